@@ -79,7 +79,10 @@ ai_build()
     docker-compose build                                        &> ${LOGS_DIR}/build.txt           && \
     docker-compose run android ${ENV_SCRIPT} ai_build_android   &> ${LOGS_DIR}/build_android.txt   && \
     docker-compose run web_app ${ENV_SCRIPT} ai_build_wasm      &> ${LOGS_DIR}/build_wasm.txt      && \
+    docker-compose run web_app ${ENV_SCRIPT} ai_build_wasm_simd &> ${LOGS_DIR}/build_wasm_simd.txt && \
+    docker-compose run web_app ${ENV_SCRIPT} ai_build_wasm_threads &> ${LOGS_DIR}/build_wasm_threads.txt && \
     docker-compose run web_app ${ENV_SCRIPT} ai_build_wasm_host &> ${LOGS_DIR}/build_wasm_host.txt && \
+    docker-compose run web_app ${ENV_SCRIPT} ai_build_wasm_host_pgo &> ${LOGS_DIR}/build_wasm_host_pgo.txt && \
     docker-compose run web_app ${ENV_SCRIPT} ai_dist_wasm       &> ${LOGS_DIR}/dist_wasm.txt       && \
     docker-compose run web_app ${ENV_SCRIPT} ai_build_webapp    &> ${LOGS_DIR}/build_webapp.txt
 
@@ -120,19 +123,48 @@ ai_build_wasm()
 
     popd
 
-    BUILD_DIR=${SOURCE_DIR}/web_app/build/wasm
+    WASM_THREADS=${WASM_THREADS:-False}
+    WASM_SIMD=${WASM_SIMD:-False}
+
+    if [ "${WASM_THREADS}" = "True" ]
+    then
+	BUILD_DIR=${SOURCE_DIR}/web_app/build/wasm-threads
+    elif [ "${WASM_SIMD}" = "True" ]
+    then
+	BUILD_DIR=${SOURCE_DIR}/web_app/build/wasm-simd
+    else
+	BUILD_DIR=${SOURCE_DIR}/web_app/build/wasm
+    fi
 
     mkdir -p ${BUILD_DIR}
 
     pushd ${BUILD_DIR}
 
-    emcmake cmake -DWASM=True -DCMAKE_BUILD_TYPE=Release --build ${SOURCE_DIR}/web_app/wasm
+    emcmake cmake -DWASM=True -DWASM_THREADS=${WASM_THREADS} -DWASM_SIMD=${WASM_SIMD} -DLTO=True -DCMAKE_BUILD_TYPE=Release --build ${SOURCE_DIR}/web_app/wasm
 
     emmake make "$@"
 
     popd
 )}
 
+#
+# Same as ai_build_wasm, but with pthreads; the web app loads this build
+# where the page is cross origin isolated and the other one elsewhere.
+#
+ai_build_wasm_threads()
+{(
+    WASM_THREADS=True ai_build_wasm "$@"
+)}
+
+#
+# Same as ai_build_wasm, but with 128-bit SIMD; the web app loads this build
+# where the browser supports it.
+#
+ai_build_wasm_simd()
+{(
+    WASM_SIMD=True ai_build_wasm "$@"
+)}
+
 ai_build_wasm_host()
 {(
     BUILD_DIR=${SOURCE_DIR}/web_app/build/host
@@ -150,6 +182,38 @@ ai_build_wasm_host()
     popd
 )}
 
+#
+# Same as ai_build_wasm_host, but profile guided and with LTO: an instrumented
+# build runs the training workload of pgo_training, and the same build
+# directory is then rebuilt with the profiles it left.  Outputs go to
+# out/host-pgo.
+#
+ai_build_wasm_host_pgo()
+{(
+    BUILD_DIR=${SOURCE_DIR}/web_app/build/host-pgo
+
+    mkdir -p ${BUILD_DIR}
+
+    pushd ${BUILD_DIR}
+
+    cmake -DWASM_HOST=True -DCMAKE_BUILD_TYPE=Release -DLTO=True -DPGO_GENERATE=True -DPGO_USE=False --build ${SOURCE_DIR}/web_app/wasm
+
+    make "$@" wasm && make pgo_training
+
+    if [ $? -ne 0 ]
+    then
+	return 1
+    fi
+
+    cmake -DPGO_GENERATE=False -DPGO_USE=True .
+
+    export CTEST_OUTPUT_ON_FAILURE=1
+
+    make "$@" && make test
+
+    popd
+)}
+
 ai_build_webapp()
 {(
     BUILD_DIR=${SOURCE_DIR}/web_app/app
@@ -171,6 +235,14 @@ ai_dist_wasm()
 
     cp ${SOURCE_DIR}/web_app/wasm/out/wasm/wasm/bin/* ${DIST_DIR}
 
+    for VARIANT in wasm-simd wasm-threads
+    do
+	if [ -d ${SOURCE_DIR}/web_app/wasm/out/${VARIANT}/wasm/bin ]
+	then
+	    cp ${SOURCE_DIR}/web_app/wasm/out/${VARIANT}/wasm/bin/* ${DIST_DIR}
+	fi
+    done
+
     echo ""
     echo "copied successfuly; files can be found at the following path"
     echo ""
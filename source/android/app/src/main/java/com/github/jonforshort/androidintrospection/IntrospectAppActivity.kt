@@ -34,6 +34,11 @@ import android.widget.ImageView
 import androidx.appcompat.app.AppCompatActivity
 import com.github.jonforshort.androidintrospection.databinding.ActivityIntrospectAppBinding
 import com.github.jonforshort.lib.ApkProcessor
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.MainScope
+import kotlinx.coroutines.cancel
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.withContext
 import timber.log.Timber.d
 import java.io.File
 
@@ -43,6 +48,11 @@ class IntrospectAppActivity : AppCompatActivity() {
     private lateinit var installedApps: List<ResolveInfo>
     private var appIconSize: Int = 0
 
+    //
+    // Scope of the processing started from the activity, cancelled with it.
+    //
+    private val scope = MainScope()
+
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
         binding = ActivityIntrospectAppBinding.inflate(layoutInflater)
@@ -55,12 +65,26 @@ class IntrospectAppActivity : AppCompatActivity() {
         binding.installedApps.setOnItemClickListener { _, _, position, _ ->
             val clickedItem = installedApps[position]
             d("item clicked : position [$position] item [$clickedItem]")
-            val modifiedApkFile = File.createTempFile("makeDebuggable", ".apk")
             val apkFile = File(clickedItem.activityInfo.applicationInfo.sourceDir)
-            ApkProcessor(apkFile).process(modifiedApkFile = modifiedApkFile, makeDebuggable = true)
+            scope.launch {
+                //
+                // Processing reads and writes the whole APK, off the UI thread.
+                //
+                val modifiedApkFile = withContext(Dispatchers.IO) {
+                    File.createTempFile("makeDebuggable", ".apk").also { modifiedApkFile ->
+                        ApkProcessor(apkFile).use { it.process(modifiedApkFile = modifiedApkFile, makeDebuggable = true) }
+                    }
+                }
+                d("item processed : position [$position] file [$modifiedApkFile]")
+            }
         }
     }
 
+    override fun onDestroy() {
+        scope.cancel()
+        super.onDestroy()
+    }
+
     private fun updateInstalledApps() {
         val mainIntent = Intent(Intent.ACTION_MAIN, null)
         mainIntent.addCategory(Intent.CATEGORY_LAUNCHER)
@@ -0,0 +1,16 @@
+cmake_minimum_required(VERSION 3.10.2)
+
+#
+# Release libraries are built with ThinLTO, linked by lld, which is what the
+# NDK supports it with.  Profiles can only come from a device, so there is
+# no profile guided build here.
+#
+if (CMAKE_BUILD_TYPE STREQUAL "Release")
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT AI_LTO_SUPPORTED LANGUAGES C CXX)
+    if (AI_LTO_SUPPORTED)
+        set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+        set(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} -fuse-ld=lld")
+        set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -fuse-ld=lld")
+    endif ()
+endif ()
@@ -0,0 +1,55 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <exception>
+#include <jni.h>
+#include <string>
+
+#include "apk/apk.h"
+#include "utils/jni_convert.h"
+#include "utils/log.h"
+
+using namespace ai;
+
+//
+// Opens the APK through the descriptor, so it is mapped or read in place,
+// and writes the debuggable copy in a single streaming pass over it.
+//
+extern "C" JNIEXPORT jboolean JNICALL Java_com_github_jonforshort_lib_ApkProcessor_nativeProcess(JNIEnv *jniEnv, jobject, jint fd, jstring modifiedApkPath,
+                                                                                                 jboolean makeDebuggable) {
+    auto const destinationPath = utils::jni::toString(jniEnv, modifiedApkPath);
+    try {
+        auto const apk = ai::Apk(static_cast<int>(fd));
+        if (!apk.isValid()) {
+            LOGW("nativeProcess, apk is not valid");
+            return JNI_FALSE;
+        }
+        if (makeDebuggable) {
+            apk.makeDebuggable(destinationPath);
+        }
+        return JNI_TRUE;
+    } catch (std::exception const &e) {
+        LOGW("nativeProcess, unable to process apk to [{}] : [{}]", destinationPath, e.what());
+        return JNI_FALSE;
+    }
+}
@@ -0,0 +1,93 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <exception>
+#include <jni.h>
+#include <string>
+#include <vector>
+
+#include "apk/apk.h"
+#include "utils/jni_convert.h"
+#include "utils/json.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+
+using namespace ai;
+
+namespace {
+    auto appendResult(std::string &output, ApkBatchResult const &result) -> void {
+        output += R"({"path":)";
+        utils::json::appendString(result.path, output);
+        if (!result.error.empty()) {
+            output += R"(,"error":)";
+            utils::json::appendString(result.error, output);
+        }
+        output += R"(,"properties":{)";
+        auto separator = "";
+        for (auto const &[key, value] : result.properties) {
+            output += separator;
+            utils::json::appendString(key, output);
+            output += ':';
+            utils::json::appendString(value, output);
+            separator = ",";
+        }
+        output += "}}\n";
+    }
+} // namespace
+
+//
+// Scans the APKs on a pool of one thread per core, reusing the index for
+// those unchanged since the last scan, and returns one JSON line per APK.
+//
+extern "C" JNIEXPORT jstring JNICALL Java_com_github_jonforshort_lib_PackageScanner_nativeScan(JNIEnv *jniEnv, jobject, jobjectArray apkPaths,
+                                                                                               jlongArray lastUpdateTimes, jstring indexPath,
+                                                                                               jstring cacheDirectory) {
+    auto const count = jniEnv->GetArrayLength(apkPaths);
+    auto targets = std::vector<ApkScanTarget>(static_cast<size_t>(count));
+    auto *const times = jniEnv->GetLongArrayElements(lastUpdateTimes, nullptr);
+    if (times == nullptr) {
+        return nullptr;
+    }
+    for (auto i = jsize{0}; i < count; i++) {
+        auto const apkPath = static_cast<jstring>(jniEnv->GetObjectArrayElement(apkPaths, i));
+        targets[i].path = utils::jni::toString(jniEnv, apkPath);
+        targets[i].lastUpdateTime = times[i];
+        jniEnv->DeleteLocalRef(apkPath);
+    }
+    jniEnv->ReleaseLongArrayElements(lastUpdateTimes, times, JNI_ABORT);
+
+    auto options = ApkBatchOptions();
+    options.fields = {ApkPropertyField::Package, ApkPropertyField::Version, ApkPropertyField::Debuggable, ApkPropertyField::Sha256};
+    options.cacheDirectory = utils::jni::toString(jniEnv, cacheDirectory);
+
+    auto output = std::string();
+    try {
+        auto threadPool = utils::ThreadPool(utils::ThreadPool::defaultThreadCount());
+        auto const analyzed = scanMany(targets, utils::jni::toString(jniEnv, indexPath), options, threadPool,
+                                       [&output](ApkBatchResult const &result) { appendResult(output, result); });
+        LOGI("nativeScan, apks [{}] analyzed [{}]", targets.size(), analyzed);
+    } catch (std::exception const &e) {
+        LOGW("nativeScan, unable to scan apks : [{}]", e.what());
+    }
+    return jniEnv->NewStringUTF(output.c_str());
+}
@@ -0,0 +1,319 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+#include <poll.h>
+#include <span>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+
+#include "utils/log.h"
+#include "EventTransport.h"
+#include "Lz4.h"
+
+using namespace ai;
+
+namespace {
+    std::atomic<uint64_t> gNextTransportId{1};
+
+    //
+    // Events moved out of a ring at a time.
+    //
+    static constexpr size_t DRAIN_SIZE = 256;
+
+    static constexpr size_t BATCH_HEADER_SIZE = 4 * sizeof(uint32_t);
+
+    auto listenAbstract(std::string const &name) -> int {
+        auto address = sockaddr_un();
+        if (name.empty() || name.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("invalid socket name " + name);
+        }
+        auto const fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("unable to create socket : ") + strerror(errno));
+        }
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path + 1, name.data(), name.size());
+        auto const addressSize = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+        if (bind(fd, reinterpret_cast<sockaddr const *>(&address), addressSize) != 0 || listen(fd, 1) != 0) {
+            auto const error = std::string(strerror(errno));
+            close(fd);
+            throw std::runtime_error("unable to listen on " + name + " : " + error);
+        }
+        return fd;
+    }
+
+    auto writeVarint(std::string &out, uint64_t value) -> void {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    auto appendUint32(std::string &out, uint32_t const value) -> void {
+        for (auto shift = 0U; shift < 32; shift += 8) {
+            out += static_cast<char>((value >> shift) & 0xffU);
+        }
+    }
+}
+
+//
+// The buffer of the thread for the last transport it published to.  The
+// transport keeps a reference too, so either may go first.
+//
+struct hook::EventTransport::ThreadLocalBuffer {
+
+    uint64_t transportId = 0;
+
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadLocalBuffer() {
+        if (buffer != nullptr) {
+            buffer->hasExited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+hook::EventTransport::EventTransport(std::string const &socketName)
+    : id_(gNextTransportId.fetch_add(1, std::memory_order_relaxed)), listenFd_(listenAbstract(socketName)) {
+    drained_.resize(DRAIN_SIZE);
+    sender_ = std::thread([this] { run(); });
+    LOGI("EventTransport, listening on @%s", socketName.c_str());
+}
+
+hook::EventTransport::~EventTransport() {
+    stopping_.store(true, std::memory_order_relaxed);
+    sender_.join();
+    disconnect();
+    close(listenFd_);
+    LOGI("~EventTransport, events %" PRIu64 " dropped %" PRIu64 " batches %" PRIu64 " bytes %" PRIu64, events_.load(), droppedEvents_.load(),
+         batches_.load(), bytesSent_.load());
+}
+
+auto hook::EventTransport::getThreadBuffer() -> ThreadBuffer & {
+    thread_local auto threadLocalBuffer = ThreadLocalBuffer();
+    if (threadLocalBuffer.transportId != id_) {
+        if (threadLocalBuffer.buffer != nullptr) {
+            threadLocalBuffer.buffer->hasExited.store(true, std::memory_order_release);
+        }
+        threadLocalBuffer.transportId = id_;
+        threadLocalBuffer.buffer = std::make_shared<ThreadBuffer>();
+        auto const lock = std::lock_guard(buffersMutex_);
+        buffers_.push_back(threadLocalBuffer.buffer);
+    }
+    return *threadLocalBuffer.buffer;
+}
+
+auto hook::EventTransport::publish(std::string_view const event) -> void {
+    auto &buffer = getThreadBuffer();
+    if (!buffer.events.tryPush(std::string(event))) {
+        buffer.droppedEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+//
+// Waits on the listening socket until a host connects, and then on the
+// host: for credits, and for room in the socket while a batch is only
+// partly sent.  Batches are filled at most every FLUSH_INTERVAL, however
+// often credits wake the thread.
+//
+auto hook::EventTransport::run() -> void {
+    auto lastFlush = std::chrono::steady_clock::now();
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        auto descriptor = pollfd{hostFd_ < 0 ? listenFd_ : hostFd_, POLLIN, 0};
+        if (hostFd_ >= 0 && pendingOffset_ < pending_.size()) {
+            descriptor.events |= POLLOUT;
+        }
+        if (poll(&descriptor, 1, FLUSH_INTERVAL) < 0 && errno != EINTR) {
+            LOGW("run, unable to poll : %s", strerror(errno));
+            return;
+        }
+        auto const now = std::chrono::steady_clock::now();
+        auto const isFlushDue = now - lastFlush >= std::chrono::milliseconds(FLUSH_INTERVAL);
+        if (isFlushDue) {
+            lastFlush = now;
+            pruneBuffers();
+        }
+        if (hostFd_ < 0) {
+            if ((descriptor.revents & POLLIN) != 0) {
+                acceptHost();
+            }
+            continue;
+        }
+        if ((descriptor.revents & (POLLERR | POLLHUP)) != 0 || ((descriptor.revents & POLLIN) != 0 && !readCredits())) {
+            disconnect();
+            continue;
+        }
+        if (isFlushDue && pendingOffset_ == pending_.size() && credits_ > 0) {
+            fillBatch();
+        }
+        if (!sendPending()) {
+            disconnect();
+        }
+    }
+}
+
+auto hook::EventTransport::acceptHost() -> void {
+    hostFd_ = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (hostFd_ < 0) {
+        LOGW("acceptHost, unable to accept : %s", strerror(errno));
+        return;
+    }
+    credits_ = INITIAL_CREDITS;
+    received_.clear();
+    pending_.assign(EVENT_STREAM_MAGIC, sizeof(EVENT_STREAM_MAGIC));
+    pending_ += static_cast<char>(EVENT_STREAM_VERSION);
+    pendingOffset_ = 0;
+    LOGI("acceptHost, host connected");
+}
+
+auto hook::EventTransport::readCredits() -> bool {
+    char bytes[64];
+    auto const size = recv(hostFd_, bytes, sizeof(bytes), MSG_DONTWAIT);
+    if (size == 0 || (size < 0 && errno != EAGAIN && errno != EINTR)) {
+        return false;
+    }
+    if (size < 0) {
+        return true;
+    }
+    received_.append(bytes, static_cast<size_t>(size));
+    auto offset = size_t{0};
+    for (; offset + sizeof(uint32_t) <= received_.size(); offset += sizeof(uint32_t)) {
+        auto granted = uint32_t{0};
+        for (auto i = size_t{0}; i < sizeof(uint32_t); i++) {
+            granted |= static_cast<uint32_t>(static_cast<uint8_t>(received_[offset + i])) << (8 * i);
+        }
+        credits_ = granted > UINT32_MAX - credits_ ? UINT32_MAX : credits_ + granted;
+    }
+    received_.erase(0, offset);
+    return true;
+}
+
+//
+// Drains the rings into a batch and frames it into pending_.  Threads are
+// taken in turn until the batch is full, so the ones after a busy thread
+// wait at most a batch.
+//
+auto hook::EventTransport::fillBatch() -> void {
+    auto buffers = std::vector<std::shared_ptr<ThreadBuffer>>();
+    {
+        auto const lock = std::lock_guard(buffersMutex_);
+        buffers = buffers_;
+    }
+    batch_.clear();
+    auto count = uint64_t{0};
+    auto dropped = uint64_t{0};
+    for (auto const &buffer : buffers) {
+        dropped += buffer->droppedEvents.exchange(0, std::memory_order_relaxed);
+        while (batch_.size() < MAX_BATCH_SIZE) {
+            auto const drainedCount = buffer->events.popBatch(std::span(drained_).first(DRAIN_SIZE));
+            for (auto i = size_t{0}; i < drainedCount; i++) {
+                writeVarint(batch_, drained_[i].size());
+                batch_ += drained_[i];
+            }
+            count += drainedCount;
+            if (drainedCount < DRAIN_SIZE) {
+                break;
+            }
+        }
+    }
+    if (count == 0 && dropped == 0 && prunedEvents_ == 0) {
+        return;
+    }
+    droppedEvents_.fetch_add(dropped, std::memory_order_relaxed);
+    dropped += std::exchange(prunedEvents_, 0);
+    compressLz4(batch_, compressed_);
+    auto const &payload = compressed_.size() < batch_.size() ? compressed_ : batch_;
+    pending_.clear();
+    appendUint32(pending_, static_cast<uint32_t>(count));
+    appendUint32(pending_, static_cast<uint32_t>(std::min<uint64_t>(dropped, UINT32_MAX)));
+    appendUint32(pending_, static_cast<uint32_t>(batch_.size()));
+    appendUint32(pending_, static_cast<uint32_t>(payload.size()));
+    pending_.reserve(BATCH_HEADER_SIZE + payload.size());
+    pending_ += payload;
+    pendingOffset_ = 0;
+    credits_--;
+    events_.fetch_add(count, std::memory_order_relaxed);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+}
+
+//
+// Forgets the rings of threads that have exited once they are drained, or
+// at once while no host is connected, counting the events left in them as
+// dropped; a process that keeps starting threads would otherwise keep a
+// ring for each.
+//
+auto hook::EventTransport::pruneBuffers() -> void {
+    auto const lock = std::lock_guard(buffersMutex_);
+    std::erase_if(buffers_, [this](auto const &buffer) {
+        if (!buffer->hasExited.load(std::memory_order_acquire)) {
+            return false;
+        }
+        auto const left = buffer->events.size();
+        if (left != 0 && hostFd_ >= 0) {
+            return false;
+        }
+        auto const dropped = left + buffer->droppedEvents.exchange(0, std::memory_order_relaxed);
+        prunedEvents_ += dropped;
+        droppedEvents_.fetch_add(dropped, std::memory_order_relaxed);
+        return true;
+    });
+}
+
+auto hook::EventTransport::sendPending() -> bool {
+    while (pendingOffset_ < pending_.size()) {
+        auto const sent = send(hostFd_, pending_.data() + pendingOffset_, pending_.size() - pendingOffset_, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+        pendingOffset_ += static_cast<size_t>(sent);
+        bytesSent_.fetch_add(static_cast<uint64_t>(sent), std::memory_order_relaxed);
+    }
+    return true;
+}
+
+auto hook::EventTransport::disconnect() -> void {
+    if (hostFd_ >= 0) {
+        close(hostFd_);
+        hostFd_ = -1;
+        LOGI("disconnect, host disconnected");
+    }
+    pending_.clear();
+    pendingOffset_ = 0;
+    credits_ = 0;
+}
+
+auto hook::EventTransport::getStats() const -> std::string {
+    return "hooks.events " + std::to_string(events_.load(std::memory_order_relaxed)) + "\n" +
+           "hooks.dropped " + std::to_string(droppedEvents_.load(std::memory_order_relaxed)) + "\n" +
+           "hooks.batches " + std::to_string(batches_.load(std::memory_order_relaxed)) + "\n" +
+           "hooks.bytes " + std::to_string(bytesSent_.load(std::memory_order_relaxed)) + "\n";
+}
@@ -0,0 +1,179 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_HOOK_EVENT_TRANSPORT_H_
+#define ANDROID_INTROSPECTION_HOOK_EVENT_TRANSPORT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "utils/ring_buffer.h"
+
+namespace ai::hook {
+
+    //
+    // Streams hook events to a host over an abstract local socket, which
+    // the host reaches with "adb forward tcp:<port> localabstract:<name>".
+    // Publishing an event is a push into a ring of the calling thread; a
+    // sender thread drains the rings every FLUSH_INTERVAL milliseconds into
+    // one batch, compresses it and sends it with a single write, so a burst
+    // of events costs a few writes rather than one each.
+    //
+    // On connecting, the host reads EVENT_STREAM_MAGIC and the version, then
+    // batches, each a header of four little-endian uint32 values: events,
+    // events dropped since the last batch, uncompressed size and payload
+    // size.  The payload is an LZ4 block, or the batch as it is if it is
+    // not smaller than that; a batch is a varint length and the bytes of
+    // each event.
+    //
+    // Flow control is by credits: a connection starts with INITIAL_CREDITS
+    // and every batch takes one.  The host grants more by sending uint32
+    // counts, e.g. one per batch it has handled.  While the host has no
+    // credits left or is not connected, events stay in the rings; events
+    // of a thread whose ring is full are dropped and counted, as are those
+    // left by a thread that exits while no host is connected.
+    //
+    class EventTransport final {
+    public:
+        static constexpr char EVENT_STREAM_MAGIC[4] = {'A', 'I', 'H', 'E'};
+
+        static constexpr uint8_t EVENT_STREAM_VERSION = 1;
+
+        static constexpr size_t EVENTS_PER_THREAD = 4096;
+
+        static constexpr uint32_t FLUSH_INTERVAL = 10;
+
+        //
+        // Uncompressed bytes of a batch past which the rings are left for
+        // the next one.
+        //
+        static constexpr size_t MAX_BATCH_SIZE = 256 * 1024;
+
+        static constexpr uint32_t INITIAL_CREDITS = 16;
+
+        //
+        // Listens on the abstract socket of the name; throws
+        // std::runtime_error if it is taken.
+        //
+        explicit EventTransport(std::string const &socketName);
+
+        ~EventTransport();
+
+        EventTransport(EventTransport const &) = delete;
+
+        auto operator=(EventTransport const &) -> EventTransport & = delete;
+
+        auto publish(std::string_view event) -> void;
+
+        //
+        // "name value" lines, like the stats of the tracer.
+        //
+        auto getStats() const -> std::string;
+
+    private:
+        struct ThreadBuffer {
+
+            ThreadBuffer() : events(EVENTS_PER_THREAD) {}
+
+            utils::SpscRingBuffer<std::string> events;
+
+            std::atomic<uint64_t> droppedEvents{0};
+
+            std::atomic<bool> hasExited{false};
+        };
+
+        struct ThreadLocalBuffer;
+
+        auto getThreadBuffer() -> ThreadBuffer &;
+
+        auto run() -> void;
+
+        auto acceptHost() -> void;
+
+        auto readCredits() -> bool;
+
+        auto fillBatch() -> void;
+
+        auto pruneBuffers() -> void;
+
+        auto sendPending() -> bool;
+
+        auto disconnect() -> void;
+
+        uint64_t const id_;
+
+        int const listenFd_;
+
+        int hostFd_ = -1;
+
+        uint32_t credits_ = 0;
+
+        //
+        // Bytes of a credit count the host has not finished sending.
+        //
+        std::string received_;
+
+        //
+        // Bytes of the last frame the socket did not take yet.
+        //
+        std::string pending_;
+
+        size_t pendingOffset_ = 0;
+
+        std::string batch_;
+
+        std::string compressed_;
+
+        //
+        // Events of pruned rings not reported in a batch yet.
+        //
+        uint64_t prunedEvents_ = 0;
+
+        std::vector<std::string> drained_;
+
+        std::mutex buffersMutex_;
+
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+
+        std::atomic<uint64_t> events_{0};
+
+        std::atomic<uint64_t> droppedEvents_{0};
+
+        std::atomic<uint64_t> batches_{0};
+
+        std::atomic<uint64_t> bytesSent_{0};
+
+        std::atomic<bool> stopping_{false};
+
+        std::thread sender_;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_HOOK_EVENT_TRANSPORT_H_ */
@@ -0,0 +1,286 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "utils/log.h"
+#include "HookEngine.h"
+#include "V8Platform.h"
+
+using namespace ai;
+
+namespace {
+    //
+    // Ordinal of the calling thread, given out in the order threads first
+    // call a hook, so threads go round the isolates.
+    //
+    std::atomic<size_t> gNextThread{0};
+
+    auto getThreadOrdinal() -> size_t {
+        static thread_local auto const ordinal = gNextThread.fetch_add(1, std::memory_order_relaxed);
+        return ordinal;
+    }
+
+    auto toString(v8::Isolate *const isolate, std::string_view const string) -> v8::Local<v8::String> {
+        return v8::String::NewFromUtf8(isolate, string.data(), v8::NewStringType::kNormal, static_cast<int>(string.size())).ToLocalChecked();
+    }
+
+    auto getHooksFunction(v8::Local<v8::Context> const context, std::string_view const name, v8::Local<v8::Object> &hooks) -> v8::Local<v8::Function> {
+        auto *const isolate = context->GetIsolate();
+        auto value = v8::Local<v8::Value>();
+        if (!context->Global()->Get(context, toString(isolate, "Hooks")).ToLocal(&value) || !value->IsObject()) {
+            return {};
+        }
+        hooks = value.As<v8::Object>();
+        if (!hooks->Get(context, toString(isolate, name)).ToLocal(&value) || !value->IsFunction()) {
+            return {};
+        }
+        return value.As<v8::Function>();
+    }
+
+    auto getPoolSize(size_t const isolateCount) -> size_t {
+        return isolateCount != 0 ? isolateCount : std::clamp<size_t>(std::thread::hardware_concurrency(), 1, hook::HookEngine::MAX_ISOLATES);
+    }
+
+    //
+    // V8 is initialized before the snapshot is loaded, as isolates are
+    // created from it whether it was read from disk or created.
+    //
+    auto loadSnapshot(std::string const &path) -> std::unique_ptr<hook::HookSnapshot> {
+        hook::initializeV8();
+        return hook::HookSnapshot::loadOrCreate(path);
+    }
+}
+
+hook::HookEngine::HookEngine(std::string const &snapshotPath, std::string codeCacheDirectory, size_t isolateCount)
+    : snapshot_(loadSnapshot(snapshotPath)), allocator_(v8::ArrayBuffer::Allocator::NewDefaultAllocator()),
+      scriptCache_(std::move(codeCacheDirectory)), mailboxes_(getPoolSize(isolateCount), MESSAGE_CAPACITY) {
+    for (auto i = size_t{0}, count = getPoolSize(isolateCount); i < count; i++) {
+        isolates_.push_back(createIsolate(i));
+    }
+    LOGI("HookEngine, isolates %zu", isolates_.size());
+}
+
+hook::HookEngine::~HookEngine() {
+    for (auto &hookIsolate : isolates_) {
+        {
+            auto const locker = v8::Locker(hookIsolate->isolate);
+            hookIsolate->context.Reset();
+        }
+        hookIsolate->isolate->Dispose();
+    }
+}
+
+auto hook::HookEngine::createIsolate(size_t const index) -> std::unique_ptr<HookIsolate> {
+    auto hookIsolate = std::make_unique<HookIsolate>(index);
+    hookIsolate->engine = this;
+
+    auto params = v8::Isolate::CreateParams();
+    params.snapshot_blob = snapshot_->getStartupData();
+    params.array_buffer_allocator = allocator_.get();
+    hookIsolate->isolate = v8::Isolate::New(params);
+
+    auto *const isolate = hookIsolate->isolate;
+    auto const locker = v8::Locker(isolate);
+    auto const isolateScope = v8::Isolate::Scope(isolate);
+    auto const handleScope = v8::HandleScope(isolate);
+    auto const context = v8::Context::New(isolate);
+    auto const contextScope = v8::Context::Scope(context);
+
+    //
+    // Installed after deserialization, as the snapshot can't refer to
+    // native functions without external references.
+    //
+    auto const post = v8::FunctionTemplate::New(isolate, postMessage, v8::External::New(isolate, hookIsolate.get()));
+    auto postFunction = v8::Local<v8::Function>();
+    if (!post->GetFunction(context).ToLocal(&postFunction) || !context->Global()->Set(context, toString(isolate, "__hookPost"), postFunction).FromMaybe(false)) {
+        LOGW("createIsolate, unable to install Hooks.post in isolate %zu", index);
+    }
+    auto const emit = v8::FunctionTemplate::New(isolate, emitEvent, v8::External::New(isolate, hookIsolate.get()));
+    auto emitFunction = v8::Local<v8::Function>();
+    if (!emit->GetFunction(context).ToLocal(&emitFunction) || !context->Global()->Set(context, toString(isolate, "__hookEmit"), emitFunction).FromMaybe(false)) {
+        LOGW("createIsolate, unable to install Hooks.emit in isolate %zu", index);
+    }
+    hookIsolate->context.Reset(isolate, context);
+    return hookIsolate;
+}
+
+auto hook::HookEngine::postMessage(v8::FunctionCallbackInfo<v8::Value> const &info) -> void {
+    auto *const hookIsolate = static_cast<HookIsolate *>(info.Data().As<v8::External>()->Value());
+    if (info.Length() < 1 || !info[0]->IsString()) {
+        return;
+    }
+    auto const message = v8::String::Utf8Value(info.GetIsolate(), info[0]);
+    if (*message != nullptr) {
+        hookIsolate->engine->mailboxes_.post(hookIsolate->index, std::string(*message, message.length()));
+    }
+}
+
+auto hook::HookEngine::emitEvent(v8::FunctionCallbackInfo<v8::Value> const &info) -> void {
+    auto *const hookIsolate = static_cast<HookIsolate *>(info.Data().As<v8::External>()->Value());
+    auto *const eventTransport = hookIsolate->engine->eventTransport_.load(std::memory_order_acquire);
+    if (eventTransport == nullptr || info.Length() < 1 || !info[0]->IsString()) {
+        return;
+    }
+    auto const event = v8::String::Utf8Value(info.GetIsolate(), info[0]);
+    if (*event != nullptr) {
+        eventTransport->publish(std::string_view(*event, event.length()));
+    }
+}
+
+auto hook::HookEngine::startEventTransport(std::string const &socketName) -> void {
+    auto const lock = std::lock_guard(eventTransportMutex_);
+    if (eventTransportOwner_ != nullptr) {
+        throw std::runtime_error("event transport already started");
+    }
+    eventTransportOwner_ = std::make_unique<EventTransport>(socketName);
+    eventTransport_.store(eventTransportOwner_.get(), std::memory_order_release);
+}
+
+auto hook::HookEngine::getEventStats() const -> std::string {
+    auto const *const eventTransport = eventTransport_.load(std::memory_order_acquire);
+    return eventTransport == nullptr ? std::string() : eventTransport->getStats();
+}
+
+auto hook::HookEngine::registerMethods(std::vector<HookSlot> methods) -> uint32_t {
+    auto const lock = std::unique_lock(methodsMutex_);
+    auto const firstSlot = static_cast<uint32_t>(methods_.size());
+    methods_.insert(methods_.end(), std::make_move_iterator(methods.begin()), std::make_move_iterator(methods.end()));
+    return firstSlot;
+}
+
+auto hook::HookEngine::getMethodId(uint32_t const slot) const -> jmethodID {
+    auto const lock = std::shared_lock(methodsMutex_);
+    return slot < methods_.size() ? methods_[slot].methodId : nullptr;
+}
+
+auto hook::HookEngine::dispatch(uint32_t const slot, std::string_view const argumentsJson) -> std::optional<std::string> {
+    auto method = std::string();
+    {
+        auto const lock = std::shared_lock(methodsMutex_);
+        if (slot >= methods_.size()) {
+            LOGW("dispatch, no method in slot %u", slot);
+            return std::nullopt;
+        }
+        if (methods_[slot].methodId == nullptr) {
+            LOGW("dispatch, method %s in slot %u is unresolved", methods_[slot].method.c_str(), slot);
+            return std::nullopt;
+        }
+        method = methods_[slot].method;
+    }
+    return dispatch(method, argumentsJson);
+}
+
+auto hook::HookEngine::pollMessages(std::vector<std::string> &messages) -> size_t {
+    return mailboxes_.pollMessages(messages);
+}
+
+auto hook::HookEngine::lockIsolate() -> std::pair<HookIsolate *, std::unique_lock<std::mutex>> {
+    auto const preferred = getThreadOrdinal() % isolates_.size();
+    for (auto i = size_t{0}; i < isolates_.size(); i++) {
+        auto &hookIsolate = *isolates_[(preferred + i) % isolates_.size()];
+        if (auto lock = std::unique_lock(hookIsolate.mutex, std::try_to_lock); lock.owns_lock()) {
+            return {&hookIsolate, std::move(lock)};
+        }
+    }
+    auto &hookIsolate = *isolates_[preferred];
+    return {&hookIsolate, std::unique_lock(hookIsolate.mutex)};
+}
+
+auto hook::HookEngine::deliverMessages(HookIsolate &hookIsolate, v8::Local<v8::Context> const context) -> void {
+    auto hooks = v8::Local<v8::Object>();
+    auto message = std::string();
+    auto deliver = v8::Local<v8::Function>();
+    while (mailboxes_.receive(hookIsolate.index, message)) {
+        if (deliver.IsEmpty()) {
+            deliver = getHooksFunction(context, "deliver", hooks);
+            if (deliver.IsEmpty()) {
+                continue;
+            }
+        }
+        auto argument = v8::Local<v8::Value>(toString(hookIsolate.isolate, message));
+        auto const tryCatch = v8::TryCatch(hookIsolate.isolate);
+        if (deliver->Call(context, hooks, 1, &argument).IsEmpty()) {
+            LOGW("deliverMessages, message handler threw in isolate %zu", hookIsolate.index);
+        }
+    }
+}
+
+auto hook::HookEngine::evaluate(std::string_view const source, std::string_view const name) -> bool {
+    auto ran = true;
+    for (auto &hookIsolate : isolates_) {
+        auto const lock = std::lock_guard(hookIsolate->mutex);
+        auto *const isolate = hookIsolate->isolate;
+        auto const locker = v8::Locker(isolate);
+        auto const isolateScope = v8::Isolate::Scope(isolate);
+        auto const handleScope = v8::HandleScope(isolate);
+        auto const context = hookIsolate->context.Get(isolate);
+        auto const contextScope = v8::Context::Scope(context);
+        auto const tryCatch = v8::TryCatch(isolate);
+        if (scriptCache_.run(context, source, name).IsEmpty()) {
+            auto const exception = v8::String::Utf8Value(isolate, tryCatch.Exception());
+            LOGW("evaluate, %.*s threw in isolate %zu : %s", static_cast<int>(name.size()), name.data(), hookIsolate->index,
+                 *exception != nullptr ? *exception : "");
+            ran = false;
+        }
+    }
+    return ran;
+}
+
+auto hook::HookEngine::dispatch(std::string_view const method, std::string_view const argumentsJson) -> std::optional<std::string> {
+    auto const [hookIsolate, lock] = lockIsolate();
+    auto *const isolate = hookIsolate->isolate;
+    auto const locker = v8::Locker(isolate);
+    auto const isolateScope = v8::Isolate::Scope(isolate);
+    auto const handleScope = v8::HandleScope(isolate);
+    auto const context = hookIsolate->context.Get(isolate);
+    auto const contextScope = v8::Context::Scope(context);
+    deliverMessages(*hookIsolate, context);
+
+    auto const tryCatch = v8::TryCatch(isolate);
+    auto hooks = v8::Local<v8::Object>();
+    auto const dispatchFunction = getHooksFunction(context, "dispatch", hooks);
+    auto arguments = v8::Local<v8::Value>();
+    if (dispatchFunction.IsEmpty() || !v8::JSON::Parse(context, toString(isolate, argumentsJson)).ToLocal(&arguments) || !arguments->IsArray()) {
+        return std::nullopt;
+    }
+    v8::Local<v8::Value> callArguments[] = {toString(isolate, method), arguments};
+    auto result = v8::Local<v8::Value>();
+    if (!dispatchFunction->Call(context, hooks, 2, callArguments).ToLocal(&result)) {
+        LOGW("dispatch, handler of %.*s threw", static_cast<int>(method.size()), method.data());
+        return std::nullopt;
+    }
+    if (result->IsUndefined()) {
+        return std::nullopt;
+    }
+    auto json = v8::Local<v8::String>();
+    if (!v8::JSON::Stringify(context, result).ToLocal(&json)) {
+        return std::nullopt;
+    }
+    auto const resultJson = v8::String::Utf8Value(isolate, json);
+    return std::string(*resultJson, resultJson.length());
+}
@@ -0,0 +1,206 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_HOOK_HOOK_ENGINE_H_
+#define ANDROID_INTROSPECTION_HOOK_HOOK_ENGINE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <jni.h>
+#include <v8.h>
+
+#include "EventTransport.h"
+#include "HookMailboxes.h"
+#include "HookSnapshot.h"
+#include "ScriptCache.h"
+
+namespace ai::hook {
+
+    //
+    // A method in a slot of registerMethods(): its name as in Hooks.on(),
+    // e.g. "org.fdroid.fdroid.FDroidApp.onCreate()V", and its id in the app,
+    // or nullptr when the app has no such method, e.g. when the table was
+    // resolved against another build.
+    //
+    struct HookSlot {
+
+        std::string method;
+
+        jmethodID methodId;
+    };
+
+    //
+    // Runs hook scripts in a pool of isolates started from the hook snapshot,
+    // with their code caches in the cache directory.  Every script is run in
+    // every isolate, so any of them can take a call of a hooked method, and
+    // threads calling hooked methods at once take different isolates rather
+    // than waiting on the lock of one.
+    //
+    // Isolates share nothing: state goes between them as messages, posted by
+    // scripts with Hooks.post() into lock-free rings and handed to the
+    // Hooks.onMessage() handlers of the others before their next call.
+    // Events for the host, from Hooks.emit(), go out through the event
+    // transport once it is started.
+    //
+    class HookEngine final {
+    public:
+        static constexpr size_t MAX_ISOLATES = 4;
+
+        static constexpr size_t MESSAGE_CAPACITY = 1024;
+
+        //
+        // With 0 isolates, one per core up to MAX_ISOLATES.
+        //
+        HookEngine(std::string const &snapshotPath, std::string codeCacheDirectory, size_t isolateCount = 0);
+
+        ~HookEngine();
+
+        HookEngine(HookEngine const &) = delete;
+
+        auto operator=(HookEngine const &) -> HookEngine & = delete;
+
+        //
+        // Runs the script in every isolate, returning whether it ran without
+        // throwing in all of them.
+        //
+        auto evaluate(std::string_view source, std::string_view name) -> bool;
+
+        //
+        // Calls the handlers of the method with the arguments, a JSON array,
+        // and returns the JSON of what the last one returned; nothing if the
+        // method has no handlers or one threw.  A thread keeps to the same
+        // isolate, and only goes to another when that one is busy.
+        //
+        auto dispatch(std::string_view method, std::string_view argumentsJson) -> std::optional<std::string>;
+
+        //
+        // Same, for a method registered by registerMethods(), so that hooked
+        // methods don't pass their names on every call; nothing for a slot
+        // whose method was not resolved.
+        //
+        auto dispatch(uint32_t slot, std::string_view argumentsJson) -> std::optional<std::string>;
+
+        //
+        // Registers methods in slots after those of earlier calls, and
+        // returns the slot of the first.
+        //
+        auto registerMethods(std::vector<HookSlot> methods) -> uint32_t;
+
+        //
+        // Id of the method in the slot, or nullptr if it was not resolved or
+        // there is no such slot.
+        //
+        auto getMethodId(uint32_t slot) const -> jmethodID;
+
+        //
+        // Moves the messages posted by scripts for the app into messages,
+        // returning how many; one thread at a time drains them.
+        //
+        auto pollMessages(std::vector<std::string> &messages) -> size_t;
+
+        //
+        // Starts streaming the events of Hooks.emit() to a host on the
+        // abstract socket of the name, see EventTransport; events emitted
+        // before are dropped.  Throws std::runtime_error if the socket is
+        // taken or a transport was started already.
+        //
+        auto startEventTransport(std::string const &socketName) -> void;
+
+        //
+        // Stats of the event transport, empty until it is started.
+        //
+        auto getEventStats() const -> std::string;
+
+        auto getIsolateCount() const -> size_t { return isolates_.size(); }
+
+        //
+        // Messages dropped because a ring was full.
+        //
+        auto getDroppedMessages() const -> uint64_t { return mailboxes_.getDroppedMessages(); }
+
+    private:
+        struct HookIsolate {
+
+            explicit HookIsolate(size_t index) : index(index) {}
+
+            size_t const index;
+
+            v8::Isolate *isolate = nullptr;
+
+            v8::Global<v8::Context> context;
+
+            std::mutex mutex;
+
+            HookEngine *engine = nullptr;
+        };
+
+        static auto postMessage(v8::FunctionCallbackInfo<v8::Value> const &info) -> void;
+
+        static auto emitEvent(v8::FunctionCallbackInfo<v8::Value> const &info) -> void;
+
+        auto createIsolate(size_t index) -> std::unique_ptr<HookIsolate>;
+
+        auto lockIsolate() -> std::pair<HookIsolate *, std::unique_lock<std::mutex>>;
+
+        auto deliverMessages(HookIsolate &hookIsolate, v8::Local<v8::Context> context) -> void;
+
+        std::unique_ptr<HookSnapshot> const snapshot_;
+
+        std::unique_ptr<v8::ArrayBuffer::Allocator> const allocator_;
+
+        ScriptCache const scriptCache_;
+
+        std::vector<std::unique_ptr<HookIsolate>> isolates_;
+
+        //
+        // The inbox of an isolate is read by whoever holds its mutex.
+        //
+        HookMailboxes mailboxes_;
+
+        //
+        // Set once, and then read without a lock by the threads emitting.
+        //
+        std::unique_ptr<EventTransport> eventTransportOwner_;
+
+        std::atomic<EventTransport *> eventTransport_{nullptr};
+
+        std::mutex eventTransportMutex_;
+
+        //
+        // Methods by slot, see registerMethods().
+        //
+        std::vector<HookSlot> methods_;
+
+        mutable std::shared_mutex methodsMutex_;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_HOOK_HOOK_ENGINE_H_ */
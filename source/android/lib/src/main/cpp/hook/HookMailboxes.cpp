@@ -0,0 +1,62 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <utility>
+
+#include "HookMailboxes.h"
+
+using namespace ai;
+
+hook::HookMailboxes::HookMailboxes(size_t const isolateCount, size_t const capacity) : outbox_(capacity) {
+    for (auto i = size_t{0}; i < isolateCount; i++) {
+        inboxes_.push_back(std::make_unique<utils::MpscRingBuffer<std::string>>(capacity));
+    }
+}
+
+auto hook::HookMailboxes::post(size_t const fromIndex, std::string message) -> void {
+    for (auto i = size_t{0}; i < inboxes_.size(); i++) {
+        if (i != fromIndex) {
+            auto copy = message;
+            if (!inboxes_[i]->tryPush(std::move(copy))) {
+                droppedMessages_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    if (!outbox_.tryPush(std::move(message))) {
+        droppedMessages_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+auto hook::HookMailboxes::receive(size_t const index, std::string &message) -> bool {
+    return inboxes_[index]->tryPop(message);
+}
+
+auto hook::HookMailboxes::pollMessages(std::vector<std::string> &messages) -> size_t {
+    auto count = size_t{0};
+    auto message = std::string();
+    while (outbox_.tryPop(message)) {
+        messages.push_back(std::move(message));
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,77 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_HOOK_HOOK_MAILBOXES_H_
+#define ANDROID_INTROSPECTION_HOOK_HOOK_MAILBOXES_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "utils/ring_buffer.h"
+
+namespace ai::hook {
+
+    //
+    // Messages of Hooks.post() between the isolates of a HookEngine and the
+    // app.  A message posted by an isolate goes into the inbox of every
+    // other one and into the outbox of the app, each a lock-free ring; a
+    // copy that finds its ring full is dropped and counted.  Any thread
+    // posts, while an inbox is read by the holder of its isolate and the
+    // outbox by one thread at a time.
+    //
+    class HookMailboxes final {
+    public:
+        HookMailboxes(size_t isolateCount, size_t capacity);
+
+        HookMailboxes(HookMailboxes const &) = delete;
+
+        auto operator=(HookMailboxes const &) -> HookMailboxes & = delete;
+
+        auto post(size_t fromIndex, std::string message) -> void;
+
+        //
+        // Pops the next message for the isolate, if any.
+        //
+        auto receive(size_t index, std::string &message) -> bool;
+
+        //
+        // Moves the messages for the app into messages, returning how many.
+        //
+        auto pollMessages(std::vector<std::string> &messages) -> size_t;
+
+        auto getDroppedMessages() const -> uint64_t { return droppedMessages_.load(std::memory_order_relaxed); }
+
+    private:
+        std::vector<std::unique_ptr<utils::MpscRingBuffer<std::string>>> inboxes_;
+
+        utils::MpscRingBuffer<std::string> outbox_;
+
+        std::atomic<uint64_t> droppedMessages_{0};
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_HOOK_HOOK_MAILBOXES_H_ */
@@ -0,0 +1,175 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <jni.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utils/jni.h"
+#include "utils/log.h"
+#include "HookEngine.h"
+#include "HookTable.h"
+
+using namespace ai;
+
+namespace {
+    //
+    // Loads the classes of the table with the class loader, each once, and
+    // looks up their methods, returning a slot per method of the table in
+    // its order, with the id of those that were found.  Lookups that fail
+    // are logged and their exceptions cleared, so one missing class doesn't
+    // stop the batch, and their slots are left unresolved.  Method ids stay
+    // valid for as long as the class loader keeps the class loaded.
+    //
+    auto resolveHookTable(JNIEnv *const jniEnv, hook::HookTable const &table, jobject const classLoader) -> std::vector<hook::HookSlot> {
+        auto slots = std::vector<hook::HookSlot>();
+        for (auto const &hookClass : table.classes) {
+            for (auto const &method : hookClass.methods) {
+                slots.push_back({hook::getMethodKey(hookClass, method), nullptr});
+            }
+        }
+        auto const classLoaderClass = jniEnv->GetObjectClass(classLoader);
+        auto const loadClass = jniEnv->GetMethodID(classLoaderClass, "loadClass", "(Ljava/lang/String;)Ljava/lang/Class;");
+        jniEnv->DeleteLocalRef(classLoaderClass);
+        if (loadClass == nullptr) {
+            jniEnv->ExceptionClear();
+            return slots;
+        }
+        auto slot = slots.begin();
+        for (auto const &hookClass : table.classes) {
+            auto const className = jniEnv->NewStringUTF(hook::getClassName(hookClass.descriptor).c_str());
+            auto const clazz = static_cast<jclass>(jniEnv->CallObjectMethod(classLoader, loadClass, className));
+            jniEnv->DeleteLocalRef(className);
+            if (jniEnv->ExceptionCheck()) {
+                jniEnv->ExceptionClear();
+                LOGW("resolveHookTable, unable to load %s", hookClass.descriptor.c_str());
+                slot += static_cast<std::ptrdiff_t>(hookClass.methods.size());
+                continue;
+            }
+            for (auto const &method : hookClass.methods) {
+                auto const methodId = (method.accessFlags & hook::ACC_STATIC) != 0
+                                      ? jniEnv->GetStaticMethodID(clazz, method.name.c_str(), method.signature.c_str())
+                                      : jniEnv->GetMethodID(clazz, method.name.c_str(), method.signature.c_str());
+                if (methodId == nullptr) {
+                    jniEnv->ExceptionClear();
+                    LOGW("resolveHookTable, no method %s%s in %s", method.name.c_str(), method.signature.c_str(), hookClass.descriptor.c_str());
+                }
+                (slot++)->methodId = methodId;
+            }
+            jniEnv->DeleteLocalRef(clazz);
+        }
+        return slots;
+    }
+}
+
+extern "C" JNIEXPORT jlong JNICALL Java_com_github_jonforshort_lib_HookManager_nativeCreate(JNIEnv *jniEnv, jclass, jstring snapshotPath,
+                                                                                            jstring codeCacheDirectory) {
+    try {
+        return reinterpret_cast<jlong>(new hook::HookEngine(utils::jni::toString(jniEnv, snapshotPath), utils::jni::toString(jniEnv, codeCacheDirectory)));
+    } catch (std::exception const &e) {
+        LOGE("nativeCreate, unable to create hook engine : %s", e.what());
+        if (auto const exceptionClass = jniEnv->FindClass("java/lang/IllegalStateException"); exceptionClass != nullptr) {
+            jniEnv->ThrowNew(exceptionClass, e.what());
+        }
+        return 0;
+    }
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_github_jonforshort_lib_HookManager_nativeDestroy(JNIEnv *, jclass, jlong engine) {
+    delete reinterpret_cast<hook::HookEngine *>(engine);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL Java_com_github_jonforshort_lib_HookManager_nativeEvaluate(JNIEnv *jniEnv, jclass, jlong engine, jstring source,
+                                                                                                 jstring name) {
+    auto *const hookEngine = reinterpret_cast<hook::HookEngine *>(engine);
+    return hookEngine->evaluate(utils::jni::toString(jniEnv, source), utils::jni::toString(jniEnv, name)) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jstring JNICALL Java_com_github_jonforshort_lib_HookManager_nativeDispatch(JNIEnv *jniEnv, jclass, jlong engine, jstring method,
+                                                                                                jstring argumentsJson) {
+    auto *const hookEngine = reinterpret_cast<hook::HookEngine *>(engine);
+    auto const result = hookEngine->dispatch(utils::jni::toString(jniEnv, method), utils::jni::toString(jniEnv, argumentsJson));
+    return result ? jniEnv->NewStringUTF(result->c_str()) : nullptr;
+}
+
+extern "C" JNIEXPORT jstring JNICALL Java_com_github_jonforshort_lib_HookManager_nativeDispatchSlot(JNIEnv *jniEnv, jclass, jlong engine, jint slot,
+                                                                                                    jstring argumentsJson) {
+    auto *const hookEngine = reinterpret_cast<hook::HookEngine *>(engine);
+    auto const result = hookEngine->dispatch(static_cast<uint32_t>(slot), utils::jni::toString(jniEnv, argumentsJson));
+    return result ? jniEnv->NewStringUTF(result->c_str()) : nullptr;
+}
+
+extern "C" JNIEXPORT jint JNICALL Java_com_github_jonforshort_lib_HookManager_nativeInstallHookTable(JNIEnv *jniEnv, jclass, jlong engine, jbyteArray table,
+                                                                                                   jobject classLoader) {
+    auto *const hookEngine = reinterpret_cast<hook::HookEngine *>(engine);
+    try {
+        auto const hookTable = hook::parseHookTable(utils::jni::toBytes(jniEnv, table));
+        auto slots = resolveHookTable(jniEnv, hookTable, classLoader);
+        auto const resolved = std::count_if(slots.begin(), slots.end(), [](auto const &slot) { return slot.methodId != nullptr; });
+        LOGI("nativeInstallHookTable, resolved [%td] of [%zu] methods", resolved, slots.size());
+        return static_cast<jint>(hookEngine->registerMethods(std::move(slots)));
+    } catch (std::exception const &e) {
+        LOGE("nativeInstallHookTable, unable to install hook table : %s", e.what());
+        if (auto const exceptionClass = jniEnv->FindClass("java/lang/IllegalArgumentException"); exceptionClass != nullptr) {
+            jniEnv->ThrowNew(exceptionClass, e.what());
+        }
+        return -1;
+    }
+}
+
+extern "C" JNIEXPORT jboolean JNICALL Java_com_github_jonforshort_lib_HookManager_nativeIsSlotResolved(JNIEnv *, jclass, jlong engine, jint slot) {
+    return reinterpret_cast<hook::HookEngine *>(engine)->getMethodId(static_cast<uint32_t>(slot)) != nullptr ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_github_jonforshort_lib_HookManager_nativeStartEventTransport(JNIEnv *jniEnv, jclass, jlong engine,
+                                                                                                      jstring socketName) {
+    auto *const hookEngine = reinterpret_cast<hook::HookEngine *>(engine);
+    try {
+        hookEngine->startEventTransport(utils::jni::toString(jniEnv, socketName));
+    } catch (std::exception const &e) {
+        LOGE("nativeStartEventTransport, unable to start event transport : %s", e.what());
+        if (auto const exceptionClass = jniEnv->FindClass("java/io/IOException"); exceptionClass != nullptr) {
+            jniEnv->ThrowNew(exceptionClass, e.what());
+        }
+    }
+}
+
+extern "C" JNIEXPORT jstring JNICALL Java_com_github_jonforshort_lib_HookManager_nativeGetEventStats(JNIEnv *jniEnv, jclass, jlong engine) {
+    return jniEnv->NewStringUTF(reinterpret_cast<hook::HookEngine *>(engine)->getEventStats().c_str());
+}
+
+extern "C" JNIEXPORT jstring JNICALL Java_com_github_jonforshort_lib_HookManager_nativePollMessages(JNIEnv *jniEnv, jclass, jlong engine) {
+    auto *const hookEngine = reinterpret_cast<hook::HookEngine *>(engine);
+    auto messages = std::vector<std::string>();
+    hookEngine->pollMessages(messages);
+    auto joined = std::string();
+    for (auto const &message : messages) {
+        joined += message;
+        joined += '\n';
+    }
+    return jniEnv->NewStringUTF(joined.c_str());
+}
@@ -0,0 +1,144 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "Hash.h"
+#include "HookRuntimeSource.h"
+#include "HookSnapshot.h"
+
+using namespace ai;
+
+namespace {
+    //
+    // "AIHS"
+    //
+    constexpr uint32_t SNAPSHOT_MAGIC = 0x53484941;
+
+    struct SnapshotHeader {
+
+        uint32_t magic;
+
+        uint32_t size;
+
+        uint64_t runtimeHash;
+    };
+
+    auto toString(v8::Isolate *const isolate, std::string_view const string) -> v8::Local<v8::String> {
+        return v8::String::NewFromUtf8(isolate, string.data(), v8::NewStringType::kNormal, static_cast<int>(string.size())).ToLocalChecked();
+    }
+
+    auto runRuntime(v8::Local<v8::Context> const context) -> bool {
+        auto *const isolate = context->GetIsolate();
+        auto const tryCatch = v8::TryCatch(isolate);
+        auto origin = v8::ScriptOrigin(toString(isolate, "hook_runtime.js"));
+        auto script = v8::Local<v8::Script>();
+        if (!v8::Script::Compile(context, toString(isolate, hook::HOOK_RUNTIME_SOURCE), &origin).ToLocal(&script) || script->Run(context).IsEmpty()) {
+            auto const exception = v8::String::Utf8Value(isolate, tryCatch.Exception());
+            LOGE("runRuntime, unable to run hook runtime : %s", *exception != nullptr ? *exception : "");
+            return false;
+        }
+        return true;
+    }
+
+    auto write(std::string const &path, std::vector<char> const &blob) -> void {
+        auto const header = SnapshotHeader{SNAPSHOT_MAGIC, static_cast<uint32_t>(blob.size()), hook::HookSnapshot::getRuntimeHash()};
+        auto const temporaryPath = path + "." + std::to_string(getpid()) + ".tmp";
+        {
+            auto file = std::ofstream(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+            file.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+            if (!file.good()) {
+                LOGW("write, unable to write snapshot to %s", temporaryPath.c_str());
+                std::remove(temporaryPath.c_str());
+                return;
+            }
+        }
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            LOGW("write, unable to write snapshot to %s", path.c_str());
+            std::remove(temporaryPath.c_str());
+        }
+    }
+
+    auto read(std::string const &path) -> std::vector<char> {
+        auto file = std::ifstream(path, std::ios::in | std::ios::binary);
+        auto header = SnapshotHeader{};
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != SNAPSHOT_MAGIC ||
+            header.runtimeHash != hook::HookSnapshot::getRuntimeHash()) {
+            return {};
+        }
+        auto blob = std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (blob.size() != header.size) {
+            return {};
+        }
+        return blob;
+    }
+}
+
+hook::HookSnapshot::HookSnapshot(std::vector<char> blob) : blob_(std::move(blob)) {
+    startupData_.data = blob_.data();
+    startupData_.raw_size = static_cast<int>(blob_.size());
+}
+
+auto hook::HookSnapshot::getRuntimeHash() -> uint64_t {
+    static auto const runtimeHash = hashBytes(HOOK_RUNTIME_SOURCE, hashBytes(v8::V8::GetVersion()));
+    return runtimeHash;
+}
+
+auto hook::HookSnapshot::create() -> std::unique_ptr<HookSnapshot> {
+    auto creator = v8::SnapshotCreator();
+    {
+        auto *const isolate = creator.GetIsolate();
+        auto const handleScope = v8::HandleScope(isolate);
+        auto const context = v8::Context::New(isolate);
+        auto const contextScope = v8::Context::Scope(context);
+        if (!runRuntime(context)) {
+            throw std::logic_error("unable to run hook runtime");
+        }
+        creator.SetDefaultContext(context);
+    }
+    auto const startupData = creator.CreateBlob(v8::SnapshotCreator::FunctionCodeHandling::kKeep);
+    if (startupData.data == nullptr) {
+        throw std::logic_error("unable to create hook snapshot");
+    }
+    auto blob = std::vector<char>(startupData.data, startupData.data + startupData.raw_size);
+    delete[] startupData.data;
+    LOGI("create, hook snapshot of %zu bytes", blob.size());
+    return std::make_unique<HookSnapshot>(std::move(blob));
+}
+
+auto hook::HookSnapshot::loadOrCreate(std::string const &path) -> std::unique_ptr<HookSnapshot> {
+    if (auto blob = read(path); !blob.empty()) {
+        LOGD("loadOrCreate, loaded hook snapshot from %s", path.c_str());
+        return std::make_unique<HookSnapshot>(std::move(blob));
+    }
+    auto snapshot = create();
+    write(path, snapshot->getBlob());
+    return snapshot;
+}
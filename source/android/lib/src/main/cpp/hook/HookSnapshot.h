@@ -0,0 +1,81 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_HOOK_HOOK_SNAPSHOT_H_
+#define ANDROID_INTROSPECTION_HOOK_HOOK_SNAPSHOT_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <v8.h>
+
+namespace ai::hook {
+
+    //
+    // Startup snapshot of an isolate whose default context has run the hook
+    // runtime, so contexts created from it start with Hooks in place instead
+    // of compiling and running the runtime on every start.
+    //
+    class HookSnapshot final {
+    public:
+        //
+        // Runs the runtime in a fresh isolate and serializes it, along with
+        // the code of its functions; V8 must be initialized.
+        //
+        static auto create() -> std::unique_ptr<HookSnapshot>;
+
+        //
+        // Reads the snapshot at path if it was made by this build of V8 from
+        // this runtime; otherwise creates one and writes it there, so only
+        // the first start after an update pays for it.
+        //
+        static auto loadOrCreate(std::string const &path) -> std::unique_ptr<HookSnapshot>;
+
+        explicit HookSnapshot(std::vector<char> blob);
+
+        HookSnapshot(HookSnapshot const &) = delete;
+
+        auto operator=(HookSnapshot const &) -> HookSnapshot & = delete;
+
+        //
+        // What Isolate::CreateParams::snapshot_blob is set to; it has to
+        // outlive the isolates created from it.
+        //
+        auto getStartupData() -> v8::StartupData * { return &startupData_; }
+
+        auto getBlob() const -> std::vector<char> const & { return blob_; }
+
+        //
+        // Identifies the V8 build and runtime a snapshot is made from.
+        //
+        static auto getRuntimeHash() -> uint64_t;
+
+    private:
+        std::vector<char> const blob_;
+
+        v8::StartupData startupData_ = {};
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_HOOK_HOOK_SNAPSHOT_H_ */
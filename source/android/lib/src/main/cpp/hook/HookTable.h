@@ -0,0 +1,71 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_HOOK_HOOK_TABLE_H_
+#define ANDROID_INTROSPECTION_HOOK_HOOK_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "utils/hook_table_format.h"
+
+namespace ai::hook {
+
+    static constexpr uint32_t ACC_STATIC = 0x0008;
+
+    using HookTableMethod = utils::HookTableMethod;
+
+    using HookTableClass = utils::HookTableClass;
+
+    using HookTableDexFile = utils::HookTableDexFile;
+
+    //
+    // Methods to hook as resolved on the host against the dex files of the
+    // app, by "--command hook-table" of the analyzer (ai::dex::HookTable),
+    // so that installing them takes no lookup by name here.  The format is
+    // shared with the analyzer, see utils/hook_table_format.h.
+    //
+    using HookTable = utils::HookTableData;
+
+    //
+    // Decodes a table; throws std::runtime_error if it is corrupt or of
+    // another version.
+    //
+    auto parseHookTable(std::span<std::byte const> encoded) -> HookTable;
+
+    //
+    // Name of the class of a descriptor for ClassLoader.loadClass(), e.g.
+    // "org.fdroid.fdroid.FDroidApp".
+    //
+    auto getClassName(std::string const &descriptor) -> std::string;
+
+    //
+    // Method as hook scripts name it in Hooks.on(), e.g.
+    // "org.fdroid.fdroid.FDroidApp.onCreate()V".
+    //
+    auto getMethodKey(HookTableClass const &hookClass, HookTableMethod const &method) -> std::string;
+}
+
+#endif /* ANDROID_INTROSPECTION_HOOK_HOOK_TABLE_H_ */
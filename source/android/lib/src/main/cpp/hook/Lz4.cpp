@@ -0,0 +1,177 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "Lz4.h"
+
+namespace {
+    static constexpr size_t MIN_MATCH = 4;
+
+    //
+    // The format ends every block with literals: the last match starts at
+    // least MATCH_FIND_LIMIT bytes before the end and ends at least
+    // LAST_LITERALS bytes before it.
+    //
+    static constexpr size_t MATCH_FIND_LIMIT = 12;
+
+    static constexpr size_t LAST_LITERALS = 5;
+
+    static constexpr size_t MAX_OFFSET = 65535;
+
+    static constexpr uint32_t HASH_BITS = 12;
+
+    static constexpr uint8_t RUN_MASK = 15;
+
+    auto read32(char const *const bytes) -> uint32_t {
+        auto value = uint32_t{0};
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    auto hash(uint32_t const sequence) -> uint32_t {
+        return (sequence * 2654435761U) >> (32 - HASH_BITS);
+    }
+
+    //
+    // Lengths of 15 or more spill into bytes of 255 and a final remainder.
+    //
+    auto writeLength(std::string &out, size_t length) -> void {
+        for (; length >= 255; length -= 255) {
+            out += static_cast<char>(255);
+        }
+        out += static_cast<char>(length);
+    }
+
+    auto writeSequence(std::string &out, char const *const literals, size_t const literalLength, size_t const offset, size_t const matchLength) -> void {
+        auto const literalNibble = std::min<size_t>(literalLength, RUN_MASK);
+        auto const matchNibble = offset == 0 ? 0 : std::min<size_t>(matchLength - MIN_MATCH, RUN_MASK);
+        out += static_cast<char>(literalNibble << 4U | matchNibble);
+        if (literalNibble == RUN_MASK) {
+            writeLength(out, literalLength - RUN_MASK);
+        }
+        out.append(literals, literalLength);
+        if (offset == 0) {
+            return;
+        }
+        out += static_cast<char>(offset & 0xffU);
+        out += static_cast<char>(offset >> 8U);
+        if (matchNibble == RUN_MASK) {
+            writeLength(out, matchLength - MIN_MATCH - RUN_MASK);
+        }
+    }
+
+    auto readLength(std::span<char const> const compressed, size_t &offset, size_t &length) -> bool {
+        for (;;) {
+            if (offset >= compressed.size()) {
+                return false;
+            }
+            auto const byte = static_cast<uint8_t>(compressed[offset++]);
+            length += byte;
+            if (byte != 255) {
+                return true;
+            }
+        }
+    }
+}
+
+auto ai::hook::compressLz4(std::span<char const> const source, std::string &compressed) -> void {
+    compressed.clear();
+    compressed.reserve(source.size() + source.size() / 255 + 16);
+    auto const *const begin = source.data();
+    auto const size = source.size();
+    auto anchor = size_t{0};
+    if (size > MATCH_FIND_LIMIT) {
+        //
+        // Positions + 1, so that 0 is an empty slot.
+        //
+        auto table = std::array<uint32_t, 1U << HASH_BITS>();
+        auto position = size_t{0};
+        while (position + MATCH_FIND_LIMIT <= size) {
+            auto const sequence = read32(begin + position);
+            auto &slot = table[hash(sequence)];
+            auto const candidate = static_cast<size_t>(slot);
+            slot = static_cast<uint32_t>(position + 1);
+            if (candidate == 0 || position + 1 - candidate > MAX_OFFSET || read32(begin + candidate - 1) != sequence) {
+                position++;
+                continue;
+            }
+            auto const match = candidate - 1;
+            auto length = MIN_MATCH;
+            while (position + length < size - LAST_LITERALS && begin[match + length] == begin[position + length]) {
+                length++;
+            }
+            writeSequence(compressed, begin + anchor, position - anchor, position - match, length);
+            position += length;
+            anchor = position;
+        }
+    }
+    writeSequence(compressed, begin + anchor, size - anchor, 0, 0);
+}
+
+auto ai::hook::decompressLz4(std::span<char const> const compressed, size_t const uncompressedSize) -> std::optional<std::string> {
+    auto out = std::string();
+    out.reserve(uncompressedSize);
+    auto offset = size_t{0};
+    while (offset < compressed.size()) {
+        auto const token = static_cast<uint8_t>(compressed[offset++]);
+        auto literalLength = static_cast<size_t>(token >> 4U);
+        if (literalLength == RUN_MASK && !readLength(compressed, offset, literalLength)) {
+            return std::nullopt;
+        }
+        if (literalLength > compressed.size() - offset || literalLength > uncompressedSize - out.size()) {
+            return std::nullopt;
+        }
+        out.append(compressed.data() + offset, literalLength);
+        offset += literalLength;
+        if (offset == compressed.size()) {
+            break;
+        }
+        if (compressed.size() - offset < 2) {
+            return std::nullopt;
+        }
+        auto const matchOffset = static_cast<size_t>(static_cast<uint8_t>(compressed[offset])) | static_cast<size_t>(static_cast<uint8_t>(compressed[offset + 1])) << 8U;
+        offset += 2;
+        auto matchLength = static_cast<size_t>(token & RUN_MASK);
+        if (matchLength == RUN_MASK && !readLength(compressed, offset, matchLength)) {
+            return std::nullopt;
+        }
+        matchLength += MIN_MATCH;
+        if (matchOffset == 0 || matchOffset > out.size() || matchLength > uncompressedSize - out.size()) {
+            return std::nullopt;
+        }
+        //
+        // Byte by byte: a match may overlap the bytes it produces.
+        //
+        auto const start = out.size() - matchOffset;
+        for (size_t i = 0; i < matchLength; i++) {
+            out += out[start + i];
+        }
+    }
+    if (out.size() != uncompressedSize) {
+        return std::nullopt;
+    }
+    return out;
+}
@@ -0,0 +1,49 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_HOOK_LZ4_H_
+#define ANDROID_INTROSPECTION_HOOK_LZ4_H_
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace ai::hook {
+
+    //
+    // Compresses into the LZ4 block format, so hosts can decompress with
+    // any LZ4 library (LZ4_decompress_safe()).  One greedy pass with a small
+    // hash table: hook events repeat their method names and JSON keys, and
+    // a batch has to be compressed in well under the flush interval.
+    //
+    auto compressLz4(std::span<char const> source, std::string &compressed) -> void;
+
+    //
+    // Decompresses a block whose uncompressed size is known; nothing if the
+    // block is corrupt or does not decompress to exactly that size.
+    //
+    auto decompressLz4(std::span<char const> compressed, size_t uncompressedSize) -> std::optional<std::string>;
+}
+
+#endif /* ANDROID_INTROSPECTION_HOOK_LZ4_H_ */
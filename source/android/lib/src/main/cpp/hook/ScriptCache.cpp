@@ -0,0 +1,110 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "utils/log.h"
+#include "Hash.h"
+#include "ScriptCache.h"
+
+using namespace ai;
+
+namespace {
+    auto toString(v8::Isolate *const isolate, std::string_view const string) -> v8::Local<v8::String> {
+        return v8::String::NewFromUtf8(isolate, string.data(), v8::NewStringType::kNormal, static_cast<int>(string.size())).ToLocalChecked();
+    }
+
+    auto read(std::string const &path) -> std::vector<uint8_t> {
+        auto file = std::ifstream(path, std::ios::in | std::ios::binary);
+        if (!file.good()) {
+            return {};
+        }
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    auto write(std::string const &path, uint8_t const *const data, int const size) -> void {
+        auto const temporaryPath = path + "." + std::to_string(getpid()) + ".tmp";
+        {
+            auto file = std::ofstream(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<char const *>(data), size);
+            if (!file.good()) {
+                LOGW("write, unable to write code cache to %s", temporaryPath.c_str());
+                std::remove(temporaryPath.c_str());
+                return;
+            }
+        }
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            LOGW("write, unable to write code cache to %s", path.c_str());
+            std::remove(temporaryPath.c_str());
+        }
+    }
+}
+
+hook::ScriptCache::ScriptCache(std::string directory) : directory_(std::move(directory)) { mkdir(directory_.c_str(), 0700); }
+
+auto hook::ScriptCache::getPath(std::string_view const source) const -> std::string {
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016" PRIx64 ".jsc", hashBytes(source));
+    return directory_ + "/" + fileName;
+}
+
+auto hook::ScriptCache::run(v8::Local<v8::Context> const context, std::string_view const source, std::string_view const name) const
+    -> v8::MaybeLocal<v8::Value> {
+    auto *const isolate = context->GetIsolate();
+    auto handleScope = v8::EscapableHandleScope(isolate);
+    auto const path = getPath(source);
+    auto const cache = read(path);
+
+    auto const origin = v8::ScriptOrigin(toString(isolate, name));
+    auto scriptSource = cache.empty() ? v8::ScriptCompiler::Source(toString(isolate, source), origin)
+                                      : v8::ScriptCompiler::Source(toString(isolate, source), origin,
+                                                                   new v8::ScriptCompiler::CachedData(cache.data(), static_cast<int>(cache.size())));
+    auto const options = cache.empty() ? v8::ScriptCompiler::kNoCompileOptions : v8::ScriptCompiler::kConsumeCodeCache;
+    auto script = v8::Local<v8::Script>();
+    if (!v8::ScriptCompiler::Compile(context, &scriptSource, options).ToLocal(&script)) {
+        return {};
+    }
+    auto const rejected = cache.empty() || scriptSource.GetCachedData()->rejected;
+    if (!cache.empty()) {
+        LOGD("run, code cache of %.*s %s", static_cast<int>(name.size()), name.data(), rejected ? "rejected" : "accepted");
+    }
+
+    auto result = v8::Local<v8::Value>();
+    if (!script->Run(context).ToLocal(&result)) {
+        return {};
+    }
+    if (rejected) {
+        auto const codeCache = std::unique_ptr<v8::ScriptCompiler::CachedData>(v8::ScriptCompiler::CreateCodeCache(script->GetUnboundScript()));
+        if (codeCache != nullptr) {
+            write(path, codeCache->data, codeCache->length);
+        }
+    }
+    return handleScope.Escape(result);
+}
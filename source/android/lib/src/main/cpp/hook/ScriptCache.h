@@ -0,0 +1,57 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_HOOK_SCRIPT_CACHE_H_
+#define ANDROID_INTROSPECTION_HOOK_SCRIPT_CACHE_H_
+
+#include <string>
+#include <string_view>
+#include <v8.h>
+
+namespace ai::hook {
+
+    //
+    // Code caches of hook scripts, one file per script in the directory,
+    // named after the hash of its source.  A script with a cache V8 accepts
+    // is deserialized rather than parsed and compiled; V8 rejects caches of
+    // another build or of other flags, which are then written again.
+    //
+    class ScriptCache final {
+    public:
+        explicit ScriptCache(std::string directory);
+
+        //
+        // Compiles and runs the script in the context.  Caches are made after
+        // the first run, so they hold the functions the script ran and not
+        // only its top level.
+        //
+        auto run(v8::Local<v8::Context> context, std::string_view source, std::string_view name) const -> v8::MaybeLocal<v8::Value>;
+
+    private:
+        auto getPath(std::string_view source) const -> std::string;
+
+        std::string const directory_;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_HOOK_SCRIPT_CACHE_H_ */
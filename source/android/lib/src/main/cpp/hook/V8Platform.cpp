@@ -0,0 +1,47 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <libplatform/libplatform.h>
+#include <memory>
+#include <mutex>
+#include <v8.h>
+
+#include "utils/log.h"
+#include "V8Platform.h"
+
+using namespace ai;
+
+namespace {
+    std::once_flag gInitialized;
+
+    std::unique_ptr<v8::Platform> gPlatform;
+}
+
+auto hook::initializeV8() -> void {
+    std::call_once(gInitialized, [] {
+        LOGI("initializing v8 %s", v8::V8::GetVersion());
+        gPlatform = v8::platform::NewDefaultPlatform();
+        v8::V8::InitializePlatform(gPlatform.get());
+        v8::V8::Initialize();
+    });
+}
@@ -0,0 +1,77 @@
+//
+// Runtime of hook scripts, run once into the startup snapshot of the
+// isolates so scripts find it in place the moment a context is created.
+//
+// Scripts register handlers with Hooks.on(method, handler) and the native
+// side delivers calls of hooked methods through Hooks.dispatch().  Each
+// isolate of the pool has its own Hooks; Hooks.post(message) sends a JSON
+// value to the Hooks.onMessage() handlers of the others and to the app, and
+// Hooks.emit(event) one to the host connected to the event transport.
+//
+(function (global) {
+    'use strict';
+
+    const handlers = new Map();
+
+    const messageHandlers = [];
+
+    const Hooks = {
+
+        on(method, handler) {
+            if (typeof handler !== 'function') {
+                throw new TypeError('handler of ' + method + ' is not a function');
+            }
+            let methodHandlers = handlers.get(method);
+            if (methodHandlers === undefined) {
+                methodHandlers = [];
+                handlers.set(method, methodHandlers);
+            }
+            methodHandlers.push(handler);
+        },
+
+        off(method) {
+            handlers.delete(method);
+        },
+
+        isHooked(method) {
+            return handlers.has(method);
+        },
+
+        post(message) {
+            global.__hookPost(JSON.stringify(message));
+        },
+
+        emit(event) {
+            global.__hookEmit(JSON.stringify(event));
+        },
+
+        onMessage(handler) {
+            if (typeof handler !== 'function') {
+                throw new TypeError('message handler is not a function');
+            }
+            messageHandlers.push(handler);
+        },
+
+        deliver(message) {
+            const value = JSON.parse(message);
+            for (const handler of messageHandlers) {
+                handler(value);
+            }
+        },
+
+        dispatch(method, args) {
+            const methodHandlers = handlers.get(method);
+            if (methodHandlers === undefined) {
+                return undefined;
+            }
+            let result;
+            for (const handler of methodHandlers) {
+                result = handler.apply(undefined, args);
+            }
+            return result;
+        },
+    };
+
+    Object.freeze(Hooks);
+    Object.defineProperty(global, 'Hooks', {value: Hooks, enumerable: true});
+})(this);
@@ -0,0 +1,195 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <optional>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "EventTransport.h"
+#include "Lz4.h"
+
+using namespace ai;
+
+namespace {
+
+auto connectAbstract(std::string const &name) -> int {
+    auto address = sockaddr_un();
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path + 1, name.data(), name.size());
+    auto const addressSize = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+    auto const fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr const *>(&address), addressSize) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+auto readExactly(int const fd, size_t const size) -> std::string {
+    auto bytes = std::string(size, '\0');
+    for (auto offset = size_t{0}; offset < size;) {
+        auto const received = recv(fd, bytes.data() + offset, size - offset, 0);
+        if (received <= 0) {
+            return {};
+        }
+        offset += static_cast<size_t>(received);
+    }
+    return bytes;
+}
+
+auto loadUint32(std::string const &bytes, size_t const offset) -> uint32_t {
+    auto value = uint32_t{0};
+    for (auto i = size_t{0}; i < sizeof(uint32_t); i++) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[offset + i])) << (8 * i);
+    }
+    return value;
+}
+
+struct Batch {
+
+    uint32_t dropped = 0;
+
+    std::vector<std::string> events;
+};
+
+//
+// Reads a frame as a host does, decompressing the payload unless it was
+// sent as it is.
+//
+auto readBatch(int const fd) -> std::optional<Batch> {
+    auto const header = readExactly(fd, 4 * sizeof(uint32_t));
+    if (header.empty()) {
+        return std::nullopt;
+    }
+    auto const count = loadUint32(header, 0);
+    auto const uncompressedSize = loadUint32(header, 8);
+    auto const payload = readExactly(fd, loadUint32(header, 12));
+    auto const bytes = payload.size() < uncompressedSize ? hook::decompressLz4(payload, uncompressedSize) : payload;
+    if (!bytes) {
+        return std::nullopt;
+    }
+    auto batch = Batch{loadUint32(header, 4), {}};
+    for (auto offset = size_t{0}; batch.events.size() < count && offset < bytes->size();) {
+        auto size = uint64_t{0};
+        for (auto shift = 0U;; shift += 7) {
+            auto const byte = static_cast<uint8_t>((*bytes)[offset++]);
+            size |= static_cast<uint64_t>(byte & 0x7fU) << shift;
+            if ((byte & 0x80U) == 0) {
+                break;
+            }
+        }
+        batch.events.push_back(bytes->substr(offset, size));
+        offset += size;
+    }
+    return batch;
+}
+
+auto getSocketName(char const *name) -> std::string { return std::string("hook-test-") + std::to_string(getpid()) + "-" + name; }
+
+}
+
+TEST(Lz4, compressedBlock_DecompressesToTheSameBytes) {
+    auto events = std::string();
+    for (auto i = 0; i < 1000; i++) {
+        events += R"({"method":"android.app.Activity.onCreate","thread":)" + std::to_string(i % 7) + "}";
+    }
+    auto random = std::string(4096, '\0');
+    auto generator = std::mt19937(42);
+    for (auto &byte : random) {
+        byte = static_cast<char>(generator());
+    }
+
+    for (auto const &source : {events, random, std::string("a"), std::string()}) {
+        auto compressed = std::string();
+        hook::compressLz4(source, compressed);
+        EXPECT_EQ(hook::decompressLz4(compressed, source.size()), source);
+    }
+    auto compressed = std::string();
+    hook::compressLz4(events, compressed);
+    EXPECT_LT(compressed.size(), events.size() / 4);
+    EXPECT_FALSE(hook::decompressLz4(std::string_view(compressed).substr(0, compressed.size() / 2), events.size()));
+    EXPECT_FALSE(hook::decompressLz4(compressed, events.size() + 1));
+}
+
+TEST(EventTransport, eventsOfAThreadThatExits_AreStreamedToTheHost) {
+    auto const socketName = getSocketName("streamed");
+    auto transport = hook::EventTransport(socketName);
+    auto const host = connectAbstract(socketName);
+    ASSERT_GE(host, 0);
+    auto const streamHeader = readExactly(host, sizeof(hook::EventTransport::EVENT_STREAM_MAGIC) + 1);
+    ASSERT_EQ(streamHeader, std::string("AIHE") + static_cast<char>(hook::EventTransport::EVENT_STREAM_VERSION));
+
+    auto const eventCount = 1000;
+    std::thread([&transport] {
+        for (auto i = 0; i < eventCount; i++) {
+            transport.publish(R"({"method":"m","index":)" + std::to_string(i) + "}");
+        }
+    }).join();
+
+    auto events = std::vector<std::string>();
+    while (events.size() < eventCount) {
+        auto const batch = readBatch(host);
+        ASSERT_TRUE(batch);
+        EXPECT_EQ(batch->dropped, 0U);
+        events.insert(events.end(), batch->events.begin(), batch->events.end());
+    }
+    ASSERT_EQ(events.size(), eventCount);
+    for (auto i = 0; i < eventCount; i++) {
+        EXPECT_EQ(events[i], R"({"method":"m","index":)" + std::to_string(i) + "}");
+    }
+    close(host);
+}
+
+TEST(EventTransport, threadExitsWithoutAHost_ItsEventsAreDropped) {
+    auto const socketName = getSocketName("dropped");
+    auto transport = hook::EventTransport(socketName);
+    std::thread([&transport] {
+        for (auto i = 0; i < 5; i++) {
+            transport.publish("event");
+        }
+    }).join();
+
+    for (auto waited = 0; waited < 200 && transport.getStats().find("hooks.dropped 5\n") == std::string::npos; waited++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_NE(transport.getStats().find("hooks.dropped 5\n"), std::string::npos);
+
+    auto const host = connectAbstract(socketName);
+    ASSERT_GE(host, 0);
+    readExactly(host, sizeof(hook::EventTransport::EVENT_STREAM_MAGIC) + 1);
+    auto const batch = readBatch(host);
+    ASSERT_TRUE(batch);
+    EXPECT_EQ(batch->dropped, 5U);
+    EXPECT_TRUE(batch->events.empty());
+    close(host);
+}
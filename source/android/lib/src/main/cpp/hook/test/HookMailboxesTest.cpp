@@ -0,0 +1,110 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstddef>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HookMailboxes.h"
+
+using namespace ai;
+
+namespace {
+
+auto receiveAll(hook::HookMailboxes &mailboxes, size_t const index) -> std::vector<std::string> {
+    auto messages = std::vector<std::string>();
+    auto message = std::string();
+    while (mailboxes.receive(index, message)) {
+        messages.push_back(message);
+    }
+    return messages;
+}
+
+}
+
+TEST(HookMailboxes, post_ReachesTheOtherIsolatesAndTheAppButNotTheSender) {
+    auto mailboxes = hook::HookMailboxes(3, 16);
+    mailboxes.post(1, "a");
+    mailboxes.post(0, "b");
+
+    EXPECT_EQ(receiveAll(mailboxes, 0), std::vector<std::string>({"a"}));
+    EXPECT_EQ(receiveAll(mailboxes, 1), std::vector<std::string>({"b"}));
+    EXPECT_EQ(receiveAll(mailboxes, 2), std::vector<std::string>({"a", "b"}));
+    auto messages = std::vector<std::string>();
+    EXPECT_EQ(mailboxes.pollMessages(messages), 2U);
+    EXPECT_EQ(messages, std::vector<std::string>({"a", "b"}));
+    EXPECT_EQ(mailboxes.pollMessages(messages), 0U);
+    EXPECT_EQ(mailboxes.getDroppedMessages(), 0U);
+}
+
+TEST(HookMailboxes, postOfSeveralThreads_EachKeepsItsOrder) {
+    constexpr auto threadCount = size_t{3};
+    constexpr auto messageCount = 500;
+    auto mailboxes = hook::HookMailboxes(threadCount + 1, threadCount * messageCount);
+    auto threads = std::vector<std::thread>();
+    for (auto index = size_t{0}; index < threadCount; index++) {
+        threads.emplace_back([&mailboxes, index] {
+            for (auto i = 0; i < messageCount; i++) {
+                mailboxes.post(index, std::to_string(index) + ":" + std::to_string(i));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    auto const checkOrder = [](std::vector<std::string> const &messages, size_t const count) {
+        ASSERT_EQ(messages.size(), count * messageCount);
+        auto next = std::vector<int>(threadCount, 0);
+        for (auto const &message : messages) {
+            auto const separator = message.find(':');
+            auto const index = std::stoul(message.substr(0, separator));
+            EXPECT_EQ(std::stoi(message.substr(separator + 1)), next[index]++);
+        }
+    };
+    checkOrder(receiveAll(mailboxes, threadCount), threadCount);
+    checkOrder(receiveAll(mailboxes, 0), threadCount - 1);
+    auto messages = std::vector<std::string>();
+    mailboxes.pollMessages(messages);
+    checkOrder(messages, threadCount);
+    EXPECT_EQ(mailboxes.getDroppedMessages(), 0U);
+}
+
+TEST(HookMailboxes, fullRings_CopiesAreDroppedAndCounted) {
+    auto mailboxes = hook::HookMailboxes(2, 4);
+    for (auto i = 0; i < 6; i++) {
+        mailboxes.post(0, std::to_string(i));
+    }
+    EXPECT_EQ(mailboxes.getDroppedMessages(), 4U);
+
+    auto messages = std::vector<std::string>();
+    EXPECT_EQ(mailboxes.pollMessages(messages), 4U);
+    EXPECT_EQ(messages, std::vector<std::string>({"0", "1", "2", "3"}));
+    EXPECT_EQ(receiveAll(mailboxes, 1), std::vector<std::string>({"0", "1", "2", "3"}));
+
+    mailboxes.post(1, "4");
+    EXPECT_EQ(receiveAll(mailboxes, 0), std::vector<std::string>({"4"}));
+    EXPECT_EQ(mailboxes.getDroppedMessages(), 4U);
+}
@@ -0,0 +1,62 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <jni.h>
+#include <mutex>
+
+#include "SamplingProfiler.h"
+#include "Symbolizer.h"
+
+using namespace ai;
+
+namespace {
+    std::mutex gSymbolizerMutex;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL Java_com_github_jonforshort_lib_Profiler_nativeStart(JNIEnv *, jclass, jint rateHz, jint budgetPercent) {
+    auto &profiler = profiler::SamplingProfiler::getInstance();
+    return profiler.start(static_cast<uint32_t>(rateHz), static_cast<uint32_t>(budgetPercent)) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_github_jonforshort_lib_Profiler_nativeStop(JNIEnv *, jclass) {
+    profiler::SamplingProfiler::getInstance().stop();
+}
+
+extern "C" JNIEXPORT jstring JNICALL Java_com_github_jonforshort_lib_Profiler_nativeGetFoldedStacks(JNIEnv *jniEnv, jclass) {
+    return jniEnv->NewStringUTF(profiler::SamplingProfiler::getInstance().getFoldedStacks().c_str());
+}
+
+extern "C" JNIEXPORT jstring JNICALL Java_com_github_jonforshort_lib_Profiler_nativeGetSymbolizedStacks(JNIEnv *jniEnv, jclass) {
+    //
+    // Kept across calls, so libraries are indexed once and the pcs of the
+    // last profiles stay cached.
+    //
+    static auto symbolizer = profiler::Symbolizer();
+    auto const folded = profiler::SamplingProfiler::getInstance().getFoldedStacks();
+    auto const lock = std::lock_guard(gSymbolizerMutex);
+    return jniEnv->NewStringUTF(symbolizer.symbolizeFoldedStacks(folded).c_str());
+}
+
+extern "C" JNIEXPORT jstring JNICALL Java_com_github_jonforshort_lib_Profiler_nativeGetStats(JNIEnv *jniEnv, jclass) {
+    return jniEnv->NewStringUTF(profiler::SamplingProfiler::getInstance().getStats().c_str());
+}
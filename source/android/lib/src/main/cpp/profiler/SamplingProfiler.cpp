@@ -0,0 +1,363 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+
+#include "utils/log.h"
+#include "SamplingProfiler.h"
+
+using namespace ai;
+
+namespace {
+    constexpr uint64_t NANOS_PER_SECOND = 1000000000;
+
+    auto getTid() -> pid_t { return static_cast<pid_t>(syscall(SYS_gettid)); }
+
+    auto getTime(clockid_t const clock) -> uint64_t {
+        auto time = timespec{};
+        clock_gettime(clock, &time);
+        return static_cast<uint64_t>(time.tv_sec) * NANOS_PER_SECOND + static_cast<uint64_t>(time.tv_nsec);
+    }
+
+    //
+    // Clock of the CPU time of a thread of this process by tid, as
+    // pthread_getcpuclockid() makes for pthreads: CPUCLOCK_SCHED with the
+    // per-thread bit.
+    //
+    auto getThreadCpuClock(pid_t const tid) -> clockid_t { return static_cast<clockid_t>((~static_cast<unsigned>(tid) << 3U) | 6U); }
+
+    //
+    // Unwinds the stack interrupted by the signal.  The signal context is
+    // what libunwind unwinds from locally, except on ARM where it only
+    // takes the 16 core registers.
+    //
+    auto unwind(void *const signalContext, profiler::Sample &sample) -> void {
+#if defined(__arm__)
+        auto context = unw_context_t{};
+        std::memcpy(context.regs, &static_cast<ucontext_t *>(signalContext)->uc_mcontext.arm_r0, sizeof(context.regs));
+        auto *const unwindContext = &context;
+#else
+        auto *const unwindContext = static_cast<unw_context_t *>(signalContext);
+#endif
+        auto cursor = unw_cursor_t{};
+        if (unw_init_local(&cursor, unwindContext) < 0) {
+            return;
+        }
+        do {
+            auto pc = unw_word_t{0};
+            if (unw_get_reg(&cursor, UNW_REG_IP, &pc) < 0 || pc == 0) {
+                break;
+            }
+            sample.frames[sample.frameCount++] = static_cast<uintptr_t>(pc);
+        } while (sample.frameCount < profiler::Sample::MAX_FRAMES && unw_step(&cursor) > 0);
+    }
+}
+
+auto profiler::SamplingProfiler::getInstance() -> SamplingProfiler & {
+    static auto instance = SamplingProfiler();
+    return instance;
+}
+
+auto profiler::SamplingProfiler::onSignal(int, siginfo_t *, void *const context) -> void {
+    auto &profiler = getInstance();
+    auto const savedErrno = errno;
+    profiler.activeHandlers_.fetch_add(1, std::memory_order_seq_cst);
+    if (profiler.running_.load(std::memory_order_seq_cst)) {
+        auto const tid = getTid();
+        if (auto *const slot = profiler.findSlot(tid); slot != nullptr) {
+            auto const startedAt = getTime(CLOCK_THREAD_CPUTIME_ID);
+            auto sample = Sample();
+            sample.timestamp = getTime(CLOCK_MONOTONIC);
+            sample.tid = tid;
+            unwind(context, sample);
+            if (slot->samples.tryPush(std::move(sample))) {
+                profiler.samples_.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                profiler.droppedSamples_.fetch_add(1, std::memory_order_relaxed);
+            }
+            slot->handlerTime.fetch_add(getTime(CLOCK_THREAD_CPUTIME_ID) - startedAt, std::memory_order_relaxed);
+        }
+    }
+    profiler.activeHandlers_.fetch_sub(1, std::memory_order_seq_cst);
+    errno = savedErrno;
+}
+
+auto profiler::SamplingProfiler::findSlot(pid_t const tid) -> ThreadSlot * {
+    for (auto i = size_t{0}; i < MAX_THREADS; i++) {
+        auto &slot = slots_[(static_cast<size_t>(tid) + i) % MAX_THREADS];
+        auto const slotTid = slot.tid.load(std::memory_order_acquire);
+        if (slotTid == tid) {
+            return &slot;
+        }
+        if (slotTid == FREE_SLOT) {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+auto profiler::SamplingProfiler::start(uint32_t const rateHz, uint32_t const budgetPercent) -> bool {
+    if (running_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    if (slots_ == nullptr) {
+        slots_ = std::make_unique<ThreadSlot[]>(MAX_THREADS);
+    }
+    requestedRate_ = std::max(rateHz, MIN_RATE);
+    rate_.store(requestedRate_, std::memory_order_relaxed);
+    budget_ = std::max<uint32_t>(budgetPercent, 1);
+    {
+        auto const lock = std::lock_guard(profileMutex_);
+        profile_.clear();
+    }
+    samples_.store(0, std::memory_order_relaxed);
+    droppedSamples_.store(0, std::memory_order_relaxed);
+
+    //
+    // Per thread caches make local unwinding safe in signal handlers.
+    //
+    unw_set_caching_policy(unw_local_addr_space, UNW_CACHE_PER_THREAD);
+
+    struct sigaction action = {};
+    action.sa_sigaction = onSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previousAction_) != 0) {
+        LOGE("start, unable to handle SIGPROF : %s", strerror(errno));
+        return false;
+    }
+    running_.store(true, std::memory_order_seq_cst);
+    stopping_.store(false, std::memory_order_relaxed);
+    LOGI("start, sampling at %u Hz within %u%% of cpu", requestedRate_, budget_);
+    thread_ = std::thread([this] { run(); });
+    return true;
+}
+
+auto profiler::SamplingProfiler::stop() -> void {
+    if (!running_.load(std::memory_order_acquire)) {
+        return;
+    }
+    stopping_.store(true, std::memory_order_relaxed);
+    thread_.join();
+
+    //
+    // Timers are gone, but a signal already sent may still be handled; wait
+    // for handlers past the check of running_ before the rings go.
+    //
+    running_.store(false, std::memory_order_seq_cst);
+    while (activeHandlers_.load(std::memory_order_seq_cst) > 0) {
+        std::this_thread::yield();
+    }
+    for (auto i = size_t{0}; i < MAX_THREADS; i++) {
+        if (slots_[i].tid.load(std::memory_order_relaxed) > 0) {
+            removeThread(slots_[i]);
+        }
+        slots_[i].tid.store(FREE_SLOT, std::memory_order_relaxed);
+    }
+    sigaction(SIGPROF, &previousAction_, nullptr);
+    LOGI("stop, samples %" PRIu64 " dropped %" PRIu64, samples_.load(), droppedSamples_.load());
+}
+
+auto profiler::SamplingProfiler::run() -> void {
+    profilerTid_ = getTid();
+    lastHandlerTime_ = 0;
+    lastProcessTime_ = getTime(CLOCK_PROCESS_CPUTIME_ID);
+    auto elapsed = uint32_t{0};
+    updateThreads();
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_INTERVAL));
+        elapsed += DRAIN_INTERVAL;
+        for (auto i = size_t{0}; i < MAX_THREADS; i++) {
+            if (slots_[i].tid.load(std::memory_order_relaxed) > 0) {
+                drain(slots_[i]);
+            }
+        }
+        if (elapsed % THREADS_INTERVAL == 0) {
+            updateThreads();
+        }
+        if (elapsed % BUDGET_INTERVAL == 0) {
+            checkBudget();
+        }
+    }
+    for (auto i = size_t{0}; i < MAX_THREADS; i++) {
+        auto &slot = slots_[i];
+        if (slot.hasTimer) {
+            timer_delete(slot.timer);
+            slot.hasTimer = false;
+        }
+    }
+}
+
+auto profiler::SamplingProfiler::updateThreads() -> void {
+    auto *const tasks = opendir("/proc/self/task");
+    if (tasks == nullptr) {
+        return;
+    }
+    for (auto i = size_t{0}; i < MAX_THREADS; i++) {
+        slots_[i].seen = false;
+    }
+    while (auto const *const entry = readdir(tasks)) {
+        auto const tid = static_cast<pid_t>(std::atoi(entry->d_name));
+        if (tid <= 0 || tid == profilerTid_) {
+            continue;
+        }
+        if (auto *const slot = findSlot(tid); slot != nullptr) {
+            slot->seen = true;
+        } else {
+            addThread(tid);
+        }
+    }
+    closedir(tasks);
+    for (auto i = size_t{0}; i < MAX_THREADS; i++) {
+        auto &slot = slots_[i];
+        if (slot.tid.load(std::memory_order_relaxed) > 0 && !slot.seen) {
+            removeThread(slot);
+        }
+    }
+}
+
+auto profiler::SamplingProfiler::addThread(pid_t const tid) -> void {
+    for (auto i = size_t{0}; i < MAX_THREADS; i++) {
+        auto &slot = slots_[(static_cast<size_t>(tid) + i) % MAX_THREADS];
+        if (auto const slotTid = slot.tid.load(std::memory_order_relaxed); slotTid != FREE_SLOT && slotTid != REMOVED_SLOT) {
+            continue;
+        }
+        auto event = sigevent{};
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGPROF;
+        event._sigev_un._tid = tid;
+        if (timer_create(getThreadCpuClock(tid), &event, &slot.timer) != 0) {
+            //
+            // The thread is gone already.
+            //
+            return;
+        }
+        slot.hasTimer = true;
+        slot.seen = true;
+        slot.tid.store(tid, std::memory_order_release);
+        armTimer(slot);
+        threadCount_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LOGW("addThread, no slot left for thread %d", tid);
+}
+
+//
+// The slot is marked removed rather than free, so that lookups of threads
+// that probed past it still get to them.
+//
+auto profiler::SamplingProfiler::removeThread(ThreadSlot &slot) -> void {
+    if (slot.hasTimer) {
+        timer_delete(slot.timer);
+        slot.hasTimer = false;
+    }
+    drain(slot);
+    lastHandlerTime_ -= std::min(lastHandlerTime_, slot.handlerTime.exchange(0, std::memory_order_relaxed));
+    slot.tid.store(REMOVED_SLOT, std::memory_order_release);
+    threadCount_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+auto profiler::SamplingProfiler::drain(ThreadSlot &slot) -> void {
+    auto sample = Sample();
+    auto const lock = std::lock_guard(profileMutex_);
+    while (slot.samples.tryPop(sample)) {
+        if (sample.frameCount > 0) {
+            profile_[std::vector<uintptr_t>(sample.frames, sample.frames + sample.frameCount)]++;
+        }
+    }
+}
+
+auto profiler::SamplingProfiler::armTimer(ThreadSlot &slot) -> void {
+    auto const interval = NANOS_PER_SECOND / rate_.load(std::memory_order_relaxed);
+    auto timerSpec = itimerspec{};
+    timerSpec.it_interval.tv_sec = static_cast<time_t>(interval / NANOS_PER_SECOND);
+    timerSpec.it_interval.tv_nsec = static_cast<long>(interval % NANOS_PER_SECOND);
+    timerSpec.it_value = timerSpec.it_interval;
+    timer_settime(slot.timer, 0, &timerSpec, nullptr);
+}
+
+auto profiler::SamplingProfiler::checkBudget() -> void {
+    auto handlerTime = uint64_t{0};
+    for (auto i = size_t{0}; i < MAX_THREADS; i++) {
+        handlerTime += slots_[i].handlerTime.load(std::memory_order_relaxed);
+    }
+    auto const processTime = getTime(CLOCK_PROCESS_CPUTIME_ID);
+    auto const spent = handlerTime - std::min(handlerTime, lastHandlerTime_);
+    auto const used = processTime - lastProcessTime_;
+    lastHandlerTime_ = handlerTime;
+    lastProcessTime_ = processTime;
+    if (used == 0) {
+        return;
+    }
+    auto const overhead = static_cast<uint32_t>(spent * 10000 / used);
+    overhead_.store(overhead, std::memory_order_relaxed);
+
+    auto const rate = rate_.load(std::memory_order_relaxed);
+    auto const newRate = getAdjustedRate(rate, requestedRate_, MIN_RATE, overhead, budget_);
+    if (newRate != rate) {
+        LOGI("checkBudget, overhead %u.%02u%%, sampling at %u Hz", overhead / 100, overhead % 100, newRate);
+        rate_.store(newRate, std::memory_order_relaxed);
+        for (auto i = size_t{0}; i < MAX_THREADS; i++) {
+            if (slots_[i].hasTimer) {
+                armTimer(slots_[i]);
+            }
+        }
+    }
+}
+
+auto profiler::SamplingProfiler::getFoldedStacks() const -> std::string {
+    auto folded = std::string();
+    char pc[2 + 2 * sizeof(uintptr_t) + 2];
+    auto const lock = std::lock_guard(profileMutex_);
+    for (auto const &[frames, count] : profile_) {
+        for (auto frame = frames.rbegin(); frame != frames.rend(); frame++) {
+            std::snprintf(pc, sizeof(pc), "%s0x%" PRIxPTR, frame == frames.rbegin() ? "" : ";", *frame);
+            folded += pc;
+        }
+        folded += ' ';
+        folded += std::to_string(count);
+        folded += '\n';
+    }
+    return folded;
+}
+
+auto profiler::SamplingProfiler::getStats() const -> std::string {
+    auto const overhead = overhead_.load(std::memory_order_relaxed);
+    auto const hundredths = std::to_string(overhead % 100);
+    return "profiler.rate " + std::to_string(rate_.load(std::memory_order_relaxed)) + "\n" +
+           "profiler.threads " + std::to_string(threadCount_.load(std::memory_order_relaxed)) + "\n" +
+           "profiler.samples " + std::to_string(samples_.load(std::memory_order_relaxed)) + "\n" +
+           "profiler.dropped " + std::to_string(droppedSamples_.load(std::memory_order_relaxed)) + "\n" +
+           "profiler.overhead " + std::to_string(overhead / 100) + (overhead % 100 < 10 ? ".0" : ".") + hundredths + "\n";
+}
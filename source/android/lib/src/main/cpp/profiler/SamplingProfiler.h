@@ -0,0 +1,235 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_PROFILER_SAMPLING_PROFILER_H_
+#define ANDROID_INTROSPECTION_PROFILER_SAMPLING_PROFILER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+#include "utils/ring_buffer.h"
+
+namespace ai::profiler {
+
+    //
+    // Stack of a thread when its timer fired, innermost frame first.
+    //
+    struct Sample {
+
+        static constexpr size_t MAX_FRAMES = 48;
+
+        uint64_t timestamp = 0;
+
+        pid_t tid = 0;
+
+        uint32_t frameCount = 0;
+
+        uintptr_t frames[MAX_FRAMES] = {};
+    };
+
+    //
+    // Sampling rate after a budget check that measured overhead, in
+    // hundredths of a percent of the CPU of the process: halved while over
+    // budgetPercent, down to minRate, and doubled back up to requestedRate
+    // once under half of it.
+    //
+    constexpr auto getAdjustedRate(uint32_t const rate, uint32_t const requestedRate, uint32_t const minRate, uint32_t const overhead,
+                                   uint32_t const budgetPercent) -> uint32_t {
+        if (overhead > budgetPercent * 100) {
+            return std::max(rate / 2, minRate);
+        }
+        if (overhead < budgetPercent * 100 / 2 && rate < requestedRate) {
+            return std::min(rate * 2, requestedRate);
+        }
+        return rate;
+    }
+
+    //
+    // CPU profiler of the process it is loaded into.  Every thread gets a
+    // timer on its own CPU clock that sends it SIGPROF, so threads are
+    // sampled in proportion to the CPU they use.  The handler unwinds the
+    // interrupted stack with libunwind into a ring of the thread, allocated
+    // up front, and a background thread drains the rings into a profile of
+    // stacks and picks up threads as they come and go.
+    //
+    // The time spent in the handler is measured against the CPU used by the
+    // process: over budget the rate is halved, and it goes back up to what
+    // was asked for once well under.
+    //
+    class SamplingProfiler final {
+    public:
+        static constexpr uint32_t DEFAULT_RATE = 100;
+
+        static constexpr uint32_t MIN_RATE = 1;
+
+        static constexpr uint32_t DEFAULT_BUDGET = 2;
+
+        static constexpr size_t MAX_THREADS = 128;
+
+        static constexpr size_t SAMPLES_PER_THREAD = 32;
+
+        //
+        // How often rings are drained, threads looked up and overhead
+        // checked, in milliseconds.
+        //
+        static constexpr uint32_t DRAIN_INTERVAL = 50;
+
+        static constexpr uint32_t THREADS_INTERVAL = 250;
+
+        static constexpr uint32_t BUDGET_INTERVAL = 1000;
+
+        //
+        // There is one SIGPROF handler per process, so one profiler.
+        //
+        static auto getInstance() -> SamplingProfiler &;
+
+        SamplingProfiler(SamplingProfiler const &) = delete;
+
+        auto operator=(SamplingProfiler const &) -> SamplingProfiler & = delete;
+
+        //
+        // Samples every thread rateHz times per second of the CPU it uses,
+        // keeping the handler under budgetPercent of the CPU of the process.
+        // Returns false if already started or if SIGPROF can't be handled.
+        //
+        auto start(uint32_t rateHz = DEFAULT_RATE, uint32_t budgetPercent = DEFAULT_BUDGET) -> bool;
+
+        //
+        // Stops sampling; the profile is kept until the next start.
+        //
+        auto stop() -> void;
+
+        auto isRunning() const -> bool { return running_.load(std::memory_order_acquire); }
+
+        //
+        // The profile as folded stacks, one "pc;pc;...;pc count" line per
+        // distinct stack with the outermost frame first and pcs in hex, as
+        // flame graph tools read them.
+        //
+        auto getFoldedStacks() const -> std::string;
+
+        //
+        // "name value" lines, like the stats of the VPN.
+        //
+        auto getStats() const -> std::string;
+
+    private:
+        //
+        // Tids of slots never used, and of slots of threads that are gone.
+        //
+        static constexpr pid_t FREE_SLOT = 0;
+
+        static constexpr pid_t REMOVED_SLOT = -1;
+
+        struct ThreadSlot {
+
+            std::atomic<pid_t> tid{0};
+
+            timer_t timer = {};
+
+            bool hasTimer = false;
+
+            bool seen = false;
+
+            utils::SpscRingBuffer<Sample> samples{SAMPLES_PER_THREAD};
+
+            //
+            // CPU time spent in the handler on the thread, in nanoseconds.
+            //
+            std::atomic<uint64_t> handlerTime{0};
+        };
+
+        SamplingProfiler() = default;
+
+        static auto onSignal(int signal, siginfo_t *info, void *context) -> void;
+
+        auto findSlot(pid_t tid) -> ThreadSlot *;
+
+        auto run() -> void;
+
+        auto updateThreads() -> void;
+
+        auto addThread(pid_t tid) -> void;
+
+        auto removeThread(ThreadSlot &slot) -> void;
+
+        auto drain(ThreadSlot &slot) -> void;
+
+        auto armTimer(ThreadSlot &slot) -> void;
+
+        auto checkBudget() -> void;
+
+        std::unique_ptr<ThreadSlot[]> slots_;
+
+        std::atomic<bool> running_{false};
+
+        std::atomic<int> activeHandlers_{0};
+
+        std::atomic<uint32_t> rate_{DEFAULT_RATE};
+
+        uint32_t requestedRate_ = DEFAULT_RATE;
+
+        uint32_t budget_ = DEFAULT_BUDGET;
+
+        pid_t profilerTid_ = 0;
+
+        std::thread thread_;
+
+        std::atomic<bool> stopping_{false};
+
+        struct sigaction previousAction_ = {};
+
+        uint64_t lastHandlerTime_ = 0;
+
+        uint64_t lastProcessTime_ = 0;
+
+        //
+        // Share of the CPU time of the process spent in the handler, in
+        // hundredths of a percent, as of the last budget check.
+        //
+        std::atomic<uint32_t> overhead_{0};
+
+        std::atomic<uint64_t> samples_{0};
+
+        std::atomic<uint64_t> droppedSamples_{0};
+
+        std::atomic<uint32_t> threadCount_{0};
+
+        mutable std::mutex profileMutex_;
+
+        std::map<std::vector<uintptr_t>, uint64_t> profile_;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_PROFILER_SAMPLING_PROFILER_H_ */
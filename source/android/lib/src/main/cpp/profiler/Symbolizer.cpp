@@ -0,0 +1,213 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+#include "elf/elf_file.h"
+#include "elf/symbol_index.h"
+#include "utils/log.h"
+#include "utils/mapped_file.h"
+#include "Symbolizer.h"
+
+using namespace ai;
+
+namespace {
+    auto getCacheIndex(uintptr_t const pc) -> size_t {
+        return static_cast<size_t>((pc >> 1U) ^ (pc >> 13U)) & (profiler::Symbolizer::CACHE_SIZE - 1);
+    }
+
+    auto getFileName(std::string_view const path) -> std::string_view {
+        auto const separator = path.rfind('/');
+        return separator == std::string_view::npos ? path : path.substr(separator + 1);
+    }
+}
+
+//
+// Mapped and indexed on the first pc in the library; a library that fails
+// to is not tried again.
+//
+struct profiler::Symbolizer::Library {
+
+    std::string path;
+
+    bool isLoaded = false;
+
+    std::unique_ptr<utils::MappedFile> mapping;
+
+    std::unique_ptr<elf::ElfFile> file;
+
+    std::unique_ptr<elf::SymbolIndex> symbols;
+
+    auto load() -> void {
+        isLoaded = true;
+        try {
+            mapping = std::make_unique<utils::MappedFile>(path);
+            file = std::make_unique<elf::ElfFile>(mapping->bytes());
+            symbols = std::make_unique<elf::SymbolIndex>(*file);
+        } catch (std::exception const &e) {
+            LOGW("load, unable to index %s : %s", path.c_str(), e.what());
+            symbols.reset();
+        }
+    }
+};
+
+profiler::Symbolizer::Symbolizer() : cache_(std::make_unique<CacheEntry[]>(CACHE_SIZE)) {}
+
+profiler::Symbolizer::~Symbolizer() = default;
+
+auto profiler::Symbolizer::symbolize(uintptr_t const pc) -> Frame {
+    auto &entry = cache_[getCacheIndex(pc)];
+    if (entry.pc == pc && pc != 0) {
+        cacheHits_++;
+        return entry.frame;
+    }
+    cacheMisses_++;
+    entry.pc = pc;
+    entry.frame = lookUp(pc);
+    return entry.frame;
+}
+
+auto profiler::Symbolizer::lookUp(uintptr_t const pc) -> Frame {
+    auto const *mapping = findMapping(pc);
+    if (mapping == nullptr) {
+        //
+        // Libraries come and go; maps are read again on a pc outside them.
+        //
+        loadMappings();
+        mapping = findMapping(pc);
+        if (mapping == nullptr) {
+            return Frame{{}, {}, pc};
+        }
+    }
+    auto &library = *mapping->library;
+    auto const fileOffset = pc - mapping->start + mapping->offset;
+    if (!library.isLoaded) {
+        library.load();
+    }
+    if (library.symbols != nullptr) {
+        if (auto const address = library.symbols->getAddressOfOffset(fileOffset)) {
+            if (auto const function = library.symbols->find(*address)) {
+                return Frame{library.path, function->name, *address - function->start};
+            }
+        }
+    }
+    return Frame{library.path, {}, fileOffset};
+}
+
+auto profiler::Symbolizer::findMapping(uintptr_t const pc) const -> Mapping const * {
+    auto const next = std::upper_bound(mappings_.begin(), mappings_.end(), pc, [](auto const pc, auto const &mapping) { return pc < mapping.start; });
+    if (next == mappings_.begin()) {
+        return nullptr;
+    }
+    auto const &mapping = *(next - 1);
+    return pc < mapping.end ? &mapping : nullptr;
+}
+
+auto profiler::Symbolizer::loadMappings() -> void {
+    auto *const maps = std::fopen("/proc/self/maps", "re");
+    if (maps == nullptr) {
+        LOGE("loadMappings, unable to read maps : %s", strerror(errno));
+        return;
+    }
+    mappings_.clear();
+    char line[512];
+    while (std::fgets(line, sizeof(line), maps) != nullptr) {
+        auto start = uintptr_t{0};
+        auto end = uintptr_t{0};
+        auto offset = uint64_t{0};
+        char permissions[5] = {};
+        auto pathStart = 0;
+        if (std::sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %4s %" SCNx64 " %*s %*s %n", &start, &end, permissions, &offset, &pathStart) < 4 ||
+            permissions[2] != 'x' || line[pathStart] != '/') {
+            continue;
+        }
+        auto path = std::string_view(line + pathStart);
+        if (!path.empty() && path.back() == '\n') {
+            path.remove_suffix(1);
+        }
+        if (path.ends_with(".apk")) {
+            continue;
+        }
+        auto library = std::find_if(libraries_.begin(), libraries_.end(), [path](auto const &candidate) { return candidate->path == path; });
+        if (library == libraries_.end()) {
+            libraries_.push_back(std::make_unique<Library>());
+            libraries_.back()->path = path;
+            library = libraries_.end() - 1;
+        }
+        mappings_.push_back(Mapping{start, end, offset, library->get()});
+    }
+    std::fclose(maps);
+    std::sort(mappings_.begin(), mappings_.end(), [](auto const &left, auto const &right) { return left.start < right.start; });
+    LOGD("loadMappings, executable mappings %zu of %zu libraries", mappings_.size(), libraries_.size());
+}
+
+//
+// Pcs past the innermost frame are return addresses, which may be the first
+// instruction of the next function after a call that doesn't return; they
+// are looked up one byte back, in the call.
+//
+auto profiler::Symbolizer::symbolizeFoldedStacks(std::string_view folded) -> std::string {
+    auto symbolized = std::string();
+    symbolized.reserve(folded.size());
+    char offset[24];
+    while (!folded.empty()) {
+        auto const lineEnd = std::min(folded.find('\n'), folded.size());
+        auto const line = folded.substr(0, lineEnd);
+        folded.remove_prefix(std::min(lineEnd + 1, folded.size()));
+        auto const countStart = line.rfind(' ');
+        if (countStart == std::string_view::npos) {
+            continue;
+        }
+        auto stack = line.substr(0, countStart);
+        while (!stack.empty()) {
+            auto const frameEnd = std::min(stack.find(';'), stack.size());
+            auto const isInnermost = frameEnd == stack.size();
+            auto hex = stack.substr(0, frameEnd);
+            if (hex.starts_with("0x")) {
+                hex.remove_prefix(2);
+            }
+            auto pc = uintptr_t{0};
+            std::from_chars(hex.data(), hex.data() + hex.size(), pc, 16);
+            stack.remove_prefix(std::min(frameEnd + 1, stack.size()));
+
+            auto const frame = symbolize(isInnermost || pc == 0 ? pc : pc - 1);
+            if (!frame.function.empty()) {
+                symbolized += frame.function;
+            } else {
+                symbolized += frame.library.empty() ? "[unknown]" : getFileName(frame.library);
+                std::snprintf(offset, sizeof(offset), "+0x%" PRIx64, frame.offset);
+                symbolized += offset;
+            }
+            symbolized += isInnermost ? ' ' : ';';
+        }
+        symbolized += line.substr(countStart + 1);
+        symbolized += '\n';
+    }
+    return symbolized;
+}
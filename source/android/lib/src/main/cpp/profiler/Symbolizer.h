@@ -0,0 +1,139 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_PROFILER_SYMBOLIZER_H_
+#define ANDROID_INTROSPECTION_PROFILER_SYMBOLIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ai::utils {
+    class MappedFile;
+}
+
+namespace ai::elf {
+    class ElfFile;
+
+    class SymbolIndex;
+}
+
+namespace ai::profiler {
+
+    struct Frame {
+
+        //
+        // Path of the library mapped at the pc, empty if none.
+        //
+        std::string_view library;
+
+        //
+        // Function of the pc, empty if not found in the symbols.
+        //
+        std::string_view function;
+
+        //
+        // Offset of the pc in the function, or in the library without one.
+        //
+        uint64_t offset = 0;
+    };
+
+    //
+    // Turns pcs of this process into functions.  Libraries are found in
+    // /proc/self/maps, mapped and indexed on their first pc, .symtab
+    // included, so static functions are named, which dladdr() can't do.
+    // Lookups go through a direct mapped cache of pcs, as profiles hit the
+    // same pcs over and over.  Libraries loaded straight from APKs are not
+    // symbolized.  Not thread safe; strings of frames are valid for the
+    // lifetime of the symbolizer.
+    //
+    class Symbolizer final {
+    public:
+        static constexpr size_t CACHE_SIZE = 4096;
+
+        Symbolizer();
+
+        ~Symbolizer();
+
+        Symbolizer(Symbolizer const &) = delete;
+
+        auto operator=(Symbolizer const &) -> Symbolizer & = delete;
+
+        auto symbolize(uintptr_t pc) -> Frame;
+
+        //
+        // Folded stacks of pcs as SamplingProfiler makes them, with the
+        // pcs replaced by functions, or by library+offset.
+        //
+        auto symbolizeFoldedStacks(std::string_view folded) -> std::string;
+
+        auto getCacheHits() const -> uint64_t { return cacheHits_; }
+
+        auto getCacheMisses() const -> uint64_t { return cacheMisses_; }
+
+    private:
+        struct Library;
+
+        struct Mapping {
+
+            uintptr_t start;
+
+            uintptr_t end;
+
+            uint64_t offset;
+
+            Library *library;
+        };
+
+        struct CacheEntry {
+
+            uintptr_t pc = 0;
+
+            Frame frame;
+        };
+
+        auto findMapping(uintptr_t pc) const -> Mapping const *;
+
+        auto loadMappings() -> void;
+
+        auto lookUp(uintptr_t pc) -> Frame;
+
+        std::vector<std::unique_ptr<Library>> libraries_;
+
+        //
+        // Executable mappings of files, sorted by address.
+        //
+        std::vector<Mapping> mappings_;
+
+        std::unique_ptr<CacheEntry[]> cache_;
+
+        uint64_t cacheHits_ = 0;
+
+        uint64_t cacheMisses_ = 0;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_PROFILER_SYMBOLIZER_H_ */
@@ -0,0 +1,66 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstdint>
+#include <gtest/gtest.h>
+
+#include "SamplingProfiler.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// Rate after checks that all measured the overhead, from the requested one.
+//
+auto getRateAfter(uint32_t const checks, uint32_t const requestedRate, uint32_t const overhead, uint32_t const budgetPercent) -> uint32_t {
+    auto rate = requestedRate;
+    for (auto i = 0U; i < checks; i++) {
+        rate = profiler::getAdjustedRate(rate, requestedRate, profiler::SamplingProfiler::MIN_RATE, overhead, budgetPercent);
+    }
+    return rate;
+}
+
+}
+
+TEST(SamplingProfiler, overheadOverBudget_RateIsHalvedDownToTheMinimum) {
+    EXPECT_EQ(getRateAfter(1, 100, 201, 2), 50U);
+    EXPECT_EQ(getRateAfter(3, 100, 201, 2), 12U);
+    EXPECT_EQ(getRateAfter(20, 100, 10000, 2), profiler::SamplingProfiler::MIN_RATE);
+}
+
+TEST(SamplingProfiler, overheadWithinBudget_RateIsKept) {
+    EXPECT_EQ(getRateAfter(5, 100, 200, 2), 100U);
+    EXPECT_EQ(profiler::getAdjustedRate(25, 100, 1, 150, 2), 25U);
+    EXPECT_EQ(profiler::getAdjustedRate(25, 100, 1, 100, 2), 25U);
+}
+
+TEST(SamplingProfiler, overheadWellUnderBudget_RateGoesBackUpToTheRequestedOne) {
+    EXPECT_EQ(profiler::getAdjustedRate(25, 100, 1, 99, 2), 50U);
+    EXPECT_EQ(profiler::getAdjustedRate(75, 100, 1, 0, 2), 100U);
+    auto rate = uint32_t{1};
+    for (auto i = 0; i < 10; i++) {
+        rate = profiler::getAdjustedRate(rate, 100, 1, 0, 2);
+    }
+    EXPECT_EQ(rate, 100U);
+}
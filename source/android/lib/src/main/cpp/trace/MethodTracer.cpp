@@ -0,0 +1,70 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <exception>
+#include <jni.h>
+#include <string>
+
+#include "utils/jni.h"
+#include "utils/log.h"
+#include "TraceConverter.h"
+#include "TraceRecorder.h"
+
+using namespace ai;
+
+extern "C" JNIEXPORT jlong JNICALL Java_com_github_jonforshort_lib_MethodTracer_nativeCreate(JNIEnv *jniEnv, jclass, jstring tracePath) {
+    try {
+        return reinterpret_cast<jlong>(new trace::TraceRecorder(utils::jni::toString(jniEnv, tracePath)));
+    } catch (std::exception const &e) {
+        LOGE("nativeCreate, unable to create trace recorder : %s", e.what());
+        if (auto const exceptionClass = jniEnv->FindClass("java/io/IOException"); exceptionClass != nullptr) {
+            jniEnv->ThrowNew(exceptionClass, e.what());
+        }
+        return 0;
+    }
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_github_jonforshort_lib_MethodTracer_nativeDestroy(JNIEnv *, jclass, jlong recorder) {
+    delete reinterpret_cast<trace::TraceRecorder *>(recorder);
+}
+
+extern "C" JNIEXPORT jint JNICALL Java_com_github_jonforshort_lib_MethodTracer_nativeInternMethod(JNIEnv *jniEnv, jclass, jlong recorder, jstring name) {
+    return static_cast<jint>(reinterpret_cast<trace::TraceRecorder *>(recorder)->internMethod(utils::jni::toString(jniEnv, name)));
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_github_jonforshort_lib_MethodTracer_nativeEnter(JNIEnv *, jclass, jlong recorder, jint methodId) {
+    reinterpret_cast<trace::TraceRecorder *>(recorder)->enter(static_cast<uint32_t>(methodId));
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_github_jonforshort_lib_MethodTracer_nativeExit(JNIEnv *, jclass, jlong recorder, jint methodId) {
+    reinterpret_cast<trace::TraceRecorder *>(recorder)->exit(static_cast<uint32_t>(methodId));
+}
+
+extern "C" JNIEXPORT jstring JNICALL Java_com_github_jonforshort_lib_MethodTracer_nativeGetStats(JNIEnv *jniEnv, jclass, jlong recorder) {
+    return jniEnv->NewStringUTF(reinterpret_cast<trace::TraceRecorder *>(recorder)->getStats().c_str());
+}
+
+extern "C" JNIEXPORT jboolean JNICALL Java_com_github_jonforshort_lib_MethodTracer_nativeConvertToTraceEvents(JNIEnv *jniEnv, jclass, jstring tracePath,
+                                                                                                              jstring jsonPath) {
+    return trace::convertToTraceEvents(utils::jni::toString(jniEnv, tracePath), utils::jni::toString(jniEnv, jsonPath)) ? JNI_TRUE : JNI_FALSE;
+}
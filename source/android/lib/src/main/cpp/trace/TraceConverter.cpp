@@ -0,0 +1,165 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/log.h"
+#include "TraceConverter.h"
+#include "TraceFormat.h"
+
+using namespace ai;
+
+namespace {
+    auto appendJsonString(std::string &json, std::string_view const string) -> void {
+        json += '"';
+        for (auto const c : string) {
+            if (c == '"' || c == '\\') {
+                json += '\\';
+                json += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                json += escaped;
+            } else {
+                json += c;
+            }
+        }
+        json += '"';
+    }
+
+    //
+    // Timestamps in microseconds, nanoseconds kept as decimals.
+    //
+    auto appendTimestamp(std::string &json, uint64_t const timestamp) -> void {
+        char formatted[32];
+        std::snprintf(formatted, sizeof(formatted), "%llu.%03u", static_cast<unsigned long long>(timestamp / 1000), static_cast<unsigned>(timestamp % 1000));
+        json += formatted;
+    }
+
+    auto appendEvent(std::string &json, char const phase, std::string_view const name, uint64_t const pid, uint64_t const tid, uint64_t const timestamp)
+        -> void {
+        json += "{\"ph\":\"";
+        json += phase;
+        json += "\",\"name\":";
+        appendJsonString(json, name);
+        json += ",\"pid\":" + std::to_string(pid) + ",\"tid\":" + std::to_string(tid) + ",\"ts\":";
+        appendTimestamp(json, timestamp);
+        json += "},\n";
+    }
+}
+
+auto trace::convertToTraceEvents(std::span<uint8_t const> const trace, std::string &json) -> bool {
+    if (trace.size() < sizeof(TRACE_MAGIC) + 1 || std::memcmp(trace.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+        trace[sizeof(TRACE_MAGIC)] != TRACE_VERSION) {
+        return false;
+    }
+    auto offset = sizeof(TRACE_MAGIC) + 1;
+    auto const pid = readVarint(trace, offset);
+    if (!pid) {
+        return false;
+    }
+
+    auto methods = std::unordered_map<uint64_t, std::string_view>();
+    auto const getMethodName = [&methods](uint64_t const id) -> std::string_view {
+        auto const method = methods.find(id);
+        return method == methods.end() ? std::string_view("[unknown]") : method->second;
+    };
+    json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    auto chunk = std::string();
+    while (offset < trace.size()) {
+        chunk.clear();
+        auto const tag = static_cast<ChunkTag>(trace[offset++]);
+        auto const id = readVarint(trace, offset);
+        auto const value = readVarint(trace, offset);
+        if (!id || !value) {
+            break;
+        }
+        if (tag == ChunkTag::METHOD || tag == ChunkTag::THREAD) {
+            if (*value > trace.size() - offset) {
+                break;
+            }
+            auto const name = std::string_view(reinterpret_cast<char const *>(trace.data() + offset), *value);
+            offset += *value;
+            if (tag == ChunkTag::METHOD) {
+                methods[*id] = name;
+            } else {
+                chunk += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + std::to_string(*pid) + ",\"tid\":" + std::to_string(*id) +
+                         ",\"args\":{\"name\":";
+                appendJsonString(chunk, name);
+                chunk += "}},\n";
+            }
+        } else if (tag == ChunkTag::EVENTS) {
+            auto timestamp = readVarint(trace, offset);
+            auto isComplete = timestamp.has_value();
+            for (auto i = uint64_t{0}; isComplete && i < *value; i++) {
+                auto const delta = readVarint(trace, offset);
+                auto const event = readVarint(trace, offset);
+                if (!delta || !event) {
+                    isComplete = false;
+                    break;
+                }
+                *timestamp += *delta;
+                auto const type = static_cast<EventType>(*event & 3U);
+                auto const phase = type == EventType::ENTER ? 'B' : type == EventType::EXIT ? 'E' : 'i';
+                appendEvent(chunk, phase, getMethodName(*event >> 2U), *pid, *id, *timestamp);
+            }
+            if (!isComplete) {
+                break;
+            }
+        } else if (tag == ChunkTag::DROPPED) {
+            LOGW("convertToTraceEvents, thread %llu dropped %llu events", static_cast<unsigned long long>(*id), static_cast<unsigned long long>(*value));
+        } else {
+            LOGW("convertToTraceEvents, unknown chunk %u", static_cast<unsigned>(tag));
+            break;
+        }
+        json += chunk;
+    }
+
+    //
+    // No trailing comma before the end of the array.
+    //
+    if (json.ends_with(",\n")) {
+        json.erase(json.size() - 2, 1);
+    }
+    json += "]}\n";
+    return true;
+}
+
+auto trace::convertToTraceEvents(std::string const &tracePath, std::string const &jsonPath) -> bool {
+    auto traceFile = std::ifstream(tracePath, std::ios::in | std::ios::binary);
+    auto const trace = std::vector<uint8_t>(std::istreambuf_iterator<char>(traceFile), std::istreambuf_iterator<char>());
+    auto json = std::string();
+    if (!convertToTraceEvents(trace, json)) {
+        LOGW("convertToTraceEvents, %s is not a trace", tracePath.c_str());
+        return false;
+    }
+    auto jsonFile = std::ofstream(jsonPath, std::ios::out | std::ios::trunc);
+    jsonFile << json;
+    return jsonFile.good();
+}
@@ -0,0 +1,44 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_TRACE_TRACE_CONVERTER_H_
+#define ANDROID_INTROSPECTION_TRACE_TRACE_CONVERTER_H_
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace ai::trace {
+
+    //
+    // Converts a trace of TraceRecorder to the JSON trace event format, which
+    // Perfetto and chrome://tracing open: enters and exits become B and E
+    // events, thread names metadata.  A trace cut short converts up to its
+    // last whole chunk.  Returns false if it isn't a trace.
+    //
+    auto convertToTraceEvents(std::span<uint8_t const> trace, std::string &json) -> bool;
+
+    auto convertToTraceEvents(std::string const &tracePath, std::string const &jsonPath) -> bool;
+}
+
+#endif /* ANDROID_INTROSPECTION_TRACE_TRACE_CONVERTER_H_ */
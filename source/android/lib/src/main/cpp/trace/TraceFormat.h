@@ -0,0 +1,84 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_TRACE_TRACE_FORMAT_H_
+#define ANDROID_INTROSPECTION_TRACE_TRACE_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace ai::trace {
+
+    //
+    // A trace file is the magic and version, the pid as a varint, then
+    // chunks, each a tag byte and its varint fields:
+    //
+    //     METHOD  id, name length, name
+    //     THREAD  tid, name length, name
+    //     EVENTS  tid, count, timestamp of the first, then per event the
+    //             delta from the one before and methodId << 2 | type
+    //     DROPPED tid, count
+    //
+    // Names come before the events that use them and chunks are written
+    // whole, so a trace cut short, or still being written, reads up to its
+    // last chunk.  Timestamps are CLOCK_MONOTONIC nanoseconds.
+    //
+    static constexpr char TRACE_MAGIC[4] = {'A', 'I', 'T', 'R'};
+
+    static constexpr uint8_t TRACE_VERSION = 1;
+
+    enum class ChunkTag : uint8_t { METHOD = 1, THREAD = 2, EVENTS = 3, DROPPED = 4 };
+
+    enum class EventType : uint8_t { ENTER = 0, EXIT = 1, INSTANT = 2 };
+
+    static constexpr size_t MAX_VARINT_SIZE = 10;
+
+    inline auto writeVarint(std::string &out, uint64_t value) -> void {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    //
+    // Reads a varint at offset, moving past it; nothing if the bytes end
+    // before it does.
+    //
+    inline auto readVarint(std::span<uint8_t const> const bytes, size_t &offset) -> std::optional<uint64_t> {
+        auto value = uint64_t{0};
+        for (auto shift = 0U; offset < bytes.size() && shift < 64; shift += 7) {
+            auto const byte = bytes[offset++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+}
+
+#endif /* ANDROID_INTROSPECTION_TRACE_TRACE_FORMAT_H_ */
@@ -0,0 +1,218 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "TraceRecorder.h"
+
+using namespace ai;
+
+namespace {
+    std::atomic<uint64_t> gNextRecorderId{1};
+
+    auto getTimestamp() -> uint64_t {
+        auto time = timespec{};
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<uint64_t>(time.tv_sec) * 1000000000 + static_cast<uint64_t>(time.tv_nsec);
+    }
+
+    auto getThreadName(pid_t const tid) -> std::string {
+        auto file = std::ifstream("/proc/self/task/" + std::to_string(tid) + "/comm");
+        auto name = std::string();
+        std::getline(file, name);
+        return name;
+    }
+
+    auto writeName(std::string &chunks, trace::ChunkTag const tag, uint64_t const id, std::string_view const name) -> void {
+        chunks += static_cast<char>(tag);
+        trace::writeVarint(chunks, id);
+        trace::writeVarint(chunks, name.size());
+        chunks += name;
+    }
+}
+
+//
+// The buffer of the thread for the last recorder it recorded to.  The
+// recorder keeps a reference too, so either may go first.
+//
+struct trace::TraceRecorder::ThreadLocalBuffer {
+
+    uint64_t recorderId = 0;
+
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadLocalBuffer() {
+        if (buffer != nullptr) {
+            buffer->hasExited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+trace::TraceRecorder::TraceRecorder(std::string const &path)
+    : id_(gNextRecorderId.fetch_add(1, std::memory_order_relaxed)), file_(std::fopen(path.c_str(), "wbe")) {
+    if (file_ == nullptr) {
+        throw std::runtime_error("unable to create trace " + path + " : " + strerror(errno));
+    }
+    auto header = std::string(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header += static_cast<char>(TRACE_VERSION);
+    writeVarint(header, static_cast<uint64_t>(getpid()));
+    std::fwrite(header.data(), 1, header.size(), file_);
+    bytesWritten_.store(header.size(), std::memory_order_relaxed);
+    writer_ = std::thread([this] { run(); });
+}
+
+trace::TraceRecorder::~TraceRecorder() {
+    {
+        auto const lock = std::lock_guard(stopMutex_);
+        stopping_ = true;
+    }
+    stopCondition_.notify_one();
+    writer_.join();
+    std::fclose(file_);
+    LOGI("~TraceRecorder, events %" PRIu64 " dropped %" PRIu64 " bytes %" PRIu64, events_.load(), droppedEvents_.load(), bytesWritten_.load());
+}
+
+auto trace::TraceRecorder::internMethod(std::string_view const name) -> uint32_t {
+    auto const lock = std::lock_guard(methodsMutex_);
+    auto const [method, isNew] = methods_.emplace(name, static_cast<uint32_t>(methods_.size()));
+    if (isNew) {
+        writeName(pendingMethods_, ChunkTag::METHOD, method->second, name);
+    }
+    return method->second;
+}
+
+auto trace::TraceRecorder::getThreadBuffer() -> ThreadBuffer & {
+    thread_local auto threadLocalBuffer = ThreadLocalBuffer();
+    if (threadLocalBuffer.recorderId != id_) {
+        if (threadLocalBuffer.buffer != nullptr) {
+            threadLocalBuffer.buffer->hasExited.store(true, std::memory_order_release);
+        }
+        threadLocalBuffer.recorderId = id_;
+        threadLocalBuffer.buffer = std::make_shared<ThreadBuffer>(static_cast<pid_t>(syscall(SYS_gettid)));
+        auto const lock = std::lock_guard(buffersMutex_);
+        buffers_.push_back(threadLocalBuffer.buffer);
+    }
+    return *threadLocalBuffer.buffer;
+}
+
+auto trace::TraceRecorder::record(uint32_t const methodId, EventType const type) -> void {
+    auto &buffer = getThreadBuffer();
+    if (!buffer.events.tryPush(TraceEvent{getTimestamp(), methodId, type})) {
+        buffer.droppedEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+auto trace::TraceRecorder::run() -> void {
+    auto lock = std::unique_lock(stopMutex_);
+    while (!stopping_) {
+        stopCondition_.wait_for(lock, std::chrono::milliseconds(WRITE_INTERVAL));
+        lock.unlock();
+        writeChunks();
+        lock.lock();
+    }
+    lock.unlock();
+    writeChunks();
+}
+
+//
+// Rings are drained before the pending methods are taken: an event drained
+// was recorded after its method was interned, so its name is among them or
+// written already.
+//
+auto trace::TraceRecorder::writeChunks() -> void {
+    auto buffers = std::vector<std::shared_ptr<ThreadBuffer>>();
+    {
+        auto const lock = std::lock_guard(buffersMutex_);
+        buffers = buffers_;
+    }
+    auto events = std::string();
+    for (auto const &buffer : buffers) {
+        writeThread(*buffer, events);
+    }
+    auto chunks = std::string();
+    {
+        auto const lock = std::lock_guard(methodsMutex_);
+        chunks.swap(pendingMethods_);
+    }
+    chunks += events;
+    if (!chunks.empty()) {
+        if (std::fwrite(chunks.data(), 1, chunks.size(), file_) != chunks.size()) {
+            LOGW("writeChunks, unable to write trace : %s", strerror(errno));
+        }
+        std::fflush(file_);
+        bytesWritten_.fetch_add(chunks.size(), std::memory_order_relaxed);
+    }
+
+    auto const lock = std::lock_guard(buffersMutex_);
+    std::erase_if(buffers_, [](auto const &buffer) { return buffer->hasExited.load(std::memory_order_acquire) && buffer->events.size() == 0; });
+}
+
+auto trace::TraceRecorder::writeThread(ThreadBuffer &buffer, std::string &chunks) -> void {
+    auto const hasExited = buffer.hasExited.load(std::memory_order_acquire);
+    drained_.resize(EVENTS_PER_THREAD);
+    drained_.resize(buffer.events.popBatch(std::span(drained_)));
+    auto const dropped = buffer.droppedEvents.exchange(0, std::memory_order_relaxed);
+    if (drained_.empty() && dropped == 0) {
+        return;
+    }
+    if (!buffer.isNamed) {
+        buffer.isNamed = true;
+        if (!hasExited) {
+            writeName(chunks, ChunkTag::THREAD, static_cast<uint64_t>(buffer.tid), getThreadName(buffer.tid));
+        }
+    }
+    if (!drained_.empty()) {
+        chunks += static_cast<char>(ChunkTag::EVENTS);
+        writeVarint(chunks, static_cast<uint64_t>(buffer.tid));
+        writeVarint(chunks, drained_.size());
+        writeVarint(chunks, drained_.front().timestamp);
+        auto previous = drained_.front().timestamp;
+        for (auto const &drainedEvent : drained_) {
+            writeVarint(chunks, drainedEvent.timestamp - previous);
+            writeVarint(chunks, static_cast<uint64_t>(drainedEvent.methodId) << 2U | static_cast<uint64_t>(drainedEvent.type));
+            previous = drainedEvent.timestamp;
+        }
+        events_.fetch_add(drained_.size(), std::memory_order_relaxed);
+    }
+    if (dropped > 0) {
+        chunks += static_cast<char>(ChunkTag::DROPPED);
+        writeVarint(chunks, static_cast<uint64_t>(buffer.tid));
+        writeVarint(chunks, dropped);
+        droppedEvents_.fetch_add(dropped, std::memory_order_relaxed);
+    }
+}
+
+auto trace::TraceRecorder::getStats() const -> std::string {
+    return "trace.events " + std::to_string(events_.load(std::memory_order_relaxed)) + "\n" +
+           "trace.dropped " + std::to_string(droppedEvents_.load(std::memory_order_relaxed)) + "\n" +
+           "trace.bytes " + std::to_string(bytesWritten_.load(std::memory_order_relaxed)) + "\n";
+}
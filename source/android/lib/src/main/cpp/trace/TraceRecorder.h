@@ -0,0 +1,172 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_TRACE_TRACE_RECORDER_H_
+#define ANDROID_INTROSPECTION_TRACE_TRACE_RECORDER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/ring_buffer.h"
+#include "TraceFormat.h"
+
+namespace ai::trace {
+
+    //
+    // Records method enters and exits into a trace file, in the format of
+    // TraceFormat.h.  Methods are interned once into ids; recording an
+    // event then takes a timestamp and a push into a ring of the calling
+    // thread, with no lock and no allocation past the first event of the
+    // thread.  A writer thread drains the rings, encodes the events with
+    // delta timestamps and varints, and appends them to the file.  Events
+    // of a thread whose ring is full are dropped and counted.
+    //
+    class TraceRecorder final {
+    public:
+        static constexpr size_t EVENTS_PER_THREAD = 16384;
+
+        //
+        // How often the writer drains the rings, in milliseconds.
+        //
+        static constexpr uint32_t WRITE_INTERVAL = 20;
+
+        //
+        // Throws std::runtime_error if the file can't be created.
+        //
+        explicit TraceRecorder(std::string const &path);
+
+        //
+        // Writes what is left in the rings and closes the file.
+        //
+        ~TraceRecorder();
+
+        TraceRecorder(TraceRecorder const &) = delete;
+
+        auto operator=(TraceRecorder const &) -> TraceRecorder & = delete;
+
+        //
+        // Id of the method, the same for the same name.
+        //
+        auto internMethod(std::string_view name) -> uint32_t;
+
+        auto record(uint32_t methodId, EventType type) -> void;
+
+        auto enter(uint32_t const methodId) -> void { record(methodId, EventType::ENTER); }
+
+        auto exit(uint32_t const methodId) -> void { record(methodId, EventType::EXIT); }
+
+        //
+        // "name value" lines, like the stats of the VPN.
+        //
+        auto getStats() const -> std::string;
+
+    private:
+        struct TraceEvent {
+
+            uint64_t timestamp = 0;
+
+            uint32_t methodId = 0;
+
+            EventType type = EventType::ENTER;
+        };
+
+        struct ThreadBuffer {
+
+            explicit ThreadBuffer(pid_t tid) : tid(tid), events(EVENTS_PER_THREAD) {}
+
+            pid_t const tid;
+
+            utils::SpscRingBuffer<TraceEvent> events;
+
+            std::atomic<uint64_t> droppedEvents{0};
+
+            //
+            // Set when the thread exits, so the writer drops the buffer once
+            // drained.
+            //
+            std::atomic<bool> hasExited{false};
+
+            bool isNamed = false;
+        };
+
+        struct ThreadLocalBuffer;
+
+        auto getThreadBuffer() -> ThreadBuffer &;
+
+        auto run() -> void;
+
+        auto writeChunks() -> void;
+
+        auto writeThread(ThreadBuffer &buffer, std::string &chunks) -> void;
+
+        //
+        // Tells apart recorders on thread local buffers, even ones at the
+        // address of a deleted one.
+        //
+        uint64_t const id_;
+
+        std::FILE *const file_;
+
+        std::mutex methodsMutex_;
+
+        std::unordered_map<std::string, uint32_t> methods_;
+
+        //
+        // Interned since the last write, as METHOD chunks.
+        //
+        std::string pendingMethods_;
+
+        std::mutex buffersMutex_;
+
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+
+        std::vector<TraceEvent> drained_;
+
+        std::atomic<uint64_t> events_{0};
+
+        std::atomic<uint64_t> droppedEvents_{0};
+
+        std::atomic<uint64_t> bytesWritten_{0};
+
+        std::mutex stopMutex_;
+
+        std::condition_variable stopCondition_;
+
+        bool stopping_ = false;
+
+        std::thread writer_;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_TRACE_TRACE_RECORDER_H_ */
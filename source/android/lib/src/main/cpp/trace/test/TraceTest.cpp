@@ -0,0 +1,183 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <pthread.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "TraceConverter.h"
+#include "TraceFormat.h"
+#include "TraceRecorder.h"
+
+using namespace ai;
+
+namespace {
+
+auto readFile(std::filesystem::path const &path) -> std::vector<uint8_t> {
+    auto file = std::ifstream(path, std::ios::in | std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+auto count(std::string_view const text, std::string_view const pattern) -> size_t {
+    auto occurrences = size_t{0};
+    for (auto offset = text.find(pattern); offset != std::string_view::npos; offset = text.find(pattern, offset + 1)) {
+        occurrences++;
+    }
+    return occurrences;
+}
+
+auto getStat(std::string const &stats, std::string const &name) -> uint64_t {
+    auto const offset = stats.find(name + " ");
+    return offset == std::string::npos ? 0 : std::stoull(stats.substr(offset + name.size() + 1));
+}
+
+//
+// Traces nested calls on two named threads that stay alive until the
+// writer had time to name them.
+//
+auto recordTrace(std::filesystem::path const &path, uint32_t const depth) -> void {
+    auto recorder = trace::TraceRecorder(path.string());
+    auto const outer = recorder.internMethod("Lcom/example/A;->outer()V");
+    auto const inner = recorder.internMethod("Lcom/example/A;->inner(\"x\")V");
+    auto isDone = std::atomic<bool>(false);
+    auto threads = std::vector<std::thread>();
+    for (auto const *name : {"tracer-a", "tracer-b"}) {
+        threads.emplace_back([&, name] {
+            pthread_setname_np(pthread_self(), name);
+            recorder.enter(outer);
+            for (auto i = 0U; i < depth; i++) {
+                recorder.enter(inner);
+            }
+            for (auto i = 0U; i < depth; i++) {
+                recorder.exit(inner);
+            }
+            recorder.exit(outer);
+            while (!isDone.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10 * trace::TraceRecorder::WRITE_INTERVAL));
+    isDone.store(true);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+}
+
+TEST(TraceFormat, varintsOfEveryLength_ReadBackAndStopAtTheEnd) {
+    auto bytes = std::string();
+    auto const values = std::vector<uint64_t>{0, 1, 0x7f, 0x80, 0x3fff, 0x4000, UINT32_MAX, UINT64_MAX};
+    for (auto const value : values) {
+        trace::writeVarint(bytes, value);
+    }
+    auto const span = std::span(reinterpret_cast<uint8_t const *>(bytes.data()), bytes.size());
+    auto offset = size_t{0};
+    for (auto const value : values) {
+        EXPECT_EQ(trace::readVarint(span, offset), value);
+    }
+    EXPECT_EQ(offset, span.size());
+    EXPECT_FALSE(trace::readVarint(span, offset).has_value());
+    offset = 0;
+    EXPECT_FALSE(trace::readVarint(span.last(trace::MAX_VARINT_SIZE).first(trace::MAX_VARINT_SIZE - 1), offset).has_value());
+}
+
+TEST(TraceRecorder, nestedCallsOnTwoThreads_ConvertToBalancedNamedEvents) {
+    auto const path = std::filesystem::temp_directory_path() / "trace_test_nested.trace";
+    recordTrace(path, 10);
+    auto json = std::string();
+    ASSERT_TRUE(trace::convertToTraceEvents(readFile(path), json));
+    EXPECT_EQ(count(json, "\"ph\":\"B\""), 22U);
+    EXPECT_EQ(count(json, "\"ph\":\"E\""), 22U);
+    EXPECT_EQ(count(json, "\"name\":\"Lcom/example/A;->outer()V\""), 4U);
+    EXPECT_EQ(count(json, "\"name\":\"Lcom/example/A;->inner(\\\"x\\\")V\""), 40U);
+    EXPECT_EQ(count(json, "\"args\":{\"name\":\"tracer-a\"}"), 1U);
+    EXPECT_EQ(count(json, "\"args\":{\"name\":\"tracer-b\"}"), 1U);
+    EXPECT_TRUE(json.ends_with("}\n]}\n"));
+    std::filesystem::remove(path);
+}
+
+TEST(TraceRecorder, moreEventsThanTheRingHolds_EveryEventIsWrittenOrCountedAsDropped) {
+    auto const path = std::filesystem::temp_directory_path() / "trace_test_dropped.trace";
+    auto const recorded = uint64_t{8 * trace::TraceRecorder::EVENTS_PER_THREAD};
+    auto events = uint64_t{0};
+    {
+        auto recorder = trace::TraceRecorder(path.string());
+        auto const method = recorder.internMethod("method");
+        for (auto i = uint64_t{0}; i < recorded / 2; i++) {
+            recorder.enter(method);
+            recorder.exit(method);
+        }
+        auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        auto stats = recorder.getStats();
+        while (getStat(stats, "trace.events") + getStat(stats, "trace.dropped") < recorded && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(trace::TraceRecorder::WRITE_INTERVAL));
+            stats = recorder.getStats();
+        }
+        events = getStat(stats, "trace.events");
+        EXPECT_EQ(events + getStat(stats, "trace.dropped"), recorded);
+    }
+    auto json = std::string();
+    ASSERT_TRUE(trace::convertToTraceEvents(readFile(path), json));
+    EXPECT_EQ(count(json, "\"ph\":\"B\"") + count(json, "\"ph\":\"E\""), events);
+    std::filesystem::remove(path);
+}
+
+TEST(TraceConverter, traceCutShort_ConvertsUpToItsLastWholeChunk) {
+    auto const path = std::filesystem::temp_directory_path() / "trace_test_cut.trace";
+    recordTrace(path, 3);
+    auto const trace = readFile(path);
+    auto headerSize = sizeof(trace::TRACE_MAGIC) + 1;
+    ASSERT_TRUE(trace::readVarint(trace, headerSize).has_value());
+    auto previousEvents = size_t{0};
+    for (auto size = size_t{0}; size <= trace.size(); size++) {
+        auto json = std::string();
+        auto const isTrace = trace::convertToTraceEvents(std::span(trace).first(size), json);
+        EXPECT_EQ(isTrace, size >= headerSize) << size;
+        if (!isTrace) {
+            continue;
+        }
+        auto const events = count(json, "\"ph\":");
+        EXPECT_GE(events, previousEvents) << size;
+        EXPECT_TRUE(json.ends_with("]}\n")) << size;
+        EXPECT_EQ(count(json, ",\n]"), 0U) << size;
+        previousEvents = events;
+    }
+    EXPECT_EQ(previousEvents, 2U * 8 + 2);
+    auto json = std::string();
+    auto notTrace = trace;
+    notTrace[0] = 'X';
+    EXPECT_FALSE(trace::convertToTraceEvents(notTrace, json));
+    std::filesystem::remove(path);
+}
@@ -23,11 +23,38 @@
 //
 package com.github.jonforshort.lib
 
+import android.os.ParcelFileDescriptor
+import java.io.Closeable
 import java.io.File
 
-class ApkProcessor(private val apkFile: File) {
+//
+// Processes an APK with the native apk library, reading it through the
+// descriptor in place, e.g. an installed package or a document from a
+// content provider, without a copy into app storage.  The descriptor is
+// closed with the processor.
+//
+class ApkProcessor(private val apk: ParcelFileDescriptor) : Closeable {
 
+    constructor(apkFile: File) : this(ParcelFileDescriptor.open(apkFile, ParcelFileDescriptor.MODE_READ_ONLY))
+
+    //
+    // Writes the processed APK to modifiedApkFile in one pass over the
+    // original, returning whether it succeeded.  Without any modification
+    // asked for nothing is written and this only checks the APK is valid.
+    //
     fun process(modifiedApkFile: File, makeDebuggable: Boolean = true): Boolean {
-        return true
+        return nativeProcess(apk.fd, modifiedApkFile.absolutePath, makeDebuggable)
+    }
+
+    override fun close() {
+        apk.close()
+    }
+
+    private external fun nativeProcess(fd: Int, modifiedApkPath: String, makeDebuggable: Boolean): Boolean
+
+    companion object {
+        init {
+            System.loadLibrary("apkprocessor")
+        }
     }
-}
\ No newline at end of file
+}
@@ -23,6 +23,137 @@
 //
 package com.github.jonforshort.lib
 
-class HookManager {
+import android.content.Context
+import android.os.Process
+import java.io.Closeable
+import java.io.File
 
-}
\ No newline at end of file
+//
+// Runs JavaScript hook scripts in V8.  Isolates start from a snapshot with
+// the hook runtime already loaded, and scripts are compiled from their code
+// caches, both kept in the code cache directory, which is cleared when the
+// app is updated.
+//
+// Scripts run in a pool of isolates, so hooked methods called on several
+// threads at once don't wait on each other; scripts share state through
+// Hooks.post() and Hooks.onMessage() only.
+//
+class HookManager(context: Context) : Closeable {
+
+    private var engine = nativeCreate(
+        File(context.codeCacheDir, "hook-snapshot.bin").absolutePath,
+        File(context.codeCacheDir, "hook-scripts").absolutePath
+    )
+
+    //
+    // Runs the script, returning whether it ran without throwing.  Scripts
+    // register their handlers with Hooks.on(method, handler).
+    //
+    fun loadScript(name: String, source: String): Boolean {
+        return nativeEvaluate(engine, source, name)
+    }
+
+    //
+    // Calls the handlers of the hooked method on an isolate of the calling
+    // thread.  Arguments and result are JSON; null if nothing handled it.
+    //
+    fun dispatch(method: String, argumentsJson: String): String? {
+        return nativeDispatch(engine, method, argumentsJson)
+    }
+
+    //
+    // Same, for a method of a hook table by its slot.
+    //
+    fun dispatch(slot: Int, argumentsJson: String): String? {
+        return nativeDispatchSlot(engine, slot, argumentsJson)
+    }
+
+    //
+    // Installs the hooks of a table written by "--command hook-table" of the
+    // analyzer, with its methods resolved against the app's dex files on the
+    // host.  Classes are loaded with the class loader and their methods
+    // looked up in one batch; the methods take slots in table order after
+    // those of earlier tables, and the slot of the first is returned.
+    // Throws IllegalArgumentException if the table is corrupt.
+    //
+    fun installHookTable(table: ByteArray, classLoader: ClassLoader = HookManager::class.java.classLoader!!): Int {
+        return nativeInstallHookTable(engine, table, classLoader)
+    }
+
+    //
+    // Whether the method in the slot was found in the app when its table was
+    // installed; dispatching to a slot that was not does nothing.
+    //
+    fun isSlotResolved(slot: Int): Boolean {
+        return nativeIsSlotResolved(engine, slot)
+    }
+
+    //
+    // Streams the events scripts emit with Hooks.emit() to a host, batched
+    // and compressed, on an abstract socket the host forwards to with
+    // "adb forward tcp:<port> localabstract:<socketName>".  Throws
+    // IOException if the socket is taken.
+    //
+    fun startEventTransport(socketName: String = "ai-hooks-${Process.myPid()}") {
+        nativeStartEventTransport(engine, socketName)
+    }
+
+    //
+    // "name value" lines of the event transport: events sent and dropped,
+    // batches and bytes.
+    //
+    fun getEventStats(): String {
+        return nativeGetEventStats(engine)
+    }
+
+    //
+    // Messages posted by scripts with Hooks.post() since the last poll, as
+    // JSON.
+    //
+    fun pollMessages(): List<String> {
+        return nativePollMessages(engine).lineSequence().filter { it.isNotEmpty() }.toList()
+    }
+
+    override fun close() {
+        if (engine != 0L) {
+            nativeDestroy(engine)
+            engine = 0L
+        }
+    }
+
+    companion object {
+        init {
+            System.loadLibrary("hooks")
+        }
+
+        @JvmStatic
+        private external fun nativeCreate(snapshotPath: String, codeCacheDirectory: String): Long
+
+        @JvmStatic
+        private external fun nativeDestroy(engine: Long)
+
+        @JvmStatic
+        private external fun nativeEvaluate(engine: Long, source: String, name: String): Boolean
+
+        @JvmStatic
+        private external fun nativeDispatch(engine: Long, method: String, argumentsJson: String): String?
+
+        @JvmStatic
+        private external fun nativeDispatchSlot(engine: Long, slot: Int, argumentsJson: String): String?
+
+        @JvmStatic
+        private external fun nativeInstallHookTable(engine: Long, table: ByteArray, classLoader: ClassLoader): Int
+
+        @JvmStatic
+        private external fun nativeIsSlotResolved(engine: Long, slot: Int): Boolean
+
+        @JvmStatic
+        private external fun nativeStartEventTransport(engine: Long, socketName: String)
+
+        @JvmStatic
+        private external fun nativeGetEventStats(engine: Long): String
+
+        @JvmStatic
+        private external fun nativePollMessages(engine: Long): String
+    }
+}
@@ -0,0 +1,105 @@
+//
+// MIT License
+//
+// Copyright 2019-2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+package com.github.jonforshort.lib
+
+import java.io.Closeable
+import java.io.File
+
+//
+// Records enters and exits of hooked methods into a compact binary trace.
+// Method names are interned once; enter() and exit() then only push an id
+// and a timestamp into a buffer of the calling thread, and a native thread
+// writes the trace as it goes.  Traces convert to JSON trace events, which
+// Perfetto opens.
+//
+class MethodTracer(traceFile: File) : Closeable {
+
+    private var recorder = nativeCreate(traceFile.absolutePath)
+
+    fun internMethod(name: String): Int {
+        return nativeInternMethod(recorder, name)
+    }
+
+    fun enter(methodId: Int) {
+        nativeEnter(recorder, methodId)
+    }
+
+    fun exit(methodId: Int) {
+        nativeExit(recorder, methodId)
+    }
+
+    inline fun <T> trace(methodId: Int, block: () -> T): T {
+        enter(methodId)
+        try {
+            return block()
+        } finally {
+            exit(methodId)
+        }
+    }
+
+    fun getStats(): String {
+        return nativeGetStats(recorder)
+    }
+
+    //
+    // Writes what is still buffered and closes the trace.
+    //
+    override fun close() {
+        if (recorder != 0L) {
+            nativeDestroy(recorder)
+            recorder = 0L
+        }
+    }
+
+    companion object {
+        init {
+            System.loadLibrary("methodtracer")
+        }
+
+        fun convertToTraceEvents(traceFile: File, jsonFile: File): Boolean {
+            return nativeConvertToTraceEvents(traceFile.absolutePath, jsonFile.absolutePath)
+        }
+
+        @JvmStatic
+        private external fun nativeCreate(tracePath: String): Long
+
+        @JvmStatic
+        private external fun nativeDestroy(recorder: Long)
+
+        @JvmStatic
+        private external fun nativeInternMethod(recorder: Long, name: String): Int
+
+        @JvmStatic
+        private external fun nativeEnter(recorder: Long, methodId: Int)
+
+        @JvmStatic
+        private external fun nativeExit(recorder: Long, methodId: Int)
+
+        @JvmStatic
+        private external fun nativeGetStats(recorder: Long): String
+
+        @JvmStatic
+        private external fun nativeConvertToTraceEvents(tracePath: String, jsonPath: String): Boolean
+    }
+}
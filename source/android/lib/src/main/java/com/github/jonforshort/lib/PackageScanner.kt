@@ -0,0 +1,93 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+package com.github.jonforshort.lib
+
+import android.content.Context
+import org.json.JSONObject
+import java.io.File
+
+data class ScannedApk(
+    val packageName: String,
+    val path: String,
+    val properties: Map<String, String>,
+    val error: String?
+)
+
+//
+// Analyzes the base and split APKs of every installed package with the
+// native apk library, on a thread per core.  What was found is kept in an
+// index in the cache directory keyed by path, size and last update time, so
+// a rescan only analyzes the packages installed or updated since.
+//
+class PackageScanner(context: Context) {
+
+    private val packageManager = context.packageManager
+    private val indexFile = File(context.cacheDir, "package-scan.index")
+    private val analysisCacheDir = File(context.cacheDir, "apk-analysis")
+
+    fun scan(): List<ScannedApk> {
+        val packageNames = mutableMapOf<String, String>()
+        val lastUpdateTimes = mutableListOf<Long>()
+        packageManager.getInstalledPackages(0).forEach { packageInfo ->
+            val applicationInfo = packageInfo.applicationInfo ?: return@forEach
+            val apkPaths = listOf(applicationInfo.sourceDir) + (applicationInfo.splitSourceDirs ?: emptyArray())
+            apkPaths.filterNotNull().forEach { apkPath ->
+                if (packageNames.putIfAbsent(apkPath, packageInfo.packageName) == null) {
+                    lastUpdateTimes.add(packageInfo.lastUpdateTime)
+                }
+            }
+        }
+
+        val results = nativeScan(
+            packageNames.keys.toTypedArray(),
+            lastUpdateTimes.toLongArray(),
+            indexFile.absolutePath,
+            analysisCacheDir.absolutePath
+        )
+        return results.lineSequence().filter { it.isNotEmpty() }.map { line ->
+            val result = JSONObject(line)
+            val path = result.getString("path")
+            val properties = result.getJSONObject("properties")
+            ScannedApk(
+                packageName = packageNames[path] ?: "",
+                path = path,
+                properties = properties.keys().asSequence().associateWith { properties.getString(it) },
+                error = if (result.has("error")) result.getString("error") else null
+            )
+        }.toList()
+    }
+
+    private external fun nativeScan(
+        apkPaths: Array<String>,
+        lastUpdateTimes: LongArray,
+        indexPath: String,
+        cacheDirectory: String
+    ): String
+
+    companion object {
+        init {
+            System.loadLibrary("apkprocessor")
+        }
+    }
+}
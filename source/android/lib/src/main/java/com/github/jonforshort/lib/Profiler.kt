@@ -0,0 +1,82 @@
+//
+// MIT License
+//
+// Copyright 2019-2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+package com.github.jonforshort.lib
+
+//
+// CPU profiler of the app it runs in.  Threads are sampled on timers of
+// their own CPU clock and unwound natively; the rate goes down on its own
+// when sampling takes more of the CPU than the budget allows.
+//
+object Profiler {
+
+    init {
+        System.loadLibrary("profiler")
+    }
+
+    //
+    // Returns false if already started.
+    //
+    fun start(rateHz: Int = 100, budgetPercent: Int = 2): Boolean {
+        return nativeStart(rateHz, budgetPercent)
+    }
+
+    fun stop() {
+        nativeStop()
+    }
+
+    //
+    // The profile as folded stacks of native pcs, one "pc;...;pc count"
+    // line per stack, outermost frame first.
+    //
+    fun getFoldedStacks(): String {
+        return nativeGetFoldedStacks()
+    }
+
+    //
+    // The folded stacks with functions in place of pcs, from the symbol
+    // tables of the libraries, local functions included.
+    //
+    fun getSymbolizedStacks(): String {
+        return nativeGetSymbolizedStacks()
+    }
+
+    fun getStats(): String {
+        return nativeGetStats()
+    }
+
+    @JvmStatic
+    private external fun nativeStart(rateHz: Int, budgetPercent: Int): Boolean
+
+    @JvmStatic
+    private external fun nativeStop()
+
+    @JvmStatic
+    private external fun nativeGetFoldedStacks(): String
+
+    @JvmStatic
+    private external fun nativeGetSymbolizedStacks(): String
+
+    @JvmStatic
+    private external fun nativeGetStats(): String
+}
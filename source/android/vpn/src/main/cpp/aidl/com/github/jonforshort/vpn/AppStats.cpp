@@ -0,0 +1,89 @@
+#include "aidl/com/github/jonforshort/vpn/AppStats.h"
+
+#include <android/binder_parcel_utils.h>
+
+namespace aidl {
+namespace com {
+namespace github {
+namespace jonforshort {
+namespace vpn {
+const char* AppStats::descriptor = "com.github.jonforshort.vpn.AppStats";
+
+binder_status_t AppStats::readFromParcel(const AParcel* parcel) {
+  int32_t _aidl_parcelable_size;
+  int32_t _aidl_start_pos = AParcel_getDataPosition(parcel);
+  binder_status_t _aidl_ret_status = AParcel_readInt32(parcel, &_aidl_parcelable_size);
+  if (_aidl_start_pos > INT32_MAX - _aidl_parcelable_size) return STATUS_BAD_VALUE;
+  if (_aidl_parcelable_size < 0) return STATUS_BAD_VALUE;
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  if (AParcel_getDataPosition(parcel) - _aidl_start_pos >= _aidl_parcelable_size) {
+    AParcel_setDataPosition(parcel, _aidl_start_pos + _aidl_parcelable_size);
+    return _aidl_ret_status;
+  }
+  _aidl_ret_status = AParcel_readInt32(parcel, &uid);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  if (AParcel_getDataPosition(parcel) - _aidl_start_pos >= _aidl_parcelable_size) {
+    AParcel_setDataPosition(parcel, _aidl_start_pos + _aidl_parcelable_size);
+    return _aidl_ret_status;
+  }
+  _aidl_ret_status = AParcel_readInt64(parcel, &packetsSent);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  if (AParcel_getDataPosition(parcel) - _aidl_start_pos >= _aidl_parcelable_size) {
+    AParcel_setDataPosition(parcel, _aidl_start_pos + _aidl_parcelable_size);
+    return _aidl_ret_status;
+  }
+  _aidl_ret_status = AParcel_readInt64(parcel, &bytesSent);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  if (AParcel_getDataPosition(parcel) - _aidl_start_pos >= _aidl_parcelable_size) {
+    AParcel_setDataPosition(parcel, _aidl_start_pos + _aidl_parcelable_size);
+    return _aidl_ret_status;
+  }
+  _aidl_ret_status = AParcel_readInt64(parcel, &packetsReceived);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  if (AParcel_getDataPosition(parcel) - _aidl_start_pos >= _aidl_parcelable_size) {
+    AParcel_setDataPosition(parcel, _aidl_start_pos + _aidl_parcelable_size);
+    return _aidl_ret_status;
+  }
+  _aidl_ret_status = AParcel_readInt64(parcel, &bytesReceived);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  AParcel_setDataPosition(parcel, _aidl_start_pos + _aidl_parcelable_size);
+  return _aidl_ret_status;
+}
+binder_status_t AppStats::writeToParcel(AParcel* parcel) const {
+  binder_status_t _aidl_ret_status;
+  size_t _aidl_start_pos = AParcel_getDataPosition(parcel);
+  _aidl_ret_status = AParcel_writeInt32(parcel, 0);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  _aidl_ret_status = AParcel_writeInt32(parcel, uid);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  _aidl_ret_status = AParcel_writeInt64(parcel, packetsSent);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  _aidl_ret_status = AParcel_writeInt64(parcel, bytesSent);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  _aidl_ret_status = AParcel_writeInt64(parcel, packetsReceived);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  _aidl_ret_status = AParcel_writeInt64(parcel, bytesReceived);
+  if (_aidl_ret_status != STATUS_OK) return _aidl_ret_status;
+
+  size_t _aidl_end_pos = AParcel_getDataPosition(parcel);
+  AParcel_setDataPosition(parcel, _aidl_start_pos);
+  AParcel_writeInt32(parcel, _aidl_end_pos - _aidl_start_pos);
+  AParcel_setDataPosition(parcel, _aidl_end_pos);
+  return _aidl_ret_status;
+}
+}  // namespace vpn
+}  // namespace jonforshort
+}  // namespace github
+}  // namespace com
+}  // namespace aidl
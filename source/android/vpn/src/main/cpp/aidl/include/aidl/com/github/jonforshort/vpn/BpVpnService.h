@@ -14,10 +14,21 @@ public:
   BpVpnService(const ::ndk::SpAIBinder& binder);
   virtual ~BpVpnService();
 
-  ::ndk::ScopedAStatus initialize(const ::ndk::SpAIBinder& in_listener, const ::ndk::ScopedFileDescriptor& in_vpnSocket) override;
+  ::ndk::ScopedAStatus initialize(const ::ndk::SpAIBinder& in_listener, const ::ndk::ScopedFileDescriptor& in_vpnSocket, const std::vector<std::string>& in_allowedApplications, const std::vector<std::string>& in_disallowedApplications) override;
   ::ndk::ScopedAStatus start() override;
   ::ndk::ScopedAStatus stop() override;
   ::ndk::ScopedAStatus uninitialize() override;
+  ::ndk::ScopedAStatus getStats(std::string* _aidl_return) override;
+  ::ndk::ScopedAStatus setCaptureDirectory(const std::string& in_directory) override;
+  ::ndk::ScopedAStatus setStatsInterval(int32_t in_intervalMillis) override;
+  ::ndk::ScopedAStatus getPacketSummaries(::ndk::ScopedFileDescriptor* _aidl_return) override;
+  ::ndk::ScopedAStatus setCaptureFilter(const std::string& in_filter, bool* _aidl_return) override;
+  ::ndk::ScopedAStatus setInspectionFilter(const std::string& in_filter, bool* _aidl_return) override;
+  ::ndk::ScopedAStatus setThreadPolicy(int32_t in_policy) override;
+  ::ndk::ScopedAStatus setBatching(int32_t in_maxPackets, int32_t in_maxDelayMicros) override;
+  ::ndk::ScopedAStatus setOverflowPolicy(const std::string& in_queue, int32_t in_policy, bool* _aidl_return) override;
+  ::ndk::ScopedAStatus setFlowLog(const std::string& in_path, int32_t in_intervalMillis) override;
+  ::ndk::ScopedAStatus setInspectionBudget(int32_t in_cpuPercent, int32_t in_fullBytes) override;
 };
 }  // namespace vpn
 }  // namespace jonforshort
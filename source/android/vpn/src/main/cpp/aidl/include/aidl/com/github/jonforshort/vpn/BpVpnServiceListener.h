@@ -16,6 +16,9 @@ public:
 
   ::ndk::ScopedAStatus onSessionCreated(int32_t in_socket) override;
   ::ndk::ScopedAStatus onSessionDestroyed(int32_t in_socket) override;
+  ::ndk::ScopedAStatus getConnectionOwnerUid(int32_t in_protocol, const std::vector<uint8_t>& in_sourceAddress, int32_t in_sourcePort, const std::vector<uint8_t>& in_destinationAddress, int32_t in_destinationPort, int32_t* _aidl_return) override;
+  ::ndk::ScopedAStatus getPackageName(int32_t in_uid, std::string* _aidl_return) override;
+  ::ndk::ScopedAStatus onStats(const ::aidl::com::github::jonforshort::vpn::StatsBatch& in_batch) override;
 };
 }  // namespace vpn
 }  // namespace jonforshort
@@ -0,0 +1,40 @@
+#pragma once
+#include <android/binder_interface_utils.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#ifdef BINDER_STABILITY_SUPPORT
+#include <android/binder_stability.h>
+#endif  // BINDER_STABILITY_SUPPORT
+namespace aidl {
+namespace com {
+namespace github {
+namespace jonforshort {
+namespace vpn {
+class FlowStats {
+public:
+  static const char* descriptor;
+
+  int32_t protocol = 0;
+  std::vector<uint8_t> sourceAddress;
+  int32_t sourcePort = 0;
+  std::vector<uint8_t> destinationAddress;
+  int32_t destinationPort = 0;
+  int32_t uid = 0;
+  int64_t packetsSent = 0L;
+  int64_t bytesSent = 0L;
+  int64_t packetsReceived = 0L;
+  int64_t bytesReceived = 0L;
+
+  binder_status_t readFromParcel(const AParcel* parcel);
+  binder_status_t writeToParcel(AParcel* parcel) const;
+  static const bool _aidl_is_stable = false;
+};
+}  // namespace vpn
+}  // namespace jonforshort
+}  // namespace github
+}  // namespace com
+}  // namespace aidl
@@ -22,6 +22,15 @@ public:
   IVpnService();
   virtual ~IVpnService();
 
+  enum : int32_t { THREAD_POLICY_DEFAULT = 0 };
+  enum : int32_t { THREAD_POLICY_PERFORMANCE = 1 };
+  enum : int32_t { THREAD_POLICY_POWER_SAVE = 2 };
+  enum : int32_t { THREAD_POLICY_ADAPTIVE = 3 };
+  enum : int32_t { OVERFLOW_BLOCK = 0 };
+  enum : int32_t { OVERFLOW_DROP_NEWEST = 1 };
+  enum : int32_t { OVERFLOW_DROP_OLDEST = 2 };
+  enum : int32_t { OVERFLOW_SAMPLE = 3 };
+
 
 
   static std::shared_ptr<IVpnService> fromBinder(const ::ndk::SpAIBinder& binder);
@@ -29,19 +38,41 @@ public:
   static binder_status_t readFromParcel(const AParcel* parcel, std::shared_ptr<IVpnService>* instance);
   static bool setDefaultImpl(std::shared_ptr<IVpnService> impl);
   static const std::shared_ptr<IVpnService>& getDefaultImpl();
-  virtual ::ndk::ScopedAStatus initialize(const ::ndk::SpAIBinder& in_listener, const ::ndk::ScopedFileDescriptor& in_vpnSocket) = 0;
+  virtual ::ndk::ScopedAStatus initialize(const ::ndk::SpAIBinder& in_listener, const ::ndk::ScopedFileDescriptor& in_vpnSocket, const std::vector<std::string>& in_allowedApplications, const std::vector<std::string>& in_disallowedApplications) = 0;
   virtual ::ndk::ScopedAStatus start() = 0;
   virtual ::ndk::ScopedAStatus stop() = 0;
   virtual ::ndk::ScopedAStatus uninitialize() = 0;
+  virtual ::ndk::ScopedAStatus getStats(std::string* _aidl_return) = 0;
+  virtual ::ndk::ScopedAStatus setCaptureDirectory(const std::string& in_directory) = 0;
+  virtual ::ndk::ScopedAStatus setStatsInterval(int32_t in_intervalMillis) = 0;
+  virtual ::ndk::ScopedAStatus getPacketSummaries(::ndk::ScopedFileDescriptor* _aidl_return) = 0;
+  virtual ::ndk::ScopedAStatus setCaptureFilter(const std::string& in_filter, bool* _aidl_return) = 0;
+  virtual ::ndk::ScopedAStatus setInspectionFilter(const std::string& in_filter, bool* _aidl_return) = 0;
+  virtual ::ndk::ScopedAStatus setThreadPolicy(int32_t in_policy) = 0;
+  virtual ::ndk::ScopedAStatus setBatching(int32_t in_maxPackets, int32_t in_maxDelayMicros) = 0;
+  virtual ::ndk::ScopedAStatus setOverflowPolicy(const std::string& in_queue, int32_t in_policy, bool* _aidl_return) = 0;
+  virtual ::ndk::ScopedAStatus setFlowLog(const std::string& in_path, int32_t in_intervalMillis) = 0;
+  virtual ::ndk::ScopedAStatus setInspectionBudget(int32_t in_cpuPercent, int32_t in_fullBytes) = 0;
 private:
   static std::shared_ptr<IVpnService> default_impl;
 };
 class IVpnServiceDefault : public IVpnService {
 public:
-  ::ndk::ScopedAStatus initialize(const ::ndk::SpAIBinder& in_listener, const ::ndk::ScopedFileDescriptor& in_vpnSocket) override;
+  ::ndk::ScopedAStatus initialize(const ::ndk::SpAIBinder& in_listener, const ::ndk::ScopedFileDescriptor& in_vpnSocket, const std::vector<std::string>& in_allowedApplications, const std::vector<std::string>& in_disallowedApplications) override;
   ::ndk::ScopedAStatus start() override;
   ::ndk::ScopedAStatus stop() override;
   ::ndk::ScopedAStatus uninitialize() override;
+  ::ndk::ScopedAStatus getStats(std::string* _aidl_return) override;
+  ::ndk::ScopedAStatus setCaptureDirectory(const std::string& in_directory) override;
+  ::ndk::ScopedAStatus setStatsInterval(int32_t in_intervalMillis) override;
+  ::ndk::ScopedAStatus getPacketSummaries(::ndk::ScopedFileDescriptor* _aidl_return) override;
+  ::ndk::ScopedAStatus setCaptureFilter(const std::string& in_filter, bool* _aidl_return) override;
+  ::ndk::ScopedAStatus setInspectionFilter(const std::string& in_filter, bool* _aidl_return) override;
+  ::ndk::ScopedAStatus setThreadPolicy(int32_t in_policy) override;
+  ::ndk::ScopedAStatus setBatching(int32_t in_maxPackets, int32_t in_maxDelayMicros) override;
+  ::ndk::ScopedAStatus setOverflowPolicy(const std::string& in_queue, int32_t in_policy, bool* _aidl_return) override;
+  ::ndk::ScopedAStatus setFlowLog(const std::string& in_path, int32_t in_intervalMillis) override;
+  ::ndk::ScopedAStatus setInspectionBudget(int32_t in_cpuPercent, int32_t in_fullBytes) override;
   ::ndk::SpAIBinder asBinder() override;
   bool isRemote() override;
 };
@@ -10,6 +10,7 @@
 #ifdef BINDER_STABILITY_SUPPORT
 #include <android/binder_stability.h>
 #endif  // BINDER_STABILITY_SUPPORT
+#include <aidl/com/github/jonforshort/vpn/StatsBatch.h>
 
 namespace aidl {
 namespace com {
@@ -31,6 +32,9 @@ public:
   static const std::shared_ptr<IVpnServiceListener>& getDefaultImpl();
   virtual ::ndk::ScopedAStatus onSessionCreated(int32_t in_socket) = 0;
   virtual ::ndk::ScopedAStatus onSessionDestroyed(int32_t in_socket) = 0;
+  virtual ::ndk::ScopedAStatus getConnectionOwnerUid(int32_t in_protocol, const std::vector<uint8_t>& in_sourceAddress, int32_t in_sourcePort, const std::vector<uint8_t>& in_destinationAddress, int32_t in_destinationPort, int32_t* _aidl_return) = 0;
+  virtual ::ndk::ScopedAStatus getPackageName(int32_t in_uid, std::string* _aidl_return) = 0;
+  virtual ::ndk::ScopedAStatus onStats(const ::aidl::com::github::jonforshort::vpn::StatsBatch& in_batch) = 0;
 private:
   static std::shared_ptr<IVpnServiceListener> default_impl;
 };
@@ -38,6 +42,9 @@ class IVpnServiceListenerDefault : public IVpnServiceListener {
 public:
   ::ndk::ScopedAStatus onSessionCreated(int32_t in_socket) override;
   ::ndk::ScopedAStatus onSessionDestroyed(int32_t in_socket) override;
+  ::ndk::ScopedAStatus getConnectionOwnerUid(int32_t in_protocol, const std::vector<uint8_t>& in_sourceAddress, int32_t in_sourcePort, const std::vector<uint8_t>& in_destinationAddress, int32_t in_destinationPort, int32_t* _aidl_return) override;
+  ::ndk::ScopedAStatus getPackageName(int32_t in_uid, std::string* _aidl_return) override;
+  ::ndk::ScopedAStatus onStats(const ::aidl::com::github::jonforshort::vpn::StatsBatch& in_batch) override;
   ::ndk::SpAIBinder asBinder() override;
   bool isRemote() override;
 };
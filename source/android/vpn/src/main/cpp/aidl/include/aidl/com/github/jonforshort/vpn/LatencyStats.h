@@ -0,0 +1,36 @@
+#pragma once
+#include <android/binder_interface_utils.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#ifdef BINDER_STABILITY_SUPPORT
+#include <android/binder_stability.h>
+#endif  // BINDER_STABILITY_SUPPORT
+namespace aidl {
+namespace com {
+namespace github {
+namespace jonforshort {
+namespace vpn {
+class LatencyStats {
+public:
+  static const char* descriptor;
+
+  std::string stage;
+  int64_t count = 0L;
+  int64_t p50Nanos = 0L;
+  int64_t p90Nanos = 0L;
+  int64_t p99Nanos = 0L;
+  int64_t maxNanos = 0L;
+
+  binder_status_t readFromParcel(const AParcel* parcel);
+  binder_status_t writeToParcel(AParcel* parcel) const;
+  static const bool _aidl_is_stable = false;
+};
+}  // namespace vpn
+}  // namespace jonforshort
+}  // namespace github
+}  // namespace com
+}  // namespace aidl
@@ -0,0 +1,37 @@
+#pragma once
+#include <android/binder_interface_utils.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#ifdef BINDER_STABILITY_SUPPORT
+#include <android/binder_stability.h>
+#endif  // BINDER_STABILITY_SUPPORT
+#include <aidl/com/github/jonforshort/vpn/FlowStats.h>
+#include <aidl/com/github/jonforshort/vpn/AppStats.h>
+#include <aidl/com/github/jonforshort/vpn/LatencyStats.h>
+namespace aidl {
+namespace com {
+namespace github {
+namespace jonforshort {
+namespace vpn {
+class StatsBatch {
+public:
+  static const char* descriptor;
+
+  int64_t intervalMillis = 0L;
+  std::vector<::aidl::com::github::jonforshort::vpn::FlowStats> flows;
+  std::vector<::aidl::com::github::jonforshort::vpn::AppStats> apps;
+  std::vector<::aidl::com::github::jonforshort::vpn::LatencyStats> latencies;
+
+  binder_status_t readFromParcel(const AParcel* parcel);
+  binder_status_t writeToParcel(AParcel* parcel) const;
+  static const bool _aidl_is_stable = false;
+};
+}  // namespace vpn
+}  // namespace jonforshort
+}  // namespace github
+}  // namespace com
+}  // namespace aidl
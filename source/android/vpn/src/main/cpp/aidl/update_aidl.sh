@@ -2,6 +2,9 @@
 
 SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" >/dev/null 2>&1 && pwd )"
 
-aidl --lang=ndk --out=$SCRIPT_DIR --header_out=$SCRIPT_DIR/include \
+aidl --lang=ndk --out=$SCRIPT_DIR --header_out=$SCRIPT_DIR/include -I$SCRIPT_DIR/../../aidl \
      $SCRIPT_DIR/../../aidl/com/github/jonforshort/vpn/IVpnService.aidl \
-     $SCRIPT_DIR/../../aidl/com/github/jonforshort/vpn/IVpnServiceListener.aidl
+     $SCRIPT_DIR/../../aidl/com/github/jonforshort/vpn/IVpnServiceListener.aidl \
+     $SCRIPT_DIR/../../aidl/com/github/jonforshort/vpn/StatsBatch.aidl \
+     $SCRIPT_DIR/../../aidl/com/github/jonforshort/vpn/FlowStats.aidl \
+     $SCRIPT_DIR/../../aidl/com/github/jonforshort/vpn/AppStats.aidl
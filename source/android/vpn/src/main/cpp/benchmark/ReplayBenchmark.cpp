@@ -0,0 +1,348 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <pcap/pcap.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "FlowAttribution.h"
+#include "FlowTable.h"
+#include "PacketFilter.h"
+#include "PacketPool.h"
+#include "FlowLog.h"
+#include "PacketProcessor.h"
+#include "PacketSummaryRing.h"
+#include "StatsReporter.h"
+#include "TimerWheel.h"
+#include "TlsInspector.h"
+
+//
+// Replays pcap files through the packet processing of a worker as fast as
+// it goes: headers, flow table, inspection filter, TLS inspection, packet
+// summaries, attribution and stats, without forwarding anything.  Reports
+// packets per second, nanoseconds and heap allocations per packet for
+// every pass over the packets; the first pass fills the flow table, the
+// ones after find their flows in it.
+//
+// usage: vpn-benchmark [-n passes] [-f filter] [-r interval] [-s] [-l flowlog] file.pcap...
+//   -n passes    passes over the packets, 5 by default
+//   -f filter    inspection filter, a pcap filter expression
+//   -r interval  milliseconds between stats reports, 1000 by default, 0 for none
+//   -s           summarizes packets, as when the UI reads them
+//   -l flowlog   logs the flows to the file once they are dropped at the end
+//
+using namespace ai;
+
+namespace {
+
+    //
+    // Packets handed over together, as the worker queue of the tunnel does.
+    //
+    constexpr size_t BATCH_SIZE = 64;
+
+    constexpr size_t MAX_FLOWS = 100'000;
+
+    constexpr size_t SUMMARY_RING_SIZE = 8192;
+
+    constexpr size_t QUEUE_SIZE = 256;
+
+    constexpr uint64_t TIMER_TICK = 100;
+
+    std::atomic_uint64_t gAllocations{0};
+
+    auto getMonotonicTime() -> uint64_t {
+        auto const now = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    }
+
+    auto isIpEtherType(uint8_t const high, uint8_t const low) -> bool {
+        return (high == 0x08 && low == 0x00) || (high == 0x86 && low == 0xDD);
+    }
+
+    //
+    // AF_INET, or AF_INET6 as BSDs, macOS and Linux number it, of a loopback
+    // header in either byte order.
+    //
+    auto isIpFamily(uint8_t const family) -> bool {
+        return family == 2 || family == 10 || family == 24 || family == 28 || family == 30;
+    }
+
+    //
+    // Bytes before the IP header of a frame of the link type, or -1 if the
+    // frame carries neither IPv4 nor IPv6.
+    //
+    auto getIpOffset(int const linkType, std::span<uint8_t const> const frame) -> ssize_t {
+        switch (linkType) {
+            case DLT_RAW:
+            case DLT_IPV4:
+            case DLT_IPV6:
+                return 0;
+            case DLT_NULL:
+                return frame.size() >= 4 && (isIpFamily(frame[0]) || isIpFamily(frame[3])) ? 4 : -1;
+            case DLT_EN10MB:
+                return frame.size() >= 14 && isIpEtherType(frame[12], frame[13]) ? 14 : -1;
+            case DLT_LINUX_SLL:
+                return frame.size() >= 16 && isIpEtherType(frame[14], frame[15]) ? 16 : -1;
+            default:
+                return -1;
+        }
+    }
+
+    //
+    // Appends the IPv4 and IPv6 packets of the file that fit a packet buffer.
+    //
+    auto loadPackets(char const *const path, std::vector<std::vector<uint8_t>> &packets) -> bool {
+        char error[PCAP_ERRBUF_SIZE] = {};
+        auto *const pcap = pcap_open_offline(path, error);
+        if (pcap == nullptr) {
+            std::fprintf(stderr, "unable to open %s, %s\n", path, error);
+            return false;
+        }
+        auto const linkType = pcap_datalink(pcap);
+        auto skipped = size_t{0};
+        pcap_pkthdr *header = nullptr;
+        u_char const *data = nullptr;
+        while (pcap_next_ex(pcap, &header, &data) == 1) {
+            auto const frame = std::span<uint8_t const>(data, header->caplen);
+            auto const offset = getIpOffset(linkType, frame);
+            if (offset < 0 || frame.size() - static_cast<size_t>(offset) > vpn::PACKET_SIZE || header->caplen != header->len) {
+                skipped++;
+                continue;
+            }
+            auto const packet = frame.subspan(static_cast<size_t>(offset));
+            packets.emplace_back(packet.begin(), packet.end());
+        }
+        pcap_close(pcap);
+        if (skipped > 0) {
+            std::fprintf(stderr, "skipped %zu packets of %s that are not whole IP packets\n", skipped, path);
+        }
+        return true;
+    }
+
+    struct PassResult {
+
+        uint64_t packets = 0;
+
+        uint64_t nanoseconds = 0;
+
+        uint64_t allocations = 0;
+    };
+
+    //
+    // Hands every packet to the processor once, in batches of pool buffers
+    // as they come off the tunnel, with the worker's chores between them.
+    //
+    auto runPass(std::vector<std::vector<uint8_t>> const &packets, vpn::PacketPool &pool, vpn::TimerWheel &timers, vpn::PacketProcessor &processor)
+            -> PassResult {
+        auto batch = std::vector<vpn::PacketBuffer>();
+        batch.reserve(BATCH_SIZE);
+        auto const allocations = gAllocations.load(std::memory_order_relaxed);
+        auto const start = std::chrono::steady_clock::now();
+        for (size_t first = 0; first < packets.size(); first += BATCH_SIZE) {
+            auto const last = std::min(first + BATCH_SIZE, packets.size());
+            for (auto index = first; index < last; index++) {
+                auto &buffer = batch.emplace_back(pool.acquire());
+                std::memcpy(buffer.data(), packets[index].data(), packets[index].size());
+                buffer.setSize(packets[index].size());
+            }
+            processor.setTime(getMonotonicTime());
+            for (auto &buffer : batch) {
+                processor.process(buffer);
+            }
+            batch.clear();
+            processor.applyOwners();
+            processor.reportStats();
+            timers.advance(getMonotonicTime());
+        }
+        auto const elapsed = std::chrono::steady_clock::now() - start;
+        return {packets.size(), static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                gAllocations.load(std::memory_order_relaxed) - allocations};
+    }
+
+    auto printResult(char const *const name, PassResult const &result) -> void {
+        auto const packets = static_cast<double>(std::max<uint64_t>(result.packets, 1));
+        auto const seconds = static_cast<double>(std::max<uint64_t>(result.nanoseconds, 1)) / 1e9;
+        std::printf("%-8s %10llu packets %12.0f packets/s %8.1f ns/packet %8.3f allocations/packet\n", name,
+                    static_cast<unsigned long long>(result.packets), packets / seconds, static_cast<double>(result.nanoseconds) / packets,
+                    static_cast<double>(result.allocations) / packets);
+    }
+
+    auto printUsage() -> void {
+        std::fprintf(stderr, "usage: vpn-benchmark [-n passes] [-f filter] [-r interval] [-s] [-l flowlog] file.pcap...\n");
+    }
+}
+
+//
+// Every allocation of the program is counted, so that those of a pass can
+// be told apart by the count before and after it.
+//
+auto operator new(size_t const size) -> void * {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto *const memory = std::malloc(std::max<size_t>(size, 1))) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+auto operator new[](size_t const size) -> void * {
+    return operator new(size);
+}
+
+auto operator delete(void *const memory) noexcept -> void {
+    std::free(memory);
+}
+
+auto operator delete[](void *const memory) noexcept -> void {
+    std::free(memory);
+}
+
+auto operator delete(void *const memory, size_t) noexcept -> void {
+    std::free(memory);
+}
+
+auto operator delete[](void *const memory, size_t) noexcept -> void {
+    std::free(memory);
+}
+
+auto main(int argc, char *argv[]) -> int {
+    auto passes = 5;
+    auto filter = std::string();
+    auto statsInterval = uint64_t{1000};
+    auto isSummarized = false;
+    auto flowLogPath = std::string();
+    for (auto option = getopt(argc, argv, "n:f:r:sl:"); option != -1; option = getopt(argc, argv, "n:f:r:sl:")) {
+        switch (option) {
+            case 'n':
+                passes = std::max(std::atoi(optarg), 1);
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 'r':
+                statsInterval = std::strtoull(optarg, nullptr, 10);
+                break;
+            case 's':
+                isSummarized = true;
+                break;
+            case 'l':
+                flowLogPath = optarg;
+                break;
+            default:
+                printUsage();
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    auto packets = std::vector<std::vector<uint8_t>>();
+    for (auto index = optind; index < argc; index++) {
+        if (!loadPackets(argv[index], packets)) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (packets.empty()) {
+        std::fprintf(stderr, "no IP packets to replay\n");
+        return EXIT_FAILURE;
+    }
+
+    auto inspectionFilter = vpn::SharedPacketFilter();
+    if (!inspectionFilter.set(filter)) {
+        std::fprintf(stderr, "unable to compile filter [%s]\n", filter.c_str());
+        return EXIT_FAILURE;
+    }
+    auto flowLog = vpn::FlowLog();
+    if (!flowLogPath.empty() && !flowLog.open(flowLogPath, 0)) {
+        std::fprintf(stderr, "unable to open flow log [%s]\n", flowLogPath.c_str());
+        return EXIT_FAILURE;
+    }
+    auto summaries = vpn::PacketSummaryRing(SUMMARY_RING_SIZE);
+    auto const summariesFd = isSummarized ? summaries.share() : -1;
+
+    //
+    // The attributor and reporter run on threads of their own, as in the
+    // pipeline, and signal an eventfd no loop waits on.
+    //
+    auto const stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    auto const wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    auto reports = std::atomic_uint64_t{0};
+    auto attributor = vpn::FlowAttributor({[](vpn::FlowKey const &) { return vpn::UNKNOWN_UID; }, [](int32_t) { return std::string(); }}, {wakeFd},
+                                          QUEUE_SIZE);
+    auto reporter = vpn::StatsReporter([&reports](vpn::StatsReport const &) { reports.fetch_add(1, std::memory_order_relaxed); }, statsInterval,
+                                       {wakeFd}, QUEUE_SIZE);
+    auto attribution = std::thread(&vpn::FlowAttributor::run, &attributor, stopFd);
+    auto reporting = std::thread(&vpn::StatsReporter::run, &reporter, stopFd);
+
+    auto pool = vpn::PacketPool(BATCH_SIZE);
+    auto flowTable = vpn::FlowTable(1, MAX_FLOWS);
+    auto timers = vpn::TimerWheel(TIMER_TICK, getMonotonicTime());
+    auto hostnames = vpn::HostnameTable();
+    auto tlsInspector = vpn::TlsInspector();
+    auto processor = vpn::PacketProcessor(flowTable.shard(0), timers, nullptr, nullptr, nullptr, hostnames, tlsInspector, summaries, inspectionFilter,
+                                          attributor, reporter, flowLog, 0);
+
+    std::printf("replaying %zu packets, %d passes\n", packets.size(), passes);
+    auto steady = PassResult();
+    for (auto pass = 0; pass < passes; pass++) {
+        auto const result = runPass(packets, pool, timers, processor);
+        printResult(("pass " + std::to_string(pass + 1)).c_str(), result);
+        if (pass > 0) {
+            steady.packets += result.packets;
+            steady.nanoseconds += result.nanoseconds;
+            steady.allocations += result.allocations;
+        }
+    }
+    if (passes > 1) {
+        printResult("steady", steady);
+    }
+
+    auto const stop = uint64_t{1};
+    if (write(stopFd, &stop, sizeof(stop)) != sizeof(stop)) {
+        std::fprintf(stderr, "unable to stop, %s\n", std::strerror(errno));
+    }
+    attribution.join();
+    reporting.join();
+    processor.expireFlows();
+    std::printf("%s%s%s%s%sreports %llu\n", vpn::getTrafficStats().c_str(), vpn::getTlsStats().c_str(), vpn::getAttributionStats().c_str(),
+                vpn::getReporterStats().c_str(), flowLog.getStats().c_str(), static_cast<unsigned long long>(reports.load()));
+
+    if (summariesFd >= 0) {
+        close(summariesFd);
+    }
+    close(wakeFd);
+    close(stopFd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "Checksum.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// Sum of RFC 1071 one big-endian word at a time.
+//
+auto sumWordsScalar(std::span<uint8_t const> const bytes) -> uint16_t {
+    auto sum = uint64_t{0};
+    for (size_t i = 0; i < bytes.size(); i += 2) {
+        sum += static_cast<uint64_t>(bytes[i]) << 8U | (i + 1 < bytes.size() ? bytes[i + 1] : 0U);
+    }
+    return vpn::foldSum(sum);
+}
+
+auto getRandomBytes(size_t const size, uint32_t const seed) -> std::vector<uint8_t> {
+    auto generator = std::mt19937(seed);
+    auto bytes = std::vector<uint8_t>(size);
+    for (auto &byte : bytes) {
+        byte = static_cast<uint8_t>(generator());
+    }
+    return bytes;
+}
+
+}
+
+TEST(Checksum, sumWordsOfEverySizeAndOffset_SameAsScalarSum) {
+    auto const bytes = getRandomBytes(300, 1);
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t size = 0; offset + size <= bytes.size(); size++) {
+            auto const span = std::span(bytes).subspan(offset, size);
+            EXPECT_EQ(vpn::sumWords(span), sumWordsScalar(span)) << offset << " " << size;
+        }
+    }
+}
+
+TEST(Checksum, sumWordsOfMoreBlocksThanALaneHolds_SameAsScalarSum) {
+    //
+    // All ones is the largest sum per block, so the lanes overflow first if
+    // they are not moved to 64 bits in time.
+    //
+    auto const ones = std::vector<uint8_t>(3 * 1024 * 1024 + 7, 0xFF);
+    EXPECT_EQ(vpn::sumWords(ones), sumWordsScalar(ones));
+    auto const bytes = getRandomBytes(2 * 1024 * 1024 + 33, 2);
+    EXPECT_EQ(vpn::sumWords(bytes), sumWordsScalar(bytes));
+}
+
+TEST(Checksum, updateAfterRewritingAWord_SameAsSummingAgain) {
+    auto generator = std::mt19937(3);
+    auto bytes = getRandomBytes(64, 4);
+    for (auto i = 0; i < 1000; i++) {
+        auto const offset = generator() % (bytes.size() - 4);
+        auto const sum = vpn::sumWords(bytes);
+        if (i % 2 == 0) {
+            auto const oldWord = static_cast<uint16_t>(bytes[offset] << 8U | bytes[offset + 1]);
+            auto const newWord = static_cast<uint16_t>(generator());
+            bytes[offset] = static_cast<uint8_t>(newWord >> 8U);
+            bytes[offset + 1] = static_cast<uint8_t>(newWord);
+            EXPECT_EQ(vpn::updateSum(sum, oldWord, newWord, offset % 2 != 0), vpn::sumWords(bytes)) << offset;
+        } else {
+            auto oldWord = uint32_t{0};
+            auto const newWord = static_cast<uint32_t>(generator());
+            for (auto byte = 0U; byte < 4; byte++) {
+                oldWord = oldWord << 8U | bytes[offset + byte];
+                bytes[offset + byte] = static_cast<uint8_t>(newWord >> (24U - 8U * byte));
+            }
+            EXPECT_EQ(vpn::updateSum(sum, oldWord, newWord, offset % 2 != 0), vpn::sumWords(bytes)) << offset;
+        }
+    }
+}
+
+TEST(Checksum, updateChecksumAfterRewritingAField_PacketStillSumsToAllOnes) {
+    auto generator = std::mt19937(5);
+    auto packet = getRandomBytes(40, 6);
+    auto const setChecksum = [&packet](uint16_t const checksum) {
+        packet[0] = static_cast<uint8_t>(checksum >> 8U);
+        packet[1] = static_cast<uint8_t>(checksum);
+    };
+    setChecksum(0);
+    setChecksum(static_cast<uint16_t>(~vpn::sumWords(packet)));
+    ASSERT_EQ(vpn::sumWords(packet), 0xFFFF);
+    for (auto i = 0; i < 100; i++) {
+        auto const offset = 2 + 4 * (generator() % 9);
+        auto oldAddress = uint32_t{0};
+        auto const newAddress = static_cast<uint32_t>(generator());
+        for (auto byte = 0U; byte < 4; byte++) {
+            oldAddress = oldAddress << 8U | packet[offset + byte];
+            packet[offset + byte] = static_cast<uint8_t>(newAddress >> (24U - 8U * byte));
+        }
+        auto const oldPort = static_cast<uint16_t>(packet[38] << 8U | packet[39]);
+        auto const newPort = static_cast<uint16_t>(generator());
+        packet[38] = static_cast<uint8_t>(newPort >> 8U);
+        packet[39] = static_cast<uint8_t>(newPort);
+        auto const checksum = static_cast<uint16_t>(packet[0] << 8U | packet[1]);
+        setChecksum(vpn::updateChecksum(vpn::updateChecksum(checksum, oldAddress, newAddress), oldPort, newPort));
+        EXPECT_EQ(vpn::sumWords(packet), 0xFFFF) << i;
+    }
+}
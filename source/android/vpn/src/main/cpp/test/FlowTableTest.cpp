@@ -0,0 +1,125 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+
+#include "FlowTable.h"
+
+using namespace ai;
+
+namespace {
+
+auto makeKey(uint32_t const index) -> vpn::FlowKey {
+    return {vpn::IpAddress::ipv4(0x0A000002), vpn::IpAddress::ipv4(0x08080800 + (index >> 16U)), static_cast<uint16_t>(index), 443, 6};
+}
+
+}
+
+TEST(FlowTableShard, insertUpToCapacity_EveryFlowIsFoundAndTheNextIsRefused) {
+    auto shard = vpn::FlowTableShard(1000);
+    for (uint32_t i = 0; i < 1000; i++) {
+        auto *const flow = shard.findOrInsert(makeKey(i));
+        ASSERT_NE(flow, nullptr) << i;
+        flow->packets = i;
+    }
+    EXPECT_EQ(shard.size(), 1000U);
+    EXPECT_EQ(shard.findOrInsert(makeKey(1000)), nullptr);
+    for (uint32_t i = 0; i < 1000; i++) {
+        auto *const flow = shard.find(makeKey(i));
+        ASSERT_NE(flow, nullptr) << i;
+        EXPECT_EQ(flow->key, makeKey(i));
+        EXPECT_EQ(flow->packets, i);
+        EXPECT_EQ(shard.findOrInsert(makeKey(i)), flow);
+    }
+    EXPECT_EQ(shard.find(makeKey(1000)), nullptr);
+}
+
+TEST(FlowTableShard, eraseAndInsertRepeatedly_FlowsStayFoundAcrossRebuilds) {
+    auto shard = vpn::FlowTableShard(256);
+    auto live = std::set<uint32_t>();
+    auto nextKey = uint32_t{0};
+    for (auto round = 0; round < 20; round++) {
+        while (shard.size() < shard.capacity()) {
+            ASSERT_NE(shard.findOrInsert(makeKey(nextKey)), nullptr);
+            live.insert(nextKey++);
+        }
+        //
+        // Every other flow goes, leaving deleted slots that make later
+        // inserts rebuild the buckets.
+        //
+        auto erased = 0;
+        for (auto it = live.begin(); it != live.end();) {
+            if (erased++ % 2 == 0) {
+                EXPECT_TRUE(shard.erase(makeKey(*it)));
+                EXPECT_FALSE(shard.erase(makeKey(*it)));
+                it = live.erase(it);
+            } else {
+                it++;
+            }
+        }
+        for (auto const key : live) {
+            ASSERT_NE(shard.find(makeKey(key)), nullptr) << key;
+        }
+    }
+    EXPECT_EQ(shard.size(), live.size());
+}
+
+TEST(FlowTableShard, expire_ErasesFlowsIdleSinceTheCutoffOnly) {
+    auto shard = vpn::FlowTableShard(64);
+    for (uint32_t i = 0; i < 64; i++) {
+        shard.findOrInsert(makeKey(i))->lastActive = i;
+    }
+    auto expiredKeys = std::vector<uint16_t>();
+    EXPECT_EQ(shard.expire(40, [&expiredKeys](vpn::Flow const &flow) { expiredKeys.push_back(flow.key.sourcePort); }), 40U);
+    EXPECT_EQ(expiredKeys.size(), 40U);
+    EXPECT_EQ(shard.size(), 24U);
+    EXPECT_EQ(shard.find(makeKey(39)), nullptr);
+    EXPECT_NE(shard.find(makeKey(40)), nullptr);
+
+    auto visited = size_t{0};
+    shard.forEach([&visited](vpn::Flow const &flow) {
+        EXPECT_GE(flow.lastActive, 40U);
+        visited++;
+    });
+    EXPECT_EQ(visited, 24U);
+}
+
+TEST(FlowTable, flowsOfManyKeys_SpreadOverEveryShard) {
+    auto table = vpn::FlowTable(4, 1024);
+    auto perShard = std::vector<size_t>(table.shardCount());
+    for (uint32_t i = 0; i < 2048; i++) {
+        auto const key = makeKey(i);
+        auto const index = table.shardIndex(key);
+        ASSERT_LT(index, table.shardCount());
+        ASSERT_NE(table.shard(index).findOrInsert(key), nullptr);
+        perShard[index]++;
+    }
+    EXPECT_EQ(table.size(), 2048U);
+    for (auto const count : perShard) {
+        EXPECT_GT(count, 2048U / table.shardCount() / 2);
+    }
+}
@@ -0,0 +1,219 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "StreamReassembler.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// Bytes of the headers in front of the payload of the packets below.
+//
+constexpr size_t HEADER_SIZE = 40;
+
+//
+// Byte of the stream at a sequence number, so that any view of it can be
+// checked against where it claims to be.
+//
+auto getStreamByte(uint32_t const sequenceNumber) -> uint8_t {
+    return static_cast<uint8_t>(sequenceNumber * 7 + 3);
+}
+
+struct Segment {
+
+    vpn::PacketBuffer packet;
+
+    std::span<uint8_t const> payload;
+};
+
+auto makeSegment(vpn::PacketPool &pool, uint32_t const sequenceNumber, size_t const size) -> Segment {
+    auto segment = Segment{pool.acquire()};
+    for (size_t i = 0; i < size; i++) {
+        segment.packet.data()[HEADER_SIZE + i] = getStreamByte(sequenceNumber + static_cast<uint32_t>(i));
+    }
+    segment.packet.setSize(HEADER_SIZE + size);
+    segment.payload = std::span<uint8_t const>(segment.packet.data() + HEADER_SIZE, size);
+    return segment;
+}
+
+auto isStreamAt(std::span<uint8_t const> const bytes, uint32_t const sequenceNumber) -> bool {
+    for (size_t i = 0; i < bytes.size(); i++) {
+        if (bytes[i] != getStreamByte(sequenceNumber + static_cast<uint32_t>(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Reads what the reassembler holds from next on, as the forwarder does
+// once the hole before it is filled; next is moved past it.
+//
+auto drain(vpn::StreamReassembler &reassembler, uint32_t &next) -> size_t {
+    auto drained = size_t{0};
+    for (auto bytes = reassembler.peek(next); !bytes.empty(); bytes = reassembler.peek(next)) {
+        EXPECT_TRUE(isStreamAt(bytes, next)) << next;
+        next += static_cast<uint32_t>(bytes.size());
+        drained += bytes.size();
+    }
+    return drained;
+}
+
+}
+
+TEST(StreamReassembler, segmentsOutOfOrder_AreHandedOnInOrderOnceTheHoleIsFilled) {
+    auto pool = vpn::PacketPool(8);
+    auto reassembler = vpn::StreamReassembler();
+    auto next = uint32_t{1000};
+
+    auto third = makeSegment(pool, 1200, 100);
+    auto second = makeSegment(pool, 1100, 100);
+    EXPECT_TRUE(reassembler.hold(third.packet, third.payload, 1200, next, 65535));
+    EXPECT_TRUE(reassembler.hold(second.packet, second.payload, 1100, next, 65535));
+    EXPECT_FALSE(third.packet);
+    EXPECT_FALSE(second.packet);
+    EXPECT_EQ(pool.available(), 6U);
+    EXPECT_TRUE(reassembler.peek(next).empty());
+
+    //
+    // The segment that filled the hole went straight on, as it does in the
+    // forwarder.
+    //
+    next = 1100;
+    EXPECT_EQ(drain(reassembler, next), 200U);
+    EXPECT_EQ(next, 1300U);
+    EXPECT_TRUE(reassembler.isEmpty());
+    EXPECT_EQ(pool.available(), 8U);
+}
+
+TEST(StreamReassembler, overlappingSegments_KeepTheBytesAlreadyHeld) {
+    auto pool = vpn::PacketPool(8);
+    auto reassembler = vpn::StreamReassembler();
+    auto next = uint32_t{1000};
+
+    auto held = makeSegment(pool, 1100, 100);
+    ASSERT_TRUE(reassembler.hold(held.packet, held.payload, 1100, next, 65535));
+
+    //
+    // Inside what is held: nothing new, the packet is left to the caller.
+    //
+    auto inside = makeSegment(pool, 1120, 50);
+    EXPECT_FALSE(reassembler.hold(inside.packet, inside.payload, 1120, next, 65535));
+    EXPECT_TRUE(inside.packet);
+
+    //
+    // Around what is held: only the bytes up to it are, the rest come again.
+    //
+    auto around = makeSegment(pool, 1050, 200);
+    EXPECT_TRUE(reassembler.hold(around.packet, around.payload, 1050, next, 65535));
+
+    //
+    // Overlapping the end of what is held: only the bytes past it are.
+    //
+    auto tail = makeSegment(pool, 1150, 100);
+    EXPECT_TRUE(reassembler.hold(tail.packet, tail.payload, 1150, next, 65535));
+
+    next = 1050;
+    EXPECT_EQ(drain(reassembler, next), 200U);
+    EXPECT_EQ(next, 1250U);
+    EXPECT_TRUE(reassembler.isEmpty());
+}
+
+TEST(StreamReassembler, peekInsideASegment_StartsAtNextAndReleasesThoseBefore) {
+    auto pool = vpn::PacketPool(8);
+    auto reassembler = vpn::StreamReassembler();
+
+    auto first = makeSegment(pool, 100, 100);
+    auto second = makeSegment(pool, 300, 100);
+    ASSERT_TRUE(reassembler.hold(first.packet, first.payload, 100, 50, 65535));
+    ASSERT_TRUE(reassembler.hold(second.packet, second.payload, 300, 50, 65535));
+
+    auto const bytes = reassembler.peek(150);
+    EXPECT_EQ(bytes.size(), 50U);
+    EXPECT_TRUE(isStreamAt(bytes, 150));
+    EXPECT_TRUE(reassembler.peek(250).empty());
+    EXPECT_EQ(pool.available(), 7U);
+
+    auto const rest = reassembler.peek(350);
+    EXPECT_EQ(rest.size(), 50U);
+    EXPECT_TRUE(isStreamAt(rest, 350));
+    reassembler.clear();
+    EXPECT_EQ(pool.available(), 8U);
+}
+
+TEST(StreamReassembler, segmentsOutsideTheWindow_AreLeftToTheCaller) {
+    auto pool = vpn::PacketPool(8);
+    auto reassembler = vpn::StreamReassembler();
+    auto next = uint32_t{1000};
+
+    auto acked = makeSegment(pool, 900, 100);
+    EXPECT_FALSE(reassembler.hold(acked.packet, acked.payload, 900, next, 1000));
+    auto expected = makeSegment(pool, 1000, 100);
+    EXPECT_FALSE(reassembler.hold(expected.packet, expected.payload, 1000, next, 1000));
+    auto beyond = makeSegment(pool, 2000, 100);
+    EXPECT_FALSE(reassembler.hold(beyond.packet, beyond.payload, 2000, next, 1000));
+
+    //
+    // Only what fits in the window is held.
+    //
+    auto straddling = makeSegment(pool, 1950, 100);
+    EXPECT_TRUE(reassembler.hold(straddling.packet, straddling.payload, 1950, next, 1000));
+    next = 1950;
+    EXPECT_EQ(drain(reassembler, next), 50U);
+}
+
+TEST(StreamReassembler, sequenceNumbersWrappingAround_AreOrderedAcrossTheWrap) {
+    auto pool = vpn::PacketPool(8);
+    auto reassembler = vpn::StreamReassembler();
+    auto next = uint32_t{0xFFFFFF00};
+
+    auto afterWrap = makeSegment(pool, 0x40, 0x40);
+    auto beforeWrap = makeSegment(pool, 0xFFFFFFC0, 0x80);
+    EXPECT_TRUE(reassembler.hold(afterWrap.packet, afterWrap.payload, 0x40, next, 65535));
+    EXPECT_TRUE(reassembler.hold(beforeWrap.packet, beforeWrap.payload, 0xFFFFFFC0, next, 65535));
+
+    next = 0xFFFFFFC0;
+    EXPECT_EQ(drain(reassembler, next), 0xC0U);
+    EXPECT_EQ(next, 0x80U);
+}
+
+TEST(StreamReassembler, moreSegmentsThanAStreamHolds_AreDropped) {
+    auto pool = vpn::PacketPool(vpn::StreamReassembler::MAX_SEGMENTS + 1);
+    auto reassembler = vpn::StreamReassembler();
+    for (uint32_t i = 0; i < vpn::StreamReassembler::MAX_SEGMENTS; i++) {
+        auto segment = makeSegment(pool, 100 + i * 20, 10);
+        EXPECT_TRUE(reassembler.hold(segment.packet, segment.payload, 100 + i * 20, 0, 65535));
+    }
+    auto dropped = makeSegment(pool, 10000, 10);
+    EXPECT_FALSE(reassembler.hold(dropped.packet, dropped.payload, 10000, 0, 65535));
+    EXPECT_TRUE(dropped.packet);
+    EXPECT_NE(vpn::getReassemblyStats().find("reassembly.dropped "), std::string::npos);
+}
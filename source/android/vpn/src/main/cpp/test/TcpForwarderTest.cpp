@@ -0,0 +1,476 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "PacketHeaders.h"
+#include "TcpForwarder.h"
+
+using namespace ai;
+
+namespace {
+
+constexpr uint32_t APP_INITIAL_SEQUENCE_NUMBER = 1000;
+
+constexpr uint16_t APP_MSS = 1460;
+
+constexpr uint16_t APP_WINDOW = 65535;
+
+auto getTime() -> uint64_t {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//
+// A segment the forwarder wrote to the tunnel for the app.
+//
+struct AppSegment {
+
+    uint8_t flags = 0;
+
+    uint32_t sequenceNumber = 0;
+
+    uint32_t acknowledgementNumber = 0;
+
+    uint16_t window = 0;
+
+    std::string payload;
+
+    auto hasFlags(uint8_t const expected) const -> bool { return (flags & expected) == expected; }
+};
+
+//
+// Loopback address of a port nothing listens on, taken from a socket that
+// was bound to it and closed.
+//
+auto getUnusedPort() -> uint16_t {
+    auto const fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    auto address = sockaddr_in{AF_INET, 0, {htonl(INADDR_LOOPBACK)}, {}};
+    auto length = static_cast<socklen_t>(sizeof(address));
+    bind(fd, reinterpret_cast<sockaddr const *>(&address), sizeof(address));
+    getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length);
+    close(fd);
+    return ntohs(address.sin_port);
+}
+
+//
+// The forwarder between an app, whose segments are handed to it as the
+// packet loop does and whose segments back are read from the tunnel, and a
+// server listening on loopback, on a loop of its own sockets and timers.
+//
+class Harness final {
+
+    vpn::PacketPool pool_{1024};
+
+    int const wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    vpn::TunnelQueue tunnel_{pool_, 1024, wakeFd_};
+
+    int const epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+
+    vpn::TimerWheel timers_{10, getTime()};
+
+    int openSockets_ = 0;
+
+    vpn::TcpForwarder forwarder_{tunnel_, epollFd_, timers_, [this](int) { openSockets_++; }, [this](int) { openSockets_--; }};
+
+    int listener_ = -1;
+
+    std::array<uint8_t, vpn::PACKET_SIZE> segment_{};
+
+public:
+    vpn::Flow flow;
+
+    //
+    // Next sequence number of the app and of the forwarder as the app saw
+    // it, once the handshake is done.
+    //
+    uint32_t appNext = APP_INITIAL_SEQUENCE_NUMBER;
+
+    uint32_t forwarderNext = 0;
+
+    uint16_t forwarderWindow = 0;
+
+    //
+    // Server on loopback if listening, else a port that refuses connects.
+    //
+    explicit Harness(bool const isListening = true) {
+        auto port = uint16_t{0};
+        if (isListening) {
+            listener_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            auto address = sockaddr_in{AF_INET, 0, {htonl(INADDR_LOOPBACK)}, {}};
+            auto length = static_cast<socklen_t>(sizeof(address));
+            bind(listener_, reinterpret_cast<sockaddr const *>(&address), sizeof(address));
+            listen(listener_, 4);
+            getsockname(listener_, reinterpret_cast<sockaddr *>(&address), &length);
+            port = ntohs(address.sin_port);
+        } else {
+            port = getUnusedPort();
+        }
+        flow.key = {vpn::IpAddress::ipv4(0x0A000002), vpn::IpAddress::ipv4(INADDR_LOOPBACK), 40000, port, 6};
+    }
+
+    Harness(Harness const &) = delete;
+
+    auto operator=(Harness const &) -> Harness & = delete;
+
+    ~Harness() {
+        if (listener_ >= 0) {
+            close(listener_);
+        }
+    }
+
+    auto forwarder() -> vpn::TcpForwarder & { return forwarder_; }
+
+    auto openSockets() const -> int { return openSockets_; }
+
+    auto accept() -> int { return ::accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC); }
+
+    //
+    // Hands a segment of the app to the forwarder, with the MSS option on
+    // SYNs.
+    //
+    auto send(uint8_t const flags, uint32_t const sequenceNumber, uint32_t const acknowledgementNumber, std::string_view const payload = {},
+              uint16_t const window = APP_WINDOW) -> void {
+        auto const isSyn = (flags & vpn::TcpHeader::SYN) != 0;
+        auto const headerSize = vpn::TcpHeader::MIN_SIZE + (isSyn ? 4 : 0);
+        auto const segment = std::span(segment_).first(headerSize + payload.size());
+        std::fill(segment.begin(), segment.end(), 0);
+        vpn::detail::store16(segment, 0, flow.key.sourcePort);
+        vpn::detail::store16(segment, 2, flow.key.destinationPort);
+        vpn::detail::store32(segment, 4, sequenceNumber);
+        vpn::detail::store32(segment, 8, acknowledgementNumber);
+        segment[12] = static_cast<uint8_t>(headerSize / 4 << 4U);
+        segment[13] = flags;
+        vpn::detail::store16(segment, 14, window);
+        if (isSyn) {
+            segment[20] = 2;
+            segment[21] = 4;
+            vpn::detail::store16(segment, 22, APP_MSS);
+        }
+        std::copy(payload.begin(), payload.end(), segment.begin() + static_cast<ptrdiff_t>(headerSize));
+        forwarder_.handleSegment(*vpn::TcpHeader::parse(segment), flow, getTime());
+    }
+
+    //
+    // Acks everything of the forwarder the app took so far.
+    //
+    auto sendAck() -> void { send(vpn::TcpHeader::ACK, appNext, forwarderNext); }
+
+    //
+    // Runs the loop for socket events and timers for up to a wait.
+    //
+    auto poll(int const timeout = 10) -> void {
+        auto events = std::array<epoll_event, 16>();
+        auto const count = epoll_wait(epollFd_, events.data(), static_cast<int>(events.size()), timeout);
+        for (auto i = 0; i < count; i++) {
+            forwarder_.handleSocketEvent(events[static_cast<size_t>(i)].data.u64, events[static_cast<size_t>(i)].events, getTime());
+        }
+        timers_.advance(getTime());
+    }
+
+    //
+    // Segments written to the app since the last call.
+    //
+    auto receive() -> std::vector<AppSegment> {
+        auto segments = std::vector<AppSegment>();
+        auto packets = std::array<vpn::PacketBuffer, 64>();
+        for (auto count = tunnel_.popBatch(packets); count > 0; count = tunnel_.popBatch(packets)) {
+            for (size_t i = 0; i < count; i++) {
+                auto const ipHeader = vpn::IpHeader::parse(std::span<uint8_t const>(packets[i].data(), packets[i].size()));
+                auto const tcpHeader = vpn::TcpHeader::parse(*ipHeader);
+                auto const payload = tcpHeader->payload();
+                segments.push_back({tcpHeader->flags(), tcpHeader->sequenceNumber(), tcpHeader->acknowledgementNumber(), tcpHeader->window(),
+                                    std::string(payload.begin(), payload.end())});
+                packets[i].reset();
+            }
+        }
+        return segments;
+    }
+
+    //
+    // Polls until a segment comes for the app, for up to a second.
+    //
+    auto receiveSome() -> std::vector<AppSegment> {
+        auto segments = receive();
+        for (auto const deadline = getTime() + 1000; segments.empty() && getTime() < deadline; segments = receive()) {
+            poll();
+        }
+        return segments;
+    }
+
+    //
+    // SYN, SYN-ACK and ACK, with the server accepting the connection; the
+    // socket of the server, -1 if there was no SYN-ACK.
+    //
+    auto handshake() -> int {
+        send(vpn::TcpHeader::SYN, APP_INITIAL_SEQUENCE_NUMBER - 1, 0);
+        auto const segments = receiveSome();
+        if (segments.size() != 1 || segments[0].flags != (vpn::TcpHeader::SYN | vpn::TcpHeader::ACK) ||
+            segments[0].acknowledgementNumber != APP_INITIAL_SEQUENCE_NUMBER) {
+            return -1;
+        }
+        forwarderNext = segments[0].sequenceNumber + 1;
+        forwarderWindow = segments[0].window;
+        sendAck();
+        return accept();
+    }
+};
+
+auto makePayload(size_t const size) -> std::string {
+    auto payload = std::string(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+        payload[i] = static_cast<char>('a' + (i * 7 + i / 251) % 26);
+    }
+    return payload;
+}
+
+auto readAll(int const fd, size_t const size) -> std::string {
+    auto bytes = std::string(size, '\0');
+    for (auto offset = size_t{0}; offset < size;) {
+        auto const received = recv(fd, bytes.data() + offset, size - offset, 0);
+        if (received <= 0) {
+            return bytes.substr(0, offset);
+        }
+        offset += static_cast<size_t>(received);
+    }
+    return bytes;
+}
+
+}
+
+TEST(TcpForwarder, synToAListeningServer_IsAnsweredOnceConnected) {
+    auto harness = Harness();
+    harness.send(vpn::TcpHeader::SYN, APP_INITIAL_SEQUENCE_NUMBER - 1, 0);
+    EXPECT_EQ(harness.forwarder().sessionCount(), 1U);
+    EXPECT_EQ(harness.openSockets(), 1);
+
+    auto const segments = harness.receiveSome();
+    ASSERT_EQ(segments.size(), 1U);
+    EXPECT_EQ(segments[0].flags, vpn::TcpHeader::SYN | vpn::TcpHeader::ACK);
+    EXPECT_EQ(segments[0].acknowledgementNumber, APP_INITIAL_SEQUENCE_NUMBER);
+    EXPECT_GT(segments[0].window, 0U);
+
+    //
+    // A SYN sent again is answered again, with the same sequence number.
+    //
+    harness.send(vpn::TcpHeader::SYN, APP_INITIAL_SEQUENCE_NUMBER - 1, 0);
+    auto const again = harness.receive();
+    ASSERT_EQ(again.size(), 1U);
+    EXPECT_EQ(again[0].sequenceNumber, segments[0].sequenceNumber);
+
+    harness.forwarderNext = segments[0].sequenceNumber + 1;
+    harness.sendAck();
+    auto const server = harness.accept();
+    ASSERT_GE(server, 0);
+    EXPECT_TRUE(harness.receive().empty());
+    close(server);
+}
+
+TEST(TcpForwarder, echoOfMoreThanTheWindows_ComesBackWhole) {
+    auto harness = Harness();
+    auto const server = harness.handshake();
+    ASSERT_GE(server, 0);
+
+    auto const payload = makePayload(200 * 1024);
+    auto sent = size_t{0};
+    auto acknowledged = harness.appNext;
+    auto window = uint32_t{harness.forwarderWindow};
+    auto received = std::string();
+    auto echo = std::string();
+    for (auto const deadline = getTime() + 10000; received.size() < payload.size() && getTime() < deadline;) {
+        //
+        // The app sends what the window of the forwarder lets it.
+        //
+        while (sent < payload.size() && harness.appNext - acknowledged < window) {
+            auto const size = std::min({payload.size() - sent, size_t{APP_MSS}, static_cast<size_t>(window - (harness.appNext - acknowledged))});
+            harness.send(vpn::TcpHeader::ACK | vpn::TcpHeader::PSH, harness.appNext, harness.forwarderNext, std::string_view(payload).substr(sent, size));
+            harness.appNext += static_cast<uint32_t>(size);
+            sent += size;
+        }
+        harness.poll(1);
+
+        //
+        // The server sends back whatever it read.
+        //
+        auto buffer = std::array<char, 16 * 1024>();
+        for (auto size = recv(server, buffer.data(), buffer.size(), MSG_DONTWAIT); size > 0; size = recv(server, buffer.data(), buffer.size(), MSG_DONTWAIT)) {
+            echo.append(buffer.data(), static_cast<size_t>(size));
+        }
+        if (!echo.empty()) {
+            auto const size = ::send(server, echo.data(), echo.size(), MSG_DONTWAIT);
+            if (size > 0) {
+                echo.erase(0, static_cast<size_t>(size));
+            }
+        }
+
+        auto const segments = harness.receive();
+        for (auto const &segment : segments) {
+            ASSERT_FALSE(segment.hasFlags(vpn::TcpHeader::RST));
+            if (segment.hasFlags(vpn::TcpHeader::ACK) && static_cast<int32_t>(segment.acknowledgementNumber - acknowledged) >= 0) {
+                acknowledged = segment.acknowledgementNumber;
+                window = segment.window;
+            }
+            if (segment.sequenceNumber == harness.forwarderNext) {
+                received += segment.payload;
+                harness.forwarderNext += static_cast<uint32_t>(segment.payload.size());
+            }
+        }
+        if (!segments.empty()) {
+            harness.sendAck();
+        }
+    }
+    EXPECT_EQ(received.size(), payload.size());
+    EXPECT_TRUE(received == payload);
+    EXPECT_EQ(harness.forwarder().sessionCount(), 1U);
+    close(server);
+}
+
+TEST(TcpForwarder, threeDuplicateAcks_SendTheFirstUnackedSegmentAgain) {
+    auto harness = Harness();
+    auto const server = harness.handshake();
+    ASSERT_GE(server, 0);
+
+    auto const payload = makePayload(3 * APP_MSS);
+    ASSERT_EQ(::send(server, payload.data(), payload.size(), 0), static_cast<ssize_t>(payload.size()));
+    auto segments = std::vector<AppSegment>();
+    auto size = size_t{0};
+    for (auto const deadline = getTime() + 1000; size < payload.size() && getTime() < deadline;) {
+        harness.poll();
+        for (auto &segment : harness.receive()) {
+            size += segment.payload.size();
+            segments.push_back(std::move(segment));
+        }
+    }
+    ASSERT_EQ(size, payload.size());
+    ASSERT_GE(segments.size(), 2U);
+    EXPECT_EQ(segments[0].sequenceNumber, harness.forwarderNext);
+
+    //
+    // The first segment was lost: the app acks what came before it for each
+    // of the others, and once more.
+    //
+    harness.sendAck();
+    harness.sendAck();
+    EXPECT_TRUE(harness.receive().empty());
+    harness.sendAck();
+    auto const retransmitted = harness.receive();
+    ASSERT_FALSE(retransmitted.empty());
+    EXPECT_EQ(retransmitted[0].sequenceNumber, segments[0].sequenceNumber);
+    EXPECT_EQ(retransmitted[0].payload, segments[0].payload);
+
+    harness.forwarderNext += static_cast<uint32_t>(payload.size());
+    harness.sendAck();
+    EXPECT_TRUE(harness.receive().empty());
+    close(server);
+}
+
+TEST(TcpForwarder, finOfBothSides_ClosesTheSessionOnceAcked) {
+    auto harness = Harness();
+    auto const server = harness.handshake();
+    ASSERT_GE(server, 0);
+
+    harness.send(vpn::TcpHeader::ACK | vpn::TcpHeader::PSH | vpn::TcpHeader::FIN, harness.appNext, harness.forwarderNext, "bye");
+    harness.appNext += 4;
+    EXPECT_EQ(readAll(server, 4), "bye");
+    auto const acks = harness.receive();
+    ASSERT_FALSE(acks.empty());
+    EXPECT_EQ(acks.back().acknowledgementNumber, harness.appNext);
+
+    close(server);
+    auto const segments = harness.receiveSome();
+    ASSERT_EQ(segments.size(), 1U);
+    EXPECT_TRUE(segments[0].hasFlags(vpn::TcpHeader::FIN | vpn::TcpHeader::ACK));
+    EXPECT_EQ(harness.forwarder().sessionCount(), 1U);
+
+    harness.forwarderNext = segments[0].sequenceNumber + 1;
+    harness.sendAck();
+    EXPECT_EQ(harness.forwarder().sessionCount(), 0U);
+    EXPECT_EQ(harness.openSockets(), 0);
+    EXPECT_EQ(harness.flow.socket, -1);
+}
+
+TEST(TcpForwarder, resetOfEitherSide_ClosesTheSession) {
+    auto harness = Harness();
+    auto server = harness.handshake();
+    ASSERT_GE(server, 0);
+
+    //
+    // The app resets: the socket is closed without a word to the app.
+    //
+    harness.send(vpn::TcpHeader::RST, harness.appNext, 0);
+    EXPECT_EQ(harness.forwarder().sessionCount(), 0U);
+    EXPECT_EQ(harness.openSockets(), 0);
+    EXPECT_TRUE(harness.receive().empty());
+    EXPECT_EQ(readAll(server, 1), "");
+    close(server);
+
+    //
+    // The server resets: the app is reset.
+    //
+    harness.appNext = APP_INITIAL_SEQUENCE_NUMBER;
+    server = harness.handshake();
+    ASSERT_GE(server, 0);
+    auto const linger = ::linger{1, 0};
+    setsockopt(server, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    close(server);
+    auto const segments = harness.receiveSome();
+    ASSERT_EQ(segments.size(), 1U);
+    EXPECT_TRUE(segments[0].hasFlags(vpn::TcpHeader::RST));
+    EXPECT_EQ(harness.forwarder().sessionCount(), 0U);
+    EXPECT_EQ(harness.openSockets(), 0);
+
+    //
+    // Segments of a session that is gone are reset.
+    //
+    harness.sendAck();
+    auto const reset = harness.receive();
+    ASSERT_EQ(reset.size(), 1U);
+    EXPECT_TRUE(reset[0].hasFlags(vpn::TcpHeader::RST));
+    EXPECT_EQ(reset[0].sequenceNumber, harness.forwarderNext);
+}
+
+TEST(TcpForwarder, synToAPortThatRefuses_IsReset) {
+    auto harness = Harness(false);
+    harness.send(vpn::TcpHeader::SYN, APP_INITIAL_SEQUENCE_NUMBER - 1, 0);
+    auto const segments = harness.receiveSome();
+    ASSERT_EQ(segments.size(), 1U);
+    EXPECT_TRUE(segments[0].hasFlags(vpn::TcpHeader::RST | vpn::TcpHeader::ACK));
+    EXPECT_EQ(segments[0].acknowledgementNumber, APP_INITIAL_SEQUENCE_NUMBER);
+    EXPECT_EQ(harness.forwarder().sessionCount(), 0U);
+    EXPECT_EQ(harness.openSockets(), 0);
+}
@@ -0,0 +1,177 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "TimerWheel.h"
+
+using namespace ai;
+
+namespace {
+
+struct FiredTimer {
+
+    vpn::TimerWheel::Timer timer;
+
+    uint64_t firedAt = 0;
+};
+
+}
+
+TEST(TimerWheel, deadlinesOnEveryWheel_FireOnTheFirstAdvancePastThem) {
+    auto wheel = vpn::TimerWheel(1, 0);
+    //
+    // Each deadline is past the reach of the wheels below its own, so the
+    // timer has to cascade down every wheel in between to fire.
+    //
+    auto const deadlines = std::vector<uint64_t>{0, 5, 63, 64, 100, 4095, 4096, 5000, 262143, 262144, 300000, 16777216, 20000000};
+    auto timers = std::vector<std::unique_ptr<FiredTimer>>();
+    for (auto const deadline : deadlines) {
+        auto &timer = *timers.emplace_back(std::make_unique<FiredTimer>());
+        timer.timer.setOnExpired([&wheel, &timer] { timer.firedAt = wheel.now(); });
+        wheel.schedule(timer.timer, deadline);
+    }
+    EXPECT_EQ(wheel.size(), deadlines.size());
+
+    auto generator = std::mt19937(1);
+    auto now = uint64_t{0};
+    while (wheel.size() > 0 && now <= deadlines.back() + 5000) {
+        now += generator() % 5000;
+        wheel.advance(now);
+        for (size_t i = 0; i < deadlines.size(); i++) {
+            EXPECT_EQ(timers[i]->timer.isScheduled(), deadlines[i] > now) << deadlines[i] << " " << now;
+        }
+    }
+    auto previous = uint64_t{0};
+    for (size_t i = 0; i < deadlines.size(); i++) {
+        EXPECT_GE(timers[i]->firedAt, deadlines[i]);
+        EXPECT_GE(timers[i]->firedAt, previous);
+        previous = timers[i]->firedAt;
+    }
+}
+
+TEST(TimerWheel, randomSchedulesAndCancels_SameAsSortedDeadlines) {
+    auto wheel = vpn::TimerWheel(10, 1000);
+    auto generator = std::mt19937(2);
+    auto timers = std::vector<std::unique_ptr<FiredTimer>>(500);
+    auto deadlines = std::vector<uint64_t>(timers.size(), 0);
+    auto scheduled = std::vector<bool>(timers.size(), false);
+    for (size_t i = 0; i < timers.size(); i++) {
+        timers[i] = std::make_unique<FiredTimer>();
+        timers[i]->timer.setOnExpired([&wheel, &timers, &scheduled, i] {
+            timers[i]->firedAt = wheel.now();
+            scheduled[i] = false;
+        });
+    }
+
+    auto now = uint64_t{1000};
+    for (auto round = 0; round < 2000; round++) {
+        auto const i = generator() % timers.size();
+        if (generator() % 4 == 0) {
+            wheel.cancel(timers[i]->timer);
+            scheduled[i] = false;
+        } else {
+            //
+            // Mostly near deadlines, as retransmits have, and some far ones
+            // that sit in the upper wheels for a while.
+            //
+            deadlines[i] = now + (generator() % 8 == 0 ? generator() % 10000000 : generator() % 3000);
+            wheel.schedule(timers[i]->timer, deadlines[i]);
+            scheduled[i] = true;
+        }
+        now += generator() % 200;
+        wheel.advance(now);
+        for (size_t j = 0; j < timers.size(); j++) {
+            ASSERT_EQ(timers[j]->timer.isScheduled(), scheduled[j]) << j;
+            if (scheduled[j]) {
+                ASSERT_GT(deadlines[j], now);
+            }
+        }
+    }
+    for (auto turns = 0; wheel.size() > 0; turns++) {
+        ASSERT_LT(turns, 10000);
+        auto const timeout = wheel.timeout(now);
+        ASSERT_GE(timeout, 0);
+        now += static_cast<uint64_t>(timeout) + 1;
+        wheel.advance(now);
+    }
+    for (size_t j = 0; j < timers.size(); j++) {
+        EXPECT_FALSE(timers[j]->timer.isScheduled());
+    }
+}
+
+TEST(TimerWheel, timeoutWithATimerInAnUpperWheel_WaitsUntilItMovesDown) {
+    auto wheel = vpn::TimerWheel(1, 0);
+    auto timer = vpn::TimerWheel::Timer();
+    auto fired = 0;
+    timer.setOnExpired([&fired] { fired++; });
+    wheel.schedule(timer, 5000);
+    EXPECT_EQ(wheel.timeout(0), 4096);
+
+    auto now = uint64_t{0};
+    for (auto turns = 0; fired == 0; turns++) {
+        ASSERT_LT(turns, 10);
+        auto const timeout = wheel.timeout(now);
+        ASSERT_GT(timeout, 0);
+        now += static_cast<uint64_t>(timeout);
+        wheel.advance(now);
+    }
+    EXPECT_EQ(now, 5000U);
+    EXPECT_EQ(wheel.timeout(now), -1);
+}
+
+TEST(TimerWheel, callbacksThatScheduleAndCancel_LeaveTheWheelConsistent) {
+    auto wheel = vpn::TimerWheel(1, 0);
+    auto first = vpn::TimerWheel::Timer();
+    auto second = vpn::TimerWheel::Timer();
+    auto repeats = 0;
+    first.setOnExpired([&] {
+        wheel.cancel(second);
+        if (++repeats < 3) {
+            wheel.schedule(first, wheel.now() + 100);
+        }
+    });
+    second.setOnExpired([] { FAIL(); });
+    wheel.schedule(first, 10);
+    wheel.schedule(second, 10);
+    EXPECT_EQ(wheel.advance(10), 1U);
+    EXPECT_EQ(wheel.advance(1000), 1U);
+    EXPECT_EQ(wheel.advance(2000), 1U);
+    EXPECT_EQ(repeats, 3);
+    EXPECT_EQ(wheel.size(), 0U);
+
+    //
+    // A timer destroyed while scheduled takes itself out of the wheel.
+    //
+    {
+        auto transient = vpn::TimerWheel::Timer([] { FAIL(); });
+        wheel.schedule(transient, 3000);
+    }
+    EXPECT_EQ(wheel.size(), 0U);
+    EXPECT_EQ(wheel.advance(4000), 0U);
+}
@@ -4,6 +4,8 @@ include(AndroidNdkModules)
 android_ndk_import_module_cpufeatures()
 
 find_library(log-lib log)
+find_library(android-lib android)
 
 target_link_libraries(utils cpufeatures)
 target_link_libraries(utils ${log-lib})
+target_link_libraries(utils ${android-lib})
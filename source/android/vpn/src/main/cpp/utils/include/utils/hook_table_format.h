@@ -0,0 +1,230 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_UTILS_HOOK_TABLE_FORMAT_H_
+#define ANDROID_INTROSPECTION_VPN_UTILS_HOOK_TABLE_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//
+// The hook table as the analyzer writes it on the host and the hook library
+// of the app reads it, in standard C++ only so that both share one codec.
+// Integers are little-endian, strings are a uint16_t size and their bytes:
+//
+//   "AIHT", version (uint16_t), reserved (uint16_t)
+//   dex file count (uint32_t), then name and checksum (uint32_t) of each
+//   class count (uint32_t), then per class its file, class_def,
+//   descriptor and method count (uint32_t), then per method its index,
+//   access flags, name and signature
+//
+namespace ai::utils {
+
+    inline constexpr uint32_t HOOK_TABLE_MAGIC = 0x54484941;
+
+    inline constexpr uint16_t HOOK_TABLE_VERSION = 1;
+
+    struct HookTableDexFile {
+
+        std::string name;
+
+        //
+        // Adler-32 of the file from its header, naming the build of the APK
+        // the table was resolved against.
+        //
+        uint32_t checksum;
+    };
+
+    struct HookTableMethod {
+
+        uint32_t methodIndex;
+
+        uint32_t accessFlags;
+
+        std::string name;
+
+        //
+        // Signature of the method in the dex file, e.g.
+        // "(Ljava/lang/String;)V", which is also its JNI signature.
+        //
+        std::string signature;
+    };
+
+    struct HookTableClass {
+
+        //
+        // Index into HookTableData::dexFiles and of the class_def in that
+        // file.
+        //
+        uint32_t dexFile;
+
+        uint32_t classDef;
+
+        //
+        // Type descriptor, e.g. "Lorg/fdroid/fdroid/FDroidApp;".
+        //
+        std::string descriptor;
+
+        std::vector<HookTableMethod> methods;
+    };
+
+    struct HookTableData {
+
+        std::vector<HookTableDexFile> dexFiles;
+
+        std::vector<HookTableClass> classes;
+    };
+
+    namespace detail {
+
+        template<typename T>
+        auto appendHookTableValue(std::vector<std::byte> &bytes, T const value) -> void {
+            auto const *const data = reinterpret_cast<std::byte const *>(&value);
+            bytes.insert(bytes.end(), data, data + sizeof(value));
+        }
+
+        inline auto appendHookTableString(std::vector<std::byte> &bytes, std::string const &value) -> void {
+            if (value.size() > std::numeric_limits<uint16_t>::max()) {
+                throw std::length_error("hook table string too long");
+            }
+            appendHookTableValue(bytes, static_cast<uint16_t>(value.size()));
+            auto const *const data = reinterpret_cast<std::byte const *>(value.data());
+            bytes.insert(bytes.end(), data, data + value.size());
+        }
+
+        class HookTableReader final {
+        public:
+            explicit HookTableReader(std::span<std::byte const> const bytes) : bytes_(bytes) {}
+
+            template<typename T>
+            auto read() -> T {
+                require(sizeof(T));
+                auto value = T{0};
+                std::memcpy(&value, bytes_.data() + position_, sizeof(value));
+                position_ += sizeof(value);
+                return value;
+            }
+
+            auto readString() -> std::string {
+                auto const size = read<uint16_t>();
+                require(size);
+                auto value = std::string(reinterpret_cast<char const *>(bytes_.data() + position_), size);
+                position_ += size;
+                return value;
+            }
+
+            auto remaining() const -> size_t { return bytes_.size() - position_; }
+
+        private:
+            auto require(size_t const size) const -> void {
+                if (size > remaining()) {
+                    throw std::runtime_error("truncated hook table");
+                }
+            }
+
+            std::span<std::byte const> bytes_;
+
+            size_t position_ = 0;
+        };
+    }
+
+    //
+    // Throws std::length_error if a string is longer than 65535 bytes.
+    //
+    inline auto encodeHookTable(HookTableData const &table) -> std::vector<std::byte> {
+        using detail::appendHookTableString;
+        using detail::appendHookTableValue;
+        auto encoded = std::vector<std::byte>();
+        appendHookTableValue(encoded, HOOK_TABLE_MAGIC);
+        appendHookTableValue(encoded, HOOK_TABLE_VERSION);
+        appendHookTableValue(encoded, uint16_t{0});
+        appendHookTableValue(encoded, static_cast<uint32_t>(table.dexFiles.size()));
+        for (auto const &dexFile : table.dexFiles) {
+            appendHookTableString(encoded, dexFile.name);
+            appendHookTableValue(encoded, dexFile.checksum);
+        }
+        appendHookTableValue(encoded, static_cast<uint32_t>(table.classes.size()));
+        for (auto const &hookClass : table.classes) {
+            appendHookTableValue(encoded, hookClass.dexFile);
+            appendHookTableValue(encoded, hookClass.classDef);
+            appendHookTableString(encoded, hookClass.descriptor);
+            appendHookTableValue(encoded, static_cast<uint32_t>(hookClass.methods.size()));
+            for (auto const &method : hookClass.methods) {
+                appendHookTableValue(encoded, method.methodIndex);
+                appendHookTableValue(encoded, method.accessFlags);
+                appendHookTableString(encoded, method.name);
+                appendHookTableString(encoded, method.signature);
+            }
+        }
+        return encoded;
+    }
+
+    //
+    // Throws std::runtime_error if the table is corrupt or of another
+    // version.
+    //
+    inline auto decodeHookTable(std::span<std::byte const> const encoded) -> HookTableData {
+        auto reader = detail::HookTableReader(encoded);
+        if (reader.read<uint32_t>() != HOOK_TABLE_MAGIC || reader.read<uint16_t>() != HOOK_TABLE_VERSION) {
+            throw std::runtime_error("unsupported hook table");
+        }
+        reader.read<uint16_t>();
+        auto table = HookTableData();
+        auto const dexFileCount = reader.read<uint32_t>();
+        for (auto file = uint32_t{0}; file < dexFileCount; file++) {
+            auto name = reader.readString();
+            table.dexFiles.push_back({std::move(name), reader.read<uint32_t>()});
+        }
+        auto const classCount = reader.read<uint32_t>();
+        for (auto i = uint32_t{0}; i < classCount; i++) {
+            auto const dexFile = reader.read<uint32_t>();
+            auto const classDef = reader.read<uint32_t>();
+            if (dexFile >= dexFileCount) {
+                throw std::runtime_error("invalid hook table");
+            }
+            auto &hookClass = table.classes.emplace_back(HookTableClass{dexFile, classDef, reader.readString(), {}});
+            if (hookClass.descriptor.size() < 3 || hookClass.descriptor.front() != 'L' || hookClass.descriptor.back() != ';') {
+                throw std::runtime_error("invalid hook table");
+            }
+            auto const methodCount = reader.read<uint32_t>();
+            for (auto j = uint32_t{0}; j < methodCount; j++) {
+                auto const methodIndex = reader.read<uint32_t>();
+                auto const accessFlags = reader.read<uint32_t>();
+                auto name = reader.readString();
+                hookClass.methods.push_back({methodIndex, accessFlags, std::move(name), reader.readString()});
+            }
+        }
+        if (reader.remaining() != 0) {
+            throw std::runtime_error("invalid hook table");
+        }
+        return table;
+    }
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_UTILS_HOOK_TABLE_FORMAT_H_ */
@@ -24,4 +24,213 @@
 #ifndef ANDROID_INTROSPECTION_UTILS_JNI_H_
 #define ANDROID_INTROSPECTION_UTILS_JNI_H_
 
-#endif /* ANDROID_INTROSPECTION_UTILS_JNI_H_ */
\ No newline at end of file
+#include <atomic>
+#include <jni.h>
+#include <utility>
+
+#include "utils/jni_convert.h"
+#include "utils/log.h"
+
+//
+// Helpers for calling into Java from native code.  Classes and methods are
+// looked up once, from JNI_OnLoad, where the class loader of the app is at
+// hand; FindClass() on a thread attached from native code only sees the
+// system classes, and lookups are too slow for callbacks anyway.  Native
+// threads are attached to the VM the first time they need it and stay
+// attached until they exit.
+//
+namespace ai::utils::jni {
+
+    namespace detail {
+
+        inline std::atomic<JavaVM *> gJavaVm{nullptr};
+
+        //
+        // Detaches the thread it belongs to as it exits, if it attached it.
+        //
+        struct ThreadAttachment final {
+
+            JNIEnv *env = nullptr;
+
+            bool isAttached = false;
+
+            ThreadAttachment() = default;
+
+            ThreadAttachment(ThreadAttachment const &) = delete;
+
+            ThreadAttachment &operator=(ThreadAttachment const &) = delete;
+
+            ~ThreadAttachment() {
+                if (auto *const javaVm = gJavaVm.load(std::memory_order_acquire); isAttached && javaVm != nullptr) {
+                    javaVm->DetachCurrentThread();
+                }
+            }
+        };
+
+        inline thread_local ThreadAttachment tAttachment;
+    }
+
+    //
+    // Keeps the VM for native threads to attach to, from JNI_OnLoad.
+    //
+    inline auto setJavaVm(JavaVM *const javaVm) -> void {
+        detail::gJavaVm.store(javaVm, std::memory_order_release);
+    }
+
+    //
+    // Env of the calling thread, which is attached to the VM for the rest of
+    // its life under the name if it was not; nullptr if there is no VM or
+    // the thread could not be attached.
+    //
+    inline auto getEnv(char const *const threadName = nullptr) -> JNIEnv * {
+        auto &attachment = detail::tAttachment;
+        if (attachment.env != nullptr) {
+            return attachment.env;
+        }
+        auto *const javaVm = detail::gJavaVm.load(std::memory_order_acquire);
+        if (javaVm == nullptr) {
+            LOGE("getEnv no java vm, JNI_OnLoad did not set it");
+            return nullptr;
+        }
+        auto *env = static_cast<JNIEnv *>(nullptr);
+        if (auto const status = javaVm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6); status == JNI_OK) {
+            attachment.env = env;
+            return env;
+        } else if (status != JNI_EDETACHED) {
+            LOGE("getEnv unable to get env, %d", status);
+            return nullptr;
+        }
+        auto arguments = JavaVMAttachArgs{JNI_VERSION_1_6, const_cast<char *>(threadName), nullptr};
+        if (javaVm->AttachCurrentThread(&env, &arguments) != JNI_OK) {
+            LOGE("getEnv unable to attach thread %s", threadName != nullptr ? threadName : "");
+            return nullptr;
+        }
+        attachment.env = env;
+        attachment.isAttached = true;
+        return env;
+    }
+
+    //
+    // Logs and clears the exception a call left pending, true if there was
+    // one.  Callbacks from native threads have no Java caller to throw to.
+    //
+    inline auto clearException(JNIEnv *const env, char const *const call) -> bool {
+        if (!env->ExceptionCheck()) {
+            return false;
+        }
+        LOGE("clearException %s threw", call);
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+        return true;
+    }
+
+    //
+    // Global reference to a Java object, deleted along with it from any
+    // thread.
+    //
+    template<typename T = jobject>
+    class GlobalRef final {
+
+        T ref_ = nullptr;
+
+    public:
+        GlobalRef() = default;
+
+        GlobalRef(JNIEnv *const env, T const local) : ref_(local != nullptr ? static_cast<T>(env->NewGlobalRef(local)) : nullptr) {
+        }
+
+        GlobalRef(GlobalRef &&other) noexcept : ref_(std::exchange(other.ref_, nullptr)) {
+        }
+
+        GlobalRef &operator=(GlobalRef &&other) noexcept {
+            if (this != &other) {
+                reset();
+                ref_ = std::exchange(other.ref_, nullptr);
+            }
+            return *this;
+        }
+
+        GlobalRef(GlobalRef const &) = delete;
+
+        GlobalRef &operator=(GlobalRef const &) = delete;
+
+        ~GlobalRef() {
+            reset();
+        }
+
+        auto get() const -> T { return ref_; }
+
+        explicit operator bool() const { return ref_ != nullptr; }
+
+        auto reset() -> void {
+            if (ref_ == nullptr) {
+                return;
+            }
+            if (auto *const env = getEnv(); env != nullptr) {
+                env->DeleteGlobalRef(ref_);
+            }
+            ref_ = nullptr;
+        }
+    };
+
+    //
+    // Frees the local references created in its scope at its end, so that a
+    // callback on a native thread, which never returns to Java, does not
+    // pile them up.
+    //
+    class LocalFrame final {
+
+        JNIEnv *const env_;
+
+        bool const isPushed_;
+
+    public:
+        explicit LocalFrame(JNIEnv *const env, jint const capacity = 16) : env_(env), isPushed_(env->PushLocalFrame(capacity) == JNI_OK) {
+            if (!isPushed_) {
+                clearException(env_, "PushLocalFrame");
+            }
+        }
+
+        LocalFrame(LocalFrame const &) = delete;
+
+        LocalFrame &operator=(LocalFrame const &) = delete;
+
+        ~LocalFrame() {
+            if (isPushed_) {
+                env_->PopLocalFrame(nullptr);
+            }
+        }
+
+        auto isValid() const -> bool { return isPushed_; }
+    };
+
+    //
+    // Class by its binary name, e.g. "android/net/VpnService", held until
+    // the reference goes; empty if it is not found.  From JNI_OnLoad or a
+    // thread of Java.
+    //
+    inline auto findClass(JNIEnv *const env, char const *const name) -> GlobalRef<jclass> {
+        auto const local = env->FindClass(name);
+        if (local == nullptr) {
+            clearException(env, name);
+            return {};
+        }
+        auto global = GlobalRef<jclass>(env, local);
+        env->DeleteLocalRef(local);
+        return global;
+    }
+
+    //
+    // Method of the class, valid for as long as the class is held; nullptr
+    // if it has none of the name and signature.
+    //
+    inline auto getMethod(JNIEnv *const env, jclass const clazz, char const *const name, char const *const signature) -> jmethodID {
+        auto const method = clazz != nullptr ? env->GetMethodID(clazz, name, signature) : nullptr;
+        if (method == nullptr) {
+            clearException(env, name);
+        }
+        return method;
+    }
+}
+
+#endif /* ANDROID_INTROSPECTION_UTILS_JNI_H_ */
@@ -0,0 +1,60 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_JNI_CONVERT_H_
+#define ANDROID_INTROSPECTION_UTILS_JNI_CONVERT_H_
+
+#include <cstddef>
+#include <jni.h>
+#include <string>
+#include <vector>
+
+//
+// Copies of Java values for native code, apart from the rest of utils/jni.h
+// so that libraries logging through another utils/log.h can include them.
+//
+namespace ai::utils::jni {
+
+    //
+    // UTF-8 copy of the string, empty if it is null or cannot be read.
+    //
+    inline auto toString(JNIEnv *const env, jstring const string) -> std::string {
+        auto const *const chars = string != nullptr ? env->GetStringUTFChars(string, nullptr) : nullptr;
+        if (chars == nullptr) {
+            return {};
+        }
+        auto result = std::string(chars);
+        env->ReleaseStringUTFChars(string, chars);
+        return result;
+    }
+
+    inline auto toBytes(JNIEnv *const env, jbyteArray const array) -> std::vector<std::byte> {
+        auto bytes = std::vector<std::byte>(array != nullptr ? static_cast<size_t>(env->GetArrayLength(array)) : 0);
+        if (!bytes.empty()) {
+            env->GetByteArrayRegion(array, 0, static_cast<jsize>(bytes.size()), reinterpret_cast<jbyte *>(bytes.data()));
+        }
+        return bytes;
+    }
+}
+
+#endif /* ANDROID_INTROSPECTION_UTILS_JNI_CONVERT_H_ */
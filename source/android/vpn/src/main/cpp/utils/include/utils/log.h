@@ -26,40 +26,51 @@
 
 #define TAG "AndroidIntrospectionNative"
 
+#if defined(__ANDROID__)
 #include <android/log.h>
 
+#define LOG_PRINT_(priority, ...) __android_log_print(ANDROID_LOG_##priority, TAG, __VA_ARGS__)
+#else
+#include <cstdio>
+
+//
+// Host builds, e.g. of the benchmark, log to stderr.
+//
+#define LOG_PRINT_(priority, format, ...) std::fprintf(stderr, #priority " " TAG ": " format "\n" __VA_OPT__(,) __VA_ARGS__)
+#endif
+
 #if LOG_LEVEL < 1
-#define LOGV(...) __android_log_print(ANDROID_LOG_VERBOSE, TAG, __VA_ARGS__)
+#define LOGV(...) LOG_PRINT_(VERBOSE, __VA_ARGS__)
 #else
 #define LOGV(...)
 #endif
 
 #if LOG_LEVEL < 2
-#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, TAG, __VA_ARGS__)
+#define LOGD(...) LOG_PRINT_(DEBUG, __VA_ARGS__)
 #else
 #define LOGD(...)
 #endif
 
 #if LOG_LEVEL < 3
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, TAG, __VA_ARGS__)
+#define LOGI(...) LOG_PRINT_(INFO, __VA_ARGS__)
 #else
 #define LOGI(...)
 #endif
 
 #if LOG_LEVEL < 4
-#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, TAG, __VA_ARGS__)
+#define LOGW(...) LOG_PRINT_(WARN, __VA_ARGS__)
 #else
 #define LOGW(...)
 #endif
 
 #if LOG_LEVEL < 5
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, TAG, __VA_ARGS__)
+#define LOGE(...) LOG_PRINT_(ERROR, __VA_ARGS__)
 #else
 #define LOGE(...)
 #endif
 
 #if LOG_LEVEL < 6
-#define LOGF(...) __android_log_print(ANDROID_LOG_FATAL, TAG, __VA_ARGS__)
+#define LOGF(...) LOG_PRINT_(FATAL, __VA_ARGS__)
 #else
 #define LOGF(...)
 #endif
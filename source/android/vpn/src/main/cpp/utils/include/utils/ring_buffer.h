@@ -0,0 +1,378 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_UTILS_RING_BUFFER_H_
+#define ANDROID_INTROSPECTION_VPN_UTILS_RING_BUFFER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+
+//
+// Bounded queues between threads without locks, in standard C++ only, so
+// that both the native libraries of the app and the web / host tools can
+// use them.  Capacities are rounded up to a power of two.  Values are moved
+// in and out of default constructed slots; a batch moves up to as many
+// values as fit, or are ready, and returns how many it moved.
+//
+namespace ai::utils {
+
+    namespace detail {
+
+        //
+        // Indices written by different threads live on cache lines of their
+        // own, so that the producer and the consumer do not invalidate each
+        // other's lines on every push and pop.
+        //
+        inline constexpr size_t CACHE_LINE_SIZE = 64;
+    }
+
+    //
+    // Ring between one producer and one consumer thread.  Each side only
+    // reads the index of the other when its cached copy says the ring is
+    // full or empty.
+    //
+    template<typename T>
+    class SpscRingBuffer final {
+
+        std::unique_ptr<T[]> const slots_;
+
+        size_t const mask_;
+
+        //
+        // Next slot to pop, written by the consumer, with its copy of tail_.
+        //
+        alignas(detail::CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+
+        size_t cachedTail_ = 0;
+
+        //
+        // Next slot to push, written by the producer, with its copy of head_.
+        //
+        alignas(detail::CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+
+        size_t cachedHead_ = 0;
+
+    public:
+        explicit SpscRingBuffer(size_t const capacity)
+                : slots_(std::make_unique<T[]>(std::bit_ceil(std::max<size_t>(capacity, 1)))), mask_(std::bit_ceil(std::max<size_t>(capacity, 1)) - 1) {}
+
+        SpscRingBuffer(SpscRingBuffer const &) = delete;
+
+        auto operator=(SpscRingBuffer const &) -> SpscRingBuffer & = delete;
+
+        //
+        // Moves the value in and returns true, or leaves it as it is if the
+        // ring is full.  Producer only.
+        //
+        auto tryPush(T &&value) -> bool {
+            return pushBatch(std::span<T>(&value, 1)) == 1;
+        }
+
+        //
+        // Moves the first values in, published with a single store.
+        // Producer only.
+        //
+        auto pushBatch(std::span<T> const values) -> size_t {
+            auto const tail = tail_.load(std::memory_order_relaxed);
+            if (tail + values.size() - cachedHead_ > capacity()) {
+                cachedHead_ = head_.load(std::memory_order_acquire);
+            }
+            auto const count = std::min(values.size(), capacity() - (tail - cachedHead_));
+            for (size_t index = 0; index < count; index++) {
+                slots_[(tail + index) & mask_] = std::move(values[index]);
+            }
+            if (count > 0) {
+                tail_.store(tail + count, std::memory_order_release);
+            }
+            return count;
+        }
+
+        //
+        // Moves the oldest value out and returns true, or false if the ring
+        // is empty.  Consumer only.
+        //
+        auto tryPop(T &value) -> bool {
+            return popBatch(std::span<T>(&value, 1)) == 1;
+        }
+
+        //
+        // Moves the oldest values out into the first values, released to the
+        // producer with a single store.  Consumer only.
+        //
+        auto popBatch(std::span<T> const values) -> size_t {
+            auto const head = head_.load(std::memory_order_relaxed);
+            if (cachedTail_ - head < values.size()) {
+                cachedTail_ = tail_.load(std::memory_order_acquire);
+            }
+            auto const count = std::min(values.size(), cachedTail_ - head);
+            for (size_t index = 0; index < count; index++) {
+                values[index] = std::move(slots_[(head + index) & mask_]);
+            }
+            if (count > 0) {
+                head_.store(head + count, std::memory_order_release);
+            }
+            return count;
+        }
+
+        auto capacity() const -> size_t { return mask_ + 1; }
+
+        //
+        // Values in the ring, as of some point during the call.  Any thread.
+        //
+        auto size() const -> size_t {
+            auto const head = head_.load(std::memory_order_relaxed);
+            auto const tail = tail_.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+    };
+
+    //
+    // Ring between any number of producer threads and one consumer thread.
+    // Producers claim slots by moving the tail forward and publish each one
+    // through its sequence number once the value is in, so the consumer only
+    // sees values past the slots that are still being written once those
+    // are done.
+    //
+    template<typename T>
+    class MpscRingBuffer final {
+
+        struct Slot {
+
+            //
+            // Position + 1 once the value pushed at position is in.
+            //
+            std::atomic<size_t> sequence{0};
+
+            T value{};
+        };
+
+        std::unique_ptr<Slot[]> const slots_;
+
+        size_t const mask_;
+
+        //
+        // Next slot to pop, written by the consumer.
+        //
+        alignas(detail::CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+
+        //
+        // Next slot to claim, moved forward by the producers.
+        //
+        alignas(detail::CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+
+    public:
+        explicit MpscRingBuffer(size_t const capacity)
+                : slots_(std::make_unique<Slot[]>(std::bit_ceil(std::max<size_t>(capacity, 1)))), mask_(std::bit_ceil(std::max<size_t>(capacity, 1)) - 1) {}
+
+        MpscRingBuffer(MpscRingBuffer const &) = delete;
+
+        auto operator=(MpscRingBuffer const &) -> MpscRingBuffer & = delete;
+
+        auto tryPush(T &&value) -> bool {
+            return pushBatch(std::span<T>(&value, 1)) == 1;
+        }
+
+        //
+        // Claims consecutive slots for the first values with one exchange of
+        // the tail.  Any thread.
+        //
+        auto pushBatch(std::span<T> const values) -> size_t {
+            auto tail = tail_.load(std::memory_order_relaxed);
+            auto count = size_t{0};
+            do {
+                auto const head = head_.load(std::memory_order_acquire);
+                count = std::min(values.size(), capacity() - (tail - head));
+                if (count == 0) {
+                    return 0;
+                }
+            } while (!tail_.compare_exchange_weak(tail, tail + count, std::memory_order_relaxed));
+            for (size_t index = 0; index < count; index++) {
+                auto &slot = slots_[(tail + index) & mask_];
+                slot.value = std::move(values[index]);
+                slot.sequence.store(tail + index + 1, std::memory_order_release);
+            }
+            return count;
+        }
+
+        //
+        // Consumer only; false while the oldest slot is still being written.
+        //
+        auto tryPop(T &value) -> bool {
+            return popBatch(std::span<T>(&value, 1)) == 1;
+        }
+
+        //
+        // Moves out the oldest values that are in, up to the first slot that
+        // is still being written.  Consumer only.
+        //
+        auto popBatch(std::span<T> const values) -> size_t {
+            auto const head = head_.load(std::memory_order_relaxed);
+            auto count = size_t{0};
+            while (count < values.size()) {
+                auto &slot = slots_[(head + count) & mask_];
+                if (slot.sequence.load(std::memory_order_acquire) != head + count + 1) {
+                    break;
+                }
+                values[count++] = std::move(slot.value);
+            }
+            if (count > 0) {
+                head_.store(head + count, std::memory_order_release);
+            }
+            return count;
+        }
+
+        auto capacity() const -> size_t { return mask_ + 1; }
+
+        //
+        // Values in the ring or being pushed, as of some point during the
+        // call.  Any thread.
+        //
+        auto size() const -> size_t {
+            auto const head = head_.load(std::memory_order_relaxed);
+            auto const tail = tail_.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+    };
+
+    //
+    // Ring between any number of producer and consumer threads, e.g. for a
+    // producer to pop the oldest value to make room for its own.  Each slot
+    // goes through a sequence number per lap: the position it is pushed at
+    // while it is free, position + 1 once its value is in, and the position
+    // of the next lap once it is popped, so that producers and consumers
+    // only ever contend on their own index.
+    //
+    template<typename T>
+    class MpmcRingBuffer final {
+
+        struct Slot {
+
+            std::atomic<size_t> sequence{0};
+
+            T value{};
+        };
+
+        std::unique_ptr<Slot[]> const slots_;
+
+        size_t const mask_;
+
+        //
+        // Next slot to pop, moved forward by the consumers.
+        //
+        alignas(detail::CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+
+        //
+        // Next slot to push, moved forward by the producers.
+        //
+        alignas(detail::CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+
+    public:
+        explicit MpmcRingBuffer(size_t const capacity)
+                : slots_(std::make_unique<Slot[]>(std::bit_ceil(std::max<size_t>(capacity, 1)))), mask_(std::bit_ceil(std::max<size_t>(capacity, 1)) - 1) {
+            for (size_t index = 0; index <= mask_; index++) {
+                slots_[index].sequence.store(index, std::memory_order_relaxed);
+            }
+        }
+
+        MpmcRingBuffer(MpmcRingBuffer const &) = delete;
+
+        auto operator=(MpmcRingBuffer const &) -> MpmcRingBuffer & = delete;
+
+        //
+        // Moves the value in and returns true, or leaves it as it is if the
+        // ring is full.  Any thread.
+        //
+        auto tryPush(T &&value) -> bool {
+            auto tail = tail_.load(std::memory_order_relaxed);
+            while (true) {
+                auto &slot = slots_[tail & mask_];
+                auto const lag = static_cast<std::ptrdiff_t>(slot.sequence.load(std::memory_order_acquire) - tail);
+                if (lag == 0) {
+                    if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                        slot.value = std::move(value);
+                        slot.sequence.store(tail + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (lag < 0) {
+                    return false;
+                } else {
+                    tail = tail_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        auto pushBatch(std::span<T> const values) -> size_t {
+            auto count = size_t{0};
+            while (count < values.size() && tryPush(std::move(values[count]))) {
+                count++;
+            }
+            return count;
+        }
+
+        //
+        // Moves the oldest value out and returns true, or false if the ring
+        // is empty or its oldest slot is still being written.  Any thread.
+        //
+        auto tryPop(T &value) -> bool {
+            auto head = head_.load(std::memory_order_relaxed);
+            while (true) {
+                auto &slot = slots_[head & mask_];
+                auto const lag = static_cast<std::ptrdiff_t>(slot.sequence.load(std::memory_order_acquire) - (head + 1));
+                if (lag == 0) {
+                    if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                        value = std::move(slot.value);
+                        slot.sequence.store(head + capacity(), std::memory_order_release);
+                        return true;
+                    }
+                } else if (lag < 0) {
+                    return false;
+                } else {
+                    head = head_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        auto popBatch(std::span<T> const values) -> size_t {
+            auto count = size_t{0};
+            while (count < values.size() && tryPop(values[count])) {
+                count++;
+            }
+            return count;
+        }
+
+        auto capacity() const -> size_t { return mask_ + 1; }
+
+        auto size() const -> size_t {
+            auto const head = head_.load(std::memory_order_relaxed);
+            auto const tail = tail_.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_UTILS_RING_BUFFER_H_ */
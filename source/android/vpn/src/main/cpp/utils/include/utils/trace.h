@@ -0,0 +1,72 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_UTILS_TRACE_H_
+#define ANDROID_INTROSPECTION_VPN_UTILS_TRACE_H_
+
+#if defined(__ANDROID__)
+#include <android/trace.h>
+#endif
+
+namespace ai::utils::trace {
+
+    //
+    // Times the scope it lives in as a section of the systrace / Perfetto
+    // trace of the app.  Costs one check while the app is not being traced,
+    // and nothing in host builds, which have no trace.
+    //
+    class Span final {
+#if defined(__ANDROID__)
+        bool const enabled_;
+
+    public:
+        explicit Span(char const *const name) : enabled_(ATrace_isEnabled()) {
+            if (enabled_) {
+                ATrace_beginSection(name);
+            }
+        }
+
+        ~Span() {
+            if (enabled_) {
+                ATrace_endSection();
+            }
+        }
+#else
+    public:
+        explicit Span(char const *const) {
+        }
+#endif
+
+        Span(Span const &) = delete;
+
+        Span &operator=(Span const &) = delete;
+    };
+}
+
+#define TRACE_SPAN_CONCAT_(a, b) a##b
+
+#define TRACE_SPAN_VARIABLE_(line) TRACE_SPAN_CONCAT_(traceSpan, line)
+
+#define TRACE_SPAN(name) ai::utils::trace::Span const TRACE_SPAN_VARIABLE_(__LINE__)(name)
+
+#endif /* ANDROID_INTROSPECTION_VPN_UTILS_TRACE_H_ */
@@ -0,0 +1,89 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#include "ByteRing.h"
+
+using namespace ai;
+
+vpn::ByteRing::ByteRing(size_t const capacity) : capacity_(capacity) {
+    if (!std::has_single_bit(capacity)) {
+        throw std::invalid_argument("capacity of byte ring is not a power of 2");
+    }
+}
+
+auto vpn::ByteRing::allocate() -> void {
+    if (!bytes_) {
+        bytes_ = std::make_unique<uint8_t[]>(capacity_);
+    }
+}
+
+auto vpn::ByteRing::peek(size_t const offset, size_t const length) const -> std::span<uint8_t const> {
+    if (offset >= size_) {
+        return {};
+    }
+    auto const start = (head_ + offset) & (capacity_ - 1);
+    return {bytes_.get() + start, std::min({length, size_ - offset, capacity_ - start})};
+}
+
+auto vpn::ByteRing::append(std::span<uint8_t const> bytes) -> size_t {
+    auto appended = size_t{0};
+    while (!bytes.empty() && size_ < capacity_) {
+        auto const free = room();
+        auto const length = std::min(free.size(), bytes.size());
+        std::memcpy(free.data(), bytes.data(), length);
+        commit(length);
+        bytes = bytes.subspan(length);
+        appended += length;
+    }
+    return appended;
+}
+
+auto vpn::ByteRing::room() -> std::span<uint8_t> {
+    allocate();
+    auto const end = (head_ + size_) & (capacity_ - 1);
+    auto const length = end >= head_ && size_ < capacity_ ? capacity_ - end : capacity_ - size_;
+    return {bytes_.get() + end, size_ == capacity_ ? 0 : length};
+}
+
+auto vpn::ByteRing::commit(size_t const length) -> void {
+    size_ += std::min(length, capacity_ - size_);
+}
+
+auto vpn::ByteRing::consume(size_t const length) -> void {
+    auto const consumed = std::min(length, size_);
+    head_ = (head_ + consumed) & (capacity_ - 1);
+    size_ -= consumed;
+
+    //
+    // An empty ring starts over at the front, so that the next bytes are
+    // not split at the wrap.
+    //
+    if (size_ == 0) {
+        head_ = 0;
+    }
+}
@@ -0,0 +1,101 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_BYTERING_H_
+#define ANDROID_INTROSPECTION_VPN_BYTERING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace ai::vpn {
+
+    //
+    // Bytes of a stream queued in a circular buffer of fixed capacity, so
+    // that taking bytes off the front as they are sent or acked moves an
+    // offset rather than the bytes left.  The buffer is allocated on the
+    // first write, as most flows never fill it, and reads and writes are
+    // handed out as contiguous views that stop at the wrap, which callers
+    // loop over.  One worker only.
+    //
+    class ByteRing final {
+
+        std::unique_ptr<uint8_t[]> bytes_;
+
+        size_t const capacity_;
+
+        //
+        // Offset of the first byte in bytes_.
+        //
+        size_t head_ = 0;
+
+        size_t size_ = 0;
+
+        auto allocate() -> void;
+
+    public:
+        //
+        // The capacity has to be a power of 2.
+        //
+        explicit ByteRing(size_t capacity);
+
+        ByteRing(ByteRing const &) = delete;
+
+        auto operator=(ByteRing const &) -> ByteRing & = delete;
+
+        //
+        // Bytes from the offset on, at most length of them, up to the wrap
+        // or the last byte.
+        //
+        auto peek(size_t offset, size_t length) const -> std::span<uint8_t const>;
+
+        //
+        // Appends what fits of the bytes; the count appended.
+        //
+        auto append(std::span<uint8_t const> bytes) -> size_t;
+
+        //
+        // Free room after the last byte, up to the wrap, to write bytes to
+        // in place, e.g. with recv(); commit() then appends those written.
+        //
+        auto room() -> std::span<uint8_t>;
+
+        auto commit(size_t length) -> void;
+
+        //
+        // Drops the first bytes, at most all of them.
+        //
+        auto consume(size_t length) -> void;
+
+        auto size() const -> size_t { return size_; }
+
+        auto empty() const -> bool { return size_ == 0; }
+
+        auto capacity() const -> size_t { return capacity_; }
+
+        auto available() const -> size_t { return capacity_ - size_; }
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_BYTERING_H_ */
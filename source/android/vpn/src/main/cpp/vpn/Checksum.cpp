@@ -0,0 +1,138 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Checksum.h"
+
+using namespace ai;
+
+namespace {
+
+    //
+    // Blocks of 16 bytes summed into lanes of 32 bits before they are moved
+    // to 64 bits; each block adds two words of at most 0xFFFF to a lane.
+    //
+    [[maybe_unused]] constexpr size_t MAX_LANE_BLOCKS = 32 * 1024;
+
+    //
+    // Sums are taken of words in the byte order of the device, which gives
+    // the sum of the words in network order with its two bytes swapped, as
+    // of RFC 1071.  Nothing is folded until the end.
+    //
+    auto sumNativeWords(uint8_t const *data, size_t size, uint64_t sum) -> uint64_t {
+        while (size >= 8) {
+            auto word = uint64_t{0};
+            std::memcpy(&word, data, sizeof(word));
+            sum += (word & 0xFFFFFFFFU) + (word >> 32U);
+            data += 8;
+            size -= 8;
+        }
+        if (size >= 4) {
+            auto word = uint32_t{0};
+            std::memcpy(&word, data, sizeof(word));
+            sum += word;
+            data += 4;
+            size -= 4;
+        }
+        if (size >= 2) {
+            auto word = uint16_t{0};
+            std::memcpy(&word, data, sizeof(word));
+            sum += word;
+            data += 2;
+            size -= 2;
+        }
+        if (size == 1) {
+            auto word = uint16_t{0};
+            std::memcpy(&word, data, 1);
+            sum += word;
+        }
+        return sum;
+    }
+
+#if defined(__ARM_NEON)
+    auto sumBlocks(uint8_t const *&data, size_t &size) -> uint64_t {
+        auto sum = uint64_t{0};
+        while (size >= 32) {
+            auto const blocks = std::min(size / 32, MAX_LANE_BLOCKS / 2);
+            auto first = vdupq_n_u32(0);
+            auto second = vdupq_n_u32(0);
+            for (size_t block = 0; block < blocks; block++, data += 32) {
+                first = vpadalq_u16(first, vreinterpretq_u16_u8(vld1q_u8(data)));
+                second = vpadalq_u16(second, vreinterpretq_u16_u8(vld1q_u8(data + 16)));
+            }
+            auto const lanes = vaddq_u64(vpaddlq_u32(first), vpaddlq_u32(second));
+            sum += vgetq_lane_u64(lanes, 0) + vgetq_lane_u64(lanes, 1);
+            size -= blocks * 32;
+        }
+        return sum;
+    }
+#elif defined(__SSE2__)
+    auto sumBlocks(uint8_t const *&data, size_t &size) -> uint64_t {
+        auto sum = uint64_t{0};
+        auto const zero = _mm_setzero_si128();
+        while (size >= 32) {
+            auto const blocks = std::min(size / 32, MAX_LANE_BLOCKS / 2);
+            auto first = _mm_setzero_si128();
+            auto second = _mm_setzero_si128();
+            for (size_t block = 0; block < blocks; block++, data += 32) {
+                auto const low = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data));
+                auto const high = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 16));
+                first = _mm_add_epi32(first, _mm_add_epi32(_mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero)));
+                second = _mm_add_epi32(second, _mm_add_epi32(_mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)));
+            }
+            auto lanes = std::array<uint32_t, 8>{};
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes.data()), first);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes.data() + 4), second);
+            for (auto const lane : lanes) {
+                sum += lane;
+            }
+            size -= blocks * 32;
+        }
+        return sum;
+    }
+#else
+    auto sumBlocks(uint8_t const *&, size_t &) -> uint64_t {
+        return 0;
+    }
+#endif
+}
+
+auto vpn::sumWords(std::span<uint8_t const> const bytes) -> uint16_t {
+    auto const *data = bytes.data();
+    auto size = bytes.size();
+    auto const sum = foldSum(sumNativeWords(data, size, sumBlocks(data, size)));
+    if constexpr (std::endian::native == std::endian::little) {
+        return static_cast<uint16_t>(sum << 8U | sum >> 8U);
+    }
+    return sum;
+}
@@ -0,0 +1,92 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_CHECKSUM_H_
+#define ANDROID_INTROSPECTION_VPN_CHECKSUM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+//
+// The one's complement sum of RFC 1071 the IPv4, TCP and UDP checksums are
+// made of: a full sum for bytes that are new, and updates of RFC 1624 for
+// fields rewritten in bytes already summed, which leave the rest of them
+// alone.  A checksum is the complement of the sum of what it covers.
+//
+namespace ai::vpn {
+
+    //
+    // Sum of the bytes as big-endian 16-bit words, the last one padded with
+    // a zero byte, folded to 16 bits.  Summed with NEON or SSE2 16 bytes at
+    // a time where the device has them, else 8 bytes at a time.
+    //
+    auto sumWords(std::span<uint8_t const> bytes) -> uint16_t;
+
+    constexpr auto foldSum(uint64_t sum) -> uint16_t {
+        while ((sum >> 16U) != 0) {
+            sum = (sum & 0xFFFFU) + (sum >> 16U);
+        }
+        return static_cast<uint16_t>(sum);
+    }
+
+    //
+    // Sum after a 16-bit word of the bytes summed changed from oldWord to
+    // newWord, as of eqn. 3 of RFC 1624.  A word starting at an odd offset
+    // of them falls across two words of the sum, which its bytes' swap
+    // accounts for.
+    //
+    constexpr auto updateSum(uint16_t const sum, uint16_t oldWord, uint16_t newWord, bool const isOddOffset = false) -> uint16_t {
+        if (isOddOffset) {
+            oldWord = static_cast<uint16_t>(oldWord << 8U | oldWord >> 8U);
+            newWord = static_cast<uint16_t>(newWord << 8U | newWord >> 8U);
+        }
+        return foldSum(static_cast<uint64_t>(sum) + static_cast<uint16_t>(~oldWord) + newWord);
+    }
+
+    //
+    // Same as above for a 32-bit word, e.g. an address.
+    //
+    constexpr auto updateSum(uint16_t const sum, uint32_t const oldWord, uint32_t const newWord, bool const isOddOffset = false) -> uint16_t {
+        auto const updated = updateSum(sum, static_cast<uint16_t>(oldWord >> 16U), static_cast<uint16_t>(newWord >> 16U), isOddOffset);
+        return updateSum(updated, static_cast<uint16_t>(oldWord), static_cast<uint16_t>(newWord), isOddOffset);
+    }
+
+    //
+    // Checksum field after a word it covers was rewritten, e.g. the address
+    // or port of a packet being translated.
+    //
+    template<typename Word>
+    constexpr auto updateChecksum(uint16_t const checksum, Word const oldWord, Word const newWord) -> uint16_t {
+        return static_cast<uint16_t>(~updateSum(static_cast<uint16_t>(~checksum), oldWord, newWord));
+    }
+
+    namespace detail {
+
+        static_assert(foldSum(0x1FFFEU) == 0xFFFF);
+        static_assert(updateSum(0x1234, uint16_t{0x0001}, uint16_t{0x0003}) == 0x1236);
+        static_assert(updateSum(0x1234, uint16_t{0x0001}, uint16_t{0x0003}, true) == 0x1434);
+    }
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_CHECKSUM_H_ */
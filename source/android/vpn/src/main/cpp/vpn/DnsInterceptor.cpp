@@ -0,0 +1,585 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+
+#include "utils/log.h"
+#include "utils/trace.h"
+#include "DnsInterceptor.h"
+
+using namespace ai;
+
+namespace {
+
+    constexpr uint16_t DNS_PORT = 53;
+
+    constexpr size_t HEADER_SIZE = 12;
+
+    //
+    // Largest message a packet of the tunnel holds, that of IPv4; those of
+    // IPv6 hold a little less.
+    //
+    constexpr size_t MAX_MESSAGE_SIZE = vpn::PACKET_SIZE - vpn::Ipv4Header::MIN_SIZE - vpn::UdpHeader::SIZE;
+
+    constexpr size_t MAX_CACHE_ENTRIES = 1024;
+
+    constexpr size_t MAX_HOSTNAMES = 4096;
+
+    constexpr uint64_t QUERY_TIMEOUT = 5 * 1000;
+
+    constexpr uint32_t MAX_TTL = 24 * 60 * 60;
+
+    //
+    // How long an address is told by the name it was looked up by, which
+    // outlives most TTLs as connections do.
+    //
+    constexpr uint64_t HOSTNAME_LIFETIME = 60 * 60 * 1000;
+
+    constexpr uint16_t FLAG_RESPONSE = 0x8000;
+
+    constexpr uint16_t FLAG_OPCODE = 0x7800;
+
+    constexpr uint16_t FLAG_TRUNCATED = 0x0200;
+
+    constexpr uint16_t FLAG_RCODE = 0x000F;
+
+    constexpr uint16_t TYPE_A = 1;
+
+    constexpr uint16_t TYPE_AAAA = 28;
+
+    constexpr uint16_t TYPE_OPT = 41;
+
+    constexpr uint16_t CLASS_IN = 1;
+
+    struct Question {
+
+        //
+        // Name in lower case with dots, e.g. "example.com".
+        //
+        std::string name;
+
+        //
+        // Name with type and class, as questions are told apart by.
+        //
+        std::string key;
+
+        size_t end = 0;
+    };
+
+    //
+    // Reads the one question of a message.  Names of questions are never
+    // compressed, what the app sends with a pointer is left alone.
+    //
+    auto parseQuestion(std::span<uint8_t const> const message) -> std::optional<Question> {
+        auto question = Question();
+        auto offset = HEADER_SIZE;
+        while (offset < message.size() && message[offset] != 0) {
+            auto const length = static_cast<size_t>(message[offset]);
+            if (length > 63 || offset + 1 + length >= message.size() || offset + 1 + length - HEADER_SIZE > 255) {
+                return std::nullopt;
+            }
+            if (!question.name.empty()) {
+                question.name += '.';
+            }
+            for (auto const c : message.subspan(offset + 1, length)) {
+                question.name += static_cast<char>(std::tolower(c));
+            }
+            offset += 1 + length;
+        }
+        if (offset + 5 > message.size()) {
+            return std::nullopt;
+        }
+        question.key = question.name;
+        question.key += '\0';
+        question.key.append(reinterpret_cast<char const *>(message.data() + offset + 1), 4);
+        question.end = offset + 5;
+        return question;
+    }
+
+    auto skipName(std::span<uint8_t const> const message, size_t offset) -> std::optional<size_t> {
+        while (offset < message.size()) {
+            auto const length = message[offset];
+            if ((length & 0xC0U) == 0xC0U) {
+                return offset + 2 <= message.size() ? std::optional(offset + 2) : std::nullopt;
+            }
+            if ((length & 0xC0U) != 0) {
+                return std::nullopt;
+            }
+            if (length == 0) {
+                return offset + 1;
+            }
+            offset += 1 + length;
+        }
+        return std::nullopt;
+    }
+
+    //
+    // Cuts a response too large for a packet of the tunnel down to its header
+    // and question, flagged as truncated so that the app asks again over TCP,
+    // and returns its size; 0 if the question can't be read.
+    //
+    auto truncateResponse(std::span<uint8_t> const message) -> size_t {
+        auto const question = parseQuestion(message);
+        if (!question) {
+            return 0;
+        }
+        vpn::detail::store16(message, 2, vpn::detail::load16(message, 2) | FLAG_TRUNCATED);
+        vpn::detail::store16(message, 6, 0);
+        vpn::detail::store16(message, 8, 0);
+        vpn::detail::store16(message, 10, 0);
+        return question->end;
+    }
+
+    auto isStandardQuery(std::span<uint8_t const> const message) -> bool {
+        return message.size() > HEADER_SIZE && (vpn::detail::load16(message, 2) & (FLAG_RESPONSE | FLAG_OPCODE)) == 0 &&
+               vpn::detail::load16(message, 4) == 1 && vpn::detail::load16(message, 6) == 0 && vpn::detail::load16(message, 8) == 0;
+    }
+}
+
+struct vpn::DnsInterceptor::CachedResponse {
+
+    std::vector<uint8_t> message;
+
+    //
+    // Where the TTL of every record but OPT is, to count them down by the
+    // time spent in the cache.
+    //
+    std::vector<size_t> ttlOffsets;
+
+    uint64_t receivedAt = 0;
+
+    uint64_t expiresAt = 0;
+
+    //
+    // Sum of the message as received, which each response written from it
+    // updates for its id, question and TTLs rather than summing it again.
+    //
+    uint16_t sum = 0;
+};
+
+struct vpn::DnsInterceptor::PendingQuery {
+
+    struct Waiter {
+
+        FlowKey key;
+
+        uint16_t id = 0;
+
+        //
+        // Question as the app asked it, with the case of its letters, which
+        // some resolvers randomize to check responses by.
+        //
+        std::vector<uint8_t> question;
+    };
+
+    std::string key;
+
+    uint16_t id = 0;
+
+    IpAddress serverAddress;
+
+    int socket = -1;
+
+    std::vector<Waiter> waiters;
+
+    TimerWheel::Timer timeout;
+
+    explicit PendingQuery(std::function<void()> onTimeout) : timeout(std::move(onTimeout)) {}
+};
+
+auto vpn::HostnameTable::add(IpAddress const &address, std::string const &name, uint64_t const now) -> void {
+    auto const lock = std::lock_guard(mutex_);
+    if (auto const it = hostnames_.find(address); it != hostnames_.end()) {
+        if (it->second.name == name) {
+            it->second.expiresAt = now + HOSTNAME_LIFETIME;
+            return;
+        }
+        erase(it);
+    }
+    if (hostnames_.size() >= MAX_HOSTNAMES) {
+        for (auto it = hostnames_.begin(); it != hostnames_.end();) {
+            auto const next = std::next(it);
+            if (it->second.expiresAt <= now) {
+                erase(it);
+            }
+            it = next;
+        }
+        if (hostnames_.size() >= MAX_HOSTNAMES) {
+            erase(hostnames_.begin());
+        }
+    }
+    hostnames_.emplace(address, Hostname{name, now + HOSTNAME_LIFETIME});
+    addresses_[name].push_back(address);
+}
+
+auto vpn::HostnameTable::find(IpAddress const &address, uint64_t const now) const -> std::string {
+    auto const lock = std::lock_guard(mutex_);
+    auto const it = hostnames_.find(address);
+    return it != hostnames_.end() && it->second.expiresAt > now ? it->second.name : std::string();
+}
+
+auto vpn::HostnameTable::findAlternates(IpAddress const &address, uint64_t const now, size_t const maxCount) const -> std::vector<IpAddress> {
+    auto alternates = std::vector<IpAddress>();
+    auto const lock = std::lock_guard(mutex_);
+    auto const it = hostnames_.find(address);
+    if (it == hostnames_.end() || it->second.expiresAt <= now) {
+        return alternates;
+    }
+    for (auto const &other : addresses_.at(it->second.name)) {
+        if (alternates.size() == maxCount) {
+            break;
+        }
+        if (other.isIpv4() != address.isIpv4() && hostnames_.at(other).expiresAt > now) {
+            alternates.push_back(other);
+        }
+    }
+    return alternates;
+}
+
+auto vpn::HostnameTable::erase(std::unordered_map<IpAddress, Hostname, AddressHash>::iterator const it) -> void {
+    auto const addresses = addresses_.find(it->second.name);
+    std::erase(addresses->second, it->first);
+    if (addresses->second.empty()) {
+        addresses_.erase(addresses);
+    }
+    hostnames_.erase(it);
+}
+
+vpn::DnsInterceptor::DnsInterceptor(TunnelQueue &tunnel, int const epollFd, TimerWheel &timers, HostnameTable &hostnames,
+                                    SocketCallback onSocketCreated, SocketCallback onSocketDestroyed)
+        : tunnel_(tunnel), epollFd_(epollFd), timers_(timers), hostnames_(hostnames), onSocketCreated_(std::move(onSocketCreated)),
+          onSocketDestroyed_(std::move(onSocketDestroyed)), random_(std::random_device()()) {
+}
+
+vpn::DnsInterceptor::~DnsInterceptor() {
+    for (auto const &[socket, query] : pendingQueriesBySocket_) {
+        closeSocket(socket);
+    }
+    pendingQueriesBySocket_.clear();
+    pendingQueriesById_.clear();
+    pendingQueries_.clear();
+}
+
+auto vpn::DnsInterceptor::handleQuery(IpHeader const &ipHeader, UdpHeader const &udpHeader, uint64_t const now) -> bool {
+    TRACE_SPAN("DnsInterceptor::handleQuery");
+    auto const message = udpHeader.payload();
+    if (!isStandardQuery(message)) {
+        return false;
+    }
+    auto const question = parseQuestion(message);
+    if (!question) {
+        return false;
+    }
+    auto waiter = PendingQuery::Waiter{
+            FlowKey{ipHeader.sourceAddress(), ipHeader.destinationAddress(), udpHeader.sourcePort(), udpHeader.destinationPort(),
+                    static_cast<uint8_t>(IpProtocol::Udp)},
+            detail::load16(message, 0), std::vector(message.begin() + HEADER_SIZE, message.begin() + static_cast<ptrdiff_t>(question->end))};
+
+    if (auto const it = cache_.find(question->key); it != cache_.end()) {
+        if (it->second->expiresAt > now) {
+            LOGD("handleQuery answering [%s] from the cache", question->name.c_str());
+            writeResponse(waiter.key, waiter.id, waiter.question, *it->second, now);
+            return true;
+        }
+        cache_.erase(it);
+    }
+
+    auto *query = pendingQueries_.contains(question->key) ? pendingQueries_.at(question->key).get() : nullptr;
+    if (query == nullptr) {
+        query = startQuery(question->key, ipHeader.destinationAddress(), message.first(question->end), now);
+        if (query == nullptr) {
+            return false;
+        }
+    }
+    query->waiters.push_back(std::move(waiter));
+    return true;
+}
+
+auto vpn::DnsInterceptor::handleSocketEvent(uint64_t const token, uint32_t const events, uint64_t const now) -> bool {
+    if ((token >> 32U) != 0) {
+        return false;
+    }
+    auto const it = pendingQueriesBySocket_.find(static_cast<int>(token));
+    if (it == pendingQueriesBySocket_.end()) {
+        return false;
+    }
+    if ((events & (EPOLLIN | EPOLLERR)) != 0) {
+        readResponses(it->first, now);
+    }
+    return true;
+}
+
+//
+// Socket of a query, connected to the server from a port of its own, which
+// the kernel picks at random; -1 if it cannot be opened.
+//
+auto vpn::DnsInterceptor::openSocket(IpAddress const &serverAddress) -> int {
+    auto const socketFd = socket(serverAddress.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socketFd < 0) {
+        LOGW("openSocket unable to create socket, %s", strerror(errno));
+        return -1;
+    }
+    onSocketCreated_(socketFd);
+    auto const address = SocketAddress(serverAddress, DNS_PORT);
+    if (connect(socketFd, address.get(), address.length) < 0) {
+        LOGD("openSocket unable to connect socket [%d], %s", socketFd, strerror(errno));
+        onSocketDestroyed_(socketFd);
+        close(socketFd);
+        return -1;
+    }
+    auto event = epoll_event{EPOLLIN, {.u64 = static_cast<uint32_t>(socketFd)}};
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, socketFd, &event) < 0) {
+        LOGW("openSocket unable to watch socket [%d], %s", socketFd, strerror(errno));
+        onSocketDestroyed_(socketFd);
+        close(socketFd);
+        return -1;
+    }
+    return socketFd;
+}
+
+auto vpn::DnsInterceptor::closeSocket(int const socket) -> void {
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+    onSocketDestroyed_(socket);
+    close(socket);
+}
+
+//
+// Sends the query upstream under an id of its own and from a port of its
+// own, both picked at random so that responses are hard to forge, and
+// returns it to wait for the response on.  What followed the question, e.g.
+// the OPT record of EDNS, is not sent, so neither is its count.
+//
+auto vpn::DnsInterceptor::startQuery(std::string const &key, IpAddress const &serverAddress, std::span<uint8_t const> const message,
+                                     uint64_t const now) -> PendingQuery * {
+    auto const socket = openSocket(serverAddress);
+    if (socket < 0) {
+        return nullptr;
+    }
+    auto id = static_cast<uint16_t>(random_());
+    while (pendingQueriesById_.contains(id)) {
+        id = static_cast<uint16_t>(random_());
+    }
+
+    auto const query = std::span(packet_).first(message.size());
+    std::ranges::copy(message, query.begin());
+    detail::store16(query, 0, id);
+    detail::store16(query, 10, 0);
+    if (send(socket, query.data(), query.size(), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        LOGD("startQuery unable to send on socket [%d], %s", socket, strerror(errno));
+        closeSocket(socket);
+        return nullptr;
+    }
+
+    auto pendingQuery = std::make_unique<PendingQuery>([this, id] { finishQuery(id); });
+    pendingQuery->key = key;
+    pendingQuery->id = id;
+    pendingQuery->serverAddress = serverAddress;
+    pendingQuery->socket = socket;
+    timers_.schedule(pendingQuery->timeout, now + QUERY_TIMEOUT);
+    pendingQueriesById_.emplace(id, pendingQuery.get());
+    pendingQueriesBySocket_.emplace(socket, pendingQuery.get());
+    return pendingQueries_.insert_or_assign(key, std::move(pendingQuery)).first->second.get();
+}
+
+//
+// Forgets a query and closes its socket; its waiters are left to ask again
+// when it timed out.
+//
+auto vpn::DnsInterceptor::finishQuery(uint16_t const id) -> void {
+    auto const it = pendingQueriesById_.find(id);
+    if (it == pendingQueriesById_.end()) {
+        return;
+    }
+    auto const key = it->second->key;
+    auto const socket = it->second->socket;
+    pendingQueriesById_.erase(it);
+    pendingQueriesBySocket_.erase(socket);
+    pendingQueries_.erase(key);
+    closeSocket(socket);
+}
+
+auto vpn::DnsInterceptor::readResponses(int const socket, uint64_t const now) -> void {
+    auto message = std::array<uint8_t, MAX_MESSAGE_SIZE>();
+    while (true) {
+        auto address = sockaddr_storage{};
+        auto addressLength = static_cast<socklen_t>(sizeof(address));
+        auto const dataReadInBytes = recvfrom(socket, message.data(), message.size(), MSG_DONTWAIT | MSG_TRUNC,
+                                              reinterpret_cast<sockaddr *>(&address), &addressLength);
+        if (dataReadInBytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOGD("readResponses unable to read socket [%d], %s", socket, strerror(errno));
+            }
+            break;
+        }
+        auto const server = SocketAddress::parse(address);
+        auto size = static_cast<size_t>(dataReadInBytes);
+        if (size > message.size()) {
+            size = truncateResponse(message);
+        }
+        if (size == 0 || !server || server->second != DNS_PORT) {
+            LOGD("readResponses dropping datagram of %zd bytes", dataReadInBytes);
+            continue;
+        }
+        handleResponse(std::span(message).first(size), server->first, now);
+        if (!pendingQueriesBySocket_.contains(socket)) {
+            break;
+        }
+    }
+}
+
+//
+// Answers every waiter of the query the response is for, and caches it for
+// as long as the shortest TTL of its answers when it has any.  Truncated
+// responses, including those truncated here for being too large for the
+// tunnel, are passed on uncached, so that the app asks again over TCP.
+//
+auto vpn::DnsInterceptor::handleResponse(std::span<uint8_t const> const message, IpAddress const &serverAddress, uint64_t const now) -> void {
+    TRACE_SPAN("DnsInterceptor::handleResponse");
+    if (message.size() <= HEADER_SIZE) {
+        return;
+    }
+    auto const it = pendingQueriesById_.find(detail::load16(message, 0));
+    if (it == pendingQueriesById_.end() || it->second->serverAddress != serverAddress) {
+        return;
+    }
+    auto &query = *it->second;
+    auto const flags = detail::load16(message, 2);
+    auto const question = parseQuestion(message);
+    if ((flags & FLAG_RESPONSE) == 0 || detail::load16(message, 4) != 1 || !question || question->key != query.key) {
+        LOGD("readResponses dropping response to query [%hu] not matching its question", query.id);
+        return;
+    }
+
+    auto response = CachedResponse{std::vector(message.begin(), message.end()), {}, now, now, sumWords(message)};
+    auto const answerCount = static_cast<size_t>(detail::load16(message, 6));
+    auto const recordCount = answerCount + detail::load16(message, 8) + detail::load16(message, 10);
+    auto addresses = std::vector<IpAddress>();
+    auto ttl = MAX_TTL;
+    auto offset = std::optional(question->end);
+    for (size_t i = 0; i < recordCount && offset; ++i) {
+        offset = skipName(message, *offset);
+        if (!offset || *offset + 10 > message.size()) {
+            offset = std::nullopt;
+            break;
+        }
+        auto const type = detail::load16(message, *offset);
+        auto const dataLength = static_cast<size_t>(detail::load16(message, *offset + 8));
+        if (type != TYPE_OPT) {
+            response.ttlOffsets.push_back(*offset + 4);
+        }
+        if (i < answerCount) {
+            ttl = std::min(ttl, detail::load32(message, *offset + 4));
+            auto const isInternet = detail::load16(message, *offset + 2) == CLASS_IN;
+            if (type == TYPE_A && isInternet && dataLength == 4 && *offset + 14 <= message.size()) {
+                addresses.push_back(IpAddress::ipv4(detail::load32(message, *offset + 10)));
+            } else if (type == TYPE_AAAA && isInternet && dataLength == IpAddress::SIZE && *offset + 10 + IpAddress::SIZE <= message.size()) {
+                addresses.push_back(IpAddress::ipv6(message.subspan(*offset + 10).first<IpAddress::SIZE>()));
+            }
+        }
+        *offset += 10 + dataLength;
+        if (*offset > message.size()) {
+            offset = std::nullopt;
+        }
+    }
+
+    if (offset && (flags & (FLAG_TRUNCATED | FLAG_RCODE)) == 0 && answerCount > 0 && ttl > 0) {
+        response.expiresAt = now + static_cast<uint64_t>(ttl) * 1000;
+        for (auto const &address : addresses) {
+            hostnames_.add(address, question->name, now);
+        }
+    }
+    for (auto const &waiter : query.waiters) {
+        writeResponse(waiter.key, waiter.id, waiter.question, response, now);
+    }
+    LOGD("handleResponse answered [%s] to %zu queries", question->name.c_str(), query.waiters.size());
+
+    if (response.expiresAt > now) {
+        if (cache_.size() >= MAX_CACHE_ENTRIES && !cache_.contains(query.key)) {
+            std::erase_if(cache_, [now](auto const &entry) { return entry.second->expiresAt <= now; });
+            if (cache_.size() >= MAX_CACHE_ENTRIES) {
+                cache_.erase(cache_.begin());
+            }
+        }
+        cache_.insert_or_assign(query.key, std::make_unique<CachedResponse>(std::move(response)));
+    }
+    finishQuery(query.id);
+}
+
+//
+// Writes the response to the app as a datagram from the server it asked,
+// with the id and question of its query and the TTLs as they are now.  A
+// response that fits a packet of IPv4 but not one of IPv6 is truncated for
+// an app asking over IPv6, as readResponses truncates those fitting neither.
+//
+auto vpn::DnsInterceptor::writeResponse(FlowKey const &key, uint16_t const id, std::span<uint8_t const> const question,
+                                        CachedResponse const &response, uint64_t const now) -> void {
+    auto const &message = response.message;
+    auto const headersSize = ipHeaderSize(key.destinationAddress) + UdpHeader::SIZE;
+    if (message.size() < HEADER_SIZE + question.size()) {
+        return;
+    }
+    if (headersSize + message.size() > packet_.size()) {
+        auto const packet = std::span(packet_).first(headersSize + HEADER_SIZE + question.size());
+        auto const payload = packet.subspan(headersSize);
+        std::ranges::copy(std::span(message).first(HEADER_SIZE), payload.begin());
+        detail::store16(payload, 0, id);
+        std::ranges::copy(question, payload.begin() + HEADER_SIZE);
+        if (truncateResponse(payload) != payload.size()) {
+            return;
+        }
+        writeIpHeader(packet, IpProtocol::Udp, key.destinationAddress, key.sourceAddress, nextPacketId_++);
+        writeUdpHeader(packet, key.destinationPort, key.sourcePort, sumWords(payload));
+        tunnel_.write(packet);
+        return;
+    }
+    auto const packet = std::span(packet_).first(headersSize + message.size());
+    auto const payload = packet.subspan(headersSize);
+    std::ranges::copy(message, payload.begin());
+    auto sum = updateSum(response.sum, detail::load16(message, 0), id);
+    detail::store16(payload, 0, id);
+    sum = updateSum(sum, sumWords(std::span(message).subspan(HEADER_SIZE, question.size())), sumWords(question));
+    std::ranges::copy(question, payload.begin() + HEADER_SIZE);
+    auto const elapsed = static_cast<uint32_t>((now - response.receivedAt) / 1000);
+    for (auto const offset : elapsed > 0 ? std::span(response.ttlOffsets) : std::span<size_t const>()) {
+        auto const ttl = detail::load32(payload, offset);
+        auto const remaining = ttl > elapsed ? ttl - elapsed : 0;
+        sum = updateSum(sum, ttl, remaining, offset % 2 != 0);
+        detail::store32(payload, offset, remaining);
+    }
+
+    writeIpHeader(packet, IpProtocol::Udp, key.destinationAddress, key.sourceAddress, nextPacketId_++);
+    writeUdpHeader(packet, key.destinationPort, key.sourcePort, sum);
+    tunnel_.write(packet);
+}
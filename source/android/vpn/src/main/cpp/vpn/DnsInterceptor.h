@@ -0,0 +1,178 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_DNSINTERCEPTOR_H_
+#define ANDROID_INTROSPECTION_VPN_DNSINTERCEPTOR_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "FlowTable.h"
+#include "PacketHeaders.h"
+#include "PacketPool.h"
+#include "TcpForwarder.h"
+#include "TimerWheel.h"
+#include "Tunnel.h"
+
+namespace ai::vpn {
+
+    //
+    // Names DNS answers gave addresses for, each kept for a while after the
+    // answer so that flows to the address can be told by name.  Written by
+    // the worker intercepting DNS and read by every worker.
+    //
+    class HostnameTable final {
+
+        struct Hostname {
+
+            std::string name;
+
+            uint64_t expiresAt = 0;
+        };
+
+        struct AddressHash {
+
+            auto operator()(IpAddress const &address) const -> size_t {
+                return std::hash<std::string_view>()(std::string_view(reinterpret_cast<char const *>(address.bytes().data()), IpAddress::SIZE));
+            }
+        };
+
+        mutable std::mutex mutex_;
+
+        std::unordered_map<IpAddress, Hostname, AddressHash> hostnames_;
+
+        //
+        // Addresses of hostnames_ by their name.
+        //
+        std::unordered_map<std::string, std::vector<IpAddress>> addresses_;
+
+        auto erase(std::unordered_map<IpAddress, Hostname, AddressHash>::iterator it) -> void;
+
+    public:
+        auto add(IpAddress const &address, std::string const &name, uint64_t now) -> void;
+
+        //
+        // Name a recent answer gave the address for, empty if none did.
+        //
+        auto find(IpAddress const &address, uint64_t now) const -> std::string;
+
+        //
+        // Addresses of the other family recent answers gave for the name the
+        // address was looked up by, e.g. those of AAAA answers for an address
+        // of an A answer, at most maxCount of them.
+        //
+        auto findAlternates(IpAddress const &address, uint64_t now, size_t maxCount) const -> std::vector<IpAddress>;
+    };
+
+    //
+    // Answers DNS queries over UDP the app sends into the tunnel: from a
+    // cache of earlier responses while their TTLs last, or else by asking
+    // the server the query was sent to.  Queries for the same question
+    // while one is on its way share its response.  Addresses of the A and
+    // AAAA answers are added to a HostnameTable with the name asked for.
+    //
+    // Like the forwarders it runs on the packet loop of a worker, the one DNS
+    // queries all go to, with a socket per query upstream in the loop's
+    // epoll set and its timeouts on the loop's wheel.
+    //
+    class DnsInterceptor final {
+
+        struct CachedResponse;
+
+        struct PendingQuery;
+
+        TunnelQueue &tunnel_;
+
+        int const epollFd_;
+
+        TimerWheel &timers_;
+
+        HostnameTable &hostnames_;
+
+        SocketCallback onSocketCreated_;
+
+        SocketCallback onSocketDestroyed_;
+
+        std::mt19937 random_;
+
+        uint16_t nextPacketId_ = 0;
+
+        std::unordered_map<std::string, std::unique_ptr<CachedResponse>> cache_;
+
+        std::unordered_map<std::string, std::unique_ptr<PendingQuery>> pendingQueries_;
+
+        std::unordered_map<uint16_t, PendingQuery *> pendingQueriesById_;
+
+        std::unordered_map<int, PendingQuery *> pendingQueriesBySocket_;
+
+        std::array<uint8_t, PACKET_SIZE> packet_{};
+
+        auto openSocket(IpAddress const &serverAddress) -> int;
+
+        auto closeSocket(int socket) -> void;
+
+        auto startQuery(std::string const &key, IpAddress const &serverAddress, std::span<uint8_t const> message, uint64_t now) -> PendingQuery *;
+
+        auto finishQuery(uint16_t id) -> void;
+
+        auto readResponses(int socket, uint64_t now) -> void;
+
+        auto handleResponse(std::span<uint8_t const> message, IpAddress const &serverAddress, uint64_t now) -> void;
+
+        auto writeResponse(FlowKey const &key, uint16_t id, std::span<uint8_t const> question, CachedResponse const &response, uint64_t now) -> void;
+
+    public:
+        DnsInterceptor(TunnelQueue &tunnel, int epollFd, TimerWheel &timers, HostnameTable &hostnames, SocketCallback onSocketCreated,
+                       SocketCallback onSocketDestroyed);
+
+        DnsInterceptor(DnsInterceptor const &) = delete;
+
+        auto operator=(DnsInterceptor const &) -> DnsInterceptor & = delete;
+
+        ~DnsInterceptor();
+
+        //
+        // Takes a datagram the app sent to port 53 and returns whether it
+        // was handled; anything but a standard query with one question is
+        // left to be forwarded as it is.
+        //
+        auto handleQuery(IpHeader const &ipHeader, UdpHeader const &udpHeader, uint64_t now) -> bool;
+
+        //
+        // Events of epoll for a token, false if it is not that of a socket of
+        // the interceptor.
+        //
+        auto handleSocketEvent(uint64_t token, uint32_t events, uint64_t now) -> bool;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_DNSINTERCEPTOR_H_ */
@@ -0,0 +1,156 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+
+#include "utils/log.h"
+#include "utils/trace.h"
+#include "FlowAttribution.h"
+
+using namespace ai;
+
+namespace {
+
+    constexpr size_t POP_BATCH_SIZE = 32;
+
+    std::atomic_uint64_t gAttributedFlows{0};
+
+    std::atomic_uint64_t gUnknownFlows{0};
+
+    std::atomic_uint64_t gDroppedRequests{0};
+
+    auto signalEventFd(int const eventFd) -> void {
+        auto const count = uint64_t{1};
+        if (write(eventFd, &count, sizeof(count)) != sizeof(count)) {
+            LOGE("signalEventFd unable to signal eventfd, %s", strerror(errno));
+        }
+    }
+}
+
+vpn::FlowAttributor::FlowAttributor(OwnerLookup lookup, std::vector<int> workerWakeFds, size_t const queueSize)
+        : lookup_(std::move(lookup)), requests_(queueSize), wakeFd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)), workerWakeFds_(std::move(workerWakeFds)) {
+    if (wakeFd_ < 0) {
+        LOGE("FlowAttributor unable to create eventfd, %s", strerror(errno));
+    }
+    owners_.reserve(workerWakeFds_.size());
+    for (size_t index = 0; index < workerWakeFds_.size(); index++) {
+        owners_.push_back(std::make_unique<utils::SpscRingBuffer<FlowOwner>>(queueSize));
+    }
+}
+
+vpn::FlowAttributor::~FlowAttributor() {
+    if (wakeFd_ >= 0) {
+        close(wakeFd_);
+    }
+}
+
+auto vpn::FlowAttributor::request(FlowKey const &key, size_t const worker) -> bool {
+    if (!requests_.tryPush(Request{key, worker})) {
+        gDroppedRequests.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (!wakePending_.exchange(true, std::memory_order_acq_rel)) {
+        signalEventFd(wakeFd_);
+    }
+    return true;
+}
+
+auto vpn::FlowAttributor::popOwners(size_t const worker, std::span<FlowOwner> const owners) -> size_t {
+    return owners_[worker]->popBatch(owners);
+}
+
+auto vpn::FlowAttributor::getPackageName(int32_t const uid) -> std::string const & {
+    auto entry = packageNames_.find(uid);
+    if (entry == packageNames_.end()) {
+        entry = packageNames_.emplace(uid, lookup_.getPackageName ? lookup_.getPackageName(uid) : std::string()).first;
+        LOGI("FlowAttributor::getPackageName uid %d is [%s]", uid, entry->second.c_str());
+    }
+    return entry->second;
+}
+
+auto vpn::FlowAttributor::attribute(Request const &request) -> void {
+    TRACE_SPAN("FlowAttributor::attribute");
+    auto const uid = lookup_.getUid ? lookup_.getUid(request.key) : UNKNOWN_UID;
+    if (uid == UNKNOWN_UID) {
+        gUnknownFlows.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    gAttributedFlows.fetch_add(1, std::memory_order_relaxed);
+    [[maybe_unused]] auto const &packageName = getPackageName(uid);
+    LOGD("FlowAttributor::attribute flow to port %hu owned by uid %d [%s]", request.key.destinationPort, uid, packageName.c_str());
+    if (!owners_[request.worker]->tryPush(FlowOwner{request.key, uid})) {
+        LOGW("FlowAttributor::attribute owners of worker %zu full", request.worker);
+    }
+}
+
+//
+// The pending flag is cleared before the queue is drained, so that a flow
+// queued after the drain always signals again.  Workers are woken once per
+// drain that attributed any of their flows.
+//
+auto vpn::FlowAttributor::run(int const stopFd) -> void {
+    LOGI("FlowAttributor::run start");
+    auto fds = std::array<pollfd, 2>{pollfd{wakeFd_, POLLIN, 0}, pollfd{stopFd, POLLIN, 0}};
+    auto batch = std::array<Request, POP_BATCH_SIZE>{};
+    while (true) {
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOGE("FlowAttributor::run unable to wait, %s", strerror(errno));
+            break;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            break;
+        }
+        auto count = uint64_t{0};
+        while (read(wakeFd_, &count, sizeof(count)) < 0 && errno == EINTR) {
+        }
+        wakePending_.store(false, std::memory_order_release);
+        auto woken = std::vector<bool>(workerWakeFds_.size());
+        for (auto popped = requests_.popBatch(batch); popped > 0; popped = requests_.popBatch(batch)) {
+            for (auto const &request : std::span(batch).first(popped)) {
+                attribute(request);
+                woken[request.worker] = true;
+            }
+        }
+        for (size_t index = 0; index < woken.size(); index++) {
+            if (woken[index]) {
+                signalEventFd(workerWakeFds_[index]);
+            }
+        }
+    }
+    LOGI("FlowAttributor::run finished");
+}
+
+auto vpn::getAttributionStats() -> std::string {
+    return "attribution.flows " + std::to_string(gAttributedFlows.load(std::memory_order_relaxed)) + "\n" +
+           "attribution.unknown " + std::to_string(gUnknownFlows.load(std::memory_order_relaxed)) + "\n" +
+           "attribution.dropped " + std::to_string(gDroppedRequests.load(std::memory_order_relaxed)) + "\n";
+}
@@ -0,0 +1,144 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_FLOWATTRIBUTION_H_
+#define ANDROID_INTROSPECTION_VPN_FLOWATTRIBUTION_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/ring_buffer.h"
+#include "FlowTable.h"
+
+namespace ai::vpn {
+
+    //
+    // Looks up the uid of the app owning a flow, e.g. through
+    // ConnectivityManager.getConnectionOwnerUid(), and the packages running
+    // as a uid.  Both are slow, so they are only called on the thread of the
+    // attributor.
+    //
+    struct OwnerLookup {
+
+        std::function<int32_t(FlowKey const &)> getUid;
+
+        std::function<std::string(int32_t)> getPackageName;
+    };
+
+    //
+    // Owner looked up for a flow of a worker.
+    //
+    struct FlowOwner {
+
+        FlowKey key;
+
+        int32_t uid = UNKNOWN_UID;
+    };
+
+    //
+    // Finds the app owning every new TCP and UDP flow off the packet path:
+    // workers queue the flows they create, a thread of its own looks up
+    // their owners and names the packages of every uid it has not seen yet,
+    // and queues the owners back to the worker of each flow, which it wakes
+    // through the eventfd of the worker.  Flows are attributed once, a few
+    // packets in; a full queue leaves a flow unattributed.
+    //
+    class FlowAttributor final {
+
+        struct Request {
+
+            FlowKey key;
+
+            size_t worker = 0;
+        };
+
+        OwnerLookup const lookup_;
+
+        utils::MpscRingBuffer<Request> requests_;
+
+        //
+        // eventfd waking the thread of the attributor, and whether it was
+        // signaled since the thread last drained its queue, so that a burst
+        // of new flows costs one write.
+        //
+        int const wakeFd_;
+
+        std::atomic_bool wakePending_{false};
+
+        std::vector<std::unique_ptr<utils::SpscRingBuffer<FlowOwner>>> owners_;
+
+        std::vector<int> const workerWakeFds_;
+
+        //
+        // Packages by uid, only used by the thread of the attributor.
+        //
+        std::unordered_map<int32_t, std::string> packageNames_;
+
+        auto getPackageName(int32_t uid) -> std::string const &;
+
+        auto attribute(Request const &request) -> void;
+
+    public:
+        FlowAttributor(OwnerLookup lookup, std::vector<int> workerWakeFds, size_t queueSize);
+
+        FlowAttributor(FlowAttributor const &) = delete;
+
+        auto operator=(FlowAttributor const &) -> FlowAttributor & = delete;
+
+        ~FlowAttributor();
+
+        auto isValid() const -> bool { return wakeFd_ >= 0; }
+
+        //
+        // Queues the flow of the worker to be attributed, false if the queue
+        // is full.  Any worker.
+        //
+        auto request(FlowKey const &key, size_t worker) -> bool;
+
+        //
+        // Moves the owners looked up for flows of the worker into owners and
+        // returns how many it moved.  That worker only.
+        //
+        auto popOwners(size_t worker, std::span<FlowOwner> owners) -> size_t;
+
+        //
+        // Looks up owners until a stop is requested through stopFd.
+        //
+        auto run(int stopFd) -> void;
+    };
+
+    //
+    // Flows attributed and left unknown since the library was loaded, one
+    // "name value" per line.
+    //
+    auto getAttributionStats() -> std::string;
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_FLOWATTRIBUTION_H_ */
@@ -0,0 +1,178 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "FlowLog.h"
+
+using namespace ai;
+
+namespace {
+
+    template<typename Clock>
+    auto getMilliseconds() -> int64_t {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    auto saturate(uint64_t const value) -> uint32_t {
+        return static_cast<uint32_t>(std::min<uint64_t>(value, UINT32_MAX));
+    }
+}
+
+vpn::FlowLog::~FlowLog() {
+    close();
+}
+
+auto vpn::FlowLog::open(std::string const &path, uint64_t const interval, uint64_t const capacity) -> bool {
+    auto const lock = std::lock_guard(mutex_);
+    closeLocked();
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ < 0) {
+        LOGE("FlowLog::open unable to open %s, %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    //
+    // An existing log keeps the capacity it was created with; anything
+    // else at the path is left as it is.
+    //
+    struct stat status{};
+    auto existing = Header();
+    if (fstat(fd_, &status) != 0 ||
+        (status.st_size != 0 && (pread(fd_, &existing, sizeof(existing), 0) != sizeof(existing) || existing.magic != MAGIC ||
+                                 existing.version != VERSION || existing.recordsOffset != sizeof(Header)))) {
+        LOGE("FlowLog::open %s is not a flow log", path.c_str());
+        closeLocked();
+        return false;
+    }
+    auto const recordsCapacity = status.st_size != 0 ? existing.capacity : capacity - capacity % RECORD_ALIGNMENT;
+    size_ = sizeof(Header) + recordsCapacity;
+    if (ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+        LOGE("FlowLog::open unable to size %s, %s", path.c_str(), strerror(errno));
+        closeLocked();
+        return false;
+    }
+    memory_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (memory_ == MAP_FAILED) {
+        LOGE("FlowLog::open unable to map %s, %s", path.c_str(), strerror(errno));
+        memory_ = nullptr;
+        closeLocked();
+        return false;
+    }
+    if (status.st_size != 0) {
+        header_ = static_cast<Header *>(memory_);
+    } else {
+        header_ = new (memory_) Header();
+        header_->recordsOffset = sizeof(Header);
+        header_->capacity = recordsCapacity;
+    }
+    wallClockOffset_ = getMilliseconds<std::chrono::system_clock>() - getMilliseconds<std::chrono::steady_clock>();
+    interval_.store(interval, std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_relaxed);
+    LOGI("FlowLog::open logging flows to %s, %llu of %llu bytes used", path.c_str(),
+         static_cast<unsigned long long>(header_->end.load(std::memory_order_relaxed)), static_cast<unsigned long long>(recordsCapacity));
+    return true;
+}
+
+auto vpn::FlowLog::close() -> void {
+    auto const lock = std::lock_guard(mutex_);
+    closeLocked();
+}
+
+auto vpn::FlowLog::closeLocked() -> void {
+    enabled_.store(false, std::memory_order_relaxed);
+    auto end = uint64_t{0};
+    if (memory_ != nullptr) {
+        end = header_->end.load(std::memory_order_relaxed);
+        munmap(memory_, size_);
+        memory_ = nullptr;
+        header_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        if (size_ != 0 && ftruncate(fd_, static_cast<off_t>(sizeof(Header) + end)) != 0) {
+            LOGW("FlowLog::close unable to trim log, %s", strerror(errno));
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+auto vpn::FlowLog::append(Flow const &flow, std::string_view const name, uint8_t const flags) -> bool {
+    if (!isEnabled()) {
+        return false;
+    }
+    auto const lock = std::lock_guard(mutex_);
+    if (header_ == nullptr) {
+        return false;
+    }
+    auto const nameLength = std::min(name.size(), MAX_NAME_LENGTH);
+    auto const size = (sizeof(Record) + nameLength + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+    auto const end = header_->end.load(std::memory_order_relaxed);
+    if (header_->capacity - end < size) {
+        droppedRecords_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto *const data = static_cast<std::byte *>(memory_) + sizeof(Header) + end;
+    auto *const record = new (data) Record();
+    record->size = static_cast<uint16_t>(size);
+    record->protocol = flow.key.protocol;
+    record->flags = flags;
+    record->uid = flow.uid;
+    record->sourceAddress = flow.key.sourceAddress;
+    record->destinationAddress = flow.key.destinationAddress;
+    record->sourcePort = flow.key.sourcePort;
+    record->destinationPort = flow.key.destinationPort;
+    record->duration = saturate(flow.lastActive - flow.firstActive);
+    record->startTime = static_cast<uint64_t>(static_cast<int64_t>(flow.firstActive) + wallClockOffset_);
+    record->bytesSent = flow.bytes;
+    record->bytesReceived = flow.receivedBytes;
+    record->packetsSent = saturate(flow.packets);
+    record->packetsReceived = saturate(flow.receivedPackets);
+    std::memcpy(data + sizeof(Record), name.data(), nameLength);
+    std::memset(data + sizeof(Record) + nameLength, 0, size - sizeof(Record) - nameLength);
+    header_->end.store(end + size, std::memory_order_release);
+    records_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+auto vpn::FlowLog::getStats() const -> std::string {
+    auto used = uint64_t{0};
+    {
+        auto const lock = std::lock_guard(mutex_);
+        used = header_ != nullptr ? header_->end.load(std::memory_order_relaxed) : 0;
+    }
+    return "flowlog.records " + std::to_string(records_.load(std::memory_order_relaxed)) + "\n" +
+           "flowlog.bytes " + std::to_string(used) + "\n" +
+           "flowlog.dropped " + std::to_string(droppedRecords_.load(std::memory_order_relaxed)) + "\n";
+}
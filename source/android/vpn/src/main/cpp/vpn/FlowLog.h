@@ -0,0 +1,205 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_FLOWLOG_H_
+#define ANDROID_INTROSPECTION_VPN_FLOWLOG_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "FlowTable.h"
+
+namespace ai::vpn {
+
+    //
+    // Log of flows in an append-only file of compact records, mapped into
+    // memory, for keeping what the tunnel carried over a long session
+    // without the weight of a capture: a flow takes one record once it is
+    // gone, plus one every interval while it is active, if set.  The file
+    // is of a fixed size, so that a full log only drops records, counted;
+    // reopening it appends to it.
+    //
+    // Layout, in native byte order, as FlowLogReader reads it:
+    //
+    //   0    magic, version and records offset, u32, capacity of the records
+    //        in bytes, u64
+    //   64   end of the records written so far, from the records offset, u64
+    //   128  records, each RECORD_ALIGNMENT aligned
+    //
+    // A record holds the size of the record, its fixed fields, and the
+    // name of the flow, e.g. from SNI or DNS, padded with zeros.  The end
+    // is stored after the records before it are written, with release.
+    // Records carry the traffic of their flow so far, so that the last
+    // record of a flow, flagged CLOSED if it is gone, holds all of it.
+    // Addresses are the 16 bytes of IpAddress in network order, ports are in
+    // host order, and the start time of a flow
+    // is wall clock time in milliseconds.
+    //
+    class FlowLog final {
+    public:
+        static constexpr uint32_t MAGIC = 0x464C5056;
+
+        static constexpr uint32_t VERSION = 2;
+
+        static constexpr size_t RECORD_ALIGNMENT = 8;
+
+        static constexpr size_t MAX_NAME_LENGTH = 255;
+
+        //
+        // Bytes of records of a new log, about a hundred thousand flows.
+        //
+        static constexpr uint64_t DEFAULT_CAPACITY = 8 * 1024 * 1024;
+
+        //
+        // Flags of a record.
+        //
+        static constexpr uint8_t CLOSED = 1U << 0U;
+
+        struct Header {
+
+            uint32_t magic = MAGIC;
+
+            uint32_t version = VERSION;
+
+            uint32_t recordsOffset = 0;
+
+            uint32_t reserved = 0;
+
+            uint64_t capacity = 0;
+
+            alignas(64) std::atomic_uint64_t end{0};
+        };
+
+        struct Record {
+
+            uint16_t size = 0;
+
+            uint8_t protocol = 0;
+
+            uint8_t flags = 0;
+
+            int32_t uid = UNKNOWN_UID;
+
+            IpAddress sourceAddress;
+
+            IpAddress destinationAddress;
+
+            uint16_t sourcePort = 0;
+
+            uint16_t destinationPort = 0;
+
+            //
+            // Milliseconds from the first to the last packet of the flow.
+            //
+            uint32_t duration = 0;
+
+            uint64_t startTime = 0;
+
+            uint64_t bytesSent = 0;
+
+            uint64_t bytesReceived = 0;
+
+            uint32_t packetsSent = 0;
+
+            uint32_t packetsReceived = 0;
+        };
+
+        static_assert(sizeof(Header) == 128 && sizeof(Record) == 80 && sizeof(Record) % RECORD_ALIGNMENT == 0);
+
+    private:
+        //
+        // Serializes opening, closing and appending, which only happens as
+        // flows end or at intervals, never per packet.
+        //
+        mutable std::mutex mutex_;
+
+        int fd_ = -1;
+
+        void *memory_ = nullptr;
+
+        size_t size_ = 0;
+
+        Header *header_ = nullptr;
+
+        //
+        // Wall clock time less the time flows are stamped with, both in
+        // milliseconds, as of opening the log.
+        //
+        int64_t wallClockOffset_ = 0;
+
+        std::atomic_bool enabled_{false};
+
+        std::atomic_uint64_t interval_{0};
+
+        std::atomic_uint64_t records_{0};
+
+        std::atomic_uint64_t droppedRecords_{0};
+
+        auto closeLocked() -> void;
+
+    public:
+        FlowLog() = default;
+
+        FlowLog(FlowLog const &) = delete;
+
+        auto operator=(FlowLog const &) -> FlowLog & = delete;
+
+        ~FlowLog();
+
+        //
+        // Appends to the log at the path from now on, creating it with room
+        // for capacity bytes of records if it does not exist, with a record
+        // of every active flow every interval milliseconds, or none if it is
+        // 0.  False, leaving the log closed, if the file cannot be mapped or
+        // is not a log of this version.  A log that is open is closed first.
+        // The time flows are stamped with is that of steady_clock.
+        //
+        auto open(std::string const &path, uint64_t interval, uint64_t capacity = DEFAULT_CAPACITY) -> bool;
+
+        //
+        // Closes the log, trimming the file to the records written.
+        //
+        auto close() -> void;
+
+        auto isEnabled() const -> bool { return enabled_.load(std::memory_order_relaxed); }
+
+        auto interval() const -> uint64_t { return interval_.load(std::memory_order_relaxed); }
+
+        //
+        // Appends a record of the flow, named as given, with the flags; false
+        // if the log is closed or full.  Any thread.
+        //
+        auto append(Flow const &flow, std::string_view name, uint8_t flags) -> bool;
+
+        //
+        // Counters of the log, one "name value" per line.
+        //
+        auto getStats() const -> std::string;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_FLOWLOG_H_ */
@@ -0,0 +1,208 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "FlowTable.h"
+
+using namespace ai;
+
+namespace {
+
+    //
+    // At most half of the slots hold a flow, so that probes rarely go past
+    // the first bucket.
+    //
+    constexpr size_t SLOTS_PER_FLOW = 2;
+
+    constexpr auto NOT_FOUND = std::pair<size_t, size_t>{SIZE_MAX, SIZE_MAX};
+
+    //
+    // Finalizer of MurmurHash3, so that flows differing in a port only still
+    // land in different buckets and shards.
+    //
+    auto mix(uint64_t value) -> uint64_t {
+        value ^= value >> 33U;
+        value *= 0xFF51AFD7ED558CCDULL;
+        value ^= value >> 33U;
+        value *= 0xC4CEB9FE1A85EC53ULL;
+        value ^= value >> 33U;
+        return value;
+    }
+}
+
+auto vpn::FlowKey::hash() const -> uint64_t {
+    auto const source = std::bit_cast<std::array<uint64_t, 2>>(sourceAddress);
+    auto const destination = std::bit_cast<std::array<uint64_t, 2>>(destinationAddress);
+    auto const ports = static_cast<uint64_t>(sourcePort) << 24U | static_cast<uint64_t>(destinationPort) << 8U | protocol;
+    //
+    // Upper halves are zeros for IPv4, whose keys then take two rounds as
+    // they did when they only held IPv4 addresses.
+    //
+    auto const upper = source[0] ^ std::rotl(destination[0], 32);
+    auto const lower = source[1] ^ std::rotl(destination[1], 32);
+    return mix(lower ^ mix(ports ^ (upper == 0 ? 0 : mix(upper))));
+}
+
+vpn::FlowTableShard::FlowTableShard(size_t const capacity)
+        : flows_(capacity), idleTimers_(std::make_unique<TimerWheel::Timer[]>(capacity)),
+          names_(std::make_unique<FlowNames[]>(capacity)) {
+    auto const bucketCount = std::bit_ceil(std::max<size_t>(1, capacity * SLOTS_PER_FLOW / BUCKET_SLOTS));
+    buckets_.resize(bucketCount);
+    bucketMask_ = bucketCount - 1;
+    freeFlows_.reserve(capacity);
+    for (auto index = capacity; index > 0; index--) {
+        freeFlows_.push_back(static_cast<uint32_t>(index - 1));
+    }
+}
+
+auto vpn::FlowTableShard::findSlot(FlowKey const &key, uint64_t const hash) const -> std::pair<size_t, size_t> {
+    auto const tag = std::max(static_cast<uint32_t>(hash >> 32U), FIRST_TAG);
+    for (size_t probe = 0, index = hash & bucketMask_; probe <= bucketMask_; probe++, index = (index + 1) & bucketMask_) {
+        auto const &bucket = buckets_[index];
+        for (size_t slot = 0; slot < BUCKET_SLOTS; slot++) {
+            if (bucket.tags[slot] == tag && flows_[bucket.flows[slot]].key == key) {
+                return {index, slot};
+            }
+            if (bucket.tags[slot] == EMPTY_TAG) {
+                return NOT_FOUND;
+            }
+        }
+    }
+    return NOT_FOUND;
+}
+
+auto vpn::FlowTableShard::find(FlowKey const &key) -> Flow * {
+    auto const [index, slot] = findSlot(key, key.hash());
+    if (index == NOT_FOUND.first) {
+        return nullptr;
+    }
+    return &flows_[buckets_[index].flows[slot]];
+}
+
+auto vpn::FlowTableShard::findOrInsert(FlowKey const &key) -> Flow * {
+    auto const hash = key.hash();
+    if (auto const [index, slot] = findSlot(key, hash); index != NOT_FOUND.first) {
+        return &flows_[buckets_[index].flows[slot]];
+    }
+    if (freeFlows_.empty()) {
+        return nullptr;
+    }
+    if (deletedSlots_ > buckets_.size() * BUCKET_SLOTS / 4) {
+        rebuild();
+    }
+
+    auto const tag = std::max(static_cast<uint32_t>(hash >> 32U), FIRST_TAG);
+    for (auto index = hash & bucketMask_;; index = (index + 1) & bucketMask_) {
+        auto &bucket = buckets_[index];
+        for (size_t slot = 0; slot < BUCKET_SLOTS; slot++) {
+            if (bucket.tags[slot] >= FIRST_TAG) {
+                continue;
+            }
+            if (bucket.tags[slot] == DELETED_TAG) {
+                deletedSlots_--;
+            }
+            auto const flowIndex = freeFlows_.back();
+            freeFlows_.pop_back();
+            flows_[flowIndex] = Flow();
+            flows_[flowIndex].key = key;
+            names_[flowIndex].serverName.clear();
+            names_[flowIndex].protocols.clear();
+            bucket.tags[slot] = tag;
+            bucket.flows[slot] = flowIndex;
+            return &flows_[flowIndex];
+        }
+    }
+}
+
+auto vpn::FlowTableShard::erase(FlowKey const &key) -> bool {
+    auto const [index, slot] = findSlot(key, key.hash());
+    if (index == NOT_FOUND.first) {
+        return false;
+    }
+    releaseSlot(buckets_[index], slot);
+    return true;
+}
+
+auto vpn::FlowTableShard::releaseSlot(Bucket &bucket, size_t const slot) -> void {
+    idleTimers_[bucket.flows[slot]].cancel();
+    freeFlows_.push_back(bucket.flows[slot]);
+    bucket.tags[slot] = DELETED_TAG;
+    deletedSlots_++;
+}
+
+//
+// Deleted slots keep probes going, so once there are many of them the live
+// flows are put back into clean buckets.
+//
+auto vpn::FlowTableShard::rebuild() -> void {
+    auto buckets = std::vector<Bucket>(buckets_.size());
+    for (auto const &bucket : buckets_) {
+        for (size_t slot = 0; slot < BUCKET_SLOTS; slot++) {
+            if (bucket.tags[slot] < FIRST_TAG) {
+                continue;
+            }
+            auto const hash = flows_[bucket.flows[slot]].key.hash();
+            for (auto index = hash & bucketMask_;; index = (index + 1) & bucketMask_) {
+                auto &target = buckets[index];
+                auto const free = std::find(target.tags.begin(), target.tags.end(), EMPTY_TAG);
+                if (free != target.tags.end()) {
+                    auto const freeSlot = static_cast<size_t>(free - target.tags.begin());
+                    target.tags[freeSlot] = bucket.tags[slot];
+                    target.flows[freeSlot] = bucket.flows[slot];
+                    break;
+                }
+            }
+        }
+    }
+    buckets_ = std::move(buckets);
+    deletedSlots_ = 0;
+}
+
+vpn::FlowTable::FlowTable(size_t const shardCount, size_t const flowsPerShard) {
+    shards_.reserve(shardCount);
+    for (size_t index = 0; index < shardCount; index++) {
+        shards_.emplace_back(flowsPerShard);
+    }
+}
+
+//
+// Uses other bits of the hash than the buckets of a shard do, so that the
+// flows of a shard still spread over all of its buckets.
+//
+auto vpn::FlowTable::shardIndex(FlowKey const &key) const -> size_t {
+    return static_cast<size_t>((key.hash() >> 32U) * shards_.size() >> 32U);
+}
+
+auto vpn::FlowTable::size() const -> size_t {
+    auto size = size_t{0};
+    for (auto const &shard : shards_) {
+        size += shard.size();
+    }
+    return size;
+}
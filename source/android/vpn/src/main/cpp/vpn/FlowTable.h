@@ -0,0 +1,332 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_FLOWTABLE_H_
+#define ANDROID_INTROSPECTION_VPN_FLOWTABLE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "IpAddress.h"
+#include "TimerWheel.h"
+
+namespace ai::vpn {
+
+    //
+    // 5-tuple of a flow as the tunnel sees it, i.e. with the device as the
+    // source; ports are in host order.
+    //
+    struct FlowKey {
+
+        IpAddress sourceAddress;
+
+        IpAddress destinationAddress;
+
+        uint16_t sourcePort = 0;
+
+        uint16_t destinationPort = 0;
+
+        uint8_t protocol = 0;
+
+        auto operator==(FlowKey const &) const -> bool = default;
+
+        auto hash() const -> uint64_t;
+    };
+
+    //
+    // Address and port a flow is translated to on its way out.
+    //
+    struct NatMapping {
+
+        IpAddress address;
+
+        uint16_t port = 0;
+    };
+
+    //
+    // Uid of a flow whose owner is not known, as Process.INVALID_UID.
+    //
+    constexpr int32_t UNKNOWN_UID = -1;
+
+    //
+    // Packets and bytes of a flow both ways, as the app sees them: sent
+    // into the tunnel and received back from it.
+    //
+    struct FlowTraffic {
+
+        uint64_t packetsSent = 0;
+
+        uint64_t bytesSent = 0;
+
+        uint64_t packetsReceived = 0;
+
+        uint64_t bytesReceived = 0;
+
+        auto isEmpty() const -> bool { return packetsSent == 0 && packetsReceived == 0; }
+
+        auto operator-(FlowTraffic const &other) const -> FlowTraffic {
+            return {packetsSent - other.packetsSent, bytesSent - other.bytesSent, packetsReceived - other.packetsReceived,
+                    bytesReceived - other.bytesReceived};
+        }
+
+        auto operator+=(FlowTraffic const &other) -> FlowTraffic & {
+            packetsSent += other.packetsSent;
+            bytesSent += other.bytesSent;
+            packetsReceived += other.packetsReceived;
+            bytesReceived += other.bytesReceived;
+            return *this;
+        }
+    };
+
+    //
+    // Names a flow was opened with, as read from its first bytes, e.g. from
+    // the ClientHello of TLS.
+    //
+    struct FlowNames {
+
+        //
+        // Host the app asked for, e.g. through SNI, empty if it named none.
+        //
+        std::string serverName;
+
+        //
+        // Protocols the app offered, e.g. through ALPN, separated by commas.
+        //
+        std::string protocols;
+    };
+
+    struct Flow {
+
+        FlowKey key;
+
+        //
+        // Packets and bytes the app sent into the tunnel.
+        //
+        uint64_t packets = 0;
+
+        uint64_t bytes = 0;
+
+        //
+        // Packets and bytes written back to the app.
+        //
+        uint64_t receivedPackets = 0;
+
+        uint64_t receivedBytes = 0;
+
+        //
+        // Time of the first and last packet, in the units the owner of the
+        // table uses to expire flows.
+        //
+        uint64_t firstActive = 0;
+
+        uint64_t lastActive = 0;
+
+        NatMapping nat;
+
+        //
+        // Upstream socket of the flow, -1 until it has one.  The table never
+        // closes it; whoever erases or expires the flow does.
+        //
+        int socket = -1;
+
+        //
+        // Uid of the app owning the flow, UNKNOWN_UID until it is attributed
+        // or if it cannot be.
+        //
+        int32_t uid = UNKNOWN_UID;
+
+        //
+        // Whether the first bytes of the flow were looked at for its names,
+        // so that the rest of them are not, or are not to be, e.g. as the
+        // flow was filtered out of inspection.
+        //
+        bool isInspected = false;
+
+        //
+        // Traffic of the flow as of its last stats report, so that the next
+        // one only carries what came since.
+        //
+        FlowTraffic reported;
+
+        auto traffic() const -> FlowTraffic { return {packets, bytes, receivedPackets, receivedBytes}; }
+    };
+
+    //
+    // Open addressing table of a fixed number of flows, with buckets of a
+    // cache line holding the tags of eight flows, so that a lookup usually
+    // reads one bucket and one flow.  A shard is owned by one thread and
+    // takes no locks; it does not allocate after it is constructed, except
+    // when rebuilt to clear deleted entries.
+    //
+    class FlowTableShard final {
+
+        static constexpr size_t BUCKET_SLOTS = 8;
+
+        struct alignas(64) Bucket {
+
+            //
+            // Upper bits of the hash of each flow, or one of the markers below.
+            //
+            std::array<uint32_t, BUCKET_SLOTS> tags{};
+
+            std::array<uint32_t, BUCKET_SLOTS> flows{};
+        };
+
+        static_assert(sizeof(Bucket) == 64);
+
+        static constexpr uint32_t EMPTY_TAG = 0;
+
+        static constexpr uint32_t DELETED_TAG = 1;
+
+        static constexpr uint32_t FIRST_TAG = 2;
+
+        std::vector<Bucket> buckets_;
+
+        size_t bucketMask_ = 0;
+
+        std::vector<Flow> flows_;
+
+        //
+        // Idle timer of each flow, kept out of the flows, which the packet
+        // path reads, as timers are only touched when they fire.
+        //
+        std::unique_ptr<TimerWheel::Timer[]> idleTimers_;
+
+        //
+        // Names of each flow, kept out of the flows for the same reason; they
+        // are cleared rather than freed when a flow is erased.
+        //
+        std::unique_ptr<FlowNames[]> names_;
+
+        std::vector<uint32_t> freeFlows_;
+
+        size_t deletedSlots_ = 0;
+
+        auto findSlot(FlowKey const &key, uint64_t hash) const -> std::pair<size_t, size_t>;
+
+        auto releaseSlot(Bucket &bucket, size_t slot) -> void;
+
+        auto rebuild() -> void;
+
+    public:
+        explicit FlowTableShard(size_t capacity);
+
+        FlowTableShard(FlowTableShard &&) = default;
+
+        auto operator=(FlowTableShard &&) -> FlowTableShard & = default;
+
+        //
+        // Flow with the key, nullptr if there is none.
+        //
+        auto find(FlowKey const &key) -> Flow *;
+
+        //
+        // Same as above, adding the flow if there is none; nullptr only when
+        // the shard is full, which callers treat as back pressure.
+        //
+        auto findOrInsert(FlowKey const &key) -> Flow *;
+
+        //
+        // Erases the flow with the key, cancelling its idle timer.
+        //
+        auto erase(FlowKey const &key) -> bool;
+
+        //
+        // Timer of a flow of the shard, for its owner to expire it by.
+        //
+        auto idleTimer(Flow const &flow) -> TimerWheel::Timer & { return idleTimers_[static_cast<size_t>(&flow - flows_.data())]; }
+
+        //
+        // Names of a flow of the shard, empty until they were read.
+        //
+        auto names(Flow const &flow) -> FlowNames & { return names_[static_cast<size_t>(&flow - flows_.data())]; }
+
+        //
+        // Erases every flow last active before the cutoff, handing each one
+        // to onExpired first, e.g. to close its socket.
+        //
+        template<typename OnExpired>
+        auto expire(uint64_t const cutoff, OnExpired &&onExpired) -> size_t {
+            auto expired = size_t{0};
+            for (auto &bucket : buckets_) {
+                for (size_t slot = 0; slot < BUCKET_SLOTS; slot++) {
+                    if (bucket.tags[slot] < FIRST_TAG) {
+                        continue;
+                    }
+                    auto &flow = flows_[bucket.flows[slot]];
+                    if (flow.lastActive < cutoff) {
+                        onExpired(flow);
+                        releaseSlot(bucket, slot);
+                        expired++;
+                    }
+                }
+            }
+            return expired;
+        }
+
+        //
+        // Hands every flow of the shard to onFlow, in no particular order.
+        //
+        template<typename OnFlow>
+        auto forEach(OnFlow &&onFlow) -> void {
+            for (auto const &bucket : buckets_) {
+                for (size_t slot = 0; slot < BUCKET_SLOTS; slot++) {
+                    if (bucket.tags[slot] >= FIRST_TAG) {
+                        onFlow(flows_[bucket.flows[slot]]);
+                    }
+                }
+            }
+        }
+
+        auto size() const -> size_t { return flows_.size() - freeFlows_.size(); }
+
+        auto capacity() const -> size_t { return flows_.size(); }
+    };
+
+    //
+    // Flows split into shards by the hash of their key, one per worker, so
+    // that each worker looks up and updates its flows without locking.
+    //
+    class FlowTable final {
+
+        std::vector<FlowTableShard> shards_;
+
+    public:
+        FlowTable(size_t shardCount, size_t flowsPerShard);
+
+        auto shardCount() const -> size_t { return shards_.size(); }
+
+        auto shardIndex(FlowKey const &key) const -> size_t;
+
+        auto shard(size_t const index) -> FlowTableShard & { return shards_[index]; }
+
+        auto size() const -> size_t;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_FLOWTABLE_H_ */
@@ -0,0 +1,360 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <atomic>
+#include <string_view>
+
+#include "HttpParser.h"
+
+using namespace ai;
+
+namespace {
+
+    constexpr size_t MAX_METHOD_SIZE = 16;
+
+    constexpr size_t MAX_FIELD_SIZE = 256;
+
+    //
+    // Longest header name cared about is shorter.
+    //
+    constexpr size_t MAX_NAME_SIZE = 32;
+
+    //
+    // Most a request line and headers may take, past which the stream is
+    // taken not to be HTTP.
+    //
+    constexpr size_t MAX_HEADERS_SIZE = 32 * 1024;
+
+    //
+    // Most a chunk may be, so that its size does not overflow.
+    //
+    constexpr uint64_t MAX_CHUNK_SIZE = uint64_t{1} << 48U;
+
+    std::atomic_uint64_t gRequests{0};
+
+    std::atomic_uint64_t gErrors{0};
+
+    auto toLower(uint8_t const byte) -> char {
+        return static_cast<char>(byte >= 'A' && byte <= 'Z' ? byte - 'A' + 'a' : byte);
+    }
+
+    auto isTokenChar(uint8_t const byte) -> bool {
+        return (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') ||
+               std::string_view("!#$%&'*+-.^_`|~").find(static_cast<char>(byte)) != std::string_view::npos;
+    }
+
+    auto isMethodChar(uint8_t const byte) -> bool {
+        return (byte >= 'A' && byte <= 'Z') || byte == '-' || byte == '_';
+    }
+
+    auto hexValue(uint8_t const byte) -> int {
+        if (byte >= '0' && byte <= '9') {
+            return byte - '0';
+        }
+        if (byte >= 'a' && byte <= 'f') {
+            return byte - 'a' + 10;
+        }
+        if (byte >= 'A' && byte <= 'F') {
+            return byte - 'A' + 10;
+        }
+        return -1;
+    }
+
+    auto append(std::string &field, size_t const maxSize, uint8_t const byte) -> void {
+        if (field.size() < maxSize) {
+            field.push_back(static_cast<char>(byte));
+        }
+    }
+}
+
+auto vpn::HttpParser::parse(std::span<uint8_t const> const bytes) -> size_t {
+    auto used = size_t{0};
+    while (used < bytes.size() && state_ != State::Stopped && !hasRequest_) {
+        if (state_ == State::Body || state_ == State::ChunkData) {
+            auto const skipped = static_cast<size_t>(std::min<uint64_t>(bodyLeft_, bytes.size() - used));
+            used += skipped;
+            bodyLeft_ -= skipped;
+            if (bodyLeft_ == 0) {
+                state_ = state_ == State::Body ? State::RequestLine : State::ChunkDataEnd;
+            }
+            continue;
+        }
+        parse(bytes[used++]);
+    }
+    return state_ == State::Stopped ? bytes.size() : used;
+}
+
+auto vpn::HttpParser::takeRequest() -> HttpRequest const * {
+    if (!hasRequest_) {
+        return nullptr;
+    }
+    hasRequest_ = false;
+    return &request_;
+}
+
+auto vpn::HttpParser::isRequest(std::span<uint8_t const> const bytes) -> bool {
+    for (size_t i = 0; i < std::min(bytes.size(), MAX_METHOD_SIZE + 1); i++) {
+        if (bytes[i] == ' ') {
+            return i > 0;
+        }
+        if (!isMethodChar(bytes[i])) {
+            return false;
+        }
+    }
+    return !bytes.empty() && bytes.size() <= MAX_METHOD_SIZE;
+}
+
+auto vpn::HttpParser::stop() -> void {
+    gErrors.fetch_add(1, std::memory_order_relaxed);
+    state_ = State::Stopped;
+}
+
+auto vpn::HttpParser::parse(uint8_t const byte) -> void {
+    if (state_ < State::Body && ++headerBytes_ > MAX_HEADERS_SIZE) {
+        stop();
+        return;
+    }
+    switch (state_) {
+        case State::RequestLine:
+            //
+            // Empty lines before a request are allowed.
+            //
+            if (byte == '\r' || byte == '\n') {
+                break;
+            }
+            if (!isMethodChar(byte)) {
+                stop();
+                break;
+            }
+            request_.method.clear();
+            request_.path.clear();
+            request_.host.clear();
+            request_.userAgent.clear();
+            request_.contentType.clear();
+            request_.method.push_back(static_cast<char>(byte));
+            headerBytes_ = 1;
+            bodyLeft_ = 0;
+            isChunked_ = false;
+            isUpgrade_ = false;
+            state_ = State::Method;
+            break;
+
+        case State::Method:
+            if (byte == ' ') {
+                state_ = State::Path;
+            } else if (isMethodChar(byte) && request_.method.size() < MAX_METHOD_SIZE) {
+                request_.method.push_back(static_cast<char>(byte));
+            } else {
+                stop();
+            }
+            break;
+
+        case State::Path:
+            if (byte == ' ') {
+                token_.clear();
+                state_ = State::Version;
+            } else if (byte == '\r' || byte == '\n') {
+                stop();
+            } else {
+                append(request_.path, MAX_FIELD_SIZE, byte);
+            }
+            break;
+
+        case State::Version:
+            if (byte == '\n') {
+                if (!token_.starts_with("HTTP/1.")) {
+                    stop();
+                    break;
+                }
+                state_ = State::HeaderLineStart;
+            } else if (byte != '\r') {
+                append(token_, MAX_NAME_SIZE, byte);
+            }
+            break;
+
+        case State::HeaderLineStart:
+            if (byte == '\n') {
+                endHeaders();
+            } else if (byte == ' ' || byte == '\t') {
+                //
+                // Values folded over lines are obsolete; they are skipped.
+                //
+                header_ = Header::Other;
+                state_ = State::HeaderValue;
+            } else if (isTokenChar(byte)) {
+                token_.assign(1, toLower(byte));
+                state_ = State::HeaderName;
+            } else if (byte != '\r') {
+                stop();
+            }
+            break;
+
+        case State::HeaderName:
+            if (byte == ':') {
+                endHeaderName();
+                value_.clear();
+                state_ = State::HeaderValue;
+            } else if (isTokenChar(byte)) {
+                if (token_.size() < MAX_NAME_SIZE) {
+                    token_.push_back(toLower(byte));
+                }
+            } else {
+                stop();
+            }
+            break;
+
+        case State::HeaderValue:
+            if (byte == '\n') {
+                endHeaderValue();
+                state_ = State::HeaderLineStart;
+            } else if (header_ != Header::Other && byte != '\r' && (!value_.empty() || (byte != ' ' && byte != '\t'))) {
+                append(value_, MAX_FIELD_SIZE, byte);
+            }
+            break;
+
+        case State::ChunkSize:
+            if (auto const value = hexValue(byte); value >= 0) {
+                bodyLeft_ = bodyLeft_ * 16 + static_cast<uint64_t>(value);
+                if (bodyLeft_ > MAX_CHUNK_SIZE) {
+                    stop();
+                }
+            } else if (byte == ';' || byte == ' ' || byte == '\t') {
+                state_ = State::ChunkExtension;
+            } else if (byte == '\n') {
+                endChunkSize();
+            } else if (byte != '\r') {
+                stop();
+            }
+            break;
+
+        case State::ChunkExtension:
+            if (byte == '\n') {
+                endChunkSize();
+            }
+            break;
+
+        case State::ChunkDataEnd:
+            if (byte == '\n') {
+                bodyLeft_ = 0;
+                state_ = State::ChunkSize;
+            } else if (byte != '\r') {
+                stop();
+            }
+            break;
+
+        case State::Body:
+        case State::ChunkData:
+        case State::Stopped:
+            break;
+    }
+}
+
+auto vpn::HttpParser::endHeaderName() -> void {
+    header_ = Header::Other;
+    if (isTrailer_) {
+        return;
+    }
+    if (token_ == "host") {
+        header_ = Header::Host;
+    } else if (token_ == "user-agent") {
+        header_ = Header::UserAgent;
+    } else if (token_ == "content-type") {
+        header_ = Header::ContentType;
+    } else if (token_ == "content-length") {
+        header_ = Header::ContentLength;
+    } else if (token_ == "transfer-encoding") {
+        header_ = Header::TransferEncoding;
+    } else if (token_ == "upgrade") {
+        header_ = Header::Upgrade;
+    }
+}
+
+auto vpn::HttpParser::endHeaderValue() -> void {
+    while (!value_.empty() && (value_.back() == ' ' || value_.back() == '\t')) {
+        value_.pop_back();
+    }
+    switch (header_) {
+        case Header::Host:
+            request_.host = value_;
+            break;
+        case Header::UserAgent:
+            request_.userAgent = value_;
+            break;
+        case Header::ContentType:
+            request_.contentType = value_;
+            break;
+        case Header::ContentLength:
+            if (value_.empty() || value_.size() > 15 || !std::ranges::all_of(value_, [](char const c) { return c >= '0' && c <= '9'; })) {
+                stop();
+                break;
+            }
+            bodyLeft_ = std::stoull(value_);
+            break;
+        case Header::TransferEncoding:
+            std::ranges::transform(value_, value_.begin(), [](char const c) { return toLower(static_cast<uint8_t>(c)); });
+            isChunked_ = value_.ends_with("chunked");
+            break;
+        case Header::Upgrade:
+            isUpgrade_ = true;
+            break;
+        case Header::Other:
+            break;
+    }
+}
+
+auto vpn::HttpParser::endHeaders() -> void {
+    if (isTrailer_) {
+        isTrailer_ = false;
+        state_ = State::RequestLine;
+        return;
+    }
+
+    gRequests.fetch_add(1, std::memory_order_relaxed);
+    hasRequest_ = true;
+    if (request_.method == "CONNECT" || isUpgrade_) {
+        //
+        // What follows may be anything once the server agreed.
+        //
+        state_ = State::Stopped;
+    } else if (isChunked_) {
+        bodyLeft_ = 0;
+        state_ = State::ChunkSize;
+    } else {
+        state_ = bodyLeft_ > 0 ? State::Body : State::RequestLine;
+    }
+}
+
+auto vpn::HttpParser::endChunkSize() -> void {
+    if (bodyLeft_ == 0) {
+        isTrailer_ = true;
+        state_ = State::HeaderLineStart;
+    } else {
+        state_ = State::ChunkData;
+    }
+}
+
+auto vpn::getHttpStats() -> std::string {
+    return "http.requests " + std::to_string(gRequests.load(std::memory_order_relaxed)) + "\n" +
+           "http.errors " + std::to_string(gErrors.load(std::memory_order_relaxed)) + "\n";
+}
@@ -0,0 +1,157 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_HTTPPARSER_H_
+#define ANDROID_INTROSPECTION_VPN_HTTPPARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace ai::vpn {
+
+    //
+    // What is kept of a request, each field cut to a few hundred bytes at
+    // most and empty if the request did not have it.
+    //
+    struct HttpRequest {
+
+        std::string method;
+
+        std::string path;
+
+        std::string host;
+
+        std::string userAgent;
+
+        std::string contentType;
+    };
+
+    //
+    // Parses the HTTP/1.x requests of a stream as its bytes come, in pieces
+    // of any size: the request line and the headers are read one byte after
+    // the other, keeping only the fields of HttpRequest, and bodies, sized
+    // or chunked, are skipped over without being looked at.  Once something
+    // is not HTTP, e.g. after a CONNECT or an upgrade, the parser stops and
+    // ignores the rest of the stream.
+    //
+    class HttpParser final {
+
+        enum class State {
+            RequestLine,
+            Method,
+            Path,
+            Version,
+            HeaderLineStart,
+            HeaderName,
+            HeaderValue,
+            Body,
+            ChunkSize,
+            ChunkExtension,
+            ChunkData,
+            ChunkDataEnd,
+            Stopped,
+        };
+
+        //
+        // Header the value being read belongs to.
+        //
+        enum class Header {
+            Other,
+            Host,
+            UserAgent,
+            ContentType,
+            ContentLength,
+            TransferEncoding,
+            Upgrade,
+        };
+
+        State state_ = State::RequestLine;
+
+        Header header_ = Header::Other;
+
+        HttpRequest request_;
+
+        //
+        // Version, and name and value of the header being read, of the few
+        // headers whose value matters.
+        //
+        std::string token_;
+
+        std::string value_;
+
+        size_t headerBytes_ = 0;
+
+        uint64_t bodyLeft_ = 0;
+
+        bool isChunked_ = false;
+
+        bool isTrailer_ = false;
+
+        bool isUpgrade_ = false;
+
+        bool hasRequest_ = false;
+
+        auto stop() -> void;
+
+        auto endHeaderName() -> void;
+
+        auto endHeaderValue() -> void;
+
+        auto endHeaders() -> void;
+
+        auto endChunkSize() -> void;
+
+        auto parse(uint8_t byte) -> void;
+
+    public:
+        //
+        // Parses the bytes up to the end of the headers of a request, for
+        // takeRequest() to return, and returns how many it used.
+        //
+        auto parse(std::span<uint8_t const> bytes) -> size_t;
+
+        //
+        // Request whose headers parse() just finished reading, nullptr if it
+        // did not finish any since it was last called.
+        //
+        auto takeRequest() -> HttpRequest const *;
+
+        auto isStopped() const -> bool { return state_ == State::Stopped; }
+
+        //
+        // Whether bytes starting a stream look like the start of a request,
+        // which the parser is only worth running for.
+        //
+        static auto isRequest(std::span<uint8_t const> bytes) -> bool;
+    };
+
+    //
+    // Requests parsed since the library was loaded, one "name value" per
+    // line.
+    //
+    auto getHttpStats() -> std::string;
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_HTTPPARSER_H_ */
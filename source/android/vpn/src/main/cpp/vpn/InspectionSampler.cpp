@@ -0,0 +1,140 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <ctime>
+
+#include "utils/log.h"
+#include "InspectionSampler.h"
+#include "PacketHeaders.h"
+
+using namespace ai;
+
+namespace {
+
+    std::atomic_uint64_t gSampledPackets{0};
+
+    std::atomic_uint64_t gSkippedPackets{0};
+
+    //
+    // Nanoseconds of CPU time every thread of the process took.
+    //
+    auto getCpuTime() -> uint64_t {
+        auto time = timespec{};
+        if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0) {
+            return 0;
+        }
+        return static_cast<uint64_t>(time.tv_sec) * 1'000'000'000 + static_cast<uint64_t>(time.tv_nsec);
+    }
+}
+
+vpn::InspectionSampler::InspectionSampler(uint32_t const budget, uint64_t const fullBytes) : budget_(budget), fullBytes_(fullBytes) {
+}
+
+auto vpn::InspectionSampler::setBudget(uint32_t const budget, uint64_t const fullBytes) -> void {
+    budget_.store(budget, std::memory_order_relaxed);
+    fullBytes_.store(fullBytes, std::memory_order_relaxed);
+    if (budget == 0) {
+        rate_.store(1, std::memory_order_relaxed);
+    }
+}
+
+auto vpn::InspectionSampler::shouldInspect(uint64_t const bytes, uint64_t const packets) const -> bool {
+    auto const rate = rate_.load(std::memory_order_relaxed);
+    if (rate == 1 || bytes <= fullBytes_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    auto const isSampled = (packets & (rate - 1)) == 0;
+    (isSampled ? gSampledPackets : gSkippedPackets).fetch_add(1, std::memory_order_relaxed);
+    return isSampled;
+}
+
+auto vpn::InspectionSampler::shouldFollow(uint64_t const bytes) const -> bool {
+    return rate_.load(std::memory_order_relaxed) == 1 || bytes <= fullBytes_.load(std::memory_order_relaxed);
+}
+
+//
+// The rate moves by one step an interval, so that a burst drawing the CPU
+// time over the budget for a moment does not sample the flows for long.
+//
+auto vpn::InspectionSampler::update(uint64_t const now) -> void {
+    if (intervalStart_ != 0 && now - intervalStart_ < INTERVAL) {
+        return;
+    }
+    auto const cpuTime = getCpuTime();
+    if (intervalStart_ != 0 && now > intervalStart_) {
+        auto const usage = static_cast<uint32_t>((cpuTime - cpuTimeAtStart_) / ((now - intervalStart_) * 10'000));
+        usage_.store(usage, std::memory_order_relaxed);
+        auto const budget = budget_.load(std::memory_order_relaxed);
+        auto const rate = rate_.load(std::memory_order_relaxed);
+        auto newRate = rate;
+        if (budget == 0) {
+            newRate = 1;
+        } else if (usage > budget) {
+            newRate = std::min(rate * 2, MAX_RATE);
+        } else if (usage < budget * 3 / 4) {
+            newRate = std::max(rate / 2, uint32_t{1});
+        }
+        if (newRate != rate) {
+            LOGI("update inspecting 1 in %u packets past the first bytes, at %u%% of a core for a budget of %u%%", newRate, usage, budget);
+            rate_.store(newRate, std::memory_order_relaxed);
+        }
+    }
+    intervalStart_ = now;
+    cpuTimeAtStart_ = cpuTime;
+}
+
+auto vpn::InspectionSampler::getStats() const -> std::string {
+    return "inspection.rate " + std::to_string(rate_.load(std::memory_order_relaxed)) + "\n" +
+           "inspection.cpu " + std::to_string(usage_.load(std::memory_order_relaxed)) + "\n" +
+           "inspection.sampled " + std::to_string(gSampledPackets.load(std::memory_order_relaxed)) + "\n" +
+           "inspection.skipped " + std::to_string(gSkippedPackets.load(std::memory_order_relaxed)) + "\n";
+}
+
+//
+// Only flows past their first bytes need counting while the rate is 1, but
+// flows are counted all along, so that a rate going up samples the flows
+// that were there already.
+//
+auto vpn::SampledFlows::shouldInspect(InspectionSampler const &sampler, std::span<uint8_t const> const packet) -> bool {
+    auto const ipHeader = IpHeader::parse(packet);
+    if (!ipHeader) {
+        return true;
+    }
+    auto key = FlowKey{ipHeader->sourceAddress(), ipHeader->destinationAddress(), 0, 0, ipHeader->protocol()};
+    if (auto const tcpHeader = TcpHeader::parse(*ipHeader)) {
+        key.sourcePort = tcpHeader->sourcePort();
+        key.destinationPort = tcpHeader->destinationPort();
+    } else if (auto const udpHeader = UdpHeader::parse(*ipHeader)) {
+        key.sourcePort = udpHeader->sourcePort();
+        key.destinationPort = udpHeader->destinationPort();
+    }
+    auto const hash = key.hash();
+    auto &entry = entries_[hash & (SIZE - 1)];
+    if (entry.hash != hash) {
+        entry = Entry{hash, 0, 0};
+    }
+    entry.bytes += packet.size();
+    entry.packets++;
+    return sampler.shouldInspect(entry.bytes, entry.packets);
+}
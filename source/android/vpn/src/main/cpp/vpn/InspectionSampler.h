@@ -0,0 +1,172 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_INSPECTIONSAMPLER_H_
+#define ANDROID_INTROSPECTION_VPN_INSPECTIONSAMPLER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "FlowTable.h"
+
+namespace ai::vpn {
+
+    //
+    // Bounds the CPU time deep inspection takes under heavy load.  The
+    // headers of every packet are always accounted for, but what costs
+    // more, i.e. capturing packets and parsing the HTTP requests of a flow,
+    // is done on the first bytes of every flow and then only on 1 in rate
+    // of its packets.  The reader measures the CPU time of the process at
+    // every interval and doubles the rate while it is over the budget, and
+    // halves it once it is well under; the rate is 1 for as long as the
+    // process keeps within the budget, which is the common case.  Names
+    // read from the ClientHello of a flow are unaffected, as it comes with
+    // the first bytes.
+    //
+    class InspectionSampler final {
+
+        std::atomic_uint32_t budget_;
+
+        std::atomic_uint64_t fullBytes_;
+
+        std::atomic_uint32_t rate_{1};
+
+        std::atomic_uint32_t usage_{0};
+
+        //
+        // Only used by the reader.
+        //
+        uint64_t intervalStart_ = 0;
+
+        uint64_t cpuTimeAtStart_ = 0;
+
+    public:
+        //
+        // Percent of one core the process is kept under by default, and bytes
+        // of every flow inspected whatever the rate.
+        //
+        static constexpr uint32_t DEFAULT_BUDGET = 50;
+
+        static constexpr uint64_t DEFAULT_FULL_BYTES = 64 * 1024;
+
+        //
+        // Most packets the one inspected of a flow stands for, a power of 2
+        // as the rate always is.
+        //
+        static constexpr uint32_t MAX_RATE = 1024;
+
+        //
+        // Milliseconds the CPU time is measured over.
+        //
+        static constexpr uint64_t INTERVAL = 1'000;
+
+        explicit InspectionSampler(uint32_t budget = DEFAULT_BUDGET, uint64_t fullBytes = DEFAULT_FULL_BYTES);
+
+        InspectionSampler(InspectionSampler const &) = delete;
+
+        auto operator=(InspectionSampler const &) -> InspectionSampler & = delete;
+
+        //
+        // Keeps the process under the percent of one core from here on, or
+        // inspects every packet if it is 0, and inspects the first fullBytes
+        // of every flow whatever the rate.  Any thread.
+        //
+        auto setBudget(uint32_t budget, uint64_t fullBytes) -> void;
+
+        auto rate() const -> uint32_t { return rate_.load(std::memory_order_relaxed); }
+
+        //
+        // Whether the packet of a flow that came to the bytes and the packets,
+        // it included, is to be inspected.  Any thread.
+        //
+        auto shouldInspect(uint64_t bytes, uint64_t packets) const -> bool;
+
+        auto shouldInspect(Flow const &flow) const -> bool {
+            return shouldInspect(flow.bytes + flow.receivedBytes, flow.packets + flow.receivedPackets);
+        }
+
+        //
+        // Whether a stream of a flow that came to the bytes is to be parsed
+        // on, for parsers that can not skip packets, i.e. whether the rate is
+        // 1 or the bytes are among the first.  Any thread.
+        //
+        auto shouldFollow(uint64_t bytes) const -> bool;
+
+        auto shouldFollow(Flow const &flow) const -> bool { return shouldFollow(flow.bytes + flow.receivedBytes); }
+
+        //
+        // Measures the CPU time of the process once an interval passed since
+        // the last time in milliseconds, and adapts the rate.  Reader only.
+        //
+        auto update(uint64_t now) -> void;
+
+        //
+        // Rate, percent of a core the process last took, and packets past
+        // the first bytes of their flows inspected and skipped since the
+        // library was loaded, one "name value" per line.
+        //
+        auto getStats() const -> std::string;
+    };
+
+    //
+    // Bytes and packets of the flows of the packets one thread sees, for
+    // those that keep no flows, e.g. the reader and the writer, to sample
+    // them.  Flows are counted in a table indexed by their hash, each entry
+    // counting the latest flow to take it; a flow losing its entry starts
+    // over, as if new.  Packets of both ways of a flow are counted apart.
+    // Single thread.
+    //
+    class SampledFlows final {
+
+        struct Entry {
+
+            uint64_t hash = 0;
+
+            uint64_t bytes = 0;
+
+            uint64_t packets = 0;
+        };
+
+        std::vector<Entry> entries_;
+
+    public:
+        //
+        // Flows counted at a time, a power of 2.
+        //
+        static constexpr size_t SIZE = 4'096;
+
+        SampledFlows() : entries_(SIZE) {}
+
+        //
+        // Counts the packet to its flow, whether it is to be inspected.
+        // Packets whose headers can not be read always are.
+        //
+        auto shouldInspect(InspectionSampler const &sampler, std::span<uint8_t const> packet) -> bool;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_INSPECTIONSAMPLER_H_ */
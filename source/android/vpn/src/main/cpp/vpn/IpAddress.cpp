@@ -0,0 +1,72 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+
+#include "IpAddress.h"
+
+using namespace ai;
+
+static_assert(INET6_ADDRSTRLEN == 46);
+
+auto vpn::IpAddress::format() const -> std::array<char, 46> {
+    auto text = std::array<char, 46>{};
+    if (isIpv4()) {
+        auto const address = in_addr{htonl(toIpv4())};
+        inet_ntop(AF_INET, &address, text.data(), text.size());
+    } else {
+        inet_ntop(AF_INET6, bytes_.data(), text.data(), text.size());
+    }
+    return text;
+}
+
+vpn::SocketAddress::SocketAddress(IpAddress const &address, uint16_t const port) {
+    if (address.isIpv4()) {
+        auto *const ipv4 = reinterpret_cast<sockaddr_in *>(&storage);
+        ipv4->sin_family = AF_INET;
+        ipv4->sin_port = htons(port);
+        ipv4->sin_addr.s_addr = htonl(address.toIpv4());
+        length = sizeof(sockaddr_in);
+    } else {
+        auto *const ipv6 = reinterpret_cast<sockaddr_in6 *>(&storage);
+        ipv6->sin6_family = AF_INET6;
+        ipv6->sin6_port = htons(port);
+        std::memcpy(&ipv6->sin6_addr, address.bytes().data(), IpAddress::SIZE);
+        length = sizeof(sockaddr_in6);
+    }
+}
+
+auto vpn::SocketAddress::parse(sockaddr_storage const &storage) -> std::optional<std::pair<IpAddress, uint16_t>> {
+    if (storage.ss_family == AF_INET) {
+        auto const *const ipv4 = reinterpret_cast<sockaddr_in const *>(&storage);
+        return std::pair(IpAddress::ipv4(ntohl(ipv4->sin_addr.s_addr)), ntohs(ipv4->sin_port));
+    }
+    if (storage.ss_family == AF_INET6) {
+        auto const *const ipv6 = reinterpret_cast<sockaddr_in6 const *>(&storage);
+        auto const bytes = std::span<uint8_t const, IpAddress::SIZE>(reinterpret_cast<uint8_t const *>(&ipv6->sin6_addr), IpAddress::SIZE);
+        return std::pair(IpAddress::ipv6(bytes), ntohs(ipv6->sin6_port));
+    }
+    return std::nullopt;
+}
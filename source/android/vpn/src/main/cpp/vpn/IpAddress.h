@@ -0,0 +1,141 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_IPADDRESS_H_
+#define ANDROID_INTROSPECTION_VPN_IPADDRESS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <sys/socket.h>
+#include <utility>
+
+namespace ai::vpn {
+
+    //
+    // Address of IPv4 or IPv6 in one layout, the 16 bytes of an IPv6
+    // address in network order with IPv4 addresses mapped to
+    // ::ffff:a.b.c.d, so that the flows of both share keys and the fast
+    // path, and InetAddress.getByAddress() takes either as they are.
+    //
+    class IpAddress final {
+
+        alignas(8) std::array<uint8_t, 16> bytes_{};
+
+        static constexpr std::array<uint8_t, 12> IPV4_PREFIX = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+
+    public:
+        static constexpr size_t SIZE = 16;
+
+        constexpr IpAddress() = default;
+
+        //
+        // IPv4 address in host order.
+        //
+        static constexpr auto ipv4(uint32_t const address) -> IpAddress {
+            auto result = IpAddress();
+            result.bytes_[10] = 0xFF;
+            result.bytes_[11] = 0xFF;
+            result.bytes_[12] = static_cast<uint8_t>(address >> 24U);
+            result.bytes_[13] = static_cast<uint8_t>(address >> 16U);
+            result.bytes_[14] = static_cast<uint8_t>(address >> 8U);
+            result.bytes_[15] = static_cast<uint8_t>(address);
+            return result;
+        }
+
+        //
+        // IPv6 address in network order.
+        //
+        static constexpr auto ipv6(std::span<uint8_t const, SIZE> const bytes) -> IpAddress {
+            auto result = IpAddress();
+            for (size_t i = 0; i < SIZE; i++) {
+                result.bytes_[i] = bytes[i];
+            }
+            return result;
+        }
+
+        constexpr auto isIpv4() const -> bool {
+            for (size_t i = 0; i < IPV4_PREFIX.size(); i++) {
+                if (bytes_[i] != IPV4_PREFIX[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        //
+        // Address in host order of an address that isIpv4().
+        //
+        constexpr auto toIpv4() const -> uint32_t {
+            return static_cast<uint32_t>(bytes_[12]) << 24U | static_cast<uint32_t>(bytes_[13]) << 16U |
+                   static_cast<uint32_t>(bytes_[14]) << 8U | bytes_[15];
+        }
+
+        constexpr auto bytes() const -> std::span<uint8_t const, SIZE> { return bytes_; }
+
+        constexpr auto operator==(IpAddress const &) const -> bool = default;
+
+        //
+        // AF_INET or AF_INET6, as sockets to the address are created with.
+        //
+        constexpr auto family() const -> int { return isIpv4() ? AF_INET : AF_INET6; }
+
+        //
+        // Dotted or colon form of the address, for logs.
+        //
+        auto format() const -> std::array<char, 46>;
+    };
+
+    static_assert(sizeof(IpAddress) == IpAddress::SIZE);
+
+    //
+    // Address of a socket of either family, as connect() and sendto() take it.
+    //
+    struct SocketAddress {
+
+        sockaddr_storage storage{};
+
+        socklen_t length = 0;
+
+        SocketAddress(IpAddress const &address, uint16_t port);
+
+        auto get() const -> sockaddr const * { return reinterpret_cast<sockaddr const *>(&storage); }
+
+        //
+        // Address and port of what recvfrom() filled in, none unless it is
+        // of IPv4 or IPv6.
+        //
+        static auto parse(sockaddr_storage const &storage) -> std::optional<std::pair<IpAddress, uint16_t>>;
+    };
+
+    namespace detail {
+
+        static_assert(IpAddress::ipv4(0x0A000002).isIpv4() && IpAddress::ipv4(0x0A000002).toIpv4() == 0x0A000002);
+        static_assert(IpAddress::ipv4(0x0A000002).bytes()[10] == 0xFF && IpAddress::ipv4(0x0A000002).bytes()[15] == 0x02);
+        static_assert(!IpAddress().isIpv4() && IpAddress::ipv4(0) != IpAddress());
+    }
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_IPADDRESS_H_ */
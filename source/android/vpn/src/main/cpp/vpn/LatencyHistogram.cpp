@@ -0,0 +1,78 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <ctime>
+
+#include "LatencyHistogram.h"
+
+using namespace ai;
+
+namespace {
+
+    //
+    // Upper end of the bucket holding the latency ranked at the fraction
+    // of the counts, per mille.
+    //
+    auto getPercentile(std::array<uint64_t, vpn::LATENCY_BUCKETS> const &counts, uint64_t const total, uint64_t const perMille) -> uint64_t {
+        auto const rank = (total * perMille + 999) / 1000;
+        auto seen = uint64_t{0};
+        for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+            seen += counts[bucket];
+            if (seen >= rank && seen > 0) {
+                return vpn::getLatencyBucketEnd(bucket);
+            }
+        }
+        return 0;
+    }
+}
+
+auto vpn::getLatencyTime() -> uint64_t {
+    auto now = timespec{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    auto const time = static_cast<uint64_t>(now.tv_sec) * 1'000'000'000 + static_cast<uint64_t>(now.tv_nsec);
+    return time != 0 ? time : 1;
+}
+
+auto vpn::LatencyCounts::add(LatencyHistogram const &histogram) -> void {
+    for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+        counts[bucket] += histogram.count(bucket);
+    }
+}
+
+auto vpn::LatencyCounts::since(LatencyCounts const &earlier, std::string const &stage) const -> LatencyStats {
+    auto delta = std::array<uint64_t, LATENCY_BUCKETS>{};
+    auto stats = LatencyStats{stage};
+    for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+        delta[bucket] = counts[bucket] - earlier.counts[bucket];
+        stats.count += delta[bucket];
+        if (delta[bucket] != 0) {
+            stats.max = getLatencyBucketEnd(bucket);
+        }
+    }
+    if (stats.count != 0) {
+        stats.p50 = getPercentile(delta, stats.count, 500);
+        stats.p90 = getPercentile(delta, stats.count, 900);
+        stats.p99 = getPercentile(delta, stats.count, 990);
+    }
+    return stats;
+}
@@ -0,0 +1,160 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_LATENCYHISTOGRAM_H_
+#define ANDROID_INTROSPECTION_VPN_LATENCYHISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ai::vpn {
+
+    //
+    // Latencies are counted in buckets of the HDR histogram kind: each power
+    // of two is split in SUB_BUCKETS buckets of the same width, so that a
+    // bucket is within 1 / SUB_BUCKETS of any value in it, from a
+    // nanosecond up to MAX_LATENCY.
+    //
+    constexpr size_t SUB_BUCKET_BITS = 4;
+
+    constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;
+
+    constexpr uint64_t MAX_LATENCY = (uint64_t{1} << 36U) - 1;
+
+    constexpr size_t LATENCY_BUCKETS = (std::bit_width(MAX_LATENCY) - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    //
+    // Bucket of a latency in nanoseconds; latencies past the last bucket are
+    // counted in it.
+    //
+    constexpr auto getLatencyBucket(uint64_t latency) -> size_t {
+        latency = latency < MAX_LATENCY ? latency : MAX_LATENCY;
+        if (latency < SUB_BUCKETS) {
+            return static_cast<size_t>(latency);
+        }
+        auto const shift = static_cast<size_t>(std::bit_width(latency)) - SUB_BUCKET_BITS - 1;
+        return (shift + 1) * SUB_BUCKETS + static_cast<size_t>(latency >> shift) - SUB_BUCKETS;
+    }
+
+    //
+    // Largest latency counted in the bucket.
+    //
+    constexpr auto getLatencyBucketEnd(size_t const bucket) -> uint64_t {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        auto const shift = bucket / SUB_BUCKETS - 1;
+        return ((uint64_t{SUB_BUCKETS} + bucket % SUB_BUCKETS + 1) << shift) - 1;
+    }
+
+    //
+    // Monotonic time in nanoseconds that latencies are measured with; never
+    // 0, which stands for a packet without a time.
+    //
+    auto getLatencyTime() -> uint64_t;
+
+    //
+    // Latencies one thread records, e.g. of a stage of the pipeline, read
+    // by any other at any time.  With a single writer a count is bumped by
+    // a plain load and store rather than a locked add.
+    //
+    class LatencyHistogram final {
+
+        std::array<std::atomic_uint64_t, LATENCY_BUCKETS> counts_{};
+
+    public:
+        auto record(uint64_t const latency) -> void {
+            auto &count = counts_[getLatencyBucket(latency)];
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        //
+        // Latency since the time, unless it is 0.
+        //
+        auto recordSince(uint64_t const time, uint64_t const now) -> void {
+            if (time != 0) {
+                record(now > time ? now - time : 0);
+            }
+        }
+
+        auto count(size_t const bucket) const -> uint64_t { return counts_[bucket].load(std::memory_order_relaxed); }
+    };
+
+    //
+    // Latencies of a stage over an interval, in nanoseconds, as the upper
+    // end of the bucket of each percentile.
+    //
+    struct LatencyStats {
+
+        std::string stage;
+
+        uint64_t count = 0;
+
+        uint64_t p50 = 0;
+
+        uint64_t p90 = 0;
+
+        uint64_t p99 = 0;
+
+        uint64_t max = 0;
+    };
+
+    //
+    // Counts of histograms summed, e.g. those of every thread recording a
+    // stage, to diff with the sum taken at the start of an interval.
+    //
+    struct LatencyCounts {
+
+        std::array<uint64_t, LATENCY_BUCKETS> counts{};
+
+        auto add(LatencyHistogram const &histogram) -> void;
+
+        //
+        // Stats of the latencies counted since the earlier counts.
+        //
+        auto since(LatencyCounts const &earlier, std::string const &stage) const -> LatencyStats;
+    };
+
+    namespace detail {
+
+        static_assert(getLatencyBucket(0) == 0 && getLatencyBucket(15) == 15 && getLatencyBucket(16) == 16 && getLatencyBucket(31) == 31);
+        static_assert(getLatencyBucket(32) == 32 && getLatencyBucket(33) == 32 && getLatencyBucket(34) == 33);
+        static_assert(getLatencyBucket(MAX_LATENCY) == LATENCY_BUCKETS - 1 && getLatencyBucket(UINT64_MAX) == LATENCY_BUCKETS - 1);
+        static_assert(getLatencyBucketEnd(15) == 15 && getLatencyBucketEnd(31) == 31 && getLatencyBucketEnd(32) == 33);
+        static_assert(getLatencyBucketEnd(LATENCY_BUCKETS - 1) == MAX_LATENCY);
+        static_assert([] {
+            for (auto latency = uint64_t{0}; latency < 100'000; latency += 7) {
+                if (getLatencyBucketEnd(getLatencyBucket(latency)) < latency || getLatencyBucketEnd(getLatencyBucket(latency)) - latency > latency / SUB_BUCKETS) {
+                    return false;
+                }
+            }
+            return true;
+        }());
+    }
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_LATENCYHISTOGRAM_H_ */
@@ -24,12 +24,77 @@
 #include <android/binder_ibinder_jni.h>
 #include <jni.h>
 #include <memory>
+#include <string>
 
+#include "utils/jni.h"
 #include "utils/log.h"
 #include "VpnService.h"
 
+using namespace ai;
+
 namespace {
     std::unique_ptr<ai::vpn::VpnService> gVpnService;
+
+    //
+    // Classes and methods called into, looked up by JNI_OnLoad.
+    //
+    struct JavaClasses {
+
+        utils::jni::GlobalRef<jclass> illegalArgumentException;
+
+        utils::jni::GlobalRef<jclass> illegalStateException;
+
+        utils::jni::GlobalRef<jclass> vpnService;
+
+        jmethodID protect = nullptr;
+    };
+
+    JavaClasses gClasses;
+
+    auto throwException(JNIEnv *const jniEnv, jclass const exceptionClass, char const *const message) -> void {
+        if (exceptionClass != nullptr) {
+            jniEnv->ThrowNew(exceptionClass, message);
+        }
+    }
+
+    //
+    // Calls the service of the process in place of a binder transaction,
+    // throwing what the binder call would on failure: IllegalArgumentException
+    // for bad values and IllegalStateException otherwise, e.g. if there is no
+    // service.
+    //
+    template<typename Call>
+    auto callVpnService(JNIEnv *const jniEnv, Call const &call) -> void {
+        if (gVpnService == nullptr) {
+            throwException(jniEnv, gClasses.illegalStateException.get(), "no native vpn service");
+            return;
+        }
+        if (auto const status = call(*gVpnService); !status.isOk()) {
+            auto const message = "native vpn service failed with status " + std::to_string(status.getStatus());
+            throwException(jniEnv, status.getStatus() == STATUS_BAD_VALUE ? gClasses.illegalArgumentException.get() : gClasses.illegalStateException.get(),
+                           message.c_str());
+        }
+    }
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM *javaVm, void *) {
+    LOGI("LocalVpnService::JNI_OnLoad");
+    auto *jniEnv = static_cast<JNIEnv *>(nullptr);
+    if (javaVm->GetEnv(reinterpret_cast<void **>(&jniEnv), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    utils::jni::setJavaVm(javaVm);
+    gClasses.illegalArgumentException = utils::jni::findClass(jniEnv, "java/lang/IllegalArgumentException");
+    gClasses.illegalStateException = utils::jni::findClass(jniEnv, "java/lang/IllegalStateException");
+    gClasses.vpnService = utils::jni::findClass(jniEnv, "android/net/VpnService");
+    gClasses.protect = utils::jni::getMethod(jniEnv, gClasses.vpnService.get(), "protect", "(I)Z");
+    if (!gClasses.illegalArgumentException || !gClasses.illegalStateException || gClasses.protect == nullptr) {
+        LOGE("LocalVpnService::JNI_OnLoad unable to look up classes");
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_6;
 }
 
 extern "C"
@@ -47,4 +112,117 @@ JNIEXPORT void JNICALL
 Java_com_github_jonforshort_vpn_LocalVpnService_destroyNativeVpnService(JNIEnv *, jobject) {
     LOGI("LocalVpnService::destroyNativeVpnService");
     gVpnService.reset();
-}
\ No newline at end of file
+}
+
+//
+// Sockets of sessions are protected by calling VpnService.protect() from
+// the worker creating them, which stays attached to the VM from then on,
+// rather than through a transaction to the listener.
+//
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetSocketProtector(JNIEnv *jniEnv, jobject, jobject vpnService) {
+    if (gVpnService == nullptr) {
+        throwException(jniEnv, gClasses.illegalStateException.get(), "no native vpn service");
+        return;
+    }
+    if (vpnService == nullptr) {
+        gVpnService->setSocketProtector({});
+        return;
+    }
+    auto const service = std::make_shared<utils::jni::GlobalRef<jobject>>(jniEnv, vpnService);
+    gVpnService->setSocketProtector([service](int const socket) {
+        auto *const env = utils::jni::getEnv("VpnWorker");
+        if (env == nullptr) {
+            return false;
+        }
+        auto const isProtected = env->CallBooleanMethod(service->get(), gClasses.protect, socket) == JNI_TRUE;
+        return !utils::jni::clearException(env, "VpnService.protect") && isProtected;
+    });
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeStart(JNIEnv *jniEnv, jobject) {
+    callVpnService(jniEnv, [](auto &service) { return service.start(); });
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeStop(JNIEnv *jniEnv, jobject) {
+    callVpnService(jniEnv, [](auto &service) { return service.stop(); });
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeUninitialize(JNIEnv *jniEnv, jobject) {
+    callVpnService(jniEnv, [](auto &service) { return service.uninitialize(); });
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeGetStats(JNIEnv *jniEnv, jobject) {
+    auto stats = std::string();
+    callVpnService(jniEnv, [&stats](auto &service) { return service.getStats(&stats); });
+    return jniEnv->ExceptionCheck() ? nullptr : jniEnv->NewStringUTF(stats.c_str());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetCaptureDirectory(JNIEnv *jniEnv, jobject, jstring directory) {
+    callVpnService(jniEnv, [&](auto &service) { return service.setCaptureDirectory(utils::jni::toString(jniEnv, directory)); });
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetCaptureFilter(JNIEnv *jniEnv, jobject, jstring filter) {
+    auto compiled = false;
+    callVpnService(jniEnv, [&](auto &service) { return service.setCaptureFilter(utils::jni::toString(jniEnv, filter), &compiled); });
+    return compiled ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetInspectionFilter(JNIEnv *jniEnv, jobject, jstring filter) {
+    auto compiled = false;
+    callVpnService(jniEnv, [&](auto &service) { return service.setInspectionFilter(utils::jni::toString(jniEnv, filter), &compiled); });
+    return compiled ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetStatsInterval(JNIEnv *jniEnv, jobject, jint intervalMillis) {
+    callVpnService(jniEnv, [=](auto &service) { return service.setStatsInterval(intervalMillis); });
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetThreadPolicy(JNIEnv *jniEnv, jobject, jint policy) {
+    callVpnService(jniEnv, [=](auto &service) { return service.setThreadPolicy(policy); });
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetBatching(JNIEnv *jniEnv, jobject, jint maxPackets, jint maxDelayMicros) {
+    callVpnService(jniEnv, [=](auto &service) { return service.setBatching(maxPackets, maxDelayMicros); });
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetOverflowPolicy(JNIEnv *jniEnv, jobject, jstring queue, jint policy) {
+    auto isSet = false;
+    callVpnService(jniEnv, [&](auto &service) { return service.setOverflowPolicy(utils::jni::toString(jniEnv, queue), policy, &isSet); });
+    return isSet ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetFlowLog(JNIEnv *jniEnv, jobject, jstring path, jint intervalMillis) {
+    callVpnService(jniEnv, [&](auto &service) { return service.setFlowLog(utils::jni::toString(jniEnv, path), intervalMillis); });
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_github_jonforshort_vpn_NativeVpnService_nativeSetInspectionBudget(JNIEnv *jniEnv, jobject, jint cpuPercent, jint fullBytes) {
+    callVpnService(jniEnv, [=](auto &service) { return service.setInspectionBudget(cpuPercent, fullBytes); });
+}
@@ -0,0 +1,186 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_OVERFLOWPOLICY_H_
+#define ANDROID_INTROSPECTION_VPN_OVERFLOWPOLICY_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "utils/ring_buffer.h"
+
+namespace ai::vpn {
+
+    namespace detail {
+
+        template<typename Ring>
+        inline constexpr bool IS_MULTI_CONSUMER = false;
+
+        template<typename T>
+        inline constexpr bool IS_MULTI_CONSUMER<utils::MpmcRingBuffer<T>> = true;
+    }
+
+    //
+    // What a bounded queue does with a value offered while it is full;
+    // values match the OVERFLOW_ constants of IVpnService.aidl.
+    //
+    enum class OverflowPolicy : int32_t {
+
+        //
+        // The producer waits for room, as long as its wait lets it.
+        //
+        Block = 0,
+
+        //
+        // The value offered is dropped.
+        //
+        DropNewest = 1,
+
+        //
+        // The oldest value queued is dropped to make room, for consumers
+        // that care about what is recent, e.g. a live view; only queues
+        // with more than one consumer can.
+        //
+        DropOldest = 2,
+
+        //
+        // Past half full, only one value in SAMPLE_RATE is queued, so that a
+        // consumer falling behind sees a thinned out but even share of them
+        // instead of a gap; the newest are dropped once it is full.
+        //
+        Sample = 3,
+    };
+
+    //
+    // Wait under Block of a producer that must not stall, e.g. one moving
+    // the packets of the tunnel: sleeps BLOCK_WAIT microseconds a try and
+    // gives up after MAX_BLOCK, dropping the value.
+    //
+    struct BoundedWait {
+
+        static constexpr uint64_t BLOCK_WAIT = 100;
+
+        static constexpr uint64_t MAX_BLOCK = 1000;
+
+        uint64_t waited = 0;
+
+        auto operator()() -> bool {
+            if (waited >= MAX_BLOCK) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(BLOCK_WAIT));
+            waited += BLOCK_WAIT;
+            return true;
+        }
+    };
+
+    //
+    // Whether a queue on the ring can apply the policy.
+    //
+    template<typename Ring>
+    constexpr auto supportsPolicy(OverflowPolicy const policy) -> bool {
+        return policy != OverflowPolicy::DropOldest || detail::IS_MULTI_CONSUMER<Ring>;
+    }
+
+    //
+    // Applies the overflow policy of a queue to the values offered to it,
+    // and counts what it drops by reason.  Any number of producers.
+    //
+    class OverflowGuard final {
+
+        std::atomic<OverflowPolicy> policy_;
+
+        std::atomic_uint64_t offered_{0};
+
+        std::atomic_uint64_t waits_{0};
+
+        std::atomic_uint64_t droppedNewest_{0};
+
+        std::atomic_uint64_t droppedOldest_{0};
+
+        std::atomic_uint64_t sampledOut_{0};
+
+    public:
+        static constexpr uint64_t SAMPLE_RATE = 8;
+
+        explicit OverflowGuard(OverflowPolicy const policy) : policy_(policy) {}
+
+        auto policy() const -> OverflowPolicy { return policy_.load(std::memory_order_relaxed); }
+
+        auto setPolicy(OverflowPolicy const policy) -> void { policy_.store(policy, std::memory_order_relaxed); }
+
+        //
+        // Moves the value into the ring and returns true, or leaves it as it
+        // is if the policy drops it.  Under Block, wait() is called while
+        // the ring is full and returns false to give up, which drops the
+        // value.  DropOldest pops from the ring, so it needs an
+        // MpmcRingBuffer; on others it drops the newest instead.
+        //
+        template<typename Ring, typename T, typename Wait>
+        auto push(Ring &ring, T &value, Wait &&wait) -> bool {
+            auto const policy = policy_.load(std::memory_order_relaxed);
+            if (policy == OverflowPolicy::Sample && ring.size() * 2 >= ring.capacity() &&
+                offered_.fetch_add(1, std::memory_order_relaxed) % SAMPLE_RATE != 0) {
+                sampledOut_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            while (!ring.tryPush(std::move(value))) {
+                if (policy == OverflowPolicy::Block) {
+                    waits_.fetch_add(1, std::memory_order_relaxed);
+                    if (wait()) {
+                        continue;
+                    }
+                } else if constexpr (detail::IS_MULTI_CONSUMER<Ring>) {
+                    if (policy == OverflowPolicy::DropOldest) {
+                        auto oldest = T();
+                        if (ring.tryPop(oldest)) {
+                            droppedOldest_.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        continue;
+                    }
+                }
+                droppedNewest_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            return true;
+        }
+
+        //
+        // Waits under Block and drops by reason, one "name value" per line
+        // with the prefix.
+        //
+        auto getStats(std::string const &prefix) const -> std::string {
+            return prefix + ".waits " + std::to_string(waits_.load(std::memory_order_relaxed)) + "\n" +
+                   prefix + ".dropped_newest " + std::to_string(droppedNewest_.load(std::memory_order_relaxed)) + "\n" +
+                   prefix + ".dropped_oldest " + std::to_string(droppedOldest_.load(std::memory_order_relaxed)) + "\n" +
+                   prefix + ".sampled_out " + std::to_string(sampledOut_.load(std::memory_order_relaxed)) + "\n";
+        }
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_OVERFLOWPOLICY_H_ */
@@ -0,0 +1,327 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "utils/log.h"
+#include "utils/trace.h"
+#include "PacketCapture.h"
+
+using namespace ai;
+
+namespace {
+
+    //
+    // Bytes of records gathered before they are written out at once.
+    //
+    constexpr size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+    //
+    // Most milliseconds records wait in the buffer, so that a file being
+    // captured to can be looked at while traffic is light.
+    //
+    constexpr uint64_t FLUSH_INTERVAL = 1000;
+
+    //
+    // Milliseconds the writer sleeps for when the ring is empty; the ring
+    // holds far more than the tunnel moves meanwhile.
+    //
+    constexpr int IDLE_WAIT = 20;
+
+    constexpr size_t POP_BATCH_SIZE = 64;
+
+    //
+    // Packets of the tunnel are raw IPv4 / IPv6 packets.
+    //
+    constexpr uint32_t LINKTYPE_RAW = 101;
+
+    auto getMonotonicTime() -> uint64_t {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    auto getWallClockTime() -> uint64_t {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    auto appendUint32(std::vector<uint8_t> &buffer, uint32_t const value) -> void {
+        auto bytes = std::array<uint8_t, sizeof(value)>{};
+        std::memcpy(bytes.data(), &value, sizeof(value));
+        buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+    }
+
+    auto appendUint16(std::vector<uint8_t> &buffer, uint16_t const value) -> void {
+        auto bytes = std::array<uint8_t, sizeof(value)>{};
+        std::memcpy(bytes.data(), &value, sizeof(value));
+        buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+    }
+
+    //
+    // A pcap file being captured to, in the byte order of the device, which
+    // readers tell from the magic number.  Records are gathered in a buffer
+    // and written out in large writes.
+    //
+    class PcapFile final {
+
+        int fd_ = -1;
+
+        std::vector<uint8_t> buffer_;
+
+        uint64_t size_ = 0;
+
+        uint64_t openedAt_ = 0;
+
+        uint64_t flushedAt_ = 0;
+
+    public:
+        PcapFile() {
+            buffer_.reserve(WRITE_BUFFER_SIZE);
+        }
+
+        PcapFile(PcapFile const &) = delete;
+
+        auto operator=(PcapFile const &) -> PcapFile & = delete;
+
+        ~PcapFile() {
+            close();
+        }
+
+        auto isOpen() const -> bool { return fd_ >= 0; }
+
+        auto size() const -> uint64_t { return size_; }
+
+        auto openedAt() const -> uint64_t { return openedAt_; }
+
+        auto flushedAt() const -> uint64_t { return flushedAt_; }
+
+        auto open(std::string const &path, uint64_t const now) -> bool {
+            close();
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd_ < 0) {
+                LOGE("PcapFile::open unable to open %s, %s", path.c_str(), strerror(errno));
+                return false;
+            }
+            appendUint32(buffer_, 0xa1b2c3d4);
+            appendUint16(buffer_, 2);
+            appendUint16(buffer_, 4);
+            appendUint32(buffer_, 0);
+            appendUint32(buffer_, 0);
+            appendUint32(buffer_, vpn::PACKET_SIZE);
+            appendUint32(buffer_, LINKTYPE_RAW);
+            size_ = buffer_.size();
+            openedAt_ = now;
+            flushedAt_ = now;
+            LOGI("PcapFile::open capturing to %s", path.c_str());
+            return true;
+        }
+
+        auto append(std::span<uint8_t const> const packet, uint64_t const timestamp) -> void {
+            appendUint32(buffer_, static_cast<uint32_t>(timestamp / 1'000'000));
+            appendUint32(buffer_, static_cast<uint32_t>(timestamp % 1'000'000));
+            appendUint32(buffer_, static_cast<uint32_t>(packet.size()));
+            appendUint32(buffer_, static_cast<uint32_t>(packet.size()));
+            buffer_.insert(buffer_.end(), packet.begin(), packet.end());
+            size_ += 16 + packet.size();
+        }
+
+        auto shouldFlush(uint64_t const now) const -> bool {
+            return buffer_.size() >= WRITE_BUFFER_SIZE || (!buffer_.empty() && now - flushedAt_ >= FLUSH_INTERVAL);
+        }
+
+        //
+        // Writes out the buffer and returns how many bytes were written; a
+        // failed write loses what was left of it.
+        //
+        auto flush(uint64_t const now) -> size_t {
+            TRACE_SPAN("PcapFile::flush");
+            auto written = size_t{0};
+            while (written < buffer_.size()) {
+                auto const result = write(fd_, buffer_.data() + written, buffer_.size() - written);
+                if (result < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    LOGE("PcapFile::flush unable to write, %s", strerror(errno));
+                    break;
+                }
+                written += static_cast<size_t>(result);
+            }
+            buffer_.clear();
+            flushedAt_ = now;
+            return written;
+        }
+
+        auto close() -> void {
+            if (fd_ >= 0) {
+                ::close(fd_);
+                fd_ = -1;
+            }
+            buffer_.clear();
+        }
+    };
+
+    //
+    // e.g. "<directory>/capture-20200131-235959-1.pcap", numbered by the
+    // files of the capture so far, so that files started within the same
+    // second do not clash.
+    //
+    auto getCapturePath(std::string const &directory, uint64_t const index) -> std::string {
+        auto const time = std::time(nullptr);
+        auto localTime = std::tm{};
+        localtime_r(&time, &localTime);
+        auto text = std::array<char, 32>{};
+        std::strftime(text.data(), text.size(), "%Y%m%d-%H%M%S", &localTime);
+        return directory + "/capture-" + text.data() + "-" + std::to_string(index) + ".pcap";
+    }
+}
+
+//
+// Enough buffers for a full ring and a batch being written.
+//
+vpn::PacketCapture::PacketCapture(size_t const queueSize) : packetPool_(queueSize + POP_BATCH_SIZE), packets_(queueSize) {
+}
+
+vpn::PacketCapture::~PacketCapture() {
+    stop();
+}
+
+auto vpn::PacketCapture::start(CaptureOptions options) -> bool {
+    stop();
+    auto const lock = std::lock_guard(mutex_);
+    stopFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stopFd_ < 0) {
+        LOGE("PacketCapture::start unable to create stop eventfd, %s", strerror(errno));
+        return false;
+    }
+
+    //
+    // Packets queued after the last stop are from the capture before.
+    //
+    auto stale = std::array<CapturedPacket, POP_BATCH_SIZE>{};
+    while (packets_.popBatch(stale) > 0) {
+    }
+    writer_ = std::thread(&PacketCapture::writePackets, this, std::move(options));
+    enabled_.store(true, std::memory_order_release);
+    return true;
+}
+
+auto vpn::PacketCapture::stop() -> void {
+    auto const lock = std::lock_guard(mutex_);
+    if (stopFd_ < 0) {
+        return;
+    }
+    enabled_.store(false, std::memory_order_release);
+    auto const stop = uint64_t{1};
+    if (write(stopFd_, &stop, sizeof(stop)) != sizeof(stop)) {
+        LOGE("PacketCapture::stop unable to signal stop eventfd, %s", strerror(errno));
+    }
+    writer_.join();
+    close(stopFd_);
+    stopFd_ = -1;
+}
+
+auto vpn::PacketCapture::capture(std::span<uint8_t const> const packet) -> void {
+    if (!enabled_.load(std::memory_order_relaxed) || !filter_.matches(packet)) {
+        return;
+    }
+    auto buffer = packetPool_.acquire();
+    if (!buffer || packet.size() > buffer.capacity()) {
+        droppedPackets_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::copy(packet.begin(), packet.end(), buffer.data());
+    buffer.setSize(packet.size());
+    auto captured = CapturedPacket{std::move(buffer), getWallClockTime()};
+    if (!overflow_.push(packets_, captured, BoundedWait())) {
+        droppedPackets_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    capturedPackets_.fetch_add(1, std::memory_order_relaxed);
+}
+
+auto vpn::PacketCapture::getStats() const -> std::string {
+    return "capture.packets " + std::to_string(capturedPackets_.load(std::memory_order_relaxed)) + "\n" +
+           "capture.dropped " + std::to_string(droppedPackets_.load(std::memory_order_relaxed)) + "\n" +
+           "capture.bytes " + std::to_string(writtenBytes_.load(std::memory_order_relaxed)) + "\n" +
+           "capture.files " + std::to_string(files_.load(std::memory_order_relaxed)) + "\n" + overflow_.getStats("capture");
+}
+
+//
+// Drains the ring into the current file, starting a new one when it is
+// due, until a stop is requested; what is left in the ring then is written
+// out before the file is closed.
+//
+auto vpn::PacketCapture::writePackets(CaptureOptions const options) -> void {
+    LOGI("PacketCapture::writePackets start");
+    auto file = PcapFile();
+    auto batch = std::array<CapturedPacket, POP_BATCH_SIZE>{};
+    auto stopping = false;
+    while (true) {
+        auto const count = packets_.popBatch(batch);
+        auto now = getMonotonicTime();
+        for (auto &captured : std::span(batch).first(count)) {
+            auto const recordSize = 16 + captured.packet.size();
+            if (!file.isOpen() || file.size() + recordSize > options.maxFileSize || now - file.openedAt() >= options.maxFileDuration) {
+                if (file.isOpen()) {
+                    writtenBytes_.fetch_add(file.flush(now), std::memory_order_relaxed);
+                }
+                if (!file.open(getCapturePath(options.directory, files_.load(std::memory_order_relaxed) + 1), now)) {
+                    droppedPackets_.fetch_add(1, std::memory_order_relaxed);
+                    captured.packet.reset();
+                    continue;
+                }
+                files_.fetch_add(1, std::memory_order_relaxed);
+            }
+            file.append(std::span<uint8_t const>(captured.packet.data(), captured.packet.size()), captured.timestamp);
+            captured.packet.reset();
+            if (file.shouldFlush(now)) {
+                writtenBytes_.fetch_add(file.flush(now), std::memory_order_relaxed);
+            }
+        }
+        if (count > 0) {
+            continue;
+        }
+        if (stopping) {
+            break;
+        }
+        if (file.isOpen() && file.shouldFlush(now)) {
+            writtenBytes_.fetch_add(file.flush(now), std::memory_order_relaxed);
+        }
+        auto stop = pollfd{stopFd_, POLLIN, 0};
+        stopping = poll(&stop, 1, IDLE_WAIT) > 0;
+    }
+    if (file.isOpen()) {
+        writtenBytes_.fetch_add(file.flush(getMonotonicTime()), std::memory_order_relaxed);
+    }
+    LOGI("PacketCapture::writePackets finished");
+}
@@ -0,0 +1,170 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_PACKETCAPTURE_H_
+#define ANDROID_INTROSPECTION_VPN_PACKETCAPTURE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+
+#include "utils/ring_buffer.h"
+#include "OverflowPolicy.h"
+#include "PacketFilter.h"
+#include "PacketPool.h"
+
+namespace ai::vpn {
+
+    struct CaptureOptions {
+
+        //
+        // Directory the pcap files are written to, which has to exist.
+        //
+        std::string directory;
+
+        //
+        // A new file is started once the current one would grow past this
+        // many bytes or has been written to for this many milliseconds.
+        //
+        uint64_t maxFileSize = 64 * 1024 * 1024;
+
+        uint64_t maxFileDuration = 10 * 60 * 1000;
+    };
+
+    //
+    // Saves the packets of the tunnel to pcap files, e.g. for Wireshark, off
+    // the packet path: the threads moving packets copy them into buffers of
+    // a pool of its own and queue them on a ring, and a thread of the capture
+    // writes them out in large writes.  A full pool drops the packet, and a
+    // full ring does what its overflow policy has it, the newest packet
+    // being dropped by default; drops are counted by reason.  Blocking
+    // is a BoundedWait, so that slow storage only slows the tunnel down
+    // rather than stalling it.  A filter,
+    // when set, is run on every packet before it is copied.
+    //
+    class PacketCapture final {
+
+        struct CapturedPacket {
+
+            PacketBuffer packet;
+
+            //
+            // Wall clock time the packet was captured at, in microseconds.
+            //
+            uint64_t timestamp = 0;
+        };
+
+        PacketPool packetPool_;
+
+        //
+        // More than one consumer, so that producers can drop the oldest
+        // packets to make room.
+        //
+        utils::MpmcRingBuffer<CapturedPacket> packets_;
+
+        OverflowGuard overflow_{OverflowPolicy::DropNewest};
+
+        std::atomic_bool enabled_{false};
+
+        SharedPacketFilter filter_;
+
+        std::atomic_uint64_t capturedPackets_{0};
+
+        std::atomic_uint64_t droppedPackets_{0};
+
+        std::atomic_uint64_t writtenBytes_{0};
+
+        std::atomic_uint64_t files_{0};
+
+        //
+        // Serializes start() and stop().
+        //
+        std::mutex mutex_;
+
+        //
+        // eventfd stop() wakes the writer with, -1 while it is not running.
+        //
+        int stopFd_ = -1;
+
+        std::thread writer_;
+
+        auto writePackets(CaptureOptions options) -> void;
+
+    public:
+        explicit PacketCapture(size_t queueSize);
+
+        PacketCapture(PacketCapture const &) = delete;
+
+        auto operator=(PacketCapture const &) -> PacketCapture & = delete;
+
+        ~PacketCapture();
+
+        //
+        // Starts writing packets to a new file in the directory of the
+        // options; a capture that is running is stopped first.
+        //
+        auto start(CaptureOptions options) -> bool;
+
+        //
+        // Writes out the packets queued so far and closes the file.
+        //
+        auto stop() -> void;
+
+        //
+        // Only captures the packets matching the pcap filter expression from
+        // now on, or all of them if it is empty; false if it does not
+        // compile.  Kept across captures.
+        //
+        auto setFilter(std::string const &expression) -> bool { return filter_.set(expression); }
+
+        //
+        // What packets captured while the ring is full do from now on.  Kept
+        // across captures.
+        //
+        auto setOverflowPolicy(OverflowPolicy const policy) -> void { overflow_.setPolicy(policy); }
+
+        //
+        // Whether the capture is running, for callers to skip the work of
+        // choosing packets to capture while it is not.  Any thread.
+        //
+        auto isEnabled() const -> bool { return enabled_.load(std::memory_order_relaxed); }
+
+        //
+        // Queues a copy of the packet if the capture is running and it
+        // passes the filter.  Any thread;
+        // never waits for the writer.
+        //
+        auto capture(std::span<uint8_t const> packet) -> void;
+
+        //
+        // Counters of the capture, one "name value" per line.
+        //
+        auto getStats() const -> std::string;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_PACKETCAPTURE_H_ */
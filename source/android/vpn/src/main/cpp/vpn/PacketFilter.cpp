@@ -0,0 +1,84 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <utility>
+
+#include "utils/log.h"
+#include "PacketFilter.h"
+#include "PacketPool.h"
+
+using namespace ai;
+
+namespace {
+
+    //
+    // pcap_compile() keeps state of its own in the versions of libpcap
+    // before 1.8.
+    //
+    std::mutex gCompileMutex;
+}
+
+vpn::PacketFilter::PacketFilter(std::string expression, bpf_program const program) : expression_(std::move(expression)), program_(program) {
+}
+
+vpn::PacketFilter::~PacketFilter() {
+    pcap_freecode(&program_);
+}
+
+auto vpn::PacketFilter::compile(std::string const &expression) -> std::unique_ptr<PacketFilter> {
+    auto const lock = std::lock_guard(gCompileMutex);
+    auto *const pcap = pcap_open_dead(DLT_RAW, static_cast<int>(PACKET_SIZE));
+    if (pcap == nullptr) {
+        LOGE("PacketFilter::compile unable to open pcap");
+        return nullptr;
+    }
+    auto program = bpf_program{};
+    if (pcap_compile(pcap, &program, expression.c_str(), 1, PCAP_NETMASK_UNKNOWN) < 0) {
+        LOGW("PacketFilter::compile unable to compile [%s], %s", expression.c_str(), pcap_geterr(pcap));
+        pcap_close(pcap);
+        return nullptr;
+    }
+    pcap_close(pcap);
+    return std::unique_ptr<PacketFilter>(new PacketFilter(expression, program));
+}
+
+auto vpn::SharedPacketFilter::set(std::string const &expression) -> bool {
+    auto const lock = std::lock_guard(mutex_);
+    if (expression.empty()) {
+        filter_.store(nullptr, std::memory_order_release);
+        return true;
+    }
+    auto const it = std::ranges::find_if(filters_, [&expression](auto const &filter) { return filter->expression() == expression; });
+    if (it != filters_.end()) {
+        filter_.store(it->get(), std::memory_order_release);
+        return true;
+    }
+    auto filter = PacketFilter::compile(expression);
+    if (!filter) {
+        return false;
+    }
+    filter_.store(filter.get(), std::memory_order_release);
+    filters_.push_back(std::move(filter));
+    return true;
+}
@@ -0,0 +1,111 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_PACKETFILTER_H_
+#define ANDROID_INTROSPECTION_VPN_PACKETFILTER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <pcap/pcap.h>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ai::vpn {
+
+    //
+    // BPF program compiled once from a pcap filter expression, e.g.
+    // "tcp port 443 and host 93.184.216.34", for the raw IP packets of the
+    // tunnel.  Running it on a packet reads its headers in place, so a
+    // packet it rejects costs a few dozen instructions.
+    //
+    class PacketFilter final {
+
+        std::string const expression_;
+
+        bpf_program program_{};
+
+        PacketFilter(std::string expression, bpf_program program);
+
+    public:
+        //
+        // nullptr if the expression does not compile, with why logged.
+        //
+        static auto compile(std::string const &expression) -> std::unique_ptr<PacketFilter>;
+
+        PacketFilter(PacketFilter const &) = delete;
+
+        auto operator=(PacketFilter const &) -> PacketFilter & = delete;
+
+        ~PacketFilter();
+
+        auto matches(std::span<uint8_t const> const packet) const -> bool {
+            auto const length = static_cast<unsigned int>(packet.size());
+            return bpf_filter(program_.bf_insns, packet.data(), length, length) != 0;
+        }
+
+        auto expression() const -> std::string const & { return expression_; }
+    };
+
+    //
+    // Filter the threads moving packets run while another thread may set a
+    // new one.  Filters set before are kept until the holder is destroyed,
+    // as a thread may still be running one; they are as many as distinct
+    // expressions were set, a handful.
+    //
+    class SharedPacketFilter final {
+
+        std::atomic<PacketFilter const *> filter_{nullptr};
+
+        //
+        // Serializes set().
+        //
+        std::mutex mutex_;
+
+        std::vector<std::unique_ptr<PacketFilter>> filters_;
+
+    public:
+        //
+        // Filters packets with the expression from now on, or lets them all
+        // through if it is empty; false, leaving the filter as it was, if
+        // the expression does not compile.
+        //
+        auto set(std::string const &expression) -> bool;
+
+        //
+        // Whether the packet passes, which it does without a filter.  Any
+        // thread.
+        //
+        auto matches(std::span<uint8_t const> const packet) const -> bool {
+            auto const *const filter = filter_.load(std::memory_order_acquire);
+            return filter == nullptr || filter->matches(packet);
+        }
+
+        auto isSet() const -> bool { return filter_.load(std::memory_order_relaxed) != nullptr; }
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_PACKETFILTER_H_ */
@@ -0,0 +1,613 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_PACKETHEADERS_H_
+#define ANDROID_INTROSPECTION_VPN_PACKETHEADERS_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <type_traits>
+
+#include "Checksum.h"
+#include "IpAddress.h"
+
+//
+// Views of the IPv4, IPv6, TCP and UDP headers of a packet, read straight
+// from its bytes without copying or allocating, and the few helpers needed
+// to write packets back into the tunnel.  Fields are in host order.
+// Parsing only checks what reading the fields safely needs, so the values
+// themselves, e.g. checksums, are left to whoever inspects the packet.
+//
+namespace ai::vpn {
+
+    namespace detail {
+
+        constexpr auto load16(std::span<uint8_t const> const bytes, size_t const offset) -> uint16_t {
+            return static_cast<uint16_t>((bytes[offset] << 8U) | bytes[offset + 1]);
+        }
+
+        constexpr auto load32(std::span<uint8_t const> const bytes, size_t const offset) -> uint32_t {
+            return static_cast<uint32_t>(load16(bytes, offset)) << 16U | load16(bytes, offset + 2);
+        }
+    }
+
+    enum class IpProtocol : uint8_t {
+        Tcp = 6,
+        Udp = 17,
+    };
+
+    class Ipv4Header final {
+
+        //
+        // The packet up to its total length, header included.
+        //
+        std::span<uint8_t const> bytes_;
+
+        constexpr explicit Ipv4Header(std::span<uint8_t const> const bytes) : bytes_(bytes) {}
+
+    public:
+        static constexpr size_t MIN_SIZE = 20;
+
+        //
+        // Header of the packet, none unless it is an IPv4 packet whose header
+        // and total length fit in the bytes.  Bytes past the total length,
+        // e.g. padding, are left out of the payload.
+        //
+        static constexpr auto parse(std::span<uint8_t const> const packet) -> std::optional<Ipv4Header> {
+            if (packet.size() < MIN_SIZE || (packet[0] >> 4U) != 4) {
+                return std::nullopt;
+            }
+            auto const headerLength = static_cast<size_t>(packet[0] & 0x0FU) * 4;
+            auto const totalLength = static_cast<size_t>(detail::load16(packet, 2));
+            if (headerLength < MIN_SIZE || totalLength < headerLength || totalLength > packet.size()) {
+                return std::nullopt;
+            }
+            return Ipv4Header(packet.first(totalLength));
+        }
+
+        constexpr auto headerLength() const -> size_t { return static_cast<size_t>(bytes_[0] & 0x0FU) * 4; }
+
+        constexpr auto totalLength() const -> size_t { return bytes_.size(); }
+
+        constexpr auto protocol() const -> uint8_t { return bytes_[9]; }
+
+        constexpr auto isProtocol(IpProtocol const protocol) const -> bool { return bytes_[9] == static_cast<uint8_t>(protocol); }
+
+        //
+        // Whether the packet is part of a fragmented datagram; only the first
+        // fragment carries the transport header.
+        //
+        constexpr auto isFragment() const -> bool { return (detail::load16(bytes_, 6) & 0x3FFFU) != 0; }
+
+        constexpr auto isFirstFragment() const -> bool { return (detail::load16(bytes_, 6) & 0x1FFFU) == 0; }
+
+        constexpr auto timeToLive() const -> uint8_t { return bytes_[8]; }
+
+        constexpr auto sourceAddress() const -> uint32_t { return detail::load32(bytes_, 12); }
+
+        constexpr auto destinationAddress() const -> uint32_t { return detail::load32(bytes_, 16); }
+
+        constexpr auto header() const -> std::span<uint8_t const> { return bytes_.first(headerLength()); }
+
+        constexpr auto payload() const -> std::span<uint8_t const> { return bytes_.subspan(headerLength()); }
+    };
+
+    //
+    // Header of an IPv4 or IPv6 packet, for what both families share: the
+    // addresses, the protocol of the payload and whether it is a fragment.
+    // The extension headers of IPv6 are walked over to the payload, and
+    // count as part of the header.
+    //
+    class IpHeader final {
+
+        //
+        // The packet up to its total length, headers included.
+        //
+        std::span<uint8_t const> bytes_;
+
+        uint16_t headerLength_ = 0;
+
+        uint8_t protocol_ = 0;
+
+        bool isFragment_ = false;
+
+        bool isFirstFragment_ = true;
+
+        constexpr IpHeader(std::span<uint8_t const> const bytes, size_t const headerLength, uint8_t const protocol, bool const isFragment,
+                           bool const isFirstFragment)
+                : bytes_(bytes), headerLength_(static_cast<uint16_t>(headerLength)), protocol_(protocol), isFragment_(isFragment),
+                  isFirstFragment_(isFirstFragment) {}
+
+        static constexpr uint8_t HOP_BY_HOP_OPTIONS = 0;
+
+        static constexpr uint8_t ROUTING = 43;
+
+        static constexpr uint8_t FRAGMENT = 44;
+
+        static constexpr uint8_t AUTHENTICATION = 51;
+
+        static constexpr uint8_t DESTINATION_OPTIONS = 60;
+
+        //
+        // Extension headers walked over at most, so that a packet made of
+        // them is not walked for long.
+        //
+        static constexpr size_t MAX_EXTENSION_HEADERS = 8;
+
+        static constexpr auto parseIpv6(std::span<uint8_t const> const packet) -> std::optional<IpHeader> {
+            if (packet.size() < IPV6_SIZE) {
+                return std::nullopt;
+            }
+            auto const totalLength = IPV6_SIZE + detail::load16(packet, 4);
+            if (totalLength > packet.size()) {
+                return std::nullopt;
+            }
+            auto const bytes = packet.first(totalLength);
+            auto protocol = bytes[6];
+            auto offset = IPV6_SIZE;
+            for (size_t count = 0; count < MAX_EXTENSION_HEADERS; count++) {
+                auto length = size_t{0};
+                if (protocol == HOP_BY_HOP_OPTIONS || protocol == ROUTING || protocol == DESTINATION_OPTIONS) {
+                    length = offset + 2 <= totalLength ? (static_cast<size_t>(bytes[offset + 1]) + 1) * 8 : SIZE_MAX;
+                } else if (protocol == AUTHENTICATION) {
+                    length = offset + 2 <= totalLength ? (static_cast<size_t>(bytes[offset + 1]) + 2) * 4 : SIZE_MAX;
+                } else if (protocol == FRAGMENT) {
+                    if (offset + 8 > totalLength) {
+                        return std::nullopt;
+                    }
+                    auto const isFirstFragment = (detail::load16(bytes, offset + 2) & 0xFFF8U) == 0;
+                    return IpHeader(bytes, offset + 8, bytes[offset], true, isFirstFragment);
+                } else {
+                    return IpHeader(bytes, offset, protocol, false, true);
+                }
+                if (length > totalLength - offset) {
+                    return std::nullopt;
+                }
+                protocol = bytes[offset];
+                offset += length;
+            }
+            return std::nullopt;
+        }
+
+    public:
+        static constexpr size_t IPV6_SIZE = 40;
+
+        //
+        // Header of the packet, none unless it is an IPv4 or IPv6 packet
+        // whose headers and total length fit in the bytes.  An IPv6 fragment
+        // ends the headers, as only the first one carries those after it;
+        // a packet with more extension headers than are walked is none.
+        //
+        static constexpr auto parse(std::span<uint8_t const> const packet) -> std::optional<IpHeader> {
+            if (!packet.empty() && (packet[0] >> 4U) == 6) {
+                return parseIpv6(packet);
+            }
+            auto const ipv4Header = Ipv4Header::parse(packet);
+            if (!ipv4Header) {
+                return std::nullopt;
+            }
+            return IpHeader(packet.first(ipv4Header->totalLength()), ipv4Header->headerLength(), ipv4Header->protocol(), ipv4Header->isFragment(),
+                            ipv4Header->isFirstFragment());
+        }
+
+        constexpr auto isIpv6() const -> bool { return (bytes_[0] >> 4U) == 6; }
+
+        constexpr auto headerLength() const -> size_t { return headerLength_; }
+
+        constexpr auto totalLength() const -> size_t { return bytes_.size(); }
+
+        //
+        // Protocol of the payload, past any extension headers.
+        //
+        constexpr auto protocol() const -> uint8_t { return protocol_; }
+
+        constexpr auto isProtocol(IpProtocol const protocol) const -> bool { return protocol_ == static_cast<uint8_t>(protocol); }
+
+        constexpr auto isFragment() const -> bool { return isFragment_; }
+
+        constexpr auto isFirstFragment() const -> bool { return isFirstFragment_; }
+
+        constexpr auto sourceAddress() const -> IpAddress {
+            return isIpv6() ? IpAddress::ipv6(bytes_.subspan<8, IpAddress::SIZE>()) : IpAddress::ipv4(detail::load32(bytes_, 12));
+        }
+
+        constexpr auto destinationAddress() const -> IpAddress {
+            return isIpv6() ? IpAddress::ipv6(bytes_.subspan<24, IpAddress::SIZE>()) : IpAddress::ipv4(detail::load32(bytes_, 16));
+        }
+
+        constexpr auto header() const -> std::span<uint8_t const> { return bytes_.first(headerLength_); }
+
+        constexpr auto payload() const -> std::span<uint8_t const> { return bytes_.subspan(headerLength_); }
+    };
+
+    class TcpHeader final {
+
+        std::span<uint8_t const> bytes_;
+
+        constexpr explicit TcpHeader(std::span<uint8_t const> const bytes) : bytes_(bytes) {}
+
+    public:
+        static constexpr size_t MIN_SIZE = 20;
+
+        static constexpr uint8_t FIN = 0x01;
+
+        static constexpr uint8_t SYN = 0x02;
+
+        static constexpr uint8_t RST = 0x04;
+
+        static constexpr uint8_t PSH = 0x08;
+
+        static constexpr uint8_t ACK = 0x10;
+
+        //
+        // Header of the segment, none unless its header, options included,
+        // fits in the bytes.
+        //
+        static constexpr auto parse(std::span<uint8_t const> const segment) -> std::optional<TcpHeader> {
+            if (segment.size() < MIN_SIZE) {
+                return std::nullopt;
+            }
+            auto const headerLength = static_cast<size_t>(segment[12] >> 4U) * 4;
+            if (headerLength < MIN_SIZE || headerLength > segment.size()) {
+                return std::nullopt;
+            }
+            return TcpHeader(segment);
+        }
+
+        //
+        // Same as above for the payload of a packet, none unless it is the
+        // first fragment of a TCP datagram.
+        //
+        static constexpr auto parse(IpHeader const &ipHeader) -> std::optional<TcpHeader> {
+            if (!ipHeader.isProtocol(IpProtocol::Tcp) || !ipHeader.isFirstFragment()) {
+                return std::nullopt;
+            }
+            return parse(ipHeader.payload());
+        }
+
+        constexpr auto sourcePort() const -> uint16_t { return detail::load16(bytes_, 0); }
+
+        constexpr auto destinationPort() const -> uint16_t { return detail::load16(bytes_, 2); }
+
+        constexpr auto sequenceNumber() const -> uint32_t { return detail::load32(bytes_, 4); }
+
+        constexpr auto acknowledgementNumber() const -> uint32_t { return detail::load32(bytes_, 8); }
+
+        constexpr auto headerLength() const -> size_t { return static_cast<size_t>(bytes_[12] >> 4U) * 4; }
+
+        constexpr auto flags() const -> uint8_t { return bytes_[13]; }
+
+        constexpr auto hasFlags(uint8_t const flags) const -> bool { return (bytes_[13] & flags) == flags; }
+
+        constexpr auto window() const -> uint16_t { return detail::load16(bytes_, 14); }
+
+        constexpr auto options() const -> std::span<uint8_t const> { return bytes_.subspan(MIN_SIZE, headerLength() - MIN_SIZE); }
+
+        constexpr auto payload() const -> std::span<uint8_t const> { return bytes_.subspan(headerLength()); }
+    };
+
+    class UdpHeader final {
+
+        //
+        // The datagram up to its length, header included.
+        //
+        std::span<uint8_t const> bytes_;
+
+        constexpr explicit UdpHeader(std::span<uint8_t const> const bytes) : bytes_(bytes) {}
+
+    public:
+        static constexpr size_t SIZE = 8;
+
+        //
+        // Header of the datagram, none unless its length fits in the bytes.
+        //
+        static constexpr auto parse(std::span<uint8_t const> const datagram) -> std::optional<UdpHeader> {
+            if (datagram.size() < SIZE) {
+                return std::nullopt;
+            }
+            auto const length = static_cast<size_t>(detail::load16(datagram, 4));
+            if (length < SIZE || length > datagram.size()) {
+                return std::nullopt;
+            }
+            return UdpHeader(datagram.first(length));
+        }
+
+        //
+        // Same as above for the payload of a packet, none unless it is the
+        // first fragment of a UDP datagram.
+        //
+        static constexpr auto parse(IpHeader const &ipHeader) -> std::optional<UdpHeader> {
+            if (!ipHeader.isProtocol(IpProtocol::Udp) || !ipHeader.isFirstFragment()) {
+                return std::nullopt;
+            }
+            return parse(ipHeader.payload());
+        }
+
+        constexpr auto sourcePort() const -> uint16_t { return detail::load16(bytes_, 0); }
+
+        constexpr auto destinationPort() const -> uint16_t { return detail::load16(bytes_, 2); }
+
+        constexpr auto length() const -> size_t { return bytes_.size(); }
+
+        constexpr auto payload() const -> std::span<uint8_t const> { return bytes_.subspan(SIZE); }
+    };
+
+    namespace detail {
+
+        constexpr auto store16(std::span<uint8_t> const bytes, size_t const offset, uint16_t const value) -> void {
+            bytes[offset] = static_cast<uint8_t>(value >> 8U);
+            bytes[offset + 1] = static_cast<uint8_t>(value);
+        }
+
+        constexpr auto store32(std::span<uint8_t> const bytes, size_t const offset, uint32_t const value) -> void {
+            store16(bytes, offset, static_cast<uint16_t>(value >> 16U));
+            store16(bytes, offset + 2, static_cast<uint16_t>(value));
+        }
+
+        constexpr auto addToChecksum(std::span<uint8_t const> const bytes, uint32_t sum) -> uint32_t {
+            if (!std::is_constant_evaluated()) {
+                return sum + sumWords(bytes);
+            }
+            for (size_t i = 0; i + 1 < bytes.size(); i += 2) {
+                sum += load16(bytes, i);
+            }
+            if (bytes.size() % 2 != 0) {
+                sum += static_cast<uint32_t>(bytes.back()) << 8U;
+            }
+            return sum;
+        }
+
+        constexpr auto finishChecksum(uint32_t sum) -> uint16_t {
+            while ((sum >> 16U) != 0) {
+                sum = (sum & 0xFFFFU) + (sum >> 16U);
+            }
+            return static_cast<uint16_t>(~sum);
+        }
+
+        //
+        // Size of the header of a packet written with writeIpHeader().
+        //
+        constexpr auto writtenHeaderSize(std::span<uint8_t const> const packet) -> size_t {
+            return (packet[0] >> 4U) == 6 ? IpHeader::IPV6_SIZE : Ipv4Header::MIN_SIZE;
+        }
+
+        //
+        // Sum of the pseudo header of the TCP or UDP segment of such a packet.
+        //
+        constexpr auto sumPseudoHeader(std::span<uint8_t const> const packet) -> uint32_t {
+            auto const headerSize = writtenHeaderSize(packet);
+            auto const segmentSize = static_cast<uint32_t>(packet.size() - headerSize);
+            if (headerSize == IpHeader::IPV6_SIZE) {
+                return addToChecksum(packet.subspan(8, 2 * IpAddress::SIZE), packet[6] + segmentSize);
+            }
+            return addToChecksum(packet.subspan(12, 8), packet[9] + segmentSize);
+        }
+    }
+
+    //
+    // Writes the header of an IPv4 packet as long as the bytes into the first
+    // Ipv4Header::MIN_SIZE of them, checksum included.  Packets are never
+    // fragmented, so the id only has to differ between packets in flight.
+    //
+    constexpr auto writeIpv4Header(std::span<uint8_t> const packet, IpProtocol const protocol, uint32_t const sourceAddress,
+                                   uint32_t const destinationAddress, uint16_t const id) -> void {
+        auto const header = packet.first(Ipv4Header::MIN_SIZE);
+        header[0] = 0x45;
+        header[1] = 0;
+        detail::store16(header, 2, static_cast<uint16_t>(packet.size()));
+        detail::store16(header, 4, id);
+        detail::store16(header, 6, 0x4000);
+        header[8] = 64;
+        header[9] = static_cast<uint8_t>(protocol);
+        detail::store16(header, 10, 0);
+        detail::store32(header, 12, sourceAddress);
+        detail::store32(header, 16, destinationAddress);
+        detail::store16(header, 10, detail::finishChecksum(detail::addToChecksum(header, 0)));
+    }
+
+    //
+    // Writes the header of an IPv6 packet as long as the bytes into the first
+    // IpHeader::IPV6_SIZE of them, without extension headers.
+    //
+    constexpr auto writeIpv6Header(std::span<uint8_t> const packet, IpProtocol const protocol, IpAddress const &sourceAddress,
+                                   IpAddress const &destinationAddress) -> void {
+        auto const header = packet.first(IpHeader::IPV6_SIZE);
+        detail::store32(header, 0, 0x60000000);
+        detail::store16(header, 4, static_cast<uint16_t>(packet.size() - IpHeader::IPV6_SIZE));
+        header[6] = static_cast<uint8_t>(protocol);
+        header[7] = 64;
+        std::ranges::copy(sourceAddress.bytes(), header.begin() + 8);
+        std::ranges::copy(destinationAddress.bytes(), header.begin() + 24);
+    }
+
+    //
+    // Bytes of the header writeIpHeader() writes for packets from the address.
+    //
+    constexpr auto ipHeaderSize(IpAddress const &sourceAddress) -> size_t {
+        return sourceAddress.isIpv4() ? Ipv4Header::MIN_SIZE : IpHeader::IPV6_SIZE;
+    }
+
+    //
+    // Writes the header of a packet between the addresses with either of the
+    // above, as their family has it; the id is only used by IPv4.
+    //
+    constexpr auto writeIpHeader(std::span<uint8_t> const packet, IpProtocol const protocol, IpAddress const &sourceAddress,
+                                 IpAddress const &destinationAddress, uint16_t const id) -> void {
+        if (sourceAddress.isIpv4()) {
+            writeIpv4Header(packet, protocol, sourceAddress.toIpv4(), destinationAddress.toIpv4(), id);
+        } else {
+            writeIpv6Header(packet, protocol, sourceAddress, destinationAddress);
+        }
+    }
+
+    //
+    // Checksum of the TCP or UDP segment of a packet written with the above,
+    // pseudo header included; the checksum field has to be 0 while it is
+    // computed.
+    //
+    constexpr auto transportChecksum(std::span<uint8_t const> const packet) -> uint16_t {
+        auto const segment = packet.subspan(detail::writtenHeaderSize(packet));
+        return detail::finishChecksum(detail::addToChecksum(segment, detail::sumPseudoHeader(packet)));
+    }
+
+    //
+    // Same as above with the payload after the first headerSize bytes of the
+    // segment already summed with sumWords(), e.g. kept with a payload sent
+    // more than once and updated for what changed in it since.
+    //
+    constexpr auto transportChecksum(std::span<uint8_t const> const packet, size_t const headerSize, uint16_t const payloadSum) -> uint16_t {
+        auto const segment = packet.subspan(detail::writtenHeaderSize(packet));
+        return detail::finishChecksum(detail::addToChecksum(segment.first(headerSize), detail::sumPseudoHeader(packet) + payloadSum));
+    }
+
+    //
+    // Writes the header of the UDP datagram of a packet whose IP header was
+    // written with one of the above, with the payload already in place.
+    //
+    constexpr auto writeUdpHeader(std::span<uint8_t> const packet, uint16_t const sourcePort, uint16_t const destinationPort) -> void {
+        auto const header = packet.subspan(detail::writtenHeaderSize(packet));
+        detail::store16(header, 0, sourcePort);
+        detail::store16(header, 2, destinationPort);
+        detail::store16(header, 4, static_cast<uint16_t>(header.size()));
+        detail::store16(header, 6, 0);
+        auto const checksum = transportChecksum(packet);
+        detail::store16(header, 6, checksum == 0 ? 0xFFFF : checksum);
+    }
+
+    //
+    // Same as above with the sum of the payload known, see transportChecksum().
+    //
+    constexpr auto writeUdpHeader(std::span<uint8_t> const packet, uint16_t const sourcePort, uint16_t const destinationPort,
+                                  uint16_t const payloadSum) -> void {
+        auto const header = packet.subspan(detail::writtenHeaderSize(packet));
+        detail::store16(header, 0, sourcePort);
+        detail::store16(header, 2, destinationPort);
+        detail::store16(header, 4, static_cast<uint16_t>(header.size()));
+        detail::store16(header, 6, 0);
+        auto const checksum = transportChecksum(packet, UdpHeader::SIZE, payloadSum);
+        detail::store16(header, 6, checksum == 0 ? 0xFFFF : checksum);
+    }
+
+    namespace detail {
+
+        //
+        // 10.0.0.2:40000 -> 1.1.1.1:53 over UDP, with a 2 byte payload.
+        //
+        constexpr std::array<uint8_t, 30> SAMPLE_UDP_PACKET = {
+                0x45, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x02,
+                0x01, 0x01, 0x01, 0x01, 0x9C, 0x40, 0x00, 0x35, 0x00, 0x0A, 0x00, 0x00, 0xAB, 0xCD,
+        };
+
+        static_assert(Ipv4Header::parse(SAMPLE_UDP_PACKET)->sourceAddress() == 0x0A000002);
+        static_assert(Ipv4Header::parse(SAMPLE_UDP_PACKET)->destinationAddress() == 0x01010101);
+        static_assert(!Ipv4Header::parse(SAMPLE_UDP_PACKET)->isFragment());
+        static_assert(UdpHeader::parse(*IpHeader::parse(SAMPLE_UDP_PACKET))->sourcePort() == 40000);
+        static_assert(UdpHeader::parse(*IpHeader::parse(SAMPLE_UDP_PACKET))->destinationPort() == 53);
+        static_assert(UdpHeader::parse(*IpHeader::parse(SAMPLE_UDP_PACKET))->payload().size() == 2);
+        static_assert(!TcpHeader::parse(*IpHeader::parse(SAMPLE_UDP_PACKET)));
+        static_assert(IpHeader::parse(SAMPLE_UDP_PACKET)->sourceAddress() == IpAddress::ipv4(0x0A000002));
+        static_assert(!Ipv4Header::parse(std::span(SAMPLE_UDP_PACKET).first(Ipv4Header::MIN_SIZE + 1)));
+
+        static_assert([] {
+            auto packet = SAMPLE_UDP_PACKET;
+            writeIpv4Header(packet, IpProtocol::Udp, 0x0A000002, 0x01010101, 0);
+            return finishChecksum(addToChecksum(std::span(packet).first(Ipv4Header::MIN_SIZE), 0)) == 0 && Ipv4Header::parse(packet).has_value();
+        }());
+
+        static_assert([] {
+            auto packet = SAMPLE_UDP_PACKET;
+            writeIpv4Header(packet, IpProtocol::Udp, 0x0A000002, 0x01010101, 0);
+            writeUdpHeader(packet, 40000, 53);
+            auto const checksum = load16(packet, Ipv4Header::MIN_SIZE + 6);
+            writeUdpHeader(packet, 40000, 53, 0xABCD);
+            return load16(packet, Ipv4Header::MIN_SIZE + 6) == checksum;
+        }());
+
+        //
+        // fd00::2:40000 -> 2001:db8::1:53 over UDP, with a hop-by-hop options
+        // and a destination options header before the 2 byte payload.
+        //
+        constexpr std::array<uint8_t, 74> SAMPLE_UDP6_PACKET = {
+                0x60, 0x00, 0x00, 0x00, 0x00, 0x22, 0x00, 0x40, 0xFD, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x20, 0x01, 0x0D, 0xB8, 0x00, 0x00, 0x00, 0x00,
+                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x3C, 0x00, 0x01, 0x04, 0x00, 0x00, 0x00, 0x00,
+                0x11, 0x01, 0x01, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                0x9C, 0x40, 0x00, 0x35, 0x00, 0x0A, 0x00, 0x00, 0xAB, 0xCD,
+        };
+
+        static_assert(IpHeader::parse(SAMPLE_UDP6_PACKET)->isIpv6() && IpHeader::parse(SAMPLE_UDP6_PACKET)->headerLength() == 64);
+        static_assert(IpHeader::parse(SAMPLE_UDP6_PACKET)->isProtocol(IpProtocol::Udp) && !IpHeader::parse(SAMPLE_UDP6_PACKET)->isFragment());
+        static_assert(!IpHeader::parse(SAMPLE_UDP6_PACKET)->sourceAddress().isIpv4());
+        static_assert(IpHeader::parse(SAMPLE_UDP6_PACKET)->destinationAddress().bytes()[1] == 0x01);
+        static_assert(UdpHeader::parse(*IpHeader::parse(SAMPLE_UDP6_PACKET))->destinationPort() == 53);
+        static_assert(UdpHeader::parse(*IpHeader::parse(SAMPLE_UDP6_PACKET))->payload().size() == 2);
+        static_assert(!IpHeader::parse(std::span(SAMPLE_UDP6_PACKET).first(60)));
+
+        //
+        // The same with a fragment header in place of the destination options,
+        // as a later fragment that carries no UDP header.
+        //
+        static_assert([] {
+            auto packet = SAMPLE_UDP6_PACKET;
+            packet[40] = 44;
+            packet[50] = 0x00;
+            packet[51] = 0x08;
+            auto const ipHeader = IpHeader::parse(packet);
+            return ipHeader && ipHeader->isFragment() && !ipHeader->isFirstFragment() && !UdpHeader::parse(*ipHeader);
+        }());
+
+        static_assert([] {
+            auto packet = std::array<uint8_t, IpHeader::IPV6_SIZE + UdpHeader::SIZE + 2>{};
+            auto const source = IpHeader::parse(SAMPLE_UDP6_PACKET)->destinationAddress();
+            auto const destination = IpHeader::parse(SAMPLE_UDP6_PACKET)->sourceAddress();
+            packet[packet.size() - 2] = 0xAB;
+            packet[packet.size() - 1] = 0xCD;
+            writeIpHeader(packet, IpProtocol::Udp, source, destination, 0);
+            writeUdpHeader(packet, 53, 40000);
+            auto const ipHeader = IpHeader::parse(packet);
+            auto const sum = finishChecksum(addToChecksum(ipHeader->payload(), sumPseudoHeader(packet)));
+            return ipHeader->sourceAddress() == source && UdpHeader::parse(*ipHeader)->destinationPort() == 40000 && sum == 0;
+        }());
+
+        //
+        // 192.168.0.1 -> 192.168.0.199 over UDP, whose source address is
+        // rewritten the way a NAT would.
+        //
+        static_assert([] {
+            std::array<uint8_t, Ipv4Header::MIN_SIZE> header = {
+                    0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11,
+                    0xB8, 0x61, 0xC0, 0xA8, 0x00, 0x01, 0xC0, 0xA8, 0x00, 0xC7,
+            };
+            auto const updated = updateChecksum(load16(header, 10), load32(header, 12), uint32_t{0x0A000002});
+            store32(header, 12, 0x0A000002);
+            store16(header, 10, 0);
+            return finishChecksum(addToChecksum(header, 0)) == updated;
+        }());
+    }
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_PACKETHEADERS_H_ */
@@ -0,0 +1,90 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <utility>
+
+#include "PacketPool.h"
+
+using namespace ai;
+
+vpn::PacketBuffer::PacketBuffer(PacketPool *const pool, uint32_t const index) : pool_(pool), index_(index) {
+}
+
+vpn::PacketBuffer::PacketBuffer(PacketBuffer &&other) noexcept
+        : pool_(std::exchange(other.pool_, nullptr)), index_(other.index_), size_(std::exchange(other.size_, 0)),
+          timestamp_(std::exchange(other.timestamp_, 0)) {
+}
+
+auto vpn::PacketBuffer::operator=(PacketBuffer &&other) noexcept -> PacketBuffer & {
+    if (this != &other) {
+        reset();
+        pool_ = std::exchange(other.pool_, nullptr);
+        index_ = other.index_;
+        size_ = std::exchange(other.size_, 0);
+        timestamp_ = std::exchange(other.timestamp_, 0);
+    }
+    return *this;
+}
+
+vpn::PacketBuffer::~PacketBuffer() {
+    reset();
+}
+
+auto vpn::PacketBuffer::data() const -> uint8_t * {
+    return pool_->slab_.get() + static_cast<size_t>(index_) * PACKET_SIZE;
+}
+
+auto vpn::PacketBuffer::reset() -> void {
+    if (pool_ != nullptr) {
+        std::exchange(pool_, nullptr)->release(index_);
+        size_ = 0;
+        timestamp_ = 0;
+    }
+}
+
+vpn::PacketPool::PacketPool(size_t const bufferCount) : slab_(std::make_unique<uint8_t[]>(bufferCount * PACKET_SIZE)) {
+    freeBuffers_.reserve(bufferCount);
+    for (auto index = bufferCount; index > 0; index--) {
+        freeBuffers_.push_back(static_cast<uint32_t>(index - 1));
+    }
+}
+
+auto vpn::PacketPool::acquire() -> PacketBuffer {
+    auto const lock = std::lock_guard(mutex_);
+    if (freeBuffers_.empty()) {
+        return {};
+    }
+    auto const index = freeBuffers_.back();
+    freeBuffers_.pop_back();
+    return {this, index};
+}
+
+auto vpn::PacketPool::release(uint32_t const index) -> void {
+    auto const lock = std::lock_guard(mutex_);
+    freeBuffers_.push_back(index);
+}
+
+auto vpn::PacketPool::available() -> size_t {
+    auto const lock = std::lock_guard(mutex_);
+    return freeBuffers_.size();
+}
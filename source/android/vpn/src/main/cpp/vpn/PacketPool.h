@@ -0,0 +1,136 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_PACKETPOOL_H_
+#define ANDROID_INTROSPECTION_VPN_PACKETPOOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ai::vpn {
+
+    //
+    // Largest packet the tunnel hands over; has to match VPN_MTU of
+    // LocalVpnService.kt.
+    //
+    constexpr size_t PACKET_SIZE = 1500;
+
+    class PacketPool;
+
+    //
+    // Move-only handle to a buffer of a PacketPool, given back to the pool
+    // when the handle is destroyed.  Handing a packet to the next stage of
+    // the pipeline moves the handle, never the bytes.
+    //
+    class PacketBuffer final {
+
+        PacketPool *pool_ = nullptr;
+
+        uint32_t index_ = 0;
+
+        size_t size_ = 0;
+
+        uint64_t timestamp_ = 0;
+
+    public:
+        PacketBuffer() = default;
+
+        PacketBuffer(PacketPool *pool, uint32_t index);
+
+        PacketBuffer(PacketBuffer &&other) noexcept;
+
+        auto operator=(PacketBuffer &&other) noexcept -> PacketBuffer &;
+
+        PacketBuffer(PacketBuffer const &) = delete;
+
+        auto operator=(PacketBuffer const &) -> PacketBuffer & = delete;
+
+        ~PacketBuffer();
+
+        explicit operator bool() const { return pool_ != nullptr; }
+
+        auto data() const -> uint8_t *;
+
+        constexpr auto capacity() const -> size_t { return PACKET_SIZE; }
+
+        //
+        // Bytes of the packet, set once it has been read into the buffer.
+        //
+        auto size() const -> size_t { return size_; }
+
+        auto setSize(size_t const size) -> void { size_ = size; }
+
+        //
+        // getLatencyTime() of when the packet entered the pipeline, 0 if it
+        // is not timed.
+        //
+        auto timestamp() const -> uint64_t { return timestamp_; }
+
+        auto setTimestamp(uint64_t const timestamp) -> void { timestamp_ = timestamp; }
+
+        auto reset() -> void;
+    };
+
+    //
+    // Fixed slab of PACKET_SIZE buffers, allocated once, so that packets can
+    // outlive a read and move between threads without the pipeline
+    // allocating in steady state.  Buffers may be acquired and released from
+    // any thread; the pool has to outlive them.
+    //
+    class PacketPool final {
+
+        friend class PacketBuffer;
+
+        std::unique_ptr<uint8_t[]> const slab_;
+
+        std::mutex mutex_;
+
+        //
+        // Indices of the free buffers, used as a stack so that the most
+        // recently released, and most likely cached, buffer is reused first.
+        //
+        std::vector<uint32_t> freeBuffers_;
+
+        auto release(uint32_t index) -> void;
+
+    public:
+        explicit PacketPool(size_t bufferCount);
+
+        PacketPool(PacketPool const &) = delete;
+
+        auto operator=(PacketPool const &) -> PacketPool & = delete;
+
+        //
+        // A free buffer, or an empty handle if they are all in use, which
+        // callers treat as back pressure.
+        //
+        auto acquire() -> PacketBuffer;
+
+        auto available() -> size_t;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_PACKETPOOL_H_ */
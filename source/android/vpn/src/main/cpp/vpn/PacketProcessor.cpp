@@ -0,0 +1,289 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <array>
+#include <atomic>
+#include <span>
+
+#include "utils/log.h"
+#include "utils/trace.h"
+#include "PacketHeaders.h"
+#include "PacketProcessor.h"
+
+using namespace ai;
+
+namespace {
+
+    //
+    // Flows without a packet for this long are dropped, in milliseconds; the
+    // tunnel does not tell when a UDP flow ends.  Open TCP connections probe
+    // the app before, so that only those it left are dropped.
+    //
+    constexpr uint64_t FLOW_IDLE_TIMEOUT = 2 * 60 * 1000;
+
+    //
+    // Owners taken from the attributor at once.
+    //
+    constexpr size_t OWNER_BATCH_SIZE = 64;
+
+    //
+    // Updated by every worker and only read for stats, so relaxed atomics
+    // are enough.
+    //
+    struct TrafficCounters {
+
+        std::atomic_uint64_t packets{0};
+
+        std::atomic_uint64_t bytes{0};
+
+        auto add(size_t const length) -> void {
+            packets.fetch_add(1, std::memory_order_relaxed);
+            bytes.fetch_add(length, std::memory_order_relaxed);
+        }
+
+        auto format(char const *const protocol) const -> std::string {
+            return std::string(protocol) + ".packets " + std::to_string(packets.load(std::memory_order_relaxed)) + "\n" +
+                   std::string(protocol) + ".bytes " + std::to_string(bytes.load(std::memory_order_relaxed)) + "\n";
+        }
+    };
+
+    TrafficCounters gTcpCounters;
+
+    TrafficCounters gUdpCounters;
+
+    TrafficCounters gOtherCounters;
+}
+
+vpn::PacketProcessor::PacketProcessor(FlowTableShard &flows, TimerWheel &timers, TcpForwarder *const tcpForwarder, UdpForwarder *const udpForwarder,
+                                      DnsInterceptor *const dnsInterceptor, HostnameTable const &hostnames, TlsInspector &tlsInspector,
+                                      PacketSummaryRing &summaries, SharedPacketFilter const &inspectionFilter, FlowAttributor &attributor,
+                                      StatsReporter &reporter, FlowLog &flowLog, size_t const worker)
+        : flows_(flows), timers_(timers), tcpForwarder_(tcpForwarder), udpForwarder_(udpForwarder), dnsInterceptor_(dnsInterceptor),
+          hostnames_(hostnames), tlsInspector_(tlsInspector), summaries_(summaries), inspectionFilter_(inspectionFilter), attributor_(attributor),
+          reporter_(reporter), flowLog_(flowLog), worker_(worker) {
+}
+
+//
+// Closes the session forwarding the flow, if any.
+//
+auto vpn::PacketProcessor::abortFlow(Flow &flow) -> void {
+    if (flow.key.protocol == static_cast<uint8_t>(IpProtocol::Tcp) && tcpForwarder_ != nullptr) {
+        tcpForwarder_->abort(flow);
+    } else if (flow.key.protocol == static_cast<uint8_t>(IpProtocol::Udp) && udpForwarder_ != nullptr) {
+        udpForwarder_->abort(flow);
+    }
+}
+
+//
+// Names the flow by what it was opened with or else by the DNS answer its
+// address came in.
+//
+auto vpn::PacketProcessor::logFlow(Flow &flow, uint8_t const flags) -> void {
+    auto const &serverName = flows_.names(flow).serverName;
+    if (serverName.empty()) {
+        flowLog_.append(flow, hostnames_.find(flow.key.destinationAddress, now_), flags);
+    } else {
+        flowLog_.append(flow, serverName, flags);
+    }
+}
+
+//
+// Queues the traffic of the flow since its last report, unless it had
+// none; false if the queue is full, which leaves it for the next report.
+//
+auto vpn::PacketProcessor::reportFlow(Flow &flow) -> bool {
+    auto const traffic = flow.traffic();
+    if ((traffic - flow.reported).isEmpty()) {
+        return true;
+    }
+    if (!reporter_.push(worker_, FlowStats{flow.key, flow.uid, traffic - flow.reported})) {
+        return false;
+    }
+    flow.reported = traffic;
+    return true;
+}
+
+//
+// Erases the flow, reporting what is left of its traffic first, so that
+// short flows are not missed.
+//
+auto vpn::PacketProcessor::eraseFlow(Flow &flow) -> void {
+    if (reporter_.isEnabled()) {
+        reportFlow(flow);
+    }
+    if (flowLog_.isEnabled()) {
+        logFlow(flow, FlowLog::CLOSED);
+    }
+    tlsInspector_.forget(flow);
+    flows_.erase(flow.key);
+}
+
+//
+// Packets only note when they came, so the idle timer is moved once per
+// timeout at most rather than with every packet.
+//
+auto vpn::PacketProcessor::expireFlowIfIdle(Flow &flow) -> void {
+    auto const deadline = flow.lastActive + FLOW_IDLE_TIMEOUT;
+    if (deadline > timers_.now()) {
+        timers_.schedule(flows_.idleTimer(flow), deadline);
+        return;
+    }
+    LOGD("expireFlowIfIdle dropping flow of %llu packets, %zu left", static_cast<unsigned long long>(flow.packets), flows_.size() - 1);
+    abortFlow(flow);
+    eraseFlow(flow);
+}
+
+auto vpn::PacketProcessor::trackFlow(FlowKey const &key, std::span<uint8_t const> const packet) -> Flow * {
+    auto *const flow = flows_.findOrInsert(key);
+    if (flow != nullptr) {
+        if (flow->packets == 0) {
+            flow->firstActive = now_;
+            flow->isInspected = !inspectionFilter_.matches(packet);
+            auto &idleTimer = flows_.idleTimer(*flow);
+            idleTimer.setOnExpired([this, flow] { expireFlowIfIdle(*flow); });
+            timers_.schedule(idleTimer, now_ + FLOW_IDLE_TIMEOUT);
+            if (key.protocol == static_cast<uint8_t>(IpProtocol::Tcp) || key.protocol == static_cast<uint8_t>(IpProtocol::Udp)) {
+                attributor_.request(key, worker_);
+            }
+        }
+        flow->packets++;
+        flow->bytes += packet.size();
+        flow->lastActive = now_;
+    }
+    return flow;
+}
+
+//
+// Only reads the headers in place; pcapplusplus is kept for inspecting
+// packets in depth, which most of them never need.
+//
+auto vpn::PacketProcessor::process(PacketBuffer &buffer) -> void {
+    TRACE_SPAN("PacketProcessor::process");
+    auto const dataLength = buffer.size();
+    auto const packet = std::span<uint8_t const>(buffer.data(), dataLength);
+    auto const ipHeader = IpHeader::parse(packet);
+    if (!ipHeader) {
+        return;
+    }
+
+    auto key = FlowKey{ipHeader->sourceAddress(), ipHeader->destinationAddress(), 0, 0, ipHeader->protocol()};
+    if (auto const tcpHeader = TcpHeader::parse(*ipHeader)) {
+        gTcpCounters.add(dataLength);
+        key.sourcePort = tcpHeader->sourcePort();
+        key.destinationPort = tcpHeader->destinationPort();
+        auto const isReset = tcpHeader->hasFlags(TcpHeader::RST);
+        auto *const flow = isReset ? flows_.find(key) : trackFlow(key, packet);
+        summaries_.publish(key, dataLength, tcpHeader->flags(), 0, flow != nullptr ? flow->uid : UNKNOWN_UID);
+        if (flow != nullptr) {
+            if (flow->packets == 1) {
+                LOGD("process new tcp flow to [%s]", hostnames_.find(key.destinationAddress, now_).c_str());
+            }
+            if (!flow->isInspected && !tcpHeader->payload().empty()) {
+                tlsInspector_.inspect(*flow, flows_.names(*flow), *tcpHeader);
+            }
+            if (tcpForwarder_ != nullptr) {
+                tcpForwarder_->handleSegment(*tcpHeader, *flow, now_, &buffer);
+            }
+            if (isReset) {
+                eraseFlow(*flow);
+            }
+        }
+        //
+        // The forwarder may have taken the buffer, so only the key is left.
+        //
+        LOGD("process processing tcp packet: sourceIP [%s], sourcePort [%hu], destinationIP [%s], destinationPort [%hu]",
+             key.sourceAddress.format().data(), key.sourcePort, key.destinationAddress.format().data(), key.destinationPort);
+
+    } else if (auto const udpHeader = UdpHeader::parse(*ipHeader)) {
+        gUdpCounters.add(dataLength);
+        key.sourcePort = udpHeader->sourcePort();
+        key.destinationPort = udpHeader->destinationPort();
+        auto *const flow = trackFlow(key, packet);
+        summaries_.publish(key, dataLength, 0, 0, flow != nullptr ? flow->uid : UNKNOWN_UID);
+        if (flow != nullptr && (dnsInterceptor_ == nullptr || key.destinationPort != DNS_PORT ||
+                                !dnsInterceptor_->handleQuery(*ipHeader, *udpHeader, now_)) && udpForwarder_ != nullptr) {
+            udpForwarder_->handleDatagram(*udpHeader, *flow, now_);
+        }
+        LOGD("process processing udp packet: sourceIP [%s], sourcePort [%hu], destinationIP [%s], destinationPort [%hu]",
+             key.sourceAddress.format().data(), udpHeader->sourcePort(),
+             key.destinationAddress.format().data(), udpHeader->destinationPort());
+
+    } else {
+        gOtherCounters.add(dataLength);
+        auto const *const flow = trackFlow(key, packet);
+        summaries_.publish(key, dataLength, 0, 0, flow != nullptr ? flow->uid : UNKNOWN_UID);
+        LOGD("process processing unknown packet:  sourceIP [%s], destinationIP [%s]",
+             key.sourceAddress.format().data(), key.destinationAddress.format().data());
+    }
+}
+
+auto vpn::PacketProcessor::applyOwners() -> void {
+    auto owners = std::array<FlowOwner, OWNER_BATCH_SIZE>{};
+    for (auto count = attributor_.popOwners(worker_, owners); count > 0; count = attributor_.popOwners(worker_, owners)) {
+        for (auto const &owner : std::span(owners).first(count)) {
+            if (auto *const flow = flows_.find(owner.key)) {
+                flow->uid = owner.uid;
+            }
+        }
+    }
+}
+
+auto vpn::PacketProcessor::reportStats() -> void {
+    if (!reporter_.takeRequest(worker_)) {
+        return;
+    }
+    TRACE_SPAN("PacketProcessor::reportStats");
+    auto isFull = false;
+    flows_.forEach([this, &isFull](Flow &flow) {
+        isFull = isFull || !reportFlow(flow);
+    });
+}
+
+auto vpn::PacketProcessor::logFlows() -> void {
+    auto const interval = flowLog_.interval();
+    auto const now = timers_.now();
+    if (!flowLog_.isEnabled() || interval == 0 || now - lastLogged_ < interval) {
+        return;
+    }
+    TRACE_SPAN("PacketProcessor::logFlows");
+    flows_.forEach([this](Flow &flow) {
+        if (flow.lastActive >= lastLogged_) {
+            logFlow(flow, 0);
+        }
+    });
+    lastLogged_ = now;
+}
+
+auto vpn::PacketProcessor::expireFlows() -> size_t {
+    TRACE_SPAN("PacketProcessor::expireFlows");
+    return flows_.expire(UINT64_MAX, [this](Flow &flow) {
+        abortFlow(flow);
+        if (flowLog_.isEnabled()) {
+            logFlow(flow, FlowLog::CLOSED);
+        }
+    });
+}
+
+auto vpn::getTrafficStats() -> std::string {
+    return gTcpCounters.format("tcp") + gUdpCounters.format("udp") + gOtherCounters.format("other");
+}
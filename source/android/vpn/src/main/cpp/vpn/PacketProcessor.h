@@ -0,0 +1,166 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_PACKETPROCESSOR_H_
+#define ANDROID_INTROSPECTION_VPN_PACKETPROCESSOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "DnsInterceptor.h"
+#include "FlowAttribution.h"
+#include "FlowLog.h"
+#include "FlowTable.h"
+#include "PacketFilter.h"
+#include "PacketPool.h"
+#include "PacketSummaryRing.h"
+#include "StatsReporter.h"
+#include "TcpForwarder.h"
+#include "TimerWheel.h"
+#include "TlsInspector.h"
+#include "UdpForwarder.h"
+
+namespace ai::vpn {
+
+    //
+    // Queries to this port go to the DNS interceptor, if the worker has one.
+    //
+    constexpr uint16_t DNS_PORT = 53;
+
+    //
+    // What a worker hands every packet to, from wherever it came: its
+    // headers are read in place, its flow tracked, inspected and summarized,
+    // and the packet forwarded; flows are logged as they end, if the log is
+    // open.  Without forwarders packets are only
+    // tracked, as when a capture is replayed.  Runs on the packet loop of
+    // one worker, whose stages it takes by reference; it does not move, as
+    // the idle timers of its flows point back to it.
+    //
+    class PacketProcessor final {
+
+        FlowTableShard &flows_;
+
+        TimerWheel &timers_;
+
+        TcpForwarder *const tcpForwarder_;
+
+        UdpForwarder *const udpForwarder_;
+
+        //
+        // Only the first worker, which every DNS query goes to, has one.
+        //
+        DnsInterceptor *const dnsInterceptor_;
+
+        HostnameTable const &hostnames_;
+
+        TlsInspector &tlsInspector_;
+
+        PacketSummaryRing &summaries_;
+
+        SharedPacketFilter const &inspectionFilter_;
+
+        FlowAttributor &attributor_;
+
+        StatsReporter &reporter_;
+
+        FlowLog &flowLog_;
+
+        //
+        // Index of the worker, which owners and traffic of its flows are
+        // queued by.
+        //
+        size_t const worker_;
+
+        uint64_t now_ = 0;
+
+        //
+        // Time the active flows were last logged at.
+        //
+        uint64_t lastLogged_ = 0;
+
+        auto abortFlow(Flow &flow) -> void;
+
+        auto logFlow(Flow &flow, uint8_t flags) -> void;
+
+        auto reportFlow(Flow &flow) -> bool;
+
+        auto eraseFlow(Flow &flow) -> void;
+
+        auto expireFlowIfIdle(Flow &flow) -> void;
+
+        auto trackFlow(FlowKey const &key, std::span<uint8_t const> packet) -> Flow *;
+
+    public:
+        PacketProcessor(FlowTableShard &flows, TimerWheel &timers, TcpForwarder *tcpForwarder, UdpForwarder *udpForwarder,
+                        DnsInterceptor *dnsInterceptor, HostnameTable const &hostnames, TlsInspector &tlsInspector, PacketSummaryRing &summaries,
+                        SharedPacketFilter const &inspectionFilter, FlowAttributor &attributor, StatsReporter &reporter, FlowLog &flowLog,
+                        size_t worker);
+
+        PacketProcessor(PacketProcessor const &) = delete;
+
+        auto operator=(PacketProcessor const &) -> PacketProcessor & = delete;
+
+        //
+        // Time, in milliseconds, the packets handed over next came at.
+        //
+        auto setTime(uint64_t const now) -> void { now_ = now; }
+
+        //
+        // A packet of the tunnel, whose buffer the TCP forwarder may take.
+        //
+        auto process(PacketBuffer &packet) -> void;
+
+        //
+        // Stores the owners the attributor looked up in the flows they are
+        // of, unless a flow is gone meanwhile.
+        //
+        auto applyOwners() -> void;
+
+        //
+        // Walks the flows once the reporter asked for their traffic; the walk
+        // stops at the first flow the queue is full for.
+        //
+        auto reportStats() -> void;
+
+        //
+        // Logs every flow active since the last time, once the interval of
+        // the log has passed.
+        //
+        auto logFlows() -> void;
+
+        //
+        // Drops every flow, closing the sessions forwarding them and logging
+        // them as closed.
+        //
+        auto expireFlows() -> size_t;
+    };
+
+    //
+    // Packets and bytes processed per protocol since the library was
+    // loaded, one "name value" per line.
+    //
+    auto getTrafficStats() -> std::string;
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_PACKETPROCESSOR_H_ */
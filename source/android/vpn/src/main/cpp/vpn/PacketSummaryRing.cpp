@@ -0,0 +1,171 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#if defined(__ANDROID__)
+#include <android/sharedmem.h>
+#endif
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "PacketHeaders.h"
+#include "PacketSummaryRing.h"
+
+using namespace ai;
+
+namespace {
+
+    auto getBootTime() -> uint64_t {
+        auto now = timespec{};
+        clock_gettime(CLOCK_BOOTTIME, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1'000'000'000U + static_cast<uint64_t>(now.tv_nsec);
+    }
+
+    //
+    // Host builds, e.g. of the benchmark, have no ashmem; a memfd stands in,
+    // which is not made read only for the mappings of others.
+    //
+    auto createSharedMemory(char const *const name, size_t const size) -> int {
+#if defined(__ANDROID__)
+        return ASharedMemory_create(name, size);
+#else
+        auto const fd = memfd_create(name, MFD_CLOEXEC);
+        if (fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+#endif
+    }
+
+    auto protectSharedMemory([[maybe_unused]] int const fd) -> bool {
+#if defined(__ANDROID__)
+        return ASharedMemory_setProt(fd, PROT_READ) == 0;
+#else
+        return true;
+#endif
+    }
+}
+
+vpn::PacketSummaryRing::PacketSummaryRing(size_t const capacity)
+        : fd_(createSharedMemory("vpn-packet-summaries", sizeof(Header) + std::bit_ceil(std::max<size_t>(capacity, 1)) * sizeof(Record))),
+          capacity_(std::bit_ceil(std::max<size_t>(capacity, 1))), size_(sizeof(Header) + capacity_ * sizeof(Record)) {
+    if (fd_ < 0) {
+        LOGE("PacketSummaryRing unable to create shared memory, %s", strerror(errno));
+        return;
+    }
+    memory_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (memory_ == MAP_FAILED) {
+        LOGE("PacketSummaryRing unable to map shared memory, %s", strerror(errno));
+        memory_ = nullptr;
+        return;
+    }
+
+    //
+    // Mappings made from the descriptor from here on, e.g. by the UI, are
+    // read only; this one stays writable.
+    //
+    if (!protectSharedMemory(fd_)) {
+        LOGW("PacketSummaryRing unable to make shared memory read only, %s", strerror(errno));
+    }
+    header_ = new (memory_) Header();
+    header_->recordSize = sizeof(Record);
+    header_->capacity = static_cast<uint32_t>(capacity_);
+    header_->recordsOffset = sizeof(Header);
+    records_ = new (static_cast<std::byte *>(memory_) + sizeof(Header)) Record[capacity_];
+}
+
+vpn::PacketSummaryRing::~PacketSummaryRing() {
+    if (memory_ != nullptr) {
+        munmap(memory_, size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+auto vpn::PacketSummaryRing::share() -> int {
+    if (!isValid()) {
+        return -1;
+    }
+    auto const fd = dup(fd_);
+    if (fd < 0) {
+        LOGE("PacketSummaryRing::share unable to duplicate descriptor, %s", strerror(errno));
+        return -1;
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+    return fd;
+}
+
+//
+// The sequence is cleared before the fields are written and set after,
+// both ordered by release, so that a reader never takes a record whose
+// sequence it expects while it is half written.
+//
+auto vpn::PacketSummaryRing::publish(FlowKey const &key, size_t const length, uint8_t const tcpFlags, uint8_t const flags, int32_t const uid)
+        -> void {
+    if (!isEnabled()) {
+        return;
+    }
+    auto const sequence = header_->head.fetch_add(1, std::memory_order_relaxed);
+    auto &record = records_[sequence & (capacity_ - 1)];
+    record.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.timestamp = getBootTime();
+    record.sourceAddress = key.sourceAddress;
+    record.destinationAddress = key.destinationAddress;
+    record.sourcePort = key.sourcePort;
+    record.destinationPort = key.destinationPort;
+    record.length = static_cast<uint32_t>(length);
+    record.uid = uid;
+    record.protocol = key.protocol;
+    record.flags = flags;
+    record.tcpFlags = tcpFlags;
+    record.sequence.store(sequence + 1, std::memory_order_release);
+}
+
+auto vpn::PacketSummaryRing::publish(std::span<uint8_t const> const packet, uint8_t const flags, int32_t const uid) -> void {
+    if (!isEnabled()) {
+        return;
+    }
+    auto const ipHeader = IpHeader::parse(packet);
+    if (!ipHeader) {
+        return;
+    }
+    auto key = FlowKey{ipHeader->sourceAddress(), ipHeader->destinationAddress(), 0, 0, ipHeader->protocol()};
+    auto tcpFlags = uint8_t{0};
+    if (auto const tcpHeader = TcpHeader::parse(*ipHeader)) {
+        key.sourcePort = tcpHeader->sourcePort();
+        key.destinationPort = tcpHeader->destinationPort();
+        tcpFlags = tcpHeader->flags();
+    } else if (auto const udpHeader = UdpHeader::parse(*ipHeader)) {
+        key.sourcePort = udpHeader->sourcePort();
+        key.destinationPort = udpHeader->destinationPort();
+    }
+    publish(key, packet.size(), tcpFlags, flags, uid);
+}
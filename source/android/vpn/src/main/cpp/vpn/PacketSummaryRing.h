@@ -0,0 +1,168 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_PACKETSUMMARYRING_H_
+#define ANDROID_INTROSPECTION_VPN_PACKETSUMMARYRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "FlowTable.h"
+
+namespace ai::vpn {
+
+    //
+    // Summaries of the packets of the tunnel in a ring of fixed size records
+    // in shared memory, which the UI maps once and reads at its own pace
+    // without a binder call per packet.  Workers write records as packets
+    // go by, claiming slots with one atomic add, and never wait for readers:
+    // a reader falling more than a ring behind loses the oldest records.
+    //
+    // Layout, in native byte order, as PacketSummaryReader reads it:
+    //
+    //   0    magic, version, record size, capacity and records offset, u32
+    //   64   sequence of the next record to be claimed, u64
+    //   128  records, capacity of them
+    //
+    // A record holds its sequence plus 1 once written, 0 while it is, so
+    // that a reader can tell a record being written or overwritten from
+    // one it can take; it reads the sequence again after the fields, as
+    // for a seqlock.  Addresses and ports are those of the packet, the
+    // former as the 16 bytes of IpAddress in network order and the latter
+    // in host order, and timestamps are of CLOCK_BOOTTIME, which
+    // SystemClock.elapsedRealtimeNanos() reads.
+    //
+    class PacketSummaryRing final {
+    public:
+        static constexpr uint32_t MAGIC = 0x534E5056;
+
+        static constexpr uint32_t VERSION = 2;
+
+        //
+        // Flags of a record.
+        //
+        static constexpr uint8_t TO_APP = 1U << 0U;
+
+        struct Header {
+
+            uint32_t magic = MAGIC;
+
+            uint32_t version = VERSION;
+
+            uint32_t recordSize = 0;
+
+            uint32_t capacity = 0;
+
+            uint32_t recordsOffset = 0;
+
+            alignas(64) std::atomic_uint64_t head{0};
+        };
+
+        struct Record {
+
+            std::atomic_uint64_t sequence{0};
+
+            uint64_t timestamp = 0;
+
+            IpAddress sourceAddress;
+
+            IpAddress destinationAddress;
+
+            uint16_t sourcePort = 0;
+
+            uint16_t destinationPort = 0;
+
+            uint32_t length = 0;
+
+            int32_t uid = UNKNOWN_UID;
+
+            uint8_t protocol = 0;
+
+            uint8_t flags = 0;
+
+            uint8_t tcpFlags = 0;
+
+            uint8_t reserved = 0;
+        };
+
+        static_assert(sizeof(Header) == 128 && sizeof(Record) == 64);
+
+    private:
+        int const fd_;
+
+        size_t const capacity_;
+
+        size_t const size_;
+
+        void *memory_ = nullptr;
+
+        Header *header_ = nullptr;
+
+        Record *records_ = nullptr;
+
+        //
+        // Records are only written once the memory was shared, so that the
+        // packet path does not pay for a ring nobody reads.
+        //
+        std::atomic_bool enabled_{false};
+
+    public:
+        //
+        // Capacity is rounded up to a power of 2.
+        //
+        explicit PacketSummaryRing(size_t capacity);
+
+        PacketSummaryRing(PacketSummaryRing const &) = delete;
+
+        auto operator=(PacketSummaryRing const &) -> PacketSummaryRing & = delete;
+
+        ~PacketSummaryRing();
+
+        auto isValid() const -> bool { return header_ != nullptr; }
+
+        //
+        // Descriptor of the shared memory for the caller to own and hand
+        // over, read only, -1 if there is none.  Records are written from
+        // the first call on.
+        //
+        auto share() -> int;
+
+        //
+        // Writes a record for a packet of the flow of the key, with the
+        // addresses of the key as they are.  Any thread.
+        //
+        auto publish(FlowKey const &key, size_t length, uint8_t tcpFlags, uint8_t flags, int32_t uid) -> void;
+
+        //
+        // Same as above, with the key and TCP flags read from the headers of
+        // the packet.
+        //
+        auto publish(std::span<uint8_t const> packet, uint8_t flags, int32_t uid) -> void;
+
+        auto isEnabled() const -> bool { return enabled_.load(std::memory_order_relaxed); }
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_PACKETSUMMARYRING_H_ */
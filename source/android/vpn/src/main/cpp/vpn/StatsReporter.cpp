@@ -0,0 +1,213 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <span>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+
+#include "utils/log.h"
+#include "utils/trace.h"
+#include "StatsReporter.h"
+
+using namespace ai;
+
+namespace {
+
+    constexpr size_t POP_BATCH_SIZE = 64;
+
+    std::atomic_uint64_t gReports{0};
+
+    std::atomic_uint64_t gReportedFlows{0};
+
+    std::atomic_uint64_t gDeferredFlows{0};
+
+    auto signalEventFd(int const eventFd) -> void {
+        auto const count = uint64_t{1};
+        if (write(eventFd, &count, sizeof(count)) != sizeof(count)) {
+            LOGE("signalEventFd unable to signal eventfd, %s", strerror(errno));
+        }
+    }
+
+    auto getMonotonicTime() -> uint64_t {
+        auto const now = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    }
+}
+
+vpn::StatsReporter::StatsReporter(StatsCallback onReport, uint64_t const interval, std::vector<int> workerWakeFds, size_t const queueSize,
+                                  std::vector<LatencySource> latencySources)
+        : onReport_(std::move(onReport)), interval_(interval), wakeFd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+          requested_(std::make_unique<std::atomic_bool[]>(workerWakeFds.size())), workerWakeFds_(std::move(workerWakeFds)),
+          latencySources_(std::move(latencySources)), latencyCounts_(latencySources_.size()) {
+    if (wakeFd_ < 0) {
+        LOGE("StatsReporter unable to create eventfd, %s", strerror(errno));
+    }
+    flows_.reserve(workerWakeFds_.size());
+    for (size_t index = 0; index < workerWakeFds_.size(); index++) {
+        flows_.push_back(std::make_unique<utils::SpscRingBuffer<FlowStats>>(queueSize));
+    }
+    report_.flows.reserve(queueSize * workerWakeFds_.size());
+    report_.latencies.reserve(latencySources_.size());
+}
+
+vpn::StatsReporter::~StatsReporter() {
+    if (wakeFd_ >= 0) {
+        close(wakeFd_);
+    }
+}
+
+auto vpn::StatsReporter::setInterval(uint64_t const interval) -> void {
+    interval_.store(interval, std::memory_order_relaxed);
+    signalEventFd(wakeFd_);
+}
+
+auto vpn::StatsReporter::takeRequest(size_t const worker) -> bool {
+    return requested_[worker].load(std::memory_order_relaxed) && requested_[worker].exchange(false, std::memory_order_acq_rel);
+}
+
+auto vpn::StatsReporter::push(size_t const worker, FlowStats const &stats) -> bool {
+    if (!flows_[worker]->tryPush(FlowStats(stats))) {
+        gDeferredFlows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+//
+// Moves what the workers queued into the report, summing the traffic of
+// the flows of each app as it goes, and adds the latencies of each stage
+// since the previous call.
+//
+auto vpn::StatsReporter::collect() -> void {
+    TRACE_SPAN("StatsReporter::collect");
+    report_.flows.clear();
+    report_.apps.clear();
+    appIndices_.clear();
+    auto batch = std::array<FlowStats, POP_BATCH_SIZE>{};
+    for (auto const &flows : flows_) {
+        for (auto popped = flows->popBatch(batch); popped > 0; popped = flows->popBatch(batch)) {
+            for (auto const &stats : std::span(batch).first(popped)) {
+                report_.flows.push_back(stats);
+                auto const [entry, inserted] = appIndices_.emplace(stats.uid, report_.apps.size());
+                if (inserted) {
+                    report_.apps.push_back(AppStats{stats.uid, {}});
+                }
+                report_.apps[entry->second].traffic += stats.traffic;
+            }
+        }
+    }
+
+    report_.latencies.clear();
+    for (size_t index = 0; index < latencySources_.size(); index++) {
+        auto counts = LatencyCounts();
+        for (auto const *const histogram : latencySources_[index].histograms) {
+            counts.add(*histogram);
+        }
+        report_.latencies.push_back(counts.since(latencyCounts_[index], latencySources_[index].stage));
+        latencyCounts_[index] = counts;
+    }
+}
+
+//
+// Workers still holding a request are not woken again.
+//
+auto vpn::StatsReporter::requestReports() -> void {
+    for (size_t index = 0; index < workerWakeFds_.size(); index++) {
+        if (!requested_[index].exchange(true, std::memory_order_acq_rel)) {
+            signalEventFd(workerWakeFds_[index]);
+        }
+    }
+}
+
+//
+// Waits out the interval from the previous request, so that reports keep
+// their pace however long the callback takes.  A change of the interval
+// drops what was queued and starts over with a baseline.
+//
+auto vpn::StatsReporter::run(int const stopFd) -> void {
+    LOGI("StatsReporter::run start");
+    auto fds = std::array<pollfd, 2>{pollfd{wakeFd_, POLLIN, 0}, pollfd{stopFd, POLLIN, 0}};
+    auto isBaseline = true;
+    auto lastRequest = getMonotonicTime();
+    if (isEnabled()) {
+        requestReports();
+    }
+    while (true) {
+        auto const interval = interval_.load(std::memory_order_relaxed);
+        auto const deadline = lastRequest + interval;
+        auto const now = getMonotonicTime();
+        auto const timeout = interval == 0 ? -1 : static_cast<int>(deadline > now ? deadline - now : 0);
+        auto const ready = poll(fds.data(), fds.size(), timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOGE("StatsReporter::run unable to wait, %s", strerror(errno));
+            break;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            break;
+        }
+        if (ready > 0) {
+            auto count = uint64_t{0};
+            while (read(wakeFd_, &count, sizeof(count)) < 0 && errno == EINTR) {
+            }
+            LOGI("StatsReporter::run interval set to %llu ms", static_cast<unsigned long long>(interval_.load(std::memory_order_relaxed)));
+            collect();
+            isBaseline = true;
+            lastRequest = getMonotonicTime();
+            if (isEnabled()) {
+                requestReports();
+            }
+            continue;
+        }
+
+        collect();
+        auto const requested = getMonotonicTime();
+        if (!isBaseline) {
+            report_.interval = requested - lastRequest;
+            gReports.fetch_add(1, std::memory_order_relaxed);
+            gReportedFlows.fetch_add(report_.flows.size(), std::memory_order_relaxed);
+            if (onReport_) {
+                TRACE_SPAN("StatsReporter::report");
+                onReport_(report_);
+            }
+        }
+        isBaseline = false;
+        lastRequest = requested;
+        requestReports();
+    }
+    LOGI("StatsReporter::run finished");
+}
+
+auto vpn::getReporterStats() -> std::string {
+    return "stats.reports " + std::to_string(gReports.load(std::memory_order_relaxed)) + "\n" +
+           "stats.flows " + std::to_string(gReportedFlows.load(std::memory_order_relaxed)) + "\n" +
+           "stats.deferred " + std::to_string(gDeferredFlows.load(std::memory_order_relaxed)) + "\n";
+}
@@ -0,0 +1,193 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_STATSREPORTER_H_
+#define ANDROID_INTROSPECTION_VPN_STATSREPORTER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/ring_buffer.h"
+#include "FlowTable.h"
+#include "LatencyHistogram.h"
+
+namespace ai::vpn {
+
+    //
+    // Traffic of a flow since it was last reported.
+    //
+    struct FlowStats {
+
+        FlowKey key;
+
+        int32_t uid = UNKNOWN_UID;
+
+        FlowTraffic traffic;
+    };
+
+    //
+    // Traffic of every flow of an app over the same interval.
+    //
+    struct AppStats {
+
+        int32_t uid = UNKNOWN_UID;
+
+        FlowTraffic traffic;
+    };
+
+    //
+    // Traffic of the tunnel since the previous report, with the flows that
+    // had any and their sums per app.
+    //
+    struct StatsReport {
+
+        //
+        // Milliseconds since the previous report.
+        //
+        uint64_t interval = 0;
+
+        std::vector<FlowStats> flows;
+
+        std::vector<AppStats> apps;
+
+        //
+        // Latencies of each stage of the pipeline over the interval.
+        //
+        std::vector<LatencyStats> latencies;
+    };
+
+    //
+    // Histograms of the threads recording latencies of a stage, summed in
+    // its report.  They have to outlive the reporter.
+    //
+    struct LatencySource {
+
+        std::string stage;
+
+        std::vector<LatencyHistogram const *> histograms;
+    };
+
+    //
+    // Called on the thread of the reporter with every report, e.g. to hand
+    // it over binder in one call.
+    //
+    using StatsCallback = std::function<void(StatsReport const &)>;
+
+    //
+    // Gathers the traffic of the flows of every worker at an interval and
+    // hands it to a callback in one report.  Each turn the reporter takes
+    // what the workers queued since the previous one, then asks them for
+    // the next through their eventfds; workers walk their flows and queue
+    // the traffic of each since its last report, so that the packet path
+    // only bumps counters.  Latencies are read from the histograms of the
+    // sources as they are and diffed with the previous report.  A flow the queue has no room for is left for
+    // the next report.  The first report after the interval is set is only
+    // a baseline of the traffic so far and is not handed over.
+    //
+    class StatsReporter final {
+
+        StatsCallback const onReport_;
+
+        std::atomic_uint64_t interval_;
+
+        //
+        // eventfd waking the thread of the reporter when the interval changes.
+        //
+        int const wakeFd_;
+
+        std::vector<std::unique_ptr<utils::SpscRingBuffer<FlowStats>>> flows_;
+
+        std::unique_ptr<std::atomic_bool[]> requested_;
+
+        std::vector<int> const workerWakeFds_;
+
+        //
+        // Only used by the thread of the reporter; both keep their capacity
+        // across reports.
+        //
+        StatsReport report_;
+
+        std::unordered_map<int32_t, size_t> appIndices_;
+
+        std::vector<LatencySource> const latencySources_;
+
+        //
+        // Counts of each source as of the previous report.
+        //
+        std::vector<LatencyCounts> latencyCounts_;
+
+        auto collect() -> void;
+
+        auto requestReports() -> void;
+
+    public:
+        StatsReporter(StatsCallback onReport, uint64_t interval, std::vector<int> workerWakeFds, size_t queueSize,
+                      std::vector<LatencySource> latencySources = {});
+
+        StatsReporter(StatsReporter const &) = delete;
+
+        auto operator=(StatsReporter const &) -> StatsReporter & = delete;
+
+        ~StatsReporter();
+
+        auto isValid() const -> bool { return wakeFd_ >= 0; }
+
+        //
+        // Milliseconds between reports, 0 for none.  Any thread.
+        //
+        auto setInterval(uint64_t interval) -> void;
+
+        auto isEnabled() const -> bool { return interval_.load(std::memory_order_relaxed) != 0; }
+
+        //
+        // Whether the worker was asked to report since it last was, which it
+        // then has to.  That worker only.
+        //
+        auto takeRequest(size_t worker) -> bool;
+
+        //
+        // Queues the traffic of a flow of the worker, false if the queue is
+        // full.  That worker only.
+        //
+        auto push(size_t worker, FlowStats const &stats) -> bool;
+
+        //
+        // Reports until a stop is requested through stopFd.
+        //
+        auto run(int stopFd) -> void;
+    };
+
+    //
+    // Reports handed over and flows left for a later one since the library
+    // was loaded, one "name value" per line.
+    //
+    auto getReporterStats() -> std::string;
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_STATSREPORTER_H_ */
@@ -0,0 +1,125 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <atomic>
+
+#include "StreamReassembler.h"
+
+using namespace ai;
+
+namespace {
+
+    //
+    // Buffers held by the segments of every stream.
+    //
+    std::atomic_size_t gHeldBuffers{0};
+
+    std::atomic_uint64_t gHeldSegments{0};
+
+    std::atomic_uint64_t gDroppedSegments{0};
+
+    //
+    // Distance from sequence number b to a, across wrap-arounds; negative if
+    // a comes before b.
+    //
+    auto distance(uint32_t const a, uint32_t const b) -> int64_t {
+        return static_cast<int32_t>(a - b);
+    }
+
+    auto reserveBuffer() -> bool {
+        auto held = gHeldBuffers.load(std::memory_order_relaxed);
+        do {
+            if (held >= vpn::StreamReassembler::MAX_HELD_SEGMENTS) {
+                return false;
+            }
+        } while (!gHeldBuffers.compare_exchange_weak(held, held + 1, std::memory_order_relaxed));
+        return true;
+    }
+}
+
+vpn::StreamReassembler::~StreamReassembler() {
+    clear();
+}
+
+auto vpn::StreamReassembler::hold(PacketBuffer &packet, std::span<uint8_t const> const payload, uint32_t const sequenceNumber, uint32_t const next,
+                                  uint32_t const window) -> bool {
+    auto const start = distance(sequenceNumber, next);
+    if (!packet || payload.empty() || start <= 0 || start >= static_cast<int64_t>(window)) {
+        return false;
+    }
+
+    //
+    // Only the bytes up to the window and between the segments around the
+    // payload are held.
+    //
+    auto first = start;
+    auto last = std::min(start + static_cast<int64_t>(payload.size()), static_cast<int64_t>(window));
+    auto const it = std::ranges::upper_bound(segments_, start, {}, [next](Segment const &segment) { return distance(segment.sequenceNumber, next); });
+    if (it != segments_.begin()) {
+        auto const &previous = *(it - 1);
+        first = std::max(first, distance(previous.sequenceNumber, next) + previous.size);
+    }
+    if (it != segments_.end()) {
+        last = std::min(last, distance(it->sequenceNumber, next));
+    }
+    if (first >= last) {
+        return false;
+    }
+    if (segments_.size() >= MAX_SEGMENTS || !reserveBuffer()) {
+        gDroppedSegments.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto const offset = static_cast<uint16_t>(payload.data() - packet.data() + (first - start));
+    segments_.insert(it, Segment{std::move(packet), next + static_cast<uint32_t>(first), offset, static_cast<uint16_t>(last - first)});
+    gHeldSegments.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+auto vpn::StreamReassembler::peek(uint32_t const next) -> std::span<uint8_t const> {
+    while (!segments_.empty()) {
+        auto const &segment = segments_.front();
+        auto const start = distance(segment.sequenceNumber, next);
+        if (start > 0) {
+            break;
+        }
+        if (-start < segment.size) {
+            return std::span<uint8_t const>(segment.packet.data() + segment.offset, segment.size).subspan(static_cast<size_t>(-start));
+        }
+        segments_.erase(segments_.begin());
+        gHeldBuffers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return {};
+}
+
+auto vpn::StreamReassembler::clear() -> void {
+    gHeldBuffers.fetch_sub(segments_.size(), std::memory_order_relaxed);
+    segments_.clear();
+}
+
+auto vpn::getReassemblyStats() -> std::string {
+    return "reassembly.segments " + std::to_string(gHeldSegments.load(std::memory_order_relaxed)) + "\n" +
+           "reassembly.dropped " + std::to_string(gDroppedSegments.load(std::memory_order_relaxed)) + "\n" +
+           "reassembly.buffers " + std::to_string(gHeldBuffers.load(std::memory_order_relaxed)) + "\n";
+}
@@ -0,0 +1,114 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_STREAMREASSEMBLER_H_
+#define ANDROID_INTROSPECTION_VPN_STREAMREASSEMBLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "PacketPool.h"
+
+namespace ai::vpn {
+
+    //
+    // Segments of a TCP stream that came ahead of a hole, kept until the
+    // hole is filled so that the sender does not have to send them again.
+    // They are held by the buffers of the packets they came in, never
+    // copied, as a list of intervals of sequence numbers sorted and not
+    // overlapping; the bytes of the stream are then handed on in order as
+    // views of those buffers.
+    //
+    // Every buffer held is one the pool cannot hand to the reader, so the
+    // segments of a stream and of every stream, across workers, are bounded,
+    // and the pool is sized for the latter.  Segments past either bound are
+    // dropped, as they were before there was reassembly.  One worker only.
+    //
+    class StreamReassembler final {
+
+        struct Segment {
+
+            PacketBuffer packet;
+
+            uint32_t sequenceNumber = 0;
+
+            uint16_t offset = 0;
+
+            uint16_t size = 0;
+        };
+
+        std::vector<Segment> segments_;
+
+    public:
+        //
+        // Segments a stream holds at most.
+        //
+        static constexpr size_t MAX_SEGMENTS = 32;
+
+        //
+        // Segments every stream holds at most, which the packet pool has
+        // buffers for on top of those of the pipeline.
+        //
+        static constexpr size_t MAX_HELD_SEGMENTS = 256;
+
+        StreamReassembler() = default;
+
+        StreamReassembler(StreamReassembler const &) = delete;
+
+        auto operator=(StreamReassembler const &) -> StreamReassembler & = delete;
+
+        ~StreamReassembler();
+
+        //
+        // Takes the packet, whose payload starts at sequenceNumber, unless
+        // it brings nothing new between next, the sequence number expected
+        // next, and next + window, or a bound was reached; false if the
+        // packet was left to the caller.  Bytes already held are kept over
+        // those of the payload.
+        //
+        auto hold(PacketBuffer &packet, std::span<uint8_t const> payload, uint32_t sequenceNumber, uint32_t next, uint32_t window) -> bool;
+
+        //
+        // Bytes held from next on, up to the first hole or the end of a
+        // segment, or none; segments before next are released on the way.
+        //
+        auto peek(uint32_t next) -> std::span<uint8_t const>;
+
+        //
+        // Releases every segment, e.g. once the stream is closed.
+        //
+        auto clear() -> void;
+
+        auto isEmpty() const -> bool { return segments_.empty(); }
+    };
+
+    //
+    // Segments held since the library was loaded, one "name value" per line.
+    //
+    auto getReassemblyStats() -> std::string;
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_STREAMREASSEMBLER_H_ */
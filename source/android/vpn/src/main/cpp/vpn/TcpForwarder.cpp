@@ -0,0 +1,1018 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "utils/log.h"
+#include "utils/trace.h"
+#include "ByteRing.h"
+#include "DnsInterceptor.h"
+#include "TcpForwarder.h"
+
+using namespace ai;
+
+namespace {
+
+    //
+    // Bytes of the app waiting for its socket, which is also the most the
+    // window advertised to the app goes up to.
+    //
+    constexpr size_t TO_UPSTREAM_BUFFER_SIZE = 64 * 1024;
+
+    //
+    // Bytes of the socket sent to the app but not acked yet, or waiting for
+    // room in its window.
+    //
+    constexpr size_t TO_APP_BUFFER_SIZE = 128 * 1024;
+
+    constexpr uint16_t DEFAULT_MSS = 536;
+
+    //
+    // Largest segment a packet of the tunnel holds, less for IPv6 with its
+    // longer header.
+    //
+    constexpr auto maxMss(vpn::IpAddress const &address) -> uint16_t {
+        return static_cast<uint16_t>(vpn::PACKET_SIZE - vpn::ipHeaderSize(address) - vpn::TcpHeader::MIN_SIZE);
+    }
+
+    constexpr uint16_t MAX_WINDOW = UINT16_MAX;
+
+    constexpr auto DUPLICATE_ACKS_TO_RETRANSMIT = 3;
+
+    //
+    // Retransmission timeouts of RFC 6298, doubled on every timeout up to
+    // the maximum; a session is reset after that many went unanswered.
+    //
+    constexpr uint64_t INITIAL_RETRANSMIT_TIMEOUT = 1000;
+
+    constexpr uint64_t MAX_RETRANSMIT_TIMEOUT = 60 * 1000;
+
+    constexpr auto MAX_RETRANSMITS = 8;
+
+    //
+    // Less than the packet loop lets a flow idle for, so that the answer of
+    // an app that is still there keeps the flow of its connection.
+    //
+    constexpr uint64_t KEEPALIVE_IDLE = 60 * 1000;
+
+    constexpr uint64_t KEEPALIVE_INTERVAL = 10 * 1000;
+
+    constexpr auto KEEPALIVE_PROBES = 3;
+
+    //
+    // Connection Attempt Delay of RFC 8305: how long a connect goes on alone
+    // before the next address is raced against it.
+    //
+    constexpr uint64_t CONNECTION_ATTEMPT_DELAY = 250;
+
+    constexpr size_t MAX_ALTERNATE_ADDRESSES = 2;
+
+    //
+    // Ports of protocols whose clients speak first, HTTP, HTTPS and DNS over
+    // TLS, and how long flows to them that were answered ahead of their
+    // connect wait for the first bytes of the app before connecting without.
+    //
+    constexpr std::array<uint16_t, 5> CLIENT_FIRST_PORTS = {80, 443, 853, 8080, 8443};
+
+    constexpr uint64_t FIRST_PAYLOAD_TIMEOUT = 200;
+
+    //
+    // Whether sequence number a comes after b, across wrap-arounds.
+    //
+    auto isAfter(uint32_t const a, uint32_t const b) -> bool {
+        return static_cast<int32_t>(a - b) > 0;
+    }
+
+    //
+    // Maximum segment size of the options of a SYN, up to the given one, or
+    // the default of RFC 879 if there is none.
+    //
+    auto parseMss(vpn::TcpHeader const &tcpHeader, uint16_t const maxMss) -> uint16_t {
+        auto const options = tcpHeader.options();
+        for (size_t i = 0; i < options.size();) {
+            auto const kind = options[i];
+            if (kind == 0) {
+                break;
+            }
+            if (kind == 1) {
+                i++;
+                continue;
+            }
+            if (i + 1 >= options.size() || options[i + 1] < 2 || i + options[i + 1] > options.size()) {
+                break;
+            }
+            if (kind == 2 && options[i + 1] == 4) {
+                return std::clamp(vpn::detail::load16(options, i + 2), DEFAULT_MSS, maxMss);
+            }
+            i += options[i + 1];
+        }
+        return DEFAULT_MSS;
+    }
+
+    auto makeToken(uint32_t const id, int const socket) -> uint64_t {
+        return static_cast<uint64_t>(id) << 32U | static_cast<uint32_t>(socket);
+    }
+
+    //
+    // Whether the kernel lets clients use TCP Fast Open, bit 0 of its sysctl,
+    // taken to be set where it can not be read as it is by default.
+    //
+    auto isFastOpenEnabled() -> bool {
+        auto const fd = open("/proc/sys/net/ipv4/tcp_fastopen", O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return true;
+        }
+        char text[16] = {};
+        auto const size = read(fd, text, sizeof(text) - 1);
+        close(fd);
+        return size <= 0 || (std::strtoul(text, nullptr, 10) & 1U) != 0;
+    }
+
+    auto openSocket(vpn::IpAddress const &address) -> int {
+        auto const socketFd = socket(address.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (socketFd >= 0) {
+            auto const noDelay = 1;
+            setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+        return socketFd;
+    }
+
+    auto getSocketError(int const socket) -> int {
+        auto error = 0;
+        auto length = static_cast<socklen_t>(sizeof(error));
+        if (getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+            return errno;
+        }
+        return error;
+    }
+}
+
+struct vpn::TcpForwarder::Session {
+
+    enum class State {
+        //
+        // The socket is connecting; the SYN of the app is only answered once
+        // it did, so that a refused connection is refused to the app too.
+        // Sessions that connect with the first bytes of the app skip it.
+        //
+        Connecting,
+        SynAckSent,
+        Established,
+        Closed,
+    };
+
+    //
+    // Address of the destination or an alternate the socket of the attempt
+    // connects to, -1 until it started and after it failed.  The socket of
+    // the first one is that of the session, kept open until the race is
+    // over so that no other session gets it.
+    //
+    struct Attempt {
+
+        IpAddress address;
+
+        int socket = -1;
+
+        bool isPending = false;
+
+        //
+        // Bytes of toUpstream the connect sent with its SYN.
+        //
+        size_t sentEarly = 0;
+    };
+
+    Flow *flow = nullptr;
+
+    FlowKey key;
+
+    int socket = -1;
+
+    //
+    // Addresses raced until one connected, that of the flow first.
+    //
+    std::vector<Attempt> attempts;
+
+    size_t nextAttempt = 0;
+
+    bool isFastOpen = false;
+
+    bool isUpstreamStarted = false;
+
+    bool isConnected = false;
+
+    TimerWheel::Timer connectTimer;
+
+    uint32_t id = 0;
+
+    State state = State::Connecting;
+
+    uint32_t initialSequenceNumber = 0;
+
+    //
+    // First sequence number of ours the app has not acked, that of the
+    // first byte of toApp once established.
+    //
+    uint32_t unacknowledged = 0;
+
+    uint32_t next = 0;
+
+    uint32_t appNext = 0;
+
+    uint32_t appWindow = 0;
+
+    uint16_t mss = DEFAULT_MSS;
+
+    uint16_t advertisedWindow = 0;
+
+    int duplicateAcks = 0;
+
+    bool appFinished = false;
+
+    bool upstreamFinished = false;
+
+    bool upstreamShutDown = false;
+
+    bool finSent = false;
+
+    bool ackPending = false;
+
+    uint32_t events = 0;
+
+    uint64_t retransmitTimeout = INITIAL_RETRANSMIT_TIMEOUT;
+
+    int retransmits = 0;
+
+    uint64_t lastAppSegment = 0;
+
+    int keepAliveProbes = 0;
+
+    TimerWheel::Timer retransmitTimer;
+
+    TimerWheel::Timer keepAliveTimer;
+
+    ByteRing toApp{TO_APP_BUFFER_SIZE};
+
+    ByteRing toUpstream{TO_UPSTREAM_BUFFER_SIZE};
+
+    //
+    // Segments of the app after a hole at appNext.
+    //
+    StreamReassembler fromApp;
+
+    //
+    // Parser of the requests of the app, if the first bytes it sent looked
+    // like one; dropped once it stopped.
+    //
+    std::unique_ptr<HttpParser> httpParser;
+
+    bool isHttpChecked = false;
+
+    auto window() const -> uint16_t {
+        return static_cast<uint16_t>(std::min<size_t>(MAX_WINDOW, toUpstream.available()));
+    }
+};
+
+vpn::TcpForwarder::TcpForwarder(TunnelQueue &tunnel, int const epollFd, TimerWheel &timers, SocketCallback onSocketCreated,
+                                SocketCallback onSocketDestroyed, HttpRequestCallback onHttpRequest, InspectionSampler const *const sampler,
+                                HostnameTable const *const hostnames)
+        : tunnel_(tunnel), epollFd_(epollFd), timers_(timers), onSocketCreated_(std::move(onSocketCreated)),
+          onSocketDestroyed_(std::move(onSocketDestroyed)), onHttpRequest_(std::move(onHttpRequest)), sampler_(sampler), hostnames_(hostnames),
+          isFastOpenEnabled_(isFastOpenEnabled()), sequenceNumbers_(std::random_device()()) {
+}
+
+vpn::TcpForwarder::~TcpForwarder() {
+    for (auto &[socket, session] : sessions_) {
+        closeAttempts(*session, socket);
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+        onSocketDestroyed_(socket);
+        close(socket);
+        session->flow->socket = -1;
+    }
+}
+
+auto vpn::TcpForwarder::handleSegment(TcpHeader const &tcpHeader, Flow &flow, uint64_t const now, PacketBuffer *const packet) -> void {
+    TRACE_SPAN("TcpForwarder::handleSegment");
+    now_ = now;
+    auto const it = flow.socket >= 0 ? sessions_.find(flow.socket) : sessions_.end();
+    if (it == sessions_.end()) {
+        if (tcpHeader.hasFlags(TcpHeader::RST)) {
+            return;
+        }
+        if ((tcpHeader.flags() & (TcpHeader::SYN | TcpHeader::ACK)) == TcpHeader::SYN) {
+            openSession(flow, tcpHeader);
+        } else {
+            sendReset(flow.key, tcpHeader);
+        }
+        return;
+    }
+
+    auto &session = *it->second;
+    session.lastAppSegment = now;
+    session.keepAliveProbes = 0;
+    if (tcpHeader.hasFlags(TcpHeader::RST)) {
+        session.state = Session::State::Closed;
+    } else if (tcpHeader.hasFlags(TcpHeader::SYN)) {
+        if (session.state == Session::State::SynAckSent) {
+            sendSegment(session, TcpHeader::SYN | TcpHeader::ACK, session.initialSequenceNumber, {});
+        }
+    } else {
+        acknowledge(session, tcpHeader);
+        receive(session, tcpHeader, packet);
+        flushToApp(session);
+        if (session.ackPending && session.state != Session::State::Closed) {
+            sendSegment(session, TcpHeader::ACK, session.next, {});
+        }
+        updateEvents(session);
+    }
+    updateRetransmitTimer(session);
+    reap(session);
+}
+
+auto vpn::TcpForwarder::handleSocketEvent(uint64_t const token, uint32_t const events, uint64_t const now) -> void {
+    TRACE_SPAN("TcpForwarder::handleSocketEvent");
+    now_ = now;
+    auto const socket = static_cast<int>(static_cast<uint32_t>(token));
+    auto *found = static_cast<Session *>(nullptr);
+    if (auto const it = sessions_.find(socket); it != sessions_.end()) {
+        found = it->second.get();
+    } else if (auto const attempt = attemptSockets_.find(socket); attempt != attemptSockets_.end()) {
+        found = attempt->second;
+    }
+    if (found == nullptr || found->id != static_cast<uint32_t>(token >> 32U)) {
+        return;
+    }
+
+    auto &session = *found;
+    if (!session.isConnected) {
+        finishAttempt(session, socket);
+    } else if ((events & EPOLLERR) != 0) {
+        LOGD("handleSocketEvent socket [%d] failed, %s", session.socket, strerror(getSocketError(session.socket)));
+        reset(session);
+    } else {
+        if ((events & (EPOLLIN | EPOLLHUP)) != 0) {
+            readUpstream(session);
+        }
+        if ((events & EPOLLOUT) != 0) {
+            writeUpstream(session);
+        }
+        flushToApp(session);
+        if (session.ackPending && session.state != Session::State::Closed) {
+            sendSegment(session, TcpHeader::ACK, session.next, {});
+        }
+    }
+    updateEvents(session);
+    updateRetransmitTimer(session);
+    reap(session);
+}
+
+auto vpn::TcpForwarder::abort(Flow &flow) -> void {
+    if (auto const it = flow.socket >= 0 ? sessions_.find(flow.socket) : sessions_.end(); it != sessions_.end()) {
+        reset(*it->second);
+        reap(*it->second);
+    }
+}
+
+auto vpn::TcpForwarder::openSession(Flow &flow, TcpHeader const &tcpHeader) -> void {
+    auto const socketFd = openSocket(flow.key.destinationAddress);
+    if (socketFd < 0) {
+        LOGW("openSession unable to create socket, %s", strerror(errno));
+        sendReset(flow.key, tcpHeader);
+        return;
+    }
+    onSocketCreated_(socketFd);
+
+    auto session = std::make_unique<Session>();
+    session->retransmitTimer.setOnExpired([this, session = session.get()] { retransmit(*session); });
+    session->keepAliveTimer.setOnExpired([this, session = session.get()] { keepAlive(*session); });
+    session->connectTimer.setOnExpired([this, session = session.get()] { connectTimedOut(*session); });
+    session->flow = &flow;
+    session->key = flow.key;
+    session->socket = socketFd;
+    session->id = nextSessionId_++;
+    if ((nextSessionId_ & (1U << 31U)) != 0) {
+        nextSessionId_ = 1;
+    }
+    session->initialSequenceNumber = static_cast<uint32_t>(sequenceNumbers_());
+    session->appNext = tcpHeader.sequenceNumber() + 1;
+    session->appWindow = tcpHeader.window();
+    session->mss = parseMss(tcpHeader, maxMss(flow.key.destinationAddress));
+    session->events = EPOLLOUT;
+    session->attempts.push_back({flow.key.destinationAddress, socketFd});
+    if (hostnames_ != nullptr) {
+        for (auto const &address : hostnames_->findAlternates(flow.key.destinationAddress, now_, MAX_ALTERNATE_ADDRESSES)) {
+            session->attempts.push_back({address});
+        }
+    }
+
+    //
+    // Flows raced across addresses connect without data, as a server may act
+    // on the data in the SYN of an attempt that then loses, e.g. run a plain
+    // HTTP request that the winner sends again.
+    //
+    session->isFastOpen = isFastOpenEnabled_ && session->attempts.size() == 1 &&
+                          std::ranges::find(CLIENT_FIRST_PORTS, flow.key.destinationPort) != CLIENT_FIRST_PORTS.end();
+
+    //
+    // Flows left out of inspection are not parsed for requests either.
+    //
+    session->isHttpChecked = flow.isInspected;
+
+    auto &opened = *session;
+    flow.socket = socketFd;
+    sessions_.emplace(socketFd, std::move(session));
+    if (opened.isFastOpen) {
+        answerSyn(opened);
+        timers_.schedule(opened.connectTimer, now_ + FIRST_PAYLOAD_TIMEOUT);
+    } else {
+        startUpstream(opened);
+    }
+    updateRetransmitTimer(opened);
+    reap(opened);
+}
+
+auto vpn::TcpForwarder::startUpstream(Session &session) -> void {
+    session.isUpstreamStarted = true;
+    timers_.cancel(session.connectTimer);
+    startNextAttempt(session);
+}
+
+//
+// Starts the connect to the next address, or to the one after if it fails
+// right away, e.g. for a family without a route, and has the one after
+// raced against it if it did not connect within the attempt delay.  The
+// session is reset once every attempt failed.
+//
+auto vpn::TcpForwarder::startNextAttempt(Session &session) -> void {
+    while (session.nextAttempt < session.attempts.size()) {
+        auto &attempt = session.attempts[session.nextAttempt++];
+        if (attempt.socket < 0) {
+            attempt.socket = openSocket(attempt.address);
+            if (attempt.socket < 0) {
+                LOGW("startNextAttempt unable to create socket, %s", strerror(errno));
+                continue;
+            }
+            onSocketCreated_(attempt.socket);
+            attemptSockets_.emplace(attempt.socket, &session);
+        }
+        if (auto const sentEarly = connectAttempt(session, attempt.socket, attempt.address)) {
+            attempt.isPending = true;
+            attempt.sentEarly = *sentEarly;
+            if (session.nextAttempt < session.attempts.size()) {
+                timers_.schedule(session.connectTimer, now_ + CONNECTION_ATTEMPT_DELAY);
+            }
+            return;
+        }
+        if (attempt.socket != session.socket) {
+            attemptSockets_.erase(attempt.socket);
+            onSocketDestroyed_(attempt.socket);
+            close(attempt.socket);
+            attempt.socket = -1;
+        }
+    }
+    if (std::ranges::none_of(session.attempts, &Session::Attempt::isPending)) {
+        LOGD("startNextAttempt every address of socket [%d] failed", session.socket);
+        reset(session);
+    }
+}
+
+//
+// Starts connecting the socket of an attempt, with the bytes the app sent
+// so far in its SYN if the session may; the count of bytes sent, nothing
+// if the connect failed.
+//
+auto vpn::TcpForwarder::connectAttempt(Session &session, int const socket, IpAddress const &address) -> std::optional<size_t> {
+    auto const socketAddress = SocketAddress(address, session.key.destinationPort);
+    auto event = epoll_event{EPOLLOUT, {.u64 = makeToken(session.id, socket)}};
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, socket, &event) < 0) {
+        LOGD("connectAttempt unable to watch socket [%d], %s", socket, strerror(errno));
+        return std::nullopt;
+    }
+    if (session.isFastOpen && isFastOpenEnabled_ && !session.toUpstream.empty()) {
+        auto const early = session.toUpstream.peek(0, session.toUpstream.size());
+        auto const dataWrittenInBytes = sendto(socket, early.data(), early.size(), MSG_FASTOPEN | MSG_NOSIGNAL, socketAddress.get(), socketAddress.length);
+        if (dataWrittenInBytes >= 0) {
+            return static_cast<size_t>(dataWrittenInBytes);
+        }
+        //
+        // Without a cookie of the destination the SYN asks for one, and the
+        // bytes are sent once connected.
+        //
+        if (errno == EINPROGRESS) {
+            return 0;
+        }
+        if (errno != EOPNOTSUPP) {
+            LOGD("connectAttempt unable to connect socket [%d] with data, %s", socket, strerror(errno));
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+            return std::nullopt;
+        }
+        LOGI("connectAttempt fast open is not supported, connecting without data");
+        isFastOpenEnabled_ = false;
+    }
+    if (connect(socket, socketAddress.get(), socketAddress.length) < 0 && errno != EINPROGRESS) {
+        LOGD("connectAttempt unable to connect socket [%d], %s", socket, strerror(errno));
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+        return std::nullopt;
+    }
+    return 0;
+}
+
+//
+// The first attempt to connect wins the race: its socket becomes that of
+// the session and the others are closed.  A failed attempt has the next
+// one started right away, if there is one.
+//
+auto vpn::TcpForwarder::finishAttempt(Session &session, int const socket) -> void {
+    auto const attempt = std::ranges::find(session.attempts, socket, &Session::Attempt::socket);
+    if (attempt == session.attempts.end() || !attempt->isPending) {
+        return;
+    }
+    if (auto const error = getSocketError(socket); error != 0) {
+        LOGD("finishAttempt unable to connect socket [%d], %s", socket, strerror(error));
+        attempt->isPending = false;
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+        if (socket != session.socket) {
+            attemptSockets_.erase(socket);
+            onSocketDestroyed_(socket);
+            close(socket);
+            attempt->socket = -1;
+        }
+        startNextAttempt(session);
+        return;
+    }
+
+    timers_.cancel(session.connectTimer);
+    session.toUpstream.consume(attempt->sentEarly);
+    if (socket != session.socket) {
+        LOGD("finishAttempt socket [%d] won the race for [%s]", socket, attempt->address.format().data());
+        auto node = sessions_.extract(session.socket);
+        node.key() = socket;
+        sessions_.insert(std::move(node));
+        attemptSockets_.erase(socket);
+        session.socket = socket;
+        session.flow->socket = socket;
+    }
+    closeAttempts(session, socket);
+    connected(session);
+}
+
+auto vpn::TcpForwarder::closeAttempts(Session &session, int const keptSocket) -> void {
+    for (auto const &attempt : session.attempts) {
+        if (attempt.socket < 0 || attempt.socket == keptSocket) {
+            continue;
+        }
+        if (attempt.isPending) {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, attempt.socket, nullptr);
+        }
+        attemptSockets_.erase(attempt.socket);
+        onSocketDestroyed_(attempt.socket);
+        close(attempt.socket);
+    }
+    session.attempts.clear();
+}
+
+//
+// Connects without the first bytes of an app that sent none in time, or
+// races the next address against the connect of the session.
+//
+auto vpn::TcpForwarder::connectTimedOut(Session &session) -> void {
+    now_ = timers_.now();
+    if (session.isConnected || session.state == Session::State::Closed) {
+        return;
+    }
+    if (session.isUpstreamStarted) {
+        startNextAttempt(session);
+    } else {
+        startUpstream(session);
+    }
+    updateRetransmitTimer(session);
+    reap(session);
+}
+
+auto vpn::TcpForwarder::connected(Session &session) -> void {
+    session.isConnected = true;
+    session.events = EPOLLOUT;
+    if (session.state == Session::State::Connecting) {
+        answerSyn(session);
+    } else {
+        writeUpstream(session);
+    }
+}
+
+auto vpn::TcpForwarder::answerSyn(Session &session) -> void {
+    session.state = Session::State::SynAckSent;
+    session.unacknowledged = session.initialSequenceNumber;
+    session.next = session.initialSequenceNumber + 1;
+    sendSegment(session, TcpHeader::SYN | TcpHeader::ACK, session.initialSequenceNumber, {});
+}
+
+auto vpn::TcpForwarder::acknowledge(Session &session, TcpHeader const &tcpHeader) -> void {
+    if (!tcpHeader.hasFlags(TcpHeader::ACK) || session.state == Session::State::Connecting) {
+        return;
+    }
+    auto const acknowledgementNumber = tcpHeader.acknowledgementNumber();
+    if (session.state == Session::State::SynAckSent) {
+        if (acknowledgementNumber == session.next) {
+            session.state = Session::State::Established;
+            session.unacknowledged = acknowledgementNumber;
+            session.appWindow = tcpHeader.window();
+            session.retransmits = 0;
+            session.retransmitTimeout = INITIAL_RETRANSMIT_TIMEOUT;
+            timers_.cancel(session.retransmitTimer);
+            timers_.schedule(session.keepAliveTimer, now_ + KEEPALIVE_IDLE);
+        }
+        return;
+    }
+
+    if (isAfter(acknowledgementNumber, session.unacknowledged) && !isAfter(acknowledgementNumber, session.next)) {
+        session.toApp.consume(acknowledgementNumber - session.unacknowledged);
+        session.unacknowledged = acknowledgementNumber;
+        session.duplicateAcks = 0;
+        session.retransmits = 0;
+        session.retransmitTimeout = INITIAL_RETRANSMIT_TIMEOUT;
+        timers_.cancel(session.retransmitTimer);
+    } else if (acknowledgementNumber == session.unacknowledged && session.unacknowledged != session.next && tcpHeader.payload().empty() &&
+               ++session.duplicateAcks == DUPLICATE_ACKS_TO_RETRANSMIT) {
+        LOGD("acknowledge retransmitting to app from socket [%d]", session.socket);
+        session.next = session.unacknowledged;
+        session.finSent = false;
+        session.duplicateAcks = 0;
+    }
+    session.appWindow = tcpHeader.window();
+}
+
+auto vpn::TcpForwarder::receive(Session &session, TcpHeader const &tcpHeader, PacketBuffer *const packet) -> void {
+    auto payload = tcpHeader.payload();
+    auto const isFin = tcpHeader.hasFlags(TcpHeader::FIN);
+    if (session.state != Session::State::Established || (payload.empty() && !isFin)) {
+        return;
+    }
+
+    //
+    // Whatever is not taken is acked as it is, so the app sends it again;
+    // what is held is acked once the hole before it is filled.
+    //
+    session.ackPending = true;
+    auto sequenceNumber = tcpHeader.sequenceNumber();
+    if (isAfter(session.appNext, sequenceNumber)) {
+        auto const overlap = static_cast<size_t>(session.appNext - sequenceNumber);
+        if (overlap > payload.size() || (overlap == payload.size() && !isFin)) {
+            return;
+        }
+        payload = payload.subspan(overlap);
+        sequenceNumber = session.appNext;
+    }
+    if (session.appFinished) {
+        return;
+    }
+    if (sequenceNumber != session.appNext) {
+        if (packet != nullptr) {
+            session.fromApp.hold(*packet, payload, sequenceNumber, session.appNext, session.window());
+        }
+        return;
+    }
+
+    auto const accepted = take(session, payload);
+    if (isFin && accepted == payload.size()) {
+        session.appFinished = true;
+        session.appNext++;
+        session.fromApp.clear();
+    } else if (accepted == payload.size()) {
+        auto bytes = session.fromApp.peek(session.appNext);
+        while (!bytes.empty() && take(session, bytes) == bytes.size()) {
+            bytes = session.fromApp.peek(session.appNext);
+        }
+    }
+    writeUpstream(session);
+}
+
+//
+// Takes what there is room for of the bytes at appNext, which moves past
+// them; the count taken.
+//
+auto vpn::TcpForwarder::take(Session &session, std::span<uint8_t const> const bytes) -> size_t {
+    auto const accepted = session.toUpstream.append(bytes);
+    session.appNext += static_cast<uint32_t>(accepted);
+    if (accepted > 0 && onHttpRequest_) {
+        parseRequests(session, bytes.first(accepted));
+    }
+    return accepted;
+}
+
+//
+// Bytes are parsed in order as they are taken, so that the parser sees the
+// stream the socket does.  A stream can not be parsed a packet here and
+// there, so flows sampled past their first bytes stop being parsed.
+//
+auto vpn::TcpForwarder::parseRequests(Session &session, std::span<uint8_t const> bytes) -> void {
+    if (!session.isHttpChecked) {
+        session.isHttpChecked = true;
+        if (HttpParser::isRequest(bytes)) {
+            session.httpParser = std::make_unique<HttpParser>();
+        }
+    }
+    if (!session.httpParser) {
+        return;
+    }
+    if (sampler_ != nullptr && !sampler_->shouldFollow(*session.flow)) {
+        LOGD("parseRequests stopping past the first bytes of a sampled flow");
+        session.httpParser.reset();
+        return;
+    }
+    TRACE_SPAN("TcpForwarder::parseRequests");
+    while (!bytes.empty() && !session.httpParser->isStopped()) {
+        bytes = bytes.subspan(session.httpParser->parse(bytes));
+        if (auto const *const request = session.httpParser->takeRequest()) {
+            onHttpRequest_(*session.flow, *request);
+        }
+    }
+    if (session.httpParser->isStopped()) {
+        session.httpParser.reset();
+    }
+}
+
+auto vpn::TcpForwarder::readUpstream(Session &session) -> void {
+    while (session.state != Session::State::Closed && !session.upstreamFinished && session.toApp.size() < TO_APP_BUFFER_SIZE) {
+        auto const room = session.toApp.room();
+        auto const dataReadInBytes = recv(session.socket, room.data(), room.size(), MSG_DONTWAIT);
+        if (dataReadInBytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOGD("readUpstream unable to read socket [%d], %s", session.socket, strerror(errno));
+                reset(session);
+            }
+            return;
+        }
+        if (dataReadInBytes == 0) {
+            session.upstreamFinished = true;
+            return;
+        }
+        session.toApp.commit(static_cast<size_t>(dataReadInBytes));
+        session.flow->lastActive = now_;
+    }
+}
+
+auto vpn::TcpForwarder::writeUpstream(Session &session) -> void {
+    if (!session.isConnected) {
+        if (!session.isUpstreamStarted && (!session.toUpstream.empty() || session.appFinished) && session.state != Session::State::Closed) {
+            startUpstream(session);
+        }
+        return;
+    }
+    while (session.state != Session::State::Closed && !session.toUpstream.empty()) {
+        auto const pending = session.toUpstream.peek(0, session.toUpstream.size());
+        auto const dataWrittenInBytes = send(session.socket, pending.data(), pending.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (dataWrittenInBytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOGD("writeUpstream unable to write socket [%d], %s", session.socket, strerror(errno));
+                reset(session);
+                return;
+            }
+            break;
+        }
+        session.toUpstream.consume(static_cast<size_t>(dataWrittenInBytes));
+    }
+
+    if (session.toUpstream.empty() && session.appFinished && !session.upstreamShutDown) {
+        shutdown(session.socket, SHUT_WR);
+        session.upstreamShutDown = true;
+    }
+
+    //
+    // Tells the app about room that opened up in a window it had filled.
+    //
+    if (session.advertisedWindow < session.mss && session.window() >= session.mss) {
+        session.ackPending = true;
+    }
+}
+
+auto vpn::TcpForwarder::flushToApp(Session &session) -> void {
+    if (session.state != Session::State::Established) {
+        return;
+    }
+    while (!session.finSent) {
+        auto const inFlight = session.next - session.unacknowledged;
+        auto const unsent = session.toApp.size() - inFlight;
+        if (unsent == 0 || inFlight >= session.appWindow) {
+            break;
+        }
+        auto const length = std::min({unsent, static_cast<size_t>(session.mss), static_cast<size_t>(session.appWindow - inFlight)});
+
+        //
+        // A segment ends at the wrap of the ring, the next one starts past it.
+        //
+        auto const payload = session.toApp.peek(inFlight, length);
+        if (!sendSegment(session, TcpHeader::ACK | TcpHeader::PSH, session.next, payload)) {
+            return;
+        }
+        session.next += static_cast<uint32_t>(payload.size());
+    }
+    if (session.upstreamFinished && !session.finSent && session.next - session.unacknowledged == session.toApp.size() &&
+        sendSegment(session, TcpHeader::FIN | TcpHeader::ACK, session.next, {})) {
+        session.next++;
+        session.finSent = true;
+    }
+}
+
+auto vpn::TcpForwarder::updateEvents(Session &session) -> void {
+    if (session.state == Session::State::Closed || !session.isConnected) {
+        return;
+    }
+    auto events = uint32_t{0};
+    if (!session.upstreamFinished && session.toApp.size() < TO_APP_BUFFER_SIZE) {
+        events |= EPOLLIN;
+    }
+    if (!session.toUpstream.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events != session.events) {
+        auto event = epoll_event{events, {.u64 = makeToken(session.id, session.socket)}};
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, session.socket, &event);
+        session.events = events;
+    }
+}
+
+//
+// Keeps the retransmission timer running while the app has anything of ours
+// to ack or that is waiting to be sent, e.g. for a full tunnel or a closed
+// window, and restarts it from the current timeout once it is all acked.
+//
+auto vpn::TcpForwarder::updateRetransmitTimer(Session &session) -> void {
+    auto const isOutstanding =
+            session.state == Session::State::SynAckSent ||
+            (session.state == Session::State::Established &&
+             (!session.toApp.empty() || session.next != session.unacknowledged || (session.upstreamFinished && !session.finSent)));
+    if (!isOutstanding) {
+        timers_.cancel(session.retransmitTimer);
+    } else if (!session.retransmitTimer.isScheduled()) {
+        timers_.schedule(session.retransmitTimer, now_ + session.retransmitTimeout);
+    }
+}
+
+//
+// Sends everything the app did not ack again, as fast retransmission does,
+// or whatever could not be sent yet if it acked everything.
+//
+auto vpn::TcpForwarder::retransmit(Session &session) -> void {
+    now_ = timers_.now();
+    auto const isSynAckSent = session.state == Session::State::SynAckSent;
+    if (isSynAckSent || session.next != session.unacknowledged) {
+        if (++session.retransmits > MAX_RETRANSMITS) {
+            LOGD("retransmit giving up on app of socket [%d]", session.socket);
+            reset(session);
+            reap(session);
+            return;
+        }
+        LOGD("retransmit timed out after %llu ms on socket [%d]", static_cast<unsigned long long>(session.retransmitTimeout), session.socket);
+        session.retransmitTimeout = std::min(session.retransmitTimeout * 2, MAX_RETRANSMIT_TIMEOUT);
+    }
+    if (isSynAckSent) {
+        sendSegment(session, TcpHeader::SYN | TcpHeader::ACK, session.initialSequenceNumber, {});
+    } else {
+        session.next = session.unacknowledged;
+        session.finSent = false;
+        session.duplicateAcks = 0;
+        flushToApp(session);
+    }
+    updateRetransmitTimer(session);
+}
+
+//
+// Probes an established connection the app sent nothing on for a while
+// with a segment just before the window, which it answers with an ack, and
+// resets it once enough probes went unanswered.
+//
+auto vpn::TcpForwarder::keepAlive(Session &session) -> void {
+    now_ = timers_.now();
+    if (session.keepAliveProbes == 0 && session.lastAppSegment + KEEPALIVE_IDLE > now_) {
+        timers_.schedule(session.keepAliveTimer, session.lastAppSegment + KEEPALIVE_IDLE);
+        return;
+    }
+    if (session.keepAliveProbes == KEEPALIVE_PROBES) {
+        LOGD("keepAlive app of socket [%d] stopped answering", session.socket);
+        reset(session);
+        reap(session);
+        return;
+    }
+    session.keepAliveProbes++;
+    sendSegment(session, TcpHeader::ACK, session.unacknowledged - 1, {});
+    timers_.schedule(session.keepAliveTimer, now_ + KEEPALIVE_INTERVAL);
+}
+
+auto vpn::TcpForwarder::reset(Session &session) -> void {
+    if (session.state != Session::State::Closed) {
+        sendSegment(session, TcpHeader::RST | TcpHeader::ACK, session.next, {});
+        session.state = Session::State::Closed;
+    }
+}
+
+//
+// Closes the session once it was reset or both sides finished and every
+// byte was delivered; the session is gone when this returns.
+//
+auto vpn::TcpForwarder::reap(Session &session) -> void {
+    if (session.finSent && session.appFinished && session.unacknowledged == session.next && session.toUpstream.empty()) {
+        session.state = Session::State::Closed;
+    }
+    if (session.state != Session::State::Closed) {
+        return;
+    }
+    auto const socket = session.socket;
+    closeAttempts(session, socket);
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+    onSocketDestroyed_(socket);
+    close(socket);
+    session.flow->socket = -1;
+    sessions_.erase(socket);
+}
+
+auto vpn::TcpForwarder::sendSegment(Session &session, uint8_t const flags, uint32_t const sequenceNumber, std::span<uint8_t const> const payload)
+        -> bool {
+    auto const window = session.window();
+    auto const mss = (flags & TcpHeader::SYN) != 0 ? maxMss(session.key.destinationAddress) : uint16_t{0};
+    if (!writeSegment(session.key, flags, sequenceNumber, session.appNext, window, mss, payload, session.flow->uid)) {
+        return false;
+    }
+    session.ackPending = false;
+    session.advertisedWindow = window;
+    session.flow->receivedPackets++;
+    session.flow->receivedBytes += ipHeaderSize(session.key.destinationAddress) + TcpHeader::MIN_SIZE + (mss != 0 ? 4 : 0) + payload.size();
+    return true;
+}
+
+auto vpn::TcpForwarder::sendReset(FlowKey const &key, TcpHeader const &tcpHeader) -> void {
+    if (tcpHeader.hasFlags(TcpHeader::ACK)) {
+        writeSegment(key, TcpHeader::RST, tcpHeader.acknowledgementNumber(), 0, 0, 0, {});
+        return;
+    }
+    auto const length = tcpHeader.payload().size() + (tcpHeader.hasFlags(TcpHeader::SYN) ? 1 : 0) + (tcpHeader.hasFlags(TcpHeader::FIN) ? 1 : 0);
+    writeSegment(key, TcpHeader::RST | TcpHeader::ACK, 0, tcpHeader.sequenceNumber() + static_cast<uint32_t>(length), 0, 0, {});
+}
+
+//
+// Writes a segment of the flow to the app, i.e. from its destination to its
+// source, with the MSS option if mss is not 0.  Fails if the tunnel is full,
+// in which case the segment is sent again later.
+//
+auto vpn::TcpForwarder::writeSegment(FlowKey const &key, uint8_t const flags, uint32_t const sequenceNumber, uint32_t const acknowledgementNumber,
+                                     uint16_t const window, uint16_t const mss, std::span<uint8_t const> const payload, int32_t const uid) -> bool {
+    auto const tcpHeaderLength = TcpHeader::MIN_SIZE + (mss != 0 ? 4 : 0);
+    auto const ipHeaderLength = ipHeaderSize(key.destinationAddress);
+    auto const packet = std::span(segment_).first(ipHeaderLength + tcpHeaderLength + payload.size());
+
+    writeIpHeader(packet, IpProtocol::Tcp, key.destinationAddress, key.sourceAddress, nextPacketId_++);
+
+    auto const tcpSegment = packet.subspan(ipHeaderLength);
+    detail::store16(tcpSegment, 0, key.destinationPort);
+    detail::store16(tcpSegment, 2, key.sourcePort);
+    detail::store32(tcpSegment, 4, sequenceNumber);
+    detail::store32(tcpSegment, 8, acknowledgementNumber);
+    tcpSegment[12] = static_cast<uint8_t>(tcpHeaderLength / 4 << 4U);
+    tcpSegment[13] = flags;
+    detail::store16(tcpSegment, 14, window);
+    detail::store32(tcpSegment, 16, 0);
+    if (mss != 0) {
+        tcpSegment[20] = 2;
+        tcpSegment[21] = 4;
+        detail::store16(tcpSegment, 22, mss);
+    }
+    std::copy(payload.begin(), payload.end(), tcpSegment.begin() + static_cast<ptrdiff_t>(tcpHeaderLength));
+    detail::store16(tcpSegment, 16, transportChecksum(packet));
+
+    return tunnel_.write(packet, uid);
+}
@@ -0,0 +1,230 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_TCPFORWARDER_H_
+#define ANDROID_INTROSPECTION_VPN_TCPFORWARDER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <unordered_map>
+
+#include "FlowTable.h"
+#include "HttpParser.h"
+#include "InspectionSampler.h"
+#include "PacketHeaders.h"
+#include "PacketPool.h"
+#include "StreamReassembler.h"
+#include "TimerWheel.h"
+#include "Tunnel.h"
+
+namespace ai::vpn {
+
+    class HostnameTable;
+
+    //
+    // Called with every upstream socket right after it is created, e.g. to
+    // protect it from the VPN, and right before it is closed.
+    //
+    using SocketCallback = std::function<void(int socket)>;
+
+    //
+    // Called with every request read from a flow whose app speaks HTTP/1.x
+    // in the clear, once its headers came.
+    //
+    using HttpRequestCallback = std::function<void(Flow &flow, HttpRequest const &request)>;
+
+    //
+    // Terminates the TCP flows of the tunnel in user space: the handshake
+    // with the app is answered once a socket of the flow connected to its
+    // destination, and data is then moved between the two as each side is
+    // ready, within the window the app advertises and ring buffers of a
+    // fixed size.  Packets written to the tunnel are delivered locally but
+    // may be dropped when it is full, so segments are sent again on
+    // duplicate acks and on a retransmission timeout, and idle connections
+    // are probed with keep-alives to find apps that went away.  Segments of
+    // apps that came ahead of a lost one are held until it is sent again,
+    // and what apps send to a socket may be parsed for HTTP requests on its
+    // way, past the first bytes of a flow only while the sampler follows
+    // every packet.
+    //
+    // Upstream connects race the addresses of the other family DNS answers
+    // gave for the name of the destination, as Happy Eyeballs (RFC 8305)
+    // does, so that a family the network does not route costs a delay
+    // rather than the flow.  Where the kernel lets clients use TCP Fast
+    // Open, flows to ports of protocols whose clients speak first that have
+    // a single address to connect to have their handshake answered right
+    // away and connect with the first bytes of the app in the SYN; a
+    // destination that refuses them is then reset rather than refused.
+    //
+    // Everything runs on the packet loop: sockets are added to its epoll set
+    // with a token, their events are handed back through handleSocketEvent()
+    // and timers of sessions are on the loop's wheel.
+    //
+    class TcpForwarder final {
+
+        struct Session;
+
+        TunnelQueue &tunnel_;
+
+        int const epollFd_;
+
+        TimerWheel &timers_;
+
+        SocketCallback onSocketCreated_;
+
+        SocketCallback onSocketDestroyed_;
+
+        HttpRequestCallback onHttpRequest_;
+
+        InspectionSampler const *const sampler_;
+
+        HostnameTable const *const hostnames_;
+
+        //
+        // Whether connects may carry data, until the kernel says otherwise.
+        //
+        bool isFastOpenEnabled_;
+
+        std::unordered_map<int, std::unique_ptr<Session>> sessions_;
+
+        //
+        // Sockets of sessions racing other addresses than that of their flow,
+        // which the sessions are not found by until one of them connected.
+        //
+        std::unordered_map<int, Session *> attemptSockets_;
+
+        //
+        // Ids of sessions, part of their epoll token, so that an event left
+        // over from a closed session is not taken for one of a new session
+        // reusing its socket.  Ids with the top bit set are UdpForwarder's.
+        //
+        uint32_t nextSessionId_ = 1;
+
+        uint16_t nextPacketId_ = 0;
+
+        //
+        // Time of the event being handled.
+        //
+        uint64_t now_ = 0;
+
+        std::minstd_rand sequenceNumbers_;
+
+        std::array<uint8_t, PACKET_SIZE> segment_{};
+
+        auto openSession(Flow &flow, TcpHeader const &tcpHeader) -> void;
+
+        auto startUpstream(Session &session) -> void;
+
+        auto startNextAttempt(Session &session) -> void;
+
+        auto connectAttempt(Session &session, int socket, IpAddress const &address) -> std::optional<size_t>;
+
+        auto finishAttempt(Session &session, int socket) -> void;
+
+        auto closeAttempts(Session &session, int keptSocket) -> void;
+
+        auto connectTimedOut(Session &session) -> void;
+
+        auto connected(Session &session) -> void;
+
+        auto answerSyn(Session &session) -> void;
+
+        auto acknowledge(Session &session, TcpHeader const &tcpHeader) -> void;
+
+        auto receive(Session &session, TcpHeader const &tcpHeader, PacketBuffer *packet) -> void;
+
+        auto take(Session &session, std::span<uint8_t const> bytes) -> size_t;
+
+        auto parseRequests(Session &session, std::span<uint8_t const> bytes) -> void;
+
+        auto readUpstream(Session &session) -> void;
+
+        auto writeUpstream(Session &session) -> void;
+
+        auto flushToApp(Session &session) -> void;
+
+        auto updateEvents(Session &session) -> void;
+
+        auto updateRetransmitTimer(Session &session) -> void;
+
+        auto retransmit(Session &session) -> void;
+
+        auto keepAlive(Session &session) -> void;
+
+        auto reset(Session &session) -> void;
+
+        auto reap(Session &session) -> void;
+
+        auto sendSegment(Session &session, uint8_t flags, uint32_t sequenceNumber, std::span<uint8_t const> payload) -> bool;
+
+        auto sendReset(FlowKey const &key, TcpHeader const &tcpHeader) -> void;
+
+        auto writeSegment(FlowKey const &key, uint8_t flags, uint32_t sequenceNumber, uint32_t acknowledgementNumber, uint16_t window,
+                          uint16_t mss, std::span<uint8_t const> payload, int32_t uid = UNKNOWN_UID) -> bool;
+
+    public:
+        //
+        // Without hostnames, upstream connects only try the address of the
+        // flow.
+        //
+        TcpForwarder(TunnelQueue &tunnel, int epollFd, TimerWheel &timers, SocketCallback onSocketCreated, SocketCallback onSocketDestroyed,
+                     HttpRequestCallback onHttpRequest = {}, InspectionSampler const *sampler = nullptr, HostnameTable const *hostnames = nullptr);
+
+        TcpForwarder(TcpForwarder const &) = delete;
+
+        auto operator=(TcpForwarder const &) -> TcpForwarder & = delete;
+
+        //
+        // Closes every session, without resetting it.
+        //
+        ~TcpForwarder();
+
+        //
+        // A segment the app sent into the tunnel, with the flow it belongs to
+        // and the buffer of its packet if the caller has one, which is taken
+        // if the segment is held for reassembly.
+        //
+        auto handleSegment(TcpHeader const &tcpHeader, Flow &flow, uint64_t now, PacketBuffer *packet = nullptr) -> void;
+
+        //
+        // Events of epoll for the token of a socket of a session.
+        //
+        auto handleSocketEvent(uint64_t token, uint32_t events, uint64_t now) -> void;
+
+        //
+        // Resets the session of the flow, if it has one, e.g. when the flow
+        // is expired.  The flow itself is left to the caller.
+        //
+        auto abort(Flow &flow) -> void;
+
+        auto sessionCount() const -> size_t { return sessions_.size(); }
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_TCPFORWARDER_H_ */
@@ -0,0 +1,211 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "utils/log.h"
+#include "ThreadTuner.h"
+
+using namespace ai;
+
+namespace {
+
+    std::atomic_uint64_t gMoves{0};
+
+    std::atomic_uint64_t gFailures{0};
+
+    //
+    // Number in a sysfs file, 0 if there is none.
+    //
+    auto readNumber(std::string const &path) -> uint64_t {
+        auto const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return 0;
+        }
+        char text[32] = {};
+        auto const size = read(fd, text, sizeof(text) - 1);
+        close(fd);
+        return size > 0 ? std::strtoull(text, nullptr, 10) : 0;
+    }
+
+    auto getCapacity(int const cpu) -> uint64_t {
+        auto const directory = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        auto const capacity = readNumber(directory + "/cpu_capacity");
+        return capacity != 0 ? capacity : readNumber(directory + "/cpufreq/cpuinfo_max_freq");
+    }
+
+    auto getNice(vpn::ThreadPolicy const policy) -> int {
+        return policy == vpn::ThreadPolicy::Performance || policy == vpn::ThreadPolicy::Adaptive ? vpn::ThreadTuner::RAISED_PRIORITY : 0;
+    }
+}
+
+auto vpn::CpuTopology::read() -> CpuTopology {
+    auto topology = CpuTopology();
+    CPU_ZERO(&topology.big);
+    CPU_ZERO(&topology.little);
+    auto const cpuCount = std::clamp<long>(sysconf(_SC_NPROCESSORS_CONF), 1, CPU_SETSIZE);
+    auto capacities = std::vector<uint64_t>(static_cast<size_t>(cpuCount));
+    for (auto cpu = 0; cpu < cpuCount; cpu++) {
+        capacities[static_cast<size_t>(cpu)] = getCapacity(cpu);
+    }
+    auto const [smallest, largest] = std::ranges::minmax(capacities);
+    for (auto cpu = 0; cpu < cpuCount; cpu++) {
+        if (capacities[static_cast<size_t>(cpu)] == largest) {
+            CPU_SET(cpu, &topology.big);
+        }
+        if (capacities[static_cast<size_t>(cpu)] == smallest) {
+            CPU_SET(cpu, &topology.little);
+        }
+    }
+    topology.isHeterogeneous = smallest != largest;
+    LOGI("CpuTopology::read %d big and %d little cores", CPU_COUNT(&topology.big), topology.isHeterogeneous ? CPU_COUNT(&topology.little) : 0);
+    return topology;
+}
+
+vpn::ThreadTuner::ThreadTuner(CpuTopology const &topology) : topology_(topology) {
+}
+
+auto vpn::ThreadTuner::getCores() const -> Cores {
+    switch (policy_) {
+        case ThreadPolicy::Performance:
+            return Cores::Big;
+        case ThreadPolicy::PowerSave:
+            return Cores::Little;
+        case ThreadPolicy::Adaptive:
+            return cores_ == Cores::Big ? Cores::Big : Cores::Little;
+        case ThreadPolicy::Default:
+            break;
+    }
+    return Cores::Any;
+}
+
+//
+// A SoC without little cores runs the threads anywhere, whatever the
+// policy.  Called with the lock held.
+//
+auto vpn::ThreadTuner::apply(pid_t const thread) const -> void {
+    auto cores = cpu_set_t();
+    if (!topology_.isHeterogeneous || cores_ == Cores::Any) {
+        CPU_ZERO(&cores);
+        for (auto cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &cores);
+        }
+    } else {
+        cores = cores_ == Cores::Big ? topology_.big : topology_.little;
+    }
+    if (sched_setaffinity(thread, sizeof(cores), &cores) != 0) {
+        LOGW("ThreadTuner::apply unable to set cores of thread %d, %s", static_cast<int>(thread), strerror(errno));
+        gFailures.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(thread), getNice(policy_)) != 0) {
+        LOGW("ThreadTuner::apply unable to set priority of thread %d, %s", static_cast<int>(thread), strerror(errno));
+        gFailures.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+auto vpn::ThreadTuner::update(Cores const cores) -> void {
+    auto const lock = std::lock_guard(mutex_);
+    if (cores == cores_ || policy_ != ThreadPolicy::Adaptive) {
+        return;
+    }
+    LOGD("ThreadTuner::update moving %zu threads to the %s cores", threads_.size(), cores == Cores::Big ? "big" : "little");
+    cores_ = cores;
+    gMoves.fetch_add(1, std::memory_order_relaxed);
+    for (auto const thread : threads_) {
+        apply(thread);
+    }
+}
+
+auto vpn::ThreadTuner::setPolicy(ThreadPolicy const policy) -> void {
+    auto const lock = std::lock_guard(mutex_);
+    LOGI("ThreadTuner::setPolicy %d", static_cast<int>(policy));
+    policy_ = policy;
+    cores_ = getCores();
+    currentPolicy_.store(policy, std::memory_order_relaxed);
+    for (auto const thread : threads_) {
+        apply(thread);
+    }
+}
+
+auto vpn::ThreadTuner::attach() -> void {
+    auto const lock = std::lock_guard(mutex_);
+    auto const thread = gettid();
+    threads_.push_back(thread);
+    if (policy_ != ThreadPolicy::Default) {
+        apply(thread);
+    }
+}
+
+//
+// Threads leave as they go, on the default policy, so that a thread
+// reused for something else does not keep it.
+//
+auto vpn::ThreadTuner::detach() -> void {
+    auto const lock = std::lock_guard(mutex_);
+    auto const thread = gettid();
+    std::erase(threads_, thread);
+    if (policy_ != ThreadPolicy::Default) {
+        auto const policy = std::exchange(policy_, ThreadPolicy::Default);
+        auto const cores = std::exchange(cores_, Cores::Any);
+        apply(thread);
+        policy_ = policy;
+        cores_ = cores;
+    }
+}
+
+//
+// Under the adaptive policy, the window starts over with every decision,
+// and the rate of a window cut short by a quiet spell of any length is
+// taken over the whole of it.
+//
+auto vpn::ThreadTuner::onPackets(size_t const count, uint64_t const now) -> void {
+    if (policy() != ThreadPolicy::Adaptive) {
+        return;
+    }
+    windowPackets_ += count;
+    auto const elapsed = now - windowStart_;
+    if (elapsed < WINDOW) {
+        return;
+    }
+    auto const rate = windowPackets_ * 1000 / elapsed;
+    if (rate >= BURST_RATE) {
+        update(Cores::Big);
+    } else if (rate < IDLE_RATE) {
+        update(Cores::Little);
+    }
+    windowStart_ = now;
+    windowPackets_ = 0;
+}
+
+auto vpn::getThreadStats() -> std::string {
+    return "threads.moves " + std::to_string(gMoves.load(std::memory_order_relaxed)) + "\n" +
+           "threads.failures " + std::to_string(gFailures.load(std::memory_order_relaxed)) + "\n";
+}
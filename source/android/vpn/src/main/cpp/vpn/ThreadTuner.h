@@ -0,0 +1,187 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_THREADTUNER_H_
+#define ANDROID_INTROSPECTION_VPN_THREADTUNER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sched.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace ai::vpn {
+
+    //
+    // Where the threads moving packets between the tunnel and the workers
+    // run and at which priority; values match the THREAD_POLICY_ constants
+    // of IVpnService.aidl.
+    //
+    enum class ThreadPolicy : int32_t {
+
+        //
+        // Any core, default priority, as the scheduler sees fit.
+        //
+        Default = 0,
+
+        //
+        // Big cores at a raised priority, for throughput and the least
+        // scheduling jitter.
+        //
+        Performance = 1,
+
+        //
+        // Little cores at default priority, to spare the battery.
+        //
+        PowerSave = 2,
+
+        //
+        // Raised priority, on big cores while traffic is bursty and on
+        // little cores once it calms down.
+        //
+        Adaptive = 3,
+    };
+
+    //
+    // Cores with the most and with the least capacity; a SoC whose cores
+    // are all alike has no little ones.
+    //
+    struct CpuTopology {
+
+        cpu_set_t big;
+
+        cpu_set_t little;
+
+        bool isHeterogeneous = false;
+
+        //
+        // Reads the capacity of every core from sysfs, or its peak frequency
+        // on kernels that do not tell it.
+        //
+        static auto read() -> CpuTopology;
+    };
+
+    //
+    // Applies a ThreadPolicy to the threads attached to it.  The policy can
+    // be changed from any thread, e.g. a binder one, and is applied to
+    // the attached threads right away through their tids, so that a thread
+    // blocked in a wait moves without having to wake.  Under the adaptive
+    // policy, the reader tells the tuner how many packets it reads, and
+    // all the attached threads move to the big cores once the rate of
+    // a window of packets reaches BURST_RATE, and back once it drops
+    // under IDLE_RATE; that way a burst costs one move and a quiet tunnel
+    // moves back on its next packet.  Failures, e.g. of a cpuset not
+    // holding the cores, are logged and leave the threads where they were.
+    //
+    class ThreadTuner final {
+
+        enum class Cores {
+            Any,
+            Big,
+            Little,
+        };
+
+        CpuTopology const topology_;
+
+        std::mutex mutex_;
+
+        std::vector<pid_t> threads_;
+
+        ThreadPolicy policy_ = ThreadPolicy::Default;
+
+        Cores cores_ = Cores::Any;
+
+        //
+        // Policy as last set, read by the reader without the lock.
+        //
+        std::atomic<ThreadPolicy> currentPolicy_{ThreadPolicy::Default};
+
+        //
+        // Only used by the reader.
+        //
+        uint64_t windowStart_ = 0;
+
+        uint64_t windowPackets_ = 0;
+
+        auto getCores() const -> Cores;
+
+        auto apply(pid_t thread) const -> void;
+
+        auto update(Cores cores) -> void;
+
+    public:
+        //
+        // Packets per second moving the threads to the big cores under the
+        // adaptive policy, and back to the little ones.
+        //
+        static constexpr uint64_t BURST_RATE = 5'000;
+
+        static constexpr uint64_t IDLE_RATE = 500;
+
+        //
+        // Milliseconds of packets the rate is taken over.
+        //
+        static constexpr uint64_t WINDOW = 100;
+
+        //
+        // Nice value of the threads at a raised priority, that of
+        // THREAD_PRIORITY_URGENT_DISPLAY, the highest apps may take.
+        //
+        static constexpr int RAISED_PRIORITY = -8;
+
+        explicit ThreadTuner(CpuTopology const &topology = CpuTopology::read());
+
+        ThreadTuner(ThreadTuner const &) = delete;
+
+        auto operator=(ThreadTuner const &) -> ThreadTuner & = delete;
+
+        auto setPolicy(ThreadPolicy policy) -> void;
+
+        auto policy() const -> ThreadPolicy { return currentPolicy_.load(std::memory_order_relaxed); }
+
+        //
+        // Applies the policy to the calling thread from here on, until it
+        // detaches.
+        //
+        auto attach() -> void;
+
+        auto detach() -> void;
+
+        //
+        // Counts the packets the reader read at the time in milliseconds.
+        // Reader only.
+        //
+        auto onPackets(size_t count, uint64_t now) -> void;
+    };
+
+    //
+    // Moves of the threads between big and little cores since the library
+    // was loaded, and failures to apply a policy, one "name value" per line.
+    //
+    auto getThreadStats() -> std::string;
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_THREADTUNER_H_ */
@@ -0,0 +1,284 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <bit>
+#include <climits>
+
+#include "TimerWheel.h"
+
+using namespace ai;
+
+vpn::TimerWheel::Timer::~Timer() {
+    cancel();
+}
+
+auto vpn::TimerWheel::Timer::cancel() -> void {
+    if (wheel_ != nullptr) {
+        wheel_->remove(*this);
+    } else if (isScheduled()) {
+        unlink(*this);
+    }
+}
+
+vpn::TimerWheel::TimerWheel(uint64_t const tick, uint64_t const now)
+        : tick_(tick), slots_(std::make_unique<Timer[]>(LEVELS * SLOTS)), currentTick_(now / tick), now_(now) {
+    for (size_t slot = 0; slot < LEVELS * SLOTS; slot++) {
+        slots_[slot].previous_ = &slots_[slot];
+        slots_[slot].next_ = &slots_[slot];
+    }
+}
+
+//
+// Timers outliving the wheel are left unscheduled.
+//
+vpn::TimerWheel::~TimerWheel() {
+    for (size_t slot = 0; slot < LEVELS * SLOTS; slot++) {
+        auto &head = slots_[slot];
+        while (head.next_ != &head) {
+            head.next_->wheel_ = nullptr;
+            head.next_->slot_ = NO_SLOT;
+            unlink(*head.next_);
+        }
+        head.previous_ = nullptr;
+        head.next_ = nullptr;
+    }
+}
+
+auto vpn::TimerWheel::schedule(Timer &timer, uint64_t const deadline) -> void {
+    remove(timer);
+    timer.deadline_ = deadline;
+    timer.wheel_ = this;
+    place(timer);
+    size_++;
+}
+
+auto vpn::TimerWheel::cancel(Timer &timer) -> void {
+    remove(timer);
+}
+
+auto vpn::TimerWheel::timeout(uint64_t const now) const -> int {
+    if (size_ == 0) {
+        return -1;
+    }
+
+    //
+    // Timers of a wheel above the first are only due at the start of their
+    // slot at the earliest, which is when they move down.
+    //
+    auto tick = (currentTick_ | (SLOTS - 1)) + 1;
+    auto const *dueSlot = static_cast<Timer const *>(nullptr);
+    for (size_t level = 0; level < LEVELS; level++) {
+        auto const shift = SLOT_BITS * level;
+        auto const first = ((currentTick_ >> shift) & (SLOTS - 1)) + (level == 0 ? 0 : 1);
+        auto const slots = first < SLOTS ? occupiedSlots_[level] >> first << first : 0;
+        if (slots != 0) {
+            auto const slot = static_cast<size_t>(std::countr_zero(slots));
+            tick = (currentTick_ >> (shift + SLOT_BITS) << (shift + SLOT_BITS)) + (static_cast<uint64_t>(slot) << shift);
+            dueSlot = level == 0 ? &slots_[slot] : nullptr;
+            break;
+        }
+    }
+
+    //
+    // Timers of the first wheel are due at their deadlines rather than at
+    // the start of their tick, which a wait that already began it would
+    // otherwise spin through.
+    //
+    auto deadline = tick * tick_;
+    if (dueSlot != nullptr) {
+        deadline = UINT64_MAX;
+        for (auto const *timer = dueSlot->next_; timer != dueSlot; timer = timer->next_) {
+            deadline = std::min(deadline, timer->deadline_);
+        }
+    }
+    return deadline > now ? static_cast<int>(std::min<uint64_t>(deadline - now, INT_MAX)) : 0;
+}
+
+auto vpn::TimerWheel::advance(uint64_t const now) -> size_t {
+    now_ = now;
+    auto const targetTick = now / tick_;
+    if (targetTick < currentTick_) {
+        return 0;
+    }
+
+    //
+    // Expired timers are moved to a list of their own first, so callbacks
+    // can do anything to the wheel while it fires the rest.  Ticks without
+    // a timer in the first wheel are skipped, stopping only where a slot of
+    // a wheel above moves down.
+    //
+    auto expired = Timer();
+    expired.previous_ = &expired;
+    expired.next_ = &expired;
+    while (true) {
+        auto const slot = static_cast<size_t>(currentTick_ & (SLOTS - 1));
+        auto due = Timer();
+        due.previous_ = &due;
+        due.next_ = &due;
+        splice(slots_[slot], due);
+        occupiedSlots_[0] &= ~(uint64_t{1} << slot);
+        while (due.next_ != &due) {
+            auto &timer = *due.next_;
+            unlink(timer);
+            timer.slot_ = NO_SLOT;
+            if (timer.deadline_ <= now) {
+                link(expired, timer);
+                timer.wheel_ = nullptr;
+                size_--;
+            } else {
+                place(timer);
+            }
+        }
+        due.previous_ = nullptr;
+        due.next_ = nullptr;
+
+        if (currentTick_ == targetTick) {
+            break;
+        }
+        auto const later = slot + 1 < SLOTS ? occupiedSlots_[0] >> (slot + 1) << (slot + 1) : 0;
+        auto const nextTick = later != 0 ? currentTick_ - slot + static_cast<uint64_t>(std::countr_zero(later)) : currentTick_ - slot + SLOTS;
+        if (nextTick > targetTick) {
+            currentTick_ = targetTick;
+            break;
+        }
+        currentTick_ = nextTick;
+        if (later == 0) {
+            cascade();
+        }
+    }
+
+    auto fired = size_t{0};
+    while (expired.next_ != &expired) {
+        auto &timer = *expired.next_;
+        unlink(timer);
+        if (auto const onExpired = timer.onExpired_) {
+            onExpired();
+        }
+        fired++;
+    }
+    expired.previous_ = nullptr;
+    expired.next_ = nullptr;
+    return fired;
+}
+
+//
+// Puts the timer in the lowest wheel whose current slot spans its deadline,
+// in the slot of the deadline.
+//
+auto vpn::TimerWheel::place(Timer &timer) -> void {
+    auto const reach = (uint64_t{1} << (SLOT_BITS * LEVELS)) - 1;
+    auto const tick = std::clamp(timer.deadline_ / tick_, currentTick_, currentTick_ | reach);
+    auto level = size_t{0};
+    while (((tick ^ currentTick_) >> (SLOT_BITS * (level + 1))) != 0) {
+        level++;
+    }
+    auto const slot = static_cast<size_t>((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    link(slots_[level * SLOTS + slot], timer);
+    timer.slot_ = static_cast<uint16_t>(level * SLOTS + slot);
+    occupiedSlots_[level] |= uint64_t{1} << slot;
+}
+
+auto vpn::TimerWheel::placeAll(Timer &list) -> void {
+    while (list.next_ != &list) {
+        auto &timer = *list.next_;
+        unlink(timer);
+        place(timer);
+    }
+}
+
+//
+// Moves the timers of the slots the current tick just entered down, from
+// the highest wheel that turned to the second.
+//
+auto vpn::TimerWheel::cascade() -> void {
+    auto levels = size_t{1};
+    while (levels < LEVELS && (currentTick_ & ((uint64_t{1} << (SLOT_BITS * levels)) - 1)) == 0) {
+        levels++;
+    }
+    for (auto level = levels - 1; level > 0; level--) {
+        auto const slot = static_cast<size_t>((currentTick_ >> (SLOT_BITS * level)) & (SLOTS - 1));
+        if ((occupiedSlots_[level] & (uint64_t{1} << slot)) == 0) {
+            continue;
+        }
+        auto list = Timer();
+        list.previous_ = &list;
+        list.next_ = &list;
+        splice(slots_[level * SLOTS + slot], list);
+        occupiedSlots_[level] &= ~(uint64_t{1} << slot);
+        placeAll(list);
+        list.previous_ = nullptr;
+        list.next_ = nullptr;
+    }
+}
+
+//
+// Takes the timer out of its slot, or out of the timers about to fire.
+//
+auto vpn::TimerWheel::remove(Timer &timer) -> void {
+    if (timer.wheel_ != nullptr) {
+        timer.wheel_ = nullptr;
+        size_--;
+    }
+    if (timer.isScheduled()) {
+        detach(timer);
+    }
+}
+
+auto vpn::TimerWheel::detach(Timer &timer) -> void {
+    auto const slot = timer.slot_;
+    unlink(timer);
+    timer.slot_ = NO_SLOT;
+    if (slot != NO_SLOT && slots_[slot].next_ == &slots_[slot]) {
+        occupiedSlots_[slot / SLOTS] &= ~(uint64_t{1} << (slot % SLOTS));
+    }
+}
+
+auto vpn::TimerWheel::link(Timer &head, Timer &timer) -> void {
+    timer.previous_ = head.previous_;
+    timer.next_ = &head;
+    head.previous_->next_ = &timer;
+    head.previous_ = &timer;
+}
+
+auto vpn::TimerWheel::unlink(Timer &timer) -> void {
+    timer.previous_->next_ = timer.next_;
+    timer.next_->previous_ = timer.previous_;
+    timer.previous_ = nullptr;
+    timer.next_ = nullptr;
+}
+
+//
+// Moves every timer of the list of one head to the end of another.
+//
+auto vpn::TimerWheel::splice(Timer &from, Timer &to) -> void {
+    if (from.next_ == &from) {
+        return;
+    }
+    from.next_->previous_ = to.previous_;
+    from.previous_->next_ = &to;
+    to.previous_->next_ = from.next_;
+    to.previous_ = from.previous_;
+    from.next_ = &from;
+    from.previous_ = &from;
+}
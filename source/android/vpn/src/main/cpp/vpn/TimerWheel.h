@@ -0,0 +1,171 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_TIMERWHEEL_H_
+#define ANDROID_INTROSPECTION_VPN_TIMERWHEEL_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace ai::vpn {
+
+    //
+    // Timers of the packet loop in a hierarchy of wheels of 64 slots, each
+    // slot of a wheel spanning the whole wheel below it, so that scheduling
+    // a timer again, as every reset of a retransmit or idle timer does, only
+    // moves it between two lists.  Timers move down a wheel as their slot
+    // comes up, and a bitmap of the slots in use of each wheel lets the loop
+    // sleep until the next one.  Times are in milliseconds of the loop's
+    // monotonic clock; timers fire on the first advance() past their deadline.
+    //
+    class TimerWheel final {
+
+        static constexpr size_t SLOT_BITS = 6;
+
+        static constexpr size_t SLOTS = size_t{1} << SLOT_BITS;
+
+        //
+        // Enough for years of ticks of 100 ms; later deadlines wait at the
+        // top until they are in reach.
+        //
+        static constexpr size_t LEVELS = 5;
+
+        static constexpr uint16_t NO_SLOT = UINT16_MAX;
+
+    public:
+        class Timer final {
+
+            friend class TimerWheel;
+
+            Timer *previous_ = nullptr;
+
+            Timer *next_ = nullptr;
+
+            //
+            // Wheel the timer is scheduled in, none while it is about to fire.
+            //
+            TimerWheel *wheel_ = nullptr;
+
+            uint64_t deadline_ = 0;
+
+            uint16_t slot_ = NO_SLOT;
+
+            std::function<void()> onExpired_;
+
+        public:
+            Timer() = default;
+
+            explicit Timer(std::function<void()> onExpired) : onExpired_(std::move(onExpired)) {}
+
+            Timer(Timer const &) = delete;
+
+            auto operator=(Timer const &) -> Timer & = delete;
+
+            ~Timer();
+
+            auto setOnExpired(std::function<void()> onExpired) -> void { onExpired_ = std::move(onExpired); }
+
+            //
+            // Same as TimerWheel::cancel(), for owners that do not know the wheel.
+            //
+            auto cancel() -> void;
+
+            auto isScheduled() const -> bool { return next_ != nullptr; }
+
+            auto deadline() const -> uint64_t { return deadline_; }
+        };
+
+        TimerWheel(uint64_t tick, uint64_t now);
+
+        TimerWheel(TimerWheel const &) = delete;
+
+        auto operator=(TimerWheel const &) -> TimerWheel & = delete;
+
+        ~TimerWheel();
+
+        //
+        // Schedules the timer, moving it if it was already scheduled.
+        //
+        auto schedule(Timer &timer, uint64_t deadline) -> void;
+
+        auto cancel(Timer &timer) -> void;
+
+        //
+        // Milliseconds from now to the deadline of the first timer due, or to
+        // the tick timers of a wheel above move down at if that comes first,
+        // to wait at most for; -1 if there is none.
+        //
+        auto timeout(uint64_t now) const -> int;
+
+        //
+        // Fires every timer whose deadline is up to now and returns how many
+        // did.  Timers may be scheduled, cancelled or destroyed from the
+        // callbacks, their own included.
+        //
+        auto advance(uint64_t now) -> size_t;
+
+        //
+        // Time of the latest advance(), that of callbacks while they run.
+        //
+        auto now() const -> uint64_t { return now_; }
+
+        auto size() const -> size_t { return size_; }
+
+    private:
+        uint64_t const tick_;
+
+        //
+        // Heads of the circular lists of each slot, wheel after wheel.
+        //
+        std::unique_ptr<Timer[]> const slots_;
+
+        std::array<uint64_t, LEVELS> occupiedSlots_{};
+
+        uint64_t currentTick_;
+
+        uint64_t now_;
+
+        size_t size_ = 0;
+
+        auto place(Timer &timer) -> void;
+
+        auto placeAll(Timer &list) -> void;
+
+        auto cascade() -> void;
+
+        auto detach(Timer &timer) -> void;
+
+        auto remove(Timer &timer) -> void;
+
+        static auto link(Timer &head, Timer &timer) -> void;
+
+        static auto unlink(Timer &timer) -> void;
+
+        static auto splice(Timer &from, Timer &to) -> void;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_TIMERWHEEL_H_ */
@@ -0,0 +1,138 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <atomic>
+
+#include "utils/log.h"
+#include "utils/trace.h"
+#include "TlsInspector.h"
+
+using namespace ai;
+
+namespace {
+
+    //
+    // Flows a hello is put back together for at once; flows past that are
+    // left without names rather than kept waiting.
+    //
+    constexpr size_t MAX_PARTIAL_HELLOS = 64;
+
+    std::atomic_uint64_t gHellos{0};
+
+    std::atomic_uint64_t gReassembledHellos{0};
+
+    std::atomic_uint64_t gInvalidHellos{0};
+
+    std::atomic_uint64_t gSkippedHellos{0};
+
+    //
+    // Joins the names of a ProtocolNameList with commas.
+    //
+    auto joinProtocols(std::span<uint8_t const> protocols, std::string &joined) -> void {
+        while (!protocols.empty()) {
+            auto const length = static_cast<size_t>(protocols[0]);
+            if (length == 0 || length >= protocols.size()) {
+                break;
+            }
+            if (!joined.empty()) {
+                joined += ',';
+            }
+            joined.append(reinterpret_cast<char const *>(protocols.data() + 1), length);
+            protocols = protocols.subspan(1 + length);
+        }
+    }
+}
+
+auto vpn::TlsInspector::inspect(Flow &flow, FlowNames &names, TcpHeader const &tcpHeader) -> void {
+    TRACE_SPAN("TlsInspector::inspect");
+    auto const payload = tcpHeader.payload();
+    auto const it = partialHellos_.find(flow.key);
+    if (it == partialHellos_.end()) {
+        if (auto const result = parseClientHello(payload); result.status != ClientHelloResult::Status::Incomplete) {
+            finish(flow, names, payload, result, false);
+            return;
+        }
+        if (partialHellos_.size() >= MAX_PARTIAL_HELLOS) {
+            gSkippedHellos.fetch_add(1, std::memory_order_relaxed);
+            flow.isInspected = true;
+            return;
+        }
+        auto &partialHello = partialHellos_[flow.key];
+        partialHello.bytes.assign(payload.begin(), payload.end());
+        partialHello.nextSequenceNumber = tcpHeader.sequenceNumber() + static_cast<uint32_t>(payload.size());
+        return;
+    }
+
+    //
+    // Segments past a missing one are left for after it was sent again, as
+    // are those holding nothing new.
+    //
+    auto &partialHello = it->second;
+    auto const behind = static_cast<int32_t>(partialHello.nextSequenceNumber - tcpHeader.sequenceNumber());
+    if (behind < 0 || static_cast<size_t>(behind) >= payload.size()) {
+        return;
+    }
+    auto const added = payload.subspan(static_cast<size_t>(behind)).first(
+            std::min(payload.size() - static_cast<size_t>(behind), MAX_CLIENT_HELLO_SIZE - partialHello.bytes.size()));
+    partialHello.bytes.insert(partialHello.bytes.end(), added.begin(), added.end());
+    partialHello.nextSequenceNumber += static_cast<uint32_t>(added.size());
+    auto const result = parseClientHello(partialHello.bytes);
+    if (result.status == ClientHelloResult::Status::Incomplete && partialHello.bytes.size() < MAX_CLIENT_HELLO_SIZE) {
+        return;
+    }
+    finish(flow, names, partialHello.bytes, result, true);
+    partialHellos_.erase(it);
+}
+
+auto vpn::TlsInspector::forget(Flow const &flow) -> void {
+    if (!flow.isInspected && !partialHellos_.empty()) {
+        partialHellos_.erase(flow.key);
+    }
+}
+
+auto vpn::TlsInspector::finish(Flow &flow, FlowNames &names, std::span<uint8_t const> const stream, ClientHelloResult const &result,
+                               bool const isReassembled) -> void {
+    flow.isInspected = true;
+    if (result.status != ClientHelloResult::Status::Complete) {
+        if (!stream.empty() && stream[0] == TLS_HANDSHAKE_RECORD) {
+            gInvalidHellos.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    gHellos.fetch_add(1, std::memory_order_relaxed);
+    if (isReassembled) {
+        gReassembledHellos.fetch_add(1, std::memory_order_relaxed);
+    }
+    names.serverName.assign(reinterpret_cast<char const *>(result.hello.serverName.data()), result.hello.serverName.size());
+    joinProtocols(result.hello.protocols, names.protocols);
+    LOGD("TlsInspector::finish flow to [%s] offering [%s]", names.serverName.c_str(), names.protocols.c_str());
+}
+
+auto vpn::getTlsStats() -> std::string {
+    return "tls.hellos " + std::to_string(gHellos.load(std::memory_order_relaxed)) + "\n" +
+           "tls.reassembled " + std::to_string(gReassembledHellos.load(std::memory_order_relaxed)) + "\n" +
+           "tls.invalid " + std::to_string(gInvalidHellos.load(std::memory_order_relaxed)) + "\n" +
+           "tls.skipped " + std::to_string(gSkippedHellos.load(std::memory_order_relaxed)) + "\n";
+}
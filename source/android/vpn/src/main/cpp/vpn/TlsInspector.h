@@ -0,0 +1,275 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_TLSINSPECTOR_H_
+#define ANDROID_INTROSPECTION_VPN_TLSINSPECTOR_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "FlowTable.h"
+#include "PacketHeaders.h"
+
+//
+// Reading of the server name (SNI) and application protocols (ALPN) a TLS
+// client asks for in its ClientHello, which is sent in the clear, straight
+// from the bytes of the stream.
+//
+namespace ai::vpn {
+
+    constexpr uint8_t TLS_HANDSHAKE_RECORD = 0x16;
+
+    //
+    // Largest record a ClientHello is looked for in, with its header.
+    //
+    constexpr size_t MAX_CLIENT_HELLO_SIZE = 5 + 16 * 1024;
+
+    //
+    // What a ClientHello asked for, as views of the bytes it was read from;
+    // either is empty if the hello did not have it.
+    //
+    struct ClientHello {
+
+        std::span<uint8_t const> serverName;
+
+        //
+        // ProtocolNameList of ALPN, every name prefixed by its length.
+        //
+        std::span<uint8_t const> protocols;
+    };
+
+    struct ClientHelloResult {
+
+        enum class Status {
+            //
+            // The stream may be a ClientHello but not all of it came yet.
+            //
+            Incomplete,
+            //
+            // The stream is not a ClientHello in one record.
+            //
+            Invalid,
+            Complete,
+        };
+
+        Status status = Status::Invalid;
+
+        ClientHello hello;
+    };
+
+    namespace detail {
+
+        //
+        // Reads fields one after the other, failing once it is asked for more
+        // than there is.
+        //
+        class TlsReader final {
+
+            std::span<uint8_t const> bytes_;
+
+            size_t offset_ = 0;
+
+            bool failed_ = false;
+
+        public:
+            constexpr explicit TlsReader(std::span<uint8_t const> const bytes) : bytes_(bytes) {}
+
+            constexpr auto take(size_t const length) -> std::span<uint8_t const> {
+                if (failed_ || length > bytes_.size() - offset_) {
+                    failed_ = true;
+                    return {};
+                }
+                auto const taken = bytes_.subspan(offset_, length);
+                offset_ += length;
+                return taken;
+            }
+
+            constexpr auto read8() -> uint8_t {
+                auto const field = take(1);
+                return field.empty() ? 0 : field[0];
+            }
+
+            constexpr auto read16() -> uint16_t {
+                auto const field = take(2);
+                return field.empty() ? 0 : load16(field, 0);
+            }
+
+            constexpr auto read24() -> uint32_t {
+                auto const field = take(3);
+                return field.empty() ? 0 : static_cast<uint32_t>(field[0]) << 16U | load16(field, 1);
+            }
+
+            constexpr auto isAtEnd() const -> bool { return failed_ || offset_ == bytes_.size(); }
+
+            constexpr auto hasFailed() const -> bool { return failed_; }
+        };
+
+        constexpr uint8_t CLIENT_HELLO = 1;
+
+        constexpr uint16_t SERVER_NAME_EXTENSION = 0;
+
+        constexpr uint16_t ALPN_EXTENSION = 16;
+
+        constexpr uint8_t HOST_NAME = 0;
+
+        constexpr auto readExtension(uint16_t const type, TlsReader &extension, ClientHello &hello) -> void {
+            if (type == SERVER_NAME_EXTENSION) {
+                auto names = TlsReader(extension.take(extension.read16()));
+                while (!names.isAtEnd()) {
+                    auto const nameType = names.read8();
+                    auto const name = names.take(names.read16());
+                    if (nameType == HOST_NAME && !names.hasFailed()) {
+                        hello.serverName = name;
+                        break;
+                    }
+                }
+            } else if (type == ALPN_EXTENSION) {
+                hello.protocols = extension.take(extension.read16());
+            }
+        }
+    }
+
+    //
+    // Parses the start of what a client sent on a stream as a TLS record
+    // holding a ClientHello.  Hellos split over records, which clients do
+    // not send in practice, are taken as invalid.
+    //
+    constexpr auto parseClientHello(std::span<uint8_t const> const stream) -> ClientHelloResult {
+        using Status = ClientHelloResult::Status;
+        if ((!stream.empty() && stream[0] != TLS_HANDSHAKE_RECORD) || (stream.size() > 1 && stream[1] != 3)) {
+            return {Status::Invalid, {}};
+        }
+        if (stream.size() < 5) {
+            return {Status::Incomplete, {}};
+        }
+        auto const recordLength = detail::load16(stream, 3);
+        if (5 + static_cast<size_t>(recordLength) > MAX_CLIENT_HELLO_SIZE) {
+            return {Status::Invalid, {}};
+        }
+        if (stream.size() < 5 + static_cast<size_t>(recordLength)) {
+            return {Status::Incomplete, {}};
+        }
+
+        auto record = detail::TlsReader(stream.subspan(5, recordLength));
+        if (record.read8() != detail::CLIENT_HELLO) {
+            return {Status::Invalid, {}};
+        }
+        auto body = detail::TlsReader(record.take(record.read24()));
+        body.take(2 + 32);
+        body.take(body.read8());
+        body.take(body.read16());
+        body.take(body.read8());
+        auto result = ClientHelloResult{Status::Complete, {}};
+        if (body.isAtEnd()) {
+            return body.hasFailed() ? ClientHelloResult{Status::Invalid, {}} : result;
+        }
+        auto extensions = detail::TlsReader(body.take(body.read16()));
+        while (!extensions.isAtEnd()) {
+            auto const type = extensions.read16();
+            auto extension = detail::TlsReader(extensions.take(extensions.read16()));
+            detail::readExtension(type, extension, result.hello);
+        }
+        if (extensions.hasFailed()) {
+            return {Status::Invalid, {}};
+        }
+        return result;
+    }
+
+    //
+    // Finds the ClientHello in the first bytes the app sends on each TCP
+    // flow of a worker, and keeps the server name and protocols it asked
+    // for in the names of the flow.  A hello in the first segment, nearly
+    // every one, is read in place from the packet buffer; one spanning
+    // segments is put back together from them in order, up to a record.
+    // A flow is marked inspected, and no longer looked at, once its hello
+    // was read or it turned out not to start with one.  One worker only.
+    //
+    class TlsInspector final {
+
+        //
+        // Start of a hello spanning segments, and the sequence number of
+        // the byte expected next.
+        //
+        struct PartialHello {
+
+            std::vector<uint8_t> bytes;
+
+            uint32_t nextSequenceNumber = 0;
+        };
+
+        struct FlowKeyHash {
+
+            auto operator()(FlowKey const &key) const -> size_t { return static_cast<size_t>(key.hash()); }
+        };
+
+        std::unordered_map<FlowKey, PartialHello, FlowKeyHash> partialHellos_;
+
+        auto finish(Flow &flow, FlowNames &names, std::span<uint8_t const> stream, ClientHelloResult const &result, bool isReassembled) -> void;
+
+    public:
+        //
+        // A segment with data the app sent on a flow not inspected yet.
+        //
+        auto inspect(Flow &flow, FlowNames &names, TcpHeader const &tcpHeader) -> void;
+
+        //
+        // Drops what was kept of the flow, which is being erased.
+        //
+        auto forget(Flow const &flow) -> void;
+    };
+
+    //
+    // Hellos read since the library was loaded, one "name value" per line.
+    //
+    auto getTlsStats() -> std::string;
+
+    namespace detail {
+
+        //
+        // ClientHello for example.com offering h2 and http/1.1.
+        //
+        constexpr std::array<uint8_t, 90> SAMPLE_CLIENT_HELLO = {
+                0x16, 0x03, 0x01, 0x00, 0x55, 0x01, 0x00, 0x00, 0x51, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x13, 0x01,
+                0x01, 0x00, 0x00, 0x26, 0x00, 0x00, 0x00, 0x10, 0x00, 0x0E, 0x00, 0x00, 0x0B, 'e', 'x', 'a',
+                'm', 'p', 'l', 'e', '.', 'c', 'o', 'm', 0x00, 0x10, 0x00, 0x0E, 0x00, 0x0C, 0x02, 'h',
+                '2', 0x08, 'h', 't', 't', 'p', '/', '1', '.', '1',
+        };
+
+        static_assert(parseClientHello(SAMPLE_CLIENT_HELLO).status == ClientHelloResult::Status::Complete);
+        static_assert(std::ranges::equal(parseClientHello(SAMPLE_CLIENT_HELLO).hello.serverName, std::string_view("example.com")));
+        static_assert(parseClientHello(SAMPLE_CLIENT_HELLO).hello.protocols.size() == 12);
+        static_assert(parseClientHello(std::span(SAMPLE_CLIENT_HELLO).first(60)).status == ClientHelloResult::Status::Incomplete);
+        static_assert(parseClientHello(std::span(SAMPLE_CLIENT_HELLO).subspan(1)).status == ClientHelloResult::Status::Invalid);
+    }
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_TLSINSPECTOR_H_ */
@@ -0,0 +1,96 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "Tunnel.h"
+
+using namespace ai;
+
+auto vpn::writeToTunnel(int const tunFd, std::span<uint8_t const> const packet) -> bool {
+    auto dataWrittenInBytes = ssize_t{0};
+    do {
+        dataWrittenInBytes = write(tunFd, packet.data(), packet.size());
+    } while (dataWrittenInBytes < 0 && errno == EINTR);
+    if (dataWrittenInBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOGW("writeToTunnel unable to write, %s", strerror(errno));
+    }
+    return dataWrittenInBytes == static_cast<ssize_t>(packet.size());
+}
+
+vpn::TunnelQueue::TunnelQueue(PacketPool &packetPool, size_t const capacity, int const wakeFd, PacketSummaryRing *const summaries,
+                              OverflowGuard *const overflow)
+        : packetPool_(packetPool), packets_(capacity), wakeFd_(wakeFd), summaries_(summaries), overflow_(overflow) {
+}
+
+auto vpn::TunnelQueue::write(std::span<uint8_t const> const packet, int32_t const uid) -> bool {
+    auto buffer = packetPool_.acquire();
+    if (!buffer || packet.size() > buffer.capacity()) {
+        return false;
+    }
+    std::copy(packet.begin(), packet.end(), buffer.data());
+    buffer.setSize(packet.size());
+    buffer.setTimestamp(receivedAt_);
+    //
+    // A writer blocked on is woken first, as it may not have been yet.
+    //
+    auto wait = [this, bounded = BoundedWait()]() mutable {
+        flush();
+        return bounded();
+    };
+    if (overflow_ != nullptr ? !overflow_->push(packets_, buffer, wait) : !packets_.tryPush(std::move(buffer))) {
+        return false;
+    }
+    if (summaries_ != nullptr) {
+        summaries_->publish(packet, PacketSummaryRing::TO_APP, uid);
+    }
+
+    //
+    // Bursts are handed over before they fill the queue.
+    //
+    if (++unflushed_ >= packets_.capacity() / 4) {
+        flush();
+    }
+    return true;
+}
+
+auto vpn::TunnelQueue::flush() -> void {
+    if (unflushed_ == 0) {
+        return;
+    }
+    auto const count = uint64_t{1};
+    if (::write(wakeFd_, &count, sizeof(count)) != sizeof(count)) {
+        LOGW("flush unable to signal writer, %s", strerror(errno));
+    }
+    unflushed_ = 0;
+}
+
+auto vpn::TunnelQueue::popBatch(std::span<PacketBuffer> const packets) -> size_t {
+    return packets_.popBatch(packets);
+}
+
@@ -0,0 +1,103 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_TUNNEL_H_
+#define ANDROID_INTROSPECTION_VPN_TUNNEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "utils/ring_buffer.h"
+#include "OverflowPolicy.h"
+#include "PacketPool.h"
+#include "PacketSummaryRing.h"
+
+namespace ai::vpn {
+
+    //
+    // Writes a packet to the non-blocking tunnel and returns whether it was
+    // taken; a full tunnel drops it, which is left to the caller to recover
+    // from.
+    //
+    auto writeToTunnel(int tunFd, std::span<uint8_t const> packet) -> bool;
+
+    //
+    // Packets a worker writes to the tunnel, copied into buffers of the pool
+    // and queued for the thread writing the tunnel, which is woken through an
+    // eventfd shared by every worker.  The worker is the only producer and
+    // the writer the only consumer.  Packets queued are summarized in the
+    // ring of summaries, if there is one.
+    //
+    class TunnelQueue final {
+
+        PacketPool &packetPool_;
+
+        utils::SpscRingBuffer<PacketBuffer> packets_;
+
+        int const wakeFd_;
+
+        PacketSummaryRing *const summaries_;
+
+        OverflowGuard *const overflow_;
+
+        size_t unflushed_ = 0;
+
+        uint64_t receivedAt_ = 0;
+
+    public:
+        //
+        // A full queue does what the overflow policy of the guard has it,
+        // blocking in a BoundedWait, or drops the packet if there is none.
+        //
+        TunnelQueue(PacketPool &packetPool, size_t capacity, int wakeFd, PacketSummaryRing *summaries = nullptr, OverflowGuard *overflow = nullptr);
+
+        //
+        // Queues the packet of a flow of the app with the uid and returns
+        // whether it was taken; like a full tunnel, running out of buffers or
+        // room drops it.
+        //
+        auto write(std::span<uint8_t const> packet, int32_t uid = UNKNOWN_UID) -> bool;
+
+        //
+        // getLatencyTime() of when what is written next came from upstream,
+        // which packets are stamped with for the writer to time; 0 for
+        // packets that did not.
+        //
+        auto setReceivedAt(uint64_t const receivedAt) -> void { receivedAt_ = receivedAt; }
+
+        //
+        // Wakes the writer for packets queued since the last flush, which
+        // workers do once per turn of their loop.
+        //
+        auto flush() -> void;
+
+        //
+        // Moves the oldest packets queued into packets and returns how many
+        // it moved.  Writer only.
+        //
+        auto popBatch(std::span<PacketBuffer> packets) -> size_t;
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_TUNNEL_H_ */
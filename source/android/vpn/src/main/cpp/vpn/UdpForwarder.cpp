@@ -0,0 +1,190 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+
+#include "utils/log.h"
+#include "utils/trace.h"
+#include "UdpForwarder.h"
+
+using namespace ai;
+
+namespace {
+
+    constexpr uint32_t SESSION_ID_BIT = 1U << 31U;
+
+    //
+    // Long enough for QUIC connections between keep-alives.
+    //
+    constexpr uint64_t IDLE_TIMEOUT = 60 * 1000;
+
+    auto makeToken(uint32_t const id, int const socket) -> uint64_t {
+        return static_cast<uint64_t>(id) << 32U | static_cast<uint32_t>(socket);
+    }
+}
+
+struct vpn::UdpForwarder::Session {
+
+    Flow *flow = nullptr;
+
+    FlowKey key;
+
+    int socket = -1;
+
+    uint32_t id = 0;
+
+    TimerWheel::Timer idleTimer;
+
+    explicit Session(std::function<void()> onIdle) : idleTimer(std::move(onIdle)) {}
+};
+
+vpn::UdpForwarder::UdpForwarder(TunnelQueue &tunnel, int const epollFd, TimerWheel &timers, SocketCallback onSocketCreated,
+                                SocketCallback onSocketDestroyed)
+        : tunnel_(tunnel), epollFd_(epollFd), timers_(timers), onSocketCreated_(std::move(onSocketCreated)),
+          onSocketDestroyed_(std::move(onSocketDestroyed)) {
+}
+
+vpn::UdpForwarder::~UdpForwarder() {
+    for (auto &[socket, session] : sessions_) {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+        onSocketDestroyed_(socket);
+        close(socket);
+        session->flow->socket = -1;
+    }
+}
+
+auto vpn::UdpForwarder::handleDatagram(UdpHeader const &udpHeader, Flow &flow, uint64_t const now) -> void {
+    TRACE_SPAN("UdpForwarder::handleDatagram");
+    auto const it = flow.socket >= 0 ? sessions_.find(flow.socket) : sessions_.end();
+    auto *const session = it != sessions_.end() ? it->second.get() : openSession(flow);
+    if (session == nullptr) {
+        return;
+    }
+    timers_.schedule(session->idleTimer, now + IDLE_TIMEOUT);
+
+    auto const payload = udpHeader.payload();
+    if (send(session->socket, payload.data(), payload.size(), MSG_DONTWAIT | MSG_NOSIGNAL) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOGD("handleDatagram unable to send on socket [%d], %s", session->socket, strerror(errno));
+    }
+}
+
+auto vpn::UdpForwarder::handleSocketEvent(uint64_t const token, uint32_t const events, uint64_t const now) -> bool {
+    auto const id = static_cast<uint32_t>(token >> 32U);
+    if ((id & SESSION_ID_BIT) == 0) {
+        return false;
+    }
+    TRACE_SPAN("UdpForwarder::handleSocketEvent");
+    auto const it = sessions_.find(static_cast<int>(static_cast<uint32_t>(token)));
+    if (it != sessions_.end() && it->second->id == id && (events & (EPOLLIN | EPOLLERR)) != 0) {
+        readUpstream(*it->second, now);
+    }
+    return true;
+}
+
+auto vpn::UdpForwarder::abort(Flow &flow) -> void {
+    if (flow.socket >= 0 && sessions_.contains(flow.socket)) {
+        closeSession(flow.socket);
+    }
+}
+
+auto vpn::UdpForwarder::openSession(Flow &flow) -> Session * {
+    auto const socketFd = socket(flow.key.destinationAddress.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socketFd < 0) {
+        LOGW("openSession unable to create socket, %s", strerror(errno));
+        return nullptr;
+    }
+    onSocketCreated_(socketFd);
+
+    auto session = std::make_unique<Session>([this, socketFd] { closeSession(socketFd); });
+    session->flow = &flow;
+    session->key = flow.key;
+    session->socket = socketFd;
+    session->id = nextSessionId_++ | SESSION_ID_BIT;
+
+    auto const address = SocketAddress(flow.key.destinationAddress, flow.key.destinationPort);
+    auto event = epoll_event{EPOLLIN, {.u64 = makeToken(session->id, socketFd)}};
+    if (connect(socketFd, address.get(), address.length) < 0 ||
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, socketFd, &event) < 0) {
+        LOGD("openSession unable to connect socket [%d], %s", socketFd, strerror(errno));
+        onSocketDestroyed_(socketFd);
+        close(socketFd);
+        return nullptr;
+    }
+    flow.socket = socketFd;
+    return sessions_.emplace(socketFd, std::move(session)).first->second.get();
+}
+
+auto vpn::UdpForwarder::closeSession(int const socket) -> void {
+    auto const it = sessions_.find(socket);
+    if (it == sessions_.end()) {
+        return;
+    }
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+    onSocketDestroyed_(socket);
+    close(socket);
+    it->second->flow->socket = -1;
+    sessions_.erase(it);
+}
+
+//
+// Writes every datagram waiting on the socket to the app as an IP packet
+// from the destination of the flow.  Datagrams too large for the tunnel are
+// dropped, as fragmenting them is left to the network.
+//
+auto vpn::UdpForwarder::readUpstream(Session &session, uint64_t const now) -> void {
+    auto const headersSize = ipHeaderSize(session.key.destinationAddress) + UdpHeader::SIZE;
+    auto const payload = std::span(datagram_).subspan(headersSize);
+    while (true) {
+        auto const dataReadInBytes = recv(session.socket, payload.data(), payload.size(), MSG_DONTWAIT | MSG_TRUNC);
+        if (dataReadInBytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOGD("readUpstream unable to read socket [%d], %s", session.socket, strerror(errno));
+            }
+            break;
+        }
+        if (static_cast<size_t>(dataReadInBytes) > payload.size()) {
+            LOGD("readUpstream dropping datagram of %zd bytes from socket [%d]", dataReadInBytes, session.socket);
+            continue;
+        }
+
+        auto const packet = std::span(datagram_).first(headersSize + static_cast<size_t>(dataReadInBytes));
+        writeIpHeader(packet, IpProtocol::Udp, session.key.destinationAddress, session.key.sourceAddress, nextPacketId_++);
+        writeUdpHeader(packet, session.key.destinationPort, session.key.sourcePort);
+        if (tunnel_.write(packet, session.flow->uid)) {
+            session.flow->receivedPackets++;
+            session.flow->receivedBytes += packet.size();
+        }
+    }
+    session.flow->lastActive = now;
+    timers_.schedule(session.idleTimer, now + IDLE_TIMEOUT);
+}
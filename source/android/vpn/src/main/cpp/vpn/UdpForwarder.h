@@ -0,0 +1,114 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_VPN_UDPFORWARDER_H_
+#define ANDROID_INTROSPECTION_VPN_UDPFORWARDER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include "FlowTable.h"
+#include "PacketHeaders.h"
+#include "PacketPool.h"
+#include "TcpForwarder.h"
+#include "TimerWheel.h"
+#include "Tunnel.h"
+
+namespace ai::vpn {
+
+    //
+    // Relays the UDP flows of the tunnel, e.g. DNS and QUIC: the first
+    // datagram of a flow opens a socket connected to its destination, which
+    // every later datagram of the flow, both ways, goes through until the
+    // flow is idle for a while.  Datagrams the socket cannot take right away
+    // are dropped, as the network would.
+    //
+    // Like TcpForwarder it runs on the packet loop, with its sockets in the
+    // loop's epoll set and its idle timers on the loop's wheel.
+    //
+    class UdpForwarder final {
+
+        struct Session;
+
+        TunnelQueue &tunnel_;
+
+        int const epollFd_;
+
+        TimerWheel &timers_;
+
+        SocketCallback onSocketCreated_;
+
+        SocketCallback onSocketDestroyed_;
+
+        std::unordered_map<int, std::unique_ptr<Session>> sessions_;
+
+        //
+        // Ids of sessions for their epoll tokens, with the top bit set so
+        // that they never match those of TcpForwarder.
+        //
+        uint32_t nextSessionId_ = 0;
+
+        uint16_t nextPacketId_ = 0;
+
+        std::array<uint8_t, PACKET_SIZE> datagram_{};
+
+        auto openSession(Flow &flow) -> Session *;
+
+        auto closeSession(int socket) -> void;
+
+        auto readUpstream(Session &session, uint64_t now) -> void;
+
+    public:
+        UdpForwarder(TunnelQueue &tunnel, int epollFd, TimerWheel &timers, SocketCallback onSocketCreated, SocketCallback onSocketDestroyed);
+
+        UdpForwarder(UdpForwarder const &) = delete;
+
+        auto operator=(UdpForwarder const &) -> UdpForwarder & = delete;
+
+        ~UdpForwarder();
+
+        //
+        // A datagram the app sent into the tunnel, with the flow it belongs to.
+        //
+        auto handleDatagram(UdpHeader const &udpHeader, Flow &flow, uint64_t now) -> void;
+
+        //
+        // Events of epoll for a token, false if it is not one of a session of
+        // this forwarder.
+        //
+        auto handleSocketEvent(uint64_t token, uint32_t events, uint64_t now) -> bool;
+
+        //
+        // Closes the session of the flow, if it has one, e.g. when the flow
+        // is expired.  The flow itself is left to the caller.
+        //
+        auto abort(Flow &flow) -> void;
+
+        auto sessionCount() const -> size_t { return sessions_.size(); }
+    };
+}
+
+#endif /* ANDROID_INTROSPECTION_VPN_UDPFORWARDER_H_ */
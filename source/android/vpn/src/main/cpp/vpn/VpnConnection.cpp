@@ -21,95 +21,877 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
-#include <arpa/inet.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
 #include <cstddef>
-#include <pcapplusplus/Packet.h>
-#include <pcapplusplus/IPv4Layer.h>
-#include <pcapplusplus/TcpLayer.h>
-#include <pcapplusplus/UdpLayer.h>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <poll.h>
+#include <span>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <unistd.h>
 
 #include "utils/log.h"
+#include "utils/ring_buffer.h"
+#include "utils/trace.h"
+#include "DnsInterceptor.h"
+#include "FlowAttribution.h"
+#include "FlowTable.h"
+#include "HttpParser.h"
+#include "LatencyHistogram.h"
+#include "PacketCapture.h"
+#include "PacketFilter.h"
+#include "PacketHeaders.h"
+#include "PacketProcessor.h"
+#include "PacketSummaryRing.h"
+#include "StatsReporter.h"
+#include "StreamReassembler.h"
+#include "TcpForwarder.h"
+#include "TlsInspector.h"
+#include "ThreadTuner.h"
+#include "TimerWheel.h"
+#include "Tunnel.h"
+#include "UdpForwarder.h"
 #include "VpnConnection.h"
 
 using namespace ai;
 
 namespace {
 
-    constexpr auto BUFFER_SIZE = 16 * 1024;
+    //
+    // Most packets read off the tunnel before they are processed together.
+    //
+    constexpr auto BATCH_SIZE = 64;
 
-    auto getCurrentTime() {
-        struct timeval tp{};
-        gettimeofday(&tp, nullptr);
-        return tp;
+    //
+    // Most workers processing packets, each with a shard of the flows and
+    // sessions of its own.  Flows are dispatched by hash, so that the packets
+    // of a flow stay in order while a burst spreads over several cores.
+    //
+    constexpr size_t MAX_WORKERS = 4;
+
+    //
+    // Packets on their way from the reader to a worker, and from a worker to
+    // the writer.
+    //
+    constexpr size_t WORKER_QUEUE_SIZE = 128;
+
+    constexpr size_t TUNNEL_QUEUE_SIZE = 128;
+
+    constexpr size_t MAX_FLOWS = 100'000;
+
+    //
+    // Packets on their way to the capture file, about a second of a busy
+    // tunnel.
+    //
+    constexpr size_t CAPTURE_QUEUE_SIZE = 4096;
+
+    //
+    // Packets summarized for the UI before the oldest are overwritten, a
+    // second or so of a busy tunnel.
+    //
+    constexpr size_t SUMMARY_RING_SIZE = 8192;
+
+    //
+    // New flows waiting for their owner to be looked up, and owners waiting
+    // for their worker.
+    //
+    constexpr size_t ATTRIBUTION_QUEUE_SIZE = 256;
+
+    //
+    // Flows of a worker with traffic a report carries at most; the others
+    // are left for the next one.
+    //
+    constexpr size_t STATS_QUEUE_SIZE = 256;
+
+    //
+    // Resolution of the timers of the packet loop, in milliseconds.
+    //
+    constexpr uint64_t TIMER_TICK = 100;
+
+    //
+    // Most events taken from epoll in one wait.
+    //
+    constexpr auto EPOLL_EVENTS = 64;
+
+    //
+    // Packets per batch, averaged over the last few in eighths, from which
+    // the reader takes the tunnel to be busy and coalesces its batches.
+    //
+    constexpr uint64_t BUSY_BATCH_SIZE = 4;
+
+    constexpr uint64_t BATCH_AVERAGE_SHIFT = 3;
+
+    std::atomic_uint64_t gBatchSize{0};
+
+    std::atomic_uint64_t gCoalescedBatches{0};
+
+    std::atomic_uint64_t gExpiredBatches{0};
+
+    auto getMonotonicTime() -> uint64_t {
+        auto const now = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
     }
 
-    auto processDataBuffer(uint8_t const *dataBytes, size_t dataLength) {
-        auto rawPacket = pcpp::RawPacket(dataBytes, dataLength, getCurrentTime(), false, pcpp::LINKTYPE_IPV4);
-        auto packet = pcpp::Packet(&rawPacket);
-        if (packet.isPacketOfType(pcpp::IPv4)) {
-            auto const ipv4Packet = packet.getLayerOfType<pcpp::IPv4Layer>();
-            auto const sourceIP = ipv4Packet->getSrcIpAddress();
-            auto const destinationIP = ipv4Packet->getDstIpAddress();
+    //
+    // Names a cleartext flow by the host of its requests, unless its
+    // ClientHello named it already.
+    //
+    auto nameFlow(vpn::FlowNames &names, vpn::HttpRequest const &request) -> void {
+        LOGD("nameFlow %s [%s] on [%s], user agent [%s]", request.method.c_str(), request.path.c_str(), request.host.c_str(),
+             request.userAgent.c_str());
+        if (names.serverName.empty()) {
+            names.serverName = request.host;
+        }
+        if (names.protocols.empty()) {
+            names.protocols = "http/1.1";
+        }
+    }
+
+    //
+    // Packets moved through the pipeline together; the vector keeps its
+    // capacity, so that batches do not allocate.
+    //
+    struct PacketBatch {
+
+        std::vector<vpn::PacketBuffer> packets;
+
+        PacketBatch() {
+            packets.reserve(BATCH_SIZE);
+        }
+    };
+
+    auto getWorkerCount() -> size_t {
+        return std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, MAX_WORKERS);
+    }
+
+    //
+    // Buffers for a batch being read and for every queue of the pipeline to
+    // be full, with a batch being processed by each worker, and for the
+    // segments held for reassembly.
+    //
+    auto getPacketPoolSize(size_t const workerCount) -> size_t {
+        return BATCH_SIZE + workerCount * (WORKER_QUEUE_SIZE + BATCH_SIZE + TUNNEL_QUEUE_SIZE) + vpn::StreamReassembler::MAX_HELD_SEGMENTS;
+    }
+
+    auto signalEventFd(int const eventFd) -> void {
+        auto const count = uint64_t{1};
+        if (write(eventFd, &count, sizeof(count)) != sizeof(count)) {
+            LOGE("signalEventFd unable to signal eventfd, %s", strerror(errno));
+        }
+    }
+
+    //
+    // Waits up to timeout milliseconds for a stop to be requested.
+    //
+    auto waitForStop(int const stopFd, int const timeout) -> bool {
+        auto stop = pollfd{stopFd, POLLIN, 0};
+        return poll(&stop, 1, timeout) > 0;
+    }
+
+    //
+    // Waits up to the nanoseconds for the tunnel to be readable, false if it
+    // did not get readable in time or a stop was requested.
+    //
+    auto waitForPackets(int const fd, int const stopFd, uint64_t const timeout, bool &stopped) -> bool {
+        auto fds = std::array<pollfd, 2>{pollfd{fd, POLLIN, 0}, pollfd{stopFd, POLLIN, 0}};
+        auto const time = timespec{static_cast<time_t>(timeout / 1'000'000'000), static_cast<long>(timeout % 1'000'000'000)};
+        if (ppoll(fds.data(), fds.size(), &time, nullptr) <= 0) {
+            return false;
+        }
+        stopped = (fds[1].revents & POLLIN) != 0;
+        return !stopped && (fds[0].revents & POLLIN) != 0;
+    }
+
+    auto clearEventFd(int const eventFd) -> void {
+        auto count = uint64_t{0};
+        while (read(eventFd, &count, sizeof(count)) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+//
+// Threads of a connection and the queues between them: the reader hands
+// the packets of the tunnel to the worker of their flow, workers process
+// them and queue what they write to the tunnel for the writer.
+//
+struct vpn::PacketPipeline {
+
+    struct Worker {
+
+        utils::SpscRingBuffer<PacketBuffer> packets;
 
-            if (packet.isPacketOfType(pcpp::TCP)) {
-                auto const tcpPacket = packet.getLayerOfType<pcpp::TcpLayer>();
-                auto const sourcePort = static_cast<uint16_t>(ntohs(tcpPacket->getTcpHeader()->portSrc));
-                auto const destinationPort = static_cast<uint16_t>(ntohs(tcpPacket->getTcpHeader()->portDst));
+        //
+        // eventfd the reader signals once per batch it queued packets from.
+        //
+        int const wakeFd;
 
-                LOGD("processDataBuffer processing tcp packet: sourceIP [%s], sourcePort [%hu], destinationIP [%s], destinationPort [%hu]",
-                     sourceIP.toString().c_str(), sourcePort, destinationIP.toString().c_str(), destinationPort);
+        TunnelQueue tunnel;
 
-            } else if (packet.isPacketOfType(pcpp::UDP)) {
-                auto const udpPacket = packet.getLayerOfType<pcpp::UdpLayer>();
-                auto const sourcePort = static_cast<uint16_t>(ntohs(udpPacket->getUdpHeader()->portSrc));
-                auto const destinationPort = static_cast<uint16_t>(ntohs(udpPacket->getUdpHeader()->portDst));
+        //
+        // From the read of a packet off the tunnel to the worker taking it
+        // from its queue, and from there to its processor being done with
+        // it.  This worker only records them.
+        //
+        LatencyHistogram queued;
 
-                LOGD("processDataBuffer processing udp packet: sourceIP [%s], sourcePort [%hu], destinationIP [%s], destinationPort [%hu]",
-                     sourceIP.toString().c_str(), sourcePort, destinationIP.toString().c_str(), destinationPort);
+        LatencyHistogram processed;
 
-            } else {
-                LOGD("processDataBuffer processing unknown packet:  sourceIP [%s], destinationIP [%s]",
-                     sourceIP.toString().c_str(), destinationIP.toString().c_str());
+        std::thread thread;
+
+        Worker(PacketPool &packetPool, int const writerWakeFd, PacketSummaryRing &summaries, OverflowGuard &tunnelOverflow)
+                : packets(WORKER_QUEUE_SIZE), wakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+                  tunnel(packetPool, TUNNEL_QUEUE_SIZE, writerWakeFd, &summaries, &tunnelOverflow) {
+        }
+
+        Worker(Worker const &) = delete;
+
+        auto operator=(Worker const &) -> Worker & = delete;
+
+        ~Worker() {
+            if (wakeFd >= 0) {
+                close(wakeFd);
             }
         }
+    };
+
+    //
+    // eventfd every worker signals when it queued packets for the writer.
+    //
+    int const writerWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    HostnameTable hostnames;
+
+    //
+    // Given every packet read from and written to the tunnel, but for those
+    // the sampler skips.
+    //
+    PacketCapture &capture;
+
+    //
+    // Given a summary of every packet the workers handle, both ways.
+    //
+    PacketSummaryRing &summaries;
+
+    //
+    // Given every flow the workers drop, and every active one at its
+    // interval.
+    //
+    FlowLog &flowLog;
+
+    SharedPacketFilter const &inspectionFilter;
+
+    //
+    // Adapted by the reader to the CPU time of the process.
+    //
+    InspectionSampler &sampler;
+
+    //
+    // Places the reader and the writer on cores as the policy has it.
+    //
+    ThreadTuner &tuner;
+
+    //
+    // What the reader does with a packet whose worker has a full queue.
+    //
+    OverflowGuard &dispatchOverflow;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    //
+    // From a worker waking up to data from upstream to the writer writing
+    // what it queued to the tunnel.  The writer only records it.
+    //
+    LatencyHistogram written;
+
+    std::unique_ptr<FlowAttributor> attributor;
+
+    std::unique_ptr<StatsReporter> reporter;
+
+    //
+    // Most packets the reader dispatches together and microseconds it holds
+    // the first of them for more once the tunnel is busy; set by any thread.
+    //
+    std::atomic_size_t maxBatchPackets{BATCH_SIZE};
+
+    std::atomic_uint64_t maxBatchDelay{0};
+
+    std::thread reader;
+
+    std::thread writer;
+
+    std::thread attribution;
+
+    std::thread reporting;
+
+    PacketPipeline(PacketPool &packetPool, PacketCapture &packetCapture, PacketSummaryRing &packetSummaries, FlowLog &packetFlowLog,
+                   SharedPacketFilter const &packetInspectionFilter, InspectionSampler &inspectionSampler, ThreadTuner &threadTuner,
+                   OverflowGuard &workerOverflow, OverflowGuard &tunnelOverflow, OwnerLookup const &ownerLookup, StatsCallback const &onStats,
+                   uint64_t const statsInterval, size_t const workerCount)
+            : capture(packetCapture), summaries(packetSummaries), flowLog(packetFlowLog), inspectionFilter(packetInspectionFilter),
+              sampler(inspectionSampler), tuner(threadTuner), dispatchOverflow(workerOverflow) {
+        workers.reserve(workerCount);
+        auto workerWakeFds = std::vector<int>();
+        for (size_t index = 0; index < workerCount; index++) {
+            workerWakeFds.push_back(workers.emplace_back(std::make_unique<Worker>(packetPool, writerWakeFd, summaries, tunnelOverflow))->wakeFd);
+        }
+        attributor = std::make_unique<FlowAttributor>(ownerLookup, workerWakeFds, ATTRIBUTION_QUEUE_SIZE);
+        auto latencySources = std::vector<LatencySource>{{"tunnel.queued", {}}, {"packet.processed", {}}, {"upstream.written", {&written}}};
+        for (auto const &worker : workers) {
+            latencySources[0].histograms.push_back(&worker->queued);
+            latencySources[1].histograms.push_back(&worker->processed);
+        }
+        reporter = std::make_unique<StatsReporter>(onStats, statsInterval, std::move(workerWakeFds), STATS_QUEUE_SIZE, std::move(latencySources));
     }
 
-    auto processFileDescriptor(int const fd, std::atomic_bool *stopThread_) -> void {
-        LOGI("processFileDescriptor start");
+    PacketPipeline(PacketPipeline const &) = delete;
 
-        auto buffer = std::vector<std::uint8_t>(BUFFER_SIZE);
-        int dataReadInBytes;
-        while (true) {
-            if (*stopThread_) {
-                LOGI("processFileDescriptor stop thread requested");
-                break;
+    auto operator=(PacketPipeline const &) -> PacketPipeline & = delete;
+
+    ~PacketPipeline() {
+        if (writerWakeFd >= 0) {
+            close(writerWakeFd);
+        }
+    }
+
+    auto isValid() const -> bool {
+        return writerWakeFd >= 0 && attributor->isValid() && reporter->isValid() && std::ranges::all_of(workers, [](auto const &worker) { return worker->wakeFd >= 0; });
+    }
+};
+
+namespace {
+
+    auto addToEpoll(int const epollFd, int const fd) -> bool {
+        auto event = epoll_event{EPOLLIN, {.u64 = static_cast<uint32_t>(fd)}};
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    //
+    // Epoll set watching every descriptor for reading, -1 if it could not
+    // be set up.
+    //
+    auto createEpoll(std::initializer_list<int> const fds) -> int {
+        auto const epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0 || !std::ranges::all_of(fds, [epollFd](auto const fd) { return addToEpoll(epollFd, fd); })) {
+            LOGE("createEpoll unable to set up epoll, %s", strerror(errno));
+            if (epollFd >= 0) {
+                close(epollFd);
             }
-            dataReadInBytes = read(fd, buffer.data(), BUFFER_SIZE);
+            return -1;
+        }
+        return epollFd;
+    }
+
+    //
+    // Reads packets into the batch until it holds maxPackets or the tunnel
+    // would block, and returns whether it was drained.  Running out of
+    // buffers ends the batch early, leaving the rest in the tunnel until
+    // buffers are given back.  Packets are stamped with the time of their
+    // read.
+    //
+    auto readBatch(int const fd, vpn::PacketPool &packetPool, PacketBatch &batch, size_t const maxPackets) -> bool {
+        TRACE_SPAN("VpnConnection::readBatch");
+        while (batch.packets.size() < maxPackets) {
+            auto packet = packetPool.acquire();
+            if (!packet) {
+                LOGW("readBatch out of packet buffers");
+                return true;
+            }
+            auto dataReadInBytes = ssize_t{0};
+            do {
+                dataReadInBytes = read(fd, packet.data(), packet.capacity());
+            } while (dataReadInBytes < 0 && errno == EINTR);
             if (dataReadInBytes < 1) {
-                sleep(1);
-                continue;
+                if (dataReadInBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    LOGW("readBatch unable to read, %s", strerror(errno));
+                }
+                return true;
+            }
+            packet.setSize(static_cast<size_t>(dataReadInBytes));
+            packet.setTimestamp(vpn::getLatencyTime());
+            batch.packets.push_back(std::move(packet));
+        }
+        return false;
+    }
+
+    //
+    // Worker of a packet: that of the shard of its flow, but the first one
+    // for DNS queries, so that they share one cache, and for packets that
+    // are not IP, which it drops.  Keys are made as PacketProcessor makes
+    // them.
+    //
+    auto getWorkerIndex(vpn::FlowTable const &flowTable, vpn::PacketBuffer const &packet) -> size_t {
+        auto const ipHeader = vpn::IpHeader::parse(std::span<uint8_t const>(packet.data(), packet.size()));
+        if (!ipHeader) {
+            return 0;
+        }
+        auto key = vpn::FlowKey{ipHeader->sourceAddress(), ipHeader->destinationAddress(), 0, 0, ipHeader->protocol()};
+        if (auto const tcpHeader = vpn::TcpHeader::parse(*ipHeader)) {
+            key.sourcePort = tcpHeader->sourcePort();
+            key.destinationPort = tcpHeader->destinationPort();
+        } else if (auto const udpHeader = vpn::UdpHeader::parse(*ipHeader)) {
+            if (udpHeader->destinationPort() == vpn::DNS_PORT) {
+                return 0;
+            }
+            key.sourcePort = udpHeader->sourcePort();
+            key.destinationPort = udpHeader->destinationPort();
+        }
+        return flowTable.shardIndex(key);
+    }
+
+    //
+    // Queues every packet of the batch for its worker and wakes each worker
+    // that got any once.  A worker whose queue is full is dealt with as the
+    // overflow policy has it; blocking wakes it and waits for it, which
+    // leaves the packets behind in the tunnel instead of dropping them.
+    // Returns false if a stop was requested meanwhile.
+    //
+    auto dispatchBatch(PacketBatch &batch, vpn::FlowTable const &flowTable, vpn::PacketPipeline &pipeline, int const stopFd) -> bool {
+        TRACE_SPAN("VpnConnection::dispatchBatch");
+        auto woken = uint32_t{0};
+        auto const wakeWorkers = [&pipeline, &woken]() {
+            for (size_t index = 0; index < pipeline.workers.size(); index++) {
+                if ((woken & (1U << index)) != 0) {
+                    signalEventFd(pipeline.workers[index]->wakeFd);
+                }
+            }
+            woken = 0;
+        };
+        auto stopped = false;
+        for (auto &packet : batch.packets) {
+            auto const index = getWorkerIndex(flowTable, packet);
+            auto const wait = [&]() {
+                LOGD("dispatchBatch queue of worker %zu full, waiting", index);
+                woken |= 1U << index;
+                wakeWorkers();
+                stopped = waitForStop(stopFd, 1);
+                return !stopped;
+            };
+            if (pipeline.dispatchOverflow.push(pipeline.workers[index]->packets, packet, wait)) {
+                woken |= 1U << index;
+            } else if (stopped) {
+                return false;
+            }
+        }
+        wakeWorkers();
+        return true;
+    }
+
+    //
+    // Drains the tunnel on every wake up, in batches, so that a burst costs
+    // one wait.  Once the buffers run out it waits for workers to give some
+    // back rather than spinning on a tunnel that is still readable.
+    //
+    // While batches average BUSY_BATCH_SIZE packets or more, one the tunnel
+    // ran dry before it filled is held until it does or the first of its
+    // packets waited maxBatchDelay, so that the workers wake up once for
+    // the lot of a busy tunnel.  A tunnel that is nearly idle has
+    // its packets dispatched as they come.
+    //
+    auto readTunnel(int const fd, int const stopFd, vpn::PacketPool *const packetPool, vpn::FlowTable const *const flowTable,
+                    vpn::PacketPipeline *const pipeline) -> void {
+        LOGI("readTunnel start");
+        auto const epollFd = createEpoll({fd, stopFd});
+        if (epollFd < 0) {
+            return;
+        }
+
+        pipeline->tuner.attach();
+        auto batch = PacketBatch();
+        auto sampledFlows = vpn::SampledFlows();
+        auto events = std::array<epoll_event, 2>{};
+        auto averageBatchSize = uint64_t{0};
+        auto running = true;
+        while (running) {
+            auto const eventCount = epoll_wait(epollFd, events.data(), events.size(), -1);
+            if (eventCount < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOGE("readTunnel unable to wait, %s", strerror(errno));
+                break;
+            }
+            for (auto const &event : std::span(events).first(static_cast<size_t>(eventCount))) {
+                if (event.data.u64 == static_cast<uint32_t>(stopFd)) {
+                    LOGI("readTunnel stop thread requested");
+                    running = false;
+                } else if ((event.events & (EPOLLERR | EPOLLHUP)) != 0) {
+                    LOGW("readTunnel tunnel closed");
+                    running = false;
+                } else {
+                    auto drained = false;
+                    auto batchStart = uint64_t{0};
+                    while (!drained && running) {
+                        auto const maxPackets = pipeline->maxBatchPackets.load(std::memory_order_relaxed);
+                        auto const read = batch.packets.size();
+                        drained = readBatch(fd, *packetPool, batch, maxPackets);
+                        auto const readAt = getMonotonicTime();
+                        pipeline->tuner.onPackets(batch.packets.size() - read, readAt);
+                        pipeline->sampler.update(readAt);
+                        if (batch.packets.empty()) {
+                            continue;
+                        }
+                        auto const maxDelay = pipeline->maxBatchDelay.load(std::memory_order_relaxed) * 1000;
+                        if (drained && batch.packets.size() < maxPackets && maxDelay != 0 && averageBatchSize >= BUSY_BATCH_SIZE << BATCH_AVERAGE_SHIFT &&
+                            packetPool->available() != 0) {
+                            auto const now = vpn::getLatencyTime();
+                            batchStart = batchStart != 0 ? batchStart : now;
+                            auto stopped = false;
+                            if (now - batchStart < maxDelay && waitForPackets(fd, stopFd, maxDelay - (now - batchStart), stopped)) {
+                                drained = false;
+                                continue;
+                            }
+                            running = !stopped;
+                            gExpiredBatches.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        if (batchStart != 0) {
+                            gCoalescedBatches.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        averageBatchSize += batch.packets.size() - (averageBatchSize >> BATCH_AVERAGE_SHIFT);
+                        gBatchSize.store(averageBatchSize >> BATCH_AVERAGE_SHIFT, std::memory_order_relaxed);
+                        if (pipeline->capture.isEnabled()) {
+                            for (auto const &packet : batch.packets) {
+                                auto const data = std::span<uint8_t const>(packet.data(), packet.size());
+                                if (sampledFlows.shouldInspect(pipeline->sampler, data)) {
+                                    pipeline->capture.capture(data);
+                                }
+                            }
+                        }
+                        running = running && dispatchBatch(batch, *flowTable, *pipeline, stopFd);
+                        batch.packets.clear();
+                        batchStart = 0;
+                    }
+                    if (running && packetPool->available() == 0) {
+                        running = !waitForStop(stopFd, 1);
+                    }
+                }
             }
-            processDataBuffer(buffer.data(), dataReadInBytes);
         }
+        pipeline->tuner.detach();
+        close(epollFd);
+        LOGI("readTunnel finished");
+    }
 
-        LOGI("processFileDescriptor finished");
+    //
+    // Pops up to a batch of packets the reader queued, false if none was.
+    //
+    auto popBatch(utils::SpscRingBuffer<vpn::PacketBuffer> &packets, PacketBatch &batch) -> bool {
+        batch.packets.resize(BATCH_SIZE);
+        batch.packets.resize(packets.popBatch(batch.packets));
+        return !batch.packets.empty();
+    }
+
+    //
+    // Hands every packet of the batch through the pipeline; their buffers
+    // go back to the pool with the next batch, but for those of segments
+    // held for reassembly.  Each packet costs one read of the clock, the
+    // end of one being the start of the next.
+    //
+    auto processBatch(PacketBatch &batch, vpn::PacketProcessor &processor, vpn::PacketPipeline::Worker &worker) -> void {
+        TRACE_SPAN("VpnConnection::processBatch");
+        processor.setTime(getMonotonicTime());
+        auto start = vpn::getLatencyTime();
+        for (auto &packet : batch.packets) {
+            worker.queued.recordSince(packet.timestamp(), start);
+            processor.process(packet);
+            auto const end = vpn::getLatencyTime();
+            worker.processed.record(end - start);
+            start = end;
+        }
+    }
+
+    //
+    // Packet loop of a worker: processes the packets the reader queued for
+    // it and moves the data of its TCP and UDP sessions, whose sockets are
+    // in one epoll set with its wake up eventfd and stopFd.  Waits time out
+    // for the next timer of the wheel, which holds every timeout of the
+    // worker.  Whatever a turn of the loop wrote to the tunnel is handed to
+    // the writer at its end.
+    //
+    auto processPackets(size_t const index, int const stopFd, vpn::FlowTable *const flowTable, vpn::PacketPipeline *const pipeline,
+                        vpn::VpnConnection::SessionListener const *const sessionListener) -> void {
+        LOGI("processPackets start worker %zu", index);
+        auto &worker = *pipeline->workers[index];
+        auto const epollFd = createEpoll({worker.wakeFd, stopFd});
+        if (epollFd < 0) {
+            return;
+        }
+
+        auto &flows = flowTable->shard(index);
+        auto timers = vpn::TimerWheel(TIMER_TICK, getMonotonicTime());
+        auto tcpForwarder = vpn::TcpForwarder(worker.tunnel, epollFd, timers, sessionListener->onSessionCreated, sessionListener->onSessionDestroyed,
+                                              [&flows](vpn::Flow &flow, vpn::HttpRequest const &request) { nameFlow(flows.names(flow), request); },
+                                              &pipeline->sampler, &pipeline->hostnames);
+        auto udpForwarder = vpn::UdpForwarder(worker.tunnel, epollFd, timers, sessionListener->onSessionCreated, sessionListener->onSessionDestroyed);
+        auto dnsInterceptor = std::optional<vpn::DnsInterceptor>();
+        if (index == 0) {
+            dnsInterceptor.emplace(worker.tunnel, epollFd, timers, pipeline->hostnames, sessionListener->onSessionCreated,
+                                   sessionListener->onSessionDestroyed);
+        }
+        auto tlsInspector = vpn::TlsInspector();
+        auto processor = vpn::PacketProcessor(flows, timers, &tcpForwarder, &udpForwarder, dnsInterceptor ? &*dnsInterceptor : nullptr, pipeline->hostnames,
+                                              tlsInspector, pipeline->summaries, pipeline->inspectionFilter, *pipeline->attributor, *pipeline->reporter,
+                                              pipeline->flowLog, index);
+        auto batch = PacketBatch();
+        auto events = std::array<epoll_event, EPOLL_EVENTS>{};
+        auto running = true;
+        while (running) {
+            auto const eventCount = epoll_wait(epollFd, events.data(), events.size(), timers.timeout(getMonotonicTime()));
+            auto const now = getMonotonicTime();
+            auto const wokeAt = vpn::getLatencyTime();
+            if (eventCount < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOGE("processPackets unable to wait, %s", strerror(errno));
+                break;
+            }
+            for (auto const &event : std::span(events).first(static_cast<size_t>(eventCount))) {
+                if (event.data.u64 == static_cast<uint32_t>(stopFd)) {
+                    LOGI("processPackets stop thread requested");
+                    running = false;
+                    break;
+                }
+                if (event.data.u64 == static_cast<uint32_t>(worker.wakeFd)) {
+                    clearEventFd(worker.wakeFd);
+                    while (popBatch(worker.packets, batch)) {
+                        processBatch(batch, processor, worker);
+                    }
+                    processor.applyOwners();
+                    processor.reportStats();
+                } else {
+                    worker.tunnel.setReceivedAt(wokeAt);
+                    if ((!dnsInterceptor || !dnsInterceptor->handleSocketEvent(event.data.u64, event.events, now)) &&
+                        !udpForwarder.handleSocketEvent(event.data.u64, event.events, now)) {
+                        tcpForwarder.handleSocketEvent(event.data.u64, event.events, now);
+                    }
+                    worker.tunnel.setReceivedAt(0);
+                }
+            }
+            timers.advance(getMonotonicTime());
+            processor.logFlows();
+            worker.tunnel.flush();
+        }
+
+        processor.expireFlows();
+        worker.tunnel.flush();
+        close(epollFd);
+        LOGI("processPackets finished worker %zu", index);
+    }
+
+    //
+    // Writes what the workers queued to the tunnel.  The wake up eventfd is
+    // cleared before the queues are drained, so that packets queued after
+    // the drain always wake it again.
+    //
+    auto writeTunnel(int const fd, int const stopFd, vpn::PacketPipeline *const pipeline) -> void {
+        LOGI("writeTunnel start");
+        auto const epollFd = createEpoll({pipeline->writerWakeFd, stopFd});
+        if (epollFd < 0) {
+            return;
+        }
+
+        pipeline->tuner.attach();
+        auto packets = std::array<vpn::PacketBuffer, BATCH_SIZE>{};
+        auto sampledFlows = vpn::SampledFlows();
+        auto events = std::array<epoll_event, 2>{};
+        auto running = true;
+        while (running) {
+            auto const eventCount = epoll_wait(epollFd, events.data(), events.size(), -1);
+            if (eventCount < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOGE("writeTunnel unable to wait, %s", strerror(errno));
+                break;
+            }
+            for (auto const &event : std::span(events).first(static_cast<size_t>(eventCount))) {
+                if (event.data.u64 == static_cast<uint32_t>(stopFd)) {
+                    LOGI("writeTunnel stop thread requested");
+                    running = false;
+                    continue;
+                }
+                TRACE_SPAN("VpnConnection::writeTunnel");
+                clearEventFd(pipeline->writerWakeFd);
+                for (auto const &worker : pipeline->workers) {
+                    for (auto count = worker->tunnel.popBatch(packets); count > 0; count = worker->tunnel.popBatch(packets)) {
+                        for (auto &packet : std::span(packets).first(count)) {
+                            auto const data = std::span<uint8_t const>(packet.data(), packet.size());
+                            if (pipeline->capture.isEnabled() && sampledFlows.shouldInspect(pipeline->sampler, data)) {
+                                pipeline->capture.capture(data);
+                            }
+                            vpn::writeToTunnel(fd, data);
+                            pipeline->written.recordSince(packet.timestamp(), vpn::getLatencyTime());
+                            packet.reset();
+                        }
+                    }
+                }
+            }
+        }
+        pipeline->tuner.detach();
+        close(epollFd);
+        LOGI("writeTunnel finished");
     }
 }
 
-vpn::VpnConnection::VpnConnection(const int fd) : fd_(fd), isDisconnectRequested_(false) {
+vpn::VpnConnection::VpnConnection(const int fd, SessionListener sessionListener, OwnerLookup ownerLookup, StatsCallback onStats)
+        : fd_(fd), sessionListener_(std::move(sessionListener)), ownerLookup_(std::move(ownerLookup)), onStats_(std::move(onStats)), maxBatchPackets_(BATCH_SIZE),
+          stopFd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)), workerCount_(getWorkerCount()),
+          packetPool_(getPacketPoolSize(workerCount_)), flowTable_(workerCount_, MAX_FLOWS / workerCount_), capture_(CAPTURE_QUEUE_SIZE),
+          summaries_(SUMMARY_RING_SIZE) {
+    if (stopFd_ < 0) {
+        LOGE("VpnConnection unable to create stop eventfd, %s", strerror(errno));
+    }
 }
 
 vpn::VpnConnection::~VpnConnection() {
+    if (pipeline_) {
+        disconnect();
+    }
+    if (stopFd_ >= 0) {
+        close(stopFd_);
+    }
     close(fd_);
 }
 
 auto vpn::VpnConnection::connect() -> void {
-    thread_ = std::thread(&processFileDescriptor, fd_, &isDisconnectRequested_);
+    if (auto const flags = fcntl(fd_, F_GETFL); flags < 0 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) < 0) {
+        LOGE("connect unable to make tunnel non-blocking, %s", strerror(errno));
+        return;
+    }
+    auto pipeline = std::make_unique<PacketPipeline>(packetPool_, capture_, summaries_, flowLog_, inspectionFilter_, inspectionSampler_, threadTuner_,
+                                                     workerOverflow_, tunnelOverflow_, ownerLookup_, onStats_, statsInterval_, workerCount_);
+    if (!pipeline->isValid()) {
+        LOGE("connect unable to create eventfds, %s", strerror(errno));
+        return;
+    }
+    pipeline->maxBatchPackets.store(maxBatchPackets_, std::memory_order_relaxed);
+    pipeline->maxBatchDelay.store(maxBatchDelay_, std::memory_order_relaxed);
+    LOGI("connect starting %zu workers", workerCount_);
+    pipeline->writer = std::thread(&writeTunnel, fd_, stopFd_, pipeline.get());
+    pipeline->attribution = std::thread(&FlowAttributor::run, pipeline->attributor.get(), stopFd_);
+    pipeline->reporting = std::thread(&StatsReporter::run, pipeline->reporter.get(), stopFd_);
+    for (size_t index = 0; index < workerCount_; index++) {
+        pipeline->workers[index]->thread = std::thread(&processPackets, index, stopFd_, &flowTable_, pipeline.get(), &sessionListener_);
+    }
+    pipeline->reader = std::thread(&readTunnel, fd_, stopFd_, &packetPool_, &flowTable_, pipeline.get());
+    pipeline_ = std::move(pipeline);
 }
 
 auto vpn::VpnConnection::disconnect() -> void {
-    isDisconnectRequested_ = true;
-    thread_.join();
-}
\ No newline at end of file
+    auto const stop = uint64_t{1};
+    if (write(stopFd_, &stop, sizeof(stop)) != sizeof(stop)) {
+        LOGE("disconnect unable to signal stop eventfd, %s", strerror(errno));
+    }
+    if (!pipeline_) {
+        return;
+    }
+    pipeline_->reader.join();
+    for (auto const &worker : pipeline_->workers) {
+        worker->thread.join();
+    }
+    pipeline_->writer.join();
+    pipeline_->attribution.join();
+    pipeline_->reporting.join();
+    pipeline_.reset();
+}
+
+auto vpn::VpnConnection::startCapture(CaptureOptions options) -> bool {
+    return capture_.start(std::move(options));
+}
+
+auto vpn::VpnConnection::stopCapture() -> void {
+    capture_.stop();
+}
+
+auto vpn::VpnConnection::setCaptureFilter(std::string const &expression) -> bool {
+    return capture_.setFilter(expression);
+}
+
+auto vpn::VpnConnection::getCaptureStats() const -> std::string {
+    return capture_.getStats();
+}
+
+auto vpn::VpnConnection::startFlowLog(std::string const &path, uint64_t const interval) -> bool {
+    return flowLog_.open(path, interval);
+}
+
+auto vpn::VpnConnection::stopFlowLog() -> void {
+    flowLog_.close();
+}
+
+auto vpn::VpnConnection::getFlowLogStats() const -> std::string {
+    return flowLog_.getStats();
+}
+
+auto vpn::VpnConnection::setInspectionFilter(std::string const &expression) -> bool {
+    return inspectionFilter_.set(expression);
+}
+
+auto vpn::VpnConnection::setInspectionBudget(uint32_t const budget, uint64_t const fullBytes) -> void {
+    inspectionSampler_.setBudget(budget, fullBytes);
+}
+
+auto vpn::VpnConnection::getInspectionStats() const -> std::string {
+    return inspectionSampler_.getStats();
+}
+
+auto vpn::VpnConnection::sharePacketSummaries() -> int {
+    return summaries_.share();
+}
+
+auto vpn::VpnConnection::setBatching(size_t const maxPackets, uint64_t const maxDelay) -> void {
+    maxBatchPackets_ = std::clamp<size_t>(maxPackets, 1, BATCH_SIZE);
+    maxBatchDelay_ = maxDelay;
+    if (pipeline_) {
+        pipeline_->maxBatchPackets.store(maxBatchPackets_, std::memory_order_relaxed);
+        pipeline_->maxBatchDelay.store(maxBatchDelay_, std::memory_order_relaxed);
+    }
+}
+
+auto vpn::getBatchStats() -> std::string {
+    return "batch.size " + std::to_string(gBatchSize.load(std::memory_order_relaxed)) + "\n" +
+           "batch.coalesced " + std::to_string(gCoalescedBatches.load(std::memory_order_relaxed)) + "\n" +
+           "batch.expired " + std::to_string(gExpiredBatches.load(std::memory_order_relaxed)) + "\n";
+}
+
+auto vpn::VpnConnection::setOverflowPolicy(std::string const &queue, OverflowPolicy const policy) -> bool {
+    if (queue == "capture") {
+        capture_.setOverflowPolicy(policy);
+    } else if (queue == "workers" && supportsPolicy<utils::SpscRingBuffer<PacketBuffer>>(policy)) {
+        workerOverflow_.setPolicy(policy);
+    } else if (queue == "tunnel" && supportsPolicy<utils::SpscRingBuffer<PacketBuffer>>(policy)) {
+        tunnelOverflow_.setPolicy(policy);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+auto vpn::VpnConnection::getQueueStats() const -> std::string {
+    return workerOverflow_.getStats("workers") + tunnelOverflow_.getStats("tunnel");
+}
+
+auto vpn::VpnConnection::setThreadPolicy(ThreadPolicy const policy) -> void {
+    threadTuner_.setPolicy(policy);
+}
+
+auto vpn::VpnConnection::setStatsInterval(uint64_t const interval) -> void {
+    statsInterval_ = interval;
+    if (pipeline_) {
+        pipeline_->reporter->setInterval(interval);
+    }
+}
@@ -24,27 +24,221 @@
 #ifndef ANDROID_INTROSPECTION_VPN_VPNCONNECTION_H_
 #define ANDROID_INTROSPECTION_VPN_VPNCONNECTION_H_
 
-#include <thread>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "FlowAttribution.h"
+#include "FlowLog.h"
+#include "FlowTable.h"
+#include "InspectionSampler.h"
+#include "OverflowPolicy.h"
+#include "PacketCapture.h"
+#include "PacketFilter.h"
+#include "PacketPool.h"
+#include "PacketSummaryRing.h"
+#include "StatsReporter.h"
+#include "TcpForwarder.h"
+#include "ThreadTuner.h"
 
 namespace ai::vpn {
 
+    struct PacketPipeline;
+
+    //
+    // Moves the packets of a tunnel through a pipeline of threads: one
+    // reading the tunnel, workers processing the flows each is handed by
+    // hash, and one writing what they send back to the tunnel.
+    //
     class VpnConnection final {
+    public:
+        //
+        // Told about every socket a session opens to forward a flow, with
+        // its descriptor, e.g. to protect it from the VPN, and about it
+        // being closed.  Called on the packet loops of the workers.
+        //
+        struct SessionListener {
+
+            SocketCallback onSessionCreated;
+
+            SocketCallback onSessionDestroyed;
+        };
 
+    private:
         int const fd_;
 
-        std::thread thread_;
+        SessionListener const sessionListener_;
+
+        OwnerLookup const ownerLookup_;
+
+        StatsCallback const onStats_;
+
+        //
+        // Milliseconds between stats reports, kept across disconnects.
+        //
+        uint64_t statsInterval_ = 0;
+
+        //
+        // Most packets dispatched together and microseconds the first of
+        // them is held for more, kept across disconnects.
+        //
+        size_t maxBatchPackets_;
+
+        uint64_t maxBatchDelay_ = 0;
+
+        //
+        // eventfd every thread of the pipeline polls, so that a disconnect
+        // wakes them right away instead of at the next packet.
+        //
+        int const stopFd_;
+
+        size_t const workerCount_;
+
+        //
+        // Buffers every packet of the connection is read into and handed
+        // along in.
+        //
+        PacketPool packetPool_;
+
+        //
+        // Flows seen on the tunnel, a shard per worker.
+        //
+        FlowTable flowTable_;
+
+        PacketCapture capture_;
+
+        PacketSummaryRing summaries_;
+
+        FlowLog flowLog_;
+
+        //
+        // Flows whose first packet it rejects are not inspected for names,
+        // e.g. the SNI of their ClientHello.
+        //
+        SharedPacketFilter inspectionFilter_;
+
+        //
+        // Samples the packets inspected in depth to keep the process within
+        // its CPU budget, kept across disconnects.
+        //
+        InspectionSampler inspectionSampler_;
+
+        //
+        // Policy of the reader and the writer, kept across disconnects.
+        //
+        ThreadTuner threadTuner_;
 
-        std::atomic_bool isDisconnectRequested_;
+        //
+        // Overflow policies of the queues of the workers and of those to the
+        // writer, kept across disconnects.
+        //
+        OverflowGuard workerOverflow_{OverflowPolicy::Block};
+
+        OverflowGuard tunnelOverflow_{OverflowPolicy::DropNewest};
+
+        std::unique_ptr<PacketPipeline> pipeline_;
 
     public:
-        VpnConnection(int const fd);
+        VpnConnection(int const fd, SessionListener sessionListener, OwnerLookup ownerLookup = {}, StatsCallback onStats = {});
 
         ~VpnConnection();
 
         auto connect() -> void;
 
         auto disconnect() -> void;
+
+        //
+        // Saves the packets of the tunnel to pcap files from here on, across
+        // disconnects, until stopped.
+        //
+        auto startCapture(CaptureOptions options) -> bool;
+
+        auto stopCapture() -> void;
+
+        auto setCaptureFilter(std::string const &expression) -> bool;
+
+        auto getCaptureStats() const -> std::string;
+
+        //
+        // Logs the flows of the tunnel to the file at the path from here on,
+        // across disconnects, each as it ends and every interval
+        // milliseconds while it is active, unless it is 0; false if the
+        // file cannot be opened as a flow log.
+        //
+        auto startFlowLog(std::string const &path, uint64_t interval) -> bool;
+
+        auto stopFlowLog() -> void;
+
+        auto getFlowLogStats() const -> std::string;
+
+        //
+        // Only inspects the flows whose first packet matches the pcap filter
+        // expression from here on, or every flow if it is empty; false if it
+        // does not compile.
+        //
+        auto setInspectionFilter(std::string const &expression) -> bool;
+
+        //
+        // Inspects every packet of the first fullBytes of each flow and
+        // samples the rest as needed to keep the process under the percent
+        // of one core from here on, across disconnects, or inspects every
+        // packet if it is 0.  See InspectionSampler.
+        //
+        auto setInspectionBudget(uint32_t budget, uint64_t fullBytes) -> void;
+
+        auto getInspectionStats() const -> std::string;
+
+        //
+        // Descriptor of the shared memory of the summaries of the packets of
+        // the tunnel for the caller to own, which turns them on; -1 if there
+        // is none.  See PacketSummaryRing for its layout.
+        //
+        auto sharePacketSummaries() -> int;
+
+        //
+        // Hands the traffic of the flows to the stats callback every interval
+        // of milliseconds from here on, or stops if it is 0.
+        //
+        auto setStatsInterval(uint64_t interval) -> void;
+
+        //
+        // Places the reader and the writer on cores and sets their priority
+        // as the policy has it from here on, across disconnects.
+        //
+        auto setThreadPolicy(ThreadPolicy policy) -> void;
+
+        //
+        // Dispatches the packets read off a busy tunnel to the workers in
+        // batches of up to maxPackets, holding the first packet of a batch
+        // up to maxDelay microseconds for the rest, or not at all if it is
+        // 0; a tunnel that is nearly idle has its packets dispatched as they
+        // come either way.
+        //
+        auto setBatching(size_t maxPackets, uint64_t maxDelay) -> void;
+
+        //
+        // What a queue does with what is offered while it is full from here
+        // on: "capture" for packets to save, "workers" for packets read off
+        // the tunnel and "tunnel" for packets to write to it.  False for
+        // other queues and for dropping the oldest packets of the latter
+        // two, which only their consumer may take.
+        //
+        auto setOverflowPolicy(std::string const &queue, OverflowPolicy policy) -> bool;
+
+        //
+        // Waits and drops of the queues of the workers and the writer, one
+        // "name value" per line.
+        //
+        auto getQueueStats() const -> std::string;
     };
+
+    //
+    // Packets the recent batches averaged and batches that were held for
+    // more and ran out of time since the library was loaded, one
+    // "name value" per line.
+    //
+    auto getBatchStats() -> std::string;
 }
 
 #endif /* ANDROID_INTROSPECTION_VPN_VPNCONNECTION_H_ */
@@ -21,26 +21,334 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
+#include <unistd.h>
+#include <utility>
+
 #include "VpnService.h"
+#include "PacketProcessor.h"
+#include "TlsInspector.h"
+#include "StreamReassembler.h"
 #include "utils/log.h"
 #include "aidl/com/github/jonforshort/vpn/BnVpnServiceListener.h"
 
-::ndk::ScopedAStatus ai::vpn::VpnService::initialize(const ndk::SpAIBinder &in_listener, const ndk::ScopedFileDescriptor &in_vpnSocket) {
-    LOGI("VpnService::initialize");
+using aidl::com::github::jonforshort::vpn::IVpnServiceListener;
+using aidl::com::github::jonforshort::vpn::StatsBatch;
+
+namespace {
+
+    auto toBytes(ai::vpn::IpAddress const &address) -> std::vector<uint8_t> {
+        return {address.bytes().begin(), address.bytes().end()};
+    }
+
+    auto toParcelable(ai::vpn::FlowStats const &stats) -> aidl::com::github::jonforshort::vpn::FlowStats {
+        auto flow = aidl::com::github::jonforshort::vpn::FlowStats();
+        flow.protocol = stats.key.protocol;
+        flow.sourceAddress = toBytes(stats.key.sourceAddress);
+        flow.sourcePort = stats.key.sourcePort;
+        flow.destinationAddress = toBytes(stats.key.destinationAddress);
+        flow.destinationPort = stats.key.destinationPort;
+        flow.uid = stats.uid;
+        flow.packetsSent = static_cast<int64_t>(stats.traffic.packetsSent);
+        flow.bytesSent = static_cast<int64_t>(stats.traffic.bytesSent);
+        flow.packetsReceived = static_cast<int64_t>(stats.traffic.packetsReceived);
+        flow.bytesReceived = static_cast<int64_t>(stats.traffic.bytesReceived);
+        return flow;
+    }
+
+    auto toParcelable(ai::vpn::AppStats const &stats) -> aidl::com::github::jonforshort::vpn::AppStats {
+        auto app = aidl::com::github::jonforshort::vpn::AppStats();
+        app.uid = stats.uid;
+        app.packetsSent = static_cast<int64_t>(stats.traffic.packetsSent);
+        app.bytesSent = static_cast<int64_t>(stats.traffic.bytesSent);
+        app.packetsReceived = static_cast<int64_t>(stats.traffic.packetsReceived);
+        app.bytesReceived = static_cast<int64_t>(stats.traffic.bytesReceived);
+        return app;
+    }
+
+    auto toParcelable(ai::vpn::LatencyStats const &stats) -> aidl::com::github::jonforshort::vpn::LatencyStats {
+        auto latency = aidl::com::github::jonforshort::vpn::LatencyStats();
+        latency.stage = stats.stage;
+        latency.count = static_cast<int64_t>(stats.count);
+        latency.p50Nanos = static_cast<int64_t>(stats.p50);
+        latency.p90Nanos = static_cast<int64_t>(stats.p90);
+        latency.p99Nanos = static_cast<int64_t>(stats.p99);
+        latency.maxNanos = static_cast<int64_t>(stats.max);
+        return latency;
+    }
+}
+
+auto ai::vpn::VpnService::setSocketProtector(std::function<bool(int socket)> protector) -> void {
+    auto const lock = std::lock_guard(mutex_);
+    socketProtector_ = std::move(protector);
+}
+
+//
+// The connection owns a descriptor of its own, as the parcel closes the one
+// it hands over.  Sockets of sessions are protected through the listener,
+// unless a protector does, and the listener looks up the apps owning flows.
+//
+// The tunnel only carries the packets of the apps it was established for,
+// the routing being up to VpnService.Builder; the lists are kept to report
+// which apps those are.
+//
+::ndk::ScopedAStatus ai::vpn::VpnService::initialize(const ndk::SpAIBinder &in_listener, const ndk::ScopedFileDescriptor &in_vpnSocket,
+                                                     std::vector<std::string> const &in_allowedApplications,
+                                                     std::vector<std::string> const &in_disallowedApplications) {
+    LOGI("VpnService::initialize %zu allowed, %zu disallowed applications", in_allowedApplications.size(), in_disallowedApplications.size());
+    auto const lock = std::lock_guard(mutex_);
+    if (!in_allowedApplications.empty() && !in_disallowedApplications.empty()) {
+        LOGE("VpnService::initialize unable to both allow and disallow applications");
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_BAD_VALUE));
+    }
+    auto const fd = dup(in_vpnSocket.get());
+    if (fd < 0) {
+        LOGE("VpnService::initialize unable to duplicate tunnel descriptor");
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_BAD_VALUE));
+    }
+    listener_ = IVpnServiceListener::fromBinder(in_listener);
+    auto const listener = listener_;
+    auto sessionListener = VpnConnection::SessionListener{
+            [listener, protector = socketProtector_](int const socket) {
+                if (protector) {
+                    if (!protector(socket)) {
+                        LOGW("VpnService unable to protect socket %d", socket);
+                    }
+                } else if (listener != nullptr) {
+                    listener->onSessionCreated(socket);
+                }
+            },
+            [listener, isProtected = static_cast<bool>(socketProtector_)](int const socket) {
+                if (!isProtected && listener != nullptr) {
+                    listener->onSessionDestroyed(socket);
+                }
+            },
+    };
+    auto ownerLookup = OwnerLookup{
+            [listener](FlowKey const &key) {
+                auto uid = UNKNOWN_UID;
+                if (listener == nullptr ||
+                    !listener->getConnectionOwnerUid(key.protocol, toBytes(key.sourceAddress), key.sourcePort, toBytes(key.destinationAddress),
+                                                     key.destinationPort, &uid).isOk()) {
+                    return UNKNOWN_UID;
+                }
+                return uid;
+            },
+            [listener](int32_t const uid) {
+                auto packageName = std::string();
+                if (listener != nullptr && !listener->getPackageName(uid, &packageName).isOk()) {
+                    packageName.clear();
+                }
+                return packageName;
+            },
+    };
+    //
+    // Reports go out in one oneway call each, so that a slow listener never
+    // holds up the reporter.
+    //
+    auto onStats = [listener](StatsReport const &report) {
+        if (listener == nullptr) {
+            return;
+        }
+        auto batch = StatsBatch();
+        batch.intervalMillis = static_cast<int64_t>(report.interval);
+        batch.flows.reserve(report.flows.size());
+        for (auto const &flow : report.flows) {
+            batch.flows.push_back(toParcelable(flow));
+        }
+        batch.apps.reserve(report.apps.size());
+        for (auto const &app : report.apps) {
+            batch.apps.push_back(toParcelable(app));
+        }
+        batch.latencies.reserve(report.latencies.size());
+        for (auto const &latency : report.latencies) {
+            batch.latencies.push_back(toParcelable(latency));
+        }
+        if (!listener->onStats(batch).isOk()) {
+            LOGW("VpnService unable to send stats of %zu flows", report.flows.size());
+        }
+    };
+    connection_ = std::make_unique<VpnConnection>(fd, std::move(sessionListener), std::move(ownerLookup), std::move(onStats));
+    allowedApplications_ = in_allowedApplications;
+    disallowedApplications_ = in_disallowedApplications;
     return ::ndk::ScopedAStatus(AStatus_newOk());
 }
 
 ::ndk::ScopedAStatus ai::vpn::VpnService::start() {
     LOGI("VpnService::start");
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ != nullptr) {
+        connection_->connect();
+    }
     return ::ndk::ScopedAStatus(AStatus_newOk());
 }
 
 ::ndk::ScopedAStatus ai::vpn::VpnService::stop() {
     LOGI("VpnService::stop");
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ != nullptr) {
+        connection_->disconnect();
+    }
     return ::ndk::ScopedAStatus(AStatus_newOk());
 }
 
 ::ndk::ScopedAStatus ai::vpn::VpnService::uninitialize() {
     LOGI("VpnService::uninitialize");
+    auto const lock = std::lock_guard(mutex_);
+    connection_.reset();
+    listener_.reset();
+    allowedApplications_.clear();
+    disallowedApplications_.clear();
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::getStats(std::string *_aidl_return) {
+    LOGI("VpnService::getStats");
+    auto const lock = std::lock_guard(mutex_);
+    *_aidl_return = getTrafficStats();
+    *_aidl_return += "routing.allowed_applications " + std::to_string(allowedApplications_.size()) + "\n";
+    *_aidl_return += "routing.disallowed_applications " + std::to_string(disallowedApplications_.size()) + "\n";
+    if (connection_ != nullptr) {
+        *_aidl_return += connection_->getCaptureStats();
+        *_aidl_return += connection_->getQueueStats();
+        *_aidl_return += connection_->getFlowLogStats();
+        *_aidl_return += connection_->getInspectionStats();
+    }
+    *_aidl_return += getAttributionStats();
+    *_aidl_return += getReporterStats();
+    *_aidl_return += getTlsStats();
+    *_aidl_return += getHttpStats();
+    *_aidl_return += getReassemblyStats();
+    *_aidl_return += getThreadStats();
+    *_aidl_return += getBatchStats();
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::setCaptureDirectory(std::string const &in_directory) {
+    LOGI("VpnService::setCaptureDirectory %s", in_directory.c_str());
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    if (in_directory.empty()) {
+        connection_->stopCapture();
+    } else if (!connection_->startCapture(CaptureOptions{in_directory})) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_UNKNOWN_ERROR));
+    }
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::setCaptureFilter(std::string const &in_filter, bool *_aidl_return) {
+    LOGI("VpnService::setCaptureFilter %s", in_filter.c_str());
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    *_aidl_return = connection_->setCaptureFilter(in_filter);
     return ::ndk::ScopedAStatus(AStatus_newOk());
-}
\ No newline at end of file
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::setInspectionFilter(std::string const &in_filter, bool *_aidl_return) {
+    LOGI("VpnService::setInspectionFilter %s", in_filter.c_str());
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    *_aidl_return = connection_->setInspectionFilter(in_filter);
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::setStatsInterval(int32_t const in_intervalMillis) {
+    LOGI("VpnService::setStatsInterval %d", in_intervalMillis);
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    if (in_intervalMillis < 0) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_BAD_VALUE));
+    }
+    connection_->setStatsInterval(static_cast<uint64_t>(in_intervalMillis));
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::setThreadPolicy(int32_t const in_policy) {
+    LOGI("VpnService::setThreadPolicy %d", in_policy);
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    if (in_policy < static_cast<int32_t>(ThreadPolicy::Default) || in_policy > static_cast<int32_t>(ThreadPolicy::Adaptive)) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_BAD_VALUE));
+    }
+    connection_->setThreadPolicy(static_cast<ThreadPolicy>(in_policy));
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::setBatching(int32_t const in_maxPackets, int32_t const in_maxDelayMicros) {
+    LOGI("VpnService::setBatching %d packets, %d us", in_maxPackets, in_maxDelayMicros);
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    if (in_maxPackets < 1 || in_maxDelayMicros < 0) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_BAD_VALUE));
+    }
+    connection_->setBatching(static_cast<size_t>(in_maxPackets), static_cast<uint64_t>(in_maxDelayMicros));
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::setOverflowPolicy(std::string const &in_queue, int32_t const in_policy, bool *_aidl_return) {
+    LOGI("VpnService::setOverflowPolicy %s %d", in_queue.c_str(), in_policy);
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    if (in_policy < static_cast<int32_t>(OverflowPolicy::Block) || in_policy > static_cast<int32_t>(OverflowPolicy::Sample)) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_BAD_VALUE));
+    }
+    *_aidl_return = connection_->setOverflowPolicy(in_queue, static_cast<OverflowPolicy>(in_policy));
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::setFlowLog(std::string const &in_path, int32_t const in_intervalMillis) {
+    LOGI("VpnService::setFlowLog %s every %d ms", in_path.c_str(), in_intervalMillis);
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    if (in_intervalMillis < 0) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_BAD_VALUE));
+    }
+    if (in_path.empty()) {
+        connection_->stopFlowLog();
+    } else if (!connection_->startFlowLog(in_path, static_cast<uint64_t>(in_intervalMillis))) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_UNKNOWN_ERROR));
+    }
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::getPacketSummaries(::ndk::ScopedFileDescriptor *_aidl_return) {
+    LOGI("VpnService::getPacketSummaries");
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    auto const fd = connection_->sharePacketSummaries();
+    if (fd < 0) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_UNKNOWN_ERROR));
+    }
+    _aidl_return->set(fd);
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
+
+::ndk::ScopedAStatus ai::vpn::VpnService::setInspectionBudget(int32_t const in_cpuPercent, int32_t const in_fullBytes) {
+    LOGI("VpnService::setInspectionBudget %d%% of a core past %d bytes", in_cpuPercent, in_fullBytes);
+    auto const lock = std::lock_guard(mutex_);
+    if (connection_ == nullptr) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_INVALID_OPERATION));
+    }
+    if (in_cpuPercent < 0 || in_fullBytes < 0) {
+        return ::ndk::ScopedAStatus(AStatus_fromStatus(STATUS_BAD_VALUE));
+    }
+    connection_->setInspectionBudget(static_cast<uint32_t>(in_cpuPercent), static_cast<uint64_t>(in_fullBytes));
+    return ::ndk::ScopedAStatus(AStatus_newOk());
+}
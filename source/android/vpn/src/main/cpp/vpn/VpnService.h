@@ -24,6 +24,12 @@
 #ifndef ANDROID_INTROSPECTION_VPN_VPNSERVICE_H_
 #define ANDROID_INTROSPECTION_VPN_VPNSERVICE_H_
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "VpnConnection.h"
 
 #include "aidl/com/github/jonforshort/vpn/BnVpnService.h"
@@ -33,18 +39,63 @@ namespace ai::vpn {
 
     class VpnService : public aidl::com::github::jonforshort::vpn::BnVpnService {
 
+        std::mutex mutex_;
+
+        std::shared_ptr<aidl::com::github::jonforshort::vpn::IVpnServiceListener> listener_;
+
+        std::unique_ptr<VpnConnection> connection_;
+
+        std::function<bool(int socket)> socketProtector_;
+
+        std::vector<std::string> allowedApplications_;
+
+        std::vector<std::string> disallowedApplications_;
+
     public:
         VpnService() = default;
 
         virtual ~VpnService() = default;
 
-        virtual ::ndk::ScopedAStatus initialize(::ndk::SpAIBinder const&in_listener, const ::ndk::ScopedFileDescriptor const&in_vpnSocket);
+        //
+        // Protects the sockets of the sessions of connections initialized
+        // from here on, in place of the session callbacks of the listener,
+        // e.g. straight through JNI when the listener is in process; false
+        // if the socket could not be protected.  Empty goes back to the
+        // listener.
+        //
+        auto setSocketProtector(std::function<bool(int socket)> protector) -> void;
+
+        virtual ::ndk::ScopedAStatus initialize(::ndk::SpAIBinder const&in_listener, ::ndk::ScopedFileDescriptor const&in_vpnSocket,
+                                                std::vector<std::string> const &in_allowedApplications,
+                                                std::vector<std::string> const &in_disallowedApplications);
 
         virtual ::ndk::ScopedAStatus start();
 
         virtual ::ndk::ScopedAStatus stop();
 
         virtual ::ndk::ScopedAStatus uninitialize();
+
+        virtual ::ndk::ScopedAStatus getStats(std::string *_aidl_return);
+
+        virtual ::ndk::ScopedAStatus setCaptureDirectory(std::string const &in_directory);
+
+        virtual ::ndk::ScopedAStatus setCaptureFilter(std::string const &in_filter, bool *_aidl_return);
+
+        virtual ::ndk::ScopedAStatus setInspectionFilter(std::string const &in_filter, bool *_aidl_return);
+
+        virtual ::ndk::ScopedAStatus setStatsInterval(int32_t in_intervalMillis);
+
+        virtual ::ndk::ScopedAStatus setThreadPolicy(int32_t in_policy);
+
+        virtual ::ndk::ScopedAStatus setBatching(int32_t in_maxPackets, int32_t in_maxDelayMicros);
+
+        virtual ::ndk::ScopedAStatus setOverflowPolicy(std::string const &in_queue, int32_t in_policy, bool *_aidl_return);
+
+        virtual ::ndk::ScopedAStatus setFlowLog(std::string const &in_path, int32_t in_intervalMillis);
+
+        virtual ::ndk::ScopedAStatus setInspectionBudget(int32_t in_cpuPercent, int32_t in_fullBytes);
+
+        virtual ::ndk::ScopedAStatus getPacketSummaries(::ndk::ScopedFileDescriptor *_aidl_return);
     };
 }
 
@@ -0,0 +1,150 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+package com.github.jonforshort.vpn
+
+import java.io.File
+import java.io.IOException
+import java.io.RandomAccessFile
+import java.net.InetAddress
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.channels.FileChannel
+
+//
+// Record of a flow of the tunnel, with the IPv4 or IPv6 addresses and the
+// ports of its first packet, the wall clock time it started at, and its
+// traffic as the app saw it up to the record.  The last record of a flow
+// that is gone has isClosed set.
+//
+data class FlowRecord(
+    val startTimeMillis: Long,
+    val durationMillis: Long,
+    val protocol: Int,
+    val sourceAddress: InetAddress,
+    val sourcePort: Int,
+    val destinationAddress: InetAddress,
+    val destinationPort: Int,
+    val uid: Int,
+    val name: String,
+    val bytesSent: Long,
+    val bytesReceived: Long,
+    val packetsSent: Long,
+    val packetsReceived: Long,
+    val isClosed: Boolean
+)
+
+//
+// Reads a flow log the native side appends to, laid out as FlowLog
+// describes.  Each reader keeps its own position, so that read() only hands
+// over the records appended since, and is not thread safe.
+//
+class FlowLogReader internal constructor(private val buffer: ByteBuffer) {
+
+    private val recordsOffset = buffer.getInt(RECORDS_OFFSET_OFFSET)
+    private var next = 0L
+
+    //
+    // Hands every record appended since the last call to onRecord, oldest
+    // first, and returns how many it handed.
+    //
+    fun read(onRecord: (FlowRecord) -> Unit): Int {
+        val end = minOf(buffer.getLong(END_OFFSET), buffer.capacity().toLong() - recordsOffset)
+        var count = 0
+        while (next + RECORD_SIZE <= end) {
+            val offset = recordsOffset + next.toInt()
+            val size = buffer.getShort(offset).toInt() and 0xffff
+            if (size < RECORD_SIZE || next + size > end) {
+                break
+            }
+            onRecord(readRecord(offset, size))
+            next += size
+            count++
+        }
+        return count
+    }
+
+    private fun readRecord(offset: Int, size: Int): FlowRecord {
+        val name = ByteArray(size - RECORD_SIZE)
+        buffer.duplicate().apply { position(offset + RECORD_SIZE) }.get(name)
+        val nameLength = name.indexOf(0).let { if (it < 0) name.size else it }
+        return FlowRecord(
+            startTimeMillis = buffer.getLong(offset + 48),
+            durationMillis = buffer.getInt(offset + 44).toLong() and 0xffffffffL,
+            protocol = buffer.get(offset + 2).toInt() and 0xff,
+            sourceAddress = readAddress(offset + 8),
+            sourcePort = buffer.getShort(offset + 40).toInt() and 0xffff,
+            destinationAddress = readAddress(offset + 24),
+            destinationPort = buffer.getShort(offset + 42).toInt() and 0xffff,
+            uid = buffer.getInt(offset + 4),
+            name = String(name, 0, nameLength, Charsets.UTF_8),
+            bytesSent = buffer.getLong(offset + 56),
+            bytesReceived = buffer.getLong(offset + 64),
+            packetsSent = buffer.getInt(offset + 72).toLong() and 0xffffffffL,
+            packetsReceived = buffer.getInt(offset + 76).toLong() and 0xffffffffL,
+            isClosed = (buffer.get(offset + 3).toInt() and CLOSED) != 0
+        )
+    }
+
+    private fun readAddress(offset: Int): InetAddress {
+        val bytes = ByteArray(ADDRESS_SIZE)
+        buffer.duplicate().apply { position(offset) }.get(bytes)
+        return InetAddress.getByAddress(bytes)
+    }
+
+    companion object {
+        private const val MAGIC = 0x464C5056
+        private const val VERSION = 2
+        private const val CLOSED = 1
+
+        private const val MAGIC_OFFSET = 0
+        private const val VERSION_OFFSET = 4
+        private const val RECORDS_OFFSET_OFFSET = 8
+        private const val END_OFFSET = 64
+        private const val HEADER_SIZE = 128L
+        private const val RECORD_SIZE = 80
+        private const val ADDRESS_SIZE = 16
+
+        //
+        // Reader of the flow log in the file, null if it is not a flow log
+        // this reader knows.  The file stays mapped while the reader is in
+        // use, so that it sees what is appended to the log still open.
+        //
+        fun open(file: File): FlowLogReader? = try {
+            RandomAccessFile(file, "r").channel.use { channel ->
+                if (channel.size() < HEADER_SIZE) {
+                    null
+                } else {
+                    val buffer = channel.map(FileChannel.MapMode.READ_ONLY, 0, channel.size()).order(ByteOrder.nativeOrder())
+                    if (buffer.getInt(MAGIC_OFFSET) != MAGIC || buffer.getInt(VERSION_OFFSET) != VERSION) {
+                        null
+                    } else {
+                        FlowLogReader(buffer)
+                    }
+                }
+            }
+        } catch (e: IOException) {
+            null
+        }
+    }
+}
@@ -26,17 +26,38 @@ package com.github.jonforshort.vpn
 import android.app.ActivityManager
 import android.content.Context
 import android.content.Intent
+import android.content.pm.PackageManager
+import android.net.ConnectivityManager
 import android.net.VpnService
+import android.os.Build
 import android.os.IBinder
 import android.os.ParcelFileDescriptor
+import android.os.Process
 import timber.log.Timber.d
 import timber.log.Timber.e
+import java.io.File
 import java.io.IOException
+import java.net.InetAddress
+import java.net.InetSocketAddress
 import java.net.NetworkInterface
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.text.SimpleDateFormat
+import java.util.Date
+import java.util.Locale
 
-fun startVpn(context: Context) {
+//
+// Tunnels the traffic of the packages in allowedPackages only, or of every
+// app but those in disallowedPackages, e.g. just the app under introspection
+// so that no time goes to the rest; every app if both are empty.  Starting
+// it again with other packages establishes the tunnel anew.
+//
+fun startVpn(context: Context, allowedPackages: List<String> = emptyList(), disallowedPackages: List<String> = emptyList()) {
+    require(allowedPackages.isEmpty() || disallowedPackages.isEmpty()) { "unable to both allow and disallow packages" }
     val intent = Intent(context, LocalVpnService::class.java).apply {
         action = "START_VPN"
+        putExtra("allowedPackages", allowedPackages.toTypedArray())
+        putExtra("disallowedPackages", disallowedPackages.toTypedArray())
     }
     context.startService(intent)
 }
@@ -48,6 +69,124 @@ fun stopVpn(context: Context) {
     context.startService(intent)
 }
 
+//
+// Saves the packets of the tunnel as pcap files under the external files
+// directory of the app, in "captures", until stopped; only those matching
+// the pcap filter expression, e.g. "tcp port 443", unless it is empty.
+//
+fun startVpnCapture(context: Context, filter: String = "") {
+    val intent = Intent(context, LocalVpnService::class.java).apply {
+        action = "START_CAPTURE"
+        putExtra("filter", filter)
+    }
+    context.startService(intent)
+}
+
+fun stopVpnCapture(context: Context) {
+    val intent = Intent(context, LocalVpnService::class.java).apply {
+        action = "STOP_CAPTURE"
+    }
+    context.startService(intent)
+}
+
+//
+// Logs the flows of the tunnel under the files directory of the app, in
+// "flows", to a file per day, e.g. "2020-06-01.flows", as FlowLogReader
+// reads them; a record as each flow ends and every intervalMillis while it
+// is active, unless it is 0.
+//
+fun startVpnFlowLog(context: Context, intervalMillis: Int = 60_000) {
+    val intent = Intent(context, LocalVpnService::class.java).apply {
+        action = "START_FLOW_LOG"
+        putExtra("intervalMillis", intervalMillis)
+    }
+    context.startService(intent)
+}
+
+fun stopVpnFlowLog(context: Context) {
+    val intent = Intent(context, LocalVpnService::class.java).apply {
+        action = "STOP_FLOW_LOG"
+    }
+    context.startService(intent)
+}
+
+//
+// Places the threads moving the packets of the tunnel on cores as the
+// policy has it, one of the THREAD_POLICY_ constants of IVpnService, e.g.
+// IVpnService.THREAD_POLICY_ADAPTIVE to favor the big cores during bursts
+// only.
+//
+fun setVpnThreadPolicy(context: Context, policy: Int) {
+    val intent = Intent(context, LocalVpnService::class.java).apply {
+        action = "SET_THREAD_POLICY"
+        putExtra("policy", policy)
+    }
+    context.startService(intent)
+}
+
+//
+// Hands the packets of a busy tunnel to the workers in batches of up to
+// maxPackets, holding the first up to maxDelayMicros for the rest, to save
+// wake ups; 0 hands them over as they come.
+//
+fun setVpnBatching(context: Context, maxPackets: Int, maxDelayMicros: Int) {
+    val intent = Intent(context, LocalVpnService::class.java).apply {
+        action = "SET_BATCHING"
+        putExtra("maxPackets", maxPackets)
+        putExtra("maxDelayMicros", maxDelayMicros)
+    }
+    context.startService(intent)
+}
+
+//
+// Sets what the queue, "capture", "workers" or "tunnel", does with what it
+// is offered while full, one of the OVERFLOW_ constants of IVpnService,
+// e.g. IVpnService.OVERFLOW_DROP_OLDEST to keep a capture current.
+//
+fun setVpnOverflowPolicy(context: Context, queue: String, policy: Int) {
+    val intent = Intent(context, LocalVpnService::class.java).apply {
+        action = "SET_OVERFLOW_POLICY"
+        putExtra("queue", queue)
+        putExtra("policy", policy)
+    }
+    context.startService(intent)
+}
+
+//
+// Inspects the first fullBytes of every flow in depth and samples the rest
+// of its packets while the VPN takes more than cpuPercent of one core, to
+// bound its CPU time under heavy load; 0 inspects every packet.
+//
+fun setVpnInspectionBudget(context: Context, cpuPercent: Int, fullBytes: Int) {
+    val intent = Intent(context, LocalVpnService::class.java).apply {
+        action = "SET_INSPECTION_BUDGET"
+        putExtra("cpuPercent", cpuPercent)
+        putExtra("fullBytes", fullBytes)
+    }
+    context.startService(intent)
+}
+
+//
+// Called on a binder thread with the traffic of the tunnel every
+// STATS_INTERVAL_MILLIS while it runs, e.g. to show it live; null to stop.
+//
+@Volatile
+private var vpnStatsListener: ((StatsBatch) -> Unit)? = null
+
+fun setVpnStatsListener(listener: ((StatsBatch) -> Unit)?) {
+    vpnStatsListener = listener
+}
+
+@Volatile
+private var vpnPacketSummaries: ByteBuffer? = null
+
+//
+// Reader of the summaries of the packets of the tunnel from here on, e.g.
+// for a live packet list, null if the VPN is not running.
+//
+fun openVpnPacketSummaries(): PacketSummaryReader? =
+    vpnPacketSummaries?.let { PacketSummaryReader(it.duplicate().order(ByteOrder.nativeOrder())) }
+
 fun isVpnRunning(context: Context) = isVpnTunnelUp() && isVpnServiceRunning(context)
 
 @Suppress("DEPRECATION")
@@ -68,13 +207,22 @@ private fun isVpnTunnelUp(): Boolean {
 
 class LocalVpnService : VpnService() {
 
-    private lateinit var vpnInterface: ParcelFileDescriptor
-    private lateinit var vpnService: IVpnService
-    private lateinit var vpnServiceListener: IVpnServiceListener
+    //
+    // Set while the tunnel is up, and reset when it is stopped.
+    //
+    private var vpnInterface: ParcelFileDescriptor? = null
+    private var vpnService: NativeVpnService? = null
+    private var vpnServiceListener: IVpnServiceListener? = null
+    private var allowedPackages = emptyList<String>()
+    private var disallowedPackages = emptyList<String>()
 
     companion object {
         private const val VPN_ADDRESS = "10.0.0.2"
         private const val VPN_ROUTE = "0.0.0.0"
+        private const val VPN_ADDRESS_V6 = "fd00::2"
+        private const val VPN_ROUTE_V6 = "::"
+        private const val VPN_MTU = 1500
+        private const val STATS_INTERVAL_MILLIS = 250
 
         init {
             System.loadLibrary("vpn")
@@ -82,49 +230,188 @@ class LocalVpnService : VpnService() {
     }
 
     override fun onStartCommand(intent: Intent?, flags: Int, startId: Int): Int {
-        if (intent?.action == "STOP_VPN") {
-            stopVpn()
+        if (intent?.action == "START_VPN") {
+            startVpn(
+                intent.getStringArrayExtra("allowedPackages")?.toList() ?: emptyList(),
+                intent.getStringArrayExtra("disallowedPackages")?.toList() ?: emptyList()
+            )
+        } else if (vpnInterface == null && intent?.action != "STOP_VPN") {
+            // e.g. restarted after the process died, with every app as before
+            startVpn(emptyList(), emptyList())
+        }
+        when (intent?.action) {
+            "STOP_VPN" -> stopVpn()
+            "START_CAPTURE" -> startCapture(intent.getStringExtra("filter") ?: "")
+            "STOP_CAPTURE" -> vpnService?.setCaptureDirectory("")
+            "START_FLOW_LOG" -> startFlowLog(intent.getIntExtra("intervalMillis", 0))
+            "STOP_FLOW_LOG" -> vpnService?.setFlowLog("", 0)
+            "SET_THREAD_POLICY" -> vpnService?.setThreadPolicy(intent.getIntExtra("policy", IVpnService.THREAD_POLICY_DEFAULT))
+            "SET_BATCHING" -> vpnService?.setBatching(intent.getIntExtra("maxPackets", 1), intent.getIntExtra("maxDelayMicros", 0))
+            "SET_OVERFLOW_POLICY" -> vpnService?.setOverflowPolicy(
+                intent.getStringExtra("queue") ?: "",
+                intent.getIntExtra("policy", IVpnService.OVERFLOW_DROP_NEWEST)
+            )
+            "SET_INSPECTION_BUDGET" -> vpnService?.setInspectionBudget(
+                intent.getIntExtra("cpuPercent", 0),
+                intent.getIntExtra("fullBytes", 0)
+            )
         }
         return START_STICKY
     }
 
-    private fun stopVpn() {
-        try {
-            vpnInterface.close()
-        } catch (e: IOException) {
-            e(e, "unable to close parcel file descriptor")
+    //
+    // With a tunnel up already, the new interface is established before the
+    // old one is closed, so that traffic keeps going through the VPN rather
+    // than around it in between, and the old tunnel stays up should the new
+    // one fail.
+    //
+    private fun startVpn(allowedPackages: List<String>, disallowedPackages: List<String>) {
+        val oldVpnInterface = vpnInterface
+        if (oldVpnInterface != null) {
+            if (allowedPackages == this.allowedPackages && disallowedPackages == this.disallowedPackages) {
+                return
+            }
+            d("re-creating vpn interface for other packages")
         }
+        val newVpnInterface = establishVpnInterface(allowedPackages, disallowedPackages) ?: return
+        this.allowedPackages = allowedPackages
+        this.disallowedPackages = disallowedPackages
+        if (oldVpnInterface != null) {
+            stopNativeVpnService()
+            closeVpnInterface(oldVpnInterface)
+        }
+        vpnInterface = newVpnInterface
+        startNativeVpnService(newVpnInterface)
+    }
 
-        vpnService.stop()
-        vpnService.uninitialize()
-        destroyNativeVpnService()
+    private fun stopVpn() {
+        vpnInterface?.let {
+            stopNativeVpnService()
+            closeVpnInterface(it)
+        }
+        vpnInterface = null
+        if (vpnService != null) {
+            destroyNativeVpnService()
+        }
+        vpnService = null
+        vpnServiceListener = null
+        allowedPackages = emptyList()
+        disallowedPackages = emptyList()
 
         stopForeground(true)
         stopSelf()
     }
 
+    private fun startCapture(filter: String) {
+        val vpnService = vpnService ?: return
+        if (!vpnService.setCaptureFilter(filter)) {
+            e("unable to compile capture filter %s", filter)
+            return
+        }
+        val captureDirectory = File(getExternalFilesDir(null) ?: filesDir, "captures")
+        if (!captureDirectory.isDirectory && !captureDirectory.mkdirs()) {
+            e("unable to create capture directory %s", captureDirectory)
+            return
+        }
+        d("capturing packets to %s", captureDirectory)
+        vpnService.setCaptureDirectory(captureDirectory.path)
+    }
+
+    private fun startFlowLog(intervalMillis: Int) {
+        val vpnService = vpnService ?: return
+        val flowLogDirectory = File(filesDir, "flows")
+        if (!flowLogDirectory.isDirectory && !flowLogDirectory.mkdirs()) {
+            e("unable to create flow log directory %s", flowLogDirectory)
+            return
+        }
+        val day = SimpleDateFormat("yyyy-MM-dd", Locale.US).format(Date())
+        val flowLog = File(flowLogDirectory, "$day.flows")
+        d("logging flows to %s", flowLog)
+        vpnService.setFlowLog(flowLog.path, intervalMillis)
+    }
+
     override fun onCreate() {
         super.onCreate()
         d("onCreate called")
-
-        createVpnInterface()
     }
 
-    private fun createVpnInterface() {
+    //
+    // Null if the app is not prepared for VPN, e.g. after the user revoked
+    // it.
+    //
+    private fun establishVpnInterface(allowedPackages: List<String>, disallowedPackages: List<String>): ParcelFileDescriptor? {
         d("creating vpn interface")
 
         val vpnServiceBuilder = super.Builder()
         vpnServiceBuilder.addAddress(VPN_ADDRESS, 32)
         vpnServiceBuilder.addRoute(VPN_ROUTE, 0)
+        vpnServiceBuilder.addAddress(VPN_ADDRESS_V6, 128)
+        vpnServiceBuilder.addRoute(VPN_ROUTE_V6, 0)
+        vpnServiceBuilder.setMtu(VPN_MTU)
+        addApplications(vpnServiceBuilder, allowedPackages, disallowedPackages)
 
         val vpnName = "LocalVpnService"
-        vpnInterface = vpnServiceBuilder
+        val vpnInterface = vpnServiceBuilder
             .setSession(vpnName)
-            .establish()!!
+            .establish()
+        if (vpnInterface == null) {
+            e("unable to establish vpn interface")
+        }
+        return vpnInterface
+    }
+
+    private fun startNativeVpnService(vpnInterface: ParcelFileDescriptor) {
+        val vpnService = vpnService ?: NativeVpnService(createNativeVpnService()).also {
+            it.setSocketProtector(this)
+            vpnService = it
+        }
+        val vpnServiceListener = vpnServiceListener ?: VpnServiceListener(this).also { vpnServiceListener = it }
+        vpnService.initialize(vpnServiceListener.asBinder(), vpnInterface, allowedPackages.toTypedArray(), disallowedPackages.toTypedArray())
+        vpnService.start()
+        vpnService.setStatsInterval(STATS_INTERVAL_MILLIS)
+        vpnPacketSummaries = PacketSummaryReader.map(vpnService.packetSummaries)
+    }
 
-        vpnServiceListener = VpnServiceListener(this)
-        vpnService = IVpnService.Stub.asInterface(createNativeVpnService())
-        vpnService.initialize(vpnServiceListener.asBinder(), vpnInterface)
+    //
+    // Packages that are not installed are left out.  Should none of the
+    // allowed ones be, only this app is tunneled rather than every app.
+    //
+    private fun addApplications(vpnServiceBuilder: Builder, allowedPackages: List<String>, disallowedPackages: List<String>) {
+        var allowedCount = 0
+        for (allowedPackage in allowedPackages) {
+            try {
+                vpnServiceBuilder.addAllowedApplication(allowedPackage)
+                allowedCount++
+            } catch (e: PackageManager.NameNotFoundException) {
+                e(e, "unable to allow package %s", allowedPackage)
+            }
+        }
+        if (allowedPackages.isNotEmpty() && allowedCount == 0) {
+            vpnServiceBuilder.addAllowedApplication(packageName)
+        }
+        for (disallowedPackage in disallowedPackages) {
+            try {
+                vpnServiceBuilder.addDisallowedApplication(disallowedPackage)
+            } catch (e: PackageManager.NameNotFoundException) {
+                e(e, "unable to disallow package %s", disallowedPackage)
+            }
+        }
+    }
+
+    private fun stopNativeVpnService() {
+        val vpnService = vpnService ?: return
+        d("vpn stats\n%s", vpnService.stats)
+        vpnPacketSummaries = null
+        vpnService.stop()
+        vpnService.uninitialize()
+    }
+
+    private fun closeVpnInterface(vpnInterface: ParcelFileDescriptor) {
+        try {
+            vpnInterface.close()
+        } catch (e: IOException) {
+            e(e, "unable to close parcel file descriptor")
+        }
     }
 
     override fun onDestroy() {
@@ -137,6 +424,78 @@ class LocalVpnService : VpnService() {
     private external fun destroyNativeVpnService()
 }
 
+//
+// The native service of this process, called straight through JNI but for
+// initialize() and getPacketSummaries(), which take binder objects and run
+// once; calls cost no transaction, so that stats can be polled often.  The
+// binder is still what asBinder() hands to clients in other processes.
+// Failures throw IllegalArgumentException for bad values and
+// IllegalStateException otherwise, as the binder calls would.
+//
+private class NativeVpnService(binder: IBinder) : IVpnService by IVpnService.Stub.asInterface(binder) {
+
+    //
+    // Protects the sockets of the connections initialized from here on
+    // with the service, called straight from the native threads, in place
+    // of the listener's onSessionCreated(); null goes back to the listener.
+    //
+    fun setSocketProtector(service: VpnService?) = nativeSetSocketProtector(service)
+
+    override fun start() = nativeStart()
+
+    override fun stop() = nativeStop()
+
+    override fun uninitialize() = nativeUninitialize()
+
+    override fun getStats(): String = nativeGetStats()
+
+    override fun setCaptureDirectory(directory: String) = nativeSetCaptureDirectory(directory)
+
+    override fun setCaptureFilter(filter: String): Boolean = nativeSetCaptureFilter(filter)
+
+    override fun setInspectionFilter(filter: String): Boolean = nativeSetInspectionFilter(filter)
+
+    override fun setStatsInterval(intervalMillis: Int) = nativeSetStatsInterval(intervalMillis)
+
+    override fun setThreadPolicy(policy: Int) = nativeSetThreadPolicy(policy)
+
+    override fun setBatching(maxPackets: Int, maxDelayMicros: Int) = nativeSetBatching(maxPackets, maxDelayMicros)
+
+    override fun setOverflowPolicy(queue: String, policy: Int): Boolean = nativeSetOverflowPolicy(queue, policy)
+
+    override fun setFlowLog(path: String, intervalMillis: Int) = nativeSetFlowLog(path, intervalMillis)
+
+    override fun setInspectionBudget(cpuPercent: Int, fullBytes: Int) = nativeSetInspectionBudget(cpuPercent, fullBytes)
+
+    private external fun nativeSetSocketProtector(service: VpnService?)
+
+    private external fun nativeStart()
+
+    private external fun nativeStop()
+
+    private external fun nativeUninitialize()
+
+    private external fun nativeGetStats(): String
+
+    private external fun nativeSetCaptureDirectory(directory: String)
+
+    private external fun nativeSetCaptureFilter(filter: String): Boolean
+
+    private external fun nativeSetInspectionFilter(filter: String): Boolean
+
+    private external fun nativeSetStatsInterval(intervalMillis: Int)
+
+    private external fun nativeSetThreadPolicy(policy: Int)
+
+    private external fun nativeSetBatching(maxPackets: Int, maxDelayMicros: Int)
+
+    private external fun nativeSetOverflowPolicy(queue: String, policy: Int): Boolean
+
+    private external fun nativeSetFlowLog(path: String, intervalMillis: Int)
+
+    private external fun nativeSetInspectionBudget(cpuPercent: Int, fullBytes: Int)
+}
+
 private class VpnServiceListener(val vpnService: VpnService) : IVpnServiceListener.Stub() {
 
     override fun onSessionCreated(socket: Int) {
@@ -147,4 +506,34 @@ private class VpnServiceListener(val vpnService: VpnService) : IVpnServiceListen
     override fun onSessionDestroyed(socket: Int) {
         d("onSessionDestroyed : socket [$socket]")
     }
+
+    override fun getConnectionOwnerUid(
+        protocol: Int,
+        sourceAddress: ByteArray,
+        sourcePort: Int,
+        destinationAddress: ByteArray,
+        destinationPort: Int
+    ): Int {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.Q) {
+            return Process.INVALID_UID
+        }
+        val connectivityManager = vpnService.getSystemService(ConnectivityManager::class.java)
+        return try {
+            connectivityManager.getConnectionOwnerUid(
+                protocol,
+                InetSocketAddress(InetAddress.getByAddress(sourceAddress), sourcePort),
+                InetSocketAddress(InetAddress.getByAddress(destinationAddress), destinationPort)
+            )
+        } catch (e: RuntimeException) {
+            e(e, "unable to get owner of connection")
+            Process.INVALID_UID
+        }
+    }
+
+    override fun getPackageName(uid: Int): String =
+        vpnService.packageManager.getPackagesForUid(uid)?.joinToString(",") ?: ""
+
+    override fun onStats(batch: StatsBatch) {
+        vpnStatsListener?.invoke(batch)
+    }
 }
@@ -0,0 +1,160 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+package com.github.jonforshort.vpn
+
+import android.os.ParcelFileDescriptor
+import java.io.IOException
+import java.net.InetAddress
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.channels.FileChannel
+
+//
+// Summary of a packet of the tunnel, with the IPv4 or IPv6 addresses and
+// the ports of the packet and a timestamp of
+// SystemClock.elapsedRealtimeNanos().
+//
+data class PacketSummary(
+    val timestampNanos: Long,
+    val protocol: Int,
+    val sourceAddress: InetAddress,
+    val sourcePort: Int,
+    val destinationAddress: InetAddress,
+    val destinationPort: Int,
+    val length: Int,
+    val uid: Int,
+    val isToApp: Boolean,
+    val tcpFlags: Int
+)
+
+//
+// Reads the ring of packet summaries the native side writes to shared
+// memory, laid out as PacketSummaryRing describes, without a binder call
+// per packet.  The writer never waits for readers, so records a reader
+// fell too far behind for are skipped and counted.  Each reader keeps its
+// own position and is not thread safe.
+//
+class PacketSummaryReader internal constructor(private val buffer: ByteBuffer) {
+
+    private val capacity = buffer.getInt(CAPACITY_OFFSET)
+    private val recordSize = buffer.getInt(RECORD_SIZE_OFFSET)
+    private val recordsOffset = buffer.getInt(RECORDS_OFFSET_OFFSET)
+    private var next = buffer.getLong(HEAD_OFFSET)
+
+    var skippedRecords = 0L
+        private set
+
+    //
+    // Hands every record written since the last call to onSummary, oldest
+    // first, and returns how many it handed.  Stops at a record still being
+    // written, which the next call picks up.
+    //
+    fun read(onSummary: (PacketSummary) -> Unit): Int {
+        val head = buffer.getLong(HEAD_OFFSET)
+        if (head - next > capacity) {
+            skippedRecords += head - capacity - next
+            next = head - capacity
+        }
+        var count = 0
+        while (next < head) {
+            val offset = recordsOffset + (next and (capacity - 1).toLong()).toInt() * recordSize
+            val sequence = buffer.getLong(offset)
+            if (sequence < next + 1) {
+                break
+            }
+            val summary = readRecord(offset)
+            if (sequence == next + 1 && buffer.getLong(offset) == sequence) {
+                onSummary(summary)
+                count++
+            } else {
+                skippedRecords++
+            }
+            next++
+        }
+        return count
+    }
+
+    private fun readRecord(offset: Int): PacketSummary {
+        val flags = buffer.get(offset + 61).toInt()
+        return PacketSummary(
+            timestampNanos = buffer.getLong(offset + 8),
+            protocol = buffer.get(offset + 60).toInt() and 0xff,
+            sourceAddress = readAddress(offset + 16),
+            sourcePort = buffer.getShort(offset + 48).toInt() and 0xffff,
+            destinationAddress = readAddress(offset + 32),
+            destinationPort = buffer.getShort(offset + 50).toInt() and 0xffff,
+            length = buffer.getInt(offset + 52),
+            uid = buffer.getInt(offset + 56),
+            isToApp = (flags and TO_APP) != 0,
+            tcpFlags = buffer.get(offset + 62).toInt() and 0xff
+        )
+    }
+
+    //
+    // Address as IpAddress lays it out, which getByAddress() turns into an
+    // Inet4Address when it is a mapped IPv4 one.
+    //
+    private fun readAddress(offset: Int): InetAddress {
+        val bytes = ByteArray(ADDRESS_SIZE)
+        for (i in bytes.indices) {
+            bytes[i] = buffer.get(offset + i)
+        }
+        return InetAddress.getByAddress(bytes)
+    }
+
+    companion object {
+        private const val MAGIC = 0x534E5056
+        private const val VERSION = 2
+        private const val TO_APP = 1
+        private const val ADDRESS_SIZE = 16
+
+        private const val MAGIC_OFFSET = 0
+        private const val VERSION_OFFSET = 4
+        private const val RECORD_SIZE_OFFSET = 8
+        private const val CAPACITY_OFFSET = 12
+        private const val RECORDS_OFFSET_OFFSET = 16
+        private const val HEAD_OFFSET = 64
+        private const val HEADER_SIZE = 128L
+
+        //
+        // Maps the shared memory of the descriptor, which it closes, null if
+        // it is not a ring of packet summaries this reader knows.  Readers
+        // take a duplicate of the buffer each.
+        //
+        internal fun map(descriptor: ParcelFileDescriptor): ByteBuffer? = try {
+            ParcelFileDescriptor.AutoCloseInputStream(descriptor).channel.use { channel ->
+                val header = channel.map(FileChannel.MapMode.READ_ONLY, 0, HEADER_SIZE).order(ByteOrder.nativeOrder())
+                if (header.getInt(MAGIC_OFFSET) != MAGIC || header.getInt(VERSION_OFFSET) != VERSION) {
+                    null
+                } else {
+                    val size = header.getInt(RECORDS_OFFSET_OFFSET).toLong() +
+                            header.getInt(CAPACITY_OFFSET).toLong() * header.getInt(RECORD_SIZE_OFFSET)
+                    channel.map(FileChannel.MapMode.READ_ONLY, 0, size).order(ByteOrder.nativeOrder())
+                }
+            }
+        } catch (e: IOException) {
+            null
+        }
+    }
+}
@@ -2,8 +2,8 @@ import { Component, ViewChild } from '@angular/core'
 import { MatTable } from '@angular/material/table'
 import { MatTabGroup, MatTab } from '@angular/material/tabs';
 import { MatDialog, MatDialogConfig } from "@angular/material/dialog";
-import { combineLatest } from 'rxjs';
-import { WasmService } from './wasm.service'
+import { combineLatest, Subscription } from 'rxjs';
+import { ApkProperties, WasmService } from './wasm.service'
 import { LogService } from './log/log.service'
 import { TelemetryService } from './telemetry/telemetry.service'
 import { ExportApkDialogComponent } from './export-apk-dialog/export-apk-dialog.component';
@@ -28,6 +28,10 @@ export class AppComponent {
 
   loadedApkFile: File
 
+  loadedApk: any
+
+  prefetchSubscription: Subscription
+
   isApkValid: boolean = false;
 
   contents: ContentElement[] = [];
@@ -95,67 +99,61 @@ export class AppComponent {
   private handleFileInput(file: File) {
     this.logger.log(`handleFileInput: loading apk file [${file.name}]`)
 
-    this.wasm.deleteDataFile(file.name).subscribe((isDeleted) => {
-      this.wasm.readFile(file).subscribe((fileContent) => {
-        this.wasm.createDataFile(file.name, fileContent).subscribe((filePath) => {
-          this.wasm.isApkValid(filePath).subscribe((isApkValid) => {
-
-            this.logger.log(`handleFileInput: loaded apk file is valid [${isApkValid}]`)
-
-            this.isApkValid = isApkValid
-            if (this.isApkValid) {
-              combineLatest([
-                this.wasm.getFilePathsInApk(filePath),
-                this.wasm.getApkProperties(filePath)
-              ]).subscribe(([filePaths, properties]) => {
-                this.updateApkContents(filePaths);
-                this.updateApkProperties(properties);
-                this.updateTableState()
-                this.sendApkLoadedTelemetry(properties)
-
-                this.logger.log(`handleFileInput: completed loading apk file [${file.name}]`)
-
-                this.loadedApkFile = file
-              })
-            }
+    if (this.prefetchSubscription !== undefined) {
+      this.prefetchSubscription.unsubscribe()
+      this.prefetchSubscription = undefined
+    }
+    if (this.loadedApk !== undefined) {
+      this.wasm.closeApk(this.loadedApk)
+      this.loadedApk = undefined
+    }
+
+    this.wasm.openApkBuffer(file).subscribe((apk) => {
+      this.loadedApk = apk
+      this.wasm.isApkValid(apk).subscribe((isApkValid) => {
+
+        this.logger.log(`handleFileInput: loaded apk file is valid [${isApkValid}]`)
+
+        this.isApkValid = isApkValid
+        if (this.isApkValid) {
+          combineLatest([
+            this.wasm.getFilePathsInApk(apk),
+            this.wasm.getApkProperties(apk)
+          ]).subscribe(([filePaths, properties]) => {
+            this.updateApkContents(filePaths);
+            this.updateApkProperties(properties);
+            this.updateTableState()
+            this.sendApkLoadedTelemetry(properties)
+
+            this.logger.log(`handleFileInput: completed loading apk file [${file.name}]`)
+
+            this.loadedApkFile = file
+
+            this.prefetchSubscription = this.wasm.prefetchLikelyNextFiles(apk).subscribe(
+              (path) => this.logger.log(`handleFileInput: prefetched [${path}]`),
+              (error) => this.logger.log(`handleFileInput: unable to prefetch, ${error}`))
           })
-        })
+        }
       })
     })
   }
 
-  private updateApkContents(filePaths) {
-    this.contents = []
-    for (var i = 0; i < filePaths.size(); i++) {
-      this.contents.push({ path: filePaths.get(i), type: "txt" })
-    }
+  private updateApkContents(filePaths: string[]) {
+    this.contents = filePaths.map(path => ({ path: path, type: "txt" }))
   }
 
-  private updateApkProperties(properties) {
+  private updateApkProperties(properties: ApkProperties) {
     this.properties = []
-    const propertiesKeys = properties.keys()
-    for (var i = 0; i < propertiesKeys.size(); i++) {
-      const key = propertiesKeys.get(i)
-      const value = properties.get(key)
-      if (key === "manifest") {
-        this.androidManifest = value
-      } else {
-        this.properties.push({ key: key, value: value })
+    this.androidManifest = properties.manifest
+    for (const [key, value] of Object.entries(properties)) {
+      if (key !== "manifest") {
+        this.properties.push({ key: key, value: String(value) })
       }
     }
   }
 
-  private sendApkLoadedTelemetry(properties) {
-    const eventParams = {}
-    const propertiesKeys = properties.keys()
-    for (var i = 0; i < propertiesKeys.size(); i++) {
-      const key = propertiesKeys.get(i)
-      const value = properties.get(key)
-      if (key === "manifest") {
-        continue
-      }
-      eventParams[key] = value
-    }
+  private sendApkLoadedTelemetry(properties: ApkProperties) {
+    const { manifest, ...eventParams } = properties
     this.telemetry.logEvent("apk_loaded", eventParams)
   }
 }
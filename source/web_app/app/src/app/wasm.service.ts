@@ -1,8 +1,91 @@
 import { Injectable } from '@angular/core'
-import { Observable, BehaviorSubject } from 'rxjs'
-import { filter, map } from 'rxjs/operators'
+import { from, Observable, BehaviorSubject, Subscriber } from 'rxjs'
+import { filter, map, mergeMap } from 'rxjs/operators'
 
 import * as Module from './../assets/js/wasm/wasm.wasm.js'
+import * as SimdModule from './../assets/js/wasm/wasm-simd.wasm.js'
+import * as ThreadedModule from './../assets/js/wasm/wasm-threads.wasm.js'
+import * as WasmWorkerPool from './../assets/js/wasm/worker-pool.js'
+
+const WASM_DIRECTORY = '/assets/js/wasm/'
+
+/**
+ * Smallest module with a SIMD instruction, which only validates where the
+ * browser supports 128-bit SIMD.
+ */
+const SIMD_PROBE = new Uint8Array([
+  0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+])
+
+/**
+ * Smallest module with a try block, which only validates where the browser
+ * supports native exception handling.
+ */
+const EXCEPTIONS_PROBE = new Uint8Array([
+  0, 97, 115, 109, 1, 0, 0, 0, 1, 4, 1, 96, 0, 0, 3, 2, 1, 0, 10, 8, 1, 6, 0, 6, 64, 25, 11, 11
+])
+
+/**
+ * Longest a sliced call of the module runs before going back to the event
+ * loop, see runSliced().
+ */
+const SLICE_MILLISECONDS = 12
+
+/**
+ * Apks of a batch that are read into memory ahead of a free worker, per
+ * worker; see runBatch().
+ */
+const BATCH_READ_AHEAD = 2
+
+/**
+ * Most paths getFilePage() of the module hands out at once, which is every
+ * path of an apk.
+ */
+const ALL_FILES = 0xffffffff
+
+const UTF8_DECODER = new TextDecoder()
+
+/**
+ * Properties of an apk as the module hands them over, all at once; fields
+ * that were not asked for are empty.
+ */
+export interface ApkProperties {
+  valid: boolean
+  packageName: string
+  versionCode: number
+  versionName: string
+  debuggable: boolean
+  manifest: string
+  sha256: string
+}
+
+/**
+ * Paths of an apk from the offset of a getFilePageInApk() on, and how many
+ * paths the filter keeps in all.
+ */
+export interface FilePage {
+  total: number
+  paths: string[]
+}
+
+/**
+ * A file extracted by a batch, its bytes transferred from the worker.
+ */
+export interface ExtractedFile {
+  path: string
+  bytes: Uint8Array
+}
+
+/**
+ * Manifest as the module renders it for display.  Elements are in document
+ * order, each the name, the index of the parent element (-1 for the root),
+ * then the name and value of every attribute; names and values are indexes
+ * into strings.
+ */
+export interface ManifestTree {
+  elements: number[][]
+  strings: string[]
+}
 
 @Injectable()
 export class WasmService {
@@ -10,42 +93,346 @@ export class WasmService {
 
   wasmReady = new BehaviorSubject<boolean>(false)
 
+  /**
+   * Build the worker pool loads, and the pool once a batch started it.
+   */
+  private batchBuild = 'wasm'
+
+  private workerPool: Promise<any> | null = null
+
   constructor() {
-    this.instantiateWasm('/assets/js/wasm/wasm.wasm.wasm')
+    this.instantiateWasm()
   }
 
-  private async instantiateWasm(url: string) {
-    const wasmFile = await fetch(url)
-    const buffer = await wasmFile.arrayBuffer()
-    const binary = new Uint8Array(buffer)
-    const moduleArgs = { wasmBinary: binary }
-    Module(moduleArgs).then((result: Module) =>
-      this.module = result,
+  /**
+   * Loads the fastest build the browser can run.  The threaded build needs
+   * SharedArrayBuffer, which browsers only offer to pages served cross
+   * origin isolated (COOP and COEP headers), and is built with SIMD and
+   * native exceptions like the SIMD build; the baseline build, with emulated
+   * exceptions, runs everywhere else.
+   */
+  private async instantiateWasm() {
+    const hasSimd = WebAssembly.validate(SIMD_PROBE) && WebAssembly.validate(EXCEPTIONS_PROBE)
+    const isThreaded = hasSimd && (self as any).crossOriginIsolated === true
+    const name = isThreaded ? 'wasm-threads' : hasSimd ? 'wasm-simd' : 'wasm'
+    this.batchBuild = hasSimd ? 'wasm-simd' : 'wasm'
+    const wasmUrl = WASM_DIRECTORY + name + '.wasm.wasm'
+    const moduleArgs = {
+      instantiateWasm: (imports: any, onInstantiated: (instance: WebAssembly.Instance, module: WebAssembly.Module) => void) => {
+        this.compileWasm(wasmUrl)
+          .then(module => WebAssembly.instantiate(module, imports).then(instance => onInstantiated(instance, module)))
+        return {}
+      },
+      locateFile: (path: string) => WASM_DIRECTORY + path,
+      mainScriptUrlOrBlob: WASM_DIRECTORY + name + '.wasm.js'
+    }
+    const instantiate = isThreaded ? ThreadedModule : hasSimd ? SimdModule : Module
+    instantiate(moduleArgs).then((result: Module) => {
+      this.module = result
       this.wasmReady.next(true)
-    )
+    })
+  }
+
+  /**
+   * Compiles the module while it downloads.  Browsers keep the code compiled
+   * from a streamed response next to it in the HTTP cache, so later visits
+   * skip both the download and the compilation.  Servers that do not send
+   * application/wasm get the module compiled after the download instead.
+   */
+  private async compileWasm(url: string): Promise<WebAssembly.Module> {
+    try {
+      return await WebAssembly.compileStreaming(fetch(url))
+    } catch (error) {
+      const response = await fetch(url)
+      return WebAssembly.compile(await response.arrayBuffer())
+    }
+  }
+
+  /**
+   * Workers with a module instance each, started by the first batch.  They
+   * load a build without threads whatever the page runs: the pool is how
+   * batches use every core where SharedArrayBuffer is not available, and a
+   * threaded build could not start in them there.
+   */
+  private getWorkerPool(): Promise<any> {
+    if (this.workerPool === null) {
+      const loaderUrl = WASM_DIRECTORY + this.batchBuild + '.wasm.js'
+      this.workerPool = this.compileWasm(WASM_DIRECTORY + this.batchBuild + '.wasm.wasm')
+        .then(module => new WasmWorkerPool({ workerUrl: WASM_DIRECTORY + 'apk-worker.js', loaderUrl, module }))
+    }
+    return this.workerPool
+  }
+
+  /**
+   * Runs the job on every apk of the batch on the worker pool, and emits
+   * the index of the apk with the result as jobs complete, in any order.
+   * Apks are read shortly before a worker is free, so a large batch is
+   * never in memory at once; buffers are copied to the workers, so they
+   * stay usable.  See worker-pool.js for the jobs.
+   */
+  public runBatch<T>(apks: (ArrayBuffer | Blob)[], job: { type: string, [key: string]: any }): Observable<[number, T]> {
+    return from(this.getWorkerPool())
+      .pipe(mergeMap(pool => from(apks.map((apk, index): [ArrayBuffer | Blob, number] => [apk, index]))
+        .pipe(mergeMap(async ([apk, index]): Promise<[number, T]> => {
+          const buffer = apk instanceof Blob ? await apk.arrayBuffer() : apk.slice(0)
+          return [index, await pool.run({ ...job, buffer })]
+        }, pool.workers.length * BATCH_READ_AHEAD))))
+  }
+
+  /**
+   * Package and version of every apk of the batch, see runBatch().
+   */
+  public getApkSummaries(apks: (ArrayBuffer | Blob)[]): Observable<[number, ApkProperties]> {
+    return this.runBatch<ApkProperties>(apks, { type: 'summary' })
+  }
+
+  /**
+   * Files of every apk of the batch the filter keeps, see runBatch() and
+   * extractFilesInApk() for the filter.
+   */
+  public extractFilesInApks(apks: (ArrayBuffer | Blob)[], pathFilter: string): Observable<[number, ExtractedFile[]]> {
+    return this.runBatch<ExtractedFile[]>(apks, { type: 'extract', filter: pathFilter })
+  }
+
+  /**
+   * Opens the apk at the path in MEMFS.  The handle keeps the apk open, with
+   * everything parsed from it, until closeApk().
+   */
+  public openApk(filePath: String): Observable<any> {
+    return this.wasmReady
+      .pipe(filter(value => value === true))
+      .pipe(map(() => {
+        return this.module.Apk.open(filePath)
+      }))
+  }
+
+  /**
+   * Same as openApk(), but copies the apk straight onto the wasm heap,
+   * without a MEMFS file.
+   */
+  public openApkBuffer(contents: ArrayBuffer | Blob): Observable<any> {
+    return this.wasmReady
+      .pipe(filter(value => value === true))
+      .pipe(mergeMap(async () => {
+        const buffer = contents instanceof Blob ? await contents.arrayBuffer() : contents
+        this.module.allocateApkBuffer(buffer.byteLength).set(new Uint8Array(buffer))
+        return this.module.Apk.openBuffer()
+      }))
+  }
+
+  /**
+   * Whether analyses outlive the page: the threaded build keeps them in the
+   * Origin Private File System, so an apk opened again in a later visit is
+   * not parsed again.
+   */
+  public isCachePersistent(): Observable<boolean> {
+    return this.wasmReady
+      .pipe(filter(value => value === true))
+      .pipe(map(() => {
+        return this.module.isCachePersistent()
+      }))
+  }
+
+  public closeApk(apk: any) {
+    apk.delete()
+  }
+
+  /**
+   * Bounds what the module inflates and parses for the apk, in bytes; 0 for
+   * no limit.  Calls going over it throw, see getErrorMessage().
+   */
+  public setApkMemoryBudget(apk: any, bytes: number) {
+    apk.setMemoryBudget(bytes)
+  }
+
+  /**
+   * Message of an error thrown by a call into the module, e.g. of a memory
+   * budget that was exceeded.
+   */
+  public getErrorMessage(error: any): string {
+    if (error instanceof Error) {
+      return error.message
+    }
+    const [type, message] = this.module.getExceptionMessage(error)
+    return message ? `${type}: ${message}` : type
+  }
+
+  public isApkValid(apk: any): Observable<boolean> {
+    return this.wasmReady
+      .pipe(filter(value => value === true))
+      .pipe(map(() => {
+        return apk.isValid()
+      }))
+  }
+
+  public getFilePathsInApk(apk: any): Observable<string[]> {
+    return this.getFilePageInApk(apk, 0, ALL_FILES).pipe(map(page => page.paths))
+  }
+
+  /**
+   * Up to limit of the paths the filter keeps, from the offset-th on, for a
+   * list that only shows some rows.  The paths cross from the module packed
+   * in one buffer.  The filter is a glob when it has '*' or '?' and a
+   * substring otherwise.
+   */
+  public getFilePageInApk(apk: any, offset: number, limit: number, pathFilter: string = ''): Observable<FilePage> {
+    return this.wasmReady
+      .pipe(filter(value => value === true))
+      .pipe(map(() => {
+        const page = apk.getFilePage(offset, limit, pathFilter)
+        const paths = []
+        for (let i = 0; i + 1 < page.offsets.length; i++) {
+          // A copy, as the decoder does not take views of a shared heap.
+          paths.push(UTF8_DECODER.decode(page.names.slice(page.offsets[i], page.offsets[i + 1])))
+        }
+        return { total: page.total, paths: paths }
+      }))
+  }
+
+  public getApkProperties(apk: any): Observable<ApkProperties> {
+    return this.wasmReady
+      .pipe(filter(value => value === true))
+      .pipe(map(() => {
+        return apk.getProperties()
+      }))
   }
 
-  public isApkValid(filePath: String): Observable<boolean> {
+  /**
+   * The manifest as a tree of elements, parsed from JSON rather than from
+   * the xml text.
+   */
+  public getAndroidManifestTree(apk: any): Observable<ManifestTree> {
     return this.wasmReady
       .pipe(filter(value => value === true))
       .pipe(map(() => {
-        return this.module.isValid(filePath)
+        return JSON.parse(apk.getAndroidManifestTree())
       }))
   }
 
-  public getFilePathsInApk(filePath: String): Observable<any> {
+  /**
+   * Same as getFilePathsInApk(), but emits the paths in pages as they are
+   * converted, so a listing can start rendering with the first page.
+   */
+  public getFilePagesInApk(apk: any, pageSize: number): Observable<string[]> {
+    return this.runSliced(observer => apk.startFilePages(pageSize, (page: string[]) => observer.next(page)))
+  }
+
+  /**
+   * Emits the manifest text in chunks as it is rendered.
+   */
+  public getAndroidManifestChunks(apk: any): Observable<string> {
+    return this.runSliced(observer => apk.startAndroidManifestChunks((chunk: string) => observer.next(chunk)))
+  }
+
+  /**
+   * Hands the path and bytes of every file the filter keeps to read, one
+   * file at a time, and emits what it returns; see readFileInApk() for the
+   * bytes.  The filter is a glob when it has '*' or '?' and a substring
+   * otherwise.
+   */
+  public extractFilesInApk<T>(apk: any, pathFilter: string, read: (path: string, bytes: Uint8Array) => T): Observable<T> {
+    return this.runSliced(observer => apk.startExtract(pathFilter, (path: string, bytes: Uint8Array) => observer.next(read(path, bytes))))
+  }
+
+  /**
+   * Loads the ProGuard or R8 mapping.txt at the path in MEMFS, e.g. one of
+   * createDataFile(), so that the apk shows the original names of classes.
+   */
+  public loadMappingOfApk(apk: any, mappingPath: String): Observable<void> {
+    return this.wasmReady
+      .pipe(filter(value => value === true))
+      .pipe(map(() => {
+        apk.loadMapping(mappingPath)
+      }))
+  }
+
+  /**
+   * Emits the class descriptor, smali text and Java name of every class of
+   * the apk, the name being the original one when a mapping is loaded.
+   */
+  public disassembleApk(apk: any): Observable<[string, string, string]> {
+    return this.runSliced(observer => apk.startDisassemble((descriptor: string, smali: string, className: string) => observer.next([descriptor, smali, className])))
+  }
+
+  /**
+   * Reads the files a user is likely to open next, e.g. the layout of the
+   * launcher activity, into the session of the apk while the page is idle,
+   * and emits the path of every file that is ready; reading them later
+   * takes no inflating.  Unsubscribe before the apk is closed.
+   */
+  public prefetchLikelyNextFiles(apk: any): Observable<string> {
+    return this.runSliced(observer => apk.startPrefetch((path: string) => observer.next(path)), true)
+  }
+
+  /**
+   * Runs a call that the module cut into steps, see SlicedCall, for at most
+   * SLICE_MILLISECONDS at a time and goes back to the event loop in between,
+   * so that without threads other requests, small ones in particular, get
+   * to run before a large call is done.  Calls run when idle only resume
+   * when the browser has nothing else to do, for as long as it has time
+   * left.  Unsubscribing ends the call at the next slice.
+   */
+  private runSliced<T>(start: (observer: Subscriber<T>) => any, whenIdle = false): Observable<T> {
+    return this.wasmReady
+      .pipe(filter(value => value === true))
+      .pipe(mergeMap(() => new Observable<T>(observer => {
+        const call = start(observer)
+        let cancel = () => {}
+        const schedule = () => {
+          const idleWindow = window as any
+          if (whenIdle && typeof idleWindow.requestIdleCallback === 'function') {
+            const handle = idleWindow.requestIdleCallback((deadline: any) => resume(Math.max(1, Math.min(deadline.timeRemaining(), SLICE_MILLISECONDS))))
+            cancel = () => idleWindow.cancelIdleCallback(handle)
+          } else {
+            const timeout = setTimeout(() => resume(SLICE_MILLISECONDS))
+            cancel = () => clearTimeout(timeout)
+          }
+        }
+        const resume = (budgetMilliseconds: number) => {
+          try {
+            if (call.resume(budgetMilliseconds)) {
+              observer.complete()
+              return
+            }
+          } catch (error) {
+            observer.error(error)
+            return
+          }
+          schedule()
+        }
+        schedule()
+        return () => {
+          cancel()
+          call.delete()
+        }
+      })))
+  }
+
+  /**
+   * Same as getApkProperties(), calling onProgress with the bytes hashed so
+   * far while the apk is hashed.
+   */
+  public getApkPropertiesWithProgress(apk: any, onProgress: (bytesProcessed: number, bytesTotal: number) => void): Observable<ApkProperties> {
     return this.wasmReady
       .pipe(filter(value => value === true))
       .pipe(map(() => {
-        return this.module.getFiles(filePath)
+        return apk.getPropertiesWithProgress(onProgress)
       }))
   }
 
-  public getApkProperties(filePath: String): Observable<any> {
+  /**
+   * Hands the bytes of a file in the apk to read, as a view of the wasm
+   * heap that is released right after; read must copy what it keeps.
+   */
+  public readFileInApk<T>(apk: any, pathInApk: String, read: (bytes: Uint8Array) => T): Observable<T> {
     return this.wasmReady
       .pipe(filter(value => value === true))
       .pipe(map(() => {
-        return this.module.getProperties(filePath)
+        try {
+          return read(apk.getFileContent(pathInApk))
+        } finally {
+          apk.releaseFileContent()
+        }
       }))
   }
 
@@ -1,2 +1,92 @@
 set(MY_CXX_FLAGS_DEBUG "${MY_CXX_FLAGS_DEBUG}")
 set(MY_CXX_FLAGS_RELEASE "${MY_CXX_FLAGS_RELEASE}")
+
+#
+# Exceptions are caught in every Wasm build.  Native Wasm exceptions cost
+# nothing until one is thrown, unlike the JS based emulation, which wraps
+# every call that may throw; every C++ object has to agree on which one is
+# used.  Only debug builds carry the code and names that EXCEPTION_DEBUG
+# reports emulated exceptions with.
+#
+if (WASM AND WASM_NATIVE_EXCEPTIONS)
+  set(WASM_EXCEPTION_FLAGS "-fwasm-exceptions")
+  set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fwasm-exceptions")
+elseif (WASM)
+  set(WASM_EXCEPTION_FLAGS "-s DISABLE_EXCEPTION_CATCHING=0")
+  if (NOT CMAKE_BUILD_TYPE STREQUAL "Release")
+    set(WASM_EXCEPTION_FLAGS "${WASM_EXCEPTION_FLAGS} -s EXCEPTION_DEBUG=1")
+  endif ()
+endif ()
+
+#
+# Wasm variant with pthreads on SharedArrayBuffer; every object, externals
+# included, has to be built with atomics for the module to link.
+#
+if (WASM AND WASM_THREADS)
+  set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -pthread")
+  set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -pthread")
+endif ()
+
+#
+# Wasm variant with 128-bit SIMD, which the hex, CRC32, UTF-16 and inflate
+# loops are vectorized with; the loader falls back to the baseline module
+# where the browser lacks it.
+#
+if (WASM AND WASM_SIMD)
+  set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -msimd128")
+  set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -msimd128")
+endif ()
+
+#
+# Host variant for the libFuzzer targets, built with clang.  Every object
+# gets the coverage instrumentation that guides libFuzzer, and ASan and
+# UBSan, so that memory errors are found along with blowups.
+#
+if (FUZZ AND NOT WASM)
+  set(FUZZ_FLAGS "-fsanitize=fuzzer-no-link,address,undefined")
+  set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${FUZZ_FLAGS}")
+  set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${FUZZ_FLAGS}")
+endif ()
+
+#
+# Profile guided host builds, in two passes in the same build directory:
+# PGO_GENERATE instruments every object and adds the pgo_training target,
+# which runs the CLI over a training corpus, and PGO_USE rebuilds with the
+# profiles it left in PGO_PROFILE_DIRECTORY.  dev/scripts/env.sh has both
+# passes as ai_build_wasm_host_pgo.
+#
+if (NOT WASM AND (PGO_GENERATE OR PGO_USE))
+  if (NOT PGO_PROFILE_DIRECTORY)
+    set(PGO_PROFILE_DIRECTORY ${CMAKE_BINARY_DIR}/pgo-profiles)
+  endif ()
+  if (PGO_GENERATE)
+    set(PGO_FLAGS "-fprofile-generate=${PGO_PROFILE_DIRECTORY}")
+  elseif (CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+    set(PGO_FLAGS "-fprofile-use=${PGO_PROFILE_DIRECTORY}/default.profdata -Wno-profile-instr-unprofiled")
+  else ()
+    #
+    # Objects the training never reaches, e.g. of externals, are still
+    # optimized for speed rather than taken as cold.
+    #
+    set(PGO_FLAGS "-fprofile-use=${PGO_PROFILE_DIRECTORY} -fprofile-partial-training -Wno-missing-profile")
+  endif ()
+  set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${PGO_FLAGS}")
+  set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${PGO_FLAGS}")
+  set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} ${PGO_FLAGS}")
+  set(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} ${PGO_FLAGS}")
+endif ()
+
+#
+# Link time optimization of every target, ThinLTO with clang and the LTO
+# the toolchain has otherwise, emcc and GCC included.  Builds where it is
+# not supported go on without it.
+#
+if (LTO)
+  include(CheckIPOSupported)
+  check_ipo_supported(RESULT LTO_SUPPORTED OUTPUT LTO_OUTPUT LANGUAGES C CXX)
+  if (LTO_SUPPORTED)
+    set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+  else ()
+    message(WARNING "LTO is not supported: ${LTO_OUTPUT}")
+  endif ()
+endif ()
@@ -1,5 +1,22 @@
-if (WASM)
+#
+# Browsers that can run the threaded variant also have SIMD, and it is only
+# loaded where they do, so it is always built with SIMD.  Both are only
+# loaded where native exception handling is supported too, so they use it
+# instead of the JS based emulation.
+#
+if (WASM AND WASM_THREADS)
+  set(WASM_SIMD True)
+  set(WASM_NATIVE_EXCEPTIONS True)
+  set(MY_TARGET "wasm-threads")
+elseif (WASM AND WASM_SIMD)
+  set(WASM_NATIVE_EXCEPTIONS True)
+  set(MY_TARGET "wasm-simd")
+elseif (WASM)
   set(MY_TARGET "wasm")
+elseif (FUZZ)
+  set(MY_TARGET "host-fuzz")
+elseif (PGO_GENERATE OR PGO_USE)
+  set(MY_TARGET "host-pgo")
 else ()
   set(MY_TARGET "host")
 endif ()
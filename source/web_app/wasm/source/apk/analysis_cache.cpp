@@ -0,0 +1,374 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include "analysis_cache.h"
+#include "utils/crc32.h"
+#include "utils/data_stream.h"
+#include "utils/format.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+
+using namespace ai;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+//
+// "AIAC"
+//
+static constexpr uint32_t RECORD_MAGIC = 0x43414941;
+
+static constexpr uint16_t RECORD_VERSION = 1;
+
+//
+// "AIAD"
+//
+static constexpr uint32_t DATA_RECORD_MAGIC = 0x44414941;
+
+static constexpr uint16_t DATA_RECORD_VERSION = 1;
+
+//
+// "AISI"
+//
+static constexpr uint32_t SCAN_INDEX_MAGIC = 0x49534941;
+
+static constexpr uint16_t SCAN_INDEX_VERSION = 1;
+
+//
+// Digest the shared data is filed under, never one of an APK in practice.
+//
+static constexpr uint64_t SHARED_DIGEST = 0;
+
+static constexpr char const *const RECORD_EXTENSION = ".aic";
+
+static constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+
+static constexpr uint64_t FNV_PRIME = 0x100000001b3;
+
+using ai::utils::little_endian::append;
+
+auto appendString(std::vector<std::byte> &bytes, std::string_view const string) -> void {
+  append(bytes, static_cast<uint32_t>(string.size()));
+  auto const data = reinterpret_cast<std::byte const *>(string.data());
+  bytes.insert(bytes.end(), data, data + string.size());
+}
+
+auto readString(DataStream &stream, std::span<std::byte const> const record) -> std::string {
+  auto const size = stream.read<uint32_t>();
+  stream.require(size);
+  auto const data = reinterpret_cast<char const *>(record.data() + stream.position());
+  stream.skip(size);
+  return std::string(data, size);
+}
+
+//
+// Splits the trailing CRC-32 off a record, throwing if it does not match.
+//
+auto checkRecord(std::span<std::byte const> const record) -> std::span<std::byte const> {
+  if (record.size() < sizeof(uint32_t)) {
+    throw std::logic_error("truncated analysis record");
+  }
+  auto const contents = record.first(record.size() - sizeof(uint32_t));
+  auto crc = uint32_t{0};
+  memcpy(&crc, record.data() + contents.size(), sizeof(crc));
+  if (utils::crc32::update(0, contents) != crc) {
+    throw std::logic_error("corrupt analysis record");
+  }
+  return contents;
+}
+
+auto isValidDataName(std::string_view const name) -> bool {
+  return !name.empty() && std::all_of(name.begin(), name.end(), [](char const c) { return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-'; });
+}
+
+auto readFile(std::string const &path) -> std::optional<std::vector<char>> {
+  auto file = std::ifstream(path, std::ios::in | std::ios::binary);
+  if (!file.good()) {
+    return std::nullopt;
+  }
+  return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+//
+// Writes through a temporary file next to path, so concurrent readers never
+// see a partial record.
+//
+auto writeFile(std::string const &path, std::span<std::byte const> const record) -> void {
+  auto error = std::error_code();
+  fs::create_directories(fs::path(path).parent_path(), error);
+  auto const temporaryPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+  {
+    auto file = std::ofstream(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const *>(record.data()), static_cast<std::streamsize>(record.size()));
+    if (!file.good()) {
+      LOGW("write, unable to write [{}]", temporaryPath);
+      fs::remove(temporaryPath, error);
+      return;
+    }
+  }
+  fs::rename(temporaryPath, path, error);
+  if (error) {
+    LOGW("write, unable to write [{}], {}", path, error.message());
+    fs::remove(temporaryPath, error);
+  }
+}
+
+template <typename T> auto hash(uint64_t digest, T const value) -> uint64_t {
+  auto const data = reinterpret_cast<unsigned char const *>(&value);
+  for (std::size_t i{0}; i < sizeof(value); i++) {
+    digest = (digest ^ data[i]) * FNV_PRIME;
+  }
+  return digest;
+}
+
+} // namespace
+
+auto ai::encodeAnalysis(ApkAnalysis const &analysis) -> std::vector<std::byte> {
+  auto record = std::vector<std::byte>();
+  append(record, RECORD_MAGIC);
+  append(record, RECORD_VERSION);
+  append(record, uint16_t{0});
+  append(record, analysis.digest);
+
+  append(record, static_cast<uint32_t>(analysis.entries.size()));
+  for (auto const &entry : analysis.entries) {
+    appendString(record, entry.path);
+    append(record, entry.centralDirectoryOffset);
+    append(record, entry.localHeaderOffset);
+    append(record, entry.compressedSize);
+    append(record, entry.uncompressedSize);
+    append(record, entry.crc);
+    append(record, entry.compressionMethod);
+  }
+
+  append(record, static_cast<uint32_t>(analysis.properties.size()));
+  for (auto const &[name, value] : analysis.properties) {
+    appendString(record, name);
+    appendString(record, value);
+  }
+  append(record, utils::crc32::update(0, record));
+  return record;
+}
+
+auto ai::decodeAnalysis(std::span<std::byte const> const record) -> ApkAnalysis {
+  auto const contents = checkRecord(record);
+  auto stream = DataStream(contents);
+  if (stream.read<uint32_t>() != RECORD_MAGIC || stream.read<uint16_t>() != RECORD_VERSION) {
+    throw std::logic_error("unsupported analysis record");
+  }
+  stream.skip(sizeof(uint16_t));
+
+  auto analysis = ApkAnalysis();
+  analysis.digest = stream.read<uint64_t>();
+  auto const entryCount = stream.read<uint32_t>();
+  for (auto i{0U}; i < entryCount; i++) {
+    auto entry = ZipEntry();
+    entry.path = readString(stream, contents);
+    entry.centralDirectoryOffset = stream.read<uint64_t>();
+    entry.localHeaderOffset = stream.read<uint64_t>();
+    entry.compressedSize = stream.read<uint64_t>();
+    entry.uncompressedSize = stream.read<uint64_t>();
+    entry.crc = stream.read<uint32_t>();
+    entry.compressionMethod = stream.read<uint16_t>();
+    analysis.entries.push_back(std::move(entry));
+  }
+  auto const propertyCount = stream.read<uint32_t>();
+  for (auto i{0U}; i < propertyCount; i++) {
+    auto name = readString(stream, contents);
+    analysis.properties.emplace(std::move(name), readString(stream, contents));
+  }
+  return analysis;
+}
+
+auto ai::loadScanIndex(std::string const &path) -> std::vector<ApkScanRecord> {
+  auto const contents = readFile(path);
+  if (!contents) {
+    return {};
+  }
+  try {
+    auto const record = checkRecord(std::as_bytes(std::span(*contents)));
+    auto stream = DataStream(record);
+    if (stream.read<uint32_t>() != SCAN_INDEX_MAGIC || stream.read<uint16_t>() != SCAN_INDEX_VERSION) {
+      throw std::logic_error("unsupported scan index");
+    }
+    stream.skip(sizeof(uint16_t));
+
+    auto records = std::vector<ApkScanRecord>();
+    auto const recordCount = stream.read<uint32_t>();
+    for (auto i{0U}; i < recordCount; i++) {
+      auto &scanRecord = records.emplace_back();
+      scanRecord.path = readString(stream, record);
+      scanRecord.size = stream.read<uint64_t>();
+      scanRecord.lastUpdateTime = stream.read<int64_t>();
+      scanRecord.fields = stream.read<uint32_t>();
+      auto const propertyCount = stream.read<uint32_t>();
+      for (auto j{0U}; j < propertyCount; j++) {
+        auto name = readString(stream, record);
+        scanRecord.properties.emplace(std::move(name), readString(stream, record));
+      }
+    }
+    return records;
+  } catch (std::exception const &exception) {
+    LOGW("loadScanIndex, ignoring [{}], {}", path, exception.what());
+    return {};
+  }
+}
+
+auto ai::storeScanIndex(std::string const &path, std::span<ApkScanRecord const> const records) -> void {
+  auto index = std::vector<std::byte>();
+  append(index, SCAN_INDEX_MAGIC);
+  append(index, SCAN_INDEX_VERSION);
+  append(index, uint16_t{0});
+  append(index, static_cast<uint32_t>(records.size()));
+  for (auto const &record : records) {
+    appendString(index, record.path);
+    append(index, record.size);
+    append(index, record.lastUpdateTime);
+    append(index, record.fields);
+    append(index, static_cast<uint32_t>(record.properties.size()));
+    for (auto const &[name, value] : record.properties) {
+      appendString(index, name);
+      appendString(index, value);
+    }
+  }
+  append(index, utils::crc32::update(0, index));
+  writeFile(path, index);
+}
+
+auto AnalysisCache::digest(uint64_t const fileSize, std::span<ZipEntry const> const entries) -> uint64_t {
+  auto digest = hash(FNV_OFFSET_BASIS, fileSize);
+  for (auto const &entry : entries) {
+    for (auto const c : entry.path) {
+      digest = hash(digest, c);
+    }
+    digest = hash(digest, entry.localHeaderOffset);
+    digest = hash(digest, entry.compressedSize);
+    digest = hash(digest, entry.uncompressedSize);
+    digest = hash(digest, entry.crc);
+    digest = hash(digest, entry.compressionMethod);
+  }
+  return digest;
+}
+
+auto AnalysisCache::load(uint64_t const digest) const -> std::optional<ApkAnalysis> {
+  static auto &hits = utils::metrics::counter("cache.analysis_hits");
+  static auto &misses = utils::metrics::counter("cache.analysis_misses");
+  auto const path = getPath(digest);
+  auto const contents = read(path);
+  if (!contents) {
+    misses.add();
+    return std::nullopt;
+  }
+  try {
+    auto analysis = decodeAnalysis(std::as_bytes(std::span(*contents)));
+    if (analysis.digest != digest) {
+      throw std::logic_error("mismatched analysis record");
+    }
+    LOGD("load, hit [{}]", path);
+    hits.add();
+    return analysis;
+  } catch (std::exception const &exception) {
+    LOGW("load, ignoring [{}], {}", path, exception.what());
+    misses.add();
+    return std::nullopt;
+  }
+}
+
+auto AnalysisCache::store(ApkAnalysis const &analysis) const -> void { write(getPath(analysis.digest), encodeAnalysis(analysis)); }
+
+auto AnalysisCache::loadData(uint64_t const digest, std::string_view const name) const -> std::optional<std::vector<std::byte>> {
+  static auto &hits = utils::metrics::counter("cache.data_hits");
+  static auto &misses = utils::metrics::counter("cache.data_misses");
+  auto const path = getPath(digest, name);
+  auto const contents = read(path);
+  if (!contents) {
+    misses.add();
+    return std::nullopt;
+  }
+  try {
+    auto const record = checkRecord(std::as_bytes(std::span(*contents)));
+    auto stream = DataStream(record);
+    if (stream.read<uint32_t>() != DATA_RECORD_MAGIC || stream.read<uint16_t>() != DATA_RECORD_VERSION) {
+      throw std::logic_error("unsupported data record");
+    }
+    stream.skip(sizeof(uint16_t));
+    if (stream.read<uint64_t>() != digest || readString(stream, record) != name) {
+      throw std::logic_error("mismatched data record");
+    }
+    LOGD("loadData, hit [{}]", path);
+    hits.add();
+    auto const data = record.subspan(stream.position());
+    return std::vector<std::byte>(data.begin(), data.end());
+  } catch (std::exception const &exception) {
+    LOGW("loadData, ignoring [{}], {}", path, exception.what());
+    misses.add();
+    return std::nullopt;
+  }
+}
+
+auto AnalysisCache::storeData(uint64_t const digest, std::string_view const name, std::span<std::byte const> const data) const -> void {
+  auto record = std::vector<std::byte>();
+  append(record, DATA_RECORD_MAGIC);
+  append(record, DATA_RECORD_VERSION);
+  append(record, uint16_t{0});
+  append(record, digest);
+  appendString(record, name);
+  record.insert(record.end(), data.begin(), data.end());
+  append(record, utils::crc32::update(0, record));
+  write(getPath(digest, name), record);
+}
+
+auto AnalysisCache::loadSharedData(std::string_view const name) const -> std::optional<std::vector<std::byte>> { return loadData(SHARED_DIGEST, name); }
+
+auto AnalysisCache::storeSharedData(std::string_view const name, std::span<std::byte const> const data) const -> void {
+  storeData(SHARED_DIGEST, name, data);
+}
+
+auto AnalysisCache::getPath(uint64_t const digest, std::string_view const name) const -> std::string {
+  if (!name.empty() && !isValidDataName(name)) {
+    throw std::invalid_argument("invalid cache data name");
+  }
+  auto digits = std::array<char, 16>();
+  auto fileName = std::string(utils::format::formatTo(digits, "{:016x}", digest));
+  if (!name.empty()) {
+    fileName += '.';
+    fileName += name;
+  }
+  return (fs::path(directory_) / (fileName + RECORD_EXTENSION)).string();
+}
+
+auto AnalysisCache::read(std::string const &path) const -> std::optional<std::vector<char>> { return readFile(path); }
+
+auto AnalysisCache::write(std::string const &path, std::span<std::byte const> const record) const -> void { writeFile(path, record); }
@@ -0,0 +1,142 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_ANALYSIS_CACHE_H_
+#define ANDROID_INTROSPECTION_APK_ANALYSIS_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "zip_archiver.h"
+
+namespace ai {
+
+//
+// What has been worked out about one APK so far.  Properties only hold the
+// fields computed at some point, named as getProperties() reports them.
+//
+struct ApkAnalysis {
+
+  uint64_t digest = 0;
+
+  std::vector<ZipEntry> entries;
+
+  std::map<std::string, std::string> properties;
+};
+
+//
+// Compact binary encoding of an analysis, checked with a trailing CRC-32.
+// Decoding throws for records that are truncated, corrupt or of another
+// format version.
+//
+auto encodeAnalysis(ApkAnalysis const &analysis) -> std::vector<std::byte>;
+
+auto decodeAnalysis(std::span<std::byte const> record) -> ApkAnalysis;
+
+//
+// What a scan found for the APK at a path, and what the file looked like
+// then.
+//
+struct ApkScanRecord {
+
+  std::string path;
+
+  uint64_t size = 0;
+
+  int64_t lastUpdateTime = 0;
+
+  uint32_t fields = 0;
+
+  std::map<std::string, std::string> properties;
+};
+
+//
+// File of the records of the last scan of a set of APKs, written through a
+// temporary file like analyses.  Loading returns no records if the file is
+// missing or cannot be read.
+//
+auto loadScanIndex(std::string const &path) -> std::vector<ApkScanRecord>;
+
+auto storeScanIndex(std::string const &path, std::span<ApkScanRecord const> records) -> void;
+
+//
+// Directory of analyses, one file per APK named after its digest.  The
+// digest covers the file size and the central directory (paths, CRCs, sizes
+// and offsets of every entry), so copies of an APK share a record wherever
+// they live, and any rewrite of the archive misses.  In the browser the
+// directory is expected to be backed by IndexedDB or OPFS.
+//
+class AnalysisCache final {
+public:
+  explicit AnalysisCache(std::string directory) : directory_(std::move(directory)) {}
+
+  static auto digest(uint64_t fileSize, std::span<ZipEntry const> entries) -> uint64_t;
+
+  //
+  // Returns the stored analysis, or nothing if there is none or it cannot be
+  // read.
+  //
+  auto load(uint64_t digest) const -> std::optional<ApkAnalysis>;
+
+  //
+  // Writes the analysis through a temporary file, so concurrent readers
+  // never see a partial record.
+  //
+  auto store(ApkAnalysis const &analysis) const -> void;
+
+  //
+  // Named data derived from an APK, e.g. a search index, kept in a file of
+  // its own next to the analysis so that loading properties never reads
+  // it.  Names are made of lowercase letters, digits and '-'.
+  //
+  auto loadData(uint64_t digest, std::string_view name) const -> std::optional<std::vector<std::byte>>;
+
+  auto storeData(uint64_t digest, std::string_view name, std::span<std::byte const> data) const -> void;
+
+  //
+  // Same as above for data of the whole cache rather than of one APK, e.g.
+  // a dictionary the data of every APK refers to.
+  //
+  auto loadSharedData(std::string_view name) const -> std::optional<std::vector<std::byte>>;
+
+  auto storeSharedData(std::string_view name, std::span<std::byte const> data) const -> void;
+
+private:
+  auto getPath(uint64_t digest, std::string_view name = {}) const -> std::string;
+
+  auto read(std::string const &path) const -> std::optional<std::vector<char>>;
+
+  auto write(std::string const &path, std::span<std::byte const> record) const -> void;
+
+  std::string const directory_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_ANALYSIS_CACHE_H_ */
@@ -21,26 +21,171 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
+#include <array>
+#include <charconv>
+#include <optional>
+#include <span>
+#include <utility>
+
 #include "android_manifest_parser.h"
 
 using namespace ai;
 
+namespace {
+
+//
+// android.R.attr.name
+//
+static constexpr uint32_t ANDROID_NAME_ATTRIBUTE = 0x01010003;
+
+//
+// android.R.attr.debuggable
+//
+static constexpr uint32_t ANDROID_DEBUGGABLE_ATTRIBUTE = 0x0101000f;
+
+//
+// android.R.attr.versionCode
+//
+static constexpr uint32_t ANDROID_VERSION_CODE_ATTRIBUTE = 0x0101021b;
+
+//
+// android.R.attr.versionName
+//
+static constexpr uint32_t ANDROID_VERSION_NAME_ATTRIBUTE = 0x0101021c;
+
+//
+// android.R.attr.extractNativeLibs
+//
+static constexpr uint32_t ANDROID_EXTRACT_NATIVE_LIBS_ATTRIBUTE = 0x010104ea;
+
+//
+// android.R.attr.permission
+//
+static constexpr uint32_t ANDROID_PERMISSION_ATTRIBUTE = 0x01010006;
+
+//
+// android.R.attr.enabled
+//
+static constexpr uint32_t ANDROID_ENABLED_ATTRIBUTE = 0x0101000e;
+
+//
+// android.R.attr.exported
+//
+static constexpr uint32_t ANDROID_EXPORTED_ATTRIBUTE = 0x01010010;
+
+//
+// android.R.attr.priority
+//
+static constexpr uint32_t ANDROID_PRIORITY_ATTRIBUTE = 0x0101001c;
+
+//
+// android.R.attr.mimeType
+//
+static constexpr uint32_t ANDROID_MIME_TYPE_ATTRIBUTE = 0x01010026;
+
+//
+// android.R.attr.scheme
+//
+static constexpr uint32_t ANDROID_SCHEME_ATTRIBUTE = 0x01010027;
+
+//
+// android.R.attr.host
+//
+static constexpr uint32_t ANDROID_HOST_ATTRIBUTE = 0x01010028;
+
+//
+// android.R.attr.path
+//
+static constexpr uint32_t ANDROID_PATH_ATTRIBUTE = 0x0101002a;
+
+//
+// android.R.attr.targetSdkVersion
+//
+static constexpr uint32_t ANDROID_TARGET_SDK_VERSION_ATTRIBUTE = 0x01010270;
+
+auto getAttribute(BinaryXml::ElementAttributes const &elementAttributes, std::string const &attributeName) -> std::string {
+  auto const attribute = elementAttributes.find(attributeName);
+  return attribute != elementAttributes.end() ? attribute->second : std::string();
+}
+
+//
+// Android attributes are matched by resource id, so shrunk manifests with
+// mangled names still answer; documents without a resource map fall back
+// to the name.
+//
+auto getAndroidAttribute(BinaryXml const &binaryXml, std::span<std::string const> const elementPath, uint32_t const attributeResourceId,
+                         std::string const &attributeName) -> std::string {
+  if (binaryXml.hasResourceIds()) {
+    return binaryXml.getElementAttribute(elementPath, attributeResourceId).value_or(std::string());
+  }
+  return getAttribute(binaryXml.getElementAttributes(std::vector<std::string>(elementPath.begin(), elementPath.end())), attributeName);
+}
+
+//
+// Attribute of an element of the index, matched by resource id like
+// getAndroidAttribute(), or by name in documents without a resource map
+// and for attributes outside the android namespace.
+//
+auto findIndexedAttribute(BinaryXml const &binaryXml, uint32_t const element, uint32_t const attributeResourceId, std::string_view const attributeName)
+    -> std::optional<std::string> {
+  auto const &elements = binaryXml.elementIndex();
+  if (attributeResourceId != 0 && binaryXml.hasResourceIds()) {
+    auto const attribute = elements.findAttribute(element, attributeResourceId);
+    return attribute ? std::optional(binaryXml.getAttributeValue(*attribute)) : std::nullopt;
+  }
+  auto const firstAttribute = elements.firstAttributes[element];
+  for (auto attribute = firstAttribute; attribute < firstAttribute + elements.attributeCounts[element]; attribute++) {
+    if (binaryXml.getString(elements.attributeNames[attribute]) == attributeName) {
+      return binaryXml.getAttributeValue(attribute);
+    }
+  }
+  return std::nullopt;
+}
+
+template <typename T> auto parseNumber(std::optional<std::string> const &value, T const defaultValue) -> T {
+  auto number = defaultValue;
+  if (value) {
+    std::from_chars(value->data(), value->data() + value->size(), number);
+  }
+  return number;
+}
+
+static auto const MANIFEST_PATH = std::array{std::string("manifest")};
+
+static auto const APPLICATION_PATH = std::array{std::string("manifest"), std::string("application")};
+
+} // namespace
+
 auto AndroidManifestParser::isValid() const -> bool { return binaryXml_.hasElement("application"); }
 
-auto AndroidManifestParser::toStringXml() const -> std::string { return binaryXml_.toStringXml(); }
+auto AndroidManifestParser::toStringXml(ResourceResolver *const resolver) const -> std::string { return binaryXml_.toStringXml(resolver); }
+
+auto AndroidManifestParser::toStringXml(std::function<void(std::string_view)> flush, ResourceResolver *const resolver) const -> void {
+  binaryXml_.toStringXml(std::move(flush), resolver);
+}
+
+auto AndroidManifestParser::toXmlTree(ResourceResolver *const resolver) const -> std::string { return binaryXml_.toXmlTree(resolver); }
+
+auto AndroidManifestParser::toBinaryXml() const -> std::vector<std::byte> { return binaryXml_.toBinaryXml(); }
 
 auto AndroidManifestParser::isApplicationDebuggable() const -> bool {
-  auto const elementAttributes = binaryXml_.getElementAttributes(std::vector<std::string>{"manifest", "application"});
-  auto const debuggableAttribute = elementAttributes.find("debuggable");
-  if (debuggableAttribute != elementAttributes.end()) {
-    return debuggableAttribute->second == "true";
-  } else {
-    return false;
-  }
+  return getAndroidAttribute(binaryXml_, APPLICATION_PATH, ANDROID_DEBUGGABLE_ATTRIBUTE, "debuggable") == "true";
 }
 
-auto AndroidManifestParser::setApplicationDebuggable(bool const debuggable) const -> void {
-  binaryXml_.setElementAttribute(std::vector<std::string>{"manifest", "application"}, "debuggable", debuggable ? "true" : "false");
+auto AndroidManifestParser::setApplicationDebuggable(bool const debuggable) -> void {
+  binaryXml_.setElementAttribute(std::vector<std::string>{"manifest", "application"}, "debuggable", debuggable ? "true" : "false", ANDROID_DEBUGGABLE_ATTRIBUTE);
+}
+
+auto AndroidManifestParser::getApplicationName() const -> std::string {
+  return getAndroidAttribute(binaryXml_, APPLICATION_PATH, ANDROID_NAME_ATTRIBUTE, "name");
+}
+
+auto AndroidManifestParser::setApplicationName(std::string_view const name) -> void {
+  binaryXml_.setElementAttribute(std::vector<std::string>{"manifest", "application"}, "name", name, ANDROID_NAME_ATTRIBUTE);
+}
+
+auto AndroidManifestParser::isExtractingNativeLibraries() const -> bool {
+  return getAndroidAttribute(binaryXml_, APPLICATION_PATH, ANDROID_EXTRACT_NATIVE_LIBS_ATTRIBUTE, "extractNativeLibs") != "false";
 }
 
 auto AndroidManifestParser::getPackageName() const -> std::string {
@@ -54,21 +199,109 @@ auto AndroidManifestParser::getPackageName() const -> std::string {
 }
 
 auto AndroidManifestParser::getVersionName() const -> std::string {
-  auto const elementAttributes = binaryXml_.getElementAttributes(std::vector<std::string>{"manifest"});
-  auto const versionNameAttribute = elementAttributes.find("versionName");
-  if (versionNameAttribute != elementAttributes.end()) {
-    return versionNameAttribute->second;
-  } else {
-    return std::string();
-  }
+  return getAndroidAttribute(binaryXml_, MANIFEST_PATH, ANDROID_VERSION_NAME_ATTRIBUTE, "versionName");
 }
 
 auto AndroidManifestParser::getVersionCode() const -> std::string {
-  auto const elementAttributes = binaryXml_.getElementAttributes(std::vector<std::string>{"manifest"});
-  auto const versionCodeAttribute = elementAttributes.find("versionCode");
-  if (versionCodeAttribute != elementAttributes.end()) {
-    return versionCodeAttribute->second;
-  } else {
-    return std::string();
+  return getAndroidAttribute(binaryXml_, MANIFEST_PATH, ANDROID_VERSION_CODE_ATTRIBUTE, "versionCode");
+}
+
+auto AndroidManifestParser::getManifestProperties() const -> ManifestProperties {
+  //
+  // Both elements are resolved in one batch, and the attributes read off
+  // them, instead of walking the paths again per property.
+  //
+  auto const elements = binaryXml_.findElements(std::array{BinaryXml::ElementPath{"manifest"}, BinaryXml::ElementPath{"manifest", "application"}});
+  auto const manifest = elements[0];
+  auto const application = elements[1];
+  auto properties = ManifestProperties{};
+  if (manifest) {
+    properties.packageName = findIndexedAttribute(binaryXml_, *manifest, 0, "package").value_or(std::string());
+    properties.versionCode = findIndexedAttribute(binaryXml_, *manifest, ANDROID_VERSION_CODE_ATTRIBUTE, "versionCode").value_or(std::string());
+    properties.versionName = findIndexedAttribute(binaryXml_, *manifest, ANDROID_VERSION_NAME_ATTRIBUTE, "versionName").value_or(std::string());
   }
-}
\ No newline at end of file
+  if (application) {
+    properties.debuggable = findIndexedAttribute(binaryXml_, *application, ANDROID_DEBUGGABLE_ATTRIBUTE, "debuggable") == "true";
+  }
+  return properties;
+}
+
+auto AndroidManifestParser::getComponents() const -> ManifestComponents {
+  auto components = ManifestComponents();
+  auto const &elements = binaryXml_.elementIndex();
+  auto const intern = [&components](std::optional<std::string> const &value) {
+    return value ? components.intern(*value) : ManifestComponents::NO_STRING;
+  };
+  components.packageName_ = components.intern(getPackageName());
+
+  //
+  // Components, filters and their children are in document order, so the
+  // last of each kind seen is the parent of the next child.
+  //
+  auto component = ElementIndex::NONE;
+  auto componentElement = ElementIndex::NONE;
+  auto filterElement = ElementIndex::NONE;
+
+  //
+  // Without android:exported, whether a component is exported depends on
+  // its filters, known once the pass is done.
+  //
+  auto isExportDeclared = std::vector<bool>();
+  for (auto element = uint32_t{0}; element < elements.size(); element++) {
+    auto const tag = binaryXml_.getString(elements.tags[element]);
+    auto const depth = elements.depths[element];
+    auto const parent = elements.parents[element];
+    if (depth == 1 && (tag == "uses-permission" || tag == "uses-permission-sdk-23")) {
+      if (auto const name = findIndexedAttribute(binaryXml_, element, ANDROID_NAME_ATTRIBUTE, "name")) {
+        components.requestedPermissions_.push_back(components.intern(*name));
+      }
+    } else if (depth == 1 && tag == "permission") {
+      if (auto const name = findIndexedAttribute(binaryXml_, element, ANDROID_NAME_ATTRIBUTE, "name")) {
+        components.declaredPermissions_.push_back(components.intern(*name));
+      }
+    } else if (depth == 1 && tag == "uses-sdk") {
+      components.targetSdkVersion_ =
+          parseNumber(findIndexedAttribute(binaryXml_, element, ANDROID_TARGET_SDK_VERSION_ATTRIBUTE, "targetSdkVersion"), components.targetSdkVersion_);
+    } else if (depth == 2) {
+      auto const type = ManifestComponents::getComponentType(tag);
+      componentElement = ElementIndex::NONE;
+      if (!type || binaryXml_.getString(elements.tags[parent]) != "application") {
+        continue;
+      }
+      auto const name = findIndexedAttribute(binaryXml_, element, ANDROID_NAME_ATTRIBUTE, "name");
+      auto const exported = findIndexedAttribute(binaryXml_, element, ANDROID_EXPORTED_ATTRIBUTE, "exported");
+      component = static_cast<uint32_t>(components.components_.size());
+      componentElement = element;
+      components.components_.push_back(ManifestComponent{
+          *type, components.internClassName(name.value_or(std::string())),
+          intern(findIndexedAttribute(binaryXml_, element, ANDROID_PERMISSION_ATTRIBUTE, "permission")), exported ? *exported == "true" : false,
+          findIndexedAttribute(binaryXml_, element, ANDROID_ENABLED_ATTRIBUTE, "enabled") != "false", static_cast<uint32_t>(components.filters_.size()), 0});
+      components.componentsByName_.emplace(components.components_.back().name, component);
+      isExportDeclared.push_back(exported.has_value());
+    } else if (depth == 3 && parent == componentElement && tag == "intent-filter") {
+      filterElement = element;
+      components.components_[component].filterCount++;
+      components.filters_.push_back(IntentFilter{component, parseNumber(findIndexedAttribute(binaryXml_, element, ANDROID_PRIORITY_ATTRIBUTE, "priority"), 0),
+                                                 static_cast<uint32_t>(components.actions_.size()), 0,
+                                                 static_cast<uint32_t>(components.categories_.size()), 0, static_cast<uint32_t>(components.data_.size()), 0});
+    } else if (depth == 4 && parent == filterElement && componentElement != ElementIndex::NONE) {
+      auto &filter = components.filters_.back();
+      if (tag == "action") {
+        components.actions_.push_back(intern(findIndexedAttribute(binaryXml_, element, ANDROID_NAME_ATTRIBUTE, "name")));
+        filter.actionCount++;
+      } else if (tag == "category") {
+        components.categories_.push_back(intern(findIndexedAttribute(binaryXml_, element, ANDROID_NAME_ATTRIBUTE, "name")));
+        filter.categoryCount++;
+      } else if (tag == "data") {
+        components.data_.push_back(IntentFilterData{intern(findIndexedAttribute(binaryXml_, element, ANDROID_SCHEME_ATTRIBUTE, "scheme")),
+                                                    intern(findIndexedAttribute(binaryXml_, element, ANDROID_HOST_ATTRIBUTE, "host")),
+                                                    intern(findIndexedAttribute(binaryXml_, element, ANDROID_PATH_ATTRIBUTE, "path")),
+                                                    intern(findIndexedAttribute(binaryXml_, element, ANDROID_MIME_TYPE_ATTRIBUTE, "mimeType"))});
+        filter.dataCount++;
+      }
+    }
+  }
+
+  components.finish(isExportDeclared);
+  return components;
+}
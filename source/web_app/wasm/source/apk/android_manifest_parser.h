@@ -25,13 +25,30 @@
 #define ANDROID_INTROSPECTION_APK_ANDROID_MANIFEST_PARSER_H_
 
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "apk/manifest_components.h"
 #include "binary_xml/binary_xml.h"
 
 namespace ai {
 
+//
+// Manifest summary collected with a single query of the manifest.
+//
+struct ManifestProperties {
+
+  std::string packageName;
+
+  std::string versionCode;
+
+  std::string versionName;
+
+  bool debuggable;
+};
+
 class AndroidManifestParser {
 
 public:
@@ -39,11 +56,31 @@ public:
 
   auto isValid() const -> bool;
 
-  auto toStringXml() const -> std::string;
+  auto toStringXml(ResourceResolver *resolver = nullptr) const -> std::string;
+
+  auto toStringXml(std::function<void(std::string_view)> flush, ResourceResolver *resolver = nullptr) const -> void;
+
+  auto toXmlTree(ResourceResolver *resolver = nullptr) const -> std::string;
+
+  auto toBinaryXml() const -> std::vector<std::byte>;
 
   auto isApplicationDebuggable() const -> bool;
 
-  auto setApplicationDebuggable(bool debuggable) const -> void;
+  auto setApplicationDebuggable(bool debuggable) -> void;
+
+  //
+  // Class name of the application as written, possibly relative to the
+  // package, or empty without one.
+  //
+  auto getApplicationName() const -> std::string;
+
+  auto setApplicationName(std::string_view name) -> void;
+
+  //
+  // android:extractNativeLibs, true unless the manifest says otherwise; when
+  // false, libraries must be stored and page aligned in the APK.
+  //
+  auto isExtractingNativeLibraries() const -> bool;
 
   auto getPackageName() const -> std::string;
 
@@ -51,8 +88,16 @@ public:
 
   auto getVersionCode() const -> std::string;
 
+  auto getManifestProperties() const -> ManifestProperties;
+
+  //
+  // Activities, aliases, services, receivers and providers with their
+  // intent filters, and the permissions, from one pass over the elements.
+  //
+  auto getComponents() const -> ManifestComponents;
+
 private:
-  BinaryXml const binaryXml_;
+  BinaryXml binaryXml_;
 };
 
 } // namespace ai
@@ -21,18 +21,57 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
 #include <filesystem>
+#include <future>
+#include <iterator>
 #include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <tuple>
 
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#include <unistd.h>
+
+#include "analysis_cache.h"
 #include "android_manifest_parser.h"
 #include "apk/apk.h"
-#include "apk_parser.h"
+#include "apk/permission_index.h"
+#include "apk/zip_stream_writer.h"
 #include "binary_xml/binary_xml.h"
+#include "binary_xml/resource_resolver.h"
+#include "binary_xml/res_value.h"
+#include "binary_xml/resource_table.h"
+#include "binary_xml/resource_types.h"
+#include "pattern_matcher.h"
+#include "resource_decoder.h"
+#include "utils/bounded_queue.h"
+#include "utils/data_stream.h"
+#include "utils/file_output.h"
+#include "utils/format.h"
+#include "utils/glob.h"
+#include "utils/little_endian.h"
 #include "utils/log.h"
 #include "utils/macros.h"
+#include "utils/mapped_file.h"
+#include "utils/memory_budget.h"
+#include "utils/metrics.h"
 #include "utils/sha.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
 #include "utils/utils.h"
+#include "zip_archiver.h"
+#include "zip_reader.h"
 
 using namespace ai;
 
@@ -42,102 +81,1597 @@ namespace {
 
 static constexpr char const *const ANDROID_MANIFEST = "AndroidManifest.xml";
 
+static constexpr char const *const RESOURCES_TABLE = "resources.arsc";
+
+static constexpr char const *const ENTRY_DIGESTS_DATA = "entry-digests";
+
+static constexpr char const *const PERMISSION_BITS_DATA = "permission-bits";
+
+static constexpr char const *const PERMISSION_DICTIONARY_DATA = "permission-dictionary";
+
+static constexpr char const *const IN_MEMORY_APK_NAME = "<memory>";
+
+//
+// Subsystems the working memory of an APK is accounted to.
+//
+static constexpr char const *const ENTRIES_MEMORY = "apk.entries";
+
+static constexpr char const *const MANIFEST_MEMORY = "apk.manifest";
+
+static constexpr char const *const RESOURCES_MEMORY = "apk.resources";
+
+static constexpr size_t SHA256_READ_SIZE = 1024 * 1024;
+
+//
+// Largest manifest a quick check lets through; real ones are a few hundred
+// KB at most.
+//
+static constexpr uint64_t MAX_MANIFEST_SIZE = 16 * 1024 * 1024;
+
+static constexpr auto PROGRESS_INTERVAL = std::chrono::milliseconds(100);
+
+//
+// Most the entries inflated ahead of use may take of a session; entries
+// beyond it are left to be inflated when asked for.
+//
+static constexpr uint64_t MAX_PREFETCHED_SIZE = 32 * 1024 * 1024;
+
+static constexpr char const *const MAIN_ACTION = "android.intent.action.MAIN";
+
+static constexpr char const *const LAUNCHER_CATEGORY = "android.intent.category.LAUNCHER";
+
+static constexpr char const *const MAIN_DEX = "classes.dex";
+
+//
+// Contents of an inflated entry, counted against the memory budget for as
+// long as they live.
+//
+using AccountedBytes = std::vector<std::byte, utils::memory::AccountingAllocator<std::byte>>;
+
+//
+// Resource table of the APK and the resolver shared by the documents
+// rendered from it.
+//
+struct ApkResources {
+
+  explicit ApkResources(std::vector<std::byte> contents) : bytes(std::move(contents)), table(bytes), resolver(table) {}
+
+  std::vector<std::byte> const bytes;
+
+  ResourceTable const table;
+
+  ResourceResolver resolver;
+};
+
+//
+// Size and modification time of the APK file, to tell whether a session
+// still describes it.
+//
+struct ApkFileStamp {
+
+  std::uintmax_t size = 0;
+
+  fs::file_time_type lastWriteTime;
+
+  auto operator==(ApkFileStamp const &) const -> bool = default;
+};
+
+auto getFileStamp(std::string const &path) -> ApkFileStamp {
+  auto error = std::error_code();
+  auto stamp = ApkFileStamp();
+  stamp.size = fs::file_size(path, error);
+  stamp.lastWriteTime = fs::last_write_time(path, error);
+  return stamp;
+}
+
+//
+// Everything read from an APK that outlives a single call: the archive with
+// its central directory index and a read handle per thread, and the manifest
+// and resources, each parsed on first use.  Calls on several threads share
+// it.
+//
+struct ApkSession {
+
+  ApkSession(std::string const &apkPath, ApkFileStamp const fileStamp) : stamp(fileStamp), archive(apkPath) {}
+
+  ApkSession(std::shared_ptr<ZipReader const> reader, ApkFileStamp const fileStamp) : stamp(fileStamp), archive(std::move(reader)) {}
+
+  ApkFileStamp const stamp;
+
+  ZipArchiver const archive;
+
+  //
+  // Guards the members below that are read on first use, and the cached
+  // properties of the analysis.
+  //
+  std::mutex mutex;
+
+  //
+  // Held while the resolver is used: it keeps the references it resolved
+  // last, so threads take turns with it.  The manifest guards its own.
+  //
+  std::mutex documentMutex;
+
+  std::unique_ptr<AndroidManifestParser> manifest;
+
+  bool manifestRead = false;
+
+  std::unique_ptr<ApkResources> resources;
+
+  bool resourcesRead = false;
+
+  //
+  // What the parsed manifest and resources take of the memory budget.
+  //
+  utils::memory::MemoryReservation manifestMemory;
+
+  utils::memory::MemoryReservation resourcesMemory;
+
+  //
+  // SHA-256 of the file, hashed in the background on first request, and the
+  // bytes hashed so far.
+  //
+  std::shared_future<std::string> sha256;
+
+  std::shared_ptr<std::atomic<uint64_t>> const sha256Progress = std::make_shared<std::atomic<uint64_t>>(0);
+
+  //
+  // Cached analysis of the APK, looked up on first use when there is a
+  // cache.
+  //
+  std::unique_ptr<ApkAnalysis> analysis;
+
+  //
+  // Entries inflated by prefetch() ahead of use, with the size they take
+  // together.
+  //
+  std::map<std::string, std::shared_ptr<AccountedBytes const>, std::less<>> prefetched;
+
+  uint64_t prefetchedSize = 0;
+};
+
+//
+// Where a file of the APK goes under the destination, or nothing if its path
+// would take it out of the destination.
+//
+auto getDestinationPath(fs::path const &destinationPath, std::string const &pathInApk) -> std::optional<fs::path> {
+  auto const filePath = (destinationPath / pathInApk).lexically_normal();
+  auto const [end, _] = std::mismatch(destinationPath.begin(), destinationPath.end(), filePath.begin(), filePath.end());
+  if (end != destinationPath.end()) {
+    return std::nullopt;
+  }
+  return filePath;
+}
+
+//
+// Path of the contents of an entry in a content store.
+//
+auto getStorePath(fs::path const &contentStore, ZipEntry const &entry, std::optional<utils::sha::Sha256Digest> const &sha256) -> fs::path {
+  auto digits = std::array<char, 32>();
+  auto name = std::string(utils::format::formatTo(digits, "{:08x}-{:x}", entry.crc, entry.uncompressedSize));
+  if (sha256) {
+    name += '-';
+    name += utils::format::toHex(*sha256, false);
+  }
+  return contentStore / name;
+}
+
+//
+// Adds contents to a content store through a temporary file, so that
+// concurrent extracts, in this process or another, never link a partial
+// file.  Stored files are read-only, so that a hardlinked file can't be
+// changed in place for every extract sharing it.
+//
+auto addStoredFile(fs::path const &storePath, std::span<std::byte const> const contents) -> void {
+  static auto temporaryFiles = std::atomic<uint64_t>(0);
+  auto const temporaryPath = storePath.string() + "." + std::to_string(getpid()) + "-" + std::to_string(temporaryFiles++) + ".tmp";
+  auto writer = utils::FileWriter(temporaryPath, contents.size());
+  writer.write(contents);
+  writer.close();
+  auto error = std::error_code();
+  fs::permissions(temporaryPath, fs::perms::owner_read | fs::perms::group_read | fs::perms::others_read, error);
+  fs::rename(temporaryPath, storePath, error);
+  if (error) {
+    fs::remove(temporaryPath, error);
+  }
+}
+
+auto cloneFile([[maybe_unused]] fs::path const &source, [[maybe_unused]] fs::path const &destination) -> bool {
+#if defined(__linux__) && !defined(__EMSCRIPTEN__) && defined(FICLONE)
+  auto const sourceFd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+  if (sourceFd < 0) {
+    return false;
+  }
+  auto const destinationFd = open(destination.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  auto const isCloned = destinationFd >= 0 && ioctl(destinationFd, FICLONE, sourceFd) == 0;
+  if (destinationFd >= 0) {
+    close(destinationFd);
+    if (!isCloned) {
+      unlink(destination.c_str());
+    }
+  }
+  close(sourceFd);
+  return isCloned;
+#else
+  return false;
+#endif
+}
+
+//
+// Puts the file of a content store at filePath, replacing what is there.
+// Clones fall back to a writable copy where the file system can't clone.
+// Returns false if the file can't be made, e.g. a hardlink across file
+// systems.
+//
+auto linkStoredFile(fs::path const &storePath, fs::path const &filePath, ApkStoreLink const storeLink) -> bool {
+  auto error = std::error_code();
+  fs::remove(filePath, error);
+  if (storeLink == ApkStoreLink::Hardlink) {
+    fs::create_hard_link(storePath, filePath, error);
+    return !error;
+  }
+  if (cloneFile(storePath, filePath)) {
+    return true;
+  }
+  if (!fs::copy_file(storePath, filePath, error)) {
+    return false;
+  }
+  fs::permissions(filePath, fs::perms::owner_write, fs::perm_options::add, error);
+  return true;
+}
+
+//
+// Adds the fields of the manifest to the properties.
+//
+auto addManifestProperties(ManifestProperties const &manifestProperties, ApkPropertyFields const fields, std::map<std::string, std::string> &properties)
+    -> void {
+  if (fields.contains(ApkPropertyField::Package)) {
+    properties.emplace("packageName", manifestProperties.packageName);
+  }
+  if (fields.contains(ApkPropertyField::Version)) {
+    properties.emplace("versionCode", manifestProperties.versionCode);
+    properties.emplace("versionName", manifestProperties.versionName);
+  }
+  if (fields.contains(ApkPropertyField::Debuggable)) {
+    properties.emplace("debuggable", manifestProperties.debuggable ? "true" : "false");
+  }
+}
+
+//
+// Names of the properties reported for the fields, besides "valid".
+//
+auto getPropertyNames(ApkPropertyFields const fields) -> std::vector<std::string_view> {
+  auto names = std::vector<std::string_view>();
+  if (fields.contains(ApkPropertyField::Package)) {
+    names.push_back("packageName");
+  }
+  if (fields.contains(ApkPropertyField::Version)) {
+    names.push_back("versionCode");
+    names.push_back("versionName");
+  }
+  if (fields.contains(ApkPropertyField::Debuggable)) {
+    names.push_back("debuggable");
+  }
+  if (fields.contains(ApkPropertyField::Manifest)) {
+    names.push_back("manifest");
+  }
+  if (fields.contains(ApkPropertyField::Sha256)) {
+    names.push_back("sha256");
+  }
+  return names;
+}
+
+//
+// Value of a resource as text, with strings taken from the value pool as
+// escaped xml with their markup and references given by name, so that
+// values compare across builds whose ids differ.
+//
+auto getResourceValueText(ResourceTable const &table, ResourceEntry const &entry) -> std::string {
+  if (entry.complex) {
+    auto const parent = entry.parent != 0 ? table.getName(entry.parent) : std::nullopt;
+    return parent ? "bag of @" + *parent : "bag";
+  }
+  if (entry.value.type == TYPE_STRING) {
+    return table.getStyledString(entry.value.data);
+  }
+  if (entry.value.type == TYPE_REFERENCE) {
+    if (auto const name = table.getName(entry.value.data)) {
+      return "@" + *name;
+    }
+  }
+  auto text = std::string();
+  appendResValue(entry.value.type, entry.value.data, text);
+  return text;
+}
+
+//
+// Class name of the first enabled activity, or alias, with a filter for the
+// main action in the launcher category.
+//
+auto findLauncherActivity(ManifestComponents const &components) -> std::optional<std::string> {
+  for (auto const &component : components.components()) {
+    if (!component.enabled || (component.type != ComponentType::Activity && component.type != ComponentType::ActivityAlias)) {
+      continue;
+    }
+    for (auto const &filter : components.filters(component)) {
+      auto const actions = components.actions(filter);
+      auto const categories = components.categories(filter);
+      auto const isMain = std::ranges::any_of(actions, [&components](auto const action) { return components.getString(action) == MAIN_ACTION; });
+      auto const isLauncher =
+          std::ranges::any_of(categories, [&components](auto const category) { return components.getString(category) == LAUNCHER_CATEGORY; });
+      if (isMain && isLauncher) {
+        return std::string(components.getString(component.name));
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+//
+// Names the layout of an activity goes by, most likely first: for
+// com.example.SettingsActivity "layout/activity_settings", then
+// "layout/settings_activity" and "layout/settings".
+//
+auto getLayoutNames(std::string_view const className) -> std::vector<std::string> {
+  auto simpleName = className.substr(className.rfind('.') + 1);
+  if (simpleName.ends_with("Activity") && simpleName.size() > std::string_view("Activity").size()) {
+    simpleName.remove_suffix(std::string_view("Activity").size());
+  }
+  auto baseName = std::string();
+  for (auto const c : simpleName) {
+    if (std::isupper(static_cast<unsigned char>(c))) {
+      if (!baseName.empty()) {
+        baseName += '_';
+      }
+      baseName += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    } else {
+      baseName += c;
+    }
+  }
+  if (baseName.empty()) {
+    return {};
+  }
+  return {"layout/activity_" + baseName, "layout/" + baseName + "_activity", "layout/" + baseName};
+}
+
+//
+// Same as utils::sha::generateSha256ForFile() for an APK read through a
+// reader, without a copy when it is contiguous in memory.  The bytes hashed
+// are stored in progress after every chunk, and reported to onProgress if
+// set.
+//
+auto generateSha256ForReader(ZipReader const &reader, std::atomic<uint64_t> &progress, ApkProgressCallback const &onProgress) -> std::string {
+  auto hash = utils::sha::Sha256();
+  auto const view = reader.view();
+  auto buffer = std::vector<std::byte>(view ? 0 : SHA256_READ_SIZE);
+  reader.advise(utils::AccessAdvice::Sequential, 0, 0);
+  for (auto offset = uint64_t{0}; offset < reader.size();) {
+    auto chunk = std::span<std::byte const>();
+    if (view) {
+      chunk = view->subspan(offset, std::min<uint64_t>(SHA256_READ_SIZE, view->size() - offset));
+    } else {
+      chunk = std::span(buffer).first(reader.readAt(offset, buffer));
+    }
+    if (chunk.empty()) {
+      throw std::logic_error("unexpected end of apk");
+    }
+    hash.update(chunk);
+    //
+    // Hashed pages are dropped behind the hash, so that hashing a large APK
+    // does not push what is still useful out of the page cache.
+    //
+    reader.advise(utils::AccessAdvice::DontNeed, offset, chunk.size());
+    offset += chunk.size();
+    progress = offset;
+    if (onProgress) {
+      onProgress(offset, reader.size());
+    }
+  }
+  reader.advise(utils::AccessAdvice::Normal, 0, 0);
+  return utils::format::toHex(hash.finish());
+}
+
+using ai::utils::little_endian::append;
+
+//
+// Entry digests as a count followed by the length, path and digest of every
+// entry.
+//
+auto encodeEntryDigests(std::span<ApkEntryDigest const> const digests) -> std::vector<std::byte> {
+  auto encoded = std::vector<std::byte>();
+  append(encoded, static_cast<uint32_t>(digests.size()));
+  for (auto const &digest : digests) {
+    append(encoded, static_cast<uint16_t>(digest.path.size()));
+    auto const pathBytes = std::as_bytes(std::span(digest.path));
+    encoded.insert(encoded.end(), pathBytes.begin(), pathBytes.end());
+    encoded.insert(encoded.end(), digest.sha256.begin(), digest.sha256.end());
+  }
+  return encoded;
+}
+
+auto decodeEntryDigests(std::span<std::byte const> const encoded) -> std::vector<ApkEntryDigest> {
+  auto stream = DataStream(encoded);
+  auto const count = stream.read<uint32_t>();
+  stream.require(std::size_t{count} * (sizeof(uint16_t) + utils::sha::SHA256_SIZE));
+  auto digests = std::vector<ApkEntryDigest>(count);
+  for (auto &digest : digests) {
+    auto const pathSize = stream.read<uint16_t>();
+    stream.require(pathSize + digest.sha256.size());
+    auto const path = encoded.subspan(stream.position(), pathSize);
+    digest.path.assign(reinterpret_cast<char const *>(path.data()), path.size());
+    auto const sha256 = encoded.subspan(stream.position() + pathSize, digest.sha256.size());
+    std::copy(sha256.begin(), sha256.end(), digest.sha256.begin());
+    stream.skip(static_cast<uint32_t>(pathSize + digest.sha256.size()));
+  }
+  if (stream.remaining() != 0) {
+    throw std::logic_error("trailing bytes after entry digests");
+  }
+  return digests;
+}
+
 } // namespace
 
 class Apk::ApkImpl final {
 public:
-  ApkImpl(std::string_view apkPath) : apkPath_(apkPath) {}
+  //
+  // Batches already keep every thread busy, so they hash inline with
+  // backgroundThreads set to 0.
+  //
+  ApkImpl(std::string_view apkPath, std::string_view cacheDirectory, size_t const backgroundThreads)
+      : apkPath_(apkPath), cache_(cacheDirectory.empty() ? nullptr : std::make_unique<AnalysisCache const>(std::string(cacheDirectory))),
+        backgroundPool_(backgroundThreads) {}
 
-  auto isValid() const -> bool {
-    auto const apkParser = ai::ApkParser(apkPath_);
-    auto const files = apkParser.getFiles();
-    auto const hasAndroidManifest = std::find(files.cbegin(), files.cend(), ANDROID_MANIFEST) != files.end();
-    if (!hasAndroidManifest) {
-      LOGW("unable to find manifest in [{}]", apkPath_);
-      return false;
-    }
-    auto const contents = apkParser.getFileContents(ANDROID_MANIFEST);
-    if (contents.empty()) {
-      LOGW("unable to read [{}]", apkPath_);
-      return false;
+  //
+  // An APK that is not a file, e.g. one in memory: it is read only, and its
+  // session lasts as long as this object.  A reader bound to the opening
+  // thread is only ever read from there, so no pool gets threads.
+  //
+  ApkImpl(std::shared_ptr<ZipReader const> reader, std::string_view cacheDirectory, size_t const backgroundThreads,
+          ApkFetcherThreads const readerThreads = ApkFetcherThreads::Any)
+      : apkPath_(IN_MEMORY_APK_NAME), reader_(std::move(reader)),
+        cache_(cacheDirectory.empty() ? nullptr : std::make_unique<AnalysisCache const>(std::string(cacheDirectory))),
+        isThreadBound_(readerThreads == ApkFetcherThreads::Opening), backgroundPool_(isThreadBound_ ? 0 : backgroundThreads) {}
+
+  //
+  // The pool a call runs on, the one it was given unless the APK can only be
+  // read on the opening thread.
+  //
+  auto getThreadPool(utils::ThreadPool &threadPool) const -> utils::ThreadPool & { return isThreadBound_ ? inlinePool_ : threadPool; }
+
+  auto isValid(ApkValidation const validation) const -> bool {
+    auto const apkSession = session();
+    if (validation == ApkValidation::Quick && !isManifestRead(*apkSession)) {
+      return isManifestPlausible(*apkSession);
     }
-    return AndroidManifestParser(contents).isValid();
+    auto const androidManifest = getManifest(*apkSession);
+    return androidManifest != nullptr && androidManifest->isValid();
   }
 
   auto makeDebuggable() const -> void {
-    auto const androidManifestContents = getFileContent(ANDROID_MANIFEST);
-    auto const androidManifestParser = AndroidManifestParser(androidManifestContents);
-    return androidManifestParser.setApplicationDebuggable(true);
+    auto androidManifestParser = AndroidManifestParser(getFileContent(ANDROID_MANIFEST));
+    androidManifestParser.setApplicationDebuggable(true);
+    setFileContent(ANDROID_MANIFEST, androidManifestParser.toBinaryXml());
+  }
+
+  auto makeDebuggable(std::string_view const destinationPath) const -> void {
+    LOGD("makeDebuggable, destinationPath [{}]", destinationPath);
+    auto androidManifestParser = AndroidManifestParser(getFileContent(ANDROID_MANIFEST));
+    androidManifestParser.setApplicationDebuggable(true);
+    auto transaction = ZipTransaction();
+    transaction.replace(ANDROID_MANIFEST, androidManifestParser.toBinaryXml()).align(ZipAlignment());
+    session()->archive.commit(transaction, destinationPath);
+    auto error = std::error_code();
+    if (reader_ == nullptr && fs::equivalent(apkPath_, destinationPath, error)) {
+      dropSession();
+    }
   }
 
   auto isDebuggable() const -> bool {
-    auto const androidManifestContents = getFileContent(ANDROID_MANIFEST);
-    auto const androidManifestParser = AndroidManifestParser(androidManifestContents);
-    return androidManifestParser.isApplicationDebuggable();
+    auto const apkSession = session();
+    auto const androidManifest = getManifest(*apkSession);
+    if (androidManifest == nullptr) {
+      throw std::logic_error("unable to read manifest");
+    }
+    return androidManifest->isApplicationDebuggable();
   }
 
   auto getAndroidManifest() const -> std::string {
-    auto const androidManifestContents = getFileContent(ANDROID_MANIFEST);
-    auto const androidManifestParser = AndroidManifestParser(androidManifestContents);
-    return androidManifestParser.toStringXml();
+    TRACE_SPAN("Apk::getAndroidManifest");
+    auto const apkSession = session();
+    auto const androidManifest = getManifest(*apkSession);
+    if (androidManifest == nullptr) {
+      throw std::logic_error("unable to read manifest");
+    }
+    auto const resolver = getResourceResolver(*apkSession);
+    auto const lock = std::lock_guard(apkSession->documentMutex);
+    return androidManifest->toStringXml(resolver);
   }
 
-  auto getFiles() const -> std::vector<std::string> {
-    auto const apkParser = ai::ApkParser(apkPath_);
-    return apkParser.getFiles();
+  auto getAndroidManifest(std::function<void(std::string_view)> const &onChunk) const -> void {
+    TRACE_SPAN("Apk::getAndroidManifest");
+    auto const apkSession = session();
+    auto const androidManifest = getManifest(*apkSession);
+    if (androidManifest == nullptr) {
+      throw std::logic_error("unable to read manifest");
+    }
+    auto const resolver = getResourceResolver(*apkSession);
+    auto const lock = std::lock_guard(apkSession->documentMutex);
+    androidManifest->toStringXml(onChunk, resolver);
+  }
+
+  auto getAndroidManifestTree() const -> std::string {
+    TRACE_SPAN("Apk::getAndroidManifestTree");
+    auto const apkSession = session();
+    auto const androidManifest = getManifest(*apkSession);
+    if (androidManifest == nullptr) {
+      throw std::logic_error("unable to read manifest");
+    }
+    auto const resolver = getResourceResolver(*apkSession);
+    auto const lock = std::lock_guard(apkSession->documentMutex);
+    return androidManifest->toXmlTree(resolver);
+  }
+
+  auto getManifestComponents() const -> ManifestComponents {
+    TRACE_SPAN("Apk::getManifestComponents");
+    auto const apkSession = session();
+    auto const androidManifest = getManifest(*apkSession);
+    if (androidManifest == nullptr) {
+      throw std::logic_error("unable to read manifest");
+    }
+    return androidManifest->getComponents();
+  }
+
+  auto getFiles() const -> std::vector<std::string> { return session()->archive.files(); }
+
+  auto getEntries() const -> std::vector<ApkEntry> {
+    auto const apkSession = session();
+    auto const analysis = getAnalysis(*apkSession);
+    auto entries = std::vector<ApkEntry>();
+    for (auto &zipEntry : analysis ? analysis->entries : apkSession->archive.entries()) {
+      entries.push_back(ApkEntry{std::move(zipEntry.path), zipEntry.compressedSize, zipEntry.uncompressedSize, zipEntry.crc, zipEntry.compressionMethod,
+                                 zipEntry.localHeaderOffset});
+    }
+    return entries;
   }
 
+  //
+  // The contents count against the budget while they are inflated; once
+  // returned they are the caller's.
+  //
   auto getFileContent(std::string_view filePath) const -> std::vector<std::byte> {
-    auto const apkParser = ai::ApkParser(apkPath_);
-    return apkParser.getFileContents(filePath);
+    LOGD("getFileContent, filePath [{}]", filePath);
+    auto const apkSession = session();
+    if (auto const prefetched = findPrefetched(*apkSession, filePath)) {
+      return std::vector<std::byte>(prefetched->begin(), prefetched->end());
+    }
+    {
+      auto const lock = std::lock_guard(apkSession->mutex);
+      evictPrefetched(*apkSession, filePath);
+    }
+    auto const memory = reserveEntry(*apkSession, ENTRIES_MEMORY, filePath);
+    return apkSession->archive.extract(filePath);
+  }
+
+  auto getFilePrefix(std::string_view filePath, size_t const size) const -> std::vector<std::byte> {
+    LOGD("getFilePrefix, filePath [{}] size [{}]", filePath, size);
+    return session()->archive.extractPrefix(filePath, size);
+  }
+
+  auto classifyEntries(utils::ThreadPool &threadPool) const -> std::vector<ApkEntryContentType> {
+    TRACE_SPAN("Apk::classifyEntries");
+    auto workerTypes = std::vector<std::vector<ApkEntryContentType>>(std::max<size_t>(threadPool.threadCount(), 1));
+    auto const classifyEntry = [&workerTypes](size_t const worker, ZipEntry const &entry, std::span<std::byte const> const prefix) {
+      workerTypes[worker].push_back(ApkEntryContentType{entry.path, classifyContent(prefix, entry.uncompressedSize, entry.compressedSize)});
+    };
+    session()->archive.peekAll([](auto const &) { return true; }, CONTENT_PREFIX_SIZE, classifyEntry, threadPool);
+
+    auto types = std::vector<ApkEntryContentType>();
+    for (auto &entryTypes : workerTypes) {
+      std::move(entryTypes.begin(), entryTypes.end(), std::back_inserter(types));
+    }
+    std::sort(types.begin(), types.end(), [](auto const &left, auto const &right) { return left.path < right.path; });
+    return types;
+  }
+
+  auto grep(std::span<std::string const> patterns, ApkGrepOptions const &options, utils::ThreadPool &threadPool) const -> std::vector<ApkGrepMatch> {
+    TRACE_SPAN("Apk::grep");
+    LOGD("grep, patterns [{}] globs [{}] caseSensitive [{}]", patterns.size(), options.include.size(), options.caseSensitive);
+    auto const matcher = PatternMatcher(patterns, options.caseSensitive);
+    auto const workerCount = std::max<size_t>(threadPool.threadCount(), 1);
+    auto streams = std::vector<PatternStream>(workerCount, PatternStream(matcher));
+    auto workerMatches = std::vector<std::vector<ApkGrepMatch>>(workerCount);
+    auto matchCount = std::atomic_size_t(0);
+    auto const isSearched = [&options, &matchCount](ZipEntry const &entry) {
+      options.cancellation.throwIfCancelled();
+      auto const matches = [&entry](std::string const &glob) { return utils::matchesGlob(glob, entry.path); };
+      return matchCount < options.maxMatches && (options.include.empty() || std::any_of(options.include.begin(), options.include.end(), matches));
+    };
+    auto const grepEntry = [&](size_t const worker, ZipEntry const &entry, ZipEntryStream const &stream) {
+      auto &patternStream = streams[worker];
+      auto const onMatch = [&](uint32_t const pattern, uint64_t const offset) {
+        workerMatches[worker].push_back(ApkGrepMatch{entry.path, pattern, offset});
+        matchCount++;
+      };
+      patternStream.reset();
+      stream([&](auto const chunk) {
+        if (matchCount < options.maxMatches) {
+          patternStream.write(chunk, onMatch);
+        }
+      });
+    };
+    session()->archive.streamAll(isSearched, grepEntry, threadPool);
+
+    auto matches = std::vector<ApkGrepMatch>();
+    for (auto &entryMatches : workerMatches) {
+      std::move(entryMatches.begin(), entryMatches.end(), std::back_inserter(matches));
+    }
+    std::sort(matches.begin(), matches.end(), [](auto const &left, auto const &right) {
+      return std::tie(left.path, left.offset, left.pattern) < std::tie(right.path, right.offset, right.pattern);
+    });
+    matches.resize(std::min(matches.size(), options.maxMatches));
+    return matches;
+  }
+
+  //
+  // Inflated contents count against the budget for as long as they live;
+  // stored files are views and take none of it.
+  //
+  auto getFileBytes(std::string_view filePath) const -> ApkFileBytes {
+    LOGD("getFileBytes, filePath [{}]", filePath);
+    auto const apkSession = session();
+    auto const &archive = apkSession->archive;
+    if (auto const view = archive.view(filePath)) {
+      return ApkFileBytes(apkSession, *view);
+    }
+    if (auto const prefetched = findPrefetched(*apkSession, filePath)) {
+      return ApkFileBytes(prefetched, std::span<std::byte const>(*prefetched));
+    }
+    {
+      auto const lock = std::lock_guard(apkSession->mutex);
+      evictPrefetched(*apkSession, filePath);
+    }
+    auto contents = inflateEntry(*apkSession, filePath);
+    auto const bytes = std::span<std::byte const>(*contents);
+    return ApkFileBytes(std::move(contents), bytes);
+  }
+
+  //
+  // The launcher activity's layout, the resources its strings come from and
+  // the main DEX, in the order a user drilling down from the manifest opens
+  // them.  The layout is guessed from the class name by the conventions of
+  // Android Studio, e.g. "activity_main" for MainActivity.
+  //
+  auto getLikelyNextFiles() const -> std::vector<std::string> {
+    TRACE_SPAN("Apk::getLikelyNextFiles");
+    auto files = std::vector<std::string>();
+    auto const apkSession = session();
+    auto const &archive = apkSession->archive;
+    try {
+      if (auto const layout = findLauncherLayout(*apkSession)) {
+        files.push_back(*layout);
+      }
+    } catch (std::exception const &exception) {
+      LOGW("unable to find launcher layout of [{}], {}", apkPath_, exception.what());
+    }
+    for (auto const file : {RESOURCES_TABLE, MAIN_DEX}) {
+      if (archive.contains(file)) {
+        files.emplace_back(file);
+      }
+    }
+    return files;
+  }
+
+  //
+  // Best effort: the resources are parsed into the session and other
+  // entries inflated into it, up to MAX_PREFETCHED_SIZE and the memory
+  // budget, for getFileBytes() to hand out.  Returns whether the file is
+  // ready.
+  //
+  auto prefetch(std::string_view filePath) const -> bool {
+    TRACE_SPAN("Apk::prefetch");
+    LOGD("prefetch, filePath [{}]", filePath);
+    auto const apkSession = session();
+    auto const &archive = apkSession->archive;
+    try {
+      if (filePath == RESOURCES_TABLE) {
+        return getResources(*apkSession) != nullptr;
+      }
+      auto const entry = archive.entry(filePath);
+      if (!entry) {
+        return false;
+      }
+      if (archive.view(filePath) || findPrefetched(*apkSession, filePath)) {
+        return true;
+      }
+      {
+        auto const lock = std::lock_guard(apkSession->mutex);
+        if (apkSession->prefetchedSize + entry->uncompressedSize > MAX_PREFETCHED_SIZE || !budget_->fits(entry->uncompressedSize)) {
+          return false;
+        }
+      }
+      auto contents = inflateEntry(*apkSession, filePath);
+      auto const lock = std::lock_guard(apkSession->mutex);
+      if (apkSession->prefetchedSize + contents->size() > MAX_PREFETCHED_SIZE) {
+        return false;
+      }
+      apkSession->prefetchedSize += contents->size();
+      apkSession->prefetched.try_emplace(std::string(filePath), std::move(contents));
+      return true;
+    } catch (std::exception const &exception) {
+      LOGW("unable to prefetch [{}] of [{}], {}", filePath, apkPath_, exception.what());
+      return false;
+    }
+  }
+
+  auto getResourceValues() const -> std::map<std::string, std::string> {
+    TRACE_SPAN("Apk::getResourceValues");
+    auto values = std::map<std::string, std::string>();
+    auto const apkSession = session();
+    auto const resources = getResources(*apkSession);
+    if (resources == nullptr) {
+      return values;
+    }
+    auto const &table = resources->table;
+    for (auto const id : table.ids()) {
+      auto const entry = table.find(id);
+      auto name = table.getName(id);
+      if (entry && name) {
+        values.insert_or_assign(std::move(*name), getResourceValueText(table, *entry));
+      }
+    }
+    return values;
+  }
+
+  auto hashEntries(utils::ThreadPool &threadPool) const -> std::vector<ApkEntryDigest> {
+    TRACE_SPAN("Apk::hashEntries");
+    if (auto const encoded = loadCachedData(ENTRY_DIGESTS_DATA)) {
+      try {
+        return decodeEntryDigests(*encoded);
+      } catch (std::exception const &exception) {
+        LOGW("hashEntries, ignoring cached digests, {}", exception.what());
+      }
+    }
+    auto const workerCount = std::max<size_t>(threadPool.threadCount(), 1);
+    auto hashes = std::vector<utils::sha::Sha256>(workerCount);
+    auto workerDigests = std::vector<std::vector<ApkEntryDigest>>(workerCount);
+    auto const hashEntry = [&hashes, &workerDigests](size_t const worker, ZipEntry const &entry, ZipEntryStream const &stream) {
+      auto &hash = hashes[worker];
+      stream([&hash](auto const chunk) { hash.update(chunk); });
+      workerDigests[worker].push_back(ApkEntryDigest{entry.path, hash.finish()});
+    };
+    auto const apkSession = session();
+    auto const &archive = apkSession->archive;
+    archive.streamAll([](auto const &) { return true; }, hashEntry, threadPool);
+    archive.advise(utils::AccessAdvice::DontNeed);
+
+    auto digests = std::vector<ApkEntryDigest>();
+    for (auto &entryDigests : workerDigests) {
+      std::move(entryDigests.begin(), entryDigests.end(), std::back_inserter(digests));
+    }
+    std::sort(digests.begin(), digests.end(), [](auto const &left, auto const &right) { return left.path < right.path; });
+    storeCachedData(ENTRY_DIGESTS_DATA, encodeEntryDigests(digests));
+    return digests;
   }
 
-  auto getProperties() const -> std::map<std::string, std::string> {
-    auto const isApkValid = isValid();
-    auto properties = std::map<std::string, std::string>{{"valid", isApkValid ? "true" : "false"}};
+  auto loadCachedData(std::string_view name) const -> std::optional<std::vector<std::byte>> {
+    auto const apkSession = session();
+    auto const analysis = getAnalysis(*apkSession);
+    return analysis ? cache_->loadData(analysis->digest, name) : std::nullopt;
+  }
 
-    if (isValid()) {
-      auto const androidManifestContents = getFileContent(ANDROID_MANIFEST);
-      auto const androidManifestParser = AndroidManifestParser(androidManifestContents);
+  auto storeCachedData(std::string_view name, std::span<std::byte const> data) const -> void {
+    auto const apkSession = session();
+    if (auto const analysis = getAnalysis(*apkSession)) {
+      cache_->storeData(analysis->digest, name, data);
+    }
+  }
 
-      properties.insert({"debuggable", androidManifestParser.isApplicationDebuggable() ? "true" : "false"});
-      properties.insert({"manifest", androidManifestParser.toStringXml()});
-      properties.insert({"packageName", androidManifestParser.getPackageName()});
-      properties.insert({"versionCode", androidManifestParser.getVersionCode()});
-      properties.insert({"versionName", androidManifestParser.getVersionName()});
-      properties.insert({"sha256", utils::sha::generateSha256ForFile(apkPath_)});
+  auto setFileContent(std::string_view filePath, std::vector<std::byte> const &contents) const -> void {
+    LOGD("setFileContent, filePath [{}] contents [{}]", filePath, contents.size());
+    if (contents.empty()) {
+      throw std::invalid_argument("contents are empty");
+    }
+    auto const apkSession = session();
+    auto const &archive = apkSession->archive;
+    if (archive.contains(filePath)) {
+      auto transaction = ZipTransaction();
+      transaction.replace(filePath, contents);
+      archive.commit(transaction);
+    } else {
+      archive.add(contents, filePath);
     }
+    dropSession();
+  }
 
+  //
+  // With a cache, fields it already holds are served from it and the ones
+  // computed are added to it.  Properties are computed without holding the
+  // session, so that threads asking for the same APK share the hash.
+  //
+  auto getProperties(ApkPropertyFields const fields, ApkProgressCallback const &onProgress) const -> std::map<std::string, std::string> {
+    TRACE_SPAN("Apk::getProperties");
+    auto const apkSession = session();
+    auto const analysis = getAnalysis(*apkSession);
+    if (analysis == nullptr) {
+      return computeProperties(*apkSession, fields, onProgress);
+    }
+    auto &cachedProperties = analysis->properties;
+    {
+      auto const lock = std::lock_guard(apkSession->mutex);
+      auto const names = getPropertyNames(fields);
+      auto const valid = cachedProperties.find("valid");
+      auto const isCached = [&cachedProperties](std::string_view const name) { return cachedProperties.contains(std::string(name)); };
+      if (valid != cachedProperties.end() && (valid->second == "false" || std::all_of(names.begin(), names.end(), isCached))) {
+        LOGD("getProperties, cached for [{}]", apkPath_);
+        auto properties = std::map<std::string, std::string>{*valid};
+        for (auto const name : valid->second == "true" ? names : std::vector<std::string_view>()) {
+          properties.emplace(*cachedProperties.find(std::string(name)));
+        }
+        return properties;
+      }
+    }
+    auto properties = computeProperties(*apkSession, fields, onProgress);
+    auto const lock = std::lock_guard(apkSession->mutex);
+    for (auto const &[name, value] : properties) {
+      cachedProperties.insert_or_assign(name, value);
+    }
+    cache_->store(*analysis);
     return properties;
   }
 
-  auto dump(std::string_view destinationDirectory) const -> void {
+  auto setMemoryBudget(uint64_t const bytes) const -> void {
+    LOGD("setMemoryBudget, bytes [{}]", bytes);
+    budget_->setLimit(bytes);
+  }
+
+  //
+  // With a memory budget, resources are decoded and written one after the
+  // other rather than on every worker at once.  Cancelling throws from the
+  // filter, so the workers stop picking entries instead of inflating the
+  // rest for a consumer that is gone.
+  //
+  auto dump(std::string_view destinationDirectory, utils::CancellationToken const &cancellation) const -> void {
+    TRACE_SPAN("Apk::dump");
     fs::create_directories(destinationDirectory);
     auto const androidManifest = getAndroidManifest();
     fs::path androidManifestFile = fs::path(destinationDirectory) / ANDROID_MANIFEST;
-    utils::writeToFile(androidManifestFile, androidManifest);
+    auto output = utils::FileOutput();
+    output.write(androidManifestFile.string(), std::as_bytes(std::span(androidManifest)));
+
+    auto const destinationPath = fs::path(std::string(destinationDirectory)).lexically_normal();
+    auto const apkSession = session();
+    auto const resources = getResources(*apkSession);
+    auto inlinePool = utils::ThreadPool(0);
+    auto &threadPool = budget_->limit() == 0 ? getThreadPool(utils::ThreadPool::shared()) : inlinePool;
+    auto const isDumped = [&cancellation](ZipEntry const &entry) {
+      cancellation.throwIfCancelled();
+      return isXmlResource(entry);
+    };
+    decodeXmlResources(apkSession->archive, resources ? &resources->table : nullptr, isDumped, threadPool, [&destinationPath, &output](DecodedXmlResource resource) {
+      auto const resourcePath = getDestinationPath(destinationPath, resource.path);
+      if (!resource.error.empty() || !resourcePath) {
+        LOGW("skipping [{}] in dump", resource.path);
+        return;
+      }
+      fs::create_directories(resourcePath->parent_path());
+      output.write(resourcePath->string(), std::as_bytes(std::span(resource.xml)));
+    });
+    output.flush();
+  }
+
+  auto dump(ZipStreamWriter &writer, utils::CancellationToken const &cancellation) const -> void {
+    TRACE_SPAN("Apk::dump");
+    writer.add(ANDROID_MANIFEST, getAndroidManifest());
+    auto const apkSession = session();
+    auto const resources = getResources(*apkSession);
+    auto inlinePool = utils::ThreadPool(0);
+    auto &threadPool = budget_->limit() == 0 ? getThreadPool(utils::ThreadPool::shared()) : inlinePool;
+    auto const isDumped = [&cancellation](ZipEntry const &entry) {
+      cancellation.throwIfCancelled();
+      return isXmlResource(entry);
+    };
+    decodeXmlResources(apkSession->archive, resources ? &resources->table : nullptr, isDumped, threadPool, [&writer](DecodedXmlResource resource) {
+      if (!resource.error.empty()) {
+        LOGW("skipping [{}] in dump", resource.path);
+        return;
+      }
+      writer.add(resource.path, resource.xml);
+    });
+  }
+
+  auto extract(std::string_view destinationDirectory, ApkExtractOptions const &options, utils::ThreadPool &threadPool) const -> size_t {
+    TRACE_SPAN("Apk::extract");
+    LOGD("extract, destinationDirectory [{}] globs [{}] decodeXml [{}]", destinationDirectory, options.include.size(), options.decodeXml);
+    auto const destinationPath = fs::path(std::string(destinationDirectory)).lexically_normal();
+    fs::create_directories(destinationPath);
+    auto const isIncluded = [&options](ZipEntry const &entry) {
+      options.cancellation.throwIfCancelled();
+      auto const matches = [&entry](std::string const &glob) { return utils::matchesGlob(glob, entry.path); };
+      return options.include.empty() || std::any_of(options.include.begin(), options.include.end(), matches);
+    };
+    auto written = std::atomic_size_t(0);
+
+    auto const apkSession = session();
+    if (options.decodeXml) {
+      auto const resources = getResources(*apkSession);
+      auto output = utils::FileOutput();
+      decodeXmlResources(apkSession->archive, resources ? &resources->table : nullptr, isIncluded, threadPool,
+                         [&destinationPath, &output, &written](DecodedXmlResource resource) {
+                           auto const filePath = getDestinationPath(destinationPath, resource.path);
+                           if (!resource.error.empty() || !filePath) {
+                             LOGW("skipping [{}] in extract", resource.path);
+                             return;
+                           }
+                           fs::create_directories(filePath->parent_path());
+                           output.write(filePath->string(), std::as_bytes(std::span(resource.xml)));
+                           written++;
+                         });
+      output.flush();
+      return written;
+    }
+
+    auto const contentStore = fs::path(options.contentStore);
+    if (!options.contentStore.empty()) {
+      fs::create_directories(contentStore);
+    }
+    static auto &storeHits = utils::metrics::counter("apk.extract_store_hits");
+
+    //
+    // Without hashes, entries already in the store are linked before they
+    // are read at all.
+    //
+    auto const isExtracted = [&](ZipEntry const &entry) {
+      if (!isIncluded(entry)) {
+        return false;
+      }
+      if (options.contentStore.empty() || options.verifyContents) {
+        return true;
+      }
+      auto const filePath = getDestinationPath(destinationPath, entry.path);
+      auto const storePath = getStorePath(contentStore, entry, std::nullopt);
+      auto error = std::error_code();
+      if (!filePath || !fs::exists(storePath, error)) {
+        return true;
+      }
+      fs::create_directories(filePath->parent_path(), error);
+      if (!linkStoredFile(storePath, *filePath, options.storeLink)) {
+        return true;
+      }
+      storeHits.add();
+      written++;
+      return false;
+    };
+
+    //
+    // Every worker writes through an output of its own.
+    //
+    auto outputs = std::vector<std::unique_ptr<utils::FileOutput>>(std::max<size_t>(threadPool.threadCount(), 1));
+    auto const writeEntry = [&](size_t const worker, ZipEntry const &entry, std::span<std::byte const> const contents) {
+      auto const filePath = getDestinationPath(destinationPath, entry.path);
+      if (!filePath) {
+        LOGW("skipping [{}] in extract", entry.path);
+        return;
+      }
+      auto error = std::error_code();
+      fs::create_directories(filePath->parent_path(), error);
+      if (!options.contentStore.empty()) {
+        auto const sha256 = options.verifyContents ? std::optional(utils::sha::Sha256().update(contents).finish()) : std::nullopt;
+        auto const storePath = getStorePath(contentStore, entry, sha256);
+        auto const isStored = fs::exists(storePath, error);
+        if (!isStored) {
+          addStoredFile(storePath, contents);
+        }
+        if (linkStoredFile(storePath, *filePath, options.storeLink)) {
+          if (isStored) {
+            storeHits.add();
+          }
+          written++;
+          return;
+        }
+      }
+      auto &output = outputs[worker];
+      if (output == nullptr) {
+        output = std::make_unique<utils::FileOutput>();
+      }
+      output->write(filePath->string(), contents);
+      written++;
+    };
+    apkSession->archive.extractAll(isExtracted, writeEntry, threadPool);
+    for (auto const &output : outputs) {
+      if (output != nullptr) {
+        output->flush();
+      }
+    }
+    return written;
   }
 
 private:
+  //
+  // While the hash runs on a thread of its own, its progress is polled and
+  // reported from the calling thread; without one, the hash reports it.
+  //
+  auto computeProperties(ApkSession &apkSession, ApkPropertyFields const fields, ApkProgressCallback const &onProgress) const
+      -> std::map<std::string, std::string> {
+    if (!apkSession.archive.contains(ANDROID_MANIFEST)) {
+      LOGW("unable to find manifest in [{}]", apkPath_);
+      return {{"valid", "false"}};
+    }
+    auto const sha256 = fields.contains(ApkPropertyField::Sha256) ? getSha256(apkSession, onProgress) : std::shared_future<std::string>();
+    auto const androidManifest = getManifest(apkSession);
+    auto properties = std::map<std::string, std::string>{{"valid", "true"}};
+    if (androidManifest == nullptr || !androidManifest->isValid()) {
+      return {{"valid", "false"}};
+    }
+    addManifestProperties(androidManifest->getManifestProperties(), fields, properties);
+    if (fields.contains(ApkPropertyField::Manifest)) {
+      auto const resolver = getResourceResolver(apkSession);
+      auto const lock = std::lock_guard(apkSession.documentMutex);
+      properties.emplace("manifest", androidManifest->toStringXml(resolver));
+    }
+    if (sha256.valid()) {
+      while (onProgress && sha256.wait_for(PROGRESS_INTERVAL) != std::future_status::ready) {
+        onProgress(apkSession.sha256Progress->load(), apkSession.stamp.size);
+      }
+      try {
+        properties.emplace("sha256", sha256.get());
+      } catch (utils::CancellationException const &) {
+        auto const lock = std::lock_guard(apkSession.mutex);
+        apkSession.sha256 = {};
+        throw;
+      }
+    }
+    return properties;
+  }
+
+  //
+  // Hashes the file on the background pool, so that it overlaps with the
+  // manifest being inflated, parsed and queried on the calling thread.
+  //
+  auto getSha256(ApkSession &apkSession, ApkProgressCallback const &onProgress) const -> std::shared_future<std::string> {
+    auto const lock = std::lock_guard(apkSession.mutex);
+    if (!apkSession.sha256.valid()) {
+      auto inlineProgress = backgroundPool_.threadCount() == 0 ? onProgress : ApkProgressCallback();
+      apkSession.sha256 = backgroundPool_
+                              .submit([apkPath = apkPath_, reader = reader_, progress = apkSession.sha256Progress, inlineProgress] {
+                                TRACE_SPAN("Apk::sha256");
+                                try {
+                                  auto const apkReader = reader ? reader : std::make_shared<FileZipReader const>(apkPath);
+                                  return generateSha256ForReader(*apkReader, *progress, inlineProgress);
+                                } catch (utils::CancellationException const &) {
+                                  throw;
+                                } catch (std::exception const &exception) {
+                                  LOGW("unable to hash [{}], {}", apkPath, exception.what());
+                                  return std::string();
+                                }
+                              })
+                              .share();
+    }
+    return apkSession.sha256;
+  }
+
+  //
+  // Returns the session of the APK, starting a new one if there is none yet
+  // or the file changed since it was started.  Writes through this class drop
+  // the session themselves.  Calls hold on to the session they started with,
+  // so one replaced meanwhile stays valid until they return.
+  //
+  auto session() const -> std::shared_ptr<ApkSession> {
+    auto const lock = std::lock_guard(sessionMutex_);
+    if (reader_ != nullptr) {
+      if (!session_) {
+        session_ = std::make_shared<ApkSession>(reader_, ApkFileStamp{reader_->size(), {}});
+      }
+      return session_;
+    }
+    auto const stamp = getFileStamp(apkPath_);
+    if (!session_ || session_->stamp != stamp) {
+      LOGD("starting session for [{}]", apkPath_);
+      session_ = std::make_shared<ApkSession>(apkPath_, stamp);
+    }
+    return session_;
+  }
+
+  auto dropSession() const -> void {
+    auto const lock = std::lock_guard(sessionMutex_);
+    session_.reset();
+  }
+
+  auto isManifestRead(ApkSession &apkSession) const -> bool {
+    auto const lock = std::lock_guard(apkSession.mutex);
+    return apkSession.manifestRead;
+  }
+
+  //
+  // Checks the manifest from its central directory record and first chunk
+  // header alone: a sane size, a CRC and an xml chunk spanning the entry.
+  //
+  auto isManifestPlausible(ApkSession const &apkSession) const -> bool {
+    TRACE_SPAN("Apk::isManifestPlausible");
+    try {
+      auto const &archive = apkSession.archive;
+      auto const entry = archive.entry(ANDROID_MANIFEST);
+      if (!entry || entry->uncompressedSize < 2 * sizeof(uint32_t) || entry->uncompressedSize > MAX_MANIFEST_SIZE || entry->crc == 0) {
+        return false;
+      }
+      auto header = std::array<std::byte, 2 * sizeof(uint32_t)>();
+      if (archive.peek(*entry, header) != header.size()) {
+        return false;
+      }
+      auto stream = DataStream(header);
+      return stream.read<uint32_t>() == XML_IDENTIFIER && stream.read<uint32_t>() == entry->uncompressedSize;
+    } catch (std::exception const &exception) {
+      LOGD("isManifestPlausible, {}", exception.what());
+      return false;
+    }
+  }
+
+  //
+  // Returns the parsed manifest, or nullptr if the APK has no readable
+  // manifest.  Threads asking for it while it is parsed wait for that parse
+  // rather than starting their own.  It is only used with the document
+  // mutex of the session held.
+  //
+  auto getManifest(ApkSession &apkSession) const -> AndroidManifestParser const * {
+    auto const lock = std::lock_guard(apkSession.mutex);
+    if (!apkSession.manifestRead) {
+      TRACE_SPAN("Apk::readManifest");
+      evictPrefetched(apkSession, ANDROID_MANIFEST);
+      auto memory = reserveEntry(apkSession, MANIFEST_MEMORY, ANDROID_MANIFEST);
+      apkSession.manifestRead = true;
+      if (!apkSession.archive.contains(ANDROID_MANIFEST)) {
+        LOGW("unable to find manifest in [{}]", apkPath_);
+        return nullptr;
+      }
+      auto contents = apkSession.archive.extract(ANDROID_MANIFEST);
+      if (contents.empty()) {
+        LOGW("unable to read [{}]", apkPath_);
+        return nullptr;
+      }
+      static auto &manifestParses = utils::metrics::counter("apk.manifest_parses");
+      manifestParses.add();
+      apkSession.manifest = std::make_unique<AndroidManifestParser>(std::move(contents));
+      apkSession.manifestMemory = std::move(memory);
+    }
+    return apkSession.manifest.get();
+  }
+
+  //
+  // Resource table of the APK, read on first use; nullptr if the APK has no
+  // readable resources.arsc, in which case references render by id.  That is
+  // also how they render when the table does not fit the memory budget.  The
+  // table may be used on any thread; its resolver only with the document
+  // mutex of the session held.
+  //
+  auto getResources(ApkSession &apkSession) const -> ApkResources * {
+    auto const lock = std::lock_guard(apkSession.mutex);
+    if (!apkSession.resourcesRead) {
+      TRACE_SPAN("Apk::readResources");
+      apkSession.resourcesRead = true;
+      try {
+        evictPrefetched(apkSession, RESOURCES_TABLE);
+        if (auto const entry = apkSession.archive.entry(RESOURCES_TABLE); entry && !budget_->fits(entry->uncompressedSize)) {
+          LOGW("resources of [{}] do not fit the memory budget, rendering references by id", apkPath_);
+        } else if (entry) {
+          apkSession.resourcesMemory = budget_->reserve(RESOURCES_MEMORY, entry->uncompressedSize);
+          static auto &resourceTableParses = utils::metrics::counter("apk.resource_table_parses");
+          resourceTableParses.add();
+          apkSession.resources = std::make_unique<ApkResources>(apkSession.archive.extract(RESOURCES_TABLE));
+        }
+      } catch (std::exception const &exception) {
+        LOGW("unable to read resources of [{}], {}", apkPath_, exception.what());
+      }
+    }
+    return apkSession.resources.get();
+  }
+
+  //
+  // Accounts the uncompressed size of the entry, if there is one, to the
+  // subsystem, throwing if it does not fit the budget.
+  //
+  auto reserveEntry(ApkSession const &apkSession, char const *const subsystem, std::string_view const filePath) const -> utils::memory::MemoryReservation {
+    auto const entry = apkSession.archive.entry(filePath);
+    return budget_->reserve(subsystem, entry ? entry->uncompressedSize : 0);
+  }
+
+  auto inflateEntry(ApkSession const &apkSession, std::string_view const filePath) const -> std::shared_ptr<AccountedBytes> {
+    auto const &archive = apkSession.archive;
+    auto contents = std::make_shared<AccountedBytes>(utils::memory::AccountingAllocator<std::byte>(budget_, ENTRIES_MEMORY));
+    if (auto const entry = archive.entry(filePath)) {
+      contents->reserve(getInflatedSize(*entry));
+    }
+    archive.extract(filePath, [&contents](auto const chunk) { contents->insert(contents->end(), chunk.begin(), chunk.end()); });
+    return contents;
+  }
+
+  //
+  // Drops prefetched entries, in order of path, until the entry fits the
+  // memory budget or none are left, so that a file asked for is read rather
+  // than failing on memory taken by guesses of what comes next.  Entries
+  // still handed out stay charged until their last holder lets go.  Expects
+  // the mutex of the session held.
+  //
+  auto evictPrefetched(ApkSession &apkSession, std::string_view const filePath) const -> void {
+    auto const entry = apkSession.archive.entry(filePath);
+    if (!entry) {
+      return;
+    }
+    while (!apkSession.prefetched.empty() && !budget_->fits(entry->uncompressedSize)) {
+      auto const prefetched = apkSession.prefetched.begin();
+      LOGD("evictPrefetched, evicting [{}] for [{}]", prefetched->first, filePath);
+      apkSession.prefetchedSize -= prefetched->second->size();
+      apkSession.prefetched.erase(prefetched);
+    }
+  }
+
+  auto findPrefetched(ApkSession &apkSession, std::string_view const filePath) const -> std::shared_ptr<AccountedBytes const> {
+    auto const lock = std::lock_guard(apkSession.mutex);
+    auto const prefetched = apkSession.prefetched.find(filePath);
+    return prefetched != apkSession.prefetched.end() ? prefetched->second : nullptr;
+  }
+
+  //
+  // Path of the layout of the activity the launcher starts, if there is one
+  // named after it.
+  //
+  auto findLauncherLayout(ApkSession &apkSession) const -> std::optional<std::string> {
+    auto const androidManifest = getManifest(apkSession);
+    auto const resources = getResources(apkSession);
+    if (androidManifest == nullptr || resources == nullptr) {
+      return std::nullopt;
+    }
+    auto const components = androidManifest->getComponents();
+    auto const launcher = findLauncherActivity(components);
+    if (!launcher) {
+      return std::nullopt;
+    }
+    auto const layoutNames = getLayoutNames(*launcher);
+    auto const &table = resources->table;
+    auto bestRank = layoutNames.size();
+    auto bestPath = std::optional<std::string>();
+    for (auto const id : table.ids()) {
+      auto const name = table.getName(id);
+      auto const rank = name ? static_cast<size_t>(std::ranges::find(layoutNames, *name) - layoutNames.begin()) : bestRank;
+      if (rank >= bestRank) {
+        continue;
+      }
+      if (auto const entry = table.find(id); entry && !entry->complex && entry->value.type == TYPE_STRING) {
+        if (auto const path = table.getString(entry->value.data); apkSession.archive.contains(path)) {
+          bestRank = rank;
+          bestPath = std::string(path);
+        }
+      }
+    }
+    return bestPath;
+  }
+
+  auto getResourceResolver(ApkSession &apkSession) const -> ResourceResolver * {
+    auto const resources = getResources(apkSession);
+    return resources ? &resources->resolver : nullptr;
+  }
+
+  //
+  // Analysis of the APK from the cache, or a fresh one to fill in; nullptr
+  // without a cache.  Only the central directory is read to find it.  Its
+  // properties are only used with the mutex of the session held.
+  //
+  auto getAnalysis(ApkSession &apkSession) const -> ApkAnalysis * {
+    if (!cache_) {
+      return nullptr;
+    }
+    auto const lock = std::lock_guard(apkSession.mutex);
+    if (!apkSession.analysis) {
+      TRACE_SPAN("Apk::loadAnalysis");
+      auto entries = apkSession.archive.entries();
+      auto const digest = AnalysisCache::digest(apkSession.stamp.size, entries);
+      auto analysis = cache_->load(digest);
+      apkSession.analysis = std::make_unique<ApkAnalysis>(analysis ? std::move(*analysis) : ApkAnalysis{digest, std::move(entries), {}});
+    }
+    return apkSession.analysis.get();
+  }
+
   std::string const apkPath_;
+
+  //
+  // Where the APK is read from when it is not the file at apkPath_.
+  //
+  std::shared_ptr<ZipReader const> const reader_;
+
+  std::unique_ptr<AnalysisCache const> const cache_;
+
+  //
+  // Shared with the ApkFileBytes views into its archive and with the calls
+  // running on it.
+  //
+  mutable std::shared_ptr<ApkSession> session_;
+
+  mutable std::mutex sessionMutex_;
+
+  bool const isThreadBound_ = false;
+
+  //
+  // Runs file hashing next to the parsing done by the calling thread; runs
+  // it inline where there are no threads.
+  //
+  mutable utils::ThreadPool backgroundPool_;
+
+  mutable utils::ThreadPool inlinePool_{0};
+
+  std::shared_ptr<utils::memory::MemoryBudget> const budget_ = std::make_shared<utils::memory::MemoryBudget>();
 };
 
-Apk::Apk(std::string_view apkPath) : pimpl_(std::make_unique<Apk::ApkImpl>(apkPath)) {}
+Apk::Apk(std::string_view apkPath) : Apk(apkPath, std::string_view()) {}
+
+Apk::Apk(std::string_view apkPath, std::string_view cacheDirectory)
+    : pimpl_(std::make_unique<Apk::ApkImpl>(apkPath, cacheDirectory, std::min<size_t>(1, utils::ThreadPool::defaultThreadCount()))) {}
+
+Apk::Apk(std::vector<std::byte> contents, std::string_view cacheDirectory)
+    : pimpl_(std::make_unique<Apk::ApkImpl>(std::make_shared<MemoryZipReader const>(std::move(contents)), cacheDirectory,
+                                            std::min<size_t>(1, utils::ThreadPool::defaultThreadCount()))) {}
+
+Apk::Apk(uint64_t const size, ApkRangeFetcher fetcher, std::string_view cacheDirectory, ApkFetcherThreads const fetcherThreads)
+    : pimpl_(std::make_unique<Apk::ApkImpl>(std::make_shared<RangeZipReader const>(size, std::move(fetcher)), cacheDirectory,
+                                            std::min<size_t>(1, utils::ThreadPool::defaultThreadCount()), fetcherThreads)) {}
+
+Apk::Apk(int const fd, std::string_view cacheDirectory)
+    : pimpl_(std::make_unique<Apk::ApkImpl>(openDescriptorReader(fd), cacheDirectory, std::min<size_t>(1, utils::ThreadPool::defaultThreadCount()))) {}
 
 Apk::~Apk() = default;
 
-auto Apk::isValid() const -> bool { return pimpl_->isValid(); }
+auto Apk::isValid() const -> bool { return pimpl_->isValid(ApkValidation::Full); }
+
+auto Apk::isValid(ApkValidation const validation) const -> bool { return pimpl_->isValid(validation); }
 
 auto Apk::makeDebuggable() const -> void { return pimpl_->makeDebuggable(); }
 
+auto Apk::makeDebuggable(std::string_view destinationPath) const -> void { pimpl_->makeDebuggable(destinationPath); }
+
 auto Apk::isDebuggable() const -> bool { return pimpl_->isDebuggable(); }
 
 auto Apk::getAndroidManifest() const -> std::string { return pimpl_->getAndroidManifest(); }
 
+auto Apk::getAndroidManifest(std::function<void(std::string_view)> const &onChunk) const -> void { pimpl_->getAndroidManifest(onChunk); }
+
+auto Apk::getAndroidManifestTree() const -> std::string { return pimpl_->getAndroidManifestTree(); }
+
+auto Apk::getManifestComponents() const -> ManifestComponents { return pimpl_->getManifestComponents(); }
+
 auto Apk::getFiles() const -> std::vector<std::string> { return pimpl_->getFiles(); }
 
+auto Apk::getEntries() const -> std::vector<ApkEntry> { return pimpl_->getEntries(); }
+
 auto Apk::getFileContent(std::string_view filePath) const -> std::vector<std::byte> { return pimpl_->getFileContent(filePath); }
 
-auto Apk::getProperties() const -> std::map<std::string, std::string> { return pimpl_->getProperties(); }
+auto Apk::getFileBytes(std::string_view filePath) const -> ApkFileBytes { return pimpl_->getFileBytes(filePath); }
+
+auto Apk::getLikelyNextFiles() const -> std::vector<std::string> { return pimpl_->getLikelyNextFiles(); }
+
+auto Apk::prefetch(std::string_view filePath) const -> bool { return pimpl_->prefetch(filePath); }
+
+auto Apk::getFilePrefix(std::string_view filePath, size_t const size) const -> std::vector<std::byte> { return pimpl_->getFilePrefix(filePath, size); }
+
+auto Apk::getResourceValues() const -> std::map<std::string, std::string> { return pimpl_->getResourceValues(); }
+
+auto Apk::hashEntries() const -> std::vector<ApkEntryDigest> {
+  auto &threadPool = utils::ThreadPool::shared();
+  return hashEntries(threadPool);
+}
+
+auto Apk::hashEntries(utils::ThreadPool &threadPool) const -> std::vector<ApkEntryDigest> {
+  return pimpl_->hashEntries(pimpl_->getThreadPool(threadPool));
+}
 
-auto Apk::dump(std::string_view destinationDirectory) const -> void { return pimpl_->dump(destinationDirectory); }
+auto Apk::loadCachedData(std::string_view name) const -> std::optional<std::vector<std::byte>> { return pimpl_->loadCachedData(name); }
+
+auto Apk::storeCachedData(std::string_view name, std::span<std::byte const> data) const -> void { pimpl_->storeCachedData(name, data); }
+
+auto Apk::classifyEntries() const -> std::vector<ApkEntryContentType> {
+  auto &threadPool = utils::ThreadPool::shared();
+  return classifyEntries(threadPool);
+}
+
+auto Apk::classifyEntries(utils::ThreadPool &threadPool) const -> std::vector<ApkEntryContentType> {
+  return pimpl_->classifyEntries(pimpl_->getThreadPool(threadPool));
+}
+
+auto Apk::grep(std::span<std::string const> patterns, ApkGrepOptions const &options, utils::ThreadPool &threadPool) const -> std::vector<ApkGrepMatch> {
+  return pimpl_->grep(patterns, options, pimpl_->getThreadPool(threadPool));
+}
+
+auto Apk::setFileContent(std::string_view filePath, std::vector<std::byte> const &contents) const -> void { pimpl_->setFileContent(filePath, contents); }
+
+auto Apk::getProperties() const -> std::map<std::string, std::string> { return pimpl_->getProperties(ApkPropertyFields::all(), {}); }
+
+auto Apk::getProperties(ApkPropertyFields const fields) const -> std::map<std::string, std::string> { return pimpl_->getProperties(fields, {}); }
+
+auto Apk::getProperties(ApkPropertyFields const fields, ApkProgressCallback const &onProgress) const -> std::map<std::string, std::string> {
+  return pimpl_->getProperties(fields, onProgress);
+}
+
+auto Apk::setMemoryBudget(uint64_t const bytes) const -> void { pimpl_->setMemoryBudget(bytes); }
+
+auto Apk::dump(std::string_view destinationDirectory, utils::CancellationToken const &cancellation) const -> void {
+  return pimpl_->dump(destinationDirectory, cancellation);
+}
+
+auto Apk::dump(ZipStreamWriter &writer, utils::CancellationToken const &cancellation) const -> void { return pimpl_->dump(writer, cancellation); }
+
+auto Apk::extract(std::string_view destinationDirectory, ApkExtractOptions const &options, utils::ThreadPool &threadPool) const -> size_t {
+  return pimpl_->extract(destinationDirectory, options, pimpl_->getThreadPool(threadPool));
+}
+
+auto ai::analyzeMany(std::span<std::string const> const apkPaths, ApkBatchOptions const &options, utils::ThreadPool &threadPool,
+                     ApkBatchCallback const &callback) -> void {
+  auto const maxInFlight = options.maxInFlight > 0 ? options.maxInFlight : std::max<size_t>(1, 2 * threadPool.threadCount());
+  LOGD("analyzeMany, apks [{}] maxInFlight [{}]", apkPaths.size(), maxInFlight);
+
+  //
+  // Never more results than APKs in flight, so workers never wait to push
+  // and a pool without threads can run every task inline.
+  //
+  auto results = utils::BoundedQueue<ApkBatchResult>(maxInFlight);
+  auto const analyze = [&options, &results](std::string const &apkPath) {
+    auto result = ApkBatchResult{apkPath, {}, {}};
+    try {
+      result.properties = Apk::ApkImpl(apkPath, options.cacheDirectory, 0).getProperties(options.fields, {});
+    } catch (std::exception const &exception) {
+      result.error = exception.what();
+    }
+    results.push(std::move(result));
+  };
+
+  auto next = size_t{0};
+  auto inFlight = size_t{0};
+  try {
+    while (next < apkPaths.size() || inFlight > 0) {
+      if (options.cancellation.isCancelled()) {
+        next = apkPaths.size();
+      }
+      for (; next < apkPaths.size() && inFlight < maxInFlight; next++, inFlight++) {
+        threadPool.submit([&analyze, &apkPath = apkPaths[next]] { analyze(apkPath); });
+      }
+      if (inFlight == 0) {
+        break;
+      }
+      auto result = results.pop();
+      inFlight--;
+      callback(std::move(*result));
+    }
+  } catch (...) {
+    //
+    // Tasks still running refer to the queue on this stack.
+    //
+    for (; inFlight > 0; inFlight--) {
+      results.pop();
+    }
+    throw;
+  }
+  options.cancellation.throwIfCancelled();
+}
+
+auto ai::indexPermissions(std::span<std::string const> const apkPaths, ApkBatchOptions const &options, utils::ThreadPool &threadPool) -> PermissionIndex {
+  TRACE_SPAN("indexPermissions");
+  auto index = PermissionIndex();
+  auto const cache = options.cacheDirectory.empty() ? nullptr : std::make_unique<AnalysisCache const>(options.cacheDirectory);
+  auto isDictionaryCached = false;
+  if (cache != nullptr) {
+    if (auto const record = cache->loadSharedData(PERMISSION_DICTIONARY_DATA)) {
+      try {
+        index.dictionary = PermissionDictionary::decode(*record);
+        isDictionaryCached = true;
+      } catch (std::exception const &exception) {
+        LOGW("indexPermissions, ignoring cached dictionary, {}", exception.what());
+      }
+    }
+  }
+  auto const cachedSize = index.dictionary.size();
+
+  //
+  // Workers intern into the one dictionary, so ids are assigned in no
+  // particular order, but they are stable once stored.
+  //
+  auto dictionaryMutex = std::mutex();
+  auto const getBits = [&options, &index, &dictionaryMutex](std::string const &apkPath) -> PermissionBits {
+    options.cancellation.throwIfCancelled();
+    auto const apk = Apk::ApkImpl(apkPath, options.cacheDirectory, 0);
+    if (auto const record = apk.loadCachedData(PERMISSION_BITS_DATA)) {
+      try {
+        auto const lock = std::lock_guard(dictionaryMutex);
+        if (auto bits = index.dictionary.decodeBits(*record)) {
+          return std::move(*bits);
+        }
+      } catch (std::exception const &exception) {
+        LOGW("indexPermissions, ignoring cached bits of [{}], {}", apkPath, exception.what());
+      }
+    }
+    auto const components = apk.getManifestComponents();
+    auto bits = PermissionBits();
+    auto record = std::vector<std::byte>();
+    {
+      auto const lock = std::lock_guard(dictionaryMutex);
+      for (auto const permission : components.requestedPermissions()) {
+        bits.add(PermissionUse::Requested, index.dictionary.intern(components.getString(permission)));
+      }
+      for (auto const permission : components.declaredPermissions()) {
+        bits.add(PermissionUse::Declared, index.dictionary.intern(components.getString(permission)));
+      }
+      record = index.dictionary.encodeBits(bits);
+    }
+    apk.storeCachedData(PERMISSION_BITS_DATA, record);
+    return bits;
+  };
+
+  auto futures = std::vector<std::future<PermissionBits>>();
+  futures.reserve(apkPaths.size());
+  for (auto const &apkPath : apkPaths) {
+    futures.push_back(threadPool.submit([&getBits, &apkPath] { return getBits(apkPath); }));
+  }
+  index.errors.resize(apkPaths.size());
+  for (auto i = size_t{0}; i < futures.size(); i++) {
+    try {
+      index.matrix.addRow(futures[i].get());
+    } catch (std::exception const &exception) {
+      index.matrix.addRow({});
+      index.errors[i] = exception.what();
+    }
+  }
+  LOGD("indexPermissions, apks [{}] permissions [{}] new [{}]", apkPaths.size(), index.dictionary.size(), index.dictionary.size() - cachedSize);
+  if (cache != nullptr && (!isDictionaryCached || index.dictionary.size() != cachedSize)) {
+    cache->storeSharedData(PERMISSION_DICTIONARY_DATA, index.dictionary.encode());
+  }
+
+  //
+  // Only once the dictionary is stored, as cached bits refer to its ids.
+  //
+  options.cancellation.throwIfCancelled();
+  return index;
+}
+
+auto ai::scanMany(std::span<ApkScanTarget const> const targets, std::string_view const indexPath, ApkBatchOptions const &options,
+                  utils::ThreadPool &threadPool, ApkBatchCallback const &callback) -> size_t {
+  auto const indexFile = std::string(indexPath);
+  auto previousRecords = std::map<std::string, ApkScanRecord>();
+  for (auto &record : loadScanIndex(indexFile)) {
+    auto path = record.path;
+    previousRecords.emplace(std::move(path), std::move(record));
+  }
+
+  auto records = std::map<std::string, ApkScanRecord>();
+  auto changedPaths = std::vector<std::string>();
+  for (auto const &target : targets) {
+    auto error = std::error_code();
+    auto const size = fs::file_size(target.path, error);
+    if (error) {
+      callback(ApkBatchResult{target.path, {}, error.message()});
+      continue;
+    }
+    auto record = ApkScanRecord{target.path, size, target.lastUpdateTime, options.fields.bits(), {}};
+    auto const previous = previousRecords.find(target.path);
+    if (previous != previousRecords.end() && previous->second.size == size && previous->second.lastUpdateTime == target.lastUpdateTime &&
+        (previous->second.fields & record.fields) == record.fields) {
+      record.fields = previous->second.fields;
+      record.properties = std::move(previous->second.properties);
+      callback(ApkBatchResult{target.path, record.properties, {}});
+    } else {
+      changedPaths.push_back(target.path);
+    }
+    records.insert_or_assign(target.path, std::move(record));
+  }
+  LOGD("scanMany, apks [{}] changed [{}]", targets.size(), changedPaths.size());
+
+  analyzeMany(changedPaths, options, threadPool, [&records, &callback](ApkBatchResult result) {
+    if (result.error.empty()) {
+      records.at(result.path).properties = result.properties;
+    } else {
+      records.erase(result.path);
+    }
+    callback(std::move(result));
+  });
+
+  auto index = std::vector<ApkScanRecord>();
+  index.reserve(records.size());
+  for (auto &[path, record] : records) {
+    index.push_back(std::move(record));
+  }
+  storeScanIndex(indexFile, index);
+  return changedPaths.size();
+}
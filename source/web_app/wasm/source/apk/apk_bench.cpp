@@ -0,0 +1,176 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "apk/apk.h"
+#include "apk_analyzer/apk_analyzer.h"
+#include "binary_xml/binary_xml.h"
+#include "utils/data_stream.h"
+#include "utils/sha.h"
+#include "utils/unicode.h"
+#include "zip_archiver.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+//
+// Corpus APK of the tests, found through AI_TESTS_DIR like apk_test does.
+//
+auto getCorpusApkPath() -> std::string {
+  auto const testsDir = std::getenv("AI_TESTS_DIR");
+  return (fs::path(testsDir != nullptr ? testsDir : ".") / "resources" / "apks" / "test_release.apk").string();
+}
+
+auto getManifestBytes() -> std::vector<std::byte> const & {
+  static auto const manifest = ai::ZipArchiver(getCorpusApkPath()).extract("AndroidManifest.xml");
+  return manifest;
+}
+
+//
+// apkanalyzer of the SDK in AI_ANDROID_HOME, like apk_test uses; empty if
+// it is not set.
+//
+auto getApkAnalyzerPath() -> std::string {
+  auto const androidHome = std::getenv("AI_ANDROID_HOME");
+  return androidHome != nullptr ? (fs::path(androidHome) / "tools" / "bin" / "apkanalyzer").string() : std::string();
+}
+
+auto ZipArchiver_files(benchmark::State &state) -> void {
+  auto const archiver = ai::ZipArchiver(getCorpusApkPath());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(archiver.files());
+  }
+}
+BENCHMARK(ZipArchiver_files);
+
+auto ZipArchiver_openAndListFiles(benchmark::State &state) -> void {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ai::ZipArchiver(getCorpusApkPath()).files());
+  }
+}
+BENCHMARK(ZipArchiver_openAndListFiles);
+
+auto ZipArchiver_extract(benchmark::State &state) -> void {
+  auto const archiver = ai::ZipArchiver(getCorpusApkPath());
+  auto contents = std::vector<std::byte>();
+  for (auto _ : state) {
+    archiver.extract("classes.dex", contents);
+    benchmark::DoNotOptimize(contents.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * contents.size()));
+}
+BENCHMARK(ZipArchiver_extract);
+
+auto BinaryXml_construct(benchmark::State &state) -> void {
+  auto const &manifest = getManifestBytes();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ai::BinaryXml(manifest));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * manifest.size()));
+}
+BENCHMARK(BinaryXml_construct);
+
+auto BinaryXml_toStringXml(benchmark::State &state) -> void {
+  auto const binaryXml = ai::BinaryXml(getManifestBytes());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(binaryXml.toStringXml());
+  }
+}
+BENCHMARK(BinaryXml_toStringXml);
+
+auto BinaryXml_getElementAttributes(benchmark::State &state) -> void {
+  auto const binaryXml = ai::BinaryXml(getManifestBytes());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(binaryXml.getElementAttributes({"manifest", "application"}));
+  }
+}
+BENCHMARK(BinaryXml_getElementAttributes);
+
+auto DataStream_read(benchmark::State &state) -> void {
+  auto const &manifest = getManifestBytes();
+  for (auto _ : state) {
+    auto stream = DataStream(manifest);
+    auto sum = uint32_t(0);
+    while (stream.remaining() >= sizeof(uint32_t)) {
+      sum += stream.read<uint32_t>();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * manifest.size()));
+}
+BENCHMARK(DataStream_read);
+
+auto Unicode_toUtf8(benchmark::State &state) -> void {
+  auto const utf16 = std::u16string(static_cast<size_t>(state.range(0)), u'a');
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ai::utils::unicode::toUtf8(utf16));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * utf16.size() * sizeof(char16_t)));
+}
+BENCHMARK(Unicode_toUtf8)->Arg(16)->Arg(256)->Arg(4096);
+
+auto Sha_generateSha256ForFile(benchmark::State &state) -> void {
+  auto const apkPath = getCorpusApkPath();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ai::utils::sha::generateSha256ForFile(apkPath));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * fs::file_size(apkPath)));
+}
+BENCHMARK(Sha_generateSha256ForFile);
+
+//
+// Manifest decode throughput from opening the APK to the text, with
+// references resolved, next to what apkanalyzer does for the same output.
+//
+auto Apk_getAndroidManifest(benchmark::State &state) -> void {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ai::Apk(getCorpusApkPath()).getAndroidManifest());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * getManifestBytes().size()));
+}
+BENCHMARK(Apk_getAndroidManifest);
+
+auto ApkAnalyzer_getAndroidManifest(benchmark::State &state) -> void {
+  auto const apkAnalyzerPath = getApkAnalyzerPath();
+  if (apkAnalyzerPath.empty()) {
+    state.SkipWithError("AI_ANDROID_HOME is not set");
+    return;
+  }
+  auto const apkAnalyzer = ai::ApkAnalyzer(apkAnalyzerPath.c_str());
+  auto const apkPath = getCorpusApkPath();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(apkAnalyzer.getAndroidManifest(apkPath.c_str()));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * getManifestBytes().size()));
+}
+BENCHMARK(ApkAnalyzer_getAndroidManifest)->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
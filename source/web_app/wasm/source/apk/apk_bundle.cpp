@@ -0,0 +1,231 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "android_manifest_parser.h"
+#include "apk/apk_bundle.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+#include "zip_archiver.h"
+#include "zip_reader.h"
+
+using namespace ai;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+static constexpr char const *const ANDROID_MANIFEST = "AndroidManifest.xml";
+
+static constexpr std::string_view APK_EXTENSION = ".apk";
+
+auto isContainer(std::string_view const path) {
+  auto const extension = fs::path(path).extension();
+  return extension == ".xapk" || extension == ".apks";
+}
+
+auto getSplitName(std::string_view const path) { return fs::path(path).stem().string(); }
+
+//
+// Containers do not say which APK is the base: bundletool names it
+// "base-master.apk", xapk uses "<package>.apk" next to "config.*.apk"
+// splits.
+//
+auto getBaseIndex(std::vector<std::string> const &names) -> size_t {
+  for (size_t i{0}; i < names.size(); i++) {
+    if (names[i] == "base" || names[i] == "base-master") {
+      return i;
+    }
+  }
+  for (size_t i{0}; i < names.size(); i++) {
+    if (!names[i].starts_with("config.") && !names[i].starts_with("split_") && names[i].find("-master") == std::string::npos) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+} // namespace
+
+class ApkBundle::ApkBundleImpl final {
+public:
+  explicit ApkBundleImpl(std::vector<std::string> const &apkPaths) { openApks(apkPaths); }
+
+  explicit ApkBundleImpl(std::string_view const bundlePath) {
+    if (!isContainer(bundlePath)) {
+      openApks({std::string(bundlePath)});
+      return;
+    }
+    //
+    // One archiver, and with it one central directory scan and one set of
+    // read handles, serves the listing and every task extracting a split.
+    // Tasks share it so that it outlives those still running when one of
+    // the others fails.
+    //
+    auto const container = std::make_shared<ZipArchiver const>(bundlePath);
+    auto apkPaths = std::vector<std::string>();
+    for (auto const &file : container->files()) {
+      if (file.ends_with(APK_EXTENSION)) {
+        apkPaths.push_back(file);
+      }
+    }
+    if (apkPaths.empty()) {
+      throw std::logic_error("bundle does not contain any apk");
+    }
+    auto names = std::vector<std::string>();
+    std::transform(apkPaths.cbegin(), apkPaths.cend(), std::back_inserter(names), getSplitName);
+    std::rotate(apkPaths.begin(), apkPaths.begin() + static_cast<std::ptrdiff_t>(getBaseIndex(names)), apkPaths.end());
+
+    auto &threadPool = utils::ThreadPool::shared();
+    auto openedSplits = std::vector<std::future<Split>>();
+    for (auto const &apkPath : apkPaths) {
+      openedSplits.push_back(threadPool.submit([container, apkPath] {
+        auto reader = std::make_shared<MemoryZipReader>(container->extract(apkPath));
+        return openSplit(getSplitName(apkPath), std::make_unique<ZipArchiver>(std::move(reader)));
+      }));
+    }
+    addSplits(openedSplits);
+  }
+
+  auto getSplits() const -> std::vector<std::string> {
+    auto splits = std::vector<std::string>();
+    for (auto const &split : splits_) {
+      splits.push_back(split.name);
+    }
+    return splits;
+  }
+
+  auto getFiles() const -> std::vector<std::string> { return files_; }
+
+  auto getSplitOf(std::string_view const filePath) const -> std::string { return splits_[findOwner(filePath)].name; }
+
+  auto getFileContent(std::string_view const filePath) const -> std::vector<std::byte> { return splits_[findOwner(filePath)].archiver->extract(filePath); }
+
+  auto getFileContent(std::string_view const split, std::string_view const filePath) const -> std::vector<std::byte> {
+    return findSplit(split).archiver->extract(filePath);
+  }
+
+  auto getAndroidManifest(std::string_view const split) const -> std::string {
+    auto const &foundSplit = findSplit(split);
+    auto const lock = std::lock_guard(manifestsMutex_);
+    if (auto const manifest = manifests_.find(foundSplit.name); manifest != manifests_.cend()) {
+      return manifest->second;
+    }
+    auto const manifest = AndroidManifestParser(foundSplit.archiver->extract(ANDROID_MANIFEST)).toStringXml();
+    manifests_.emplace(foundSplit.name, manifest);
+    return manifest;
+  }
+
+private:
+  struct Split {
+
+    std::string name;
+
+    std::unique_ptr<ZipArchiver> archiver;
+
+    std::vector<std::string> files;
+  };
+
+  auto openApks(std::vector<std::string> const &apkPaths) -> void {
+    if (apkPaths.empty()) {
+      throw std::logic_error("bundle needs at least one apk");
+    }
+    auto &threadPool = utils::ThreadPool::shared();
+    auto openedSplits = std::vector<std::future<Split>>();
+    for (auto const &apkPath : apkPaths) {
+      openedSplits.push_back(threadPool.submit([apkPath] { return openSplit(getSplitName(apkPath), std::make_unique<ZipArchiver>(apkPath)); }));
+    }
+    addSplits(openedSplits);
+  }
+
+  static auto openSplit(std::string name, std::unique_ptr<ZipArchiver> archiver) -> Split {
+    LOGD("openSplit, name [{}]", name);
+    auto files = archiver->files();
+    return Split{std::move(name), std::move(archiver), std::move(files)};
+  }
+
+  auto addSplits(std::vector<std::future<Split>> &openedSplits) -> void {
+    for (auto &openedSplit : openedSplits) {
+      auto split = openedSplit.get();
+      for (auto &file : split.files) {
+        if (fileOwners_.emplace(file, splits_.size()).second) {
+          files_.push_back(std::move(file));
+        }
+      }
+      split.files.clear();
+      splits_.push_back(std::move(split));
+    }
+  }
+
+  auto findOwner(std::string_view const filePath) const -> size_t {
+    if (auto const owner = fileOwners_.find(std::string(filePath)); owner != fileOwners_.cend()) {
+      return owner->second;
+    }
+    throw std::logic_error("file does not exist in bundle");
+  }
+
+  auto findSplit(std::string_view const name) const -> Split const & {
+    auto const split = std::find_if(splits_.cbegin(), splits_.cend(), [&name](auto const &candidate) { return candidate.name == name; });
+    if (split == splits_.cend()) {
+      throw std::logic_error("split does not exist in bundle");
+    }
+    return *split;
+  }
+
+  std::vector<Split> splits_;
+
+  std::vector<std::string> files_;
+
+  std::unordered_map<std::string, size_t> fileOwners_;
+
+  mutable std::mutex manifestsMutex_;
+
+  mutable std::unordered_map<std::string, std::string> manifests_;
+};
+
+ApkBundle::ApkBundle(std::vector<std::string> const &apkPaths) : pimpl_(std::make_unique<ApkBundleImpl>(apkPaths)) {}
+
+ApkBundle::ApkBundle(std::string_view bundlePath) : pimpl_(std::make_unique<ApkBundleImpl>(bundlePath)) {}
+
+ApkBundle::~ApkBundle() = default;
+
+auto ApkBundle::getSplits() const -> std::vector<std::string> { return pimpl_->getSplits(); }
+
+auto ApkBundle::getFiles() const -> std::vector<std::string> { return pimpl_->getFiles(); }
+
+auto ApkBundle::getSplitOf(std::string_view filePath) const -> std::string { return pimpl_->getSplitOf(filePath); }
+
+auto ApkBundle::getFileContent(std::string_view filePath) const -> std::vector<std::byte> { return pimpl_->getFileContent(filePath); }
+
+auto ApkBundle::getFileContent(std::string_view split, std::string_view filePath) const -> std::vector<std::byte> {
+  return pimpl_->getFileContent(split, filePath);
+}
+
+auto ApkBundle::getAndroidManifest(std::string_view split) const -> std::string { return pimpl_->getAndroidManifest(split); }
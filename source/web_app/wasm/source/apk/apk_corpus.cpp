@@ -0,0 +1,359 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <array>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "apk/apk_corpus.h"
+#include "binary_xml/resource_types.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/trace.h"
+#include "utils/unicode.h"
+#include "zip_archiver.h"
+
+using namespace ai;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+static constexpr char const *const MANIFEST_PATH = "AndroidManifest.xml";
+static constexpr char const *const STRINGS_LAYOUT_PATH = "res/layout/strings.xml";
+static constexpr char const *const DEEP_LAYOUT_PATH = "res/layout/deep.xml";
+
+static constexpr char16_t const *const ANDROID_NAMESPACE = u"http://schemas.android.com/apk/res/android";
+static constexpr char16_t const *const ANDROID_PREFIX = u"android";
+static constexpr char16_t const *const PACKAGE_NAME = u"org.example.corpus";
+
+static constexpr uint64_t GIB = uint64_t{1} << 30U;
+
+//
+// Tiny entries are spread over directories of this many files.
+//
+static constexpr size_t TINY_ENTRIES_PER_DIRECTORY = 1000;
+
+static constexpr uint16_t CHUNK_HEADER_SIZE = 8;
+static constexpr uint16_t POOL_HEADER_SIZE = 28;
+static constexpr uint16_t NODE_HEADER_SIZE = 16;
+static constexpr uint16_t ATTRIBUTE_SIZE = 20;
+static constexpr uint16_t RES_VALUE_SIZE = 8;
+static constexpr uint32_t NO_STRING = UINT32_MAX;
+static constexpr uint32_t LONG_STRING_FLAG = 0x8000;
+
+//
+// Attributes of the android namespace the corpus uses, sorted by resource
+// id as aapt sorts them.  Their names lead the string pool in this order,
+// which is how the resource map pairs them with their ids.
+//
+enum AndroidAttribute : uint32_t {
+  ANDROID_NAME,
+  ANDROID_EXPORTED,
+  ANDROID_ORIENTATION,
+  ANDROID_TEXT,
+  ANDROID_VERSION_CODE,
+  ANDROID_VERSION_NAME,
+};
+
+static constexpr std::array<std::pair<char16_t const *, uint32_t>, 6> ANDROID_ATTRIBUTES = {{
+    {u"name", 0x01010003},
+    {u"exported", 0x01010010},
+    {u"orientation", 0x010100c4},
+    {u"text", 0x0101014f},
+    {u"versionCode", 0x0101021b},
+    {u"versionName", 0x0101021c},
+}};
+
+using ai::utils::little_endian::append;
+
+auto appendChunkHeader(std::vector<std::byte> &bytes, uint16_t const type, uint16_t const headerSize, size_t const size) -> void {
+  append<uint16_t>(bytes, type);
+  append<uint16_t>(bytes, headerSize);
+  append<uint32_t>(bytes, static_cast<uint32_t>(size));
+}
+
+auto toUtf16(std::string_view const text) -> std::u16string { return utils::unicode::toUtf16(text); }
+
+//
+// Bytes of a string in a UTF-16 pool: its length, in one unit or two past
+// 0x7fff, its characters and a terminating 0.
+//
+auto getEncodedSize(std::u16string const &text) -> size_t {
+  return (text.size() < LONG_STRING_FLAG ? sizeof(uint16_t) : 2 * sizeof(uint16_t)) + (text.size() + 1) * sizeof(char16_t);
+}
+
+//
+// Writes a binary xml document in the layout aapt2 gives it: one UTF-16
+// string pool, the resource map of the android attributes and the nodes
+// inside a single android namespace.
+//
+class BinaryXmlWriter final {
+public:
+  struct Attribute {
+
+    uint32_t name;
+
+    uint8_t type;
+
+    //
+    // Index of the value in the string pool for TYPE_STRING.
+    //
+    uint32_t data;
+
+    bool android = true;
+  };
+
+  BinaryXmlWriter() {
+    for (auto const &[name, resourceId] : ANDROID_ATTRIBUTES) {
+      string(name);
+    }
+    prefix_ = string(ANDROID_PREFIX);
+    namespace_ = string(ANDROID_NAMESPACE);
+    appendNamespace(RES_XML_START_NAMESPACE_TYPE);
+  }
+
+  auto string(std::u16string_view const text) -> uint32_t {
+    auto const [found, inserted] = indices_.try_emplace(std::u16string(text), static_cast<uint32_t>(strings_.size()));
+    if (inserted) {
+      strings_.emplace_back(text);
+    }
+    return found->second;
+  }
+
+  auto startElement(std::u16string_view const name, std::initializer_list<Attribute> const attributes) -> void {
+    auto const size = NODE_HEADER_SIZE + ATTRIBUTE_SIZE + attributes.size() * ATTRIBUTE_SIZE;
+    appendNode(RES_XML_START_ELEMENT_TYPE, size);
+    append<uint32_t>(nodes_, NO_STRING);
+    append<uint32_t>(nodes_, string(name));
+    append<uint16_t>(nodes_, ATTRIBUTE_SIZE);
+    append<uint16_t>(nodes_, ATTRIBUTE_SIZE);
+    append<uint16_t>(nodes_, static_cast<uint16_t>(attributes.size()));
+    append<uint16_t>(nodes_, 0);
+    append<uint16_t>(nodes_, 0);
+    append<uint16_t>(nodes_, 0);
+    for (auto const &attribute : attributes) {
+      append<uint32_t>(nodes_, attribute.android ? namespace_ : NO_STRING);
+      append<uint32_t>(nodes_, attribute.name);
+      append<uint32_t>(nodes_, attribute.type == TYPE_STRING ? attribute.data : NO_STRING);
+      append<uint16_t>(nodes_, RES_VALUE_SIZE);
+      append<uint8_t>(nodes_, 0);
+      append<uint8_t>(nodes_, attribute.type);
+      append<uint32_t>(nodes_, attribute.data);
+    }
+  }
+
+  auto endElement(std::u16string_view const name) -> void {
+    appendNode(RES_XML_END_ELEMENT_TYPE, NODE_HEADER_SIZE + 8);
+    append<uint32_t>(nodes_, NO_STRING);
+    append<uint32_t>(nodes_, string(name));
+  }
+
+  //
+  // Closes the namespace and returns the whole document.
+  //
+  auto finish() -> std::vector<std::byte> {
+    appendNamespace(RES_XML_END_NAMESPACE_TYPE);
+    auto stringsSize = size_t{0};
+    for (auto const &text : strings_) {
+      stringsSize += getEncodedSize(text);
+    }
+    auto const stringsStart = POOL_HEADER_SIZE + strings_.size() * sizeof(uint32_t);
+    auto const poolSize = (stringsStart + stringsSize + 3) & ~size_t{3};
+    auto const mapSize = CHUNK_HEADER_SIZE + ANDROID_ATTRIBUTES.size() * sizeof(uint32_t);
+    auto document = std::vector<std::byte>();
+    document.reserve(CHUNK_HEADER_SIZE + poolSize + mapSize + nodes_.size());
+    appendChunkHeader(document, RES_XML_TYPE, CHUNK_HEADER_SIZE, CHUNK_HEADER_SIZE + poolSize + mapSize + nodes_.size());
+
+    appendChunkHeader(document, RES_STRING_POOL_TYPE, POOL_HEADER_SIZE, poolSize);
+    append<uint32_t>(document, static_cast<uint32_t>(strings_.size()));
+    append<uint32_t>(document, 0);
+    append<uint32_t>(document, 0);
+    append<uint32_t>(document, static_cast<uint32_t>(stringsStart));
+    append<uint32_t>(document, 0);
+    auto offset = size_t{0};
+    for (auto const &text : strings_) {
+      append<uint32_t>(document, static_cast<uint32_t>(offset));
+      offset += getEncodedSize(text);
+    }
+    for (auto const &text : strings_) {
+      if (text.size() >= LONG_STRING_FLAG) {
+        append<uint16_t>(document, static_cast<uint16_t>(LONG_STRING_FLAG | (text.size() >> 16U)));
+      }
+      append<uint16_t>(document, static_cast<uint16_t>(text.size()));
+      for (auto const character : text) {
+        append<char16_t>(document, character);
+      }
+      append<char16_t>(document, 0);
+    }
+    document.resize(CHUNK_HEADER_SIZE + poolSize);
+
+    appendChunkHeader(document, RES_XML_RESOURCE_MAP_TYPE, CHUNK_HEADER_SIZE, mapSize);
+    for (auto const &[name, resourceId] : ANDROID_ATTRIBUTES) {
+      append<uint32_t>(document, resourceId);
+    }
+    document.insert(document.end(), nodes_.begin(), nodes_.end());
+    return document;
+  }
+
+private:
+  auto appendNode(uint16_t const type, size_t const size) -> void {
+    appendChunkHeader(nodes_, type, NODE_HEADER_SIZE, size);
+    append<uint32_t>(nodes_, ++lineNumber_);
+    append<uint32_t>(nodes_, NO_STRING);
+  }
+
+  auto appendNamespace(uint16_t const type) -> void {
+    appendNode(type, NODE_HEADER_SIZE + 8);
+    append<uint32_t>(nodes_, prefix_);
+    append<uint32_t>(nodes_, namespace_);
+  }
+
+  std::vector<std::u16string> strings_;
+
+  std::unordered_map<std::u16string, uint32_t> indices_;
+
+  std::vector<std::byte> nodes_;
+
+  uint32_t prefix_ = NO_STRING;
+
+  uint32_t namespace_ = NO_STRING;
+
+  uint32_t lineNumber_ = 0;
+};
+
+auto getManifest(size_t const components) -> std::vector<std::byte> {
+  auto writer = BinaryXmlWriter();
+  auto const package = BinaryXmlWriter::Attribute{writer.string(u"package"), TYPE_STRING, writer.string(PACKAGE_NAME), false};
+  writer.startElement(u"manifest", {{ANDROID_VERSION_CODE, TYPE_INT_DEC, 1}, {ANDROID_VERSION_NAME, TYPE_STRING, writer.string(u"1.0")}, package});
+  writer.startElement(u"application", {});
+  for (size_t i{0}; i < components; i++) {
+    auto const name = writer.string(std::u16string(PACKAGE_NAME) + u".Activity" + toUtf16(std::to_string(i)));
+    writer.startElement(u"activity", {{ANDROID_NAME, TYPE_STRING, name}, {ANDROID_EXPORTED, TYPE_INT_BOOLEAN, RES_VALUE_FALSE}});
+    writer.endElement(u"activity");
+  }
+  writer.endElement(u"application");
+  writer.endElement(u"manifest");
+  return writer.finish();
+}
+
+//
+// Every string has a character outside of Latin-1, so that none of them
+// could have been narrowed to a UTF-8 pool.
+//
+auto getStringsLayout(size_t const strings) -> std::vector<std::byte> {
+  auto writer = BinaryXmlWriter();
+  writer.startElement(u"LinearLayout", {{ANDROID_ORIENTATION, TYPE_INT_DEC, 1}});
+  for (size_t i{0}; i < strings; i++) {
+    auto const text = writer.string(u"String \u2116" + toUtf16(std::to_string(i)));
+    writer.startElement(u"TextView", {{ANDROID_TEXT, TYPE_STRING, text}});
+    writer.endElement(u"TextView");
+  }
+  writer.endElement(u"LinearLayout");
+  return writer.finish();
+}
+
+auto getDeepLayout(size_t const depth) -> std::vector<std::byte> {
+  auto writer = BinaryXmlWriter();
+  for (size_t i{0}; i < depth; i++) {
+    writer.startElement(u"LinearLayout", {{ANDROID_ORIENTATION, TYPE_INT_DEC, static_cast<uint32_t>(i % 2)}});
+  }
+  for (size_t i{0}; i < depth; i++) {
+    writer.endElement(u"LinearLayout");
+  }
+  return writer.finish();
+}
+
+auto getTinyEntry(size_t const index, size_t const size) -> std::vector<std::byte> {
+  auto const line = "tiny entry " + std::to_string(index) + "\n";
+  auto contents = std::vector<std::byte>(size);
+  for (size_t i{0}; i < size; i++) {
+    contents[i] = static_cast<std::byte>(line[i % line.size()]);
+  }
+  return contents;
+}
+
+//
+// Bytes that do not repeat within a page, so that nothing can mistake the
+// asset for a run of zeroes.
+//
+auto getStoredAsset(uint64_t const size) -> std::vector<std::byte> {
+  auto contents = std::vector<std::byte>(size);
+  for (uint64_t i{0}; i < size; i++) {
+    contents[i] = static_cast<std::byte>((i * 7 + (i >> 12U)) % 251);
+  }
+  return contents;
+}
+
+} // namespace
+
+auto ai::getApkCorpusShapes() -> std::vector<ApkCorpusShape> {
+  auto shapes = std::vector<ApkCorpusShape>(5);
+  shapes[0].name = "tiny-entries";
+  shapes[0].tinyEntries = 100'000;
+  shapes[1].name = "stored-assets";
+  shapes[1].storedAssets = 3;
+  shapes[1].storedAssetSize = GIB;
+  shapes[2].name = "large-manifest";
+  shapes[2].manifestComponents = 10'000;
+  shapes[3].name = "string-pool";
+  shapes[3].layoutStrings = 100'000;
+  shapes[4].name = "deep-layout";
+  shapes[4].layoutDepth = 1'000;
+  return shapes;
+}
+
+auto ai::generateCorpusApk(std::string_view const destinationPath, ApkCorpusShape const &shape, utils::ThreadPool &threadPool) -> void {
+  TRACE_SPAN("generateCorpusApk");
+  LOGD("generateCorpusApk, shape [{}], destinationPath [{}]", shape.name, destinationPath);
+  auto error = std::error_code();
+  fs::remove(fs::path(destinationPath), error);
+  if (error) {
+    throw std::logic_error("unable to replace corpus apk");
+  }
+
+  auto transaction = ZipTransaction();
+  transaction.add(MANIFEST_PATH, getManifest(shape.manifestComponents));
+  if (shape.layoutStrings > 0) {
+    transaction.add(STRINGS_LAYOUT_PATH, getStringsLayout(shape.layoutStrings));
+  }
+  if (shape.layoutDepth > 0) {
+    transaction.add(DEEP_LAYOUT_PATH, getDeepLayout(shape.layoutDepth));
+  }
+  for (size_t i{0}; i < shape.tinyEntries; i++) {
+    auto const path = "assets/tiny/" + std::to_string(i / TINY_ENTRIES_PER_DIRECTORY) + "/" + std::to_string(i) + ".txt";
+    transaction.add(path, getTinyEntry(i, shape.tinyEntrySize));
+  }
+  auto const zipArchiver = ZipArchiver(destinationPath);
+  zipArchiver.commit(transaction, threadPool);
+
+  if (shape.storedAssets > 0) {
+    auto const asset = getStoredAsset(shape.storedAssetSize);
+    for (size_t i{0}; i < shape.storedAssets; i++) {
+      zipArchiver.add(asset, "assets/large/" + std::to_string(i) + ".bin", ZipCompression::Store);
+    }
+  }
+}
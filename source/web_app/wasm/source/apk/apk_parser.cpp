@@ -22,8 +22,6 @@
 // SOFTWARE.
 //
 #include <cstdint>
-#include <filesystem>
-#include <fstream>
 #include <mz.h>
 
 #include "apk_parser.h"
@@ -34,20 +32,11 @@
 using namespace ai;
 using namespace ai::minizip;
 
-namespace {
-
-auto writeToTempFile(std::vector<std::byte> const &content) {
-  auto tempName = std::vector<char>(L_tmpnam);
-  std::tmpnam(&tempName[0]);
-  auto tempPath = std::filesystem::temp_directory_path() / tempName.data();
-  auto outputFile = std::ofstream(tempPath, std::fstream::binary);
-  outputFile.write(reinterpret_cast<char const *>(content.data()), static_cast<uint32_t>(content.size()));
-  outputFile.close();
-  return tempPath.string();
+auto ApkParser::getEntries() const -> std::vector<ZipEntry> {
+  LOGD("getEntries");
+  return ai::ZipArchiver(pathToApk_).entries();
 }
 
-} // namespace
-
 auto ApkParser::getFiles() const -> std::vector<std::string> {
   LOGD("getFileNames");
   return ai::ZipArchiver(pathToApk_).files();
@@ -63,8 +52,12 @@ auto ApkParser::setFileContents(std::string_view fileInArchive, std::vector<std:
   if (contents.empty()) {
     throw std::invalid_argument("contents are empty");
   }
-  auto pathToContents = writeToTempFile(contents);
   auto zipArchiver = ai::ZipArchiver(pathToApk_);
-  auto inputFile = std::ifstream(pathToContents);
-  zipArchiver.add(inputFile, fileInArchive);
+  if (zipArchiver.contains(fileInArchive)) {
+    auto transaction = ai::ZipTransaction();
+    transaction.replace(fileInArchive, contents);
+    zipArchiver.commit(transaction);
+  } else {
+    zipArchiver.add(contents, fileInArchive);
+  }
 }
@@ -27,6 +27,8 @@
 #include <string>
 #include <vector>
 
+#include "zip_archiver.h"
+
 namespace ai {
 
 class ApkParser {
@@ -34,6 +36,8 @@ class ApkParser {
 public:
   ApkParser(std::string_view pathToApk) : pathToApk_(pathToApk) {}
 
+  auto getEntries() const -> std::vector<ZipEntry>;
+
   auto getFiles() const -> std::vector<std::string>;
 
   auto getFileContents(std::string_view fileInArchive) const -> std::vector<std::byte>;
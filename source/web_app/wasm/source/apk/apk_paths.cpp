@@ -0,0 +1,38 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "apk/apk_paths.h"
+
+auto ai::getDexFileName(std::size_t const index) -> std::string { return index == 0 ? "classes.dex" : "classes" + std::to_string(index + 1) + ".dex"; }
+
+auto ai::getLibraryAbi(std::string_view const path) -> std::optional<std::string_view> {
+  if (!path.starts_with(LIBRARY_DIRECTORY) || !path.ends_with(LIBRARY_EXTENSION)) {
+    return std::nullopt;
+  }
+  auto const rest = path.substr(LIBRARY_DIRECTORY.size());
+  auto const separator = rest.find('/');
+  if (separator == 0 || separator == std::string_view::npos || rest.find('/', separator + 1) != std::string_view::npos) {
+    return std::nullopt;
+  }
+  return rest.substr(0, separator);
+}
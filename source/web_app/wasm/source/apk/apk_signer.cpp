@@ -0,0 +1,200 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include "apk_signer.h"
+#include "apk_signing_block.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/mapped_file.h"
+#include "utils/signature.h"
+
+using namespace ai;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+static constexpr std::size_t CENTRAL_DIRECTORY_OFFSET_OFFSET = 16;
+
+using ai::utils::little_endian::append;
+
+//
+// Appends bytes prefixed with their uint32 length, the building block of
+// every structure in the signature blocks.
+//
+auto appendPrefixed(std::vector<std::byte> &bytes, std::span<std::byte const> const value) -> void {
+  append(bytes, static_cast<uint32_t>(value.size()));
+  bytes.insert(bytes.end(), value.begin(), value.end());
+}
+
+auto getSignatureAlgorithmId(utils::signature::SigningKey const &key) -> uint32_t {
+  switch (key.algorithm()) {
+  case utils::signature::SignatureAlgorithm::RsaPkcs1Sha256: {
+    return SIGNATURE_RSA_PKCS1_V1_5_WITH_SHA256;
+  }
+  case utils::signature::SignatureAlgorithm::EcdsaSha256: {
+    return SIGNATURE_ECDSA_WITH_SHA256;
+  }
+  case utils::signature::SignatureAlgorithm::RsaPkcs1Sha512: {
+    return SIGNATURE_RSA_PKCS1_V1_5_WITH_SHA512;
+  }
+  case utils::signature::SignatureAlgorithm::EcdsaSha512: {
+    return SIGNATURE_ECDSA_WITH_SHA512;
+  }
+  case utils::signature::SignatureAlgorithm::RsaPkcs1Sha1:
+  case utils::signature::SignatureAlgorithm::EcdsaSha1: {
+    break;
+  }
+  }
+  throw std::logic_error("unsupported signature algorithm");
+}
+
+auto encodeSignedData(uint32_t const algorithmId, std::span<std::byte const> const contentDigest, utils::signature::SigningKey const &key,
+                      std::vector<std::byte> const *const sdkVersions, std::vector<std::byte> const &attributes) -> std::vector<std::byte> {
+  auto digest = std::vector<std::byte>();
+  append(digest, algorithmId);
+  appendPrefixed(digest, contentDigest);
+  auto digests = std::vector<std::byte>();
+  appendPrefixed(digests, digest);
+
+  auto certificates = std::vector<std::byte>();
+  appendPrefixed(certificates, key.certificate());
+
+  auto signedData = std::vector<std::byte>();
+  appendPrefixed(signedData, digests);
+  appendPrefixed(signedData, certificates);
+  if (sdkVersions != nullptr) {
+    signedData.insert(signedData.end(), sdkVersions->begin(), sdkVersions->end());
+  }
+  appendPrefixed(signedData, attributes);
+  return signedData;
+}
+
+//
+// Encodes the value of a v2 or v3 block with a single signer; v3 signers
+// carry the SDK versions they are for in both the signed data and the
+// signer.
+//
+auto encodeSchemeBlock(uint32_t const algorithmId, std::span<std::byte const> const contentDigest, utils::signature::SigningKey const &key,
+                       std::vector<std::byte> const *const sdkVersions, std::vector<std::byte> const &attributes) -> std::vector<std::byte> {
+  auto const signedData = encodeSignedData(algorithmId, contentDigest, key, sdkVersions, attributes);
+
+  auto signature = std::vector<std::byte>();
+  append(signature, algorithmId);
+  appendPrefixed(signature, key.sign(signedData));
+  auto signatures = std::vector<std::byte>();
+  appendPrefixed(signatures, signature);
+
+  auto signer = std::vector<std::byte>();
+  appendPrefixed(signer, signedData);
+  if (sdkVersions != nullptr) {
+    signer.insert(signer.end(), sdkVersions->begin(), sdkVersions->end());
+  }
+  appendPrefixed(signer, signatures);
+  appendPrefixed(signer, key.publicKey());
+
+  auto signers = std::vector<std::byte>();
+  appendPrefixed(signers, signer);
+  auto block = std::vector<std::byte>();
+  appendPrefixed(block, signers);
+  return block;
+}
+
+auto write(std::ostream &destination, std::span<std::byte const> const bytes) -> void {
+  destination.write(reinterpret_cast<char const *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+} // namespace
+
+auto ai::signApk(std::span<std::byte const> const apk, utils::signature::SigningKey const &key, ApkSignerOptions const &options,
+                 utils::ThreadPool &threadPool, std::ostream &destination) -> void {
+  if (!options.v2 && !options.v3) {
+    throw std::invalid_argument("no signature scheme selected");
+  }
+  auto const sections = findApkSections(apk);
+  LOGD("signApk, entries [{}] central directory [{}] replacing block [{}]", sections.signingBlockOffset, sections.centralDirectoryOffset,
+       sections.signingBlockOffset != sections.centralDirectoryOffset);
+  auto const algorithmId = getSignatureAlgorithmId(key);
+  auto contentDigest = std::vector<std::byte>();
+  if (isSha512SignatureAlgorithm(algorithmId)) {
+    auto const digest = computeApkContentSha512Digest(apk, sections, threadPool);
+    contentDigest.assign(digest.begin(), digest.end());
+  } else {
+    auto const digest = computeApkContentDigest(apk, sections, threadPool);
+    contentDigest.assign(digest.begin(), digest.end());
+  }
+
+  auto values = std::vector<ApkSigningBlockValue>();
+  if (options.v2) {
+    auto attributes = std::vector<std::byte>();
+    if (options.v3) {
+      auto attribute = std::vector<std::byte>();
+      append(attribute, STRIPPING_PROTECTION_ATTRIBUTE_ID);
+      append(attribute, STRIPPING_PROTECTION_V3);
+      appendPrefixed(attributes, attribute);
+    }
+    values.emplace_back(APK_SIGNATURE_SCHEME_V2_BLOCK_ID, encodeSchemeBlock(algorithmId, contentDigest, key, nullptr, attributes));
+  }
+  if (options.v3) {
+    auto sdkVersions = std::vector<std::byte>();
+    append(sdkVersions, options.minSdkVersion);
+    append(sdkVersions, options.maxSdkVersion);
+    values.emplace_back(APK_SIGNATURE_SCHEME_V3_BLOCK_ID, encodeSchemeBlock(algorithmId, contentDigest, key, &sdkVersions, {}));
+  }
+  auto const signingBlock = encodeApkSigningBlock(values);
+
+  auto endOfCentralDirectory = std::vector<std::byte>(apk.begin() + static_cast<std::ptrdiff_t>(sections.endOfCentralDirectoryOffset), apk.end());
+  auto const centralDirectoryOffset = static_cast<uint32_t>(sections.signingBlockOffset + signingBlock.size());
+  memcpy(endOfCentralDirectory.data() + CENTRAL_DIRECTORY_OFFSET_OFFSET, &centralDirectoryOffset, sizeof(centralDirectoryOffset));
+
+  write(destination, apk.first(sections.signingBlockOffset));
+  write(destination, signingBlock);
+  write(destination, apk.subspan(sections.centralDirectoryOffset, sections.endOfCentralDirectoryOffset - sections.centralDirectoryOffset));
+  write(destination, endOfCentralDirectory);
+  if (!destination.good()) {
+    throw std::runtime_error("unable to write signed apk");
+  }
+}
+
+auto ai::signApk(std::string const &apkPath, std::string const &destinationPath, utils::signature::SigningKey const &key, ApkSignerOptions const &options,
+                 utils::ThreadPool &threadPool) -> void {
+  auto const temporaryPath = destinationPath + ".tmp";
+  try {
+    auto const apk = utils::MappedFile(apkPath);
+    auto destination = std::ofstream(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    signApk(apk.bytes(), key, options, threadPool, destination);
+  } catch (...) {
+    auto error = std::error_code();
+    fs::remove(temporaryPath, error);
+    throw;
+  }
+  fs::rename(temporaryPath, destinationPath);
+}
@@ -0,0 +1,80 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_APK_SIGNER_H_
+#define ANDROID_INTROSPECTION_APK_APK_SIGNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <string>
+
+namespace ai {
+
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+namespace utils::signature {
+class SigningKey;
+} // namespace utils::signature
+
+struct ApkSignerOptions {
+
+  bool v2 = true;
+
+  bool v3 = true;
+
+  //
+  // Platform versions the v3 signer is for; v3 is only read from Android 9
+  // (API 28) on.
+  //
+  uint32_t minSdkVersion = 28;
+
+  uint32_t maxSdkVersion = INT32_MAX;
+};
+
+//
+// Signs the APK with APK Signature Scheme v2 and/or v3 and writes the signed
+// APK to destination: the entries, a new APK Signing Block, the central
+// directory and the end of central directory record.  A signing block the
+// APK already has is replaced.  Content digests are computed over 1 MB
+// chunks on the workers of the pool, with SHA-512 for RSA keys over 3072
+// bits and EC keys over 256 bits as apksigner does; v1 (JAR) signatures are
+// left as they are.
+//
+auto signApk(std::span<std::byte const> apk, utils::signature::SigningKey const &key, ApkSignerOptions const &options, utils::ThreadPool &threadPool,
+             std::ostream &destination) -> void;
+
+//
+// Same as above, reading from a memory mapping of the file at apkPath; the
+// destination may be the same file, which is then replaced once the signed
+// copy is complete.
+//
+auto signApk(std::string const &apkPath, std::string const &destinationPath, utils::signature::SigningKey const &key, ApkSignerOptions const &options,
+             utils::ThreadPool &threadPool) -> void;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_APK_SIGNER_H_ */
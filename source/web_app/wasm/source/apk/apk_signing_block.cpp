@@ -0,0 +1,220 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string_view>
+
+#include "apk_signing_block.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr uint32_t END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+
+static constexpr uint32_t ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIGNATURE = 0x07064b50;
+
+static constexpr std::size_t END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+
+static constexpr std::size_t ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIZE = 20;
+
+static constexpr std::size_t CENTRAL_DIRECTORY_SIZE_OFFSET = 12;
+
+static constexpr std::size_t CENTRAL_DIRECTORY_OFFSET_OFFSET = 16;
+
+static constexpr std::size_t COMMENT_LENGTH_OFFSET = 20;
+
+static constexpr std::size_t MAX_COMMENT_LENGTH = UINT16_MAX;
+
+static constexpr std::string_view SIGNING_BLOCK_MAGIC = "APK Sig Block 42";
+
+//
+// Size field and magic that close the signing block.
+//
+static constexpr std::size_t SIGNING_BLOCK_FOOTER_SIZE = sizeof(uint64_t) + SIGNING_BLOCK_MAGIC.size();
+
+static constexpr std::size_t CONTENT_CHUNK_SIZE = 1024 * 1024;
+
+static constexpr std::byte CHUNK_DIGEST_PREFIX{0xa5};
+
+static constexpr std::byte TOP_DIGEST_PREFIX{0x5a};
+
+//
+// Chunks digested by one task, so that small files are not split into more
+// tasks than chunks and large ones keep every worker busy.
+//
+static constexpr std::size_t TASKS_PER_THREAD = 4;
+
+template <typename T> auto load(std::span<std::byte const> const bytes, uint64_t const offset) -> T {
+  return utils::little_endian::load<T>(bytes, offset, "invalid apk offset");
+}
+
+using ai::utils::little_endian::append;
+
+auto findEndOfCentralDirectory(std::span<std::byte const> const apk) -> uint64_t {
+  if (apk.size() < END_OF_CENTRAL_DIRECTORY_SIZE) {
+    throw std::logic_error("not a zip archive");
+  }
+  auto const last = apk.size() - END_OF_CENTRAL_DIRECTORY_SIZE;
+  for (auto commentLength = std::size_t{0}; commentLength <= std::min(last, MAX_COMMENT_LENGTH); commentLength++) {
+    auto const offset = last - commentLength;
+    if (load<uint32_t>(apk, offset) == END_OF_CENTRAL_DIRECTORY_SIGNATURE && load<uint16_t>(apk, offset + COMMENT_LENGTH_OFFSET) == commentLength) {
+      return offset;
+    }
+  }
+  throw std::logic_error("not a zip archive");
+}
+
+//
+// Chunked content digest with Hash, utils::sha::Sha256 or Sha512.
+//
+template <typename Hash> auto computeChunkedDigest(std::span<std::byte const> const apk, ApkSections const &sections, utils::ThreadPool &threadPool) {
+  auto endOfCentralDirectory = std::vector<std::byte>(apk.begin() + static_cast<std::ptrdiff_t>(sections.endOfCentralDirectoryOffset), apk.end());
+  auto const signingBlockOffset = static_cast<uint32_t>(sections.signingBlockOffset);
+  memcpy(endOfCentralDirectory.data() + CENTRAL_DIRECTORY_OFFSET_OFFSET, &signingBlockOffset, sizeof(signingBlockOffset));
+
+  auto const contents = std::array{apk.subspan(0, sections.signingBlockOffset),
+                                   apk.subspan(sections.centralDirectoryOffset, sections.endOfCentralDirectoryOffset - sections.centralDirectoryOffset),
+                                   std::span<std::byte const>(endOfCentralDirectory)};
+  auto chunks = std::vector<std::span<std::byte const>>();
+  for (auto const section : contents) {
+    for (auto offset = std::size_t{0}; offset < section.size(); offset += CONTENT_CHUNK_SIZE) {
+      chunks.push_back(section.subspan(offset, std::min(CONTENT_CHUNK_SIZE, section.size() - offset)));
+    }
+  }
+
+  auto chunkDigests = std::vector<decltype(Hash().finish())>(chunks.size());
+  auto const digestChunks = [&chunks, &chunkDigests](std::size_t const begin, std::size_t const end) {
+    auto hash = Hash();
+    for (auto i = begin; i < end; i++) {
+      auto const chunkSize = static_cast<uint32_t>(chunks[i].size());
+      hash.update(std::span(&CHUNK_DIGEST_PREFIX, 1)).update(std::as_bytes(std::span(&chunkSize, 1))).update(chunks[i]);
+      chunkDigests[i] = hash.finish();
+    }
+  };
+  auto const taskCount = std::clamp<std::size_t>(threadPool.threadCount() * TASKS_PER_THREAD, 1, std::max<std::size_t>(chunks.size(), 1));
+  auto const chunksPerTask = (chunks.size() + taskCount - 1) / taskCount;
+  auto tasks = std::vector<std::future<void>>();
+  for (auto begin = std::size_t{0}; begin < chunks.size(); begin += chunksPerTask) {
+    tasks.push_back(threadPool.submit([&digestChunks, begin, end = std::min(begin + chunksPerTask, chunks.size())] { digestChunks(begin, end); }));
+  }
+  for (auto &task : tasks) {
+    task.wait();
+  }
+  for (auto &task : tasks) {
+    task.get();
+  }
+  LOGD("computeChunkedDigest, chunks [{}] tasks [{}]", chunks.size(), tasks.size());
+
+  auto hash = Hash();
+  auto const chunkCount = static_cast<uint32_t>(chunks.size());
+  hash.update(std::span(&TOP_DIGEST_PREFIX, 1)).update(std::as_bytes(std::span(&chunkCount, 1)));
+  for (auto const &chunkDigest : chunkDigests) {
+    hash.update(chunkDigest);
+  }
+  return hash.finish();
+}
+
+} // namespace
+
+auto ai::isSha512SignatureAlgorithm(uint32_t const id) -> bool { return id == SIGNATURE_RSA_PKCS1_V1_5_WITH_SHA512 || id == SIGNATURE_ECDSA_WITH_SHA512; }
+
+auto ai::findApkSections(std::span<std::byte const> const apk) -> ApkSections {
+  auto const endOfCentralDirectoryOffset = findEndOfCentralDirectory(apk);
+  if (endOfCentralDirectoryOffset >= ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIZE &&
+      load<uint32_t>(apk, endOfCentralDirectoryOffset - ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIZE) == ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIGNATURE) {
+    throw std::logic_error("zip64 archives are not supported");
+  }
+  auto const centralDirectorySize = load<uint32_t>(apk, endOfCentralDirectoryOffset + CENTRAL_DIRECTORY_SIZE_OFFSET);
+  auto const centralDirectoryOffset = load<uint32_t>(apk, endOfCentralDirectoryOffset + CENTRAL_DIRECTORY_OFFSET_OFFSET);
+  if (uint64_t{centralDirectoryOffset} + centralDirectorySize != endOfCentralDirectoryOffset) {
+    throw std::logic_error("central directory does not precede end of central directory");
+  }
+
+  auto sections = ApkSections{centralDirectoryOffset, centralDirectoryOffset, endOfCentralDirectoryOffset, apk.size()};
+  if (centralDirectoryOffset < SIGNING_BLOCK_FOOTER_SIZE + sizeof(uint64_t) ||
+      memcmp(apk.data() + centralDirectoryOffset - SIGNING_BLOCK_MAGIC.size(), SIGNING_BLOCK_MAGIC.data(), SIGNING_BLOCK_MAGIC.size()) != 0) {
+    return sections;
+  }
+  auto const blockSize = load<uint64_t>(apk, centralDirectoryOffset - SIGNING_BLOCK_FOOTER_SIZE);
+  if (blockSize < SIGNING_BLOCK_FOOTER_SIZE || blockSize > centralDirectoryOffset - sizeof(uint64_t)) {
+    throw std::logic_error("invalid apk signing block size");
+  }
+  auto const signingBlockOffset = centralDirectoryOffset - blockSize - sizeof(uint64_t);
+  if (load<uint64_t>(apk, signingBlockOffset) != blockSize) {
+    throw std::logic_error("mismatched apk signing block sizes");
+  }
+  sections.signingBlockOffset = signingBlockOffset;
+  return sections;
+}
+
+auto ai::readApkSigningBlock(std::span<std::byte const> const apk, ApkSections const &sections) -> std::vector<ApkSigningBlockEntry> {
+  auto entries = std::vector<ApkSigningBlockEntry>();
+  auto const end = sections.centralDirectoryOffset - SIGNING_BLOCK_FOOTER_SIZE;
+  for (auto offset = sections.signingBlockOffset + sizeof(uint64_t); offset < end;) {
+    auto const length = load<uint64_t>(apk, offset);
+    if (length < sizeof(uint32_t) || length > end - offset - sizeof(uint64_t)) {
+      throw std::logic_error("invalid apk signing block entry");
+    }
+    auto const id = load<uint32_t>(apk, offset + sizeof(uint64_t));
+    entries.emplace_back(id, apk.subspan(offset + sizeof(uint64_t) + sizeof(uint32_t), length - sizeof(uint32_t)));
+    offset += sizeof(uint64_t) + length;
+  }
+  return entries;
+}
+
+auto ai::encodeApkSigningBlock(std::span<ApkSigningBlockValue const> const values) -> std::vector<std::byte> {
+  auto blockSize = uint64_t{SIGNING_BLOCK_FOOTER_SIZE};
+  for (auto const &[id, value] : values) {
+    blockSize += sizeof(uint64_t) + sizeof(id) + value.size();
+  }
+  auto block = std::vector<std::byte>();
+  block.reserve(sizeof(uint64_t) + blockSize);
+  append(block, blockSize);
+  for (auto const &[id, value] : values) {
+    append(block, uint64_t{sizeof(id) + value.size()});
+    append(block, id);
+    block.insert(block.end(), value.begin(), value.end());
+  }
+  append(block, blockSize);
+  auto const magic = std::as_bytes(std::span(SIGNING_BLOCK_MAGIC));
+  block.insert(block.end(), magic.begin(), magic.end());
+  return block;
+}
+
+auto ai::computeApkContentDigest(std::span<std::byte const> const apk, ApkSections const &sections, utils::ThreadPool &threadPool)
+    -> utils::sha::Sha256Digest {
+  return computeChunkedDigest<utils::sha::Sha256>(apk, sections, threadPool);
+}
+
+auto ai::computeApkContentSha512Digest(std::span<std::byte const> const apk, ApkSections const &sections, utils::ThreadPool &threadPool)
+    -> utils::sha::Sha512Digest {
+  return computeChunkedDigest<utils::sha::Sha512>(apk, sections, threadPool);
+}
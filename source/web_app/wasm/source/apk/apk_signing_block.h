@@ -0,0 +1,118 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_APK_SIGNING_BLOCK_H_
+#define ANDROID_INTROSPECTION_APK_APK_SIGNING_BLOCK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "utils/sha.h"
+
+namespace ai {
+
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+static constexpr uint32_t APK_SIGNATURE_SCHEME_V2_BLOCK_ID = 0x7109871a;
+
+static constexpr uint32_t APK_SIGNATURE_SCHEME_V3_BLOCK_ID = 0xf05368c0;
+
+//
+// Attribute of v2 signed data saying the APK is also signed with v3, so that
+// stripping the v3 signature is detected.
+//
+static constexpr uint32_t STRIPPING_PROTECTION_ATTRIBUTE_ID = 0xbeeff00d;
+
+static constexpr uint32_t STRIPPING_PROTECTION_V3 = 3;
+
+static constexpr uint32_t SIGNATURE_RSA_PKCS1_V1_5_WITH_SHA256 = 0x0103;
+
+static constexpr uint32_t SIGNATURE_RSA_PKCS1_V1_5_WITH_SHA512 = 0x0104;
+
+static constexpr uint32_t SIGNATURE_ECDSA_WITH_SHA256 = 0x0201;
+
+static constexpr uint32_t SIGNATURE_ECDSA_WITH_SHA512 = 0x0202;
+
+//
+// Whether the v2 or v3 signature algorithm signs the SHA-512 content digest
+// rather than the SHA-256 one.
+//
+auto isSha512SignatureAlgorithm(uint32_t id) -> bool;
+
+//
+// Layout of a zip file as the APK signature schemes see it: the entries, the
+// APK Signing Block if there is one, the central directory and the end of
+// central directory record, back to back.  Without a signing block,
+// signingBlockOffset equals centralDirectoryOffset.
+//
+struct ApkSections {
+
+  uint64_t signingBlockOffset;
+
+  uint64_t centralDirectoryOffset;
+
+  uint64_t endOfCentralDirectoryOffset;
+
+  uint64_t size;
+};
+
+using ApkSigningBlockValue = std::pair<uint32_t, std::vector<std::byte>>;
+
+using ApkSigningBlockEntry = std::pair<uint32_t, std::span<std::byte const>>;
+
+//
+// Locates the sections through the end of central directory record.  Throws
+// for files that are not zip archives or use zip64 records.
+//
+auto findApkSections(std::span<std::byte const> apk) -> ApkSections;
+
+//
+// ID-value pairs of the signing block, pointing into apk; empty without a
+// block.
+//
+auto readApkSigningBlock(std::span<std::byte const> apk, ApkSections const &sections) -> std::vector<ApkSigningBlockEntry>;
+
+auto encodeApkSigningBlock(std::span<ApkSigningBlockValue const> values) -> std::vector<std::byte>;
+
+//
+// SHA-256 content digest of the v2 and v3 schemes: every section is split
+// into 1 MB chunks, the chunks are digested on the workers of the pool and
+// the digest of their digests is returned.  The central directory offset
+// in the end of central directory record is taken to be the offset of the
+// signing block, as it is in the signed file.
+//
+auto computeApkContentDigest(std::span<std::byte const> apk, ApkSections const &sections, utils::ThreadPool &threadPool) -> utils::sha::Sha256Digest;
+
+//
+// Same with SHA-512, the digest of the SHA-512 signature algorithms.
+//
+auto computeApkContentSha512Digest(std::span<std::byte const> apk, ApkSections const &sections, utils::ThreadPool &threadPool) -> utils::sha::Sha512Digest;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_APK_SIGNING_BLOCK_H_ */
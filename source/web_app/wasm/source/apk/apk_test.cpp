@@ -21,18 +21,77 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <span>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
 
 #include "apk/apk.h"
+#include "apk/apk_bundle.h"
+#include "apk/apk_paths.h"
+#include "apk/app_bundle.h"
+#include "apk/apk_corpus.h"
+#include "apk/directory_tree.h"
+#include "apk/file_listing.h"
+#include "apk/permission_index.h"
+#include "apk/size_report.h"
+#include "apk/zip_stream_writer.h"
 #include "apk_analyzer/apk_analyzer.h"
 #include "utils/log.h"
 #include "zip_archiver.h"
+#include "zip_reader.h"
 
+#include "android_manifest_parser.h"
 #include "apk_parser.h"
+#include "apk_signer.h"
+#include "apk_signing_block.h"
+#include "apk_verifier.h"
+#include "dex_patch.h"
+#include "gadget_injector.h"
+#include "pattern_matcher.h"
+#include "binary_xml/binary_xml.h"
+#include "binary_xml/res_value.h"
+#include "binary_xml/resource_resolver.h"
+#include "binary_xml/resource_structs.h"
+#include "binary_xml/resource_table.h"
+#include "binary_xml/resource_types.h"
+#include "binary_xml/string_pool.h"
+#include "binary_xml/xml_patch.h"
+#include "resource_decoder.h"
+#include "utils/adler32.h"
+#include "utils/arena.h"
+#include "utils/cancellation.h"
+#include "utils/file_output.h"
+#include "utils/format.h"
+#include "utils/glob.h"
+#include "utils/json.h"
+#include "utils/mapped_file.h"
+#include "utils/memory_budget.h"
+#include "utils/metrics.h"
+#include "utils/ring_buffer.h"
+#include "utils/sha.h"
+#include "utils/signature.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
 
 namespace fs = std::filesystem;
 
@@ -75,6 +134,16 @@ private:
 
 fs::path getTestApkPath(char const *fileName) { return fs::path(gTestEnvironment->testsDir) / "resources" / "apks" / fileName; }
 
+fs::path getTestKeyPath(char const *fileName) { return fs::path(gTestEnvironment->testsDir) / "resources" / "keys" / fileName; }
+
+auto getPagePaths(ai::FilePage const &page) -> std::vector<std::string_view> {
+  auto paths = std::vector<std::string_view>();
+  for (auto path = size_t{0}; path + 1 < page.offsets.size(); path++) {
+    paths.push_back(page.names.substr(page.offsets[path], page.offsets[path + 1] - page.offsets[path]));
+  }
+  return paths;
+}
+
 } // namespace
 
 TEST(MakeDebuggable, MakeReleaseApkIsDebuggable_ApkIsMadeDebuggableSuccessfully) {
@@ -98,6 +167,22 @@ TEST(MakeDebuggable, MakeReleaseApkIsDebuggable_ApkIsMadeDebuggableSuccessfully)
   }
 }
 
+TEST(MakeDebuggable, MakeDebuggableCopyOfReleaseApk_CopyIsDebuggableAndOriginalIsUntouched) {
+  auto const originalTestApk = getTestApkPath("test_release.apk");
+  auto const debuggableTestApk = fs::temp_directory_path() / "MakeDebuggableCopyOfReleaseApk.apk";
+  auto scopedFileDeleter = ScopedFileDeleter(debuggableTestApk.c_str());
+
+  auto const originalApk = ai::Apk(originalTestApk.string());
+  EXPECT_NO_THROW(originalApk.makeDebuggable(debuggableTestApk.string()));
+  EXPECT_FALSE(originalApk.isDebuggable());
+
+  auto const debuggableApk = ai::Apk(debuggableTestApk.string());
+  EXPECT_TRUE(debuggableApk.isDebuggable());
+  EXPECT_EQ(debuggableApk.getFiles(), originalApk.getFiles());
+  EXPECT_EQ(debuggableApk.getFileContent("resources.arsc"), originalApk.getFileContent("resources.arsc"));
+  EXPECT_EQ(debuggableApk.getProperties({ai::ApkPropertyField::Package}), originalApk.getProperties({ai::ApkPropertyField::Package}));
+}
+
 TEST(ApkParser, ReleaseApkContainsAndroidManifest_AndroidManifestFoundSuccessfully) {
   auto pathToApk = getTestApkPath("test_release.apk");
   auto apkParser = ai::ApkParser(pathToApk.string().c_str());
@@ -134,6 +219,979 @@ TEST(ApkParser, AddFileToApk_FileIsAddedSuccessfully) {
   auto fileNames = apkParser.getFiles();
   auto maybeTestFile = std::find(fileNames.begin(), fileNames.end(), "test_file");
   EXPECT_TRUE(maybeTestFile != fileNames.end());
+  EXPECT_EQ(apkParser.getFileContents("test_file"), contents);
+}
+
+TEST(ApkParser, ReplaceFileInApk_FileIsReplacedInPlaceSuccessfully) {
+  auto pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto pathToCopiedApk = fs::temp_directory_path() / "ReplaceFileInApk_FileIsReplacedInPlaceSuccessfully.apk";
+  auto isCopiedSuccessfully = fs::copy_file(pathToOriginalApk, pathToCopiedApk, fs::copy_options::overwrite_existing);
+  EXPECT_TRUE(isCopiedSuccessfully);
+  auto scopedFileDeleter = ScopedFileDeleter(pathToCopiedApk.c_str());
+
+  auto apkParser = ai::ApkParser(pathToCopiedApk.string().c_str());
+  auto const originalFileNames = apkParser.getFiles();
+  auto const originalManifest = apkParser.getFileContents("AndroidManifest.xml");
+  apkParser.setFileContents("AndroidManifest.xml", originalManifest);
+
+  EXPECT_EQ(apkParser.getFiles(), originalFileNames);
+  EXPECT_EQ(apkParser.getFileContents("AndroidManifest.xml"), originalManifest);
+}
+
+TEST(Apk, setFileContentInSession_SessionFollowsChangesToTheFile) {
+  auto pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto pathToCopiedApk = fs::temp_directory_path() / "setFileContentInSession_SessionFollowsChangesToTheFile.apk";
+  auto isCopiedSuccessfully = fs::copy_file(pathToOriginalApk, pathToCopiedApk, fs::copy_options::overwrite_existing);
+  EXPECT_TRUE(isCopiedSuccessfully);
+  auto scopedFileDeleter = ScopedFileDeleter(pathToCopiedApk.c_str());
+
+  auto const apk = ai::Apk(pathToCopiedApk.string());
+  auto const originalProperties = apk.getProperties();
+  EXPECT_EQ(originalProperties.at("valid"), "true");
+
+  auto const contents = std::vector<std::byte>{std::byte(0x1)};
+  apk.setFileContent("test_file", contents);
+  EXPECT_EQ(apk.getFileContent("test_file"), contents);
+
+  auto const otherContents = std::vector<std::byte>{std::byte(0x2), std::byte(0x3)};
+  ai::ApkParser(pathToCopiedApk.string()).setFileContents("other_test_file", otherContents);
+  EXPECT_EQ(apk.getFileContent("other_test_file"), otherContents);
+  EXPECT_EQ(apk.getProperties().at("packageName"), originalProperties.at("packageName"));
+}
+
+TEST(Apk, getSelectedProperties_OnlyRequestedFieldsAreComputed) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const summary = apk.getProperties({ai::ApkPropertyField::Package, ai::ApkPropertyField::Version});
+  auto const expectedSummary =
+      std::map<std::string, std::string>{{"valid", "true"}, {"packageName", "org.fdroid.fdroid"}, {"versionCode", "1006050"}, {"versionName", "1.6"}};
+  EXPECT_EQ(summary, expectedSummary);
+
+  auto const properties = apk.getProperties();
+  EXPECT_EQ(properties.size(), 7U);
+  EXPECT_EQ(properties.at("sha256").size(), 64U);
+  EXPECT_EQ(apk.getProperties({ai::ApkPropertyField::Sha256}).at("sha256"), properties.at("sha256"));
+}
+
+TEST(Apk, readFromManyThreads_EveryThreadReadsWhatOneThreadReads) {
+  auto const pathToApk = getTestApkPath("test_release.apk").string();
+  auto const expectedApk = ai::Apk(pathToApk);
+  auto const expectedProperties = expectedApk.getProperties();
+  auto const expectedFiles = expectedApk.getFiles();
+  auto const expectedManifest = expectedApk.getFileContent("AndroidManifest.xml");
+
+  auto const apk = ai::Apk(pathToApk);
+  auto results = std::vector<std::tuple<std::map<std::string, std::string>, std::vector<std::string>, std::vector<std::byte>>>(8);
+  auto threads = std::vector<std::thread>();
+  for (auto &result : results) {
+    threads.emplace_back([&apk, &result] { result = {apk.getProperties(), apk.getFiles(), apk.getFileContent("AndroidManifest.xml")}; });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto const &[properties, files, manifest] : results) {
+    EXPECT_EQ(properties, expectedProperties);
+    EXPECT_EQ(files, expectedFiles);
+    EXPECT_EQ(manifest, expectedManifest);
+  }
+}
+
+TEST(Apk, openFromMemory_ApkIsReadLikeTheFile) {
+  auto const pathToApk = getTestApkPath("test_release.apk");
+  auto file = std::ifstream(pathToApk, std::ios::binary);
+  auto const fileContents = std::string(std::istreambuf_iterator<char>(file), {});
+  auto const fileBytes = reinterpret_cast<std::byte const *>(fileContents.data());
+
+  auto const fileApk = ai::Apk(pathToApk.string());
+  auto const memoryApk = ai::Apk(std::vector<std::byte>(fileBytes, fileBytes + fileContents.size()));
+  EXPECT_EQ(memoryApk.getFiles(), fileApk.getFiles());
+  EXPECT_EQ(memoryApk.getProperties(), fileApk.getProperties());
+  EXPECT_EQ(memoryApk.getFileContent("AndroidManifest.xml"), fileApk.getFileContent("AndroidManifest.xml"));
+  EXPECT_THROW(memoryApk.setFileContent("test_file", std::vector<std::byte>{std::byte(0x1)}), std::logic_error);
+}
+
+TEST(Apk, openFromDescriptor_ApkIsReadLikeTheFileAfterTheDescriptorIsClosed) {
+  auto const pathToApk = getTestApkPath("test_release.apk");
+  auto const debuggableTestApk = fs::temp_directory_path() / "openFromDescriptor_ApkIsReadLikeTheFile.apk";
+  auto scopedFileDeleter = ScopedFileDeleter(debuggableTestApk.c_str());
+
+  auto const fd = open(pathToApk.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  auto const descriptorApk = ai::Apk(fd);
+  close(fd);
+
+  auto const fileApk = ai::Apk(pathToApk.string());
+  EXPECT_EQ(descriptorApk.getFiles(), fileApk.getFiles());
+  EXPECT_EQ(descriptorApk.getProperties(), fileApk.getProperties());
+  EXPECT_THROW(descriptorApk.setFileContent("test_file", std::vector<std::byte>{std::byte(0x1)}), std::logic_error);
+  EXPECT_NO_THROW(descriptorApk.makeDebuggable(debuggableTestApk.string()));
+  EXPECT_TRUE(ai::Apk(debuggableTestApk.string()).isDebuggable());
+}
+
+TEST(ZipReader, DescriptorZipReader_ReadsLikeTheMappedFile) {
+  auto const pathToApk = getTestApkPath("test_release.apk");
+  auto const fd = open(pathToApk.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  auto const mappedReader = ai::FileZipReader(fd);
+  auto const descriptorReader = ai::DescriptorZipReader(fd);
+  close(fd);
+
+  ASSERT_EQ(descriptorReader.size(), mappedReader.size());
+  auto const tail = std::min<uint64_t>(descriptorReader.size(), 4096);
+  auto buffer = std::vector<std::byte>(8192);
+  EXPECT_EQ(descriptorReader.readAt(descriptorReader.size() - tail, buffer), tail);
+  auto const expected = mappedReader.view()->last(tail);
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), buffer.begin()));
+  EXPECT_EQ(descriptorReader.readAt(descriptorReader.size(), buffer), 0U);
+}
+
+TEST(Apk, openFromRanges_OnlyRequestedEntriesAreFetched) {
+  auto const pathToApk = getTestApkPath("test_release.apk");
+  auto file = std::ifstream(pathToApk, std::ios::binary);
+  auto const fileContents = std::string(std::istreambuf_iterator<char>(file), {});
+
+  auto fetchedBytes = std::atomic_size_t(0);
+  auto const rangeApk = ai::Apk(fileContents.size(), [&](uint64_t const offset, std::span<std::byte> const buffer) {
+    auto const size = std::min<size_t>(buffer.size(), fileContents.size() - offset);
+    fetchedBytes += size;
+    std::memcpy(buffer.data(), fileContents.data() + offset, size);
+    return size;
+  });
+  auto const fileApk = ai::Apk(pathToApk.string());
+  EXPECT_EQ(rangeApk.getProperties({ai::ApkPropertyField::Package, ai::ApkPropertyField::Version}),
+            fileApk.getProperties({ai::ApkPropertyField::Package, ai::ApkPropertyField::Version}));
+  EXPECT_LT(fetchedBytes, fileContents.size() / 4);
+  EXPECT_EQ(rangeApk.getProperties({ai::ApkPropertyField::Sha256}), fileApk.getProperties({ai::ApkPropertyField::Sha256}));
+}
+
+TEST(Apk, openFromRangesOnOpeningThread_EveryFetchIsOnTheOpeningThread) {
+  auto const pathToApk = getTestApkPath("test_release.apk");
+  auto file = std::ifstream(pathToApk, std::ios::binary);
+  auto const fileContents = std::string(std::istreambuf_iterator<char>(file), {});
+
+  auto const openingThread = std::this_thread::get_id();
+  auto otherThreadFetches = std::atomic_size_t(0);
+  auto const rangeApk = ai::Apk(
+      fileContents.size(),
+      [&](uint64_t const offset, std::span<std::byte> const buffer) {
+        otherThreadFetches += std::this_thread::get_id() != openingThread ? 1 : 0;
+        auto const size = std::min<size_t>(buffer.size(), fileContents.size() - offset);
+        std::memcpy(buffer.data(), fileContents.data() + offset, size);
+        return size;
+      },
+      {}, ai::ApkFetcherThreads::Opening);
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const fileApk = ai::Apk(pathToApk.string());
+  auto options = ai::ApkGrepOptions();
+  options.maxMatches = SIZE_MAX;
+  auto const patterns = std::vector<std::string>{"fdroid", "http://"};
+
+  EXPECT_EQ(rangeApk.hashEntries(threadPool).size(), fileApk.hashEntries(threadPool).size());
+  EXPECT_EQ(rangeApk.grep(patterns, options, threadPool).size(), fileApk.grep(patterns, options, threadPool).size());
+  EXPECT_EQ(rangeApk.getProperties({ai::ApkPropertyField::Sha256}), fileApk.getProperties({ai::ApkPropertyField::Sha256}));
+  EXPECT_EQ(otherThreadFetches, 0U);
+}
+
+TEST(Apk, setMemoryBudget_EntriesPastTheBudgetThrowAndHeldBytesAreAccounted) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const manifestSize = apk.getFileContent("AndroidManifest.xml").size();
+  auto const &liveBytes = ai::utils::memory::MemoryBudget::getSubsystemGauge("apk.entries");
+  auto const liveBytesBefore = liveBytes.value();
+
+  apk.setMemoryBudget(manifestSize - 1);
+  EXPECT_THROW(apk.getFileContent("AndroidManifest.xml"), ai::utils::memory::MemoryBudgetExceededException);
+  EXPECT_THROW(apk.getFileBytes("AndroidManifest.xml"), ai::utils::memory::MemoryBudgetExceededException);
+
+  apk.setMemoryBudget(manifestSize);
+  {
+    auto const fileBytes = apk.getFileBytes("AndroidManifest.xml");
+    EXPECT_EQ(fileBytes.bytes().size(), manifestSize);
+    EXPECT_EQ(liveBytes.value(), liveBytesBefore + static_cast<int64_t>(manifestSize));
+    EXPECT_THROW(apk.getFileContent("AndroidManifest.xml"), ai::utils::memory::MemoryBudgetExceededException);
+  }
+  EXPECT_EQ(liveBytes.value(), liveBytesBefore);
+  EXPECT_EQ(apk.getFileContent("AndroidManifest.xml").size(), manifestSize);
+}
+
+TEST(Apk, prefetchLikelyNextFiles_FilesAreServedFromSession) {
+  auto const pathToApk = getTestApkPath("test_release.apk");
+  auto const apk = ai::Apk(pathToApk.string());
+  auto const files = apk.getLikelyNextFiles();
+  EXPECT_EQ(files, (std::vector<std::string>{"res/layout/activity_main.xml", "resources.arsc", "classes.dex"}));
+
+  for (auto const &file : files) {
+    EXPECT_TRUE(apk.prefetch(file)) << file;
+  }
+  EXPECT_FALSE(apk.prefetch("no/such/file"));
+
+  auto const other = ai::Apk(pathToApk.string());
+  for (auto const &file : files) {
+    auto const bytes = apk.getFileBytes(file).bytes();
+    EXPECT_EQ(std::vector<std::byte>(bytes.begin(), bytes.end()), other.getFileContent(file)) << file;
+    EXPECT_EQ(apk.getFileContent(file), other.getFileContent(file)) << file;
+  }
+}
+
+TEST(Apk, readFilePastTheBudgetOfPrefetchedFiles_PrefetchedFilesAreEvicted) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const manifestSize = apk.getFileContent("AndroidManifest.xml").size();
+  auto const layoutSize = apk.getFileContent("res/layout/activity_main.xml").size();
+  auto const &liveBytes = ai::utils::memory::MemoryBudget::getSubsystemGauge("apk.entries");
+  auto const liveBytesBefore = liveBytes.value();
+
+  apk.setMemoryBudget(manifestSize + layoutSize - 1);
+  ASSERT_TRUE(apk.prefetch("res/layout/activity_main.xml"));
+  EXPECT_EQ(liveBytes.value(), liveBytesBefore + static_cast<int64_t>(layoutSize));
+  EXPECT_EQ(apk.getFileContent("AndroidManifest.xml").size(), manifestSize);
+  EXPECT_EQ(liveBytes.value(), liveBytesBefore);
+  EXPECT_EQ(apk.getFileContent("res/layout/activity_main.xml").size(), layoutSize);
+}
+
+TEST(Apk, getResultsProgressively_ChunksAndProgressMatchWholeResults) {
+  auto const pathToApk = getTestApkPath("test_release.apk");
+  auto const apk = ai::Apk(pathToApk.string());
+  auto manifest = std::string();
+  auto chunkCount = size_t{0};
+  apk.getAndroidManifest([&](std::string_view const chunk) {
+    manifest += chunk;
+    chunkCount++;
+  });
+  EXPECT_GT(chunkCount, 0U);
+  EXPECT_EQ(manifest, apk.getAndroidManifest());
+
+  auto const progressApk = ai::Apk(pathToApk.string());
+  auto lastBytesProcessed = uint64_t{0};
+  auto const properties = progressApk.getProperties({ai::ApkPropertyField::Sha256}, [&](uint64_t const bytesProcessed, uint64_t const bytesTotal) {
+    EXPECT_GE(bytesProcessed, lastBytesProcessed);
+    EXPECT_LE(bytesProcessed, bytesTotal);
+    EXPECT_EQ(bytesTotal, fs::file_size(pathToApk));
+    lastBytesProcessed = bytesProcessed;
+  });
+  EXPECT_EQ(properties.at("sha256"), apk.getProperties({ai::ApkPropertyField::Sha256}).at("sha256"));
+}
+
+TEST(Apk, isValidQuickOfCorruptManifest_ApkIsRejectedWithoutParsing) {
+  auto const pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto const pathToCopiedApk = fs::temp_directory_path() / "isValidQuickOfCorruptManifest_ApkIsRejectedWithoutParsing.apk";
+  fs::copy_file(pathToOriginalApk, pathToCopiedApk, fs::copy_options::overwrite_existing);
+  auto scopedFileDeleter = ScopedFileDeleter(pathToCopiedApk.c_str());
+
+  EXPECT_TRUE(ai::Apk(pathToOriginalApk.string()).isValid(ai::ApkValidation::Quick));
+
+  auto const apk = ai::Apk(pathToCopiedApk.string());
+  apk.setFileContent("AndroidManifest.xml", std::vector<std::byte>(64, std::byte(0x7f)));
+  EXPECT_FALSE(apk.isValid(ai::ApkValidation::Quick));
+  EXPECT_FALSE(apk.isValid());
+}
+
+TEST(Apk, hashEntriesOfReleaseApk_EveryFileIsHashedAndCached) {
+  auto const cacheDirectory = fs::temp_directory_path() / "hashEntriesOfReleaseApk_EveryFileIsHashedAndCached";
+  fs::remove_all(cacheDirectory);
+  auto const pathToApk = getTestApkPath("test_release.apk").string();
+  auto const apk = ai::Apk(pathToApk, cacheDirectory.string());
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const digests = apk.hashEntries(threadPool);
+
+  auto files = apk.getFiles();
+  files.erase(std::remove_if(files.begin(), files.end(), [](auto const &file) { return file.ends_with('/'); }), files.end());
+  ASSERT_EQ(digests.size(), files.size());
+  EXPECT_TRUE(std::is_sorted(digests.begin(), digests.end(), [](auto const &left, auto const &right) { return left.path < right.path; }));
+  for (auto const &digest : digests) {
+    auto const expected = ai::utils::sha::computeDigest("SHA-256", apk.getFileContent(digest.path));
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), digest.sha256.begin(), digest.sha256.end())) << digest.path;
+  }
+
+  auto const cachedDigests = ai::Apk(pathToApk, cacheDirectory.string()).hashEntries();
+  ASSERT_EQ(cachedDigests.size(), digests.size());
+  for (size_t i = 0; i < digests.size(); i++) {
+    EXPECT_EQ(cachedDigests[i].path, digests[i].path);
+    EXPECT_EQ(cachedDigests[i].sha256, digests[i].sha256);
+  }
+  fs::remove_all(cacheDirectory);
+}
+
+TEST(Apk, classifyEntriesOfReleaseApk_EntriesAreTypedByContents) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const types = apk.classifyEntries(threadPool);
+
+  auto files = apk.getFiles();
+  files.erase(std::remove_if(files.begin(), files.end(), [](auto const &file) { return file.ends_with('/'); }), files.end());
+  ASSERT_EQ(types.size(), files.size());
+  EXPECT_TRUE(std::is_sorted(types.begin(), types.end(), [](auto const &left, auto const &right) { return left.path < right.path; }));
+  auto const typeOf = [&types](std::string_view const path) {
+    auto const type = std::find_if(types.begin(), types.end(), [path](auto const &entry) { return entry.path == path; });
+    return type != types.end() ? type->type : ai::ContentType::Unknown;
+  };
+  EXPECT_EQ(typeOf("classes.dex"), ai::ContentType::Dex);
+  EXPECT_EQ(typeOf("AndroidManifest.xml"), ai::ContentType::BinaryXml);
+  EXPECT_EQ(typeOf("resources.arsc"), ai::ContentType::ResourceTable);
+  EXPECT_EQ(typeOf("assets/swap-icon.png"), ai::ContentType::Png);
+  EXPECT_EQ(typeOf("assets/index.template.html"), ai::ContentType::Text);
+}
+
+TEST(ApkPaths, dexAndLibraryPaths_NamesAndAbisAreThoseAndroidUses) {
+  EXPECT_EQ(ai::getDexFileName(0), "classes.dex");
+  EXPECT_EQ(ai::getDexFileName(1), "classes2.dex");
+  EXPECT_EQ(ai::getLibraryAbi("lib/arm64-v8a/libnative.so"), "arm64-v8a");
+  EXPECT_FALSE(ai::getLibraryAbi("lib/arm64-v8a/nested/libnative.so"));
+  EXPECT_FALSE(ai::getLibraryAbi("lib//libnative.so"));
+  EXPECT_FALSE(ai::getLibraryAbi("assets/lib/x86/libnative.so"));
+  EXPECT_FALSE(ai::getLibraryAbi("lib/x86/libnative.so.txt"));
+}
+
+TEST(ContentType, classifyContent_ScriptsAndNoiseAreToldApart) {
+  auto const script = std::string_view("!function(e){var t={};function n(r){if(t[r])return t[r].exports}}");
+  EXPECT_EQ(ai::classifyContent(std::as_bytes(std::span(script)), script.size(), script.size()), ai::ContentType::JavaScript);
+
+  auto noise = std::vector<std::byte>(ai::CONTENT_PREFIX_SIZE);
+  auto state = uint32_t{1};
+  for (auto &byte : noise) {
+    state = state * 1664525 + 1013904223;
+    byte = static_cast<std::byte>(state >> 24);
+  }
+  EXPECT_EQ(ai::classifyContent(noise, 4096, 4096), ai::ContentType::Encrypted);
+  EXPECT_EQ(ai::classifyContent(noise, 4096, 1024), ai::ContentType::Unknown);
+  EXPECT_EQ(ai::classifyContent({}, 0, 0), ai::ContentType::Empty);
+}
+
+TEST(SizeReport, buildSizeReport_BytesAreAttributedAndWasteIsFlagged) {
+  auto const entries = std::vector<ai::ApkEntry>{
+      {"AndroidManifest.xml", 1000, 4000, 0, 8, 0},         {"classes.dex", 30000, 90000, 0, 8, 0},    {"classes2.dex", 5000, 12000, 0, 0, 0},
+      {"lib/arm64-v8a/libfoo.so", 20000, 20000, 0, 0, 0}, {"lib/x86/libfoo.so", 22000, 22000, 0, 0, 0}, {"assets/data.json", 8000, 8000, 0, 0, 0},
+      {"assets/clip.MP4", 9900, 10000, 0, 8, 0},           {"assets/small.txt", 100, 100, 0, 0, 0},    {"assets/", 0, 0, 0, 0, 0},
+  };
+  auto const report = ai::buildSizeReport(entries);
+  EXPECT_EQ(report.entryCount, 8U);
+  EXPECT_EQ(report.compressedSize, 96000U);
+  EXPECT_EQ(report.uncompressedSize, 166100U);
+
+  auto const names = [](std::vector<ai::SizeBucket> const &buckets) {
+    auto bucketNames = std::vector<std::string>();
+    std::transform(buckets.begin(), buckets.end(), std::back_inserter(bucketNames), [](auto const &bucket) { return bucket.name; });
+    return bucketNames;
+  };
+  EXPECT_EQ(names(report.directories), (std::vector<std::string>{"lib", "/", "assets"}));
+  EXPECT_EQ(report.directories[0].compressedSize, 42000U);
+  EXPECT_EQ(report.directories[0].entryCount, 2U);
+  EXPECT_EQ(names(report.types), (std::vector<std::string>{"elf", "dex", "media", "text", "binary-xml"}));
+  EXPECT_EQ(names(report.abis), (std::vector<std::string>{"x86", "arm64-v8a"}));
+  EXPECT_EQ(names(report.dexFiles), (std::vector<std::string>{"classes.dex", "classes2.dex"}));
+
+  ASSERT_EQ(report.flags.size(), 2U);
+  EXPECT_EQ(report.flags[0].path, "assets/data.json");
+  EXPECT_EQ(report.flags[0].issue, ai::SizeIssue::StoredCompressible);
+  EXPECT_EQ(report.flags[1].path, "assets/clip.MP4");
+  EXPECT_EQ(report.flags[1].issue, ai::SizeIssue::BadlyCompressed);
+  EXPECT_EQ(report.flags[1].type, ai::ContentType::Media);
+
+  auto const apkReport = ai::buildSizeReport(ai::Apk(getTestApkPath("test_release.apk").string()).getEntries());
+  EXPECT_EQ(apkReport.dexFiles.size(), 1U);
+  EXPECT_EQ(std::accumulate(apkReport.directories.begin(), apkReport.directories.end(), uint64_t{0},
+                            [](uint64_t const size, auto const &bucket) { return size + bucket.compressedSize; }),
+            apkReport.compressedSize);
+}
+
+TEST(Apk, grepOfReleaseApk_EveryOccurrenceIsFound) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const patterns = std::vector<std::string>{"fdroid", "http://"};
+  auto options = ai::ApkGrepOptions();
+  options.maxMatches = SIZE_MAX;
+  auto const matches = apk.grep(patterns, options, threadPool);
+
+  auto expected = std::vector<std::tuple<std::string, uint64_t, uint32_t>>();
+  for (auto const &file : apk.getFiles()) {
+    if (file.ends_with('/')) {
+      continue;
+    }
+    auto const contents = apk.getFileContent(file);
+    auto const text = std::string_view(reinterpret_cast<char const *>(contents.data()), contents.size());
+    for (uint32_t pattern{0}; pattern < patterns.size(); pattern++) {
+      for (auto offset = text.find(patterns[pattern]); offset != text.npos; offset = text.find(patterns[pattern], offset + 1)) {
+        expected.emplace_back(file, offset, pattern);
+      }
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+  ASSERT_FALSE(expected.empty());
+  ASSERT_EQ(matches.size(), expected.size());
+  for (size_t i = 0; i < matches.size(); i++) {
+    EXPECT_EQ(std::tie(matches[i].path, matches[i].offset, matches[i].pattern), expected[i]);
+  }
+
+  options.include = {"META-INF/*.MF"};
+  options.caseSensitive = false;
+  auto const manifestMatches = apk.grep(std::vector<std::string>{"manifest-version"}, options, threadPool);
+  ASSERT_EQ(manifestMatches.size(), 1);
+  EXPECT_EQ(manifestMatches[0].path, "META-INF/MANIFEST.MF");
+  EXPECT_EQ(manifestMatches[0].offset, 0);
+}
+
+TEST(PatternStream, write_MatchesAcrossChunksAreFoundOnce) {
+  auto const patterns = std::vector<std::string>{"abcab", "cab", "b"};
+  auto const matcher = ai::PatternMatcher(patterns, true);
+  auto stream = ai::PatternStream(matcher);
+  auto const text = std::string_view("xabcabcabx");
+  auto matches = std::vector<std::pair<uint64_t, uint32_t>>();
+  for (auto const chunk : {text.substr(0, 2), text.substr(2, 1), text.substr(3, 0), text.substr(3, 4), text.substr(7)}) {
+    stream.write(std::as_bytes(std::span(chunk)), [&matches](uint32_t const pattern, uint64_t const offset) { matches.emplace_back(offset, pattern); });
+  }
+  std::sort(matches.begin(), matches.end());
+  auto const expected = std::vector<std::pair<uint64_t, uint32_t>>{{1, 0}, {2, 2}, {3, 1}, {4, 0}, {5, 2}, {6, 1}, {8, 2}};
+  EXPECT_EQ(matches, expected);
+}
+
+TEST(AnalysisCache, getPropertiesOfCopiedApk_PropertiesAreServedFromCache) {
+  auto const cacheDirectory = fs::temp_directory_path() / "getPropertiesOfCopiedApk_PropertiesAreServedFromCache";
+  fs::remove_all(cacheDirectory);
+  auto const pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto const pathToCopiedApk = fs::temp_directory_path() / "getPropertiesOfCopiedApk_PropertiesAreServedFromCache.apk";
+  auto isCopiedSuccessfully = fs::copy_file(pathToOriginalApk, pathToCopiedApk, fs::copy_options::overwrite_existing);
+  EXPECT_TRUE(isCopiedSuccessfully);
+  auto scopedFileDeleter = ScopedFileDeleter(pathToCopiedApk.c_str());
+
+  auto const properties = ai::Apk(pathToOriginalApk.string(), cacheDirectory.string()).getProperties();
+  EXPECT_EQ(properties, ai::Apk(pathToOriginalApk.string()).getProperties());
+  EXPECT_EQ(std::distance(fs::directory_iterator(cacheDirectory), fs::directory_iterator()), 1);
+
+  auto const copiedApk = ai::Apk(pathToCopiedApk.string(), cacheDirectory.string());
+  EXPECT_EQ(copiedApk.getProperties(), properties);
+  EXPECT_EQ(copiedApk.getEntries().size(), ai::Apk(pathToOriginalApk.string()).getEntries().size());
+
+  copiedApk.setFileContent("test_file", std::vector<std::byte>{std::byte(0x1)});
+  EXPECT_EQ(copiedApk.getProperties({ai::ApkPropertyField::Package}).at("packageName"), properties.at("packageName"));
+  EXPECT_EQ(std::distance(fs::directory_iterator(cacheDirectory), fs::directory_iterator()), 2);
+  fs::remove_all(cacheDirectory);
+}
+
+TEST(Apk, analyzeMany_ResultsOfEveryApkAreReported) {
+  auto const pathToApk = getTestApkPath("test_release.apk").string();
+  auto apkPaths = std::vector<std::string>(8, pathToApk);
+  apkPaths.push_back((fs::temp_directory_path() / "analyzeMany_NonExistingApk.apk").string());
+  auto const expectedProperties = ai::Apk(pathToApk).getProperties({ai::ApkPropertyField::Package, ai::ApkPropertyField::Sha256});
+
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto options = ai::ApkBatchOptions();
+  options.fields = {ai::ApkPropertyField::Package, ai::ApkPropertyField::Sha256};
+  options.maxInFlight = 3;
+  auto results = std::vector<ai::ApkBatchResult>();
+  ai::analyzeMany(apkPaths, options, threadPool, [&results](ai::ApkBatchResult result) { results.push_back(std::move(result)); });
+
+  ASSERT_EQ(results.size(), apkPaths.size());
+  auto const valid = std::count_if(results.begin(), results.end(), [&](auto const &result) {
+    EXPECT_TRUE(result.error.empty()) << result.path;
+    return result.path == pathToApk && result.properties == expectedProperties;
+  });
+  EXPECT_EQ(valid, 8);
+}
+
+TEST(Apk, scanMany_OnlyChangedApksAreAnalyzedAgain) {
+  auto const pathToApk = getTestApkPath("test_release.apk").string();
+  auto const pathToCopiedApk = fs::temp_directory_path() / "scanMany_OnlyChangedApksAreAnalyzedAgain.apk";
+  auto const indexPath = fs::temp_directory_path() / "scanMany_OnlyChangedApksAreAnalyzedAgain.index";
+  fs::copy_file(pathToApk, pathToCopiedApk, fs::copy_options::overwrite_existing);
+  auto scopedFileDeleter = ScopedFileDeleter(pathToCopiedApk.c_str());
+  auto scopedIndexDeleter = ScopedFileDeleter(indexPath.c_str());
+  auto const expectedProperties = ai::Apk(pathToApk).getProperties({ai::ApkPropertyField::Package, ai::ApkPropertyField::Sha256});
+
+  auto threadPool = ai::utils::ThreadPool(2);
+  auto options = ai::ApkBatchOptions();
+  options.fields = {ai::ApkPropertyField::Package, ai::ApkPropertyField::Sha256};
+  auto targets = std::vector<ai::ApkScanTarget>{{pathToApk, 1}, {pathToCopiedApk.string(), 1}};
+  auto const scan = [&] {
+    auto results = std::map<std::string, ai::ApkBatchResult>();
+    auto const analyzed = ai::scanMany(targets, indexPath.string(), options, threadPool, [&results](ai::ApkBatchResult result) {
+      auto path = result.path;
+      results.emplace(std::move(path), std::move(result));
+    });
+    EXPECT_EQ(results.size(), targets.size());
+    for (auto const &[path, result] : results) {
+      EXPECT_EQ(result.properties, expectedProperties) << path;
+    }
+    return analyzed;
+  };
+
+  EXPECT_EQ(scan(), 2U);
+  EXPECT_EQ(scan(), 0U);
+  targets[1].lastUpdateTime = 2;
+  EXPECT_EQ(scan(), 1U);
+  options.fields = ai::ApkPropertyFields::all();
+  EXPECT_EQ(ai::scanMany(targets, indexPath.string(), options, threadPool, [](ai::ApkBatchResult) {}), 2U);
+
+  targets.push_back({(fs::temp_directory_path() / "scanMany_NonExistingApk.apk").string(), 1});
+  auto errors = 0;
+  ai::scanMany(targets, indexPath.string(), options, threadPool, [&errors](ai::ApkBatchResult result) { errors += result.error.empty() ? 0 : 1; });
+  EXPECT_EQ(errors, 1);
+}
+
+TEST(Apk, indexPermissions_RequestingApksAreCountedFromCachedBits) {
+  auto const cacheDirectory = fs::temp_directory_path() / "indexPermissions_RequestingApksAreCountedFromCachedBits";
+  fs::remove_all(cacheDirectory);
+  auto const pathToApk = getTestApkPath("test_release.apk").string();
+  auto apkPaths = std::vector<std::string>(4, pathToApk);
+  apkPaths.push_back((fs::temp_directory_path() / "indexPermissions_NonExistingApk.apk").string());
+
+  auto threadPool = ai::utils::ThreadPool(2);
+  auto options = ai::ApkBatchOptions();
+  options.cacheDirectory = cacheDirectory.string();
+  auto const index = ai::indexPermissions(apkPaths, options, threadPool);
+  auto const cachedIndex = ai::indexPermissions(apkPaths, options, threadPool);
+  fs::remove_all(cacheDirectory);
+
+  for (auto const *permissionIndex : {&index, &cachedIndex}) {
+    ASSERT_EQ(permissionIndex->matrix.rowCount(), apkPaths.size());
+    EXPECT_TRUE(permissionIndex->errors.front().empty());
+    EXPECT_FALSE(permissionIndex->errors.back().empty());
+
+    auto const internet = permissionIndex->dictionary.find("android.permission.INTERNET");
+    ASSERT_TRUE(internet.has_value());
+    EXPECT_FALSE(permissionIndex->dictionary.find("android.permission.READ_SMS").has_value());
+    auto const permissions = std::array{*internet};
+    EXPECT_EQ(permissionIndex->matrix.count(ai::PermissionUse::Requested, permissions), 4U);
+    EXPECT_EQ(permissionIndex->matrix.find(ai::PermissionUse::Requested, permissions), (std::vector<size_t>{0, 1, 2, 3}));
+    EXPECT_EQ(permissionIndex->matrix.count(ai::PermissionUse::Declared, permissions), 0U);
+    EXPECT_FALSE(permissionIndex->matrix.contains(4, ai::PermissionUse::Requested, *internet));
+  }
+  EXPECT_EQ(cachedIndex.dictionary.id(), index.dictionary.id());
+  EXPECT_EQ(cachedIndex.dictionary.size(), index.dictionary.size());
+}
+
+TEST(Sha, computeFileDigestsOfReleaseApk_EveryDigestMatchesOneShotDigest) {
+  auto const path = getTestApkPath("test_release.apk").string();
+  auto const hashNames = std::vector<std::string_view>{"SHA-1", "MD5", "SHA-256"};
+  auto const digests = ai::utils::sha::computeFileDigests(path, hashNames);
+  ASSERT_EQ(digests.size(), hashNames.size());
+
+  auto const file = ai::utils::MappedFile(path);
+  for (size_t i = 0; i < hashNames.size(); i++) {
+    EXPECT_EQ(digests[i], ai::utils::sha::computeDigest(hashNames[i], file.bytes())) << hashNames[i];
+  }
+
+  auto const missingPath = (fs::path(gTestEnvironment->testsDir) / "missing.apk").string();
+  EXPECT_THROW(ai::utils::sha::computeFileDigests(missingPath, hashNames), std::logic_error);
+  EXPECT_TRUE(ai::utils::sha::generateSha256ForFile(missingPath).empty());
+}
+
+TEST(Arena, allocateFreedSizes_BlocksAreReusedUntilReleased) {
+  auto arena = ai::utils::Arena();
+  auto *const first = arena.allocate(24);
+  arena.deallocate(first, 24);
+  EXPECT_EQ(arena.allocate(20), first);
+  EXPECT_EQ(arena.bytesInUse(), 32U);
+
+  {
+    auto attributes = std::pmr::map<std::pmr::string, std::pmr::string>(&arena);
+    attributes[std::pmr::string("android:versionName", &arena)] = "1.0";
+    EXPECT_GT(arena.bytesInUse(), 32U);
+  }
+  EXPECT_EQ(arena.bytesInUse(), 32U);
+
+  auto *const large = arena.allocate(1024 * 1024);
+  EXPECT_NE(large, nullptr);
+  arena.release();
+  EXPECT_EQ(arena.bytesInUse(), 0U);
+}
+
+TEST(RingBuffer, pushAndPopBatchesAcrossThreads_EveryValueArrivesInProducerOrder) {
+  auto constexpr valueCount = size_t{100000};
+  auto spsc = ai::utils::SpscRingBuffer<size_t>(100);
+  EXPECT_EQ(spsc.capacity(), 128U);
+  auto producer = std::thread([&spsc] {
+    auto values = std::array<size_t, 7>{};
+    for (size_t next = 0; next < valueCount;) {
+      auto const count = std::min(values.size(), valueCount - next);
+      std::iota(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(count), next);
+      auto const pushed = spsc.pushBatch(std::span(values).first(count));
+      if (pushed == 0) {
+        std::this_thread::yield();
+      }
+      next += pushed;
+    }
+  });
+  auto values = std::array<size_t, 13>{};
+  for (size_t expected = 0; expected < valueCount;) {
+    auto const count = spsc.popBatch(values);
+    if (count == 0) {
+      std::this_thread::yield();
+    }
+    for (auto const value : std::span(values).first(count)) {
+      ASSERT_EQ(value, expected++);
+    }
+  }
+  producer.join();
+
+  auto constexpr producerCount = size_t{4};
+  auto mpsc = ai::utils::MpscRingBuffer<size_t>(64);
+  auto producers = std::vector<std::thread>();
+  for (size_t producerIndex = 0; producerIndex < producerCount; producerIndex++) {
+    producers.emplace_back([&mpsc, producerIndex] {
+      auto values = std::array<size_t, producerCount>{};
+      for (size_t next = 0; next < valueCount;) {
+        auto const count = std::min(producerIndex + 1, valueCount - next);
+        for (size_t i = 0; i < count; i++) {
+          values[i] = (producerIndex << 32U) | (next + i);
+        }
+        auto const pushed = mpsc.pushBatch(std::span(values).first(count));
+        if (pushed == 0) {
+          std::this_thread::yield();
+        }
+        next += pushed;
+      }
+    });
+  }
+  auto expected = std::vector<size_t>(producerCount);
+  for (size_t popped = 0; popped < producerCount * valueCount;) {
+    auto const count = mpsc.popBatch(values);
+    if (count == 0) {
+      std::this_thread::yield();
+    }
+    for (auto const value : std::span(values).first(count)) {
+      ASSERT_EQ(value & 0xffffffffU, expected[value >> 32U]++);
+    }
+    popped += count;
+  }
+  for (auto &thread : producers) {
+    thread.join();
+  }
+  auto value = size_t{0};
+  EXPECT_FALSE(mpsc.tryPop(value));
+  EXPECT_TRUE(mpsc.tryPush(42));
+  EXPECT_TRUE(mpsc.tryPop(value));
+  EXPECT_EQ(value, 42U);
+}
+
+TEST(RingBuffer, pushAndPopAcrossManyThreads_EveryValueArrivesOnceInProducerOrder) {
+  auto constexpr valueCount = size_t{50000};
+  auto constexpr threadCount = size_t{3};
+  auto mpmc = ai::utils::MpmcRingBuffer<size_t>(50);
+  EXPECT_EQ(mpmc.capacity(), 64U);
+  auto producers = std::vector<std::thread>();
+  for (size_t producerIndex = 0; producerIndex < threadCount; producerIndex++) {
+    producers.emplace_back([&mpmc, producerIndex] {
+      auto values = std::array<size_t, 5>{};
+      for (size_t next = 0; next < valueCount;) {
+        auto const count = std::min(values.size(), valueCount - next);
+        for (size_t i = 0; i < count; i++) {
+          values[i] = (producerIndex << 32U) | (next + i);
+        }
+        auto const pushed = mpmc.pushBatch(std::span(values).first(count));
+        if (pushed == 0) {
+          std::this_thread::yield();
+        }
+        next += pushed;
+      }
+    });
+  }
+  auto popped = std::atomic_size_t{0};
+  auto received = std::vector<std::vector<size_t>>(threadCount, std::vector<size_t>(threadCount));
+  auto consumers = std::vector<std::thread>();
+  for (size_t consumerIndex = 0; consumerIndex < threadCount; consumerIndex++) {
+    consumers.emplace_back([&mpmc, &popped, &counts = received[consumerIndex]] {
+      auto values = std::array<size_t, 7>{};
+      while (popped.load() < threadCount * valueCount) {
+        auto const count = mpmc.popBatch(values);
+        if (count == 0) {
+          std::this_thread::yield();
+        }
+        for (auto const value : std::span(values).first(count)) {
+          auto &last = counts[value >> 32U];
+          ASSERT_GE(value & 0xffffffffU, last);
+          last = (value & 0xffffffffU) + 1;
+        }
+        popped += count;
+      }
+    });
+  }
+  for (auto &thread : producers) {
+    thread.join();
+  }
+  for (auto &thread : consumers) {
+    thread.join();
+  }
+  EXPECT_EQ(popped.load(), threadCount * valueCount);
+  EXPECT_EQ(mpmc.size(), 0U);
+  auto value = size_t{0};
+  EXPECT_FALSE(mpmc.tryPop(value));
+  EXPECT_TRUE(mpmc.tryPush(42));
+  EXPECT_EQ(mpmc.size(), 1U);
+  EXPECT_TRUE(mpmc.tryPop(value));
+  EXPECT_EQ(value, 42U);
+}
+
+TEST(FileOutput, writeManyFiles_EveryBackendWritesAllContents) {
+  auto const testOutputPath = fs::temp_directory_path() / "writeManyFiles_EveryBackendWritesAllContents_dir";
+  for (auto const backend : {ai::utils::FileOutputBackend::IoUring, ai::utils::FileOutputBackend::Posix}) {
+    fs::remove_all(testOutputPath);
+    fs::create_directories(testOutputPath);
+    auto output = ai::utils::FileOutput(backend);
+    auto expectedContents = std::vector<std::string>();
+    for (size_t i = 0; i < 100; i++) {
+      auto const &contents = expectedContents.emplace_back(i * 3001, static_cast<char>('a' + i % 26));
+      output.write((testOutputPath / std::to_string(i)).string(), std::as_bytes(std::span(contents)));
+    }
+    output.flush();
+
+    for (size_t i = 0; i < expectedContents.size(); i++) {
+      auto stream = std::ifstream(testOutputPath / std::to_string(i), std::ios::binary);
+      EXPECT_EQ(std::string(std::istreambuf_iterator<char>(stream), {}), expectedContents[i]) << i;
+    }
+    auto const contents = std::string("contents");
+    EXPECT_THROW(output.write((testOutputPath / "missing" / "file").string(), std::as_bytes(std::span(contents))), std::logic_error);
+  }
+  fs::remove_all(testOutputPath);
+}
+
+TEST(Format, encodeBytes_HexAndBase64MatchScalarEncoding) {
+  auto bytes = std::vector<std::byte>(300);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = static_cast<std::byte>((i * 7) & 0xff);
+  }
+  for (auto const size : {0, 1, 15, 16, 17, 33, 300}) {
+    auto const part = std::span<std::byte const>(bytes).first(static_cast<size_t>(size));
+    auto expected = std::string();
+    for (auto const b : part) {
+      expected += "0123456789abcdef"[std::to_integer<int>(b) >> 4];
+      expected += "0123456789abcdef"[std::to_integer<int>(b) & 0xf];
+    }
+    EXPECT_EQ(ai::utils::format::toHex(part, false), expected) << size;
+    std::transform(expected.begin(), expected.end(), expected.begin(), [](char const c) { return static_cast<char>(std::toupper(c)); });
+    EXPECT_EQ(ai::utils::format::toHex(part), expected) << size;
+    EXPECT_EQ(ai::utils::format::decodeBase64(ai::utils::format::toBase64(part)), std::vector<std::byte>(part.begin(), part.end())) << size;
+  }
+
+  auto const text = std::string_view("foobar");
+  auto const textBytes = std::as_bytes(std::span(text));
+  EXPECT_EQ(ai::utils::format::toBase64(textBytes.first(1)), "Zg==");
+  EXPECT_EQ(ai::utils::format::toBase64(textBytes.first(2)), "Zm8=");
+  EXPECT_EQ(ai::utils::format::toBase64(textBytes), "Zm9vYmFy");
+  EXPECT_THROW(ai::utils::format::decodeBase64("Zm9v*mFy"), std::logic_error);
+
+  auto buffer = std::array<char, 8>();
+  EXPECT_EQ(ai::utils::format::formatTo(buffer, "@res/0x{:08X}", 0x7f010001U), "@res/0x7");
+  EXPECT_EQ(ai::utils::format::format("@res/0x{:08X}", 0x7f010001U), "@res/0x7F010001");
+}
+
+TEST(Glob, matchesGlob_StarsStayWithinSegmentsAndDoubleStarsSpanThem) {
+  EXPECT_TRUE(ai::utils::matchesGlob("res/**/*.xml", "res/a.xml"));
+  EXPECT_TRUE(ai::utils::matchesGlob("res/**/*.xml", "res/layout/v21/a.xml"));
+  EXPECT_FALSE(ai::utils::matchesGlob("res/**/*.xml", "res/layout/a.png"));
+  EXPECT_FALSE(ai::utils::matchesGlob("res/*.xml", "res/layout/a.xml"));
+  EXPECT_TRUE(ai::utils::matchesGlob("classes?.dex", "classes2.dex"));
+  EXPECT_FALSE(ai::utils::matchesGlob("*.dex", "lib/classes.dex"));
+  EXPECT_TRUE(ai::utils::matchesGlob("lib/**", "lib/arm64-v8a/libapp.so"));
+}
+
+TEST(Json, appendString_QuotesBackslashesAndControlCharactersAreEscaped) {
+  auto output = std::string("[");
+  ai::utils::json::appendString("plain", output);
+  output += ',';
+  ai::utils::json::appendString("<a b=\"c\\d\">\n\t\r\x01</a>", output);
+  output += ',';
+  ai::utils::json::appendString("caf\xc3\xa9", output);
+  EXPECT_EQ(output, R"(["plain","<a b=\"c\\d\">\n\t\r\u0001</a>",)" "\"caf\xc3\xa9\"");
+}
+
+TEST(Trace, getPropertiesWhileTracing_SpansAreExportedAsChromeTrace) {
+  ai::utils::trace::clear();
+  ai::utils::trace::setEnabled(true);
+  ai::Apk(getTestApkPath("test_release.apk").string()).getProperties();
+  ai::utils::trace::setEnabled(false);
+
+  auto const trace = ai::utils::trace::exportChromeTrace();
+  EXPECT_TRUE(trace.starts_with(R"({"traceEvents":[{"name":)"));
+  EXPECT_NE(trace.find(R"("name":"Apk::getProperties","ph":"X")"), std::string::npos);
+  EXPECT_NE(trace.find(R"("name":"ZipArchiver::index")"), std::string::npos);
+  EXPECT_NE(trace.find(R"("name":"BinaryXml::toStringXml")"), std::string::npos);
+
+  ai::utils::trace::clear();
+  ai::Apk(getTestApkPath("test_release.apk").string()).getProperties();
+  EXPECT_EQ(ai::utils::trace::exportChromeTrace(), R"({"traceEvents":[]})");
+}
+
+TEST(Trace, summarizeAfterGetProperties_SpansAreTotaledByNameLongestFirst) {
+  ai::utils::trace::clear();
+  ai::utils::trace::setEnabled(true);
+  ai::Apk(getTestApkPath("test_release.apk").string()).getProperties();
+  ai::utils::trace::setEnabled(false);
+
+  auto const summaries = ai::utils::trace::summarize();
+  auto const getProperties = std::find_if(summaries.begin(), summaries.end(), [](auto const &summary) { return summary.name == "Apk::getProperties"; });
+  ASSERT_NE(getProperties, summaries.end());
+  EXPECT_EQ(getProperties->count, 1U);
+  EXPECT_EQ(getProperties->maxMicroseconds, getProperties->totalMicroseconds);
+  EXPECT_TRUE(std::is_sorted(summaries.begin(), summaries.end(),
+                             [](auto const &left, auto const &right) { return left.totalMicroseconds > right.totalMicroseconds; }));
+
+  ai::utils::trace::clear();
+  EXPECT_TRUE(ai::utils::trace::summarize().empty());
+}
+
+TEST(Metrics, getPropertiesTwice_ManifestIsParsedAndArchiveIsScannedOnce) {
+  ai::utils::metrics::reset();
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const properties = apk.getProperties();
+  EXPECT_EQ(apk.getProperties(), properties);
+
+  auto const metrics = ai::utils::metrics::snapshot();
+  EXPECT_EQ(metrics.at("apk.manifest_parses"), "1");
+  EXPECT_EQ(metrics.at("apk.resource_table_parses"), "1");
+  EXPECT_EQ(metrics.at("zip.central_directory_scans"), "1");
+  EXPECT_EQ(metrics.at("zip.entries_scanned"), std::to_string(apk.getFiles().size()));
+  EXPECT_NE(metrics.at("zip.bytes_inflated"), "0");
+
+  auto &histogram = ai::utils::metrics::histogram("test.values");
+  for (auto const value : {0U, 1U, 5U, 6U, 7U, 1000U}) {
+    histogram.record(value);
+  }
+  EXPECT_EQ(histogram.count(), 6U);
+  EXPECT_EQ(histogram.sum(), 1019U);
+  EXPECT_EQ(histogram.bucket(3), 3U);
+  EXPECT_EQ(histogram.quantile(0.5), 7U);
+  EXPECT_EQ(histogram.quantile(1), 1023U);
+}
+
+TEST(ApkSigner, signReleaseApk_SigningBlockIsInsertedBeforeCentralDirectory) {
+  auto const pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto const pathToSignedApk = fs::temp_directory_path() / "signReleaseApk.apk";
+  auto scopedFileDeleter = ScopedFileDeleter(pathToSignedApk.c_str());
+
+  auto const privateKey = ai::utils::MappedFile(getTestKeyPath("test_key.pk8").string());
+  auto const certificate = ai::utils::MappedFile(getTestKeyPath("test_cert.der").string());
+  auto const key = ai::utils::signature::SigningKey(privateKey.bytes(), certificate.bytes());
+  auto threadPool = ai::utils::ThreadPool(4);
+  ai::signApk(pathToOriginalApk.string(), pathToSignedApk.string(), key, ai::ApkSignerOptions(), threadPool);
+
+  auto const signedApk = ai::utils::MappedFile(pathToSignedApk.string());
+  auto const sections = ai::findApkSections(signedApk.bytes());
+  ASSERT_LT(sections.signingBlockOffset, sections.centralDirectoryOffset);
+  auto const block = ai::readApkSigningBlock(signedApk.bytes(), sections);
+  auto ids = std::vector<uint32_t>();
+  std::transform(block.begin(), block.end(), std::back_inserter(ids), [](auto const &entry) { return entry.first; });
+  EXPECT_EQ(ids, (std::vector<uint32_t>{ai::APK_SIGNATURE_SCHEME_V2_BLOCK_ID, ai::APK_SIGNATURE_SCHEME_V3_BLOCK_ID}));
+
+  auto const originalApk = ai::Apk(pathToOriginalApk.string());
+  auto const apk = ai::Apk(pathToSignedApk.string());
+  EXPECT_EQ(apk.getFiles(), originalApk.getFiles());
+  EXPECT_EQ(apk.getFileContent("AndroidManifest.xml"), originalApk.getFileContent("AndroidManifest.xml"));
+
+  auto const verification = ai::verifyApk(pathToSignedApk.string(), ai::ApkVerifierOptions(), threadPool);
+  EXPECT_TRUE(verification.verified);
+  EXPECT_EQ(verification.schemes, (std::vector<uint32_t>{1, 2, 3}));
+  EXPECT_TRUE(std::any_of(verification.signers.begin(), verification.signers.end(),
+                          [&key](auto const &signer) { return signer.scheme == 3 && signer.certificate.publicKey == key.publicKey(); }));
+}
+
+TEST(ApkSigner, signWithEc384Key_Sha512ContentDigestIsSignedAndVerified) {
+  auto const pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto const pathToSignedApk = fs::temp_directory_path() / "signWithEc384Key.apk";
+  auto scopedFileDeleter = ScopedFileDeleter(pathToSignedApk.c_str());
+
+  auto const privateKey = ai::utils::MappedFile(getTestKeyPath("test_ec384_key.pk8").string());
+  auto const certificate = ai::utils::MappedFile(getTestKeyPath("test_ec384_cert.der").string());
+  auto const key = ai::utils::signature::SigningKey(privateKey.bytes(), certificate.bytes());
+  EXPECT_EQ(key.algorithm(), ai::utils::signature::SignatureAlgorithm::EcdsaSha512);
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto options = ai::ApkSignerOptions();
+  options.v3 = false;
+  ai::signApk(pathToOriginalApk.string(), pathToSignedApk.string(), key, options, threadPool);
+
+  auto const verification = ai::verifyApk(pathToSignedApk.string(), ai::ApkVerifierOptions(), threadPool);
+  EXPECT_TRUE(verification.verified);
+  EXPECT_EQ(verification.schemes, (std::vector<uint32_t>{1, 2}));
+
+  // Claims an algorithm the verifier does not know, DSA with SHA-256, for
+  // both the signature and the digest of the v2 signer.
+  auto signedApk = std::vector<std::byte>();
+  {
+    auto const mappedApk = ai::utils::MappedFile(pathToSignedApk.string());
+    signedApk.assign(mappedApk.bytes().begin(), mappedApk.bytes().end());
+  }
+  auto const block = ai::readApkSigningBlock(signedApk, ai::findApkSections(signedApk));
+  ASSERT_EQ(block.size(), 1);
+  auto const v2Offset = static_cast<std::size_t>(block.front().second.data() - signedApk.data());
+  auto const sha512Id = std::as_bytes(std::span(&ai::SIGNATURE_ECDSA_WITH_SHA512, 1));
+  auto const dsaId = uint32_t{0x0301};
+  auto replaced = 0;
+  for (auto offset = v2Offset; offset + sha512Id.size() <= v2Offset + block.front().second.size(); offset++) {
+    if (std::equal(sha512Id.begin(), sha512Id.end(), signedApk.begin() + static_cast<std::ptrdiff_t>(offset))) {
+      memcpy(signedApk.data() + offset, &dsaId, sizeof(dsaId));
+      replaced++;
+    }
+  }
+  ASSERT_EQ(replaced, 2);
+  {
+    auto file = std::ofstream(pathToSignedApk, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const *>(signedApk.data()), static_cast<std::streamsize>(signedApk.size()));
+  }
+
+  auto const unsupported = ai::verifyApk(pathToSignedApk.string(), ai::ApkVerifierOptions(), threadPool);
+  EXPECT_FALSE(unsupported.verified);
+  EXPECT_EQ(unsupported.errors, (std::vector<std::string>{"v2 signer uses unsupported signature algorithms [0x0301]"}));
+}
+
+TEST(ApkVerifier, verifyReleaseApk_JarSignatureAndEntryDigestsAreVerified) {
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const verification = ai::verifyApk(getTestApkPath("test_release.apk").string(), ai::ApkVerifierOptions(), threadPool);
+
+  EXPECT_TRUE(verification.verified);
+  EXPECT_TRUE(verification.errors.empty());
+  EXPECT_EQ(verification.schemes, (std::vector<uint32_t>{1}));
+  ASSERT_EQ(verification.signers.size(), 1);
+  EXPECT_EQ(verification.signers.front().certificate.keyAlgorithm, "RSA");
+  EXPECT_FALSE(verification.signers.front().certificate.sha256Fingerprint.empty());
+}
+
+TEST(GadgetInjector, injectIntoReleaseApk_GadgetAndLoaderAreAdded) {
+  auto const pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto const pathToInjectedApk = fs::temp_directory_path() / "injectIntoReleaseApk.apk";
+  auto scopedFileDeleter = ScopedFileDeleter(pathToInjectedApk.c_str());
+
+  auto const gadget = std::make_shared<std::vector<std::byte> const>(64 * 1024, std::byte(0x7f));
+  auto options = ai::GadgetInjectorOptions();
+  options.gadgets = {{"arm64-v8a", gadget}, {"x86_64", gadget}};
+  options.config = R"({"interaction":{"type":"listen"}})";
+  auto threadPool = ai::utils::ThreadPool(4);
+  ai::injectGadget(pathToOriginalApk.string(), pathToInjectedApk.string(), options, threadPool);
+
+  auto const originalApk = ai::Apk(pathToOriginalApk.string());
+  auto const apk = ai::Apk(pathToInjectedApk.string());
+  EXPECT_EQ(apk.getFileContent("lib/arm64-v8a/libfrida-gadget.so"), *gadget);
+  EXPECT_EQ(apk.getFileContent("lib/x86_64/libfrida-gadget.so"), *gadget);
+  EXPECT_EQ(apk.getFileContent("lib/x86_64/libfrida-gadget.config.so").size(), options.config.size());
+  EXPECT_EQ(apk.getFileContent("classes.dex"), originalApk.getFileContent("classes.dex"));
+
+  auto const loader = apk.getFileContent("classes2.dex");
+  EXPECT_TRUE(ai::findDexClassDefinition(loader, "Lcom/github/jonforshort/introspection/GadgetApplication;").has_value());
+  auto const originalManifest = ai::AndroidManifestParser(originalApk.getFileContent("AndroidManifest.xml"));
+  auto const manifest = ai::AndroidManifestParser(apk.getFileContent("AndroidManifest.xml"));
+  EXPECT_EQ(manifest.getApplicationName(), options.loaderClass);
+  EXPECT_EQ(manifest.getPackageName(), originalManifest.getPackageName());
+  EXPECT_TRUE(apk.isValid());
+
+  auto const injectedEntries = ai::ZipArchiver(pathToInjectedApk.string()).entries();
+  auto const findEntry = [&injectedEntries](std::string_view const path) {
+    return *std::find_if(injectedEntries.begin(), injectedEntries.end(), [path](auto const &entry) { return entry.path == path; });
+  };
+  EXPECT_EQ(findEntry("lib/arm64-v8a/libfrida-gadget.so").compressedSize, findEntry("lib/x86_64/libfrida-gadget.so").compressedSize);
+  EXPECT_THROW(ai::injectGadget(pathToInjectedApk.string(), (fs::temp_directory_path() / "injectTwice.apk").string(), options, threadPool), std::exception);
+}
+
+TEST(DexPatch, patchReleaseDex_ChecksumsMatchThoseOverWholeFile) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto dex = apk.getFileContent("classes.dex");
+  auto checksum = uint32_t{0};
+  std::memcpy(&checksum, dex.data() + 8, sizeof(checksum));
+  EXPECT_EQ(ai::utils::adler32::update(1, std::span(dex).subspan(12)), checksum);
+
+  auto const patchOffset = dex.size() / 2;
+  auto const originalBytes = std::vector<std::byte>(dex.begin() + patchOffset, dex.begin() + patchOffset + 8);
+  std::fill_n(dex.begin() + patchOffset, originalBytes.size(), std::byte(0x5a));
+  ai::updateDexChecksums(dex, patchOffset, originalBytes);
+  auto wholeFileDex = dex;
+  ai::updateDexChecksums(wholeFileDex);
+  EXPECT_EQ(dex, wholeFileDex);
+  EXPECT_NE(dex, apk.getFileContent("classes.dex"));
+  EXPECT_THROW(ai::updateDexChecksums(dex, 16, originalBytes), std::exception);
 }
 
 TEST(ZipArchiver, addPath_PathIsAddedSuccessfully) {
@@ -161,6 +1219,1364 @@ TEST(ZipArchiver, addPath_PathIsAddedSuccessfully) {
   EXPECT_TRUE(fs::exists(testExtractPath / "test"));
 }
 
+TEST(ZipArchiver, extractIndexedEntries_ContentsAreReadSuccessfully) {
+  auto const testZipPath = fs::temp_directory_path() / "extractIndexedEntries_ContentsAreReadSuccessfully.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  auto firstStream = std::istringstream("first");
+  zipArchiver.add(firstStream, "first");
+  auto secondStream = std::istringstream("second");
+  zipArchiver.add(secondStream, "nested/second");
+
+  EXPECT_EQ(zipArchiver.files(), (std::vector<std::string>{"first", "nested/second"}));
+  EXPECT_TRUE(zipArchiver.contains("nested/second"));
+  EXPECT_FALSE(zipArchiver.contains("second"));
+
+  auto const secondContents = zipArchiver.extract("nested/second");
+  EXPECT_EQ(std::string(reinterpret_cast<char const *>(secondContents.data()), secondContents.size()), "second");
+  auto const firstContents = zipArchiver.extract("first");
+  EXPECT_EQ(std::string(reinterpret_cast<char const *>(firstContents.data()), firstContents.size()), "first");
+
+  EXPECT_THROW(zipArchiver.extract("missing"), std::logic_error);
+}
+
+TEST(ZipArchiver, viewStoredEntry_BytesAreMappedSuccessfully) {
+  auto const testZipPath = fs::temp_directory_path() / "viewStoredEntry_BytesAreMappedSuccessfully.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  auto stream = std::istringstream("stored contents");
+  zipArchiver.add(stream, "stored");
+
+  auto const storedView = zipArchiver.view("stored");
+  ASSERT_TRUE(storedView.has_value());
+  EXPECT_EQ(std::string(reinterpret_cast<char const *>(storedView->data()), storedView->size()), "stored contents");
+  EXPECT_THROW(zipArchiver.view("missing"), std::logic_error);
+}
+
+TEST(ZipArchiver, extractAllInParallel_NestedEntriesAreExtractedSuccessfully) {
+  auto const testZipPath = fs::temp_directory_path() / "extractAllInParallel_NestedEntriesAreExtractedSuccessfully.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  auto const paths = std::vector<std::string>{"a", "res/layout/b.xml", "res/layout/c.xml", "lib/x86/d.so", "../outside"};
+  for (auto const &path : paths) {
+    auto stream = std::istringstream(path);
+    zipArchiver.add(stream, path);
+  }
+
+  auto const testExtractPath = fs::temp_directory_path() / "extractAllInParallel_NestedEntriesAreExtractedSuccessfully_dir";
+  fs::remove_all(testExtractPath);
+  auto threadPool = ai::utils::ThreadPool(2);
+  zipArchiver.extractAll(testExtractPath.string(), threadPool);
+
+  for (auto const &path : std::vector<std::string>{"a", "res/layout/b.xml", "res/layout/c.xml", "lib/x86/d.so"}) {
+    auto const extractedFile = testExtractPath / path;
+    EXPECT_TRUE(fs::exists(extractedFile));
+    auto extractedStream = std::ifstream(extractedFile);
+    auto extractedContents = std::string(std::istreambuf_iterator<char>(extractedStream), {});
+    EXPECT_EQ(extractedContents, path);
+  }
+  EXPECT_FALSE(fs::exists(testExtractPath.parent_path() / "outside"));
+  fs::remove_all(testExtractPath);
+}
+
+TEST(ZipArchiver, extractToSink_ChunksMatchContents) {
+  auto const testZipPath = fs::temp_directory_path() / "extractToSink_ChunksMatchContents.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const contents = std::string(200 * 1024, 'x');
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  auto stream = std::istringstream(contents);
+  zipArchiver.add(stream, "large");
+
+  auto chunkCount = size_t(0);
+  auto streamedContents = std::string();
+  zipArchiver.extract("large", [&](auto const chunk) {
+    chunkCount++;
+    streamedContents.append(reinterpret_cast<char const *>(chunk.data()), chunk.size());
+  });
+  EXPECT_GT(chunkCount, 1U);
+  EXPECT_EQ(streamedContents, contents);
+
+  auto outputStream = std::ostringstream();
+  zipArchiver.extract("large", outputStream);
+  EXPECT_EQ(outputStream.str(), contents);
+}
+
+TEST(ZipArchiver, extractPrefix_OnlyFirstBytesAreReturned) {
+  auto const testZipPath = fs::temp_directory_path() / "extractPrefix_OnlyFirstBytesAreReturned.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto contents = std::vector<std::byte>(300 * 1024);
+  for (auto i = size_t{0}; i < contents.size(); i++) {
+    contents[i] = static_cast<std::byte>((i * 31 + i / 997) % 251);
+  }
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  zipArchiver.add(contents, "deflated");
+  zipArchiver.add(contents, "stored", ai::ZipCompression::Store);
+  zipArchiver.add(std::vector<std::byte>(3, std::byte(0x2a)), "short");
+
+  for (auto const *const path : {"deflated", "stored"}) {
+    EXPECT_EQ(zipArchiver.extractPrefix(path, 512), std::vector<std::byte>(contents.begin(), contents.begin() + 512)) << path;
+    EXPECT_EQ(zipArchiver.extractPrefix(path, 0).size(), 0U) << path;
+  }
+  EXPECT_EQ(zipArchiver.extractPrefix("deflated", contents.size() + 1), contents);
+  EXPECT_EQ(zipArchiver.extractPrefix("short", 512), std::vector<std::byte>(3, std::byte(0x2a)));
+  EXPECT_THROW(zipArchiver.extractPrefix("missing", 512), std::logic_error);
+}
+
+TEST(ZipArchiver, commitTransaction_ChangesAreAppliedSuccessfully) {
+  auto const testZipPath = fs::temp_directory_path() / "commitTransaction_ChangesAreAppliedSuccessfully.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const toBytes = [](std::string_view const value) {
+    auto const bytes = reinterpret_cast<std::byte const *>(value.data());
+    return std::vector<std::byte>(bytes, bytes + value.size());
+  };
+  auto const toString = [](std::vector<std::byte> const &bytes) { return std::string(reinterpret_cast<char const *>(bytes.data()), bytes.size()); };
+
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  auto additions = ai::ZipTransaction();
+  additions.add("kept", toBytes("kept")).add("replaced", toBytes("original")).add("removed", toBytes("removed"), ai::ZipCompression::Store);
+  zipArchiver.commit(additions);
+  EXPECT_EQ(zipArchiver.files(), (std::vector<std::string>{"kept", "replaced", "removed"}));
+
+  auto changes = ai::ZipTransaction();
+  changes.replace("replaced", toBytes("replacement")).remove("removed").add("added", toBytes("added"));
+  zipArchiver.commit(changes);
+  EXPECT_EQ(zipArchiver.files(), (std::vector<std::string>{"kept", "replaced", "added"}));
+  EXPECT_EQ(toString(zipArchiver.extract("kept")), "kept");
+  EXPECT_EQ(toString(zipArchiver.extract("replaced")), "replacement");
+  EXPECT_EQ(toString(zipArchiver.extract("added")), "added");
+
+  auto invalidChanges = ai::ZipTransaction();
+  invalidChanges.remove("missing");
+  EXPECT_THROW(zipArchiver.commit(invalidChanges), std::logic_error);
+}
+
+TEST(ZipArchiver, commitTransactionWithDuplicatePaths_SupersededRecordsAreDropped) {
+  auto const testZipPath = fs::temp_directory_path() / "commitTransactionWithDuplicatePaths_SupersededRecordsAreDropped.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const toBytes = [](std::string_view const value) {
+    auto const bytes = reinterpret_cast<std::byte const *>(value.data());
+    return std::vector<std::byte>(bytes, bytes + value.size());
+  };
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  zipArchiver.add(toBytes("stale"), "twice");
+  zipArchiver.add(toBytes("kept"), "kept");
+  zipArchiver.add(toBytes("removed"), "removed");
+  zipArchiver.add(toBytes("current"), "twice");
+  EXPECT_EQ(zipArchiver.files(), (std::vector<std::string>{"twice", "kept", "removed", "twice"}));
+  EXPECT_EQ(zipArchiver.extract("twice"), toBytes("current"));
+
+  auto changes = ai::ZipTransaction();
+  changes.remove("removed");
+  zipArchiver.commit(changes);
+  EXPECT_EQ(zipArchiver.files(), (std::vector<std::string>{"kept", "twice"}));
+  EXPECT_EQ(zipArchiver.extract("twice"), toBytes("current"));
+}
+
+TEST(ZipArchiver, commitTransactionInParallel_EntriesAreCompressedSuccessfully) {
+  auto const testZipPath = fs::temp_directory_path() / "commitTransactionInParallel_EntriesAreCompressedSuccessfully.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto transaction = ai::ZipTransaction();
+  auto expectedFiles = std::vector<std::string>();
+  auto expectedContents = std::vector<std::vector<std::byte>>();
+  for (auto i = 0; i < 16; ++i) {
+    auto contents = std::vector<std::byte>(static_cast<size_t>(1024 * (i + 1)));
+    for (size_t j = 0; j < contents.size(); ++j) {
+      contents[j] = static_cast<std::byte>((i * j) % 13);
+    }
+    expectedFiles.push_back("entry_" + std::to_string(i));
+    expectedContents.push_back(contents);
+    transaction.add(expectedFiles.back(), std::move(contents), i % 2 == 0 ? ai::ZipCompression::Deflate : ai::ZipCompression::Store);
+  }
+  zipArchiver.commit(transaction, threadPool);
+
+  EXPECT_EQ(zipArchiver.files(), expectedFiles);
+  for (size_t i = 0; i < expectedFiles.size(); ++i) {
+    EXPECT_EQ(zipArchiver.extract(expectedFiles[i]), expectedContents[i]);
+  }
+
+  auto replacements = ai::ZipTransaction();
+  replacements.replace("entry_0", expectedContents[1]).remove("entry_1");
+  zipArchiver.commit(replacements, threadPool);
+  EXPECT_EQ(zipArchiver.extract("entry_0"), expectedContents[1]);
+  EXPECT_FALSE(zipArchiver.contains("entry_1"));
+}
+
+TEST(ZipArchiver, commitAlignedTransaction_StoredEntriesAreAlignedSuccessfully) {
+  auto const testZipPath = fs::temp_directory_path() / "commitAlignedTransaction_StoredEntriesAreAlignedSuccessfully.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  auto unaligned = ai::ZipTransaction();
+  unaligned.add("a", std::vector<std::byte>(3, std::byte{0x1}), ai::ZipCompression::Store)
+      .add("lib/arm64-v8a/libfoo.so", std::vector<std::byte>(5, std::byte{0x2}), ai::ZipCompression::Store)
+      .add("resources.arsc", std::vector<std::byte>(7, std::byte{0x3}), ai::ZipCompression::Store)
+      .add("classes.dex", std::vector<std::byte>(11, std::byte{0x4}));
+  zipArchiver.commit(unaligned);
+
+  auto aligned = ai::ZipTransaction();
+  aligned.align(ai::ZipAlignment{});
+  zipArchiver.commit(aligned);
+
+  auto const getAlignment = [&zipArchiver](std::string_view const path, uintptr_t const alignment) {
+    auto const view = zipArchiver.view(path);
+    EXPECT_TRUE(view.has_value());
+    return reinterpret_cast<uintptr_t>(view->data()) % alignment;
+  };
+  EXPECT_EQ(getAlignment("a", 4), 0);
+  EXPECT_EQ(getAlignment("lib/arm64-v8a/libfoo.so", 4096), 0);
+  EXPECT_EQ(getAlignment("resources.arsc", 4), 0);
+  EXPECT_EQ(zipArchiver.extract("lib/arm64-v8a/libfoo.so"), std::vector<std::byte>(5, std::byte{0x2}));
+  EXPECT_EQ(zipArchiver.extract("classes.dex"), std::vector<std::byte>(11, std::byte{0x4}));
+
+  //
+  // Only local headers are padded; the central directory lists every entry
+  // without the alignment extra field (0xd935).
+  //
+  auto zipFile = std::ifstream(testZipPath, std::ios::binary);
+  auto const zipContents = std::string(std::istreambuf_iterator<char>(zipFile), {});
+  auto const zipBytes = std::as_bytes(std::span(zipContents));
+  auto const sections = ai::findApkSections(zipBytes);
+  auto const load16 = [&zipBytes](uint64_t const offset) {
+    return static_cast<uint16_t>(std::to_integer<uint16_t>(zipBytes[offset]) | std::to_integer<uint16_t>(zipBytes[offset + 1]) << 8U);
+  };
+  auto centralEntries = 0;
+  for (auto offset = sections.centralDirectoryOffset; offset < sections.endOfCentralDirectoryOffset; centralEntries++) {
+    auto const extraFieldOffset = offset + 46 + load16(offset + 28);
+    auto const extraFieldEnd = extraFieldOffset + load16(offset + 30);
+    for (auto field = extraFieldOffset; field + 4 <= extraFieldEnd; field += 4 + load16(field + 2)) {
+      EXPECT_NE(load16(field), 0xd935);
+    }
+    offset = extraFieldEnd + load16(offset + 32);
+  }
+  EXPECT_EQ(centralEntries, 4);
+}
+
+TEST(ZipArchiver, listEntries_MetadataIsReadSuccessfully) {
+  auto const testZipPath = fs::temp_directory_path() / "listEntries_MetadataIsReadSuccessfully.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const longPath = std::string(300, 'a') + "/" + std::string(300, 'b');
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  auto transaction = ai::ZipTransaction();
+  transaction.add(longPath, std::vector<std::byte>(4096, std::byte{0x0})).add("stored", std::vector<std::byte>(3, std::byte{0x1}), ai::ZipCompression::Store);
+  zipArchiver.commit(transaction);
+
+  auto const entries = zipArchiver.entries();
+  ASSERT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries[0].path, longPath);
+  EXPECT_EQ(entries[0].compressionMethod, static_cast<uint16_t>(ai::ZipCompression::Deflate));
+  EXPECT_EQ(entries[0].uncompressedSize, 4096);
+  EXPECT_LT(entries[0].compressedSize, entries[0].uncompressedSize);
+  EXPECT_EQ(entries[1].path, "stored");
+  EXPECT_EQ(entries[1].compressionMethod, static_cast<uint16_t>(ai::ZipCompression::Store));
+  EXPECT_EQ(entries[1].compressedSize, 3);
+  EXPECT_EQ(entries[1].crc, 0x909fb2f2);
+  EXPECT_GT(entries[1].localHeaderOffset, entries[0].localHeaderOffset);
+  EXPECT_EQ(zipArchiver.extract(longPath), std::vector<std::byte>(4096, std::byte{0x0}));
+}
+
+TEST(ZipStreamWriter, addEntries_ArchiveIsReadBackSuccessfully) {
+  auto archive = std::vector<std::byte>();
+  auto const sink = [&archive](std::span<std::byte const> const chunk) { archive.insert(archive.end(), chunk.begin(), chunk.end()); };
+  auto text = std::string();
+  for (auto i = 0; i < 1000; i++) {
+    text += "line of compressible text\n";
+  }
+  auto noise = std::vector<std::byte>(4096);
+  std::generate(noise.begin(), noise.end(), [state = uint32_t{1}]() mutable {
+    state = state * 1103515245 + 12345;
+    return static_cast<std::byte>(state >> 24);
+  });
+  {
+    auto writer = ai::ZipStreamWriter(sink);
+    writer.add("text.txt", text);
+    writer.add("noise.bin", noise);
+    writer.add("empty", std::string_view());
+    writer.finish();
+    EXPECT_EQ(writer.entryCount(), 3);
+    EXPECT_EQ(writer.bytesWritten(), archive.size());
+    EXPECT_THROW(writer.add("late", text), std::logic_error);
+  }
+
+  auto const zipArchiver = ai::ZipArchiver(std::make_shared<ai::MemoryZipReader>(archive));
+  auto const entries = zipArchiver.entries();
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_EQ(entries[0].path, "text.txt");
+  EXPECT_LT(entries[0].compressedSize, text.size());
+  EXPECT_EQ(entries[1].compressedSize, noise.size());
+  auto const extractedText = zipArchiver.extract("text.txt");
+  EXPECT_EQ(std::string(reinterpret_cast<char const *>(extractedText.data()), extractedText.size()), text);
+  EXPECT_EQ(zipArchiver.extract("noise.bin"), noise);
+  EXPECT_TRUE(zipArchiver.extract("empty").empty());
+  auto const verifications = zipArchiver.verify();
+  EXPECT_TRUE(std::all_of(verifications.begin(), verifications.end(), [](auto const &verification) { return verification.passed; }));
+}
+
+TEST(Apk, dumpToStream_ManifestAndResourcesAreArchived) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto archive = std::vector<std::byte>();
+  auto writer = ai::ZipStreamWriter([&archive](std::span<std::byte const> const chunk) { archive.insert(archive.end(), chunk.begin(), chunk.end()); });
+  apk.dump(writer);
+  writer.finish();
+
+  auto const zipArchiver = ai::ZipArchiver(std::make_shared<ai::MemoryZipReader>(archive));
+  auto const manifest = zipArchiver.extract("AndroidManifest.xml");
+  EXPECT_EQ(std::string(reinterpret_cast<char const *>(manifest.data()), manifest.size()), apk.getAndroidManifest());
+  auto const files = zipArchiver.files();
+  EXPECT_GT(files.size(), 1);
+  EXPECT_TRUE(std::all_of(files.begin() + 1, files.end(), [](auto const &file) { return file.starts_with("res/") && file.ends_with(".xml"); }));
+}
+
+TEST(ZipArchiver, verifyEntries_CorruptedEntryFailsVerification) {
+  auto const testZipPath = fs::temp_directory_path() / "verifyEntries_CorruptedEntryFailsVerification.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const contents = std::string("contents of a stored entry");
+  auto const bytes = reinterpret_cast<std::byte const *>(contents.data());
+  {
+    auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+    auto transaction = ai::ZipTransaction();
+    transaction.add("stored", std::vector<std::byte>(bytes, bytes + contents.size()), ai::ZipCompression::Store)
+        .add("deflated", std::vector<std::byte>(100000, std::byte{0x5}));
+    zipArchiver.commit(transaction);
+
+    auto threadPool = ai::utils::ThreadPool(2);
+    auto const verifications = zipArchiver.verify(threadPool);
+    ASSERT_EQ(verifications.size(), 2);
+    EXPECT_TRUE(verifications[0].passed);
+    EXPECT_TRUE(verifications[1].passed);
+    EXPECT_EQ(verifications[0].actualCrc, verifications[0].expectedCrc);
+  }
+
+  auto archive = std::fstream(testZipPath, std::ios::in | std::ios::out | std::ios::binary);
+  auto const archiveContents = std::string(std::istreambuf_iterator<char>(archive), {});
+  auto const contentsOffset = archiveContents.find(contents);
+  ASSERT_NE(contentsOffset, std::string::npos);
+  archive.seekp(static_cast<std::streamoff>(contentsOffset));
+  archive.put('C');
+  archive.close();
+
+  auto const verifications = ai::ZipArchiver(testZipPath.string()).verify();
+  ASSERT_EQ(verifications.size(), 2);
+  EXPECT_FALSE(verifications[0].passed);
+  EXPECT_EQ(verifications[0].path, "stored");
+  EXPECT_TRUE(verifications[1].passed);
+}
+
+TEST(ZipArchiver, openFromReaders_EntriesAreReadSuccessfully) {
+  auto const testZipPath = fs::temp_directory_path() / "openFromReaders_EntriesAreReadSuccessfully.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const stored = std::vector<std::byte>(1024 * 1024, std::byte{0x1});
+  auto const deflated = std::vector<std::byte>(200000, std::byte{0x2});
+  {
+    auto transaction = ai::ZipTransaction();
+    transaction.add("stored", stored, ai::ZipCompression::Store).add("deflated", deflated);
+    ai::ZipArchiver(testZipPath.string()).commit(transaction);
+  }
+  auto archive = std::ifstream(testZipPath, std::ios::binary);
+  auto const archiveContents = std::string(std::istreambuf_iterator<char>(archive), {});
+  auto const archiveBytes = reinterpret_cast<std::byte const *>(archiveContents.data());
+
+  auto const memoryReader = std::make_shared<ai::MemoryZipReader>(std::vector<std::byte>(archiveBytes, archiveBytes + archiveContents.size()));
+  auto const memoryArchiver = ai::ZipArchiver(memoryReader);
+  EXPECT_EQ(memoryArchiver.files(), (std::vector<std::string>{"stored", "deflated"}));
+  EXPECT_EQ(memoryArchiver.extract("stored"), stored);
+  EXPECT_EQ(memoryArchiver.extract("deflated"), deflated);
+  EXPECT_TRUE(memoryArchiver.view("stored").has_value());
+  EXPECT_THROW(memoryArchiver.add(stored, "added"), std::logic_error);
+
+  auto fetchedBytes = std::atomic_size_t(0);
+  auto const rangeReader = std::make_shared<ai::RangeZipReader>(archiveContents.size(), [&](uint64_t const offset, std::span<std::byte> const buffer) {
+    fetchedBytes += buffer.size();
+    std::memcpy(buffer.data(), archiveBytes + offset, buffer.size());
+    return buffer.size();
+  });
+  auto const rangeArchiver = ai::ZipArchiver(rangeReader);
+  EXPECT_EQ(rangeArchiver.files(), (std::vector<std::string>{"stored", "deflated"}));
+  EXPECT_LT(fetchedBytes, archiveContents.size());
+  EXPECT_EQ(rangeArchiver.extract("stored"), stored);
+  EXPECT_EQ(rangeArchiver.extract("deflated"), deflated);
+  EXPECT_FALSE(rangeArchiver.view("stored").has_value());
+  auto const verifications = rangeArchiver.verify();
+  EXPECT_TRUE(std::all_of(verifications.cbegin(), verifications.cend(), [](auto const &verification) { return verification.passed; }));
+}
+
+TEST(ZipArchiver, openWithoutCentralDirectory_EntriesAreRecoveredFromLocalHeaders) {
+  auto const testZipPath = fs::temp_directory_path() / "openWithoutCentralDirectory_EntriesAreRecoveredFromLocalHeaders.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const stored = std::vector<std::byte>(64 * 1024, std::byte{'P'});
+  auto const deflated = std::vector<std::byte>(200000, std::byte{'K'});
+  {
+    auto transaction = ai::ZipTransaction();
+    transaction.add("stored", stored, ai::ZipCompression::Store).add("deflated", deflated);
+    ai::ZipArchiver(testZipPath.string()).commit(transaction);
+  }
+  auto archive = std::ifstream(testZipPath, std::ios::binary);
+  auto archiveContents = std::string(std::istreambuf_iterator<char>(archive), {});
+  EXPECT_FALSE(ai::ZipArchiver(testZipPath.string()).isRecovered());
+  archiveContents.resize(archiveContents.find("PK\x01\x02"));
+  auto const archiveBytes = reinterpret_cast<std::byte const *>(archiveContents.data());
+
+  auto const memoryReader = std::make_shared<ai::MemoryZipReader>(std::vector<std::byte>(archiveBytes, archiveBytes + archiveContents.size()));
+  auto const memoryArchiver = ai::ZipArchiver(memoryReader);
+  EXPECT_TRUE(memoryArchiver.isRecovered());
+  EXPECT_EQ(memoryArchiver.files(), (std::vector<std::string>{"stored", "deflated"}));
+  EXPECT_EQ(memoryArchiver.extract("stored"), stored);
+  EXPECT_EQ(memoryArchiver.extract("deflated"), deflated);
+
+  auto const rangeReader = std::make_shared<ai::RangeZipReader>(archiveContents.size(), [&](uint64_t const offset, std::span<std::byte> const buffer) {
+    auto const size = std::min<size_t>(buffer.size(), archiveContents.size() - offset);
+    std::memcpy(buffer.data(), archiveBytes + offset, size);
+    return size;
+  });
+  auto const rangeArchiver = ai::ZipArchiver(rangeReader);
+  auto chunks = std::vector<std::byte>();
+  rangeArchiver.extract("deflated", [&chunks](auto const chunk) { chunks.insert(chunks.end(), chunk.begin(), chunk.end()); });
+  EXPECT_EQ(chunks, deflated);
+  auto const verifications = rangeArchiver.verify();
+  EXPECT_EQ(verifications.size(), 2U);
+  EXPECT_TRUE(std::all_of(verifications.cbegin(), verifications.cend(), [](auto const &verification) { return verification.passed; }));
+}
+
+TEST(ZipArchiver, openWithFakeCentralDirectory_EntriesAreRecoveredFromLocalHeaders) {
+  auto const testZipPath = fs::temp_directory_path() / "openWithFakeCentralDirectory_EntriesAreRecoveredFromLocalHeaders.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const stored = std::vector<std::byte>(64 * 1024, std::byte{0x1});
+  auto const deflated = std::vector<std::byte>(200000, std::byte{0x2});
+  {
+    auto transaction = ai::ZipTransaction();
+    transaction.add("stored", stored, ai::ZipCompression::Store).add("deflated", deflated);
+    ai::ZipArchiver(testZipPath.string()).commit(transaction);
+  }
+  auto archive = std::ifstream(testZipPath, std::ios::binary);
+  auto archiveContents = std::string(std::istreambuf_iterator<char>(archive), {});
+  //
+  // The central directory lists the entries at offsets without a local
+  // header, as the fake ones of packers do.
+  //
+  for (auto record = archiveContents.find("PK\x01\x02"); record != std::string::npos; record = archiveContents.find("PK\x01\x02", record + 1)) {
+    archiveContents[record + 42] = '\x01';
+  }
+  auto const archiveBytes = reinterpret_cast<std::byte const *>(archiveContents.data());
+
+  auto const memoryReader = std::make_shared<ai::MemoryZipReader>(std::vector<std::byte>(archiveBytes, archiveBytes + archiveContents.size()));
+  auto const memoryArchiver = ai::ZipArchiver(memoryReader);
+  auto threadPool = ai::utils::ThreadPool(2);
+  auto const verifications = memoryArchiver.verify(threadPool);
+  EXPECT_EQ(verifications.size(), 2U);
+  EXPECT_TRUE(std::all_of(verifications.cbegin(), verifications.cend(), [](auto const &verification) { return verification.passed; }));
+  EXPECT_TRUE(memoryArchiver.isRecovered());
+  EXPECT_EQ(memoryArchiver.files(), (std::vector<std::string>{"stored", "deflated"}));
+  EXPECT_EQ(memoryArchiver.extract("stored"), stored);
+  EXPECT_EQ(memoryArchiver.extract("deflated"), deflated);
+}
+
+TEST(ZipArchiver, extractIntoRecycledBuffer_ContentsAreReadSuccessfully) {
+  auto const testZipPath = fs::temp_directory_path() / "extractIntoRecycledBuffer_ContentsAreReadSuccessfully.zip";
+  fs::remove(testZipPath);
+  auto scopedFileDeleter = ScopedFileDeleter(testZipPath.c_str());
+
+  auto const zipArchiver = ai::ZipArchiver(testZipPath.string());
+  auto transaction = ai::ZipTransaction();
+  transaction.add("large", std::vector<std::byte>(100000, std::byte{0x1}))
+      .add("empty", std::vector<std::byte>())
+      .add("small", std::vector<std::byte>(10, std::byte{0x2}))
+      .add("stored", std::vector<std::byte>(20, std::byte{0x3}), ai::ZipCompression::Store);
+  zipArchiver.commit(transaction);
+
+  auto contents = std::vector<std::byte>();
+  zipArchiver.extract("large", contents);
+  EXPECT_EQ(contents, std::vector<std::byte>(100000, std::byte{0x1}));
+  zipArchiver.extract("empty", contents);
+  EXPECT_TRUE(contents.empty());
+  zipArchiver.extract("small", contents);
+  EXPECT_EQ(contents, std::vector<std::byte>(10, std::byte{0x2}));
+  zipArchiver.extract("stored", contents);
+  EXPECT_EQ(contents, std::vector<std::byte>(20, std::byte{0x3}));
+}
+
+TEST(ZipArchiver, extractEntryClaimingImpossibleSize_ThrowsWithoutAllocatingIt) {
+  auto archiveFile = std::ifstream(getTestApkPath("test_release.apk"), std::ios::binary);
+  auto archive = std::vector<char>(std::istreambuf_iterator<char>(archiveFile), {});
+  static constexpr auto centralDirectoryHeaderSize = 46;
+  static constexpr auto uncompressedSizeOffset = 24;
+  auto const name = std::string_view("classes.dex");
+  auto header = archive.end();
+  for (auto found = std::search(archive.begin(), archive.end(), name.begin(), name.end()); found != archive.end();
+       found = std::search(found + 1, archive.end(), name.begin(), name.end())) {
+    if (found - archive.begin() >= centralDirectoryHeaderSize && std::string_view(&*(found - centralDirectoryHeaderSize), 4) == "PK\x01\x02") {
+      header = found - centralDirectoryHeaderSize;
+    }
+  }
+  ASSERT_NE(header, archive.end());
+  auto const claimedSize = uint32_t{0xF0000000};
+  std::memcpy(&*(header + uncompressedSizeOffset), &claimedSize, sizeof(claimedSize));
+
+  auto const bytes = std::as_bytes(std::span(archive));
+  auto const corruptArchiver = ai::ZipArchiver(std::make_shared<ai::MemoryZipReader>(std::vector<std::byte>(bytes.begin(), bytes.end())));
+  EXPECT_EQ(corruptArchiver.entry("classes.dex")->uncompressedSize, claimedSize);
+  EXPECT_EQ(corruptArchiver.entry("classes.dex")->compressionMethod, static_cast<uint16_t>(ai::ZipCompression::Deflate));
+  EXPECT_THROW(corruptArchiver.extract("classes.dex"), std::logic_error);
+  EXPECT_THROW(ai::getInflatedSize(*corruptArchiver.entry("classes.dex")), std::logic_error);
+
+  auto const corruptApkPath = fs::temp_directory_path() / "extractEntryClaimingImpossibleSize_ThrowsWithoutAllocatingIt.apk";
+  auto scopedFileDeleter = ScopedFileDeleter(corruptApkPath.c_str());
+  std::ofstream(corruptApkPath, std::ios::binary).write(archive.data(), static_cast<std::streamsize>(archive.size()));
+  EXPECT_THROW(ai::Apk(corruptApkPath.string()).getFileBytes("classes.dex"), std::logic_error);
+}
+
+TEST(ApkBundle, openSplitsAndContainer_FilesAreMergedSuccessfully) {
+  auto const testDirectory = fs::temp_directory_path() / "openSplitsAndContainer_FilesAreMergedSuccessfully";
+  fs::remove_all(testDirectory);
+  fs::create_directories(testDirectory);
+
+  auto const toBytes = [](std::string_view const value) {
+    auto const bytes = reinterpret_cast<std::byte const *>(value.data());
+    return std::vector<std::byte>(bytes, bytes + value.size());
+  };
+  auto const readFile = [&toBytes](fs::path const &path) {
+    auto file = std::ifstream(path, std::ios::binary);
+    return toBytes(std::string(std::istreambuf_iterator<char>(file), {}));
+  };
+  auto const writeApk = [&toBytes](fs::path const &path, std::vector<std::pair<std::string, std::string>> const &files) {
+    auto transaction = ai::ZipTransaction();
+    for (auto const &[file, contents] : files) {
+      transaction.add(file, toBytes(contents));
+    }
+    ai::ZipArchiver(path.string()).commit(transaction);
+  };
+  auto const basePath = testDirectory / "base.apk";
+  auto const splitPath = testDirectory / "split_config.arm64_v8a.apk";
+  writeApk(basePath, {{"classes.dex", "dex"}, {"resources.arsc", "base resources"}});
+  writeApk(splitPath, {{"lib/arm64-v8a/libfoo.so", "elf"}, {"resources.arsc", "split resources"}});
+
+  auto const bundle = ai::ApkBundle(std::vector<std::string>{basePath.string(), splitPath.string()});
+  EXPECT_EQ(bundle.getSplits(), (std::vector<std::string>{"base", "split_config.arm64_v8a"}));
+  EXPECT_EQ(bundle.getFiles(), (std::vector<std::string>{"classes.dex", "resources.arsc", "lib/arm64-v8a/libfoo.so"}));
+  EXPECT_EQ(bundle.getSplitOf("lib/arm64-v8a/libfoo.so"), "split_config.arm64_v8a");
+  EXPECT_EQ(bundle.getFileContent("resources.arsc"), toBytes("base resources"));
+  EXPECT_EQ(bundle.getFileContent("split_config.arm64_v8a", "resources.arsc"), toBytes("split resources"));
+  EXPECT_THROW(bundle.getFileContent("missing"), std::logic_error);
+
+  auto const containerPath = testDirectory / "app.apks";
+  auto container = ai::ZipTransaction();
+  container.add("splits/config.arm64_v8a.apk", readFile(splitPath)).add("splits/base-master.apk", readFile(basePath), ai::ZipCompression::Store);
+  ai::ZipArchiver(containerPath.string()).commit(container);
+
+  auto const containerBundle = ai::ApkBundle(containerPath.string());
+  EXPECT_EQ(containerBundle.getSplits(), (std::vector<std::string>{"base-master", "config.arm64_v8a"}));
+  EXPECT_EQ(containerBundle.getFileContent("resources.arsc"), toBytes("base resources"));
+  EXPECT_EQ(containerBundle.getFileContent("lib/arm64-v8a/libfoo.so"), toBytes("elf"));
+
+  fs::remove_all(testDirectory);
+}
+
+TEST(AppBundle, openBundle_ProtoManifestAndResourcesAreDecoded) {
+  auto const testDirectory = fs::temp_directory_path() / "openBundle_ProtoManifestAndResourcesAreDecoded";
+  fs::remove_all(testDirectory);
+  fs::create_directories(testDirectory);
+
+  //
+  // Protobuf messages as aapt2 writes them, field by field.
+  //
+  auto const varint = [](uint64_t value) {
+    auto encoded = std::string();
+    for (; value >= 0x80; value >>= 7U) {
+      encoded += static_cast<char>((value & 0x7fU) | 0x80U);
+    }
+    return encoded + static_cast<char>(value);
+  };
+  auto const number = [&varint](uint32_t const field, uint64_t const value) { return varint(field << 3U) + varint(value); };
+  auto const message = [&varint](uint32_t const field, std::string const &value) { return varint((field << 3U) | 2U) + varint(value.size()) + value; };
+  auto const attribute = [&](std::string const &name, uint32_t const resourceId, std::string const &value) {
+    return message(4, message(2, name) + message(3, value) + (resourceId != 0 ? number(5, resourceId) : std::string()));
+  };
+  auto const compiledAttribute = [&](std::string const &name, uint32_t const resourceId, std::string const &item) {
+    return message(4, message(2, name) + number(5, resourceId) + message(6, item));
+  };
+  auto const element = [&](std::string const &name, std::string const &attributes, std::string const &children = std::string()) {
+    return message(1, message(3, name) + attributes + children);
+  };
+  auto const child = [&message](std::string const &node) { return message(5, node); };
+
+  auto const filter = element("intent-filter", std::string(), child(element("action", attribute("name", 0x01010003, "android.intent.action.MAIN"))));
+  auto const application =
+      element("application",
+              compiledAttribute("label", 0x01010001, message(1, number(2, 0x7f010000))) + compiledAttribute("debuggable", 0x0101000f, message(7, number(8, 1))),
+              child(element("activity", attribute("name", 0x01010003, ".MainActivity"), child(filter))) +
+                  child(element("provider", attribute("name", 0x01010003, "com.example.Provider"))));
+  auto const manifest = element("manifest", attribute("package", 0, "com.example") + attribute("versionCode", 0x0101021b, "7"),
+                                child(element("uses-permission", attribute("name", 0x01010003, "android.permission.INTERNET"))) + child(application) +
+                                    child(element("uses-sdk", attribute("targetSdkVersion", 0x01010270, "30"))));
+  auto const entry = message(3, message(1, number(1, 0)) + message(2, "app_name") + message(6, message(2, message(4, message(2, message(1, "Demo"))))));
+  auto const resources = message(2, message(1, number(1, 0x7f)) + message(3, message(1, number(1, 1)) + message(2, "string") + entry));
+
+  auto const toBytes = [](std::string_view const value) {
+    auto const bytes = reinterpret_cast<std::byte const *>(value.data());
+    return std::vector<std::byte>(bytes, bytes + value.size());
+  };
+  auto const bundlePath = testDirectory / "app.aab";
+  auto transaction = ai::ZipTransaction();
+  transaction.add("BundleConfig.pb", toBytes(""))
+      .add("feature/manifest/AndroidManifest.xml", toBytes(element("manifest", attribute("package", 0, "com.example"))))
+      .add("base/manifest/AndroidManifest.xml", toBytes(manifest), ai::ZipCompression::Store)
+      .add("base/resources.pb", toBytes(resources));
+  ai::ZipArchiver(bundlePath.string()).commit(transaction);
+
+  auto const bundle = ai::AppBundle(bundlePath.string());
+  EXPECT_EQ(bundle.getModules(), (std::vector<std::string>{"base", "feature"}));
+  EXPECT_EQ(bundle.getFileContent("base/resources.pb"), toBytes(resources));
+  EXPECT_EQ(bundle.getResourceValues(), (std::map<std::string, std::string>{{"string/app_name", "Demo"}}));
+  EXPECT_TRUE(bundle.getResourceValues("feature").empty());
+  EXPECT_THROW(bundle.getAndroidManifest("missing"), std::logic_error);
+
+  auto const properties = bundle.getProperties({ai::ApkPropertyField::Package, ai::ApkPropertyField::Version, ai::ApkPropertyField::Debuggable});
+  EXPECT_EQ(properties, (std::map<std::string, std::string>{
+                            {"valid", "true"}, {"packageName", "com.example"}, {"versionCode", "7"}, {"versionName", ""}, {"debuggable", "true"}}));
+  EXPECT_EQ(bundle.getAndroidManifest(), "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                                         "<manifest package=\"com.example\" versionCode=\"7\">\n"
+                                         "  <uses-permission name=\"android.permission.INTERNET\"/>\n"
+                                         "  <application debuggable=\"true\" label=\"@string/app_name\">\n"
+                                         "    <activity name=\".MainActivity\">\n"
+                                         "      <intent-filter>\n"
+                                         "        <action name=\"android.intent.action.MAIN\"/>\n"
+                                         "      </intent-filter>\n"
+                                         "    </activity>\n"
+                                         "    <provider name=\"com.example.Provider\"/>\n"
+                                         "  </application>\n"
+                                         "  <uses-sdk targetSdkVersion=\"30\"/>\n"
+                                         "</manifest>\n");
+
+  auto const components = bundle.getManifestComponents();
+  EXPECT_EQ(components.getTargetSdkVersion(), 30U);
+  EXPECT_TRUE(components.isPermissionRequested("android.permission.INTERNET"));
+  ASSERT_EQ(components.components().size(), 2U);
+  EXPECT_EQ(components.getString(components.components()[0].name), "com.example.MainActivity");
+  EXPECT_TRUE(components.components()[0].exported);
+  EXPECT_FALSE(components.components()[1].exported);
+  EXPECT_EQ(components.findComponentsWithAction("android.intent.action.MAIN"), (std::vector<uint32_t>{0}));
+
+  auto bundleFile = std::ifstream(bundlePath, std::ios::binary);
+  auto const bundleContents = std::string(std::istreambuf_iterator<char>(bundleFile), std::istreambuf_iterator<char>());
+  auto const bufferBundle = ai::AppBundle(toBytes(bundleContents));
+  EXPECT_EQ(bufferBundle.getModules(), bundle.getModules());
+  EXPECT_EQ(bufferBundle.getAndroidManifest(), bundle.getAndroidManifest());
+  EXPECT_EQ(bufferBundle.getProperties(), bundle.getProperties());
+
+  EXPECT_TRUE(ai::AppBundle::isAppBundlePath(bundlePath.string()));
+  EXPECT_FALSE(ai::AppBundle::isAppBundlePath("app.apk"));
+
+  fs::remove_all(testDirectory);
+}
+
+TEST(AndroidManifestParser, getPropertiesOfMangledManifest_AttributesAreMatchedByResourceId) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto manifest = zipArchiver.extract("AndroidManifest.xml");
+  auto const mangle = [&manifest](std::u16string_view const name) {
+    auto const bytes = std::as_bytes(std::span(name));
+    auto const found = std::search(manifest.begin(), manifest.end(), bytes.begin(), bytes.end());
+    ASSERT_NE(found, manifest.end());
+    std::fill(found, found + static_cast<std::ptrdiff_t>(bytes.size()), std::byte{'q'});
+  };
+  mangle(u"versionCode");
+  mangle(u"versionName");
+
+  auto const manifestParser = ai::AndroidManifestParser(manifest);
+  auto const properties = manifestParser.getManifestProperties();
+  EXPECT_EQ(properties.packageName, "org.fdroid.fdroid");
+  EXPECT_EQ(properties.versionCode, "1006050");
+  EXPECT_EQ(properties.versionName, "1.6");
+  EXPECT_FALSE(properties.debuggable);
+  EXPECT_EQ(properties.versionCode, manifestParser.getVersionCode());
+  EXPECT_EQ(properties.versionName, manifestParser.getVersionName());
+
+  auto const binaryXml = ai::BinaryXml(manifest);
+  auto const elements = binaryXml.findElements(std::array{ai::BinaryXml::ElementPath{"manifest", "application"}, ai::BinaryXml::ElementPath{"missing"}});
+  ASSERT_EQ(elements.size(), 2U);
+  EXPECT_TRUE(elements[0].has_value());
+  EXPECT_FALSE(elements[1].has_value());
+}
+
+TEST(BinaryXml, setElementAttribute_KeptRenderingMatchesFreshRendering) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto binaryXml = ai::BinaryXml(zipArchiver.extract("AndroidManifest.xml"));
+  auto const original = binaryXml.toStringXml();
+
+  binaryXml.setElementAttribute({"manifest"}, "versionName", "1.6-patched");
+  binaryXml.setElementAttribute({"manifest", "application"}, "debuggable", "true", 0x0101000f);
+  binaryXml.setElementAttribute({"manifest", "application"}, "customThing", "hello");
+  auto const edited = binaryXml.toStringXml();
+  EXPECT_NE(edited, original);
+  EXPECT_NE(edited.find("versionName=\"1.6-patched\""), std::string::npos);
+  EXPECT_NE(edited.find("customThing=\"hello\""), std::string::npos);
+  EXPECT_EQ(edited, ai::BinaryXml(binaryXml.toBinaryXml()).toStringXml());
+
+  auto chunks = std::string();
+  binaryXml.toStringXml([&chunks](std::string_view const chunk) { chunks += chunk; });
+  EXPECT_EQ(chunks, edited);
+}
+
+TEST(BinaryXml, setElementAttribute_MissingAttributeIsInsertedThenRewrittenInPlace) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto binaryXml = ai::BinaryXml(zipArchiver.extract("AndroidManifest.xml"));
+  auto const applicationPath = std::vector<std::string>{"manifest", "application"};
+  ASSERT_FALSE(binaryXml.getElementAttribute(applicationPath, 0x0101000f).has_value());
+  auto const application = *binaryXml.findElements(std::array{ai::BinaryXml::ElementPath(applicationPath)}).front();
+  auto const attributeCount = binaryXml.elementIndex().attributeCounts[application];
+
+  binaryXml.setElementAttribute(applicationPath, "debuggable", "true", 0x0101000f);
+  EXPECT_EQ(binaryXml.getElementAttribute(applicationPath, 0x0101000f), "true");
+  EXPECT_EQ(binaryXml.elementIndex().attributeCounts[application], attributeCount + 1);
+
+  //
+  // Attributes with resource ids stay ordered by id, which is how the
+  // framework looks them up.
+  //
+  auto const &elements = binaryXml.elementIndex();
+  auto resourceIds = std::vector<uint32_t>();
+  for (auto attribute = elements.firstAttributes[application]; attribute < elements.firstAttributes[application] + elements.attributeCounts[application];
+       attribute++) {
+    if (elements.attributeResourceIds[attribute] != 0) {
+      resourceIds.push_back(elements.attributeResourceIds[attribute]);
+    }
+  }
+  EXPECT_TRUE(std::is_sorted(resourceIds.begin(), resourceIds.end()));
+  EXPECT_NE(std::find(resourceIds.begin(), resourceIds.end(), 0x0101000fU), resourceIds.end());
+
+  binaryXml.setElementAttribute(applicationPath, "debuggable", "false", 0x0101000f);
+  EXPECT_EQ(binaryXml.getElementAttribute(applicationPath, 0x0101000f), "false");
+  EXPECT_EQ(binaryXml.elementIndex().attributeCounts[application], attributeCount + 1);
+
+  auto const reparsed = ai::BinaryXml(binaryXml.toBinaryXml());
+  EXPECT_EQ(reparsed.getElementAttribute(applicationPath, 0x0101000f), "false");
+  EXPECT_EQ(reparsed.getElementAttributes(applicationPath), binaryXml.getElementAttributes(applicationPath));
+}
+
+TEST(BinaryXml, toBinaryXml_PoolIsCompactedAndDocumentUnchanged) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const original = zipArchiver.extract("AndroidManifest.xml");
+  auto binaryXml = ai::BinaryXml(original);
+  binaryXml.setElementAttribute({"manifest"}, "versionName", "unreferenced-version-name");
+  binaryXml.setElementAttribute({"manifest"}, "versionName", "1.6");
+  auto const encoded = binaryXml.toBinaryXml();
+  EXPECT_LE(encoded.size(), original.size());
+  EXPECT_EQ(ai::BinaryXml(encoded).toStringXml(), ai::BinaryXml(original).toStringXml());
+  EXPECT_EQ(ai::BinaryXml(encoded).toBinaryXml(), encoded);
+
+  //
+  // Names with a resource id lead the pool, in the order of the resource
+  // map, and the other strings follow sorted and without duplicates; the
+  // string only the first edit referenced is gone.
+  //
+  auto header = ai::ResChunkHeader();
+  std::memcpy(&header, encoded.data() + sizeof(header), sizeof(header));
+  auto const strings = ai::StringPool::read(std::span(encoded).subspan(sizeof(header), header.size));
+  auto const resourceIds = ai::getXmlResourceIds(encoded);
+  ASSERT_LE(resourceIds.size(), strings.size());
+  EXPECT_EQ(std::count(resourceIds.begin(), resourceIds.end(), 0U), 0);
+  for (auto i = resourceIds.size() + 1; i < strings.size(); i++) {
+    EXPECT_LT(strings[i - 1], strings[i]) << i;
+  }
+  EXPECT_FALSE(strings.contains("unreferenced-version-name"));
+  EXPECT_TRUE(strings.contains("1.6"));
+}
+
+TEST(ResValue, formatResValueOfEveryType_AsDecodedXmlShowsIt) {
+  auto const format = [](uint8_t const type, uint32_t const data) {
+    auto buffer = ai::ResValueBuffer();
+    return std::string(ai::formatResValue(type, data, buffer));
+  };
+  EXPECT_EQ(format(ai::TYPE_NULL, 0), "<undefined>");
+  EXPECT_EQ(format(ai::TYPE_NULL, 1), "<empty>");
+  EXPECT_EQ(format(ai::TYPE_REFERENCE, 0x7f0f0050), "@res/0x7F0F0050");
+  EXPECT_EQ(format(ai::TYPE_ATTRIBUTE, 0x0101000f), "@attr/0x0101000F");
+  EXPECT_EQ(format(ai::TYPE_DYNAMIC_REFERENCE, 0x7f010000), "@dyn/0x7F010000");
+  EXPECT_EQ(format(ai::TYPE_DYNAMIC_ATTRIBUTE, 0x7f010000), "@dynattr/0x7F010000");
+  EXPECT_EQ(format(ai::TYPE_FLOAT, 0x3fc00000), "1.5");
+  EXPECT_EQ(format(ai::TYPE_FLOAT, 0x40000000), "2.0");
+  EXPECT_EQ(format(ai::TYPE_DIMENSION, 16U << 8U | 1U), "16.0dip");
+  EXPECT_EQ(format(ai::TYPE_DIMENSION, 0xffffff00), "-1.0px");
+  EXPECT_EQ(format(ai::TYPE_DIMENSION, 3U << 8U | 2U), "3.0sp");
+  EXPECT_EQ(format(ai::TYPE_FRACTION, 0x40000031), "50.0%p");
+  EXPECT_EQ(format(ai::TYPE_FRACTION, 1U << 8U), "100.0%");
+  EXPECT_EQ(format(ai::TYPE_INT_DEC, static_cast<uint32_t>(-7)), "-7");
+  EXPECT_EQ(format(ai::TYPE_INT_HEX, 0x10), "0x00000010");
+  EXPECT_EQ(format(ai::TYPE_INT_BOOLEAN, ai::RES_VALUE_TRUE), "true");
+  EXPECT_EQ(format(ai::TYPE_INT_BOOLEAN, ai::RES_VALUE_FALSE), "false");
+  EXPECT_EQ(format(ai::TYPE_INT_BOOLEAN, 1), "unknown");
+  EXPECT_EQ(format(ai::TYPE_INT_COLOR_ARGB8, 0xff00ff00), "#FF00FF00");
+  EXPECT_EQ(format(ai::TYPE_INT_COLOR_RGB8, 0xff00ff00), "#00FF00");
+  EXPECT_EQ(format(ai::TYPE_STRING, 3), "unknown");
+  EXPECT_EQ(format(0x40, 3), "unknown");
+
+  EXPECT_EQ(format(ai::TYPE_FLOAT, 0x80800001), "-1.1754945e-38");
+
+  auto output = std::string("value=");
+  ai::appendResValue(ai::TYPE_INT_HEX, 0xcafe, output);
+  EXPECT_EQ(output, "value=0x0000CAFE");
+}
+
+TEST(XmlPatch, parseXmlTypedValue_NumbersAndBooleansOnlyWhereTheTypeAllows) {
+  auto const typeOf = [](std::string_view const value, uint8_t const currentType) -> std::optional<std::pair<uint8_t, uint32_t>> {
+    auto const typedValue = ai::parseXmlTypedValue(value, currentType);
+    return typedValue ? std::optional(std::pair(typedValue->type, typedValue->data)) : std::nullopt;
+  };
+  EXPECT_EQ(typeOf("true", ai::TYPE_NULL), std::pair(uint8_t{ai::TYPE_INT_BOOLEAN}, uint32_t{ai::RES_VALUE_TRUE}));
+  EXPECT_EQ(typeOf("false", ai::TYPE_INT_BOOLEAN), std::pair(uint8_t{ai::TYPE_INT_BOOLEAN}, uint32_t{ai::RES_VALUE_FALSE}));
+  EXPECT_EQ(typeOf("-7", ai::TYPE_NULL), std::pair(uint8_t{ai::TYPE_INT_DEC}, static_cast<uint32_t>(-7)));
+  EXPECT_EQ(typeOf("0x10", ai::TYPE_INT_DEC), std::pair(uint8_t{ai::TYPE_INT_HEX}, uint32_t{0x10}));
+  EXPECT_EQ(typeOf("0xFFFFFFFF", ai::TYPE_INT_HEX), std::pair(uint8_t{ai::TYPE_INT_HEX}, uint32_t{0xFFFFFFFF}));
+  EXPECT_FALSE(typeOf("true", ai::TYPE_STRING));
+  EXPECT_FALSE(typeOf("7", ai::TYPE_STRING));
+  EXPECT_FALSE(typeOf("true", ai::TYPE_INT_DEC));
+  EXPECT_FALSE(typeOf("7", ai::TYPE_REFERENCE));
+  EXPECT_FALSE(typeOf("7a", ai::TYPE_NULL));
+  EXPECT_FALSE(typeOf("0x", ai::TYPE_NULL));
+  EXPECT_FALSE(typeOf("", ai::TYPE_NULL));
+}
+
+TEST(BinaryXml, renderFromSeveralThreads_EveryThreadGetsTheSameText) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const expected = ai::BinaryXml(zipArchiver.extract("AndroidManifest.xml")).toStringXml();
+  auto const binaryXml = ai::BinaryXml(zipArchiver.extract("AndroidManifest.xml"));
+  auto rendered = std::vector<std::string>(4);
+  auto threads = std::vector<std::thread>();
+  for (auto &xml : rendered) {
+    threads.emplace_back([&binaryXml, &xml] {
+      binaryXml.toStringXml([&xml](std::string_view const chunk) { xml += chunk; });
+      EXPECT_FALSE(binaryXml.getElementAttributes({"manifest"}).empty());
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto const &xml : rendered) {
+    EXPECT_EQ(xml, expected);
+  }
+}
+
+TEST(BinaryXml, toXmlTree_ElementsAndStringsMatchText) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const binaryXml = ai::BinaryXml(zipArchiver.extract("AndroidManifest.xml"));
+  auto const xml = binaryXml.toStringXml();
+  auto const tree = binaryXml.toXmlTree();
+
+  auto startTagCount = std::size_t{0};
+  for (auto i = xml.find('<'); i != std::string::npos; i = xml.find('<', i + 1)) {
+    startTagCount += xml[i + 1] != '/' && xml[i + 1] != '?' ? 1 : 0;
+  }
+  auto const stringsOffset = tree.find("],\"strings\":[");
+  ASSERT_NE(stringsOffset, std::string::npos);
+  auto const elements = std::string_view(tree).substr(0, stringsOffset);
+  EXPECT_TRUE(elements.starts_with("{\"elements\":[[0,-1,"));
+  EXPECT_EQ(static_cast<std::size_t>(std::count(elements.begin(), elements.end(), '[')) - 1, startTagCount);
+  EXPECT_TRUE(tree.ends_with("]}"));
+  EXPECT_NE(tree.find("\"strings\":[\"manifest\","), std::string::npos);
+  EXPECT_NE(tree.find("\"org.fdroid.fdroid\""), std::string::npos);
+  EXPECT_NE(tree.find("\"android.permission.INTERNET\""), std::string::npos);
+}
+
+TEST(BinaryXml, elementIndex_ParentsChildrenAndAttributesAreConsistent) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const binaryXml = ai::BinaryXml(zipArchiver.extract("AndroidManifest.xml"));
+  auto const &elements = binaryXml.elementIndex();
+  ASSERT_GT(elements.size(), 1U);
+  EXPECT_EQ(binaryXml.getString(elements.tags[0]), "manifest");
+  EXPECT_EQ(elements.parents[0], ai::ElementIndex::NONE);
+  EXPECT_EQ(elements.depths[0], 0);
+  EXPECT_EQ(elements.lastRoot, 0U);
+
+  //
+  // Walking the children of every element from its last one back reaches
+  // each element but the root exactly once.
+  //
+  auto reached = std::vector<uint32_t>(elements.size());
+  auto attributes = std::size_t{0};
+  for (uint32_t element = 0; element < elements.size(); element++) {
+    for (auto child = elements.lastChildren[element]; child != ai::ElementIndex::NONE; child = elements.previousSiblings[child]) {
+      ASSERT_GT(child, element);
+      EXPECT_EQ(elements.parents[child], element);
+      EXPECT_EQ(elements.depths[child], elements.depths[element] + 1);
+      reached[child]++;
+    }
+    EXPECT_EQ(elements.firstAttributes[element], attributes);
+    attributes += elements.attributeCounts[element];
+  }
+  EXPECT_EQ(std::count(reached.begin() + 1, reached.end(), 1U), static_cast<std::ptrdiff_t>(elements.size() - 1));
+  EXPECT_EQ(elements.attributeNames.size(), attributes);
+
+  auto const manifest = binaryXml.findElements(std::array{ai::BinaryXml::ElementPath{"manifest"}}).front();
+  ASSERT_EQ(manifest, 0U);
+  auto const versionCode = elements.findAttribute(*manifest, 0x0101021b);
+  ASSERT_TRUE(versionCode.has_value());
+  EXPECT_EQ(binaryXml.getAttributeValue(*versionCode), "1006050");
+  EXPECT_FALSE(elements.findAttribute(*manifest, 0x01010001).has_value());
+}
+
+TEST(BinaryXml, getElementAttributesOfPaths_SameAsOnePathAtATime) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const binaryXml = ai::BinaryXml(zipArchiver.extract("AndroidManifest.xml"));
+  auto const elementPaths = std::vector<ai::BinaryXml::ElementPath>{
+      {"manifest"}, {"manifest", "application"}, {"manifest", "missing"}, {"manifest", "uses-permission"}, {"application"}, {"manifest", "application"}};
+  auto const elementsAttributes = binaryXml.getElementAttributes(std::span<ai::BinaryXml::ElementPath const>(elementPaths));
+  ASSERT_EQ(elementsAttributes.size(), elementPaths.size());
+  for (auto i = std::size_t{0}; i < elementPaths.size(); i++) {
+    EXPECT_EQ(elementsAttributes[i], binaryXml.getElementAttributes(elementPaths[i])) << i;
+  }
+  EXPECT_EQ(elementsAttributes[0].at("package"), "org.fdroid.fdroid");
+  EXPECT_TRUE(elementsAttributes[2].empty());
+  EXPECT_TRUE(elementsAttributes[4].empty());
+  EXPECT_EQ(elementsAttributes[5], elementsAttributes[1]);
+  EXPECT_TRUE(binaryXml.getElementAttributes(std::span<ai::BinaryXml::ElementPath const>()).empty());
+}
+
+TEST(AndroidManifestParser, getComponents_ExportedComponentsAreFoundByAction) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const components = apk.getManifestComponents();
+  EXPECT_EQ(components.getPackageName(), "org.fdroid.fdroid");
+  EXPECT_EQ(components.getTargetSdkVersion(), 25U);
+  EXPECT_TRUE(components.isPermissionRequested("android.permission.INTERNET"));
+  EXPECT_FALSE(components.isPermissionRequested("android.permission.READ_SMS"));
+
+  auto const getName = [&components](uint32_t const component) { return components.getString(components.components()[component].name); };
+  auto const bootReceivers = components.findComponentsWithAction("android.intent.action.BOOT_COMPLETED", true);
+  ASSERT_EQ(bootReceivers.size(), 1U);
+  EXPECT_EQ(getName(bootReceivers[0]), "org.fdroid.fdroid.receiver.StartupReceiver");
+  EXPECT_EQ(components.components()[bootReceivers[0]].type, ai::ComponentType::Receiver);
+  auto const viewers = components.findComponentsWithAction("android.intent.action.VIEW", true);
+  EXPECT_TRUE(std::any_of(viewers.begin(), viewers.end(), [&getName](auto const component) { return getName(component) == "org.fdroid.fdroid.views.main.MainActivity"; }));
+  EXPECT_TRUE(components.findComponentsWithAction("org.example.NO_SUCH_ACTION").empty());
+
+  auto const updateService = components.findComponent("org.fdroid.fdroid.UpdateService");
+  ASSERT_TRUE(updateService.has_value());
+  auto const &service = components.components()[*updateService];
+  EXPECT_EQ(service.type, ai::ComponentType::Service);
+  EXPECT_EQ(components.getString(service.permission), "android.permission.BIND_JOB_SERVICE");
+  EXPECT_FALSE(service.exported);
+
+  auto const appProvider = components.findComponent("org.fdroid.fdroid.data.AppProvider");
+  ASSERT_TRUE(appProvider.has_value());
+  EXPECT_FALSE(components.components()[*appProvider].exported);
+  auto const calculator = components.findComponent("org.fdroid.fdroid.views.hiding.CalculatorActivity");
+  ASSERT_TRUE(calculator.has_value());
+  EXPECT_FALSE(components.components()[*calculator].enabled);
+
+  auto const &mainActivity = components.components()[components.findComponent("org.fdroid.fdroid.views.main.MainActivity").value()];
+  auto const filters = components.filters(mainActivity);
+  EXPECT_EQ(filters.size(), mainActivity.filterCount);
+  EXPECT_TRUE(std::any_of(filters.begin(), filters.end(), [&components](auto const &filter) {
+    auto const data = components.data(filter);
+    return std::any_of(data.begin(), data.end(), [&components](auto const &entry) { return components.getString(entry.host) == "f-droid.org"; });
+  }));
+}
+
+TEST(ResourceTable, findReleaseApkResources_EntriesAreDecodedSuccessfully) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const resources = zipArchiver.extract("resources.arsc");
+  auto const resourceTable = ai::ResourceTable(resources);
+
+  EXPECT_EQ(resourceTable.packageCount(), 1U);
+  EXPECT_EQ(resourceTable.getName(0x7f0f0050), "string/app_name");
+  auto const appName = resourceTable.find(0x7f0f0050);
+  ASSERT_TRUE(appName.has_value());
+  EXPECT_FALSE(appName->complex);
+  EXPECT_EQ(appName->value.type, ai::TYPE_STRING);
+  EXPECT_EQ(resourceTable.getString(appName->value.data), "F-Droid");
+
+  auto const theme = resourceTable.find(0x7f100018);
+  ASSERT_TRUE(theme.has_value());
+  EXPECT_TRUE(theme->complex);
+  EXPECT_EQ(theme->typeName, "style");
+
+  EXPECT_FALSE(resourceTable.find(0x7f0fffff).has_value());
+  EXPECT_FALSE(resourceTable.getName(0x01030055).has_value());
+}
+
+TEST(ResourceTable, findForConfiguration_BestMatchingEntriesAreDecoded) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const resources = zipArchiver.extract("resources.arsc");
+  auto const resourceTable = ai::ResourceTable(resources);
+  auto const findString = [&resourceTable](uint32_t const id, ai::ResourceConfiguration const &configuration) {
+    auto const entry = resourceTable.find(id, configuration);
+    return entry && entry->value.type == ai::TYPE_STRING ? std::string(resourceTable.getString(entry->value.data)) : std::string();
+  };
+
+  EXPECT_EQ(findString(0x7f0f0004, {}), "Done");
+  EXPECT_EQ(findString(0x7f0f0004, {.language = "de"}), "Fertig");
+  EXPECT_EQ(findString(0x7f0f0004, {.language = "de", .region = "AT"}), "Fertig");
+  EXPECT_EQ(findString(0x7f0f0004, {.language = "pt", .region = "BR"}), "Concluído");
+  EXPECT_EQ(findString(0x7f0f0004, {.language = "xx"}), "Done");
+  EXPECT_EQ(findString(0x7f08000a, {.density = 160}), "res/drawable-mdpi-v4/abc_btn_check_to_on_mtrl_000.png");
+  EXPECT_EQ(findString(0x7f08000a, {.density = 480}), "res/drawable-xxhdpi-v4/abc_btn_check_to_on_mtrl_000.png");
+  EXPECT_EQ(findString(0x7f01000c, {.sdkVersion = 19}), "res/anim/design_bottom_sheet_slide_in.xml");
+  EXPECT_EQ(findString(0x7f01000c, {.sdkVersion = 30}), "res/anim-v21/design_bottom_sheet_slide_in.xml");
+  EXPECT_EQ(findString(0x7f0f0004, {.language = "de"}), "Fertig");
+  EXPECT_FALSE(resourceTable.find(0x7f0fffff, {.language = "de"}).has_value());
+  EXPECT_THROW(resourceTable.find(0x7f0f0004, {.language = "deu"}), std::logic_error);
+}
+
+TEST(ResourceStructs, readResStruct_ShortHeadersAreZeroFilled) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const resources = zipArchiver.extract("resources.arsc");
+  auto const bytes = std::span<std::byte const>(resources);
+
+  auto const header = ai::readResStruct<ai::ResChunkHeader>(bytes, 0, "invalid");
+  EXPECT_EQ(header.type, ai::RES_TABLE_TYPE);
+  EXPECT_EQ(header.size, resources.size());
+  auto const pool = ai::readResStruct<ai::ResStringPoolHeader>(bytes, header.headerSize, "invalid");
+  EXPECT_EQ(pool.header.type, ai::RES_STRING_POOL_TYPE);
+  EXPECT_GT(pool.stringCount, 0U);
+
+  auto const truncated = ai::readResStruct<ai::ResStringPoolHeader>(bytes, header.headerSize, "invalid", sizeof(ai::ResChunkHeader));
+  EXPECT_EQ(truncated.header.size, pool.header.size);
+  EXPECT_EQ(truncated.stringCount, 0U);
+  EXPECT_THROW(ai::readResStruct<ai::ResChunkHeader>(bytes, bytes.size() - 4, "invalid"), std::logic_error);
+}
+
+TEST(StringPool, readStyledUtf8Pool_LongLengthsAndSpansAreDecoded) {
+  auto const strings = std::vector<std::string>{"\xF0\x9F\x98\x80 b&ld r<d", std::string(200, 'a'), "b", "font;color=#ff0000"};
+  auto const spans = std::vector<uint32_t>{2, 3, 6, 3, 8, 10, ai::RES_STRING_POOL_SPAN_END, ai::RES_STRING_POOL_SPAN_END, ai::RES_STRING_POOL_SPAN_END};
+  auto const appendLength = [](std::vector<std::byte> &bytes, size_t const length) {
+    if (length >= 0x80) {
+      bytes.push_back(static_cast<std::byte>(0x80 | (length >> 8)));
+    }
+    bytes.push_back(static_cast<std::byte>(length & 0xFF));
+  };
+  auto data = std::vector<std::byte>();
+  auto offsets = std::vector<uint32_t>();
+  for (auto const &string : strings) {
+    offsets.push_back(static_cast<uint32_t>(data.size()));
+    appendLength(data, string == strings[0] ? 11 : string.size());
+    appendLength(data, string.size());
+    std::transform(string.begin(), string.end(), std::back_inserter(data), [](char const c) { return static_cast<std::byte>(c); });
+    data.push_back(std::byte{0});
+  }
+  data.resize((data.size() + 3) & ~size_t{3});
+  offsets.push_back(0);
+
+  auto header = ai::ResStringPoolHeader();
+  header.header = ai::ResChunkHeader{ai::RES_STRING_POOL_TYPE, sizeof(header), 0};
+  header.stringCount = static_cast<uint32_t>(strings.size());
+  header.styleCount = 1;
+  header.flags = ai::RES_FLAG_UTF8;
+  header.stringsStart = static_cast<uint32_t>(sizeof(header) + offsets.size() * sizeof(uint32_t));
+  header.stylesStart = static_cast<uint32_t>(header.stringsStart + data.size());
+  header.header.size = static_cast<uint32_t>(header.stylesStart + spans.size() * sizeof(uint32_t));
+  auto chunk = std::vector<std::byte>(header.header.size);
+  memcpy(chunk.data(), &header, sizeof(header));
+  memcpy(chunk.data() + sizeof(header), offsets.data(), offsets.size() * sizeof(uint32_t));
+  memcpy(chunk.data() + header.stringsStart, data.data(), data.size());
+  memcpy(chunk.data() + header.stylesStart, spans.data(), spans.size() * sizeof(uint32_t));
+
+  auto const pool = ai::StringPool::read(chunk);
+  ASSERT_EQ(pool.size(), strings.size());
+  EXPECT_EQ(pool[1], strings[1]);
+  EXPECT_EQ(pool[3], strings[3]);
+  EXPECT_EQ(pool.styleCount(), 1U);
+  EXPECT_EQ(pool.styles(0).size(), 2U);
+  EXPECT_TRUE(pool.styles(1).empty());
+  EXPECT_EQ(pool.styledString(0), "\xF0\x9F\x98\x80 <b>b&amp;ld</b> <font color=\"#ff0000\">r&lt;d</font>");
+  EXPECT_EQ(pool.styledString(1), strings[1]);
+  EXPECT_THROW(ai::StringPool::read(std::span(chunk).first(header.stylesStart)), std::logic_error);
+}
+
+TEST(AndroidManifestParser, moveComponents_StringsAreStillFoundById) {
+  static_assert(!std::is_copy_constructible_v<ai::ManifestComponents>);
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto components = apk.getManifestComponents();
+  auto const movedComponents = std::move(components);
+  EXPECT_EQ(movedComponents.getPackageName(), "org.fdroid.fdroid");
+  EXPECT_TRUE(movedComponents.isPermissionRequested("android.permission.INTERNET"));
+  EXPECT_TRUE(movedComponents.findComponent("org.fdroid.fdroid.UpdateService").has_value());
+}
+
+TEST(ResourceResolver, getAndroidManifest_ReferencesAreResolvedByName) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const androidManifest = apk.getAndroidManifest();
+  EXPECT_NE(androidManifest.find("label=\"@string/app_name\""), std::string::npos);
+  EXPECT_NE(androidManifest.find("theme=\"@res/0x01030055\""), std::string::npos);
+
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const resources = zipArchiver.extract("resources.arsc");
+  auto const resourceTable = ai::ResourceTable(resources);
+  auto resolver = ai::ResourceResolver(resourceTable, 2);
+  EXPECT_EQ(resolver.getReference(0x7f0f0050), "@string/app_name");
+  EXPECT_EQ(resolver.getReference(0x7f100018), "@style/AppThemeLight");
+  EXPECT_EQ(resolver.getReference(0x7f0f0050), "@string/app_name");
+  EXPECT_EQ(resolver.getReference(0x01030055), "@res/0x01030055");
+  EXPECT_EQ(resolver.size(), 2U);
+}
+
+TEST(ResourceDecoder, decodeXmlResources_AllResourcesAreDecodedSuccessfully) {
+  auto const zipArchiver = ai::ZipArchiver(getTestApkPath("test_release.apk").string());
+  auto const resources = zipArchiver.extract("resources.arsc");
+  auto const resourceTable = ai::ResourceTable(resources);
+
+  auto const decodeAll = [&](ai::utils::ThreadPool &threadPool) {
+    auto decoded = std::map<std::string, std::string>();
+    ai::decodeXmlResources(zipArchiver, &resourceTable, threadPool, [&decoded](ai::DecodedXmlResource resource) {
+      EXPECT_TRUE(resource.error.empty()) << resource.path;
+      decoded.emplace(std::move(resource.path), std::move(resource.xml));
+    }, 4);
+    return decoded;
+  };
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const decoded = decodeAll(threadPool);
+  auto inlinePool = ai::utils::ThreadPool(0);
+  EXPECT_EQ(decodeAll(inlinePool), decoded);
+
+  auto const fileProvider = decoded.find("res/xml/apk_file_provider.xml");
+  ASSERT_NE(fileProvider, decoded.end());
+  EXPECT_TRUE(fileProvider->second.starts_with("<?xml"));
+  EXPECT_EQ(decoded.count("AndroidManifest.xml"), 0U);
+}
+
+TEST(Apk, extractWithGlobs_OnlyMatchingFilesAreWrittenAndXmlIsDecoded) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const destination = fs::temp_directory_path() / "extractWithGlobs_OnlyMatchingFilesAreWrittenAndXmlIsDecoded";
+  fs::remove_all(destination);
+  auto const isXmlResource = [](std::string const &file) { return ai::utils::matchesGlob("res/**/*.xml", file); };
+  auto const files = apk.getFiles();
+  auto const xmlResources = static_cast<size_t>(std::count_if(files.begin(), files.end(), isXmlResource));
+  ASSERT_GT(xmlResources, 0U);
+
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto options = ai::ApkExtractOptions();
+  options.include = {"res/**/*.xml"};
+  EXPECT_EQ(apk.extract(destination.string(), options, threadPool), xmlResources);
+  EXPECT_FALSE(fs::exists(destination / "AndroidManifest.xml"));
+  auto const rawXml = apk.getFileContent("res/xml/apk_file_provider.xml");
+  EXPECT_EQ(fs::file_size(destination / "res/xml/apk_file_provider.xml"), rawXml.size());
+
+  options.include.push_back("AndroidManifest.xml");
+  options.decodeXml = true;
+  EXPECT_EQ(apk.extract(destination.string(), options, threadPool), xmlResources + 1);
+  auto file = std::ifstream(destination / "res/xml/apk_file_provider.xml");
+  EXPECT_TRUE(std::string(std::istreambuf_iterator<char>(file), {}).starts_with("<?xml"));
+  EXPECT_TRUE(fs::exists(destination / "AndroidManifest.xml"));
+  fs::remove_all(destination);
+}
+
+TEST(Apk, extractWithContentStore_IdenticalEntriesAreLinkedFromTheStore) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const root = fs::temp_directory_path() / "extractWithContentStore_IdenticalEntriesAreLinkedFromTheStore";
+  fs::remove_all(root);
+  auto options = ai::ApkExtractOptions();
+  options.include = {"res/**/*.xml"};
+  options.contentStore = (root / "store").string();
+  options.storeLink = ai::ApkStoreLink::Hardlink;
+
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const extracted = apk.extract((root / "first").string(), options, threadPool);
+  ASSERT_GT(extracted, 0U);
+  auto const hits = ai::utils::metrics::counter("apk.extract_store_hits").value();
+  EXPECT_EQ(apk.extract((root / "second").string(), options, threadPool), extracted);
+  EXPECT_GE(ai::utils::metrics::counter("apk.extract_store_hits").value() - hits, extracted);
+
+  auto const path = fs::path("res/xml/apk_file_provider.xml");
+  EXPECT_EQ(fs::hard_link_count(root / "second" / path), 3U);
+  EXPECT_EQ(fs::file_size(root / "second" / path), apk.getFileContent(path.string()).size());
+
+  options.verifyContents = true;
+  EXPECT_EQ(apk.extract((root / "third").string(), options, threadPool), extracted);
+  EXPECT_EQ(fs::hard_link_count(root / "third" / path), 2U);
+  EXPECT_EQ(fs::status(root / "third" / path).permissions() & fs::perms::owner_write, fs::perms::none);
+
+  // Clones, or the copies they fall back to, leave the store untouched when
+  // the extracted file is changed.
+  options.storeLink = ai::ApkStoreLink::Clone;
+  EXPECT_EQ(apk.extract((root / "fourth").string(), options, threadPool), extracted);
+  EXPECT_EQ(fs::hard_link_count(root / "fourth" / path), 1U);
+  std::ofstream(root / "fourth" / path, std::ios::trunc) << "changed";
+  EXPECT_EQ(fs::file_size(root / "third" / path), apk.getFileContent(path.string()).size());
+  fs::remove_all(root);
+}
+
+TEST(Apk, cancelLongCalls_CallsThrowAndStopTakingWork) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const destination = fs::temp_directory_path() / "cancelLongCalls_CallsThrowAndStopTakingWork";
+  fs::remove_all(destination);
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto options = ai::ApkExtractOptions();
+  options.cancellation = ai::utils::CancellationToken::create();
+  options.cancellation.cancel();
+  EXPECT_THROW(apk.extract(destination.string(), options, threadPool), ai::utils::CancellationException);
+  options.decodeXml = true;
+  EXPECT_THROW(apk.extract(destination.string(), options, threadPool), ai::utils::CancellationException);
+  EXPECT_THROW(apk.dump(destination.string(), options.cancellation), ai::utils::CancellationException);
+  EXPECT_FALSE(fs::exists(destination / "res"));
+
+  auto const apkPaths = std::vector<std::string>(8, getTestApkPath("test_release.apk").string());
+  auto batchOptions = ai::ApkBatchOptions();
+  batchOptions.fields = {ai::ApkPropertyField::Package};
+  batchOptions.maxInFlight = 1;
+  batchOptions.cancellation = ai::utils::CancellationToken::create();
+  auto results = size_t{0};
+  auto const onResult = [&](ai::ApkBatchResult const &) {
+    results++;
+    batchOptions.cancellation.cancel();
+  };
+  EXPECT_THROW(ai::analyzeMany(apkPaths, batchOptions, threadPool, onResult), ai::utils::CancellationException);
+  EXPECT_EQ(results, 1U);
+  EXPECT_FALSE(ai::utils::CancellationToken().isCancelled());
+  fs::remove_all(destination);
+}
+
+TEST(DirectoryTree, buildFromEntries_DirectoriesListChildrenWithSizes) {
+  auto const entries = std::vector<ai::ApkEntry>{
+      {"res/layout/main.xml", 10, 20, 0, 8, 0}, {"classes.dex", 100, 200, 0, 8, 0}, {"res/values/", 0, 0, 0, 0, 0},
+      {"res/layout/item.xml", 1, 2, 0, 8, 0},   {"lib//a.so", 5, 5, 0, 0, 0},
+  };
+  auto const directoryTree = ai::DirectoryTree(entries);
+  auto const &root = directoryTree.getNode(ai::DirectoryTree::ROOT);
+  EXPECT_EQ(root.fileCount, 4);
+  EXPECT_EQ(root.compressedSize, 116);
+  EXPECT_EQ(root.uncompressedSize, 227);
+
+  auto const rootChildren = directoryTree.listDirectory(ai::DirectoryTree::ROOT);
+  ASSERT_EQ(rootChildren.size(), 3);
+  EXPECT_EQ(directoryTree.getName(root.firstChild), "lib");
+  EXPECT_EQ(directoryTree.getName(root.firstChild + 1), "res");
+  EXPECT_EQ(directoryTree.getName(root.firstChild + 2), "classes.dex");
+  EXPECT_FALSE(rootChildren[2].isDirectory());
+  EXPECT_EQ(rootChildren[2].entry, 1);
+
+  auto const layout = directoryTree.find("res/layout");
+  ASSERT_TRUE(layout);
+  EXPECT_EQ(directoryTree.getPath(*layout), "res/layout");
+  EXPECT_EQ(directoryTree.getNode(*layout).fileCount, 2);
+  auto const layoutChildren = directoryTree.listDirectory(*layout);
+  ASSERT_EQ(layoutChildren.size(), 2);
+  EXPECT_EQ(directoryTree.getName(directoryTree.getNode(*layout).firstChild), "item.xml");
+
+  auto const values = directoryTree.find("res/values");
+  ASSERT_TRUE(values);
+  EXPECT_TRUE(directoryTree.getNode(*values).isDirectory());
+  EXPECT_EQ(directoryTree.getNode(*values).fileCount, 0);
+  EXPECT_EQ(directoryTree.find("lib/a.so"), directoryTree.find("/lib/a.so"));
+  EXPECT_FALSE(directoryTree.find("res/raw"));
+}
+
+TEST(DirectoryTree, buildFromReleaseApk_EveryFileIsFoundByItsPath) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const entries = apk.getEntries();
+  auto const directoryTree = ai::DirectoryTree(entries);
+  auto files = size_t{0};
+  for (auto entry = size_t{0}; entry < entries.size(); entry++) {
+    if (entries[entry].path.ends_with('/')) {
+      continue;
+    }
+    files++;
+    auto const node = directoryTree.find(entries[entry].path);
+    ASSERT_TRUE(node);
+    EXPECT_EQ(directoryTree.getNode(*node).entry, entry);
+    EXPECT_EQ(directoryTree.getPath(*node), entries[entry].path);
+  }
+  EXPECT_EQ(directoryTree.getNode(ai::DirectoryTree::ROOT).fileCount, files);
+}
+
+TEST(FileListing, getPage_PagesOfTheFilterInOrderOfTheFiles) {
+  auto fileListing = ai::FileListing({"AndroidManifest.xml", "classes.dex", "res/layout/main.xml", "res/drawable/icon.png", "classes2.dex"});
+
+  auto page = fileListing.getPage(1, 2, "");
+  EXPECT_EQ(page.total, 5U);
+  EXPECT_EQ(page.offsets.front(), 0U);
+  EXPECT_EQ(page.offsets.back(), page.names.size());
+  EXPECT_EQ(getPagePaths(page), std::vector<std::string_view>({"classes.dex", "res/layout/main.xml"}));
+
+  page = fileListing.getPage(0, 10, "classes*.dex");
+  EXPECT_EQ(page.total, 2U);
+  EXPECT_EQ(getPagePaths(page), std::vector<std::string_view>({"classes.dex", "classes2.dex"}));
+
+  page = fileListing.getPage(1, 10, "res/");
+  EXPECT_EQ(page.total, 2U);
+  EXPECT_EQ(getPagePaths(page), std::vector<std::string_view>({"res/drawable/icon.png"}));
+
+  page = fileListing.getPage(3, 10, "res/");
+  EXPECT_EQ(page.total, 2U);
+  EXPECT_TRUE(page.names.empty());
+  EXPECT_EQ(page.offsets.size(), 1U);
+
+  EXPECT_EQ(fileListing.getPage(0, 0, "").total, 5U);
+  EXPECT_EQ(fileListing.getPage(0, 10, "*.so").total, 0U);
+}
+
+TEST(FileListing, getPagesOfReleaseApk_SameAsItsFiles) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const files = apk.getFiles();
+  auto fileListing = ai::FileListing(files);
+  auto paths = std::vector<std::string>();
+  for (auto offset = size_t{0}; offset < files.size(); offset += 7) {
+    auto const page = fileListing.getPage(offset, 7, "");
+    EXPECT_EQ(page.total, files.size());
+    for (auto const path : getPagePaths(page)) {
+      paths.emplace_back(path);
+    }
+  }
+  EXPECT_EQ(paths, files);
+
+  auto xmlFiles = files;
+  std::erase_if(xmlFiles, [](std::string const &file) { return !ai::utils::matchesGlob("res/**/*.xml", file); });
+  auto const page = fileListing.getPage(0, files.size(), "res/**/*.xml");
+  EXPECT_EQ(page.total, xmlFiles.size());
+  EXPECT_EQ(getPagePaths(page), std::vector<std::string_view>(xmlFiles.begin(), xmlFiles.end()));
+}
+
+TEST(ApkCorpus, generateScaledDownShape_EveryPartIsReadBack) {
+  auto const shape = ai::ApkCorpusShape{"scaled-down", 2'500, 16, 2, 64 * 1024, 50, 1'000, 200};
+  auto const corpusPath = (fs::temp_directory_path() / "generateScaledDownShape_EveryPartIsReadBack.apk").string();
+  auto scopedFileDeleter = ScopedFileDeleter(corpusPath.c_str());
+  auto threadPool = ai::utils::ThreadPool(4);
+  ai::generateCorpusApk(corpusPath, shape, threadPool);
+  ai::generateCorpusApk(corpusPath, shape, threadPool);
+
+  auto const apk = ai::Apk(corpusPath);
+  EXPECT_TRUE(apk.isValid());
+  EXPECT_EQ(apk.getFiles().size(), 2'505U);
+  EXPECT_EQ(apk.getFileContent("assets/tiny/2/2499.txt").size(), 16U);
+  EXPECT_EQ(apk.getFileBytes("assets/large/1.bin").bytes().size(), 64U * 1024U);
+  auto const properties = apk.getProperties({ai::ApkPropertyField::Package, ai::ApkPropertyField::Version});
+  EXPECT_EQ(properties.at("packageName"), "org.example.corpus");
+  EXPECT_EQ(properties.at("versionCode"), "1");
+  EXPECT_NE(apk.getAndroidManifest().find("org.example.corpus.Activity49"), std::string::npos);
+
+  auto const strings = ai::BinaryXml(apk.getFileContent("res/layout/strings.xml")).toStringXml();
+  EXPECT_NE(strings.find("String \u2116999"), std::string::npos);
+  auto const deep = ai::BinaryXml(apk.getFileContent("res/layout/deep.xml")).toStringXml();
+  auto depth = size_t{0};
+  for (auto position = deep.find("<LinearLayout"); position != std::string::npos; position = deep.find("<LinearLayout", position + 1)) {
+    depth++;
+  }
+  EXPECT_EQ(depth, 200U);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   if (setEnvironmentIfReady()) {
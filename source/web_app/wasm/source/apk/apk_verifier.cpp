@@ -0,0 +1,615 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+#include "apk_signing_block.h"
+#include "apk_verifier.h"
+#include "utils/format.h"
+#include "utils/log.h"
+#include "utils/mapped_file.h"
+#include "utils/sha.h"
+#include "utils/thread_pool.h"
+#include "zip_archiver.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr std::string_view JAR_SIGNATURE_DIRECTORY = "META-INF/";
+
+static constexpr std::string_view JAR_MANIFEST_PATH = "META-INF/MANIFEST.MF";
+
+static constexpr std::array<std::string_view, 3> JAR_SIGNATURE_BLOCK_EXTENSIONS = {".RSA", ".EC", ".DSA"};
+
+static constexpr std::string_view ANDROID_APK_SIGNED_ATTRIBUTE = "X-Android-APK-Signed";
+
+static constexpr uint8_t DER_INTEGER = 0x02;
+
+static constexpr uint8_t DER_OCTET_STRING = 0x04;
+
+static constexpr uint8_t DER_OBJECT_IDENTIFIER = 0x06;
+
+static constexpr uint8_t DER_SEQUENCE = 0x30;
+
+static constexpr uint8_t DER_SET = 0x31;
+
+static constexpr uint8_t DER_CONTEXT_0 = 0xa0;
+
+static constexpr uint8_t DER_CONTEXT_1 = 0xa1;
+
+static constexpr std::array<uint8_t, 5> OID_SHA1 = {0x2b, 0x0e, 0x03, 0x02, 0x1a};
+
+static constexpr std::array<uint8_t, 9> OID_SHA256 = {0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01};
+
+struct JarDigestAlgorithm {
+
+  std::string_view hashName;
+
+  //
+  // Prefix of the digest attributes in the manifest and signature file,
+  // e.g. "SHA-256" in "SHA-256-Digest".
+  //
+  std::string_view attributePrefix;
+};
+
+static constexpr std::array<JarDigestAlgorithm, 2> JAR_DIGEST_ALGORITHMS = {JarDigestAlgorithm{"SHA-256", "SHA-256"}, JarDigestAlgorithm{"SHA-1", "SHA1"}};
+
+//
+// Reader of the length-prefixed structures of the v2 and v3 blocks.
+//
+class PrefixedReader final {
+public:
+  explicit PrefixedReader(std::span<std::byte const> bytes) : bytes_(bytes) {}
+
+  auto empty() const -> bool { return bytes_.empty(); }
+
+  auto readUint32() -> uint32_t {
+    auto value = uint32_t{0};
+    memcpy(&value, read(sizeof(value)).data(), sizeof(value));
+    return value;
+  }
+
+  auto readPrefixed() -> std::span<std::byte const> { return read(readUint32()); }
+
+private:
+  auto read(std::size_t const size) -> std::span<std::byte const> {
+    if (size > bytes_.size()) {
+      throw std::logic_error("truncated signature block");
+    }
+    auto const value = bytes_.first(size);
+    bytes_ = bytes_.subspan(size);
+    return value;
+  }
+
+  std::span<std::byte const> bytes_;
+};
+
+struct DerElement {
+
+  uint8_t tag;
+
+  std::span<std::byte const> contents;
+
+  //
+  // Tag, length and contents.
+  //
+  std::span<std::byte const> encoded;
+};
+
+//
+// Just enough DER to walk the PKCS#7 SignedData of a v1 signature block.
+//
+class DerReader final {
+public:
+  explicit DerReader(std::span<std::byte const> bytes) : bytes_(bytes) {}
+
+  auto empty() const -> bool { return bytes_.empty(); }
+
+  auto peek() const -> uint8_t { return bytes_.empty() ? 0 : static_cast<uint8_t>(bytes_[0]); }
+
+  auto read() -> DerElement {
+    if (bytes_.size() < 2) {
+      throw std::logic_error("truncated der element");
+    }
+    auto const tag = static_cast<uint8_t>(bytes_[0]);
+    auto length = std::size_t{static_cast<uint8_t>(bytes_[1])};
+    auto headerSize = std::size_t{2};
+    if ((length & 0x80) != 0) {
+      auto const lengthSize = length & 0x7f;
+      if (lengthSize == 0 || lengthSize > sizeof(uint32_t) || bytes_.size() < headerSize + lengthSize) {
+        throw std::logic_error("invalid der length");
+      }
+      length = 0;
+      for (auto i = std::size_t{0}; i < lengthSize; i++) {
+        length = (length << 8) | static_cast<uint8_t>(bytes_[headerSize + i]);
+      }
+      headerSize += lengthSize;
+    }
+    if (length > bytes_.size() - headerSize) {
+      throw std::logic_error("truncated der element");
+    }
+    auto const element = DerElement{tag, bytes_.subspan(headerSize, length), bytes_.first(headerSize + length)};
+    bytes_ = bytes_.subspan(headerSize + length);
+    return element;
+  }
+
+  auto read(uint8_t const expectedTag) -> DerElement {
+    auto const element = read();
+    if (element.tag != expectedTag) {
+      throw std::logic_error("unexpected der element");
+    }
+    return element;
+  }
+
+private:
+  std::span<std::byte const> bytes_;
+};
+
+struct JarSignatureBlock {
+
+  std::vector<std::span<std::byte const>> certificates;
+
+  std::span<std::byte const> digestAlgorithm;
+
+  std::span<std::byte const> signature;
+};
+
+auto readJarSignatureBlock(std::span<std::byte const> const block) -> JarSignatureBlock {
+  auto contentInfo = DerReader(DerReader(block).read(DER_SEQUENCE).contents);
+  contentInfo.read(DER_OBJECT_IDENTIFIER);
+  auto signedData = DerReader(DerReader(contentInfo.read(DER_CONTEXT_0).contents).read(DER_SEQUENCE).contents);
+  signedData.read(DER_INTEGER);
+  signedData.read(DER_SET);
+  signedData.read(DER_SEQUENCE);
+
+  auto signatureBlock = JarSignatureBlock();
+  if (signedData.peek() == DER_CONTEXT_0) {
+    auto certificates = DerReader(signedData.read().contents);
+    while (!certificates.empty()) {
+      signatureBlock.certificates.push_back(certificates.read(DER_SEQUENCE).encoded);
+    }
+  }
+  if (signedData.peek() == DER_CONTEXT_1) {
+    signedData.read();
+  }
+
+  auto signerInfo = DerReader(DerReader(signedData.read(DER_SET).contents).read(DER_SEQUENCE).contents);
+  signerInfo.read(DER_INTEGER);
+  signerInfo.read(DER_SEQUENCE);
+  signatureBlock.digestAlgorithm = DerReader(signerInfo.read(DER_SEQUENCE).contents).read(DER_OBJECT_IDENTIFIER).contents;
+  if (signerInfo.peek() == DER_CONTEXT_0) {
+    throw std::logic_error("signed attributes are not supported");
+  }
+  signerInfo.read(DER_SEQUENCE);
+  signatureBlock.signature = signerInfo.read(DER_OCTET_STRING).contents;
+  return signatureBlock;
+}
+
+template <std::size_t N> auto isOid(std::span<std::byte const> const oid, std::array<uint8_t, N> const &expected) -> bool {
+  return oid.size() == N && memcmp(oid.data(), expected.data(), N) == 0;
+}
+
+auto getJarSignatureAlgorithm(std::span<std::byte const> const digestAlgorithm, std::string_view const keyAlgorithm)
+    -> std::optional<utils::signature::SignatureAlgorithm> {
+  using utils::signature::SignatureAlgorithm;
+  auto const isRsa = keyAlgorithm == "RSA";
+  if (!isRsa && keyAlgorithm != "ECDSA") {
+    return std::nullopt;
+  }
+  if (isOid(digestAlgorithm, OID_SHA256)) {
+    return isRsa ? SignatureAlgorithm::RsaPkcs1Sha256 : SignatureAlgorithm::EcdsaSha256;
+  }
+  if (isOid(digestAlgorithm, OID_SHA1)) {
+    return isRsa ? SignatureAlgorithm::RsaPkcs1Sha1 : SignatureAlgorithm::EcdsaSha1;
+  }
+  return std::nullopt;
+}
+
+using JarSection = std::map<std::string, std::string, std::less<>>;
+
+//
+// Sections of a manifest or signature file, the main section first.  Lines
+// starting with a space continue the previous one.
+//
+auto readJarSections(std::string_view const text) -> std::vector<JarSection> {
+  auto sections = std::vector<JarSection>(1);
+  auto lines = std::vector<std::string>();
+  auto flush = [&sections, &lines] {
+    for (auto const &line : lines) {
+      auto const separator = line.find(": ");
+      if (separator != std::string::npos) {
+        sections.back()[line.substr(0, separator)] = line.substr(separator + 2);
+      }
+    }
+    lines.clear();
+  };
+  for (auto offset = std::size_t{0}; offset < text.size();) {
+    auto end = text.find_first_of("\r\n", offset);
+    end = end == std::string_view::npos ? text.size() : end;
+    auto const line = text.substr(offset, end - offset);
+    offset = end + (text.compare(end, 2, "\r\n") == 0 ? 2 : 1);
+    if (line.empty()) {
+      if (!lines.empty()) {
+        flush();
+        sections.emplace_back();
+      }
+    } else if (line[0] == ' ' && !lines.empty()) {
+      lines.back() += line.substr(1);
+    } else {
+      lines.emplace_back(line);
+    }
+  }
+  flush();
+  if (sections.size() > 1 && sections.back().empty()) {
+    sections.pop_back();
+  }
+  return sections;
+}
+
+//
+// Digest attribute of a section with the strongest algorithm it has, e.g.
+// SHA-256-Digest, or with suffix "-Digest-Manifest" in a signature file.
+//
+auto findJarDigest(JarSection const &section, std::string_view const suffix) -> std::optional<std::pair<std::string_view, std::vector<std::byte>>> {
+  for (auto const &algorithm : JAR_DIGEST_ALGORITHMS) {
+    auto const digest = section.find(std::string(algorithm.attributePrefix) + std::string(suffix));
+    if (digest != section.end()) {
+      return std::make_pair(algorithm.hashName, utils::format::decodeBase64(digest->second));
+    }
+  }
+  return std::nullopt;
+}
+
+//
+// Files of the v1 signature itself, which the manifest does not list.
+//
+auto isJarSignatureFile(std::string_view const path) -> bool {
+  if (!path.starts_with(JAR_SIGNATURE_DIRECTORY) || path.find('/', JAR_SIGNATURE_DIRECTORY.size()) != std::string_view::npos) {
+    return false;
+  }
+  auto const isBlock = [path](auto const extension) { return path.ends_with(extension); };
+  return path == JAR_MANIFEST_PATH || path.ends_with(".SF") ||
+         std::any_of(JAR_SIGNATURE_BLOCK_EXTENSIONS.begin(), JAR_SIGNATURE_BLOCK_EXTENSIONS.end(), isBlock);
+}
+
+auto getSignatureAlgorithm(uint32_t const id) -> std::optional<utils::signature::SignatureAlgorithm> {
+  switch (id) {
+  case SIGNATURE_RSA_PKCS1_V1_5_WITH_SHA256: {
+    return utils::signature::SignatureAlgorithm::RsaPkcs1Sha256;
+  }
+  case SIGNATURE_RSA_PKCS1_V1_5_WITH_SHA512: {
+    return utils::signature::SignatureAlgorithm::RsaPkcs1Sha512;
+  }
+  case SIGNATURE_ECDSA_WITH_SHA256: {
+    return utils::signature::SignatureAlgorithm::EcdsaSha256;
+  }
+  case SIGNATURE_ECDSA_WITH_SHA512: {
+    return utils::signature::SignatureAlgorithm::EcdsaSha512;
+  }
+  default: {
+    return std::nullopt;
+  }
+  }
+}
+
+//
+// Content digests of the apk, each computed the first time a signer needs
+// it so that APKs signed only with SHA-256 are not also hashed with SHA-512.
+//
+class ContentDigests final {
+public:
+  ContentDigests(std::span<std::byte const> apk, ApkSections const &sections, utils::ThreadPool &threadPool)
+      : apk_(apk), sections_(sections), threadPool_(threadPool) {}
+
+  auto get(uint32_t const algorithmId) -> std::span<std::byte const> {
+    if (isSha512SignatureAlgorithm(algorithmId)) {
+      if (!sha512_) {
+        sha512_ = computeApkContentSha512Digest(apk_, sections_, threadPool_);
+      }
+      return *sha512_;
+    }
+    if (!sha256_) {
+      sha256_ = computeApkContentDigest(apk_, sections_, threadPool_);
+    }
+    return *sha256_;
+  }
+
+private:
+  std::span<std::byte const> const apk_;
+
+  ApkSections const sections_;
+
+  utils::ThreadPool &threadPool_;
+
+  std::optional<utils::sha::Sha256Digest> sha256_;
+
+  std::optional<utils::sha::Sha512Digest> sha512_;
+};
+
+auto toHexId(uint32_t const id) -> std::string {
+  auto const bytes = std::array{static_cast<std::byte>(id >> 8), static_cast<std::byte>(id)};
+  return "0x" + utils::format::toHex(bytes);
+}
+
+auto addError(ApkVerification &verification, std::string error) -> bool {
+  LOGD("verifyApk, [{}]", error);
+  verification.errors.push_back(std::move(error));
+  return false;
+}
+
+//
+// Verifies every signer of a v2 or v3 block: the signatures over the signed
+// data, the content digest it lists and the public key of its certificate.
+// Sets v3Required when a v2 signer says the APK is also signed with v3.
+//
+auto verifySchemeBlock(uint32_t const scheme, std::span<std::byte const> const block, ContentDigests &contentDigests,
+                       ApkVerification &verification, bool &v3Required) -> bool {
+  auto const prefix = "v" + std::to_string(scheme) + " ";
+  auto signers = PrefixedReader(PrefixedReader(block).readPrefixed());
+  if (signers.empty()) {
+    return addError(verification, prefix + "block has no signers");
+  }
+  while (!signers.empty()) {
+    auto signer = PrefixedReader(signers.readPrefixed());
+    auto const signedData = signer.readPrefixed();
+    auto const sdkVersions = scheme == 3 ? std::optional(std::make_pair(signer.readUint32(), signer.readUint32())) : std::nullopt;
+    auto signatures = PrefixedReader(signer.readPrefixed());
+    auto const publicKey = signer.readPrefixed();
+
+    auto signatureAlgorithms = std::vector<uint32_t>();
+    auto verifiedSignatures = 0;
+    while (!signatures.empty()) {
+      auto signature = PrefixedReader(signatures.readPrefixed());
+      auto const algorithmId = signature.readUint32();
+      auto const bytes = signature.readPrefixed();
+      signatureAlgorithms.push_back(algorithmId);
+      auto const algorithm = getSignatureAlgorithm(algorithmId);
+      if (!algorithm) {
+        continue;
+      }
+      if (!utils::signature::verify(*algorithm, publicKey, signedData, bytes)) {
+        return addError(verification, prefix + "signature does not verify");
+      }
+      verifiedSignatures++;
+    }
+    if (verifiedSignatures == 0) {
+      auto ids = std::string();
+      for (auto const algorithmId : signatureAlgorithms) {
+        ids += (ids.empty() ? "" : ", ") + toHexId(algorithmId);
+      }
+      return addError(verification, prefix + "signer uses unsupported signature algorithms [" + ids + "]");
+    }
+
+    auto data = PrefixedReader(signedData);
+    auto digests = PrefixedReader(data.readPrefixed());
+    auto certificates = PrefixedReader(data.readPrefixed());
+    if (sdkVersions && std::make_pair(data.readUint32(), data.readUint32()) != *sdkVersions) {
+      return addError(verification, prefix + "signer and signed data disagree on sdk versions");
+    }
+    auto attributes = PrefixedReader(data.readPrefixed());
+
+    auto digestAlgorithms = std::vector<uint32_t>();
+    while (!digests.empty()) {
+      auto digest = PrefixedReader(digests.readPrefixed());
+      auto const algorithmId = digest.readUint32();
+      auto const bytes = digest.readPrefixed();
+      digestAlgorithms.push_back(algorithmId);
+      if (getSignatureAlgorithm(algorithmId)) {
+        auto const contentDigest = contentDigests.get(algorithmId);
+        if (!std::equal(bytes.begin(), bytes.end(), contentDigest.begin(), contentDigest.end())) {
+          return addError(verification, prefix + "content digest does not match");
+        }
+      }
+    }
+    if (digestAlgorithms != signatureAlgorithms) {
+      return addError(verification, prefix + "digest and signature algorithms differ");
+    }
+
+    if (certificates.empty()) {
+      return addError(verification, prefix + "signer has no certificate");
+    }
+    auto certificate = utils::signature::readCertificate(certificates.readPrefixed());
+    if (!std::equal(certificate.publicKey.begin(), certificate.publicKey.end(), publicKey.begin(), publicKey.end())) {
+      return addError(verification, prefix + "certificate is not for the signing key");
+    }
+    verification.signers.push_back(ApkSignerCertificate{scheme, std::move(certificate)});
+
+    while (!attributes.empty()) {
+      auto attribute = PrefixedReader(attributes.readPrefixed());
+      if (scheme == 2 && attribute.readUint32() == STRIPPING_PROTECTION_ATTRIBUTE_ID && attribute.readUint32() == STRIPPING_PROTECTION_V3) {
+        v3Required = true;
+      }
+    }
+  }
+  return true;
+}
+
+//
+// Checks the digest of every entry against the manifest, inflating the
+// entries on the workers of the pool.
+//
+auto verifyJarEntries(ZipArchiver const &archive, std::vector<JarSection> const &manifest, utils::ThreadPool &threadPool, ApkVerification &verification)
+    -> bool {
+  auto expectedDigests = std::map<std::string, std::pair<std::string_view, std::vector<std::byte>>, std::less<>>();
+  for (auto section = manifest.begin() + 1; section != manifest.end(); section++) {
+    auto const name = section->find("Name");
+    auto digest = name == section->end() ? std::nullopt : findJarDigest(*section, "-Digest");
+    if (digest) {
+      expectedDigests.emplace(name->second, std::move(*digest));
+    }
+  }
+
+  auto mutex = std::mutex();
+  auto mismatches = std::vector<std::string>();
+  auto const isSigned = [](ZipEntry const &entry) { return !isJarSignatureFile(entry.path) && !entry.path.ends_with('/'); };
+  for (auto const &entry : archive.entries()) {
+    if (isSigned(entry) && !expectedDigests.contains(entry.path)) {
+      mismatches.push_back(entry.path);
+    }
+  }
+  archive.extractAll(isSigned,
+                     [&expectedDigests, &mutex, &mismatches](size_t, ZipEntry const &entry, std::span<std::byte const> const contents) {
+                       auto const expected = expectedDigests.find(entry.path);
+                       if (expected != expectedDigests.end() && utils::sha::computeDigest(expected->second.first, contents) != expected->second.second) {
+                         auto const lock = std::scoped_lock(mutex);
+                         mismatches.push_back(entry.path);
+                       }
+                     },
+                     threadPool);
+  std::sort(mismatches.begin(), mismatches.end());
+  for (auto const &path : mismatches) {
+    addError(verification, "v1 digest of [" + path + "] is missing or does not match");
+  }
+  return mismatches.empty();
+}
+
+//
+// Verifies the v1 signature files: the PKCS#7 signature over each .SF
+// file, its digest of the manifest and, when checkEntries is set, the
+// digests of the entries.  Returns nullopt when there is no v1 signature.
+//
+auto verifyJarSignature(ZipArchiver const &archive, bool const hasV2, bool const hasV3, bool const checkEntries, utils::ThreadPool &threadPool,
+                        ApkVerification &verification) -> std::optional<bool> {
+  auto const files = archive.files();
+  auto signatureFiles = std::vector<std::string>();
+  std::copy_if(files.begin(), files.end(), std::back_inserter(signatureFiles),
+               [](auto const &path) { return isJarSignatureFile(path) && path.ends_with(".SF"); });
+  if (signatureFiles.empty() || std::find(files.begin(), files.end(), JAR_MANIFEST_PATH) == files.end()) {
+    return std::nullopt;
+  }
+
+  auto const manifestBytes = archive.extract(JAR_MANIFEST_PATH);
+  for (auto const &signatureFile : signatureFiles) {
+    auto const base = signatureFile.substr(0, signatureFile.size() - 3);
+    auto const hasBlock = [&files, &base](auto const extension) { return std::find(files.begin(), files.end(), base + std::string(extension)) != files.end(); };
+    auto const blockExtension = std::find_if(JAR_SIGNATURE_BLOCK_EXTENSIONS.begin(), JAR_SIGNATURE_BLOCK_EXTENSIONS.end(), hasBlock);
+    if (blockExtension == JAR_SIGNATURE_BLOCK_EXTENSIONS.end()) {
+      return addError(verification, "v1 signature block of [" + signatureFile + "] is missing");
+    }
+    auto const signatureBytes = archive.extract(signatureFile);
+    auto const blockBytes = archive.extract(base + std::string(*blockExtension));
+    auto const block = readJarSignatureBlock(blockBytes);
+
+    auto signer = std::optional<utils::signature::CertificateInfo>();
+    for (auto const &encoded : block.certificates) {
+      auto certificate = utils::signature::readCertificate(encoded);
+      auto const algorithm = getJarSignatureAlgorithm(block.digestAlgorithm, certificate.keyAlgorithm);
+      if (algorithm && utils::signature::verify(*algorithm, certificate.publicKey, signatureBytes, block.signature)) {
+        signer = std::move(certificate);
+        break;
+      }
+    }
+    if (!signer) {
+      return addError(verification, "v1 signature of [" + signatureFile + "] does not verify");
+    }
+    verification.signers.push_back(ApkSignerCertificate{1, std::move(*signer)});
+
+    auto const signatureText = std::string_view(reinterpret_cast<char const *>(signatureBytes.data()), signatureBytes.size());
+    auto const mainSection = readJarSections(signatureText).front();
+    auto const apkSigned = mainSection.find(ANDROID_APK_SIGNED_ATTRIBUTE);
+    if (apkSigned != mainSection.end() && ((apkSigned->second.find('2') != std::string::npos && !hasV2) ||
+                                           (apkSigned->second.find('3') != std::string::npos && !hasV3))) {
+      return addError(verification, "v1 signature says the apk had a v2 or v3 signature that was stripped");
+    }
+    auto const manifestDigest = findJarDigest(mainSection, "-Digest-Manifest");
+    if (!manifestDigest || utils::sha::computeDigest(manifestDigest->first, manifestBytes) != manifestDigest->second) {
+      return addError(verification, "v1 digest of the manifest in [" + signatureFile + "] is missing or does not match");
+    }
+  }
+
+  if (!checkEntries) {
+    return true;
+  }
+  auto const manifestText = std::string_view(reinterpret_cast<char const *>(manifestBytes.data()), manifestBytes.size());
+  return verifyJarEntries(archive, readJarSections(manifestText), threadPool, verification);
+}
+
+auto findBlockValue(std::vector<ApkSigningBlockEntry> const &block, uint32_t const id) -> std::optional<std::span<std::byte const>> {
+  auto const entry = std::find_if(block.begin(), block.end(), [id](auto const &pair) { return pair.first == id; });
+  return entry == block.end() ? std::nullopt : std::optional(entry->second);
+}
+
+} // namespace
+
+auto ai::verifyApk(std::string const &apkPath, ApkVerifierOptions const &options, utils::ThreadPool &threadPool) -> ApkVerification {
+  auto verification = ApkVerification();
+  auto const apk = utils::MappedFile(apkPath);
+  auto const sections = findApkSections(apk.bytes());
+
+  auto signingBlock = std::vector<ApkSigningBlockEntry>();
+  try {
+    signingBlock = readApkSigningBlock(apk.bytes(), sections);
+  } catch (std::exception const &e) {
+    addError(verification, std::string("malformed signing block: ") + e.what());
+  }
+  auto const v2 = findBlockValue(signingBlock, APK_SIGNATURE_SCHEME_V2_BLOCK_ID);
+  auto const v3 = findBlockValue(signingBlock, APK_SIGNATURE_SCHEME_V3_BLOCK_ID);
+  LOGD("verifyApk, path [{}] v2 [{}] v3 [{}]", apkPath, v2.has_value(), v3.has_value());
+
+  auto v3Required = false;
+  if (v2 || v3) {
+    auto contentDigests = ContentDigests(apk.bytes(), sections, threadPool);
+    for (auto const &[scheme, block] : {std::make_pair(3u, v3), std::make_pair(2u, v2)}) {
+      if (!block) {
+        continue;
+      }
+      try {
+        if (verifySchemeBlock(scheme, *block, contentDigests, verification, v3Required)) {
+          verification.schemes.push_back(scheme);
+        }
+      } catch (std::exception const &e) {
+        addError(verification, "malformed v" + std::to_string(scheme) + " block: " + e.what());
+      }
+    }
+  }
+  if (v3Required && !v3) {
+    addError(verification, "v2 signature says the apk had a v3 signature that was stripped");
+  }
+
+  try {
+    auto const archive = ZipArchiver(apkPath);
+    auto const v1 = verifyJarSignature(archive, v2.has_value(), v3.has_value(), options.verifyJarDigests || (!v2 && !v3), threadPool, verification);
+    if (v1.value_or(false)) {
+      verification.schemes.push_back(1);
+    }
+  } catch (std::exception const &e) {
+    addError(verification, std::string("malformed v1 signature: ") + e.what());
+  }
+
+  if (verification.schemes.empty() && verification.errors.empty()) {
+    addError(verification, "apk is not signed");
+  }
+  std::sort(verification.schemes.begin(), verification.schemes.end());
+  verification.verified = verification.errors.empty();
+  return verification;
+}
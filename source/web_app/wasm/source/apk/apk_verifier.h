@@ -0,0 +1,86 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_APK_VERIFIER_H_
+#define ANDROID_INTROSPECTION_APK_APK_VERIFIER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils/signature.h"
+
+namespace ai {
+
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+struct ApkVerifierOptions {
+
+  //
+  // Checks the per entry digests of a v1 (JAR) signature even when a v2 or
+  // v3 signature covers the whole file.  Every entry is inflated for them,
+  // so this is many times slower than the v2 and v3 checks.
+  //
+  bool verifyJarDigests = false;
+};
+
+struct ApkSignerCertificate {
+
+  //
+  // Signature scheme the signer was found in: 1, 2 or 3.
+  //
+  uint32_t scheme;
+
+  utils::signature::CertificateInfo certificate;
+};
+
+struct ApkVerification {
+
+  bool verified = false;
+
+  //
+  // Schemes whose signatures were found and verified.
+  //
+  std::vector<uint32_t> schemes;
+
+  std::vector<ApkSignerCertificate> signers;
+
+  std::vector<std::string> errors;
+};
+
+//
+// Verifies the v3, v2 and v1 signatures of the APK at apkPath.  The APK
+// Signing Block is located through the end of central directory record and
+// the content digest is computed once, in 1 MB chunks on the workers of the
+// pool, for both v2 and v3.  The v1 signature file is always checked when
+// there is one; the digests of its entries only without a v2 or v3
+// signature or when asked to.  Problems are reported rather than thrown,
+// unless the file is not a zip archive.
+//
+auto verifyApk(std::string const &apkPath, ApkVerifierOptions const &options, utils::ThreadPool &threadPool) -> ApkVerification;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_APK_VERIFIER_H_ */
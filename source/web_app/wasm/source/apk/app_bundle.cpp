@@ -0,0 +1,207 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "apk/app_bundle.h"
+#include "proto/proto_resource_table.h"
+#include "proto_manifest_parser.h"
+#include "utils/format.h"
+#include "utils/log.h"
+#include "utils/sha.h"
+#include "zip_archiver.h"
+#include "zip_reader.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr std::string_view BASE_MODULE = "base";
+
+static constexpr std::string_view BUNDLE_EXTENSION = ".aab";
+
+static constexpr std::string_view MODULE_MANIFEST = "/manifest/AndroidManifest.xml";
+
+static constexpr std::string_view MODULE_RESOURCES = "/resources.pb";
+
+//
+// Bytes of an entry: a view of the mapped bundle when the entry is stored,
+// else the entry inflated once and kept.
+//
+struct BundleEntry {
+
+  std::vector<std::byte> inflated;
+
+  std::span<std::byte const> bytes;
+};
+
+} // namespace
+
+class AppBundle::AppBundleImpl final {
+public:
+  AppBundleImpl(std::string_view const bundlePath, std::shared_ptr<ZipReader const> reader)
+      : bundlePath_(bundlePath), reader_(std::move(reader)), archiver_(reader_ ? ZipArchiver(reader_) : ZipArchiver(bundlePath)), files_(archiver_.files()) {
+    for (auto const &file : files_) {
+      if (file.ends_with(MODULE_MANIFEST) && file.find('/') == file.size() - MODULE_MANIFEST.size()) {
+        modules_.push_back(file.substr(0, file.size() - MODULE_MANIFEST.size()));
+      }
+    }
+    if (modules_.empty()) {
+      throw std::logic_error("bundle does not contain any module");
+    }
+    std::stable_partition(modules_.begin(), modules_.end(), [](auto const &module) { return module == BASE_MODULE; });
+  }
+
+  auto getModules() const -> std::vector<std::string> { return modules_; }
+
+  auto getFiles() const -> std::vector<std::string> { return files_; }
+
+  auto getFileContent(std::string_view const filePath) const -> std::vector<std::byte> { return archiver_.extract(filePath); }
+
+  auto getAndroidManifest(std::string_view const module) const -> std::string {
+    auto const resources = findResources(module);
+    auto const table = resources ? std::optional(ProtoResourceTable(*resources)) : std::nullopt;
+    return getManifest(module).toStringXml(table ? &*table : nullptr);
+  }
+
+  auto getManifestComponents(std::string_view const module) const -> ManifestComponents { return getManifest(module).getComponents(); }
+
+  auto getProperties(ApkPropertyFields const fields) const -> std::map<std::string, std::string> {
+    auto const manifest = getManifest(BASE_MODULE);
+    if (!manifest.isValid()) {
+      return {{"valid", "false"}};
+    }
+    auto properties = std::map<std::string, std::string>{{"valid", "true"}};
+    auto const manifestProperties = manifest.getManifestProperties();
+    if (fields.contains(ApkPropertyField::Package)) {
+      properties.emplace("packageName", manifestProperties.packageName);
+    }
+    if (fields.contains(ApkPropertyField::Version)) {
+      properties.emplace("versionCode", manifestProperties.versionCode);
+      properties.emplace("versionName", manifestProperties.versionName);
+    }
+    if (fields.contains(ApkPropertyField::Debuggable)) {
+      properties.emplace("debuggable", manifestProperties.debuggable ? "true" : "false");
+    }
+    if (fields.contains(ApkPropertyField::Manifest)) {
+      properties.emplace("manifest", getAndroidManifest(BASE_MODULE));
+    }
+    if (fields.contains(ApkPropertyField::Sha256)) {
+      properties.emplace("sha256", reader_ ? utils::format::toHex(utils::sha::Sha256().update(*reader_->view()).finish())
+                                           : utils::sha::generateSha256ForFile(bundlePath_));
+    }
+    return properties;
+  }
+
+  auto getResourceValues(std::string_view const module) const -> std::map<std::string, std::string> {
+    auto const resources = findResources(module);
+    return resources ? ProtoResourceTable(*resources).getValues() : std::map<std::string, std::string>();
+  }
+
+private:
+  auto findModule(std::string_view const module) const -> std::string const & {
+    auto const found = std::find(modules_.cbegin(), modules_.cend(), module);
+    if (found == modules_.cend()) {
+      throw std::logic_error("module does not exist in bundle");
+    }
+    return *found;
+  }
+
+  auto getManifest(std::string_view const module) const -> ProtoManifestParser {
+    return ProtoManifestParser(*getEntry(findModule(module) + std::string(MODULE_MANIFEST)));
+  }
+
+  auto findResources(std::string_view const module) const -> std::optional<std::span<std::byte const>> {
+    return getEntry(findModule(module) + std::string(MODULE_RESOURCES));
+  }
+
+  //
+  // Entries are kept for the life of the bundle, so that the views handed
+  // out stay valid without holding the lock.
+  //
+  auto getEntry(std::string const &path) const -> std::optional<std::span<std::byte const>> {
+    auto const lock = std::lock_guard(entriesMutex_);
+    if (auto const entry = entries_.find(path); entry != entries_.cend()) {
+      return entry->second ? std::optional(entry->second->bytes) : std::nullopt;
+    }
+    if (!archiver_.contains(path)) {
+      entries_.emplace(path, nullptr);
+      return std::nullopt;
+    }
+    auto entry = std::make_unique<BundleEntry>();
+    if (auto const view = archiver_.view(path)) {
+      entry->bytes = *view;
+    } else {
+      LOGD("getEntry, inflating [{}]", path);
+      entry->inflated = archiver_.extract(path);
+      entry->bytes = entry->inflated;
+    }
+    return entries_.emplace(path, std::move(entry)).first->second->bytes;
+  }
+
+  std::string const bundlePath_;
+
+  //
+  // Reader of a bundle in memory, none for one on disk.
+  //
+  std::shared_ptr<ZipReader const> const reader_;
+
+  ZipArchiver const archiver_;
+
+  std::vector<std::string> const files_;
+
+  std::vector<std::string> modules_;
+
+  mutable std::mutex entriesMutex_;
+
+  mutable std::unordered_map<std::string, std::unique_ptr<BundleEntry>> entries_;
+};
+
+AppBundle::AppBundle(std::string_view bundlePath) : pimpl_(std::make_unique<AppBundleImpl>(bundlePath, nullptr)) {}
+
+AppBundle::AppBundle(std::vector<std::byte> contents)
+    : pimpl_(std::make_unique<AppBundleImpl>(std::string_view(), std::make_shared<MemoryZipReader const>(std::move(contents)))) {}
+
+auto AppBundle::isAppBundlePath(std::string_view const path) -> bool { return path.ends_with(BUNDLE_EXTENSION); }
+
+AppBundle::~AppBundle() = default;
+
+auto AppBundle::getModules() const -> std::vector<std::string> { return pimpl_->getModules(); }
+
+auto AppBundle::getFiles() const -> std::vector<std::string> { return pimpl_->getFiles(); }
+
+auto AppBundle::getFileContent(std::string_view filePath) const -> std::vector<std::byte> { return pimpl_->getFileContent(filePath); }
+
+auto AppBundle::getAndroidManifest(std::string_view module) const -> std::string { return pimpl_->getAndroidManifest(module); }
+
+auto AppBundle::getManifestComponents(std::string_view module) const -> ManifestComponents { return pimpl_->getManifestComponents(module); }
+
+auto AppBundle::getProperties(ApkPropertyFields fields) const -> std::map<std::string, std::string> { return pimpl_->getProperties(fields); }
+
+auto AppBundle::getResourceValues(std::string_view module) const -> std::map<std::string, std::string> { return pimpl_->getResourceValues(module); }
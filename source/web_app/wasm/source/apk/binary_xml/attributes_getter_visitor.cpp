@@ -32,7 +32,10 @@ AttributesGetterVisitor::AttributesGetterVisitor(std::vector<std::string> const
 auto AttributesGetterVisitor::visit(StartXmlTagElement const &element) -> void {
   currentElementPath_.push_back(element.tag());
   if (currentElementPath_ == elementPath_) {
-    elementAttributes_ = element.attributes();
+    elementAttributes_.clear();
+    for (auto const &[name, value] : element.attributes()) {
+      elementAttributes_.emplace(name, value);
+    }
   }
 }
 
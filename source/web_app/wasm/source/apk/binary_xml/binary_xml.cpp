@@ -21,19 +21,25 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
-#include <codecvt>
-#include <locale>
+#define LOG_MODULE LOG_MODULE_BINARY_XML
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
 
-#include "attributes_getter_visitor.h"
-#include "attributes_setter_visitor.h"
 #include "binary_xml.h"
 #include "binary_xml_visitor.h"
 #include "resource_types.h"
 #include "string_xml_visitor.h"
-#include "utils/data_stream.h"
+#include "utils/arena.h"
 #include "utils/log.h"
 #include "utils/macros.h"
+#include "utils/trace.h"
 #include "utils/utils.h"
+#include "xml_encoder.h"
+#include "xml_patch.h"
+#include "xml_traversal.h"
+#include "xml_tree_visitor.h"
 
 //
 // Implementation used the following resources.
@@ -60,323 +66,333 @@ namespace {
 
 using namespace ai;
 
-using ai::utils::formatString;
-
-using Bytes = std::vector<std::byte>;
-using Strings = std::vector<std::string>;
-using StringPairs = std::map<std::string, std::string>;
-using ElementPointers = std::vector<std::shared_ptr<BinaryXmlElement>>;
-
-struct TraverseContext {
-
-  TraverseContext(Bytes const &content, Strings const &strings) : contentStream_(DataStream(content)), strings_(strings) {}
+static constexpr char const *const ANDROID_NAMESPACE = "http://schemas.android.com/apk/res/android";
 
-  auto contentStream() -> DataStream & { return contentStream_; }
+static constexpr uint32_t NO_STRING = UINT32_MAX;
 
-  auto strings() -> Strings & { return strings_; }
+//
+// Adapts the templated traversal to the BinaryXmlVisitor interface.
+//
+struct BinaryXmlVisitorAdapter {
+
+  explicit BinaryXmlVisitorAdapter(BinaryXmlVisitor &visitor) : visitor(visitor) {}
+
+  auto onStartElement(XmlStartElement const &element) -> void {
+    auto attributes = StartXmlTagElement::Attributes(&arena);
+    for (auto const &attribute : element.attributes) {
+      auto const attributeName = attribute.name();
+      if (attributeName.empty()) {
+        LOGW("unexpected empty attribute name");
+        continue;
+      }
+      attributes[std::pmr::string(attributeName, &arena)] = attribute.value();
+    }
+    LOGI("start tag [{}] namespace [{}]", element.name(), element.nameSpace());
+    StartXmlTagElement(std::string(element.name()), std::string(element.nameSpace()), std::move(attributes)).accept(visitor);
+  }
 
-  auto elements() -> ElementPointers & { return elements_; }
+  auto onEndElement(XmlEndElement const &element) -> void {
+    LOGI("end tag [{}] namespace [{}]", element.name(), element.nameSpace());
+    EndXmlTagElement(std::string(element.name()), std::string(element.nameSpace())).accept(visitor);
+  }
 
-private:
-  DataStream contentStream_;
+  auto onCData(XmlCData const &cdata) -> void {
+    LOGI("cdata tag [{}]", cdata.data());
+    CDataTagElement(std::string(cdata.data())).accept(visitor);
+  }
 
-  Strings strings_;
+  BinaryXmlVisitor &visitor;
 
-  ElementPointers elements_;
+  utils::Arena arena;
 };
 
-auto handleAttributes(DataStream &contentStream, Strings const &strings) {
-  StringPairs attributes;
-  auto const attributeMarker = contentStream.read<uint32_t>();
-  if (attributeMarker != XML_ATTRS_MARKER) {
-    LOGW("unexpected attributes marker");
-    return attributes;
-  }
-
-  auto const attributesCount = contentStream.read<uint32_t>();
-  contentStream.skip(sizeof(uint32_t));
+} // namespace
 
-  for (auto i{0U}; i < attributesCount; i++) {
-    auto const attributeNamespaceIndex = contentStream.read<uint32_t>();
-    auto const attributeNameIndex = contentStream.read<uint32_t>();
-    auto const attributeValueIndex = contentStream.read<uint32_t>();
+BinaryXml::BinaryXml(std::vector<std::byte> const &bytes) : content_(std::make_unique<BinaryXmlContent>()) {
+  content_->bytes = bytes;
+  decode();
+}
 
-    utils::ignore(attributeNamespaceIndex);
+auto BinaryXml::decode() -> void {
+  TRACE_SPAN("BinaryXml::decode");
+  content_->header = getXmlHeader();
+  content_->utf8Encoded = isStringsUtf8Encoded();
+  content_->strings = getStrings();
+  content_->resourceIds = getXmlResourceIds(content_->bytes);
+  content_->elements.reset();
+}
 
-    contentStream.skip(sizeof(uint16_t));
-    contentStream.skip(sizeof(uint8_t));
+auto BinaryXml::hasElement(std::string_view elementTag) const -> bool {
+  return content_->strings.contains(elementTag);
+}
 
-    auto const attributeValueType = contentStream.read<uint8_t>();
-    auto const attributeResourceId = contentStream.read<uint32_t>();
+auto BinaryXml::getElementAttributes(std::vector<std::string> elementPath) const -> ElementAttributes {
+  return std::move(getElementAttributes(std::span<ElementPath const>(&elementPath, 1)).front());
+}
 
-    auto attributeName = strings[attributeNameIndex];
-    if (attributeName.empty()) {
-      LOGW("unexpected empty attribute name");
+auto BinaryXml::getElementAttributes(std::span<ElementPath const> elementPaths) const -> std::vector<ElementAttributes> {
+  auto const &elements = elementIndex();
+  auto const &strings = content_->strings;
+  auto const foundElements = findElements(elementPaths);
+  auto elementsAttributes = std::vector<ElementAttributes>(elementPaths.size());
+  for (size_t i{0}; i < elementPaths.size(); i++) {
+    auto const element = foundElements[i];
+    if (!element) {
       continue;
     }
-    std::string attributeValue;
-    switch (attributeValueType) {
-    case TYPE_NULL: {
-      attributeValue = attributeResourceId == 0 ? "<undefined>" : "<empty>";
-      break;
-    }
-    case TYPE_REFERENCE: {
-      attributeValue = formatString("@res/0x%08X", attributeResourceId);
-      break;
-    }
-    case TYPE_ATTRIBUTE: {
-      attributeValue = formatString("@attr/0x%08X", attributeResourceId);
-      break;
-    }
-    case TYPE_STRING: {
-      attributeValue = strings[attributeValueIndex];
-      break;
-    }
-    case TYPE_FLOAT: {
-      break;
-    }
-    case TYPE_DIMENSION: {
-      break;
-    }
-    case TYPE_FRACTION: {
-      break;
-    }
-    case TYPE_DYNAMIC_REFERENCE: {
-      attributeValue = formatString("@dyn/0x%08X", attributeResourceId);
-      break;
-    }
-    case TYPE_INT_DEC: {
-      attributeValue = formatString("%d", attributeResourceId);
-      break;
-    }
-    case TYPE_INT_HEX: {
-      attributeValue = formatString("0x%08X", attributeResourceId);
-      break;
-    }
-    case TYPE_INT_BOOLEAN: {
-      attributeValue = attributeResourceId == RES_VALUE_TRUE ? "true" : attributeResourceId == RES_VALUE_FALSE ? "false" : "unknown";
-      break;
-    }
-    default: {
-      attributeValue = "unknown";
-      break;
-    }
+    auto &elementAttributes = elementsAttributes[i];
+    auto const firstAttribute = elements.firstAttributes[*element];
+    for (auto attribute = firstAttribute; attribute < firstAttribute + elements.attributeCounts[*element]; attribute++) {
+      auto const attributeName = strings[elements.attributeNames[attribute]];
+      if (attributeName.empty()) {
+        LOGW("unexpected empty attribute name");
+        continue;
+      }
+      elementAttributes[std::string(attributeName)] =
+          formatAttributeValue(elements.attributeTypes[attribute], elements.attributeData[attribute], elements.attributeRawValues[attribute], strings);
     }
-    LOGI("  attribute value [{}]", attributeValue.c_str());
-    attributes[attributeName] = attributeValue;
   }
-  return attributes;
+  return elementsAttributes;
 }
 
-auto handleStartElementTag(TraverseContext &context, BinaryXmlVisitor &visitor) {
-  auto &contentStream = context.contentStream();
-  auto const &strings = context.strings();
-
-  contentStream.skip(sizeof(uint32_t));
-  contentStream.skip(sizeof(uint32_t));
-
-  auto const namespaceStringIndex = contentStream.read<int32_t>();
-  auto const namespaceString = namespaceStringIndex >= 0 ? strings[static_cast<uint32_t>(namespaceStringIndex)] : "";
-
-  auto const stringIndex = contentStream.read<int32_t>();
-  auto const string = stringIndex >= 0 ? strings[static_cast<uint32_t>(stringIndex)] : "";
-
-  auto const attributes = handleAttributes(contentStream, strings);
-
-  LOGI("start tag [{}] namespace [{}]", string.c_str(), namespaceString.c_str());
-
-  auto element = std::make_shared<StartXmlTagElement>(string, namespaceString, attributes);
-  element->accept(visitor);
-  context.elements().push_back(element);
+auto BinaryXml::findElements(std::span<ElementPath const> const elementPaths) const -> std::vector<std::optional<uint32_t>> {
+  auto const &elements = elementIndex();
+  auto foundElements = std::vector<std::optional<uint32_t>>();
+  foundElements.reserve(elementPaths.size());
+  for (auto const &elementPath : elementPaths) {
+    foundElements.push_back(elements.find(elementPath, content_->strings));
+  }
+  return foundElements;
 }
 
-auto handleEndElementTag(TraverseContext &context, BinaryXmlVisitor &visitor) {
-  auto &contentStream = context.contentStream();
-  auto const &strings = context.strings();
-
-  contentStream.skip(sizeof(uint32_t));
-  contentStream.skip(sizeof(uint32_t));
-
-  auto const namespaceStringIndex = contentStream.read<int32_t>();
-  auto const namespaceString = namespaceStringIndex >= 0 ? strings[static_cast<uint32_t>(namespaceStringIndex)] : "";
-
-  auto const stringIndex = contentStream.read<int32_t>();
-  auto const string = stringIndex >= 0 ? strings[static_cast<uint32_t>(stringIndex)] : "";
+auto BinaryXml::getElementAttribute(std::span<std::string const> const elementPath, uint32_t const attributeResourceId) const -> std::optional<std::string> {
+  auto const &elements = elementIndex();
+  auto const element = elements.find(elementPath, content_->strings);
+  if (!element) {
+    return std::nullopt;
+  }
+  auto const attribute = elements.findAttribute(*element, attributeResourceId);
+  if (!attribute) {
+    return std::nullopt;
+  }
+  return formatAttributeValue(elements.attributeTypes[*attribute], elements.attributeData[*attribute], elements.attributeRawValues[*attribute],
+                              content_->strings);
+}
 
-  LOGI("end tag [{}] namespace [{}]", string.c_str(), namespaceString.c_str());
+auto BinaryXml::hasResourceIds() const -> bool {
+  return std::any_of(content_->resourceIds.begin(), content_->resourceIds.end(), [](uint32_t const resourceId) { return resourceId != 0; });
+}
 
-  auto element = std::make_shared<EndXmlTagElement>(string, namespaceString);
-  element->accept(visitor);
-  context.elements().pop_back();
+auto BinaryXml::elementIndex() const -> ElementIndex const & {
+  auto const lock = std::lock_guard(content_->cacheMutex);
+  if (!content_->elements) {
+    TRACE_SPAN("BinaryXml::elementIndex");
+    content_->elements = std::make_unique<ElementIndex>(
+        ElementIndex::build(content_->bytes, getXmlChunkOffset(), content_->strings, content_->resourceIds, &content_->arena));
+  }
+  return *content_->elements;
 }
 
-auto handleCDataTag(TraverseContext &context, BinaryXmlVisitor &visitor) {
-  auto &contentStream = context.contentStream();
-  auto const &strings = context.strings();
+auto BinaryXml::getString(uint32_t const stringIndex) const -> std::string_view {
+  return stringIndex < content_->strings.size() ? content_->strings[stringIndex] : std::string_view();
+}
 
-  contentStream.skip(sizeof(uint32_t));
-  contentStream.skip(sizeof(uint32_t));
+auto BinaryXml::getAttributeValue(uint32_t const attribute) const -> std::string {
+  auto const &elements = elementIndex();
+  return formatAttributeValue(elements.attributeTypes[attribute], elements.attributeData[attribute], elements.attributeRawValues[attribute],
+                              content_->strings);
+}
 
-  auto const stringIndex = contentStream.read<uint32_t>();
-  auto const string = strings[stringIndex];
+auto BinaryXml::setElementAttribute(std::vector<std::string> elementPath, std::string_view attributeName, std::string_view attributeValue,
+                                    uint32_t const attributeResourceId) -> void {
+  auto const element = elementIndex().find(elementPath, content_->strings);
+  if (!element) {
+    throw std::logic_error("unable to set attribute; element not found");
+  }
 
-  contentStream.skip(sizeof(uint32_t));
-  contentStream.skip(sizeof(uint32_t));
+  auto existingAttribute = elementIndex().findAttribute(*element, attributeResourceId);
+  if (!existingAttribute) {
+    auto const &elements = elementIndex();
+    auto const firstAttribute = elements.firstAttributes[*element];
+    for (auto attribute = firstAttribute; attribute < firstAttribute + elements.attributeCounts[*element]; attribute++) {
+      if ((attributeResourceId == 0 || elements.attributeResourceIds[attribute] == 0) && content_->strings[elements.attributeNames[attribute]] == attributeName) {
+        existingAttribute = attribute;
+      }
+    }
+  }
 
-  LOGI("cdata tag [{}]", string.c_str());
+  //
+  // Strings the value needs are added first, since that moves the chunks
+  // the element index points at.
+  //
+  auto const currentType = existingAttribute ? elementIndex().attributeTypes[*existingAttribute] : uint8_t{TYPE_NULL};
+  auto typedValue = parseXmlTypedValue(attributeValue, currentType);
+  if (!typedValue) {
+    auto const stringIndex = getStringIndex(attributeValue, 0);
+    typedValue = XmlTypedValue{TYPE_STRING, stringIndex, stringIndex};
+  }
+  if (existingAttribute) {
+    LOGD("setElementAttribute, patching [{}] in place", attributeName);
+    patchXmlAttributeValue(content_->bytes, elementIndex().attributeOffsets[*existingAttribute], *typedValue);
+    decode();
+    rerenderElement(*element);
+    return;
+  }
 
-  auto element = std::make_shared<CDataTagElement>(string);
-  element->accept(visitor);
+  auto const nameIndex = getStringIndex(attributeName, attributeResourceId);
+  auto const namespaceIndex = attributeResourceId != 0 ? getStringIndex(ANDROID_NAMESPACE, 0) : NO_STRING;
+
+  //
+  // Attributes are kept ordered by resource id, with attributes without one
+  // last, as the platform looks them up in that order.
+  //
+  auto const &elements = elementIndex();
+  auto const firstAttribute = elements.firstAttributes[*element];
+  auto position = uint16_t{0};
+  for (; attributeResourceId != 0 && position < elements.attributeCounts[*element]; position++) {
+    auto const resourceId = elements.attributeResourceIds[firstAttribute + position];
+    if (resourceId == 0 || resourceId > attributeResourceId) {
+      break;
+    }
+  }
+  if (attributeResourceId == 0) {
+    position = elements.attributeCounts[*element];
+  }
+  LOGD("setElementAttribute, inserting [{}] at [{}]", attributeName, position);
+  insertXmlAttribute(content_->bytes, elements.chunkOffsets[*element], position, XmlAttributeRecord{namespaceIndex, nameIndex, *typedValue});
+  decode();
+  rerenderElement(*element);
 }
 
-} // namespace
-
-BinaryXml::BinaryXml(std::vector<std::byte> const &bytes) : content_(std::make_unique<BinaryXmlContent>()) {
-  content_->bytes = bytes;
-  content_->header = getXmlHeader();
-  content_->strings = getStrings();
-  content_->offsets = getStringOffsets();
-  content_->utf8Encoded = isStringsUtf8Encoded();
+auto BinaryXml::rerenderElement(uint32_t const element) -> void {
+  auto &rendered = content_->rendered;
+  if (!rendered) {
+    return;
+  }
+  TRACE_SPAN("BinaryXml::rerenderElement");
+  auto &tags = rendered->tags;
+  if (element >= tags.size()) {
+    rendered.reset();
+    return;
+  }
+  auto const &bytes = content_->bytes;
+  auto const chunkOffset = elementIndex().chunkOffsets[element];
+  auto const startElement = readXmlStartElement(bytes, chunkOffset, readXmlChunk(bytes, chunkOffset), content_->strings);
+  auto const tag = StringXmlVisitor::renderStartTag(startElement, tags[element], rendered->resolver);
+  rendered->xml.replace(tags[element].offset, tags[element].size, tag);
+  auto const delta = static_cast<std::ptrdiff_t>(tag.size()) - static_cast<std::ptrdiff_t>(tags[element].size);
+  tags[element].size = tag.size();
+  for (auto i = std::size_t{element} + 1; i < tags.size(); i++) {
+    tags[i].offset = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(tags[i].offset) + delta);
+  }
+  LOGD("rerenderElement, element [{}] now [{}] bytes", element, tag.size());
 }
 
-auto BinaryXml::hasElement(std::string_view elementTag) const -> bool {
-  auto const strings = getStrings();
-  return std::find(strings.cbegin(), strings.cend(), elementTag) != strings.end();
+auto BinaryXml::toStringXml(ResourceResolver *const resolver) const -> std::string {
+  auto const lock = std::lock_guard(content_->cacheMutex);
+  auto const &rendered = content_->rendered;
+  if (rendered && rendered->resolver == resolver) {
+    return rendered->xml;
+  }
+  return render(resolver, {}).xml;
 }
 
-auto BinaryXml::getElementAttributes(std::vector<std::string> elementPath) const -> ElementAttributes {
-  ElementAttributes elementAttributes;
-  auto visitor = AttributesGetterVisitor(elementPath, elementAttributes);
-  traverseXml(visitor);
-  return elementAttributes;
+auto BinaryXml::toStringXml(std::function<void(std::string_view)> flush, ResourceResolver *const resolver) const -> void {
+  auto const lock = std::lock_guard(content_->cacheMutex);
+  auto const &rendered = content_->rendered;
+  if (!rendered || rendered->resolver != resolver) {
+    render(resolver, flush);
+    return;
+  }
+  //
+  // Pieces end at line breaks, which never split a character.
+  //
+  auto const xml = std::string_view(rendered->xml);
+  for (auto offset = std::size_t{0}; offset < xml.size();) {
+    auto end = std::min(offset + StringXmlVisitor::FLUSH_SIZE, xml.size());
+    if (auto const lineBreak = xml.rfind('\n', end); end < xml.size() && lineBreak != std::string_view::npos && lineBreak > offset) {
+      end = lineBreak;
+    }
+    flush(xml.substr(offset, end - offset));
+    offset = end;
+  }
 }
 
-auto BinaryXml::setElementAttribute(std::vector<std::string> elementPath, std::string_view attributeName, std::string_view attributeValue) const -> void {
-  auto visitor = AttributesSetterVisitor(elementPath, attributeName, attributeValue);
-  traverseXml(visitor);
+auto BinaryXml::render(ResourceResolver *const resolver, StringXmlVisitor::FlushCallback const &flush) const -> RenderedXml const & {
+  TRACE_SPAN("BinaryXml::toStringXml");
+  auto rendered = RenderedXml();
+  rendered.resolver = resolver;
+  auto const capacity = StringXmlVisitor::estimateSize(content_->bytes.size());
+  auto buffer = std::string();
+  auto visitor = flush ? StringXmlVisitor(buffer, content_->utf8Encoded, capacity,
+                                          [&rendered, &flush](std::string_view const chunk) {
+                                            rendered.xml += chunk;
+                                            flush(chunk);
+                                          },
+                                          resolver)
+                       : StringXmlVisitor(rendered.xml, content_->utf8Encoded, capacity, {}, resolver);
+  if (flush) {
+    rendered.xml.reserve(capacity);
+  }
+  visitor.recordTags(rendered.tags);
+  ai::traverseXml(content_->bytes, getXmlChunkOffset(), content_->strings, visitor);
+  visitor.finish();
+  return content_->rendered.emplace(std::move(rendered));
 }
 
-auto BinaryXml::toStringXml() const -> std::string {
-  std::string xml;
-  auto visitor = StringXmlVisitor(xml, isStringsUtf8Encoded());
-  traverseXml(visitor);
-  return xml;
+auto BinaryXml::toXmlTree(ResourceResolver *const resolver) const -> std::string {
+  TRACE_SPAN("BinaryXml::toXmlTree");
+  auto json = std::string();
+  json.reserve(StringXmlVisitor::estimateSize(content_->bytes.size()));
+  auto visitor = XmlTreeVisitor(json, resolver);
+  ai::traverseXml(content_->bytes, getXmlChunkOffset(), content_->strings, visitor);
+  visitor.finish();
+  return json;
 }
 
 auto BinaryXml::toBinaryXml() const -> std::vector<std::byte> {
-  return content_->bytes;
+  TRACE_SPAN("BinaryXml::toBinaryXml");
+  return encodeXml(content_->bytes, content_->strings);
 }
 
-auto BinaryXml::getXmlHeader() const -> BinaryXmlHeader const * {
-  auto xmlHeader = reinterpret_cast<BinaryXmlHeader const *>(content_->bytes.data());
-  if (xmlHeader->magicNumber != XML_IDENTIFIER) {
+auto BinaryXml::getStringIndex(std::string_view const string, uint32_t const resourceId) -> uint32_t {
+  auto const &strings = content_->strings;
+  auto const &resourceIds = content_->resourceIds;
+  for (auto i{0U}; i < strings.size(); i++) {
+    if (strings[i] == string && (resourceId == 0 || (i < resourceIds.size() && resourceIds[i] == resourceId))) {
+      return i;
+    }
+  }
+  auto const stringIndex = appendXmlString(content_->bytes, string, resourceId);
+  decode();
+  return stringIndex;
+}
+
+auto BinaryXml::getXmlHeader() const -> BinaryXmlHeader {
+  auto const xmlHeader = readResStruct<BinaryXmlHeader>(content_->bytes, 0, "invalid xml header; truncated header");
+  if (xmlHeader.document.type != RES_XML_TYPE || xmlHeader.document.headerSize != sizeof(ResChunkHeader)) {
     throw std::logic_error("invalid xml header; missing xml identifier");
   }
-  if (xmlHeader->stringTableIdentifier != XML_STRING_TABLE) {
+  if (xmlHeader.strings.header.type != RES_STRING_POOL_TYPE) {
     throw std::logic_error("invalid xml header; missing xml string table");
   }
   return xmlHeader;
 }
 
-auto BinaryXml::getStringOffsets() const -> std::vector<std::uint32_t> {
-  auto stringOffsets = std::vector<uint32_t>();
-  auto stream = DataStream(content_->bytes);
-  stream.skip(sizeof(BinaryXmlHeader));
-  for (size_t i{0}; i < content_->header->numStrings; i++) {
-    auto const offset = stream.read<uint32_t>();
-    stringOffsets.push_back(offset);
-  }
-  return stringOffsets;
-}
-
-auto BinaryXml::isStringsUtf8Encoded() const -> bool {
-  auto const xmlHeader = content_->header;
-  return (xmlHeader->flags & RES_FLAG_UTF8) == RES_FLAG_UTF8;
-}
+auto BinaryXml::isStringsUtf8Encoded() const -> bool { return (content_->header.strings.flags & RES_FLAG_UTF8) == RES_FLAG_UTF8; }
 
-auto BinaryXml::getStrings() const -> Strings {
-  auto const stringOffsets = getStringOffsets();
-  auto const stringOffsetsInBytes = stringOffsets.size() * sizeof(decltype(stringOffsets)::value_type);
-  auto const startStringsOffset = static_cast<uint32_t>(sizeof(BinaryXmlHeader) + stringOffsetsInBytes);
-  auto const isUtf8Encoded = isStringsUtf8Encoded();
-  auto contentStream = DataStream(content_->bytes);
-
-  std::vector<std::string> strings;
-  for (auto const &offset : stringOffsets) {
-    if (isUtf8Encoded) {
-      contentStream.reset();
-      contentStream.skip(startStringsOffset + offset);
-
-      auto stringLength = contentStream.read<uint8_t>();
-      auto stringOffset = reinterpret_cast<const char *>(content_->bytes.data() + startStringsOffset + offset + 2);
-      auto string = std::string(stringOffset, stringLength);
-      strings.push_back(string);
-    } else {
-      contentStream.reset();
-      contentStream.skip(startStringsOffset + offset);
-
-      auto stringLength = contentStream.read<uint16_t>();
-      auto stringOffset = reinterpret_cast<const char16_t *>(content_->bytes.data() + startStringsOffset + offset + 2);
-      auto string = std::u16string(stringOffset, stringLength);
-      std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> converter;
-      strings.push_back(converter.to_bytes(string));
-    }
-  }
-  return strings;
+auto BinaryXml::getStrings() const -> StringPool {
+  return StringPool::read(std::span<std::byte const>(content_->bytes).subspan(sizeof(ResChunkHeader)));
 }
 
 auto BinaryXml::getXmlChunkOffset() const -> uint64_t {
-  auto const &bytes = content_->bytes;
-  auto const &header = content_->header;
-  if (bytes.size() <= header->chunkSize) {
+  auto const xmlChunkOffset = sizeof(ResChunkHeader) + uint64_t{content_->header.strings.header.size};
+  if (content_->bytes.size() < xmlChunkOffset) {
     throw std::logic_error("unable to get chunk size; missing string marker");
   }
-  return bytes.size() - (bytes.size() - header->chunkSize);
+  return xmlChunkOffset;
 }
 
 auto BinaryXml::traverseXml(BinaryXmlVisitor &visitor) const -> void {
-  auto const xmlChunkOffset = getXmlChunkOffset();
-  if (xmlChunkOffset == 0) {
-    InvalidXmlTagElement("chunk offset is zero").accept(visitor);
-    return;
-  }
-
-  auto context = TraverseContext(content_->bytes, getStrings());
-  auto &contentStream = context.contentStream();
-  contentStream.skip(static_cast<uint32_t>(xmlChunkOffset));
-
-  for (auto tag = contentStream.read<uint16_t>(); tag != RES_XML_END_NAMESPACE_TYPE; tag = contentStream.read<uint16_t>()) {
-    auto const headerSize = contentStream.read<uint16_t>();
-    auto const chunkSize = contentStream.read<uint32_t>();
-
-    LOGV("traverseXml: tag = [{:d}], headerSize = [{:d}], chunkSize = [{:d}]", tag, headerSize, chunkSize);
-
-    utils::ignore(headerSize);
-
-    switch (tag) {
-    case RES_XML_START_NAMESPACE_TYPE: {
-      contentStream.skip(chunkSize - 8);
-      break;
-    }
-    case RES_XML_RESOURCE_MAP_TYPE: {
-      contentStream.skip(chunkSize - 8);
-      break;
-    }
-    case RES_XML_START_ELEMENT_TYPE: {
-      handleStartElementTag(context, visitor);
-      break;
-    }
-    case RES_XML_END_ELEMENT_TYPE: {
-      handleEndElementTag(context, visitor);
-      break;
-    }
-    case RES_XML_CDATA_TYPE: {
-      handleCDataTag(context, visitor);
-      break;
-    }
-    default: {
-      LOGW("traverseXml: skipping unknown tag [{}]", tag);
-    }
-    }
-  }
+  ai::traverseXml(content_->bytes, getXmlChunkOffset(), content_->strings, BinaryXmlVisitorAdapter{visitor});
 }
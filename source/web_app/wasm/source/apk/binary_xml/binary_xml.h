@@ -25,77 +25,217 @@
 #define ANDROID_INTROSPECTION_APK_BINARY_XML_H_
 
 #include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "binary_xml_visitor.h"
+#include "element_index.h"
+#include "resource_resolver.h"
+#include "resource_structs.h"
+#include "string_pool.h"
+#include "string_xml_visitor.h"
+#include "utils/arena.h"
 
 namespace ai {
 
+//
+// A binary xml document.  Const calls can be made from several threads at
+// once, as the element index and the kept rendering are built under a lock;
+// edits need the document to themselves.
+//
 class BinaryXml {
 public:
   using ElementAttributes = std::map<std::string, std::string>;
 
+  using ElementPath = std::vector<std::string>;
+
   explicit BinaryXml(std::vector<std::byte> const &bytes);
 
   auto hasElement(std::string_view elementTag) const -> bool;
 
   auto getElementAttributes(std::vector<std::string> elementPath) const -> ElementAttributes;
 
-  auto setElementAttribute(std::vector<std::string> elementPath, std::string_view attributeName, std::string_view attributeValue) const -> void;
+  //
+  // Resolves all paths against a single parse of the document; attributes
+  // are returned in the order of the paths, empty for paths not found.
+  //
+  auto getElementAttributes(std::span<ElementPath const> elementPaths) const -> std::vector<ElementAttributes>;
+
+  //
+  // Elements of the element index at the paths, in the order of the paths,
+  // empty for paths not found.  The batch queries by path resolve through
+  // this; callers that match attributes by resource id use it directly.
+  //
+  auto findElements(std::span<ElementPath const> elementPaths) const -> std::vector<std::optional<uint32_t>>;
+
+  //
+  // Value of the attribute of the element at the path whose name maps to the
+  // resource id (e.g. android.R.attr.debuggable) in the resource map.  Empty
+  // when the element, the attribute or the resource map is missing.
+  //
+  auto getElementAttribute(std::span<std::string const> elementPath, uint32_t attributeResourceId) const -> std::optional<std::string>;
+
+  //
+  // Whether the resource map gives any attribute name a resource id, i.e.
+  // whether getElementAttribute() by id can find anything.
+  //
+  auto hasResourceIds() const -> bool;
+
+  //
+  // Sets an attribute of the element at the path.  An existing attribute,
+  // matched by resource id when one is given and by name otherwise, has
+  // its typed value rewritten in place; otherwise the attribute is spliced
+  // into the element, in the android namespace if it has a resource id.
+  // Strings missing from the pool are appended to it.
+  //
+  auto setElementAttribute(std::vector<std::string> elementPath, std::string_view attributeName, std::string_view attributeValue,
+                           uint32_t attributeResourceId = 0) -> void;
+
+  //
+  // Renders the document as xml text.  With a resolver, references are
+  // written by resource name instead of id.  The text is kept, so that
+  // rendering again with the same resolver returns it as is, and edits by
+  // setElementAttribute() only rewrite the start tag of the element; the
+  // resolver has to outlive the document for that.
+  //
+  auto toStringXml(ResourceResolver *resolver = nullptr) const -> std::string;
+
+  //
+  // Renders the document in pieces of about StringXmlVisitor::FLUSH_SIZE
+  // bytes, handing each to flush as soon as it is complete.  Pieces of the
+  // kept text are handed out instead when there is one.  Other threads wait
+  // for the rendering meanwhile, so flush must not call the document.
+  //
+  auto toStringXml(std::function<void(std::string_view)> flush, ResourceResolver *resolver = nullptr) const -> void;
+
+  //
+  // Renders the document as the JSON tree of XmlTreeVisitor, with the same
+  // attributes and values as the text.
+  //
+  auto toXmlTree(ResourceResolver *resolver = nullptr) const -> std::string;
+
+  //
+  // Encodes the document with a compacted string pool, see encodeXml().
+  //
+  auto toBinaryXml() const -> std::vector<std::byte>;
 
-  auto toStringXml() const -> std::string;
+  //
+  // Flat table of all elements, built on first use and shared by all path
+  // queries afterwards.
+  //
+  auto elementIndex() const -> ElementIndex const &;
 
-  auto toBinaryXml() const -> std::vector<std::byte>;
+  //
+  // String of the pool by index, as names of the element index are; empty
+  // out of range.
+  //
+  auto getString(uint32_t stringIndex) const -> std::string_view;
+
+  //
+  // Value of attribute i of the element index as text, as queries by path
+  // return it.
+  //
+  auto getAttributeValue(uint32_t attribute) const -> std::string;
 
 private:
+  //
+  // ResXMLTree_header directly followed by the string pool header.
+  //
   struct BinaryXmlHeader {
 
-    uint32_t magicNumber;
+    ResChunkHeader document;
 
-    uint32_t reservedBytes;
+    ResStringPoolHeader strings;
+  };
 
-    uint16_t stringTableIdentifier;
+  struct RenderedXml {
 
-    uint16_t headerSize;
+    ResourceResolver *resolver;
 
-    uint32_t chunkSize;
+    std::string xml;
 
-    uint32_t numStrings;
+    //
+    // Start tag of every element, indexed as the element index is.
+    //
+    std::vector<XmlTagRange> tags;
+  };
 
-    uint32_t numStyles;
+  struct BinaryXmlContent {
 
-    uint32_t flags;
+    //
+    // Backs the element index, so that rebuilding it after an edit reuses
+    // the memory of the previous one; freed with the document.
+    //
+    utils::Arena arena;
 
-    uint32_t stringsOffset;
+    BinaryXmlHeader header;
 
-    uint32_t stylesOffset;
-  };
+    std::vector<std::byte> bytes;
 
-  struct BinaryXmlContent {
+    StringPool strings;
 
-    BinaryXmlHeader const *header;
+    //
+    // Resource map, indexed by string.
+    //
+    std::vector<uint32_t> resourceIds;
 
-    std::vector<std::byte> bytes;
+    std::unique_ptr<ElementIndex> elements;
 
-    std::vector<std::string> strings;
+    //
+    // Last rendering of the document.  Edits keep it in step rather than
+    // dropping it, since they neither add nor remove elements.
+    //
+    std::optional<RenderedXml> rendered;
 
-    std::vector<uint32_t> offsets;
+    //
+    // Held while elements or rendered is built or read.
+    //
+    std::mutex cacheMutex;
 
     bool utf8Encoded;
   };
 
   auto traverseXml(BinaryXmlVisitor &visitor) const -> void;
 
-  auto getXmlHeader() const -> BinaryXmlHeader const *;
+  //
+  // Renders the whole document into content_->rendered, handing the text
+  // to flush as it goes if given; content_->cacheMutex is held.
+  //
+  auto render(ResourceResolver *resolver, StringXmlVisitor::FlushCallback const &flush) const -> RenderedXml const &;
 
-  auto getXmlChunkOffset() const -> uint64_t;
+  //
+  // Splices the start tag of the element, as it reads after an edit, into
+  // the kept rendering.
+  //
+  auto rerenderElement(uint32_t element) -> void;
 
-  auto getStrings() const -> std::vector<std::string>;
+  //
+  // (Re)builds the views of content_ into its bytes, after construction and
+  // after every edit.
+  //
+  auto decode() -> void;
+
+  //
+  // Returns the index of the string, appending it if the pool lacks it.
+  //
+  auto getStringIndex(std::string_view string, uint32_t resourceId) -> uint32_t;
+
+  auto getXmlHeader() const -> BinaryXmlHeader;
+
+  auto getXmlChunkOffset() const -> uint64_t;
 
-  auto getStringOffsets() const -> std::vector<std::uint32_t>;
+  //
+  // Indexes the string pool from its own header, so its styles are skipped
+  // and its strings bounded by the chunk.  Only called by decode(); traversals
+  // and queries share the pool in content_.
+  //
+  auto getStrings() const -> StringPool;
 
   auto isStringsUtf8Encoded() const -> bool;
 
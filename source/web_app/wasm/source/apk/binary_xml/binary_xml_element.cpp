@@ -30,9 +30,9 @@ BinaryXmlElement::~BinaryXmlElement() = default;
 
 auto StartXmlTagElement::tag() const -> std::string { return tag_; }
 
-auto StartXmlTagElement::nameSpace() const -> std::string { return nameSpace_; }
+auto StartXmlTagElement::nameSpace() const -> std::string const & { return nameSpace_; }
 
-auto StartXmlTagElement::attributes() const -> std::map<std::string, std::string> { return attributes_; }
+auto StartXmlTagElement::attributes() const -> Attributes const & { return attributes_; }
 
 auto StartXmlTagElement::accept(BinaryXmlVisitor &visitor) const -> void { visitor.visit(*this); }
 
@@ -40,7 +40,7 @@ StartXmlTagElement::~StartXmlTagElement() = default;
 
 auto EndXmlTagElement::tag() const -> std::string { return tag_; }
 
-auto EndXmlTagElement::nameSpace() const -> std::string { return nameSpace_; }
+auto EndXmlTagElement::nameSpace() const -> std::string const & { return nameSpace_; }
 
 auto EndXmlTagElement::accept(BinaryXmlVisitor &visitor) const -> void { visitor.visit(*this); }
 
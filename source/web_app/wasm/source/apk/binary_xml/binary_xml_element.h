@@ -25,7 +25,9 @@
 #define ANDROID_INTROSPECTION_APK_BINARY_XML_ELEMENT_H_
 
 #include <map>
+#include <memory_resource>
 #include <string>
+#include <utility>
 
 namespace ai {
 
@@ -39,23 +41,31 @@ public:
 };
 
 class StartXmlTagElement final : public BinaryXmlElement {
+public:
+  //
+  // Allocated from the arena of the traversal, which recycles the nodes of
+  // one element for the next.
+  //
+  using Attributes = std::pmr::map<std::pmr::string, std::pmr::string>;
+
+private:
   std::string const tag_;
 
   std::string const nameSpace_;
 
-  std::map<std::string, std::string> attributes_;
+  Attributes attributes_;
 
 public:
-  StartXmlTagElement(std::string const tag, std::string const nameSpace, std::map<std::string, std::string> attributes)
-      : tag_(tag), nameSpace_(nameSpace), attributes_(attributes) {}
+  StartXmlTagElement(std::string tag, std::string nameSpace, Attributes attributes)
+      : tag_(std::move(tag)), nameSpace_(std::move(nameSpace)), attributes_(std::move(attributes)) {}
 
   ~StartXmlTagElement() override;
 
   auto tag() const -> std::string override;
 
-  auto nameSpace() const -> std::string;
+  auto nameSpace() const -> std::string const &;
 
-  auto attributes() const -> std::map<std::string, std::string>;
+  auto attributes() const -> Attributes const &;
 
   auto accept(BinaryXmlVisitor &visitor) const -> void;
 };
@@ -67,13 +77,13 @@ class EndXmlTagElement final : public BinaryXmlElement {
   std::string const nameSpace_;
 
 public:
-  EndXmlTagElement(std::string const tag, std::string const nameSpace) : tag_(tag), nameSpace_(nameSpace) {}
+  EndXmlTagElement(std::string tag, std::string nameSpace) : tag_(std::move(tag)), nameSpace_(std::move(nameSpace)) {}
 
   ~EndXmlTagElement() override;
 
   auto tag() const -> std::string override;
 
-  auto nameSpace() const -> std::string;
+  auto nameSpace() const -> std::string const &;
 
   auto accept(BinaryXmlVisitor &visitor) const -> void;
 };
@@ -82,7 +92,7 @@ class CDataTagElement final : public BinaryXmlElement {
   std::string const tag_;
 
 public:
-  CDataTagElement(std::string const tag) : tag_(tag) {}
+  CDataTagElement(std::string tag) : tag_(std::move(tag)) {}
 
   ~CDataTagElement() override;
 
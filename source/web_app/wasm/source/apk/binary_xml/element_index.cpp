@@ -0,0 +1,126 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <stdexcept>
+
+#include "element_index.h"
+#include "xml_traversal.h"
+
+using namespace ai;
+
+namespace {
+
+struct ElementIndexBuilder {
+
+  auto onStartElement(XmlStartElement const &element) -> void {
+    if (openElements.size() > UINT16_MAX) {
+      throw std::logic_error("xml elements nested too deeply");
+    }
+    auto const elementIndex = static_cast<uint32_t>(index.tags.size());
+    auto const parent = openElements.empty() ? ElementIndex::NONE : openElements.back();
+    auto &lastSibling = parent == ElementIndex::NONE ? index.lastRoot : index.lastChildren[parent];
+    index.previousSiblings.push_back(lastSibling);
+    lastSibling = elementIndex;
+
+    index.tags.push_back(element.nameIndex);
+    index.namespaces.push_back(element.namespaceIndex);
+    index.parents.push_back(parent);
+    index.lastChildren.push_back(ElementIndex::NONE);
+    index.depths.push_back(static_cast<uint16_t>(openElements.size()));
+    index.chunkOffsets.push_back(static_cast<uint32_t>(element.chunkOffset));
+    index.firstAttributes.push_back(static_cast<uint32_t>(index.attributeNames.size()));
+    index.attributeCounts.push_back(static_cast<uint16_t>(element.attributes.size()));
+
+    for (auto const &attribute : element.attributes) {
+      index.attributeNames.push_back(attribute.nameIndex);
+      index.attributeResourceIds.push_back(attribute.nameIndex < resourceIds.size() ? resourceIds[attribute.nameIndex] : 0);
+      index.attributeRawValues.push_back(attribute.rawValueIndex);
+      index.attributeTypes.push_back(attribute.type);
+      index.attributeData.push_back(attribute.data);
+      index.attributeOffsets.push_back(static_cast<uint32_t>(attribute.offset));
+    }
+    openElements.push_back(elementIndex);
+  }
+
+  auto onEndElement(XmlEndElement const &) -> void {
+    if (!openElements.empty()) {
+      openElements.pop_back();
+    }
+  }
+
+  std::span<uint32_t const> resourceIds;
+
+  ElementIndex index;
+
+  std::pmr::vector<uint32_t> openElements;
+};
+
+} // namespace
+
+ElementIndex::ElementIndex(std::pmr::memory_resource *const resource)
+    : tags(resource), namespaces(resource), parents(resource), lastChildren(resource), previousSiblings(resource), depths(resource), chunkOffsets(resource),
+      firstAttributes(resource), attributeCounts(resource), attributeNames(resource), attributeResourceIds(resource), attributeRawValues(resource),
+      attributeTypes(resource), attributeData(resource), attributeOffsets(resource) {}
+
+auto ElementIndex::build(std::span<std::byte const> const document, std::size_t const firstChunkOffset, StringPool const &strings,
+                         std::span<uint32_t const> const resourceIds, std::pmr::memory_resource *const resource) -> ElementIndex {
+  auto builder = ElementIndexBuilder{resourceIds, ElementIndex(resource), std::pmr::vector<uint32_t>(resource)};
+  traverseXml(document, firstChunkOffset, strings, builder);
+  return std::move(builder.index);
+}
+
+auto ElementIndex::find(std::span<std::string const> const path, StringPool const &strings) const -> std::optional<uint32_t> {
+  if (path.empty()) {
+    return std::nullopt;
+  }
+  return findFrom(lastRoot, path, strings);
+}
+
+auto ElementIndex::findAttribute(uint32_t const element, uint32_t const resourceId) const -> std::optional<uint32_t> {
+  auto found = std::optional<uint32_t>();
+  if (resourceId == 0) {
+    return found;
+  }
+  auto const firstAttribute = firstAttributes[element];
+  for (auto attribute = firstAttribute; attribute < firstAttribute + attributeCounts[element]; attribute++) {
+    if (attributeResourceIds[attribute] == resourceId) {
+      found = attribute;
+    }
+  }
+  return found;
+}
+
+auto ElementIndex::findFrom(uint32_t const lastSibling, std::span<std::string const> const path, StringPool const &strings) const -> std::optional<uint32_t> {
+  for (auto element = lastSibling; element != NONE; element = previousSiblings[element]) {
+    if (tags[element] >= strings.size() || strings[tags[element]] != path.front()) {
+      continue;
+    }
+    if (path.size() == 1) {
+      return element;
+    }
+    if (auto const found = findFrom(lastChildren[element], path.subspan(1), strings)) {
+      return found;
+    }
+  }
+  return std::nullopt;
+}
@@ -0,0 +1,110 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_ELEMENT_INDEX_H_
+#define ANDROID_INTROSPECTION_APK_ELEMENT_INDEX_H_
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "string_pool.h"
+
+namespace ai {
+
+//
+// Flat struct of arrays table of the elements of a binary xml document,
+// built in a single pass over its chunks.  Elements are stored in document
+// order; attributes of element i are the attributeCounts[i] entries of the
+// attribute arrays starting at firstAttributes[i].  Names are string pool
+// indexes, offsets are byte offsets into the document.  Attribute resource
+// ids come from the resource map, 0 for names it does not cover.  The
+// arrays are allocated from the given resource, e.g. the arena of the
+// document.
+//
+struct ElementIndex {
+
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+  explicit ElementIndex(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+  static auto build(std::span<std::byte const> document, std::size_t firstChunkOffset, StringPool const &strings, std::span<uint32_t const> resourceIds,
+                    std::pmr::memory_resource *resource = std::pmr::get_default_resource()) -> ElementIndex;
+
+  auto size() const -> std::size_t { return tags.size(); }
+
+  //
+  // Walks the tree along the path and returns the last element in document
+  // order that matches it, if any.  Each step only looks at the children of
+  // the elements matched so far.
+  //
+  auto find(std::span<std::string const> path, StringPool const &strings) const -> std::optional<uint32_t>;
+
+  //
+  // Returns the last attribute of the element with the resource id, matched
+  // by id alone so mangled or stripped names do not get in the way.
+  //
+  auto findAttribute(uint32_t element, uint32_t resourceId) const -> std::optional<uint32_t>;
+
+  uint32_t lastRoot = NONE;
+
+  std::pmr::vector<uint32_t> tags;
+
+  std::pmr::vector<uint32_t> namespaces;
+
+  std::pmr::vector<uint32_t> parents;
+
+  std::pmr::vector<uint32_t> lastChildren;
+
+  std::pmr::vector<uint32_t> previousSiblings;
+
+  std::pmr::vector<uint16_t> depths;
+
+  std::pmr::vector<uint32_t> chunkOffsets;
+
+  std::pmr::vector<uint32_t> firstAttributes;
+
+  std::pmr::vector<uint16_t> attributeCounts;
+
+  std::pmr::vector<uint32_t> attributeNames;
+
+  std::pmr::vector<uint32_t> attributeResourceIds;
+
+  std::pmr::vector<uint32_t> attributeRawValues;
+
+  std::pmr::vector<uint8_t> attributeTypes;
+
+  std::pmr::vector<uint32_t> attributeData;
+
+  std::pmr::vector<uint32_t> attributeOffsets;
+
+private:
+  auto findFrom(uint32_t lastSibling, std::span<std::string const> path, StringPool const &strings) const -> std::optional<uint32_t>;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_ELEMENT_INDEX_H_ */
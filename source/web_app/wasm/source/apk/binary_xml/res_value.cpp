@@ -0,0 +1,144 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <bit>
+#include <charconv>
+
+#include "res_value.h"
+#include "resource_types.h"
+#include "utils/format.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// Complex values (dimensions and fractions) keep the unit in the low four
+// bits, the radix in the next two and a signed 24 bit mantissa above.
+//
+static constexpr uint32_t COMPLEX_UNIT_MASK = 0xf;
+static constexpr uint32_t COMPLEX_RADIX_SHIFT = 4;
+static constexpr uint32_t COMPLEX_RADIX_MASK = 0x3;
+static constexpr uint32_t COMPLEX_MANTISSA_MASK = 0xffffff00;
+
+static constexpr float COMPLEX_RADIX_MULTIPLIERS[] = {1.0f / (1U << 8), 1.0f / (1U << 15), 1.0f / (1U << 23), 1.0f / (1U << 31)};
+
+static constexpr std::string_view DIMENSION_UNITS[] = {"px", "dip", "sp", "pt", "in", "mm"};
+
+static constexpr std::string_view FRACTION_UNITS[] = {"%", "%p"};
+
+using Formatter = auto (*)(uint32_t data, char *begin, char *end) -> char *;
+
+auto writeText(char *const begin, std::string_view const text) -> char * { return std::copy(text.begin(), text.end(), begin); }
+
+auto writeHex(char *const begin, uint32_t const data, int const digits) -> char * { return utils::format::writeHex(data, digits, begin); }
+
+//
+// Shortest round trip form, with ".0" added to integral values the way the
+// platform tools print them.
+//
+auto writeFloat(char *const begin, char *const end, float const value) -> char * {
+  auto const written = std::to_chars(begin, end, value).ptr;
+  if (std::find_if(begin, written, [](char const c) { return c == '.' || c == 'e' || c == 'n'; }) == written) {
+    return writeText(written, ".0");
+  }
+  return written;
+}
+
+auto complexToFloat(uint32_t const data) -> float {
+  auto const mantissa = static_cast<int32_t>(data & COMPLEX_MANTISSA_MASK);
+  return static_cast<float>(mantissa) * COMPLEX_RADIX_MULTIPLIERS[(data >> COMPLEX_RADIX_SHIFT) & COMPLEX_RADIX_MASK];
+}
+
+auto formatUnknown(uint32_t, char *const begin, char *) -> char * { return writeText(begin, "unknown"); }
+
+auto formatNull(uint32_t const data, char *const begin, char *) -> char * { return writeText(begin, data == 0 ? "<undefined>" : "<empty>"); }
+
+auto formatReference(uint32_t const data, char *const begin, char *) -> char * { return writeHex(writeText(begin, "@res/0x"), data, 8); }
+
+auto formatAttribute(uint32_t const data, char *const begin, char *) -> char * { return writeHex(writeText(begin, "@attr/0x"), data, 8); }
+
+auto formatDynamicReference(uint32_t const data, char *const begin, char *) -> char * { return writeHex(writeText(begin, "@dyn/0x"), data, 8); }
+
+auto formatDynamicAttribute(uint32_t const data, char *const begin, char *) -> char * { return writeHex(writeText(begin, "@dynattr/0x"), data, 8); }
+
+auto formatFloat(uint32_t const data, char *const begin, char *const end) -> char * { return writeFloat(begin, end, std::bit_cast<float>(data)); }
+
+auto formatDimension(uint32_t const data, char *const begin, char *const end) -> char * {
+  auto const unit = data & COMPLEX_UNIT_MASK;
+  auto const written = writeFloat(begin, end, complexToFloat(data));
+  return unit < std::size(DIMENSION_UNITS) ? writeText(written, DIMENSION_UNITS[unit]) : written;
+}
+
+auto formatFraction(uint32_t const data, char *const begin, char *const end) -> char * {
+  auto const unit = data & COMPLEX_UNIT_MASK;
+  auto const written = writeFloat(begin, end, complexToFloat(data) * 100);
+  return unit < std::size(FRACTION_UNITS) ? writeText(written, FRACTION_UNITS[unit]) : written;
+}
+
+auto formatIntDec(uint32_t const data, char *const begin, char *const end) -> char * { return std::to_chars(begin, end, static_cast<int32_t>(data)).ptr; }
+
+auto formatIntHex(uint32_t const data, char *const begin, char *) -> char * { return writeHex(writeText(begin, "0x"), data, 8); }
+
+auto formatBoolean(uint32_t const data, char *const begin, char *) -> char * {
+  return writeText(begin, data == RES_VALUE_TRUE ? "true" : data == RES_VALUE_FALSE ? "false" : "unknown");
+}
+
+auto formatColorArgb(uint32_t const data, char *const begin, char *) -> char * { return writeHex(writeText(begin, "#"), data, 8); }
+
+auto formatColorRgb(uint32_t const data, char *const begin, char *) -> char * { return writeHex(writeText(begin, "#"), data, 6); }
+
+static constexpr auto FORMATTERS = [] {
+  auto formatters = std::array<Formatter, TYPE_LAST_INT + 1>();
+  formatters.fill(formatUnknown);
+  formatters[TYPE_NULL] = formatNull;
+  formatters[TYPE_REFERENCE] = formatReference;
+  formatters[TYPE_ATTRIBUTE] = formatAttribute;
+  formatters[TYPE_FLOAT] = formatFloat;
+  formatters[TYPE_DIMENSION] = formatDimension;
+  formatters[TYPE_FRACTION] = formatFraction;
+  formatters[TYPE_DYNAMIC_REFERENCE] = formatDynamicReference;
+  formatters[TYPE_DYNAMIC_ATTRIBUTE] = formatDynamicAttribute;
+  formatters[TYPE_INT_DEC] = formatIntDec;
+  formatters[TYPE_INT_HEX] = formatIntHex;
+  formatters[TYPE_INT_BOOLEAN] = formatBoolean;
+  formatters[TYPE_INT_COLOR_ARGB8] = formatColorArgb;
+  formatters[TYPE_INT_COLOR_RGB8] = formatColorRgb;
+  formatters[TYPE_INT_COLOR_ARGB4] = formatColorArgb;
+  formatters[TYPE_INT_COLOR_RGB4] = formatColorRgb;
+  return formatters;
+}();
+
+} // namespace
+
+auto ai::formatResValue(uint8_t const type, uint32_t const data, ResValueBuffer &buffer) -> std::string_view {
+  auto const formatter = type < FORMATTERS.size() ? FORMATTERS[type] : formatUnknown;
+  auto const end = formatter(data, buffer.data(), buffer.data() + buffer.size());
+  return std::string_view(buffer.data(), static_cast<std::size_t>(end - buffer.data()));
+}
+
+auto ai::appendResValue(uint8_t const type, uint32_t const data, std::string &output) -> void {
+  auto buffer = ResValueBuffer();
+  output += formatResValue(type, data, buffer);
+}
@@ -0,0 +1,53 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_RES_VALUE_H_
+#define ANDROID_INTROSPECTION_APK_RES_VALUE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ai {
+
+//
+// Large enough for the text of any Res_value but strings.
+//
+using ResValueBuffer = std::array<char, 32>;
+
+//
+// Formats the data of a Res_value the way decoded xml shows it, e.g.
+// "@res/0x7F0F0050", "16.0dip", "50%p" or "#FF00FF00", into buffer and
+// returns the view of it.  Values are formatted through a table indexed by
+// type with std::to_chars, without allocating.  TYPE_STRING values live in
+// a string pool and format as "unknown" here, like unknown types.
+//
+auto formatResValue(uint8_t type, uint32_t data, ResValueBuffer &buffer) -> std::string_view;
+
+auto appendResValue(uint8_t type, uint32_t data, std::string &output) -> void;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_RES_VALUE_H_ */
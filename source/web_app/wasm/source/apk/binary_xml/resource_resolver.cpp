@@ -0,0 +1,46 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "resource_resolver.h"
+#include "utils/format.h"
+
+using namespace ai;
+
+ResourceResolver::ResourceResolver(ResourceTable const &table, std::size_t const capacity) : table_(table), capacity_(capacity > 0 ? capacity : 1) {
+  index_.reserve(capacity_);
+}
+
+auto ResourceResolver::getReference(uint32_t const id) -> std::string const & {
+  if (auto const found = index_.find(id); found != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, found->second);
+    return found->second->second;
+  }
+  if (entries_.size() >= capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  auto const name = table_.getName(id);
+  entries_.emplace_front(id, name ? "@" + *name : utils::format::format("@res/0x{:08X}", id));
+  index_.emplace(id, entries_.begin());
+  return entries_.front().second;
+}
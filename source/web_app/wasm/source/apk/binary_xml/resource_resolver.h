@@ -0,0 +1,76 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_RESOURCE_RESOLVER_H_
+#define ANDROID_INTROSPECTION_APK_RESOURCE_RESOLVER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "resource_table.h"
+
+namespace ai {
+
+//
+// Resolves resource ids to the references xml is written with, keeping the
+// most recently used ones.  One resolver is meant to be shared by all the
+// documents of an APK, since layouts and the manifest keep referring to the
+// same few strings, styles and drawables.  Not thread safe.
+//
+class ResourceResolver final {
+public:
+  static constexpr std::size_t DEFAULT_CAPACITY = 4096;
+
+  explicit ResourceResolver(ResourceTable const &table, std::size_t capacity = DEFAULT_CAPACITY);
+
+  //
+  // Reference to the resource, e.g. "@string/app_name", or "@res/0x7F0F0050"
+  // for ids the table lacks.  The string stays valid until it is evicted,
+  // i.e. at least until the next call.
+  //
+  auto getReference(uint32_t id) -> std::string const &;
+
+  auto size() const -> std::size_t { return entries_.size(); }
+
+private:
+  using Entry = std::pair<uint32_t, std::string>;
+
+  ResourceTable const &table_;
+
+  std::size_t const capacity_;
+
+  //
+  // Most recently used first.
+  //
+  std::list<Entry> entries_;
+
+  std::unordered_map<uint32_t, std::list<Entry>::iterator> index_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_RESOURCE_RESOLVER_H_ */
@@ -0,0 +1,286 @@
+//
+// MIT License
+//
+// Copyright 2019-2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_RESOURCE_STRUCTS_H_
+#define ANDROID_INTROSPECTION_APK_RESOURCE_STRUCTS_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+//
+// Mirrors of the structures of ResourceTypes.h.
+//
+// https://android.googlesource.com/platform/frameworks/base/+/master/libs/androidfw/include/androidfw/ResourceTypes.h
+//
+// Documents are little endian and the structures are naturally aligned, so
+// the layouts below match AOSP on every target the host and wasm builds
+// support; the asserts keep it that way.  Structures are copied out of the
+// document with readResStruct() rather than pointed at, which needs no
+// alignment and lets the compiler keep fields in registers.
+//
+
+namespace ai {
+
+static_assert(std::endian::native == std::endian::little, "resource structures are read in host byte order");
+
+struct ResChunkHeader {
+
+  uint16_t type;
+
+  uint16_t headerSize;
+
+  uint32_t size;
+};
+
+struct ResStringPoolHeader {
+
+  ResChunkHeader header;
+
+  uint32_t stringCount;
+
+  uint32_t styleCount;
+
+  uint32_t flags;
+
+  uint32_t stringsStart;
+
+  uint32_t stylesStart;
+};
+
+//
+// Markup of a styled string, e.g. "b" or "font;color=#ff0000", from its
+// firstChar-th UTF-16 unit to its lastChar-th, both included.  The spans of
+// a string end with one whose name is RES_STRING_POOL_SPAN_END.
+//
+struct ResStringPoolSpan {
+
+  uint32_t name;
+
+  uint32_t firstChar;
+
+  uint32_t lastChar;
+};
+
+static constexpr uint32_t RES_STRING_POOL_SPAN_END = 0xFFFFFFFF;
+
+struct ResValue {
+
+  uint16_t size;
+
+  uint8_t res0;
+
+  uint8_t dataType;
+
+  uint32_t data;
+};
+
+struct ResXMLTreeNode {
+
+  ResChunkHeader header;
+
+  uint32_t lineNumber;
+
+  uint32_t comment;
+};
+
+//
+// Extension of RES_XML_START_NAMESPACE_TYPE and RES_XML_END_NAMESPACE_TYPE
+// nodes.
+//
+struct ResXMLTreeNamespaceExt {
+
+  uint32_t prefix;
+
+  uint32_t uri;
+};
+
+struct ResXMLTreeEndElementExt {
+
+  uint32_t ns;
+
+  uint32_t name;
+};
+
+struct ResXMLTreeAttrExt {
+
+  uint32_t ns;
+
+  uint32_t name;
+
+  uint16_t attributeStart;
+
+  uint16_t attributeSize;
+
+  uint16_t attributeCount;
+
+  uint16_t idIndex;
+
+  uint16_t classIndex;
+
+  uint16_t styleIndex;
+};
+
+struct ResXMLTreeAttribute {
+
+  uint32_t ns;
+
+  uint32_t name;
+
+  uint32_t rawValue;
+
+  ResValue typedValue;
+};
+
+struct ResXMLTreeCdataExt {
+
+  uint32_t data;
+
+  ResValue typedData;
+};
+
+struct ResTablePackageHeader {
+
+  ResChunkHeader header;
+
+  uint32_t id;
+
+  char16_t name[128];
+
+  uint32_t typeStrings;
+
+  uint32_t lastPublicType;
+
+  uint32_t keyStrings;
+
+  uint32_t lastPublicKey;
+
+  uint32_t typeIdOffset;
+};
+
+//
+// ResTable_type up to its ResTable_config, whose size varies between
+// versions and which follows as the rest of the header.
+//
+struct ResTableTypeHeader {
+
+  ResChunkHeader header;
+
+  uint8_t id;
+
+  uint8_t flags;
+
+  uint16_t reserved;
+
+  uint32_t entryCount;
+
+  uint32_t entriesStart;
+};
+
+struct ResTableEntry {
+
+  uint16_t size;
+
+  uint16_t flags;
+
+  uint32_t key;
+};
+
+struct ResTableMapEntry {
+
+  ResTableEntry entry;
+
+  uint32_t parent;
+
+  uint32_t count;
+};
+
+static_assert(sizeof(ResChunkHeader) == 8);
+static_assert(offsetof(ResChunkHeader, headerSize) == 2 && offsetof(ResChunkHeader, size) == 4);
+
+static_assert(sizeof(ResStringPoolHeader) == 28);
+static_assert(offsetof(ResStringPoolHeader, stringCount) == 8 && offsetof(ResStringPoolHeader, flags) == 16);
+static_assert(offsetof(ResStringPoolHeader, stringsStart) == 20 && offsetof(ResStringPoolHeader, stylesStart) == 24);
+
+static_assert(sizeof(ResStringPoolSpan) == 12);
+static_assert(offsetof(ResStringPoolSpan, lastChar) == 8);
+
+static_assert(sizeof(ResValue) == 8);
+static_assert(offsetof(ResValue, dataType) == 3 && offsetof(ResValue, data) == 4);
+
+static_assert(sizeof(ResXMLTreeNode) == 16);
+static_assert(offsetof(ResXMLTreeNode, lineNumber) == 8 && offsetof(ResXMLTreeNode, comment) == 12);
+
+static_assert(sizeof(ResXMLTreeNamespaceExt) == 8);
+static_assert(sizeof(ResXMLTreeEndElementExt) == 8);
+
+static_assert(sizeof(ResXMLTreeAttrExt) == 20);
+static_assert(offsetof(ResXMLTreeAttrExt, attributeStart) == 8 && offsetof(ResXMLTreeAttrExt, attributeSize) == 10);
+static_assert(offsetof(ResXMLTreeAttrExt, attributeCount) == 12 && offsetof(ResXMLTreeAttrExt, idIndex) == 14);
+static_assert(offsetof(ResXMLTreeAttrExt, styleIndex) == 18);
+
+static_assert(sizeof(ResXMLTreeAttribute) == 20);
+static_assert(offsetof(ResXMLTreeAttribute, rawValue) == 8 && offsetof(ResXMLTreeAttribute, typedValue) == 12);
+
+static_assert(sizeof(ResXMLTreeCdataExt) == 12);
+static_assert(offsetof(ResXMLTreeCdataExt, typedData) == 4);
+
+static_assert(sizeof(ResTablePackageHeader) == 288);
+static_assert(offsetof(ResTablePackageHeader, name) == 12 && offsetof(ResTablePackageHeader, typeStrings) == 268);
+static_assert(offsetof(ResTablePackageHeader, keyStrings) == 276 && offsetof(ResTablePackageHeader, typeIdOffset) == 284);
+
+static_assert(sizeof(ResTableTypeHeader) == 20);
+static_assert(offsetof(ResTableTypeHeader, flags) == 9 && offsetof(ResTableTypeHeader, entryCount) == 12);
+static_assert(offsetof(ResTableTypeHeader, entriesStart) == 16);
+
+static_assert(sizeof(ResTableEntry) == 8);
+static_assert(offsetof(ResTableEntry, flags) == 2 && offsetof(ResTableEntry, key) == 4);
+
+static_assert(sizeof(ResTableMapEntry) == 16);
+static_assert(offsetof(ResTableMapEntry, parent) == 8);
+
+//
+// Copies the structure at offset out of bytes.  Only the first size bytes
+// are read, for headers written by older versions that lack trailing
+// fields; those are zeroed.  Throws with error unless the bytes read are
+// all within bytes.
+//
+template <typename T>
+auto readResStruct(std::span<std::byte const> const bytes, std::size_t const offset, char const *const error, std::size_t const size = sizeof(T)) -> T {
+  static_assert(std::is_trivially_copyable_v<T>);
+  if (offset > bytes.size() || size > bytes.size() - offset) {
+    throw std::logic_error(error);
+  }
+  auto value = T();
+  memcpy(&value, bytes.data() + offset, std::min(size, sizeof(T)));
+  return value;
+}
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_RESOURCE_STRUCTS_H_ */
@@ -0,0 +1,468 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#define LOG_MODULE LOG_MODULE_BINARY_XML
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+#include "resource_structs.h"
+#include "resource_table.h"
+#include "resource_types.h"
+#include "utils/log.h"
+#include "utils/unicode.h"
+
+//
+// Implementation used the following resources.
+//
+// https://android.googlesource.com/platform/frameworks/base/+/master/libs/androidfw/include/androidfw/ResourceTypes.h
+// https://android.googlesource.com/platform/frameworks/base/+/master/libs/androidfw/ResourceTypes.cpp
+//
+// A resource table is a RES_TABLE_TYPE chunk holding the pool of value
+// strings followed by one RES_TABLE_PACKAGE_TYPE chunk per package.  A
+// package holds the pools of type and key names, then for every type one
+// RES_TABLE_TYPE_SPEC_TYPE chunk and one RES_TABLE_TYPE_TYPE chunk per
+// configuration, each being a table of offsets to its entries.
+//
+
+using namespace ai;
+
+namespace {
+
+static constexpr std::size_t CHUNK_HEADER_SIZE = sizeof(ResChunkHeader);
+
+static constexpr std::size_t PACKAGE_NAME_LENGTH = sizeof(ResTablePackageHeader::name) / sizeof(char16_t);
+
+static constexpr uint32_t NO_ENTRY = UINT32_MAX;
+static constexpr uint16_t NO_ENTRY16 = UINT16_MAX;
+
+static constexpr uint32_t APPLICATION_PACKAGE_ID = 0x7f;
+
+static constexpr char const *INVALID_OFFSET = "invalid resource table offset";
+
+//
+// Offsets into a ResTable_config, which starts with its size, and the size
+// of its current version; older versions are shorter, newer ones longer.
+//
+static constexpr std::size_t CONFIGURATION_LANGUAGE = 8;
+static constexpr std::size_t CONFIGURATION_REGION = 10;
+static constexpr std::size_t CONFIGURATION_DENSITY = 14;
+static constexpr std::size_t CONFIGURATION_SDK_VERSION = 24;
+static constexpr std::size_t CONFIGURATION_UI_MODE = 29;
+static constexpr std::size_t CONFIGURATION_SIZE = 64;
+
+static constexpr uint8_t UI_MODE_NIGHT_MASK = 0x30;
+static constexpr uint8_t UI_MODE_NIGHT_NO = 0x10;
+static constexpr uint8_t UI_MODE_NIGHT_YES = 0x20;
+
+static constexpr uint16_t DENSITY_MEDIUM = 160;
+static constexpr uint16_t DENSITY_ANY = 0xFFFE;
+
+static constexpr uint8_t QUALIFIER_LANGUAGE = 1 << 0;
+static constexpr uint8_t QUALIFIER_REGION = 1 << 1;
+static constexpr uint8_t QUALIFIER_DENSITY = 1 << 2;
+static constexpr uint8_t QUALIFIER_SDK_VERSION = 1 << 3;
+static constexpr uint8_t QUALIFIER_NIGHT = 1 << 4;
+static constexpr uint8_t QUALIFIER_OTHER = 1 << 5;
+
+template <typename T> auto load(std::span<std::byte const> const table, std::size_t const offset) -> T { return readResStruct<T>(table, offset, INVALID_OFFSET); }
+
+auto readChunk(std::span<std::byte const> const table, std::size_t const offset, std::size_t const end) -> ResChunkHeader {
+  auto const chunk = load<ResChunkHeader>(table, offset);
+  if (chunk.size < CHUNK_HEADER_SIZE || chunk.headerSize < CHUNK_HEADER_SIZE || chunk.headerSize > chunk.size || chunk.size > end - offset) {
+    throw std::logic_error("invalid resource table chunk");
+  }
+  return chunk;
+}
+
+auto readPackageName(ResTablePackageHeader const &header) -> std::string {
+  auto const name = std::u16string_view(header.name, PACKAGE_NAME_LENGTH);
+  return utils::unicode::toUtf8(name.substr(0, name.find(u'\0')));
+}
+
+auto readCode(std::string const &code, char const *const error) -> std::array<char, 2> {
+  if (!code.empty() && code.size() != 2) {
+    throw std::logic_error(error);
+  }
+  return code.empty() ? std::array<char, 2>{} : std::array<char, 2>{code[0], code[1]};
+}
+
+//
+// Density closer to the one requested scores higher.  Like Android, scaling
+// a larger image down is preferred over scaling a smaller one up unless the
+// smaller one is much closer.
+//
+auto scoreDensity(uint16_t const density, uint16_t const requested) -> double {
+  if (density == DENSITY_ANY) {
+    return 2;
+  }
+  auto const actual = static_cast<double>(density != 0 ? density : DENSITY_MEDIUM);
+  auto const target = static_cast<double>(requested != 0 ? requested : DENSITY_MEDIUM);
+  return actual >= target ? target / actual : 2 * actual / target - 1;
+}
+
+} // namespace
+
+//
+// The configuration starts with its size; the fields older, shorter
+// versions lack read as zero.
+//
+auto ResourceTable::readConfiguration(std::span<std::byte const> const bytes) -> Configuration {
+  auto padded = std::array<uint8_t, CONFIGURATION_SIZE>{};
+  std::memcpy(padded.data(), bytes.data(), std::min(bytes.size(), padded.size()));
+  auto configuration = Configuration{};
+  std::memcpy(configuration.language.data(), &padded[CONFIGURATION_LANGUAGE], 2);
+  std::memcpy(configuration.region.data(), &padded[CONFIGURATION_REGION], 2);
+  std::memcpy(&configuration.density, &padded[CONFIGURATION_DENSITY], sizeof(uint16_t));
+  std::memcpy(&configuration.sdkVersion, &padded[CONFIGURATION_SDK_VERSION], sizeof(uint16_t));
+  configuration.night = padded[CONFIGURATION_UI_MODE] & UI_MODE_NIGHT_MASK;
+
+  auto const set = [&configuration, &padded](uint8_t const qualifier, std::size_t const offset, std::size_t const size) {
+    if (std::any_of(&padded[offset], &padded[offset + size], [](uint8_t const b) { return b != 0; })) {
+      configuration.qualifiers |= qualifier;
+    }
+    std::fill(&padded[offset], &padded[offset + size], uint8_t{0});
+  };
+  //
+  // Three letter languages are packed into the two bytes with the high bit
+  // set and are told apart from no other qualifier.
+  //
+  set((padded[CONFIGURATION_LANGUAGE] & 0x80) != 0 ? QUALIFIER_OTHER : QUALIFIER_LANGUAGE, CONFIGURATION_LANGUAGE, 2);
+  set((padded[CONFIGURATION_REGION] & 0x80) != 0 ? QUALIFIER_OTHER : QUALIFIER_REGION, CONFIGURATION_REGION, 2);
+  set(QUALIFIER_DENSITY, CONFIGURATION_DENSITY, sizeof(uint16_t));
+  set(QUALIFIER_SDK_VERSION, CONFIGURATION_SDK_VERSION, sizeof(uint16_t));
+  if (configuration.night != 0) {
+    configuration.qualifiers |= QUALIFIER_NIGHT;
+  }
+  padded[CONFIGURATION_UI_MODE] &= ~UI_MODE_NIGHT_MASK;
+  auto const isZero = [](auto const b) { return b == decltype(b){0}; };
+  if (!std::all_of(padded.begin() + sizeof(uint32_t), padded.end(), isZero) ||
+      (bytes.size() > padded.size() && !std::all_of(bytes.begin() + padded.size(), bytes.end(), isZero))) {
+    configuration.qualifiers |= QUALIFIER_OTHER;
+  }
+  return configuration;
+}
+
+auto ResourceTable::readDevice(ResourceConfiguration const &device) -> Configuration {
+  auto configuration = Configuration{};
+  configuration.language = readCode(device.language, "invalid resource configuration language");
+  configuration.region = readCode(device.region, "invalid resource configuration region");
+  configuration.density = device.density;
+  configuration.sdkVersion = device.sdkVersion;
+  configuration.night = device.night ? UI_MODE_NIGHT_YES : UI_MODE_NIGHT_NO;
+  return configuration;
+}
+
+ResourceTable::ResourceTable(std::span<std::byte const> const table) : table_(table) {
+  auto const header = readChunk(table_, 0, table_.size());
+  if (header.type != RES_TABLE_TYPE) {
+    throw std::logic_error("invalid resource table header");
+  }
+  for (auto offset = std::size_t{header.headerSize}; offset + CHUNK_HEADER_SIZE <= header.size;) {
+    auto const chunk = readChunk(table_, offset, header.size);
+    if (chunk.type == RES_STRING_POOL_TYPE && valueStringsOffset_ == 0) {
+      valueStringsOffset_ = offset;
+    } else if (chunk.type == RES_TABLE_PACKAGE_TYPE) {
+      readPackage(offset);
+    }
+    offset += chunk.size;
+  }
+  if (valueStringsOffset_ == 0) {
+    throw std::logic_error("invalid resource table; missing string pool");
+  }
+  LOGD("resource table with [{}] packages", packages_.size());
+}
+
+auto ResourceTable::readPackage(std::size_t const offset) -> void {
+  auto const chunk = readChunk(table_, offset, table_.size());
+  if (chunk.headerSize < offsetof(ResTablePackageHeader, typeIdOffset)) {
+    throw std::logic_error("invalid resource table package");
+  }
+  auto const header = readResStruct<ResTablePackageHeader>(table_, offset, INVALID_OFFSET, chunk.headerSize);
+  auto package = Package(&arena_);
+  package.id = header.id;
+  package.name = readPackageName(header);
+  package.typeStringsOffset = offset + header.typeStrings;
+  package.keyStringsOffset = offset + header.keyStrings;
+  package.typeIdOffset = header.typeIdOffset;
+
+  auto const end = offset + chunk.size;
+  for (auto typeOffset = offset + chunk.headerSize; typeOffset + CHUNK_HEADER_SIZE <= end;) {
+    auto const typeChunk = readChunk(table_, typeOffset, end);
+    if (typeChunk.type == RES_TABLE_TYPE_TYPE) {
+      //
+      // The ResTable_config starts with its own size.
+      //
+      static constexpr auto configurationOffset = sizeof(ResTableTypeHeader) + sizeof(uint32_t);
+      if (typeChunk.headerSize < configurationOffset) {
+        throw std::logic_error("invalid resource table type");
+      }
+      auto const typeHeader = load<ResTableTypeHeader>(table_, typeOffset);
+      auto const type = TypeChunk{
+          typeOffset,
+          typeChunk.headerSize,
+          typeHeader.flags,
+          typeHeader.entryCount,
+          typeHeader.entriesStart,
+          readConfiguration(table_.subspan(typeOffset + sizeof(ResTableTypeHeader), typeChunk.headerSize - sizeof(ResTableTypeHeader))),
+      };
+      auto &types = package.types.try_emplace(typeHeader.id, &arena_).first->second;
+      types.chunks.push_back(type);
+      types.qualifiers |= type.configuration.qualifiers;
+    }
+    typeOffset += typeChunk.size;
+  }
+  LOGD("resource table package [{}] id [{:#x}] with [{}] types", package.name, package.id, package.types.size());
+  packages_.push_back(std::move(package));
+}
+
+auto ResourceTable::findEntry(TypeChunk const &type, uint16_t const entryIndex) const -> std::optional<std::size_t> {
+  auto const offsets = type.offset + type.headerSize;
+  auto entryOffset = uint32_t{NO_ENTRY};
+  if ((type.flags & RES_TABLE_TYPE_FLAG_SPARSE) != 0) {
+    //
+    // Sparse types list (index, offset / 4) pairs sorted by index.
+    //
+    auto low = uint32_t{0};
+    auto high = type.entryCount;
+    while (low < high) {
+      auto const middle = low + (high - low) / 2;
+      auto const index = load<uint16_t>(table_, offsets + middle * 2 * sizeof(uint16_t));
+      if (index == entryIndex) {
+        entryOffset = uint32_t{load<uint16_t>(table_, offsets + middle * 2 * sizeof(uint16_t) + sizeof(uint16_t))} * 4;
+        break;
+      }
+      if (index < entryIndex) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+  } else if (entryIndex < type.entryCount && (type.flags & RES_TABLE_TYPE_FLAG_OFFSET16) != 0) {
+    auto const offset16 = load<uint16_t>(table_, offsets + std::size_t{entryIndex} * sizeof(uint16_t));
+    entryOffset = offset16 == NO_ENTRY16 ? NO_ENTRY : uint32_t{offset16} * 4;
+  } else if (entryIndex < type.entryCount) {
+    entryOffset = load<uint32_t>(table_, offsets + std::size_t{entryIndex} * sizeof(uint32_t));
+  }
+  if (entryOffset == NO_ENTRY) {
+    return std::nullopt;
+  }
+  return type.offset + type.entriesStart + entryOffset;
+}
+
+auto ResourceTable::findTypes(uint32_t const id) const -> std::pair<Package const *, Types const *> {
+  auto const package = std::find_if(packages_.begin(), packages_.end(), [id](Package const &package) { return package.id == (id >> 24); });
+  if (package == packages_.end()) {
+    return {nullptr, nullptr};
+  }
+  auto const types = package->types.find(static_cast<uint8_t>(id >> 16));
+  if (types == package->types.end()) {
+    return {nullptr, nullptr};
+  }
+  return {&*package, &types->second};
+}
+
+auto ResourceTable::find(uint32_t const id) const -> std::optional<ResourceEntry> {
+  auto const lock = std::lock_guard(mutex_);
+  auto const [package, types] = findTypes(id);
+  if (types == nullptr) {
+    return std::nullopt;
+  }
+  auto entryOffset = std::optional<std::size_t>();
+  for (auto const &type : types->chunks) {
+    auto const defaultConfiguration = type.configuration.qualifiers == 0;
+    if (auto const offset = findEntry(type, static_cast<uint16_t>(id)); offset && (!entryOffset || defaultConfiguration)) {
+      entryOffset = offset;
+      if (defaultConfiguration) {
+        break;
+      }
+    }
+  }
+  if (!entryOffset) {
+    return std::nullopt;
+  }
+  return readEntry(*package, id, *entryOffset);
+}
+
+auto ResourceTable::find(uint32_t const id, ResourceConfiguration const &configuration) const -> std::optional<ResourceEntry> {
+  auto const device = readDevice(configuration);
+  auto const lock = std::lock_guard(mutex_);
+  auto const [package, types] = findTypes(id);
+  if (types == nullptr) {
+    return std::nullopt;
+  }
+  for (auto const chunk : rank(*types, device)) {
+    if (auto const offset = findEntry(types->chunks[chunk], static_cast<uint16_t>(id))) {
+      return readEntry(*package, id, *offset);
+    }
+  }
+  return std::nullopt;
+}
+
+//
+// Drops the configurations that contradict the device, then orders the rest
+// by the qualifiers in the order Android weighs them.  Every qualifier a
+// remaining configuration sets agrees with the device, so setting one at
+// all is what counts, but for the density and the SDK version.
+//
+auto ResourceTable::rank(Types const &types, Configuration const &device) const -> std::pmr::vector<uint32_t> const & {
+  auto key = Configuration{};
+  if ((types.qualifiers & (QUALIFIER_LANGUAGE | QUALIFIER_REGION)) != 0) {
+    key.language = device.language;
+  }
+  if ((types.qualifiers & QUALIFIER_REGION) != 0) {
+    key.region = device.region;
+  }
+  if ((types.qualifiers & QUALIFIER_DENSITY) != 0) {
+    key.density = device.density;
+  }
+  if ((types.qualifiers & QUALIFIER_SDK_VERSION) != 0) {
+    key.sdkVersion = device.sdkVersion;
+  }
+  if ((types.qualifiers & QUALIFIER_NIGHT) != 0) {
+    key.night = device.night;
+  }
+  if (types.rankedFor == key) {
+    return types.ranking;
+  }
+
+  auto const matches = [&key](Configuration const &configuration) {
+    auto const set = [&configuration](uint8_t const qualifier) { return (configuration.qualifiers & qualifier) != 0; };
+    return !set(QUALIFIER_OTHER) && (!set(QUALIFIER_LANGUAGE) || configuration.language == key.language) &&
+           (!set(QUALIFIER_REGION) || configuration.region == key.region) && (!set(QUALIFIER_NIGHT) || configuration.night == key.night) &&
+           (!set(QUALIFIER_SDK_VERSION) || key.sdkVersion == 0 || configuration.sdkVersion <= key.sdkVersion);
+  };
+  auto const score = [&key](Configuration const &configuration) {
+    auto const set = [&configuration](uint8_t const qualifier) { return (configuration.qualifiers & qualifier) != 0; };
+    auto const density = set(QUALIFIER_DENSITY) ? scoreDensity(configuration.density, key.density) : scoreDensity(0, key.density);
+    return std::tuple(set(QUALIFIER_LANGUAGE), set(QUALIFIER_REGION), set(QUALIFIER_NIGHT), density, configuration.sdkVersion);
+  };
+  auto &ranking = types.ranking;
+  ranking.clear();
+  for (auto chunk = uint32_t{0}; chunk < types.chunks.size(); chunk++) {
+    if (matches(types.chunks[chunk].configuration)) {
+      ranking.push_back(chunk);
+    }
+  }
+  std::stable_sort(ranking.begin(), ranking.end(),
+                   [&types, &score](uint32_t const a, uint32_t const b) { return score(types.chunks[a].configuration) > score(types.chunks[b].configuration); });
+  types.rankedFor = key;
+  return ranking;
+}
+
+auto ResourceTable::readEntry(Package const &package, uint32_t const id, std::size_t const offset) const -> ResourceEntry {
+  auto entry = ResourceEntry{id, {}, {}, false, ResourceValue{TYPE_NULL, 0}, 0};
+  auto const tableEntry = load<ResTableEntry>(table_, offset);
+  auto keyIndex = uint32_t{0};
+  if ((tableEntry.flags & RES_TABLE_ENTRY_FLAG_COMPACT) != 0) {
+    //
+    // Compact entries keep the key in the size, the value type in the high
+    // byte of the flags and the value data in the key.
+    //
+    keyIndex = tableEntry.size;
+    entry.value = ResourceValue{static_cast<uint8_t>(tableEntry.flags >> 8), tableEntry.key};
+  } else {
+    keyIndex = tableEntry.key;
+    if ((tableEntry.flags & RES_TABLE_ENTRY_FLAG_COMPLEX) != 0) {
+      entry.complex = true;
+      entry.parent = load<ResTableMapEntry>(table_, offset).parent;
+    } else {
+      auto const value = load<ResValue>(table_, offset + tableEntry.size);
+      entry.value = ResourceValue{value.dataType, value.data};
+    }
+  }
+  auto const typeId = static_cast<uint8_t>(id >> 16);
+  if (typeId <= package.typeIdOffset) {
+    throw std::logic_error("invalid resource table type id");
+  }
+  entry.typeName = getPool(package.typeStrings, package.typeStringsOffset)[typeId - 1 - package.typeIdOffset];
+  entry.keyName = getPool(package.keyStrings, package.keyStringsOffset)[keyIndex];
+  return entry;
+}
+
+auto ResourceTable::ids() const -> std::vector<uint32_t> {
+  auto const lock = std::lock_guard(mutex_);
+  auto ids = std::vector<uint32_t>();
+  for (auto const &package : packages_) {
+    for (auto const &[typeId, types] : package.types) {
+      auto const typePrefix = package.id << 24 | uint32_t{typeId} << 16;
+      for (auto const &type : types.chunks) {
+        if ((type.flags & RES_TABLE_TYPE_FLAG_SPARSE) != 0) {
+          auto const offsets = type.offset + type.headerSize;
+          for (auto entry = uint32_t{0}; entry < type.entryCount; entry++) {
+            ids.push_back(typePrefix | load<uint16_t>(table_, offsets + entry * 2 * sizeof(uint16_t)));
+          }
+          continue;
+        }
+        for (auto entryIndex = uint32_t{0}; entryIndex < type.entryCount && entryIndex <= UINT16_MAX; entryIndex++) {
+          if (findEntry(type, static_cast<uint16_t>(entryIndex))) {
+            ids.push_back(typePrefix | entryIndex);
+          }
+        }
+      }
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+auto ResourceTable::getName(uint32_t const id) const -> std::optional<std::string> {
+  auto const entry = find(id);
+  if (!entry) {
+    return std::nullopt;
+  }
+  auto name = std::string();
+  if ((id >> 24) != APPLICATION_PACKAGE_ID) {
+    auto const package = std::find_if(packages_.begin(), packages_.end(), [id](Package const &package) { return package.id == (id >> 24); });
+    name += package->name;
+    name += ':';
+  }
+  name += entry->typeName;
+  name += '/';
+  name += entry->keyName;
+  return name;
+}
+
+auto ResourceTable::getString(uint32_t const index) const -> std::string_view {
+  auto const lock = std::lock_guard(mutex_);
+  return getPool(valueStrings_, valueStringsOffset_)[index];
+}
+
+auto ResourceTable::getStyledString(uint32_t const index) const -> std::string {
+  auto const lock = std::lock_guard(mutex_);
+  return getPool(valueStrings_, valueStringsOffset_).styledString(index);
+}
+
+auto ResourceTable::getPool(std::optional<StringPool> &pool, std::size_t const offset) const -> StringPool const & {
+  if (!pool) {
+    if (offset > table_.size()) {
+      throw std::logic_error("invalid resource table offset");
+    }
+    pool = StringPool::read(table_.subspan(offset));
+  }
+  return *pool;
+}
@@ -0,0 +1,253 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_RESOURCE_TABLE_H_
+#define ANDROID_INTROSPECTION_APK_RESOURCE_TABLE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "string_pool.h"
+#include "utils/arena.h"
+
+namespace ai {
+
+struct ResourceValue {
+
+  uint8_t type;
+
+  uint32_t data;
+};
+
+struct ResourceEntry {
+
+  uint32_t id;
+
+  std::string_view typeName;
+
+  std::string_view keyName;
+
+  //
+  // Bag resources (styles, arrays, plurals) have no single value; their
+  // value is TYPE_NULL and parent is the id of the bag they extend.
+  //
+  bool complex;
+
+  ResourceValue value;
+
+  uint32_t parent;
+};
+
+//
+// Device configuration resources are looked up for.  Languages and regions
+// are two letter codes, e.g. "en" and "US", empty for none; a density of 0
+// stands for medium (160 dpi) and an sdkVersion of 0 for any version.
+//
+struct ResourceConfiguration {
+
+  std::string language = {};
+
+  std::string region = {};
+
+  uint16_t density = 0;
+
+  uint16_t sdkVersion = 0;
+
+  bool night = false;
+};
+
+//
+// Index over a resources.arsc.  Only the package, type spec and type chunk
+// headers are read up front; entries are decoded when looked up by id and
+// the string pools are indexed on first use.  Of the configurations of an
+// entry find(id) prefers the default one.  The table bytes, e.g. a mapped
+// file or a stored zip entry, must outlive the index.  Lookups are
+// serialized, so one table can be shared between threads; views it hands
+// out stay valid for its lifetime.
+//
+class ResourceTable final {
+public:
+  explicit ResourceTable(std::span<std::byte const> table);
+
+  auto find(uint32_t id) const -> std::optional<ResourceEntry>;
+
+  //
+  // Same as above with the entry of the configuration that best matches the
+  // device, as Android picks it: the locale goes first, then night mode,
+  // density and the SDK version.  Configurations qualified by anything else,
+  // e.g. orientation or screen size, or by three letter languages, never
+  // match.  The configurations of a type are ranked once for a device and
+  // kept until a type is looked up for another one, so resolving a screen of
+  // references for one device ranks each type once.
+  //
+  auto find(uint32_t id, ResourceConfiguration const &configuration) const -> std::optional<ResourceEntry>;
+
+  //
+  // Name of the resource as in "string/app_name", prefixed with the package
+  // name for packages other than the application, e.g. "android:style/Theme".
+  //
+  auto getName(uint32_t id) const -> std::optional<std::string>;
+
+  //
+  // String of the global value pool, for TYPE_STRING values.
+  //
+  auto getString(uint32_t index) const -> std::string_view;
+
+  //
+  // Same as above with the markup of the string as tags, e.g. "<b>Note</b>".
+  //
+  auto getStyledString(uint32_t index) const -> std::string;
+
+  auto packageCount() const -> std::size_t { return packages_.size(); }
+
+  //
+  // Ids of every entry of any configuration, sorted.  Only the offsets of
+  // the type chunks are read.
+  //
+  auto ids() const -> std::vector<uint32_t>;
+
+private:
+  //
+  // The qualifiers of a ResTable_config that lookups tell apart, with the
+  // bit of every one that is set.
+  //
+  struct Configuration {
+
+    std::array<char, 2> language;
+
+    std::array<char, 2> region;
+
+    uint16_t density;
+
+    uint16_t sdkVersion;
+
+    uint8_t night;
+
+    uint8_t qualifiers;
+
+    auto operator==(Configuration const &) const -> bool = default;
+  };
+
+  struct TypeChunk {
+
+    std::size_t offset;
+
+    uint16_t headerSize;
+
+    uint8_t flags;
+
+    uint32_t entryCount;
+
+    uint32_t entriesStart;
+
+    Configuration configuration;
+  };
+
+  struct Types {
+
+    explicit Types(std::pmr::memory_resource *const resource) : chunks(resource), ranking(resource) {}
+
+    std::pmr::vector<TypeChunk> chunks;
+
+    //
+    // Qualifiers set by any of the chunks.
+    //
+    uint8_t qualifiers = 0;
+
+    //
+    // Chunks matching the device rankedFor, best first.  The device is
+    // reduced to the qualifiers of the type, so that devices differing in
+    // what the type does not tell apart share the ranking.
+    //
+    mutable std::optional<Configuration> rankedFor;
+
+    mutable std::pmr::vector<uint32_t> ranking;
+  };
+
+  struct Package {
+
+    explicit Package(std::pmr::memory_resource *const resource) : types(resource) {}
+
+    uint32_t id;
+
+    std::string name;
+
+    std::size_t typeStringsOffset;
+
+    std::size_t keyStringsOffset;
+
+    uint32_t typeIdOffset;
+
+    std::pmr::map<uint8_t, Types> types;
+
+    mutable std::optional<StringPool> typeStrings;
+
+    mutable std::optional<StringPool> keyStrings;
+  };
+
+  static auto readConfiguration(std::span<std::byte const> bytes) -> Configuration;
+
+  static auto readDevice(ResourceConfiguration const &device) -> Configuration;
+
+  auto readPackage(std::size_t offset) -> void;
+
+  auto findTypes(uint32_t id) const -> std::pair<Package const *, Types const *>;
+
+  auto findEntry(TypeChunk const &type, uint16_t entryIndex) const -> std::optional<std::size_t>;
+
+  auto rank(Types const &types, Configuration const &device) const -> std::pmr::vector<uint32_t> const &;
+
+  auto readEntry(Package const &package, uint32_t id, std::size_t offset) const -> ResourceEntry;
+
+  auto getPool(std::optional<StringPool> &pool, std::size_t offset) const -> StringPool const &;
+
+  std::span<std::byte const> table_;
+
+  std::size_t valueStringsOffset_ = 0;
+
+  mutable std::optional<StringPool> valueStrings_;
+
+  //
+  // Holds the type chunk lists of the packages, which are only built by the
+  // constructor and dropped with the table, and their rankings.
+  //
+  utils::Arena arena_;
+
+  std::vector<Package> packages_;
+
+  mutable std::mutex mutex_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_RESOURCE_TABLE_H_ */
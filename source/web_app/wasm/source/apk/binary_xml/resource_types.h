@@ -98,6 +98,26 @@ enum : uint32_t {
   RES_VALUE_FALSE = 0x00000000
 };
 
+//
+// Table Entry Flags
+//
+enum : uint16_t {
+
+  RES_TABLE_ENTRY_FLAG_COMPLEX = 0x0001,
+  RES_TABLE_ENTRY_FLAG_PUBLIC = 0x0002,
+  RES_TABLE_ENTRY_FLAG_WEAK = 0x0004,
+  RES_TABLE_ENTRY_FLAG_COMPACT = 0x0008,
+};
+
+//
+// Table Type Flags
+//
+enum : uint8_t {
+
+  RES_TABLE_TYPE_FLAG_SPARSE = 0x01,
+  RES_TABLE_TYPE_FLAG_OFFSET16 = 0x02,
+};
+
 //
 // Resource Flags
 //
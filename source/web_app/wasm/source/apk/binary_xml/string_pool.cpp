@@ -0,0 +1,256 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "resource_structs.h"
+#include "resource_types.h"
+#include "string_pool.h"
+#include "utils/trace.h"
+#include "utils/unicode.h"
+#include "utils/xml_escape.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// Lengths in a pool are prefixed with one unit, or two if the high bit of the
+// first one is set.
+//
+template <typename T> auto readLength(std::span<std::byte const> strings, std::size_t &offset) -> uint32_t {
+  auto const readUnit = [&strings, &offset]() {
+    if (offset + sizeof(T) > strings.size()) {
+      throw std::logic_error("invalid string pool entry");
+    }
+    T unit;
+    memcpy(&unit, strings.data() + offset, sizeof(unit));
+    offset += sizeof(unit);
+    return unit;
+  };
+  static constexpr auto highBit = static_cast<T>(1U << (sizeof(T) * 8 - 1));
+  auto const first = readUnit();
+  if ((first & highBit) == 0) {
+    return first;
+  }
+  return (static_cast<uint32_t>(first & ~highBit) << (sizeof(T) * 8)) | readUnit();
+}
+
+//
+// Bytes of the UTF-8 sequence led by the byte, 1 for a stray continuation
+// byte so that broken strings still move forward.
+//
+auto getSequenceLength(char const lead) -> std::size_t {
+  auto const byte = static_cast<uint8_t>(lead);
+  return byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+}
+
+//
+// "font;color=#ff0000" is written as <font color="#ff0000">.
+//
+auto appendOpeningTag(std::string &styled, std::string_view const name) -> void {
+  auto const tagEnd = name.find(';');
+  styled += '<';
+  styled += name.substr(0, tagEnd);
+  for (auto attributes = tagEnd; attributes != std::string_view::npos;) {
+    auto const attributeEnd = name.find(';', attributes + 1);
+    auto const attribute = name.substr(attributes + 1, attributeEnd == std::string_view::npos ? std::string_view::npos : attributeEnd - attributes - 1);
+    auto const separator = attribute.find('=');
+    styled += ' ';
+    styled += attribute.substr(0, separator);
+    styled += "=\"";
+    utils::xml::appendEscaped(separator == std::string_view::npos ? std::string_view() : attribute.substr(separator + 1), styled);
+    styled += '"';
+    attributes = attributeEnd;
+  }
+  styled += '>';
+}
+
+auto appendClosingTag(std::string &styled, std::string_view const name) -> void {
+  styled += "</";
+  styled += name.substr(0, name.find(';'));
+  styled += '>';
+}
+
+} // namespace
+
+StringPool::StringPool(std::span<std::byte const> strings, std::vector<uint32_t> offsets, bool const utf8Encoded, std::span<std::byte const> styles,
+                       std::vector<uint32_t> styleOffsets)
+    : strings_(strings), offsets_(std::move(offsets)), utf8Encoded_(utf8Encoded), styles_(styles), styleOffsets_(std::move(styleOffsets)) {
+  if (!utf8Encoded_) {
+    decodedStrings_.resize(offsets_.size());
+  }
+}
+
+auto StringPool::read(std::span<std::byte const> const chunk) -> StringPool {
+  auto const pool = readResStruct<ResStringPoolHeader>(chunk, 0, "invalid string pool header");
+  auto const &header = pool.header;
+  auto const stringsEnd = pool.styleCount > 0 ? pool.stylesStart : header.size;
+  auto const offsetsEnd = header.headerSize + (uint64_t{pool.stringCount} + pool.styleCount) * sizeof(uint32_t);
+  if (header.type != RES_STRING_POOL_TYPE || header.size > chunk.size() || offsetsEnd > header.size || pool.stringsStart > stringsEnd ||
+      stringsEnd > header.size) {
+    throw std::logic_error("invalid string pool header");
+  }
+  auto offsets = std::vector<uint32_t>(pool.stringCount);
+  memcpy(offsets.data(), chunk.data() + header.headerSize, offsets.size() * sizeof(uint32_t));
+  auto styleOffsets = std::vector<uint32_t>(pool.styleCount);
+  if (!styleOffsets.empty()) {
+    memcpy(styleOffsets.data(), chunk.data() + header.headerSize + offsets.size() * sizeof(uint32_t), styleOffsets.size() * sizeof(uint32_t));
+  }
+  auto const strings = chunk.subspan(pool.stringsStart, stringsEnd - pool.stringsStart);
+  auto const styles = pool.styleCount > 0 ? chunk.subspan(pool.stylesStart, header.size - pool.stylesStart) : std::span<std::byte const>();
+  return StringPool(strings, std::move(offsets), (pool.flags & RES_FLAG_UTF8) == RES_FLAG_UTF8, styles, std::move(styleOffsets));
+}
+
+auto StringPool::operator[](std::size_t const index) const -> std::string_view {
+  if (index >= offsets_.size()) {
+    throw std::logic_error("invalid string index");
+  }
+  if (utf8Encoded_) {
+    return decodeUtf8(offsets_[index]);
+  }
+  auto &decodedString = decodedStrings_[index];
+  if (!decodedString) {
+    decodedString = decodeUtf16(offsets_[index]);
+  }
+  return *decodedString;
+}
+
+auto StringPool::contains(std::string_view const string) const -> bool {
+  for (auto i{0U}; i < offsets_.size(); i++) {
+    if ((*this)[i] == string) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto StringPool::styles(std::size_t const index) const -> std::vector<ResStringPoolSpan> {
+  auto spans = std::vector<ResStringPoolSpan>();
+  if (index >= styleOffsets_.size()) {
+    return spans;
+  }
+  for (auto offset = std::size_t{styleOffsets_[index]};; offset += sizeof(ResStringPoolSpan)) {
+    auto const span = readResStruct<ResStringPoolSpan>(styles_, offset, "invalid string pool style", sizeof(uint32_t));
+    if (span.name == RES_STRING_POOL_SPAN_END) {
+      return spans;
+    }
+    spans.push_back(readResStruct<ResStringPoolSpan>(styles_, offset, "invalid string pool style"));
+  }
+}
+
+auto StringPool::styledString(std::size_t const index) const -> std::string {
+  auto const string = (*this)[index];
+  auto spans = styles(index);
+  auto styled = std::string();
+  if (spans.empty()) {
+    utils::xml::appendEscaped(string, styled);
+    return styled;
+  }
+
+  //
+  // Spans are opened in order of their first unit, outer ones first, and
+  // closed past their last one; positions count UTF-16 units, of which
+  // four byte sequences take two.
+  //
+  std::stable_sort(spans.begin(), spans.end(), [](auto const &left, auto const &right) {
+    return left.firstChar < right.firstChar || (left.firstChar == right.firstChar && left.lastChar > right.lastChar);
+  });
+  styled.reserve(string.size() + spans.size() * 8);
+  auto open = std::vector<ResStringPoolSpan>();
+  auto next = spans.begin();
+  auto unit = uint32_t{0};
+
+  //
+  // Text between tags is escaped in runs, written out before each tag.
+  //
+  auto runStart = std::size_t{0};
+  auto const appendRun = [&string, &styled, &runStart](std::size_t const runEnd) {
+    utils::xml::appendEscaped(string.substr(runStart, runEnd - runStart), styled);
+    runStart = runEnd;
+  };
+  for (auto position = std::size_t{0};;) {
+    while (!open.empty() && open.back().lastChar < unit) {
+      appendRun(position);
+      appendClosingTag(styled, (*this)[open.back().name]);
+      open.pop_back();
+    }
+    for (; next != spans.end() && next->firstChar <= unit; next++) {
+      appendRun(position);
+      appendOpeningTag(styled, (*this)[next->name]);
+      open.push_back(*next);
+    }
+    if (position == string.size()) {
+      break;
+    }
+    auto const length = std::min(getSequenceLength(string[position]), string.size() - position);
+    position += length;
+    unit += length == 4 ? 2 : 1;
+  }
+  appendRun(string.size());
+  for (; !open.empty(); open.pop_back()) {
+    appendClosingTag(styled, (*this)[open.back().name]);
+  }
+  return styled;
+}
+
+auto StringPool::entry(std::size_t const index) const -> std::span<std::byte const> {
+  if (index >= offsets_.size()) {
+    throw std::logic_error("invalid string index");
+  }
+  auto const offset = std::size_t{offsets_[index]};
+  auto position = offset;
+  auto size = std::size_t{0};
+  if (utf8Encoded_) {
+    readLength<uint8_t>(strings_, position);
+    size = readLength<uint8_t>(strings_, position) + sizeof(char);
+  } else {
+    size = (readLength<uint16_t>(strings_, position) + 1) * sizeof(char16_t);
+  }
+  if (position + size > strings_.size()) {
+    throw std::logic_error("invalid string pool entry");
+  }
+  return strings_.subspan(offset, position + size - offset);
+}
+
+auto StringPool::decodeUtf8(uint32_t const offset) const -> std::string_view {
+  auto position = std::size_t{offset};
+  readLength<uint8_t>(strings_, position);
+  auto const length = readLength<uint8_t>(strings_, position);
+  if (position + length > strings_.size()) {
+    throw std::logic_error("invalid string pool entry");
+  }
+  return std::string_view(reinterpret_cast<char const *>(strings_.data() + position), length);
+}
+
+auto StringPool::decodeUtf16(uint32_t const offset) const -> std::string {
+  TRACE_ACCUMULATE("StringPool::decodeUtf16");
+  auto position = std::size_t{offset};
+  auto const length = readLength<uint16_t>(strings_, position);
+  if (position + length * sizeof(char16_t) > strings_.size()) {
+    throw std::logic_error("invalid string pool entry");
+  }
+  return utils::unicode::toUtf8(strings_.subspan(position, length * sizeof(char16_t)));
+}
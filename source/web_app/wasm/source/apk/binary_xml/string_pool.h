@@ -0,0 +1,111 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_STRING_POOL_H_
+#define ANDROID_INTROSPECTION_APK_STRING_POOL_H_
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "resource_structs.h"
+
+namespace ai {
+
+//
+// Read only view of a ResStringPool, of a binary xml file or of any of the
+// value, type and key pools of a resource table.  Strings of UTF-8 pools are
+// handed out as views straight into the pool bytes; strings of UTF-16 pools
+// are converted on first access and kept for later lookups.  The pool bytes
+// must outlive the pool, and lookups are not thread safe.
+//
+class StringPool final {
+public:
+  StringPool() = default;
+
+  StringPool(std::span<std::byte const> strings, std::vector<uint32_t> offsets, bool utf8Encoded, std::span<std::byte const> styles = {},
+             std::vector<uint32_t> styleOffsets = {});
+
+  //
+  // Pool of a whole RES_STRING_POOL_TYPE chunk, with its styles.
+  //
+  static auto read(std::span<std::byte const> chunk) -> StringPool;
+
+  auto size() const -> std::size_t { return offsets_.size(); }
+
+  auto isUtf8Encoded() const -> bool { return utf8Encoded_; }
+
+  //
+  // Views are valid for the lifetime of the pool.
+  //
+  auto operator[](std::size_t index) const -> std::string_view;
+
+  auto contains(std::string_view string) const -> bool;
+
+  //
+  // Strings with markup are the first styleCount() of the pool.
+  //
+  auto styleCount() const -> std::size_t { return styleOffsets_.size(); }
+
+  //
+  // Spans of the string, without the end marker; none if it has no markup.
+  //
+  auto styles(std::size_t index) const -> std::vector<ResStringPoolSpan>;
+
+  //
+  // The string with its spans written as tags the way apktool writes them,
+  // e.g. "<b>bold</b>" or "<font color=\"#ff0000\">red</font>".  The text and
+  // the tag attribute values are xml escaped, also in strings without markup.
+  //
+  auto styledString(std::size_t index) const -> std::string;
+
+  //
+  // Encoded entry of the string as stored in the pool, i.e. with its length
+  // prefix and terminator but without padding.
+  //
+  auto entry(std::size_t index) const -> std::span<std::byte const>;
+
+private:
+  auto decodeUtf8(uint32_t offset) const -> std::string_view;
+
+  auto decodeUtf16(uint32_t offset) const -> std::string;
+
+  std::span<std::byte const> strings_;
+
+  std::vector<uint32_t> offsets_;
+
+  bool utf8Encoded_ = false;
+
+  std::span<std::byte const> styles_;
+
+  std::vector<uint32_t> styleOffsets_;
+
+  mutable std::vector<std::optional<std::string>> decodedStrings_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_STRING_POOL_H_ */
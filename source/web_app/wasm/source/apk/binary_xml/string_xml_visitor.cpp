@@ -21,39 +21,145 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
+#define LOG_MODULE LOG_MODULE_BINARY_XML
+
+#include <algorithm>
+
+#include "res_value.h"
 #include "string_xml_visitor.h"
-#include "utils/macros.h"
+#include "utils/log.h"
+#include "utils/xml_escape.h"
 
 using namespace ai;
 
-StringXmlVisitor::StringXmlVisitor(std::string &xml, bool const isStringsUtf8Encoded) : isStringsUtf8Encoded_(isStringsUtf8Encoded), xml_(xml) {
-  xml_ += getAndroidManifestHeader();
+namespace {
+
+static constexpr std::size_t INDENT_SIZE = 2;
+
+//
+// Writes the tag name and attributes, sorted by name, keeping the last of
+// attributes with the same name.
+//
+auto appendStartTag(std::string &xml, XmlStartElement const &element, std::vector<XmlAttribute> &attributes, ResourceResolver *const resolver) -> void {
+  xml += '<';
+  xml += element.name();
+  attributes.assign(element.attributes.begin(), element.attributes.end());
+  std::stable_sort(attributes.begin(), attributes.end(), [](XmlAttribute const &a, XmlAttribute const &b) { return a.name() < b.name(); });
+  for (std::size_t i{0}; i < attributes.size(); i++) {
+    auto const &attribute = attributes[i];
+    auto const attributeName = attribute.name();
+    if (attributeName.empty()) {
+      LOGW("unexpected empty attribute name");
+      continue;
+    }
+    if (i + 1 < attributes.size() && attributes[i + 1].name() == attributeName) {
+      continue;
+    }
+    xml += ' ';
+    xml += attributeName;
+    xml += "=\"";
+    if (attribute.type == TYPE_STRING) {
+      utils::xml::appendEscaped((*attribute.strings)[attribute.rawValueIndex], xml);
+    } else if (attribute.type == TYPE_REFERENCE && resolver != nullptr) {
+      utils::xml::appendEscaped(resolver->getReference(attribute.data), xml);
+    } else {
+      auto buffer = ResValueBuffer();
+      utils::xml::appendEscaped(formatResValue(attribute.type, attribute.data, buffer), xml);
+    }
+    xml += '"';
+  }
 }
 
-auto StringXmlVisitor::visit(StartXmlTagElement const &element) -> void {
-  xml_ += "<";
-  xml_ += element.tag();
-  for (auto const &[attributeName, attributeValue] : element.attributes()) {
-    xml_ += " ";
-    xml_ += attributeName;
-    xml_ += "=";
-    xml_ += "\"" + attributeValue + "\"";
+} // namespace
+
+StringXmlVisitor::StringXmlVisitor(std::string &xml, bool const isStringsUtf8Encoded, std::size_t const capacity, FlushCallback flush,
+                                   ResourceResolver *const resolver)
+    : xml_(xml), flush_(std::move(flush)), resolver_(resolver) {
+  xml_.reserve(flush_ ? std::min(capacity, FLUSH_SIZE) + FLUSH_SIZE / 4 : capacity);
+  xml_ += isStringsUtf8Encoded ? "<?xml version=\"1.0\" encoding=\"utf-8\"?>" : "<?xml version=\"1.0\" encoding=\"utf-16\"?>";
+}
+
+auto StringXmlVisitor::estimateSize(std::size_t const documentSize) -> std::size_t {
+  //
+  // Names and values are shared through the string pool and every node
+  // carries a fixed size header, so the text mostly comes out at half to
+  // two thirds of the binary document.
+  //
+  return documentSize * 3 / 4;
+}
+
+auto StringXmlVisitor::onStartElement(XmlStartElement const &element) -> void {
+  closeStartTag();
+  if (tags_ != nullptr) {
+    tags_->push_back(XmlTagRange{flushed_ + xml_.size(), 0, depth_, false});
   }
-  xml_ += ">";
+  writeIndent();
+  appendStartTag(xml_, element, attributes_, resolver_);
+  startTagOpen_ = true;
   depth_++;
 }
 
-auto StringXmlVisitor::visit(EndXmlTagElement const &element) -> void {
-  xml_ += "</";
-  xml_ += element.tag();
-  xml_ += ">";
-  depth_--;
+auto StringXmlVisitor::onEndElement(XmlEndElement const &element) -> void {
+  if (depth_ > 0) {
+    depth_--;
+  }
+  if (startTagOpen_) {
+    xml_ += "/>";
+    startTagOpen_ = false;
+    endTag(true);
+  } else {
+    writeIndent();
+    xml_ += "</";
+    xml_ += element.name();
+    xml_ += '>';
+  }
+  flushIfFull();
+}
+
+auto StringXmlVisitor::finish() -> void {
+  closeStartTag();
+  xml_ += '\n';
+  if (flush_) {
+    flush_(xml_);
+    flushed_ += xml_.size();
+    xml_.clear();
+  }
 }
 
-auto StringXmlVisitor::visit(InvalidXmlTagElement const &element) -> void { utils::ignore(element); }
+auto StringXmlVisitor::renderStartTag(XmlStartElement const &element, XmlTagRange const &tag, ResourceResolver *const resolver) -> std::string {
+  auto xml = std::string("\n");
+  xml.append(tag.depth * INDENT_SIZE, ' ');
+  auto attributes = std::vector<XmlAttribute>();
+  appendStartTag(xml, element, attributes, resolver);
+  xml += tag.selfClosing ? "/>" : ">";
+  return xml;
+}
 
-auto StringXmlVisitor::visit(CDataTagElement const &element) -> void { utils::ignore(element); }
+auto StringXmlVisitor::writeIndent() -> void {
+  xml_ += '\n';
+  xml_.append(depth_ * INDENT_SIZE, ' ');
+}
 
-auto StringXmlVisitor::getAndroidManifestHeader() const -> char const * {
-  return isStringsUtf8Encoded_ ? "<?xml version=\"1.0\" encoding=\"utf-8\"?>" : "<?xml version=\"1.0\" encoding=\"utf-16\"?>";
+auto StringXmlVisitor::closeStartTag() -> void {
+  if (startTagOpen_) {
+    xml_ += '>';
+    startTagOpen_ = false;
+    endTag(false);
+  }
+}
+
+auto StringXmlVisitor::flushIfFull() -> void {
+  if (flush_ && xml_.size() >= FLUSH_SIZE) {
+    flush_(xml_);
+    flushed_ += xml_.size();
+    xml_.clear();
+  }
+}
+
+auto StringXmlVisitor::endTag(bool const selfClosing) -> void {
+  if (tags_ != nullptr) {
+    auto &tag = tags_->back();
+    tag.size = flushed_ + xml_.size() - tag.offset;
+    tag.selfClosing = selfClosing;
+  }
 }
@@ -24,33 +24,106 @@
 #ifndef ANDROID_INTROSPECTION_APK_STRING_XML_VISITOR_H_
 #define ANDROID_INTROSPECTION_APK_STRING_XML_VISITOR_H_
 
-#include "binary_xml_visitor.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "resource_resolver.h"
+#include "xml_traversal.h"
 
 namespace ai {
 
-class StringXmlVisitor : public BinaryXmlVisitor {
+//
+// Text of the start tag of an element in the rendered document, from the
+// line break before it to its closing bracket.
+//
+struct XmlTagRange {
+
+  std::size_t offset;
+
+  std::size_t size;
+
+  uint32_t depth;
 
+  bool selfClosing;
+};
+
+//
+// Renders the document as indented xml text for the templated traversal.
+// Output goes into a single buffer reserved up front; with a flush callback
+// the buffer is handed over and reused whenever it fills up, so large
+// documents can be consumed while they are still being rendered.
+// Attributes are written sorted by name and their values escaped; with a
+// resolver, references are written by name.
+//
+class StringXmlVisitor final {
 public:
-  StringXmlVisitor(std::string &xml, bool const isStringsUtf8Encoded);
+  using FlushCallback = std::function<void(std::string_view)>;
+
+  static constexpr std::size_t FLUSH_SIZE = 64 * 1024;
 
-  ~StringXmlVisitor() override = default;
+  StringXmlVisitor(std::string &xml, bool isStringsUtf8Encoded, std::size_t capacity = 0, FlushCallback flush = {},
+                   ResourceResolver *resolver = nullptr);
 
-  auto visit(StartXmlTagElement const &element) -> void override;
+  auto onStartElement(XmlStartElement const &element) -> void;
 
-  auto visit(EndXmlTagElement const &element) -> void override;
+  auto onEndElement(XmlEndElement const &element) -> void;
 
-  auto visit(CDataTagElement const &element) -> void override;
+  //
+  // Hands what is left in the buffer to the flush callback, if any.
+  //
+  auto finish() -> void;
 
-  auto visit(InvalidXmlTagElement const &element) -> void override;
+  //
+  // Records the range of every start tag, in document order, as offsets
+  // into the whole text rather than the buffer.
+  //
+  auto recordTags(std::vector<XmlTagRange> &tags) -> void { tags_ = &tags; }
+
+  //
+  // Renders the start tag of the element as it appears in a rendering whose
+  // range for it is tag, for splicing in place of that range after an edit.
+  //
+  static auto renderStartTag(XmlStartElement const &element, XmlTagRange const &tag, ResourceResolver *resolver) -> std::string;
+
+  //
+  // Rough size of the xml text for a binary document of the given size.
+  //
+  static auto estimateSize(std::size_t documentSize) -> std::size_t;
 
 private:
-  auto getAndroidManifestHeader() const -> char const *;
+  auto writeIndent() -> void;
+
+  auto closeStartTag() -> void;
 
-  bool const isStringsUtf8Encoded_;
+  auto flushIfFull() -> void;
+
+  //
+  // Completes the range of the start tag just closed.
+  //
+  auto endTag(bool selfClosing) -> void;
 
   std::string &xml_;
 
+  FlushCallback flush_;
+
+  ResourceResolver *resolver_;
+
+  std::vector<XmlAttribute> attributes_;
+
+  std::vector<XmlTagRange> *tags_ = nullptr;
+
+  //
+  // Bytes handed to the flush callback so far.
+  //
+  std::size_t flushed_ = 0;
+
   uint32_t depth_ = 0;
+
+  bool startTagOpen_ = false;
 };
 
 } // namespace ai
@@ -0,0 +1,259 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+#include "resource_structs.h"
+#include "resource_types.h"
+#include "xml_encoder.h"
+#include "xml_patch.h"
+#include "xml_traversal.h"
+#include "utils/little_endian.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// The string pool chunk directly follows the ResXMLTree_header.
+//
+static constexpr std::size_t POOL_OFFSET = XML_CHUNK_HEADER_SIZE;
+
+static constexpr std::size_t POOL_HEADER_SIZE = sizeof(ResStringPoolHeader);
+static constexpr std::size_t CHUNK_SIZE_OFFSET = offsetof(ResChunkHeader, size);
+static constexpr std::size_t POOL_STYLE_COUNT_OFFSET = offsetof(ResStringPoolHeader, styleCount);
+static constexpr std::size_t POOL_FLAGS_OFFSET = offsetof(ResStringPoolHeader, flags);
+
+//
+// Offsets of string references within a ResXMLTree_node and its extensions.
+//
+static constexpr std::size_t NODE_HEADER_SIZE = sizeof(ResXMLTreeNode);
+static constexpr std::size_t NODE_COMMENT_OFFSET = offsetof(ResXMLTreeNode, comment);
+static constexpr std::size_t NAMESPACE_EXTENSION_SIZE = sizeof(ResXMLTreeNamespaceExt);
+static constexpr std::size_t END_ELEMENT_EXTENSION_SIZE = sizeof(ResXMLTreeEndElementExt);
+static constexpr std::size_t CDATA_EXTENSION_SIZE = sizeof(ResXMLTreeCdataExt);
+static constexpr std::size_t CDATA_TYPE_OFFSET = offsetof(ResXMLTreeCdataExt, typedData) + offsetof(ResValue, dataType);
+static constexpr std::size_t CDATA_DATA_OFFSET = offsetof(ResXMLTreeCdataExt, typedData) + offsetof(ResValue, data);
+static constexpr std::size_t ATTRIBUTE_RAW_VALUE_OFFSET = offsetof(ResXMLTreeAttribute, rawValue);
+static constexpr std::size_t ATTRIBUTE_DATA_OFFSET = offsetof(ResXMLTreeAttribute, typedValue) + offsetof(ResValue, data);
+
+static constexpr uint32_t NO_STRING = UINT32_MAX;
+
+using ai::utils::little_endian::store;
+
+template <typename T> auto load(std::span<std::byte const> const bytes, std::size_t const offset) -> T {
+  return utils::little_endian::load<T>(bytes, offset, "invalid xml document offset");
+}
+
+auto requireExtension(XmlChunk const &chunk, std::size_t const extensionSize) -> void {
+  if (chunk.headerSize < NODE_HEADER_SIZE || chunk.size < chunk.headerSize + extensionSize) {
+    throw std::logic_error("invalid xml node chunk");
+  }
+}
+
+//
+// Calls back with the offset, relative to the chunk, of every string index
+// the chunk at offset holds.  Chunks other than xml nodes hold none.
+//
+template <typename Callback>
+auto forEachStringReference(std::span<std::byte const> const document, std::size_t const offset, XmlChunk const &chunk, Callback &&callback) -> void {
+  if (chunk.type < RES_XML_FIRST_CHUNK_TYPE || chunk.type > RES_XML_LAST_CHUNK_TYPE) {
+    return;
+  }
+  requireExtension(chunk, 0);
+  callback(NODE_COMMENT_OFFSET);
+  auto const extension = std::size_t{chunk.headerSize};
+  switch (chunk.type) {
+  case RES_XML_START_NAMESPACE_TYPE:
+  case RES_XML_END_NAMESPACE_TYPE: {
+    requireExtension(chunk, NAMESPACE_EXTENSION_SIZE);
+    callback(extension);
+    callback(extension + sizeof(uint32_t));
+    break;
+  }
+  case RES_XML_START_ELEMENT_TYPE: {
+    auto const strings = StringPool();
+    auto const element = readXmlStartElement(document, offset, chunk, strings);
+    callback(extension);
+    callback(extension + sizeof(uint32_t));
+    for (auto const &attribute : element.attributes) {
+      auto const attributeOffset = attribute.offset - offset;
+      callback(attributeOffset);
+      callback(attributeOffset + sizeof(uint32_t));
+      callback(attributeOffset + ATTRIBUTE_RAW_VALUE_OFFSET);
+      if (attribute.type == TYPE_STRING) {
+        callback(attributeOffset + ATTRIBUTE_DATA_OFFSET);
+      }
+    }
+    break;
+  }
+  case RES_XML_END_ELEMENT_TYPE: {
+    requireExtension(chunk, END_ELEMENT_EXTENSION_SIZE);
+    callback(extension);
+    callback(extension + sizeof(uint32_t));
+    break;
+  }
+  case RES_XML_CDATA_TYPE: {
+    requireExtension(chunk, CDATA_EXTENSION_SIZE);
+    callback(extension);
+    if (load<uint8_t>(document, offset + extension + CDATA_TYPE_OFFSET) == TYPE_STRING) {
+      callback(extension + CDATA_DATA_OFFSET);
+    }
+    break;
+  }
+  default: {
+    break;
+  }
+  }
+}
+
+} // namespace
+
+auto ai::encodeXml(std::span<std::byte const> const document, StringPool const &strings) -> std::vector<std::byte> {
+  if (load<uint32_t>(document, POOL_OFFSET + POOL_STYLE_COUNT_OFFSET) != 0) {
+    throw std::logic_error("unable to encode xml; styled strings are not supported");
+  }
+  auto const flags = load<uint32_t>(document, POOL_OFFSET + POOL_FLAGS_OFFSET) & RES_FLAG_UTF8;
+  auto const firstChunkOffset = POOL_OFFSET + load<uint32_t>(document, POOL_OFFSET + CHUNK_SIZE_OFFSET);
+  auto const resourceIds = getXmlResourceIds(document);
+
+  //
+  // First walk collects the strings that are referenced and the size of the
+  // chunks that are kept; the resource map is written anew.
+  //
+  auto referenced = std::vector<bool>(strings.size());
+  auto nodesSize = uint64_t{0};
+  for (auto offset = firstChunkOffset; offset + XML_CHUNK_HEADER_SIZE <= document.size();) {
+    auto const chunk = readXmlChunk(document, offset);
+    if (chunk.type != RES_XML_RESOURCE_MAP_TYPE) {
+      nodesSize += chunk.size;
+      forEachStringReference(document, offset, chunk, [&](std::size_t const referenceOffset) {
+        auto const index = load<uint32_t>(document, offset + referenceOffset);
+        if (index != NO_STRING && index >= strings.size()) {
+          throw std::logic_error("invalid string index");
+        }
+        if (index != NO_STRING) {
+          referenced[index] = true;
+        }
+      });
+    }
+    offset += chunk.size;
+  }
+
+  auto indexes = std::vector<uint32_t>(strings.size(), NO_STRING);
+  auto order = std::vector<uint32_t>();
+  {
+    auto mappedStrings = std::map<std::pair<uint32_t, std::string_view>, uint32_t>();
+    for (auto i{0U}; i < std::min(resourceIds.size(), strings.size()); i++) {
+      if (referenced[i] && resourceIds[i] != 0) {
+        auto const [mappedString, inserted] = mappedStrings.try_emplace({resourceIds[i], strings[i]}, static_cast<uint32_t>(order.size()));
+        if (inserted) {
+          order.push_back(i);
+        }
+        indexes[i] = mappedString->second;
+      }
+    }
+  }
+  auto const mappedCount = order.size();
+  {
+    auto unmappedStrings = std::vector<uint32_t>();
+    for (auto i{0U}; i < strings.size(); i++) {
+      if (referenced[i] && indexes[i] == NO_STRING) {
+        unmappedStrings.push_back(i);
+      }
+    }
+    std::stable_sort(unmappedStrings.begin(), unmappedStrings.end(), [&strings](uint32_t const a, uint32_t const b) { return strings[a] < strings[b]; });
+    for (auto const i : unmappedStrings) {
+      if (order.size() == mappedCount || strings[order.back()] != strings[i]) {
+        order.push_back(i);
+      }
+      indexes[i] = static_cast<uint32_t>(order.size() - 1);
+    }
+  }
+
+  auto stringsSize = std::size_t{0};
+  for (auto const i : order) {
+    stringsSize += strings.entry(i).size();
+  }
+  auto const stringsStart = POOL_HEADER_SIZE + order.size() * sizeof(uint32_t);
+  auto const poolSize = stringsStart + ((stringsSize + 3) & ~std::size_t{3});
+  auto const mapSize = mappedCount > 0 ? XML_CHUNK_HEADER_SIZE + mappedCount * sizeof(uint32_t) : 0;
+  auto const documentSize = uint64_t{XML_CHUNK_HEADER_SIZE} + poolSize + mapSize + nodesSize;
+  if (documentSize > UINT32_MAX) {
+    throw std::logic_error("unable to encode xml; document too large");
+  }
+
+  auto encoded = std::vector<std::byte>(static_cast<std::size_t>(documentSize));
+  auto const output = std::span<std::byte>(encoded);
+  store(output, 0, uint16_t{RES_XML_TYPE});
+  store(output, 2, static_cast<uint16_t>(XML_CHUNK_HEADER_SIZE));
+  store(output, 4, static_cast<uint32_t>(documentSize));
+
+  auto position = POOL_OFFSET;
+  store(output, position, uint16_t{RES_STRING_POOL_TYPE});
+  store(output, position + 2, static_cast<uint16_t>(POOL_HEADER_SIZE));
+  store(output, position + 4, static_cast<uint32_t>(poolSize));
+  store(output, position + 8, static_cast<uint32_t>(order.size()));
+  store(output, position + 12, uint32_t{0});
+  store(output, position + 16, flags);
+  store(output, position + 20, static_cast<uint32_t>(stringsStart));
+  store(output, position + 24, uint32_t{0});
+  auto stringOffset = std::size_t{0};
+  for (auto i{0U}; i < order.size(); i++) {
+    auto const entry = strings.entry(order[i]);
+    store(output, position + POOL_HEADER_SIZE + i * sizeof(uint32_t), static_cast<uint32_t>(stringOffset));
+    memcpy(output.data() + position + stringsStart + stringOffset, entry.data(), entry.size());
+    stringOffset += entry.size();
+  }
+  position += poolSize;
+
+  if (mappedCount > 0) {
+    store(output, position, uint16_t{RES_XML_RESOURCE_MAP_TYPE});
+    store(output, position + 2, static_cast<uint16_t>(XML_CHUNK_HEADER_SIZE));
+    store(output, position + 4, static_cast<uint32_t>(mapSize));
+    for (auto i{0U}; i < mappedCount; i++) {
+      store(output, position + XML_CHUNK_HEADER_SIZE + i * sizeof(uint32_t), resourceIds[order[i]]);
+    }
+    position += mapSize;
+  }
+
+  for (auto offset = firstChunkOffset; offset + XML_CHUNK_HEADER_SIZE <= document.size();) {
+    auto const chunk = readXmlChunk(document, offset);
+    if (chunk.type != RES_XML_RESOURCE_MAP_TYPE) {
+      memcpy(output.data() + position, document.data() + offset, chunk.size);
+      forEachStringReference(document, offset, chunk, [&](std::size_t const referenceOffset) {
+        if (auto const index = load<uint32_t>(document, offset + referenceOffset); index != NO_STRING) {
+          store(output, position + referenceOffset, indexes[index]);
+        }
+      });
+      position += chunk.size;
+    }
+    offset += chunk.size;
+  }
+  return encoded;
+}
@@ -0,0 +1,47 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_XML_ENCODER_H_
+#define ANDROID_INTROSPECTION_APK_XML_ENCODER_H_
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "string_pool.h"
+
+namespace ai {
+
+//
+// Encodes a document again from its chunks.  The string pool is rebuilt
+// from the strings the chunks reference: strings with a resource id come
+// first, in the order of the resource map, followed by the other strings
+// sorted and without duplicates.  Every reference in the chunks is remapped
+// to the new pool, and the output is sized up front and written in a single
+// pass.  Pools with styles are not supported.
+//
+auto encodeXml(std::span<std::byte const> document, StringPool const &strings) -> std::vector<std::byte>;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_XML_ENCODER_H_ */
@@ -0,0 +1,265 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include "resource_structs.h"
+#include "resource_types.h"
+#include "utils/little_endian.h"
+#include "utils/unicode.h"
+#include "xml_patch.h"
+#include "xml_traversal.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// The string pool chunk directly follows the ResXMLTree_header.
+//
+static constexpr std::size_t DOCUMENT_SIZE_OFFSET = offsetof(ResChunkHeader, size);
+static constexpr std::size_t POOL_OFFSET = XML_CHUNK_HEADER_SIZE;
+
+static constexpr std::size_t POOL_HEADER_SIZE_OFFSET = offsetof(ResChunkHeader, headerSize);
+static constexpr std::size_t CHUNK_SIZE_OFFSET = offsetof(ResChunkHeader, size);
+static constexpr std::size_t POOL_STRING_COUNT_OFFSET = offsetof(ResStringPoolHeader, stringCount);
+static constexpr std::size_t POOL_STYLE_COUNT_OFFSET = offsetof(ResStringPoolHeader, styleCount);
+static constexpr std::size_t POOL_FLAGS_OFFSET = offsetof(ResStringPoolHeader, flags);
+static constexpr std::size_t POOL_STRINGS_START_OFFSET = offsetof(ResStringPoolHeader, stringsStart);
+static constexpr std::size_t POOL_STYLES_START_OFFSET = offsetof(ResStringPoolHeader, stylesStart);
+
+//
+// Fields of the ResXMLTree_attrExt following the node header.
+//
+static constexpr std::size_t ATTRIBUTE_START_OFFSET = offsetof(ResXMLTreeAttrExt, attributeStart);
+static constexpr std::size_t ATTRIBUTE_SIZE_OFFSET = offsetof(ResXMLTreeAttrExt, attributeSize);
+static constexpr std::size_t ATTRIBUTE_COUNT_OFFSET = offsetof(ResXMLTreeAttrExt, attributeCount);
+static constexpr std::size_t ATTRIBUTE_ID_INDEX_OFFSET = offsetof(ResXMLTreeAttrExt, idIndex);
+static constexpr std::size_t ATTRIBUTE_STYLE_INDEX_OFFSET = offsetof(ResXMLTreeAttrExt, styleIndex);
+
+static constexpr std::size_t ATTRIBUTE_SIZE = sizeof(ResXMLTreeAttribute);
+static constexpr uint16_t RES_VALUE_SIZE = sizeof(ResValue);
+
+static constexpr uint32_t NO_STRING = UINT32_MAX;
+
+using ai::utils::little_endian::append;
+
+template <typename T> auto load(std::span<std::byte const> const document, std::size_t const offset) -> T {
+  return utils::little_endian::load<T>(document, offset, "invalid xml document offset");
+}
+
+template <typename T> auto store(std::vector<std::byte> &document, std::size_t const offset, T const value) -> void {
+  utils::little_endian::store(std::span(document), offset, value, "invalid xml document offset");
+}
+
+auto grow(std::vector<std::byte> &document, std::size_t const offset, std::size_t const bytes) -> void {
+  store(document, offset, static_cast<uint32_t>(load<uint32_t>(document, offset) + bytes));
+}
+
+auto insert(std::vector<std::byte> &document, std::size_t const offset, std::span<std::byte const> const bytes) -> void {
+  if (offset > document.size()) {
+    throw std::logic_error("invalid xml document offset");
+  }
+  document.insert(document.begin() + static_cast<std::ptrdiff_t>(offset), bytes.begin(), bytes.end());
+  grow(document, DOCUMENT_SIZE_OFFSET, bytes.size());
+}
+
+auto encodeString(std::string_view const string, bool const utf8Encoded) -> std::vector<std::byte> {
+  auto encoded = std::vector<std::byte>();
+  auto const utf16 = utils::unicode::toUtf16(string);
+  if (utf16.size() > 0x7fff || string.size() > 0x7fff) {
+    throw std::logic_error("string too long for string pool");
+  }
+  auto const appendLength8 = [&encoded](std::size_t const length) {
+    if (length > 0x7f) {
+      encoded.push_back(static_cast<std::byte>(0x80 | (length >> 8)));
+    }
+    encoded.push_back(static_cast<std::byte>(length & 0xff));
+  };
+  if (utf8Encoded) {
+    appendLength8(utf16.size());
+    appendLength8(string.size());
+    auto const bytes = reinterpret_cast<std::byte const *>(string.data());
+    encoded.insert(encoded.end(), bytes, bytes + string.size());
+    encoded.push_back(std::byte{0});
+  } else {
+    append(encoded, static_cast<uint16_t>(utf16.size()));
+    for (auto const unit : utf16) {
+      append(encoded, static_cast<uint16_t>(unit));
+    }
+    append(encoded, uint16_t{0});
+  }
+  encoded.resize((encoded.size() + 3) & ~std::size_t{3});
+  return encoded;
+}
+
+auto isInteger(uint8_t const type) -> bool { return type == TYPE_INT_DEC || type == TYPE_INT_HEX; }
+
+} // namespace
+
+auto ai::parseXmlTypedValue(std::string_view const value, uint8_t const currentType) -> std::optional<XmlTypedValue> {
+  if (currentType == TYPE_STRING) {
+    return std::nullopt;
+  }
+  if ((currentType == TYPE_NULL || currentType == TYPE_INT_BOOLEAN) && (value == "true" || value == "false")) {
+    return XmlTypedValue{TYPE_INT_BOOLEAN, value == "true" ? RES_VALUE_TRUE : RES_VALUE_FALSE, NO_STRING};
+  }
+  if (currentType != TYPE_NULL && !isInteger(currentType)) {
+    return std::nullopt;
+  }
+  auto const isHex = value.starts_with("0x") || value.starts_with("0X");
+  auto const digits = isHex ? value.substr(2) : value;
+  auto data = uint32_t{0};
+  auto result = std::from_chars_result{};
+  if (isHex) {
+    result = std::from_chars(digits.data(), digits.data() + digits.size(), data, 16);
+  } else {
+    auto signedData = int32_t{0};
+    result = std::from_chars(digits.data(), digits.data() + digits.size(), signedData);
+    data = static_cast<uint32_t>(signedData);
+  }
+  if (digits.empty() || result.ec != std::errc() || result.ptr != digits.data() + digits.size()) {
+    return std::nullopt;
+  }
+  return XmlTypedValue{isHex ? TYPE_INT_HEX : TYPE_INT_DEC, data, NO_STRING};
+}
+
+auto ai::patchXmlAttributeValue(std::vector<std::byte> &document, std::size_t const attributeOffset, XmlTypedValue const &value) -> void {
+  auto attribute = load<ResXMLTreeAttribute>(document, attributeOffset);
+  attribute.rawValue = value.rawValueIndex;
+  attribute.typedValue = ResValue{RES_VALUE_SIZE, 0, value.type, value.data};
+  store(document, attributeOffset, attribute);
+}
+
+auto ai::appendXmlString(std::vector<std::byte> &document, std::string_view const string, uint32_t const resourceId) -> uint32_t {
+  auto const headerSize = load<uint16_t>(document, POOL_OFFSET + POOL_HEADER_SIZE_OFFSET);
+  auto const poolSize = load<uint32_t>(document, POOL_OFFSET + CHUNK_SIZE_OFFSET);
+  auto const stringCount = load<uint32_t>(document, POOL_OFFSET + POOL_STRING_COUNT_OFFSET);
+  auto const styleCount = load<uint32_t>(document, POOL_OFFSET + POOL_STYLE_COUNT_OFFSET);
+  auto const flags = load<uint32_t>(document, POOL_OFFSET + POOL_FLAGS_OFFSET);
+  auto const stringsStart = load<uint32_t>(document, POOL_OFFSET + POOL_STRINGS_START_OFFSET);
+  auto const stylesStart = load<uint32_t>(document, POOL_OFFSET + POOL_STYLES_START_OFFSET);
+  auto const stringsEnd = styleCount > 0 ? stylesStart : poolSize;
+  if (stringsEnd < stringsStart || stringsEnd > poolSize || POOL_OFFSET + poolSize > document.size()) {
+    throw std::logic_error("invalid xml string pool");
+  }
+
+  //
+  // The string goes behind the last string and its offset behind the last
+  // string offset; insert the later one first so the earlier position holds.
+  //
+  auto const encoded = encodeString(string, (flags & RES_FLAG_UTF8) == RES_FLAG_UTF8);
+  insert(document, POOL_OFFSET + stringsEnd, encoded);
+  auto offset = std::vector<std::byte>();
+  append(offset, stringsEnd - stringsStart);
+  insert(document, POOL_OFFSET + headerSize + std::size_t{stringCount} * sizeof(uint32_t), offset);
+
+  auto const addedBytes = static_cast<uint32_t>(sizeof(uint32_t) + encoded.size());
+  store(document, POOL_OFFSET + POOL_STRING_COUNT_OFFSET, stringCount + 1);
+  store(document, POOL_OFFSET + POOL_STRINGS_START_OFFSET, static_cast<uint32_t>(stringsStart + sizeof(uint32_t)));
+  if (styleCount > 0) {
+    store(document, POOL_OFFSET + POOL_STYLES_START_OFFSET, stylesStart + addedBytes);
+  }
+  store(document, POOL_OFFSET + CHUNK_SIZE_OFFSET, poolSize + addedBytes);
+
+  if (resourceId != 0) {
+    //
+    // Strings between the last mapped one and the new one get id 0, which is
+    // what the platform also reports for strings past the end of the map.
+    //
+    auto const mapOffset = POOL_OFFSET + poolSize + addedBytes;
+    auto ids = std::vector<std::byte>();
+    if (mapOffset + XML_CHUNK_HEADER_SIZE <= document.size() && load<uint16_t>(document, mapOffset) == RES_XML_RESOURCE_MAP_TYPE) {
+      auto const chunk = readXmlChunk(document, mapOffset);
+      auto const mappedStrings = (chunk.size - chunk.headerSize) / sizeof(uint32_t);
+      if (mappedStrings > stringCount) {
+        throw std::logic_error("invalid xml resource map");
+      }
+      ids.resize((stringCount + 1 - mappedStrings) * sizeof(uint32_t));
+      memcpy(ids.data() + ids.size() - sizeof(uint32_t), &resourceId, sizeof(resourceId));
+      insert(document, mapOffset + chunk.size, ids);
+      grow(document, mapOffset + CHUNK_SIZE_OFFSET, ids.size());
+    } else {
+      append(ids, RES_XML_RESOURCE_MAP_TYPE);
+      append(ids, static_cast<uint16_t>(XML_CHUNK_HEADER_SIZE));
+      append(ids, static_cast<uint32_t>(XML_CHUNK_HEADER_SIZE + (stringCount + 1) * sizeof(uint32_t)));
+      ids.resize(ids.size() + std::size_t{stringCount} * sizeof(uint32_t));
+      append(ids, resourceId);
+      insert(document, mapOffset, ids);
+    }
+  }
+  return stringCount;
+}
+
+auto ai::getXmlResourceIds(std::span<std::byte const> const document) -> std::vector<uint32_t> {
+  auto const mapOffset = POOL_OFFSET + load<uint32_t>(document, POOL_OFFSET + CHUNK_SIZE_OFFSET);
+  auto ids = std::vector<uint32_t>();
+  if (mapOffset + XML_CHUNK_HEADER_SIZE > document.size() || load<uint16_t>(document, mapOffset) != RES_XML_RESOURCE_MAP_TYPE) {
+    return ids;
+  }
+  auto const chunk = readXmlChunk(document, mapOffset);
+  ids.resize((chunk.size - chunk.headerSize) / sizeof(uint32_t));
+  memcpy(ids.data(), document.data() + mapOffset + chunk.headerSize, ids.size() * sizeof(uint32_t));
+  return ids;
+}
+
+auto ai::insertXmlAttribute(std::vector<std::byte> &document, std::size_t const chunkOffset, uint16_t const position, XmlAttributeRecord const &attribute)
+    -> void {
+  auto const chunk = readXmlChunk(document, chunkOffset);
+  auto const strings = StringPool();
+  auto const element = readXmlStartElement(document, chunkOffset, chunk, strings);
+  auto const extension = chunkOffset + chunk.headerSize;
+  auto const attributeStart = load<uint16_t>(document, extension + ATTRIBUTE_START_OFFSET);
+  auto const attributeCount = static_cast<uint16_t>(element.attributes.size());
+  auto const attributeSize = attributeCount > 0 ? load<uint16_t>(document, extension + ATTRIBUTE_SIZE_OFFSET) : static_cast<uint16_t>(ATTRIBUTE_SIZE);
+  if (position > attributeCount || attributeCount == UINT16_MAX) {
+    throw std::logic_error("invalid xml attribute position");
+  }
+
+  auto record = std::vector<std::byte>();
+  append(record, attribute.namespaceIndex);
+  append(record, attribute.nameIndex);
+  append(record, attribute.value.rawValueIndex);
+  append(record, RES_VALUE_SIZE);
+  append(record, uint8_t{0});
+  append(record, attribute.value.type);
+  append(record, attribute.value.data);
+  record.resize(attributeSize);
+  insert(document, extension + attributeStart + std::size_t{position} * attributeSize, record);
+
+  grow(document, chunkOffset + CHUNK_SIZE_OFFSET, record.size());
+  store(document, extension + ATTRIBUTE_SIZE_OFFSET, attributeSize);
+  store(document, extension + ATTRIBUTE_COUNT_OFFSET, static_cast<uint16_t>(attributeCount + 1));
+
+  //
+  // The id, class and style attribute indexes are one based, zero is none.
+  //
+  for (auto offset = ATTRIBUTE_ID_INDEX_OFFSET; offset <= ATTRIBUTE_STYLE_INDEX_OFFSET; offset += sizeof(uint16_t)) {
+    if (auto const index = load<uint16_t>(document, extension + offset); index > position) {
+      store(document, extension + offset, static_cast<uint16_t>(index + 1));
+    }
+  }
+}
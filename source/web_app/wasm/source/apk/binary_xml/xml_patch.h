@@ -0,0 +1,92 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_XML_PATCH_H_
+#define ANDROID_INTROSPECTION_APK_XML_PATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace ai {
+
+//
+// Typed value of an attribute, i.e. the Res_value and raw value string of a
+// ResXMLTree_attribute.
+//
+struct XmlTypedValue {
+
+  uint8_t type;
+
+  uint32_t data;
+
+  uint32_t rawValueIndex;
+};
+
+struct XmlAttributeRecord {
+
+  uint32_t namespaceIndex;
+
+  uint32_t nameIndex;
+
+  XmlTypedValue value;
+};
+
+//
+// Typed value for a value given as text, e.g. "true" or "0x10", or
+// std::nullopt if it can only be stored as a string.  If the attribute
+// already has a type (TYPE_NULL for new attributes) numbers and booleans
+// are only accepted where that type allows them.
+//
+auto parseXmlTypedValue(std::string_view value, uint8_t currentType) -> std::optional<XmlTypedValue>;
+
+//
+// Edits below work directly on the document bytes and only touch what they
+// have to: a value is rewritten in place, a string is appended to the end of
+// the pool and an attribute is spliced into its element chunk, fixing up the
+// sizes, counts and indexes that cover it.  Insertions move the chunks that
+// follow, so offsets and views into the document must be recomputed after
+// them.
+//
+auto patchXmlAttributeValue(std::vector<std::byte> &document, std::size_t attributeOffset, XmlTypedValue const &value) -> void;
+
+//
+// Appends a string to the pool and returns its index.  A non zero resource
+// id is recorded in the resource map, which grows as needed.
+//
+auto appendXmlString(std::vector<std::byte> &document, std::string_view string, uint32_t resourceId) -> uint32_t;
+
+//
+// Resource ids of the attribute names, indexed by string; empty without a
+// resource map.
+//
+auto getXmlResourceIds(std::span<std::byte const> document) -> std::vector<uint32_t>;
+
+auto insertXmlAttribute(std::vector<std::byte> &document, std::size_t chunkOffset, uint16_t position, XmlAttributeRecord const &attribute) -> void;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_XML_PATCH_H_ */
@@ -0,0 +1,107 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <stdexcept>
+
+#include "res_value.h"
+#include "xml_traversal.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr uint32_t NO_STRING = UINT32_MAX;
+
+auto getString(StringPool const *strings, uint32_t const index) -> std::string_view { return index == NO_STRING ? std::string_view() : (*strings)[index]; }
+
+//
+// Copies the extension following the ResXMLTree_node of the chunk.
+//
+template <typename Extension> auto readExtension(std::span<std::byte const> const document, std::size_t const offset, XmlChunk const &chunk) -> Extension {
+  if (chunk.headerSize < sizeof(ResXMLTreeNode) || chunk.size < chunk.headerSize + sizeof(Extension)) {
+    throw std::logic_error("invalid xml node chunk");
+  }
+  return readResStruct<Extension>(document, offset + chunk.headerSize, "invalid xml node chunk");
+}
+
+} // namespace
+
+auto XmlAttribute::name() const -> std::string_view { return getString(strings, nameIndex); }
+
+auto XmlAttribute::value() const -> std::string { return formatAttributeValue(type, data, rawValueIndex, *strings); }
+
+auto XmlAttributes::operator[](std::size_t const index) const -> XmlAttribute {
+  auto const offset = offset_ + index * stride_;
+  auto const attribute = readResStruct<ResXMLTreeAttribute>(document_, offset, "invalid xml element attributes");
+  auto const &value = attribute.typedValue;
+  return XmlAttribute{strings_, attribute.ns, attribute.name, attribute.rawValue, value.dataType, value.data, offset};
+}
+
+auto XmlStartElement::name() const -> std::string_view { return getString(strings, nameIndex); }
+
+auto XmlStartElement::nameSpace() const -> std::string_view { return getString(strings, namespaceIndex); }
+
+auto XmlEndElement::name() const -> std::string_view { return getString(strings, nameIndex); }
+
+auto XmlEndElement::nameSpace() const -> std::string_view { return getString(strings, namespaceIndex); }
+
+auto XmlCData::data() const -> std::string_view { return getString(strings, dataIndex); }
+
+auto ai::readXmlChunk(std::span<std::byte const> const document, std::size_t const offset) -> XmlChunk {
+  auto const header = readResStruct<ResChunkHeader>(document, offset, "invalid xml chunk size");
+  if (header.size < XML_CHUNK_HEADER_SIZE || header.size > document.size() - offset || header.headerSize > header.size) {
+    throw std::logic_error("invalid xml chunk size");
+  }
+  return header;
+}
+
+auto ai::readXmlStartElement(std::span<std::byte const> const document, std::size_t const offset, XmlChunk const &chunk, StringPool const &strings)
+    -> XmlStartElement {
+  auto const extension = readExtension<ResXMLTreeAttrExt>(document, offset, chunk);
+  auto const attributesOffset = std::size_t{chunk.headerSize} + extension.attributeStart;
+  auto const attributeCount = extension.attributeCount;
+  auto const attributeSize = extension.attributeSize;
+  if (attributeCount > 0 && (attributeSize < sizeof(ResXMLTreeAttribute) || attributesOffset + std::size_t{attributeCount} * attributeSize > chunk.size)) {
+    throw std::logic_error("invalid xml element attributes");
+  }
+  auto const attributes = XmlAttributes(document, offset + attributesOffset, attributeCount, attributeSize, strings);
+  return XmlStartElement{&strings, extension.ns, extension.name, attributes, offset};
+}
+
+auto ai::readXmlEndElement(std::span<std::byte const> const document, std::size_t const offset, XmlChunk const &chunk, StringPool const &strings)
+    -> XmlEndElement {
+  auto const extension = readExtension<ResXMLTreeEndElementExt>(document, offset, chunk);
+  return XmlEndElement{&strings, extension.ns, extension.name};
+}
+
+auto ai::readXmlCData(std::span<std::byte const> const document, std::size_t const offset, XmlChunk const &chunk, StringPool const &strings) -> XmlCData {
+  return XmlCData{&strings, readExtension<ResXMLTreeCdataExt>(document, offset, chunk).data};
+}
+
+auto ai::formatAttributeValue(uint8_t const type, uint32_t const data, uint32_t const rawValueIndex, StringPool const &strings) -> std::string {
+  if (type == TYPE_STRING) {
+    return std::string(strings[rawValueIndex]);
+  }
+  auto buffer = ResValueBuffer();
+  return std::string(formatResValue(type, data, buffer));
+}
@@ -0,0 +1,223 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_XML_TRAVERSAL_H_
+#define ANDROID_INTROSPECTION_APK_XML_TRAVERSAL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "resource_structs.h"
+#include "resource_types.h"
+#include "string_pool.h"
+
+namespace ai {
+
+//
+// Events of the templated traversal below.  They only point into the
+// document and its string pool, and are valid for the duration of the
+// callback.  Strings are resolved on access, so callbacks that only look
+// at indexes never decode them.
+//
+struct XmlAttribute {
+
+  StringPool const *strings;
+
+  uint32_t namespaceIndex;
+
+  uint32_t nameIndex;
+
+  uint32_t rawValueIndex;
+
+  uint8_t type;
+
+  uint32_t data;
+
+  //
+  // Offset of the ResXMLTree_attribute in the document.
+  //
+  std::size_t offset;
+
+  auto name() const -> std::string_view;
+
+  auto value() const -> std::string;
+};
+
+class XmlAttributes final {
+public:
+  class Iterator final {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = XmlAttribute;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = XmlAttribute;
+
+    Iterator(XmlAttributes const *attributes, uint16_t index) : attributes_(attributes), index_(index) {}
+
+    auto operator*() const -> XmlAttribute { return (*attributes_)[index_]; }
+
+    auto operator++() -> Iterator & {
+      index_++;
+      return *this;
+    }
+
+    auto operator==(Iterator const &other) const -> bool { return index_ == other.index_; }
+
+  private:
+    XmlAttributes const *attributes_;
+
+    uint16_t index_;
+  };
+
+  XmlAttributes() = default;
+
+  XmlAttributes(std::span<std::byte const> document, std::size_t offset, uint16_t count, uint16_t stride, StringPool const &strings)
+      : document_(document), offset_(offset), count_(count), stride_(stride), strings_(&strings) {}
+
+  auto size() const -> std::size_t { return count_; }
+
+  auto operator[](std::size_t index) const -> XmlAttribute;
+
+  auto begin() const -> Iterator { return Iterator(this, 0); }
+
+  auto end() const -> Iterator { return Iterator(this, count_); }
+
+private:
+  std::span<std::byte const> document_;
+
+  std::size_t offset_ = 0;
+
+  uint16_t count_ = 0;
+
+  uint16_t stride_ = 0;
+
+  StringPool const *strings_ = nullptr;
+};
+
+struct XmlStartElement {
+
+  StringPool const *strings;
+
+  uint32_t namespaceIndex;
+
+  uint32_t nameIndex;
+
+  XmlAttributes attributes;
+
+  //
+  // Offset of the RES_XML_START_ELEMENT_TYPE chunk in the document.
+  //
+  std::size_t chunkOffset;
+
+  auto name() const -> std::string_view;
+
+  auto nameSpace() const -> std::string_view;
+};
+
+struct XmlEndElement {
+
+  StringPool const *strings;
+
+  uint32_t namespaceIndex;
+
+  uint32_t nameIndex;
+
+  auto name() const -> std::string_view;
+
+  auto nameSpace() const -> std::string_view;
+};
+
+struct XmlCData {
+
+  StringPool const *strings;
+
+  uint32_t dataIndex;
+
+  auto data() const -> std::string_view;
+};
+
+static constexpr std::size_t XML_CHUNK_HEADER_SIZE = sizeof(ResChunkHeader);
+
+using XmlChunk = ResChunkHeader;
+
+//
+// Formats a Res_value the way the decoded xml shows it.
+//
+auto formatAttributeValue(uint8_t type, uint32_t data, uint32_t rawValueIndex, StringPool const &strings) -> std::string;
+
+//
+// Reads and validates the header of the chunk at offset.
+//
+auto readXmlChunk(std::span<std::byte const> document, std::size_t offset) -> XmlChunk;
+
+auto readXmlStartElement(std::span<std::byte const> document, std::size_t offset, XmlChunk const &chunk, StringPool const &strings) -> XmlStartElement;
+
+auto readXmlEndElement(std::span<std::byte const> document, std::size_t offset, XmlChunk const &chunk, StringPool const &strings) -> XmlEndElement;
+
+auto readXmlCData(std::span<std::byte const> document, std::size_t offset, XmlChunk const &chunk, StringPool const &strings) -> XmlCData;
+
+//
+// Walks the chunks of a document starting at firstChunkOffset and calls
+// onStartElement(), onEndElement() and onCData() on the visitor for the
+// events it handles; handlers it lacks are skipped at compile time.  No
+// heap allocation happens per element.
+//
+template <typename Visitor>
+auto traverseXml(std::span<std::byte const> const document, std::size_t const firstChunkOffset, StringPool const &strings, Visitor &&visitor) -> void {
+  for (auto offset = firstChunkOffset; offset + XML_CHUNK_HEADER_SIZE <= document.size();) {
+    auto const chunk = readXmlChunk(document, offset);
+    switch (chunk.type) {
+    case RES_XML_START_ELEMENT_TYPE: {
+      if constexpr (requires(XmlStartElement const &element) { visitor.onStartElement(element); }) {
+        visitor.onStartElement(readXmlStartElement(document, offset, chunk, strings));
+      }
+      break;
+    }
+    case RES_XML_END_ELEMENT_TYPE: {
+      if constexpr (requires(XmlEndElement const &element) { visitor.onEndElement(element); }) {
+        visitor.onEndElement(readXmlEndElement(document, offset, chunk, strings));
+      }
+      break;
+    }
+    case RES_XML_CDATA_TYPE: {
+      if constexpr (requires(XmlCData const &cdata) { visitor.onCData(cdata); }) {
+        visitor.onCData(readXmlCData(document, offset, chunk, strings));
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+    }
+    offset += chunk.size;
+  }
+}
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_XML_TRAVERSAL_H_ */
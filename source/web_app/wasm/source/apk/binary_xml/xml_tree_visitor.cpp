@@ -0,0 +1,102 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+#include "res_value.h"
+#include "utils/json.h"
+#include "xml_tree_visitor.h"
+
+using namespace ai;
+
+namespace {
+
+auto appendNumber(int64_t const number, std::string &json) -> void {
+  auto buffer = std::array<char, 24>();
+  auto const [end, error] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), number);
+  json.append(buffer.data(), end);
+}
+
+} // namespace
+
+XmlTreeVisitor::XmlTreeVisitor(std::string &json, ResourceResolver *const resolver) : json_(json), resolver_(resolver) { json_ += "{\"elements\":["; }
+
+auto XmlTreeVisitor::onStartElement(XmlStartElement const &element) -> void {
+  if (elementCount_ > 0) {
+    json_ += ',';
+  }
+  json_ += '[';
+  appendNumber(intern(element.name()), json_);
+  json_ += ',';
+  appendNumber(openElements_.empty() ? -1 : openElements_.back(), json_);
+  attributes_.assign(element.attributes.begin(), element.attributes.end());
+  std::stable_sort(attributes_.begin(), attributes_.end(), [](XmlAttribute const &a, XmlAttribute const &b) { return a.name() < b.name(); });
+  for (std::size_t i{0}; i < attributes_.size(); i++) {
+    auto const &attribute = attributes_[i];
+    auto const attributeName = attribute.name();
+    if (attributeName.empty() || (i + 1 < attributes_.size() && attributes_[i + 1].name() == attributeName)) {
+      continue;
+    }
+    json_ += ',';
+    appendNumber(intern(attributeName), json_);
+    json_ += ',';
+    if (attribute.type == TYPE_STRING) {
+      appendNumber(intern((*attribute.strings)[attribute.rawValueIndex]), json_);
+    } else if (attribute.type == TYPE_REFERENCE && resolver_ != nullptr) {
+      appendNumber(intern(resolver_->getReference(attribute.data)), json_);
+    } else {
+      auto buffer = ResValueBuffer();
+      appendNumber(intern(formatResValue(attribute.type, attribute.data, buffer)), json_);
+    }
+  }
+  json_ += ']';
+  openElements_.push_back(elementCount_++);
+}
+
+auto XmlTreeVisitor::onEndElement(XmlEndElement const &) -> void {
+  if (!openElements_.empty()) {
+    openElements_.pop_back();
+  }
+}
+
+auto XmlTreeVisitor::finish() -> void {
+  json_ += "],\"strings\":[";
+  for (auto const &string : strings_) {
+    if (&string != &strings_.front()) {
+      json_ += ',';
+    }
+    utils::json::appendString(string, json_);
+  }
+  json_ += "]}";
+}
+
+auto XmlTreeVisitor::intern(std::string_view const string) -> uint32_t {
+  if (auto const found = stringIds_.find(string); found != stringIds_.end()) {
+    return found->second;
+  }
+  auto const id = static_cast<uint32_t>(strings_.size());
+  stringIds_.emplace(strings_.emplace_back(string), id);
+  return id;
+}
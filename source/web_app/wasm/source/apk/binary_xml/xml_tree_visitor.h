@@ -0,0 +1,92 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_XML_TREE_VISITOR_H_
+#define ANDROID_INTROSPECTION_APK_XML_TREE_VISITOR_H_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "resource_resolver.h"
+#include "xml_traversal.h"
+
+namespace ai {
+
+//
+// Renders the document for the templated traversal as a JSON tree that a
+// UI can walk without parsing xml text again:
+//
+//   {"elements":[[name,parent,attributeName,attributeValue,...],...],
+//    "strings":[...]}
+//
+// Elements are in document order, each an array of string ids: its name,
+// the index of its parent element, -1 for the root, then the name and value
+// of each attribute.  Every name and value is interned once in strings.
+// Attributes and their values are those of StringXmlVisitor: sorted by
+// name, the last of a name kept, and references by name with a resolver.
+//
+class XmlTreeVisitor final {
+public:
+  explicit XmlTreeVisitor(std::string &json, ResourceResolver *resolver = nullptr);
+
+  auto onStartElement(XmlStartElement const &element) -> void;
+
+  auto onEndElement(XmlEndElement const &element) -> void;
+
+  //
+  // Closes the elements and writes the strings.
+  //
+  auto finish() -> void;
+
+private:
+  auto intern(std::string_view string) -> uint32_t;
+
+  std::string &json_;
+
+  ResourceResolver *resolver_;
+
+  std::vector<XmlAttribute> attributes_;
+
+  //
+  // A deque, so that the views stringIds_ is keyed by stay put as strings
+  // are added.
+  //
+  std::deque<std::string> strings_;
+
+  std::unordered_map<std::string_view, uint32_t> stringIds_;
+
+  //
+  // Indexes of the elements from the root to the one last started.
+  //
+  std::vector<int32_t> openElements_;
+
+  int32_t elementCount_ = 0;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_XML_TREE_VISITOR_H_ */
@@ -0,0 +1,304 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "apk/content_type.h"
+#include "binary_xml/resource_types.h"
+#include "utils/little_endian.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// The shortest prefix whose entropy says anything about the rest.
+//
+static constexpr size_t MIN_ENTROPY_PREFIX_SIZE = 256;
+
+//
+// How far below the entropy expected of as many random bytes a prefix may
+// be and still be taken for noise.
+//
+static constexpr double ENTROPY_MARGIN = 0.4;
+
+//
+// Hermes bytecode, what React Native ships its bundles as.
+//
+static constexpr uint64_t HERMES_MAGIC = 0x1F1903C103BC1FC6;
+
+static constexpr std::array<std::string_view, 8> BUNDLE_SIGNATURES = {
+    "webpackJsonp", "__webpack_require__", "__d(function", "__BUNDLE_START_TIME__", "!function(", "(function(", "\"use strict\"", "'use strict'",
+};
+
+//
+// Extensions of the types classifyPath() tells, lower case.
+//
+static constexpr std::array<std::pair<std::string_view, ContentType>, 36> EXTENSION_TYPES = {{
+    {".dex", ContentType::Dex}, {".so", ContentType::Elf}, {".arsc", ContentType::ResourceTable}, {".png", ContentType::Png}, {".webp", ContentType::WebP},
+    {".jpg", ContentType::Jpeg}, {".jpeg", ContentType::Jpeg}, {".gif", ContentType::Gif}, {".zip", ContentType::Zip}, {".jar", ContentType::Zip},
+    {".apk", ContentType::Zip}, {".js", ContentType::JavaScript}, {".bundle", ContentType::JavaScript}, {".hbc", ContentType::JavaScript},
+    {".txt", ContentType::Text}, {".json", ContentType::Text}, {".html", ContentType::Text}, {".css", ContentType::Text}, {".properties", ContentType::Text},
+    {".mp3", ContentType::Media}, {".ogg", ContentType::Media}, {".wav", ContentType::Media}, {".mp4", ContentType::Media}, {".m4a", ContentType::Media},
+    {".webm", ContentType::Media}, {".ttf", ContentType::Font}, {".otf", ContentType::Font}, {".ttc", ContentType::Font}, {".woff", ContentType::Font},
+    {".woff2", ContentType::Font}, {".gz", ContentType::Compressed}, {".xz", ContentType::Compressed}, {".zst", ContentType::Compressed},
+    {".bz2", ContentType::Compressed}, {".7z", ContentType::Compressed}, {".br", ContentType::Compressed},
+}};
+
+static constexpr std::array<std::string_view, 8> SCRIPT_KEYWORDS = {"function", "=>", "var ", "let ", "const ", "return ", "require(", "exports"};
+
+using ai::utils::little_endian::load;
+
+auto hasMagic(std::span<std::byte const> const prefix, std::string_view const magic, size_t const offset = 0) -> bool {
+  return prefix.size() >= offset + magic.size() && memcmp(prefix.data() + offset, magic.data(), magic.size()) == 0;
+}
+
+auto isDex(std::span<std::byte const> const prefix) -> bool {
+  if (hasMagic(prefix, "cdex")) {
+    return true;
+  }
+  if (!hasMagic(prefix, "dex\n") || prefix.size() < 8 || prefix[7] != std::byte{0}) {
+    return false;
+  }
+  return std::all_of(prefix.begin() + 4, prefix.begin() + 7, [](auto const byte) { return byte >= std::byte{'0'} && byte <= std::byte{'9'}; });
+}
+
+//
+// Chunks of the resource formats are only taken for what they are if the
+// size in their header is the size of the entry.
+//
+auto isResourceChunk(std::span<std::byte const> const prefix, uint16_t const type, uint16_t const headerSize, uint64_t const uncompressedSize) -> bool {
+  return prefix.size() >= 2 * sizeof(uint32_t) && load<uint16_t>(prefix, 0) == type && load<uint16_t>(prefix, 2) == headerSize &&
+         load<uint32_t>(prefix, 4) == uncompressedSize;
+}
+
+auto isMedia(std::span<std::byte const> const prefix) -> bool {
+  if (hasMagic(prefix, "OggS") || hasMagic(prefix, "ID3") || hasMagic(prefix, "fLaC") || hasMagic(prefix, "MThd") || hasMagic(prefix, "#!AMR") ||
+      hasMagic(prefix, "\x1A\x45\xDF\xA3") || hasMagic(prefix, "ftyp", 4)) {
+    return true;
+  }
+  if (hasMagic(prefix, "RIFF") && (hasMagic(prefix, "WAVE", 8) || hasMagic(prefix, "AVI ", 8))) {
+    return true;
+  }
+  //
+  // Frame sync of an MPEG audio stream without an ID3 tag.
+  //
+  return prefix.size() >= 3 && prefix[0] == std::byte{0xFF} && (prefix[1] & std::byte{0xE0}) == std::byte{0xE0} && (prefix[1] & std::byte{0x06}) != std::byte{0} &&
+         (prefix[2] & std::byte{0xF0}) != std::byte{0xF0};
+}
+
+auto isFont(std::span<std::byte const> const prefix) -> bool {
+  return hasMagic(prefix, std::string_view("\x00\x01\x00\x00", 4)) || hasMagic(prefix, "OTTO") || hasMagic(prefix, "true") || hasMagic(prefix, "ttcf") ||
+         hasMagic(prefix, "wOFF") || hasMagic(prefix, "wOF2");
+}
+
+auto isCompressed(std::span<std::byte const> const prefix) -> bool {
+  return hasMagic(prefix, "\x1F\x8B") || hasMagic(prefix, "\xFD" "7zXZ") || hasMagic(prefix, "\x28\xB5\x2F\xFD") || hasMagic(prefix, "BZh") ||
+         hasMagic(prefix, "7z\xBC\xAF\x27\x1C") || hasMagic(prefix, "\x04\x22\x4D\x18") || hasMagic(prefix, "Rar!");
+}
+
+//
+// Text if there are no control characters but whitespace.  Bytes past ASCII
+// pass, being UTF-8 in any text an APK ships.
+//
+auto isText(std::string_view const text) -> bool {
+  return std::all_of(text.begin(), text.end(), [](char const c) {
+    auto const byte = static_cast<unsigned char>(c);
+    return byte >= 0x20 || byte == '\t' || byte == '\n' || byte == '\r' || byte == '\f';
+  });
+}
+
+auto isScript(std::string_view text) -> bool {
+  if (text.starts_with("\xEF\xBB\xBF")) {
+    text.remove_prefix(3);
+  }
+  if (std::any_of(BUNDLE_SIGNATURES.begin(), BUNDLE_SIGNATURES.end(), [text](auto const signature) { return text.find(signature) != text.npos; })) {
+    return true;
+  }
+  auto const start = text.find_first_not_of(" \t\r\n");
+  if (start == text.npos || text[start] == '<' || text[start] == '{' || text[start] == '[') {
+    return false;
+  }
+  auto const keywords = std::count_if(SCRIPT_KEYWORDS.begin(), SCRIPT_KEYWORDS.end(), [text](auto const keyword) { return text.find(keyword) != text.npos; });
+  return keywords >= 2;
+}
+
+//
+// Shannon entropy in bits per byte.  It is biased low for short inputs, by
+// about 255 / (2 n ln 2) bits for n random bytes, so it is compared with
+// what as many random bytes would give.
+//
+auto getEntropy(std::span<std::byte const> const bytes) -> double {
+  auto counts = std::array<uint32_t, 256>();
+  for (auto const byte : bytes) {
+    counts[static_cast<uint8_t>(byte)]++;
+  }
+  auto entropy = 0.0;
+  for (auto const count : counts) {
+    if (count > 0) {
+      auto const probability = static_cast<double>(count) / static_cast<double>(bytes.size());
+      entropy -= probability * std::log2(probability);
+    }
+  }
+  return entropy;
+}
+
+auto isNoise(std::span<std::byte const> const prefix) -> bool {
+  if (prefix.size() < MIN_ENTROPY_PREFIX_SIZE) {
+    return false;
+  }
+  auto const expectedEntropy = 8.0 - 255.0 / (2.0 * static_cast<double>(prefix.size()) * std::log(2.0));
+  return getEntropy(prefix) >= expectedEntropy - ENTROPY_MARGIN;
+}
+
+} // namespace
+
+auto ai::getContentTypeName(ContentType const type) -> std::string_view {
+  switch (type) {
+  case ContentType::Empty:
+    return "empty";
+  case ContentType::Dex:
+    return "dex";
+  case ContentType::Elf:
+    return "elf";
+  case ContentType::BinaryXml:
+    return "binary-xml";
+  case ContentType::ResourceTable:
+    return "resource-table";
+  case ContentType::Png:
+    return "png";
+  case ContentType::WebP:
+    return "webp";
+  case ContentType::Jpeg:
+    return "jpeg";
+  case ContentType::Gif:
+    return "gif";
+  case ContentType::Zip:
+    return "zip";
+  case ContentType::JavaScript:
+    return "javascript";
+  case ContentType::Text:
+    return "text";
+  case ContentType::Media:
+    return "media";
+  case ContentType::Font:
+    return "font";
+  case ContentType::Compressed:
+    return "compressed";
+  case ContentType::Encrypted:
+    return "encrypted";
+  case ContentType::Unknown:
+    break;
+  }
+  return "unknown";
+}
+
+auto ai::classifyContent(std::span<std::byte const> prefix, uint64_t const uncompressedSize, uint64_t const compressedSize) -> ContentType {
+  if (uncompressedSize == 0) {
+    return ContentType::Empty;
+  }
+  prefix = prefix.first(std::min<size_t>(prefix.size(), CONTENT_PREFIX_SIZE));
+  if (isDex(prefix)) {
+    return ContentType::Dex;
+  }
+  if (hasMagic(prefix, "\x7F" "ELF")) {
+    return ContentType::Elf;
+  }
+  if (isResourceChunk(prefix, RES_XML_TYPE, 2 * sizeof(uint32_t), uncompressedSize)) {
+    return ContentType::BinaryXml;
+  }
+  if (isResourceChunk(prefix, RES_TABLE_TYPE, 3 * sizeof(uint32_t), uncompressedSize)) {
+    return ContentType::ResourceTable;
+  }
+  if (hasMagic(prefix, "\x89PNG\r\n\x1A\n")) {
+    return ContentType::Png;
+  }
+  if (hasMagic(prefix, "RIFF") && hasMagic(prefix, "WEBP", 8)) {
+    return ContentType::WebP;
+  }
+  if (hasMagic(prefix, "\xFF\xD8\xFF")) {
+    return ContentType::Jpeg;
+  }
+  if (hasMagic(prefix, "GIF87a") || hasMagic(prefix, "GIF89a")) {
+    return ContentType::Gif;
+  }
+  if (hasMagic(prefix, "PK\x03\x04") || hasMagic(prefix, "PK\x05\x06")) {
+    return ContentType::Zip;
+  }
+  if (prefix.size() >= sizeof(uint64_t) && load<uint64_t>(prefix, 0) == HERMES_MAGIC) {
+    return ContentType::JavaScript;
+  }
+  //
+  // Ahead of the short magics below, which text may well start with.
+  //
+  if (auto const text = std::string_view(reinterpret_cast<char const *>(prefix.data()), prefix.size()); isText(text)) {
+    return isScript(text) ? ContentType::JavaScript : ContentType::Text;
+  }
+  if (isMedia(prefix)) {
+    return ContentType::Media;
+  }
+  if (isFont(prefix)) {
+    return ContentType::Font;
+  }
+  if (isCompressed(prefix)) {
+    return ContentType::Compressed;
+  }
+  //
+  // Deflate shrinks anything with structure, so noise that it did not shrink
+  // by a hundredth is taken for encrypted.
+  //
+  if (compressedSize * 100 >= uncompressedSize * 99 && isNoise(prefix)) {
+    return ContentType::Encrypted;
+  }
+  return ContentType::Unknown;
+}
+
+auto ai::classifyPath(std::string_view const path, uint64_t const uncompressedSize) -> ContentType {
+  if (uncompressedSize == 0) {
+    return ContentType::Empty;
+  }
+  auto const name = path.substr(path.rfind('/') + 1);
+  auto const dot = name.rfind('.');
+  if (dot == std::string_view::npos) {
+    return ContentType::Unknown;
+  }
+  auto extension = std::string(name.substr(dot));
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](char const c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+  //
+  // aapt compiles the manifest and the xml of res/, the rest of the xml of
+  // an APK is text.
+  //
+  if (extension == ".xml") {
+    return path == "AndroidManifest.xml" || path.starts_with("res/") ? ContentType::BinaryXml : ContentType::Text;
+  }
+  auto const found = std::find_if(EXTENSION_TYPES.begin(), EXTENSION_TYPES.end(), [&extension](auto const &type) { return type.first == extension; });
+  return found != EXTENSION_TYPES.end() ? found->second : ContentType::Unknown;
+}
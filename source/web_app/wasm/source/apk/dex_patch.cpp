@@ -0,0 +1,515 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+#include "dex_patch.h"
+#include "utils/adler32.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/sha.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr std::size_t HEADER_SIZE = 0x70;
+
+static constexpr std::size_t CHECKSUM_OFFSET = 8;
+
+static constexpr std::size_t SIGNATURE_OFFSET = 12;
+
+static constexpr std::size_t SIGNATURE_SIZE = 20;
+
+static constexpr std::size_t FILE_SIZE_OFFSET = 32;
+
+static constexpr std::size_t HEADER_SIZE_OFFSET = 36;
+
+static constexpr std::size_t ENDIAN_TAG_OFFSET = 40;
+
+static constexpr std::size_t MAP_OFFSET_OFFSET = 52;
+
+//
+// Every table of the header is a size followed by an offset.
+//
+static constexpr std::size_t STRING_IDS_OFFSET = 56;
+
+static constexpr std::size_t TYPE_IDS_OFFSET = 64;
+
+static constexpr std::size_t PROTO_IDS_OFFSET = 72;
+
+static constexpr std::size_t METHOD_IDS_OFFSET = 88;
+
+static constexpr std::size_t CLASS_DEFS_OFFSET = 96;
+
+static constexpr std::size_t DATA_OFFSET = 104;
+
+static constexpr std::size_t CLASS_DEF_SIZE = 32;
+
+static constexpr std::size_t CLASS_DEF_ACCESS_FLAGS_OFFSET = 4;
+
+static constexpr uint32_t ENDIAN_CONSTANT = 0x12345678;
+
+static constexpr uint32_t NO_INDEX = 0xffffffff;
+
+static constexpr uint32_t ACC_PUBLIC = 0x1;
+
+static constexpr uint32_t ACC_STATIC = 0x8;
+
+static constexpr uint32_t ACC_FINAL = 0x10;
+
+static constexpr uint32_t ACC_CONSTRUCTOR = 0x10000;
+
+static constexpr uint16_t OP_RETURN_VOID = 0x0e;
+
+static constexpr uint16_t OP_CONST_STRING = 0x1a;
+
+static constexpr uint16_t OP_INVOKE_DIRECT = 0x70;
+
+static constexpr uint16_t OP_INVOKE_STATIC = 0x71;
+
+static constexpr uint16_t TYPE_HEADER_ITEM = 0x0000;
+
+static constexpr uint16_t TYPE_STRING_ID_ITEM = 0x0001;
+
+static constexpr uint16_t TYPE_TYPE_ID_ITEM = 0x0002;
+
+static constexpr uint16_t TYPE_PROTO_ID_ITEM = 0x0003;
+
+static constexpr uint16_t TYPE_METHOD_ID_ITEM = 0x0005;
+
+static constexpr uint16_t TYPE_CLASS_DEF_ITEM = 0x0006;
+
+static constexpr uint16_t TYPE_MAP_LIST = 0x1000;
+
+static constexpr uint16_t TYPE_TYPE_LIST = 0x1001;
+
+static constexpr uint16_t TYPE_CLASS_DATA_ITEM = 0x2000;
+
+static constexpr uint16_t TYPE_CODE_ITEM = 0x2001;
+
+static constexpr uint16_t TYPE_STRING_DATA_ITEM = 0x2002;
+
+static constexpr std::string_view CLASS_INITIALIZER = "<clinit>";
+
+static constexpr std::string_view CONSTRUCTOR = "<init>";
+
+static constexpr std::string_view STRING_DESCRIPTOR = "Ljava/lang/String;";
+
+static constexpr std::string_view SYSTEM_DESCRIPTOR = "Ljava/lang/System;";
+
+static constexpr std::string_view VOID_DESCRIPTOR = "V";
+
+static constexpr std::string_view LOAD_LIBRARY = "loadLibrary";
+
+template <typename T> auto readValue(std::span<std::byte const> const bytes, std::size_t const offset) -> T {
+  return utils::little_endian::load<T>(bytes, offset, "dex structure out of bounds");
+}
+
+//
+// MUTF-8 bytes of the string at the index, without the leading length.
+//
+auto getString(std::span<std::byte const> const dex, uint32_t const stringIndex) -> std::string_view {
+  auto const stringIdsOffset = readValue<uint32_t>(dex, STRING_IDS_OFFSET + 4);
+  auto offset = std::size_t{readValue<uint32_t>(dex, stringIdsOffset + std::size_t{stringIndex} * 4)};
+  while (static_cast<uint8_t>(readValue<std::byte>(dex, offset)) & 0x80) {
+    offset++;
+  }
+  auto const data = dex.subspan(offset + 1);
+  auto const end = std::find(data.begin(), data.end(), std::byte{0});
+  if (end == data.end()) {
+    throw std::logic_error("dex string is not terminated");
+  }
+  return std::string_view(reinterpret_cast<char const *>(data.data()), static_cast<std::size_t>(end - data.begin()));
+}
+
+//
+// Strings are sorted by UTF-16 code units, which matches byte order for the
+// ASCII descriptors looked up here.
+//
+auto findString(std::span<std::byte const> const dex, std::string_view const string) -> std::optional<uint32_t> {
+  auto low = uint32_t{0};
+  auto high = readValue<uint32_t>(dex, STRING_IDS_OFFSET);
+  while (low < high) {
+    auto const middle = low + (high - low) / 2;
+    auto const candidate = getString(dex, middle);
+    if (candidate == string) {
+      return middle;
+    }
+    if (candidate < string) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return std::nullopt;
+}
+
+auto findType(std::span<std::byte const> const dex, uint32_t const stringIndex) -> std::optional<uint32_t> {
+  auto const typeIdsOffset = readValue<uint32_t>(dex, TYPE_IDS_OFFSET + 4);
+  auto low = uint32_t{0};
+  auto high = readValue<uint32_t>(dex, TYPE_IDS_OFFSET);
+  while (low < high) {
+    auto const middle = low + (high - low) / 2;
+    auto const candidate = readValue<uint32_t>(dex, typeIdsOffset + std::size_t{middle} * 4);
+    if (candidate == stringIndex) {
+      return middle;
+    }
+    if (candidate < stringIndex) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return std::nullopt;
+}
+
+//
+// Little endian writer of the sections of the loader, which are laid out in
+// the order they are written.
+//
+class DexWriter final {
+public:
+  auto offset() const -> uint32_t { return static_cast<uint32_t>(bytes_.size()); }
+
+  auto write16(uint16_t const value) -> void { append(&value, sizeof(value)); }
+
+  auto write32(uint32_t const value) -> void { append(&value, sizeof(value)); }
+
+  auto writeUleb128(uint32_t value) -> void {
+    do {
+      auto byte = static_cast<uint8_t>(value & 0x7f);
+      value >>= 7;
+      if (value != 0) {
+        byte |= 0x80;
+      }
+      bytes_.push_back(std::byte{byte});
+    } while (value != 0);
+  }
+
+  auto writeString(std::string_view const string) -> void {
+    writeUleb128(getUtf16Length(string));
+    append(string.data(), string.size());
+    bytes_.push_back(std::byte{0});
+  }
+
+  auto align(std::size_t const alignment) -> void { bytes_.resize((bytes_.size() + alignment - 1) / alignment * alignment); }
+
+  auto patch32(std::size_t const offset, uint32_t const value) -> void { std::memcpy(bytes_.data() + offset, &value, sizeof(value)); }
+
+  auto take() -> std::vector<std::byte> { return std::move(bytes_); }
+
+private:
+  //
+  // UTF-16 code units of UTF-8 text, which is also its MUTF-8 encoding as
+  // long as it stays within the Basic Multilingual Plane.
+  //
+  static auto getUtf16Length(std::string_view const string) -> uint32_t {
+    auto length = uint32_t{0};
+    for (auto const c : string) {
+      auto const byte = static_cast<uint8_t>(c);
+      if (byte == 0 || byte >= 0xf0) {
+        throw std::logic_error("unsupported character in dex string");
+      }
+      if ((byte & 0xc0) != 0x80) {
+        length++;
+      }
+    }
+    return length;
+  }
+
+  auto append(void const *const data, std::size_t const size) -> void {
+    auto const bytes = static_cast<std::byte const *>(data);
+    bytes_.insert(bytes_.end(), bytes, bytes + size);
+  }
+
+  std::vector<std::byte> bytes_;
+};
+
+struct MapItem {
+
+  uint16_t type;
+
+  uint32_t size;
+
+  uint32_t offset;
+};
+
+} // namespace
+
+auto ai::findDexClassDefinition(std::span<std::byte const> const dex, std::string_view const descriptor) -> std::optional<std::size_t> {
+  if (dex.size() < HEADER_SIZE || std::memcmp(dex.data(), "dex\n", 4) != 0) {
+    throw std::logic_error("invalid dex magic");
+  }
+  auto const stringIndex = findString(dex, descriptor);
+  auto const typeIndex = stringIndex ? findType(dex, *stringIndex) : std::nullopt;
+  if (!typeIndex) {
+    return std::nullopt;
+  }
+  auto const classDefsCount = readValue<uint32_t>(dex, CLASS_DEFS_OFFSET);
+  auto const classDefsOffset = std::size_t{readValue<uint32_t>(dex, CLASS_DEFS_OFFSET + 4)};
+  for (auto index = std::size_t{0}; index < classDefsCount; index++) {
+    auto const offset = classDefsOffset + index * CLASS_DEF_SIZE;
+    if (readValue<uint32_t>(dex, offset) == *typeIndex) {
+      return offset;
+    }
+  }
+  return std::nullopt;
+}
+
+auto ai::clearDexClassFinal(std::vector<std::byte> &dex, std::size_t const classDefinitionOffset) -> bool {
+  auto const flagsOffset = classDefinitionOffset + CLASS_DEF_ACCESS_FLAGS_OFFSET;
+  auto const accessFlags = readValue<uint32_t>(dex, flagsOffset);
+  if ((accessFlags & ACC_FINAL) == 0) {
+    return false;
+  }
+  auto const clearedFlags = accessFlags & ~ACC_FINAL;
+  std::memcpy(dex.data() + flagsOffset, &clearedFlags, sizeof(clearedFlags));
+  updateDexChecksums(dex, flagsOffset, std::as_bytes(std::span(&accessFlags, 1)));
+  return true;
+}
+
+auto ai::updateDexChecksums(std::span<std::byte> const dex) -> void {
+  if (dex.size() < HEADER_SIZE) {
+    throw std::logic_error("invalid dex header");
+  }
+  auto const signature = utils::sha::computeDigest("SHA-1", dex.subspan(SIGNATURE_OFFSET + SIGNATURE_SIZE));
+  std::copy(signature.begin(), signature.end(), dex.begin() + SIGNATURE_OFFSET);
+  auto const checksum = utils::adler32::update(1, dex.subspan(SIGNATURE_OFFSET));
+  std::memcpy(dex.data() + CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+}
+
+auto ai::updateDexChecksums(std::span<std::byte> const dex, std::size_t const patchOffset, std::span<std::byte const> const originalBytes) -> void {
+  if (dex.size() < HEADER_SIZE || patchOffset < SIGNATURE_OFFSET + SIGNATURE_SIZE || patchOffset > dex.size() ||
+      originalBytes.size() > dex.size() - patchOffset) {
+    throw std::logic_error("dex patch out of bounds");
+  }
+  auto const checksummedSize = dex.size() - SIGNATURE_OFFSET;
+  auto checksum = readValue<uint32_t>(dex, CHECKSUM_OFFSET);
+  checksum = utils::adler32::replace(checksum, checksummedSize, patchOffset - SIGNATURE_OFFSET, originalBytes, dex.subspan(patchOffset, originalBytes.size()));
+
+  auto originalSignature = std::array<std::byte, SIGNATURE_SIZE>();
+  std::copy_n(dex.begin() + SIGNATURE_OFFSET, SIGNATURE_SIZE, originalSignature.begin());
+  auto const signature = utils::sha::computeDigest("SHA-1", dex.subspan(SIGNATURE_OFFSET + SIGNATURE_SIZE));
+  std::copy(signature.begin(), signature.end(), dex.begin() + SIGNATURE_OFFSET);
+  checksum = utils::adler32::replace(checksum, checksummedSize, 0, originalSignature, dex.subspan(SIGNATURE_OFFSET, SIGNATURE_SIZE));
+  std::memcpy(dex.data() + CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+}
+
+auto ai::encodeDexLoader(std::string_view const loaderDescriptor, std::string_view const superclassDescriptor, std::string_view const libraryName)
+    -> std::vector<std::byte> {
+  LOGD("encodeDexLoader, loader [{}] superclass [{}] library [{}]", loaderDescriptor, superclassDescriptor, libraryName);
+  auto strings = std::vector<std::string_view>{CLASS_INITIALIZER, CONSTRUCTOR,    STRING_DESCRIPTOR, SYSTEM_DESCRIPTOR,   VOID_DESCRIPTOR,
+                                               "VL",              LOAD_LIBRARY,   loaderDescriptor,  superclassDescriptor, libraryName};
+  std::sort(strings.begin(), strings.end());
+  strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+  auto const stringIndex = [&strings](std::string_view const string) {
+    return static_cast<uint32_t>(std::lower_bound(strings.begin(), strings.end(), string) - strings.begin());
+  };
+
+  //
+  // Type ids are sorted by string index, so sorting the descriptors sorts
+  // them too.
+  //
+  auto types = std::vector<std::string_view>{loaderDescriptor, superclassDescriptor, STRING_DESCRIPTOR, SYSTEM_DESCRIPTOR, VOID_DESCRIPTOR};
+  std::sort(types.begin(), types.end());
+  if (std::adjacent_find(types.begin(), types.end()) != types.end()) {
+    throw std::logic_error("loader conflicts with its superclass");
+  }
+  auto const typeIndex = [&types](std::string_view const type) {
+    return static_cast<uint16_t>(std::lower_bound(types.begin(), types.end(), type) - types.begin());
+  };
+
+  //
+  // ()V sorts before (Ljava/lang/String;)V, as both return void and an empty
+  // parameter list comes first.
+  //
+  static constexpr uint16_t VOID_PROTO = 0;
+  static constexpr uint16_t STRING_TO_VOID_PROTO = 1;
+  using MethodId = std::tuple<uint16_t, uint32_t, uint16_t>;
+  auto const classInitializer = MethodId(typeIndex(loaderDescriptor), stringIndex(CLASS_INITIALIZER), VOID_PROTO);
+  auto const constructor = MethodId(typeIndex(loaderDescriptor), stringIndex(CONSTRUCTOR), VOID_PROTO);
+  auto const superConstructor = MethodId(typeIndex(superclassDescriptor), stringIndex(CONSTRUCTOR), VOID_PROTO);
+  auto const loadLibrary = MethodId(typeIndex(SYSTEM_DESCRIPTOR), stringIndex(LOAD_LIBRARY), STRING_TO_VOID_PROTO);
+  auto methods = std::vector<MethodId>{classInitializer, constructor, superConstructor, loadLibrary};
+  std::sort(methods.begin(), methods.end());
+  auto const methodIndex = [&methods](MethodId const &method) {
+    return static_cast<uint16_t>(std::lower_bound(methods.begin(), methods.end(), method) - methods.begin());
+  };
+
+  auto writer = DexWriter();
+  for (auto i = std::size_t{0}; i < HEADER_SIZE / 4; i++) {
+    writer.write32(0);
+  }
+  auto const stringIdsOffset = writer.offset();
+  for (auto i = std::size_t{0}; i < strings.size(); i++) {
+    writer.write32(0);
+  }
+  auto const typeIdsOffset = writer.offset();
+  for (auto const type : types) {
+    writer.write32(stringIndex(type));
+  }
+  auto const protoIdsOffset = writer.offset();
+  writer.write32(stringIndex(VOID_DESCRIPTOR));
+  writer.write32(typeIndex(VOID_DESCRIPTOR));
+  writer.write32(0);
+  writer.write32(stringIndex("VL"));
+  writer.write32(typeIndex(VOID_DESCRIPTOR));
+  auto const parametersOffsetAt = writer.offset();
+  writer.write32(0);
+  auto const methodIdsOffset = writer.offset();
+  for (auto const &[classIndex, nameIndex, protoIndex] : methods) {
+    writer.write16(classIndex);
+    writer.write16(protoIndex);
+    writer.write32(nameIndex);
+  }
+  auto const classDefsOffset = writer.offset();
+  writer.write32(typeIndex(loaderDescriptor));
+  writer.write32(ACC_PUBLIC);
+  writer.write32(typeIndex(superclassDescriptor));
+  writer.write32(0);
+  writer.write32(NO_INDEX);
+  writer.write32(0);
+  auto const classDataOffsetAt = writer.offset();
+  writer.write32(0);
+  writer.write32(0);
+
+  //
+  // static { System.loadLibrary(libraryName); }, in v0, and a constructor
+  // calling super() on p0.
+  //
+  auto const dataOffset = writer.offset();
+  auto const writeCode = [&writer](uint16_t const registers, uint16_t const ins, std::span<uint16_t const> const instructions) {
+    writer.align(4);
+    auto const offset = writer.offset();
+    writer.write16(registers);
+    writer.write16(ins);
+    writer.write16(1);
+    writer.write16(0);
+    writer.write32(0);
+    writer.write32(static_cast<uint32_t>(instructions.size()));
+    for (auto const instruction : instructions) {
+      writer.write16(instruction);
+    }
+    return offset;
+  };
+  auto const libraryNameIndex = stringIndex(libraryName);
+  if (libraryNameIndex > UINT16_MAX) {
+    throw std::logic_error("library name index out of range");
+  }
+  auto const classInitializerCode = std::array<uint16_t, 6>{OP_CONST_STRING, static_cast<uint16_t>(libraryNameIndex), 1U << 12U | OP_INVOKE_STATIC,
+                                                            methodIndex(loadLibrary), 0, OP_RETURN_VOID};
+  auto const constructorCode = std::array<uint16_t, 4>{1U << 12U | OP_INVOKE_DIRECT, methodIndex(superConstructor), 0, OP_RETURN_VOID};
+  auto const classInitializerOffset = writeCode(1, 0, classInitializerCode);
+  auto const constructorOffset = writeCode(1, 1, constructorCode);
+
+  writer.align(4);
+  auto const typeListOffset = writer.offset();
+  writer.patch32(parametersOffsetAt, typeListOffset);
+  writer.write32(1);
+  writer.write16(typeIndex(STRING_DESCRIPTOR));
+
+  auto const stringDataOffset = writer.offset();
+  for (auto i = std::size_t{0}; i < strings.size(); i++) {
+    writer.patch32(stringIdsOffset + i * 4, writer.offset());
+    writer.writeString(strings[i]);
+  }
+
+  //
+  // Direct methods are sorted by method index and encoded as differences.
+  //
+  auto const classDataOffset = writer.offset();
+  writer.patch32(classDataOffsetAt, classDataOffset);
+  auto directMethods = std::vector<std::tuple<uint16_t, uint32_t, uint32_t>>{
+      {methodIndex(classInitializer), ACC_STATIC | ACC_CONSTRUCTOR, classInitializerOffset},
+      {methodIndex(constructor), ACC_PUBLIC | ACC_CONSTRUCTOR, constructorOffset},
+  };
+  std::sort(directMethods.begin(), directMethods.end());
+  writer.writeUleb128(0);
+  writer.writeUleb128(0);
+  writer.writeUleb128(static_cast<uint32_t>(directMethods.size()));
+  writer.writeUleb128(0);
+  auto previousMethodIndex = uint32_t{0};
+  for (auto const &[index, accessFlags, codeOffset] : directMethods) {
+    writer.writeUleb128(index - previousMethodIndex);
+    writer.writeUleb128(accessFlags);
+    writer.writeUleb128(codeOffset);
+    previousMethodIndex = index;
+  }
+
+  writer.align(4);
+  auto const mapOffset = writer.offset();
+  auto const mapItems = std::array{
+      MapItem{TYPE_HEADER_ITEM, 1, 0},
+      MapItem{TYPE_STRING_ID_ITEM, static_cast<uint32_t>(strings.size()), stringIdsOffset},
+      MapItem{TYPE_TYPE_ID_ITEM, static_cast<uint32_t>(types.size()), typeIdsOffset},
+      MapItem{TYPE_PROTO_ID_ITEM, 2, protoIdsOffset},
+      MapItem{TYPE_METHOD_ID_ITEM, static_cast<uint32_t>(methods.size()), methodIdsOffset},
+      MapItem{TYPE_CLASS_DEF_ITEM, 1, classDefsOffset},
+      MapItem{TYPE_CODE_ITEM, 2, classInitializerOffset},
+      MapItem{TYPE_TYPE_LIST, 1, typeListOffset},
+      MapItem{TYPE_STRING_DATA_ITEM, static_cast<uint32_t>(strings.size()), stringDataOffset},
+      MapItem{TYPE_CLASS_DATA_ITEM, 1, classDataOffset},
+      MapItem{TYPE_MAP_LIST, 1, mapOffset},
+  };
+  writer.write32(static_cast<uint32_t>(mapItems.size()));
+  for (auto const &item : mapItems) {
+    writer.write16(item.type);
+    writer.write16(0);
+    writer.write32(item.size);
+    writer.write32(item.offset);
+  }
+  auto const fileSize = writer.offset();
+
+  auto dex = writer.take();
+  std::memcpy(dex.data(), "dex\n035", 8);
+  auto const header = std::array<std::pair<std::size_t, uint32_t>, 16>{{
+      {FILE_SIZE_OFFSET, fileSize},
+      {HEADER_SIZE_OFFSET, static_cast<uint32_t>(HEADER_SIZE)},
+      {ENDIAN_TAG_OFFSET, ENDIAN_CONSTANT},
+      {MAP_OFFSET_OFFSET, mapOffset},
+      {STRING_IDS_OFFSET, static_cast<uint32_t>(strings.size())},
+      {STRING_IDS_OFFSET + 4, stringIdsOffset},
+      {TYPE_IDS_OFFSET, static_cast<uint32_t>(types.size())},
+      {TYPE_IDS_OFFSET + 4, typeIdsOffset},
+      {PROTO_IDS_OFFSET, 2},
+      {PROTO_IDS_OFFSET + 4, protoIdsOffset},
+      {METHOD_IDS_OFFSET, static_cast<uint32_t>(methods.size())},
+      {METHOD_IDS_OFFSET + 4, methodIdsOffset},
+      {CLASS_DEFS_OFFSET, 1},
+      {CLASS_DEFS_OFFSET + 4, classDefsOffset},
+      {DATA_OFFSET, fileSize - dataOffset},
+      {DATA_OFFSET + 4, dataOffset},
+  }};
+  for (auto const &[offset, value] : header) {
+    std::memcpy(dex.data() + offset, &value, sizeof(value));
+  }
+  updateDexChecksums(dex);
+  return dex;
+}
@@ -0,0 +1,76 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_DEX_PATCH_H_
+#define ANDROID_INTROSPECTION_APK_DEX_PATCH_H_
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace ai {
+
+//
+// Edits below work directly on the bytes of a DEX file, without parsing it
+// as a whole.  Descriptors are type descriptors, e.g. "Lcom/example/App;".
+//
+
+//
+// Offset of the class_def_item of the class, or std::nullopt if the file
+// does not define it.
+//
+auto findDexClassDefinition(std::span<std::byte const> dex, std::string_view descriptor) -> std::optional<std::size_t>;
+
+//
+// Clears ACC_FINAL in the class_def_item at the offset, so that the class
+// can be subclassed, and updates the signature and checksum of the file.
+// Returns whether the class was final.
+//
+auto clearDexClassFinal(std::vector<std::byte> &dex, std::size_t classDefinitionOffset) -> bool;
+
+//
+// SHA-1 signature and Adler-32 checksum of the header, over the rest of the
+// file.
+//
+auto updateDexChecksums(std::span<std::byte> dex) -> void;
+
+//
+// Same, after the bytes at the offset, past the signature, were changed in
+// place from originalBytes.  The checksum is adjusted for the changed bytes
+// and the new signature alone rather than summed over the file again, so it
+// is only right if it was before; the signature still covers the file.
+//
+auto updateDexChecksums(std::span<std::byte> dex, std::size_t patchOffset, std::span<std::byte const> originalBytes) -> void;
+
+//
+// Encodes a DEX file with a single public class extending the superclass,
+// whose static initializer calls System.loadLibrary(libraryName) and whose
+// only constructor forwards to the no argument one of the superclass.
+//
+auto encodeDexLoader(std::string_view loaderDescriptor, std::string_view superclassDescriptor, std::string_view libraryName) -> std::vector<std::byte>;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_DEX_PATCH_H_ */
@@ -0,0 +1,192 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "apk/directory_tree.h"
+#include "utils/log.h"
+#include "utils/trace.h"
+
+using namespace ai;
+
+namespace {
+
+struct BuildNode {
+
+  std::string_view name;
+
+  uint32_t entry = DirectoryNode::NO_ENTRY;
+
+  std::unordered_map<std::string_view, uint32_t> children;
+
+  auto isDirectory() const -> bool { return !children.empty() || entry == DirectoryNode::NO_ENTRY; }
+};
+
+} // namespace
+
+DirectoryTree::DirectoryTree(std::span<ApkEntry const> const entries) {
+  TRACE_SPAN("DirectoryTree::DirectoryTree");
+  if (entries.size() >= DirectoryNode::NO_ENTRY) {
+    throw std::logic_error("too many entries");
+  }
+
+  //
+  // Paths are split into nodes that point into them, then laid out breadth
+  // first so that the children of a node follow each other.
+  //
+  auto buildNodes = std::vector<BuildNode>(1);
+  for (auto entry = uint32_t{0}; entry < entries.size(); entry++) {
+    auto const path = std::string_view(entries[entry].path);
+    auto node = uint32_t{ROOT};
+    for (size_t componentStart{0}; componentStart < path.size();) {
+      auto const componentEnd = std::min(path.find('/', componentStart), path.size());
+      auto const component = path.substr(componentStart, componentEnd - componentStart);
+      componentStart = componentEnd + 1;
+      if (component.empty()) {
+        continue;
+      }
+      auto const [child, isAdded] = buildNodes[node].children.try_emplace(component, static_cast<uint32_t>(buildNodes.size()));
+      node = child->second;
+      if (isAdded) {
+        buildNodes.push_back(BuildNode{component, DirectoryNode::NO_ENTRY, {}});
+      }
+    }
+    if (node != ROOT && !path.ends_with('/') && buildNodes[node].entry == DirectoryNode::NO_ENTRY) {
+      buildNodes[node].entry = entry;
+    }
+  }
+
+  auto nameOffsets = std::unordered_map<std::string_view, uint32_t>();
+  auto const intern = [this, &nameOffsets](std::string_view const name) {
+    auto const [offset, isAdded] = nameOffsets.try_emplace(name, static_cast<uint32_t>(names_.size()));
+    if (isAdded) {
+      names_.append(name);
+    }
+    return offset->second;
+  };
+  auto const addNode = [this, &entries, &intern](BuildNode const &buildNode, uint32_t const parent) {
+    auto node = DirectoryNode{parent, intern(buildNode.name), static_cast<uint32_t>(buildNode.name.size()), 0, 0, buildNode.entry, 0, 0, 0};
+    if (buildNode.entry != DirectoryNode::NO_ENTRY) {
+      node.fileCount = 1;
+      node.compressedSize = entries[buildNode.entry].compressedSize;
+      node.uncompressedSize = entries[buildNode.entry].uncompressedSize;
+    }
+    nodes_.push_back(node);
+  };
+  nodes_.reserve(buildNodes.size());
+  auto order = std::vector<uint32_t>{ROOT};
+  order.reserve(buildNodes.size());
+  addNode(buildNodes[ROOT], ROOT);
+  auto children = std::vector<uint32_t>();
+  for (auto node = uint32_t{0}; node < order.size(); node++) {
+    auto const &buildNode = buildNodes[order[node]];
+    children.clear();
+    for (auto const &[name, child] : buildNode.children) {
+      children.push_back(child);
+    }
+    std::sort(children.begin(), children.end(), [&buildNodes](uint32_t const a, uint32_t const b) {
+      return std::pair(!buildNodes[a].isDirectory(), buildNodes[a].name) < std::pair(!buildNodes[b].isDirectory(), buildNodes[b].name);
+    });
+    nodes_[node].firstChild = static_cast<uint32_t>(order.size());
+    nodes_[node].childCount = static_cast<uint32_t>(children.size());
+    for (auto const child : children) {
+      order.push_back(child);
+      addNode(buildNodes[child], node);
+    }
+  }
+
+  //
+  // Children come after their parent, so one pass from the back sums every
+  // subtree.
+  //
+  for (auto node = nodes_.size() - 1; node > ROOT; node--) {
+    auto &parent = nodes_[nodes_[node].parent];
+    parent.fileCount += nodes_[node].fileCount;
+    parent.compressedSize += nodes_[node].compressedSize;
+    parent.uncompressedSize += nodes_[node].uncompressedSize;
+  }
+  LOGD("directory tree, [{}] nodes from [{}] entries, [{}] bytes of names", nodes_.size(), entries.size(), names_.size());
+}
+
+auto DirectoryTree::getName(uint32_t const node) const -> std::string_view {
+  auto const &directoryNode = getNode(node);
+  return std::string_view(names_).substr(directoryNode.nameOffset, directoryNode.nameSize);
+}
+
+auto DirectoryTree::getPath(uint32_t const node) const -> std::string {
+  auto components = std::vector<std::string_view>();
+  for (auto current = node; current != ROOT; current = getNode(current).parent) {
+    components.push_back(getName(current));
+  }
+  auto path = std::string();
+  for (auto component = components.rbegin(); component != components.rend(); component++) {
+    if (!path.empty()) {
+      path += '/';
+    }
+    path += *component;
+  }
+  return path;
+}
+
+auto DirectoryTree::listDirectory(uint32_t const node) const -> std::span<DirectoryNode const> {
+  auto const &directoryNode = getNode(node);
+  return std::span(nodes_).subspan(directoryNode.firstChild, directoryNode.childCount);
+}
+
+auto DirectoryTree::find(std::string_view const path) const -> std::optional<uint32_t> {
+  auto node = uint32_t{ROOT};
+  for (size_t componentStart{0}; componentStart < path.size();) {
+    auto const componentEnd = std::min(path.find('/', componentStart), path.size());
+    auto const component = path.substr(componentStart, componentEnd - componentStart);
+    componentStart = componentEnd + 1;
+    if (component.empty()) {
+      continue;
+    }
+    auto const &directoryNode = nodes_[node];
+    auto const first = nodes_.begin() + directoryNode.firstChild;
+    auto const last = first + directoryNode.childCount;
+    auto const getNodeName = [this](DirectoryNode const &child) { return std::string_view(names_).substr(child.nameOffset, child.nameSize); };
+
+    //
+    // Either a directory or a file; both groups are sorted by name.
+    //
+    auto const files = std::partition_point(first, last, [](DirectoryNode const &child) { return child.isDirectory(); });
+    auto found = std::optional<uint32_t>();
+    for (auto const &[groupFirst, groupLast] : {std::pair(first, files), std::pair(files, last)}) {
+      auto const child = std::lower_bound(groupFirst, groupLast, component,
+                                          [&getNodeName](DirectoryNode const &child, std::string_view const name) { return getNodeName(child) < name; });
+      if (child != groupLast && getNodeName(*child) == component) {
+        found = static_cast<uint32_t>(child - nodes_.begin());
+        break;
+      }
+    }
+    if (!found) {
+      return std::nullopt;
+    }
+    node = *found;
+  }
+  return node;
+}
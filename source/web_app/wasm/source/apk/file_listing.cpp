@@ -0,0 +1,65 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <utility>
+
+#include "apk/file_listing.h"
+#include "utils/glob.h"
+
+using namespace ai;
+
+auto ai::matchesPathFilter(std::string_view const filter, std::string_view const path) -> bool {
+  if (filter.empty()) {
+    return true;
+  }
+  auto const isGlob = filter.find_first_of("*?") != std::string_view::npos;
+  return isGlob ? utils::matchesGlob(filter, path) : path.find(filter) != std::string_view::npos;
+}
+
+FileListing::FileListing(std::vector<std::string> files) : files_(std::move(files)), matches_(files_.size()) {
+  for (auto file = uint32_t{0}; file < matches_.size(); file++) {
+    matches_[file] = file;
+  }
+}
+
+auto FileListing::getPage(size_t const offset, size_t const limit, std::string_view const filter) -> FilePage {
+  if (filter != filter_) {
+    matches_.clear();
+    for (auto file = uint32_t{0}; file < files_.size(); file++) {
+      if (matchesPathFilter(filter, files_[file])) {
+        matches_.push_back(file);
+      }
+    }
+    filter_ = filter;
+  }
+  auto const pageStart = std::min(offset, matches_.size());
+  auto const pageEnd = pageStart + std::min(limit, matches_.size() - pageStart);
+  names_.clear();
+  offsets_.assign(1, 0);
+  for (auto match = pageStart; match < pageEnd; match++) {
+    names_ += files_[matches_[match]];
+    offsets_.push_back(static_cast<uint32_t>(names_.size()));
+  }
+  return {matches_.size(), names_, offsets_};
+}
@@ -0,0 +1,135 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <optional>
+#include <set>
+#include <span>
+#include <stdexcept>
+
+#include "android_manifest_parser.h"
+#include "apk/apk_paths.h"
+#include "dex_patch.h"
+#include "gadget_injector.h"
+#include "utils/log.h"
+#include "zip_archiver.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr char const *const ANDROID_MANIFEST = "AndroidManifest.xml";
+
+static constexpr char const *const DEFAULT_APPLICATION_CLASS = "android.app.Application";
+
+//
+// Names starting with a dot or without any are relative to the package.
+//
+auto getClassName(std::string const &packageName, std::string const &name) -> std::string {
+  if (name.empty()) {
+    return DEFAULT_APPLICATION_CLASS;
+  }
+  if (name.starts_with('.')) {
+    return packageName + name;
+  }
+  return name.find('.') == std::string::npos ? packageName + "." + name : name;
+}
+
+auto getDescriptor(std::string className) -> std::string {
+  std::replace(className.begin(), className.end(), '.', '/');
+  return "L" + className + ";";
+}
+
+} // namespace
+
+auto ai::injectGadget(std::string_view const apkPath, std::string_view const destinationPath, GadgetInjectorOptions const &options,
+                      utils::ThreadPool &threadPool) -> void {
+  LOGD("injectGadget, apkPath [{}] destinationPath [{}]", apkPath, destinationPath);
+  auto const archive = ZipArchiver(apkPath);
+  auto const entries = archive.entries();
+  auto abis = std::set<std::string>();
+  auto storedLibraries = false;
+  for (auto const &entry : entries) {
+    if (auto const abi = getLibraryAbi(entry.path)) {
+      abis.emplace(*abi);
+      storedLibraries |= entry.compressionMethod == static_cast<uint16_t>(ZipCompression::Store);
+    }
+  }
+  if (abis.empty()) {
+    for (auto const &[abi, gadget] : options.gadgets) {
+      abis.insert(abi);
+    }
+  }
+  if (abis.empty()) {
+    throw std::logic_error("no gadgets to inject");
+  }
+
+  auto manifest = AndroidManifestParser(archive.extract(ANDROID_MANIFEST));
+  auto const applicationClass = getClassName(manifest.getPackageName(), manifest.getApplicationName());
+  auto const compression = storedLibraries || !manifest.isExtractingNativeLibraries() ? ZipCompression::Store : ZipCompression::Deflate;
+  auto transaction = ZipTransaction();
+  auto const configBytes = std::as_bytes(std::span(options.config));
+  auto const config = configBytes.empty() ? nullptr : std::make_shared<std::vector<std::byte> const>(configBytes.begin(), configBytes.end());
+  for (auto const &abi : abis) {
+    auto const gadget = options.gadgets.find(abi);
+    if (gadget == options.gadgets.end() || gadget->second == nullptr) {
+      throw std::logic_error("no gadget for abi " + abi);
+    }
+    auto const libraryPath = std::string(LIBRARY_DIRECTORY) + abi + "/lib" + options.libraryName;
+    transaction.add(libraryPath + std::string(LIBRARY_EXTENSION), gadget->second, compression);
+    if (config != nullptr) {
+      transaction.add(libraryPath + ".config" + std::string(LIBRARY_EXTENSION), config, compression);
+    }
+  }
+
+  //
+  // The loader goes into a DEX file of its own after the last one, which
+  // the platform loads along with the others; the application class can
+  // live in any of them.
+  //
+  auto dexFileCount = std::size_t{0};
+  while (archive.contains(getDexFileName(dexFileCount))) {
+    dexFileCount++;
+  }
+  if (dexFileCount == 0) {
+    throw std::logic_error("apk has no dex files");
+  }
+  auto const applicationDescriptor = getDescriptor(applicationClass);
+  if (applicationClass != DEFAULT_APPLICATION_CLASS) {
+    for (auto index = std::size_t{0}; index < dexFileCount; index++) {
+      auto dex = archive.extract(getDexFileName(index));
+      if (auto const classDefinition = findDexClassDefinition(dex, applicationDescriptor)) {
+        if (clearDexClassFinal(dex, *classDefinition)) {
+          LOGD("injectGadget, application class [{}] is no longer final", applicationClass);
+          transaction.replace(getDexFileName(index), std::move(dex));
+        }
+        break;
+      }
+    }
+  }
+  transaction.add(getDexFileName(dexFileCount), encodeDexLoader(getDescriptor(options.loaderClass), applicationDescriptor, options.libraryName));
+
+  manifest.setApplicationName(options.loaderClass);
+  transaction.replace(ANDROID_MANIFEST, manifest.toBinaryXml()).align(ZipAlignment());
+  archive.commit(transaction, destinationPath, threadPool);
+}
@@ -0,0 +1,78 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_GADGET_INJECTOR_H_
+#define ANDROID_INTROSPECTION_APK_GADGET_INJECTOR_H_
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ai {
+
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+struct GadgetInjectorOptions {
+
+  //
+  // libfrida-gadget.so for every ABI it may be injected for, e.g.
+  // "arm64-v8a".  ABIs may share a binary, which is then compressed once.
+  //
+  std::map<std::string, std::shared_ptr<std::vector<std::byte> const>> gadgets;
+
+  //
+  // Contents of the gadget configuration written next to every gadget, as
+  // lib<libraryName>.config.so; none if empty.
+  //
+  std::string config;
+
+  std::string libraryName = "frida-gadget";
+
+  //
+  // Class loading the gadget, in Java notation.
+  //
+  std::string loaderClass = "com.github.jonforshort.introspection.GadgetApplication";
+};
+
+//
+// Writes a copy of the APK to destinationPath that loads the gadget on
+// start up.  The gadget is added for every ABI the APK has libraries for,
+// or for every ABI of the options if it has none.  A DEX file is added
+// with a subclass of the application class whose static initializer loads
+// the gadget, and the manifest is pointed at it; the DEX file defining the
+// application class is only patched, in place, if the class is final.
+//
+// The copy is written in a single pass: untouched entries are copied as
+// raw compressed bytes, and new and changed ones are compressed on the
+// pool.  The copy still has to be signed before it can be installed.
+//
+auto injectGadget(std::string_view apkPath, std::string_view destinationPath, GadgetInjectorOptions const &options, utils::ThreadPool &threadPool) -> void;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_GADGET_INJECTOR_H_ */
@@ -24,44 +24,531 @@
 #ifndef ANDROID_INTROSPECTION_APK_APK_H_
 #define ANDROID_INTROSPECTION_APK_APK_H_
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
 #include <map>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "apk_exception.h"
+#include "content_type.h"
+#include "manifest_components.h"
+#include "utils/cancellation.h"
+#include "utils/sha.h"
 
 namespace ai {
 
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+struct ApkBatchOptions;
+
+struct ApkExtractOptions;
+
+struct ApkGrepOptions;
+
+struct ApkBatchResult;
+
+struct PermissionIndex;
+
+class ZipStreamWriter;
+
+using ApkBatchCallback = std::function<void(ApkBatchResult)>;
+
+//
+// Reads up to buffer.size() bytes of an APK at offset and returns how many
+// were read, short only at the end.  It may be called from several threads,
+// unless the APK is opened with ApkFetcherThreads::Opening.
+//
+using ApkRangeFetcher = std::function<size_t(uint64_t offset, std::span<std::byte> buffer)>;
+
+//
+// Threads an ApkRangeFetcher may be called on: any, or only the one that
+// opened the APK, e.g. for a fetcher reading a Blob through JS objects that
+// belong to that thread.  An APK whose fetcher is bound to the opening
+// thread runs its calls there, whatever pool they are given.
+//
+enum class ApkFetcherThreads : uint8_t { Any, Opening };
+
+//
+// Called on the calling thread with how many of the bytes of the APK a long
+// call has gone through so far.
+//
+using ApkProgressCallback = std::function<void(uint64_t bytesProcessed, uint64_t bytesTotal)>;
+
+struct ApkEntry {
+
+  std::string path;
+
+  uint64_t compressedSize;
+
+  uint64_t uncompressedSize;
+
+  uint32_t crc;
+
+  uint16_t compressionMethod;
+
+  uint64_t offset;
+};
+
+//
+// SHA-256 of the uncompressed contents of an entry.
+//
+struct ApkEntryDigest {
+
+  std::string path;
+
+  utils::sha::Sha256Digest sha256;
+};
+
+//
+// Where one of the patterns of grep() occurs in the uncompressed contents of
+// an entry.
+//
+struct ApkGrepMatch {
+
+  std::string path;
+
+  uint32_t pattern;
+
+  uint64_t offset;
+};
+
+enum class ApkPropertyField : uint32_t {
+  Package = 1U << 0U,
+  Version = 1U << 1U,
+  Debuggable = 1U << 2U,
+  Manifest = 1U << 3U,
+  Sha256 = 1U << 4U,
+};
+
+//
+// How far isValid() goes.  Full parses the manifest.  Quick only reads the
+// central directory, the local header of the manifest and its first bytes,
+// to triage large sets of APKs; an APK passing it may still fail Full.
+//
+enum class ApkValidation : uint8_t { Full, Quick };
+
+//
+// Bytes of a file of an APK, valid for as long as this object lives or up
+// to the next write through the Apk they came from.  Stored files are a
+// view of the memory mapped APK; compressed ones are inflated once.
+//
+class ApkFileBytes final {
+public:
+  ApkFileBytes(std::shared_ptr<void const> owner, std::span<std::byte const> const bytes) : owner_(std::move(owner)), bytes_(bytes) {}
+
+  auto bytes() const -> std::span<std::byte const> { return bytes_; }
+
+private:
+  std::shared_ptr<void const> owner_;
+
+  std::span<std::byte const> bytes_;
+};
+
+//
+// Set of the fields getProperties() computes; "valid" is always reported.
+//
+class ApkPropertyFields final {
+public:
+  constexpr ApkPropertyFields(std::initializer_list<ApkPropertyField> const fields) {
+    for (auto const field : fields) {
+      fields_ |= static_cast<uint32_t>(field);
+    }
+  }
+
+  static constexpr auto all() -> ApkPropertyFields {
+    return {ApkPropertyField::Package, ApkPropertyField::Version, ApkPropertyField::Debuggable, ApkPropertyField::Manifest, ApkPropertyField::Sha256};
+  }
+
+  constexpr auto contains(ApkPropertyField const field) const -> bool { return (fields_ & static_cast<uint32_t>(field)) != 0; }
+
+  constexpr auto bits() const -> uint32_t { return fields_; }
+
+private:
+  uint32_t fields_ = 0;
+};
+
+//
+// An APK opened as a session: the archive handle, its central directory and
+// the parsed manifest and resources are kept across calls and dropped when
+// the file changes, through this class or otherwise.
+//
+// Reads may be called from any number of threads at once, e.g. by the
+// workers of a server sharing one open APK.  They share the central
+// directory, manifest and resources, parsed once, and read entries through
+// an archive handle per thread.  Writes, setFileContent() and the in place
+// makeDebuggable(), must not overlap any other call.
+//
 class Apk final {
 public:
   explicit Apk(std::string_view apkPath);
 
+  //
+  // Same as above, but properties and entries are kept in an analysis cache
+  // in the directory, shared by every copy of the same APK.  Repeat opens
+  // only read the central directory and one cache record.
+  //
+  Apk(std::string_view apkPath, std::string_view cacheDirectory);
+
+  //
+  // Opens an APK held in memory, e.g. a buffer handed over by JS, without a
+  // copy on a file system.  It is read only: writing to it throws, though
+  // debuggable copies can still be written to a destination path.  With a
+  // cache directory it shares the analysis cache with APKs opened from files.
+  //
+  explicit Apk(std::vector<std::byte> contents, std::string_view cacheDirectory = {});
+
+  //
+  // Opens an APK that is read in ranges, e.g. slices of a browser Blob too
+  // large for the Wasm heap.  Only the central directory and the entries
+  // asked for are fetched; like the above it is read only.  A cache hit only
+  // fetches the central directory.
+  //
+  Apk(uint64_t size, ApkRangeFetcher fetcher, std::string_view cacheDirectory = {}, ApkFetcherThreads fetcherThreads = ApkFetcherThreads::Any);
+
+  //
+  // Opens the APK behind a descriptor, e.g. a ParcelFileDescriptor of an
+  // installed package or of a document picked through the storage access
+  // framework.  It is mapped, or read with pread() when it can't be, so the
+  // descriptor may be closed once this returns.  Like the above it is read
+  // only.
+  //
+  explicit Apk(int fd, std::string_view cacheDirectory = {});
+
   ~Apk();
 
   auto isValid() const -> bool;
 
+  auto isValid(ApkValidation validation) const -> bool;
+
   auto makeDebuggable() const -> void;
 
+  //
+  // Writes a debuggable, zipaligned copy of the APK to destinationPath in a
+  // single pass, copying every entry but the manifest as raw compressed
+  // bytes.  The copy still has to be signed before it can be installed.
+  //
+  auto makeDebuggable(std::string_view destinationPath) const -> void;
+
   auto isDebuggable() const -> bool;
 
   auto getAndroidManifest() const -> std::string;
 
+  //
+  // Same as above, but the text is handed to onChunk in pieces as it is
+  // rendered, so it can be shown before the whole manifest is.
+  //
+  auto getAndroidManifest(std::function<void(std::string_view)> const &onChunk) const -> void;
+
+  //
+  // The manifest as a JSON tree of elements and interned strings, for a UI
+  // to show without parsing the text again; see XmlTreeVisitor.
+  //
+  auto getAndroidManifestTree() const -> std::string;
+
+  //
+  // Components of the manifest with their intent filters, indexed for
+  // lookups by action; see ManifestComponents.
+  //
+  auto getManifestComponents() const -> ManifestComponents;
+
   auto getFiles() const -> std::vector<std::string>;
 
+  //
+  // Sizes, CRC, compression method and local header offset of every entry,
+  // read from the central directory alone.
+  //
+  auto getEntries() const -> std::vector<ApkEntry>;
+
   auto getFileContent(std::string_view filePath) const -> std::vector<std::byte>;
 
+  //
+  // Same as above without a copy for stored files.
+  //
+  auto getFileBytes(std::string_view filePath) const -> ApkFileBytes;
+
+  //
+  // Files a user who opened the manifest is likely to open next, most
+  // likely first: the layout of the launcher activity, resources.arsc and
+  // the main DEX.
+  //
+  auto getLikelyNextFiles() const -> std::vector<std::string>;
+
+  //
+  // Reads the file into the session ahead of use, e.g. while the UI is
+  // idle, so that getFileBytes() and getFileContent() serve it without
+  // inflating it again; resources.arsc is parsed instead.  Prefetched
+  // entries take at most 32 MB and count against the memory budget until
+  // the session ends.  Returns whether the file is ready; failures are
+  // logged, not thrown.
+  //
+  auto prefetch(std::string_view filePath) const -> bool;
+
+  //
+  // The first size bytes of a file, e.g. for its header or magic bytes;
+  // inflating stops there.
+  //
+  auto getFilePrefix(std::string_view filePath, size_t size) const -> std::vector<std::byte>;
+
+  //
+  // What every file entry is from its first CONTENT_PREFIX_SIZE bytes, see
+  // classifyContent(), sorted by path.  Entries are peeked at on the workers
+  // of the pool and at most that many bytes of each are inflated.
+  //
+  auto classifyEntries() const -> std::vector<ApkEntryContentType>;
+
+  //
+  // Every occurrence of any of the patterns in the files picked by the
+  // options, sorted by path and offset, without an index: entries are
+  // inflated in chunks on the workers of the pool and fed to the matcher as
+  // they are, so none is held whole.  Suits one-off searches, e.g. of large
+  // asset bundles; SearchIndex of the dex library is for repeat ones.
+  //
+  auto grep(std::span<std::string const> patterns, ApkGrepOptions const &options, utils::ThreadPool &threadPool) const -> std::vector<ApkGrepMatch>;
+
+  auto classifyEntries(utils::ThreadPool &threadPool) const -> std::vector<ApkEntryContentType>;
+
+  //
+  // Replaces the entry at the path, or adds it if the APK lacks it.
+  //
+  auto setFileContent(std::string_view filePath, std::vector<std::byte> const &contents) const -> void;
+
+  //
+  // Every resource of resources.arsc by name, e.g. "string/app_name", with
+  // its value as text: strings as they are, references by name and other
+  // values as decoded xml shows them.  The default configuration of an
+  // entry is preferred; bags only name the bag they extend.
+  //
+  auto getResourceValues() const -> std::map<std::string, std::string>;
+
+  //
+  // SHA-256 of every file entry, sorted by path.  Entries are inflated and
+  // hashed in chunks on the workers of the pool, so none is held in memory
+  // whole.  With a cache the table is kept in it.
+  //
+  auto hashEntries() const -> std::vector<ApkEntryDigest>;
+
+  auto hashEntries(utils::ThreadPool &threadPool) const -> std::vector<ApkEntryDigest>;
+
+  //
+  // Data derived from the APK that the analysis cache keeps for it, e.g. a
+  // search index.  Nothing is loaded or stored without a cache.
+  //
+  auto loadCachedData(std::string_view name) const -> std::optional<std::vector<std::byte>>;
+
+  auto storeCachedData(std::string_view name, std::span<std::byte const> data) const -> void;
+
   auto getProperties() const -> std::map<std::string, std::string>;
 
-  auto dump(std::string_view destinationDirectory) const -> void;
+  //
+  // Same as above, but only with the requested fields: package and version
+  // come from the manifest alone, while the manifest text needs the resource
+  // table and the hash reads the whole file.
+  //
+  auto getProperties(ApkPropertyFields fields) const -> std::map<std::string, std::string>;
+
+  //
+  // Same as above, reporting the progress of hashing the file, the longest
+  // part for a large APK, to onProgress while it runs.  onProgress may throw
+  // utils::CancellationException to stop waiting; the hash is then finished
+  // in the background for the next call if there is a background thread.
+  //
+  auto getProperties(ApkPropertyFields fields, ApkProgressCallback const &onProgress) const -> std::map<std::string, std::string>;
+
+  //
+  // Most bytes this APK may take at once for what it inflates and parses,
+  // on top of the APK itself; 0, the default, for no limit.  Going past it
+  // throws utils::memory::MemoryBudgetExceededException instead of running
+  // out of memory.  Where there is a leaner way, e.g. references rendered by
+  // id without the resource table or a dump decoding one file at a time, it
+  // is taken rather than throwing.  Live bytes are reported in the
+  // "memory.apk.*" gauges.
+  //
+  auto setMemoryBudget(uint64_t bytes) const -> void;
+
+  //
+  // Writes the manifest and the decoded resources under
+  // destinationDirectory.  cancellation is checked before every resource and
+  // throws utils::CancellationException once set.
+  //
+  auto dump(std::string_view destinationDirectory, utils::CancellationToken const &cancellation = {}) const -> void;
+
+  //
+  // Same as above, but the manifest and the decoded resources are added to
+  // writer as they finish rather than written under a directory, e.g. for
+  // one zip streamed to a download.  The caller adds anything else and
+  // finishes the archive.
+  //
+  auto dump(ZipStreamWriter &writer, utils::CancellationToken const &cancellation = {}) const -> void;
+
+  //
+  // Writes the files picked by the options under destinationDirectory and
+  // returns how many were written.  Entries are picked from the central
+  // directory alone, then inflated, and decoded if asked to, on the workers
+  // of the pool and written through utils::FileOutput.  Paths that would
+  // leave the directory are skipped.
+  //
+  auto extract(std::string_view destinationDirectory, ApkExtractOptions const &options, utils::ThreadPool &threadPool) const -> size_t;
 
 private:
+  friend auto analyzeMany(std::span<std::string const> apkPaths, ApkBatchOptions const &options, utils::ThreadPool &threadPool,
+                          ApkBatchCallback const &callback) -> void;
+
+  friend auto indexPermissions(std::span<std::string const> apkPaths, ApkBatchOptions const &options, utils::ThreadPool &threadPool) -> PermissionIndex;
+
   class ApkImpl;
 
   std::unique_ptr<ApkImpl> const pimpl_;
 };
 
+struct ApkBatchOptions {
+
+  ApkPropertyFields fields = ApkPropertyFields::all();
+
+  //
+  // Analysis cache shared by the batch, none if empty.
+  //
+  std::string cacheDirectory;
+
+  //
+  // Most APKs being analyzed or waiting for the callback at once; 0 for
+  // twice the threads of the pool.
+  //
+  size_t maxInFlight = 0;
+
+  //
+  // Stops handing out APKs once cancelled; those in flight are let finish
+  // and reported, then utils::CancellationException is thrown.
+  //
+  utils::CancellationToken cancellation;
+};
+
+//
+// How extract() puts a file of its content store at its destination.
+// Hardlinks share the read-only file of the store, so extracted files must
+// be replaced rather than changed in place; clones, on file systems with
+// copy on write, and the copies they fall back to elsewhere don't.
+// Either falls back to writing the file.
+//
+enum class ApkStoreLink : uint8_t { Hardlink, Clone };
+
+struct ApkExtractOptions {
+
+  //
+  // Globs of utils::matchesGlob() the path of a file has to match one of,
+  // e.g. "res/**/*.xml"; every file if empty.
+  //
+  std::vector<std::string> include;
+
+  //
+  // Writes binary xml files as text, with references resolved through the
+  // resource table; other files are written as they are.
+  //
+  bool decodeXml = false;
+
+  //
+  // Directory of contents shared by extracts, e.g. of every version of an
+  // app.  Entries already in it, by CRC-32 and size, are linked to their
+  // destination instead of being inflated and written again; others are
+  // added to it.  None if empty; ignored when decoding xml.
+  //
+  std::string contentStore;
+
+  //
+  // Keys the store on the SHA-256 of the contents too, for when entries
+  // of the same CRC-32 and size may differ.  Every entry is then inflated
+  // to be hashed, though hits are still not written.
+  //
+  bool verifyContents = false;
+
+  ApkStoreLink storeLink = ApkStoreLink::Clone;
+
+  //
+  // Checked before every entry is inflated; utils::CancellationException is
+  // thrown once the workers stopped, with the files written so far left in
+  // place.
+  //
+  utils::CancellationToken cancellation;
+};
+
+struct ApkGrepOptions {
+
+  //
+  // Globs the path of a file has to match one of, as for ApkExtractOptions;
+  // every file if empty.
+  //
+  std::vector<std::string> include;
+
+  //
+  // ASCII letters match either case unless set.
+  //
+  bool caseSensitive = true;
+
+  //
+  // Entries stop being searched once as many matches were found; which
+  // ones are kept then depends on the order workers got to them.
+  //
+  size_t maxMatches = 1000;
+
+  //
+  // Checked before every entry; utils::CancellationException is thrown once
+  // the workers stopped.
+  //
+  utils::CancellationToken cancellation;
+};
+
+struct ApkBatchResult {
+
+  std::string path;
+
+  std::map<std::string, std::string> properties;
+
+  //
+  // Why the APK could not be analyzed; properties are empty if set.
+  //
+  std::string error;
+};
+
+//
+// Analyzes every APK on the workers of the pool: each one is opened, parsed
+// and hashed on a single worker.  Results are handed to callback on the
+// calling thread as they finish, in no particular order, and no more than
+// maxInFlight APKs are held at any time.
+//
+auto analyzeMany(std::span<std::string const> apkPaths, ApkBatchOptions const &options, utils::ThreadPool &threadPool, ApkBatchCallback const &callback)
+    -> void;
+
+struct ApkScanTarget {
+
+  std::string path;
+
+  //
+  // When the package of the APK was last updated, e.g. the lastUpdateTime of
+  // its PackageInfo.
+  //
+  int64_t lastUpdateTime = 0;
+};
+
+//
+// Same as analyzeMany(), but APKs whose path, size and last update time are
+// in the scan index at indexPath are not opened: their properties come from
+// the index, so a rescan only analyzes what changed.  The index is rewritten
+// with the targets of this scan, dropping APKs that are gone; a cancelled
+// scan throws before that and leaves the previous index.  Returns how many
+// APKs were analyzed.
+//
+auto scanMany(std::span<ApkScanTarget const> targets, std::string_view indexPath, ApkBatchOptions const &options, utils::ThreadPool &threadPool,
+              ApkBatchCallback const &callback) -> size_t;
+
 } // namespace ai
 
 #endif /* ANDROID_INTROSPECTION_APK_APK_H_ */
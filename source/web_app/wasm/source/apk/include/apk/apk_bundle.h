@@ -0,0 +1,81 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_APK_BUNDLE_H_
+#define ANDROID_INTROSPECTION_APK_APK_BUNDLE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ai {
+
+//
+// Base APK together with its split APKs, presented as one merged file view.
+// All splits are indexed concurrently when the bundle is opened; manifests
+// are only decoded when asked for.
+//
+class ApkBundle final {
+public:
+  //
+  // Opens the given APKs; the first one is the base.
+  //
+  explicit ApkBundle(std::vector<std::string> const &apkPaths);
+
+  //
+  // Opens an .xapk or .apks container, or a single APK.
+  //
+  explicit ApkBundle(std::string_view bundlePath);
+
+  ~ApkBundle();
+
+  //
+  // Names of the splits, the base first.
+  //
+  auto getSplits() const -> std::vector<std::string>;
+
+  //
+  // Files of all splits; a file present in several splits is listed once
+  // and resolves to the first split that has it.
+  //
+  auto getFiles() const -> std::vector<std::string>;
+
+  auto getSplitOf(std::string_view filePath) const -> std::string;
+
+  auto getFileContent(std::string_view filePath) const -> std::vector<std::byte>;
+
+  auto getFileContent(std::string_view split, std::string_view filePath) const -> std::vector<std::byte>;
+
+  auto getAndroidManifest(std::string_view split) const -> std::string;
+
+private:
+  class ApkBundleImpl;
+
+  std::unique_ptr<ApkBundleImpl> const pimpl_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_APK_BUNDLE_H_ */
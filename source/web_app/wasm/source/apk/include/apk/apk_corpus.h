@@ -0,0 +1,97 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_APK_CORPUS_H_
+#define ANDROID_INTROSPECTION_APK_APK_CORPUS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ai {
+
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+//
+// Shape of a synthetic APK, to measure how parsing scales with one dimension
+// at a time.  Every APK has a manifest; the other parts are only added when
+// their count is not 0.
+//
+struct ApkCorpusShape {
+
+  std::string name;
+
+  //
+  // Deflated entries of tinyEntrySize bytes under assets/tiny/.
+  //
+  size_t tinyEntries = 0;
+
+  size_t tinyEntrySize = 32;
+
+  //
+  // Stored entries of storedAssetSize bytes under assets/large/, written
+  // one after the other from one buffer; zip64 past 4 GiB.
+  //
+  size_t storedAssets = 0;
+
+  uint64_t storedAssetSize = 0;
+
+  //
+  // Activities declared in the manifest.
+  //
+  size_t manifestComponents = 0;
+
+  //
+  // Distinct strings of the UTF-16 string pool of res/layout/strings.xml,
+  // one TextView each.
+  //
+  size_t layoutStrings = 0;
+
+  //
+  // Nested LinearLayouts of res/layout/deep.xml.
+  //
+  size_t layoutDepth = 0;
+};
+
+//
+// The shapes of the scale-test corpus: 100k tiny entries, 3 GiB of stored
+// assets, 10k components in the manifest, 100k strings in a pool and 1k
+// nested layouts.
+//
+auto getApkCorpusShapes() -> std::vector<ApkCorpusShape>;
+
+//
+// Writes an unsigned APK of the shape to destinationPath, replacing what is
+// there.  Small entries are compressed on the workers of the pool and the
+// archive is written in one commit; stored assets are appended afterwards so
+// only one of them is ever in memory.
+//
+auto generateCorpusApk(std::string_view destinationPath, ApkCorpusShape const &shape, utils::ThreadPool &threadPool) -> void;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_APK_CORPUS_H_ */
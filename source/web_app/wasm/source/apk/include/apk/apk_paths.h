@@ -1,7 +1,7 @@
 //
 // MIT License
 //
-// Copyright 2020
+// Copyright 2019
 //
 // Permission is hereby granted, free of charge, to any person obtaining a copy
 // of this software and associated documentation files (the "Software"), to deal
@@ -21,33 +21,32 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
-#ifndef ANDROID_INTROSPECTION_APK_ATTRIBUTES_SETTER_VISITOR_H_
-#define ANDROID_INTROSPECTION_APK_ATTRIBUTES_SETTER_VISITOR_H_
+#ifndef ANDROID_INTROSPECTION_APK_APK_PATHS_H_
+#define ANDROID_INTROSPECTION_APK_APK_PATHS_H_
 
+#include <cstddef>
+#include <optional>
 #include <string>
 #include <string_view>
-#include <vector>
-
-#include "binary_xml_visitor.h"
 
 namespace ai {
 
-class AttributesSetterVisitor : public BinaryXmlVisitor {
-
-public:
-  AttributesSetterVisitor(std::vector<std::string> const &elementPath, std::string_view attributeName, std::string_view attributeValue);
-
-  ~AttributesSetterVisitor() override = default;
-
-  auto visit(StartXmlTagElement const &element) -> void override;
+static constexpr std::string_view LIBRARY_DIRECTORY = "lib/";
 
-  auto visit(EndXmlTagElement const &element) -> void override;
+static constexpr std::string_view LIBRARY_EXTENSION = ".so";
 
-  auto visit(CDataTagElement const &element) -> void override;
+//
+// Name of the dex file of the index, in the order Android loads them:
+// classes.dex, classes2.dex, classes3.dex, ...
+//
+auto getDexFileName(std::size_t index) -> std::string;
 
-  auto visit(InvalidXmlTagElement const &element) -> void override;
-};
+//
+// ABI of lib/<abi>/<name>.so, the libraries Android extracts; nothing for
+// files elsewhere or nested deeper.
+//
+auto getLibraryAbi(std::string_view path) -> std::optional<std::string_view>;
 
 } // namespace ai
 
-#endif /* ANDROID_INTROSPECTION_APK_ATTRIBUTES_SETTER_VISITOR_H_ */
+#endif /* ANDROID_INTROSPECTION_APK_APK_PATHS_H_ */
@@ -0,0 +1,91 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_APP_BUNDLE_H_
+#define ANDROID_INTROSPECTION_APK_APP_BUNDLE_H_
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "apk/apk.h"
+#include "apk/manifest_components.h"
+
+namespace ai {
+
+//
+// Android App Bundle (.aab), as uploaded to the Play Store: a zip of
+// modules, each with the manifest and resource table aapt2 compiled into
+// protobuf rather than binary xml.  Nothing is decoded when the bundle is
+// opened; manifests and resource tables are read in place from the archive
+// when stored, and decoded only as far as a query needs.
+//
+class AppBundle final {
+public:
+  explicit AppBundle(std::string_view bundlePath);
+
+  //
+  // Opens the bundle in memory, e.g. a file handed over by JS.
+  //
+  explicit AppBundle(std::vector<std::byte> contents);
+
+  //
+  // Whether the path names an app bundle rather than an APK, by extension.
+  //
+  static auto isAppBundlePath(std::string_view path) -> bool;
+
+  ~AppBundle();
+
+  //
+  // Names of the modules, "base" first.
+  //
+  auto getModules() const -> std::vector<std::string>;
+
+  auto getFiles() const -> std::vector<std::string>;
+
+  auto getFileContent(std::string_view filePath) const -> std::vector<std::byte>;
+
+  auto getAndroidManifest(std::string_view module = "base") const -> std::string;
+
+  auto getManifestComponents(std::string_view module = "base") const -> ManifestComponents;
+
+  //
+  // Properties of the base module as Apk::getProperties() reports them, the
+  // hash being that of the bundle.
+  //
+  auto getProperties(ApkPropertyFields fields = ApkPropertyFields::all()) const -> std::map<std::string, std::string>;
+
+  auto getResourceValues(std::string_view module = "base") const -> std::map<std::string, std::string>;
+
+private:
+  class AppBundleImpl;
+
+  std::unique_ptr<AppBundleImpl> const pimpl_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_APP_BUNDLE_H_ */
@@ -0,0 +1,94 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_CONTENT_TYPE_H_
+#define ANDROID_INTROSPECTION_APK_CONTENT_TYPE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace ai {
+
+//
+// What the bytes of an entry are, whatever its extension says.  Media, Font
+// and Compressed are formats with a header that pack their data, told apart
+// so that they are not taken for Encrypted, which has no header and looks
+// like noise throughout.
+//
+enum class ContentType : uint8_t {
+  Unknown,
+  Empty,
+  Dex,
+  Elf,
+  BinaryXml,
+  ResourceTable,
+  Png,
+  WebP,
+  Jpeg,
+  Gif,
+  Zip,
+  JavaScript,
+  Text,
+  Media,
+  Font,
+  Compressed,
+  Encrypted,
+};
+
+//
+// Most bytes of an entry classifyContent() looks at.
+//
+static constexpr size_t CONTENT_PREFIX_SIZE = 512;
+
+struct ApkEntryContentType {
+
+  std::string path;
+
+  ContentType type;
+};
+
+//
+// "dex", "elf", "binary-xml", ... as the UI shows them.
+//
+auto getContentTypeName(ContentType type) -> std::string_view;
+
+//
+// Classifies an entry from the start of its contents, as from
+// ZipArchiver::peek(), and its sizes from the central directory: magic bytes
+// first, then whether the prefix is text, and last its byte entropy.
+//
+auto classifyContent(std::span<std::byte const> prefix, uint64_t uncompressedSize, uint64_t compressedSize) -> ContentType;
+
+//
+// Classifies an entry from its path and size alone, for when reading its
+// contents costs too much: by extension, and by where Android keeps
+// compiled xml.  Unknown for what the extension does not tell.
+//
+auto classifyPath(std::string_view path, uint64_t uncompressedSize) -> ContentType;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_CONTENT_TYPE_H_ */
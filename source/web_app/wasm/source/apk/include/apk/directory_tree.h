@@ -0,0 +1,118 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_DIRECTORY_TREE_H_
+#define ANDROID_INTROSPECTION_APK_DIRECTORY_TREE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "apk.h"
+
+namespace ai {
+
+//
+// A file or directory of a DirectoryTree.  The children of a directory are
+// the nodes firstChild to firstChild + childCount, directories first, each
+// group sorted by name.
+//
+struct DirectoryNode {
+
+  static constexpr uint32_t NO_ENTRY = UINT32_MAX;
+
+  uint32_t parent;
+
+  //
+  // Of the interned name, in DirectoryTree::getName().
+  //
+  uint32_t nameOffset;
+
+  uint32_t nameSize;
+
+  uint32_t firstChild;
+
+  uint32_t childCount;
+
+  //
+  // Index of the entry of a file in the entries the tree was built from, or
+  // NO_ENTRY for a directory without an entry of its own.
+  //
+  uint32_t entry;
+
+  //
+  // Files at or below the node and their sizes.
+  //
+  uint64_t fileCount;
+
+  uint64_t compressedSize;
+
+  uint64_t uncompressedSize;
+
+  auto isDirectory() const -> bool { return childCount > 0 || entry == NO_ENTRY; }
+};
+
+//
+// Entries of an APK as a tree of path components, built once from the
+// central directory so that an explorer lists one directory at a time
+// instead of splitting every path.  Nodes live in one array, children of a
+// directory next to each other, and each distinct component is stored once.
+// Entries ending in "/" are directories and empty components are dropped.
+//
+class DirectoryTree final {
+public:
+  static constexpr uint32_t ROOT = 0;
+
+  explicit DirectoryTree(std::span<ApkEntry const> entries);
+
+  auto size() const -> size_t { return nodes_.size(); }
+
+  auto getNode(uint32_t node) const -> DirectoryNode const & { return nodes_.at(node); }
+
+  auto getName(uint32_t node) const -> std::string_view;
+
+  auto getPath(uint32_t node) const -> std::string;
+
+  //
+  // The children of the node, the first being node firstChild.
+  //
+  auto listDirectory(uint32_t node) const -> std::span<DirectoryNode const>;
+
+  //
+  // The node of a path such as "res/drawable", "" being the root.
+  //
+  auto find(std::string_view path) const -> std::optional<uint32_t>;
+
+private:
+  std::vector<DirectoryNode> nodes_;
+
+  std::string names_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_DIRECTORY_TREE_H_ */
@@ -0,0 +1,88 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_FILE_LISTING_H_
+#define ANDROID_INTROSPECTION_APK_FILE_LISTING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ai {
+
+//
+// Whether a path is one a filter of the UI keeps: a glob when it has '*' or
+// '?' and a substring otherwise; empty keeps every path.
+//
+auto matchesPathFilter(std::string_view filter, std::string_view path) -> bool;
+
+//
+// Paths of a FileListing page packed one after the other, path i spanning
+// offsets[i] to offsets[i + 1] of names.
+//
+struct FilePage {
+
+  //
+  // Paths matching the filter, on this page or not.
+  //
+  size_t total;
+
+  std::string_view names;
+
+  std::span<uint32_t const> offsets;
+};
+
+//
+// Paths of an APK handed out a page at a time, for a virtualized list that
+// fetches the rows it shows; a page crosses to JS as two buffers rather than
+// a string per path.  The matches of the last filter are kept, so scrolling
+// does not run it again.
+//
+class FileListing final {
+public:
+  explicit FileListing(std::vector<std::string> files);
+
+  //
+  // Up to limit of the paths matching the filter, from the offset-th on.
+  // The page is valid up to the next call.
+  //
+  auto getPage(size_t offset, size_t limit, std::string_view filter) -> FilePage;
+
+private:
+  std::vector<std::string> files_;
+
+  std::string filter_;
+
+  std::vector<uint32_t> matches_;
+
+  std::string names_;
+
+  std::vector<uint32_t> offsets_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_FILE_LISTING_H_ */
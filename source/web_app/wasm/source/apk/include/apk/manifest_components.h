@@ -0,0 +1,225 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_MANIFEST_COMPONENTS_H_
+#define ANDROID_INTROSPECTION_APK_MANIFEST_COMPONENTS_H_
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ai {
+
+enum class ComponentType : uint8_t { Activity, ActivityAlias, Service, Receiver, Provider };
+
+struct ManifestComponent {
+
+  ComponentType type;
+
+  //
+  // Strings of the index: the class name, relative names resolved against
+  // the package, and the permission, NO_STRING without one.
+  //
+  uint32_t name;
+
+  uint32_t permission;
+
+  //
+  // As declared, or as implied without android:exported: components with
+  // intent filters are exported, providers only below API 17.
+  //
+  bool exported;
+
+  bool enabled;
+
+  uint32_t firstFilter;
+
+  uint32_t filterCount;
+};
+
+struct IntentFilterData {
+
+  uint32_t scheme;
+
+  uint32_t host;
+
+  uint32_t path;
+
+  uint32_t mimeType;
+};
+
+//
+// Actions, categories and data of the filter are ranges of the arrays of
+// the index, as filters of a component are.
+//
+struct IntentFilter {
+
+  uint32_t component;
+
+  int32_t priority;
+
+  uint32_t firstAction;
+
+  uint32_t actionCount;
+
+  uint32_t firstCategory;
+
+  uint32_t categoryCount;
+
+  uint32_t firstData;
+
+  uint32_t dataCount;
+};
+
+//
+// Components of a manifest with their intent filters, and the permissions
+// it requests and declares, built by AndroidManifestParser::getComponents()
+// in one pass over its elements.  Strings are interned: names, actions and
+// permissions are ids into the strings of the index, so components compare
+// by id, and components are indexed by action, so that finding the ones
+// that handle an action is a lookup.
+//
+class ManifestComponents final {
+public:
+  static constexpr uint32_t NO_STRING = UINT32_MAX;
+
+  ManifestComponents() = default;
+
+  //
+  // Not copyable, as stringIds_ is keyed by views of the strings; a move
+  // keeps the strings where they are.
+  //
+  ManifestComponents(ManifestComponents const &) = delete;
+  auto operator=(ManifestComponents const &) -> ManifestComponents & = delete;
+
+  ManifestComponents(ManifestComponents &&) = default;
+  auto operator=(ManifestComponents &&) -> ManifestComponents & = default;
+
+  auto getString(uint32_t id) const -> std::string_view { return id == NO_STRING ? std::string_view() : std::string_view(strings_[id]); }
+
+  auto findString(std::string_view string) const -> std::optional<uint32_t>;
+
+  auto getPackageName() const -> std::string_view { return getString(packageName_); }
+
+  //
+  // android:targetSdkVersion of uses-sdk, 1 without one as for Android.
+  //
+  auto getTargetSdkVersion() const -> uint32_t { return targetSdkVersion_; }
+
+  auto components() const -> std::span<ManifestComponent const> { return components_; }
+
+  auto filters(ManifestComponent const &component) const -> std::span<IntentFilter const> {
+    return std::span(filters_).subspan(component.firstFilter, component.filterCount);
+  }
+
+  auto actions(IntentFilter const &filter) const -> std::span<uint32_t const> { return std::span(actions_).subspan(filter.firstAction, filter.actionCount); }
+
+  auto categories(IntentFilter const &filter) const -> std::span<uint32_t const> {
+    return std::span(categories_).subspan(filter.firstCategory, filter.categoryCount);
+  }
+
+  auto data(IntentFilter const &filter) const -> std::span<IntentFilterData const> { return std::span(data_).subspan(filter.firstData, filter.dataCount); }
+
+  auto requestedPermissions() const -> std::span<uint32_t const> { return requestedPermissions_; }
+
+  auto declaredPermissions() const -> std::span<uint32_t const> { return declaredPermissions_; }
+
+  auto findComponent(std::string_view name) const -> std::optional<uint32_t>;
+
+  //
+  // Indexes of the components with a filter for the action, in document
+  // order.
+  //
+  auto findComponentsWithAction(std::string_view action, bool exportedOnly = false) const -> std::vector<uint32_t>;
+
+  auto isPermissionRequested(std::string_view permission) const -> bool;
+
+private:
+  friend class AndroidManifestParser;
+
+  friend class ProtoManifestParser;
+
+  auto intern(std::string_view string) -> uint32_t;
+
+  //
+  // Type of the component an element of the application declares, none
+  // for other tags.
+  //
+  static auto getComponentType(std::string_view tag) -> std::optional<ComponentType>;
+
+  //
+  // Interns the class name of a component; names starting with a dot, or
+  // without one, are relative to the package.
+  //
+  auto internClassName(std::string_view name) -> uint32_t;
+
+  //
+  // Once every component and filter is in: gives the components without
+  // android:exported, flagged false in isExportDeclared, the value implied
+  // by their filters and the target SDK, and sorts the action index.
+  //
+  auto finish(std::vector<bool> const &isExportDeclared) -> void;
+
+  //
+  // A deque, so that the views stringIds_ is keyed by stay put as strings
+  // are added.
+  //
+  std::deque<std::string> strings_;
+
+  std::unordered_map<std::string_view, uint32_t> stringIds_;
+
+  uint32_t packageName_ = NO_STRING;
+
+  uint32_t targetSdkVersion_ = 1;
+
+  std::vector<ManifestComponent> components_;
+
+  std::vector<IntentFilter> filters_;
+
+  std::vector<uint32_t> actions_;
+
+  std::vector<uint32_t> categories_;
+
+  std::vector<IntentFilterData> data_;
+
+  std::vector<uint32_t> requestedPermissions_;
+
+  std::vector<uint32_t> declaredPermissions_;
+
+  //
+  // (action, component) pairs sorted by action, then by component.
+  //
+  std::vector<std::pair<uint32_t, uint32_t>> actionComponents_;
+
+  std::unordered_map<uint32_t, uint32_t> componentsByName_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_MANIFEST_COMPONENTS_H_ */
@@ -0,0 +1,161 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_PERMISSION_INDEX_H_
+#define ANDROID_INTROSPECTION_APK_PERMISSION_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "apk.h"
+
+namespace ai {
+
+enum class PermissionUse : uint8_t { Requested, Declared };
+
+//
+// Permissions requested and declared by one APK, as bits indexed by the ids
+// of a PermissionDictionary.  Either set may be shorter than the other.
+//
+struct PermissionBits {
+
+  auto add(PermissionUse use, uint32_t permission) -> void;
+
+  std::vector<uint64_t> requested;
+
+  std::vector<uint64_t> declared;
+};
+
+//
+// Ids of permission names.  It only grows, so an id keeps naming the same
+// permission for the lifetime of the dictionary, and bits computed against
+// it stay valid after more names are interned.
+//
+class PermissionDictionary final {
+public:
+  //
+  // An empty dictionary of its own random id.
+  //
+  PermissionDictionary();
+
+  auto intern(std::string_view name) -> uint32_t;
+
+  auto find(std::string_view name) const -> std::optional<uint32_t>;
+
+  auto getName(uint32_t id) const -> std::string const & { return names_.at(id); }
+
+  auto size() const -> size_t { return names_.size(); }
+
+  auto id() const -> uint64_t { return id_; }
+
+  auto encode() const -> std::vector<std::byte>;
+
+  //
+  // Throws for records that are truncated or of another format version.
+  //
+  static auto decode(std::span<std::byte const> record) -> PermissionDictionary;
+
+  //
+  // Bits of an APK for the analysis cache, stamped with the id and size of
+  // the dictionary.  Decoding returns nothing for bits of another dictionary
+  // or with ids it lacks, e.g. when it was not stored after them.
+  //
+  auto encodeBits(PermissionBits const &bits) const -> std::vector<std::byte>;
+
+  auto decodeBits(std::span<std::byte const> record) const -> std::optional<PermissionBits>;
+
+private:
+  uint64_t id_;
+
+  std::vector<std::string> names_;
+
+  std::unordered_map<std::string, uint32_t> ids_;
+};
+
+//
+// Permissions of a set of APKs, one row per APK.  Bits are kept by column,
+// one bitset over the rows per permission, so asking which APKs request a
+// set of permissions ANDs as many columns and counts the bits left, 64 rows
+// a word, in loops the compiler vectorizes.
+//
+class PermissionMatrix final {
+public:
+  auto addRow(PermissionBits const &bits) -> size_t;
+
+  auto rowCount() const -> size_t { return rowCount_; }
+
+  auto contains(size_t row, PermissionUse use, uint32_t permission) const -> bool;
+
+  //
+  // Rows with every one of the permissions, and how many there are; every
+  // row for none.
+  //
+  auto find(PermissionUse use, std::span<uint32_t const> permissions) const -> std::vector<size_t>;
+
+  auto count(PermissionUse use, std::span<uint32_t const> permissions) const -> size_t;
+
+private:
+  auto getColumns(PermissionUse use) const -> std::vector<std::vector<uint64_t>> const & { return use == PermissionUse::Requested ? requested_ : declared_; }
+
+  auto intersect(PermissionUse use, std::span<uint32_t const> permissions) const -> std::vector<uint64_t>;
+
+  size_t rowCount_ = 0;
+
+  std::vector<std::vector<uint64_t>> requested_;
+
+  std::vector<std::vector<uint64_t>> declared_;
+};
+
+//
+// Permissions of a batch of APKs; row i of the matrix is apkPaths[i].
+//
+struct PermissionIndex {
+
+  PermissionDictionary dictionary;
+
+  PermissionMatrix matrix;
+
+  //
+  // Why the APK of a row could not be read, its row being empty, or empty.
+  //
+  std::vector<std::string> errors;
+};
+
+//
+// Reads the permissions of every APK on the workers of the pool.  With a
+// cache directory the dictionary is kept in it and so are the bits of each
+// APK, so a batch over APKs seen before only reads their central directory
+// and one small record.  Batches sharing a cache directory are expected not
+// to run at once.
+//
+auto indexPermissions(std::span<std::string const> apkPaths, ApkBatchOptions const &options, utils::ThreadPool &threadPool) -> PermissionIndex;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_PERMISSION_INDEX_H_ */
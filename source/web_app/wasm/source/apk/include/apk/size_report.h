@@ -0,0 +1,119 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_SIZE_REPORT_H_
+#define ANDROID_INTROSPECTION_APK_SIZE_REPORT_H_
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "apk/apk.h"
+#include "apk/content_type.h"
+
+namespace ai {
+
+//
+// Entries of an APK that have something in common, e.g. a directory, and
+// their sizes summed.
+//
+struct SizeBucket {
+
+  std::string name;
+
+  uint64_t compressedSize;
+
+  uint64_t uncompressedSize;
+
+  uint32_t entryCount;
+};
+
+enum class SizeIssue : uint8_t {
+  //
+  // Deflated by less than a twentieth: the APK is hardly smaller for it,
+  // but the entry has to be inflated to be read.
+  //
+  BadlyCompressed,
+
+  //
+  // Stored although it is of a type deflate shrinks.
+  //
+  StoredCompressible,
+};
+
+struct SizeFlag {
+
+  std::string path;
+
+  SizeIssue issue;
+
+  ContentType type;
+
+  uint64_t compressedSize;
+
+  uint64_t uncompressedSize;
+};
+
+//
+// Where the bytes of an APK go, from its central directory alone: entries
+// are summed by top level directory, by type, by ABI of native libraries and
+// by dex file, buckets being sorted by compressed size, largest first.
+// Entries too small to matter are not flagged.
+//
+struct SizeReport {
+
+  uint64_t compressedSize;
+
+  uint64_t uncompressedSize;
+
+  uint32_t entryCount;
+
+  std::vector<SizeBucket> directories;
+
+  std::vector<SizeBucket> types;
+
+  std::vector<SizeBucket> abis;
+
+  std::vector<SizeBucket> dexFiles;
+
+  std::vector<SizeFlag> flags;
+};
+
+//
+// Smallest entry a size report flags.
+//
+static constexpr uint64_t SIZE_FLAG_MIN_SIZE = 4 * 1024;
+
+//
+// Report of the entries of Apk::getEntries(), which only reads the central
+// directory; types come from classifyPath(), so nothing is inflated.
+//
+auto buildSizeReport(std::span<ApkEntry const> entries) -> SizeReport;
+
+auto getSizeIssueName(SizeIssue issue) -> std::string_view;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_SIZE_REPORT_H_ */
@@ -0,0 +1,117 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_ZIP_STREAM_WRITER_H_
+#define ANDROID_INTROSPECTION_APK_ZIP_STREAM_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/macros.h"
+
+namespace ai {
+
+//
+// Receives the bytes of the archive in order, in chunks only valid for the
+// duration of the call.
+//
+using ZipStreamSink = std::function<void(std::span<std::byte const>)>;
+
+//
+// Writes a new zip archive front to back through a sink, e.g. a download in
+// the browser, without a file to seek in: the sizes of each entry are known
+// before its local header goes out, and the central directory follows the
+// last entry.  Each entry is deflated and written as it is added, on the
+// calling thread, so callers that produce entries on workers, e.g. from
+// the consumer of decodeXmlResources(), keep them busy meanwhile; entries
+// deflate does not shrink are stored.  Zip64 records are only written when
+// the archive needs them.
+//
+class ZipStreamWriter final {
+public:
+  explicit ZipStreamWriter(ZipStreamSink sink);
+
+  DISALLOW_COPY_AND_ASSIGN(ZipStreamWriter);
+
+  ~ZipStreamWriter();
+
+  auto add(std::string_view pathInArchive, std::span<std::byte const> contents) -> void;
+
+  auto add(std::string_view pathInArchive, std::string_view text) -> void;
+
+  //
+  // Writes the central directory; nothing can be added afterwards.
+  //
+  auto finish() -> void;
+
+  auto entryCount() const -> std::size_t { return entries_.size(); }
+
+  auto bytesWritten() const -> uint64_t { return offset_; }
+
+private:
+  struct Entry {
+
+    std::string path;
+
+    uint64_t offset;
+
+    uint64_t compressedSize;
+
+    uint64_t uncompressedSize;
+
+    uint32_t crc;
+
+    uint16_t compressionMethod;
+  };
+
+  //
+  // One deflate stream, reset for every entry, with its output buffer.
+  //
+  struct Deflater;
+
+  auto write(std::span<std::byte const> bytes) -> void;
+
+  auto flush() -> void;
+
+  ZipStreamSink sink_;
+
+  std::unique_ptr<Deflater> deflater_;
+
+  std::vector<Entry> entries_;
+
+  std::vector<std::byte> buffer_;
+
+  uint64_t offset_ = 0;
+
+  bool finished_ = false;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_ZIP_STREAM_WRITER_H_ */
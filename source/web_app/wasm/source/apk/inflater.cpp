@@ -0,0 +1,185 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <zlib.h>
+
+#ifdef AI_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+#include "inflater.h"
+#include "utils/metrics.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+static constexpr size_t MAX_STEP_SIZE = UINT_MAX;
+
+#ifdef AI_LIBDEFLATE
+
+//
+// Entries up to this size are decompressed in a single libdeflate call;
+// larger ones keep streaming through zlib.
+//
+static constexpr size_t SINGLE_SHOT_MAX_SIZE = 64 * 1024 * 1024;
+
+struct ScopedDecompressor {
+
+  ScopedDecompressor() : decompressor(libdeflate_alloc_decompressor()) {
+    if (decompressor == nullptr) {
+      throw std::logic_error("unable to allocate decompressor");
+    }
+  }
+
+  ~ScopedDecompressor() { libdeflate_free_decompressor(decompressor); }
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedDecompressor);
+
+  libdeflate_decompressor *const decompressor;
+};
+
+auto getDecompressor() -> libdeflate_decompressor * {
+  thread_local auto const scopedDecompressor = ScopedDecompressor();
+  return scopedDecompressor.decompressor;
+}
+
+#endif
+
+//
+// Uncompressed bytes of every entry inflated, in total and per entry.
+//
+auto recordInflated(uint64_t const size) -> void {
+  static auto &bytesInflated = utils::metrics::counter("zip.bytes_inflated");
+  static auto &entrySizes = utils::metrics::histogram("zip.inflated_entry_size");
+  bytesInflated.add(size);
+  entrySizes.record(size);
+}
+
+} // namespace
+
+Inflater::Inflater() : stream_(std::make_unique<z_stream_s>()) {
+  if (inflateInit2(stream_.get(), -MAX_WBITS) != Z_OK) {
+    throw std::logic_error("unable to initialize inflate");
+  }
+}
+
+Inflater::~Inflater() { inflateEnd(stream_.get()); }
+
+auto Inflater::forThread() -> Inflater & {
+  thread_local auto inflater = Inflater();
+  return inflater;
+}
+
+auto Inflater::reset(std::span<std::byte const> const compressed) -> void {
+  if (inflateReset(stream_.get()) != Z_OK) {
+    throw std::logic_error("unable to reset inflate");
+  }
+  input_ = compressed;
+  stream_->avail_in = 0;
+}
+
+//
+// Runs inflate once on the output, topping up the input window first, as
+// zlib counts both in 32-bit sizes.
+//
+auto Inflater::step(std::span<std::byte> const output) -> int {
+  if (stream_->avail_in == 0) {
+    auto const size = std::min(input_.size(), MAX_STEP_SIZE);
+    stream_->next_in = input_.empty() ? Z_NULL : const_cast<Bytef *>(reinterpret_cast<Bytef const *>(input_.data()));
+    stream_->avail_in = static_cast<uInt>(size);
+    input_ = input_.subspan(size);
+  }
+  static auto placeholder = Bytef{0};
+  stream_->next_out = output.empty() ? &placeholder : reinterpret_cast<Bytef *>(output.data());
+  stream_->avail_out = static_cast<uInt>(std::min(output.size(), MAX_STEP_SIZE));
+  auto const result = ::inflate(stream_.get(), Z_NO_FLUSH);
+  if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+    throw std::logic_error("unable to inflate entry");
+  }
+  return result;
+}
+
+auto Inflater::inflate(std::span<std::byte const> const compressed, std::span<std::byte> output) -> void {
+#ifdef AI_LIBDEFLATE
+  if (output.size() <= SINGLE_SHOT_MAX_SIZE) {
+    if (libdeflate_deflate_decompress(getDecompressor(), compressed.data(), compressed.size(), output.data(), output.size(), nullptr) != LIBDEFLATE_SUCCESS) {
+      throw std::logic_error("entry does not match its uncompressed size");
+    }
+    recordInflated(output.size());
+    return;
+  }
+#endif
+  auto const size = output.size();
+  reset(compressed);
+  auto result = Z_OK;
+  do {
+    auto const stepSize = std::min(output.size(), MAX_STEP_SIZE);
+    result = step(output.first(stepSize));
+    if (result == Z_BUF_ERROR) {
+      throw std::logic_error("entry does not match its uncompressed size");
+    }
+    output = output.subspan(stepSize - stream_->avail_out);
+  } while (result != Z_STREAM_END);
+  if (!output.empty()) {
+    throw std::logic_error("entry does not match its uncompressed size");
+  }
+  recordInflated(size);
+}
+
+auto Inflater::inflate(std::span<std::byte const> const compressed, ZipEntrySink const &sink) -> uint64_t {
+  reset(compressed);
+  chunk_.resize(CHUNK_SIZE);
+  uint64_t size{0};
+  auto result = Z_OK;
+  while (result != Z_STREAM_END) {
+    result = step(chunk_);
+    auto const chunkSize = chunk_.size() - stream_->avail_out;
+    if (result == Z_BUF_ERROR && chunkSize == 0) {
+      throw std::logic_error("entry is truncated");
+    }
+    if (chunkSize > 0) {
+      sink(std::span<std::byte const>(chunk_.data(), chunkSize));
+      size += chunkSize;
+    }
+  }
+  recordInflated(size);
+  return size;
+}
+
+auto Inflater::inflatePrefix(std::span<std::byte const> const compressed, std::span<std::byte> const output) -> size_t {
+  reset(compressed);
+  auto remaining = output;
+  auto result = Z_OK;
+  while (!remaining.empty() && result == Z_OK) {
+    auto const stepSize = std::min(remaining.size(), MAX_STEP_SIZE);
+    result = step(remaining.first(stepSize));
+    remaining = remaining.subspan(stepSize - stream_->avail_out);
+  }
+  return output.size() - remaining.size();
+}
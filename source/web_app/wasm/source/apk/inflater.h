@@ -0,0 +1,89 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_INFLATER_H_
+#define ANDROID_INTROSPECTION_APK_INFLATER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "utils/macros.h"
+#include "zip_archiver.h"
+
+struct z_stream_s;
+
+namespace ai {
+
+//
+// Raw deflate decoder whose zlib state and output buffer are reused across
+// entries; inflateReset() is a fraction of the cost of inflateInit().  Not
+// thread safe, use forThread() to get the instance owned by the calling
+// thread.
+//
+class Inflater final {
+public:
+  Inflater();
+
+  ~Inflater();
+
+  DISALLOW_COPY_AND_ASSIGN(Inflater);
+
+  static auto forThread() -> Inflater &;
+
+  //
+  // Inflates compressed into output, which must be exactly the size of the
+  // uncompressed data.  Builds with AI_LIBDEFLATE decompress entries of up
+  // to 64 MB in one libdeflate call instead of streaming through zlib.
+  //
+  auto inflate(std::span<std::byte const> compressed, std::span<std::byte> output) -> void;
+
+  //
+  // Inflates compressed through the sink in fixed size chunks and returns
+  // the uncompressed size.
+  //
+  auto inflate(std::span<std::byte const> compressed, ZipEntrySink const &sink) -> uint64_t;
+
+  //
+  // Inflates the start of compressed, possibly cut short, into output and
+  // returns how many bytes it filled: all of it, unless the data ends first.
+  //
+  auto inflatePrefix(std::span<std::byte const> compressed, std::span<std::byte> output) -> size_t;
+
+private:
+  auto reset(std::span<std::byte const> compressed) -> void;
+
+  auto step(std::span<std::byte> output) -> int;
+
+  std::unique_ptr<z_stream_s> const stream_;
+
+  std::span<std::byte const> input_;
+
+  std::vector<std::byte> chunk_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_INFLATER_H_ */
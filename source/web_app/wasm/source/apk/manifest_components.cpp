@@ -0,0 +1,125 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <string>
+
+#include "apk/manifest_components.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// Providers stopped being exported by default in API 17.
+//
+static constexpr uint32_t PROVIDERS_NOT_EXPORTED_SDK_VERSION = 17;
+
+} // namespace
+
+auto ManifestComponents::intern(std::string_view const string) -> uint32_t {
+  if (auto const found = stringIds_.find(string); found != stringIds_.end()) {
+    return found->second;
+  }
+  auto const id = static_cast<uint32_t>(strings_.size());
+  stringIds_.emplace(strings_.emplace_back(string), id);
+  return id;
+}
+
+auto ManifestComponents::getComponentType(std::string_view const tag) -> std::optional<ComponentType> {
+  if (tag == "activity") {
+    return ComponentType::Activity;
+  } else if (tag == "activity-alias") {
+    return ComponentType::ActivityAlias;
+  } else if (tag == "service") {
+    return ComponentType::Service;
+  } else if (tag == "receiver") {
+    return ComponentType::Receiver;
+  } else if (tag == "provider") {
+    return ComponentType::Provider;
+  }
+  return std::nullopt;
+}
+
+auto ManifestComponents::internClassName(std::string_view const name) -> uint32_t {
+  auto const packageName = getPackageName();
+  if (name.starts_with('.')) {
+    return intern(std::string(packageName) + std::string(name));
+  }
+  if (name.find('.') == std::string_view::npos && !name.empty()) {
+    return intern(std::string(packageName) + "." + std::string(name));
+  }
+  return intern(name);
+}
+
+auto ManifestComponents::finish(std::vector<bool> const &isExportDeclared) -> void {
+  for (auto index = std::size_t{0}; index < components_.size(); index++) {
+    auto &component = components_[index];
+    if (!isExportDeclared[index]) {
+      component.exported = component.type == ComponentType::Provider ? targetSdkVersion_ < PROVIDERS_NOT_EXPORTED_SDK_VERSION : component.filterCount > 0;
+    }
+  }
+  actionComponents_.clear();
+  for (auto const &filter : filters_) {
+    for (auto const action : actions(filter)) {
+      actionComponents_.emplace_back(action, filter.component);
+    }
+  }
+  std::sort(actionComponents_.begin(), actionComponents_.end());
+  actionComponents_.erase(std::unique(actionComponents_.begin(), actionComponents_.end()), actionComponents_.end());
+}
+
+auto ManifestComponents::findString(std::string_view const string) const -> std::optional<uint32_t> {
+  auto const found = stringIds_.find(string);
+  return found == stringIds_.end() ? std::nullopt : std::optional(found->second);
+}
+
+auto ManifestComponents::findComponent(std::string_view const name) const -> std::optional<uint32_t> {
+  auto const id = findString(name);
+  if (!id) {
+    return std::nullopt;
+  }
+  auto const found = componentsByName_.find(*id);
+  return found == componentsByName_.end() ? std::nullopt : std::optional(found->second);
+}
+
+auto ManifestComponents::findComponentsWithAction(std::string_view const action, bool const exportedOnly) const -> std::vector<uint32_t> {
+  auto found = std::vector<uint32_t>();
+  auto const id = findString(action);
+  if (!id) {
+    return found;
+  }
+  auto const first = std::lower_bound(actionComponents_.begin(), actionComponents_.end(), std::pair(*id, uint32_t{0}));
+  auto const last = std::upper_bound(first, actionComponents_.end(), std::pair(*id, UINT32_MAX));
+  for (auto entry = first; entry != last; entry++) {
+    if (!exportedOnly || components_[entry->second].exported) {
+      found.push_back(entry->second);
+    }
+  }
+  return found;
+}
+
+auto ManifestComponents::isPermissionRequested(std::string_view const permission) const -> bool {
+  auto const id = findString(permission);
+  return id && std::find(requestedPermissions_.begin(), requestedPermissions_.end(), *id) != requestedPermissions_.end();
+}
@@ -0,0 +1,137 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "pattern_matcher.h"
+
+using namespace ai;
+
+namespace {
+
+auto fold(std::byte const byte) -> std::byte { return byte >= std::byte{'A'} && byte <= std::byte{'Z'} ? byte | std::byte{0x20} : byte; }
+
+auto isLetter(std::byte const byte) -> bool { return fold(byte) >= std::byte{'a'} && fold(byte) <= std::byte{'z'}; }
+
+} // namespace
+
+PatternMatcher::PatternMatcher(std::span<std::string const> const patterns, bool const caseSensitive)
+    : patterns_(patterns.begin(), patterns.end()), caseSensitive_(caseSensitive) {
+  if (patterns_.empty()) {
+    throw std::invalid_argument("no patterns");
+  }
+  auto firstBytes = std::vector<std::byte>();
+  for (uint32_t i{0}; i < patterns_.size(); i++) {
+    auto const &pattern = patterns_[i];
+    if (pattern.empty()) {
+      throw std::invalid_argument("pattern is empty");
+    }
+    maxPatternSize_ = std::max(maxPatternSize_, pattern.size());
+    auto const firstByte = static_cast<std::byte>(pattern.front());
+    buckets_[static_cast<uint8_t>(caseSensitive_ ? firstByte : fold(firstByte))].push_back(i);
+    if (std::find(firstBytes.begin(), firstBytes.end(), firstByte) == firstBytes.end()) {
+      firstBytes.push_back(firstByte);
+    }
+  }
+  if (firstBytes.size() == 1 && (caseSensitive_ || !isLetter(firstBytes.front()))) {
+    onlyFirstByte_ = firstBytes.front();
+  }
+}
+
+auto PatternMatcher::matchesAt(std::span<std::byte const> const text, size_t const offset, uint32_t const pattern) const -> bool {
+  auto const &bytes = patterns_[pattern];
+  if (bytes.size() > text.size() - offset) {
+    return false;
+  }
+  if (caseSensitive_) {
+    return memcmp(text.data() + offset, bytes.data(), bytes.size()) == 0;
+  }
+  return std::equal(bytes.begin(), bytes.end(), text.begin() + static_cast<std::ptrdiff_t>(offset),
+                    [](char const a, std::byte const b) { return fold(static_cast<std::byte>(a)) == fold(b); });
+}
+
+auto PatternMatcher::find(std::span<std::byte const> const text, uint64_t const base, PatternMatchCallback const &onMatch) const -> void {
+  auto const matchAt = [&](size_t const offset, std::vector<uint32_t> const &bucket) {
+    for (auto const pattern : bucket) {
+      if (matchesAt(text, offset, pattern)) {
+        onMatch(pattern, base + offset);
+      }
+    }
+  };
+  if (onlyFirstByte_) {
+    auto const &bucket = buckets_[static_cast<uint8_t>(caseSensitive_ ? *onlyFirstByte_ : fold(*onlyFirstByte_))];
+    auto const *const begin = text.data();
+    auto const *const end = begin + text.size();
+    for (auto const *next = begin; next < end;) {
+      auto const *const found = static_cast<std::byte const *>(memchr(next, static_cast<int>(*onlyFirstByte_), static_cast<size_t>(end - next)));
+      if (found == nullptr) {
+        break;
+      }
+      matchAt(static_cast<size_t>(found - begin), bucket);
+      next = found + 1;
+    }
+    return;
+  }
+  for (size_t offset{0}; offset < text.size(); offset++) {
+    auto const &bucket = buckets_[static_cast<uint8_t>(caseSensitive_ ? text[offset] : fold(text[offset]))];
+    if (!bucket.empty()) {
+      matchAt(offset, bucket);
+    }
+  }
+}
+
+auto PatternStream::reset() -> void {
+  tail_.clear();
+  position_ = 0;
+}
+
+auto PatternStream::write(std::span<std::byte const> const chunk, PatternMatchCallback const &onMatch) -> void {
+  auto const keep = matcher_.maxPatternSize() - 1;
+
+  //
+  // Matches across the boundary start in the tail and end in the chunk,
+  // within keep bytes of it.  Those wholly in the tail were found before.
+  //
+  if (!tail_.empty() && !chunk.empty()) {
+    seam_.assign(tail_.begin(), tail_.end());
+    seam_.insert(seam_.end(), chunk.begin(), chunk.begin() + static_cast<std::ptrdiff_t>(std::min(keep, chunk.size())));
+    auto const tailSize = tail_.size();
+    auto const seamBase = position_ - tailSize;
+    matcher_.find(seam_, seamBase, [&](uint32_t const pattern, uint64_t const offset) {
+      if (auto const start = offset - seamBase; start < tailSize && start + matcher_.patternSize(pattern) > tailSize) {
+        onMatch(pattern, offset);
+      }
+    });
+  }
+  matcher_.find(chunk, position_, onMatch);
+  position_ += chunk.size();
+
+  if (chunk.size() >= keep) {
+    tail_.assign(chunk.end() - static_cast<std::ptrdiff_t>(keep), chunk.end());
+  } else {
+    tail_.insert(tail_.end(), chunk.begin(), chunk.end());
+    tail_.erase(tail_.begin(), tail_.end() - static_cast<std::ptrdiff_t>(std::min(keep, tail_.size())));
+  }
+}
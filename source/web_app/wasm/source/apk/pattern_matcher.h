@@ -0,0 +1,116 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_PATTERN_MATCHER_H_
+#define ANDROID_INTROSPECTION_APK_PATTERN_MATCHER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ai {
+
+//
+// Called with the index of the pattern that matched and the offset where the
+// match starts.
+//
+using PatternMatchCallback = std::function<void(uint32_t pattern, uint64_t offset)>;
+
+//
+// Finds every occurrence of any of a set of byte patterns, overlapping ones
+// included.  Candidates are found through the first byte of the patterns,
+// with memchr() when there is only one such byte, and then compared with
+// the patterns of that byte.  It is immutable, so one matcher can be
+// shared by the workers of a pool.
+//
+class PatternMatcher final {
+public:
+  //
+  // Throws for an empty set or an empty pattern.  ASCII letters match
+  // either case unless caseSensitive is set.
+  //
+  PatternMatcher(std::span<std::string const> patterns, bool caseSensitive);
+
+  //
+  // Matches that lie wholly in text, at offsets from base.
+  //
+  auto find(std::span<std::byte const> text, uint64_t base, PatternMatchCallback const &onMatch) const -> void;
+
+  auto patternSize(uint32_t pattern) const -> size_t { return patterns_[pattern].size(); }
+
+  auto maxPatternSize() const -> size_t { return maxPatternSize_; }
+
+private:
+  auto matchesAt(std::span<std::byte const> text, size_t offset, uint32_t pattern) const -> bool;
+
+  std::vector<std::string> patterns_;
+
+  bool const caseSensitive_;
+
+  size_t maxPatternSize_ = 0;
+
+  //
+  // Patterns by their first byte, folded unless case sensitive.
+  //
+  std::array<std::vector<uint32_t>, 256> buckets_;
+
+  //
+  // The one byte memchr() looks for, if all patterns start with it.
+  //
+  std::optional<std::byte> onlyFirstByte_;
+};
+
+//
+// Feeds a matcher with a stream in chunks of any size, finding the matches
+// across chunk boundaries too, at offsets from the start of the stream.
+// The last maxPatternSize() - 1 bytes are kept between chunks.
+//
+class PatternStream final {
+public:
+  explicit PatternStream(PatternMatcher const &matcher) : matcher_(matcher) {}
+
+  //
+  // Starts a new stream.
+  //
+  auto reset() -> void;
+
+  auto write(std::span<std::byte const> chunk, PatternMatchCallback const &onMatch) -> void;
+
+private:
+  PatternMatcher const &matcher_;
+
+  std::vector<std::byte> tail_;
+
+  std::vector<std::byte> seam_;
+
+  uint64_t position_ = 0;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_PATTERN_MATCHER_H_ */
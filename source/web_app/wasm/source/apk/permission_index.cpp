@@ -0,0 +1,236 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+#include "apk/permission_index.h"
+#include "utils/crc32.h"
+#include "utils/data_stream.h"
+#include "utils/little_endian.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// "AIPD"
+//
+static constexpr uint32_t DICTIONARY_MAGIC = 0x44504941;
+
+static constexpr uint16_t DICTIONARY_VERSION = 1;
+
+static constexpr size_t WORD_BITS = 64;
+
+using ai::utils::little_endian::append;
+
+auto appendWords(std::vector<std::byte> &bytes, std::span<uint64_t const> const words) -> void {
+  append(bytes, static_cast<uint32_t>(words.size()));
+  auto const data = std::as_bytes(words);
+  bytes.insert(bytes.end(), data.begin(), data.end());
+}
+
+auto readWords(DataStream &stream) -> std::vector<uint64_t> {
+  auto const size = stream.read<uint32_t>();
+  stream.require(static_cast<size_t>(size) * sizeof(uint64_t));
+  auto words = std::vector<uint64_t>(size);
+  for (auto &word : words) {
+    word = stream.readUnchecked<uint64_t>();
+  }
+  return words;
+}
+
+//
+// Index of the last permission set in the words, or -1.
+//
+auto getLastBit(std::span<uint64_t const> const words) -> int64_t {
+  for (auto i = words.size(); i > 0; i--) {
+    if (words[i - 1] != 0) {
+      return static_cast<int64_t>((i - 1) * WORD_BITS + WORD_BITS - 1 - std::countl_zero(words[i - 1]));
+    }
+  }
+  return -1;
+}
+
+} // namespace
+
+auto PermissionBits::add(PermissionUse const use, uint32_t const permission) -> void {
+  auto &words = use == PermissionUse::Requested ? requested : declared;
+  words.resize(std::max(words.size(), permission / WORD_BITS + 1));
+  words[permission / WORD_BITS] |= uint64_t{1} << (permission % WORD_BITS);
+}
+
+PermissionDictionary::PermissionDictionary() : id_((static_cast<uint64_t>(std::random_device()()) << 32U) | std::random_device()()) {}
+
+auto PermissionDictionary::intern(std::string_view const name) -> uint32_t {
+  auto const [it, inserted] = ids_.try_emplace(std::string(name), static_cast<uint32_t>(names_.size()));
+  if (inserted) {
+    names_.push_back(it->first);
+  }
+  return it->second;
+}
+
+auto PermissionDictionary::find(std::string_view const name) const -> std::optional<uint32_t> {
+  auto const it = ids_.find(std::string(name));
+  return it == ids_.end() ? std::nullopt : std::optional(it->second);
+}
+
+auto PermissionDictionary::encode() const -> std::vector<std::byte> {
+  auto record = std::vector<std::byte>();
+  append(record, DICTIONARY_MAGIC);
+  append(record, DICTIONARY_VERSION);
+  append(record, uint16_t{0});
+  append(record, id_);
+  append(record, static_cast<uint32_t>(names_.size()));
+  for (auto const &name : names_) {
+    append(record, static_cast<uint32_t>(name.size()));
+    auto const data = reinterpret_cast<std::byte const *>(name.data());
+    record.insert(record.end(), data, data + name.size());
+  }
+  append(record, utils::crc32::update(0, record));
+  return record;
+}
+
+auto PermissionDictionary::decode(std::span<std::byte const> const record) -> PermissionDictionary {
+  if (record.size() < sizeof(uint32_t)) {
+    throw std::logic_error("truncated permission dictionary");
+  }
+  auto const contents = record.first(record.size() - sizeof(uint32_t));
+  auto crc = uint32_t{0};
+  memcpy(&crc, record.data() + contents.size(), sizeof(crc));
+  if (utils::crc32::update(0, contents) != crc) {
+    throw std::logic_error("corrupt permission dictionary");
+  }
+  auto stream = DataStream(contents);
+  if (stream.read<uint32_t>() != DICTIONARY_MAGIC || stream.read<uint16_t>() != DICTIONARY_VERSION) {
+    throw std::logic_error("unsupported permission dictionary");
+  }
+  stream.skip(sizeof(uint16_t));
+
+  auto dictionary = PermissionDictionary();
+  dictionary.id_ = stream.read<uint64_t>();
+  auto const count = stream.read<uint32_t>();
+  for (auto i{0U}; i < count; i++) {
+    auto const size = stream.read<uint32_t>();
+    stream.require(size);
+    auto const name = std::string_view(reinterpret_cast<char const *>(contents.data() + stream.position()), size);
+    stream.skip(size);
+    if (dictionary.intern(name) != i) {
+      throw std::logic_error("duplicate permission in dictionary");
+    }
+  }
+  return dictionary;
+}
+
+auto PermissionDictionary::encodeBits(PermissionBits const &bits) const -> std::vector<std::byte> {
+  auto record = std::vector<std::byte>();
+  append(record, id_);
+  append(record, static_cast<uint32_t>(names_.size()));
+  appendWords(record, bits.requested);
+  appendWords(record, bits.declared);
+  return record;
+}
+
+auto PermissionDictionary::decodeBits(std::span<std::byte const> const record) const -> std::optional<PermissionBits> {
+  auto stream = DataStream(record);
+  if (stream.read<uint64_t>() != id_ || stream.read<uint32_t>() > names_.size()) {
+    return std::nullopt;
+  }
+  auto bits = PermissionBits{readWords(stream), readWords(stream)};
+  if (std::max(getLastBit(bits.requested), getLastBit(bits.declared)) >= static_cast<int64_t>(names_.size())) {
+    throw std::logic_error("permission bits past the dictionary");
+  }
+  return bits;
+}
+
+auto PermissionMatrix::addRow(PermissionBits const &bits) -> size_t {
+  auto const row = rowCount_++;
+  auto const wordCount = (rowCount_ + WORD_BITS - 1) / WORD_BITS;
+  auto const addBits = [row, wordCount](std::vector<std::vector<uint64_t>> &columns, std::span<uint64_t const> const words) {
+    columns.resize(std::max(columns.size(), words.size() * WORD_BITS));
+    for (auto i = size_t{0}; i < words.size(); i++) {
+      for (auto word = words[i]; word != 0; word &= word - 1) {
+        auto &column = columns[i * WORD_BITS + static_cast<size_t>(std::countr_zero(word))];
+        column.resize(wordCount);
+        column[row / WORD_BITS] |= uint64_t{1} << (row % WORD_BITS);
+      }
+    }
+  };
+  addBits(requested_, bits.requested);
+  addBits(declared_, bits.declared);
+  return row;
+}
+
+auto PermissionMatrix::contains(size_t const row, PermissionUse const use, uint32_t const permission) const -> bool {
+  auto const &columns = getColumns(use);
+  if (permission >= columns.size() || row / WORD_BITS >= columns[permission].size()) {
+    return false;
+  }
+  return (columns[permission][row / WORD_BITS] >> (row % WORD_BITS) & 1U) != 0;
+}
+
+auto PermissionMatrix::find(PermissionUse const use, std::span<uint32_t const> const permissions) const -> std::vector<size_t> {
+  auto const words = intersect(use, permissions);
+  auto rows = std::vector<size_t>();
+  for (auto i = size_t{0}; i < words.size(); i++) {
+    for (auto word = words[i]; word != 0; word &= word - 1) {
+      rows.push_back(i * WORD_BITS + static_cast<size_t>(std::countr_zero(word)));
+    }
+  }
+  return rows;
+}
+
+auto PermissionMatrix::count(PermissionUse const use, std::span<uint32_t const> const permissions) const -> size_t {
+  auto const words = intersect(use, permissions);
+  auto count = size_t{0};
+  for (auto const word : words) {
+    count += static_cast<size_t>(std::popcount(word));
+  }
+  return count;
+}
+
+auto PermissionMatrix::intersect(PermissionUse const use, std::span<uint32_t const> const permissions) const -> std::vector<uint64_t> {
+  auto const wordCount = (rowCount_ + WORD_BITS - 1) / WORD_BITS;
+  auto words = std::vector<uint64_t>(wordCount, ~uint64_t{0});
+  if (rowCount_ % WORD_BITS != 0) {
+    words.back() = (uint64_t{1} << (rowCount_ % WORD_BITS)) - 1;
+  }
+  auto const &columns = getColumns(use);
+  for (auto const permission : permissions) {
+    if (permission >= columns.size()) {
+      return {};
+    }
+    //
+    // Columns end at the word of their last row with the permission.
+    //
+    auto const &column = columns[permission];
+    words.resize(std::min(words.size(), column.size()));
+    for (auto i = size_t{0}; i < words.size(); i++) {
+      words[i] &= column[i];
+    }
+  }
+  return words;
+}
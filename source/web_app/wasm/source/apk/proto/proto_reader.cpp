@@ -0,0 +1,95 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstring>
+#include <stdexcept>
+
+#include "proto_reader.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr uint32_t MAX_VARINT_SIZE = 10;
+
+static constexpr uint32_t WIRE_TYPE_BITS = 3;
+
+static constexpr uint64_t WIRE_TYPE_MASK = (1U << WIRE_TYPE_BITS) - 1;
+
+} // namespace
+
+auto ProtoReader::next() -> std::optional<ProtoField> {
+  if (position_ == message_.size()) {
+    return std::nullopt;
+  }
+  auto const key = readVarint();
+  auto const number = key >> WIRE_TYPE_BITS;
+  if (number == 0 || number > UINT32_MAX) {
+    throw std::logic_error("invalid protobuf field number");
+  }
+  auto field = ProtoField{static_cast<uint32_t>(number), static_cast<ProtoWireType>(key & WIRE_TYPE_MASK), 0, {}};
+  switch (field.wireType) {
+  case ProtoWireType::Varint:
+    field.value = readVarint();
+    break;
+  case ProtoWireType::Fixed64:
+    std::memcpy(&field.value, readBytes(sizeof(uint64_t)).data(), sizeof(uint64_t));
+    break;
+  case ProtoWireType::LengthDelimited:
+    field.bytes = readBytes(readVarint());
+    break;
+  case ProtoWireType::Fixed32: {
+    auto value = uint32_t{0};
+    std::memcpy(&value, readBytes(sizeof(uint32_t)).data(), sizeof(uint32_t));
+    field.value = value;
+    break;
+  }
+  default:
+    //
+    // Groups have been deprecated since proto2 and aapt2 never writes them.
+    //
+    throw std::logic_error("unsupported protobuf wire type");
+  }
+  return field;
+}
+
+auto ProtoReader::readVarint() -> uint64_t {
+  auto value = uint64_t{0};
+  for (auto i = uint32_t{0}; i < MAX_VARINT_SIZE && position_ < message_.size(); i++) {
+    auto const byte = std::to_integer<uint8_t>(message_[position_++]);
+    value |= uint64_t{byte & 0x7fU} << (7 * i);
+    if ((byte & 0x80U) == 0) {
+      return value;
+    }
+  }
+  throw std::logic_error("truncated protobuf varint");
+}
+
+auto ProtoReader::readBytes(uint64_t const size) -> std::span<std::byte const> {
+  if (size > message_.size() - position_) {
+    throw std::logic_error("truncated protobuf field");
+  }
+  auto const bytes = message_.subspan(position_, static_cast<std::size_t>(size));
+  position_ += static_cast<std::size_t>(size);
+  return bytes;
+}
@@ -0,0 +1,82 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_PROTO_READER_H_
+#define ANDROID_INTROSPECTION_APK_PROTO_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace ai {
+
+enum class ProtoWireType : uint8_t { Varint = 0, Fixed64 = 1, LengthDelimited = 2, Fixed32 = 5 };
+
+//
+// Field of a protocol buffer message: varints and fixed size values in
+// value, strings, bytes and nested messages as a view of the message.
+//
+struct ProtoField {
+
+  uint32_t number;
+
+  ProtoWireType wireType;
+
+  uint64_t value;
+
+  std::span<std::byte const> bytes;
+
+  auto string() const -> std::string_view { return {reinterpret_cast<char const *>(bytes.data()), bytes.size()}; }
+};
+
+//
+// Reads a protocol buffer message in wire format, one field at a time and
+// without a schema: callers switch on the numbers they know and simply
+// don't look at the others, and nested messages are only read if they are
+// read in turn.  Nothing is copied, so the message must outlive the reader
+// and the fields.  Throws std::logic_error on malformed messages.
+//
+class ProtoReader final {
+public:
+  explicit ProtoReader(std::span<std::byte const> message) : message_(message) {}
+
+  //
+  // The next field, or nothing at the end of the message.
+  //
+  auto next() -> std::optional<ProtoField>;
+
+private:
+  auto readVarint() -> uint64_t;
+
+  auto readBytes(uint64_t size) -> std::span<std::byte const>;
+
+  std::span<std::byte const> message_;
+
+  std::size_t position_ = 0;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_PROTO_READER_H_ */
@@ -0,0 +1,371 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <string_view>
+#include <utility>
+
+#include "binary_xml/res_value.h"
+#include "binary_xml/resource_types.h"
+#include "proto_reader.h"
+#include "proto_resource_table.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// Field numbers of frameworks/base/tools/aapt2/Resources.proto.
+//
+namespace table_fields {
+static constexpr uint32_t PACKAGE = 2;
+} // namespace table_fields
+
+namespace package_fields {
+static constexpr uint32_t PACKAGE_ID = 1;
+static constexpr uint32_t TYPE = 3;
+} // namespace package_fields
+
+namespace type_fields {
+static constexpr uint32_t TYPE_ID = 1;
+static constexpr uint32_t NAME = 2;
+static constexpr uint32_t ENTRY = 3;
+} // namespace type_fields
+
+namespace entry_fields {
+static constexpr uint32_t ENTRY_ID = 1;
+static constexpr uint32_t NAME = 2;
+static constexpr uint32_t CONFIG_VALUE = 6;
+} // namespace entry_fields
+
+namespace config_value_fields {
+static constexpr uint32_t CONFIG = 1;
+static constexpr uint32_t VALUE = 2;
+} // namespace config_value_fields
+
+namespace value_fields {
+static constexpr uint32_t ITEM = 4;
+static constexpr uint32_t COMPOUND_VALUE = 5;
+} // namespace value_fields
+
+namespace compound_value_fields {
+static constexpr uint32_t STYLE = 2;
+} // namespace compound_value_fields
+
+namespace style_fields {
+static constexpr uint32_t PARENT = 1;
+} // namespace style_fields
+
+namespace item_fields {
+static constexpr uint32_t REF = 1;
+static constexpr uint32_t STR = 2;
+static constexpr uint32_t RAW_STR = 3;
+static constexpr uint32_t STYLED_STR = 4;
+static constexpr uint32_t FILE = 5;
+static constexpr uint32_t PRIM = 7;
+} // namespace item_fields
+
+namespace reference_fields {
+static constexpr uint32_t TYPE = 1;
+static constexpr uint32_t ID = 2;
+static constexpr uint32_t NAME = 3;
+static constexpr uint64_t TYPE_ATTRIBUTE = 1;
+} // namespace reference_fields
+
+namespace primitive_fields {
+static constexpr uint32_t NULL_VALUE = 1;
+static constexpr uint32_t EMPTY_VALUE = 2;
+static constexpr uint32_t FLOAT_VALUE = 3;
+static constexpr uint32_t DIMENSION_VALUE_DEPRECATED = 4;
+static constexpr uint32_t FRACTION_VALUE_DEPRECATED = 5;
+static constexpr uint32_t INT_DECIMAL_VALUE = 6;
+static constexpr uint32_t INT_HEXADECIMAL_VALUE = 7;
+static constexpr uint32_t BOOLEAN_VALUE = 8;
+static constexpr uint32_t COLOR_ARGB8_VALUE = 9;
+static constexpr uint32_t COLOR_RGB8_VALUE = 10;
+static constexpr uint32_t COLOR_ARGB4_VALUE = 11;
+static constexpr uint32_t COLOR_RGB4_VALUE = 12;
+static constexpr uint32_t DIMENSION_VALUE = 13;
+static constexpr uint32_t FRACTION_VALUE = 14;
+} // namespace primitive_fields
+
+//
+// Fields of the messages PackageId, TypeId and EntryId, and of String,
+// RawString, StyledString and FileReference, that hold their value.
+//
+static constexpr uint32_t WRAPPED_VALUE = 1;
+
+static constexpr uint32_t PACKAGE_ID_SHIFT = 24;
+
+static constexpr uint32_t TYPE_ID_SHIFT = 16;
+
+static constexpr uint32_t ID_BYTE_MASK = 0xff;
+
+static constexpr uint32_t ENTRY_ID_MASK = 0xffff;
+
+//
+// The field with the number, the last one as protobuf wants it, or nothing.
+//
+auto findField(std::span<std::byte const> const message, uint32_t const number) -> std::optional<ProtoField> {
+  auto found = std::optional<ProtoField>();
+  auto reader = ProtoReader(message);
+  while (auto const field = reader.next()) {
+    if (field->number == number) {
+      found = field;
+    }
+  }
+  return found;
+}
+
+auto findString(std::span<std::byte const> const message, uint32_t const number) -> std::string_view {
+  auto const field = findField(message, number);
+  return field ? field->string() : std::string_view();
+}
+
+//
+// Value of the id message in the field of a message, e.g. the TypeId of a
+// Type.
+//
+auto findId(std::span<std::byte const> const message, uint32_t const number) -> std::optional<uint32_t> {
+  auto const id = findField(message, number);
+  if (!id) {
+    return std::nullopt;
+  }
+  auto const value = findField(id->bytes, WRAPPED_VALUE);
+  return static_cast<uint32_t>(value ? value->value : 0);
+}
+
+//
+// The Primitive as the type and data of a Res_value.
+//
+auto getPrimitiveValue(std::span<std::byte const> const primitive) -> std::pair<uint8_t, uint32_t> {
+  auto resValue = std::pair<uint8_t, uint32_t>(TYPE_NULL, 0);
+  auto reader = ProtoReader(primitive);
+  while (auto const field = reader.next()) {
+    auto const data = static_cast<uint32_t>(field->value);
+    switch (field->number) {
+    case primitive_fields::NULL_VALUE:
+      resValue = {TYPE_NULL, 0};
+      break;
+    case primitive_fields::EMPTY_VALUE:
+      resValue = {TYPE_NULL, 1};
+      break;
+    case primitive_fields::FLOAT_VALUE:
+    case primitive_fields::DIMENSION_VALUE_DEPRECATED:
+    case primitive_fields::FRACTION_VALUE_DEPRECATED:
+      resValue = {TYPE_FLOAT, data};
+      break;
+    case primitive_fields::INT_DECIMAL_VALUE:
+      resValue = {TYPE_INT_DEC, data};
+      break;
+    case primitive_fields::INT_HEXADECIMAL_VALUE:
+      resValue = {TYPE_INT_HEX, data};
+      break;
+    case primitive_fields::BOOLEAN_VALUE:
+      resValue = {TYPE_INT_BOOLEAN, data != 0 ? UINT32_MAX : 0};
+      break;
+    case primitive_fields::COLOR_ARGB8_VALUE:
+    case primitive_fields::COLOR_RGB8_VALUE:
+    case primitive_fields::COLOR_ARGB4_VALUE:
+    case primitive_fields::COLOR_RGB4_VALUE:
+      resValue = {static_cast<uint8_t>(TYPE_INT_COLOR_ARGB8 + field->number - primitive_fields::COLOR_ARGB8_VALUE), data};
+      break;
+    case primitive_fields::DIMENSION_VALUE:
+      resValue = {TYPE_DIMENSION, data};
+      break;
+    case primitive_fields::FRACTION_VALUE:
+      resValue = {TYPE_FRACTION, data};
+      break;
+    default:
+      break;
+    }
+  }
+  return resValue;
+}
+
+auto appendReference(std::span<std::byte const> const reference, ProtoResourceTable const *const table, std::string &output) -> void {
+  auto type = uint64_t{0};
+  auto id = uint32_t{0};
+  auto name = std::string_view();
+  auto reader = ProtoReader(reference);
+  while (auto const field = reader.next()) {
+    if (field->number == reference_fields::TYPE) {
+      type = field->value;
+    } else if (field->number == reference_fields::ID) {
+      id = static_cast<uint32_t>(field->value);
+    } else if (field->number == reference_fields::NAME) {
+      name = field->string();
+    }
+  }
+  auto const isAttribute = type == reference_fields::TYPE_ATTRIBUTE;
+  if (!name.empty()) {
+    output += isAttribute ? '?' : '@';
+    output += name;
+    return;
+  }
+  if (auto const tableName = table != nullptr && id != 0 ? table->getName(id) : std::nullopt) {
+    output += isAttribute ? '?' : '@';
+    output += *tableName;
+    return;
+  }
+  appendResValue(isAttribute ? TYPE_ATTRIBUTE : TYPE_REFERENCE, id, output);
+}
+
+//
+// Text of the Value of an entry: its item, or the parent of a style.
+//
+auto getValueText(std::span<std::byte const> const value, ProtoResourceTable const &table) -> std::string {
+  auto text = std::string();
+  if (auto const item = findField(value, value_fields::ITEM)) {
+    appendProtoItem(item->bytes, &table, text);
+    return text;
+  }
+  auto const compoundValue = findField(value, value_fields::COMPOUND_VALUE);
+  auto const style = compoundValue ? findField(compoundValue->bytes, compound_value_fields::STYLE) : std::nullopt;
+  auto const parent = style ? findField(style->bytes, style_fields::PARENT) : std::nullopt;
+  if (!parent) {
+    return "bag";
+  }
+  text = "bag of ";
+  appendReference(parent->bytes, &table, text);
+  return text;
+}
+
+//
+// Value of the default configuration of an entry, or of its first one
+// without a default.
+//
+auto findDefaultValue(std::span<std::byte const> const entry) -> std::optional<std::span<std::byte const>> {
+  auto found = std::optional<std::span<std::byte const>>();
+  auto reader = ProtoReader(entry);
+  while (auto const field = reader.next()) {
+    if (field->number != entry_fields::CONFIG_VALUE) {
+      continue;
+    }
+    auto const config = findField(field->bytes, config_value_fields::CONFIG);
+    auto const value = findField(field->bytes, config_value_fields::VALUE);
+    if (value && (!config || config->bytes.empty())) {
+      return value->bytes;
+    }
+    if (value && !found) {
+      found = value->bytes;
+    }
+  }
+  return found;
+}
+
+} // namespace
+
+auto ProtoResourceTable::getName(uint32_t const id) const -> std::optional<std::string> {
+  if (!names_) {
+    names_ = indexNames();
+  }
+  auto const name = names_->find(id);
+  if (name == names_->end()) {
+    return std::nullopt;
+  }
+  return std::string(name->second.first) + "/" + std::string(name->second.second);
+}
+
+//
+// The first entry of an id wins, as the first match did for a lookup.
+//
+auto ProtoResourceTable::indexNames() const -> NameIndex {
+  auto names = NameIndex();
+  auto packages = ProtoReader(table_);
+  while (auto const package = packages.next()) {
+    if (package->number != table_fields::PACKAGE) {
+      continue;
+    }
+    auto const packageId = findId(package->bytes, package_fields::PACKAGE_ID).value_or(0);
+    auto types = ProtoReader(package->bytes);
+    while (auto const type = types.next()) {
+      if (type->number != package_fields::TYPE) {
+        continue;
+      }
+      auto const typeId = findId(type->bytes, type_fields::TYPE_ID).value_or(0);
+      auto const typeName = findString(type->bytes, type_fields::NAME);
+      auto entries = ProtoReader(type->bytes);
+      while (auto const entry = entries.next()) {
+        if (entry->number != type_fields::ENTRY) {
+          continue;
+        }
+        auto const entryId = findId(entry->bytes, entry_fields::ENTRY_ID).value_or(0);
+        auto const id = ((packageId & ID_BYTE_MASK) << PACKAGE_ID_SHIFT) | ((typeId & ID_BYTE_MASK) << TYPE_ID_SHIFT) | (entryId & ENTRY_ID_MASK);
+        names.emplace(id, std::pair(typeName, findString(entry->bytes, entry_fields::NAME)));
+      }
+    }
+  }
+  return names;
+}
+
+auto ProtoResourceTable::getValues() const -> std::map<std::string, std::string> {
+  auto values = std::map<std::string, std::string>();
+  auto packages = ProtoReader(table_);
+  while (auto const package = packages.next()) {
+    if (package->number != table_fields::PACKAGE) {
+      continue;
+    }
+    auto types = ProtoReader(package->bytes);
+    while (auto const type = types.next()) {
+      if (type->number != package_fields::TYPE) {
+        continue;
+      }
+      auto const typeName = findString(type->bytes, type_fields::NAME);
+      auto entries = ProtoReader(type->bytes);
+      while (auto const entry = entries.next()) {
+        if (entry->number != type_fields::ENTRY) {
+          continue;
+        }
+        if (auto const value = findDefaultValue(entry->bytes)) {
+          auto name = std::string(typeName) + "/" + std::string(findString(entry->bytes, entry_fields::NAME));
+          values.insert_or_assign(std::move(name), getValueText(*value, *this));
+        }
+      }
+    }
+  }
+  return values;
+}
+
+auto ai::appendProtoItem(std::span<std::byte const> const item, ProtoResourceTable const *const table, std::string &output) -> void {
+  auto reader = ProtoReader(item);
+  while (auto const field = reader.next()) {
+    switch (field->number) {
+    case item_fields::REF:
+      appendReference(field->bytes, table, output);
+      return;
+    case item_fields::STR:
+    case item_fields::RAW_STR:
+    case item_fields::STYLED_STR:
+    case item_fields::FILE:
+      output += findString(field->bytes, WRAPPED_VALUE);
+      return;
+    case item_fields::PRIM: {
+      auto const [type, data] = getPrimitiveValue(field->bytes);
+      appendResValue(type, data, output);
+      return;
+    }
+    default:
+      break;
+    }
+  }
+}
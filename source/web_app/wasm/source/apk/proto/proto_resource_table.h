@@ -0,0 +1,84 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_PROTO_RESOURCE_TABLE_H_
+#define ANDROID_INTROSPECTION_APK_PROTO_RESOURCE_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace ai {
+
+//
+// Resource table of an app bundle module, resources.pb as aapt2 writes it,
+// read in place.  Nothing is decoded up front: the first name lookup
+// indexes the ids and names of every entry, skipping their values, and the
+// others are answered from the index.  Not thread safe.
+//
+class ProtoResourceTable final {
+public:
+  explicit ProtoResourceTable(std::span<std::byte const> table) : table_(table) {}
+
+  //
+  // Name of the resource, e.g. "string/app_name".
+  //
+  auto getName(uint32_t id) const -> std::optional<std::string>;
+
+  //
+  // Every resource by name with its value as text, as
+  // Apk::getResourceValues() reports those of resources.arsc: the default
+  // configuration is preferred and bags only name the bag they extend.
+  //
+  auto getValues() const -> std::map<std::string, std::string>;
+
+private:
+  //
+  // Type and entry names by resource id, views of the table.
+  //
+  using NameIndex = std::unordered_map<uint32_t, std::pair<std::string_view, std::string_view>>;
+
+  auto indexNames() const -> NameIndex;
+
+  std::span<std::byte const> table_;
+
+  mutable std::optional<NameIndex> names_;
+};
+
+//
+// Appends the text of an Item, a compiled value, as decoded xml shows it:
+// strings as they are, references by name, from the table if they were
+// compiled without one, and other values as formatResValue() formats them.
+// The table may be null.
+//
+auto appendProtoItem(std::span<std::byte const> item, ProtoResourceTable const *table, std::string &output) -> void;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_PROTO_RESOURCE_TABLE_H_ */
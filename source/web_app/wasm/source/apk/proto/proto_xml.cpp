@@ -0,0 +1,237 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <vector>
+
+#include "proto_reader.h"
+#include "proto_resource_table.h"
+#include "proto_xml.h"
+#include "utils/xml_escape.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr std::size_t INDENT_SIZE = 2;
+
+//
+// Field numbers of XmlNode, XmlElement and XmlAttribute in
+// frameworks/base/tools/aapt2/Resources.proto.
+//
+namespace node_fields {
+static constexpr uint32_t ELEMENT = 1;
+} // namespace node_fields
+
+namespace element_fields {
+static constexpr uint32_t NAME = 3;
+static constexpr uint32_t ATTRIBUTE = 4;
+static constexpr uint32_t CHILD = 5;
+} // namespace element_fields
+
+namespace attribute_fields {
+static constexpr uint32_t NAME = 2;
+static constexpr uint32_t VALUE = 3;
+static constexpr uint32_t RESOURCE_ID = 5;
+static constexpr uint32_t COMPILED_ITEM = 6;
+} // namespace attribute_fields
+
+struct ProtoXmlAttribute {
+
+  std::string_view name;
+
+  std::string_view value;
+
+  uint32_t resourceId = 0;
+
+  std::span<std::byte const> compiledItem;
+};
+
+auto readAttribute(std::span<std::byte const> const attribute) -> ProtoXmlAttribute {
+  auto decoded = ProtoXmlAttribute();
+  auto reader = ProtoReader(attribute);
+  while (auto const field = reader.next()) {
+    switch (field->number) {
+    case attribute_fields::NAME:
+      decoded.name = field->string();
+      break;
+    case attribute_fields::VALUE:
+      decoded.value = field->string();
+      break;
+    case attribute_fields::RESOURCE_ID:
+      decoded.resourceId = static_cast<uint32_t>(field->value);
+      break;
+    case attribute_fields::COMPILED_ITEM:
+      decoded.compiledItem = field->bytes;
+      break;
+    default:
+      break;
+    }
+  }
+  return decoded;
+}
+
+auto getAttributeValue(ProtoXmlAttribute const &attribute, ProtoResourceTable const *const table) -> std::string {
+  if (!attribute.value.empty() || attribute.compiledItem.empty()) {
+    return std::string(attribute.value);
+  }
+  auto value = std::string();
+  appendProtoItem(attribute.compiledItem, table, value);
+  return value;
+}
+
+//
+// The XmlElement of the XmlNode, nothing for text.
+//
+auto findElementBytes(std::span<std::byte const> const node) -> std::optional<std::span<std::byte const>> {
+  auto reader = ProtoReader(node);
+  while (auto const field = reader.next()) {
+    if (field->number == node_fields::ELEMENT) {
+      return field->bytes;
+    }
+  }
+  return std::nullopt;
+}
+
+//
+// Writes the element and its subtree like StringXmlVisitor: attributes
+// sorted by name, keeping the last of attributes with the same name, and
+// elements without children closed in their start tag.  attributes is
+// scratch space shared by the whole document.
+//
+auto appendElement(std::span<std::byte const> const element, std::size_t const depth, ProtoResourceTable const *const table,
+                   std::vector<ProtoXmlAttribute> &attributes, std::string &xml) -> void {
+  auto name = std::string_view();
+  auto children = std::vector<std::span<std::byte const>>();
+  auto const firstAttribute = attributes.size();
+  auto reader = ProtoReader(element);
+  while (auto const field = reader.next()) {
+    if (field->number == element_fields::NAME) {
+      name = field->string();
+    } else if (field->number == element_fields::ATTRIBUTE) {
+      attributes.push_back(readAttribute(field->bytes));
+    } else if (field->number == element_fields::CHILD) {
+      if (auto const child = findElementBytes(field->bytes)) {
+        children.push_back(*child);
+      }
+    }
+  }
+
+  xml += '\n';
+  xml.append(depth * INDENT_SIZE, ' ');
+  xml += '<';
+  xml += name;
+  auto const elementAttributes = std::span(attributes).subspan(firstAttribute);
+  std::stable_sort(elementAttributes.begin(), elementAttributes.end(), [](auto const &left, auto const &right) { return left.name < right.name; });
+  for (auto i = std::size_t{0}; i < elementAttributes.size(); i++) {
+    auto const &attribute = elementAttributes[i];
+    if (attribute.name.empty() || (i + 1 < elementAttributes.size() && elementAttributes[i + 1].name == attribute.name)) {
+      continue;
+    }
+    xml += ' ';
+    xml += attribute.name;
+    xml += "=\"";
+    utils::xml::appendEscaped(getAttributeValue(attribute, table), xml);
+    xml += '"';
+  }
+  attributes.resize(firstAttribute);
+  if (children.empty()) {
+    xml += "/>";
+    return;
+  }
+  xml += '>';
+  for (auto const child : children) {
+    appendElement(child, depth + 1, table, attributes, xml);
+  }
+  xml += '\n';
+  xml.append(depth * INDENT_SIZE, ' ');
+  xml += "</";
+  xml += name;
+  xml += '>';
+}
+
+} // namespace
+
+auto ProtoXmlElement::name() const -> std::string_view {
+  auto name = std::string_view();
+  auto reader = ProtoReader(element_);
+  while (auto const field = reader.next()) {
+    if (field->number == element_fields::NAME) {
+      name = field->string();
+    }
+  }
+  return name;
+}
+
+auto ProtoXmlElement::findAttribute(uint32_t const resourceId, std::string_view const name, ProtoResourceTable const *const table) const
+    -> std::optional<std::string> {
+  auto found = std::optional<std::string>();
+  auto reader = ProtoReader(element_);
+  while (auto const field = reader.next()) {
+    if (field->number != element_fields::ATTRIBUTE) {
+      continue;
+    }
+    auto const attribute = readAttribute(field->bytes);
+    if (resourceId != 0 && attribute.resourceId != 0 ? attribute.resourceId == resourceId : attribute.name == name) {
+      found = getAttributeValue(attribute, table);
+    }
+  }
+  return found;
+}
+
+auto ProtoXmlElement::forEachChild(std::function<void(ProtoXmlElement const &)> const &visitor) const -> void {
+  auto reader = ProtoReader(element_);
+  while (auto const field = reader.next()) {
+    if (field->number != element_fields::CHILD) {
+      continue;
+    }
+    if (auto const child = findElementBytes(field->bytes)) {
+      visitor(ProtoXmlElement(*child));
+    }
+  }
+}
+
+auto ProtoXmlElement::findChild(std::string_view const name) const -> std::optional<ProtoXmlElement> {
+  auto found = std::optional<ProtoXmlElement>();
+  forEachChild([&found, &name](ProtoXmlElement const &child) {
+    if (!found && child.name() == name) {
+      found = child;
+    }
+  });
+  return found;
+}
+
+auto ProtoXml::root() const -> std::optional<ProtoXmlElement> {
+  auto const element = findElementBytes(node_);
+  return element ? std::optional(ProtoXmlElement(*element)) : std::nullopt;
+}
+
+auto ProtoXml::toStringXml(ProtoResourceTable const *const table) const -> std::string {
+  auto xml = std::string("<?xml version=\"1.0\" encoding=\"utf-8\"?>");
+  if (auto const element = findElementBytes(node_)) {
+    auto attributes = std::vector<ProtoXmlAttribute>();
+    appendElement(*element, 0, table, attributes, xml);
+  }
+  xml += '\n';
+  return xml;
+}
@@ -0,0 +1,90 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_PROTO_XML_H_
+#define ANDROID_INTROSPECTION_APK_PROTO_XML_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace ai {
+
+class ProtoResourceTable;
+
+//
+// Element of an XML document compiled by aapt2 into an XmlNode, as app
+// bundles keep their manifests and layouts.  It is a view of the
+// XmlElement message: attributes and children are decoded as they are asked
+// for, so looking at one subtree skips over the others unread.
+//
+class ProtoXmlElement final {
+public:
+  explicit ProtoXmlElement(std::span<std::byte const> element) : element_(element) {}
+
+  auto name() const -> std::string_view;
+
+  //
+  // Value of the attribute as text, matched by resource id, or by name for
+  // an id of 0 and attributes compiled without one.  The value as written
+  // is preferred; compiled values format as in decoded binary xml.
+  //
+  auto findAttribute(uint32_t resourceId, std::string_view name, ProtoResourceTable const *table = nullptr) const -> std::optional<std::string>;
+
+  //
+  // Child elements in document order; text is skipped.
+  //
+  auto forEachChild(std::function<void(ProtoXmlElement const &)> const &visitor) const -> void;
+
+  auto findChild(std::string_view name) const -> std::optional<ProtoXmlElement>;
+
+private:
+  std::span<std::byte const> element_;
+};
+
+//
+// Document of an XmlNode, rendered to text the way decoded binary xml is,
+// so that the manifests of bundles and APKs compare.
+//
+class ProtoXml final {
+public:
+  explicit ProtoXml(std::span<std::byte const> node) : node_(node) {}
+
+  //
+  // The root element, nothing if the node is text.
+  //
+  auto root() const -> std::optional<ProtoXmlElement>;
+
+  auto toStringXml(ProtoResourceTable const *table = nullptr) const -> std::string;
+
+private:
+  std::span<std::byte const> node_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_PROTO_XML_H_ */
@@ -0,0 +1,175 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <charconv>
+#include <optional>
+#include <vector>
+
+#include "proto_manifest_parser.h"
+
+using namespace ai;
+
+namespace {
+
+//
+// android.R.attr ids of the attributes read, as in AndroidManifestParser.
+//
+static constexpr uint32_t ANDROID_NAME_ATTRIBUTE = 0x01010003;
+static constexpr uint32_t ANDROID_DEBUGGABLE_ATTRIBUTE = 0x0101000f;
+static constexpr uint32_t ANDROID_VERSION_CODE_ATTRIBUTE = 0x0101021b;
+static constexpr uint32_t ANDROID_VERSION_NAME_ATTRIBUTE = 0x0101021c;
+static constexpr uint32_t ANDROID_PERMISSION_ATTRIBUTE = 0x01010006;
+static constexpr uint32_t ANDROID_ENABLED_ATTRIBUTE = 0x0101000e;
+static constexpr uint32_t ANDROID_EXPORTED_ATTRIBUTE = 0x01010010;
+static constexpr uint32_t ANDROID_PRIORITY_ATTRIBUTE = 0x0101001c;
+static constexpr uint32_t ANDROID_MIME_TYPE_ATTRIBUTE = 0x01010026;
+static constexpr uint32_t ANDROID_SCHEME_ATTRIBUTE = 0x01010027;
+static constexpr uint32_t ANDROID_HOST_ATTRIBUTE = 0x01010028;
+static constexpr uint32_t ANDROID_PATH_ATTRIBUTE = 0x0101002a;
+static constexpr uint32_t ANDROID_TARGET_SDK_VERSION_ATTRIBUTE = 0x01010270;
+
+template <typename T> auto parseNumber(std::optional<std::string> const &value, T const defaultValue) -> T {
+  auto number = defaultValue;
+  if (value) {
+    std::from_chars(value->data(), value->data() + value->size(), number);
+  }
+  return number;
+}
+
+auto findApplication(ProtoXml const &protoXml) -> std::optional<ProtoXmlElement> {
+  auto const root = protoXml.root();
+  return root && root->name() == "manifest" ? root->findChild("application") : std::nullopt;
+}
+
+auto getManifestAttribute(ProtoXml const &protoXml, uint32_t const attributeResourceId, std::string_view const attributeName) -> std::string {
+  auto const root = protoXml.root();
+  return root && root->name() == "manifest" ? root->findAttribute(attributeResourceId, attributeName).value_or(std::string()) : std::string();
+}
+
+} // namespace
+
+auto ProtoManifestParser::isValid() const -> bool { return findApplication(protoXml_).has_value(); }
+
+auto ProtoManifestParser::toStringXml(ProtoResourceTable const *const table) const -> std::string { return protoXml_.toStringXml(table); }
+
+auto ProtoManifestParser::isApplicationDebuggable() const -> bool {
+  auto const application = findApplication(protoXml_);
+  return application && application->findAttribute(ANDROID_DEBUGGABLE_ATTRIBUTE, "debuggable") == "true";
+}
+
+auto ProtoManifestParser::getPackageName() const -> std::string { return getManifestAttribute(protoXml_, 0, "package"); }
+
+auto ProtoManifestParser::getVersionName() const -> std::string {
+  return getManifestAttribute(protoXml_, ANDROID_VERSION_NAME_ATTRIBUTE, "versionName");
+}
+
+auto ProtoManifestParser::getVersionCode() const -> std::string {
+  return getManifestAttribute(protoXml_, ANDROID_VERSION_CODE_ATTRIBUTE, "versionCode");
+}
+
+auto ProtoManifestParser::getManifestProperties() const -> ManifestProperties {
+  return ManifestProperties{getPackageName(), getVersionCode(), getVersionName(), isApplicationDebuggable()};
+}
+
+auto ProtoManifestParser::getComponents() const -> ManifestComponents {
+  auto components = ManifestComponents();
+  auto const root = protoXml_.root();
+  if (!root || root->name() != "manifest") {
+    return components;
+  }
+  auto const intern = [&components](std::optional<std::string> const &value) {
+    return value ? components.intern(*value) : ManifestComponents::NO_STRING;
+  };
+  components.packageName_ = components.intern(root->findAttribute(0, "package").value_or(std::string()));
+
+  //
+  // Components are added while walking the application; the target SDK,
+  // which decides whether providers are exported, may come after it.
+  //
+  auto isExportDeclared = std::vector<bool>();
+  auto const addFilterChild = [&components, &intern](ProtoXmlElement const &element) {
+    auto &filter = components.filters_.back();
+    auto const tag = element.name();
+    if (tag == "action") {
+      components.actions_.push_back(intern(element.findAttribute(ANDROID_NAME_ATTRIBUTE, "name")));
+      filter.actionCount++;
+    } else if (tag == "category") {
+      components.categories_.push_back(intern(element.findAttribute(ANDROID_NAME_ATTRIBUTE, "name")));
+      filter.categoryCount++;
+    } else if (tag == "data") {
+      components.data_.push_back(IntentFilterData{intern(element.findAttribute(ANDROID_SCHEME_ATTRIBUTE, "scheme")),
+                                                  intern(element.findAttribute(ANDROID_HOST_ATTRIBUTE, "host")),
+                                                  intern(element.findAttribute(ANDROID_PATH_ATTRIBUTE, "path")),
+                                                  intern(element.findAttribute(ANDROID_MIME_TYPE_ATTRIBUTE, "mimeType"))});
+      filter.dataCount++;
+    }
+  };
+  auto const addComponent = [&](ProtoXmlElement const &element) {
+    auto const type = ManifestComponents::getComponentType(element.name());
+    if (!type) {
+      return;
+    }
+    auto const name = element.findAttribute(ANDROID_NAME_ATTRIBUTE, "name");
+    auto const exported = element.findAttribute(ANDROID_EXPORTED_ATTRIBUTE, "exported");
+    auto const component = static_cast<uint32_t>(components.components_.size());
+    components.components_.push_back(ManifestComponent{*type, components.internClassName(name.value_or(std::string())),
+                                                       intern(element.findAttribute(ANDROID_PERMISSION_ATTRIBUTE, "permission")),
+                                                       exported ? *exported == "true" : false,
+                                                       element.findAttribute(ANDROID_ENABLED_ATTRIBUTE, "enabled") != "false",
+                                                       static_cast<uint32_t>(components.filters_.size()), 0});
+    components.componentsByName_.emplace(components.components_.back().name, component);
+    isExportDeclared.push_back(exported.has_value());
+    element.forEachChild([&](ProtoXmlElement const &filterElement) {
+      if (filterElement.name() != "intent-filter") {
+        return;
+      }
+      components.components_[component].filterCount++;
+      components.filters_.push_back(IntentFilter{component, parseNumber(filterElement.findAttribute(ANDROID_PRIORITY_ATTRIBUTE, "priority"), 0),
+                                                 static_cast<uint32_t>(components.actions_.size()), 0,
+                                                 static_cast<uint32_t>(components.categories_.size()), 0,
+                                                 static_cast<uint32_t>(components.data_.size()), 0});
+      filterElement.forEachChild(addFilterChild);
+    });
+  };
+
+  root->forEachChild([&](ProtoXmlElement const &element) {
+    auto const tag = element.name();
+    if (tag == "uses-permission" || tag == "uses-permission-sdk-23") {
+      if (auto const name = element.findAttribute(ANDROID_NAME_ATTRIBUTE, "name")) {
+        components.requestedPermissions_.push_back(components.intern(*name));
+      }
+    } else if (tag == "permission") {
+      if (auto const name = element.findAttribute(ANDROID_NAME_ATTRIBUTE, "name")) {
+        components.declaredPermissions_.push_back(components.intern(*name));
+      }
+    } else if (tag == "uses-sdk") {
+      components.targetSdkVersion_ =
+          parseNumber(element.findAttribute(ANDROID_TARGET_SDK_VERSION_ATTRIBUTE, "targetSdkVersion"), components.targetSdkVersion_);
+    } else if (tag == "application") {
+      element.forEachChild(addComponent);
+    }
+  });
+
+  components.finish(isExportDeclared);
+  return components;
+}
@@ -0,0 +1,72 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_PROTO_MANIFEST_PARSER_H_
+#define ANDROID_INTROSPECTION_APK_PROTO_MANIFEST_PARSER_H_
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+#include "android_manifest_parser.h"
+#include "apk/manifest_components.h"
+#include "proto/proto_xml.h"
+
+namespace ai {
+
+class ProtoResourceTable;
+
+//
+// AndroidManifest.xml of an app bundle module, compiled by aapt2 into an
+// XmlNode instead of binary xml.  It answers the queries AndroidManifestParser
+// answers for APKs, into the same models, over bytes it does not own: only
+// the elements a query walks to are decoded.
+//
+class ProtoManifestParser final {
+
+public:
+  explicit ProtoManifestParser(std::span<std::byte const> bytes) : protoXml_(bytes) {}
+
+  auto isValid() const -> bool;
+
+  auto toStringXml(ProtoResourceTable const *table = nullptr) const -> std::string;
+
+  auto isApplicationDebuggable() const -> bool;
+
+  auto getPackageName() const -> std::string;
+
+  auto getVersionName() const -> std::string;
+
+  auto getVersionCode() const -> std::string;
+
+  auto getManifestProperties() const -> ManifestProperties;
+
+  auto getComponents() const -> ManifestComponents;
+
+private:
+  ProtoXml protoXml_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_PROTO_MANIFEST_PARSER_H_ */
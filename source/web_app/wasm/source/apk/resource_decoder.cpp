@@ -0,0 +1,126 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "binary_xml/binary_xml.h"
+#include "binary_xml/resource_resolver.h"
+#include "binary_xml/resource_table.h"
+#include "binary_xml/resource_types.h"
+#include "resource_decoder.h"
+#include "utils/bounded_queue.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+#include "zip_archiver.h"
+
+using namespace ai;
+
+namespace {
+
+auto isBinaryXml(std::span<std::byte const> const contents) -> bool {
+  auto magicNumber = uint32_t{0};
+  if (contents.size() < sizeof(magicNumber)) {
+    return false;
+  }
+  memcpy(&magicNumber, contents.data(), sizeof(magicNumber));
+  return magicNumber == XML_IDENTIFIER;
+}
+
+auto decodeXmlResource(ZipEntry const &entry, std::span<std::byte const> const contents, ResourceResolver *const resolver) -> DecodedXmlResource {
+  auto resource = DecodedXmlResource{entry.path, {}, {}};
+  try {
+    if (isBinaryXml(contents)) {
+      resource.xml = BinaryXml(std::vector<std::byte>(contents.begin(), contents.end())).toStringXml(resolver);
+    } else {
+      resource.xml.assign(reinterpret_cast<char const *>(contents.data()), contents.size());
+    }
+  } catch (std::exception const &exception) {
+    LOGW("unable to decode [{}], {}", entry.path, exception.what());
+    resource.error = exception.what();
+  }
+  return resource;
+}
+
+} // namespace
+
+auto ai::isXmlResource(ZipEntry const &entry) -> bool { return entry.path.starts_with("res/") && entry.path.ends_with(".xml"); }
+
+auto ai::decodeXmlResources(ZipArchiver const &archiver, ResourceTable const *const table, utils::ThreadPool &threadPool,
+                            DecodedXmlResourceConsumer const &consumer, std::size_t const queueCapacity) -> void {
+  decodeXmlResources(archiver, table, isXmlResource, threadPool, consumer, queueCapacity);
+}
+
+auto ai::decodeXmlResources(ZipArchiver const &archiver, ResourceTable const *const table, ZipEntryFilter const &filter, utils::ThreadPool &threadPool,
+                            DecodedXmlResourceConsumer const &consumer, std::size_t const queueCapacity) -> void {
+  auto const workerCount = std::max<std::size_t>(threadPool.threadCount(), 1);
+  auto resolvers = std::vector<std::unique_ptr<ResourceResolver>>(workerCount);
+  if (table != nullptr) {
+    for (auto &resolver : resolvers) {
+      resolver = std::make_unique<ResourceResolver>(*table);
+    }
+  }
+
+  if (threadPool.threadCount() == 0) {
+    archiver.extractAll(filter, [&](std::size_t const worker, ZipEntry const &entry, std::span<std::byte const> const contents) {
+      consumer(decodeXmlResource(entry, contents, resolvers[worker].get()));
+    }, threadPool);
+    return;
+  }
+
+  //
+  // Extraction waits for its workers, so it runs on a thread of its own
+  // while this thread drains the queue.
+  //
+  auto queue = utils::BoundedQueue<DecodedXmlResource>(queueCapacity);
+  auto producerError = std::exception_ptr();
+  auto producer = std::thread([&] {
+    try {
+      archiver.extractAll(filter, [&](std::size_t const worker, ZipEntry const &entry, std::span<std::byte const> const contents) {
+        if (!queue.isClosed()) {
+          queue.push(decodeXmlResource(entry, contents, resolvers[worker].get()));
+        }
+      }, threadPool);
+    } catch (...) {
+      producerError = std::current_exception();
+    }
+    queue.close();
+  });
+
+  try {
+    while (auto resource = queue.pop()) {
+      consumer(std::move(*resource));
+    }
+  } catch (...) {
+    queue.close();
+    producer.join();
+    throw;
+  }
+  producer.join();
+  if (producerError) {
+    std::rethrow_exception(producerError);
+  }
+}
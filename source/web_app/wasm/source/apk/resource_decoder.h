@@ -0,0 +1,84 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_RESOURCE_DECODER_H_
+#define ANDROID_INTROSPECTION_APK_RESOURCE_DECODER_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include "zip_archiver.h"
+
+namespace ai {
+
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+class ResourceTable;
+
+struct DecodedXmlResource {
+
+  std::string path;
+
+  std::string xml;
+
+  //
+  // Why the resource could not be decoded; xml is empty then.
+  //
+  std::string error;
+};
+
+using DecodedXmlResourceConsumer = std::function<void(DecodedXmlResource)>;
+
+//
+// Whether the entry is one of the xml files under res/ that a dump decodes.
+//
+auto isXmlResource(ZipEntry const &entry) -> bool;
+
+//
+// Turns every xml file under res/ into text.  Entries are picked from the
+// central directory, then inflated and decoded on the workers of the pool;
+// files that are not binary xml are passed on as they are.  Every worker
+// renders through its own reference cache in front of the shared table,
+// which it only has to consult the first time it sees an id.
+//
+// Results reach consumer on the calling thread, in completion order,
+// through a queue of queueCapacity results that holds back the workers
+// while the consumer is busy.  A pool without threads decodes and
+// consumes one resource after the other.
+//
+auto decodeXmlResources(ZipArchiver const &archiver, ResourceTable const *table, utils::ThreadPool &threadPool, DecodedXmlResourceConsumer const &consumer,
+                        std::size_t queueCapacity = 64) -> void;
+
+//
+// Same as above for the entries accepted by filter rather than the xml
+// files under res/.
+//
+auto decodeXmlResources(ZipArchiver const &archiver, ResourceTable const *table, ZipEntryFilter const &filter, utils::ThreadPool &threadPool,
+                        DecodedXmlResourceConsumer const &consumer, std::size_t queueCapacity = 64) -> void;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_RESOURCE_DECODER_H_ */
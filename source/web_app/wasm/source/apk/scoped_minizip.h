@@ -29,8 +29,18 @@
 #include <mz_zip_rw.h>
 #include <zip.h>
 
+namespace ai {
+class ZipReader;
+} // namespace ai
+
 namespace ai::minizip {
 
+//
+// Opens an archive for reading through a ZipReader instead of a path.  The
+// reader must outlive the returned handle.
+//
+auto openZipReader(ZipReader const &reader) -> unzFile;
+
 struct ScopedZipOpen {
 
   explicit ScopedZipOpen(char const *const szFileName, int const mode) : zip_(zipOpen(szFileName, mode)) {}
@@ -57,11 +67,32 @@ private:
   zipFile const zipFile_;
 };
 
+struct ScopedZipCloseFileInZipRaw {
+
+  ScopedZipCloseFileInZipRaw(zipFile const zipFile, uint64_t const uncompressedSize, uint32_t const crc)
+      : zipFile_(zipFile), uncompressedSize_(uncompressedSize), crc_(crc) {}
+
+  ~ScopedZipCloseFileInZipRaw() { zipCloseFileInZipRaw64(zipFile_, uncompressedSize_, crc_); }
+
+private:
+  zipFile const zipFile_;
+
+  uint64_t const uncompressedSize_;
+
+  uint32_t const crc_;
+};
+
 struct ScopedUnzOpenFile {
 
   explicit ScopedUnzOpenFile(char const *const szFileName) : zip_(unzOpen(szFileName)) {}
 
-  ~ScopedUnzOpenFile() { unzClose(zip_); }
+  explicit ScopedUnzOpenFile(ZipReader const *const reader) : zip_(reader == nullptr ? nullptr : openZipReader(*reader)) {}
+
+  ~ScopedUnzOpenFile() {
+    if (zip_ != nullptr) {
+      unzClose(zip_);
+    }
+  }
 
   auto get() const -> unzFile { return zip_; }
 
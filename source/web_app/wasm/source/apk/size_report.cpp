@@ -0,0 +1,149 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+
+#include "apk/size_report.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr uint16_t STORED = 0;
+
+//
+// Name of the bucket of the files at the root of the APK.
+//
+static constexpr std::string_view ROOT_DIRECTORY = "/";
+
+static constexpr std::string_view LIBRARY_DIRECTORY = "lib/";
+
+//
+// Buckets by name, sorted into a list once every entry is in.
+//
+class SizeBuckets final {
+public:
+  auto add(std::string_view const name, ApkEntry const &entry) -> void {
+    auto &bucket = buckets_.try_emplace(std::string(name), SizeBucket{std::string(name), 0, 0, 0}).first->second;
+    bucket.compressedSize += entry.compressedSize;
+    bucket.uncompressedSize += entry.uncompressedSize;
+    bucket.entryCount++;
+  }
+
+  auto sorted() -> std::vector<SizeBucket> {
+    auto buckets = std::vector<SizeBucket>();
+    buckets.reserve(buckets_.size());
+    for (auto &[name, bucket] : buckets_) {
+      buckets.push_back(std::move(bucket));
+    }
+    std::sort(buckets.begin(), buckets.end(), [](SizeBucket const &a, SizeBucket const &b) {
+      return a.compressedSize != b.compressedSize ? a.compressedSize > b.compressedSize : a.name < b.name;
+    });
+    return buckets;
+  }
+
+private:
+  std::unordered_map<std::string, SizeBucket> buckets_;
+};
+
+auto getDirectory(std::string_view const path) -> std::string_view {
+  auto const slash = path.find('/');
+  return slash == std::string_view::npos ? ROOT_DIRECTORY : path.substr(0, slash);
+}
+
+//
+// ABI of a native library, e.g. "arm64-v8a" of lib/arm64-v8a/libfoo.so.
+//
+auto getAbi(std::string_view const path) -> std::string_view {
+  if (!path.starts_with(LIBRARY_DIRECTORY)) {
+    return {};
+  }
+  auto const abi = path.substr(LIBRARY_DIRECTORY.size());
+  auto const slash = abi.find('/');
+  return slash == std::string_view::npos ? std::string_view() : abi.substr(0, slash);
+}
+
+//
+// Types deflate does well on.  Dex files, libraries and the resource table
+// are left out: Android wants them stored, to map them in place.
+//
+auto isCompressible(ContentType const type) -> bool {
+  return type == ContentType::Text || type == ContentType::JavaScript || type == ContentType::BinaryXml;
+}
+
+auto getSizeIssue(ApkEntry const &entry, ContentType const type) -> std::optional<SizeIssue> {
+  if (entry.uncompressedSize < SIZE_FLAG_MIN_SIZE) {
+    return std::nullopt;
+  }
+  if (entry.compressionMethod == STORED) {
+    return isCompressible(type) ? std::optional(SizeIssue::StoredCompressible) : std::nullopt;
+  }
+  return entry.compressedSize * 20 > entry.uncompressedSize * 19 ? std::optional(SizeIssue::BadlyCompressed) : std::nullopt;
+}
+
+} // namespace
+
+auto ai::buildSizeReport(std::span<ApkEntry const> const entries) -> SizeReport {
+  auto report = SizeReport{0, 0, 0, {}, {}, {}, {}, {}};
+  auto directories = SizeBuckets();
+  auto types = SizeBuckets();
+  auto abis = SizeBuckets();
+  auto dexFiles = SizeBuckets();
+  for (auto const &entry : entries) {
+    if (entry.path.ends_with('/')) {
+      continue;
+    }
+    report.compressedSize += entry.compressedSize;
+    report.uncompressedSize += entry.uncompressedSize;
+    report.entryCount++;
+    auto const type = classifyPath(entry.path, entry.uncompressedSize);
+    directories.add(getDirectory(entry.path), entry);
+    types.add(getContentTypeName(type), entry);
+    if (auto const abi = getAbi(entry.path); !abi.empty()) {
+      abis.add(abi, entry);
+    }
+    if (type == ContentType::Dex) {
+      dexFiles.add(entry.path, entry);
+    }
+    if (auto const issue = getSizeIssue(entry, type)) {
+      report.flags.push_back(SizeFlag{entry.path, *issue, type, entry.compressedSize, entry.uncompressedSize});
+    }
+  }
+  report.directories = directories.sorted();
+  report.types = types.sorted();
+  report.abis = abis.sorted();
+  report.dexFiles = dexFiles.sorted();
+  return report;
+}
+
+auto ai::getSizeIssueName(SizeIssue const issue) -> std::string_view {
+  switch (issue) {
+  case SizeIssue::BadlyCompressed:
+    return "badly-compressed";
+  case SizeIssue::StoredCompressible:
+    return "stored-compressible";
+  }
+  return "unknown";
+}
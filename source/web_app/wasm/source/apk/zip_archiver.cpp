@@ -21,22 +21,410 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
+#define LOG_MODULE LOG_MODULE_ZIP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <istream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <zlib.h>
 
+#include "inflater.h"
 #include "scoped_minizip.h"
+#include "utils/crc32.h"
+#include "utils/file_output.h"
+#include "utils/little_endian.h"
 #include "utils/log.h"
+#include "utils/macros.h"
+#include "utils/mapped_file.h"
+#include "utils/metrics.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
 #include "utils/utils.h"
 #include "zip.h"
 #include "zip_archiver.h"
+#include "zip_reader.h"
+#include "zip_recovery.h"
 
 using namespace ai;
 using namespace ai::minizip;
 
+namespace fs = std::filesystem;
+
 namespace {
 
+static constexpr size_t EXTRACT_CHUNK_SIZE = 64 * 1024;
+
+static constexpr size_t WRITE_CHUNK_SIZE = 1024 * 1024;
+
+//
+// Largest compressed entry extractAll() inflates whole to hand to the
+// batched file output.
+//
+static constexpr uint64_t BATCHED_EXTRACT_SIZE = 256 * 1024;
+
+static constexpr size_t MAX_SCRATCH_BUFFER_SIZE = 16 * 1024 * 1024;
+
+static constexpr uint64_t ZIP64_THRESHOLD = 0xFFFFFFFF;
+
+static constexpr uint32_t LOCAL_FILE_HEADER_SIGNATURE = 0x04034b50;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_SIZE = 30;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_FILE_NAME_LENGTH_OFFSET = 26;
+
+static constexpr size_t MAX_FILE_NAME_SIZE = UINT16_MAX;
+
+//
+// minizip handles an index keeps open between reads, each holding its
+// buffers; more are opened while more threads read at once.
+//
+static constexpr size_t MAX_IDLE_ZIP_FILES = 8;
+
+static constexpr uint16_t ALIGNMENT_EXTRA_FIELD_ID = 0xd935;
+
+static constexpr uint64_t ALIGNMENT_EXTRA_FIELD_SIZE = 6;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_EXTRA_FIELD_LENGTH_OFFSET = 28;
+
+static constexpr uint32_t CENTRAL_DIRECTORY_HEADER_SIGNATURE = 0x02014b50;
+
+static constexpr uint64_t CENTRAL_DIRECTORY_HEADER_SIZE = 46;
+
+static constexpr uint64_t CENTRAL_DIRECTORY_HEADER_FILE_NAME_LENGTH_OFFSET = 28;
+
+static constexpr uint64_t CENTRAL_DIRECTORY_HEADER_EXTRA_FIELD_LENGTH_OFFSET = 30;
+
+static constexpr uint64_t CENTRAL_DIRECTORY_HEADER_COMMENT_LENGTH_OFFSET = 32;
+
+static constexpr uint32_t END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+
+static constexpr uint64_t END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+
+static constexpr uint64_t END_OF_CENTRAL_DIRECTORY_SIZE_OFFSET = 12;
+
+static constexpr uint64_t END_OF_CENTRAL_DIRECTORY_OFFSET_OFFSET = 16;
+
+static constexpr uint32_t ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIGNATURE = 0x07064b50;
+
+static constexpr uint64_t ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIZE = 20;
+
+static constexpr uint64_t ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_OFFSET_OFFSET = 8;
+
+static constexpr uint64_t ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE = 56;
+
+static constexpr uint64_t ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE_OFFSET = 40;
+
+static constexpr uint64_t ZIP64_END_OF_CENTRAL_DIRECTORY_OFFSET_OFFSET = 48;
+
+//
+// Deflate expands data at most 1032 times, plus a few bytes of headers, so
+// an entry claiming more than that is corrupt.
+//
+static constexpr uint64_t MAX_DEFLATE_RATIO = 1032;
+
+static constexpr uint64_t MAX_DEFLATE_OVERHEAD = 1024;
+
+//
+// Compressed bytes peek() reads of a deflated entry on top of twice the
+// bytes asked for: no literal takes more than 15 bits, and this leaves room
+// for the headers of the blocks they are in.
+//
+static constexpr uint64_t PEEK_COMPRESSED_OVERHEAD = 4 * 1024;
+
+//
+// Bytes past the entry a worker claims that a bulk pass asks the reader to
+// fetch in the background.
+//
+static constexpr uint64_t PREFETCH_SIZE = 8 * 1024 * 1024;
+
+//
+// Entries whose local header opening an archive checks, see
+// hasLocalHeaders().
+//
+static constexpr size_t LOCAL_HEADER_SAMPLES = 4;
+
+using ai::utils::little_endian::load;
+using ai::utils::little_endian::store;
+
+auto isStoredEntry(ZipEntry const &entry) {
+  return entry.compressionMethod == MZ_COMPRESS_METHOD_STORE && entry.compressedSize == entry.uncompressedSize;
+}
+
+auto isDeflatedEntry(ZipEntry const &entry) { return entry.compressionMethod == MZ_COMPRESS_METHOD_DEFLATE; }
+
+auto resizeForInflate(ZipEntry const &entry, std::vector<std::byte> &contents) -> void { contents.resize(getInflatedSize(entry)); }
+
+//
+// Per-thread buffer for compressed data read from readers that are not in
+// memory, so that bulk extracts do not allocate for every entry.  Buffers
+// that grew past MAX_SCRATCH_BUFFER_SIZE are released after use.
+//
+struct ScratchBuffer {
+
+  ScratchBuffer() : buffer(get()) {}
+
+  ~ScratchBuffer() {
+    if (buffer.capacity() > MAX_SCRATCH_BUFFER_SIZE) {
+      buffer = std::vector<std::byte>();
+    }
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(ScratchBuffer);
+
+  static auto get() -> std::vector<std::byte> & {
+    thread_local auto scratchBuffer = std::vector<std::byte>();
+    return scratchBuffer;
+  }
+
+  std::vector<std::byte> &buffer;
+};
+
+auto getEntryData(std::span<std::byte const> const archive, ZipEntry const &entry) -> std::span<std::byte const> {
+  if (archive.size() < LOCAL_FILE_HEADER_SIZE || entry.localHeaderOffset > archive.size() - LOCAL_FILE_HEADER_SIZE) {
+    throw std::logic_error("local file header is out of bounds");
+  }
+  if (load<uint32_t>(archive, entry.localHeaderOffset) != LOCAL_FILE_HEADER_SIGNATURE) {
+    throw std::logic_error("invalid local file header signature");
+  }
+  auto const fileNameLength = load<uint16_t>(archive, entry.localHeaderOffset + LOCAL_FILE_HEADER_FILE_NAME_LENGTH_OFFSET);
+  auto const extraFieldLength = load<uint16_t>(archive, entry.localHeaderOffset + LOCAL_FILE_HEADER_EXTRA_FIELD_LENGTH_OFFSET);
+  auto const dataOffset = entry.localHeaderOffset + LOCAL_FILE_HEADER_SIZE + fileNameLength + extraFieldLength;
+  if (dataOffset > archive.size() || entry.compressedSize > archive.size() - dataOffset) {
+    throw std::logic_error("entry data is out of bounds");
+  }
+  return archive.subspan(dataOffset, entry.compressedSize);
+}
+
+//
+// Returns the raw data of an entry, straight from the reader's view when it
+// has one and read into buffer otherwise.  Only its first maxSize bytes are
+// read, though the whole entry still has to be within the archive.
+//
+auto readEntryData(ZipReader const &reader, ZipEntry const &entry, std::vector<std::byte> &buffer, uint64_t const maxSize = UINT64_MAX)
+    -> std::span<std::byte const> {
+  if (auto const archive = reader.view(); archive) {
+    auto const entryData = getEntryData(*archive, entry);
+    return entryData.first(std::min<uint64_t>(entryData.size(), maxSize));
+  }
+  auto header = std::array<std::byte, LOCAL_FILE_HEADER_SIZE>();
+  if (reader.readAt(entry.localHeaderOffset, header) != header.size()) {
+    throw std::logic_error("local file header is out of bounds");
+  }
+  if (load<uint32_t>(header, 0) != LOCAL_FILE_HEADER_SIGNATURE) {
+    throw std::logic_error("invalid local file header signature");
+  }
+  auto const fileNameLength = load<uint16_t>(header, LOCAL_FILE_HEADER_FILE_NAME_LENGTH_OFFSET);
+  auto const extraFieldLength = load<uint16_t>(header, LOCAL_FILE_HEADER_EXTRA_FIELD_LENGTH_OFFSET);
+  auto const dataOffset = entry.localHeaderOffset + LOCAL_FILE_HEADER_SIZE + fileNameLength + extraFieldLength;
+  if (dataOffset > reader.size() || entry.compressedSize > reader.size() - dataOffset) {
+    throw std::logic_error("entry data is out of bounds");
+  }
+  buffer.resize(std::min(entry.compressedSize, maxSize));
+  if (reader.readAt(dataOffset, buffer) != buffer.size()) {
+    throw std::logic_error("entry data is out of bounds");
+  }
+  return buffer;
+}
+
+//
+// Hints for a bulk pass over the entries in central directory order, which
+// is the order of their data in archives written by the usual tools: the
+// archive is read sequentially, and the data of the next entries is
+// prefetched ahead of the workers.
+//
+class SequentialPass final {
+public:
+  explicit SequentialPass(ZipReader const *const reader) : reader_(reader) { advise(utils::AccessAdvice::Sequential, 0, 0); }
+
+  ~SequentialPass() { advise(utils::AccessAdvice::Normal, 0, 0); }
+
+  DISALLOW_COPY_AND_ASSIGN(SequentialPass);
+
+  //
+  // Called by a worker before it reads an entry, so that the next
+  // PREFETCH_SIZE bytes are on their way once it gets past half of them.
+  //
+  auto claim(ZipEntry const &entry) -> void {
+    auto const end = entry.localHeaderOffset + entry.compressedSize;
+    auto prefetched = prefetched_.load(std::memory_order_relaxed);
+    while (end + PREFETCH_SIZE / 2 > prefetched) {
+      if (prefetched_.compare_exchange_weak(prefetched, end + PREFETCH_SIZE, std::memory_order_relaxed)) {
+        auto const start = std::max(prefetched, entry.localHeaderOffset);
+        advise(utils::AccessAdvice::WillNeed, start, end + PREFETCH_SIZE - start);
+        break;
+      }
+    }
+  }
+
+private:
+  auto advise(utils::AccessAdvice const advice, uint64_t const offset, uint64_t const length) const -> void {
+    if (reader_ != nullptr) {
+      reader_->advise(advice, offset, length);
+    }
+  }
+
+  ZipReader const *const reader_;
+
+  std::atomic<uint64_t> prefetched_{0};
+};
+
+auto readEntry(unzFile const zipFile, ZipEntry const &entry) {
+  if (zipFile == nullptr) {
+    throw std::logic_error("archive does not exist");
+  }
+  if (auto const result = unzSetOffset64(zipFile, entry.centralDirectoryOffset); result != UNZ_OK) {
+    throw std::logic_error("path does not exist in archive");
+  }
+  auto const openedZipFile = ScopedUnzOpenCurrentFile(zipFile);
+  if (auto result = openedZipFile.result(); result != MZ_OK) {
+    throw std::logic_error("unable to open zip entry in archive");
+  }
+  auto contents = std::vector<std::byte>();
+  resizeForInflate(entry, contents);
+  auto const contentsSize = static_cast<uint32_t>(contents.size());
+  if (auto const bytesRead = unzReadCurrentFile(zipFile, contents.data(), contentsSize); static_cast<uint32_t>(bytesRead) != contentsSize) {
+    throw std::logic_error("unable to read full file in archive");
+  }
+  return contents;
+}
+
+auto readEntryInChunks(unzFile const zipFile, ZipEntry const &entry, ZipEntrySink const &sink) {
+  if (zipFile == nullptr) {
+    throw std::logic_error("archive does not exist");
+  }
+  if (auto const result = unzSetOffset64(zipFile, entry.centralDirectoryOffset); result != UNZ_OK) {
+    throw std::logic_error("path does not exist in archive");
+  }
+  auto const openedZipFile = ScopedUnzOpenCurrentFile(zipFile);
+  if (auto result = openedZipFile.result(); result != MZ_OK) {
+    throw std::logic_error("unable to open zip entry in archive");
+  }
+  auto chunk = std::vector<std::byte>(std::min<uint64_t>(entry.uncompressedSize, EXTRACT_CHUNK_SIZE));
+  auto bytesRemaining = entry.uncompressedSize;
+  while (bytesRemaining > 0) {
+    auto const bytesRead = unzReadCurrentFile(zipFile, chunk.data(), static_cast<uint32_t>(chunk.size()));
+    if (bytesRead <= 0) {
+      throw std::logic_error("unable to read full file in archive");
+    }
+    auto const chunkSize = std::min<uint64_t>(static_cast<uint64_t>(bytesRead), bytesRemaining);
+    sink(std::span<std::byte const>(chunk.data(), chunkSize));
+    bytesRemaining -= chunkSize;
+  }
+}
+
+//
+// Whether entries spread over the central directory, the first and the
+// last among them, have their local header where it puts them, with their
+// data within the archive.  The fake central directories of packers list
+// entries that point at nothing; a sample finds them without a read per
+// entry on every open.
+//
+auto hasLocalHeaders(ZipReader const &reader, std::vector<ZipEntry> const &entries) -> bool {
+  auto buffer = std::vector<std::byte>();
+  auto const sampleCount = std::min(entries.size(), LOCAL_HEADER_SAMPLES);
+  try {
+    for (auto sample = size_t{0}; sample < sampleCount; sample++) {
+      auto const entry = sampleCount == 1 ? 0 : sample * (entries.size() - 1) / (sampleCount - 1);
+      readEntryData(reader, entries[entry], buffer, 0);
+    }
+  } catch (std::logic_error const &) {
+    return false;
+  }
+  return true;
+}
+
+//
+// Streams a deflated entry through the thread's pooled inflater when the
+// archive is in memory, and through minizip otherwise.  Entries recovered
+// from local headers can't be read by minizip, so their compressed data is
+// read whole instead.
+//
+auto inflateInChunks(ZipReader const &reader, unzFile const zipFile, ZipEntry const &entry, ZipEntrySink const &sink) {
+  if (auto const archive = reader.view(); archive && isDeflatedEntry(entry)) {
+    if (Inflater::forThread().inflate(getEntryData(*archive, entry), sink) != entry.uncompressedSize) {
+      throw std::logic_error("entry does not match its uncompressed size");
+    }
+    return;
+  }
+  if (entry.centralDirectoryOffset == NO_CENTRAL_DIRECTORY_OFFSET && isDeflatedEntry(entry)) {
+    auto const scratchBuffer = ScratchBuffer();
+    if (Inflater::forThread().inflate(readEntryData(reader, entry, scratchBuffer.buffer), sink) != entry.uncompressedSize) {
+      throw std::logic_error("entry does not match its uncompressed size");
+    }
+    return;
+  }
+  readEntryInChunks(zipFile, entry, sink);
+}
+
+auto viewInChunks(std::span<std::byte const> const entryData, ZipEntrySink const &sink) {
+  for (size_t offset{0}; offset < entryData.size(); offset += EXTRACT_CHUNK_SIZE) {
+    sink(entryData.subspan(offset, std::min(EXTRACT_CHUNK_SIZE, entryData.size() - offset)));
+  }
+}
+
+auto prepareDestinationDirectory(std::string_view const destinationDirectory) {
+  if (!fs::exists(destinationDirectory)) {
+    LOGD("prepareDestinationDirectory, destinationDirectory does not exist; creating directory");
+    fs::create_directories(destinationDirectory);
+  }
+  auto const isPathValid = fs::is_directory(destinationDirectory);
+  if (!isPathValid) {
+    throw std::logic_error("destinationDirectory must be a directory or must not exist");
+  }
+}
+
+//
+// Resolves where an entry is written to, refusing entries whose path
+// escapes the destination directory (e.g. "../../file").
+//
+auto getExtractPath(fs::path const &destinationDirectory, std::string_view const pathInArchive) -> std::optional<fs::path> {
+  auto const extractPath = (destinationDirectory / std::string(pathInArchive)).lexically_normal();
+  auto const relativePath = extractPath.lexically_relative(destinationDirectory);
+  if (relativePath.empty() || *relativePath.begin() == "..") {
+    LOGW("getExtractPath, skipping path outside of destination [{}]", pathInArchive);
+    return std::nullopt;
+  }
+  return extractPath;
+}
+
+auto writeToStream(std::ostream &destination, std::span<std::byte const> const contents) {
+  destination.write(reinterpret_cast<char const *>(contents.data()), static_cast<std::streamsize>(contents.size()));
+  if (!destination.good()) {
+    throw std::logic_error("unable to write extracted contents");
+  }
+}
+
+//
+// Creates the parent directories of extracted files, skipping the calls for
+// a run of entries in the same directory.
+//
+class ParentDirectories final {
+public:
+  auto create(fs::path const &path) -> void {
+    auto parent = path.parent_path();
+    if (parent != lastParent_) {
+      fs::create_directories(parent);
+      lastParent_ = std::move(parent);
+    }
+  }
+
+private:
+  fs::path lastParent_;
+};
+
 auto openZipFile(std::string const &path) {
   auto fileExists = std::filesystem::exists(path);
   auto zipMode = fileExists ? APPEND_STATUS_ADDINZIP : APPEND_STATUS_CREATE;
@@ -63,33 +451,449 @@ auto writeStreamToOpenZipFile(std::istream &source, zipFile const zipFile) {
   } while ((result == ZIP_OK) && (readCount > 0));
 }
 
-auto getAllEntriesInZipFile(std::string const &pathToArchive) {
-  using PathAndFileInfo = std::pair<std::string, unz_file_info64>;
-  auto entries = std::vector<PathAndFileInfo>();
-  auto openedZipFile = ScopedUnzOpenFile(pathToArchive.c_str());
-  if (openedZipFile.get() == nullptr) {
-    LOGW("getAllEntriesInZipFile, pathToArchive [{}]", pathToArchive.c_str());
-    return entries;
+//
+// Builds the zipalign style extra field that pads the local header of the
+// next entry written to the archive, so that its data starts on a multiple
+// of the alignment.  minizip writes the field to the central directory as
+// well, which stripCentralAlignmentFields() undoes once the archive is
+// closed.
+//
+auto getAlignmentExtraField(zipFile const zipFile, std::string const &pathInArchive, uint32_t const alignment) {
+  auto extraField = std::vector<std::byte>();
+  if (alignment <= 1) {
+    return extraField;
+  }
+  auto const stream = zipGetStream_MZ(zipFile);
+  auto const headerOffset = stream == nullptr ? -1 : mz_stream_tell(stream);
+  if (headerOffset < 0) {
+    throw std::logic_error("unable to get archive write offset");
+  }
+  auto const dataOffset = static_cast<uint64_t>(headerOffset) + LOCAL_FILE_HEADER_SIZE + pathInArchive.size() + ALIGNMENT_EXTRA_FIELD_SIZE;
+  auto const padding = (alignment - dataOffset % alignment) % alignment;
+  extraField.resize(ALIGNMENT_EXTRA_FIELD_SIZE + padding);
+  auto const fieldId = ALIGNMENT_EXTRA_FIELD_ID;
+  auto const fieldSize = static_cast<uint16_t>(sizeof(uint16_t) + padding);
+  auto const fieldAlignment = static_cast<uint16_t>(alignment);
+  std::memcpy(extraField.data(), &fieldId, sizeof(fieldId));
+  std::memcpy(extraField.data() + 2, &fieldSize, sizeof(fieldSize));
+  std::memcpy(extraField.data() + 4, &fieldAlignment, sizeof(fieldAlignment));
+  return extraField;
+}
+
+//
+// Drops the alignment extra fields from the central directory of the closed
+// archive at the path, as zipalign only pads local headers.  The directory
+// and the records after it are moved up over the bytes dropped, and the
+// file is truncated.  minizip writes archives without a comment, so the
+// end of central directory record is the last one.
+//
+auto stripCentralAlignmentFields(std::string const &path) -> void {
+  auto const fileSize = fs::file_size(path);
+  auto file = std::fstream(path, std::ios::binary | std::ios::in | std::ios::out);
+  auto const readAt = [&file](uint64_t const offset, uint64_t const size) {
+    auto bytes = std::vector<std::byte>(size);
+    file.seekg(static_cast<std::streamoff>(offset));
+    if (!file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(size))) {
+      throw std::logic_error("unable to read central directory");
+    }
+    return bytes;
+  };
+  if (fileSize < END_OF_CENTRAL_DIRECTORY_SIZE) {
+    throw std::logic_error("invalid end of central directory");
+  }
+  auto const endOffset = fileSize - END_OF_CENTRAL_DIRECTORY_SIZE;
+  auto const end = readAt(endOffset, END_OF_CENTRAL_DIRECTORY_SIZE);
+  if (load<uint32_t>(end, 0) != END_OF_CENTRAL_DIRECTORY_SIGNATURE) {
+    throw std::logic_error("invalid end of central directory");
+  }
+  auto directoryOffset = uint64_t{load<uint32_t>(end, END_OF_CENTRAL_DIRECTORY_OFFSET_OFFSET)};
+  auto directorySize = uint64_t{load<uint32_t>(end, END_OF_CENTRAL_DIRECTORY_SIZE_OFFSET)};
+  auto zip64EndOffset = std::optional<uint64_t>();
+  if (endOffset >= ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIZE) {
+    auto const locator = readAt(endOffset - ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIZE, ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIZE);
+    if (load<uint32_t>(locator, 0) == ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIGNATURE) {
+      zip64EndOffset = load<uint64_t>(locator, ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_OFFSET_OFFSET);
+      auto const zip64End = readAt(*zip64EndOffset, ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE);
+      directoryOffset = load<uint64_t>(zip64End, ZIP64_END_OF_CENTRAL_DIRECTORY_OFFSET_OFFSET);
+      directorySize = load<uint64_t>(zip64End, ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE_OFFSET);
+    }
+  }
+  if (directoryOffset > endOffset || directorySize > endOffset - directoryOffset || (zip64EndOffset && *zip64EndOffset < directoryOffset + directorySize)) {
+    throw std::logic_error("invalid central directory");
+  }
+
+  auto const tail = readAt(directoryOffset, fileSize - directoryOffset);
+  auto const directory = std::span(tail).first(directorySize);
+  auto stripped = std::vector<std::byte>();
+  stripped.reserve(directory.size());
+  for (auto offset = uint64_t{0}; offset < directory.size();) {
+    if (load<uint32_t>(directory, offset, "invalid central directory") != CENTRAL_DIRECTORY_HEADER_SIGNATURE) {
+      throw std::logic_error("invalid central directory header");
+    }
+    auto const fileNameLength = load<uint16_t>(directory, offset + CENTRAL_DIRECTORY_HEADER_FILE_NAME_LENGTH_OFFSET, "invalid central directory");
+    auto const extraFieldLength = load<uint16_t>(directory, offset + CENTRAL_DIRECTORY_HEADER_EXTRA_FIELD_LENGTH_OFFSET, "invalid central directory");
+    auto const commentLength = load<uint16_t>(directory, offset + CENTRAL_DIRECTORY_HEADER_COMMENT_LENGTH_OFFSET, "invalid central directory");
+    auto const extraFieldOffset = offset + CENTRAL_DIRECTORY_HEADER_SIZE + fileNameLength;
+    auto const extraFieldEnd = extraFieldOffset + extraFieldLength;
+    auto const headerEnd = extraFieldEnd + commentLength;
+    if (headerEnd > directory.size()) {
+      throw std::logic_error("invalid central directory header");
+    }
+    auto const header = stripped.size();
+    stripped.insert(stripped.end(), directory.begin() + static_cast<std::ptrdiff_t>(offset), directory.begin() + static_cast<std::ptrdiff_t>(extraFieldOffset));
+    auto field = extraFieldOffset;
+    while (field + 2 * sizeof(uint16_t) <= extraFieldEnd) {
+      auto const fieldEnd = std::min(field + 2 * sizeof(uint16_t) + load<uint16_t>(directory, field + sizeof(uint16_t)), extraFieldEnd);
+      if (load<uint16_t>(directory, field) != ALIGNMENT_EXTRA_FIELD_ID) {
+        stripped.insert(stripped.end(), directory.begin() + static_cast<std::ptrdiff_t>(field), directory.begin() + static_cast<std::ptrdiff_t>(fieldEnd));
+      }
+      field = fieldEnd;
+    }
+    stripped.insert(stripped.end(), directory.begin() + static_cast<std::ptrdiff_t>(field), directory.begin() + static_cast<std::ptrdiff_t>(headerEnd));
+    auto const strippedExtraFieldLength = stripped.size() - header - CENTRAL_DIRECTORY_HEADER_SIZE - fileNameLength - commentLength;
+    store(std::span(stripped), header + CENTRAL_DIRECTORY_HEADER_EXTRA_FIELD_LENGTH_OFFSET, static_cast<uint16_t>(strippedExtraFieldLength));
+    offset = headerEnd;
+  }
+  auto const removed = directory.size() - stripped.size();
+  if (removed == 0) {
+    return;
+  }
+
+  //
+  // Records after the directory keep their order; only the sizes and
+  // offsets past the directory change.
+  //
+  auto trailer = std::vector<std::byte>(tail.begin() + static_cast<std::ptrdiff_t>(directory.size()), tail.end());
+  auto const trailerEnd = std::span(trailer).last(END_OF_CENTRAL_DIRECTORY_SIZE);
+  if (load<uint32_t>(trailerEnd, END_OF_CENTRAL_DIRECTORY_SIZE_OFFSET) != UINT32_MAX) {
+    store(trailerEnd, END_OF_CENTRAL_DIRECTORY_SIZE_OFFSET, static_cast<uint32_t>(stripped.size()));
+  }
+  if (zip64EndOffset) {
+    auto const zip64End = *zip64EndOffset - directoryOffset - directory.size();
+    store(std::span(trailer), zip64End + ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE_OFFSET, static_cast<uint64_t>(stripped.size()), "invalid central directory");
+    auto const locator = trailer.size() - END_OF_CENTRAL_DIRECTORY_SIZE - ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIZE;
+    store(std::span(trailer), locator + ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_OFFSET_OFFSET, *zip64EndOffset - removed, "invalid central directory");
+  }
+  stripped.insert(stripped.end(), trailer.begin(), trailer.end());
+  file.seekp(static_cast<std::streamoff>(directoryOffset));
+  if (!file.write(reinterpret_cast<char const *>(stripped.data()), static_cast<std::streamsize>(stripped.size()))) {
+    throw std::logic_error("unable to write central directory");
+  }
+  file.close();
+  fs::resize_file(path, fileSize - removed);
+}
+
+auto getAlignment(std::optional<ZipAlignment> const &alignment, std::string_view const pathInArchive, ZipCompression const compression) -> uint32_t {
+  if (!alignment || compression != ZipCompression::Store) {
+    return 0;
   }
-  if (auto result = unzGoToFirstFile(openedZipFile.get()); result == UNZ_OK) {
+  return pathInArchive.ends_with(".so") ? alignment->sharedLibraries : alignment->storedEntries;
+}
+
+auto writeEntry(zipFile const zipFile, std::string const &pathInArchive, std::span<std::byte const> const contents, ZipCompression const compression,
+                uint32_t const alignment = 0) {
+  auto const method = static_cast<int>(compression);
+  auto const level = compression == ZipCompression::Store ? 0 : MZ_COMPRESS_LEVEL_DEFAULT;
+  auto const zip64 = contents.size() >= ZIP64_THRESHOLD;
+  auto const extraField = getAlignmentExtraField(zipFile, pathInArchive, alignment);
+  auto const extraFieldSize = static_cast<uint16_t>(extraField.size());
+  if (auto const result = zipOpenNewFileInZip_64(zipFile, pathInArchive.c_str(), nullptr, extraField.data(), extraFieldSize, extraField.data(), extraFieldSize,
+                                                 nullptr, method, level, zip64);
+      result != ZIP_OK) {
+    throw std::logic_error("unable to add entry to archive");
+  }
+  auto const scopedZipCloseFileInZip = ScopedZipCloseFileInZip(zipFile);
+  for (size_t offset{0}; offset < contents.size(); offset += WRITE_CHUNK_SIZE) {
+    auto const chunk = contents.subspan(offset, std::min(WRITE_CHUNK_SIZE, contents.size() - offset));
+    if (auto const result = zipWriteInFileInZip(zipFile, chunk.data(), static_cast<uint32_t>(chunk.size())); result != ZIP_OK) {
+      throw std::logic_error("unable to write entry to archive");
+    }
+  }
+}
+
+auto writeRawEntry(zipFile const zipFile, ZipEntry const &entry, std::span<std::byte const> const rawContents, uint32_t const alignment = 0) {
+  auto const method = static_cast<int>(entry.compressionMethod);
+  auto const level = entry.compressionMethod == MZ_COMPRESS_METHOD_STORE ? 0 : MZ_COMPRESS_LEVEL_DEFAULT;
+  auto const zip64 = entry.uncompressedSize >= ZIP64_THRESHOLD || entry.compressedSize >= ZIP64_THRESHOLD;
+  auto const extraField = getAlignmentExtraField(zipFile, entry.path, alignment);
+  auto const extraFieldSize = static_cast<uint16_t>(extraField.size());
+  if (auto const result = zipOpenNewFileInZip2_64(zipFile, entry.path.c_str(), nullptr, extraField.data(), extraFieldSize, extraField.data(), extraFieldSize,
+                                                  nullptr, method, level, 1, zip64);
+      result != ZIP_OK) {
+    throw std::logic_error("unable to add raw entry to archive");
+  }
+  auto const scopedZipCloseFileInZipRaw = ScopedZipCloseFileInZipRaw(zipFile, entry.uncompressedSize, entry.crc);
+  for (size_t offset{0}; offset < rawContents.size(); offset += WRITE_CHUNK_SIZE) {
+    auto const chunk = rawContents.subspan(offset, std::min(WRITE_CHUNK_SIZE, rawContents.size() - offset));
+    if (auto const result = zipWriteInFileInZip(zipFile, chunk.data(), static_cast<uint32_t>(chunk.size())); result != ZIP_OK) {
+      throw std::logic_error("unable to write raw entry to archive");
+    }
+  }
+}
+
+auto getCompression(ZipEntry const &entry) {
+  return entry.compressionMethod == MZ_COMPRESS_METHOD_STORE ? ZipCompression::Store : ZipCompression::Deflate;
+}
+
+struct CompressedEntry {
+  ZipEntry entry;
+  std::vector<std::byte> contents;
+};
+
+struct ScopedDeflate {
+
+  ScopedDeflate() {
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::logic_error("unable to initialize deflate");
+    }
+  }
+
+  ~ScopedDeflate() { deflateEnd(&stream); }
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedDeflate);
+
+  z_stream stream{};
+};
+
+//
+// Produces the raw (headerless) deflate stream minizip expects for raw
+// writes, so that entries can be compressed away from the zip handle.
+//
+auto deflateContents(std::span<std::byte const> const contents) {
+  auto deflate = ScopedDeflate();
+  auto compressed = std::vector<std::byte>(deflateBound(&deflate.stream, static_cast<uLong>(contents.size())));
+  deflate.stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+  size_t offset{0};
+  auto result = Z_OK;
+  while (result != Z_STREAM_END) {
+    auto const chunkSize = std::min(WRITE_CHUNK_SIZE, contents.size() - offset);
+    deflate.stream.next_in = const_cast<Bytef *>(reinterpret_cast<Bytef const *>(contents.data() + offset));
+    deflate.stream.avail_in = static_cast<uInt>(chunkSize);
+    offset += chunkSize;
+    auto const flush = offset == contents.size() ? Z_FINISH : Z_NO_FLUSH;
     do {
-      unz_file_info64 fileInfo = {};
-      char fileNameInZip[256] = {};
-      result = unzGetCurrentFileInfo64(openedZipFile.get(), &fileInfo, fileNameInZip, sizeof(fileNameInZip), nullptr, 0, nullptr, 0);
-      if (result == UNZ_OK) {
-        entries.push_back(std::make_pair(std::string(fileNameInZip), fileInfo));
+      auto const written = static_cast<size_t>(deflate.stream.total_out);
+      if (written == compressed.size()) {
+        compressed.resize(compressed.size() + WRITE_CHUNK_SIZE);
+        deflate.stream.next_out = reinterpret_cast<Bytef *>(compressed.data() + written);
+      }
+      deflate.stream.avail_out = static_cast<uInt>(std::min(WRITE_CHUNK_SIZE, compressed.size() - written));
+      result = ::deflate(&deflate.stream, flush);
+      if (result == Z_STREAM_ERROR) {
+        throw std::logic_error("unable to deflate contents");
       }
-      result = unzGoToNextFile(openedZipFile.get());
-    } while (UNZ_OK == result);
+    } while (deflate.stream.avail_out == 0 && result != Z_STREAM_END);
+    if (flush == Z_NO_FLUSH && deflate.stream.avail_in != 0) {
+      throw std::logic_error("unable to deflate contents");
+    }
+  }
+  compressed.resize(static_cast<size_t>(deflate.stream.total_out));
+  return compressed;
+}
+
+//
+// The entry of the result has no path, as the same contents may be written
+// under several.
+//
+auto compressEntry(std::span<std::byte const> const contents, ZipCompression const compression) {
+  auto compressed = CompressedEntry();
+  compressed.entry.uncompressedSize = contents.size();
+  compressed.entry.crc = utils::crc32::update(0, contents);
+  compressed.entry.compressionMethod = static_cast<uint16_t>(compression);
+  if (compression == ZipCompression::Store) {
+    compressed.contents.assign(contents.begin(), contents.end());
+  } else {
+    compressed.contents = deflateContents(contents);
   }
-  return entries;
+  compressed.entry.compressedSize = compressed.contents.size();
+  return compressed;
 }
 
+struct StringHash {
+  using is_transparent = void;
+
+  auto operator()(std::string_view const value) const noexcept { return std::hash<std::string_view>{}(value); }
+};
+
 } // namespace
 
+auto ai::getInflatedSize(ZipEntry const &entry) -> uint64_t {
+  if (entry.uncompressedSize > MAX_DEFLATE_OVERHEAD + std::min(entry.compressedSize, UINT64_MAX / MAX_DEFLATE_RATIO) * MAX_DEFLATE_RATIO) {
+    throw std::logic_error("entry claims an impossible uncompressed size");
+  }
+  return entry.uncompressedSize;
+}
+
+struct ZipArchiver::ZipIndex {
+
+  ZipIndex(std::shared_ptr<ZipReader const> zipReader, utils::ThreadPool *const threadPool) : reader(std::move(zipReader)), zipFile(reader.get()) {
+    TRACE_SPAN("ZipArchiver::index");
+    auto const openedZipFile = zipFile.get();
+    if (openedZipFile == nullptr) {
+      LOGW("ZipIndex, unable to open archive");
+      recover(threadPool);
+      return;
+    }
+    auto fileNameInZip = std::vector<char>(MAX_FILE_NAME_SIZE + 1);
+    if (auto result = unzGoToFirstFile(openedZipFile); result == UNZ_OK) {
+      do {
+        unz_file_info64 fileInfo = {};
+        result = unzGetCurrentFileInfo64(openedZipFile, &fileInfo, fileNameInZip.data(), static_cast<uint16_t>(fileNameInZip.size() - 1), nullptr, 0, nullptr, 0);
+        if (result == UNZ_OK) {
+          auto const fileNameSize = std::min(static_cast<size_t>(fileInfo.size_filename), MAX_FILE_NAME_SIZE);
+          auto entry = ZipEntry{std::string(fileNameInZip.data(), fileNameSize),
+                                unzGetOffset64(openedZipFile),
+                                static_cast<uint64_t>(fileInfo.disk_offset),
+                                static_cast<uint64_t>(fileInfo.compressed_size),
+                                static_cast<uint64_t>(fileInfo.uncompressed_size),
+                                static_cast<uint32_t>(fileInfo.crc),
+                                static_cast<uint16_t>(fileInfo.compression_method)};
+          entryIndices.insert_or_assign(entry.path, entries.size());
+          entries.push_back(std::move(entry));
+        }
+        result = unzGoToNextFile(openedZipFile);
+      } while (UNZ_OK == result);
+    }
+    static auto &centralDirectoryScans = utils::metrics::counter("zip.central_directory_scans");
+    static auto &entriesScanned = utils::metrics::counter("zip.entries_scanned");
+    centralDirectoryScans.add();
+    entriesScanned.add(entries.size());
+    LOGD("ZipIndex, entries [{}]", entries.size());
+    if (entries.empty()) {
+      recover(threadPool);
+    } else if (!hasLocalHeaders(*reader, entries)) {
+      LOGW("ZipIndex, central directory lists entries without a local header");
+      recover(threadPool);
+    }
+  }
+
+  //
+  // Rebuilds the index from local file headers when the central directory
+  // is gone, lists nothing or lists entries that are not there; the listed
+  // entries stay if none are found.  The archive is scanned on the pool of
+  // the call building the index, and on the calling thread for calls that
+  // take none, as those may come from a task of any pool.
+  //
+  auto recover(utils::ThreadPool *const threadPool) -> void {
+    if (reader == nullptr || reader->size() == 0) {
+      return;
+    }
+    auto inlinePool = utils::ThreadPool(0);
+    auto recoveredEntries = recoverZipEntries(*reader, threadPool != nullptr ? *threadPool : inlinePool);
+    if (recoveredEntries.empty()) {
+      return;
+    }
+    entries = std::move(recoveredEntries);
+    entryIndices.clear();
+    for (size_t i{0}; i < entries.size(); i++) {
+      entryIndices.insert_or_assign(entries[i].path, i);
+    }
+    recovered = true;
+    LOGW("ZipIndex, central directory unreadable; recovered entries [{}] from local headers", entries.size());
+  }
+
+  //
+  // Of records sharing a path, as appending an entry again leaves them, the
+  // last one is found; it supersedes the others.
+  //
+  auto find(std::string_view const pathInArchive) const -> ZipEntry const * {
+    if (auto const entry = entryIndices.find(pathInArchive); entry != entryIndices.cend()) {
+      return &entries[entry->second];
+    }
+    return nullptr;
+  }
+
+  struct ZipFileReturn {
+
+    auto operator()(ScopedUnzOpenFile const *const lent) const -> void { index->returnZipFile(lent); }
+
+    ZipIndex *index;
+  };
+
+  using ZipFileLease = std::unique_ptr<ScopedUnzOpenFile const, ZipFileReturn>;
+
+  //
+  // minizip handle for the calling thread until the lease goes away: a
+  // handle keeps the position of the entry it reads, so threads can't share
+  // one.  Handles come back to the index for the next reads rather than
+  // staying with threads, which may be short-lived.
+  //
+  auto leaseZipFile() -> ZipFileLease {
+    {
+      auto const lock = std::lock_guard(idleZipFilesMutex);
+      if (!idleZipFiles.empty()) {
+        auto idleZipFile = std::move(idleZipFiles.back());
+        idleZipFiles.pop_back();
+        return ZipFileLease(idleZipFile.release(), ZipFileReturn{this});
+      }
+    }
+    return ZipFileLease(new ScopedUnzOpenFile const(reader.get()), ZipFileReturn{this});
+  }
+
+  auto returnZipFile(ScopedUnzOpenFile const *const lent) -> void {
+    auto returned = std::unique_ptr<ScopedUnzOpenFile const>(lent);
+    auto const lock = std::lock_guard(idleZipFilesMutex);
+    if (idleZipFiles.size() < MAX_IDLE_ZIP_FILES) {
+      idleZipFiles.push_back(std::move(returned));
+    }
+  }
+
+  std::shared_ptr<ZipReader const> const reader;
+
+  //
+  // Handle the central directory is read through.
+  //
+  ScopedUnzOpenFile const zipFile;
+
+  std::mutex idleZipFilesMutex;
+
+  std::vector<std::unique_ptr<ScopedUnzOpenFile const>> idleZipFiles;
+
+  std::vector<ZipEntry> entries;
+
+  std::unordered_map<std::string, size_t, StringHash, std::equal_to<>> entryIndices;
+
+  bool recovered = false;
+};
+
+ZipArchiver::ZipArchiver(std::string_view zipPath) : zipPath_(zipPath) {}
+
+ZipArchiver::ZipArchiver(std::shared_ptr<ZipReader const> reader) : reader_(std::move(reader)) {
+  if (reader_ == nullptr) {
+    throw std::logic_error("reader is null");
+  }
+}
+
+ZipArchiver::~ZipArchiver() = default;
+
+auto ZipArchiver::index(utils::ThreadPool *const threadPool) const -> ZipIndex & {
+  auto const lock = std::lock_guard(indexMutex_);
+  if (index_ == nullptr) {
+    auto reader = reader_;
+    if (reader == nullptr && fs::exists(zipPath_)) {
+      reader = std::make_shared<FileZipReader>(zipPath_);
+    }
+    index_ = std::make_unique<ZipIndex>(std::move(reader), threadPool);
+  }
+  return *index_;
+}
+
+auto ZipArchiver::writablePath() const -> std::string const & {
+  if (reader_ != nullptr) {
+    throw std::logic_error("archive opened from a reader is read only");
+  }
+  return zipPath_;
+}
+
+auto ZipArchiver::invalidateIndex() const -> void {
+  auto const lock = std::lock_guard(indexMutex_);
+  index_.reset();
+}
+
 auto ZipArchiver::add(std::istream &source, std::string_view const pathInArchive) const -> void {
   LOGD("add, pathInArchive [{}]", pathInArchive);
-  auto const zipFile = openZipFile(zipPath_);
+  invalidateIndex();
+  auto const zipFile = openZipFile(writablePath());
   auto const pathInArchiveString = std::string(pathInArchive);
   if (auto result = zipOpenNewFileInZip_64(zipFile->get(), pathInArchiveString.c_str(), nullptr, nullptr, 0, nullptr, 0, nullptr, 0, 0, false);
       result == ZIP_OK) {
@@ -98,87 +902,562 @@ auto ZipArchiver::add(std::istream &source, std::string_view const pathInArchive
   }
 }
 
+auto ZipArchiver::add(std::span<std::byte const> const contents, std::string_view const pathInArchive, ZipCompression const compression) const
+    -> void {
+  LOGD("add, pathInArchive [{}], size [{}]", pathInArchive, contents.size());
+  invalidateIndex();
+  auto const zipFile = openZipFile(writablePath());
+  writeEntry(zipFile->get(), std::string(pathInArchive), contents, compression);
+}
+
+auto ZipArchiver::commit(ZipTransaction const &transaction) const -> void { commit(transaction, nullptr, std::nullopt); }
+
+auto ZipArchiver::commit(ZipTransaction const &transaction, utils::ThreadPool &threadPool) const -> void { commit(transaction, &threadPool, std::nullopt); }
+
+auto ZipArchiver::commit(ZipTransaction const &transaction, std::string_view const destinationPath, utils::ThreadPool &threadPool) const -> void {
+  auto error = std::error_code();
+  if (reader_ == nullptr && fs::equivalent(zipPath_, destinationPath, error)) {
+    commit(transaction, &threadPool, std::nullopt);
+    return;
+  }
+  commit(transaction, &threadPool, destinationPath);
+}
+
+auto ZipArchiver::commit(ZipTransaction const &transaction, std::string_view const destinationPath) const -> void {
+  auto error = std::error_code();
+  if (reader_ == nullptr && fs::equivalent(zipPath_, destinationPath, error)) {
+    commit(transaction, nullptr, std::nullopt);
+    return;
+  }
+  commit(transaction, nullptr, destinationPath);
+}
+
+auto ZipArchiver::commit(ZipTransaction const &transaction, utils::ThreadPool *const threadPool, std::optional<std::string_view> const destinationPath) const
+    -> void {
+  TRACE_SPAN("ZipArchiver::commit");
+  LOGD("commit, changes [{}], parallel [{}], copy [{}]", transaction.changes_.size(), threadPool != nullptr, destinationPath.has_value());
+  if (transaction.empty() && !transaction.alignment_ && !destinationPath) {
+    return;
+  }
+  auto const zipPath = destinationPath ? std::string(*destinationPath) : writablePath();
+  using Change = ZipTransaction::Change;
+  using Operation = ZipTransaction::Operation;
+
+  auto &zipIndex = index(threadPool);
+  auto changedPaths = std::unordered_set<std::string_view>();
+  auto replacements = std::unordered_map<std::string_view, Change const *>();
+  auto removals = std::unordered_set<std::string_view>();
+  auto additions = std::vector<Change const *>();
+  auto compressions = std::unordered_map<Change const *, ZipCompression>();
+  for (auto const &change : transaction.changes_) {
+    if (!changedPaths.insert(change.pathInArchive).second) {
+      throw std::logic_error("path is changed more than once in transaction");
+    }
+    auto const exists = zipIndex.find(change.pathInArchive) != nullptr;
+    switch (change.operation) {
+    case Operation::Add: {
+      if (exists) {
+        throw std::logic_error("path already exists in archive");
+      }
+      additions.push_back(&change);
+      compressions.emplace(&change, change.compression.value_or(ZipCompression::Deflate));
+      break;
+    }
+    case Operation::Replace: {
+      if (!exists) {
+        throw std::logic_error("path does not exist in archive");
+      }
+      replacements.emplace(change.pathInArchive, &change);
+      compressions.emplace(&change, change.compression.value_or(getCompression(*zipIndex.find(change.pathInArchive))));
+      break;
+    }
+    case Operation::Remove: {
+      if (!exists) {
+        throw std::logic_error("path does not exist in archive");
+      }
+      removals.insert(change.pathInArchive);
+      break;
+    }
+    }
+  }
+
+  //
+  // With a pool, contents are compressed up front on it; without one only
+  // contents shared by several entries are, inline, and the others are
+  // streamed through minizip.  Either way every buffer is compressed once
+  // per compression method, however many entries it is written to.
+  //
+  using CompressionKey = std::pair<std::vector<std::byte> const *, ZipCompression>;
+  auto contentUses = std::map<CompressionKey, size_t>();
+  for (auto const &[change, compression] : compressions) {
+    contentUses[CompressionKey(change->contents.get(), compression)]++;
+  }
+  auto inlinePool = utils::ThreadPool(0);
+  auto &compressionPool = threadPool != nullptr ? *threadPool : inlinePool;
+  auto compressedEntries = std::map<CompressionKey, std::shared_future<CompressedEntry>>();
+  for (auto const &[change, compression] : compressions) {
+    auto const key = CompressionKey(change->contents.get(), compression);
+    if ((threadPool == nullptr && contentUses.at(key) == 1) || compressedEntries.contains(key)) {
+      continue;
+    }
+    auto compressedEntry = compressionPool.submit([contents = change->contents, compression] { return compressEntry(*contents, compression); });
+    compressedEntries.emplace(key, compressedEntry.share());
+  }
+  auto const waitForCompressedEntries = [&compressedEntries] {
+    for (auto const &[key, compressedEntry] : compressedEntries) {
+      if (compressedEntry.valid()) {
+        compressedEntry.wait();
+      }
+    }
+  };
+  auto const &alignment = transaction.alignment_;
+  auto const writeChange = [&](zipFile const zipFile, Change const *const change) {
+    auto const compression = compressions.at(change);
+    auto const entryAlignment = getAlignment(alignment, change->pathInArchive, compression);
+    if (auto compressedEntry = compressedEntries.find(CompressionKey(change->contents.get(), compression)); compressedEntry != compressedEntries.end()) {
+      auto const &compressed = compressedEntry->second.get();
+      auto entry = compressed.entry;
+      entry.path = change->pathInArchive;
+      writeRawEntry(zipFile, entry, compressed.contents, entryAlignment);
+    } else {
+      writeEntry(zipFile, change->pathInArchive, *change->contents, compression, entryAlignment);
+    }
+  };
+
+  if (destinationPath && zipIndex.reader == nullptr) {
+    throw std::logic_error("unable to read archive");
+  }
+  if (!destinationPath && ((replacements.empty() && removals.empty() && !alignment) || zipIndex.reader == nullptr)) {
+    invalidateIndex();
+    try {
+      auto const zipFile = openZipFile(zipPath);
+      for (auto const addition : additions) {
+        writeChange(zipFile->get(), addition);
+      }
+    } catch (...) {
+      waitForCompressedEntries();
+      throw;
+    }
+    return;
+  }
+
+  auto const temporaryPath = zipPath + ".tmp";
+  try {
+    auto const temporaryZipFile = ScopedZipOpen(temporaryPath.c_str(), APPEND_STATUS_CREATE);
+    if (temporaryZipFile.get() == nullptr) {
+      throw std::logic_error("unable to create temporary zip file");
+    }
+    auto buffer = std::vector<std::byte>();
+    for (auto const &entry : zipIndex.entries) {
+      if (removals.contains(entry.path) || zipIndex.find(entry.path) != &entry) {
+        continue;
+      }
+      if (auto const replacement = replacements.find(entry.path); replacement != replacements.cend()) {
+        writeChange(temporaryZipFile.get(), replacement->second);
+        continue;
+      }
+      auto const entryData = readEntryData(*zipIndex.reader, entry, buffer);
+      writeRawEntry(temporaryZipFile.get(), entry, entryData, getAlignment(alignment, entry.path, getCompression(entry)));
+    }
+    for (auto const addition : additions) {
+      writeChange(temporaryZipFile.get(), addition);
+    }
+  } catch (...) {
+    waitForCompressedEntries();
+    fs::remove(temporaryPath);
+    throw;
+  }
+  if (alignment) {
+    try {
+      stripCentralAlignmentFields(temporaryPath);
+    } catch (...) {
+      fs::remove(temporaryPath);
+      throw;
+    }
+  }
+  if (!destinationPath) {
+    invalidateIndex();
+  }
+  fs::rename(temporaryPath, zipPath);
+}
+
+auto ZipArchiver::entries() const -> std::vector<ZipEntry> { return index().entries; }
+
+auto ZipArchiver::isRecovered() const -> bool { return index().recovered; }
+
 auto ZipArchiver::files() const -> std::vector<std::string> {
   auto files = std::vector<std::string>();
-  for (auto const &entry : getAllEntriesInZipFile(zipPath_)) {
-    files.push_back(entry.first);
+  for (auto const &entry : index().entries) {
+    files.push_back(entry.path);
   }
   return files;
 }
 
 auto ZipArchiver::contains(std::string_view pathInArchive) const -> bool {
   LOGD("contains, pathInArchive [{}]", pathInArchive);
-  if (auto const zipFile = ScopedUnzOpenFile(zipPath_.c_str()); zipFile.get() != nullptr) {
-    auto const pathInArchiveString = std::string(pathInArchive);
-    return unzLocateFile(zipFile.get(), pathInArchiveString.c_str(), nullptr) == UNZ_OK;
-  } else {
-    return false;
-  }
+  return index().find(pathInArchive) != nullptr;
+}
+
+auto ZipArchiver::entry(std::string_view pathInArchive) const -> std::optional<ZipEntry> {
+  auto const entry = index().find(pathInArchive);
+  return entry != nullptr ? std::optional<ZipEntry>(*entry) : std::nullopt;
 }
 
 auto ZipArchiver::extractAll(std::string_view destinationDirectory) const -> void {
-  LOGD("extractAll, destinationDirectory [{}]", destinationDirectory);
-  namespace fs = std::filesystem;
-  if (!fs::exists(destinationDirectory)) {
-    LOGD("extractAll, destinationDirectory does not exist; creating directory");
-    fs::create_directory(destinationDirectory);
+  auto &threadPool = utils::ThreadPool::shared();
+  extractAll(destinationDirectory, threadPool);
+}
+
+auto ZipArchiver::extractAll(std::string_view destinationDirectory, utils::ThreadPool &threadPool) const -> void {
+  TRACE_SPAN("ZipArchiver::extractAll");
+  LOGD("extractAll, destinationDirectory [{}] threads [{}]", destinationDirectory, threadPool.threadCount());
+  prepareDestinationDirectory(destinationDirectory);
+  auto &zipIndex = index(&threadPool);
+  auto const &entries = zipIndex.entries;
+  auto const destinationPath = fs::path(std::string(destinationDirectory)).lexically_normal();
+  auto nextEntry = std::atomic_size_t(0);
+  auto pass = SequentialPass(zipIndex.reader.get());
+
+  //
+  // Small entries are inflated into a recycled buffer and written in
+  // batches; large ones are streamed to their file.
+  //
+  auto const extractEntries = [&]() {
+    auto const zipFile = ScopedUnzOpenFile(zipIndex.reader.get());
+    auto output = utils::FileOutput();
+    auto parentDirectories = ParentDirectories();
+    auto buffer = std::vector<std::byte>();
+    for (auto i = nextEntry++; i < entries.size(); i = nextEntry++) {
+      auto const &entry = entries[i];
+      auto const extractPath = getExtractPath(destinationPath, entry.path);
+      if (!extractPath) {
+        continue;
+      }
+      if (entry.path.ends_with('/')) {
+        fs::create_directories(*extractPath);
+        continue;
+      }
+      pass.claim(entry);
+      parentDirectories.create(*extractPath);
+      if (isStoredEntry(entry)) {
+        output.write(extractPath->string(), readEntryData(*zipIndex.reader, entry, buffer));
+      } else if (entry.uncompressedSize <= BATCHED_EXTRACT_SIZE) {
+        buffer.clear();
+        inflateInChunks(*zipIndex.reader, zipFile.get(), entry, [&buffer](auto const chunk) { buffer.insert(buffer.end(), chunk.begin(), chunk.end()); });
+        output.write(extractPath->string(), buffer);
+      } else {
+        auto writer = utils::FileWriter(extractPath->string(), entry.uncompressedSize);
+        inflateInChunks(*zipIndex.reader, zipFile.get(), entry, [&writer](auto const chunk) { writer.write(chunk); });
+        writer.close();
+      }
+    }
+    output.flush();
+  };
+
+  auto const workerCount = std::max<size_t>(threadPool.threadCount(), 1);
+  auto workers = std::vector<std::future<void>>();
+  for (size_t i{0}; i < workerCount; i++) {
+    workers.push_back(threadPool.submit(extractEntries));
   }
-  auto const isPathValid = fs::is_directory(destinationDirectory);
-  if (!isPathValid) {
-    throw std::logic_error("destinationDirectory must be a directory or must not exist");
+
+  //
+  // Every worker is done with the state of this frame before a failure of
+  // one is rethrown.
+  //
+  for (auto &worker : workers) {
+    worker.wait();
+  }
+  for (auto &worker : workers) {
+    worker.get();
+  }
+}
+
+auto ZipArchiver::extractAll(ZipEntryFilter const &filter, ZipEntryVisitor const &visitor, utils::ThreadPool &threadPool) const -> void {
+  TRACE_SPAN("ZipArchiver::extractAll");
+  LOGD("extractAll, to visitor threads [{}]", threadPool.threadCount());
+  auto &zipIndex = index(&threadPool);
+  auto const &entries = zipIndex.entries;
+  auto nextEntry = std::atomic_size_t(0);
+  auto pass = SequentialPass(zipIndex.reader.get());
+
+  auto const extractEntries = [&](size_t const worker) {
+    auto const zipFile = ScopedUnzOpenFile(zipIndex.reader.get());
+    auto buffer = std::vector<std::byte>();
+    auto contents = std::vector<std::byte>();
+    for (auto i = nextEntry++; i < entries.size(); i = nextEntry++) {
+      auto const &entry = entries[i];
+      if (entry.path.ends_with('/') || !filter(entry)) {
+        continue;
+      }
+      pass.claim(entry);
+      if (isStoredEntry(entry)) {
+        visitor(worker, entry, readEntryData(*zipIndex.reader, entry, buffer));
+      } else if (isDeflatedEntry(entry)) {
+        auto const compressed = readEntryData(*zipIndex.reader, entry, buffer);
+        resizeForInflate(entry, contents);
+        Inflater::forThread().inflate(compressed, contents);
+        visitor(worker, entry, contents);
+      } else {
+        contents = readEntry(zipFile.get(), entry);
+        visitor(worker, entry, contents);
+      }
+    }
+  };
+
+  auto const workerCount = std::max<size_t>(threadPool.threadCount(), 1);
+  auto workers = std::vector<std::future<void>>();
+  for (size_t i{0}; i < workerCount; i++) {
+    workers.push_back(threadPool.submit([&extractEntries, i] { extractEntries(i); }));
+  }
+  for (auto &worker : workers) {
+    worker.wait();
+  }
+  for (auto &worker : workers) {
+    worker.get();
+  }
+}
+
+auto ZipArchiver::streamAll(ZipEntryFilter const &filter, ZipEntryStreamVisitor const &visitor, utils::ThreadPool &threadPool) const -> void {
+  TRACE_SPAN("ZipArchiver::streamAll");
+  LOGD("streamAll, threads [{}]", threadPool.threadCount());
+  auto &zipIndex = index(&threadPool);
+  auto const &entries = zipIndex.entries;
+  auto nextEntry = std::atomic_size_t(0);
+  auto pass = SequentialPass(zipIndex.reader.get());
+
+  auto const streamEntries = [&](size_t const worker) {
+    auto const zipFile = ScopedUnzOpenFile(zipIndex.reader.get());
+    auto buffer = std::vector<std::byte>();
+    for (auto i = nextEntry++; i < entries.size(); i = nextEntry++) {
+      auto const &entry = entries[i];
+      if (entry.path.ends_with('/') || !filter(entry)) {
+        continue;
+      }
+      pass.claim(entry);
+      visitor(worker, entry, [&](ZipEntrySink const &sink) {
+        if (isStoredEntry(entry)) {
+          viewInChunks(readEntryData(*zipIndex.reader, entry, buffer), sink);
+        } else {
+          inflateInChunks(*zipIndex.reader, zipFile.get(), entry, sink);
+        }
+      });
+    }
+  };
+
+  auto const workerCount = std::max<size_t>(threadPool.threadCount(), 1);
+  auto workers = std::vector<std::future<void>>();
+  for (size_t i{0}; i < workerCount; i++) {
+    workers.push_back(threadPool.submit([&streamEntries, i] { streamEntries(i); }));
+  }
+  for (auto &worker : workers) {
+    worker.wait();
+  }
+  for (auto &worker : workers) {
+    worker.get();
+  }
+}
+
+auto ZipArchiver::verify() const -> std::vector<ZipEntryVerification> {
+  auto &threadPool = utils::ThreadPool::shared();
+  return verify(threadPool);
+}
+
+auto ZipArchiver::verify(utils::ThreadPool &threadPool) const -> std::vector<ZipEntryVerification> {
+  TRACE_SPAN("ZipArchiver::verify");
+  LOGD("verify, threads [{}]", threadPool.threadCount());
+  auto &zipIndex = index(&threadPool);
+  auto const &entries = zipIndex.entries;
+  auto verifications = std::vector<ZipEntryVerification>(entries.size());
+  auto nextEntry = std::atomic_size_t(0);
+  auto pass = SequentialPass(zipIndex.reader.get());
+
+  auto const verifyEntries = [&]() {
+    auto const zipFile = ScopedUnzOpenFile(zipIndex.reader.get());
+    auto buffer = std::vector<std::byte>();
+    for (auto i = nextEntry++; i < entries.size(); i = nextEntry++) {
+      auto const &entry = entries[i];
+      auto &verification = verifications[i];
+      verification.path = entry.path;
+      verification.expectedCrc = entry.crc;
+      pass.claim(entry);
+      try {
+        auto crc = uint32_t{0};
+        auto size = uint64_t{0};
+        auto const updateCrc = [&crc, &size](std::span<std::byte const> const chunk) {
+          crc = utils::crc32::update(crc, chunk);
+          size += chunk.size();
+        };
+        if (isStoredEntry(entry)) {
+          updateCrc(readEntryData(*zipIndex.reader, entry, buffer));
+        } else {
+          inflateInChunks(*zipIndex.reader, zipFile.get(), entry, updateCrc);
+        }
+        verification.actualCrc = crc;
+        verification.passed = crc == entry.crc && size == entry.uncompressedSize;
+      } catch (std::exception const &exception) {
+        LOGW("verify, unable to read [{}]: {}", entry.path, exception.what());
+        verification.passed = false;
+      }
+    }
+  };
+
+  auto const workerCount = std::max<size_t>(threadPool.threadCount(), 1);
+  auto workers = std::vector<std::future<void>>();
+  for (size_t i{0}; i < workerCount; i++) {
+    workers.push_back(threadPool.submit(verifyEntries));
+  }
+  for (auto &worker : workers) {
+    worker.wait();
   }
-  auto const entries = getAllEntriesInZipFile(zipPath_);
-  for (auto const &entry : entries) {
-    extract(entry.first, destinationDirectory);
+  for (auto &worker : workers) {
+    worker.get();
   }
+  return verifications;
 }
 
 auto ZipArchiver::extract(std::string_view pathInArchive, std::string_view destinationDirectory) const -> void {
   LOGD("extract, pathInArchive [{}] destinationDirectory [{}]", pathInArchive, destinationDirectory);
-  namespace fs = std::filesystem;
-  if (!fs::exists(destinationDirectory)) {
-    LOGD("extractAll, destinationDirectory does not exist; creating directory");
-    fs::create_directory(destinationDirectory);
-  }
-  auto const isPathValid = fs::is_directory(destinationDirectory);
-  if (!isPathValid) {
-    throw std::logic_error("path must be a directory or must not exist");
+  prepareDestinationDirectory(destinationDirectory);
+  auto const destinationPath = fs::path(std::string(destinationDirectory)).lexically_normal();
+  if (auto const extractPath = getExtractPath(destinationPath, pathInArchive); extractPath) {
+    auto const entry = index().find(pathInArchive);
+    if (entry == nullptr) {
+      throw std::logic_error("path does not exist in archive");
+    }
+    fs::create_directories(extractPath->parent_path());
+    auto writer = utils::FileWriter(extractPath->string(), entry->uncompressedSize);
+    extract(pathInArchive, [&writer](auto const chunk) { writer.write(chunk); });
+    writer.close();
+  } else {
+    throw std::logic_error("path in archive is outside of destination directory");
   }
-  auto const fileContents = extract(pathInArchive);
-  auto const destinationDirectoryString = std::string(destinationDirectory);
-  auto const fullPathToExtract = fs::path(destinationDirectoryString) / std::string(pathInArchive);
-  auto outputFile = std::ofstream(fullPathToExtract.string(), std::fstream::binary);
-  outputFile.write(reinterpret_cast<char const *>(fileContents.data()), sizeof(std::byte) * static_cast<uint32_t>(fileContents.size()));
-  outputFile.close();
 }
 
 auto ZipArchiver::extract(std::string_view pathInArchive) const -> std::vector<std::byte> {
+  auto contents = std::vector<std::byte>();
+  extract(pathInArchive, contents);
+  return contents;
+}
+
+auto ZipArchiver::extract(std::string_view pathInArchive, std::vector<std::byte> &contents) const -> void {
+  TRACE_SPAN("ZipArchiver::extract");
   LOGD("extract, pathInArchive [{}]", pathInArchive);
-  auto const entries = getAllEntriesInZipFile(zipPath_);
-  auto pathInZip = std::find_if(entries.cbegin(), entries.cend(),
-                                [&pathInArchive = std::as_const(pathInArchive)](auto const &entry) { return entry.first == pathInArchive; });
-  if (pathInZip == entries.cend()) {
+  auto &zipIndex = index();
+  auto const entry = zipIndex.find(pathInArchive);
+  if (entry == nullptr) {
     throw std::logic_error("path does not exist in archive");
   }
-  if (auto const zipFile = ScopedUnzOpenFile(zipPath_.c_str()); zipFile.get() == nullptr) {
-    throw std::logic_error("archive does not exist");
-  } else {
-    if (auto const result = unzLocateFile(zipFile.get(), pathInZip->first.c_str(), nullptr); result != UNZ_OK) {
-      throw std::logic_error("path does not exist in archive");
-    }
-    unz_file_info zipFileInfo;
-    if (auto const result = unzGetCurrentFileInfo(zipFile.get(), &zipFileInfo, nullptr, 0, nullptr, 0, nullptr, 0); result != UNZ_OK) {
-      throw std::logic_error("unable to get file info in archive");
-    }
-    auto const openedZipFile = ScopedUnzOpenCurrentFile(zipFile.get());
-    if (auto result = openedZipFile.result(); result != MZ_OK) {
-      throw std::logic_error("unable to open zip entry in archive");
+  if (isStoredEntry(*entry)) {
+    if (auto const entryData = readEntryData(*zipIndex.reader, *entry, contents); entryData.data() != contents.data()) {
+      contents.assign(entryData.begin(), entryData.end());
     }
-    auto contents = std::vector<std::byte>(zipFileInfo.uncompressed_size);
-    auto const contentsSize = static_cast<uint32_t>(contents.size());
-    if (auto const bytesRead = unzReadCurrentFile(zipFile.get(), &contents[0], contentsSize); static_cast<uint32_t>(bytesRead) != contentsSize) {
-      throw std::logic_error("unable to read full file in archive");
+  } else if (isDeflatedEntry(*entry)) {
+    auto const scratchBuffer = ScratchBuffer();
+    auto const compressed = readEntryData(*zipIndex.reader, *entry, scratchBuffer.buffer);
+    resizeForInflate(*entry, contents);
+    Inflater::forThread().inflate(compressed, contents);
+  } else {
+    auto const zipFile = zipIndex.leaseZipFile();
+    contents = readEntry(zipFile->get(), *entry);
+  }
+}
+
+auto ZipArchiver::extract(std::string_view pathInArchive, ZipEntrySink const &sink) const -> void {
+  TRACE_SPAN("ZipArchiver::extract");
+  LOGD("extract, pathInArchive [{}] to sink", pathInArchive);
+  auto &zipIndex = index();
+  auto const entry = zipIndex.find(pathInArchive);
+  if (entry == nullptr) {
+    throw std::logic_error("path does not exist in archive");
+  }
+  if (isStoredEntry(*entry)) {
+    auto buffer = std::vector<std::byte>();
+    viewInChunks(readEntryData(*zipIndex.reader, *entry, buffer), sink);
+  } else {
+    auto const zipFile = zipIndex.leaseZipFile();
+    inflateInChunks(*zipIndex.reader, zipFile->get(), *entry, sink);
+  }
+}
+
+auto ZipArchiver::extract(std::string_view pathInArchive, std::ostream &destination) const -> void {
+  extract(pathInArchive, [&destination](auto const chunk) { writeToStream(destination, chunk); });
+}
+
+auto ZipArchiver::peek(ZipEntry const &entry, std::span<std::byte> const buffer) const -> size_t {
+  auto &zipIndex = index();
+  auto scratchBuffer = ScratchBuffer();
+  if (isStoredEntry(entry)) {
+    auto const entryData = readEntryData(*zipIndex.reader, entry, scratchBuffer.buffer, buffer.size());
+    std::copy(entryData.begin(), entryData.end(), buffer.begin());
+    return entryData.size();
+  }
+  if (!isDeflatedEntry(entry)) {
+    throw std::logic_error("unsupported compression method");
+  }
+  auto const entryData = readEntryData(*zipIndex.reader, entry, scratchBuffer.buffer, 2 * static_cast<uint64_t>(buffer.size()) + PEEK_COMPRESSED_OVERHEAD);
+  return Inflater::forThread().inflatePrefix(entryData, buffer.first(std::min<uint64_t>(buffer.size(), entry.uncompressedSize)));
+}
+
+auto ZipArchiver::extractPrefix(std::string_view pathInArchive, size_t const size) const -> std::vector<std::byte> {
+  auto const entry = index().find(pathInArchive);
+  if (entry == nullptr) {
+    throw std::logic_error("path does not exist in archive");
+  }
+  auto contents = std::vector<std::byte>(std::min<uint64_t>(size, entry->uncompressedSize));
+  contents.resize(peek(*entry, contents));
+  return contents;
+}
+
+auto ZipArchiver::peekAll(ZipEntryFilter const &filter, size_t const size, ZipEntryVisitor const &visitor, utils::ThreadPool &threadPool) const -> void {
+  TRACE_SPAN("ZipArchiver::peekAll");
+  LOGD("peekAll, size [{}] threads [{}]", size, threadPool.threadCount());
+  auto const &entries = index().entries;
+  auto nextEntry = std::atomic_size_t(0);
+
+  //
+  // No SequentialPass: only the start of every entry is read, so prefetching
+  // the data ahead of the workers would mostly fetch what is skipped.
+  //
+  auto const peekEntries = [&](size_t const worker) {
+    auto prefix = std::vector<std::byte>(size);
+    for (auto i = nextEntry++; i < entries.size(); i = nextEntry++) {
+      auto const &entry = entries[i];
+      if (entry.path.ends_with('/') || !filter(entry)) {
+        continue;
+      }
+      visitor(worker, entry, std::span<std::byte const>(prefix).first(peek(entry, prefix)));
     }
-    return contents;
+  };
+
+  auto const workerCount = std::max<size_t>(threadPool.threadCount(), 1);
+  auto workers = std::vector<std::future<void>>();
+  for (size_t i{0}; i < workerCount; i++) {
+    workers.push_back(threadPool.submit([&peekEntries, i] { peekEntries(i); }));
+  }
+  for (auto &worker : workers) {
+    worker.wait();
+  }
+  for (auto &worker : workers) {
+    worker.get();
+  }
+}
+
+auto ZipArchiver::advise(utils::AccessAdvice const advice) const -> void {
+  if (auto const &reader = index().reader; reader != nullptr) {
+    reader->advise(advice, 0, 0);
+  }
+}
+
+auto ZipArchiver::view(std::string_view pathInArchive) const -> std::optional<std::span<std::byte const>> {
+  LOGD("view, pathInArchive [{}]", pathInArchive);
+  auto &zipIndex = index();
+  auto const entry = zipIndex.find(pathInArchive);
+  if (entry == nullptr) {
+    throw std::logic_error("path does not exist in archive");
+  }
+  auto const archive = zipIndex.reader->view();
+  if (!isStoredEntry(*entry) || !archive) {
+    return std::nullopt;
   }
+  return getEntryData(*archive, *entry);
 }
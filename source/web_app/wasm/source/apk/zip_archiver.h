@@ -24,29 +24,345 @@
 #ifndef ANDROID_INTROSPECTION_APK_ZIP_ARCHIVER_H_
 #define ANDROID_INTROSPECTION_APK_ZIP_ARCHIVER_H_
 
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 
 namespace ai {
 
+namespace utils {
+class ThreadPool;
+
+enum class AccessAdvice : uint8_t;
+} // namespace utils
+
+class ZipReader;
+
+struct ZipEntry {
+
+  std::string path;
+
+  uint64_t centralDirectoryOffset;
+
+  uint64_t localHeaderOffset;
+
+  uint64_t compressedSize;
+
+  uint64_t uncompressedSize;
+
+  uint32_t crc;
+
+  uint16_t compressionMethod;
+};
+
+//
+// Uncompressed size of the entry, for sizing a buffer to inflate it into.
+// The size comes from the central directory, so it is checked against what
+// the compressed size can hold first, throwing std::logic_error if it is
+// more: a few corrupt bytes must not allocate gigabytes.
+//
+auto getInflatedSize(ZipEntry const &entry) -> uint64_t;
+
+struct ZipEntryVerification {
+
+  std::string path;
+
+  uint32_t expectedCrc;
+
+  uint32_t actualCrc;
+
+  bool passed;
+};
+
+enum class ZipCompression : uint16_t {
+
+  Store = 0,
+
+  Deflate = 8,
+};
+
+//
+// zipalign style alignment of the data of stored entries, in bytes.  Shared
+// libraries get their own (page) alignment so that the platform can mmap
+// them straight out of the APK.
+//
+struct ZipAlignment {
+
+  uint32_t storedEntries = 4;
+
+  uint32_t sharedLibraries = 4096;
+};
+
+//
+// Queue of changes applied to an archive by ZipArchiver::commit() in a
+// single pass with a single central directory write.
+//
+class ZipTransaction final {
+public:
+  auto add(std::string_view pathInArchive, std::vector<std::byte> contents, ZipCompression compression = ZipCompression::Deflate) -> ZipTransaction &;
+
+  //
+  // Same as above with contents other entries of the transaction may share,
+  // e.g. one library for several ABIs.  Shared contents are compressed once
+  // for all the entries using them.
+  //
+  auto add(std::string_view pathInArchive, std::shared_ptr<std::vector<std::byte> const> contents, ZipCompression compression = ZipCompression::Deflate)
+      -> ZipTransaction &;
+
+  //
+  // Replaces the contents of an existing entry, keeping its compression
+  // method unless another one is given.
+  //
+  auto replace(std::string_view pathInArchive, std::vector<std::byte> contents, std::optional<ZipCompression> compression = std::nullopt) -> ZipTransaction &;
+
+  auto remove(std::string_view pathInArchive) -> ZipTransaction &;
+
+  //
+  // Aligns every stored entry of the committed archive, which makes the
+  // commit rewrite the whole archive even if it only adds entries.
+  //
+  auto align(ZipAlignment alignment) -> ZipTransaction &;
+
+  auto empty() const -> bool;
+
+private:
+  friend class ZipArchiver;
+
+  enum class Operation { Add, Replace, Remove };
+
+  struct Change {
+
+    Operation operation;
+
+    std::string pathInArchive;
+
+    std::shared_ptr<std::vector<std::byte> const> contents;
+
+    std::optional<ZipCompression> compression;
+  };
+
+  std::vector<Change> changes_;
+
+  std::optional<ZipAlignment> alignment_;
+};
+
+//
+// Receives the contents of an entry one chunk at a time.  Chunks are only
+// valid for the duration of the call.
+//
+using ZipEntrySink = std::function<void(std::span<std::byte const>)>;
+
+using ZipEntryFilter = std::function<bool(ZipEntry const &)>;
+
+//
+// Called with the index of the worker, so per worker state can be kept in a
+// plain vector, the entry and its whole contents.
+//
+using ZipEntryVisitor = std::function<void(size_t, ZipEntry const &, std::span<std::byte const>)>;
+
+//
+// Streams the contents of an entry through the sink it is called with.
+//
+using ZipEntryStream = std::function<void(ZipEntrySink const &)>;
+
+//
+// Same as ZipEntryVisitor, but with a stream of the contents instead of the
+// whole contents.
+//
+using ZipEntryStreamVisitor = std::function<void(size_t, ZipEntry const &, ZipEntryStream const &)>;
+
+//
+// Reads may run on any number of threads at once; writes must not overlap
+// any other call.
+//
 class ZipArchiver final {
   std::string const zipPath_;
 
+  std::shared_ptr<ZipReader const> const reader_;
+
+  //
+  // Central directory of the archive, built once on first access and
+  // kept together with a read handle per thread.  Dropped whenever the
+  // archive is written to.  An archive recovered from its local headers is
+  // scanned on the pool of the call that builds the index, if it has one.
+  //
+  struct ZipIndex;
+
+  mutable std::mutex indexMutex_;
+
+  mutable std::unique_ptr<ZipIndex> index_;
+
+  auto index(utils::ThreadPool *threadPool = nullptr) const -> ZipIndex &;
+
+  auto invalidateIndex() const -> void;
+
+  auto writablePath() const -> std::string const &;
+
+  auto commit(ZipTransaction const &transaction, utils::ThreadPool *threadPool, std::optional<std::string_view> destinationPath) const -> void;
+
 public:
-  explicit ZipArchiver(std::string_view zipPath) : zipPath_(zipPath) {}
+  explicit ZipArchiver(std::string_view zipPath);
+
+  //
+  // Opens an archive read only through a reader, e.g. an in-memory buffer
+  // or ranges fetched from a browser Blob, without a copy on disk.
+  //
+  explicit ZipArchiver(std::shared_ptr<ZipReader const> reader);
+
+  ~ZipArchiver();
 
   auto add(std::istream &source, std::string_view pathInArchive) const -> void;
 
+  //
+  // Adds an entry straight from memory, without staging it in a file first.
+  //
+  auto add(std::span<std::byte const> contents, std::string_view pathInArchive, ZipCompression compression = ZipCompression::Deflate) const -> void;
+
+  //
+  // Metadata of every entry, in central directory order.  Only the central
+  // directory is read; entry data is never touched.
+  //
+  auto entries() const -> std::vector<ZipEntry>;
+
+  //
+  // Whether the central directory could not be read and the entries were
+  // recovered from local file headers instead, as for archives a packer
+  // mangled.  Recovered entries have no central directory offset, and only
+  // stored and deflated ones are found.
+  //
+  auto isRecovered() const -> bool;
+
   auto files() const -> std::vector<std::string>;
 
   auto contains(std::string_view pathInArchive) const -> bool;
 
+  //
+  // Metadata of the entry at the path, if there is one, from the central
+  // directory alone.
+  //
+  auto entry(std::string_view pathInArchive) const -> std::optional<ZipEntry>;
+
   auto extractAll(std::string_view destinationDirectory) const -> void;
 
+  //
+  // Extracts every entry using the workers of the given pool.  Each worker
+  // reads through its own archive handle.
+  //
+  auto extractAll(std::string_view destinationDirectory, utils::ThreadPool &threadPool) const -> void;
+
+  //
+  // Hands the contents of every file entry accepted by filter to visitor, on
+  // the workers of the pool.  Every worker reads through its own archive
+  // handle into its own recycled buffer, so contents are only valid during
+  // the call.  Workers are numbered from 0 to the thread count, exclusive,
+  // or 0 alone for a pool without threads.
+  //
+  auto extractAll(ZipEntryFilter const &filter, ZipEntryVisitor const &visitor, utils::ThreadPool &threadPool) const -> void;
+
+  //
+  // Same as above, but contents are streamed in chunks, so that entries are
+  // never inflated whole.
+  //
+  auto streamAll(ZipEntryFilter const &filter, ZipEntryStreamVisitor const &visitor, utils::ThreadPool &threadPool) const -> void;
+
   auto extract(std::string_view pathInArchive, std::string_view destinationDirectory) const -> void;
 
   auto extract(std::string_view pathInArchive) const -> std::vector<std::byte>;
+
+  //
+  // Same as above, but reuses the capacity of contents, so bulk extracts
+  // can recycle one buffer instead of allocating for every entry.
+  //
+  auto extract(std::string_view pathInArchive, std::vector<std::byte> &contents) const -> void;
+
+  //
+  // Streams an entry through the sink in fixed size chunks without holding
+  // the whole uncompressed entry in memory.
+  //
+  auto extract(std::string_view pathInArchive, ZipEntrySink const &sink) const -> void;
+
+  auto extract(std::string_view pathInArchive, std::ostream &destination) const -> void;
+
+  //
+  // Reads the first bytes of an entry into buffer and returns how many were
+  // read, fewer only for a shorter entry or a pathological deflate stream.
+  // Only the local header and the start of the data are read, and inflating
+  // stops once buffer is full.
+  //
+  auto peek(ZipEntry const &entry, std::span<std::byte> buffer) const -> size_t;
+
+  //
+  // Same as above by path: the first size bytes of the entry, or all of it
+  // if it is shorter, e.g. for a header or magic bytes.
+  //
+  auto extractPrefix(std::string_view pathInArchive, size_t size) const -> std::vector<std::byte>;
+
+  //
+  // Same as above for every file entry accepted by filter, on the workers of
+  // the pool as extractAll() does: visitor gets at most size bytes of each,
+  // in a buffer of the worker only valid during the call.
+  //
+  auto peekAll(ZipEntryFilter const &filter, size_t size, ZipEntryVisitor const &visitor, utils::ThreadPool &threadPool) const -> void;
+
+  //
+  // Tells the reader how the whole archive is about to be read, e.g. that
+  // its pages can be dropped once a hash went through them.  Bulk passes
+  // over the entries give their own advice.
+  //
+  auto advise(utils::AccessAdvice advice) const -> void;
+
+  //
+  // Applies all queued changes.  Pure additions are appended to the archive;
+  // replacements and removals rewrite it into a temporary file that then
+  // takes the place of the original.  Untouched entries are copied over
+  // as raw compressed bytes, without being inflated and deflated again,
+  // and records superseded by a later one of the same path are dropped.
+  //
+  auto commit(ZipTransaction const &transaction) const -> void;
+
+  //
+  // Checks the CRC-32 of every entry against the central directory, spread
+  // over the thread pool.  Entries that cannot be read fail verification.
+  //
+  auto verify() const -> std::vector<ZipEntryVerification>;
+
+  auto verify(utils::ThreadPool &threadPool) const -> std::vector<ZipEntryVerification>;
+
+  //
+  // Same as above, but added and replaced entries are compressed in memory
+  // on the thread pool first, and then written in order.
+  //
+  auto commit(ZipTransaction const &transaction, utils::ThreadPool &threadPool) const -> void;
+
+  //
+  // Applies all queued changes to a copy of the archive written to
+  // destinationPath, leaving this one untouched; archives opened from a
+  // reader can be committed this way too.  Input is streamed to output in a
+  // single pass, unchanged entries as raw compressed bytes through one
+  // recycled buffer.
+  //
+  auto commit(ZipTransaction const &transaction, std::string_view destinationPath) const -> void;
+
+  //
+  // Same as above, but added and replaced entries are compressed on the
+  // thread pool while untouched ones are copied.
+  //
+  auto commit(ZipTransaction const &transaction, std::string_view destinationPath, utils::ThreadPool &threadPool) const -> void;
+
+  //
+  // Returns the bytes of a stored (uncompressed) entry directly from a
+  // memory mapping of the archive, or std::nullopt if the entry is
+  // compressed or the reader is not in memory.  The span is valid until the
+  // archive is written to or the archiver is destroyed.
+  //
+  auto view(std::string_view pathInArchive) const -> std::optional<std::span<std::byte const>>;
 };
 
 } // namespace ai
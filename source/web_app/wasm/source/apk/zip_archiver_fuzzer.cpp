@@ -0,0 +1,57 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "utils/thread_pool.h"
+#include "zip_archiver.h"
+#include "zip_reader.h"
+
+//
+// libFuzzer target for the archive reader.  Every input is opened from
+// memory, its central directory listed and every entry streamed and
+// verified, so that both the index and the entry data paths are covered.
+// Inputs only have to fail cleanly: anything but std::exception, or a run
+// past the time and memory limits of the run target, is a finding.
+//
+extern "C" auto LLVMFuzzerTestOneInput(uint8_t const *data, size_t size) -> int {
+  auto contents = std::vector<std::byte>(reinterpret_cast<std::byte const *>(data), reinterpret_cast<std::byte const *>(data) + size);
+  try {
+    auto const zipArchiver = ai::ZipArchiver(std::make_shared<ai::MemoryZipReader>(std::move(contents)));
+    for (auto const &entry : zipArchiver.entries()) {
+      try {
+        zipArchiver.extract(entry.path, [](std::span<std::byte const>) {});
+      } catch (std::exception const &) {
+      }
+    }
+    auto threadPool = ai::utils::ThreadPool(0);
+    zipArchiver.verify(threadPool);
+  } catch (std::exception const &) {
+  }
+  return 0;
+}
@@ -0,0 +1,250 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#define LOG_MODULE LOG_MODULE_ZIP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "scoped_minizip.h"
+#include "utils/log.h"
+#include "utils/mapped_file.h"
+#include "zip_reader.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr size_t READ_AHEAD_SIZE = 64 * 1024;
+
+auto readFromSpan(std::span<std::byte const> const contents, uint64_t const offset, std::span<std::byte> const buffer) -> size_t {
+  if (offset >= contents.size()) {
+    return 0;
+  }
+  auto const size = std::min<uint64_t>(buffer.size(), contents.size() - offset);
+  std::memcpy(buffer.data(), contents.data() + offset, size);
+  return size;
+}
+
+//
+// State of one stream minizip opened on a reader.  Readers that are not in
+// memory get a read-ahead window, since minizip issues many small reads
+// (headers, names) that would otherwise each become a fetch.
+//
+struct ReaderStream {
+
+  explicit ReaderStream(ZipReader const &reader) : reader(reader), isInMemory(reader.view().has_value()) {}
+
+  auto read(std::span<std::byte> const destination) -> size_t {
+    if (isInMemory || destination.size() >= READ_AHEAD_SIZE) {
+      auto const bytesRead = reader.readAt(position, destination);
+      position += bytesRead;
+      return bytesRead;
+    }
+    size_t bytesCopied{0};
+    while (bytesCopied < destination.size()) {
+      if (position < windowOffset || position >= windowOffset + windowSize) {
+        window.resize(READ_AHEAD_SIZE);
+        windowOffset = position;
+        windowSize = reader.readAt(position, window);
+        if (windowSize == 0) {
+          break;
+        }
+      }
+      auto const windowPosition = static_cast<size_t>(position - windowOffset);
+      auto const size = std::min(destination.size() - bytesCopied, windowSize - windowPosition);
+      std::memcpy(destination.data() + bytesCopied, window.data() + windowPosition, size);
+      bytesCopied += size;
+      position += size;
+    }
+    return bytesCopied;
+  }
+
+  ZipReader const &reader;
+
+  bool const isInMemory;
+
+  uint64_t position = 0;
+
+  std::vector<std::byte> window;
+
+  uint64_t windowOffset = 0;
+
+  size_t windowSize = 0;
+};
+
+auto openStream(voidpf const opaque, void const *, int const mode) -> voidpf {
+  if ((mode & ZLIB_FILEFUNC_MODE_WRITE) != 0) {
+    LOGW("openStream, readers are read only");
+    return nullptr;
+  }
+  return new ReaderStream(*static_cast<ZipReader const *>(opaque));
+}
+
+auto readStream(voidpf, voidpf const stream, void *const buffer, unsigned long const size) -> unsigned long {
+  return static_cast<ReaderStream *>(stream)->read(std::span<std::byte>(static_cast<std::byte *>(buffer), size));
+}
+
+auto writeStream(voidpf, voidpf, void const *, unsigned long) -> unsigned long { return 0; }
+
+auto tellStream(voidpf, voidpf const stream) -> ZPOS64_T { return static_cast<ReaderStream *>(stream)->position; }
+
+auto seekStream(voidpf, voidpf const stream, ZPOS64_T const offset, int const origin) -> long {
+  auto const readerStream = static_cast<ReaderStream *>(stream);
+  switch (origin) {
+  case ZLIB_FILEFUNC_SEEK_SET:
+    readerStream->position = offset;
+    return 0;
+  case ZLIB_FILEFUNC_SEEK_CUR:
+    readerStream->position += offset;
+    return 0;
+  case ZLIB_FILEFUNC_SEEK_END:
+    readerStream->position = readerStream->reader.size() + offset;
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+auto closeStream(voidpf, voidpf const stream) -> int {
+  delete static_cast<ReaderStream *>(stream);
+  return 0;
+}
+
+auto testStreamError(voidpf, voidpf) -> int { return 0; }
+
+} // namespace
+
+auto ZipReader::view() const -> std::optional<std::span<std::byte const>> { return std::nullopt; }
+
+auto ZipReader::advise(utils::AccessAdvice, uint64_t, uint64_t) const -> void {}
+
+FileZipReader::FileZipReader(std::string const &path) : mapping_(std::make_unique<utils::MappedFile>(path)) {}
+
+FileZipReader::FileZipReader(int const fd) : mapping_(std::make_unique<utils::MappedFile>(fd)) {}
+
+FileZipReader::~FileZipReader() = default;
+
+auto FileZipReader::size() const -> uint64_t { return mapping_->size(); }
+
+auto FileZipReader::readAt(uint64_t const offset, std::span<std::byte> const buffer) const -> size_t {
+  return readFromSpan(mapping_->bytes(), offset, buffer);
+}
+
+auto FileZipReader::view() const -> std::optional<std::span<std::byte const>> { return mapping_->bytes(); }
+
+auto FileZipReader::advise(utils::AccessAdvice const advice, uint64_t const offset, uint64_t const length) const -> void {
+  mapping_->advise(advice, static_cast<size_t>(offset), static_cast<size_t>(length));
+}
+
+DescriptorZipReader::DescriptorZipReader(int const fd) : fd_(fcntl(fd, F_DUPFD_CLOEXEC, 0)) {
+  if (fd_ < 0) {
+    throw std::logic_error("unable to duplicate descriptor");
+  }
+  struct stat fileStat = {};
+  if (fstat(fd_, &fileStat) != 0 || fileStat.st_size < 0) {
+    close(fd_);
+    throw std::logic_error("unable to stat descriptor");
+  }
+  size_ = static_cast<uint64_t>(fileStat.st_size);
+}
+
+DescriptorZipReader::~DescriptorZipReader() { close(fd_); }
+
+auto DescriptorZipReader::size() const -> uint64_t { return size_; }
+
+auto DescriptorZipReader::readAt(uint64_t const offset, std::span<std::byte> const buffer) const -> size_t {
+  if (offset >= size_) {
+    return 0;
+  }
+  auto const wanted = std::min<uint64_t>(buffer.size(), size_ - offset);
+  auto read = size_t{0};
+  while (read < wanted) {
+    auto const result = pread(fd_, buffer.data() + read, wanted - read, static_cast<off_t>(offset + read));
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result < 0) {
+      throw std::logic_error("unable to read descriptor");
+    }
+    if (result == 0) {
+      break;
+    }
+    read += static_cast<size_t>(result);
+  }
+  return read;
+}
+
+auto DescriptorZipReader::advise(utils::AccessAdvice const advice, uint64_t const offset, uint64_t const length) const -> void {
+  utils::adviseDescriptor(fd_, advice, offset, length);
+}
+
+auto ai::openDescriptorReader(int const fd) -> std::shared_ptr<ZipReader const> {
+  try {
+    return std::make_shared<FileZipReader const>(fd);
+  } catch (std::logic_error const &) {
+    LOGD("openDescriptorReader, unable to map descriptor, reading it instead");
+    return std::make_shared<DescriptorZipReader const>(fd);
+  }
+}
+
+MemoryZipReader::MemoryZipReader(std::vector<std::byte> contents) : contents_(std::move(contents)) {}
+
+auto MemoryZipReader::size() const -> uint64_t { return contents_.size(); }
+
+auto MemoryZipReader::readAt(uint64_t const offset, std::span<std::byte> const buffer) const -> size_t { return readFromSpan(contents_, offset, buffer); }
+
+auto MemoryZipReader::view() const -> std::optional<std::span<std::byte const>> { return std::span<std::byte const>(contents_); }
+
+RangeZipReader::RangeZipReader(uint64_t const size, ZipRangeFetcher fetcher) : size_(size), fetcher_(std::move(fetcher)) {
+  if (!fetcher_) {
+    throw std::logic_error("range fetcher is empty");
+  }
+}
+
+auto RangeZipReader::size() const -> uint64_t { return size_; }
+
+auto RangeZipReader::readAt(uint64_t const offset, std::span<std::byte> const buffer) const -> size_t {
+  if (offset >= size_) {
+    return 0;
+  }
+  return fetcher_(offset, buffer.first(std::min<uint64_t>(buffer.size(), size_ - offset)));
+}
+
+auto ai::minizip::openZipReader(ZipReader const &reader) -> unzFile {
+  auto fileFunctions = zlib_filefunc64_def{};
+  fileFunctions.zopen64_file = openStream;
+  fileFunctions.zread_file = readStream;
+  fileFunctions.zwrite_file = writeStream;
+  fileFunctions.ztell64_file = tellStream;
+  fileFunctions.zseek64_file = seekStream;
+  fileFunctions.zclose_file = closeStream;
+  fileFunctions.zerror_file = testStreamError;
+  fileFunctions.opaque = const_cast<ZipReader *>(&reader);
+  return unzOpen2_64("", &fileFunctions);
+}
@@ -0,0 +1,174 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_ZIP_READER_H_
+#define ANDROID_INTROSPECTION_APK_ZIP_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ai {
+
+namespace utils {
+class MappedFile;
+
+enum class AccessAdvice : uint8_t;
+} // namespace utils
+
+//
+// Random access source of archive bytes.  Archives are only read through
+// this interface, so opening one reads the end of central directory and
+// the central directory, and entry data is fetched on demand.
+//
+// Parallel extraction reads through one reader from several threads, so
+// readAt() must be safe to call concurrently.
+//
+class ZipReader {
+public:
+  virtual ~ZipReader() = default;
+
+  virtual auto size() const -> uint64_t = 0;
+
+  //
+  // Reads up to buffer.size() bytes at offset, returning the number of
+  // bytes read; short reads only happen at the end of the archive.
+  //
+  virtual auto readAt(uint64_t offset, std::span<std::byte> buffer) const -> size_t = 0;
+
+  //
+  // The whole archive, when it is contiguous in memory and can be accessed
+  // without copies.
+  //
+  virtual auto view() const -> std::optional<std::span<std::byte const>>;
+
+  //
+  // Tells the source how a range is about to be read, e.g. in order by a
+  // bulk extract, so readers backed by a file pass it on to the kernel.  A
+  // length of 0 runs to the end.  Others ignore it.
+  //
+  virtual auto advise(utils::AccessAdvice advice, uint64_t offset, uint64_t length) const -> void;
+};
+
+//
+// Reads a file on disk through a memory mapping.
+//
+class FileZipReader final : public ZipReader {
+public:
+  explicit FileZipReader(std::string const &path);
+
+  //
+  // Maps the file open at the descriptor, which the caller keeps.
+  //
+  explicit FileZipReader(int fd);
+
+  ~FileZipReader() override;
+
+  auto size() const -> uint64_t override;
+
+  auto readAt(uint64_t offset, std::span<std::byte> buffer) const -> size_t override;
+
+  auto view() const -> std::optional<std::span<std::byte const>> override;
+
+  auto advise(utils::AccessAdvice advice, uint64_t offset, uint64_t length) const -> void override;
+
+private:
+  std::unique_ptr<utils::MappedFile> const mapping_;
+};
+
+//
+// Reads a file behind a descriptor that can't be mapped with pread().  The
+// descriptor is duplicated and closed with the reader.
+//
+class DescriptorZipReader final : public ZipReader {
+public:
+  explicit DescriptorZipReader(int fd);
+
+  ~DescriptorZipReader() override;
+
+  DescriptorZipReader(DescriptorZipReader const &) = delete;
+
+  auto operator=(DescriptorZipReader const &) -> DescriptorZipReader & = delete;
+
+  auto size() const -> uint64_t override;
+
+  auto readAt(uint64_t offset, std::span<std::byte> buffer) const -> size_t override;
+
+  auto advise(utils::AccessAdvice advice, uint64_t offset, uint64_t length) const -> void override;
+
+private:
+  int const fd_;
+
+  uint64_t size_ = 0;
+};
+
+//
+// Reader of the file open at the descriptor, e.g. an installed APK or a
+// document from a content provider: mapped when it can be, and read with
+// pread() otherwise.  The caller keeps the descriptor.
+//
+auto openDescriptorReader(int fd) -> std::shared_ptr<ZipReader const>;
+
+class MemoryZipReader final : public ZipReader {
+public:
+  explicit MemoryZipReader(std::vector<std::byte> contents);
+
+  auto size() const -> uint64_t override;
+
+  auto readAt(uint64_t offset, std::span<std::byte> buffer) const -> size_t override;
+
+  auto view() const -> std::optional<std::span<std::byte const>> override;
+
+private:
+  std::vector<std::byte> const contents_;
+};
+
+//
+// Fetches byte ranges of an archive that lives elsewhere, e.g. slices of a
+// browser Blob or HTTP Range requests.  The fetcher has the same contract
+// as ZipReader::readAt().
+//
+using ZipRangeFetcher = std::function<size_t(uint64_t offset, std::span<std::byte> buffer)>;
+
+class RangeZipReader final : public ZipReader {
+public:
+  RangeZipReader(uint64_t size, ZipRangeFetcher fetcher);
+
+  auto size() const -> uint64_t override;
+
+  auto readAt(uint64_t offset, std::span<std::byte> buffer) const -> size_t override;
+
+private:
+  uint64_t const size_;
+
+  ZipRangeFetcher const fetcher_;
+};
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_ZIP_READER_H_ */
@@ -0,0 +1,412 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <future>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AI_ZIP_RECOVERY_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AI_ZIP_RECOVERY_NEON
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define AI_ZIP_RECOVERY_SIMD128
+#endif
+
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
+#include "zip_reader.h"
+#include "zip_recovery.h"
+
+namespace {
+
+using namespace ai;
+
+static constexpr uint32_t LOCAL_FILE_HEADER_SIGNATURE = 0x04034b50;
+
+static constexpr uint32_t DATA_DESCRIPTOR_SIGNATURE = 0x08074b50;
+
+static constexpr uint32_t CENTRAL_DIRECTORY_SIGNATURE = 0x02014b50;
+
+static constexpr uint32_t END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+
+static constexpr size_t SIGNATURE_SIZE = 4;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_SIZE = 30;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_FLAGS_OFFSET = 6;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_METHOD_OFFSET = 8;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_CRC_OFFSET = 14;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_COMPRESSED_SIZE_OFFSET = 18;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_UNCOMPRESSED_SIZE_OFFSET = 22;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_FILE_NAME_LENGTH_OFFSET = 26;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_EXTRA_FIELD_LENGTH_OFFSET = 28;
+
+//
+// General purpose flag of entries whose sizes and CRC-32 follow their data
+// in a data descriptor.
+//
+static constexpr uint16_t DATA_DESCRIPTOR_FLAG = 0x08;
+
+//
+// Signature, CRC-32 and the two sizes, which are 8 bytes each in the
+// descriptors of zip64 entries.
+//
+static constexpr uint64_t DATA_DESCRIPTOR_SIZE = 16;
+
+static constexpr uint64_t ZIP64_DATA_DESCRIPTOR_SIZE = 24;
+
+static constexpr uint16_t ZIP64_EXTRA_FIELD_ID = 0x0001;
+
+static constexpr uint32_t ZIP64_THRESHOLD = 0xFFFFFFFF;
+
+static constexpr uint16_t STORED_METHOD = 0;
+
+static constexpr uint16_t DEFLATED_METHOD = 8;
+
+//
+// Bytes of the archive each task searches.  Segments are read with the
+// first bytes of the next one, so signatures across a boundary are found.
+//
+static constexpr uint64_t SEGMENT_SIZE = 4 * 1024 * 1024;
+
+static constexpr size_t BLOCK_SIZE = 16;
+
+struct Signature {
+
+  uint64_t offset;
+
+  uint32_t value;
+};
+
+using ai::utils::little_endian::load;
+
+//
+// Skips blocks of 16 bytes without a "PK" pair starting in them; returns
+// the offset of the block the scalar loop has to look at.
+//
+#if defined(AI_ZIP_RECOVERY_SSE2)
+
+auto skipBlocks(std::byte const *const bytes, size_t offset, size_t const size) -> size_t {
+  auto const p = _mm_set1_epi8('P');
+  auto const k = _mm_set1_epi8('K');
+  for (; offset + BLOCK_SIZE + 1 <= size; offset += BLOCK_SIZE) {
+    auto const first = _mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes + offset));
+    auto const second = _mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes + offset + 1));
+    auto const matches = _mm_and_si128(_mm_cmpeq_epi8(first, p), _mm_cmpeq_epi8(second, k));
+    if (auto const mask = _mm_movemask_epi8(matches); mask != 0) {
+      return offset + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+    }
+  }
+  return offset;
+}
+
+#elif defined(AI_ZIP_RECOVERY_NEON)
+
+auto skipBlocks(std::byte const *const bytes, size_t offset, size_t const size) -> size_t {
+  for (; offset + BLOCK_SIZE + 1 <= size; offset += BLOCK_SIZE) {
+    auto const first = vld1q_u8(reinterpret_cast<uint8_t const *>(bytes + offset));
+    auto const second = vld1q_u8(reinterpret_cast<uint8_t const *>(bytes + offset + 1));
+    if (vmaxvq_u8(vandq_u8(vceqq_u8(first, vdupq_n_u8('P')), vceqq_u8(second, vdupq_n_u8('K')))) != 0) {
+      break;
+    }
+  }
+  return offset;
+}
+
+#elif defined(AI_ZIP_RECOVERY_SIMD128)
+
+auto skipBlocks(std::byte const *const bytes, size_t offset, size_t const size) -> size_t {
+  for (; offset + BLOCK_SIZE + 1 <= size; offset += BLOCK_SIZE) {
+    auto const first = wasm_v128_load(bytes + offset);
+    auto const second = wasm_v128_load(bytes + offset + 1);
+    auto const matches = wasm_v128_and(wasm_i8x16_eq(first, wasm_i8x16_splat('P')), wasm_i8x16_eq(second, wasm_i8x16_splat('K')));
+    if (auto const mask = wasm_i8x16_bitmask(matches); mask != 0) {
+      return offset + static_cast<size_t>(__builtin_ctz(mask));
+    }
+  }
+  return offset;
+}
+
+#else
+
+auto skipBlocks(std::byte const *const, size_t const offset, size_t const) -> size_t { return offset; }
+
+#endif
+
+auto isRecoverySignature(uint32_t const value) {
+  return value == LOCAL_FILE_HEADER_SIGNATURE || value == DATA_DESCRIPTOR_SIGNATURE || value == CENTRAL_DIRECTORY_SIGNATURE ||
+         value == END_OF_CENTRAL_DIRECTORY_SIGNATURE;
+}
+
+//
+// Appends the signatures starting in the first count bytes; bytes holds
+// the three bytes after those as well, where there are any.
+//
+auto findSignatures(std::span<std::byte const> const bytes, size_t const count, uint64_t const baseOffset, std::vector<Signature> &signatures) {
+  auto offset = size_t{0};
+  while (offset < count) {
+    offset = skipBlocks(bytes.data(), offset, bytes.size());
+    auto const blockEnd = std::min(offset + BLOCK_SIZE, count);
+    for (; offset < blockEnd; offset++) {
+      if (offset + SIGNATURE_SIZE > bytes.size() || bytes[offset] != std::byte{'P'} || bytes[offset + 1] != std::byte{'K'}) {
+        continue;
+      }
+      if (auto const value = load<uint32_t>(bytes, offset); isRecoverySignature(value)) {
+        signatures.push_back(Signature{baseOffset + offset, value});
+      }
+    }
+  }
+}
+
+auto scanSegment(ZipReader const &reader, uint64_t const offset) -> std::vector<Signature> {
+  auto const count = std::min(SEGMENT_SIZE, reader.size() - offset);
+  auto const size = std::min(count + SIGNATURE_SIZE - 1, reader.size() - offset);
+  auto signatures = std::vector<Signature>();
+  if (auto const archive = reader.view(); archive) {
+    findSignatures(archive->subspan(offset, size), count, offset, signatures);
+    return signatures;
+  }
+  auto buffer = std::vector<std::byte>(size);
+  buffer.resize(reader.readAt(offset, buffer));
+  findSignatures(buffer, std::min<size_t>(count, buffer.size()), offset, signatures);
+  return signatures;
+}
+
+auto scanSignatures(ZipReader const &reader, utils::ThreadPool &threadPool) -> std::vector<Signature> {
+  auto segments = std::vector<std::future<std::vector<Signature>>>();
+  for (uint64_t offset{0}; offset < reader.size(); offset += SEGMENT_SIZE) {
+    segments.push_back(threadPool.submit([&reader, offset] { return scanSegment(reader, offset); }));
+  }
+  for (auto &segment : segments) {
+    segment.wait();
+  }
+  auto signatures = std::vector<Signature>();
+  for (auto &segment : segments) {
+    auto const found = segment.get();
+    signatures.insert(signatures.end(), found.begin(), found.end());
+  }
+  return signatures;
+}
+
+auto readBytes(ZipReader const &reader, uint64_t const offset, std::span<std::byte> const buffer) {
+  return offset <= reader.size() && buffer.size() <= reader.size() - offset && reader.readAt(offset, buffer) == buffer.size();
+}
+
+//
+// Offsets of the signatures of one kind, in file order.
+//
+struct SignatureOffsets {
+
+  explicit SignatureOffsets(std::vector<Signature> const &signatures, uint32_t const value) {
+    for (auto const &signature : signatures) {
+      if (signature.value == value) {
+        offsets.push_back(signature.offset);
+      }
+    }
+  }
+
+  auto from(uint64_t const offset) const -> std::span<uint64_t const> {
+    return std::span(std::lower_bound(offsets.begin(), offsets.end(), offset), offsets.end());
+  }
+
+  std::vector<uint64_t> offsets;
+};
+
+//
+// Fills the sizes and CRC-32 of an entry from the descriptor after its
+// data: the first one with a signature whose compressed size matches its
+// distance from the data, or else one without a signature right before
+// the next header.
+//
+auto readDataDescriptor(ZipReader const &reader, SignatureOffsets const &descriptors, uint64_t const nextHeader, uint64_t const dataOffset,
+                        ZipEntry &entry) -> bool {
+  auto descriptor = std::array<std::byte, ZIP64_DATA_DESCRIPTOR_SIZE>();
+  for (auto const offset : descriptors.from(dataOffset)) {
+    if (offset >= nextHeader) {
+      break;
+    }
+    auto const compressedSize = offset - dataOffset;
+    if (readBytes(reader, offset, std::span(descriptor).first(DATA_DESCRIPTOR_SIZE)) && load<uint32_t>(descriptor, 8) == compressedSize) {
+      entry.crc = load<uint32_t>(descriptor, 4);
+      entry.compressedSize = compressedSize;
+      entry.uncompressedSize = load<uint32_t>(descriptor, 12);
+      return true;
+    }
+    if (readBytes(reader, offset, descriptor) && load<uint64_t>(descriptor, 8) == compressedSize) {
+      entry.crc = load<uint32_t>(descriptor, 4);
+      entry.compressedSize = compressedSize;
+      entry.uncompressedSize = load<uint64_t>(descriptor, 16);
+      return true;
+    }
+  }
+  auto const unsignedSize = DATA_DESCRIPTOR_SIZE - SIGNATURE_SIZE;
+  if (nextHeader < dataOffset + unsignedSize || !readBytes(reader, nextHeader - unsignedSize, std::span(descriptor).first(unsignedSize))) {
+    return false;
+  }
+  if (auto const compressedSize = nextHeader - unsignedSize - dataOffset; load<uint32_t>(descriptor, 4) == compressedSize) {
+    entry.crc = load<uint32_t>(descriptor, 0);
+    entry.compressedSize = compressedSize;
+    entry.uncompressedSize = load<uint32_t>(descriptor, 8);
+    return true;
+  }
+  return false;
+}
+
+//
+// Reads the sizes that did not fit the local header from its zip64 extra
+// field.
+//
+auto readZip64Sizes(std::span<std::byte const> const extraField, ZipEntry &entry) -> bool {
+  for (uint64_t offset{0}; offset + 4 <= extraField.size();) {
+    auto const id = load<uint16_t>(extraField, offset);
+    auto const size = load<uint16_t>(extraField, offset + 2);
+    offset += 4;
+    if (offset + size > extraField.size()) {
+      return false;
+    }
+    if (id == ZIP64_EXTRA_FIELD_ID) {
+      auto const fields = extraField.subspan(offset, size);
+      auto field = uint64_t{0};
+      for (auto *const value : {&entry.uncompressedSize, &entry.compressedSize}) {
+        if (*value == ZIP64_THRESHOLD) {
+          if (field + sizeof(uint64_t) > fields.size()) {
+            return false;
+          }
+          *value = load<uint64_t>(fields, field);
+          field += sizeof(uint64_t);
+        }
+      }
+      return true;
+    }
+    offset += size;
+  }
+  return false;
+}
+
+//
+// The entry of the local header at offset, if the header holds up: a name
+// without NUL bytes, a supported method and data within the archive.
+//
+auto readLocalHeader(ZipReader const &reader, uint64_t const offset, SignatureOffsets const &descriptors, uint64_t const nextHeader)
+    -> std::optional<std::pair<ZipEntry, uint64_t>> {
+  auto header = std::array<std::byte, LOCAL_FILE_HEADER_SIZE>();
+  if (!readBytes(reader, offset, header)) {
+    return std::nullopt;
+  }
+  auto const flags = load<uint16_t>(header, LOCAL_FILE_HEADER_FLAGS_OFFSET);
+  auto const method = load<uint16_t>(header, LOCAL_FILE_HEADER_METHOD_OFFSET);
+  auto const fileNameLength = load<uint16_t>(header, LOCAL_FILE_HEADER_FILE_NAME_LENGTH_OFFSET);
+  auto const extraFieldLength = load<uint16_t>(header, LOCAL_FILE_HEADER_EXTRA_FIELD_LENGTH_OFFSET);
+  if ((method != STORED_METHOD && method != DEFLATED_METHOD) || fileNameLength == 0) {
+    return std::nullopt;
+  }
+  auto nameAndExtraField = std::vector<std::byte>(fileNameLength + extraFieldLength);
+  if (!readBytes(reader, offset + LOCAL_FILE_HEADER_SIZE, nameAndExtraField)) {
+    return std::nullopt;
+  }
+  auto const fileName = std::span<std::byte const>(nameAndExtraField).first(fileNameLength);
+  if (std::find(fileName.begin(), fileName.end(), std::byte{0}) != fileName.end()) {
+    return std::nullopt;
+  }
+  auto entry = ZipEntry{std::string(reinterpret_cast<char const *>(fileName.data()), fileName.size()),
+                        NO_CENTRAL_DIRECTORY_OFFSET,
+                        offset,
+                        load<uint32_t>(header, LOCAL_FILE_HEADER_COMPRESSED_SIZE_OFFSET),
+                        load<uint32_t>(header, LOCAL_FILE_HEADER_UNCOMPRESSED_SIZE_OFFSET),
+                        load<uint32_t>(header, LOCAL_FILE_HEADER_CRC_OFFSET),
+                        method};
+  auto const dataOffset = offset + LOCAL_FILE_HEADER_SIZE + nameAndExtraField.size();
+  if ((flags & DATA_DESCRIPTOR_FLAG) != 0) {
+    if (!readDataDescriptor(reader, descriptors, nextHeader, dataOffset, entry)) {
+      return std::nullopt;
+    }
+  } else if ((entry.compressedSize == ZIP64_THRESHOLD || entry.uncompressedSize == ZIP64_THRESHOLD) &&
+             !readZip64Sizes(std::span<std::byte const>(nameAndExtraField).subspan(fileNameLength), entry)) {
+    return std::nullopt;
+  }
+  if (dataOffset > reader.size() || entry.compressedSize > reader.size() - dataOffset ||
+      (method == STORED_METHOD && entry.compressedSize != entry.uncompressedSize)) {
+    return std::nullopt;
+  }
+  auto const dataEnd = dataOffset + entry.compressedSize;
+  return std::pair(std::move(entry), dataEnd);
+}
+
+} // namespace
+
+namespace ai {
+
+auto recoverZipEntries(ZipReader const &reader, utils::ThreadPool &threadPool) -> std::vector<ZipEntry> {
+  TRACE_SPAN("recoverZipEntries");
+  auto const signatures = scanSignatures(reader, threadPool);
+  auto const localHeaders = SignatureOffsets(signatures, LOCAL_FILE_HEADER_SIGNATURE);
+  auto const descriptors = SignatureOffsets(signatures, DATA_DESCRIPTOR_SIGNATURE);
+  //
+  // Data of the last entry ends at the central directory, whatever is left
+  // of it.
+  //
+  auto boundaries = std::vector<uint64_t>();
+  for (auto const &signature : signatures) {
+    if (signature.value != DATA_DESCRIPTOR_SIGNATURE) {
+      boundaries.push_back(signature.offset);
+    }
+  }
+  boundaries.push_back(reader.size());
+
+  auto entries = std::vector<ZipEntry>();
+  auto dataEnd = uint64_t{0};
+  for (auto const offset : localHeaders.offsets) {
+    if (offset < dataEnd) {
+      continue;
+    }
+    auto const nextHeader = *std::upper_bound(boundaries.begin(), boundaries.end() - 1, offset + LOCAL_FILE_HEADER_SIZE);
+    if (auto entry = readLocalHeader(reader, offset, descriptors, nextHeader); entry) {
+      dataEnd = entry->second;
+      entries.push_back(std::move(entry->first));
+    }
+  }
+  static auto &recoveredEntries = utils::metrics::counter("zip.recovered_entries");
+  recoveredEntries.add(entries.size());
+  LOGD("recoverZipEntries, signatures [{}] entries [{}]", signatures.size(), entries.size());
+  return entries;
+}
+
+} // namespace ai
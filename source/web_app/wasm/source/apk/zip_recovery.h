@@ -0,0 +1,57 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_APK_ZIP_RECOVERY_H_
+#define ANDROID_INTROSPECTION_APK_ZIP_RECOVERY_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "zip_archiver.h"
+
+namespace ai {
+
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+class ZipReader;
+
+//
+// Central directory offset of entries rebuilt from their local header.
+//
+static constexpr uint64_t NO_CENTRAL_DIRECTORY_OFFSET = UINT64_MAX;
+
+//
+// Rebuilds the entries of an archive whose central directory is missing or
+// corrupt, as packers leave them, from its local file headers.  The file is
+// searched for signatures in segments spread over the pool, and headers are
+// then walked in order: sizes missing from a header come from its data
+// descriptor, and signatures inside the data of an entry are skipped.
+// Only stored and deflated entries are recovered.
+//
+auto recoverZipEntries(ZipReader const &reader, utils::ThreadPool &threadPool) -> std::vector<ZipEntry>;
+
+} // namespace ai
+
+#endif /* ANDROID_INTROSPECTION_APK_ZIP_RECOVERY_H_ */
@@ -0,0 +1,274 @@
+//
+// MIT License
+//
+// Copyright 2019
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#define LOG_MODULE LOG_MODULE_ZIP
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <zlib.h>
+
+#include "apk/zip_stream_writer.h"
+#include "utils/crc32.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/macros.h"
+#include "utils/trace.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr uint32_t LOCAL_FILE_HEADER_SIGNATURE = 0x04034b50;
+
+static constexpr uint32_t CENTRAL_DIRECTORY_HEADER_SIGNATURE = 0x02014b50;
+
+static constexpr uint32_t ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06064b50;
+
+static constexpr uint32_t ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIGNATURE = 0x07064b50;
+
+static constexpr uint32_t END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+
+static constexpr uint16_t ZIP64_EXTRA_FIELD_ID = 0x0001;
+
+static constexpr uint16_t VERSION_DEFAULT = 20;
+
+static constexpr uint16_t VERSION_ZIP64 = 45;
+
+//
+// Paths are UTF-8.
+//
+static constexpr uint16_t GENERAL_PURPOSE_FLAGS = 0x0800;
+
+static constexpr uint16_t COMPRESSION_STORE = 0;
+
+static constexpr uint16_t COMPRESSION_DEFLATE = 8;
+
+//
+// 1980-01-01 00:00, the earliest DOS date, so that the same input always
+// makes the same archive.
+//
+static constexpr uint16_t DOS_TIME = 0;
+
+static constexpr uint16_t DOS_DATE = 0x21;
+
+static constexpr uint64_t ZIP64_THRESHOLD = 0xFFFFFFFF;
+
+static constexpr uint64_t ZIP64_ENTRY_COUNT_THRESHOLD = 0xFFFF;
+
+static constexpr size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+using ai::utils::little_endian::append;
+
+auto appendPath(std::vector<std::byte> &bytes, std::string_view const path) -> void {
+  auto const data = reinterpret_cast<std::byte const *>(path.data());
+  bytes.insert(bytes.end(), data, data + path.size());
+}
+
+} // namespace
+
+struct ZipStreamWriter::Deflater {
+
+  Deflater() {
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::logic_error("unable to initialize deflate");
+    }
+  }
+
+  ~Deflater() { deflateEnd(&stream); }
+
+  DISALLOW_COPY_AND_ASSIGN(Deflater);
+
+  //
+  // Raw deflate stream of the contents, or nothing if it is not smaller.
+  //
+  auto deflateContents(std::span<std::byte const> const contents) -> std::span<std::byte const> {
+    if (contents.empty() || contents.size() > UINT32_MAX) {
+      return {};
+    }
+    if (deflateReset(&stream) != Z_OK) {
+      throw std::logic_error("unable to reset deflate");
+    }
+    output.resize(deflateBound(&stream, static_cast<uLong>(contents.size())));
+    stream.next_in = const_cast<Bytef *>(reinterpret_cast<Bytef const *>(contents.data()));
+    stream.avail_in = static_cast<uInt>(contents.size());
+    stream.next_out = reinterpret_cast<Bytef *>(output.data());
+    stream.avail_out = static_cast<uInt>(output.size());
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+      throw std::logic_error("unable to deflate contents");
+    }
+    auto const size = static_cast<size_t>(stream.total_out);
+    return size < contents.size() ? std::span<std::byte const>(output).first(size) : std::span<std::byte const>();
+  }
+
+  z_stream stream{};
+
+  std::vector<std::byte> output;
+};
+
+ZipStreamWriter::ZipStreamWriter(ZipStreamSink sink) : sink_(std::move(sink)), deflater_(std::make_unique<Deflater>()) { buffer_.reserve(WRITE_BUFFER_SIZE); }
+
+ZipStreamWriter::~ZipStreamWriter() = default;
+
+auto ZipStreamWriter::add(std::string_view const pathInArchive, std::span<std::byte const> const contents) -> void {
+  if (finished_) {
+    throw std::logic_error("zip stream already finished");
+  }
+  if (pathInArchive.empty() || pathInArchive.size() > UINT16_MAX) {
+    throw std::logic_error("invalid path in archive");
+  }
+  auto const compressed = deflater_->deflateContents(contents);
+  auto const data = compressed.empty() ? contents : compressed;
+  auto entry = Entry{std::string(pathInArchive), offset_, data.size(), contents.size(), utils::crc32::update(0, contents),
+                     compressed.empty() ? COMPRESSION_STORE : COMPRESSION_DEFLATE};
+  auto const zip64 = entry.uncompressedSize >= ZIP64_THRESHOLD || entry.compressedSize >= ZIP64_THRESHOLD;
+
+  auto header = std::vector<std::byte>();
+  append(header, LOCAL_FILE_HEADER_SIGNATURE);
+  append(header, zip64 ? VERSION_ZIP64 : VERSION_DEFAULT);
+  append(header, GENERAL_PURPOSE_FLAGS);
+  append(header, entry.compressionMethod);
+  append(header, DOS_TIME);
+  append(header, DOS_DATE);
+  append(header, entry.crc);
+  append(header, static_cast<uint32_t>(zip64 ? ZIP64_THRESHOLD : entry.compressedSize));
+  append(header, static_cast<uint32_t>(zip64 ? ZIP64_THRESHOLD : entry.uncompressedSize));
+  append(header, static_cast<uint16_t>(entry.path.size()));
+  append(header, static_cast<uint16_t>(zip64 ? 20 : 0));
+  appendPath(header, entry.path);
+  if (zip64) {
+    append(header, ZIP64_EXTRA_FIELD_ID);
+    append(header, uint16_t{16});
+    append(header, entry.uncompressedSize);
+    append(header, entry.compressedSize);
+  }
+  write(header);
+  write(data);
+  entries_.push_back(std::move(entry));
+}
+
+auto ZipStreamWriter::add(std::string_view const pathInArchive, std::string_view const text) -> void {
+  add(pathInArchive, std::as_bytes(std::span(text)));
+}
+
+auto ZipStreamWriter::finish() -> void {
+  TRACE_SPAN("ZipStreamWriter::finish");
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+
+  auto const centralDirectoryOffset = offset_;
+  auto directory = std::vector<std::byte>();
+  for (auto const &entry : entries_) {
+    auto extraField = std::vector<std::byte>();
+    auto const addZip64Value = [&extraField](uint64_t const value) {
+      if (value >= ZIP64_THRESHOLD) {
+        append(extraField, value);
+      }
+      return static_cast<uint32_t>(std::min(value, ZIP64_THRESHOLD));
+    };
+    auto const uncompressedSize = addZip64Value(entry.uncompressedSize);
+    auto const compressedSize = addZip64Value(entry.compressedSize);
+    auto const offset = addZip64Value(entry.offset);
+    auto const zip64 = !extraField.empty();
+    auto const version = zip64 ? VERSION_ZIP64 : VERSION_DEFAULT;
+    directory.clear();
+    append(directory, CENTRAL_DIRECTORY_HEADER_SIGNATURE);
+    append(directory, version);
+    append(directory, version);
+    append(directory, GENERAL_PURPOSE_FLAGS);
+    append(directory, entry.compressionMethod);
+    append(directory, DOS_TIME);
+    append(directory, DOS_DATE);
+    append(directory, entry.crc);
+    append(directory, compressedSize);
+    append(directory, uncompressedSize);
+    append(directory, static_cast<uint16_t>(entry.path.size()));
+    append(directory, static_cast<uint16_t>(zip64 ? extraField.size() + 4 : 0));
+    append(directory, uint16_t{0});
+    append(directory, uint16_t{0});
+    append(directory, uint16_t{0});
+    append(directory, uint32_t{0});
+    append(directory, offset);
+    appendPath(directory, entry.path);
+    if (zip64) {
+      append(directory, ZIP64_EXTRA_FIELD_ID);
+      append(directory, static_cast<uint16_t>(extraField.size()));
+      directory.insert(directory.end(), extraField.begin(), extraField.end());
+    }
+    write(directory);
+  }
+
+  auto const centralDirectorySize = offset_ - centralDirectoryOffset;
+  auto const entryCount = static_cast<uint64_t>(entries_.size());
+  auto end = std::vector<std::byte>();
+  if (entryCount >= ZIP64_ENTRY_COUNT_THRESHOLD || centralDirectorySize >= ZIP64_THRESHOLD || centralDirectoryOffset >= ZIP64_THRESHOLD) {
+    auto const zip64EndOffset = offset_;
+    append(end, ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+    append(end, uint64_t{44});
+    append(end, VERSION_ZIP64);
+    append(end, VERSION_ZIP64);
+    append(end, uint32_t{0});
+    append(end, uint32_t{0});
+    append(end, entryCount);
+    append(end, entryCount);
+    append(end, centralDirectorySize);
+    append(end, centralDirectoryOffset);
+    append(end, ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIGNATURE);
+    append(end, uint32_t{0});
+    append(end, zip64EndOffset);
+    append(end, uint32_t{1});
+  }
+  append(end, END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+  append(end, uint16_t{0});
+  append(end, uint16_t{0});
+  append(end, static_cast<uint16_t>(std::min(entryCount, ZIP64_ENTRY_COUNT_THRESHOLD)));
+  append(end, static_cast<uint16_t>(std::min(entryCount, ZIP64_ENTRY_COUNT_THRESHOLD)));
+  append(end, static_cast<uint32_t>(std::min(centralDirectorySize, ZIP64_THRESHOLD)));
+  append(end, static_cast<uint32_t>(std::min(centralDirectoryOffset, ZIP64_THRESHOLD)));
+  append(end, uint16_t{0});
+  write(end);
+  flush();
+  LOGD("finish, entries [{}] bytes [{}]", entries_.size(), offset_);
+}
+
+auto ZipStreamWriter::write(std::span<std::byte const> const bytes) -> void {
+  offset_ += bytes.size();
+  if (buffer_.size() + bytes.size() > WRITE_BUFFER_SIZE) {
+    flush();
+  }
+  if (bytes.size() >= WRITE_BUFFER_SIZE) {
+    sink_(bytes);
+    return;
+  }
+  buffer_.insert(buffer_.end(), bytes.begin(), bytes.end());
+}
+
+auto ZipStreamWriter::flush() -> void {
+  if (!buffer_.empty()) {
+    sink_(buffer_);
+    buffer_.clear();
+  }
+}
@@ -0,0 +1,69 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#define LOG_MODULE LOG_MODULE_ZIP
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#include "utils/log.h"
+#include "zip_archiver.h"
+
+using namespace ai;
+
+auto ZipTransaction::add(std::string_view const pathInArchive, std::vector<std::byte> contents, ZipCompression const compression) -> ZipTransaction & {
+  LOGD("add, pathInArchive [{}] contents [{}]", pathInArchive, contents.size());
+  return add(pathInArchive, std::make_shared<std::vector<std::byte> const>(std::move(contents)), compression);
+}
+
+auto ZipTransaction::add(std::string_view const pathInArchive, std::shared_ptr<std::vector<std::byte> const> contents, ZipCompression const compression)
+    -> ZipTransaction & {
+  LOGD("add, pathInArchive [{}] shared contents [{}]", pathInArchive, contents->size());
+  changes_.push_back(Change{Operation::Add, std::string(pathInArchive), std::move(contents), compression});
+  return *this;
+}
+
+auto ZipTransaction::replace(std::string_view const pathInArchive, std::vector<std::byte> contents, std::optional<ZipCompression> const compression)
+    -> ZipTransaction & {
+  LOGD("replace, pathInArchive [{}] contents [{}]", pathInArchive, contents.size());
+  changes_.push_back(Change{Operation::Replace, std::string(pathInArchive), std::make_shared<std::vector<std::byte> const>(std::move(contents)), compression});
+  return *this;
+}
+
+auto ZipTransaction::remove(std::string_view const pathInArchive) -> ZipTransaction & {
+  LOGD("remove, pathInArchive [{}]", pathInArchive);
+  changes_.push_back(Change{Operation::Remove, std::string(pathInArchive), nullptr, std::nullopt});
+  return *this;
+}
+
+auto ZipTransaction::align(ZipAlignment const alignment) -> ZipTransaction & {
+  LOGD("align, storedEntries [{}] sharedLibraries [{}]", alignment.storedEntries, alignment.sharedLibraries);
+  if (alignment.storedEntries == 0 || alignment.sharedLibraries == 0 || alignment.storedEntries > UINT16_MAX || alignment.sharedLibraries > UINT16_MAX) {
+    throw std::logic_error("invalid alignment");
+  }
+  alignment_ = alignment;
+  return *this;
+}
+
+auto ZipTransaction::empty() const -> bool { return changes_.empty(); }
@@ -0,0 +1,44 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+
+#include "apk/apk_paths.h"
+#include "dex/apk_dex_files.h"
+#include "utils/log.h"
+
+using namespace ai::dex;
+
+ApkDexFiles::ApkDexFiles(Apk const &apk) {
+  auto const files = apk.getFiles();
+  for (auto index = std::size_t{0};; index++) {
+    auto name = getDexFileName(index);
+    if (std::find(files.begin(), files.end(), name) == files.end()) {
+      break;
+    }
+    auto bytes = apk.getFileBytes(name);
+    auto file = DexFile(bytes.bytes());
+    files_.push_back(File{std::move(name), std::move(bytes), std::move(file)});
+  }
+  LOGD("ApkDexFiles, dex files [{}]", files_.size());
+}
@@ -0,0 +1,395 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <utility>
+
+#include "dex/call_graph.h"
+#include "instruction_set.h"
+#include "utils/data_stream.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
+
+using namespace ai::dex;
+
+namespace {
+
+static constexpr std::string_view CACHE_DATA_NAME = "call-graph";
+
+//
+// "AICG"
+//
+static constexpr uint32_t GRAPH_MAGIC = 0x47434941;
+
+static constexpr uint16_t GRAPH_VERSION = 1;
+
+static constexpr uint32_t CLASSES_PER_TASK = 256;
+
+//
+// Names of the method ids of a file, in order of id.
+//
+struct FileMethods {
+
+  std::string names;
+
+  std::vector<uint32_t> offsets = {0};
+
+  auto name(uint32_t const method) const -> std::string_view { return std::string_view(names).substr(offsets[method], offsets[method + 1] - offsets[method]); }
+};
+
+//
+// Calls of a range of class defs, as caller and callee method ids of their
+// file packed into one value, sorted and without duplicates.
+//
+struct FileCalls {
+
+  std::size_t dexFile;
+
+  std::vector<uint64_t> calls;
+
+  uint32_t invalidMethods = 0;
+};
+
+auto getPair(uint32_t const first, uint32_t const second) -> uint64_t { return uint64_t{first} << 32 | second; }
+
+auto getMethods(DexFile const &dex) -> FileMethods {
+  auto methods = FileMethods();
+  auto const &methodIds = dex.methodIds();
+  for (auto method = uint32_t{0}; method < methodIds.size(); method++) {
+    methods.names += getClassName(dex.typeDescriptor(methodIds[method].classIndex));
+    methods.names += '.';
+    methods.names += dex.methodName(method);
+    methods.names += dex.methodSignature(method);
+    if (methods.names.size() > UINT32_MAX) {
+      throw std::logic_error("too many method names");
+    }
+    methods.offsets.push_back(static_cast<uint32_t>(methods.names.size()));
+  }
+  return methods;
+}
+
+auto addCalls(DexFile const &dex, DexEncodedMethod const &method, std::vector<uint64_t> &calls) -> void {
+  auto const code = dex.codeItem(method.codeOffset);
+  auto const size = code.instructions.size();
+  for (auto address = uint32_t{0}; address < size;) {
+    if (auto const payloadSize = getPayloadSize(code.instructions, address); payloadSize > 0) {
+      address += payloadSize;
+      continue;
+    }
+    auto const &opcode = OPCODES[code.instructions[address] & 0xff];
+
+    //
+    // Every invoke, ranges and polymorphic ones included, has the method
+    // id in its second unit.
+    //
+    if (opcode.reference == Reference::Method) {
+      calls.push_back(getPair(method.methodIndex, code.instructions[address + 1]));
+    }
+    address += getFormatSize(opcode.format);
+  }
+}
+
+auto getCalls(DexFile const &dex, std::size_t const dexFile, uint32_t const firstClassDef, uint32_t const lastClassDef) -> FileCalls {
+  auto calls = FileCalls{dexFile, {}};
+  auto const addMethodCalls = [&dex, &calls](std::vector<DexEncodedMethod> const &methods) {
+    for (auto const &method : methods) {
+      if (method.codeOffset == 0) {
+        continue;
+      }
+      auto const restart = calls.calls.size();
+      try {
+        addCalls(dex, method, calls.calls);
+      } catch (std::exception const &) {
+        calls.calls.resize(restart);
+        calls.invalidMethods++;
+      }
+    }
+  };
+  for (auto classDef = firstClassDef; classDef < lastClassDef; classDef++) {
+    auto const classData = dex.classData(dex.classDefs()[classDef]);
+    addMethodCalls(classData.directMethods);
+    addMethodCalls(classData.virtualMethods);
+  }
+  std::sort(calls.calls.begin(), calls.calls.end());
+  calls.calls.erase(std::unique(calls.calls.begin(), calls.calls.end()), calls.calls.end());
+  return calls;
+}
+
+using ai::utils::little_endian::append;
+
+template <typename T> auto appendArray(std::vector<std::byte> &bytes, std::span<T const> const values) -> void {
+  auto const data = reinterpret_cast<std::byte const *>(values.data());
+  bytes.insert(bytes.end(), data, data + values.size_bytes());
+}
+
+auto skip(DataStream &stream, std::size_t const size) -> void {
+  if (size > UINT32_MAX) {
+    throw std::logic_error("invalid call graph");
+  }
+  stream.skip(static_cast<uint32_t>(size));
+}
+
+template <typename T> auto readArray(DataStream &stream, std::span<std::byte const> const encoded, std::size_t const count) -> std::vector<T> {
+  stream.require(count * sizeof(T));
+  auto values = std::vector<T>(count);
+  memcpy(values.data(), encoded.data() + stream.position(), count * sizeof(T));
+  skip(stream, count * sizeof(T));
+  return values;
+}
+
+//
+// Offsets of the runs of each index in a sorted list of them.
+//
+auto getRowOffsets(std::span<uint32_t const> const rows, uint32_t const rowCount) -> std::vector<uint32_t> {
+  auto offsets = std::vector<uint32_t>(std::size_t{rowCount} + 1);
+  for (auto const row : rows) {
+    offsets[row + 1]++;
+  }
+  for (auto row = std::size_t{0}; row < rowCount; row++) {
+    offsets[row + 1] += offsets[row];
+  }
+  return offsets;
+}
+
+} // namespace
+
+CallGraph::CallGraph(ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool) {
+  TRACE_SPAN("CallGraph");
+  auto futureMethods = std::vector<std::future<FileMethods>>();
+  auto futureCalls = std::vector<std::future<FileCalls>>();
+  for (auto dexFile = std::size_t{0}; dexFile < dexFiles.size(); dexFile++) {
+    auto const &dex = dexFiles[dexFile];
+    futureMethods.push_back(threadPool.submit([&dex] { return getMethods(dex); }));
+    auto const classDefCount = dex.classDefs().size();
+    for (auto firstClassDef = uint32_t{0}; firstClassDef < classDefCount; firstClassDef += CLASSES_PER_TASK) {
+      auto const lastClassDef = std::min(classDefCount, firstClassDef + CLASSES_PER_TASK);
+      futureCalls.push_back(threadPool.submit([&dex, dexFile, firstClassDef, lastClassDef] { return getCalls(dex, dexFile, firstClassDef, lastClassDef); }));
+    }
+  }
+  //
+  // Every task is done before the first result is taken, as one that
+  // throws would otherwise leave the others reading the dex files.
+  //
+  for (auto &future : futureMethods) {
+    future.wait();
+  }
+  for (auto &future : futureCalls) {
+    future.wait();
+  }
+  auto fileMethods = std::vector<FileMethods>();
+  for (auto &future : futureMethods) {
+    fileMethods.push_back(future.get());
+  }
+
+  //
+  // Methods are numbered by name, so the same method referenced from
+  // several files gets one id.
+  //
+  auto sortedNames = std::vector<std::string_view>();
+  for (auto const &methods : fileMethods) {
+    for (auto method = uint32_t{0}; method + 1 < methods.offsets.size(); method++) {
+      sortedNames.push_back(methods.name(method));
+    }
+  }
+  std::sort(sortedNames.begin(), sortedNames.end());
+  sortedNames.erase(std::unique(sortedNames.begin(), sortedNames.end()), sortedNames.end());
+  if (sortedNames.size() >= UINT32_MAX) {
+    throw std::logic_error("too many methods");
+  }
+  for (auto const name : sortedNames) {
+    if (name.size() > UINT32_MAX - names_.size()) {
+      throw std::logic_error("too many method names");
+    }
+    names_ += name;
+    nameOffsets_.push_back(static_cast<uint32_t>(names_.size()));
+  }
+  auto futureIds = std::vector<std::future<std::vector<uint32_t>>>();
+  for (auto const &methods : fileMethods) {
+    futureIds.push_back(threadPool.submit([this, &methods] {
+      auto ids = std::vector<uint32_t>();
+      for (auto method = uint32_t{0}; method + 1 < methods.offsets.size(); method++) {
+        ids.push_back(*findMethod(methods.name(method)));
+      }
+      return ids;
+    }));
+  }
+  for (auto &future : futureIds) {
+    future.wait();
+  }
+  auto fileIds = std::vector<std::vector<uint32_t>>();
+  for (auto &future : futureIds) {
+    fileIds.push_back(future.get());
+  }
+
+  auto calls = std::vector<uint64_t>();
+  auto invalidMethods = uint32_t{0};
+  for (auto &future : futureCalls) {
+    auto const fileCalls = future.get();
+    auto const &ids = fileIds[fileCalls.dexFile];
+    for (auto const call : fileCalls.calls) {
+      auto const caller = static_cast<uint32_t>(call >> 32);
+      auto const callee = static_cast<uint32_t>(call);
+      if (caller < ids.size() && callee < ids.size()) {
+        calls.push_back(getPair(ids[caller], ids[callee]));
+      }
+    }
+    invalidMethods += fileCalls.invalidMethods;
+  }
+  std::sort(calls.begin(), calls.end());
+  calls.erase(std::unique(calls.begin(), calls.end()), calls.end());
+  if (calls.size() >= UINT32_MAX) {
+    throw std::logic_error("too many calls");
+  }
+
+  //
+  // Calls are sorted by caller, so the callees are in place and one pass
+  // places the callers of each callee, also in order.
+  //
+  auto callerIds = std::vector<uint32_t>();
+  callerIds.reserve(calls.size());
+  callees_.reserve(calls.size());
+  for (auto const call : calls) {
+    callerIds.push_back(static_cast<uint32_t>(call >> 32));
+    callees_.push_back(static_cast<uint32_t>(call));
+  }
+  calleeOffsets_ = getRowOffsets(callerIds, methodCount());
+  callerOffsets_ = getRowOffsets(callees_, methodCount());
+  callers_.resize(calls.size());
+  auto next = std::vector<uint32_t>(callerOffsets_.begin(), callerOffsets_.end() - 1);
+  for (auto edge = std::size_t{0}; edge < calls.size(); edge++) {
+    callers_[next[callees_[edge]]++] = callerIds[edge];
+  }
+  LOGD("CallGraph, methods [{}] edges [{}] invalid methods [{}]", methodCount(), edgeCount(), invalidMethods);
+}
+
+CallGraph::CallGraph(std::span<std::byte const> const encoded) {
+  auto stream = DataStream(encoded);
+  if (stream.read<uint32_t>() != GRAPH_MAGIC || stream.read<uint16_t>() != GRAPH_VERSION) {
+    throw std::logic_error("unsupported call graph");
+  }
+  stream.skip(sizeof(uint16_t));
+  auto const methodCount = stream.read<uint32_t>();
+  auto const namesSize = stream.read<uint32_t>();
+  stream.require(namesSize);
+  names_.assign(reinterpret_cast<char const *>(encoded.data() + stream.position()), namesSize);
+  skip(stream, namesSize);
+  nameOffsets_ = readArray<uint32_t>(stream, encoded, std::size_t{methodCount} + 1);
+  auto const edgeCount = stream.read<uint32_t>();
+  calleeOffsets_ = readArray<uint32_t>(stream, encoded, std::size_t{methodCount} + 1);
+  callees_ = readArray<uint32_t>(stream, encoded, edgeCount);
+  callerOffsets_ = readArray<uint32_t>(stream, encoded, std::size_t{methodCount} + 1);
+  callers_ = readArray<uint32_t>(stream, encoded, edgeCount);
+  validate();
+}
+
+auto CallGraph::load(Apk const &apk, ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool) -> CallGraph {
+  if (auto const encoded = apk.loadCachedData(CACHE_DATA_NAME)) {
+    try {
+      return CallGraph(*encoded);
+    } catch (std::exception const &exception) {
+      LOGW("load, ignoring cached call graph, {}", exception.what());
+    }
+  }
+  auto graph = CallGraph(dexFiles, threadPool);
+  apk.storeCachedData(CACHE_DATA_NAME, graph.encode());
+  return graph;
+}
+
+auto CallGraph::encode() const -> std::vector<std::byte> {
+  auto encoded = std::vector<std::byte>();
+  append(encoded, GRAPH_MAGIC);
+  append(encoded, GRAPH_VERSION);
+  append(encoded, uint16_t{0});
+  append(encoded, methodCount());
+  append(encoded, static_cast<uint32_t>(names_.size()));
+  appendArray(encoded, std::span<char const>(names_));
+  appendArray(encoded, std::span<uint32_t const>(nameOffsets_));
+  append(encoded, static_cast<uint32_t>(edgeCount()));
+  appendArray(encoded, std::span<uint32_t const>(calleeOffsets_));
+  appendArray(encoded, std::span<uint32_t const>(callees_));
+  appendArray(encoded, std::span<uint32_t const>(callerOffsets_));
+  appendArray(encoded, std::span<uint32_t const>(callers_));
+  return encoded;
+}
+
+auto CallGraph::methodName(uint32_t const method) const -> std::string_view {
+  if (method >= methodCount()) {
+    throw std::out_of_range("no such method");
+  }
+  return std::string_view(names_).substr(nameOffsets_[method], nameOffsets_[method + 1] - nameOffsets_[method]);
+}
+
+auto CallGraph::findMethod(std::string_view const name) const -> std::optional<uint32_t> {
+  auto low = uint32_t{0};
+  auto high = methodCount();
+  while (low < high) {
+    auto const middle = low + (high - low) / 2;
+    if (methodName(middle) < name) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low < methodCount() && methodName(low) == name) {
+    return low;
+  }
+  return std::nullopt;
+}
+
+auto CallGraph::callees(uint32_t const method) const -> std::span<uint32_t const> {
+  if (method >= methodCount()) {
+    throw std::out_of_range("no such method");
+  }
+  return std::span(callees_).subspan(calleeOffsets_[method], calleeOffsets_[method + 1] - calleeOffsets_[method]);
+}
+
+auto CallGraph::callers(uint32_t const method) const -> std::span<uint32_t const> {
+  if (method >= methodCount()) {
+    throw std::out_of_range("no such method");
+  }
+  return std::span(callers_).subspan(callerOffsets_[method], callerOffsets_[method + 1] - callerOffsets_[method]);
+}
+
+auto CallGraph::validate() const -> void {
+  auto const validOffsets = [](std::vector<uint32_t> const &offsets, std::size_t const size) {
+    return !offsets.empty() && offsets.front() == 0 && offsets.back() == size && std::is_sorted(offsets.begin(), offsets.end());
+  };
+  auto const validMethods = [this](std::vector<uint32_t> const &methods) {
+    return std::all_of(methods.begin(), methods.end(), [this](uint32_t const method) { return method < methodCount(); });
+  };
+  if (!validOffsets(nameOffsets_, names_.size()) || !validOffsets(calleeOffsets_, callees_.size()) || !validOffsets(callerOffsets_, callers_.size()) ||
+      calleeOffsets_.size() != nameOffsets_.size() || callerOffsets_.size() != nameOffsets_.size() || callees_.size() != callers_.size() ||
+      !validMethods(callees_) || !validMethods(callers_)) {
+    throw std::logic_error("invalid call graph");
+  }
+  for (auto method = uint32_t{1}; method < methodCount(); method++) {
+    if (!(methodName(method - 1) < methodName(method))) {
+      throw std::logic_error("invalid call graph");
+    }
+  }
+}
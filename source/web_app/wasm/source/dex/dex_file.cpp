@@ -0,0 +1,294 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+
+#include "dex/dex_file.h"
+#include "utils/data_stream.h"
+#include "utils/log.h"
+#include "utils/unicode.h"
+
+using namespace ai::dex;
+
+namespace {
+
+static constexpr std::size_t HEADER_SIZE = 0x70;
+
+static constexpr std::string_view MAGIC = "dex\n";
+
+static constexpr std::size_t VERSION_SIZE = 3;
+
+static constexpr uint32_t ENDIAN_CONSTANT = 0x12345678;
+
+static_assert(sizeof(DexProtoId) == 12);
+
+static_assert(sizeof(DexFieldId) == 8);
+
+static_assert(sizeof(DexMethodId) == 8);
+
+static_assert(sizeof(DexTryItem) == 8);
+
+static constexpr std::size_t CODE_ITEM_HEADER_SIZE = 16;
+
+static_assert(sizeof(DexClassDef) == 32);
+
+struct TableExtent {
+
+  uint32_t size;
+
+  uint32_t offset;
+};
+
+template <typename T> auto getTable(std::span<std::byte const> const bytes, TableExtent const extent) -> DexTable<T> {
+  if (extent.size == 0) {
+    return DexTable<T>();
+  }
+  if (extent.offset > bytes.size() || extent.size > (bytes.size() - extent.offset) / sizeof(T)) {
+    throw std::logic_error("invalid dex table");
+  }
+  return DexTable<T>(bytes.subspan(extent.offset, std::size_t{extent.size} * sizeof(T)));
+}
+
+auto readUleb128(std::span<std::byte const> const bytes, std::size_t &offset) -> uint32_t {
+  auto value = uint32_t{0};
+  for (auto shift = 0; shift < 35; shift += 7) {
+    if (offset >= bytes.size()) {
+      throw std::logic_error("invalid dex uleb128");
+    }
+    auto const byte = static_cast<uint8_t>(bytes[offset++]);
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::logic_error("invalid dex uleb128");
+}
+
+auto readSleb128(std::span<std::byte const> const bytes, std::size_t &offset) -> int32_t {
+  auto value = uint32_t{0};
+  for (auto shift = 0; shift < 35; shift += 7) {
+    if (offset >= bytes.size()) {
+      throw std::logic_error("invalid dex sleb128");
+    }
+    auto const byte = static_cast<uint8_t>(bytes[offset++]);
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      if (shift + 7 < 32 && (byte & 0x40) != 0) {
+        value |= ~uint32_t{0} << (shift + 7);
+      }
+      return static_cast<int32_t>(value);
+    }
+  }
+  throw std::logic_error("invalid dex sleb128");
+}
+
+} // namespace
+
+DexFile::DexFile(std::span<std::byte const> const bytes) : bytes_(bytes) {
+  if (bytes.size() < HEADER_SIZE || memcmp(bytes.data(), MAGIC.data(), MAGIC.size()) != 0 || bytes[MAGIC.size() + VERSION_SIZE] != std::byte{0}) {
+    throw std::logic_error("invalid dex magic");
+  }
+  header_.version = std::string(reinterpret_cast<char const *>(bytes.data()) + MAGIC.size(), VERSION_SIZE);
+
+  auto stream = DataStream(bytes.first(HEADER_SIZE));
+  stream.skip(MAGIC.size() + VERSION_SIZE + 1);
+  header_.checksum = stream.read<uint32_t>();
+  stream.skip(20);
+  header_.fileSize = stream.read<uint32_t>();
+  auto const headerSize = stream.read<uint32_t>();
+  auto const endianTag = stream.read<uint32_t>();
+  if (headerSize != HEADER_SIZE || endianTag != ENDIAN_CONSTANT || header_.fileSize < HEADER_SIZE || header_.fileSize > bytes.size()) {
+    throw std::logic_error("invalid dex header");
+  }
+  bytes_ = bytes.first(header_.fileSize);
+
+  //
+  // link, map, then the id tables in file order.
+  //
+  stream.skip(3 * sizeof(uint32_t));
+  auto const readExtent = [&stream] {
+    auto const size = stream.read<uint32_t>();
+    auto const offset = stream.read<uint32_t>();
+    return TableExtent{size, offset};
+  };
+  stringIds_ = getTable<uint32_t>(bytes_, readExtent());
+  typeIds_ = getTable<uint32_t>(bytes_, readExtent());
+  protoIds_ = getTable<DexProtoId>(bytes_, readExtent());
+  fieldIds_ = getTable<DexFieldId>(bytes_, readExtent());
+  methodIds_ = getTable<DexMethodId>(bytes_, readExtent());
+  classDefs_ = getTable<DexClassDef>(bytes_, readExtent());
+  LOGD("DexFile, version [{}] strings [{}] types [{}] methods [{}] classes [{}]", header_.version, stringIds_.size(), typeIds_.size(), methodIds_.size(),
+       classDefs_.size());
+}
+
+auto DexFile::string(uint32_t const stringIndex) const -> std::string_view {
+  auto offset = std::size_t{stringIds_[stringIndex]};
+  readUleb128(bytes_, offset);
+  auto const data = bytes_.subspan(std::min(offset, bytes_.size()));
+  auto const end = std::find(data.begin(), data.end(), std::byte{0});
+  if (end == data.end()) {
+    throw std::logic_error("invalid dex string");
+  }
+  return std::string_view(reinterpret_cast<char const *>(data.data()), static_cast<std::size_t>(end - data.begin()));
+}
+
+auto DexFile::isValidString(uint32_t const stringIndex) const -> bool {
+  auto offset = std::size_t{stringIds_[stringIndex]};
+  auto const utf16Length = readUleb128(bytes_, offset);
+  auto const length = utils::unicode::getMutf8Utf16Length(string(stringIndex));
+  return length && *length == utf16Length;
+}
+
+auto DexFile::typeDescriptor(uint32_t const typeIndex) const -> std::string_view { return string(typeIds_[typeIndex]); }
+
+auto DexFile::parameters(DexProtoId const &proto) const -> DexTable<uint16_t> { return typeList(proto.parametersOffset); }
+
+auto DexFile::typeList(uint32_t const offset) const -> DexTable<uint16_t> {
+  if (offset == 0) {
+    return DexTable<uint16_t>();
+  }
+  if (offset > bytes_.size() - sizeof(uint32_t)) {
+    throw std::logic_error("invalid dex type list");
+  }
+  auto size = uint32_t{0};
+  memcpy(&size, bytes_.data() + offset, sizeof(size));
+  return getTable<uint16_t>(bytes_, TableExtent{size, static_cast<uint32_t>(offset + sizeof(uint32_t))});
+}
+
+auto DexFile::fieldName(uint32_t const fieldIndex) const -> std::string_view { return string(fieldIds_[fieldIndex].nameIndex); }
+
+auto DexFile::methodName(uint32_t const methodIndex) const -> std::string_view { return string(methodIds_[methodIndex].nameIndex); }
+
+auto DexFile::methodSignature(uint32_t const methodIndex) const -> std::string {
+  auto const proto = protoIds_[methodIds_[methodIndex].protoIndex];
+  auto signature = std::string("(");
+  for (auto const parameter : parameters(proto)) {
+    signature += typeDescriptor(parameter);
+  }
+  signature += ')';
+  signature += typeDescriptor(proto.returnTypeIndex);
+  return signature;
+}
+
+auto ai::dex::getClassName(std::string_view const descriptor) -> std::string {
+  if (descriptor.size() < 2 || descriptor.front() != 'L' || descriptor.back() != ';') {
+    return std::string(descriptor);
+  }
+  auto name = std::string(descriptor.substr(1, descriptor.size() - 2));
+  std::replace(name.begin(), name.end(), '/', '.');
+  return name;
+}
+
+auto DexFile::classData(DexClassDef const &classDef) const -> DexClassData {
+  auto classData = DexClassData();
+  if (classDef.classDataOffset == 0) {
+    return classData;
+  }
+  auto offset = std::size_t{classDef.classDataOffset};
+  auto const staticFieldCount = readUleb128(bytes_, offset);
+  auto const instanceFieldCount = readUleb128(bytes_, offset);
+  auto const directMethodCount = readUleb128(bytes_, offset);
+  auto const virtualMethodCount = readUleb128(bytes_, offset);
+
+  //
+  // Every item takes at least a byte per field, which bounds the counts
+  // before anything is reserved for them.
+  //
+  if (uint64_t{staticFieldCount} + instanceFieldCount + directMethodCount + virtualMethodCount > bytes_.size() - offset) {
+    throw std::logic_error("invalid dex class data");
+  }
+  auto const readFields = [this, &offset](uint32_t const count, std::vector<DexEncodedField> &fields) {
+    fields.reserve(count);
+    auto fieldIndex = uint32_t{0};
+    for (auto field = uint32_t{0}; field < count; field++) {
+      fieldIndex += readUleb128(bytes_, offset);
+      fields.push_back(DexEncodedField{fieldIndex, readUleb128(bytes_, offset)});
+    }
+  };
+  auto const readMethods = [this, &offset](uint32_t const count, std::vector<DexEncodedMethod> &methods) {
+    methods.reserve(count);
+    auto methodIndex = uint32_t{0};
+    for (auto method = uint32_t{0}; method < count; method++) {
+      methodIndex += readUleb128(bytes_, offset);
+      auto const accessFlags = readUleb128(bytes_, offset);
+      methods.push_back(DexEncodedMethod{methodIndex, accessFlags, readUleb128(bytes_, offset)});
+    }
+  };
+  readFields(staticFieldCount, classData.staticFields);
+  readFields(instanceFieldCount, classData.instanceFields);
+  readMethods(directMethodCount, classData.directMethods);
+  readMethods(virtualMethodCount, classData.virtualMethods);
+  return classData;
+}
+
+auto DexFile::codeItem(uint32_t const codeOffset) const -> DexCodeItem {
+  if (codeOffset > bytes_.size() || bytes_.size() - codeOffset < CODE_ITEM_HEADER_SIZE) {
+    throw std::logic_error("invalid dex code item");
+  }
+  auto stream = DataStream(bytes_.subspan(codeOffset, CODE_ITEM_HEADER_SIZE));
+  auto code = DexCodeItem();
+  code.registersSize = stream.read<uint16_t>();
+  code.insSize = stream.read<uint16_t>();
+  code.outsSize = stream.read<uint16_t>();
+  auto const triesSize = stream.read<uint16_t>();
+  code.debugInfoOffset = stream.read<uint32_t>();
+  auto const instructionsSize = stream.read<uint32_t>();
+  auto const instructionsOffset = codeOffset + CODE_ITEM_HEADER_SIZE;
+  if (instructionsSize > (bytes_.size() - instructionsOffset) / sizeof(uint16_t)) {
+    throw std::logic_error("invalid dex code item");
+  }
+  code.instructions = getTable<uint16_t>(bytes_, TableExtent{instructionsSize, static_cast<uint32_t>(instructionsOffset)});
+
+  //
+  // Try items are 4 byte aligned, after a padding unit past an odd number
+  // of instructions.
+  //
+  auto const triesOffset = instructionsOffset + (std::size_t{instructionsSize} + instructionsSize % 2) * sizeof(uint16_t);
+  if (triesSize > 0) {
+    if (triesOffset > bytes_.size()) {
+      throw std::logic_error("invalid dex code item");
+    }
+    code.tries = getTable<DexTryItem>(bytes_, TableExtent{triesSize, static_cast<uint32_t>(triesOffset)});
+    code.handlersOffset = static_cast<uint32_t>(triesOffset + std::size_t{triesSize} * sizeof(DexTryItem));
+  }
+  return code;
+}
+
+auto DexFile::catchHandler(DexCodeItem const &code, uint16_t const handlerOffset) const -> DexCatchHandler {
+  auto offset = std::size_t{code.handlersOffset} + handlerOffset;
+  auto const size = readSleb128(bytes_, offset);
+  auto const handlerCount = size < 0 ? -static_cast<int64_t>(size) : size;
+  if (static_cast<uint64_t>(handlerCount) > bytes_.size() - std::min(offset, bytes_.size())) {
+    throw std::logic_error("invalid dex catch handler");
+  }
+  auto catchHandler = DexCatchHandler();
+  catchHandler.handlers.reserve(static_cast<std::size_t>(handlerCount));
+  for (auto handler = int64_t{0}; handler < handlerCount; handler++) {
+    auto const typeIndex = readUleb128(bytes_, offset);
+    catchHandler.handlers.emplace_back(typeIndex, readUleb128(bytes_, offset));
+  }
+  if (size <= 0) {
+    catchHandler.catchAllAddress = readUleb128(bytes_, offset);
+  }
+  return catchHandler;
+}
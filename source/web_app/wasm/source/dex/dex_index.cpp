@@ -0,0 +1,195 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <utility>
+
+#include "dex/dex_index.h"
+#include "dex/proguard_mapping.h"
+#include "utils/arena.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+
+using namespace ai::dex;
+
+namespace {
+
+//
+// Sorted names of one file.  Every name and container of the file lives in
+// its arena, which goes away in one piece once the names are merged.
+//
+struct DexFileIndex {
+
+  DexFileIndex() : arena(std::make_unique<ai::utils::Arena>()), classes(arena.get()), methods(arena.get()) {}
+
+  auto intern(std::pmr::string const &name) -> std::string_view {
+    auto *const data = static_cast<char *>(arena->allocate(name.size(), 1));
+    std::copy(name.begin(), name.end(), data);
+    return std::string_view(data, name.size());
+  }
+
+  std::unique_ptr<ai::utils::Arena> arena;
+
+  std::pmr::vector<std::pair<std::string_view, DexClassLocation>> classes;
+
+  std::pmr::vector<std::string_view> methods;
+};
+
+auto indexDexFile(DexFile const &dex, uint32_t const dexFile) -> DexFileIndex {
+  auto index = DexFileIndex();
+  auto *const arena = index.arena.get();
+  auto classNames = std::pmr::vector<std::string_view>(dex.typeIds().size(), arena);
+  auto name = std::pmr::string(arena);
+  auto const &classDefs = dex.classDefs();
+  for (auto classDef = uint32_t{0}; classDef < classDefs.size(); classDef++) {
+    auto const classIndex = classDefs[classDef].classIndex;
+    name.assign(getClassName(dex.typeDescriptor(classIndex)));
+    classNames[classIndex] = index.intern(name);
+    index.classes.emplace_back(classNames[classIndex], DexClassLocation{dexFile, classDef});
+  }
+
+  //
+  // One buffer is recycled for every method name, so only the interned
+  // copies take arena memory.
+  //
+  auto const &methodIds = dex.methodIds();
+  for (auto method = uint32_t{0}; method < methodIds.size(); method++) {
+    auto const classIndex = methodIds[method].classIndex;
+    if (classIndex < classNames.size() && !classNames[classIndex].empty()) {
+      name.assign(classNames[classIndex]);
+      name += '.';
+      name += dex.methodName(method);
+      name += dex.methodSignature(method);
+      index.methods.push_back(index.intern(name));
+    }
+  }
+
+  std::sort(index.classes.begin(), index.classes.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+  std::sort(index.methods.begin(), index.methods.end());
+  index.methods.erase(std::unique(index.methods.begin(), index.methods.end()), index.methods.end());
+  return index;
+}
+
+auto getPrefixRange(std::span<std::string_view const> const names, std::string_view const prefix) -> std::span<std::string_view const> {
+  auto const begin = std::lower_bound(names.begin(), names.end(), prefix);
+  auto const end = std::find_if_not(begin, names.end(), [prefix](auto const name) { return name.starts_with(prefix); });
+  return names.subspan(static_cast<std::size_t>(begin - names.begin()), static_cast<std::size_t>(end - begin));
+}
+
+} // namespace
+
+DexIndex::DexIndex(ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool) {
+  auto futures = std::vector<std::future<DexFileIndex>>();
+  for (auto dexFile = std::size_t{0}; dexFile < dexFiles.size(); dexFile++) {
+    futures.push_back(threadPool.submit([&dexFiles, dexFile] { return indexDexFile(dexFiles[dexFile], static_cast<uint32_t>(dexFile)); }));
+  }
+
+  for (auto &future : futures) {
+    future.wait();
+  }
+
+  //
+  // Merging the sorted runs in file order keeps the first definition of a
+  // class ahead of the others.
+  //
+  auto indexes = std::vector<DexFileIndex>();
+  auto classes = std::vector<std::pair<std::string_view, DexClassLocation>>();
+  auto methods = std::vector<std::string_view>();
+  for (auto &future : futures) {
+    auto &index = indexes.emplace_back(future.get());
+    auto const classesMiddle = static_cast<std::ptrdiff_t>(classes.size());
+    std::move(index.classes.begin(), index.classes.end(), std::back_inserter(classes));
+    std::inplace_merge(classes.begin(), classes.begin() + classesMiddle, classes.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+    auto const methodsMiddle = static_cast<std::ptrdiff_t>(methods.size());
+    std::move(index.methods.begin(), index.methods.end(), std::back_inserter(methods));
+    std::inplace_merge(methods.begin(), methods.begin() + methodsMiddle, methods.end());
+  }
+  classes.erase(std::unique(classes.begin(), classes.end(), [](auto const &a, auto const &b) { return a.first == b.first; }), classes.end());
+  methods.erase(std::unique(methods.begin(), methods.end()), methods.end());
+
+  auto size = std::size_t{0};
+  std::for_each(classes.begin(), classes.end(), [&size](auto const &entry) { size += entry.first.size(); });
+  std::for_each(methods.begin(), methods.end(), [&size](auto const &method) { size += method.size(); });
+  names_.reserve(size);
+  auto const intern = [this](std::string_view const name) {
+    auto const data = names_.data() + names_.size();
+    names_.insert(names_.end(), name.begin(), name.end());
+    return std::string_view(data, name.size());
+  };
+  classes_.reserve(classes.size());
+  classLocations_.reserve(classes.size());
+  for (auto const &[name, location] : classes) {
+    classes_.push_back(intern(name));
+    classLocations_.push_back(location);
+  }
+  methods_.reserve(methods.size());
+  for (auto const &method : methods) {
+    methods_.push_back(intern(method));
+  }
+  LOGD("DexIndex, dex files [{}] classes [{}] methods [{}] bytes [{}]", dexFiles.size(), classes_.size(), methods_.size(), names_.size());
+}
+
+auto DexIndex::findClass(std::string_view const name) const -> std::optional<DexClassLocation> {
+  auto const found = std::lower_bound(classes_.begin(), classes_.end(), name);
+  if (found == classes_.end() || *found != name) {
+    return std::nullopt;
+  }
+  return classLocations_[static_cast<std::size_t>(found - classes_.begin())];
+}
+
+auto DexIndex::findOriginalClass(std::string_view const originalName, ProguardMapping const &mapping) const -> std::optional<DexClassLocation> {
+  auto const mapped = mapping.findOriginalClass(originalName);
+  return findClass(mapped ? mapping.classes()[*mapped].obfuscatedName : originalName);
+}
+
+auto DexIndex::findClasses(std::string_view const prefix) const -> std::span<std::string_view const> { return getPrefixRange(classes_, prefix); }
+
+auto DexIndex::findMethods(std::string_view const prefix) const -> std::span<std::string_view const> { return getPrefixRange(methods_, prefix); }
+
+auto DexIndex::packageChildren(std::string_view const package) const -> std::vector<DexPackageChild> {
+  auto const prefix = package.empty() ? std::string() : std::string(package) + '.';
+  auto const range = findClasses(prefix);
+  auto children = std::vector<DexPackageChild>();
+  for (auto name = range.begin(); name != range.end();) {
+    auto const rest = name->substr(prefix.size());
+    auto const separator = rest.find('.');
+    if (separator == std::string_view::npos) {
+      children.push_back(DexPackageChild{rest, false});
+      name++;
+      continue;
+    }
+    auto const child = rest.substr(0, separator);
+    children.push_back(DexPackageChild{child, true});
+
+    //
+    // Every class of the subpackage sorts below its name followed by '/',
+    // the character after '.'.
+    //
+    name = std::lower_bound(name, range.end(), prefix + std::string(child) + '/');
+  }
+  return children;
+}
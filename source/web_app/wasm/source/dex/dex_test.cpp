@@ -0,0 +1,378 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "apk/apk.h"
+#include "dex/apk_dex_files.h"
+#include "dex/call_graph.h"
+#include "dex/dex_file.h"
+#include "dex/dex_index.h"
+#include "dex/disassembler.h"
+#include "dex/hook_table.h"
+#include "dex/proguard_mapping.h"
+#include "dex/search_index.h"
+#include "utils/hook_table_format.h"
+#include "instruction_set.h"
+#include "utils/thread_pool.h"
+#include "utils/unicode.h"
+#include "utils/log.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct TestEnvironment {
+  std::string testsDir;
+};
+
+std::unique_ptr<TestEnvironment> gTestEnvironment;
+
+auto setEnvironmentIfReady() -> bool {
+  auto const testsDir = std::getenv("AI_TESTS_DIR");
+  if (testsDir == nullptr) {
+    LOGE("tests directory is not defined");
+    return false;
+  }
+
+  gTestEnvironment = std::make_unique<TestEnvironment>();
+  gTestEnvironment->testsDir = testsDir;
+
+  return true;
+}
+
+fs::path getTestApkPath(char const *fileName) { return fs::path(gTestEnvironment->testsDir) / "resources" / "apks" / fileName; }
+
+} // namespace
+
+TEST(DexFile, readClassesOfReleaseApk_ClassesAndMethodsAreListed) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  ASSERT_EQ(dexFiles.size(), 1);
+  EXPECT_EQ(dexFiles.name(0), "classes.dex");
+
+  auto const &dex = dexFiles[0];
+  EXPECT_EQ(dex.header().version, "035");
+  auto const &classDefs = dex.classDefs();
+  EXPECT_TRUE(std::any_of(classDefs.begin(), classDefs.end(),
+                          [&dex](auto const &classDef) { return dex.typeDescriptor(classDef.classIndex) == "Lorg/fdroid/fdroid/FDroidApp;"; }));
+
+  auto const &methodIds = dex.methodIds();
+  ASSERT_GT(methodIds.size(), 0);
+  EXPECT_EQ(dex.typeDescriptor(methodIds[0].classIndex), "Landroid/animation/Animator;");
+  EXPECT_EQ(dex.methodName(0), "addListener");
+  EXPECT_EQ(dex.methodSignature(0), "(Landroid/animation/Animator$AnimatorListener;)V");
+  EXPECT_THROW(dex.methodName(methodIds.size()), std::out_of_range);
+}
+
+TEST(DexFile, readTruncatedDex_InvalidDexIsRejected) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const contents = apk.getFileContent("classes.dex");
+  EXPECT_THROW(ai::dex::DexFile(std::span(contents).first(0x40)), std::logic_error);
+  EXPECT_THROW(ai::dex::DexFile(std::span(contents).first(contents.size() / 2)), std::logic_error);
+}
+
+TEST(DexFile, decodeStringsOfReleaseApk_MutF8IsValidatedAndDecoded) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  auto const &dex = dexFiles[0];
+  auto invalidStrings = size_t{0};
+  for (auto stringIndex = uint32_t{0}; stringIndex < dex.stringCount(); stringIndex++) {
+    if (!dex.isValidString(stringIndex)) {
+      invalidStrings++;
+    }
+  }
+  EXPECT_EQ(invalidStrings, 0);
+
+  using namespace ai::utils::unicode;
+  auto const ascii = std::string(100, 'x') + "\xc3\xa9" + std::string(40, 'y');
+  EXPECT_EQ(getMutf8Utf16Length(ascii), 141);
+  EXPECT_EQ(mutf8ToUtf8(ascii), ascii);
+  EXPECT_EQ(mutf8ToUtf16(ascii), toUtf16(ascii));
+  EXPECT_EQ(mutf8ToUtf8("\xc0\x80"), std::string(1, '\0'));
+  EXPECT_EQ(mutf8ToUtf8("\xed\xa0\xbd\xed\xb8\x80"), "\xf0\x9f\x98\x80");
+  EXPECT_EQ(mutf8ToUtf16("\xed\xa0\xbd"), std::u16string(1, char16_t{0xd83d}));
+  EXPECT_EQ(mutf8ToUtf8("\xed\xa0\xbd!"), "\xef\xbf\xbd!");
+  EXPECT_FALSE(getMutf8Utf16Length("\xf0\x9f\x98\x80").has_value());
+  EXPECT_FALSE(getMutf8Utf16Length(std::string(40, 'z') + '\0' + std::string(40, 'z')).has_value());
+  EXPECT_FALSE(getMutf8Utf16Length("\xc1\x81").has_value());
+}
+
+TEST(DexFile, payloadPastTheInstructions_PayloadIsRejected) {
+  auto const units = std::vector<uint16_t>{ai::dex::PACKED_SWITCH_PAYLOAD, 2, 0, 0, 1, 0, 2, 0, ai::dex::FILL_ARRAY_DATA_PAYLOAD, 0xffff, 0xffff, 0xffff};
+  auto const instructions = ai::dex::DexTable<uint16_t>(std::as_bytes(std::span(units)));
+  EXPECT_EQ(ai::dex::getPayloadSize(instructions, 0), 8U);
+  EXPECT_THROW(ai::dex::getPayloadSize(instructions, 8), std::out_of_range);
+}
+
+TEST(DexIndex, indexReleaseApk_ClassesAndMethodsAreFoundByPrefix) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const index = ai::dex::DexIndex(dexFiles, threadPool);
+
+  EXPECT_EQ(index.classes().size(), dexFiles[0].classDefs().size());
+  EXPECT_TRUE(std::is_sorted(index.classes().begin(), index.classes().end()));
+  auto const location = index.findClass("org.fdroid.fdroid.FDroidApp");
+  ASSERT_TRUE(location.has_value());
+  auto const &dex = dexFiles[location->dexFile];
+  EXPECT_EQ(dex.typeDescriptor(dex.classDefs()[location->classDef].classIndex), "Lorg/fdroid/fdroid/FDroidApp;");
+  EXPECT_FALSE(index.findClass("org.fdroid.fdroid").has_value());
+
+  auto const onCreate = index.findMethods("org.fdroid.fdroid.FDroidApp.onCreate(");
+  ASSERT_EQ(onCreate.size(), 1);
+  EXPECT_EQ(onCreate.front(), "org.fdroid.fdroid.FDroidApp.onCreate()V");
+
+  auto const root = index.packageChildren("");
+  EXPECT_TRUE(std::any_of(root.begin(), root.end(), [](auto const &child) { return child.name == "org" && child.isPackage; }));
+  auto const fdroid = index.packageChildren("org.fdroid.fdroid");
+  EXPECT_TRUE(std::any_of(fdroid.begin(), fdroid.end(), [](auto const &child) { return child.name == "FDroidApp" && !child.isPackage; }));
+}
+
+TEST(Disassembler, getSmaliPathOfEscapingDescriptor_PathStaysInTheDirectory) {
+  EXPECT_EQ(ai::dex::getSmaliPath("smali/", "Lorg/fdroid/FDroidApp;"), "smali/org/fdroid/FDroidApp.smali");
+  EXPECT_EQ(ai::dex::getSmaliPath("smali/", "L../../etc/passwd;"), "smali/%2E%2E/%2E%2E/etc/passwd.smali");
+  EXPECT_EQ(ai::dex::getSmaliPath("smali/", "L/tmp/./a;"), "smali/%00/tmp/%2E/a.smali");
+  EXPECT_EQ(ai::dex::getSmaliPath("smali/", "La//b/;"), "smali/a/%00/b/%00.smali");
+  EXPECT_EQ(ai::dex::getSmaliPath("smali/", "L..\\a%;"), "smali/..%5Ca%25.smali");
+}
+
+TEST(Disassembler, disassembleReleaseApk_EveryClassIsStreamedInOrder) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const &dex = dexFiles[0];
+  auto classDef = uint32_t{0};
+  auto invalidClasses = size_t{0};
+  auto fdroidApp = std::string();
+  ai::dex::disassemble(dexFiles, threadPool, [&](std::string_view const descriptor, std::string_view const smali) {
+    ASSERT_LT(classDef, dex.classDefs().size());
+    EXPECT_EQ(descriptor, dex.typeDescriptor(dex.classDefs()[classDef++].classIndex));
+    EXPECT_TRUE(smali.starts_with(".class "));
+    if (smali.find("# invalid code") != std::string_view::npos || smali.find("# unused opcode") != std::string_view::npos) {
+      invalidClasses++;
+    }
+    if (descriptor == "Lorg/fdroid/fdroid/FDroidApp;") {
+      fdroidApp = smali;
+    }
+  });
+  EXPECT_EQ(classDef, dex.classDefs().size());
+  EXPECT_EQ(invalidClasses, 0);
+  EXPECT_NE(fdroidApp.find(".method public onCreate()V"), std::string::npos);
+  EXPECT_NE(fdroidApp.find("invoke-super {v"), std::string::npos);
+}
+
+TEST(SearchIndex, searchReleaseApk_MatchesAreFoundAndIndexIsCached) {
+  auto const cacheDirectory = fs::temp_directory_path() / "searchReleaseApk_cache";
+  fs::remove_all(cacheDirectory);
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string(), cacheDirectory.string());
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  auto threadPool = ai::utils::ThreadPool(4);
+
+  auto const index = ai::dex::SearchIndex::load(apk, dexFiles, threadPool);
+  auto const matches = index.search("HTTPS://F-DROID.ORG");
+  ASSERT_FALSE(matches.empty());
+  EXPECT_TRUE(std::all_of(matches.begin(), matches.end(), [](auto const &match) { return match.text.find("https://f-droid.org") != std::string_view::npos; }));
+  EXPECT_TRUE(index.search("HTTPS://F-DROID.ORG", {true, 1000}).empty());
+  EXPECT_EQ(index.search("https://", {false, 2}).size(), 2);
+  EXPECT_TRUE(index.search("no such text anywhere in the apk").empty());
+
+  auto const cachedIndex = ai::dex::SearchIndex::load(apk, dexFiles, threadPool);
+  EXPECT_EQ(cachedIndex.documentCount(), index.documentCount());
+  EXPECT_EQ(cachedIndex.search("https://f-droid.org").size(), matches.size());
+  auto const encoded = index.encode();
+  EXPECT_THROW(ai::dex::SearchIndex(std::span(encoded).first(64)), std::exception);
+  fs::remove_all(cacheDirectory);
+}
+
+TEST(CallGraph, buildReleaseApkGraph_CallersAndCalleesAreSymmetric) {
+  auto const cacheDirectory = fs::temp_directory_path() / "buildReleaseApkGraph_cache";
+  fs::remove_all(cacheDirectory);
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string(), cacheDirectory.string());
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  auto threadPool = ai::utils::ThreadPool(4);
+
+  auto const graph = ai::dex::CallGraph::load(apk, dexFiles, threadPool);
+  ASSERT_GT(graph.edgeCount(), 0);
+  auto const onCreate = graph.findMethod("org.fdroid.fdroid.FDroidApp.onCreate()V");
+  auto const superOnCreate = graph.findMethod("android.app.Application.onCreate()V");
+  ASSERT_TRUE(onCreate.has_value());
+  ASSERT_TRUE(superOnCreate.has_value());
+  EXPECT_EQ(graph.methodName(*onCreate), "org.fdroid.fdroid.FDroidApp.onCreate()V");
+  auto const callees = graph.callees(*onCreate);
+  EXPECT_TRUE(std::binary_search(callees.begin(), callees.end(), *superOnCreate));
+  auto const callers = graph.callers(*superOnCreate);
+  EXPECT_TRUE(std::binary_search(callers.begin(), callers.end(), *onCreate));
+  EXPECT_FALSE(graph.findMethod("org.fdroid.fdroid.FDroidApp.noSuchMethod()V").has_value());
+
+  auto const cachedGraph = ai::dex::CallGraph::load(apk, dexFiles, threadPool);
+  EXPECT_EQ(cachedGraph.methodCount(), graph.methodCount());
+  EXPECT_EQ(cachedGraph.edgeCount(), graph.edgeCount());
+  auto const encoded = graph.encode();
+  EXPECT_EQ(cachedGraph.encode(), encoded);
+  EXPECT_THROW(ai::dex::CallGraph(std::span(encoded).first(64)), std::exception);
+  fs::remove_all(cacheDirectory);
+}
+
+TEST(HookTable, resolveReleaseApkSpecs_TableRoundTripsAndMethodsAreFound) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  auto threadPool = ai::utils::ThreadPool(4);
+  auto const index = ai::dex::DexIndex(dexFiles, threadPool);
+  auto const specs = std::vector<std::string>{"org.fdroid.fdroid.FDroidApp.onCreate()V", "org.fdroid.fdroid.FDroidApp.onCreate", "org.fdroid.fdroid.data",
+                                              "org.fdroid.fdroid.FDroidApp.noSuchMethod"};
+
+  auto const table = ai::dex::HookTable(dexFiles, index, specs);
+  ASSERT_EQ(table.unmatchedSpecs().size(), 1U);
+  EXPECT_EQ(table.unmatchedSpecs().front(), "org.fdroid.fdroid.FDroidApp.noSuchMethod");
+  ASSERT_EQ(table.dexFiles().size(), dexFiles.size());
+  EXPECT_EQ(table.dexFiles()[0].checksum, dexFiles[0].header().checksum);
+  auto const fdroidApp = std::find_if(table.classes().begin(), table.classes().end(), [](auto const &hookClass) { return hookClass.descriptor == "Lorg/fdroid/fdroid/FDroidApp;"; });
+  ASSERT_NE(fdroidApp, table.classes().end());
+  ASSERT_EQ(fdroidApp->methods.size(), 1U);
+  EXPECT_EQ(fdroidApp->methods.front().name, "onCreate");
+  EXPECT_EQ(fdroidApp->methods.front().signature, "()V");
+  EXPECT_TRUE(std::all_of(table.classes().begin(), table.classes().end(), [](auto const &hookClass) {
+    return hookClass.descriptor == "Lorg/fdroid/fdroid/FDroidApp;" || hookClass.descriptor.starts_with("Lorg/fdroid/fdroid/data/");
+  }));
+  EXPECT_GT(table.methodCount(), 1U);
+
+  auto const encoded = table.encode();
+  auto const decoded = ai::dex::HookTable(encoded);
+  EXPECT_EQ(decoded.methodCount(), table.methodCount());
+  EXPECT_EQ(decoded.encode(), encoded);
+  EXPECT_THROW(ai::dex::HookTable(std::span(encoded).first(64)), std::exception);
+}
+
+TEST(HookTable, decodeEncodedTableAsTheAgentDoes_ClassesAndMethodsAreKept) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  auto threadPool = ai::utils::ThreadPool(2);
+  auto const index = ai::dex::DexIndex(dexFiles, threadPool);
+  auto const table = ai::dex::HookTable(dexFiles, index, std::vector<std::string>{"org.fdroid.fdroid.FDroidApp"});
+  auto encoded = table.encode();
+
+  //
+  // The agent parses the table with decodeHookTable() of the shared codec.
+  //
+  auto const decoded = ai::utils::decodeHookTable(encoded);
+  ASSERT_EQ(decoded.dexFiles.size(), table.dexFiles().size());
+  EXPECT_EQ(decoded.dexFiles[0].name, table.dexFiles()[0].name);
+  EXPECT_EQ(decoded.dexFiles[0].checksum, table.dexFiles()[0].checksum);
+  ASSERT_EQ(decoded.classes.size(), 1U);
+  EXPECT_EQ(decoded.classes[0].descriptor, "Lorg/fdroid/fdroid/FDroidApp;");
+  EXPECT_EQ(decoded.classes[0].classDef, table.classes()[0].classDef);
+  ASSERT_EQ(decoded.classes[0].methods.size(), table.classes()[0].methods.size());
+  for (auto i = size_t{0}; i < decoded.classes[0].methods.size(); i++) {
+    EXPECT_EQ(decoded.classes[0].methods[i].methodIndex, table.classes()[0].methods[i].methodIndex);
+    EXPECT_EQ(decoded.classes[0].methods[i].accessFlags, table.classes()[0].methods[i].accessFlags);
+    EXPECT_EQ(decoded.classes[0].methods[i].name, table.classes()[0].methods[i].name);
+    EXPECT_EQ(decoded.classes[0].methods[i].signature, table.classes()[0].methods[i].signature);
+  }
+  EXPECT_EQ(ai::utils::encodeHookTable(decoded), encoded);
+
+  encoded.push_back(std::byte{0});
+  EXPECT_THROW(ai::utils::decodeHookTable(encoded), std::runtime_error);
+}
+
+TEST(ProguardMapping, loadMapping_NamesAreFoundInBothDirections) {
+  auto const pathToMapping = fs::temp_directory_path() / "loadMapping_NamesAreFoundInBothDirections.txt";
+  {
+    auto mapping = std::ofstream(pathToMapping);
+    mapping << "# compiler: R8\n"
+               "org.fdroid.fdroid.FDroidApp -> a.a:\n"
+               "# {\"id\":\"sourceFile\",\"fileName\":\"FDroidApp.java\"}\n"
+               "    int count -> a\n"
+               "    1:5:void onCreate(android.os.Bundle):10:14 -> a\n"
+               "    6:6:void helper(int,java.lang.String):20:20 -> a\n"
+               "    6:6:void onCreate(android.os.Bundle):15 -> a\n"
+               "    java.lang.String getName() -> b\n"
+               "org.fdroid.fdroid.Utils -> a.b:\n"
+               "    void log(java.lang.String) -> c\n";
+  }
+
+  auto threadPool = ai::utils::ThreadPool(2);
+  auto const mapping = ai::dex::ProguardMapping(pathToMapping.string(), threadPool);
+  ASSERT_EQ(mapping.classes().size(), 2);
+  EXPECT_EQ(mapping.members().size(), 6);
+  EXPECT_EQ(mapping.deobfuscateClassName("a.b"), "org.fdroid.fdroid.Utils");
+  EXPECT_EQ(mapping.deobfuscateClassName("a.c"), "a.c");
+
+  auto const app = mapping.findOriginalClass("org.fdroid.fdroid.FDroidApp");
+  ASSERT_TRUE(app);
+  EXPECT_EQ(mapping.classes()[*app].obfuscatedName, "a.a");
+
+  auto const frames = mapping.findObfuscatedMembers(*app, "a");
+  ASSERT_EQ(frames.size(), 4);
+  EXPECT_FALSE(frames[0]->isMethod);
+  EXPECT_EQ(frames[0]->type, "int");
+  EXPECT_EQ(frames[1]->originalName, "onCreate");
+  EXPECT_EQ(frames[1]->arguments, "android.os.Bundle");
+  EXPECT_EQ(frames[2]->originalName, "helper");
+  EXPECT_EQ(frames[2]->arguments, "int,java.lang.String");
+
+  auto const onCreate = mapping.findOriginalMembers(*app, "onCreate");
+  ASSERT_EQ(onCreate.size(), 2);
+  EXPECT_EQ(onCreate[0]->obfuscatedName, "a");
+  EXPECT_TRUE(mapping.findObfuscatedMembers(*app, "c").empty());
+  fs::remove(pathToMapping);
+}
+
+TEST(DexIndex, findOriginalClassOfMapping_ObfuscatedClassIsFound) {
+  auto const pathToMapping = fs::temp_directory_path() / "findOriginalClassOfMapping_ObfuscatedClassIsFound.txt";
+  {
+    auto mapping = std::ofstream(pathToMapping);
+    mapping << "com.example.Application -> org.fdroid.fdroid.FDroidApp:\n"
+               "    void onCreate() -> onCreate\n";
+  }
+
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  auto threadPool = ai::utils::ThreadPool(2);
+  auto const index = ai::dex::DexIndex(dexFiles, threadPool);
+  auto const mapping = ai::dex::ProguardMapping(pathToMapping.string(), threadPool);
+
+  auto const location = index.findOriginalClass("com.example.Application", mapping);
+  ASSERT_TRUE(location.has_value());
+  EXPECT_EQ(location->dexFile, index.findClass("org.fdroid.fdroid.FDroidApp")->dexFile);
+  EXPECT_EQ(location->classDef, index.findClass("org.fdroid.fdroid.FDroidApp")->classDef);
+  EXPECT_TRUE(index.findOriginalClass("org.fdroid.fdroid.Utils", mapping).has_value());
+  EXPECT_FALSE(index.findOriginalClass("com.example.Missing", mapping).has_value());
+  fs::remove(pathToMapping);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  if (setEnvironmentIfReady()) {
+    return RUN_ALL_TESTS();
+  } else {
+    return -1;
+  }
+}
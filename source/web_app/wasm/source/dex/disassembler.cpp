@@ -0,0 +1,723 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "apk/zip_stream_writer.h"
+#include "dex/disassembler.h"
+#include "instruction_set.h"
+#include "utils/arena.h"
+#include "utils/format.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
+
+using namespace ai::dex;
+
+namespace {
+
+//
+// Class defs a task disassembles.
+//
+static constexpr uint32_t CLASSES_PER_TASK = 64;
+
+//
+// Tasks in flight per worker of the pool.
+//
+static constexpr size_t TASKS_PER_WORKER = 2;
+
+enum AccessFlagTarget : uint8_t { ClassFlag = 1, FieldFlag = 2, MethodFlag = 4 };
+
+struct AccessFlag {
+
+  uint32_t flag;
+
+  std::string_view name;
+
+  uint8_t targets;
+};
+
+//
+// In the order smali writes them.
+//
+static constexpr auto ACCESS_FLAGS = std::array<AccessFlag, 19>{{
+    {0x1, "public", ClassFlag | FieldFlag | MethodFlag},
+    {0x2, "private", ClassFlag | FieldFlag | MethodFlag},
+    {0x4, "protected", ClassFlag | FieldFlag | MethodFlag},
+    {0x8, "static", ClassFlag | FieldFlag | MethodFlag},
+    {0x10, "final", ClassFlag | FieldFlag | MethodFlag},
+    {0x20, "synchronized", MethodFlag},
+    {0x40, "volatile", FieldFlag},
+    {0x40, "bridge", MethodFlag},
+    {0x80, "transient", FieldFlag},
+    {0x80, "varargs", MethodFlag},
+    {0x100, "native", MethodFlag},
+    {0x200, "interface", ClassFlag},
+    {0x400, "abstract", ClassFlag | MethodFlag},
+    {0x800, "strictfp", MethodFlag},
+    {0x1000, "synthetic", ClassFlag | FieldFlag | MethodFlag},
+    {0x2000, "annotation", ClassFlag},
+    {0x4000, "enum", ClassFlag | FieldFlag},
+    {0x10000, "constructor", MethodFlag},
+    {0x20000, "declared-synchronized", MethodFlag},
+}};
+
+auto appendAccessFlags(std::pmr::string &output, uint32_t const accessFlags, AccessFlagTarget const target) -> void {
+  for (auto const &accessFlag : ACCESS_FLAGS) {
+    if ((accessFlags & accessFlag.flag) != 0 && (accessFlag.targets & target) != 0) {
+      output += accessFlag.name;
+      output += ' ';
+    }
+  }
+}
+
+auto appendStringLiteral(std::pmr::string &output, std::string_view const text) -> void {
+  output += '"';
+  for (auto const c : text) {
+    switch (c) {
+    case '"':
+      output += "\\\"";
+      break;
+    case '\\':
+      output += "\\\\";
+      break;
+    case '\n':
+      output += "\\n";
+      break;
+    case '\r':
+      output += "\\r";
+      break;
+    case '\t':
+      output += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        ai::utils::format::appendTo(output, "\\u{:04x}", static_cast<unsigned char>(c));
+      } else {
+        output += c;
+      }
+    }
+  }
+  output += '"';
+}
+
+auto appendLiteral(std::pmr::string &output, int64_t const value, bool const isWide) -> void {
+  if (value < 0) {
+    ai::utils::format::appendTo(output, "-0x{:x}", static_cast<uint64_t>(-(value + 1)) + 1);
+  } else {
+    ai::utils::format::appendTo(output, "0x{:x}", static_cast<uint64_t>(value));
+  }
+  if (isWide) {
+    output += 'L';
+  }
+}
+
+auto appendLabel(std::pmr::string &output, uint32_t const address) -> void { ai::utils::format::appendTo(output, ":addr_{:x}", address); }
+
+auto appendMethodReference(std::pmr::string &output, DexFile const &dex, uint32_t const methodIndex) -> void {
+  output += dex.typeDescriptor(dex.methodIds()[methodIndex].classIndex);
+  output += "->";
+  output += dex.methodName(methodIndex);
+  output += dex.methodSignature(methodIndex);
+}
+
+auto appendProto(std::pmr::string &output, DexFile const &dex, uint32_t const protoIndex) -> void {
+  auto const proto = dex.protoIds()[protoIndex];
+  output += '(';
+  for (auto const parameter : dex.parameters(proto)) {
+    output += dex.typeDescriptor(parameter);
+  }
+  output += ')';
+  output += dex.typeDescriptor(proto.returnTypeIndex);
+}
+
+auto appendReference(std::pmr::string &output, DexFile const &dex, Reference const reference, uint32_t const index) -> void {
+  switch (reference) {
+  case Reference::None:
+    break;
+  case Reference::String:
+    appendStringLiteral(output, dex.string(index));
+    break;
+  case Reference::Type:
+    output += dex.typeDescriptor(index);
+    break;
+  case Reference::Field: {
+    auto const field = dex.fieldIds()[index];
+    output += dex.typeDescriptor(field.classIndex);
+    output += "->";
+    output += dex.fieldName(index);
+    output += ':';
+    output += dex.typeDescriptor(field.typeIndex);
+    break;
+  }
+  case Reference::Method:
+    appendMethodReference(output, dex, index);
+    break;
+  case Reference::CallSite:
+    ai::utils::format::appendTo(output, "call_site_{}", index);
+    break;
+  case Reference::MethodHandle:
+    ai::utils::format::appendTo(output, "method_handle_{}", index);
+    break;
+  case Reference::Proto:
+    appendProto(output, dex, index);
+    break;
+  }
+}
+
+//
+// Decoding state of one method.
+//
+class MethodDisassembler final {
+public:
+  MethodDisassembler(DexFile const &dex, DexCodeItem const &code, std::pmr::memory_resource *const memory)
+      : dex_(dex), code_(code), labels_(memory), switches_(memory) {}
+
+  auto disassemble(std::pmr::string &output) -> void {
+    findLabels();
+    auto const size = code_.instructions.size();
+    for (auto address = uint32_t{0}; address < size;) {
+      if (std::binary_search(labels_.begin(), labels_.end(), address)) {
+        output += "    ";
+        appendLabel(output, address);
+        output += '\n';
+      }
+      auto const unit = code_.instructions[address];
+      if (auto const payloadSize = getPayloadSize(code_.instructions, address); payloadSize > 0) {
+        appendPayload(output, address, unit);
+        address += payloadSize;
+        continue;
+      }
+      appendInstruction(output, address);
+      address += getFormatSize(OPCODES[unit & 0xff].format);
+    }
+    if (std::binary_search(labels_.begin(), labels_.end(), size)) {
+      output += "    ";
+      appendLabel(output, size);
+      output += '\n';
+    }
+    appendCatches(output);
+  }
+
+private:
+  auto readUnit(uint32_t const address) const -> uint16_t { return code_.instructions[address]; }
+
+  auto readInt32(uint32_t const address) const -> int32_t { return static_cast<int32_t>(readUnit(address) | static_cast<uint32_t>(readUnit(address + 1)) << 16); }
+
+  auto findLabels() -> void {
+    auto const size = code_.instructions.size();
+    for (auto address = uint32_t{0}; address < size;) {
+      auto const unit = code_.instructions[address];
+      if (auto const payloadSize = getPayloadSize(code_.instructions, address); payloadSize > 0) {
+        address += payloadSize;
+        continue;
+      }
+      auto const opcode = static_cast<uint8_t>(unit & 0xff);
+      switch (OPCODES[opcode].format) {
+      case Format::F10t:
+        labels_.push_back(address + static_cast<uint32_t>(static_cast<int8_t>(unit >> 8)));
+        break;
+      case Format::F20t:
+      case Format::F21t:
+      case Format::F22t:
+        labels_.push_back(address + static_cast<uint32_t>(static_cast<int16_t>(readUnit(address + 1))));
+        break;
+      case Format::F30t:
+      case Format::F31t: {
+        auto const target = address + static_cast<uint32_t>(readInt32(address + 1));
+        labels_.push_back(target);
+        if (opcode == PACKED_SWITCH || opcode == SPARSE_SWITCH) {
+          switches_.emplace_back(target, address);
+        }
+        break;
+      }
+      default:
+        break;
+      }
+      address += getFormatSize(OPCODES[opcode].format);
+    }
+
+    //
+    // Case targets are relative to the switch, not to its payload.
+    //
+    for (auto const &[payload, switchAddress] : switches_) {
+      if (payload >= size) {
+        continue;
+      }
+      auto const unit = readUnit(payload);
+      auto const caseCount = uint32_t{readUnit(payload + 1)};
+      auto const firstTarget = unit == PACKED_SWITCH_PAYLOAD ? payload + 4 : payload + 2 + caseCount * 2;
+      if (unit == PACKED_SWITCH_PAYLOAD || unit == SPARSE_SWITCH_PAYLOAD) {
+        for (auto caseIndex = uint32_t{0}; caseIndex < caseCount; caseIndex++) {
+          labels_.push_back(switchAddress + static_cast<uint32_t>(readInt32(firstTarget + caseIndex * 2)));
+        }
+      }
+    }
+    for (auto const &tryItem : code_.tries) {
+      labels_.push_back(tryItem.startAddress);
+      labels_.push_back(tryItem.startAddress + tryItem.instructionCount);
+      auto const catchHandler = dex_.catchHandler(code_, tryItem.handlerOffset);
+      for (auto const &[typeIndex, handlerAddress] : catchHandler.handlers) {
+        labels_.push_back(handlerAddress);
+      }
+      if (catchHandler.catchAllAddress) {
+        labels_.push_back(*catchHandler.catchAllAddress);
+      }
+    }
+    std::sort(labels_.begin(), labels_.end());
+    labels_.erase(std::unique(labels_.begin(), labels_.end()), labels_.end());
+    std::sort(switches_.begin(), switches_.end());
+  }
+
+  auto appendRegisters(std::pmr::string &output, uint16_t const unit0, uint16_t const unit2) const -> void {
+    auto const registers = std::array<uint32_t, 5>{uint32_t{unit2} & 0xfu, uint32_t{unit2} >> 4 & 0xfu, uint32_t{unit2} >> 8 & 0xfu, uint32_t{unit2} >> 12,
+                                                   uint32_t{unit0} >> 8 & 0xfu};
+    auto const count = std::min<uint32_t>(unit0 >> 12, registers.size());
+    output += '{';
+    for (auto index = uint32_t{0}; index < count; index++) {
+      ai::utils::format::appendTo(output, "{}v{}", index == 0 ? "" : ", ", registers[index]);
+    }
+    output += '}';
+  }
+
+  auto appendRegisterRange(std::pmr::string &output, uint32_t const count, uint32_t const first) const -> void {
+    if (count == 0) {
+      output += "{}";
+    } else {
+      ai::utils::format::appendTo(output, "{{v{} .. v{}}}", first, first + count - 1);
+    }
+  }
+
+  auto appendInstruction(std::pmr::string &output, uint32_t const address) const -> void {
+    auto const unit0 = readUnit(address);
+    auto const &opcode = OPCODES[unit0 & 0xff];
+    if (opcode.format == Format::Unused) {
+      ai::utils::format::appendTo(output, "    # unused opcode 0x{:02x}\n", unit0 & 0xff);
+      return;
+    }
+    output += "    ";
+    output += opcode.name;
+    output += ' ';
+    auto const a = uint32_t{unit0} >> 8;
+    auto const appendReferenceOperand = [&](uint32_t const index) { appendReference(output, dex_, opcode.reference, index); };
+    switch (opcode.format) {
+    case Format::Unused:
+    case Format::F10x:
+      output.pop_back();
+      break;
+    case Format::F12x:
+      ai::utils::format::appendTo(output, "v{}, v{}", a & 0xf, a >> 4);
+      break;
+    case Format::F11n:
+      ai::utils::format::appendTo(output, "v{}, ", a & 0xf);
+      appendLiteral(output, static_cast<int16_t>(unit0) >> 12, opcode.isWide);
+      break;
+    case Format::F11x:
+      ai::utils::format::appendTo(output, "v{}", a);
+      break;
+    case Format::F10t:
+      appendLabel(output, address + static_cast<uint32_t>(static_cast<int8_t>(a)));
+      break;
+    case Format::F20t:
+      appendLabel(output, address + static_cast<uint32_t>(static_cast<int16_t>(readUnit(address + 1))));
+      break;
+    case Format::F22x:
+      ai::utils::format::appendTo(output, "v{}, v{}", a, readUnit(address + 1));
+      break;
+    case Format::F21t:
+      ai::utils::format::appendTo(output, "v{}, ", a);
+      appendLabel(output, address + static_cast<uint32_t>(static_cast<int16_t>(readUnit(address + 1))));
+      break;
+    case Format::F21s:
+      ai::utils::format::appendTo(output, "v{}, ", a);
+      appendLiteral(output, static_cast<int16_t>(readUnit(address + 1)), opcode.isWide);
+      break;
+    case Format::F21h:
+      ai::utils::format::appendTo(output, "v{}, ", a);
+      appendLiteral(output, static_cast<int64_t>(static_cast<int16_t>(readUnit(address + 1))) * (opcode.isWide ? int64_t{1} << 48 : int64_t{1} << 16),
+                    opcode.isWide);
+      break;
+    case Format::F21c:
+      ai::utils::format::appendTo(output, "v{}, ", a);
+      appendReferenceOperand(readUnit(address + 1));
+      break;
+    case Format::F23x:
+      ai::utils::format::appendTo(output, "v{}, v{}, v{}", a, readUnit(address + 1) & 0xff, readUnit(address + 1) >> 8);
+      break;
+    case Format::F22b:
+      ai::utils::format::appendTo(output, "v{}, v{}, ", a, readUnit(address + 1) & 0xff);
+      appendLiteral(output, static_cast<int8_t>(readUnit(address + 1) >> 8), false);
+      break;
+    case Format::F22t:
+      ai::utils::format::appendTo(output, "v{}, v{}, ", a & 0xf, a >> 4);
+      appendLabel(output, address + static_cast<uint32_t>(static_cast<int16_t>(readUnit(address + 1))));
+      break;
+    case Format::F22s:
+      ai::utils::format::appendTo(output, "v{}, v{}, ", a & 0xf, a >> 4);
+      appendLiteral(output, static_cast<int16_t>(readUnit(address + 1)), false);
+      break;
+    case Format::F22c:
+      ai::utils::format::appendTo(output, "v{}, v{}, ", a & 0xf, a >> 4);
+      appendReferenceOperand(readUnit(address + 1));
+      break;
+    case Format::F30t:
+      appendLabel(output, address + static_cast<uint32_t>(readInt32(address + 1)));
+      break;
+    case Format::F32x:
+      ai::utils::format::appendTo(output, "v{}, v{}", readUnit(address + 1), readUnit(address + 2));
+      break;
+    case Format::F31i:
+      ai::utils::format::appendTo(output, "v{}, ", a);
+      appendLiteral(output, readInt32(address + 1), opcode.isWide);
+      break;
+    case Format::F31t:
+      ai::utils::format::appendTo(output, "v{}, ", a);
+      appendLabel(output, address + static_cast<uint32_t>(readInt32(address + 1)));
+      break;
+    case Format::F31c:
+      ai::utils::format::appendTo(output, "v{}, ", a);
+      appendReferenceOperand(static_cast<uint32_t>(readInt32(address + 1)));
+      break;
+    case Format::F35c:
+    case Format::F45cc:
+      appendRegisters(output, unit0, readUnit(address + 2));
+      output += ", ";
+      appendReferenceOperand(readUnit(address + 1));
+      if (opcode.format == Format::F45cc) {
+        output += ", ";
+        appendProto(output, dex_, readUnit(address + 3));
+      }
+      break;
+    case Format::F3rc:
+    case Format::F4rcc:
+      appendRegisterRange(output, a, readUnit(address + 2));
+      output += ", ";
+      appendReferenceOperand(readUnit(address + 1));
+      if (opcode.format == Format::F4rcc) {
+        output += ", ";
+        appendProto(output, dex_, readUnit(address + 3));
+      }
+      break;
+    case Format::F51l: {
+      auto value = uint64_t{0};
+      for (auto index = uint32_t{0}; index < 4; index++) {
+        value |= uint64_t{readUnit(address + 1 + index)} << (16 * index);
+      }
+      ai::utils::format::appendTo(output, "v{}, ", a);
+      appendLiteral(output, static_cast<int64_t>(value), opcode.isWide);
+      break;
+    }
+    }
+    output += '\n';
+  }
+
+  auto appendPayload(std::pmr::string &output, uint32_t const address, uint16_t const unit) const -> void {
+    auto const owner = std::lower_bound(switches_.begin(), switches_.end(), std::pair(address, uint32_t{0}));
+    auto const switchAddress = owner != switches_.end() && owner->first == address ? std::optional(owner->second) : std::nullopt;
+    auto const count = uint32_t{readUnit(address + 1)};
+    auto const appendTarget = [&](int32_t const offset) {
+      if (switchAddress) {
+        appendLabel(output, *switchAddress + static_cast<uint32_t>(offset));
+      } else {
+        ai::utils::format::appendTo(output, "# {:+}", offset);
+      }
+    };
+    if (unit == PACKED_SWITCH_PAYLOAD) {
+      output += "    .packed-switch ";
+      appendLiteral(output, readInt32(address + 2), false);
+      output += '\n';
+      for (auto caseIndex = uint32_t{0}; caseIndex < count; caseIndex++) {
+        output += "        ";
+        appendTarget(readInt32(address + 4 + caseIndex * 2));
+        output += '\n';
+      }
+      output += "    .end packed-switch\n";
+    } else if (unit == SPARSE_SWITCH_PAYLOAD) {
+      output += "    .sparse-switch\n";
+      for (auto caseIndex = uint32_t{0}; caseIndex < count; caseIndex++) {
+        output += "        ";
+        appendLiteral(output, readInt32(address + 2 + caseIndex * 2), false);
+        output += " -> ";
+        appendTarget(readInt32(address + 2 + count * 2 + caseIndex * 2));
+        output += '\n';
+      }
+      output += "    .end sparse-switch\n";
+    } else {
+      auto const elementCount = static_cast<uint32_t>(readInt32(address + 2));
+      ai::utils::format::appendTo(output, "    .array-data {}\n", count);
+      for (auto element = uint32_t{0}; element < elementCount; element++) {
+        auto value = uint64_t{0};
+        for (auto byte = uint32_t{0}; byte < count && byte < sizeof(value); byte++) {
+          auto const offset = element * count + byte;
+          auto const dataUnit = readUnit(address + 4 + offset / 2);
+          value |= uint64_t{(offset % 2 == 0 ? dataUnit : dataUnit >> 8) & 0xffu} << (8 * byte);
+        }
+        ai::utils::format::appendTo(output, "        0x{:x}\n", value);
+      }
+      output += "    .end array-data\n";
+    }
+  }
+
+  auto appendCatches(std::pmr::string &output) const -> void {
+    for (auto const &tryItem : code_.tries) {
+      auto const appendRange = [&output, &tryItem] {
+        output += " {";
+        appendLabel(output, tryItem.startAddress);
+        output += " .. ";
+        appendLabel(output, tryItem.startAddress + tryItem.instructionCount);
+        output += "} ";
+      };
+      auto const catchHandler = dex_.catchHandler(code_, tryItem.handlerOffset);
+      for (auto const &[typeIndex, handlerAddress] : catchHandler.handlers) {
+        output += "    .catch ";
+        output += dex_.typeDescriptor(typeIndex);
+        appendRange();
+        appendLabel(output, handlerAddress);
+        output += '\n';
+      }
+      if (catchHandler.catchAllAddress) {
+        output += "    .catchall";
+        appendRange();
+        appendLabel(output, *catchHandler.catchAllAddress);
+        output += '\n';
+      }
+    }
+  }
+
+  DexFile const &dex_;
+
+  DexCodeItem const &code_;
+
+  std::pmr::vector<uint32_t> labels_;
+
+  //
+  // Payload and switch addresses, sorted by payload.
+  //
+  std::pmr::vector<std::pair<uint32_t, uint32_t>> switches_;
+};
+
+auto appendFields(std::pmr::string &output, DexFile const &dex, std::string_view const heading, std::vector<DexEncodedField> const &fields) -> void {
+  if (fields.empty()) {
+    return;
+  }
+  ai::utils::format::appendTo(output, "\n# {}\n", heading);
+  for (auto const &field : fields) {
+    output += ".field ";
+    appendAccessFlags(output, field.accessFlags, FieldFlag);
+    output += dex.fieldName(field.fieldIndex);
+    output += ':';
+    output += dex.typeDescriptor(dex.fieldIds()[field.fieldIndex].typeIndex);
+    output += '\n';
+  }
+}
+
+auto appendMethods(std::pmr::string &output, DexFile const &dex, std::string_view const heading, std::vector<DexEncodedMethod> const &methods) -> void {
+  if (methods.empty()) {
+    return;
+  }
+  ai::utils::format::appendTo(output, "\n# {}\n", heading);
+  for (auto const &method : methods) {
+    output += ".method ";
+    appendAccessFlags(output, method.accessFlags, MethodFlag);
+    output += dex.methodName(method.methodIndex);
+    output += dex.methodSignature(method.methodIndex);
+    output += '\n';
+    if (method.codeOffset != 0) {
+      auto const restart = output.size();
+      try {
+        auto const code = dex.codeItem(method.codeOffset);
+        ai::utils::format::appendTo(output, "    .registers {}\n\n", code.registersSize);
+        MethodDisassembler(dex, code, output.get_allocator().resource()).disassemble(output);
+      } catch (std::exception const &exception) {
+        output.resize(restart);
+        ai::utils::format::appendTo(output, "    # invalid code: {}\n", exception.what());
+      }
+    }
+    output += ".end method\n\n";
+  }
+}
+
+//
+// Text of a range of class defs, and their descriptors, in the arena of the
+// range.
+//
+struct DisassembledClasses {
+
+  DisassembledClasses() : arena(std::make_unique<ai::utils::Arena>()), descriptors(arena.get()), texts(arena.get()) {}
+
+  std::unique_ptr<ai::utils::Arena> arena;
+
+  std::pmr::vector<std::string_view> descriptors;
+
+  std::pmr::vector<std::pmr::string> texts;
+};
+
+auto disassembleClasses(DexFile const &dex, uint32_t const firstClassDef, uint32_t const lastClassDef) -> DisassembledClasses {
+  auto classes = DisassembledClasses();
+  classes.descriptors.reserve(lastClassDef - firstClassDef);
+  classes.texts.reserve(lastClassDef - firstClassDef);
+  for (auto classDef = firstClassDef; classDef < lastClassDef; classDef++) {
+    auto &text = classes.texts.emplace_back();
+    disassembleClass(dex, classDef, text);
+    classes.descriptors.push_back(dex.typeDescriptor(dex.classDefs()[classDef].classIndex));
+  }
+  return classes;
+}
+
+} // namespace
+
+auto ai::dex::disassembleClass(DexFile const &dex, uint32_t const classDef, std::pmr::string &output) -> void {
+  auto const definition = dex.classDefs()[classDef];
+  output += ".class ";
+  appendAccessFlags(output, definition.accessFlags, ClassFlag);
+  output += dex.typeDescriptor(definition.classIndex);
+  output += '\n';
+  if (definition.superclassIndex != NO_INDEX) {
+    output += ".super ";
+    output += dex.typeDescriptor(definition.superclassIndex);
+    output += '\n';
+  }
+  if (definition.sourceFileIndex != NO_INDEX) {
+    output += ".source ";
+    appendStringLiteral(output, dex.string(definition.sourceFileIndex));
+    output += '\n';
+  }
+  auto const interfaces = dex.typeList(definition.interfacesOffset);
+  if (interfaces.size() > 0) {
+    output += "\n# interfaces\n";
+    for (auto const interface : interfaces) {
+      output += ".implements ";
+      output += dex.typeDescriptor(interface);
+      output += '\n';
+    }
+  }
+  auto const classData = dex.classData(definition);
+  appendFields(output, dex, "static fields", classData.staticFields);
+  appendFields(output, dex, "instance fields", classData.instanceFields);
+  appendMethods(output, dex, "direct methods", classData.directMethods);
+  appendMethods(output, dex, "virtual methods", classData.virtualMethods);
+}
+
+auto ai::dex::disassemble(ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool, DisassemblyCallback const &onClass,
+                          utils::CancellationToken const &cancellation) -> void {
+  TRACE_SPAN("disassemble");
+  auto const window = std::max<size_t>(threadPool.threadCount(), 1) * TASKS_PER_WORKER;
+  auto inFlight = std::deque<std::future<DisassembledClasses>>();
+  auto const takeOldest = [&inFlight, &onClass] {
+    auto const classes = inFlight.front().get();
+    inFlight.pop_front();
+    for (size_t index = 0; index < classes.texts.size(); index++) {
+      onClass(classes.descriptors[index], classes.texts[index]);
+    }
+  };
+  try {
+    for (size_t dexFile = 0; dexFile < dexFiles.size(); dexFile++) {
+      auto const &dex = dexFiles[dexFile];
+      auto const classDefCount = dex.classDefs().size();
+      for (auto firstClassDef = uint32_t{0}; firstClassDef < classDefCount; firstClassDef += CLASSES_PER_TASK) {
+        cancellation.throwIfCancelled();
+        auto const lastClassDef = std::min(classDefCount, firstClassDef + CLASSES_PER_TASK);
+        inFlight.push_back(threadPool.submit([&dex, &cancellation, firstClassDef, lastClassDef] {
+          cancellation.throwIfCancelled();
+          return disassembleClasses(dex, firstClassDef, lastClassDef);
+        }));
+        if (inFlight.size() >= window) {
+          takeOldest();
+        }
+      }
+    }
+    while (!inFlight.empty()) {
+      takeOldest();
+    }
+  } catch (...) {
+
+    //
+    // Tasks still running refer to the files.
+    //
+    for (auto &future : inFlight) {
+      future.wait();
+    }
+    throw;
+  }
+}
+
+auto ai::dex::getSmaliPath(std::string_view const directory, std::string_view const descriptor) -> std::string {
+  auto const isClass = descriptor.size() > 2 && descriptor.front() == 'L' && descriptor.back() == ';';
+  auto name = isClass ? descriptor.substr(1, descriptor.size() - 2) : descriptor;
+  auto path = std::string(directory);
+  while (true) {
+    auto const segmentEnd = name.find('/');
+    auto const segment = name.substr(0, segmentEnd);
+    if (segment.empty()) {
+      path += "%00";
+    } else if (segment == "." || segment == "..") {
+      for (auto i = size_t{0}; i < segment.size(); i++) {
+        path += "%2E";
+      }
+    } else {
+      for (auto const character : segment) {
+        if (character == '%') {
+          path += "%25";
+        } else if (character == '\\') {
+          path += "%5C";
+        } else {
+          path += character;
+        }
+      }
+    }
+    if (segmentEnd == std::string_view::npos) {
+      break;
+    }
+    path += '/';
+    name.remove_prefix(segmentEnd + 1);
+  }
+  path += ".smali";
+  return path;
+}
+
+auto ai::dex::disassemble(ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool, ZipStreamWriter &writer,
+                          utils::CancellationToken const &cancellation) -> void {
+
+  //
+  // Classes come in order of file, so the file of each is known from the
+  // class def counts.
+  //
+  auto dexFile = size_t{0};
+  auto classDef = uint32_t{0};
+  auto directory = std::string("smali/");
+  disassemble(dexFiles, threadPool, [&](std::string_view const descriptor, std::string_view const smali) {
+    while (classDef == dexFiles[dexFile].classDefs().size()) {
+      dexFile++;
+      classDef = 0;
+      directory = "smali_classes" + std::to_string(dexFile + 1) + "/";
+    }
+    classDef++;
+    writer.add(getSmaliPath(directory, descriptor), smali);
+  }, cancellation);
+}
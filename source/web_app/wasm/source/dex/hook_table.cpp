@@ -0,0 +1,141 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <map>
+#include <string_view>
+#include <utility>
+
+#include "dex/hook_table.h"
+#include "utils/log.h"
+
+using namespace ai::dex;
+
+namespace {
+
+static constexpr uint32_t ACC_ABSTRACT = 0x0400;
+
+static constexpr std::string_view STATIC_INITIALIZER_NAME = "<clinit>";
+
+//
+// Method index to access flags of the methods selected in a class, by file
+// and class_def; both maps keep the order the table is written in.
+//
+using SelectedMethods = std::map<std::pair<uint32_t, uint32_t>, std::map<uint32_t, uint32_t>>;
+
+//
+// Selects the methods of the class the filter accepts by name and
+// signature, and returns whether there was one.
+//
+template <typename Filter>
+auto selectMethods(ApkDexFiles const &dexFiles, DexClassLocation const location, Filter const &filter, SelectedMethods &selected) -> bool {
+  auto const &dex = dexFiles[location.dexFile];
+  auto const classData = dex.classData(dex.classDefs()[location.classDef]);
+  auto matched = false;
+  for (auto const *methods : {&classData.directMethods, &classData.virtualMethods}) {
+    for (auto const &method : *methods) {
+      auto const name = dex.methodName(method.methodIndex);
+      if ((method.accessFlags & ACC_ABSTRACT) != 0 || name == STATIC_INITIALIZER_NAME || !filter(name, dex.methodSignature(method.methodIndex))) {
+        continue;
+      }
+      selected[{location.dexFile, location.classDef}][method.methodIndex] = method.accessFlags;
+      matched = true;
+    }
+  }
+  return matched;
+}
+
+auto selectSpec(ApkDexFiles const &dexFiles, DexIndex const &index, std::string_view const spec, SelectedMethods &selected) -> bool {
+  auto const any = [](std::string_view, std::string_view) { return true; };
+  auto const selectPackage = [&](std::string_view const prefix) {
+    auto matched = false;
+    for (auto const name : index.findClasses(prefix)) {
+      matched = selectMethods(dexFiles, *index.findClass(name), any, selected) || matched;
+    }
+    return matched;
+  };
+  if (spec.empty()) {
+    return false;
+  }
+  if (spec.ends_with('.')) {
+    return selectPackage(spec);
+  }
+  if (auto const location = index.findClass(spec)) {
+    return selectMethods(dexFiles, *location, any, selected);
+  }
+
+  //
+  // The class name ends at the last '.' before the signature, which may
+  // have dots of its own only in array and class types after the '('.
+  //
+  auto const signatureStart = spec.find('(');
+  auto const classEnd = spec.rfind('.', signatureStart);
+  if (classEnd != std::string_view::npos) {
+    if (auto const location = index.findClass(spec.substr(0, classEnd))) {
+      auto const member = spec.substr(classEnd + 1);
+      return selectMethods(
+          dexFiles, *location,
+          [member, signatureStart](std::string_view const name, std::string_view const signature) {
+            if (signatureStart == std::string_view::npos) {
+              return name == member;
+            }
+            return member.size() == name.size() + signature.size() && member.starts_with(name) && member.ends_with(signature);
+          },
+          selected);
+    }
+  }
+  return signatureStart == std::string_view::npos && selectPackage(std::string(spec) + '.');
+}
+
+} // namespace
+
+HookTable::HookTable(ApkDexFiles const &dexFiles, DexIndex const &index, std::span<std::string const> const specs) {
+  auto selected = SelectedMethods();
+  for (auto const &spec : specs) {
+    if (!selectSpec(dexFiles, index, spec, selected)) {
+      unmatchedSpecs_.push_back(spec);
+    }
+  }
+  for (auto file = std::size_t{0}; file < dexFiles.size(); file++) {
+    table_.dexFiles.push_back({dexFiles.name(file), dexFiles[file].header().checksum});
+  }
+  for (auto const &[location, methods] : selected) {
+    auto const &dex = dexFiles[location.first];
+    auto &hookClass = table_.classes.emplace_back(HookTableClass{location.first, location.second, std::string(dex.typeDescriptor(dex.classDefs()[location.second].classIndex)), {}});
+    for (auto const &[methodIndex, accessFlags] : methods) {
+      hookClass.methods.push_back({methodIndex, accessFlags, std::string(dex.methodName(methodIndex)), dex.methodSignature(methodIndex)});
+    }
+  }
+  LOGD("HookTable, classes [{}] methods [{}] unmatched specs [{}]", table_.classes.size(), methodCount(), unmatchedSpecs_.size());
+}
+
+HookTable::HookTable(std::span<std::byte const> const encoded) : table_(utils::decodeHookTable(encoded)) {}
+
+auto HookTable::encode() const -> std::vector<std::byte> { return utils::encodeHookTable(table_); }
+
+auto HookTable::methodCount() const -> std::size_t {
+  auto count = std::size_t{0};
+  for (auto const &hookClass : table_.classes) {
+    count += hookClass.methods.size();
+  }
+  return count;
+}
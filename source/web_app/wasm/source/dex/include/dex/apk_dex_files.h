@@ -0,0 +1,67 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DEX_APK_DEX_FILES_H_
+#define ANDROID_INTROSPECTION_DEX_APK_DEX_FILES_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "apk/apk.h"
+#include "dex/dex_file.h"
+
+namespace ai::dex {
+
+//
+// The classes.dex, classes2.dex, ... files of an APK, in the order the
+// runtime loads them.  Stored files are read straight from the memory
+// mapped APK, compressed ones are inflated once; past that only the headers
+// are parsed until the files are queried.
+//
+class ApkDexFiles final {
+public:
+  explicit ApkDexFiles(Apk const &apk);
+
+  auto size() const -> std::size_t { return files_.size(); }
+
+  auto name(std::size_t const index) const -> std::string const & { return files_.at(index).name; }
+
+  auto operator[](std::size_t const index) const -> DexFile const & { return files_.at(index).file; }
+
+private:
+  struct File {
+
+    std::string name;
+
+    ApkFileBytes bytes;
+
+    DexFile file;
+  };
+
+  std::vector<File> files_;
+};
+
+} // namespace ai::dex
+
+#endif /* ANDROID_INTROSPECTION_DEX_APK_DEX_FILES_H_ */
@@ -0,0 +1,118 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DEX_CALL_GRAPH_H_
+#define ANDROID_INTROSPECTION_DEX_CALL_GRAPH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "apk/apk.h"
+#include "dex/apk_dex_files.h"
+
+namespace ai {
+namespace utils {
+class ThreadPool;
+} // namespace utils
+} // namespace ai
+
+namespace ai::dex {
+
+//
+// Calls made by the invoke instructions of every dex file of an APK.
+// Methods are numbered once for all the files, in order of their names,
+// which are written as in DexIndex, e.g.
+// "org.fdroid.fdroid.FDroidApp.onCreate()V"; a method referenced by several
+// files is one method.  Edges are kept twice in compressed sparse row
+// form, by caller and by callee, so both directions are a slice of an
+// array.  A caller that invokes the same method more than once has one edge
+// to it.
+//
+class CallGraph final {
+public:
+  //
+  // Decodes the instructions on the workers of the pool, a range of class
+  // defs per task.  Methods whose code fails to decode have no callees.
+  //
+  CallGraph(ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool);
+
+  //
+  // Decodes a graph encoded by encode(); throws if it is corrupt.
+  //
+  explicit CallGraph(std::span<std::byte const> encoded);
+
+  //
+  // Returns the graph of the APK from its analysis cache, or builds it and
+  // stores it there.
+  //
+  static auto load(Apk const &apk, ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool) -> CallGraph;
+
+  auto encode() const -> std::vector<std::byte>;
+
+  auto methodCount() const -> uint32_t { return static_cast<uint32_t>(nameOffsets_.size() - 1); }
+
+  auto edgeCount() const -> std::size_t { return callees_.size(); }
+
+  auto methodName(uint32_t method) const -> std::string_view;
+
+  auto findMethod(std::string_view name) const -> std::optional<uint32_t>;
+
+  //
+  // Methods invoked by the method, and those invoking it, in order.
+  //
+  auto callees(uint32_t method) const -> std::span<uint32_t const>;
+
+  auto callers(uint32_t method) const -> std::span<uint32_t const>;
+
+private:
+  auto validate() const -> void;
+
+  //
+  // Names of the methods: that of method i is names_[nameOffsets_[i]]
+  // up to names_[nameOffsets_[i + 1]].
+  //
+  std::string names_;
+
+  std::vector<uint32_t> nameOffsets_ = {0};
+
+  //
+  // Callees of method i are callees_[calleeOffsets_[i]] up to
+  // callees_[calleeOffsets_[i + 1]], and likewise for the callers.
+  //
+  std::vector<uint32_t> calleeOffsets_ = {0};
+
+  std::vector<uint32_t> callees_;
+
+  std::vector<uint32_t> callerOffsets_ = {0};
+
+  std::vector<uint32_t> callers_;
+};
+
+} // namespace ai::dex
+
+#endif /* ANDROID_INTROSPECTION_DEX_CALL_GRAPH_H_ */
@@ -0,0 +1,334 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DEX_DEX_FILE_H_
+#define ANDROID_INTROSPECTION_DEX_DEX_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ai::dex {
+
+static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+struct DexHeader {
+
+  //
+  // Format version, e.g. "035" or "039".
+  //
+  std::string version;
+
+  uint32_t checksum;
+
+  uint32_t fileSize;
+};
+
+//
+// Records of the id tables, laid out as in the file.
+//
+struct DexProtoId {
+
+  uint32_t shortyIndex;
+
+  uint32_t returnTypeIndex;
+
+  uint32_t parametersOffset;
+};
+
+struct DexFieldId {
+
+  uint16_t classIndex;
+
+  uint16_t typeIndex;
+
+  uint32_t nameIndex;
+};
+
+struct DexMethodId {
+
+  uint16_t classIndex;
+
+  uint16_t protoIndex;
+
+  uint32_t nameIndex;
+};
+
+struct DexClassDef {
+
+  uint32_t classIndex;
+
+  uint32_t accessFlags;
+
+  uint32_t superclassIndex;
+
+  uint32_t interfacesOffset;
+
+  uint32_t sourceFileIndex;
+
+  uint32_t annotationsOffset;
+
+  uint32_t classDataOffset;
+
+  uint32_t staticValuesOffset;
+};
+
+//
+// Fields and methods of a class_data_item, with their indexes decoded from
+// the differences the file stores.
+//
+struct DexEncodedField {
+
+  uint32_t fieldIndex;
+
+  uint32_t accessFlags;
+};
+
+struct DexEncodedMethod {
+
+  uint32_t methodIndex;
+
+  uint32_t accessFlags;
+
+  //
+  // 0 for abstract and native methods.
+  //
+  uint32_t codeOffset;
+};
+
+struct DexClassData {
+
+  std::vector<DexEncodedField> staticFields;
+
+  std::vector<DexEncodedField> instanceFields;
+
+  std::vector<DexEncodedMethod> directMethods;
+
+  std::vector<DexEncodedMethod> virtualMethods;
+};
+
+struct DexTryItem {
+
+  uint32_t startAddress;
+
+  uint16_t instructionCount;
+
+  uint16_t handlerOffset;
+};
+
+struct DexCatchHandler {
+
+  //
+  // Type index and address of each typed handler, in order.
+  //
+  std::vector<std::pair<uint32_t, uint32_t>> handlers;
+
+  std::optional<uint32_t> catchAllAddress;
+};
+
+//
+// View of a table of fixed size records; a record is only read when it is
+// accessed.  Bounds are checked once, when the table is created.
+//
+template <typename T> class DexTable final {
+public:
+  class Iterator final {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = T;
+
+    Iterator(DexTable const *table, uint32_t index) : table_(table), index_(index) {}
+
+    auto operator*() const -> T { return (*table_)[index_]; }
+
+    auto operator++() -> Iterator & {
+      index_++;
+      return *this;
+    }
+
+    auto operator==(Iterator const &other) const -> bool { return index_ == other.index_; }
+
+  private:
+    DexTable const *table_;
+
+    uint32_t index_;
+  };
+
+  DexTable() = default;
+
+  explicit DexTable(std::span<std::byte const> const records) : records_(records) {}
+
+  auto size() const -> uint32_t { return static_cast<uint32_t>(records_.size() / sizeof(T)); }
+
+  auto operator[](uint32_t const index) const -> T {
+    if (index >= size()) {
+      throw std::out_of_range("dex table index out of range");
+    }
+    auto record = T();
+    memcpy(&record, records_.data() + std::size_t{index} * sizeof(T), sizeof(T));
+    return record;
+  }
+
+  auto begin() const -> Iterator { return Iterator(this, 0); }
+
+  auto end() const -> Iterator { return Iterator(this, size()); }
+
+private:
+  std::span<std::byte const> records_;
+};
+
+//
+// Header and instructions of a code_item.
+//
+struct DexCodeItem {
+
+  uint16_t registersSize;
+
+  uint16_t insSize;
+
+  uint16_t outsSize;
+
+  uint32_t debugInfoOffset;
+
+  //
+  // Code units of the instructions, payloads included.
+  //
+  DexTable<uint16_t> instructions;
+
+  DexTable<DexTryItem> tries;
+
+  //
+  // Offset of the encoded_catch_handler_list, which handlerOffset of a
+  // try item is relative to.
+  //
+  uint32_t handlersOffset;
+};
+
+//
+// Lazy reader of a DEX file.  The constructor only validates the header and
+// the bounds of the id tables; strings are located when asked for, and
+// returned as they are stored, in MUTF-8, which equals UTF-8 for everything
+// but NUL and supplementary characters.  The bytes must outlive the reader.
+//
+class DexFile final {
+public:
+  explicit DexFile(std::span<std::byte const> bytes);
+
+  auto header() const -> DexHeader const & { return header_; }
+
+  auto stringCount() const -> uint32_t { return stringIds_.size(); }
+
+  auto string(uint32_t stringIndex) const -> std::string_view;
+
+  //
+  // Whether the string is well formed MUTF-8 of the UTF-16 length stored
+  // before it.
+  //
+  auto isValidString(uint32_t stringIndex) const -> bool;
+
+  //
+  // Descriptor string index of every type.
+  //
+  auto typeIds() const -> DexTable<uint32_t> const & { return typeIds_; }
+
+  auto protoIds() const -> DexTable<DexProtoId> const & { return protoIds_; }
+
+  auto fieldIds() const -> DexTable<DexFieldId> const & { return fieldIds_; }
+
+  auto methodIds() const -> DexTable<DexMethodId> const & { return methodIds_; }
+
+  auto classDefs() const -> DexTable<DexClassDef> const & { return classDefs_; }
+
+  //
+  // Type descriptor, e.g. "Ljava/lang/String;" or "[I".
+  //
+  auto typeDescriptor(uint32_t typeIndex) const -> std::string_view;
+
+  //
+  // Type indexes of the parameters of a prototype.
+  //
+  auto parameters(DexProtoId const &proto) const -> DexTable<uint16_t>;
+
+  //
+  // Type indexes of the type_list at the offset, e.g. the interfaces of a
+  // class; empty for offset 0.
+  //
+  auto typeList(uint32_t offset) const -> DexTable<uint16_t>;
+
+  auto fieldName(uint32_t fieldIndex) const -> std::string_view;
+
+  auto methodName(uint32_t methodIndex) const -> std::string_view;
+
+  //
+  // Descriptor of the parameters and return type of a method, e.g.
+  // "(Ljava/lang/String;I)V".
+  //
+  auto methodSignature(uint32_t methodIndex) const -> std::string;
+
+  //
+  // Fields and methods of a class; empty for a class without data.
+  //
+  auto classData(DexClassDef const &classDef) const -> DexClassData;
+
+  auto codeItem(uint32_t codeOffset) const -> DexCodeItem;
+
+  auto catchHandler(DexCodeItem const &code, uint16_t handlerOffset) const -> DexCatchHandler;
+
+private:
+  std::span<std::byte const> bytes_;
+
+  DexHeader header_;
+
+  DexTable<uint32_t> stringIds_;
+
+  DexTable<uint32_t> typeIds_;
+
+  DexTable<DexProtoId> protoIds_;
+
+  DexTable<DexFieldId> fieldIds_;
+
+  DexTable<DexMethodId> methodIds_;
+
+  DexTable<DexClassDef> classDefs_;
+};
+
+//
+// Java name of a class descriptor, e.g. "Lorg/fdroid/fdroid/FDroidApp;" to
+// "org.fdroid.fdroid.FDroidApp"; other descriptors are returned as they are.
+//
+auto getClassName(std::string_view descriptor) -> std::string;
+
+} // namespace ai::dex
+
+#endif /* ANDROID_INTROSPECTION_DEX_DEX_FILE_H_ */
@@ -0,0 +1,117 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DEX_DEX_INDEX_H_
+#define ANDROID_INTROSPECTION_DEX_DEX_INDEX_H_
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "dex/apk_dex_files.h"
+#include "utils/macros.h"
+
+namespace ai {
+namespace utils {
+class ThreadPool;
+} // namespace utils
+} // namespace ai
+
+namespace ai::dex {
+
+class ProguardMapping;
+
+struct DexClassLocation {
+
+  //
+  // Index of the file in ApkDexFiles and of the class_def in that file.
+  //
+  uint32_t dexFile;
+
+  uint32_t classDef;
+};
+
+struct DexPackageChild {
+
+  std::string_view name;
+
+  bool isPackage;
+};
+
+//
+// Sorted index of the classes defined in the dex files of an APK, by
+// their Java names (e.g. "org.fdroid.fdroid.FDroidApp"), and of the
+// methods referenced on them, as class name, '.', method name and
+// signature (e.g. "org.fdroid.fdroid.FDroidApp.onCreate()V").  Names are
+// interned in a single buffer; lookups are binary searches and never
+// allocate, except for the children of a package.
+//
+class DexIndex final {
+public:
+  //
+  // Indexes the files on the workers of the pool, one task per file, then
+  // merges their sorted names.  A class defined by several files is found
+  // in the first, as the runtime does.
+  //
+  DexIndex(ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool);
+
+  DISALLOW_COPY_AND_ASSIGN(DexIndex);
+
+  auto classes() const -> std::span<std::string_view const> { return classes_; }
+
+  auto methods() const -> std::span<std::string_view const> { return methods_; }
+
+  auto findClass(std::string_view name) const -> std::optional<DexClassLocation>;
+
+  //
+  // Same as above by the name the class has in the source of the mapping,
+  // e.g. "org.fdroid.fdroid.FDroidApp" for "a.a"; a class the mapping does
+  // not list, e.g. one that was kept, is found by the name itself.
+  //
+  auto findOriginalClass(std::string_view originalName, ProguardMapping const &mapping) const -> std::optional<DexClassLocation>;
+
+  auto findClasses(std::string_view prefix) const -> std::span<std::string_view const>;
+
+  auto findMethods(std::string_view prefix) const -> std::span<std::string_view const>;
+
+  //
+  // Subpackages and classes directly in a package, in order; the empty
+  // package is the root.
+  //
+  auto packageChildren(std::string_view package) const -> std::vector<DexPackageChild>;
+
+private:
+  std::vector<char> names_;
+
+  std::vector<std::string_view> classes_;
+
+  std::vector<DexClassLocation> classLocations_;
+
+  std::vector<std::string_view> methods_;
+};
+
+} // namespace ai::dex
+
+#endif /* ANDROID_INTROSPECTION_DEX_DEX_INDEX_H_ */
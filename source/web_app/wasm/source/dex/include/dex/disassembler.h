@@ -0,0 +1,89 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DEX_DISASSEMBLER_H_
+#define ANDROID_INTROSPECTION_DEX_DISASSEMBLER_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+#include "dex/apk_dex_files.h"
+#include "dex/dex_file.h"
+#include "utils/cancellation.h"
+
+namespace ai {
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+class ZipStreamWriter;
+} // namespace ai
+
+namespace ai::dex {
+
+//
+// Appends the smali text of a class to output.  Instructions are decoded
+// from one table of opcode formats; registers are written as v registers,
+// branch targets as :addr_<offset> labels, and debug info, annotations and
+// static field values are left out.  Code that fails to decode ends its
+// method with a comment saying why.
+//
+auto disassembleClass(DexFile const &dex, uint32_t classDef, std::pmr::string &output) -> void;
+
+using DisassemblyCallback = std::function<void(std::string_view classDescriptor, std::string_view smali)>;
+
+//
+// Disassembles every class of the files on the workers of the pool, a
+// range of class defs per task, each task writing into an arena of its own.
+// Text is handed to onClass in order of file and class def as the tasks
+// finish, and only a few tasks per worker are in flight, so memory is
+// bounded by them rather than by the size of the app.  Once cancellation
+// is set, tasks not started yet are skipped and utils::CancellationException
+// is thrown when those running are done.
+//
+auto disassemble(ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool, DisassemblyCallback const &onClass,
+                 utils::CancellationToken const &cancellation = {}) -> void;
+
+//
+// Path of the smali file of the class in the directory, e.g.
+// "smali/org/fdroid/fdroid/FDroidApp.smali".  Descriptors are names chosen
+// by the app, so segments that would leave the directory or be dropped by
+// an extractor, "", "." and "..", are escaped as %00 and with a %2E per dot,
+// and '%' and backslashes as %25 and %5C.
+//
+auto getSmaliPath(std::string_view directory, std::string_view descriptor) -> std::string;
+
+//
+// Same as above, adding the text of each class to writer as apktool lays
+// it out, at the path of getSmaliPath(): under "smali/" for a class of
+// classes.dex, under "smali_classes2/" for classes2.dex and so on.
+//
+auto disassemble(ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool, ZipStreamWriter &writer, utils::CancellationToken const &cancellation = {})
+    -> void;
+
+} // namespace ai::dex
+
+#endif /* ANDROID_INTROSPECTION_DEX_DISASSEMBLER_H_ */
@@ -0,0 +1,95 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DEX_HOOK_TABLE_H_
+#define ANDROID_INTROSPECTION_DEX_HOOK_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "dex/apk_dex_files.h"
+#include "dex/dex_index.h"
+#include "utils/hook_table_format.h"
+
+namespace ai::dex {
+
+using HookTableDexFile = utils::HookTableDexFile;
+
+using HookTableMethod = utils::HookTableMethod;
+
+using HookTableClass = utils::HookTableClass;
+
+//
+// Methods to hook, resolved on the host against the dex files of an APK so
+// that the agent in the app does no lookup by name of its own: it loads
+// each class once and resolves its methods by the signatures in the table,
+// in one batch.  The agent decodes the table with the same codec, see
+// utils/hook_table_format.h.
+//
+// A spec is one of
+//
+//   "org.fdroid.fdroid."  every class of the package and its subpackages
+//   "org.fdroid.fdroid.FDroidApp"  every method of the class
+//   "org.fdroid.fdroid.FDroidApp.onCreate"  every overload of the method
+//   "org.fdroid.fdroid.FDroidApp.onCreate()V"  that method only
+//
+// and a package given without the trailing '.' is taken as one when no
+// class or method matches.  Only methods defined by the classes are in the
+// table, abstract ones and static initializers left out; classes are in
+// order of file and class_def, and methods in order of method id.
+//
+class HookTable final {
+public:
+  HookTable(ApkDexFiles const &dexFiles, DexIndex const &index, std::span<std::string const> specs);
+
+  //
+  // Decodes a table encoded by encode(); throws std::runtime_error if it is
+  // corrupt.
+  //
+  explicit HookTable(std::span<std::byte const> encoded);
+
+  auto encode() const -> std::vector<std::byte>;
+
+  auto dexFiles() const -> std::vector<HookTableDexFile> const & { return table_.dexFiles; }
+
+  auto classes() const -> std::vector<HookTableClass> const & { return table_.classes; }
+
+  auto methodCount() const -> std::size_t;
+
+  //
+  // Specs that matched no method, in the order given.
+  //
+  auto unmatchedSpecs() const -> std::vector<std::string> const & { return unmatchedSpecs_; }
+
+private:
+  utils::HookTableData table_;
+
+  std::vector<std::string> unmatchedSpecs_;
+};
+
+} // namespace ai::dex
+
+#endif /* ANDROID_INTROSPECTION_DEX_HOOK_TABLE_H_ */
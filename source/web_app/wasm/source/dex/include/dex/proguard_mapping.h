@@ -0,0 +1,154 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DEX_PROGUARD_MAPPING_H_
+#define ANDROID_INTROSPECTION_DEX_PROGUARD_MAPPING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/macros.h"
+#include "utils/mapped_file.h"
+
+namespace ai {
+namespace utils {
+class ThreadPool;
+} // namespace utils
+} // namespace ai
+
+namespace ai::dex {
+
+struct ProguardClass {
+
+  //
+  // Java names, e.g. "org.fdroid.fdroid.FDroidApp" and "a.b".
+  //
+  std::string_view originalName;
+
+  std::string_view obfuscatedName;
+};
+
+//
+// A field or method line of a class, names and types as the original
+// source has them.  Inlined methods take one line per frame, all with the
+// obfuscated name of the method they were inlined into.
+//
+struct ProguardMember {
+
+  uint32_t classIndex;
+
+  bool isMethod;
+
+  //
+  // Type of a field or return type of a method.
+  //
+  std::string_view type;
+
+  std::string_view originalName;
+
+  //
+  // Comma separated types of the arguments of a method, e.g.
+  // "android.os.Bundle,int"; empty for a field.
+  //
+  std::string_view arguments;
+
+  std::string_view obfuscatedName;
+};
+
+//
+// A ProGuard or R8 mapping.txt, mapped and parsed on the workers of a pool,
+// each taking a range of the file that starts at a class line.  Names are
+// views of the mapping, kept for the lifetime of the object, and hashed in
+// both directions: classes by either name, members by class and either
+// name.  Comments, including R8 metadata, and line numbers are skipped.
+//
+class ProguardMapping final {
+public:
+  ProguardMapping(std::string const &path, utils::ThreadPool &threadPool);
+
+  DISALLOW_COPY_AND_ASSIGN(ProguardMapping);
+
+  auto classes() const -> std::vector<ProguardClass> const & { return classes_; }
+
+  auto members() const -> std::vector<ProguardMember> const & { return members_; }
+
+  auto findObfuscatedClass(std::string_view obfuscatedName) const -> std::optional<uint32_t>;
+
+  auto findOriginalClass(std::string_view originalName) const -> std::optional<uint32_t>;
+
+  //
+  // Original name of a class, or the name itself when the mapping lacks it,
+  // e.g. for classes that were kept.
+  //
+  auto deobfuscateClassName(std::string_view obfuscatedName) const -> std::string_view;
+
+  //
+  // Members of the class of the name, overloads and inlined frames in the
+  // order of the mapping.
+  //
+  auto findObfuscatedMembers(uint32_t classIndex, std::string_view obfuscatedName) const -> std::vector<ProguardMember const *>;
+
+  auto findOriginalMembers(uint32_t classIndex, std::string_view originalName) const -> std::vector<ProguardMember const *>;
+
+private:
+  struct MemberKey {
+
+    uint32_t classIndex;
+
+    std::string_view name;
+
+    auto operator==(MemberKey const &) const -> bool = default;
+  };
+
+  struct MemberKeyHash {
+
+    auto operator()(MemberKey const &key) const -> size_t { return std::hash<std::string_view>()(key.name) * 31 + key.classIndex; }
+  };
+
+  using MemberIndex = std::unordered_multimap<MemberKey, uint32_t, MemberKeyHash>;
+
+  static auto findMembers(std::vector<ProguardMember> const &members, MemberIndex const &index, MemberKey const &key) -> std::vector<ProguardMember const *>;
+
+  utils::MappedFile file_;
+
+  std::vector<ProguardClass> classes_;
+
+  std::vector<ProguardMember> members_;
+
+  std::unordered_map<std::string_view, uint32_t> classesByObfuscatedName_;
+
+  std::unordered_map<std::string_view, uint32_t> classesByOriginalName_;
+
+  MemberIndex membersByObfuscatedName_;
+
+  MemberIndex membersByOriginalName_;
+};
+
+} // namespace ai::dex
+
+#endif /* ANDROID_INTROSPECTION_DEX_PROGUARD_MAPPING_H_ */
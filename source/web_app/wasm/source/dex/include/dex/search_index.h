@@ -0,0 +1,150 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DEX_SEARCH_INDEX_H_
+#define ANDROID_INTROSPECTION_DEX_SEARCH_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "apk/apk.h"
+#include "dex/apk_dex_files.h"
+
+namespace ai {
+namespace utils {
+class ThreadPool;
+} // namespace utils
+} // namespace ai
+
+namespace ai::dex {
+
+struct SearchOptions {
+
+  //
+  // ASCII letters match either case unless set.
+  //
+  bool caseSensitive = false;
+
+  std::size_t maxMatches = 1000;
+};
+
+struct SearchMatch {
+
+  //
+  // Dex file or APK entry the match is in.
+  //
+  std::string_view source;
+
+  //
+  // Index of the string in the dex file, or NO_INDEX for entries.
+  //
+  uint32_t stringIndex;
+
+  //
+  // Offset of the match in the string or entry.
+  //
+  uint32_t offset;
+
+  //
+  // The string, or the line of the entry with the match.
+  //
+  std::string_view text;
+};
+
+//
+// Trigram index over the strings of the dex files and the text entries of
+// an APK (assets and files with a text extension).  Posting lists hold, in
+// order, the strings and entries that contain each ASCII case folded
+// trigram; a query intersects the lists of its trigrams and only checks the
+// text of the candidates.  The index keeps its own copy of the text, so
+// once built or loaded nothing is inflated again.
+//
+class SearchIndex final {
+public:
+  //
+  // Extracts the trigrams on the workers of the pool in one pass over the
+  // strings and entries.
+  //
+  SearchIndex(Apk const &apk, ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool);
+
+  //
+  // Decodes an index encoded by encode(); throws if it is corrupt.
+  //
+  explicit SearchIndex(std::span<std::byte const> encoded);
+
+  //
+  // Returns the index of the APK from its analysis cache, or builds it and
+  // stores it there.
+  //
+  static auto load(Apk const &apk, ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool) -> SearchIndex;
+
+  auto encode() const -> std::vector<std::byte>;
+
+  auto search(std::string_view pattern, SearchOptions const &options = SearchOptions()) const -> std::vector<SearchMatch>;
+
+  auto documentCount() const -> std::size_t { return documents_.size(); }
+
+private:
+  struct Document {
+
+    uint32_t source;
+
+    uint32_t stringIndex;
+
+    uint32_t offset;
+
+    uint32_t size;
+  };
+
+  auto text(Document const &document) const -> std::string_view;
+
+  auto candidates(std::string_view pattern) const -> std::vector<uint32_t>;
+
+  auto buildTrigrams(utils::ThreadPool &threadPool) -> void;
+
+  auto validate() const -> void;
+
+  std::vector<std::string> sources_;
+
+  std::vector<Document> documents_;
+
+  std::string text_;
+
+  //
+  // Posting lists of the sorted trigram keys: those of trigrams_[i] are
+  // postings_[offsets_[i]] up to postings_[offsets_[i + 1]].
+  //
+  std::vector<uint32_t> trigrams_;
+
+  std::vector<uint32_t> offsets_;
+
+  std::vector<uint32_t> postings_;
+};
+
+} // namespace ai::dex
+
+#endif /* ANDROID_INTROSPECTION_DEX_SEARCH_INDEX_H_ */
@@ -0,0 +1,282 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DEX_INSTRUCTION_SET_H_
+#define ANDROID_INTROSPECTION_DEX_INSTRUCTION_SET_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+#include "dex/dex_file.h"
+
+namespace ai::dex {
+
+inline constexpr uint16_t PACKED_SWITCH_PAYLOAD = 0x0100;
+
+inline constexpr uint16_t SPARSE_SWITCH_PAYLOAD = 0x0200;
+
+inline constexpr uint16_t FILL_ARRAY_DATA_PAYLOAD = 0x0300;
+
+inline constexpr uint8_t CONST_WIDE_HIGH16 = 0x19;
+
+inline constexpr uint8_t FILL_ARRAY_DATA = 0x26;
+
+inline constexpr uint8_t PACKED_SWITCH = 0x2b;
+
+inline constexpr uint8_t SPARSE_SWITCH = 0x2c;
+
+//
+// Instruction formats of the Dalvik bytecode specification, named after
+// their size in code units, register count and operand kind.
+//
+enum class Format : uint8_t {
+  Unused,
+  F10x,
+  F12x,
+  F11n,
+  F11x,
+  F10t,
+  F20t,
+  F22x,
+  F21t,
+  F21s,
+  F21h,
+  F21c,
+  F23x,
+  F22b,
+  F22t,
+  F22s,
+  F22c,
+  F30t,
+  F32x,
+  F31i,
+  F31t,
+  F31c,
+  F35c,
+  F3rc,
+  F45cc,
+  F4rcc,
+  F51l,
+};
+
+enum class Reference : uint8_t { None, String, Type, Field, Method, CallSite, MethodHandle, Proto };
+
+struct Opcode {
+
+  std::string_view name;
+
+  Format format = Format::Unused;
+
+  Reference reference = Reference::None;
+
+  //
+  // Whether literals are 64 bit.
+  //
+  bool isWide = false;
+};
+
+constexpr auto getFormatSize(Format const format) -> uint32_t {
+  switch (format) {
+  case Format::Unused:
+  case Format::F10x:
+  case Format::F12x:
+  case Format::F11n:
+  case Format::F11x:
+  case Format::F10t:
+    return 1;
+  case Format::F20t:
+  case Format::F22x:
+  case Format::F21t:
+  case Format::F21s:
+  case Format::F21h:
+  case Format::F21c:
+  case Format::F23x:
+  case Format::F22b:
+  case Format::F22t:
+  case Format::F22s:
+  case Format::F22c:
+    return 2;
+  case Format::F30t:
+  case Format::F32x:
+  case Format::F31i:
+  case Format::F31t:
+  case Format::F31c:
+  case Format::F35c:
+  case Format::F3rc:
+    return 3;
+  case Format::F45cc:
+  case Format::F4rcc:
+    return 4;
+  case Format::F51l:
+    return 5;
+  }
+  return 1;
+}
+
+constexpr auto makeOpcodes() -> std::array<Opcode, 256> {
+  auto opcodes = std::array<Opcode, 256>();
+  auto const set = [&opcodes](uint8_t const opcode, std::string_view const name, Format const format, Reference const reference = Reference::None,
+                              bool const isWide = false) { opcodes[opcode] = Opcode{name, format, reference, isWide}; };
+  auto const setRange = [&set](uint8_t const first, auto const &names, Format const format, Reference const reference = Reference::None) {
+    for (size_t name = 0; name < std::size(names); name++) {
+      set(static_cast<uint8_t>(first + name), names[name], format, reference);
+    }
+  };
+  set(0x00, "nop", Format::F10x);
+  setRange(0x01, std::array<std::string_view, 9>{"move", "move/from16", "move/16", "move-wide", "move-wide/from16", "move-wide/16", "move-object",
+                                                 "move-object/from16", "move-object/16"},
+           Format::F12x);
+  set(0x02, "move/from16", Format::F22x);
+  set(0x03, "move/16", Format::F32x);
+  set(0x05, "move-wide/from16", Format::F22x);
+  set(0x06, "move-wide/16", Format::F32x);
+  set(0x08, "move-object/from16", Format::F22x);
+  set(0x09, "move-object/16", Format::F32x);
+  setRange(0x0a, std::array<std::string_view, 4>{"move-result", "move-result-wide", "move-result-object", "move-exception"}, Format::F11x);
+  set(0x0e, "return-void", Format::F10x);
+  setRange(0x0f, std::array<std::string_view, 3>{"return", "return-wide", "return-object"}, Format::F11x);
+  set(0x12, "const/4", Format::F11n);
+  set(0x13, "const/16", Format::F21s);
+  set(0x14, "const", Format::F31i);
+  set(0x15, "const/high16", Format::F21h);
+  set(0x16, "const-wide/16", Format::F21s, Reference::None, true);
+  set(0x17, "const-wide/32", Format::F31i, Reference::None, true);
+  set(0x18, "const-wide", Format::F51l, Reference::None, true);
+  set(CONST_WIDE_HIGH16, "const-wide/high16", Format::F21h, Reference::None, true);
+  set(0x1a, "const-string", Format::F21c, Reference::String);
+  set(0x1b, "const-string/jumbo", Format::F31c, Reference::String);
+  set(0x1c, "const-class", Format::F21c, Reference::Type);
+  set(0x1d, "monitor-enter", Format::F11x);
+  set(0x1e, "monitor-exit", Format::F11x);
+  set(0x1f, "check-cast", Format::F21c, Reference::Type);
+  set(0x20, "instance-of", Format::F22c, Reference::Type);
+  set(0x21, "array-length", Format::F12x);
+  set(0x22, "new-instance", Format::F21c, Reference::Type);
+  set(0x23, "new-array", Format::F22c, Reference::Type);
+  set(0x24, "filled-new-array", Format::F35c, Reference::Type);
+  set(0x25, "filled-new-array/range", Format::F3rc, Reference::Type);
+  set(FILL_ARRAY_DATA, "fill-array-data", Format::F31t);
+  set(0x27, "throw", Format::F11x);
+  set(0x28, "goto", Format::F10t);
+  set(0x29, "goto/16", Format::F20t);
+  set(0x2a, "goto/32", Format::F30t);
+  set(PACKED_SWITCH, "packed-switch", Format::F31t);
+  set(SPARSE_SWITCH, "sparse-switch", Format::F31t);
+  setRange(0x2d, std::array<std::string_view, 5>{"cmpl-float", "cmpg-float", "cmpl-double", "cmpg-double", "cmp-long"}, Format::F23x);
+  setRange(0x32, std::array<std::string_view, 6>{"if-eq", "if-ne", "if-lt", "if-ge", "if-gt", "if-le"}, Format::F22t);
+  setRange(0x38, std::array<std::string_view, 6>{"if-eqz", "if-nez", "if-ltz", "if-gez", "if-gtz", "if-lez"}, Format::F21t);
+  setRange(0x44, std::array<std::string_view, 14>{"aget", "aget-wide", "aget-object", "aget-boolean", "aget-byte", "aget-char", "aget-short", "aput",
+                                                  "aput-wide", "aput-object", "aput-boolean", "aput-byte", "aput-char", "aput-short"},
+           Format::F23x);
+  setRange(0x52, std::array<std::string_view, 14>{"iget", "iget-wide", "iget-object", "iget-boolean", "iget-byte", "iget-char", "iget-short", "iput",
+                                                  "iput-wide", "iput-object", "iput-boolean", "iput-byte", "iput-char", "iput-short"},
+           Format::F22c, Reference::Field);
+  setRange(0x60, std::array<std::string_view, 14>{"sget", "sget-wide", "sget-object", "sget-boolean", "sget-byte", "sget-char", "sget-short", "sput",
+                                                  "sput-wide", "sput-object", "sput-boolean", "sput-byte", "sput-char", "sput-short"},
+           Format::F21c, Reference::Field);
+  setRange(0x6e, std::array<std::string_view, 5>{"invoke-virtual", "invoke-super", "invoke-direct", "invoke-static", "invoke-interface"}, Format::F35c,
+           Reference::Method);
+  setRange(0x74,
+           std::array<std::string_view, 5>{"invoke-virtual/range", "invoke-super/range", "invoke-direct/range", "invoke-static/range",
+                                           "invoke-interface/range"},
+           Format::F3rc, Reference::Method);
+  setRange(0x7b,
+           std::array<std::string_view, 21>{"neg-int",       "not-int",      "neg-long",       "not-long",        "neg-float",    "neg-double",
+                                            "int-to-long",   "int-to-float", "int-to-double",  "long-to-int",     "long-to-float", "long-to-double",
+                                            "float-to-int",  "float-to-long", "float-to-double", "double-to-int", "double-to-long", "double-to-float",
+                                            "int-to-byte",   "int-to-char",  "int-to-short"},
+           Format::F12x);
+  constexpr auto binaryOperations = std::array<std::string_view, 32>{
+      "add-int",  "sub-int",  "mul-int",  "div-int",  "rem-int",  "and-int",   "or-int",    "xor-int",    "shl-int",    "shr-int",    "ushr-int",
+      "add-long", "sub-long", "mul-long", "div-long", "rem-long", "and-long",  "or-long",   "xor-long",   "shl-long",   "shr-long",   "ushr-long",
+      "add-float", "sub-float", "mul-float", "div-float", "rem-float", "add-double", "sub-double", "mul-double", "div-double", "rem-double"};
+  setRange(0x90, binaryOperations, Format::F23x);
+  constexpr auto binaryOperations2Addr = std::array<std::string_view, 32>{
+      "add-int/2addr",    "sub-int/2addr",    "mul-int/2addr",    "div-int/2addr",    "rem-int/2addr",     "and-int/2addr",    "or-int/2addr",
+      "xor-int/2addr",    "shl-int/2addr",    "shr-int/2addr",    "ushr-int/2addr",   "add-long/2addr",    "sub-long/2addr",   "mul-long/2addr",
+      "div-long/2addr",   "rem-long/2addr",   "and-long/2addr",   "or-long/2addr",    "xor-long/2addr",    "shl-long/2addr",   "shr-long/2addr",
+      "ushr-long/2addr",  "add-float/2addr",  "sub-float/2addr",  "mul-float/2addr",  "div-float/2addr",   "rem-float/2addr",  "add-double/2addr",
+      "sub-double/2addr", "mul-double/2addr", "div-double/2addr", "rem-double/2addr"};
+  setRange(0xb0, binaryOperations2Addr, Format::F12x);
+  setRange(0xd0,
+           std::array<std::string_view, 8>{"add-int/lit16", "rsub-int", "mul-int/lit16", "div-int/lit16", "rem-int/lit16", "and-int/lit16", "or-int/lit16",
+                                           "xor-int/lit16"},
+           Format::F22s);
+  setRange(0xd8,
+           std::array<std::string_view, 11>{"add-int/lit8", "rsub-int/lit8", "mul-int/lit8", "div-int/lit8", "rem-int/lit8", "and-int/lit8", "or-int/lit8",
+                                            "xor-int/lit8", "shl-int/lit8", "shr-int/lit8", "ushr-int/lit8"},
+           Format::F22b);
+  set(0xfa, "invoke-polymorphic", Format::F45cc, Reference::Method);
+  set(0xfb, "invoke-polymorphic/range", Format::F4rcc, Reference::Method);
+  set(0xfc, "invoke-custom", Format::F35c, Reference::CallSite);
+  set(0xfd, "invoke-custom/range", Format::F3rc, Reference::CallSite);
+  set(0xfe, "const-method-handle", Format::F21c, Reference::MethodHandle);
+  set(0xff, "const-method-type", Format::F21c, Reference::Proto);
+  return opcodes;
+}
+
+inline constexpr auto OPCODES = makeOpcodes();
+
+//
+// Units of the payload at the address, 0 if there is none.  Payloads only
+// start where an instruction would, so a unit that looks like one inside
+// an instruction is never taken for it.  One running past the end of the
+// instructions throws, so that callers skipping it never wrap the address.
+//
+inline auto getPayloadSize(DexTable<uint16_t> const &instructions, uint32_t const address) -> uint32_t {
+  auto size = uint64_t{0};
+  switch (instructions[address]) {
+  case PACKED_SWITCH_PAYLOAD:
+    size = 4 + uint64_t{instructions[address + 1]} * 2;
+    break;
+  case SPARSE_SWITCH_PAYLOAD:
+    size = 2 + uint64_t{instructions[address + 1]} * 4;
+    break;
+  case FILL_ARRAY_DATA_PAYLOAD: {
+    auto const elementCount = instructions[address + 2] | uint64_t{instructions[address + 3]} << 16;
+    size = 4 + (uint64_t{instructions[address + 1]} * elementCount + 1) / 2;
+    break;
+  }
+  default:
+    return 0;
+  }
+  if (size > instructions.size() - address) {
+    throw std::out_of_range("dex payload out of range");
+  }
+  return static_cast<uint32_t>(size);
+}
+
+//
+// Units of the instruction or payload at the address.
+//
+inline auto getInstructionSize(DexTable<uint16_t> const &instructions, uint32_t const address) -> uint32_t {
+  auto const payloadSize = getPayloadSize(instructions, address);
+  return payloadSize > 0 ? payloadSize : getFormatSize(OPCODES[instructions[address] & 0xff].format);
+}
+
+} // namespace ai::dex
+
+#endif /* ANDROID_INTROSPECTION_DEX_INSTRUCTION_SET_H_ */
@@ -0,0 +1,266 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <future>
+#include <string>
+#include <utility>
+
+#include "dex/proguard_mapping.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
+
+using namespace ai::dex;
+
+namespace {
+
+//
+// Ranges smaller than this are not worth a task of their own.
+//
+static constexpr size_t MIN_RANGE_SIZE = 1 << 20;
+
+static constexpr auto MAPPING_SEPARATOR = std::string_view(" -> ");
+
+struct MappingRange {
+
+  std::vector<ProguardClass> classes;
+
+  std::vector<ProguardMember> members;
+
+  size_t skippedLines = 0;
+};
+
+auto trim(std::string_view text) -> std::string_view {
+  auto const isSpace = [](char const c) { return c == ' ' || c == '\t' || c == '\r'; };
+  while (!text.empty() && isSpace(text.front())) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && isSpace(text.back())) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+auto isClassLine(std::string_view const line) -> bool { return !line.empty() && line.front() != ' ' && line.front() != '\t' && line.front() != '#'; }
+
+//
+// Drops the "1:5:" of the line numbers a member line may start with.
+//
+auto skipLineNumbers(std::string_view line) -> std::string_view {
+  for (auto range = 0; range < 2 && !line.empty() && line.front() >= '0' && line.front() <= '9'; range++) {
+    auto const colon = line.find(':');
+    if (colon == std::string_view::npos || !std::all_of(line.begin(), line.begin() + static_cast<std::ptrdiff_t>(colon), [](char const c) {
+          return c >= '0' && c <= '9';
+        })) {
+      break;
+    }
+    line.remove_prefix(colon + 1);
+  }
+  return line;
+}
+
+//
+// "type name -> obfuscated" or "type name(arguments)[:line[:line]] ->
+// obfuscated", after the line numbers.
+//
+auto parseMember(std::string_view const line, uint32_t const classIndex) -> std::optional<ProguardMember> {
+  auto const separator = line.find(MAPPING_SEPARATOR);
+  if (separator == std::string_view::npos) {
+    return std::nullopt;
+  }
+  auto const declaration = trim(skipLineNumbers(trim(line.substr(0, separator))));
+  auto const obfuscatedName = trim(line.substr(separator + MAPPING_SEPARATOR.size()));
+  auto const typeEnd = declaration.find(' ');
+  if (typeEnd == std::string_view::npos || obfuscatedName.empty()) {
+    return std::nullopt;
+  }
+  auto member = ProguardMember{classIndex, false, declaration.substr(0, typeEnd), trim(declaration.substr(typeEnd + 1)), {}, obfuscatedName};
+  if (auto const argumentsStart = member.originalName.find('('); argumentsStart != std::string_view::npos) {
+    auto const argumentsEnd = member.originalName.find(')', argumentsStart);
+    if (argumentsEnd == std::string_view::npos) {
+      return std::nullopt;
+    }
+    member.isMethod = true;
+    member.arguments = member.originalName.substr(argumentsStart + 1, argumentsEnd - argumentsStart - 1);
+    member.originalName = member.originalName.substr(0, argumentsStart);
+  }
+  return member.originalName.empty() ? std::nullopt : std::optional(member);
+}
+
+auto parseRange(std::string_view const text) -> MappingRange {
+  auto range = MappingRange();
+  for (size_t lineStart{0}; lineStart < text.size();) {
+    auto const lineEnd = std::min(text.find('\n', lineStart), text.size());
+    auto const line = text.substr(lineStart, lineEnd - lineStart);
+    lineStart = lineEnd + 1;
+    auto const content = trim(line);
+    if (content.empty() || content.front() == '#') {
+      continue;
+    }
+    if (isClassLine(line)) {
+      auto const separator = content.find(MAPPING_SEPARATOR);
+      if (separator == std::string_view::npos || !content.ends_with(':')) {
+        range.skippedLines++;
+        continue;
+      }
+      auto const obfuscatedName = trim(content.substr(separator + MAPPING_SEPARATOR.size(), content.size() - separator - MAPPING_SEPARATOR.size() - 1));
+      range.classes.push_back(ProguardClass{trim(content.substr(0, separator)), obfuscatedName});
+      continue;
+    }
+    auto const member = range.classes.empty() ? std::nullopt : parseMember(content, static_cast<uint32_t>(range.classes.size() - 1));
+    if (member) {
+      range.members.push_back(*member);
+    } else {
+      range.skippedLines++;
+    }
+  }
+  return range;
+}
+
+//
+// Start of the first class line at or after the offset.
+//
+auto findClassLine(std::string_view const text, size_t const offset) -> size_t {
+  auto lineStart = offset;
+  if (offset > 0) {
+    auto const newline = text.find('\n', offset - 1);
+    lineStart = newline == std::string_view::npos ? text.size() : newline + 1;
+  }
+  while (lineStart < text.size()) {
+    auto const lineEnd = std::min(text.find('\n', lineStart), text.size());
+    if (isClassLine(text.substr(lineStart, lineEnd - lineStart))) {
+      return lineStart;
+    }
+    lineStart = lineEnd + 1;
+  }
+  return text.size();
+}
+
+} // namespace
+
+ProguardMapping::ProguardMapping(std::string const &path, utils::ThreadPool &threadPool) : file_(path) {
+  TRACE_SPAN("ProguardMapping::ProguardMapping");
+  auto const text = std::string_view(reinterpret_cast<char const *>(file_.bytes().data()), file_.size());
+  auto const rangeCount = std::clamp<size_t>(text.size() / MIN_RANGE_SIZE, 1, std::max<size_t>(threadPool.threadCount() * 4, 1));
+  auto rangeStarts = std::vector<size_t>{0};
+  for (auto range = size_t{1}; range < rangeCount; range++) {
+    rangeStarts.push_back(std::max(rangeStarts.back(), findClassLine(text, text.size() / rangeCount * range)));
+  }
+  rangeStarts.push_back(text.size());
+  auto futures = std::vector<std::future<MappingRange>>();
+  for (auto range = size_t{0}; range < rangeCount; range++) {
+    auto const rangeText = text.substr(rangeStarts[range], rangeStarts[range + 1] - rangeStarts[range]);
+    futures.push_back(threadPool.submit([rangeText] { return parseRange(rangeText); }));
+  }
+
+  for (auto &future : futures) {
+    future.wait();
+  }
+
+  //
+  // Ranges start at class lines, so appending them in order only shifts
+  // the class indexes of their members.
+  //
+  auto skippedLines = size_t{0};
+  for (auto &future : futures) {
+    auto range = future.get();
+    auto const classOffset = static_cast<uint32_t>(classes_.size());
+    classes_.insert(classes_.end(), range.classes.begin(), range.classes.end());
+    for (auto &member : range.members) {
+      member.classIndex += classOffset;
+      members_.push_back(member);
+    }
+    skippedLines += range.skippedLines;
+  }
+
+  //
+  // The four indexes are independent of each other; the first class of a
+  // name wins should a mapping repeat it.
+  //
+  auto const indexClasses = [this](std::unordered_map<std::string_view, uint32_t> &index, std::string_view ProguardClass::*name) {
+    index.reserve(classes_.size());
+    for (auto classIndex = uint32_t{0}; classIndex < classes_.size(); classIndex++) {
+      index.emplace(classes_[classIndex].*name, classIndex);
+    }
+  };
+  auto const indexMembers = [this](MemberIndex &index, std::string_view ProguardMember::*name) {
+    index.reserve(members_.size());
+    for (auto member = uint32_t{0}; member < members_.size(); member++) {
+      index.emplace(MemberKey{members_[member].classIndex, members_[member].*name}, member);
+    }
+  };
+  auto indexes = std::vector<std::future<void>>();
+  indexes.push_back(threadPool.submit([&] { indexClasses(classesByObfuscatedName_, &ProguardClass::obfuscatedName); }));
+  indexes.push_back(threadPool.submit([&] { indexClasses(classesByOriginalName_, &ProguardClass::originalName); }));
+  indexes.push_back(threadPool.submit([&] { indexMembers(membersByObfuscatedName_, &ProguardMember::obfuscatedName); }));
+  indexes.push_back(threadPool.submit([&] { indexMembers(membersByOriginalName_, &ProguardMember::originalName); }));
+  for (auto &index : indexes) {
+    index.wait();
+  }
+  for (auto &index : indexes) {
+    index.get();
+  }
+  LOGD("ProguardMapping, ranges [{}] classes [{}] members [{}] skipped lines [{}]", rangeCount, classes_.size(), members_.size(), skippedLines);
+}
+
+auto ProguardMapping::findObfuscatedClass(std::string_view const obfuscatedName) const -> std::optional<uint32_t> {
+  auto const found = classesByObfuscatedName_.find(obfuscatedName);
+  return found != classesByObfuscatedName_.end() ? std::optional(found->second) : std::nullopt;
+}
+
+auto ProguardMapping::findOriginalClass(std::string_view const originalName) const -> std::optional<uint32_t> {
+  auto const found = classesByOriginalName_.find(originalName);
+  return found != classesByOriginalName_.end() ? std::optional(found->second) : std::nullopt;
+}
+
+auto ProguardMapping::deobfuscateClassName(std::string_view const obfuscatedName) const -> std::string_view {
+  auto const classIndex = findObfuscatedClass(obfuscatedName);
+  return classIndex ? classes_[*classIndex].originalName : obfuscatedName;
+}
+
+auto ProguardMapping::findObfuscatedMembers(uint32_t const classIndex, std::string_view const obfuscatedName) const -> std::vector<ProguardMember const *> {
+  return findMembers(members_, membersByObfuscatedName_, MemberKey{classIndex, obfuscatedName});
+}
+
+auto ProguardMapping::findOriginalMembers(uint32_t const classIndex, std::string_view const originalName) const -> std::vector<ProguardMember const *> {
+  return findMembers(members_, membersByOriginalName_, MemberKey{classIndex, originalName});
+}
+
+auto ProguardMapping::findMembers(std::vector<ProguardMember> const &members, MemberIndex const &index, MemberKey const &key)
+    -> std::vector<ProguardMember const *> {
+  auto const [first, last] = index.equal_range(key);
+  auto found = std::vector<uint32_t>();
+  std::for_each(first, last, [&found](auto const &entry) { found.push_back(entry.second); });
+
+  //
+  // The order of equal keys in a multimap is unspecified.
+  //
+  std::sort(found.begin(), found.end());
+  auto foundMembers = std::vector<ProguardMember const *>();
+  foundMembers.reserve(found.size());
+  for (auto const member : found) {
+    foundMembers.push_back(&members[member]);
+  }
+  return foundMembers;
+}
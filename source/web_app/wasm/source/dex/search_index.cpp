@@ -0,0 +1,365 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+
+#include "dex/search_index.h"
+#include "utils/data_stream.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+#include "utils/unicode.h"
+
+using namespace ai::dex;
+
+namespace {
+
+static constexpr std::string_view CACHE_DATA_NAME = "search-index";
+
+//
+// "AISX"
+//
+static constexpr uint32_t INDEX_MAGIC = 0x58534941;
+
+static constexpr uint16_t INDEX_VERSION = 2;
+
+static constexpr uint64_t MAX_TEXT_ENTRY_SIZE = 16 * 1024 * 1024;
+
+//
+// Entries with a NUL in their first bytes are taken to be binary.
+//
+static constexpr std::size_t TEXT_PROBE_SIZE = 4096;
+
+static constexpr std::size_t TASKS_PER_THREAD = 4;
+
+static constexpr std::size_t TRIGRAM_SIZE = 3;
+
+static constexpr std::array<std::string_view, 18> TEXT_EXTENSIONS = {".txt", ".json", ".xml", ".html", ".htm", ".js",  ".css", ".properties", ".cfg",
+                                                                     ".conf", ".ini", ".yml", ".yaml", ".csv", ".md", ".pem", ".MF",  ".SF"};
+
+auto fold(char const c) -> char { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+auto getTrigram(std::string_view const text, std::size_t const offset) -> uint32_t {
+  return (uint32_t{static_cast<uint8_t>(fold(text[offset]))} << 16) | (uint32_t{static_cast<uint8_t>(fold(text[offset + 1]))} << 8) |
+         uint32_t{static_cast<uint8_t>(fold(text[offset + 2]))};
+}
+
+//
+// Compiled xml under res/ is binary; raw resources and assets are kept as
+// they are.
+//
+auto isTextEntry(ai::ApkEntry const &entry) -> bool {
+  if (entry.uncompressedSize == 0 || entry.uncompressedSize > MAX_TEXT_ENTRY_SIZE || entry.path.ends_with('/')) {
+    return false;
+  }
+  if (entry.path.starts_with("assets/") || entry.path.starts_with("res/raw/")) {
+    return true;
+  }
+  if (entry.path.starts_with("res/")) {
+    return false;
+  }
+  return std::any_of(TEXT_EXTENSIONS.begin(), TEXT_EXTENSIONS.end(), [&entry](auto const extension) { return entry.path.ends_with(extension); });
+}
+
+auto isText(std::span<std::byte const> const bytes) -> bool {
+  auto const probe = bytes.first(std::min(bytes.size(), TEXT_PROBE_SIZE));
+  return std::find(probe.begin(), probe.end(), std::byte{0}) == probe.end();
+}
+
+using ai::utils::little_endian::append;
+
+template <typename T> auto appendArray(std::vector<std::byte> &bytes, std::span<T const> const values) -> void {
+  auto const data = reinterpret_cast<std::byte const *>(values.data());
+  bytes.insert(bytes.end(), data, data + values.size_bytes());
+}
+
+auto skip(DataStream &stream, std::size_t const size) -> void {
+  if (size > UINT32_MAX) {
+    throw std::logic_error("invalid search index");
+  }
+  stream.skip(static_cast<uint32_t>(size));
+}
+
+template <typename T> auto readArray(DataStream &stream, std::span<std::byte const> const encoded, std::size_t const count) -> std::vector<T> {
+  stream.require(count * sizeof(T));
+  auto values = std::vector<T>(count);
+  memcpy(values.data(), encoded.data() + stream.position(), count * sizeof(T));
+  skip(stream, count * sizeof(T));
+  return values;
+}
+
+auto readString(DataStream &stream, std::span<std::byte const> const encoded) -> std::string {
+  auto const size = stream.read<uint32_t>();
+  stream.require(size);
+  auto const data = reinterpret_cast<char const *>(encoded.data() + stream.position());
+  stream.skip(size);
+  return std::string(data, size);
+}
+
+} // namespace
+
+SearchIndex::SearchIndex(Apk const &apk, ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool) {
+  auto const addDocument = [this](uint32_t const source, uint32_t const stringIndex, std::string_view const text) {
+    if (text.size() > UINT32_MAX - text_.size()) {
+      throw std::logic_error("too much text to index");
+    }
+    documents_.push_back(Document{source, stringIndex, static_cast<uint32_t>(text_.size()), static_cast<uint32_t>(text.size())});
+    text_ += text;
+  };
+
+  //
+  // Strings are indexed as UTF-8, so that patterns with supplementary
+  // characters match; one buffer is recycled for all of them.
+  //
+  auto decoded = std::string();
+  for (auto dexFile = std::size_t{0}; dexFile < dexFiles.size(); dexFile++) {
+    sources_.push_back(dexFiles.name(dexFile));
+    auto const &dex = dexFiles[dexFile];
+    for (auto stringIndex = uint32_t{0}; stringIndex < dex.stringCount(); stringIndex++) {
+      decoded.clear();
+      utils::unicode::appendUtf8FromMutf8(dex.string(stringIndex), decoded);
+      if (!decoded.empty()) {
+        addDocument(static_cast<uint32_t>(sources_.size() - 1), stringIndex, decoded);
+      }
+    }
+  }
+  for (auto const &entry : apk.getEntries()) {
+    if (!isTextEntry(entry)) {
+      continue;
+    }
+    auto const contents = apk.getFileBytes(entry.path);
+    if (isText(contents.bytes())) {
+      sources_.push_back(entry.path);
+      addDocument(static_cast<uint32_t>(sources_.size() - 1), NO_INDEX,
+                  std::string_view(reinterpret_cast<char const *>(contents.bytes().data()), contents.bytes().size()));
+    }
+  }
+  buildTrigrams(threadPool);
+  LOGD("SearchIndex, sources [{}] documents [{}] text [{}] trigrams [{}] postings [{}]", sources_.size(), documents_.size(), text_.size(), trigrams_.size(),
+       postings_.size());
+}
+
+SearchIndex::SearchIndex(std::span<std::byte const> const encoded) {
+  auto stream = DataStream(encoded);
+  if (stream.read<uint32_t>() != INDEX_MAGIC || stream.read<uint16_t>() != INDEX_VERSION) {
+    throw std::logic_error("unsupported search index");
+  }
+  stream.skip(sizeof(uint16_t));
+  auto const sourceCount = stream.read<uint32_t>();
+  for (auto i = uint32_t{0}; i < sourceCount; i++) {
+    sources_.push_back(readString(stream, encoded));
+  }
+  documents_ = readArray<Document>(stream, encoded, stream.read<uint32_t>());
+  auto const textSize = stream.read<uint64_t>();
+  stream.require(textSize);
+  text_.assign(reinterpret_cast<char const *>(encoded.data() + stream.position()), textSize);
+  skip(stream, textSize);
+  auto const trigramCount = stream.read<uint32_t>();
+  trigrams_ = readArray<uint32_t>(stream, encoded, trigramCount);
+  offsets_ = readArray<uint32_t>(stream, encoded, std::size_t{trigramCount} + 1);
+  postings_ = readArray<uint32_t>(stream, encoded, stream.read<uint32_t>());
+  validate();
+}
+
+auto SearchIndex::load(Apk const &apk, ApkDexFiles const &dexFiles, utils::ThreadPool &threadPool) -> SearchIndex {
+  if (auto const encoded = apk.loadCachedData(CACHE_DATA_NAME)) {
+    try {
+      return SearchIndex(*encoded);
+    } catch (std::exception const &exception) {
+      LOGW("load, ignoring cached search index, {}", exception.what());
+    }
+  }
+  auto index = SearchIndex(apk, dexFiles, threadPool);
+  apk.storeCachedData(CACHE_DATA_NAME, index.encode());
+  return index;
+}
+
+auto SearchIndex::encode() const -> std::vector<std::byte> {
+  auto encoded = std::vector<std::byte>();
+  append(encoded, INDEX_MAGIC);
+  append(encoded, INDEX_VERSION);
+  append(encoded, uint16_t{0});
+  append(encoded, static_cast<uint32_t>(sources_.size()));
+  for (auto const &source : sources_) {
+    append(encoded, static_cast<uint32_t>(source.size()));
+    appendArray(encoded, std::span<char const>(source));
+  }
+  append(encoded, static_cast<uint32_t>(documents_.size()));
+  appendArray(encoded, std::span<Document const>(documents_));
+  append(encoded, static_cast<uint64_t>(text_.size()));
+  appendArray(encoded, std::span<char const>(text_));
+  append(encoded, static_cast<uint32_t>(trigrams_.size()));
+  appendArray(encoded, std::span<uint32_t const>(trigrams_));
+  appendArray(encoded, std::span<uint32_t const>(offsets_));
+  append(encoded, static_cast<uint32_t>(postings_.size()));
+  appendArray(encoded, std::span<uint32_t const>(postings_));
+  return encoded;
+}
+
+auto SearchIndex::search(std::string_view const pattern, SearchOptions const &options) const -> std::vector<SearchMatch> {
+  auto matches = std::vector<SearchMatch>();
+  if (pattern.empty()) {
+    return matches;
+  }
+  auto const equal = [caseSensitive = options.caseSensitive](char const a, char const b) { return caseSensitive ? a == b : fold(a) == fold(b); };
+  auto const find = [&](uint32_t const documentIndex) {
+    auto const &document = documents_[documentIndex];
+    auto const documentText = text(document);
+    for (auto from = documentText.begin(); matches.size() < options.maxMatches;) {
+      auto const found = std::search(from, documentText.end(), pattern.begin(), pattern.end(), equal);
+      if (found == documentText.end()) {
+        break;
+      }
+      auto const offset = static_cast<std::size_t>(found - documentText.begin());
+      auto line = documentText;
+      if (document.stringIndex == NO_INDEX) {
+        auto const lineStart = documentText.rfind('\n', offset);
+        auto const begin = lineStart == std::string_view::npos ? 0 : lineStart + 1;
+        line = documentText.substr(begin, documentText.find('\n', offset) - begin);
+      }
+      matches.push_back(SearchMatch{sources_[document.source], document.stringIndex, static_cast<uint32_t>(offset), line});
+      from = found + 1;
+    }
+  };
+
+  if (pattern.size() < TRIGRAM_SIZE) {
+    for (auto document = uint32_t{0}; document < documents_.size() && matches.size() < options.maxMatches; document++) {
+      find(document);
+    }
+  } else {
+    for (auto const document : candidates(pattern)) {
+      if (matches.size() >= options.maxMatches) {
+        break;
+      }
+      find(document);
+    }
+  }
+  LOGD("search, pattern [{}] matches [{}]", pattern, matches.size());
+  return matches;
+}
+
+auto SearchIndex::text(Document const &document) const -> std::string_view { return std::string_view(text_).substr(document.offset, document.size); }
+
+auto SearchIndex::candidates(std::string_view const pattern) const -> std::vector<uint32_t> {
+  auto keys = std::vector<uint32_t>();
+  for (auto offset = std::size_t{0}; offset + TRIGRAM_SIZE <= pattern.size(); offset++) {
+    keys.push_back(getTrigram(pattern, offset));
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  auto lists = std::vector<std::span<uint32_t const>>();
+  for (auto const key : keys) {
+    auto const found = std::lower_bound(trigrams_.begin(), trigrams_.end(), key);
+    if (found == trigrams_.end() || *found != key) {
+      return {};
+    }
+    auto const index = static_cast<std::size_t>(found - trigrams_.begin());
+    lists.push_back(std::span(postings_).subspan(offsets_[index], offsets_[index + 1] - offsets_[index]));
+  }
+  std::sort(lists.begin(), lists.end(), [](auto const &a, auto const &b) { return a.size() < b.size(); });
+
+  auto result = std::vector<uint32_t>(lists.front().begin(), lists.front().end());
+  for (auto list = lists.begin() + 1; list != lists.end() && !result.empty(); list++) {
+    auto intersection = std::vector<uint32_t>();
+    std::set_intersection(result.begin(), result.end(), list->begin(), list->end(), std::back_inserter(intersection));
+    result = std::move(intersection);
+  }
+  return result;
+}
+
+auto SearchIndex::buildTrigrams(utils::ThreadPool &threadPool) -> void {
+  //
+  // Ranges of documents of about the same amount of text, a few per worker
+  // so that a large entry does not hold up the others.
+  //
+  auto const taskCount = std::max<std::size_t>(1, threadPool.threadCount() * TASKS_PER_THREAD);
+  auto const taskSize = text_.size() / taskCount + 1;
+  auto futures = std::vector<std::future<std::vector<uint64_t>>>();
+  for (auto begin = std::size_t{0}; begin < documents_.size();) {
+    auto end = begin;
+    for (auto size = std::size_t{0}; end < documents_.size() && size < taskSize; end++) {
+      size += documents_[end].size;
+    }
+    futures.push_back(threadPool.submit([this, begin, end] {
+      auto pairs = std::vector<uint64_t>();
+      auto trigrams = std::vector<uint32_t>();
+      for (auto document = begin; document < end; document++) {
+        auto const documentText = text(documents_[document]);
+        trigrams.clear();
+        for (auto offset = std::size_t{0}; offset + TRIGRAM_SIZE <= documentText.size(); offset++) {
+          trigrams.push_back(getTrigram(documentText, offset));
+        }
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+        for (auto const trigram : trigrams) {
+          pairs.push_back((uint64_t{trigram} << 32) | document);
+        }
+      }
+      std::sort(pairs.begin(), pairs.end());
+      return pairs;
+    }));
+    begin = end;
+  }
+
+  for (auto &future : futures) {
+    future.wait();
+  }
+  auto pairs = std::vector<uint64_t>();
+  for (auto &future : futures) {
+    auto const middle = static_cast<std::ptrdiff_t>(pairs.size());
+    auto const taskPairs = future.get();
+    pairs.insert(pairs.end(), taskPairs.begin(), taskPairs.end());
+    std::inplace_merge(pairs.begin(), pairs.begin() + middle, pairs.end());
+  }
+
+  trigrams_.clear();
+  offsets_.clear();
+  postings_.clear();
+  postings_.reserve(pairs.size());
+  for (auto const pair : pairs) {
+    auto const trigram = static_cast<uint32_t>(pair >> 32);
+    if (trigrams_.empty() || trigrams_.back() != trigram) {
+      trigrams_.push_back(trigram);
+      offsets_.push_back(static_cast<uint32_t>(postings_.size()));
+    }
+    postings_.push_back(static_cast<uint32_t>(pair));
+  }
+  offsets_.push_back(static_cast<uint32_t>(postings_.size()));
+}
+
+auto SearchIndex::validate() const -> void {
+  auto const validDocument = [this](Document const &document) {
+    return document.source < sources_.size() && document.offset <= text_.size() && document.size <= text_.size() - document.offset;
+  };
+  if (!std::all_of(documents_.begin(), documents_.end(), validDocument) || !std::is_sorted(trigrams_.begin(), trigrams_.end()) ||
+      !std::is_sorted(offsets_.begin(), offsets_.end()) || offsets_.front() != 0 || offsets_.back() != postings_.size() ||
+      !std::all_of(postings_.begin(), postings_.end(), [this](uint32_t const document) { return document < documents_.size(); })) {
+    throw std::logic_error("invalid search index");
+  }
+}
@@ -0,0 +1,193 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <future>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "dex/dex_file.h"
+#include "diff/apk_diff.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+
+using namespace ai::diff;
+
+namespace {
+
+static constexpr auto ANDROID_MANIFEST = std::string_view("AndroidManifest.xml");
+
+static constexpr auto RESOURCES_TABLE = std::string_view("resources.arsc");
+
+auto isDexFile(std::string_view const path) -> bool { return path.starts_with("classes") && path.ends_with(".dex") && path.find('/') == path.npos; }
+
+//
+// Items only one side has, each keeping its duplicates; both sides are
+// sorted on the way.
+//
+auto diffItems(std::vector<std::string> oldItems, std::vector<std::string> newItems, ApkEntryDiff &entryDiff) -> void {
+  std::sort(oldItems.begin(), oldItems.end());
+  std::sort(newItems.begin(), newItems.end());
+  std::set_difference(oldItems.begin(), oldItems.end(), newItems.begin(), newItems.end(), std::back_inserter(entryDiff.removed));
+  std::set_difference(newItems.begin(), newItems.end(), oldItems.begin(), oldItems.end(), std::back_inserter(entryDiff.added));
+}
+
+auto getLines(std::string_view text) -> std::vector<std::string> {
+  auto lines = std::vector<std::string>();
+  while (!text.empty()) {
+    auto const end = std::min(text.find('\n'), text.size());
+    auto line = text.substr(0, end);
+    line.remove_prefix(std::min(line.find_first_not_of(' '), line.size()));
+    if (!line.empty()) {
+      lines.emplace_back(line);
+    }
+    text.remove_prefix(std::min(end + 1, text.size()));
+  }
+  return lines;
+}
+
+auto getResources(ai::Apk const &apk) -> std::vector<std::string> {
+  auto resources = std::vector<std::string>();
+  for (auto const &[name, value] : apk.getResourceValues()) {
+    resources.push_back(name + " = " + value);
+  }
+  return resources;
+}
+
+struct DexContents {
+
+  std::set<std::string> classes;
+
+  //
+  // Methods of the classes the file defines, with the class they belong to.
+  //
+  std::map<std::string, std::string> methods;
+};
+
+auto getDexContents(std::span<std::byte const> const bytes) -> DexContents {
+  auto const dex = ai::dex::DexFile(bytes);
+  auto contents = DexContents();
+  auto classNames = std::vector<std::string>(dex.typeIds().size());
+  for (auto const classDef : dex.classDefs()) {
+    auto name = ai::dex::getClassName(dex.typeDescriptor(classDef.classIndex));
+    contents.classes.insert(name);
+    classNames.at(classDef.classIndex) = std::move(name);
+  }
+  auto const &methodIds = dex.methodIds();
+  for (auto method = uint32_t{0}; method < methodIds.size(); method++) {
+    auto const classIndex = methodIds[method].classIndex;
+    if (classIndex < classNames.size() && !classNames[classIndex].empty()) {
+      auto const &className = classNames[classIndex];
+      contents.methods.emplace(className + '.' + std::string(dex.methodName(method)) + dex.methodSignature(method), className);
+    }
+  }
+  return contents;
+}
+
+auto diffDexFiles(std::span<std::byte const> const oldBytes, std::span<std::byte const> const newBytes, ApkEntryDiff &entryDiff) -> void {
+  auto const oldContents = getDexContents(oldBytes);
+  auto const newContents = getDexContents(newBytes);
+  auto removedClasses = std::vector<std::string>();
+  auto addedClasses = std::vector<std::string>();
+  std::set_difference(oldContents.classes.begin(), oldContents.classes.end(), newContents.classes.begin(), newContents.classes.end(),
+                      std::back_inserter(removedClasses));
+  std::set_difference(newContents.classes.begin(), newContents.classes.end(), oldContents.classes.begin(), oldContents.classes.end(),
+                      std::back_inserter(addedClasses));
+  for (auto const &name : removedClasses) {
+    entryDiff.removed.push_back("class " + name);
+  }
+  for (auto const &name : addedClasses) {
+    entryDiff.added.push_back("class " + name);
+  }
+
+  auto const diffMethods = [](DexContents const &contents, DexContents const &otherContents, std::vector<std::string> const &skippedClasses,
+                              std::vector<std::string> &methods) {
+    for (auto const &[method, className] : contents.methods) {
+      if (!otherContents.methods.contains(method) && !std::binary_search(skippedClasses.begin(), skippedClasses.end(), className)) {
+        methods.push_back("method " + method);
+      }
+    }
+  };
+  diffMethods(oldContents, newContents, removedClasses, entryDiff.removed);
+  diffMethods(newContents, oldContents, addedClasses, entryDiff.added);
+}
+
+} // namespace
+
+auto ai::diff::diffApks(Apk const &oldApk, Apk const &newApk, utils::ThreadPool &threadPool) -> ApkDiff {
+  auto oldEntries = std::unordered_map<std::string, ApkEntry>();
+  for (auto &entry : oldApk.getEntries()) {
+    auto path = entry.path;
+    oldEntries.emplace(std::move(path), std::move(entry));
+  }
+
+  auto apkDiff = ApkDiff();
+  auto modifiedPaths = std::vector<std::string>();
+  for (auto const &newEntry : newApk.getEntries()) {
+    auto const oldEntry = oldEntries.find(newEntry.path);
+    if (oldEntry == oldEntries.end()) {
+      apkDiff.entries.push_back(ApkEntryDiff{newEntry.path, ApkEntryChange::Added, {}, {}});
+      continue;
+    }
+    if (oldEntry->second.uncompressedSize == newEntry.uncompressedSize && oldEntry->second.crc == newEntry.crc) {
+      apkDiff.unchangedEntries++;
+    } else {
+      modifiedPaths.push_back(newEntry.path);
+    }
+    oldEntries.erase(oldEntry);
+  }
+  for (auto const &[path, oldEntry] : oldEntries) {
+    apkDiff.entries.push_back(ApkEntryDiff{path, ApkEntryChange::Removed, {}, {}});
+  }
+
+  //
+  // Modified DEX files are read here, as Apk is not thread safe, and only
+  // their parsing is spread over the pool.
+  //
+  auto dexDiffs = std::vector<std::future<ApkEntryDiff>>();
+  for (auto const &path : modifiedPaths) {
+    auto entryDiff = ApkEntryDiff{path, ApkEntryChange::Modified, {}, {}};
+    if (path == ANDROID_MANIFEST) {
+      diffItems(getLines(oldApk.getAndroidManifest()), getLines(newApk.getAndroidManifest()), entryDiff);
+    } else if (path == RESOURCES_TABLE) {
+      diffItems(getResources(oldApk), getResources(newApk), entryDiff);
+    } else if (isDexFile(path)) {
+      dexDiffs.push_back(threadPool.submit([oldBytes = oldApk.getFileBytes(path), newBytes = newApk.getFileBytes(path), entryDiff]() mutable {
+        diffDexFiles(oldBytes.bytes(), newBytes.bytes(), entryDiff);
+        return entryDiff;
+      }));
+      continue;
+    }
+    apkDiff.entries.push_back(std::move(entryDiff));
+  }
+  for (auto &dexDiff : dexDiffs) {
+    apkDiff.entries.push_back(dexDiff.get());
+  }
+  std::sort(apkDiff.entries.begin(), apkDiff.entries.end(), [](auto const &a, auto const &b) { return a.path < b.path; });
+  LOGD("diffApks, changed [{}] unchanged [{}]", apkDiff.entries.size(), apkDiff.unchangedEntries);
+  return apkDiff;
+}
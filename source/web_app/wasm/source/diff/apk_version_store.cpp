@@ -0,0 +1,423 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "apk/apk.h"
+#include "diff/apk_version_store.h"
+#include "utils/crc32.h"
+#include "utils/file_output.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+#include "utils/mapped_file.h"
+#include "utils/trace.h"
+
+using namespace ai::diff;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+static constexpr uint32_t VERSION_MAGIC = 0x564b5041;
+
+static constexpr uint32_t VERSION_FORMAT = 1;
+
+static constexpr uint32_t NO_SOURCE = UINT32_MAX;
+
+static constexpr auto VERSION_EXTENSION = std::string_view(".apkv");
+
+static constexpr uint32_t LOCAL_FILE_HEADER_SIGNATURE = 0x04034b50;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_SIZE = 30;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_FILE_NAME_LENGTH_OFFSET = 26;
+
+static constexpr uint64_t LOCAL_FILE_HEADER_EXTRA_FIELD_LENGTH_OFFSET = 28;
+
+//
+// A version file is this header, the segments, the entries, each followed
+// by its path, and the literal bytes of the version.
+//
+struct VersionHeader {
+
+  uint32_t magic;
+
+  uint32_t format;
+
+  uint64_t apkSize;
+
+  uint64_t literalsOffset;
+
+  uint32_t segmentCount;
+
+  uint32_t entryCount;
+};
+
+//
+// Next length bytes of the version, at offset in the literals of the file
+// of version source.
+//
+struct Segment {
+
+  uint64_t offset;
+
+  uint64_t length;
+
+  uint32_t source;
+
+  uint32_t reserved;
+};
+
+//
+// Central directory fields of an entry, whether its compressed data was
+// shared, and where in the store that data is, if anywhere: the data of
+// entries that overlap others is left out of the table, and never shared.
+//
+struct StoredEntry {
+
+  uint64_t compressedSize;
+
+  uint64_t uncompressedSize;
+
+  uint64_t dataOffset;
+
+  uint32_t crc;
+
+  //
+  // CRC-32 of the compressed data, since the same contents can be deflated
+  // to different bytes.
+  //
+  uint32_t dataCrc;
+
+  uint32_t dataSource;
+
+  uint16_t compressionMethod;
+
+  uint16_t pathSize;
+};
+
+static_assert(sizeof(VersionHeader) == 32 && sizeof(Segment) == 24 && sizeof(StoredEntry) == 40);
+
+struct VersionEntry {
+
+  std::string path;
+
+  StoredEntry stored;
+};
+
+struct VersionTable {
+
+  VersionHeader header;
+
+  std::vector<Segment> segments;
+
+  std::vector<VersionEntry> entries;
+};
+
+using DataKey = std::tuple<uint32_t, uint32_t, uint64_t, uint64_t, uint16_t>;
+
+auto getDataKey(StoredEntry const &stored) -> DataKey {
+  return DataKey{stored.crc, stored.dataCrc, stored.compressedSize, stored.uncompressedSize, stored.compressionMethod};
+}
+
+using ai::utils::little_endian::load;
+
+using ai::utils::little_endian::append;
+
+auto readVersionTable(std::span<std::byte const> const file) -> VersionTable {
+  static constexpr auto error = "invalid version store file";
+  auto table = VersionTable();
+  table.header = load<VersionHeader>(file, 0, error);
+  if (table.header.magic != VERSION_MAGIC || table.header.format != VERSION_FORMAT || table.header.literalsOffset > file.size()) {
+    throw std::logic_error(error);
+  }
+  auto offset = uint64_t{sizeof(VersionHeader)};
+  auto size = uint64_t{0};
+  table.segments.reserve(std::min<uint64_t>(table.header.segmentCount, file.size() / sizeof(Segment)));
+  for (auto i = uint32_t{0}; i < table.header.segmentCount; i++, offset += sizeof(Segment)) {
+    auto const &segment = table.segments.emplace_back(load<Segment>(file, offset, error));
+    size += segment.length;
+  }
+  if (size != table.header.apkSize) {
+    throw std::logic_error(error);
+  }
+  table.entries.reserve(std::min<uint64_t>(table.header.entryCount, file.size() / sizeof(StoredEntry)));
+  for (auto i = uint32_t{0}; i < table.header.entryCount; i++) {
+    auto const stored = load<StoredEntry>(file, offset, error);
+    offset += sizeof(StoredEntry);
+    if (stored.pathSize > file.size() - std::min<uint64_t>(offset, file.size())) {
+      throw std::logic_error(error);
+    }
+    table.entries.push_back(VersionEntry{std::string(reinterpret_cast<char const *>(file.data() + offset), stored.pathSize), stored});
+    offset += stored.pathSize;
+  }
+  return table;
+}
+
+//
+// Offset of the compressed data of the entry, from its local header.
+//
+auto getDataOffset(std::span<std::byte const> const apk, ai::ApkEntry const &entry) -> uint64_t {
+  static constexpr auto error = "invalid local file header";
+  if (load<uint32_t>(apk, entry.offset, error) != LOCAL_FILE_HEADER_SIGNATURE) {
+    throw std::logic_error(error);
+  }
+  auto const dataOffset = entry.offset + LOCAL_FILE_HEADER_SIZE + load<uint16_t>(apk, entry.offset + LOCAL_FILE_HEADER_FILE_NAME_LENGTH_OFFSET, error) +
+                          load<uint16_t>(apk, entry.offset + LOCAL_FILE_HEADER_EXTRA_FIELD_LENGTH_OFFSET, error);
+  if (dataOffset > apk.size() || entry.compressedSize > apk.size() - dataOffset) {
+    throw std::logic_error("entry data is out of bounds");
+  }
+  return dataOffset;
+}
+
+//
+// Literal bytes of a version file.
+//
+struct VersionLiterals {
+
+  explicit VersionLiterals(std::string const &path) : file(path) {
+    auto const header = load<VersionHeader>(file.bytes(), 0, "invalid version store file");
+    if (header.magic != VERSION_MAGIC || header.format != VERSION_FORMAT || header.literalsOffset > file.size()) {
+      throw std::logic_error("invalid version store file");
+    }
+    bytes = file.bytes().subspan(header.literalsOffset);
+  }
+
+  ai::utils::MappedFile file;
+
+  std::span<std::byte const> bytes;
+};
+
+} // namespace
+
+ApkVersionStore::ApkVersionStore(std::string_view const directory) : directory_(directory) {
+  fs::create_directories(directory_);
+  while (fs::exists(getVersionPath(versionCount_))) {
+    versionCount_++;
+  }
+  LOGD("version store [{}] with [{}] versions", directory_, versionCount_);
+}
+
+auto ApkVersionStore::getVersionPath(size_t const version) const -> std::string {
+  return (fs::path(directory_) / (std::to_string(version) + std::string(VERSION_EXTENSION))).string();
+}
+
+auto ApkVersionStore::add(std::string_view const apkPath) -> ApkVersion {
+  TRACE_SPAN("ApkVersionStore::add");
+  if (versionCount_ >= NO_SOURCE) {
+    throw std::logic_error("unable to add version; store is full");
+  }
+  auto const version = static_cast<uint32_t>(versionCount_);
+  auto const mapping = utils::MappedFile(std::string(apkPath));
+  auto const apk = mapping.bytes();
+
+  //
+  // Compressed data of the previous version, wherever it is in the store.
+  //
+  auto sharedData = std::map<DataKey, std::pair<uint32_t, uint64_t>>();
+  if (version > 0) {
+    auto const previous = utils::MappedFile(getVersionPath(version - 1));
+    for (auto const &entry : readVersionTable(previous.bytes()).entries) {
+      if (entry.stored.dataSource != NO_SOURCE) {
+        sharedData.emplace(getDataKey(entry.stored), std::pair(entry.stored.dataSource, entry.stored.dataOffset));
+      }
+    }
+  }
+
+  auto entries = std::vector<VersionEntry>();
+  auto dataOffsets = std::vector<std::pair<uint64_t, size_t>>();
+  for (auto &apkEntry : Apk(apkPath).getEntries()) {
+    if (apkEntry.path.size() > UINT16_MAX) {
+      throw std::logic_error("invalid entry path");
+    }
+    auto const dataOffset = getDataOffset(apk, apkEntry);
+    auto const dataCrc = utils::crc32::update(0, apk.subspan(dataOffset, apkEntry.compressedSize));
+    auto const stored = StoredEntry{apkEntry.compressedSize,  apkEntry.uncompressedSize, 0, apkEntry.crc, dataCrc, NO_SOURCE, apkEntry.compressionMethod,
+                                    static_cast<uint16_t>(apkEntry.path.size())};
+    dataOffsets.emplace_back(dataOffset, entries.size());
+    entries.push_back(VersionEntry{std::move(apkEntry.path), stored});
+  }
+  std::sort(dataOffsets.begin(), dataOffsets.end());
+
+  //
+  // Covers the APK front to back with segments, sharing the data of
+  // entries the previous version has and keeping everything else, merging
+  // segments that follow each other.
+  //
+  auto segments = std::vector<Segment>();
+  auto literalSize = uint64_t{0};
+  auto const addSegment = [&segments](uint32_t const source, uint64_t const offset, uint64_t const length) {
+    if (length == 0) {
+      return;
+    }
+    if (!segments.empty() && segments.back().source == source && segments.back().offset + segments.back().length == offset) {
+      segments.back().length += length;
+    } else {
+      segments.push_back(Segment{offset, length, source, 0});
+    }
+  };
+  auto const addLiteral = [&addSegment, &literalSize, version](uint64_t const length) {
+    addSegment(version, literalSize, length);
+    literalSize += length;
+  };
+  auto sharedEntries = size_t{0};
+  auto sources = std::unordered_map<uint32_t, std::unique_ptr<VersionLiterals>>();
+  auto const isSameData = [&](uint32_t const source, uint64_t const offset, std::span<std::byte const> const data) {
+    auto &literals = sources[source];
+    if (!literals) {
+      literals = std::make_unique<VersionLiterals>(getVersionPath(source));
+    }
+    return offset <= literals->bytes.size() && data.size() <= literals->bytes.size() - offset &&
+           std::ranges::equal(literals->bytes.subspan(offset, data.size()), data);
+  };
+  auto position = uint64_t{0};
+  for (auto const &[dataOffset, entry] : dataOffsets) {
+    auto &stored = entries[entry].stored;
+    if (dataOffset < position) {
+      continue;
+    }
+    addLiteral(dataOffset - position);
+    //
+    // The key only makes it likely that the data is the same; it is shared
+    // if it is.
+    //
+    auto const shared = sharedData.find(getDataKey(stored));
+    if (shared != sharedData.end() && isSameData(shared->second.first, shared->second.second, apk.subspan(dataOffset, stored.compressedSize))) {
+      std::tie(stored.dataSource, stored.dataOffset) = shared->second;
+      addSegment(stored.dataSource, stored.dataOffset, stored.compressedSize);
+      sharedEntries++;
+    } else {
+      stored.dataSource = version;
+      stored.dataOffset = literalSize;
+      addLiteral(stored.compressedSize);
+    }
+    position = dataOffset + stored.compressedSize;
+  }
+  addLiteral(apk.size() - position);
+
+  auto table = std::vector<std::byte>();
+  auto header = VersionHeader{VERSION_MAGIC, VERSION_FORMAT, apk.size(), 0, static_cast<uint32_t>(segments.size()), static_cast<uint32_t>(entries.size())};
+  append(table, header);
+  for (auto const &segment : segments) {
+    append(table, segment);
+  }
+  for (auto const &entry : entries) {
+    append(table, entry.stored);
+    auto const path = std::as_bytes(std::span(entry.path));
+    table.insert(table.end(), path.begin(), path.end());
+  }
+  header.literalsOffset = table.size();
+  memcpy(table.data(), &header, sizeof(header));
+
+  //
+  // Written aside and renamed into place, so that a store never holds a
+  // partial version.
+  //
+  auto const versionPath = getVersionPath(version);
+  auto const temporaryPath = versionPath + ".tmp";
+  {
+    auto writer = utils::FileWriter(temporaryPath, table.size() + literalSize);
+    writer.write(table);
+    auto offset = uint64_t{0};
+    for (auto const &segment : segments) {
+      if (segment.source == version) {
+        writer.write(apk.subspan(offset, segment.length));
+      }
+      offset += segment.length;
+    }
+    writer.close();
+  }
+  fs::rename(temporaryPath, versionPath);
+  versionCount_++;
+  LOGD("add, version [{}] keeps [{}] of [{}] bytes, [{}] of [{}] entries shared", version, literalSize, apk.size(), sharedEntries, entries.size());
+  return ApkVersion{version, apk.size(), literalSize, entries.size(), sharedEntries};
+}
+
+auto ApkVersionStore::rebuild(size_t const version, std::function<void(std::span<std::byte const>)> const &sink) const -> void {
+  TRACE_SPAN("ApkVersionStore::rebuild");
+  if (version >= versionCount_) {
+    throw std::invalid_argument("unknown version");
+  }
+  auto const table = readVersionTable(utils::MappedFile(getVersionPath(version)).bytes());
+  auto sources = std::unordered_map<uint32_t, std::unique_ptr<VersionLiterals>>();
+  for (auto const &segment : table.segments) {
+    if (segment.source > version) {
+      throw std::logic_error("invalid version store file");
+    }
+    auto &source = sources[segment.source];
+    if (!source) {
+      source = std::make_unique<VersionLiterals>(getVersionPath(segment.source));
+    }
+    auto const literals = source->bytes;
+    if (segment.offset > literals.size() || segment.length > literals.size() - segment.offset) {
+      throw std::logic_error("invalid version store file");
+    }
+    sink(literals.subspan(segment.offset, segment.length));
+  }
+}
+
+auto ApkVersionStore::rebuild(size_t const version, std::string_view const destinationPath) const -> void {
+  auto writer = utils::FileWriter(std::string(destinationPath));
+  rebuild(version, [&writer](std::span<std::byte const> const bytes) { writer.write(bytes); });
+  writer.close();
+}
+
+auto ApkVersionStore::diff(size_t const version) const -> ApkDiff {
+  if (version >= versionCount_) {
+    throw std::invalid_argument("unknown version");
+  }
+  auto previousEntries = std::unordered_map<std::string, StoredEntry>();
+  if (version > 0) {
+    for (auto &entry : readVersionTable(utils::MappedFile(getVersionPath(version - 1)).bytes()).entries) {
+      previousEntries.emplace(std::move(entry.path), entry.stored);
+    }
+  }
+  auto apkDiff = ApkDiff();
+  for (auto const &entry : readVersionTable(utils::MappedFile(getVersionPath(version)).bytes()).entries) {
+    auto const previous = previousEntries.find(entry.path);
+    if (previous == previousEntries.end()) {
+      apkDiff.entries.push_back(ApkEntryDiff{entry.path, ApkEntryChange::Added, {}, {}});
+      continue;
+    }
+    if (previous->second.uncompressedSize == entry.stored.uncompressedSize && previous->second.crc == entry.stored.crc) {
+      apkDiff.unchangedEntries++;
+    } else {
+      apkDiff.entries.push_back(ApkEntryDiff{entry.path, ApkEntryChange::Modified, {}, {}});
+    }
+    previousEntries.erase(previous);
+  }
+  for (auto const &[path, stored] : previousEntries) {
+    apkDiff.entries.push_back(ApkEntryDiff{path, ApkEntryChange::Removed, {}, {}});
+  }
+  std::sort(apkDiff.entries.begin(), apkDiff.entries.end(), [](auto const &a, auto const &b) { return a.path < b.path; });
+  return apkDiff;
+}
@@ -0,0 +1,216 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+
+#include "apk/apk.h"
+#include "diff/apk_diff.h"
+#include "diff/apk_version_store.h"
+#include "utils/mapped_file.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct TestEnvironment {
+  std::string testsDir;
+};
+
+std::unique_ptr<TestEnvironment> gTestEnvironment;
+
+auto setEnvironmentIfReady() -> bool {
+  auto const testsDir = std::getenv("AI_TESTS_DIR");
+  if (testsDir == nullptr) {
+    LOGE("tests directory is not defined");
+    return false;
+  }
+
+  gTestEnvironment = std::make_unique<TestEnvironment>();
+  gTestEnvironment->testsDir = testsDir;
+
+  return true;
+}
+
+fs::path getTestApkPath(char const *fileName) { return fs::path(gTestEnvironment->testsDir) / "resources" / "apks" / fileName; }
+
+} // namespace
+
+TEST(ApkDiff, diffReleaseApkWithItself_NoEntryDiffers) {
+  auto const apk = ai::Apk(getTestApkPath("test_release.apk").string());
+  auto threadPool = ai::utils::ThreadPool(2);
+  auto const apkDiff = ai::diff::diffApks(apk, apk, threadPool);
+  EXPECT_TRUE(apkDiff.entries.empty());
+  EXPECT_EQ(apkDiff.unchangedEntries, apk.getFiles().size());
+}
+
+TEST(ApkDiff, diffModifiedCopy_OnlyChangedEntriesAreReported) {
+  auto pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto pathToCopiedApk = fs::temp_directory_path() / "diffModifiedCopy_OnlyChangedEntriesAreReported.apk";
+  auto isCopiedSuccessfully = fs::copy_file(pathToOriginalApk, pathToCopiedApk, fs::copy_options::overwrite_existing);
+  EXPECT_TRUE(isCopiedSuccessfully);
+
+  {
+    auto const originalApk = ai::Apk(pathToOriginalApk.string());
+    auto const copiedApk = ai::Apk(pathToCopiedApk.string());
+    copiedApk.makeDebuggable();
+    copiedApk.setFileContent("test_file", std::vector<std::byte>{std::byte(0x1)});
+
+    //
+    // Only the header checksum of the DEX file changes, so it differs by
+    // CRC but not by contents.
+    //
+    auto dex = copiedApk.getFileContent("classes.dex");
+    dex[8] = ~dex[8];
+    copiedApk.setFileContent("classes.dex", dex);
+
+    auto threadPool = ai::utils::ThreadPool(2);
+    auto const apkDiff = ai::diff::diffApks(originalApk, copiedApk, threadPool);
+    ASSERT_EQ(apkDiff.entries.size(), 3);
+    EXPECT_EQ(apkDiff.unchangedEntries, originalApk.getFiles().size() - 2);
+
+    auto const &manifest = apkDiff.entries[0];
+    EXPECT_EQ(manifest.path, "AndroidManifest.xml");
+    EXPECT_EQ(manifest.change, ai::diff::ApkEntryChange::Modified);
+    ASSERT_EQ(manifest.added.size(), 1);
+    EXPECT_NE(manifest.added.front().find("debuggable=\"true\""), std::string::npos);
+
+    auto const &dexDiff = apkDiff.entries[1];
+    EXPECT_EQ(dexDiff.path, "classes.dex");
+    EXPECT_EQ(dexDiff.change, ai::diff::ApkEntryChange::Modified);
+    EXPECT_TRUE(dexDiff.added.empty());
+    EXPECT_TRUE(dexDiff.removed.empty());
+
+    EXPECT_EQ(apkDiff.entries[2].path, "test_file");
+    EXPECT_EQ(apkDiff.entries[2].change, ai::diff::ApkEntryChange::Added);
+  }
+  fs::remove(pathToCopiedApk);
+}
+
+TEST(ApkVersionStore, addModifiedCopy_VersionsRebuildAndShareUnchangedData) {
+  auto pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto pathToCopiedApk = fs::temp_directory_path() / "addModifiedCopy_VersionsRebuildAndShareUnchangedData.apk";
+  auto pathToStore = fs::temp_directory_path() / "addModifiedCopy_VersionsRebuildAndShareUnchangedData";
+  auto pathToRebuiltApk = fs::temp_directory_path() / "addModifiedCopy_VersionsRebuildAndShareUnchangedData_rebuilt.apk";
+  fs::remove_all(pathToStore);
+  auto isCopiedSuccessfully = fs::copy_file(pathToOriginalApk, pathToCopiedApk, fs::copy_options::overwrite_existing);
+  EXPECT_TRUE(isCopiedSuccessfully);
+
+  {
+    auto const copiedApk = ai::Apk(pathToCopiedApk.string());
+    copiedApk.makeDebuggable();
+    copiedApk.setFileContent("test_file", std::vector<std::byte>{std::byte(0x1)});
+  }
+
+  {
+    auto store = ai::diff::ApkVersionStore(pathToStore.string());
+    auto const original = store.add(pathToOriginalApk.string());
+    EXPECT_EQ(original.storedBytes, original.size);
+    EXPECT_EQ(original.sharedEntries, 0);
+    auto const copied = store.add(pathToCopiedApk.string());
+    EXPECT_EQ(copied.sharedEntries, copied.entries - 2);
+    EXPECT_LT(copied.storedBytes, copied.size / 2);
+  }
+
+  auto const store = ai::diff::ApkVersionStore(pathToStore.string());
+  ASSERT_EQ(store.versionCount(), 2);
+  for (auto const &[version, path] : {std::pair(size_t{0}, pathToOriginalApk), std::pair(size_t{1}, pathToCopiedApk)}) {
+    store.rebuild(version, pathToRebuiltApk.string());
+    auto const expected = ai::utils::MappedFile(path.string());
+    auto const rebuilt = ai::utils::MappedFile(pathToRebuiltApk.string());
+    EXPECT_TRUE(std::ranges::equal(rebuilt.bytes(), expected.bytes()));
+  }
+
+  auto const versionDiff = store.diff(1);
+  ASSERT_EQ(versionDiff.entries.size(), 2);
+  EXPECT_EQ(versionDiff.entries[0].path, "AndroidManifest.xml");
+  EXPECT_EQ(versionDiff.entries[0].change, ai::diff::ApkEntryChange::Modified);
+  EXPECT_EQ(versionDiff.entries[1].path, "test_file");
+  EXPECT_EQ(versionDiff.entries[1].change, ai::diff::ApkEntryChange::Added);
+
+  fs::remove(pathToRebuiltApk);
+  fs::remove(pathToCopiedApk);
+  fs::remove_all(pathToStore);
+}
+
+TEST(ApkVersionStore, addCopyOfVersionWithDifferentDataUnderSameKey_DataIsNotShared) {
+  auto pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto pathToStore = fs::temp_directory_path() / "addCopyOfVersionWithDifferentDataUnderSameKey_DataIsNotShared";
+  auto pathToRebuiltApk = fs::temp_directory_path() / "addCopyOfVersionWithDifferentDataUnderSameKey_DataIsNotShared_rebuilt.apk";
+  fs::remove_all(pathToStore);
+
+  auto store = ai::diff::ApkVersionStore(pathToStore.string());
+  auto const original = store.add(pathToOriginalApk.string());
+
+  //
+  // Changes a byte of the stored data of the manifest behind the back of
+  // the store, so that its key no longer matches its data.
+  //
+  {
+    auto const entries = ai::Apk(pathToOriginalApk.string()).getEntries();
+    auto const manifest = std::ranges::find(entries, "AndroidManifest.xml", &ai::ApkEntry::path);
+    ASSERT_NE(manifest, entries.end());
+    auto const apk = ai::utils::MappedFile(pathToOriginalApk.string());
+    auto extraFieldSize = uint16_t();
+    memcpy(&extraFieldSize, apk.bytes().data() + manifest->offset + 28, sizeof(extraFieldSize));
+    auto const dataOffset = manifest->offset + 30 + manifest->path.size() + extraFieldSize;
+
+    auto version = std::fstream(pathToStore / "0.apkv", std::ios::in | std::ios::out | std::ios::binary);
+    auto literalsOffset = uint64_t();
+    version.seekg(16);
+    version.read(reinterpret_cast<char *>(&literalsOffset), sizeof(literalsOffset));
+    auto byte = char();
+    version.seekg(static_cast<std::streamoff>(literalsOffset + dataOffset));
+    version.read(&byte, 1);
+    byte = static_cast<char>(~byte);
+    version.seekp(static_cast<std::streamoff>(literalsOffset + dataOffset));
+    version.write(&byte, 1);
+  }
+
+  auto const copy = store.add(pathToOriginalApk.string());
+  EXPECT_EQ(copy.sharedEntries, original.entries - 1);
+  store.rebuild(1, pathToRebuiltApk.string());
+  auto const expected = ai::utils::MappedFile(pathToOriginalApk.string());
+  auto const rebuilt = ai::utils::MappedFile(pathToRebuiltApk.string());
+  EXPECT_TRUE(std::ranges::equal(rebuilt.bytes(), expected.bytes()));
+
+  fs::remove(pathToRebuiltApk);
+  fs::remove_all(pathToStore);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  if (setEnvironmentIfReady()) {
+    return RUN_ALL_TESTS();
+  } else {
+    return -1;
+  }
+}
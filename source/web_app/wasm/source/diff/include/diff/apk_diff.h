@@ -0,0 +1,87 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DIFF_APK_DIFF_H_
+#define ANDROID_INTROSPECTION_DIFF_APK_DIFF_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "apk/apk.h"
+
+namespace ai {
+
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+} // namespace ai
+
+namespace ai::diff {
+
+enum class ApkEntryChange { Added, Removed, Modified };
+
+struct ApkEntryDiff {
+
+  std::string path;
+
+  ApkEntryChange change;
+
+  //
+  // What a modified manifest, resource table or DEX file lost and gained:
+  // lines of the decoded manifest, "type/name = value" for resources, and
+  // "class name" and "method class.name(signature)" for DEX files, where
+  // methods of added or removed classes are left out.  Empty for other
+  // entries.
+  //
+  std::vector<std::string> removed;
+
+  std::vector<std::string> added;
+};
+
+struct ApkDiff {
+
+  //
+  // Entries that differ, sorted by path.
+  //
+  std::vector<ApkEntryDiff> entries;
+
+  //
+  // Entries with the same path, size and CRC-32 in both APKs, which are
+  // taken to be identical without being read.
+  //
+  std::size_t unchangedEntries = 0;
+};
+
+//
+// Compares the central directories of the APKs and only reads the entries
+// whose size or CRC-32 differ, decoding modified manifests, resource tables
+// and DEX files to diff their contents.  Entries are read on the calling
+// thread, and DEX files are parsed and compared on the pool.
+//
+auto diffApks(Apk const &oldApk, Apk const &newApk, utils::ThreadPool &threadPool) -> ApkDiff;
+
+} // namespace ai::diff
+
+#endif /* ANDROID_INTROSPECTION_DIFF_APK_DIFF_H_ */
@@ -0,0 +1,113 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_DIFF_APK_VERSION_STORE_H_
+#define ANDROID_INTROSPECTION_DIFF_APK_VERSION_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "diff/apk_diff.h"
+
+namespace ai::diff {
+
+//
+// What adding an APK to a store took.
+//
+struct ApkVersion {
+
+  size_t version;
+
+  uint64_t size;
+
+  //
+  // Bytes of the APK the store had to keep for this version: every header,
+  // the central directory and the data of entries no earlier version has.
+  //
+  uint64_t storedBytes;
+
+  size_t entries;
+
+  //
+  // Entries whose compressed data is shared with the previous version.
+  //
+  size_t sharedEntries;
+};
+
+//
+// Successive versions of an APK kept in a directory.  The first version is
+// kept in full; every later one keeps only the compressed data of entries
+// the previous version lacks, found by CRC-32 and sizes as diffApks() does,
+// along with all the bytes around entry data: local headers, the signing
+// block and the central directory.  Any version is rebuilt byte for byte
+// by streaming pieces of the files of the store, without inflating
+// anything.
+//
+// Each version is one file, <version>.apkv, holding the table of pieces
+// the version is made of, its entries and the bytes only it has.  Files are
+// written once and never changed, so versions can be read concurrently.
+//
+class ApkVersionStore final {
+public:
+  //
+  // Opens the store in the directory, creating it if needed.
+  //
+  explicit ApkVersionStore(std::string_view directory);
+
+  auto versionCount() const -> size_t { return versionCount_; }
+
+  //
+  // Adds the APK as the next version.
+  //
+  auto add(std::string_view apkPath) -> ApkVersion;
+
+  //
+  // Streams the bytes of the version, in order, through sink.  Pieces are
+  // only valid for the duration of the call.
+  //
+  auto rebuild(size_t version, std::function<void(std::span<std::byte const>)> const &sink) const -> void;
+
+  auto rebuild(size_t version, std::string_view destinationPath) const -> void;
+
+  //
+  // Entries added, removed or modified since the previous version, or all
+  // of them for the first one, from the tables of the store alone.  Only
+  // paths are filled in; diffApks() on rebuilt versions decodes contents.
+  //
+  auto diff(size_t version) const -> ApkDiff;
+
+private:
+  auto getVersionPath(size_t version) const -> std::string;
+
+  std::string directory_;
+
+  size_t versionCount_ = 0;
+};
+
+} // namespace ai::diff
+
+#endif /* ANDROID_INTROSPECTION_DIFF_APK_VERSION_STORE_H_ */
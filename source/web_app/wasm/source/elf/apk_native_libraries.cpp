@@ -0,0 +1,93 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <future>
+#include <optional>
+#include <stdexcept>
+
+#include "apk/apk_paths.h"
+#include "elf/apk_native_libraries.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+
+using namespace ai::elf;
+
+namespace {
+
+//
+// Runs find for every library on the pool, keeping the libraries found in
+// the order of the APK.
+//
+template <typename Find>
+auto findInLibraries(std::size_t const count, ai::utils::ThreadPool &threadPool, Find const &find) -> std::vector<NativeLibrarySymbol> {
+  auto futures = std::vector<std::future<std::optional<NativeLibrarySymbol>>>();
+  futures.reserve(count);
+  for (auto index = std::size_t{0}; index < count; index++) {
+    futures.push_back(threadPool.submit([&find, index] { return find(index); }));
+  }
+  for (auto &future : futures) {
+    future.wait();
+  }
+  auto libraries = std::vector<NativeLibrarySymbol>();
+  for (auto &future : futures) {
+    if (auto library = future.get()) {
+      libraries.push_back(std::move(*library));
+    }
+  }
+  return libraries;
+}
+
+} // namespace
+
+ApkNativeLibraries::ApkNativeLibraries(Apk const &apk) {
+  for (auto const &path : apk.getFiles()) {
+    auto const abi = ai::getLibraryAbi(path);
+    if (!abi) {
+      continue;
+    }
+    auto bytes = apk.getFileBytes(path);
+    try {
+      auto file = ElfFile(bytes.bytes());
+      libraries_.push_back(Library{path, std::string(*abi), std::move(bytes), std::move(file)});
+    } catch (std::logic_error const &exception) {
+      LOGW("ApkNativeLibraries, skipping [{}], {}", path, exception.what());
+    }
+  }
+  LOGD("ApkNativeLibraries, libraries [{}]", libraries_.size());
+}
+
+auto ApkNativeLibraries::findExporting(std::string_view const symbolName, utils::ThreadPool &threadPool) const -> std::vector<NativeLibrarySymbol> {
+  return findInLibraries(libraries_.size(), threadPool, [this, symbolName](std::size_t const index) -> std::optional<NativeLibrarySymbol> {
+    auto const &library = libraries_[index];
+    auto const symbol = library.file.findExport(symbolName);
+    return symbol ? std::optional(NativeLibrarySymbol{library.path, library.abi, *symbol}) : std::nullopt;
+  });
+}
+
+auto ApkNativeLibraries::findImporting(std::string_view const symbolName, utils::ThreadPool &threadPool) const -> std::vector<NativeLibrarySymbol> {
+  return findInLibraries(libraries_.size(), threadPool, [this, symbolName](std::size_t const index) -> std::optional<NativeLibrarySymbol> {
+    auto const &library = libraries_[index];
+    auto const symbol = library.file.findImport(symbolName);
+    return symbol ? std::optional(NativeLibrarySymbol{library.path, library.abi, *symbol}) : std::nullopt;
+  });
+}
@@ -0,0 +1,390 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <stdexcept>
+
+#include "elf/elf_file.h"
+#include "utils/little_endian.h"
+#include "utils/log.h"
+
+using namespace ai::elf;
+
+namespace {
+
+static constexpr std::size_t IDENT_SIZE = 16;
+
+static constexpr uint8_t ELFCLASS32 = 1;
+
+static constexpr uint8_t ELFCLASS64 = 2;
+
+static constexpr uint8_t ELFDATA2LSB = 1;
+
+static constexpr std::size_t ELF32_HEADER_SIZE = 52;
+
+static constexpr std::size_t ELF64_HEADER_SIZE = 64;
+
+static constexpr std::size_t ELF32_PROGRAM_HEADER_SIZE = 32;
+
+static constexpr std::size_t ELF64_PROGRAM_HEADER_SIZE = 56;
+
+static constexpr std::size_t ELF32_SECTION_HEADER_SIZE = 40;
+
+static constexpr std::size_t ELF64_SECTION_HEADER_SIZE = 64;
+
+static constexpr std::size_t ELF32_SYMBOL_SIZE = 16;
+
+static constexpr std::size_t ELF64_SYMBOL_SIZE = 24;
+
+static constexpr int64_t DT_NULL = 0;
+
+static constexpr int64_t DT_NEEDED = 1;
+
+//
+// Reads little endian fields of the structures at an offset of the file,
+// checking bounds.
+//
+class FieldReader final {
+public:
+  FieldReader(std::span<std::byte const> const bytes, uint64_t const offset, std::size_t const size) {
+    if (offset > bytes.size() || size > bytes.size() - offset) {
+      throw std::logic_error("elf structure out of bounds");
+    }
+    bytes_ = bytes.subspan(offset, size);
+  }
+
+  template <typename T> auto read(std::size_t const offset) const -> T { return ai::utils::little_endian::load<T>(bytes_, offset); }
+
+  //
+  // Reads a word, 4 bytes in 32 bit files and 8 in 64 bit ones.
+  //
+  auto readWord(std::size_t const offset, bool const is64Bit) const -> uint64_t { return is64Bit ? read<uint64_t>(offset) : read<uint32_t>(offset); }
+
+private:
+  std::span<std::byte const> bytes_;
+};
+
+auto getString(std::span<std::byte const> const strings, uint64_t const offset) -> std::string_view {
+  if (offset >= strings.size()) {
+    throw std::logic_error("elf string out of bounds");
+  }
+  auto const data = strings.subspan(offset);
+  auto const end = std::find(data.begin(), data.end(), std::byte{0});
+  return std::string_view(reinterpret_cast<char const *>(data.data()), static_cast<std::size_t>(end - data.begin()));
+}
+
+auto getGnuHash(std::string_view const name) -> uint32_t {
+  auto hash = uint32_t{5381};
+  for (auto const c : name) {
+    hash = hash * 33 + static_cast<uint8_t>(c);
+  }
+  return hash;
+}
+
+auto getSysvHash(std::string_view const name) -> uint32_t {
+  auto hash = uint32_t{0};
+  for (auto const c : name) {
+    hash = (hash << 4) + static_cast<uint8_t>(c);
+    auto const high = hash & 0xf0000000;
+    hash ^= high >> 24;
+    hash &= ~high;
+  }
+  return hash;
+}
+
+} // namespace
+
+ElfFile::ElfFile(std::span<std::byte const> const bytes) : bytes_(bytes) {
+  if (bytes.size() < IDENT_SIZE || memcmp(bytes.data(), "\x7f"
+                                                        "ELF",
+                                          4) != 0) {
+    throw std::logic_error("invalid elf magic");
+  }
+  auto const elfClass = static_cast<uint8_t>(bytes[4]);
+  if ((elfClass != ELFCLASS32 && elfClass != ELFCLASS64) || static_cast<uint8_t>(bytes[5]) != ELFDATA2LSB) {
+    throw std::logic_error("unsupported elf class or byte order");
+  }
+  header_.is64Bit = elfClass == ELFCLASS64;
+  auto const is64Bit = header_.is64Bit;
+  auto const fields = FieldReader(bytes, 0, is64Bit ? ELF64_HEADER_SIZE : ELF32_HEADER_SIZE);
+  header_.type = fields.read<uint16_t>(16);
+  header_.machine = fields.read<uint16_t>(18);
+  header_.entry = fields.readWord(24, is64Bit);
+  header_.programHeaderOffset = fields.readWord(is64Bit ? 32 : 28, is64Bit);
+  header_.sectionHeaderOffset = fields.readWord(is64Bit ? 40 : 32, is64Bit);
+  header_.programHeaderCount = fields.read<uint16_t>(is64Bit ? 56 : 44);
+  header_.sectionHeaderCount = fields.read<uint16_t>(is64Bit ? 60 : 48);
+  header_.sectionNameIndex = fields.read<uint16_t>(is64Bit ? 62 : 50);
+}
+
+auto ElfFile::programHeaders() const -> std::vector<ElfProgramHeader> const & {
+  if (!programHeaders_) {
+    auto const is64Bit = header_.is64Bit;
+    auto const entrySize = is64Bit ? ELF64_PROGRAM_HEADER_SIZE : ELF32_PROGRAM_HEADER_SIZE;
+    auto programHeaders = std::vector<ElfProgramHeader>();
+    for (auto i = std::size_t{0}; i < header_.programHeaderCount; i++) {
+      auto const fields = FieldReader(bytes_, header_.programHeaderOffset + i * entrySize, entrySize);
+      auto programHeader = ElfProgramHeader();
+      programHeader.type = fields.read<uint32_t>(0);
+      programHeader.flags = fields.read<uint32_t>(is64Bit ? 4 : 24);
+      programHeader.offset = fields.readWord(is64Bit ? 8 : 4, is64Bit);
+      programHeader.virtualAddress = fields.readWord(is64Bit ? 16 : 8, is64Bit);
+      programHeader.fileSize = fields.readWord(is64Bit ? 32 : 16, is64Bit);
+      programHeader.memorySize = fields.readWord(is64Bit ? 40 : 20, is64Bit);
+      programHeader.alignment = fields.readWord(is64Bit ? 48 : 28, is64Bit);
+      programHeaders.push_back(programHeader);
+    }
+    programHeaders_ = std::move(programHeaders);
+  }
+  return *programHeaders_;
+}
+
+auto ElfFile::sections() const -> std::vector<ElfSection> const & {
+  if (!sections_) {
+    auto const is64Bit = header_.is64Bit;
+    auto const entrySize = is64Bit ? ELF64_SECTION_HEADER_SIZE : ELF32_SECTION_HEADER_SIZE;
+    auto sections = std::vector<ElfSection>();
+    auto nameOffsets = std::vector<uint32_t>();
+    for (auto i = std::size_t{0}; i < header_.sectionHeaderCount; i++) {
+      auto const fields = FieldReader(bytes_, header_.sectionHeaderOffset + i * entrySize, entrySize);
+      auto section = ElfSection();
+      nameOffsets.push_back(fields.read<uint32_t>(0));
+      section.type = fields.read<uint32_t>(4);
+      section.flags = fields.readWord(8, is64Bit);
+      section.address = fields.readWord(is64Bit ? 16 : 12, is64Bit);
+      section.offset = fields.readWord(is64Bit ? 24 : 16, is64Bit);
+      section.size = fields.readWord(is64Bit ? 32 : 20, is64Bit);
+      section.link = fields.read<uint32_t>(is64Bit ? 40 : 24);
+      section.info = fields.read<uint32_t>(is64Bit ? 44 : 28);
+      section.entrySize = fields.readWord(is64Bit ? 56 : 36, is64Bit);
+      sections.push_back(section);
+    }
+    if (header_.sectionNameIndex < sections.size()) {
+      auto const names = sectionBytes(sections[header_.sectionNameIndex]);
+      for (auto i = std::size_t{0}; i < sections.size(); i++) {
+        sections[i].name = nameOffsets[i] < names.size() ? getString(names, nameOffsets[i]) : std::string_view();
+      }
+    }
+    sections_ = std::move(sections);
+  }
+  return *sections_;
+}
+
+auto ElfFile::findSection(std::string_view const name) const -> std::optional<ElfSection> {
+  auto const &allSections = sections();
+  auto const section = std::find_if(allSections.begin(), allSections.end(), [name](auto const &candidate) { return candidate.name == name; });
+  return section == allSections.end() ? std::nullopt : std::optional(*section);
+}
+
+auto ElfFile::sectionBytes(ElfSection const &section) const -> std::span<std::byte const> {
+  if (section.offset > bytes_.size() || section.size > bytes_.size() - section.offset) {
+    throw std::logic_error("elf section out of bounds");
+  }
+  return bytes_.subspan(section.offset, section.size);
+}
+
+auto ElfFile::neededLibraries() const -> std::vector<std::string_view> {
+  auto libraries = std::vector<std::string_view>();
+  auto const &allSections = sections();
+  auto const dynamic = std::find_if(allSections.begin(), allSections.end(), [](auto const &section) { return section.type == SHT_DYNAMIC; });
+  if (dynamic == allSections.end() || dynamic->link >= allSections.size()) {
+    return libraries;
+  }
+  auto const strings = sectionBytes(allSections[dynamic->link]);
+  auto const entries = sectionBytes(*dynamic);
+  auto const is64Bit = header_.is64Bit;
+  auto const entrySize = std::size_t{is64Bit ? 16U : 8U};
+  for (auto offset = std::size_t{0}; offset + entrySize <= entries.size(); offset += entrySize) {
+    auto const fields = FieldReader(entries, offset, entrySize);
+    auto const tag = is64Bit ? fields.read<int64_t>(0) : fields.read<int32_t>(0);
+    if (tag == DT_NULL) {
+      break;
+    }
+    if (tag == DT_NEEDED) {
+      libraries.push_back(getString(strings, fields.readWord(is64Bit ? 8 : 4, is64Bit)));
+    }
+  }
+  return libraries;
+}
+
+auto ElfFile::dynamicSymbols() const -> DynamicSymbols const & {
+  if (!dynamicSymbols_) {
+    auto symbols = DynamicSymbols();
+    auto const &allSections = sections();
+    for (auto const &section : allSections) {
+      if (section.type == SHT_DYNSYM && section.link < allSections.size()) {
+        symbols.symbols = sectionBytes(section);
+        symbols.strings = sectionBytes(allSections[section.link]);
+      } else if (section.type == SHT_GNU_HASH) {
+        symbols.gnuHash = section;
+      } else if (section.type == SHT_HASH) {
+        symbols.hash = section;
+      }
+    }
+    dynamicSymbols_ = symbols;
+  }
+  return *dynamicSymbols_;
+}
+
+auto ElfFile::symbolTable() const -> SymbolTable const & {
+  if (!symbolTable_) {
+    auto table = SymbolTable();
+    auto const &allSections = sections();
+    for (auto const &section : allSections) {
+      if (section.type == SHT_SYMTAB && section.link < allSections.size()) {
+        table.symbols = sectionBytes(section);
+        table.strings = sectionBytes(allSections[section.link]);
+        break;
+      }
+    }
+    symbolTable_ = table;
+  }
+  return *symbolTable_;
+}
+
+auto ElfFile::getSymbolCount(SymbolTable const &table) const -> std::size_t {
+  return table.symbols.size() / (header_.is64Bit ? ELF64_SYMBOL_SIZE : ELF32_SYMBOL_SIZE);
+}
+
+auto ElfFile::readSymbol(SymbolTable const &table, std::size_t const index) const -> ElfSymbol {
+  auto const is64Bit = header_.is64Bit;
+  auto const entrySize = is64Bit ? ELF64_SYMBOL_SIZE : ELF32_SYMBOL_SIZE;
+  if (index >= getSymbolCount(table)) {
+    throw std::out_of_range("elf symbol index out of range");
+  }
+  auto const fields = FieldReader(table.symbols, index * entrySize, entrySize);
+  auto symbol = ElfSymbol();
+  symbol.name = getString(table.strings, fields.read<uint32_t>(0));
+  auto const info = fields.read<uint8_t>(is64Bit ? 4 : 12);
+  symbol.binding = info >> 4;
+  symbol.type = info & 0xf;
+  symbol.sectionIndex = fields.read<uint16_t>(is64Bit ? 6 : 14);
+  symbol.value = fields.readWord(is64Bit ? 8 : 4, is64Bit);
+  symbol.size = fields.readWord(is64Bit ? 16 : 8, is64Bit);
+  return symbol;
+}
+
+auto ElfFile::dynamicSymbolCount() const -> std::size_t { return getSymbolCount(dynamicSymbols()); }
+
+auto ElfFile::dynamicSymbol(std::size_t const index) const -> ElfSymbol { return readSymbol(dynamicSymbols(), index); }
+
+auto ElfFile::symbolCount() const -> std::size_t { return getSymbolCount(symbolTable()); }
+
+auto ElfFile::symbol(std::size_t const index) const -> ElfSymbol { return readSymbol(symbolTable(), index); }
+
+auto ElfFile::findExport(std::string_view const name) const -> std::optional<ElfSymbol> {
+  auto const &symbols = dynamicSymbols();
+  if (symbols.gnuHash) {
+    return findGnuHashExport(name, *symbols.gnuHash);
+  }
+  if (symbols.hash) {
+    return findHashExport(name, *symbols.hash);
+  }
+  for (auto index = std::size_t{0}; index < dynamicSymbolCount(); index++) {
+    auto const symbol = dynamicSymbol(index);
+    if (symbol.isDefined() && symbol.binding != STB_LOCAL && symbol.name == name) {
+      return symbol;
+    }
+  }
+  return std::nullopt;
+}
+
+auto ElfFile::findImport(std::string_view const name) const -> std::optional<ElfSymbol> {
+  for (auto index = std::size_t{0}; index < dynamicSymbolCount(); index++) {
+    auto const symbol = dynamicSymbol(index);
+    if (!symbol.isDefined() && symbol.name == name) {
+      return symbol;
+    }
+  }
+  return std::nullopt;
+}
+
+//
+// Bloom filter first, then the chain of the bucket, whose hashes have their
+// lowest bit set on the last entry.
+//
+auto ElfFile::findGnuHashExport(std::string_view const name, ElfSection const &gnuHash) const -> std::optional<ElfSymbol> {
+  auto const table = sectionBytes(gnuHash);
+  auto const header = FieldReader(table, 0, 4 * sizeof(uint32_t));
+  auto const bucketCount = header.read<uint32_t>(0);
+  auto const symbolOffset = header.read<uint32_t>(4);
+  auto const bloomSize = header.read<uint32_t>(8);
+  auto const bloomShift = header.read<uint32_t>(12);
+  auto const is64Bit = header_.is64Bit;
+  auto const wordBits = is64Bit ? 64U : 32U;
+  if (bucketCount == 0 || bloomSize == 0) {
+    return std::nullopt;
+  }
+
+  auto const hash = getGnuHash(name);
+  auto const bloomOffset = std::size_t{4 * sizeof(uint32_t)};
+  auto const bloomWord = FieldReader(table, bloomOffset + ((hash / wordBits) % bloomSize) * (wordBits / 8), wordBits / 8).readWord(0, is64Bit);
+  auto const mask = (uint64_t{1} << (hash % wordBits)) | (uint64_t{1} << ((hash >> bloomShift) % wordBits));
+  if ((bloomWord & mask) != mask) {
+    return std::nullopt;
+  }
+
+  auto const bucketsOffset = bloomOffset + std::size_t{bloomSize} * (wordBits / 8);
+  auto const chainOffset = bucketsOffset + std::size_t{bucketCount} * sizeof(uint32_t);
+  auto index = FieldReader(table, bucketsOffset + (hash % bucketCount) * sizeof(uint32_t), sizeof(uint32_t)).read<uint32_t>(0);
+  if (index < symbolOffset) {
+    return std::nullopt;
+  }
+  for (;; index++) {
+    auto const chainHash = FieldReader(table, chainOffset + std::size_t{index - symbolOffset} * sizeof(uint32_t), sizeof(uint32_t)).read<uint32_t>(0);
+    if ((chainHash | 1) == (hash | 1)) {
+      auto const symbol = dynamicSymbol(index);
+      if (symbol.name == name && symbol.isDefined()) {
+        return symbol;
+      }
+    }
+    if ((chainHash & 1) != 0) {
+      return std::nullopt;
+    }
+  }
+}
+
+auto ElfFile::findHashExport(std::string_view const name, ElfSection const &hash) const -> std::optional<ElfSymbol> {
+  auto const table = sectionBytes(hash);
+  auto const header = FieldReader(table, 0, 2 * sizeof(uint32_t));
+  auto const bucketCount = header.read<uint32_t>(0);
+  auto const chainCount = header.read<uint32_t>(4);
+  if (bucketCount == 0) {
+    return std::nullopt;
+  }
+  auto const bucketsOffset = std::size_t{2 * sizeof(uint32_t)};
+  auto const chainOffset = bucketsOffset + std::size_t{bucketCount} * sizeof(uint32_t);
+  auto index = FieldReader(table, bucketsOffset + (getSysvHash(name) % bucketCount) * sizeof(uint32_t), sizeof(uint32_t)).read<uint32_t>(0);
+
+  //
+  // A chain never visits more entries than there are.
+  //
+  for (auto steps = uint32_t{0}; index != 0 && steps < chainCount; steps++) {
+    auto const symbol = dynamicSymbol(index);
+    if (symbol.name == name && symbol.isDefined()) {
+      return symbol;
+    }
+    index = FieldReader(table, chainOffset + std::size_t{index} * sizeof(uint32_t), sizeof(uint32_t)).read<uint32_t>(0);
+  }
+  return std::nullopt;
+}
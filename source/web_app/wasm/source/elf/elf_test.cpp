@@ -0,0 +1,161 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apk/apk.h"
+#include "elf/apk_native_libraries.h"
+#include "elf/elf_file.h"
+#include "elf/symbol_index.h"
+#include "utils/log.h"
+#include "utils/thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct TestEnvironment {
+  std::string testsDir;
+};
+
+std::unique_ptr<TestEnvironment> gTestEnvironment;
+
+auto setEnvironmentIfReady() -> bool {
+  auto const testsDir = std::getenv("AI_TESTS_DIR");
+  if (testsDir == nullptr) {
+    LOGE("tests directory is not defined");
+    return false;
+  }
+
+  gTestEnvironment = std::make_unique<TestEnvironment>();
+  gTestEnvironment->testsDir = testsDir;
+
+  return true;
+}
+
+fs::path getTestApkPath(char const *fileName) { return fs::path(gTestEnvironment->testsDir) / "resources" / "apks" / fileName; }
+
+auto readTestLibrary() -> std::vector<std::byte> {
+  auto file = std::ifstream(fs::path(gTestEnvironment->testsDir) / "resources" / "libs" / "libintrospection.so", std::ios::binary);
+  auto const contents = std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  auto const bytes = std::as_bytes(std::span(contents));
+  return std::vector<std::byte>(bytes.begin(), bytes.end());
+}
+
+} // namespace
+
+TEST(ElfFile, readTestLibrary_ExportsAndImportsAreFound) {
+  auto const contents = readTestLibrary();
+  auto const file = ai::elf::ElfFile(contents);
+  EXPECT_TRUE(file.header().is64Bit);
+  EXPECT_EQ(file.header().machine, ai::elf::EM_X86_64);
+  EXPECT_TRUE(file.findSection(".gnu.hash").has_value());
+  EXPECT_EQ(file.neededLibraries(), std::vector<std::string_view>{"libc.so.6"});
+
+  auto const onLoad = file.findExport("JNI_OnLoad");
+  ASSERT_TRUE(onLoad.has_value());
+  EXPECT_TRUE(onLoad->isDefined());
+  EXPECT_TRUE(file.findExport("introspection_length").has_value());
+  EXPECT_FALSE(file.findExport("strlen").has_value());
+  EXPECT_FALSE(file.findExport("JNI_OnUnload").has_value());
+  EXPECT_TRUE(file.findImport("strlen").has_value());
+  EXPECT_FALSE(file.findImport("JNI_OnLoad").has_value());
+}
+
+TEST(ElfFile, readTruncatedLibrary_InvalidElfIsRejected) {
+  auto const contents = readTestLibrary();
+  EXPECT_THROW(ai::elf::ElfFile(std::span(contents).first(8)), std::logic_error);
+  auto const file = ai::elf::ElfFile(std::span(contents).first(64));
+  EXPECT_THROW(file.sections(), std::logic_error);
+}
+
+TEST(SymbolIndex, indexTestLibrary_AddressesAreFoundInTheirFunctions) {
+  auto const contents = readTestLibrary();
+  auto const file = ai::elf::ElfFile(contents);
+  EXPECT_GT(file.symbolCount(), file.dynamicSymbolCount());
+
+  auto const index = ai::elf::SymbolIndex(file);
+  EXPECT_EQ(index.size(), 2);
+  auto const onLoad = file.findExport("JNI_OnLoad");
+  ASSERT_TRUE(onLoad.has_value());
+  for (auto const address : {onLoad->value, onLoad->value + onLoad->size - 1}) {
+    auto const range = index.find(address);
+    ASSERT_TRUE(range.has_value());
+    EXPECT_EQ(range->name, "JNI_OnLoad");
+    EXPECT_EQ(range->start, onLoad->value);
+  }
+  EXPECT_FALSE(index.find(onLoad->value - 1).has_value());
+  EXPECT_FALSE(index.find(onLoad->value + onLoad->size).has_value());
+  EXPECT_FALSE(index.find(0).has_value());
+
+  auto const text = file.findSection(".text");
+  ASSERT_TRUE(text.has_value());
+  EXPECT_EQ(index.getAddressOfOffset(text->offset), text->address);
+  EXPECT_FALSE(index.getAddressOfOffset(contents.size()).has_value());
+}
+
+TEST(ApkNativeLibraries, addLibrariesToApk_SymbolsAreFoundPerAbi) {
+  auto pathToOriginalApk = getTestApkPath("test_release.apk");
+  auto pathToCopiedApk = fs::temp_directory_path() / "addLibrariesToApk_SymbolsAreFoundPerAbi.apk";
+  auto isCopiedSuccessfully = fs::copy_file(pathToOriginalApk, pathToCopiedApk, fs::copy_options::overwrite_existing);
+  EXPECT_TRUE(isCopiedSuccessfully);
+
+  {
+    auto const apk = ai::Apk(pathToCopiedApk.string());
+    EXPECT_EQ(ai::elf::ApkNativeLibraries(apk).size(), 0);
+    auto const contents = readTestLibrary();
+    apk.setFileContent("lib/x86_64/libintrospection.so", contents);
+    apk.setFileContent("lib/arm64-v8a/libintrospection.so", contents);
+    apk.setFileContent("lib/x86_64/nested/libignored.so", contents);
+    apk.setFileContent("lib/x86_64/libpacked.so", std::vector<std::byte>(contents.begin(), contents.begin() + 8));
+
+    auto const libraries = ai::elf::ApkNativeLibraries(apk);
+    auto threadPool = ai::utils::ThreadPool(2);
+    ASSERT_EQ(libraries.size(), 2);
+    auto const exporting = libraries.findExporting("JNI_OnLoad", threadPool);
+    ASSERT_EQ(exporting.size(), 2);
+    EXPECT_TRUE(std::any_of(exporting.begin(), exporting.end(), [](auto const &library) { return library.abi == "x86_64"; }));
+    EXPECT_TRUE(std::any_of(exporting.begin(), exporting.end(), [](auto const &library) { return library.abi == "arm64-v8a"; }));
+    auto const importing = libraries.findImporting("strlen", threadPool);
+    ASSERT_EQ(importing.size(), 2);
+    EXPECT_FALSE(importing[0].symbol.isDefined());
+    EXPECT_TRUE(libraries.findExporting("strlen", threadPool).empty());
+  }
+  fs::remove(pathToCopiedApk);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  if (setEnvironmentIfReady()) {
+    return RUN_ALL_TESTS();
+  } else {
+    return -1;
+  }
+}
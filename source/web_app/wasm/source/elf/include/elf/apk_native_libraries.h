@@ -0,0 +1,106 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_ELF_APK_NATIVE_LIBRARIES_H_
+#define ANDROID_INTROSPECTION_ELF_APK_NATIVE_LIBRARIES_H_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "apk/apk.h"
+#include "elf/elf_file.h"
+
+namespace ai {
+
+namespace utils {
+class ThreadPool;
+} // namespace utils
+
+} // namespace ai
+
+namespace ai::elf {
+
+struct NativeLibrarySymbol {
+
+  //
+  // Path of the library in the APK, e.g. lib/arm64-v8a/libfoo.so.
+  //
+  std::string path;
+
+  std::string abi;
+
+  ElfSymbol symbol;
+};
+
+//
+// The lib/<abi>/*.so files of an APK.  Libraries are read from the APK on
+// construction, stored ones straight from the memory mapping, but only
+// their ELF headers are parsed; symbol tables are read by the first query
+// that needs them.  Files that are not ELF, as packers leave under lib/,
+// are skipped.  Queries use the pool for parallelism of their own and
+// must not run concurrently with each other.
+//
+class ApkNativeLibraries final {
+public:
+  explicit ApkNativeLibraries(Apk const &apk);
+
+  auto size() const -> std::size_t { return libraries_.size(); }
+
+  auto path(std::size_t const index) const -> std::string const & { return libraries_.at(index).path; }
+
+  auto abi(std::size_t const index) const -> std::string const & { return libraries_.at(index).abi; }
+
+  auto operator[](std::size_t const index) const -> ElfFile const & { return libraries_.at(index).file; }
+
+  //
+  // Libraries exporting the symbol.  Every library is looked up through its
+  // hash table on a worker of the pool.
+  //
+  auto findExporting(std::string_view symbolName, utils::ThreadPool &threadPool) const -> std::vector<NativeLibrarySymbol>;
+
+  //
+  // Libraries referencing the symbol without defining it; the symbol of the
+  // results is the undefined one.
+  //
+  auto findImporting(std::string_view symbolName, utils::ThreadPool &threadPool) const -> std::vector<NativeLibrarySymbol>;
+
+private:
+  struct Library {
+
+    std::string path;
+
+    std::string abi;
+
+    ApkFileBytes bytes;
+
+    ElfFile file;
+  };
+
+  std::vector<Library> libraries_;
+};
+
+} // namespace ai::elf
+
+#endif /* ANDROID_INTROSPECTION_ELF_APK_NATIVE_LIBRARIES_H_ */
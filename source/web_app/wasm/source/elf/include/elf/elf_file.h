@@ -0,0 +1,229 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_ELF_ELF_FILE_H_
+#define ANDROID_INTROSPECTION_ELF_ELF_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace ai::elf {
+
+static constexpr uint16_t EM_386 = 3;
+
+static constexpr uint16_t EM_ARM = 40;
+
+static constexpr uint16_t EM_X86_64 = 62;
+
+static constexpr uint16_t EM_AARCH64 = 183;
+
+static constexpr uint32_t PT_LOAD = 1;
+
+static constexpr uint32_t SHT_SYMTAB = 2;
+
+static constexpr uint32_t SHT_HASH = 5;
+
+static constexpr uint32_t SHT_DYNAMIC = 6;
+
+static constexpr uint32_t SHT_DYNSYM = 11;
+
+static constexpr uint32_t SHT_GNU_HASH = 0x6ffffff6;
+
+static constexpr uint16_t SHN_UNDEF = 0;
+
+static constexpr uint8_t STB_LOCAL = 0;
+
+static constexpr uint8_t STT_FUNC = 2;
+
+struct ElfHeader {
+
+  bool is64Bit;
+
+  uint16_t type;
+
+  uint16_t machine;
+
+  uint64_t entry;
+
+  uint64_t programHeaderOffset;
+
+  uint64_t sectionHeaderOffset;
+
+  uint16_t programHeaderCount;
+
+  uint16_t sectionHeaderCount;
+
+  uint16_t sectionNameIndex;
+};
+
+struct ElfProgramHeader {
+
+  uint32_t type;
+
+  uint32_t flags;
+
+  uint64_t offset;
+
+  uint64_t virtualAddress;
+
+  uint64_t fileSize;
+
+  uint64_t memorySize;
+
+  uint64_t alignment;
+};
+
+struct ElfSection {
+
+  std::string_view name;
+
+  uint32_t type;
+
+  uint64_t flags;
+
+  uint64_t address;
+
+  uint64_t offset;
+
+  uint64_t size;
+
+  uint32_t link;
+
+  uint32_t info;
+
+  uint64_t entrySize;
+};
+
+struct ElfSymbol {
+
+  std::string_view name;
+
+  uint64_t value;
+
+  uint64_t size;
+
+  uint8_t binding;
+
+  uint8_t type;
+
+  uint16_t sectionIndex;
+
+  auto isDefined() const -> bool { return sectionIndex != SHN_UNDEF; }
+};
+
+//
+// Lazy reader of a little endian ELF file, 32 or 64 bit, as shipped for
+// the Android ABIs.  The constructor only validates the ELF header; program
+// headers, sections and the dynamic symbol table are read on first use and
+// kept, so an instance must not be shared between threads.  The bytes must
+// outlive the reader.
+//
+class ElfFile final {
+public:
+  explicit ElfFile(std::span<std::byte const> bytes);
+
+  auto header() const -> ElfHeader const & { return header_; }
+
+  auto programHeaders() const -> std::vector<ElfProgramHeader> const &;
+
+  auto sections() const -> std::vector<ElfSection> const &;
+
+  auto findSection(std::string_view name) const -> std::optional<ElfSection>;
+
+  auto sectionBytes(ElfSection const &section) const -> std::span<std::byte const>;
+
+  //
+  // DT_NEEDED entries of the dynamic section.
+  //
+  auto neededLibraries() const -> std::vector<std::string_view>;
+
+  auto dynamicSymbolCount() const -> std::size_t;
+
+  auto dynamicSymbol(std::size_t index) const -> ElfSymbol;
+
+  //
+  // Entries of .symtab, local symbols included; none if the file is
+  // stripped.
+  //
+  auto symbolCount() const -> std::size_t;
+
+  auto symbol(std::size_t index) const -> ElfSymbol;
+
+  //
+  // Looks a defined dynamic symbol up through the GNU hash table, or the
+  // SysV one, falling back to a scan of .dynsym without either.
+  //
+  auto findExport(std::string_view name) const -> std::optional<ElfSymbol>;
+
+  //
+  // Undefined dynamic symbol of that name, if the file references one.
+  //
+  auto findImport(std::string_view name) const -> std::optional<ElfSymbol>;
+
+private:
+  struct SymbolTable {
+
+    std::span<std::byte const> symbols;
+
+    std::span<std::byte const> strings;
+  };
+
+  struct DynamicSymbols : SymbolTable {
+
+    std::optional<ElfSection> gnuHash;
+
+    std::optional<ElfSection> hash;
+  };
+
+  auto dynamicSymbols() const -> DynamicSymbols const &;
+
+  auto symbolTable() const -> SymbolTable const &;
+
+  auto getSymbolCount(SymbolTable const &table) const -> std::size_t;
+
+  auto readSymbol(SymbolTable const &table, std::size_t index) const -> ElfSymbol;
+
+  auto findGnuHashExport(std::string_view name, ElfSection const &gnuHash) const -> std::optional<ElfSymbol>;
+
+  auto findHashExport(std::string_view name, ElfSection const &hash) const -> std::optional<ElfSymbol>;
+
+  std::span<std::byte const> bytes_;
+
+  ElfHeader header_;
+
+  mutable std::optional<std::vector<ElfProgramHeader>> programHeaders_;
+
+  mutable std::optional<std::vector<ElfSection>> sections_;
+
+  mutable std::optional<DynamicSymbols> dynamicSymbols_;
+
+  mutable std::optional<SymbolTable> symbolTable_;
+};
+
+} // namespace ai::elf
+
+#endif /* ANDROID_INTROSPECTION_ELF_ELF_FILE_H_ */
@@ -0,0 +1,91 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_ELF_SYMBOL_INDEX_H_
+#define ANDROID_INTROSPECTION_ELF_SYMBOL_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "elf/elf_file.h"
+
+namespace ai::elf {
+
+struct SymbolRange {
+
+  std::string_view name;
+
+  //
+  // Virtual addresses of the file, as linked, end excluded.
+  //
+  uint64_t start;
+
+  uint64_t end;
+};
+
+//
+// Defined functions of .symtab and .dynsym sorted by address, to find the
+// function an address is in.  Built in one pass over the symbol tables;
+// functions without a size end where the next one starts.  Names point in
+// the bytes of the file, which must outlive the index.  Lookups don't
+// change the index, so it can be shared between threads.
+//
+class SymbolIndex final {
+public:
+  explicit SymbolIndex(ElfFile const &file);
+
+  auto size() const -> std::size_t { return starts_.size(); }
+
+  auto find(uint64_t address) const -> std::optional<SymbolRange>;
+
+  //
+  // Virtual address of a file offset, through the loaded segment holding
+  // it, as return addresses in a mapping of the file are converted.
+  //
+  auto getAddressOfOffset(uint64_t offset) const -> std::optional<uint64_t>;
+
+private:
+  struct Symbol {
+
+    std::string_view name;
+
+    uint64_t end;
+  };
+
+  //
+  // Kept apart from the rest of the symbols so that searches go through
+  // addresses only.
+  //
+  std::vector<uint64_t> starts_;
+
+  std::vector<Symbol> symbols_;
+
+  std::vector<ElfProgramHeader> loads_;
+};
+
+} // namespace ai::elf
+
+#endif /* ANDROID_INTROSPECTION_ELF_SYMBOL_INDEX_H_ */
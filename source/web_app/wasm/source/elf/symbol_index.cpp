@@ -0,0 +1,125 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+
+#include "elf/symbol_index.h"
+#include "utils/log.h"
+
+using namespace ai::elf;
+
+namespace {
+
+struct IndexedSymbol {
+
+  uint64_t start;
+
+  uint64_t size;
+
+  std::string_view name;
+
+  bool isGlobal;
+};
+
+auto addFunctions(std::size_t const count, auto const &readSymbol, uint16_t const machine, std::vector<IndexedSymbol> &functions) -> void {
+  for (auto index = std::size_t{0}; index < count; index++) {
+    auto const symbol = readSymbol(index);
+    if (!symbol.isDefined() || symbol.type != STT_FUNC || symbol.name.empty()) {
+      continue;
+    }
+
+    //
+    // The lowest bit of Thumb functions is set in their address.
+    //
+    auto const start = machine == EM_ARM ? symbol.value & ~uint64_t{1} : symbol.value;
+    functions.push_back(IndexedSymbol{start, symbol.size, symbol.name, symbol.binding != STB_LOCAL});
+  }
+}
+
+} // namespace
+
+SymbolIndex::SymbolIndex(ElfFile const &file) {
+  auto const machine = file.header().machine;
+  auto functions = std::vector<IndexedSymbol>();
+  addFunctions(
+      file.symbolCount(), [&file](std::size_t const index) { return file.symbol(index); }, machine, functions);
+  addFunctions(
+      file.dynamicSymbolCount(), [&file](std::size_t const index) { return file.dynamicSymbol(index); }, machine, functions);
+
+  //
+  // Symbols of .dynsym are in .symtab too when not stripped, and aliases
+  // share addresses: keep one per address, global and sized first.
+  //
+  std::sort(functions.begin(), functions.end(), [](auto const &left, auto const &right) {
+    if (left.start != right.start) {
+      return left.start < right.start;
+    }
+    if (left.isGlobal != right.isGlobal) {
+      return left.isGlobal;
+    }
+    return left.size > right.size;
+  });
+  functions.erase(std::unique(functions.begin(), functions.end(), [](auto const &left, auto const &right) { return left.start == right.start; }),
+                  functions.end());
+
+  starts_.reserve(functions.size());
+  symbols_.reserve(functions.size());
+  for (auto index = std::size_t{0}; index < functions.size(); index++) {
+    auto const &function = functions[index];
+    auto end = function.start + function.size;
+    if (function.size == 0) {
+      end = index + 1 < functions.size() ? functions[index + 1].start : function.start + 1;
+    }
+    starts_.push_back(function.start);
+    symbols_.push_back(Symbol{function.name, end});
+  }
+
+  for (auto const &programHeader : file.programHeaders()) {
+    if (programHeader.type == PT_LOAD) {
+      loads_.push_back(programHeader);
+    }
+  }
+  LOGD("SymbolIndex, functions [{}]", starts_.size());
+}
+
+auto SymbolIndex::find(uint64_t const address) const -> std::optional<SymbolRange> {
+  auto const next = std::upper_bound(starts_.begin(), starts_.end(), address);
+  if (next == starts_.begin()) {
+    return std::nullopt;
+  }
+  auto const index = static_cast<std::size_t>(next - starts_.begin()) - 1;
+  auto const &symbol = symbols_[index];
+  if (address >= symbol.end) {
+    return std::nullopt;
+  }
+  return SymbolRange{symbol.name, starts_[index], symbol.end};
+}
+
+auto SymbolIndex::getAddressOfOffset(uint64_t const offset) const -> std::optional<uint64_t> {
+  for (auto const &load : loads_) {
+    if (offset >= load.offset && offset - load.offset < load.fileSize) {
+      return offset - load.offset + load.virtualAddress;
+    }
+  }
+  return std::nullopt;
+}
@@ -8,6 +8,24 @@ else ()
     set(log-level 0)
 endif ()
 
+#
+# Bits of the LOG_MODULE_* modules of utils/log.h that log at all, e.g.
+# -DLOG_MODULE_MASK=0xFFFFFFFD compiles out binary xml logging.
+#
+if (NOT DEFINED LOG_MODULE_MASK)
+    set(LOG_MODULE_MASK 0xFFFFFFFF)
+endif ()
+
+#
+# Tracing spans of utils/trace.h are compiled in unless TRACING is 0.
+#
+if (NOT DEFINED TRACING)
+    set(TRACING 1)
+endif ()
+
 target_compile_definitions(utils PUBLIC LOG_LEVEL=${log-level})
+target_compile_definitions(utils PUBLIC LOG_MODULE_MASK=${LOG_MODULE_MASK})
+target_compile_definitions(utils PUBLIC TRACING=${TRACING})
 
 message("setting log level to " ${log-level})
+message("setting log module mask to " ${LOG_MODULE_MASK})
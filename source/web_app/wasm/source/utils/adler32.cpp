@@ -0,0 +1,199 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AI_ADLER32_SSSE3
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AI_ADLER32_NEON
+#endif
+
+#include "utils/adler32.h"
+
+namespace {
+
+static constexpr uint32_t MODULUS = 65521;
+
+//
+// Most bytes summed before the sums have to be reduced so that they don't
+// overflow 32 bits, as in zlib.
+//
+static constexpr size_t MAX_UNREDUCED_SIZE = 5552;
+
+//
+// Bytes of the replaced range summed in 64 bits before reducing; distances
+// are reduced first, so each adds less than 2^33 to the weighted sum.
+//
+static constexpr size_t MAX_UNREDUCED_REPLACEMENT_SIZE = 64 * 1024;
+
+auto updateScalar(uint32_t &sum1, uint32_t &sum2, uint8_t const *data, size_t size) -> void {
+  while (size > 0) {
+    auto const blockSize = std::min(size, MAX_UNREDUCED_SIZE);
+    size -= blockSize;
+    for (auto const *const end = data + blockSize; data != end; data++) {
+      sum1 += *data;
+      sum2 += sum1;
+    }
+    sum1 %= MODULUS;
+    sum2 %= MODULUS;
+  }
+}
+
+#if defined(AI_ADLER32_SSSE3)
+
+static constexpr size_t SSSE3_BLOCK_SIZE = 32;
+
+__attribute__((target("ssse3"))) inline auto sumLanes(__m128i const value) -> uint32_t {
+  auto const pairs = _mm_add_epi32(value, _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2)));
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_add_epi32(pairs, _mm_shuffle_epi32(pairs, _MM_SHUFFLE(2, 3, 0, 1)))));
+}
+
+//
+// Sums 32 byte blocks: PSADBW adds the bytes up and PMADDUBSW weighs them
+// by their distance to the end of the block, while the sums of the blocks
+// before are added up once per block and weighed by the block size at the
+// end.  Requires size to be a multiple of 32.
+//
+__attribute__((target("ssse3"))) auto updateSsse3(uint32_t &sum1, uint32_t &sum2, uint8_t const *data, size_t size) -> void {
+  auto const weights1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+  auto const weights2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  auto const zero = _mm_setzero_si128();
+  auto const ones = _mm_set1_epi16(1);
+  auto blocks = size / SSSE3_BLOCK_SIZE;
+  while (blocks > 0) {
+    auto count = std::min(blocks, MAX_UNREDUCED_SIZE / SSSE3_BLOCK_SIZE);
+    blocks -= count;
+    auto previousSums = _mm_cvtsi32_si128(static_cast<int>(sum1 * count));
+    auto sums1 = _mm_setzero_si128();
+    auto sums2 = _mm_cvtsi32_si128(static_cast<int>(sum2));
+    do {
+      auto const bytes1 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data));
+      auto const bytes2 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 16));
+      previousSums = _mm_add_epi32(previousSums, sums1);
+      sums1 = _mm_add_epi32(sums1, _mm_add_epi32(_mm_sad_epu8(bytes1, zero), _mm_sad_epu8(bytes2, zero)));
+      sums2 = _mm_add_epi32(sums2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, weights1), ones));
+      sums2 = _mm_add_epi32(sums2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, weights2), ones));
+      data += SSSE3_BLOCK_SIZE;
+    } while (--count > 0);
+    sums2 = _mm_add_epi32(sums2, _mm_slli_epi32(previousSums, 5));
+    sum1 = (sum1 + sumLanes(sums1)) % MODULUS;
+    sum2 = sumLanes(sums2) % MODULUS;
+  }
+}
+
+auto hasSsse3() -> bool {
+  static auto const supported = __builtin_cpu_supports("ssse3");
+  return supported;
+}
+
+#elif defined(AI_ADLER32_NEON)
+
+static constexpr size_t NEON_BLOCK_SIZE = 16;
+
+//
+// Same as the SSSE3 version, 16 bytes at a time: pairwise additions sum
+// the bytes and widening multiplications weigh them.  Requires size to be
+// a multiple of 16.
+//
+auto updateNeon(uint32_t &sum1, uint32_t &sum2, uint8_t const *data, size_t size) -> void {
+  static constexpr uint8_t WEIGHTS[] = {16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+  auto const weightsLow = vld1_u8(WEIGHTS);
+  auto const weightsHigh = vld1_u8(WEIGHTS + 8);
+  auto blocks = size / NEON_BLOCK_SIZE;
+  while (blocks > 0) {
+    auto count = std::min(blocks, MAX_UNREDUCED_SIZE / NEON_BLOCK_SIZE);
+    blocks -= count;
+    auto previousSums = vsetq_lane_u32(sum1 * static_cast<uint32_t>(count), vdupq_n_u32(0), 0);
+    auto sums1 = vdupq_n_u32(0);
+    auto sums2 = vsetq_lane_u32(sum2, vdupq_n_u32(0), 0);
+    do {
+      auto const bytes = vld1q_u8(data);
+      previousSums = vaddq_u32(previousSums, sums1);
+      sums1 = vpadalq_u16(sums1, vpaddlq_u8(bytes));
+      auto const weighted = vmlal_u8(vmull_u8(vget_low_u8(bytes), weightsLow), vget_high_u8(bytes), weightsHigh);
+      sums2 = vpadalq_u16(sums2, weighted);
+      data += NEON_BLOCK_SIZE;
+    } while (--count > 0);
+    sums2 = vaddq_u32(sums2, vshlq_n_u32(previousSums, 4));
+    sum1 = (sum1 + vaddvq_u32(sums1)) % MODULUS;
+    sum2 = vaddvq_u32(sums2) % MODULUS;
+  }
+}
+
+#endif
+
+} // namespace
+
+namespace ai::utils::adler32 {
+
+auto update(uint32_t const adler, std::span<std::byte const> const bytes) -> uint32_t {
+  auto data = reinterpret_cast<uint8_t const *>(bytes.data());
+  auto size = bytes.size();
+  auto sum1 = adler & 0xffff;
+  auto sum2 = adler >> 16;
+#if defined(AI_ADLER32_SSSE3)
+  if (hasSsse3()) {
+    auto const blocksSize = size & ~(SSSE3_BLOCK_SIZE - 1);
+    updateSsse3(sum1, sum2, data, blocksSize);
+    data += blocksSize;
+    size -= blocksSize;
+  }
+#elif defined(AI_ADLER32_NEON)
+  auto const blocksSize = size & ~(NEON_BLOCK_SIZE - 1);
+  updateNeon(sum1, sum2, data, blocksSize);
+  data += blocksSize;
+  size -= blocksSize;
+#endif
+  updateScalar(sum1, sum2, data, size);
+  return sum2 << 16 | sum1;
+}
+
+auto replace(uint32_t const adler, std::size_t const size, std::size_t const offset, std::span<std::byte const> const originalBytes,
+             std::span<std::byte const> const replacementBytes) -> uint32_t {
+  if (originalBytes.size() != replacementBytes.size() || offset > size || originalBytes.size() > size - offset) {
+    throw std::logic_error("replaced bytes out of range");
+  }
+
+  //
+  // Works on sums kept in [0, MODULUS) so that differences stay positive.
+  //
+  auto sum1 = uint64_t{adler & 0xffff};
+  auto sum2 = uint64_t{adler >> 16};
+  for (auto index = size_t{0}; index < originalBytes.size(); index++) {
+    auto const difference = MODULUS + static_cast<uint32_t>(replacementBytes[index]) - static_cast<uint32_t>(originalBytes[index]);
+    auto const distance = (size - offset - index) % MODULUS;
+    sum1 += difference;
+    sum2 += difference * distance;
+    if (index % MAX_UNREDUCED_REPLACEMENT_SIZE == MAX_UNREDUCED_REPLACEMENT_SIZE - 1) {
+      sum1 %= MODULUS;
+      sum2 %= MODULUS;
+    }
+  }
+  return static_cast<uint32_t>(sum2 % MODULUS) << 16 | static_cast<uint32_t>(sum1 % MODULUS);
+}
+
+} // namespace ai::utils::adler32
@@ -0,0 +1,102 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <bit>
+#include <optional>
+
+#include "utils/arena.h"
+
+using namespace ai::utils;
+
+namespace {
+
+static constexpr std::size_t SIZE_CLASS_GRANULARITY = 16;
+
+static constexpr std::size_t SMALL_SIZE_CLASS_COUNT = 16;
+
+static constexpr std::size_t SMALL_SIZE_LIMIT = SIZE_CLASS_GRANULARITY * SMALL_SIZE_CLASS_COUNT;
+
+static constexpr std::size_t LARGE_SIZE_LIMIT = 64 * 1024;
+
+//
+// Blocks on the free lists are at least 16 byte aligned, which covers every
+// type but over-aligned ones.
+//
+static constexpr std::size_t MAX_POOLED_ALIGNMENT = SIZE_CLASS_GRANULARITY;
+
+auto getSizeClass(std::size_t const bytes, std::size_t const alignment) -> std::optional<std::size_t> {
+  if (bytes == 0 || bytes > LARGE_SIZE_LIMIT || alignment > MAX_POOLED_ALIGNMENT) {
+    return std::nullopt;
+  }
+  if (bytes <= SMALL_SIZE_LIMIT) {
+    return (bytes - 1) / SIZE_CLASS_GRANULARITY;
+  }
+  return SMALL_SIZE_CLASS_COUNT + static_cast<std::size_t>(std::bit_width(bytes - 1)) - std::bit_width(SMALL_SIZE_LIMIT);
+}
+
+auto getBlockSize(std::size_t const sizeClass) -> std::size_t {
+  if (sizeClass < SMALL_SIZE_CLASS_COUNT) {
+    return (sizeClass + 1) * SIZE_CLASS_GRANULARITY;
+  }
+  return SMALL_SIZE_LIMIT << (sizeClass - SMALL_SIZE_CLASS_COUNT + 1);
+}
+
+} // namespace
+
+Arena::Arena(std::size_t const initialSize, std::pmr::memory_resource *const upstream) : buffer_(initialSize, upstream) {}
+
+Arena::~Arena() = default;
+
+auto Arena::release() -> void {
+  buffer_.release();
+  freeBlocks_.fill(nullptr);
+  bytesInUse_ = 0;
+}
+
+auto Arena::do_allocate(std::size_t const bytes, std::size_t const alignment) -> void * {
+  auto const sizeClass = getSizeClass(bytes, alignment);
+  if (!sizeClass) {
+    bytesInUse_ += bytes;
+    return buffer_.allocate(bytes, alignment);
+  }
+  bytesInUse_ += getBlockSize(*sizeClass);
+  if (auto *const block = freeBlocks_[*sizeClass]; block != nullptr) {
+    freeBlocks_[*sizeClass] = block->next;
+    return block;
+  }
+  return buffer_.allocate(getBlockSize(*sizeClass), MAX_POOLED_ALIGNMENT);
+}
+
+auto Arena::do_deallocate(void *const pointer, std::size_t const bytes, std::size_t const alignment) -> void {
+  auto const sizeClass = getSizeClass(bytes, alignment);
+  if (!sizeClass) {
+    bytesInUse_ -= bytes;
+    return;
+  }
+  bytesInUse_ -= getBlockSize(*sizeClass);
+  auto *const block = static_cast<FreeBlock *>(pointer);
+  block->next = freeBlocks_[*sizeClass];
+  freeBlocks_[*sizeClass] = block;
+}
+
+auto Arena::do_is_equal(std::pmr::memory_resource const &other) const noexcept -> bool { return this == &other; }
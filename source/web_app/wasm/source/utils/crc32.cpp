@@ -0,0 +1,189 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AI_CRC32_PCLMUL
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define AI_CRC32_ARM
+#endif
+
+#include "utils/crc32.h"
+
+namespace {
+
+static constexpr uint32_t POLYNOMIAL = 0xedb88320;
+
+constexpr auto makeTables() {
+  auto tables = std::array<std::array<uint32_t, 256>, 8>();
+  for (uint32_t i = 0; i < 256; i++) {
+    auto crc = i;
+    for (auto bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL : 0);
+    }
+    tables[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    for (size_t table = 1; table < tables.size(); table++) {
+      tables[table][i] = (tables[table - 1][i] >> 8) ^ tables[0][tables[table - 1][i] & 0xff];
+    }
+  }
+  return tables;
+}
+
+static constexpr auto TABLES = makeTables();
+
+//
+// Works on the inverted crc, like the accelerated versions below.
+//
+auto updateSlicingBy8(uint32_t crc, uint8_t const *data, size_t size) -> uint32_t {
+  while (size >= 8) {
+    auto const low = crc ^ (static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 |
+                            static_cast<uint32_t>(data[3]) << 24);
+    crc = TABLES[7][low & 0xff] ^ TABLES[6][(low >> 8) & 0xff] ^ TABLES[5][(low >> 16) & 0xff] ^ TABLES[4][low >> 24] ^ TABLES[3][data[4]] ^
+          TABLES[2][data[5]] ^ TABLES[1][data[6]] ^ TABLES[0][data[7]];
+    data += 8;
+    size -= 8;
+  }
+  while (size-- > 0) {
+    crc = (crc >> 8) ^ TABLES[0][(crc ^ *data++) & 0xff];
+  }
+  return crc;
+}
+
+#if defined(AI_CRC32_PCLMUL)
+
+static constexpr size_t PCLMUL_MINIMUM_SIZE = 64;
+
+__attribute__((target("pclmul,sse4.1"))) inline auto load(uint8_t const *const data) -> __m128i {
+  return _mm_loadu_si128(reinterpret_cast<__m128i const *>(data));
+}
+
+__attribute__((target("pclmul,sse4.1"))) inline auto fold(__m128i const value, __m128i const next, __m128i const constants) -> __m128i {
+  auto const low = _mm_clmulepi64_si128(value, constants, 0x00);
+  return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(value, constants, 0x11), next), low);
+}
+
+//
+// Folds 64 byte blocks with carry-less multiplication and finishes with a
+// Barrett reduction ("Fast CRC Computation for Generic Polynomials Using
+// PCLMULQDQ Instruction", Intel).  Requires size >= 64 and a multiple of 16.
+//
+__attribute__((target("pclmul,sse4.1"))) auto updatePclmul(uint32_t crc, uint8_t const *data, size_t size) -> uint32_t {
+  alignas(16) static constexpr uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+  alignas(16) static constexpr uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+  alignas(16) static constexpr uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+  alignas(16) static constexpr uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+  auto x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+  auto x2 = load(data + 0x10);
+  auto x3 = load(data + 0x20);
+  auto x4 = load(data + 0x30);
+  auto x0 = _mm_load_si128(reinterpret_cast<__m128i const *>(k1k2));
+  data += 64;
+  size -= 64;
+
+  while (size >= 64) {
+    x1 = fold(x1, load(data), x0);
+    x2 = fold(x2, load(data + 0x10), x0);
+    x3 = fold(x3, load(data + 0x20), x0);
+    x4 = fold(x4, load(data + 0x30), x0);
+    data += 64;
+    size -= 64;
+  }
+
+  x0 = _mm_load_si128(reinterpret_cast<__m128i const *>(k3k4));
+  x1 = fold(x1, x2, x0);
+  x1 = fold(x1, x3, x0);
+  x1 = fold(x1, x4, x0);
+  while (size >= 16) {
+    x1 = fold(x1, load(data), x0);
+    data += 16;
+    size -= 16;
+  }
+
+  auto const mask = _mm_setr_epi32(~0, 0, ~0, 0);
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x0 = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(k5k0));
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), x0, 0x00), x2);
+
+  x0 = _mm_load_si128(reinterpret_cast<__m128i const *>(poly));
+  x2 = _mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), x0, 0x10), mask);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+auto hasPclmul() -> bool {
+  static auto const supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+  return supported;
+}
+
+#elif defined(AI_CRC32_ARM)
+
+auto updateArm(uint32_t crc, uint8_t const *data, size_t size) -> uint32_t {
+  while (size >= 8) {
+    auto value = uint64_t();
+    __builtin_memcpy(&value, data, sizeof(value));
+    crc = __crc32d(crc, value);
+    data += 8;
+    size -= 8;
+  }
+  while (size-- > 0) {
+    crc = __crc32b(crc, *data++);
+  }
+  return crc;
+}
+
+#endif
+
+} // namespace
+
+namespace ai::utils::crc32 {
+
+auto update(uint32_t crc, std::span<std::byte const> const bytes) -> uint32_t {
+  auto data = reinterpret_cast<uint8_t const *>(bytes.data());
+  auto size = bytes.size();
+  crc = ~crc;
+#if defined(AI_CRC32_PCLMUL)
+  if (size >= PCLMUL_MINIMUM_SIZE && hasPclmul()) {
+    auto const foldedSize = size & ~size_t{15};
+    crc = updatePclmul(crc, data, foldedSize);
+    data += foldedSize;
+    size -= foldedSize;
+  }
+  crc = updateSlicingBy8(crc, data, size);
+#elif defined(AI_CRC32_ARM)
+  crc = updateArm(crc, data, size);
+#else
+  crc = updateSlicingBy8(crc, data, size);
+#endif
+  return ~crc;
+}
+
+} // namespace ai::utils::crc32
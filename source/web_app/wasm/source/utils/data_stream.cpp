@@ -24,8 +24,14 @@
 #include "utils/data_stream.h"
 #include <stdexcept>
 
+auto DataStream::require(std::size_t const bytes) const -> void {
+  if (bytes > data_.size() - index_) {
+    throw std::logic_error("read past data boundry");
+  }
+}
+
 auto DataStream::skip(uint32_t const bytes) -> void {
-  if (index_ + bytes > data_.size()) {
+  if (bytes > data_.size() - index_) {
     throw std::logic_error("skipped past data boundry");
   }
   index_ += bytes;
@@ -0,0 +1,459 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <utility>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define AI_FILE_OUTPUT_IO_URING
+#endif
+#endif
+
+#include "utils/file_output.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+
+using namespace ai::utils;
+
+namespace {
+
+static constexpr std::size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+//
+// Files up to this size are queued for a batch, larger ones are written
+// right away without a copy.
+//
+static constexpr std::size_t BATCHED_FILE_SIZE_LIMIT = 256 * 1024;
+
+//
+// Bounds of a batch; every queued file holds an open descriptor.
+//
+static constexpr std::size_t MAX_BATCH_FILES = 64;
+
+static constexpr std::size_t MAX_BATCH_BYTES = 8 * 1024 * 1024;
+
+static constexpr mode_t FILE_MODE = 0644;
+
+auto recordWrite(uint64_t const size) {
+  static auto &filesWritten = metrics::counter("output.files_written");
+  static auto &bytesWritten = metrics::counter("output.bytes_written");
+  filesWritten.add();
+  bytesWritten.add(size);
+}
+
+auto openOutputFile(std::string const &path) -> int {
+  auto const fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, FILE_MODE);
+  if (fd < 0) {
+    LOGW("openOutputFile, unable to open [{}] errno [{}]", path, errno);
+    throw std::logic_error("unable to open output file");
+  }
+  return fd;
+}
+
+//
+// Only a hint: file systems without support simply allocate as data comes.
+//
+auto reserveSpace(int const fd, uint64_t const size) {
+#if defined(__linux__)
+  if (size > 0) {
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+  }
+#else
+  ignore(fd);
+  ignore(size);
+#endif
+}
+
+auto writeAll(int const fd, std::span<std::byte const> bytes) -> bool {
+  while (!bytes.empty()) {
+    auto const written = ::write(fd, bytes.data(), bytes.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes = bytes.subspan(static_cast<std::size_t>(written));
+  }
+  return true;
+}
+
+auto writeWholeFile(std::string const &path, std::span<std::byte const> const contents) {
+  auto writer = FileWriter(path, contents.size());
+  writer.write(contents);
+  writer.close();
+}
+
+#if defined(AI_FILE_OUTPUT_IO_URING)
+
+//
+// Minimal io_uring on the raw system calls: one submission queue filled by
+// a single thread, which then waits for every completion.
+//
+class IoUring final {
+public:
+  static auto create(unsigned const entries) -> std::unique_ptr<IoUring> {
+    auto params = io_uring_params();
+    auto const fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+      LOGD("IoUring, unavailable errno [{}]", errno);
+      return nullptr;
+    }
+    auto ring = std::unique_ptr<IoUring>(new IoUring(fd));
+    if (!ring->map(params) || !ring->supportsOperations()) {
+      return nullptr;
+    }
+    return ring;
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(IoUring);
+
+  ~IoUring() {
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+      munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != MAP_FAILED) {
+      munmap(sqRing_, sqRingSize_);
+    }
+    close(fd_);
+  }
+
+  auto capacity() const -> unsigned { return entries_; }
+
+  //
+  // Queues an operation on the file at offset 0; at most capacity() can be
+  // queued before submitAndWait().
+  //
+  auto prepare(uint8_t const opcode, int const fd, void const *const address, uint32_t const length, uint64_t const userData, uint8_t const flags) {
+    auto const tail = *sqTail_;
+    auto const index = tail & *sqMask_;
+    auto &sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.flags = flags;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(address);
+    sqe.len = length;
+    sqe.user_data = userData;
+    sqArray_[index] = index;
+    std::atomic_ref(*sqTail_).store(tail + 1, std::memory_order_release);
+    queued_++;
+  }
+
+  //
+  // Submits what is queued and hands every completion to onCompletion as
+  // (userData, result).  Returns false if the ring failed, in which case
+  // the completions not handed out are lost.
+  //
+  template <typename OnCompletion> auto submitAndWait(OnCompletion const &onCompletion) -> bool {
+    auto const expected = std::exchange(queued_, 0);
+    for (auto completed = 0U; completed < expected;) {
+      auto const toSubmit = *sqTail_ - std::atomic_ref(*sqHead_).load(std::memory_order_acquire);
+      if (syscall(__NR_io_uring_enter, fd_, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+        LOGW("IoUring, submission failed errno [{}]", errno);
+        return false;
+      }
+      auto head = *cqHead_;
+      auto const tail = std::atomic_ref(*cqTail_).load(std::memory_order_acquire);
+      for (; head != tail; head++, completed++) {
+        auto const &cqe = cqes_[head & *cqMask_];
+        onCompletion(cqe.user_data, cqe.res);
+      }
+      std::atomic_ref(*cqHead_).store(head, std::memory_order_release);
+    }
+    return true;
+  }
+
+private:
+  explicit IoUring(int const fd) : fd_(fd) {}
+
+  auto map(io_uring_params const &params) -> bool {
+    entries_ = params.sq_entries;
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    auto const singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMapping) {
+      sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+      return false;
+    }
+    cqRing_ = singleMapping ? sqRing_ : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cqRing_ == MAP_FAILED) {
+      return false;
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    auto const sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return false;
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    auto *const sq = static_cast<std::byte *>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    auto *const cq = static_cast<std::byte *>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  //
+  // Writes and closes through the ring came with Linux 5.6.
+  //
+  auto supportsOperations() const -> bool {
+    static constexpr unsigned PROBED_OPERATIONS = 256;
+    auto probe = std::vector<std::byte>(sizeof(io_uring_probe) + PROBED_OPERATIONS * sizeof(io_uring_probe_op));
+    if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe.data(), PROBED_OPERATIONS) < 0) {
+      return false;
+    }
+    auto const *const operations = reinterpret_cast<io_uring_probe_op const *>(probe.data() + sizeof(io_uring_probe));
+    auto const lastOperation = reinterpret_cast<io_uring_probe const *>(probe.data())->last_op;
+    auto const isSupported = [&](uint8_t const operation) { return operation <= lastOperation && (operations[operation].flags & IO_URING_OP_SUPPORTED) != 0; };
+    return isSupported(IORING_OP_WRITE) && isSupported(IORING_OP_CLOSE);
+  }
+
+  int const fd_;
+
+  unsigned entries_ = 0;
+
+  unsigned queued_ = 0;
+
+  void *sqRing_ = MAP_FAILED;
+
+  void *cqRing_ = MAP_FAILED;
+
+  io_uring_sqe *sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+
+  std::size_t sqRingSize_ = 0;
+
+  std::size_t cqRingSize_ = 0;
+
+  std::size_t sqesSize_ = 0;
+
+  unsigned *sqHead_ = nullptr;
+
+  unsigned *sqTail_ = nullptr;
+
+  unsigned *sqMask_ = nullptr;
+
+  unsigned *sqArray_ = nullptr;
+
+  unsigned *cqHead_ = nullptr;
+
+  unsigned *cqTail_ = nullptr;
+
+  unsigned *cqMask_ = nullptr;
+
+  io_uring_cqe *cqes_ = nullptr;
+};
+
+#endif
+
+} // namespace
+
+FileWriter::FileWriter(std::string const &path, std::optional<uint64_t> const size) : path_(path), fd_(openOutputFile(path)) {
+  if (size) {
+    reserveSpace(fd_, *size);
+  }
+}
+
+FileWriter::~FileWriter() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+auto FileWriter::write(std::span<std::byte const> const bytes) -> void {
+  written_ += bytes.size();
+  if (buffer_.size() + bytes.size() > WRITE_BUFFER_SIZE) {
+    flushBuffer();
+  }
+  if (bytes.size() >= WRITE_BUFFER_SIZE) {
+    if (!writeAll(fd_, bytes)) {
+      LOGW("FileWriter, unable to write [{}] errno [{}]", path_, errno);
+      throw std::logic_error("unable to write output file");
+    }
+    return;
+  }
+  if (buffer_.capacity() == 0) {
+    buffer_.reserve(WRITE_BUFFER_SIZE);
+  }
+  buffer_.insert(buffer_.end(), bytes.begin(), bytes.end());
+}
+
+auto FileWriter::flushBuffer() -> void {
+  if (!buffer_.empty() && !writeAll(fd_, buffer_)) {
+    LOGW("FileWriter, unable to write [{}] errno [{}]", path_, errno);
+    throw std::logic_error("unable to write output file");
+  }
+  buffer_.clear();
+}
+
+auto FileWriter::close() -> void {
+  flushBuffer();
+  if (::close(std::exchange(fd_, -1)) != 0) {
+    LOGW("FileWriter, unable to close [{}] errno [{}]", path_, errno);
+    throw std::logic_error("unable to write output file");
+  }
+  recordWrite(written_);
+}
+
+class FileOutput::Batch final {
+public:
+  explicit Batch(FileOutputBackend const preferredBackend) {
+#if defined(AI_FILE_OUTPUT_IO_URING)
+    if (preferredBackend == FileOutputBackend::IoUring) {
+      ring_ = IoUring::create(static_cast<unsigned>(MAX_BATCH_FILES * 2));
+    }
+#else
+    ignore(preferredBackend);
+#endif
+  }
+
+  auto backend() const -> FileOutputBackend {
+#if defined(AI_FILE_OUTPUT_IO_URING)
+    if (ring_) {
+      return FileOutputBackend::IoUring;
+    }
+#endif
+    return FileOutputBackend::Posix;
+  }
+
+  auto write(std::string const &path, std::span<std::byte const> const contents) -> void {
+    if (backend() == FileOutputBackend::Posix || contents.size() > BATCHED_FILE_SIZE_LIMIT) {
+      writeWholeFile(path, contents);
+      return;
+    }
+    if (files_.size() == MAX_BATCH_FILES || staging_.size() + contents.size() > MAX_BATCH_BYTES) {
+      submit();
+    }
+    files_.push_back(QueuedFile{path, openOutputFile(path), staging_.size(), contents.size()});
+    staging_.insert(staging_.end(), contents.begin(), contents.end());
+  }
+
+  auto flush() -> void {
+    submit();
+    if (!failedPaths_.empty()) {
+      auto const failedPaths = std::exchange(failedPaths_, {});
+      LOGW("FileOutput, unable to write [{}] files, first [{}]", failedPaths.size(), failedPaths.front());
+      throw std::logic_error("unable to write output file");
+    }
+  }
+
+private:
+  struct QueuedFile {
+
+    std::string path;
+
+    int fd;
+
+    std::size_t offset;
+
+    std::size_t size;
+  };
+
+  //
+  // Every file is a write linked to a close, so that the close only runs
+  // once the write is done; a failed write cancels its close.
+  //
+  auto submit() -> void {
+    if (files_.empty()) {
+      return;
+    }
+#if defined(AI_FILE_OUTPUT_IO_URING)
+    for (auto i = std::size_t{0}; i < files_.size(); i++) {
+      auto const &file = files_[i];
+      ring_->prepare(IORING_OP_WRITE, file.fd, staging_.data() + file.offset, static_cast<uint32_t>(file.size), i << 1, IOSQE_IO_LINK);
+      ring_->prepare(IORING_OP_CLOSE, file.fd, nullptr, 0, (i << 1) | 1, 0);
+    }
+    auto failed = std::vector<bool>(files_.size());
+    auto const completed = ring_->submitAndWait([this, &failed](uint64_t const userData, int32_t const result) {
+      auto const &file = files_[userData >> 1];
+      auto const isClose = (userData & 1) != 0;
+      if (isClose && result == -ECANCELED) {
+        ::close(file.fd);
+      } else if (result < 0 || (!isClose && static_cast<std::size_t>(result) != file.size)) {
+        failed[userData >> 1] = true;
+      }
+    });
+    if (!completed) {
+      std::fill(failed.begin(), failed.end(), true);
+      ring_.reset();
+    }
+    for (auto i = std::size_t{0}; i < files_.size(); i++) {
+      if (failed[i]) {
+        failedPaths_.push_back(files_[i].path);
+      } else {
+        recordWrite(files_[i].size);
+      }
+    }
+#endif
+    files_.clear();
+    staging_.clear();
+  }
+
+  std::vector<QueuedFile> files_;
+
+  std::vector<std::byte> staging_;
+
+  std::vector<std::string> failedPaths_;
+
+#if defined(AI_FILE_OUTPUT_IO_URING)
+  std::unique_ptr<IoUring> ring_;
+#endif
+};
+
+FileOutput::FileOutput(FileOutputBackend const preferredBackend) : batch_(std::make_unique<Batch>(preferredBackend)) {}
+
+FileOutput::~FileOutput() {
+  try {
+    batch_->flush();
+  } catch (std::logic_error const &e) {
+    LOGW("FileOutput, {}", e.what());
+  }
+}
+
+auto FileOutput::backend() const -> FileOutputBackend { return batch_->backend(); }
+
+auto FileOutput::write(std::string const &path, std::span<std::byte const> const contents) -> void { batch_->write(path, contents); }
+
+auto FileOutput::flush() -> void { batch_->flush(); }
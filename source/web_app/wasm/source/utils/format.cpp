@@ -0,0 +1,218 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AI_FORMAT_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AI_FORMAT_NEON
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define AI_FORMAT_SIMD128
+#endif
+
+#include "utils/format.h"
+
+namespace {
+
+static constexpr char UPPERCASE_HEX_DIGITS[] = "0123456789ABCDEF";
+
+static constexpr char LOWERCASE_HEX_DIGITS[] = "0123456789abcdef";
+
+static constexpr char BASE64_DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+//
+// Distance from '0' + 10 to 'A' or 'a', added to nibbles above 9.
+//
+static constexpr uint8_t UPPERCASE_LETTER_OFFSET = 'A' - '0' - 10;
+
+static constexpr uint8_t LOWERCASE_LETTER_OFFSET = 'a' - '0' - 10;
+
+//
+// Encodes blocks of 16 bytes into 32 digits; returns the offset of the first
+// byte the scalar loop has to encode.
+//
+#if defined(AI_FORMAT_SSE2)
+
+auto writeHexBlocks(uint8_t const *const bytes, std::size_t const size, char *const output, uint8_t const letterOffset) -> std::size_t {
+  auto const nibbleMask = _mm_set1_epi8(0x0f);
+  auto const nine = _mm_set1_epi8(9);
+  auto const zero = _mm_set1_epi8('0');
+  auto const offset = _mm_set1_epi8(static_cast<char>(letterOffset));
+  auto const toDigits = [&](__m128i const nibbles) { return _mm_add_epi8(_mm_add_epi8(nibbles, zero), _mm_and_si128(_mm_cmpgt_epi8(nibbles, nine), offset)); };
+  auto position = std::size_t{0};
+  for (; position + 16 <= size; position += 16) {
+    auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes + position));
+    auto const high = _mm_and_si128(_mm_srli_epi16(block, 4), nibbleMask);
+    auto const low = _mm_and_si128(block, nibbleMask);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + position * 2), toDigits(_mm_unpacklo_epi8(high, low)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + position * 2 + 16), toDigits(_mm_unpackhi_epi8(high, low)));
+  }
+  return position;
+}
+
+#elif defined(AI_FORMAT_NEON)
+
+auto writeHexBlocks(uint8_t const *const bytes, std::size_t const size, char *const output, uint8_t const letterOffset) -> std::size_t {
+  auto const toDigits = [letterOffset](uint8x16_t const nibbles) {
+    return vaddq_u8(vaddq_u8(nibbles, vdupq_n_u8('0')), vandq_u8(vcgtq_u8(nibbles, vdupq_n_u8(9)), vdupq_n_u8(letterOffset)));
+  };
+  auto position = std::size_t{0};
+  for (; position + 16 <= size; position += 16) {
+    auto const block = vld1q_u8(bytes + position);
+    auto const high = vshrq_n_u8(block, 4);
+    auto const low = vandq_u8(block, vdupq_n_u8(0x0f));
+    vst1q_u8(reinterpret_cast<uint8_t *>(output + position * 2), toDigits(vzip1q_u8(high, low)));
+    vst1q_u8(reinterpret_cast<uint8_t *>(output + position * 2 + 16), toDigits(vzip2q_u8(high, low)));
+  }
+  return position;
+}
+
+#elif defined(AI_FORMAT_SIMD128)
+
+auto writeHexBlocks(uint8_t const *const bytes, std::size_t const size, char *const output, uint8_t const letterOffset) -> std::size_t {
+  auto const toDigits = [letterOffset](v128_t const nibbles) {
+    return wasm_i8x16_add(wasm_i8x16_add(nibbles, wasm_i8x16_splat('0')),
+                          wasm_v128_and(wasm_i8x16_gt(nibbles, wasm_i8x16_splat(9)), wasm_i8x16_splat(static_cast<int8_t>(letterOffset))));
+  };
+  auto position = std::size_t{0};
+  for (; position + 16 <= size; position += 16) {
+    auto const block = wasm_v128_load(bytes + position);
+    auto const high = wasm_u8x16_shr(block, 4);
+    auto const low = wasm_v128_and(block, wasm_i8x16_splat(0x0f));
+    wasm_v128_store(output + position * 2, toDigits(wasm_i8x16_shuffle(high, low, 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23)));
+    wasm_v128_store(output + position * 2 + 16, toDigits(wasm_i8x16_shuffle(high, low, 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31)));
+  }
+  return position;
+}
+
+#else
+
+auto writeHexBlocks(uint8_t const *, std::size_t, char *, uint8_t) -> std::size_t { return 0; }
+
+#endif
+
+auto getBase64Value(char const c) -> uint32_t {
+  if (c >= 'A' && c <= 'Z') {
+    return static_cast<uint32_t>(c - 'A');
+  }
+  if (c >= 'a' && c <= 'z') {
+    return static_cast<uint32_t>(c - 'a' + 26);
+  }
+  if (c >= '0' && c <= '9') {
+    return static_cast<uint32_t>(c - '0' + 52);
+  }
+  if (c == '+') {
+    return 62;
+  }
+  if (c == '/') {
+    return 63;
+  }
+  throw std::logic_error("invalid base64 character");
+}
+
+} // namespace
+
+namespace ai::utils::format {
+
+auto writeHex(uint32_t const value, int const digits, char *const output) -> char * {
+  for (auto i{0}; i < digits; i++) {
+    output[i] = UPPERCASE_HEX_DIGITS[(value >> ((digits - 1 - i) * 4)) & 0xf];
+  }
+  return output + digits;
+}
+
+auto writeHex(std::span<std::byte const> const bytes, char *const output, bool const uppercase) -> char * {
+  auto const *const data = reinterpret_cast<uint8_t const *>(bytes.data());
+  auto const *const digits = uppercase ? UPPERCASE_HEX_DIGITS : LOWERCASE_HEX_DIGITS;
+  auto position = writeHexBlocks(data, bytes.size(), output, uppercase ? UPPERCASE_LETTER_OFFSET : LOWERCASE_LETTER_OFFSET);
+  for (; position < bytes.size(); position++) {
+    output[position * 2] = digits[data[position] >> 4];
+    output[position * 2 + 1] = digits[data[position] & 0xf];
+  }
+  return output + bytes.size() * 2;
+}
+
+auto appendHex(std::span<std::byte const> const bytes, std::string &output, bool const uppercase) -> void {
+  auto const size = output.size();
+  output.resize(size + bytes.size() * 2);
+  writeHex(bytes, output.data() + size, uppercase);
+}
+
+auto toHex(std::span<std::byte const> const bytes, bool const uppercase) -> std::string {
+  auto text = std::string();
+  appendHex(bytes, text, uppercase);
+  return text;
+}
+
+auto appendBase64(std::span<std::byte const> const bytes, std::string &output) -> void {
+  auto const *const data = reinterpret_cast<uint8_t const *>(bytes.data());
+  auto position = output.size();
+  output.resize(position + (bytes.size() + 2) / 3 * 4);
+  auto i = std::size_t{0};
+  for (; i + 3 <= bytes.size(); i += 3) {
+    auto const triple = (uint32_t{data[i]} << 16) | (uint32_t{data[i + 1]} << 8) | data[i + 2];
+    output[position++] = BASE64_DIGITS[(triple >> 18) & 0x3f];
+    output[position++] = BASE64_DIGITS[(triple >> 12) & 0x3f];
+    output[position++] = BASE64_DIGITS[(triple >> 6) & 0x3f];
+    output[position++] = BASE64_DIGITS[triple & 0x3f];
+  }
+  if (auto const remaining = bytes.size() - i; remaining > 0) {
+    auto const triple = (uint32_t{data[i]} << 16) | (remaining > 1 ? uint32_t{data[i + 1]} << 8 : 0);
+    output[position++] = BASE64_DIGITS[(triple >> 18) & 0x3f];
+    output[position++] = BASE64_DIGITS[(triple >> 12) & 0x3f];
+    output[position++] = remaining > 1 ? BASE64_DIGITS[(triple >> 6) & 0x3f] : '=';
+    output[position++] = '=';
+  }
+}
+
+auto toBase64(std::span<std::byte const> const bytes) -> std::string {
+  auto text = std::string();
+  appendBase64(bytes, text);
+  return text;
+}
+
+auto decodeBase64(std::string_view const text) -> std::vector<std::byte> {
+  auto bytes = std::vector<std::byte>();
+  bytes.reserve(text.size() / 4 * 3);
+  auto buffer = uint32_t{0};
+  auto bits = 0;
+  for (auto const c : text) {
+    if (c == '=') {
+      break;
+    }
+    buffer = (buffer << 6) | getBase64Value(c);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      bytes.push_back(static_cast<std::byte>((buffer >> bits) & 0xff));
+    }
+  }
+  return bytes;
+}
+
+} // namespace ai::utils::format
@@ -0,0 +1,63 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "utils/glob.h"
+
+auto ai::utils::matchesGlob(std::string_view glob, std::string_view path) -> bool {
+  while (!glob.empty()) {
+    if (glob.starts_with("**")) {
+      glob.remove_prefix(glob.starts_with("**/") ? 3 : 2);
+      if (glob.empty()) {
+        return true;
+      }
+      for (auto segment = size_t(0);;) {
+        if (matchesGlob(glob, path.substr(segment))) {
+          return true;
+        }
+        auto const separator = path.find('/', segment);
+        if (separator == std::string_view::npos) {
+          return false;
+        }
+        segment = separator + 1;
+      }
+    }
+    if (glob.front() == '*') {
+      glob.remove_prefix(1);
+      for (auto length = size_t(0); length <= path.size(); length++) {
+        if (matchesGlob(glob, path.substr(length))) {
+          return true;
+        }
+        if (length < path.size() && path[length] == '/') {
+          break;
+        }
+      }
+      return false;
+    }
+    if (path.empty() || (glob.front() == '?' ? path.front() == '/' : glob.front() != path.front())) {
+      return false;
+    }
+    glob.remove_prefix(1);
+    path.remove_prefix(1);
+  }
+  return path.empty();
+}
@@ -0,0 +1,51 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_ADLER32_H_
+#define ANDROID_INTROSPECTION_UTILS_ADLER32_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace ai::utils::adler32 {
+
+//
+// Continues the Adler-32 of a byte sequence; start with an adler of 1,
+// exactly like zlib's adler32().  Uses SSSE3 on x86 and NEON on ARM when
+// available, and otherwise (e.g. in wasm) sums byte by byte, reducing the
+// sums every 5552 bytes as zlib does.
+//
+auto update(uint32_t adler, std::span<std::byte const> bytes) -> uint32_t;
+
+//
+// Adler-32 of a sequence of the size after its bytes at the offset were
+// replaced, from the Adler-32 before; only the replaced bytes are read, as
+// each byte adds to the checksum by its value and its distance to the end.
+//
+auto replace(uint32_t adler, std::size_t size, std::size_t offset, std::span<std::byte const> originalBytes, std::span<std::byte const> replacementBytes)
+    -> uint32_t;
+
+} // namespace ai::utils::adler32
+
+#endif /* ANDROID_INTROSPECTION_UTILS_ADLER32_H_ */
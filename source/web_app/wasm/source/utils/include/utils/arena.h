@@ -0,0 +1,91 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_ARENA_H_
+#define ANDROID_INTROSPECTION_UTILS_ARENA_H_
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+#include "utils/macros.h"
+
+namespace ai::utils {
+
+//
+// Memory resource for the allocations of a single parse, handed to std::pmr
+// containers.  Memory comes from a monotonic buffer that is only returned
+// as a whole, when the arena is released or destroyed.  Blocks freed before
+// that are kept on a free list per size class and handed out again, so
+// containers that grow or nodes that are dropped mid parse do not pile up.
+// Not thread safe; every thread parses with its own arena.
+//
+class Arena final : public std::pmr::memory_resource {
+public:
+  explicit Arena(std::size_t initialSize = INITIAL_SIZE, std::pmr::memory_resource *upstream = std::pmr::get_default_resource());
+
+  DISALLOW_COPY_AND_ASSIGN(Arena);
+
+  ~Arena() override;
+
+  //
+  // Frees everything allocated so far at once.  Containers using the arena
+  // must be gone or never touched again.
+  //
+  auto release() -> void;
+
+  //
+  // Bytes handed out and not given back, with size class rounding.
+  //
+  auto bytesInUse() const -> std::size_t { return bytesInUse_; }
+
+private:
+  static constexpr std::size_t INITIAL_SIZE = 16 * 1024;
+
+  //
+  // Size classes are 16 bytes apart up to 256 bytes, then powers of two up
+  // to 64 KiB; larger blocks are not reused before the arena is released.
+  //
+  static constexpr std::size_t SIZE_CLASS_COUNT = 24;
+
+  struct FreeBlock {
+
+    FreeBlock *next;
+  };
+
+  auto do_allocate(std::size_t bytes, std::size_t alignment) -> void * override;
+
+  auto do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) -> void override;
+
+  auto do_is_equal(std::pmr::memory_resource const &other) const noexcept -> bool override;
+
+  std::pmr::monotonic_buffer_resource buffer_;
+
+  std::array<FreeBlock *, SIZE_CLASS_COUNT> freeBlocks_{};
+
+  std::size_t bytesInUse_ = 0;
+};
+
+} // namespace ai::utils
+
+#endif /* ANDROID_INTROSPECTION_UTILS_ARENA_H_ */
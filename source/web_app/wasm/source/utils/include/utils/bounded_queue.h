@@ -0,0 +1,110 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_BOUNDED_QUEUE_H_
+#define ANDROID_INTROSPECTION_UTILS_BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+#include "utils/macros.h"
+
+namespace ai::utils {
+
+//
+// Blocking queue of at most capacity items between producer and consumer
+// threads.  Producers wait while it is full, so a slow consumer holds back
+// the producers instead of letting results pile up in memory.  Once closed,
+// pushes are refused and pops drain what is left.
+//
+template <typename T> class BoundedQueue final {
+public:
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+  DISALLOW_COPY_AND_ASSIGN(BoundedQueue);
+
+  //
+  // Returns false if the queue was closed before the item could be queued.
+  //
+  auto push(T item) -> bool {
+    auto lock = std::unique_lock(mutex_);
+    notFull_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(item));
+    lock.unlock();
+    notEmpty_.notify_one();
+    return true;
+  }
+
+  //
+  // Returns std::nullopt once the queue is closed and empty.
+  //
+  auto pop() -> std::optional<T> {
+    auto lock = std::unique_lock(mutex_);
+    notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+    auto item = std::move(items_.front());
+    items_.pop_front();
+    lock.unlock();
+    notFull_.notify_one();
+    return item;
+  }
+
+  auto close() -> void {
+    {
+      auto const lock = std::lock_guard(mutex_);
+      closed_ = true;
+    }
+    notFull_.notify_all();
+    notEmpty_.notify_all();
+  }
+
+  auto isClosed() const -> bool {
+    auto const lock = std::lock_guard(mutex_);
+    return closed_;
+  }
+
+private:
+  size_t const capacity_;
+
+  std::deque<T> items_;
+
+  mutable std::mutex mutex_;
+
+  std::condition_variable notFull_;
+
+  std::condition_variable notEmpty_;
+
+  bool closed_ = false;
+};
+
+} // namespace ai::utils
+
+#endif /* ANDROID_INTROSPECTION_UTILS_BOUNDED_QUEUE_H_ */
@@ -0,0 +1,78 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_CANCELLATION_H_
+#define ANDROID_INTROSPECTION_UTILS_CANCELLATION_H_
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace ai::utils {
+
+//
+// Thrown by a long call once its token is cancelled, after its workers let
+// go of what they were working on.
+//
+class CancellationException : public std::runtime_error {
+public:
+  CancellationException() : std::runtime_error("cancelled") {}
+};
+
+//
+// Cancels long calls from another thread, or from a callback of theirs.
+// Copies share the state, so the caller keeps one and hands another to the
+// call, which checks it between entries, chunks or files and throws
+// CancellationException once it is set.  A default token is never
+// cancelled and costs nothing to check.
+//
+class CancellationToken final {
+public:
+  CancellationToken() = default;
+
+  static auto create() -> CancellationToken { return CancellationToken(std::make_shared<std::atomic_bool>(false)); }
+
+  auto cancel() const -> void {
+    if (cancelled_ != nullptr) {
+      cancelled_->store(true, std::memory_order_relaxed);
+    }
+  }
+
+  [[nodiscard]] auto isCancelled() const -> bool { return cancelled_ != nullptr && cancelled_->load(std::memory_order_relaxed); }
+
+  auto throwIfCancelled() const -> void {
+    if (isCancelled()) {
+      throw CancellationException();
+    }
+  }
+
+private:
+  explicit CancellationToken(std::shared_ptr<std::atomic_bool> cancelled) : cancelled_(std::move(cancelled)) {}
+
+  std::shared_ptr<std::atomic_bool> cancelled_;
+};
+
+} // namespace ai::utils
+
+#endif /* ANDROID_INTROSPECTION_UTILS_CANCELLATION_H_ */
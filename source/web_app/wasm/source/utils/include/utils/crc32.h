@@ -0,0 +1,43 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_CRC32_H_
+#define ANDROID_INTROSPECTION_UTILS_CRC32_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace ai::utils::crc32 {
+
+//
+// Continues the zip (IEEE 802.3) CRC-32 of a byte sequence; start with a
+// crc of 0, exactly like zlib's crc32().  Uses PCLMULQDQ folding on x86
+// and the CRC32 instructions on ARMv8 when available, slicing-by-8
+// otherwise (e.g. in wasm).
+//
+auto update(uint32_t crc, std::span<std::byte const> bytes) -> uint32_t;
+
+} // namespace ai::utils::crc32
+
+#endif /* ANDROID_INTROSPECTION_UTILS_CRC32_H_ */
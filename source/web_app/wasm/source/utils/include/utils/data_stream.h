@@ -25,20 +25,42 @@
 #define ANDROID_INTROSPECTION_UTILS_DATA_STREAM_H_
 
 #include <cstdint>
-#include <vector>
+#include <cstring>
+#include <span>
+#include <type_traits>
 
+//
+// Non owning reader over a byte range; the bytes must outlive the stream.
+//
 class DataStream final {
 public:
-  DataStream(std::vector<std::byte> const &data) : data_(data) {}
+  DataStream(std::span<std::byte const> data) : data_(data) {}
 
   template <typename T> auto read() -> T {
+    require(sizeof(T));
+    return readUnchecked<T>();
+  }
+
+  //
+  // Fast path for ranges already validated with require().
+  //
+  template <typename T> auto readUnchecked() -> T {
     static_assert(std::is_integral<T>::value, "type must be integral");
     T value = {0};
-    memcpy(&value, &data_[index_], sizeof(value));
+    memcpy(&value, data_.data() + index_, sizeof(value));
     index_ += sizeof(value);
     return value;
   }
 
+  //
+  // Throws unless at least the given number of bytes is left to read.
+  //
+  auto require(std::size_t bytes) const -> void;
+
+  auto position() const -> std::size_t { return index_; }
+
+  auto remaining() const -> std::size_t { return data_.size() - index_; }
+
   auto reset() -> void;
 
   auto skip(uint32_t bytes) -> void;
@@ -46,7 +68,7 @@ public:
 private:
   std::size_t index_{0};
 
-  std::vector<std::byte> data_;
+  std::span<std::byte const> data_;
 };
 
 #endif // ANDROID_INTROSPECTION_UTILS_DATA_STREAM_H_
@@ -0,0 +1,126 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_FILE_OUTPUT_H_
+#define ANDROID_INTROSPECTION_UTILS_FILE_OUTPUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "utils/macros.h"
+
+namespace ai::utils {
+
+//
+// Writes one new file front to back through a large buffer, straight to
+// the file descriptor.  With a known size the space is reserved up front,
+// so that file systems can lay the file out in one piece.
+//
+class FileWriter final {
+public:
+  explicit FileWriter(std::string const &path, std::optional<uint64_t> size = std::nullopt);
+
+  DISALLOW_COPY_AND_ASSIGN(FileWriter);
+
+  ~FileWriter();
+
+  auto write(std::span<std::byte const> bytes) -> void;
+
+  //
+  // Writes what is buffered and closes the file; throws if any of the
+  // writes failed.  The destructor closes without reporting errors.
+  //
+  auto close() -> void;
+
+private:
+  auto flushBuffer() -> void;
+
+  std::string path_;
+
+  int fd_ = -1;
+
+  uint64_t written_ = 0;
+
+  std::vector<std::byte> buffer_;
+};
+
+enum class FileOutputBackend {
+
+  //
+  // One open, write and close call per file.
+  //
+  Posix,
+
+  //
+  // Writes and closes of a batch of files are submitted to an io_uring and
+  // completed with a single system call.  Linux only.
+  //
+  IoUring,
+};
+
+//
+// Writes many whole files, e.g. the entries of an archive being dumped.
+// Small files are queued and written in batches, so that contents are
+// copied and only valid for the duration of write(); larger ones are
+// written through a FileWriter right away.  Parent directories must exist.
+// Not thread safe; every worker writes through its own instance.
+//
+class FileOutput final {
+public:
+  //
+  // Falls back to the Posix backend when io_uring is not available, e.g.
+  // on other systems, old kernels or in sandboxes that deny it.
+  //
+  explicit FileOutput(FileOutputBackend preferredBackend = FileOutputBackend::IoUring);
+
+  DISALLOW_COPY_AND_ASSIGN(FileOutput);
+
+  //
+  // Flushes what is queued, logging instead of throwing.
+  //
+  ~FileOutput();
+
+  auto backend() const -> FileOutputBackend;
+
+  auto write(std::string const &path, std::span<std::byte const> contents) -> void;
+
+  //
+  // Waits for every queued file to be written and closed; throws if any of
+  // them failed.
+  //
+  auto flush() -> void;
+
+private:
+  class Batch;
+
+  std::unique_ptr<Batch> batch_;
+};
+
+} // namespace ai::utils
+
+#endif /* ANDROID_INTROSPECTION_UTILS_FILE_OUTPUT_H_ */
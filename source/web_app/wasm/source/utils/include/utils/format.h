@@ -0,0 +1,103 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_FORMAT_H_
+#define ANDROID_INTROSPECTION_UTILS_FORMAT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// utils/log.h has to come before any other spdlog header.
+#include "utils/log.h"
+
+#include "spdlog/fmt/fmt.h"
+
+namespace ai::utils::format {
+
+//
+// Formatting on the fmt library spdlog bundles.  Format strings are checked
+// against their arguments at compile time, e.g. format("@res/0x{:08X}", id)
+// does not build with a string id.
+//
+template <typename... Args> auto format(fmt::format_string<Args...> const format, Args &&...args) -> std::string {
+  return fmt::format(format, std::forward<Args>(args)...);
+}
+
+//
+// Same as above, but appended to output, so that a recycled string does not
+// allocate once it has grown; any allocator, e.g. a std::pmr::string.
+//
+template <typename Allocator, typename... Args>
+auto appendTo(std::basic_string<char, std::char_traits<char>, Allocator> &output, fmt::format_string<Args...> const format, Args &&...args) -> void {
+  fmt::format_to(std::back_inserter(output), format, std::forward<Args>(args)...);
+}
+
+//
+// Same as above, but into a caller buffer, e.g. a std::array on the stack.
+// Output that does not fit is dropped; the formatted part is returned.
+//
+template <typename... Args> auto formatTo(std::span<char> const buffer, fmt::format_string<Args...> const format, Args &&...args) -> std::string_view {
+  auto const result = fmt::format_to_n(buffer.data(), buffer.size(), format, std::forward<Args>(args)...);
+  return {buffer.data(), std::min(result.size, buffer.size())};
+}
+
+//
+// Writes the digits of the low nibbles of value, most significant first, to
+// output and returns the end of what was written.
+//
+auto writeHex(uint32_t value, int digits, char *output) -> char *;
+
+//
+// Writes two digits for every byte to output, which must have room for them,
+// and returns the end of what was written.  Blocks of 16 bytes are encoded
+// at once with SSE2, NEON or wasm SIMD128 when available.
+//
+auto writeHex(std::span<std::byte const> bytes, char *output, bool uppercase = true) -> char *;
+
+auto appendHex(std::span<std::byte const> bytes, std::string &output, bool uppercase = true) -> void;
+
+auto toHex(std::span<std::byte const> bytes, bool uppercase = true) -> std::string;
+
+//
+// Standard base64 alphabet with padding.
+//
+auto appendBase64(std::span<std::byte const> bytes, std::string &output) -> void;
+
+auto toBase64(std::span<std::byte const> bytes) -> std::string;
+
+//
+// Decodes up to the first padding character; throws on any character out of
+// the alphabet.
+//
+auto decodeBase64(std::string_view text) -> std::vector<std::byte>;
+
+} // namespace ai::utils::format
+
+#endif /* ANDROID_INTROSPECTION_UTILS_FORMAT_H_ */
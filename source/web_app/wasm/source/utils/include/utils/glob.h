@@ -0,0 +1,41 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_GLOB_H_
+#define ANDROID_INTROSPECTION_UTILS_GLOB_H_
+
+#include <string_view>
+
+namespace ai::utils {
+
+//
+// Whether a path of an archive matches a glob: '?' matches one character
+// and '*' any run of them within a segment, while '**' matches any number
+// of whole segments, e.g. "res/**/*.xml" matches "res/a.xml" as well as
+// "res/layout/a.xml".
+//
+auto matchesGlob(std::string_view glob, std::string_view path) -> bool;
+
+} // namespace ai::utils
+
+#endif /* ANDROID_INTROSPECTION_UTILS_GLOB_H_ */
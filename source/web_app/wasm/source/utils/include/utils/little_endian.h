@@ -0,0 +1,86 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_LITTLE_ENDIAN_H_
+#define ANDROID_INTROSPECTION_UTILS_LITTLE_ENDIAN_H_
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+//
+// Values in byte buffers, in the little-endian order of every format read
+// and written here: zip, dex, resources and our own caches.  Hosts are
+// little endian too, so values are copied as they are.
+//
+namespace ai::utils::little_endian {
+
+static_assert(std::endian::native == std::endian::little, "values are copied in the byte order of the host");
+
+template <typename T> auto append(std::vector<std::byte> &bytes, T const &value) -> void {
+  static_assert(std::is_trivially_copyable_v<T>, "type must be trivially copyable");
+  auto const data = reinterpret_cast<std::byte const *>(&value);
+  bytes.insert(bytes.end(), data, data + sizeof(value));
+}
+
+//
+// The value at the offset, which the caller has checked is in range.
+//
+template <typename T> auto load(std::span<std::byte const> const bytes, uint64_t const offset) -> T {
+  static_assert(std::is_trivially_copyable_v<T>, "type must be trivially copyable");
+  auto value = T();
+  std::memcpy(&value, bytes.data() + offset, sizeof(value));
+  return value;
+}
+
+//
+// The value at the offset; throws std::logic_error with the message if it
+// is out of range.
+//
+template <typename T> auto load(std::span<std::byte const> const bytes, uint64_t const offset, char const *const error) -> T {
+  if (offset > bytes.size() || sizeof(T) > bytes.size() - offset) {
+    throw std::logic_error(error);
+  }
+  return load<T>(bytes, offset);
+}
+
+template <typename T> auto store(std::span<std::byte> const bytes, uint64_t const offset, T const &value) -> void {
+  static_assert(std::is_trivially_copyable_v<T>, "type must be trivially copyable");
+  std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+template <typename T> auto store(std::span<std::byte> const bytes, uint64_t const offset, T const &value, char const *const error) -> void {
+  if (offset > bytes.size() || sizeof(T) > bytes.size() - offset) {
+    throw std::logic_error(error);
+  }
+  store(bytes, offset, value);
+}
+
+} // namespace ai::utils::little_endian
+
+#endif /* ANDROID_INTROSPECTION_UTILS_LITTLE_ENDIAN_H_ */
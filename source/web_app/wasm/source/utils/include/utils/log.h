@@ -40,42 +40,103 @@
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_OFF
 #endif
 
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
 #include "spdlog/spdlog.h"
+#include "utils/macros.h"
+
+//
+// Modules whose logging can be compiled out on its own, without raising
+// LOG_LEVEL, by clearing their bit in LOG_MODULE_MASK.  A source file joins
+// a module by defining LOG_MODULE before its first include, e.g.
+//
+//   #define LOG_MODULE LOG_MODULE_BINARY_XML
+//
+#define LOG_MODULE_DEFAULT (1U << 0U)
+#define LOG_MODULE_BINARY_XML (1U << 1U)
+#define LOG_MODULE_ZIP (1U << 2U)
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_DEFAULT
+#endif
+
+#ifndef LOG_MODULE_MASK
+#define LOG_MODULE_MASK 0xFFFFFFFFU
+#endif
+
+#define LOG_IF_MODULE_ENABLED(statement)                                                                                                                       \
+  do {                                                                                                                                                         \
+    if constexpr (((LOG_MODULE_MASK) & (LOG_MODULE)) != 0) {                                                                                                   \
+      statement;                                                                                                                                               \
+    }                                                                                                                                                          \
+  } while (false)
 
 #if LOG_LEVEL < 1
-#define LOGV(...) spdlog::trace(__VA_ARGS__)
+#define LOGV(...) LOG_IF_MODULE_ENABLED(spdlog::trace(__VA_ARGS__))
 #else
 #define LOGV(...)
 #endif
 
 #if LOG_LEVEL < 2
-#define LOGD(...) spdlog::debug(__VA_ARGS__)
+#define LOGD(...) LOG_IF_MODULE_ENABLED(spdlog::debug(__VA_ARGS__))
 #else
 #define LOGD(...)
 #endif
 
 #if LOG_LEVEL < 3
-#define LOGI(...) spdlog::info(__VA_ARGS__)
+#define LOGI(...) LOG_IF_MODULE_ENABLED(spdlog::info(__VA_ARGS__))
 #else
 #define LOGI(...)
 #endif
 
 #if LOG_LEVEL < 4
-#define LOGW(...) spdlog::warn(__VA_ARGS__)
+#define LOGW(...) LOG_IF_MODULE_ENABLED(spdlog::warn(__VA_ARGS__))
 #else
 #define LOGW(...)
 #endif
 
 #if LOG_LEVEL < 5
-#define LOGE(...) spdlog::error(__VA_ARGS__)
+#define LOGE(...) LOG_IF_MODULE_ENABLED(spdlog::error(__VA_ARGS__))
 #else
 #define LOGE(...)
 #endif
 
 #if LOG_LEVEL < 6
-#define LOGF(...) spdlog::critical(__VA_ARGS__)
+#define LOGF(...) LOG_IF_MODULE_ENABLED(spdlog::critical(__VA_ARGS__))
 #else
 #define LOGF(...)
 #endif
 
+namespace spdlog::details {
+class thread_pool;
+} // namespace spdlog::details
+
+namespace ai::utils::log {
+
+//
+// Routes the default logger through a background thread for as long as it
+// lives: callers only format the message and push it onto a bounded ring
+// buffer, while the sinks are written to and flushed every flushInterval on
+// the logging thread.  When the buffer is full the oldest messages are
+// dropped rather than blocking the caller.  Pending messages are written out
+// on destruction.  Logging stays synchronous where there are no threads.
+//
+class AsyncLogging final {
+public:
+  explicit AsyncLogging(size_t queueSize = 8192, std::chrono::seconds flushInterval = std::chrono::seconds(1));
+
+  ~AsyncLogging();
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncLogging);
+
+private:
+  std::shared_ptr<spdlog::logger> previousLogger_;
+
+  std::shared_ptr<spdlog::details::thread_pool> threadPool_;
+};
+
+} // namespace ai::utils::log
+
 #endif /* ANDROID_INTROSPECTION_UTILS_LOG_H_ */
@@ -0,0 +1,96 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_MAPPED_FILE_H_
+#define ANDROID_INTROSPECTION_UTILS_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "utils/macros.h"
+
+namespace ai::utils {
+
+//
+// How a range of a file is about to be read, handed to the kernel so it
+// reads ahead, or not, and keeps or drops the pages: WillNeed starts
+// reading the range in the background, DontNeed drops it from the page
+// cache once it has been read.
+//
+enum class AccessAdvice : uint8_t { Normal, Sequential, Random, WillNeed, DontNeed };
+
+//
+// Advises the kernel about a range of the file open at the descriptor; a
+// length of 0 runs to the end of the file.  Advice is a hint, so failures
+// are ignored.
+//
+auto adviseDescriptor(int fd, AccessAdvice advice, uint64_t offset, uint64_t length) -> void;
+
+//
+// Read-only memory mapping of a whole file.  The mapping stays valid for
+// the lifetime of the object; spans handed out by bytes() must not outlive
+// it.
+//
+class MappedFile final {
+public:
+  explicit MappedFile(std::string const &path);
+
+  //
+  // Maps the file open at the descriptor, which the caller keeps and may
+  // close as soon as this returns.
+  //
+  explicit MappedFile(int fd);
+
+  ~MappedFile();
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+
+  auto bytes() const -> std::span<std::byte const>;
+
+  auto size() const -> size_t;
+
+  //
+  // Same as adviseDescriptor() for a range of the mapping, both for the
+  // mapping and for the file behind it.
+  //
+  auto advise(AccessAdvice advice, size_t offset, size_t length) const -> void;
+
+private:
+  auto map(int fd) -> void;
+
+  //
+  // Kept for the advice that only applies to the file, closed with the
+  // mapping.
+  //
+  int fd_ = -1;
+
+  void *address_ = nullptr;
+
+  size_t size_ = 0;
+};
+
+} // namespace ai::utils
+
+#endif /* ANDROID_INTROSPECTION_UTILS_MAPPED_FILE_H_ */
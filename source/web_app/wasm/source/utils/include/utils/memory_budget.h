@@ -0,0 +1,165 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_MEMORY_BUDGET_H_
+#define ANDROID_INTROSPECTION_UTILS_MEMORY_BUDGET_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "utils/macros.h"
+#include "utils/metrics.h"
+
+namespace ai::utils::memory {
+
+//
+// Thrown instead of allocating past a budget, e.g. before a Wasm heap that
+// cannot grow any further would abort the module.
+//
+class MemoryBudgetExceededException : public std::runtime_error {
+public:
+  explicit MemoryBudgetExceededException(std::string const &message) : std::runtime_error(message) {}
+};
+
+class MemoryBudget;
+
+//
+// Bytes accounted to a subsystem of a budget until it is destroyed.
+//
+class MemoryReservation final {
+public:
+  MemoryReservation() = default;
+
+  MemoryReservation(MemoryReservation &&other) noexcept;
+
+  auto operator=(MemoryReservation &&other) noexcept -> MemoryReservation &;
+
+  ~MemoryReservation();
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryReservation);
+
+  auto bytes() const -> uint64_t { return bytes_; }
+
+private:
+  friend class MemoryBudget;
+
+  MemoryReservation(std::shared_ptr<MemoryBudget> budget, metrics::Gauge *subsystem, uint64_t bytes);
+
+  std::shared_ptr<MemoryBudget> budget_;
+
+  metrics::Gauge *subsystem_ = nullptr;
+
+  uint64_t bytes_ = 0;
+};
+
+//
+// Most bytes the working memory of an operation may take at once, i.e. what
+// is inflated, parsed and rendered on top of its input; 0 for no limit.
+// Live bytes are also accounted per subsystem, in the gauges named
+// "memory.<subsystem>.live_bytes", with or without a limit.  Subsystem names
+// must outlive the budget, e.g. string literals.
+//
+class MemoryBudget final : public std::enable_shared_from_this<MemoryBudget> {
+public:
+  explicit MemoryBudget(uint64_t const limit = 0) : limit_(limit) {}
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryBudget);
+
+  auto setLimit(uint64_t const limit) -> void { limit_.store(limit, std::memory_order_relaxed); }
+
+  auto limit() const -> uint64_t { return limit_.load(std::memory_order_relaxed); }
+
+  auto liveBytes() const -> uint64_t { return live_.load(std::memory_order_relaxed); }
+
+  //
+  // Whether that many more bytes would fit right now, for callers with a
+  // streaming variant to fall back to.
+  //
+  auto fits(uint64_t bytes) const -> bool;
+
+  //
+  // Accounts the bytes to the subsystem, throwing if they do not fit.
+  //
+  auto reserve(char const *subsystem, uint64_t bytes) -> MemoryReservation;
+
+  auto acquire(char const *subsystem, metrics::Gauge &liveBytes, uint64_t bytes) -> void;
+
+  auto release(metrics::Gauge &liveBytes, uint64_t bytes) -> void;
+
+  static auto getSubsystemGauge(char const *subsystem) -> metrics::Gauge &;
+
+private:
+  std::atomic_uint64_t limit_;
+
+  std::atomic_uint64_t live_ = 0;
+};
+
+//
+// Allocator accounting what containers hold to a subsystem of a budget, so
+// that growing one past the budget throws rather than exhausting the heap.
+//
+template <typename T> class AccountingAllocator {
+public:
+  using value_type = T;
+
+  AccountingAllocator(std::shared_ptr<MemoryBudget> budget, char const *const subsystem)
+      : budget_(std::move(budget)), subsystem_(subsystem), liveBytes_(&MemoryBudget::getSubsystemGauge(subsystem)) {}
+
+  template <typename U>
+  AccountingAllocator(AccountingAllocator<U> const &other) : budget_(other.budget_), subsystem_(other.subsystem_), liveBytes_(other.liveBytes_) {}
+
+  auto allocate(size_t const count) -> T * {
+    budget_->acquire(subsystem_, *liveBytes_, count * sizeof(T));
+    try {
+      return std::allocator<T>().allocate(count);
+    } catch (...) {
+      budget_->release(*liveBytes_, count * sizeof(T));
+      throw;
+    }
+  }
+
+  auto deallocate(T *const pointer, size_t const count) -> void {
+    std::allocator<T>().deallocate(pointer, count);
+    budget_->release(*liveBytes_, count * sizeof(T));
+  }
+
+  template <typename U> auto operator==(AccountingAllocator<U> const &other) const -> bool { return budget_ == other.budget_; }
+
+private:
+  template <typename U> friend class AccountingAllocator;
+
+  std::shared_ptr<MemoryBudget> budget_;
+
+  char const *subsystem_;
+
+  metrics::Gauge *liveBytes_;
+};
+
+} // namespace ai::utils::memory
+
+#endif /* ANDROID_INTROSPECTION_UTILS_MEMORY_BUDGET_H_ */
@@ -0,0 +1,138 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_METRICS_H_
+#define ANDROID_INTROSPECTION_UTILS_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "utils/macros.h"
+
+//
+// Process wide counters, gauges and histograms, e.g. to tell repeated scans
+// of an archive apart from cached ones.  Metrics are named once and live for
+// the whole process, so call sites keep the reference in a static:
+//
+//   static auto &scans = utils::metrics::counter("zip.central_directory_scans");
+//   scans.add();
+//
+// Updates are single relaxed atomics; only naming a metric takes a lock.
+//
+namespace ai::utils::metrics {
+
+class Counter final {
+public:
+  Counter() = default;
+
+  DISALLOW_COPY_AND_ASSIGN(Counter);
+
+  auto add(uint64_t const amount = 1) -> void { value_.fetch_add(amount, std::memory_order_relaxed); }
+
+  auto value() const -> uint64_t { return value_.load(std::memory_order_relaxed); }
+
+  auto reset() -> void { value_.store(0, std::memory_order_relaxed); }
+
+private:
+  std::atomic_uint64_t value_ = 0;
+};
+
+class Gauge final {
+public:
+  Gauge() = default;
+
+  DISALLOW_COPY_AND_ASSIGN(Gauge);
+
+  auto set(int64_t const value) -> void { value_.store(value, std::memory_order_relaxed); }
+
+  auto add(int64_t const amount) -> void { value_.fetch_add(amount, std::memory_order_relaxed); }
+
+  auto value() const -> int64_t { return value_.load(std::memory_order_relaxed); }
+
+  auto reset() -> void { set(0); }
+
+private:
+  std::atomic_int64_t value_ = 0;
+};
+
+//
+// Distribution of values over power of two buckets: bucket i counts the
+// values that take i bits, so 0 goes to bucket 0 and 5 to bucket 3.
+//
+class Histogram final {
+public:
+  static constexpr size_t BUCKET_COUNT = 65;
+
+  Histogram() = default;
+
+  DISALLOW_COPY_AND_ASSIGN(Histogram);
+
+  auto record(uint64_t value) -> void;
+
+  auto count() const -> uint64_t { return count_.load(std::memory_order_relaxed); }
+
+  auto sum() const -> uint64_t { return sum_.load(std::memory_order_relaxed); }
+
+  auto bucket(size_t const index) const -> uint64_t { return buckets_[index].load(std::memory_order_relaxed); }
+
+  //
+  // Upper bound of the bucket holding the given fraction of the values, e.g.
+  // 0.5 for the median; 0 without values.
+  //
+  auto quantile(double fraction) const -> uint64_t;
+
+  auto reset() -> void;
+
+private:
+  std::atomic_uint64_t count_ = 0;
+
+  std::atomic_uint64_t sum_ = 0;
+
+  std::array<std::atomic_uint64_t, BUCKET_COUNT> buckets_ = {};
+};
+
+auto counter(std::string_view name) -> Counter &;
+
+auto gauge(std::string_view name) -> Gauge &;
+
+auto histogram(std::string_view name) -> Histogram &;
+
+//
+// Current value of every metric by name.  Histograms are reported as
+// "<name>.count", "<name>.sum", "<name>.p50" and "<name>.p99".
+//
+auto snapshot() -> std::map<std::string, std::string>;
+
+//
+// Zeroes every metric; names stay registered.
+//
+auto reset() -> void;
+
+} // namespace ai::utils::metrics
+
+#endif /* ANDROID_INTROSPECTION_UTILS_METRICS_H_ */
@@ -24,10 +24,89 @@
 #ifndef ANDROID_INTROSPECTION_UTILS_SHA_H_
 #define ANDROID_INTROSPECTION_UTILS_SHA_H_
 
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/macros.h"
+
+namespace Botan {
+class HashFunction;
+} // namespace Botan
 
 namespace ai::utils::sha {
 
+static constexpr size_t SHA256_SIZE = 32;
+
+using Sha256Digest = std::array<std::byte, SHA256_SIZE>;
+
+static constexpr size_t SHA512_SIZE = 64;
+
+using Sha512Digest = std::array<std::byte, SHA512_SIZE>;
+
+//
+// Incremental SHA-256.  Botan picks the SHA extensions of x86 and ARMv8 at
+// run time where the CPU has them.
+//
+class Sha256 final {
+public:
+  Sha256();
+
+  ~Sha256();
+
+  DISALLOW_COPY_AND_ASSIGN(Sha256);
+
+  auto update(std::span<std::byte const> bytes) -> Sha256 &;
+
+  //
+  // Returns the digest and resets the hash for the next message.
+  //
+  auto finish() -> Sha256Digest;
+
+private:
+  std::unique_ptr<Botan::HashFunction> const hash_;
+};
+
+//
+// Incremental SHA-512, for the content digests of APKs signed with large
+// keys.
+//
+class Sha512 final {
+public:
+  Sha512();
+
+  ~Sha512();
+
+  DISALLOW_COPY_AND_ASSIGN(Sha512);
+
+  auto update(std::span<std::byte const> bytes) -> Sha512 &;
+
+  //
+  // Returns the digest and resets the hash for the next message.
+  //
+  auto finish() -> Sha512Digest;
+
+private:
+  std::unique_ptr<Botan::HashFunction> const hash_;
+};
+
+//
+// One-shot digest with a hash Botan knows by name, e.g. "SHA-1".
+//
+auto computeDigest(std::string_view hashName, std::span<std::byte const> bytes) -> std::vector<std::byte>;
+
+//
+// Digests of a whole file for every named hash, in the order of hashNames,
+// computed in a single pass: the file is memory mapped and each block is fed
+// to all hashes while it is still in cache.  Throws if the file cannot be
+// read or a hash is unknown to Botan.
+//
+auto computeFileDigests(std::string const &path, std::span<std::string_view const> hashNames) -> std::vector<std::vector<std::byte>>;
+
 auto generateSha256ForFile(std::string const &path) -> std::string;
 
 } // namespace ai::utils::sha
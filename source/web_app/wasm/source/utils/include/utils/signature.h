@@ -0,0 +1,133 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_SIGNATURE_H_
+#define ANDROID_INTROSPECTION_UTILS_SIGNATURE_H_
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "utils/macros.h"
+
+namespace ai::utils::signature {
+
+enum class SignatureAlgorithm {
+  RsaPkcs1Sha256,
+  EcdsaSha256,
+
+  //
+  // What apksigner signs with for RSA keys over 3072 bits and EC keys over
+  // 256 bits.
+  //
+  RsaPkcs1Sha512,
+  EcdsaSha512,
+
+  //
+  // Only found in v1 (JAR) signatures of older APKs.
+  //
+  RsaPkcs1Sha1,
+  EcdsaSha1,
+};
+
+struct CertificateInfo {
+
+  std::string subject;
+
+  std::string issuer;
+
+  std::string serialNumber;
+
+  std::string notBefore;
+
+  std::string notAfter;
+
+  std::string sha256Fingerprint;
+
+  //
+  // "RSA" or "ECDSA" for the keys the signature schemes use.
+  //
+  std::string keyAlgorithm;
+
+  //
+  // DER encoded SubjectPublicKeyInfo.
+  //
+  std::vector<std::byte> publicKey;
+};
+
+//
+// Reads a DER or PEM encoded X.509 certificate; throws if it cannot be
+// parsed.
+//
+auto readCertificate(std::span<std::byte const> certificate) -> CertificateInfo;
+
+//
+// Checks a signature over data made with the key in publicKey, a DER
+// SubjectPublicKeyInfo.  Malformed keys and signatures fail the check
+// rather than throw.
+//
+auto verify(SignatureAlgorithm algorithm, std::span<std::byte const> publicKey, std::span<std::byte const> data, std::span<std::byte const> signature)
+    -> bool;
+
+//
+// Private key (PKCS#8) and the X.509 certificate that goes with it, each
+// either DER or PEM encoded.  Throws if either cannot be read, the key type
+// is not supported or the certificate is for another key.
+//
+class SigningKey final {
+public:
+  SigningKey(std::span<std::byte const> privateKey, std::span<std::byte const> certificate);
+
+  ~SigningKey();
+
+  DISALLOW_COPY_AND_ASSIGN(SigningKey);
+
+  auto algorithm() const -> SignatureAlgorithm;
+
+  //
+  // DER encoded certificate.
+  //
+  auto certificate() const -> std::vector<std::byte> const &;
+
+  //
+  // DER encoded SubjectPublicKeyInfo.
+  //
+  auto publicKey() const -> std::vector<std::byte> const &;
+
+  //
+  // Signs data with the algorithm of the key; ECDSA signatures are DER
+  // encoded.  Safe to call from several threads.
+  //
+  auto sign(std::span<std::byte const> data) const -> std::vector<std::byte>;
+
+private:
+  struct Key;
+
+  std::unique_ptr<Key const> const key_;
+};
+
+} // namespace ai::utils::signature
+
+#endif /* ANDROID_INTROSPECTION_UTILS_SIGNATURE_H_ */
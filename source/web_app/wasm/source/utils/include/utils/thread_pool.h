@@ -0,0 +1,104 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_THREAD_POOL_H_
+#define ANDROID_INTROSPECTION_UTILS_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "utils/macros.h"
+
+namespace ai::utils {
+
+//
+// Fixed size pool of worker threads.  A pool without threads runs every
+// task inline on the submitting thread, which is what single threaded
+// builds (e.g. wasm without pthreads) get by default.
+//
+// Tasks must not block on futures of other tasks submitted to the same
+// pool.
+//
+class ThreadPool final {
+public:
+  explicit ThreadPool(size_t threadCount = defaultThreadCount());
+
+  ~ThreadPool();
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+
+  template <typename Task> auto submit(Task &&task) -> std::future<std::invoke_result_t<std::decay_t<Task>>> {
+    using Result = std::invoke_result_t<std::decay_t<Task>>;
+    auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+    auto future = packagedTask->get_future();
+    if (threads_.empty()) {
+      (*packagedTask)();
+      return future;
+    }
+    {
+      auto const lock = std::lock_guard(mutex_);
+      tasks_.emplace([packagedTask] { (*packagedTask)(); });
+    }
+    condition_.notify_one();
+    return future;
+  }
+
+  auto threadCount() const -> size_t;
+
+  //
+  // Threads of the hardware, or none where there are no pthreads; in the
+  // threaded wasm build that is navigator.hardwareConcurrency.
+  //
+  static auto defaultThreadCount() -> size_t;
+
+  //
+  // Pool with the default thread count shared by the calls that take no
+  // pool, so that threads (web workers in the browser) are started once
+  // rather than on every call.  Its tasks must not use it themselves.
+  //
+  static auto shared() -> ThreadPool &;
+
+private:
+  auto run() -> void;
+
+  std::vector<std::thread> threads_;
+
+  std::queue<std::function<void()>> tasks_;
+
+  std::mutex mutex_;
+
+  std::condition_variable condition_;
+
+  bool stopping_ = false;
+};
+
+} // namespace ai::utils
+
+#endif /* ANDROID_INTROSPECTION_UTILS_THREAD_POOL_H_ */
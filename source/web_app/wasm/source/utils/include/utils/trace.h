@@ -0,0 +1,203 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_TRACE_H_
+#define ANDROID_INTROSPECTION_UTILS_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils/macros.h"
+
+//
+// Spans are compiled in unless TRACING is defined to 0, and only recorded
+// while tracing is enabled at run time.
+//
+#ifndef TRACING
+#define TRACING 1
+#endif
+
+namespace ai::utils::trace {
+
+namespace detail {
+
+inline auto enabled = std::atomic_bool(false);
+
+} // namespace detail
+
+inline auto isEnabled() -> bool { return detail::enabled.load(std::memory_order_relaxed); }
+
+//
+// Starts or stops recording spans; spans already open when tracing starts
+// are not recorded.
+//
+auto setEnabled(bool enabled) -> void;
+
+//
+// Times the scope it lives in.  Ended spans go to a buffer of the thread
+// that ran them; in the browser they are also reported with
+// performance.measure(), so they show up in the DevTools timings track.
+// The name must outlive tracing, i.e. be a string literal.
+//
+class Span final {
+public:
+  explicit Span(char const *const name) : name_(isEnabled() ? name : nullptr) {
+    if (name_ != nullptr) {
+      start_ = now();
+    }
+  }
+
+  ~Span() {
+    if (name_ != nullptr) {
+      end(name_, start_);
+    }
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(Span);
+
+  //
+  // Microseconds since tracing first started.
+  //
+  static auto now() -> double;
+
+private:
+  static auto end(char const *name, double start) -> void;
+
+  char const *const name_;
+
+  double start_ = 0;
+};
+
+//
+// Count and total duration of calls too short and too many to record a
+// span for each, e.g. strings transcoded on demand.  Like metrics they are
+// named once and kept in a static at the call site.
+//
+class Accumulator final {
+public:
+  explicit Accumulator(char const *const name) : name_(name) {}
+
+  DISALLOW_COPY_AND_ASSIGN(Accumulator);
+
+  auto add(double const microseconds) -> void {
+    count_.fetch_add(1, std::memory_order_relaxed);
+    nanoseconds_.fetch_add(static_cast<uint64_t>(microseconds * 1000), std::memory_order_relaxed);
+  }
+
+  auto name() const -> char const * { return name_; }
+
+  auto count() const -> uint64_t { return count_.load(std::memory_order_relaxed); }
+
+  auto microseconds() const -> double { return static_cast<double>(nanoseconds_.load(std::memory_order_relaxed)) / 1000; }
+
+  auto reset() -> void;
+
+private:
+  char const *const name_;
+
+  std::atomic_uint64_t count_ = 0;
+
+  std::atomic_uint64_t nanoseconds_ = 0;
+};
+
+auto accumulator(char const *name) -> Accumulator &;
+
+//
+// Adds the time of the scope it lives in to an accumulator while tracing is
+// enabled.
+//
+class AccumulatedSpan final {
+public:
+  explicit AccumulatedSpan(Accumulator &accumulator) : accumulator_(isEnabled() ? &accumulator : nullptr) {
+    if (accumulator_ != nullptr) {
+      start_ = Span::now();
+    }
+  }
+
+  ~AccumulatedSpan() {
+    if (accumulator_ != nullptr) {
+      accumulator_->add(Span::now() - start_);
+    }
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(AccumulatedSpan);
+
+private:
+  Accumulator *const accumulator_;
+
+  double start_ = 0;
+};
+
+//
+// Spans and accumulated calls recorded so far with the same name.  Nested
+// spans are each counted in full, so the totals of a span and the spans it
+// contains overlap.
+//
+struct SpanSummary {
+
+  std::string name;
+
+  uint64_t count = 0;
+
+  double totalMicroseconds = 0;
+
+  double maxMicroseconds = 0;
+};
+
+//
+// Every name recorded so far, by any thread, longest total first.
+//
+auto summarize() -> std::vector<SpanSummary>;
+
+//
+// Every span recorded so far, by any thread, in the Chrome Trace Event
+// format that chrome://tracing and Perfetto load.
+//
+auto exportChromeTrace() -> std::string;
+
+//
+// Drops the spans recorded so far and zeroes the accumulators.
+//
+auto clear() -> void;
+
+} // namespace ai::utils::trace
+
+#define TRACE_SPAN_CONCAT_(a, b) a##b
+
+#define TRACE_SPAN_VARIABLE_(line) TRACE_SPAN_CONCAT_(traceSpan, line)
+
+#define TRACE_ACCUMULATOR_VARIABLE_(line) TRACE_SPAN_CONCAT_(traceAccumulator, line)
+
+#if TRACING
+#define TRACE_SPAN(name) ai::utils::trace::Span const TRACE_SPAN_VARIABLE_(__LINE__)(name)
+#define TRACE_ACCUMULATE(name)                                                                                                                                \
+  static auto &TRACE_ACCUMULATOR_VARIABLE_(__LINE__) = ai::utils::trace::accumulator(name);                                                                   \
+  ai::utils::trace::AccumulatedSpan const TRACE_SPAN_VARIABLE_(__LINE__)(TRACE_ACCUMULATOR_VARIABLE_(__LINE__))
+#else
+#define TRACE_SPAN(name)
+#define TRACE_ACCUMULATE(name)
+#endif
+
+#endif /* ANDROID_INTROSPECTION_UTILS_TRACE_H_ */
@@ -0,0 +1,89 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_UTILS_UNICODE_H_
+#define ANDROID_INTROSPECTION_UTILS_UNICODE_H_
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace ai::utils::unicode {
+
+//
+// Appends the UTF-8 encoding of UTF-16 text to output.  Runs of ASCII are
+// narrowed with SSE2/AVX2, NEON or wasm SIMD128 when available, everything
+// else goes through a scalar encoder.  Unpaired surrogates become U+FFFD.
+//
+auto appendUtf8(std::u16string_view utf16, std::string &output) -> void;
+
+//
+// Same as above for little endian UTF-16 code units that are not
+// necessarily aligned, e.g. straight out of a resource string pool.
+//
+auto appendUtf8(std::span<std::byte const> utf16, std::string &output) -> void;
+
+auto toUtf8(std::u16string_view utf16) -> std::string;
+
+auto toUtf8(std::span<std::byte const> utf16) -> std::string;
+
+//
+// Decodes UTF-8 into UTF-16 for writing string pools.  Malformed sequences
+// become U+FFFD.
+//
+auto toUtf16(std::string_view utf8) -> std::u16string;
+
+//
+// Modified UTF-8, as in DEX string data: UTF-16 code units of one to three
+// bytes each, U+0000 as C0 80 and supplementary characters as two encoded
+// surrogates.  Runs of ASCII are checked 16 or 32 bytes at a time with the
+// same vector code as above; NUL, surrogates and other sequences are left
+// to scalar code.
+//
+
+//
+// UTF-16 length of well formed MUTF-8, which DEX stores before each string,
+// or nullopt for a raw NUL, a four byte or an overlong sequence, or a
+// truncated one.
+//
+auto getMutf8Utf16Length(std::string_view mutf8) -> std::optional<size_t>;
+
+//
+// Appends the UTF-8 of MUTF-8 text to output, joining surrogate pairs.
+// Malformed sequences and unpaired surrogates become U+FFFD.
+//
+auto appendUtf8FromMutf8(std::string_view mutf8, std::string &output) -> void;
+
+auto mutf8ToUtf8(std::string_view mutf8) -> std::string;
+
+//
+// Decodes MUTF-8 into UTF-16, keeping unpaired surrogates as Java does.
+// Malformed sequences become U+FFFD.
+//
+auto mutf8ToUtf16(std::string_view mutf8) -> std::u16string;
+
+} // namespace ai::utils::unicode
+
+#endif /* ANDROID_INTROSPECTION_UTILS_UNICODE_H_ */
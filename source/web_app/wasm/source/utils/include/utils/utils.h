@@ -24,13 +24,12 @@
 #ifndef ANDROID_INTROSPECTION_UTILS_UTILS_H_
 #define ANDROID_INTROSPECTION_UTILS_UTILS_H_
 
-#include <cstdint>
 #include <fstream>
-#include <iomanip>
-#include <memory>
-#include <sstream>
+#include <span>
 #include <string>
 
+#include "utils/file_output.h"
+
 using namespace std;
 
 namespace ai::utils {
@@ -41,24 +40,9 @@ inline auto fileExists(std::string_view path) -> bool {
 }
 
 inline auto writeToFile(std::string const &path, std::string const &contents) {
-  ofstream outfile(path.data());
-  outfile << contents;
-}
-
-inline auto bytesToHexString(std::vector<std::byte> const &bytes) -> std::string {
-  std::ostringstream stream;
-  stream << std::hex << std::uppercase << std::setfill('0');
-  for (auto const b : bytes) {
-    stream << std::setw(2) << static_cast<char>(b);
-  }
-  return stream.str();
-}
-
-template <typename... Args> std::string formatString(const char *format, Args... args) {
-  auto size = static_cast<uint64_t>(snprintf(nullptr, 0, format, args...) + 1);
-  std::unique_ptr<char[]> buf(new char[size]);
-  snprintf(buf.get(), size, format, args...);
-  return std::string(buf.get(), buf.get() + size - 1);
+  auto writer = FileWriter(path, contents.size());
+  writer.write(std::as_bytes(std::span(contents)));
+  writer.close();
 }
 
 } // namespace ai::utils
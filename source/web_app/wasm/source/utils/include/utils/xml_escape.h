@@ -21,25 +21,29 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
-#include "attributes_setter_visitor.h"
-#include "utils/macros.h"
+#ifndef ANDROID_INTROSPECTION_UTILS_XML_ESCAPE_H_
+#define ANDROID_INTROSPECTION_UTILS_XML_ESCAPE_H_
 
+#include <cstddef>
 #include <string>
 #include <string_view>
-#include <vector>
 
-using namespace ai;
+namespace ai::utils::xml {
 
-AttributesSetterVisitor::AttributesSetterVisitor(std::vector<std::string> const &elementPath, std::string_view attributeName, std::string_view attributeValue) {
-  utils::ignore(elementPath);
-  utils::ignore(attributeName);
-  utils::ignore(attributeValue);
-}
-
-auto AttributesSetterVisitor::visit(StartXmlTagElement const &element) -> void { utils::ignore(element); }
+//
+// Appends text to output with &, <, > and " replaced by their entities, so
+// it can go into element text as well as double quoted attribute values.
+// The text is scanned 16 bytes at a time with SSE2, NEON or wasm SIMD128
+// when available and copied in runs between the characters to replace.
+//
+auto appendEscaped(std::string_view text, std::string &output) -> void;
 
-auto AttributesSetterVisitor::visit(EndXmlTagElement const &element) -> void { utils::ignore(element); }
+//
+// Offset of the first character appendEscaped() would replace, or the size
+// of the text if there is none.
+//
+auto findEscaped(std::string_view text) -> std::size_t;
 
-auto AttributesSetterVisitor::visit(InvalidXmlTagElement const &element) -> void { utils::ignore(element); }
+} // namespace ai::utils::xml
 
-auto AttributesSetterVisitor::visit(CDataTagElement const &element) -> void { utils::ignore(element); }
+#endif /* ANDROID_INTROSPECTION_UTILS_XML_ESCAPE_H_ */
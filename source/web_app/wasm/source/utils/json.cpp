@@ -0,0 +1,66 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+
+#include "utils/format.h"
+#include "utils/json.h"
+
+namespace {
+
+inline auto isEscaped(char const c) -> bool { return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20; }
+
+} // namespace
+
+auto ai::utils::json::appendString(std::string_view const text, std::string &output) -> void {
+  output += '"';
+  auto run = text.begin();
+  while (run != text.end()) {
+    auto const escaped = std::find_if(run, text.end(), isEscaped);
+    output.append(run, escaped);
+    if (escaped == text.end()) {
+      break;
+    }
+    switch (*escaped) {
+    case '"':
+      output += "\\\"";
+      break;
+    case '\\':
+      output += "\\\\";
+      break;
+    case '\n':
+      output += "\\n";
+      break;
+    case '\r':
+      output += "\\r";
+      break;
+    case '\t':
+      output += "\\t";
+      break;
+    default:
+      utils::format::appendTo(output, "\\u{:04x}", static_cast<unsigned char>(*escaped));
+    }
+    run = escaped + 1;
+  }
+  output += '"';
+}
@@ -0,0 +1,60 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// log.h picks the spdlog level, so it has to come before any spdlog header.
+#include "utils/log.h"
+
+#include "spdlog/async.h"
+#include "spdlog/async_logger.h"
+
+using namespace ai::utils::log;
+
+AsyncLogging::AsyncLogging(size_t const queueSize, std::chrono::seconds const flushInterval) {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  ai::utils::ignore(queueSize);
+  ai::utils::ignore(flushInterval);
+#else
+  previousLogger_ = spdlog::default_logger();
+  threadPool_ = std::make_shared<spdlog::details::thread_pool>(queueSize, 1);
+  auto const &sinks = previousLogger_->sinks();
+  auto logger = std::make_shared<spdlog::async_logger>(previousLogger_->name(), sinks.begin(), sinks.end(), threadPool_,
+                                                       spdlog::async_overflow_policy::overrun_oldest);
+  logger->set_level(previousLogger_->level());
+  logger->flush_on(spdlog::level::err);
+  spdlog::set_default_logger(std::move(logger));
+  spdlog::flush_every(flushInterval);
+#endif
+}
+
+AsyncLogging::~AsyncLogging() {
+  if (previousLogger_ == nullptr) {
+    return;
+  }
+  spdlog::default_logger()->flush();
+  spdlog::set_default_logger(previousLogger_);
+  //
+  // Messages still queued keep the async logger alive; the logging thread
+  // writes them out before it is joined here.
+  //
+  threadPool_.reset();
+}
@@ -0,0 +1,162 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/log.h"
+#include "utils/mapped_file.h"
+
+using namespace ai::utils;
+
+namespace {
+
+struct ScopedFileDescriptor {
+
+  explicit ScopedFileDescriptor(int const fd) : fd_(fd) {}
+
+  ~ScopedFileDescriptor() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  auto get() const -> int { return fd_; }
+
+private:
+  int const fd_;
+};
+
+auto getMemoryAdvice(AccessAdvice const advice) -> int {
+  switch (advice) {
+  case AccessAdvice::Sequential:
+    return MADV_SEQUENTIAL;
+  case AccessAdvice::Random:
+    return MADV_RANDOM;
+  case AccessAdvice::WillNeed:
+    return MADV_WILLNEED;
+  case AccessAdvice::DontNeed:
+    return MADV_DONTNEED;
+  default:
+    return MADV_NORMAL;
+  }
+}
+
+auto getFileAdvice(AccessAdvice const advice) -> int {
+  switch (advice) {
+  case AccessAdvice::Sequential:
+    return POSIX_FADV_SEQUENTIAL;
+  case AccessAdvice::Random:
+    return POSIX_FADV_RANDOM;
+  case AccessAdvice::WillNeed:
+    return POSIX_FADV_WILLNEED;
+  case AccessAdvice::DontNeed:
+    return POSIX_FADV_DONTNEED;
+  default:
+    return POSIX_FADV_NORMAL;
+  }
+}
+
+} // namespace
+
+auto ai::utils::adviseDescriptor(int const fd, AccessAdvice const advice, uint64_t const offset, uint64_t const length) -> void {
+  if (auto const result = posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), getFileAdvice(advice)); result != 0) {
+    LOGD("adviseDescriptor, unable to advise [{}], {}", fd, result);
+  }
+}
+
+MappedFile::MappedFile(std::string const &path) {
+  auto const fd = ScopedFileDescriptor(open(path.c_str(), O_RDONLY));
+  if (fd.get() < 0) {
+    LOGW("MappedFile, unable to open [{}]", path);
+    throw std::logic_error("unable to open file for mapping");
+  }
+  try {
+    map(fd.get());
+  } catch (std::logic_error const &) {
+    LOGW("MappedFile, unable to map [{}]", path);
+    throw;
+  }
+}
+
+MappedFile::MappedFile(int const fd) { map(fd); }
+
+auto MappedFile::map(int const fd) -> void {
+  struct stat fileStat = {};
+  if (fstat(fd, &fileStat) != 0) {
+    throw std::logic_error("unable to stat file for mapping");
+  }
+  if (!S_ISREG(fileStat.st_mode)) {
+    throw std::logic_error("unable to map what is not a file");
+  }
+  size_ = static_cast<size_t>(fileStat.st_size);
+  if (size_ == 0) {
+    return;
+  }
+  address_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (address_ == MAP_FAILED) {
+    address_ = nullptr;
+    size_ = 0;
+    throw std::logic_error("unable to map file");
+  }
+  fd_ = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+}
+
+MappedFile::~MappedFile() {
+  if (address_ != nullptr) {
+    munmap(address_, size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+auto MappedFile::bytes() const -> std::span<std::byte const> { return {static_cast<std::byte const *>(address_), size_}; }
+
+auto MappedFile::size() const -> size_t { return size_; }
+
+auto MappedFile::advise(AccessAdvice const advice, size_t const offset, size_t const length) const -> void {
+  if (address_ == nullptr || offset >= size_) {
+    return;
+  }
+  //
+  // madvise() wants a page aligned start; the end may fall anywhere.
+  //
+  static auto const pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  auto const start = offset / pageSize * pageSize;
+  auto const end = length == 0 ? size_ : std::min(size_, offset + length);
+  if (madvise(static_cast<std::byte *>(address_) + start, end - start, getMemoryAdvice(advice)) != 0) {
+    LOGD("advise, unable to advise mapping");
+  }
+  //
+  // Pages still mapped stay in the page cache, so the file is only told to
+  // drop them once the mapping has let go of them.
+  //
+  if (fd_ >= 0 && advice == AccessAdvice::DontNeed) {
+    adviseDescriptor(fd_, advice, start, end - start);
+  }
+}
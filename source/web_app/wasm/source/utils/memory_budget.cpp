@@ -0,0 +1,82 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "utils/memory_budget.h"
+#include "utils/format.h"
+
+using namespace ai::utils::memory;
+
+MemoryReservation::MemoryReservation(std::shared_ptr<MemoryBudget> budget, metrics::Gauge *const subsystem, uint64_t const bytes)
+    : budget_(std::move(budget)), subsystem_(subsystem), bytes_(bytes) {}
+
+MemoryReservation::MemoryReservation(MemoryReservation &&other) noexcept
+    : budget_(std::move(other.budget_)), subsystem_(other.subsystem_), bytes_(std::exchange(other.bytes_, 0)) {}
+
+auto MemoryReservation::operator=(MemoryReservation &&other) noexcept -> MemoryReservation & {
+  if (this != &other) {
+    if (budget_ != nullptr) {
+      budget_->release(*subsystem_, bytes_);
+    }
+    budget_ = std::move(other.budget_);
+    subsystem_ = other.subsystem_;
+    bytes_ = std::exchange(other.bytes_, 0);
+  }
+  return *this;
+}
+
+MemoryReservation::~MemoryReservation() {
+  if (budget_ != nullptr) {
+    budget_->release(*subsystem_, bytes_);
+  }
+}
+
+auto MemoryBudget::fits(uint64_t const bytes) const -> bool {
+  auto const limit = this->limit();
+  return limit == 0 || (bytes <= limit && liveBytes() <= limit - bytes);
+}
+
+auto MemoryBudget::reserve(char const *const subsystem, uint64_t const bytes) -> MemoryReservation {
+  auto &liveBytes = getSubsystemGauge(subsystem);
+  acquire(subsystem, liveBytes, bytes);
+  return MemoryReservation(shared_from_this(), &liveBytes, bytes);
+}
+
+auto MemoryBudget::acquire(char const *const subsystem, metrics::Gauge &liveBytes, uint64_t const bytes) -> void {
+  auto const limit = this->limit();
+  auto live = live_.load(std::memory_order_relaxed);
+  do {
+    if (limit != 0 && (bytes > limit || live > limit - bytes)) {
+      throw MemoryBudgetExceededException(utils::format::format("memory budget exceeded, {} needs {} bytes with {} of {} in use", subsystem, bytes, live, limit));
+    }
+  } while (!live_.compare_exchange_weak(live, live + bytes, std::memory_order_relaxed));
+  liveBytes.add(static_cast<int64_t>(bytes));
+}
+
+auto MemoryBudget::release(metrics::Gauge &liveBytes, uint64_t const bytes) -> void {
+  live_.fetch_sub(bytes, std::memory_order_relaxed);
+  liveBytes.add(-static_cast<int64_t>(bytes));
+}
+
+auto MemoryBudget::getSubsystemGauge(char const *const subsystem) -> metrics::Gauge & {
+  return metrics::gauge(utils::format::format("memory.{}.live_bytes", subsystem));
+}
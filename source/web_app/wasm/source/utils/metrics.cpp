@@ -0,0 +1,131 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <bit>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "utils/metrics.h"
+
+using namespace ai::utils::metrics;
+
+namespace {
+
+template <typename Metric> using Metrics = std::map<std::string, std::unique_ptr<Metric>, std::less<>>;
+
+struct Registry {
+
+  std::mutex mutex;
+
+  Metrics<Counter> counters;
+
+  Metrics<Gauge> gauges;
+
+  Metrics<Histogram> histograms;
+};
+
+auto registry() -> Registry & {
+  static auto instance = Registry();
+  return instance;
+}
+
+template <typename Metric> auto getOrAdd(Metrics<Metric> &metrics, std::string_view const name) -> Metric & {
+  auto const lock = std::lock_guard(registry().mutex);
+  auto metric = metrics.find(name);
+  if (metric == metrics.end()) {
+    metric = metrics.emplace(std::string(name), std::make_unique<Metric>()).first;
+  }
+  return *metric->second;
+}
+
+} // namespace
+
+auto Histogram::record(uint64_t const value) -> void {
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  buckets_[std::bit_width(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+auto Histogram::quantile(double const fraction) const -> uint64_t {
+  auto const total = count();
+  if (total == 0) {
+    return 0;
+  }
+  auto const rank = static_cast<uint64_t>(fraction * static_cast<double>(total - 1));
+  auto seen = uint64_t{0};
+  for (size_t i{0}; i < BUCKET_COUNT; i++) {
+    seen += bucket(i);
+    if (seen > rank) {
+      return i == 0 ? 0 : (i == 64 ? UINT64_MAX : (uint64_t{1} << i) - 1);
+    }
+  }
+  return UINT64_MAX;
+}
+
+auto Histogram::reset() -> void {
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+auto ai::utils::metrics::counter(std::string_view const name) -> Counter & { return getOrAdd(registry().counters, name); }
+
+auto ai::utils::metrics::gauge(std::string_view const name) -> Gauge & { return getOrAdd(registry().gauges, name); }
+
+auto ai::utils::metrics::histogram(std::string_view const name) -> Histogram & { return getOrAdd(registry().histograms, name); }
+
+auto ai::utils::metrics::snapshot() -> std::map<std::string, std::string> {
+  auto &metrics = registry();
+  auto const lock = std::lock_guard(metrics.mutex);
+  auto values = std::map<std::string, std::string>();
+  for (auto const &[name, counter] : metrics.counters) {
+    values.emplace(name, std::to_string(counter->value()));
+  }
+  for (auto const &[name, gauge] : metrics.gauges) {
+    values.emplace(name, std::to_string(gauge->value()));
+  }
+  for (auto const &[name, histogram] : metrics.histograms) {
+    values.emplace(name + ".count", std::to_string(histogram->count()));
+    values.emplace(name + ".sum", std::to_string(histogram->sum()));
+    values.emplace(name + ".p50", std::to_string(histogram->quantile(0.5)));
+    values.emplace(name + ".p99", std::to_string(histogram->quantile(0.99)));
+  }
+  return values;
+}
+
+auto ai::utils::metrics::reset() -> void {
+  auto &metrics = registry();
+  auto const lock = std::lock_guard(metrics.mutex);
+  for (auto const &[_, counter] : metrics.counters) {
+    counter->reset();
+  }
+  for (auto const &[_, gauge] : metrics.gauges) {
+    gauge->reset();
+  }
+  for (auto const &[_, histogram] : metrics.histograms) {
+    histogram->reset();
+  }
+}
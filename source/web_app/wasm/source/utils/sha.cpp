@@ -21,38 +21,101 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
+#include <algorithm>
+#include <array>
 #include <botan/hash.h>
-#include <botan/hex.h>
 #include <cstdint>
-#include <fstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "utils/format.h"
 #include "utils/log.h"
 #include "utils/macros.h"
+#include "utils/mapped_file.h"
 #include "utils/sha.h"
 
 using namespace ai;
 
 namespace {
 
-static constexpr size_t FILE_READ_BUFFER_SIZE = 16 * 1024;
+//
+// Small enough for a block to stay in L2 while every hash goes over it.
+//
+static constexpr size_t FILE_HASH_BLOCK_SIZE = 256 * 1024;
 
 } // namespace
 
-auto utils::sha::generateSha256ForFile(std::string const &path) -> std::string {
-  std::ifstream file(path, std::ios::in | std::ios::binary);
-  if (!file.good()) {
-    LOGW("failed to open input file [{}]", path);
-    return std::string();
+utils::sha::Sha256::Sha256() : hash_(Botan::HashFunction::create_or_throw("SHA-256")) {}
+
+utils::sha::Sha256::~Sha256() = default;
+
+auto utils::sha::Sha256::update(std::span<std::byte const> const bytes) -> Sha256 & {
+  hash_->update(reinterpret_cast<uint8_t const *>(bytes.data()), bytes.size());
+  return *this;
+}
+
+auto utils::sha::Sha256::finish() -> Sha256Digest {
+  auto digest = Sha256Digest();
+  hash_->final(reinterpret_cast<uint8_t *>(digest.data()));
+  return digest;
+}
+
+utils::sha::Sha512::Sha512() : hash_(Botan::HashFunction::create_or_throw("SHA-512")) {}
+
+utils::sha::Sha512::~Sha512() = default;
+
+auto utils::sha::Sha512::update(std::span<std::byte const> const bytes) -> Sha512 & {
+  hash_->update(reinterpret_cast<uint8_t const *>(bytes.data()), bytes.size());
+  return *this;
+}
+
+auto utils::sha::Sha512::finish() -> Sha512Digest {
+  auto digest = Sha512Digest();
+  hash_->final(reinterpret_cast<uint8_t *>(digest.data()));
+  return digest;
+}
+
+auto utils::sha::computeDigest(std::string_view const hashName, std::span<std::byte const> const bytes) -> std::vector<std::byte> {
+  auto const hash = Botan::HashFunction::create_or_throw(std::string(hashName));
+  hash->update(reinterpret_cast<uint8_t const *>(bytes.data()), bytes.size());
+  auto digest = std::vector<std::byte>(hash->output_length());
+  hash->final(reinterpret_cast<uint8_t *>(digest.data()));
+  return digest;
+}
+
+auto utils::sha::computeFileDigests(std::string const &path, std::span<std::string_view const> const hashNames) -> std::vector<std::vector<std::byte>> {
+  auto hashes = std::vector<std::unique_ptr<Botan::HashFunction>>();
+  hashes.reserve(hashNames.size());
+  for (auto const hashName : hashNames) {
+    hashes.push_back(Botan::HashFunction::create_or_throw(std::string(hashName)));
+  }
+
+  auto const file = MappedFile(path);
+  auto const bytes = file.bytes();
+  for (size_t offset = 0; offset < bytes.size(); offset += FILE_HASH_BLOCK_SIZE) {
+    auto const block = bytes.subspan(offset, std::min(FILE_HASH_BLOCK_SIZE, bytes.size() - offset));
+    for (auto const &hash : hashes) {
+      hash->update(reinterpret_cast<uint8_t const *>(block.data()), block.size());
+    }
   }
 
-  std::vector<uint8_t> buffer(FILE_READ_BUFFER_SIZE);
-  std::unique_ptr<Botan::HashFunction> hash(Botan::HashFunction::create("SHA-256"));
-  while (file.good()) {
-    file.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
-    hash->update(buffer.data(), file.gcount());
+  auto digests = std::vector<std::vector<std::byte>>();
+  digests.reserve(hashes.size());
+  for (auto const &hash : hashes) {
+    auto &digest = digests.emplace_back(hash->output_length());
+    hash->final(reinterpret_cast<uint8_t *>(digest.data()));
   }
+  return digests;
+}
 
-  return Botan::hex_encode(hash->final());
-}
\ No newline at end of file
+auto utils::sha::generateSha256ForFile(std::string const &path) -> std::string {
+  static constexpr auto HASH_NAMES = std::array<std::string_view, 1>{"SHA-256"};
+  try {
+    auto const digests = computeFileDigests(path, HASH_NAMES);
+    return format::toHex(digests[0]);
+  } catch (std::logic_error const &) {
+    LOGW("failed to open input file [{}]", path);
+    return std::string();
+  }
+}
@@ -0,0 +1,164 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <botan/auto_rng.h>
+#include <botan/data_src.h>
+#include <botan/pkcs8.h>
+#include <botan/pubkey.h>
+#include <botan/x509_key.h>
+#include <botan/x509cert.h>
+#include <cstdint>
+#include <stdexcept>
+
+#include "utils/format.h"
+#include "utils/log.h"
+#include "utils/signature.h"
+
+using namespace ai::utils::signature;
+
+namespace {
+
+auto toBytes(std::vector<uint8_t> const &bytes) -> std::vector<std::byte> {
+  auto const data = reinterpret_cast<std::byte const *>(bytes.data());
+  return std::vector<std::byte>(data, data + bytes.size());
+}
+
+auto getAlgorithm(Botan::Private_Key const &key) -> SignatureAlgorithm {
+  auto const name = key.algo_name();
+  if (name == "RSA") {
+    return key.key_length() > 3072 ? SignatureAlgorithm::RsaPkcs1Sha512 : SignatureAlgorithm::RsaPkcs1Sha256;
+  }
+  if (name == "ECDSA") {
+    return key.key_length() > 256 ? SignatureAlgorithm::EcdsaSha512 : SignatureAlgorithm::EcdsaSha256;
+  }
+  throw std::logic_error("unsupported signing key algorithm");
+}
+
+auto isRsa(SignatureAlgorithm const algorithm) -> bool {
+  return algorithm == SignatureAlgorithm::RsaPkcs1Sha256 || algorithm == SignatureAlgorithm::RsaPkcs1Sha512 || algorithm == SignatureAlgorithm::RsaPkcs1Sha1;
+}
+
+auto getPadding(SignatureAlgorithm const algorithm) -> char const * {
+  switch (algorithm) {
+  case SignatureAlgorithm::RsaPkcs1Sha256: {
+    return "PKCS1v15(SHA-256)";
+  }
+  case SignatureAlgorithm::EcdsaSha256: {
+    return "SHA-256";
+  }
+  case SignatureAlgorithm::RsaPkcs1Sha512: {
+    return "PKCS1v15(SHA-512)";
+  }
+  case SignatureAlgorithm::EcdsaSha512: {
+    return "SHA-512";
+  }
+  case SignatureAlgorithm::RsaPkcs1Sha1: {
+    return "PKCS1v15(SHA-1)";
+  }
+  case SignatureAlgorithm::EcdsaSha1: {
+    return "SHA-1";
+  }
+  }
+  throw std::logic_error("unsupported signature algorithm");
+}
+
+auto getFormat(SignatureAlgorithm const algorithm) -> Botan::Signature_Format {
+  return isRsa(algorithm) ? Botan::Signature_Format::Standard : Botan::Signature_Format::DerSequence;
+}
+
+} // namespace
+
+struct SigningKey::Key {
+
+  std::unique_ptr<Botan::Private_Key> privateKey;
+
+  SignatureAlgorithm algorithm;
+
+  std::vector<std::byte> certificate;
+
+  std::vector<std::byte> publicKey;
+};
+
+SigningKey::SigningKey(std::span<std::byte const> const privateKey, std::span<std::byte const> const certificate)
+    : key_([&privateKey, &certificate] {
+        auto key = std::make_unique<Key>();
+        auto privateKeySource = Botan::DataSource_Memory(reinterpret_cast<uint8_t const *>(privateKey.data()), privateKey.size());
+        key->privateKey = Botan::PKCS8::load_key(privateKeySource);
+        key->algorithm = getAlgorithm(*key->privateKey);
+
+        auto certificateSource = Botan::DataSource_Memory(reinterpret_cast<uint8_t const *>(certificate.data()), certificate.size());
+        auto const x509Certificate = Botan::X509_Certificate(certificateSource);
+        key->certificate = toBytes(x509Certificate.BER_encode());
+        key->publicKey = toBytes(key->privateKey->subject_public_key());
+        if (toBytes(x509Certificate.subject_public_key_info()) != key->publicKey) {
+          throw std::logic_error("certificate does not match signing key");
+        }
+        LOGD("SigningKey, algorithm [{}]", key->privateKey->algo_name());
+        return key;
+      }()) {}
+
+SigningKey::~SigningKey() = default;
+
+auto SigningKey::algorithm() const -> SignatureAlgorithm { return key_->algorithm; }
+
+auto SigningKey::certificate() const -> std::vector<std::byte> const & { return key_->certificate; }
+
+auto SigningKey::publicKey() const -> std::vector<std::byte> const & { return key_->publicKey; }
+
+auto SigningKey::sign(std::span<std::byte const> const data) const -> std::vector<std::byte> {
+  auto rng = Botan::AutoSeeded_RNG();
+  auto signer = Botan::PK_Signer(*key_->privateKey, rng, getPadding(key_->algorithm), getFormat(key_->algorithm));
+  return toBytes(signer.sign_message(reinterpret_cast<uint8_t const *>(data.data()), data.size(), rng));
+}
+
+auto ai::utils::signature::readCertificate(std::span<std::byte const> const certificate) -> CertificateInfo {
+  auto source = Botan::DataSource_Memory(reinterpret_cast<uint8_t const *>(certificate.data()), certificate.size());
+  auto const x509Certificate = Botan::X509_Certificate(source);
+  auto info = CertificateInfo();
+  info.subject = x509Certificate.subject_dn().to_string();
+  info.issuer = x509Certificate.issuer_dn().to_string();
+  info.serialNumber = ai::utils::format::toHex(std::as_bytes(std::span(x509Certificate.serial_number())));
+  info.notBefore = x509Certificate.not_before().readable_string();
+  info.notAfter = x509Certificate.not_after().readable_string();
+  info.sha256Fingerprint = x509Certificate.fingerprint("SHA-256");
+  info.keyAlgorithm = x509Certificate.subject_public_key()->algo_name();
+  info.publicKey = toBytes(x509Certificate.subject_public_key_info());
+  return info;
+}
+
+auto ai::utils::signature::verify(SignatureAlgorithm const algorithm, std::span<std::byte const> const publicKey, std::span<std::byte const> const data,
+                                  std::span<std::byte const> const signature) -> bool {
+  try {
+    auto const key = Botan::X509::load_key(std::vector<uint8_t>(reinterpret_cast<uint8_t const *>(publicKey.data()),
+                                                                 reinterpret_cast<uint8_t const *>(publicKey.data()) + publicKey.size()));
+    if (key->algo_name() != (isRsa(algorithm) ? "RSA" : "ECDSA")) {
+      return false;
+    }
+    auto verifier = Botan::PK_Verifier(*key, getPadding(algorithm), getFormat(algorithm));
+    return verifier.verify_message(reinterpret_cast<uint8_t const *>(data.data()), data.size(), reinterpret_cast<uint8_t const *>(signature.data()),
+                                   signature.size());
+  } catch (std::exception const &e) {
+    LOGD("verify, rejected [{}]", e.what());
+    return false;
+  }
+}
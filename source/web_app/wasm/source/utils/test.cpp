@@ -0,0 +1,262 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+#include "utils/adler32.h"
+#include "utils/unicode.h"
+#include "utils/xml_escape.h"
+
+namespace {
+
+auto getRandomBytes(size_t const size, uint32_t const seed) -> std::vector<std::byte> {
+  auto generator = std::mt19937(seed);
+  auto bytes = std::vector<std::byte>(size);
+  for (auto &byte : bytes) {
+    byte = static_cast<std::byte>(generator());
+  }
+  return bytes;
+}
+
+auto zlibAdler32(uint32_t const adler, std::span<std::byte const> const bytes) -> uint32_t {
+  return static_cast<uint32_t>(::adler32(adler, reinterpret_cast<Bytef const *>(bytes.data()), static_cast<uInt>(bytes.size())));
+}
+
+//
+// Scalar UTF-8 encoding of UTF-16 text, one code point at a time, with
+// unpaired surrogates as U+FFFD.
+//
+auto encodeUtf8(std::u16string_view const utf16) -> std::string {
+  auto utf8 = std::string();
+  for (size_t i{0}; i < utf16.size(); i++) {
+    auto codePoint = uint32_t{utf16[i]};
+    if (codePoint >= 0xd800 && codePoint < 0xdc00 && i + 1 < utf16.size() && utf16[i + 1] >= 0xdc00 && utf16[i + 1] < 0xe000) {
+      codePoint = 0x10000 + ((codePoint - 0xd800) << 10U) + (utf16[++i] - 0xdc00);
+    } else if (codePoint >= 0xd800 && codePoint < 0xe000) {
+      codePoint = 0xfffd;
+    }
+    if (codePoint < 0x80) {
+      utf8 += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+      utf8 += static_cast<char>(0xc0 | codePoint >> 6U);
+      utf8 += static_cast<char>(0x80 | (codePoint & 0x3fU));
+    } else if (codePoint < 0x10000) {
+      utf8 += static_cast<char>(0xe0 | codePoint >> 12U);
+      utf8 += static_cast<char>(0x80 | (codePoint >> 6U & 0x3fU));
+      utf8 += static_cast<char>(0x80 | (codePoint & 0x3fU));
+    } else {
+      utf8 += static_cast<char>(0xf0 | codePoint >> 18U);
+      utf8 += static_cast<char>(0x80 | (codePoint >> 12U & 0x3fU));
+      utf8 += static_cast<char>(0x80 | (codePoint >> 6U & 0x3fU));
+      utf8 += static_cast<char>(0x80 | (codePoint & 0x3fU));
+    }
+  }
+  return utf8;
+}
+
+//
+// Text of mostly ASCII runs, of lengths around the 16 and 32 units the
+// vector paths take at once, broken by other characters, pairs and lone
+// surrogates.
+//
+auto getRandomUtf16(size_t const size, uint32_t const seed) -> std::u16string {
+  auto generator = std::mt19937(seed);
+  auto utf16 = std::u16string();
+  while (utf16.size() < size) {
+    switch (generator() % 6) {
+    case 0:
+      utf16 += static_cast<char16_t>(0x80 + generator() % 0x780);
+      break;
+    case 1:
+      utf16 += static_cast<char16_t>(0x800 + generator() % 0xd000);
+      break;
+    case 2:
+      utf16 += static_cast<char16_t>(0xd800 + generator() % 0x400);
+      utf16 += static_cast<char16_t>(0xdc00 + generator() % 0x400);
+      break;
+    case 3:
+      utf16 += static_cast<char16_t>(0xd800 + generator() % 0x800);
+      break;
+    default:
+      for (auto run = generator() % 70; run > 0; run--) {
+        utf16 += static_cast<char16_t>(generator() % 0x80);
+      }
+    }
+  }
+  return utf16;
+}
+
+//
+// Scalar XML escaping, one character at a time.
+//
+auto escapeXml(std::string_view const text) -> std::string {
+  auto escaped = std::string();
+  for (auto const c : text) {
+    switch (c) {
+    case '&':
+      escaped += "&amp;";
+      break;
+    case '<':
+      escaped += "&lt;";
+      break;
+    case '>':
+      escaped += "&gt;";
+      break;
+    case '"':
+      escaped += "&quot;";
+      break;
+    default:
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+} // namespace
+
+TEST(Unicode, toUtf8OfRandomText_SameAsScalarEncoding) {
+  for (auto seed = uint32_t{0}; seed < 50; seed++) {
+    auto const utf16 = getRandomUtf16(seed * 37, seed);
+    auto const expected = encodeUtf8(utf16);
+    EXPECT_EQ(ai::utils::unicode::toUtf8(utf16), expected) << seed;
+
+    //
+    // The same units, little endian and at an odd address.
+    //
+    auto bytes = std::vector<std::byte>(1);
+    for (auto const unit : utf16) {
+      bytes.push_back(static_cast<std::byte>(unit & 0xffU));
+      bytes.push_back(static_cast<std::byte>(unit >> 8U));
+    }
+    EXPECT_EQ(ai::utils::unicode::toUtf8(std::span<std::byte const>(bytes).subspan(1)), expected) << seed;
+  }
+}
+
+TEST(Unicode, appendUtf8AtEveryLengthOfAsciiRun_SameAsScalarEncoding) {
+  for (size_t length{0}; length <= 70; length++) {
+    for (auto const tail : {u"", u"\u00e9", u"\xd83d\xde00", u"\xdc00x"}) {
+      auto const utf16 = std::u16string(length, u'a') + tail;
+      auto output = std::string("prefix");
+      ai::utils::unicode::appendUtf8(utf16, output);
+      EXPECT_EQ(output, "prefix" + encodeUtf8(utf16)) << length;
+    }
+  }
+}
+
+TEST(Unicode, toUtf16OfUtf8_RoundTripsValidText) {
+  auto utf16 = getRandomUtf16(5000, 7);
+  std::replace_if(utf16.begin(), utf16.end(), [](char16_t const unit) { return unit >= 0xd800 && unit < 0xe000; }, u'?');
+  EXPECT_EQ(ai::utils::unicode::toUtf16(ai::utils::unicode::toUtf8(utf16)), utf16);
+  EXPECT_EQ(ai::utils::unicode::toUtf16("a\xff"), u"a\ufffd");
+}
+
+TEST(Unicode, mutf8_NulAndSupplementaryCharactersAreDecoded) {
+  auto const mutf8 = std::string("a\xc0\x80\xed\xa0\xbd\xed\xb8\x80") + std::string(40, 'b');
+  EXPECT_EQ(ai::utils::unicode::getMutf8Utf16Length(mutf8), 4U + 40U);
+  EXPECT_EQ(ai::utils::unicode::mutf8ToUtf8(mutf8), std::string("a\0\xf0\x9f\x98\x80", 6) + std::string(40, 'b'));
+  EXPECT_EQ(ai::utils::unicode::mutf8ToUtf16(mutf8), std::u16string(u"a\0\xd83d\xde00", 4) + std::u16string(40, u'b'));
+  EXPECT_EQ(ai::utils::unicode::getMutf8Utf16Length(std::string("a\0", 2)), std::nullopt);
+  EXPECT_EQ(ai::utils::unicode::getMutf8Utf16Length("\xf0\x9f\x98\x80"), std::nullopt);
+}
+
+TEST(Adler32, updateOfSizesAroundBlocksAndReductions_SameAsZlib) {
+  auto const bytes = getRandomBytes(3 * 5552 + 100, 1);
+  auto const ones = std::vector<std::byte>(bytes.size(), std::byte(0xff));
+  for (auto const size : {size_t(0), size_t(1), size_t(15), size_t(16), size_t(31), size_t(32), size_t(33), size_t(5551), size_t(5552),
+                          size_t(5553), size_t(2 * 5552 + 17), bytes.size() - 3}) {
+    for (auto const offset : {size_t(0), size_t(1), size_t(3)}) {
+      EXPECT_EQ(ai::utils::adler32::update(1, std::span(bytes).subspan(offset, size)), zlibAdler32(1, std::span(bytes).subspan(offset, size)))
+          << size << " at " << offset;
+      EXPECT_EQ(ai::utils::adler32::update(1, std::span(ones).subspan(offset, size)), zlibAdler32(1, std::span(ones).subspan(offset, size)))
+          << size << " at " << offset;
+    }
+  }
+}
+
+TEST(Adler32, updateInPieces_SameAsZlibOverTheWhole) {
+  auto const bytes = getRandomBytes(20000, 2);
+  auto adler = uint32_t{1};
+  for (auto offset = size_t(0), size = size_t(1); offset < bytes.size(); offset += size, size = size * 3 + 1) {
+    adler = ai::utils::adler32::update(adler, std::span(bytes).subspan(offset, std::min(size, bytes.size() - offset)));
+  }
+  EXPECT_EQ(adler, zlibAdler32(1, bytes));
+}
+
+TEST(Adler32, replaceBytes_SameAsZlibOverTheReplacedSequence) {
+  auto bytes = getRandomBytes(100000, 3);
+  auto const replacement = getRandomBytes(70000, 4);
+  for (auto const &[offset, size] : {std::pair(size_t(0), size_t(1)), std::pair(size_t(12), size_t(8)), std::pair(size_t(99999), size_t(1)),
+                                    std::pair(size_t(5000), size_t(70000)), std::pair(size_t(100000), size_t(0))}) {
+    auto const adler = zlibAdler32(1, bytes);
+    auto const original = std::vector<std::byte>(bytes.begin() + offset, bytes.begin() + offset + size);
+    std::copy_n(replacement.begin(), size, bytes.begin() + offset);
+    EXPECT_EQ(ai::utils::adler32::replace(adler, bytes.size(), offset, original, std::span(replacement).first(size)), zlibAdler32(1, bytes))
+        << size << " at " << offset;
+  }
+  EXPECT_THROW(ai::utils::adler32::replace(1, 10, 8, getRandomBytes(4, 5), getRandomBytes(4, 6)), std::logic_error);
+}
+
+TEST(XmlEscape, findEscapedAtEveryOffsetOfEveryLength_FindsTheFirstCharacterToReplace) {
+  for (auto const special : std::string_view("&<>\"")) {
+    for (size_t size{1}; size <= 48; size++) {
+      for (size_t offset{0}; offset < size; offset++) {
+        auto text = std::string(size, 'a');
+        text[offset] = special;
+        if (offset + 1 < size) {
+          text[size - 1] = '<';
+        }
+        EXPECT_EQ(ai::utils::xml::findEscaped(text), offset) << size;
+        EXPECT_EQ(ai::utils::xml::findEscaped(std::string_view(text).substr(0, offset)), offset) << size;
+      }
+    }
+  }
+  EXPECT_EQ(ai::utils::xml::findEscaped(""), 0U);
+}
+
+TEST(XmlEscape, appendEscapedOfRandomText_SameAsScalarEscaping) {
+  auto generator = std::mt19937(7);
+  auto const alphabet = std::string_view("&<>\"'ab \xc3\xa9\x80\xff");
+  for (size_t i{0}; i < 2000; i++) {
+    auto text = std::string(generator() % 100, '\0');
+    auto const density = generator() % 8 + 1;
+    for (auto &c : text) {
+      c = generator() % density == 0 ? alphabet[generator() % alphabet.size()] : static_cast<char>('a' + generator() % 26);
+    }
+    auto const unaligned = std::string_view(text).substr(std::min(i % 3, text.size()));
+    auto output = std::string("prefix");
+    ai::utils::xml::appendEscaped(unaligned, output);
+    EXPECT_EQ(output, "prefix" + escapeXml(unaligned));
+  }
+}
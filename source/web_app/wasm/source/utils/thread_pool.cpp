@@ -0,0 +1,76 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "utils/thread_pool.h"
+
+using namespace ai::utils;
+
+ThreadPool::ThreadPool(size_t const threadCount) {
+  threads_.reserve(threadCount);
+  for (size_t i{0}; i < threadCount; i++) {
+    threads_.emplace_back(&ThreadPool::run, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    auto const lock = std::lock_guard(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+auto ThreadPool::threadCount() const -> size_t { return threads_.size(); }
+
+auto ThreadPool::defaultThreadCount() -> size_t {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  return 0;
+#else
+  auto const hardwareConcurrency = std::thread::hardware_concurrency();
+  return hardwareConcurrency > 0 ? hardwareConcurrency : 1;
+#endif
+}
+
+auto ThreadPool::shared() -> ThreadPool & {
+  static auto threadPool = ThreadPool();
+  return threadPool;
+}
+
+auto ThreadPool::run() -> void {
+  while (true) {
+    auto task = std::function<void()>();
+    {
+      auto lock = std::unique_lock(mutex_);
+      condition_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
@@ -0,0 +1,214 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+#include "utils/json.h"
+#include "utils/log.h"
+#include "utils/trace.h"
+
+#include "spdlog/fmt/fmt.h"
+
+using namespace ai::utils;
+
+namespace {
+
+//
+// Spans a thread keeps before it drops new ones, so that a trace left
+// running cannot take all memory.
+//
+static constexpr size_t MAX_THREAD_SPANS = 1024 * 1024;
+
+struct SpanEvent {
+
+  char const *name;
+
+  double start;
+
+  double duration;
+};
+
+struct ThreadBuffer {
+
+  explicit ThreadBuffer(uint32_t const id) : threadId(id) {}
+
+  uint32_t const threadId;
+
+  //
+  // Only contended while the trace is exported or cleared.
+  //
+  std::mutex mutex;
+
+  std::vector<SpanEvent> events;
+};
+
+//
+// Buffers of every thread that ended a span, kept past the end of the
+// thread so that spans of finished workers are exported too.
+//
+struct Registry {
+
+  std::mutex mutex;
+
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+  std::vector<std::unique_ptr<trace::Accumulator>> accumulators;
+
+  std::chrono::steady_clock::time_point const epoch = std::chrono::steady_clock::now();
+};
+
+auto registry() -> Registry & {
+  static auto instance = Registry();
+  return instance;
+}
+
+auto threadBuffer() -> ThreadBuffer & {
+  thread_local auto const buffer = [] {
+    auto &spanRegistry = registry();
+    auto const lock = std::lock_guard(spanRegistry.mutex);
+    auto newBuffer = std::make_shared<ThreadBuffer>(static_cast<uint32_t>(spanRegistry.buffers.size() + 1));
+    spanRegistry.buffers.push_back(newBuffer);
+    return newBuffer;
+  }();
+  return *buffer;
+}
+
+} // namespace
+
+auto trace::setEnabled(bool const enabled) -> void {
+  registry();
+  detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+auto trace::Span::now() -> double {
+#ifdef __EMSCRIPTEN__
+  return emscripten_get_now() * 1000;
+#else
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - registry().epoch).count();
+#endif
+}
+
+auto trace::Span::end(char const *const name, double const start) -> void {
+  auto const duration = now() - start;
+#ifdef __EMSCRIPTEN__
+  EM_ASM({ performance.measure(UTF8ToString($0), {start : $1 / 1000, duration : $2 / 1000}); }, name, start, duration);
+#endif
+  auto &buffer = threadBuffer();
+  auto const lock = std::lock_guard(buffer.mutex);
+  if (buffer.events.size() < MAX_THREAD_SPANS) {
+    buffer.events.push_back(SpanEvent{name, start, duration});
+  }
+}
+
+auto trace::exportChromeTrace() -> std::string {
+  auto &spanRegistry = registry();
+  auto const registryLock = std::lock_guard(spanRegistry.mutex);
+  auto json = std::string(R"({"traceEvents":[)");
+  auto separator = "";
+  for (auto const &buffer : spanRegistry.buffers) {
+    auto const lock = std::lock_guard(buffer->mutex);
+    for (auto const &event : buffer->events) {
+      json += separator;
+      json += R"({"name":)";
+      utils::json::appendString(event.name, json);
+      json += fmt::format(R"(,"ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})", buffer->threadId, event.start, event.duration);
+      separator = ",";
+    }
+  }
+  json += "]}";
+  return json;
+}
+
+auto trace::Accumulator::reset() -> void {
+  count_.store(0, std::memory_order_relaxed);
+  nanoseconds_.store(0, std::memory_order_relaxed);
+}
+
+auto trace::accumulator(char const *const name) -> Accumulator & {
+  auto &spanRegistry = registry();
+  auto const registryLock = std::lock_guard(spanRegistry.mutex);
+  for (auto const &accumulator : spanRegistry.accumulators) {
+    if (std::strcmp(accumulator->name(), name) == 0) {
+      return *accumulator;
+    }
+  }
+  return *spanRegistry.accumulators.emplace_back(std::make_unique<Accumulator>(name));
+}
+
+auto trace::summarize() -> std::vector<SpanSummary> {
+  auto &spanRegistry = registry();
+  auto const registryLock = std::lock_guard(spanRegistry.mutex);
+  auto summaries = std::map<std::string, SpanSummary, std::less<>>();
+  auto const getSummary = [&summaries](char const *const name) -> SpanSummary & {
+    auto summary = summaries.find(std::string_view(name));
+    if (summary == summaries.end()) {
+      summary = summaries.emplace(name, SpanSummary{name}).first;
+    }
+    return summary->second;
+  };
+  for (auto const &buffer : spanRegistry.buffers) {
+    auto const lock = std::lock_guard(buffer->mutex);
+    for (auto const &event : buffer->events) {
+      auto &summary = getSummary(event.name);
+      summary.count++;
+      summary.totalMicroseconds += event.duration;
+      summary.maxMicroseconds = std::max(summary.maxMicroseconds, event.duration);
+    }
+  }
+  for (auto const &accumulator : spanRegistry.accumulators) {
+    if (accumulator->count() > 0) {
+      auto &summary = getSummary(accumulator->name());
+      summary.count += accumulator->count();
+      summary.totalMicroseconds += accumulator->microseconds();
+    }
+  }
+  auto result = std::vector<SpanSummary>();
+  for (auto &[_, summary] : summaries) {
+    result.push_back(std::move(summary));
+  }
+  std::sort(result.begin(), result.end(), [](auto const &left, auto const &right) { return left.totalMicroseconds > right.totalMicroseconds; });
+  return result;
+}
+
+auto trace::clear() -> void {
+  auto &spanRegistry = registry();
+  auto const registryLock = std::lock_guard(spanRegistry.mutex);
+  for (auto const &buffer : spanRegistry.buffers) {
+    auto const lock = std::lock_guard(buffer->mutex);
+    buffer->events.clear();
+  }
+  for (auto const &accumulator : spanRegistry.accumulators) {
+    accumulator->reset();
+  }
+}
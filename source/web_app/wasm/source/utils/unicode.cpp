@@ -0,0 +1,423 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define AI_UNICODE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AI_UNICODE_NEON
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define AI_UNICODE_SIMD128
+#endif
+
+#include "utils/unicode.h"
+
+namespace {
+
+static constexpr char32_t REPLACEMENT_CHARACTER = 0xfffd;
+
+//
+// Code units are read with memcpy, so they need not be aligned.
+//
+inline auto loadUnit(uint8_t const *const units, size_t const index) -> char16_t {
+  char16_t unit;
+  memcpy(&unit, units + index * sizeof(char16_t), sizeof(unit));
+  return unit;
+}
+
+//
+// Index of the first block of bytes, from index, that is not all in
+// 0x01-0x7f.  Runs of ASCII are passed over 32 or 16 bytes at a time, so
+// the index returned is only where the scalar loops need to look next; NUL
+// stops the run as MUTF-8 never has it raw.
+//
+#if defined(AI_UNICODE_SSE2)
+
+__attribute__((target("avx2"))) auto skipAsciiAvx2(uint8_t const *const bytes, size_t index, size_t const count) -> size_t {
+  auto const zero = _mm256_setzero_si256();
+  for (; index + 32 <= count; index += 32) {
+    auto const block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(bytes + index));
+    if (_mm256_movemask_epi8(_mm256_or_si256(block, _mm256_cmpeq_epi8(block, zero))) != 0) {
+      break;
+    }
+  }
+  return index;
+}
+
+auto skipAscii(uint8_t const *const bytes, size_t index, size_t const count) -> size_t {
+  static auto const avx2 = __builtin_cpu_supports("avx2");
+  if (avx2) {
+    index = skipAsciiAvx2(bytes, index, count);
+  }
+  auto const zero = _mm_setzero_si128();
+  for (; index + 16 <= count; index += 16) {
+    auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes + index));
+    if (_mm_movemask_epi8(_mm_or_si128(block, _mm_cmpeq_epi8(block, zero))) != 0) {
+      break;
+    }
+  }
+  return index;
+}
+
+#elif defined(AI_UNICODE_NEON)
+
+auto skipAscii(uint8_t const *const bytes, size_t index, size_t const count) -> size_t {
+  for (; index + 16 <= count; index += 16) {
+    auto const block = vld1q_u8(bytes + index);
+    if (vmaxvq_u8(block) >= 0x80 || vminvq_u8(block) == 0) {
+      break;
+    }
+  }
+  return index;
+}
+
+#elif defined(AI_UNICODE_SIMD128)
+
+auto skipAscii(uint8_t const *const bytes, size_t index, size_t const count) -> size_t {
+  auto const zero = wasm_i8x16_splat(0);
+  for (; index + 16 <= count; index += 16) {
+    auto const block = wasm_v128_load(bytes + index);
+    if (wasm_i8x16_bitmask(wasm_v128_or(block, wasm_i8x16_eq(block, zero))) != 0) {
+      break;
+    }
+  }
+  return index;
+}
+
+#else
+
+auto skipAscii(uint8_t const *const, size_t const index, size_t const) -> size_t { return index; }
+
+#endif
+
+//
+// Reads one UTF-16 code unit of MUTF-8: one to three bytes, with U+0000 as
+// C0 80 and supplementary characters as two encoded surrogates.  Returns
+// -1 and skips the lead byte for anything else.
+//
+auto readMutf8Unit(uint8_t const *const bytes, size_t &index, size_t const count) -> int32_t {
+  auto const lead = bytes[index++];
+  if (lead >= 0x01 && lead < 0x80) {
+    return lead;
+  }
+  auto const continuation = [bytes, count](size_t const at) { return at < count && (bytes[at] & 0xc0) == 0x80; };
+  if ((lead >> 5) == 0x6 && continuation(index)) {
+    auto const unit = static_cast<int32_t>((lead & 0x1f) << 6 | (bytes[index] & 0x3f));
+    if (unit >= 0x80 || unit == 0) {
+      index++;
+      return unit;
+    }
+  } else if ((lead >> 4) == 0xe && continuation(index) && continuation(index + 1)) {
+    auto const unit = static_cast<int32_t>((lead & 0x0f) << 12 | (bytes[index] & 0x3f) << 6 | (bytes[index + 1] & 0x3f));
+    if (unit >= 0x800) {
+      index += 2;
+      return unit;
+    }
+  }
+  return -1;
+}
+
+auto isHighSurrogate(int32_t const unit) -> bool { return unit >= 0xd800 && unit <= 0xdbff; }
+
+auto isLowSurrogate(int32_t const unit) -> bool { return unit >= 0xdc00 && unit <= 0xdfff; }
+
+auto appendCodePoint(char32_t const codePoint, std::string &output) -> void {
+  if (codePoint < 0x80) {
+    output += static_cast<char>(codePoint);
+  } else if (codePoint < 0x800) {
+    output += static_cast<char>(0xc0 | (codePoint >> 6));
+    output += static_cast<char>(0x80 | (codePoint & 0x3f));
+  } else if (codePoint < 0x10000) {
+    output += static_cast<char>(0xe0 | (codePoint >> 12));
+    output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+    output += static_cast<char>(0x80 | (codePoint & 0x3f));
+  } else {
+    output += static_cast<char>(0xf0 | (codePoint >> 18));
+    output += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+    output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+    output += static_cast<char>(0x80 | (codePoint & 0x3f));
+  }
+}
+
+//
+// Encodes code units starting at index until the next ASCII unit, so the
+// vector loop can pick up again; returns the index it stopped at.  dest
+// must have room for three bytes per unit.
+//
+auto encodeScalar(uint8_t const *const units, size_t index, size_t const count, char *&dest) -> size_t {
+  while (index < count) {
+    auto codePoint = static_cast<char32_t>(loadUnit(units, index++));
+    if (codePoint < 0x80) {
+      *dest++ = static_cast<char>(codePoint);
+      return index;
+    }
+    if (codePoint >= 0xd800 && codePoint <= 0xdfff) {
+      auto const low = index < count ? static_cast<char32_t>(loadUnit(units, index)) : 0;
+      if (codePoint <= 0xdbff && low >= 0xdc00 && low <= 0xdfff) {
+        codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+        index++;
+      } else {
+        codePoint = REPLACEMENT_CHARACTER;
+      }
+    }
+    if (codePoint < 0x800) {
+      *dest++ = static_cast<char>(0xc0 | (codePoint >> 6));
+      *dest++ = static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+      *dest++ = static_cast<char>(0xe0 | (codePoint >> 12));
+      *dest++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+      *dest++ = static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else {
+      *dest++ = static_cast<char>(0xf0 | (codePoint >> 18));
+      *dest++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+      *dest++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+      *dest++ = static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+  }
+  return index;
+}
+
+#if defined(AI_UNICODE_SSE2)
+
+//
+// Narrows 32 units at a time while they are all ASCII.
+//
+__attribute__((target("avx2"))) auto narrowAsciiAvx2(uint8_t const *const units, size_t index, size_t const count, char *&dest) -> size_t {
+  auto const nonAscii = _mm256_set1_epi16(static_cast<short>(0xff80));
+  for (; index + 32 <= count; index += 32) {
+    auto const first = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(units + index * sizeof(char16_t)));
+    auto const second = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(units + (index + 16) * sizeof(char16_t)));
+    if (!_mm256_testz_si256(_mm256_or_si256(first, second), nonAscii)) {
+      break;
+    }
+    auto const narrowed = _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), 0xd8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest), narrowed);
+    dest += 32;
+  }
+  return index;
+}
+
+auto narrowAsciiSse2(uint8_t const *const units, size_t index, size_t const count, char *&dest) -> size_t {
+  auto const nonAscii = _mm_set1_epi16(static_cast<short>(0xff80));
+  for (; index + 16 <= count; index += 16) {
+    auto const first = _mm_loadu_si128(reinterpret_cast<__m128i const *>(units + index * sizeof(char16_t)));
+    auto const second = _mm_loadu_si128(reinterpret_cast<__m128i const *>(units + (index + 8) * sizeof(char16_t)));
+    auto const masked = _mm_and_si128(_mm_or_si128(first, second), nonAscii);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(masked, _mm_setzero_si128())) != 0xffff) {
+      break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm_packus_epi16(first, second));
+    dest += 16;
+  }
+  return index;
+}
+
+auto narrowAscii(uint8_t const *const units, size_t index, size_t const count, char *&dest) -> size_t {
+  static auto const avx2 = __builtin_cpu_supports("avx2");
+  if (avx2) {
+    index = narrowAsciiAvx2(units, index, count, dest);
+  }
+  return narrowAsciiSse2(units, index, count, dest);
+}
+
+#elif defined(AI_UNICODE_NEON)
+
+auto narrowAscii(uint8_t const *const units, size_t index, size_t const count, char *&dest) -> size_t {
+  for (; index + 16 <= count; index += 16) {
+    auto const first = vld1q_u16(reinterpret_cast<uint16_t const *>(units + index * sizeof(char16_t)));
+    auto const second = vld1q_u16(reinterpret_cast<uint16_t const *>(units + (index + 8) * sizeof(char16_t)));
+    if (vmaxvq_u16(vorrq_u16(first, second)) >= 0x80) {
+      break;
+    }
+    vst1q_u8(reinterpret_cast<uint8_t *>(dest), vcombine_u8(vmovn_u16(first), vmovn_u16(second)));
+    dest += 16;
+  }
+  return index;
+}
+
+#elif defined(AI_UNICODE_SIMD128)
+
+auto narrowAscii(uint8_t const *const units, size_t index, size_t const count, char *&dest) -> size_t {
+  auto const nonAscii = wasm_i16x8_splat(static_cast<int16_t>(0xff80));
+  for (; index + 16 <= count; index += 16) {
+    auto const first = wasm_v128_load(units + index * sizeof(char16_t));
+    auto const second = wasm_v128_load(units + (index + 8) * sizeof(char16_t));
+    if (wasm_v128_any_true(wasm_v128_and(wasm_v128_or(first, second), nonAscii))) {
+      break;
+    }
+    wasm_v128_store(dest, wasm_u8x16_narrow_i16x8(first, second));
+    dest += 16;
+  }
+  return index;
+}
+
+#else
+
+auto narrowAscii(uint8_t const *const, size_t const index, size_t const, char *&) -> size_t { return index; }
+
+#endif
+
+auto transcode(uint8_t const *const units, size_t const count, std::string &output) -> void {
+  auto const offset = output.size();
+  output.resize(offset + count * 3);
+  auto dest = output.data() + offset;
+  for (size_t index = 0; index < count;) {
+    index = narrowAscii(units, index, count, dest);
+    index = encodeScalar(units, index, count, dest);
+  }
+  output.resize(static_cast<size_t>(dest - output.data()));
+}
+
+} // namespace
+
+namespace ai::utils::unicode {
+
+auto appendUtf8(std::u16string_view const utf16, std::string &output) -> void {
+  transcode(reinterpret_cast<uint8_t const *>(utf16.data()), utf16.size(), output);
+}
+
+auto appendUtf8(std::span<std::byte const> const utf16, std::string &output) -> void {
+  transcode(reinterpret_cast<uint8_t const *>(utf16.data()), utf16.size() / sizeof(char16_t), output);
+}
+
+auto toUtf8(std::u16string_view const utf16) -> std::string {
+  auto output = std::string();
+  appendUtf8(utf16, output);
+  return output;
+}
+
+auto toUtf8(std::span<std::byte const> const utf16) -> std::string {
+  auto output = std::string();
+  appendUtf8(utf16, output);
+  return output;
+}
+
+auto toUtf16(std::string_view const utf8) -> std::u16string {
+  auto output = std::u16string();
+  output.reserve(utf8.size());
+  auto const bytes = reinterpret_cast<uint8_t const *>(utf8.data());
+  for (size_t index = 0; index < utf8.size();) {
+    auto const asciiEnd = skipAscii(bytes, index, utf8.size());
+    output.append(utf8.begin() + static_cast<std::ptrdiff_t>(index), utf8.begin() + static_cast<std::ptrdiff_t>(asciiEnd));
+    index = asciiEnd;
+    if (index == utf8.size()) {
+      break;
+    }
+    auto const lead = static_cast<uint8_t>(utf8[index++]);
+    auto const continuations = lead < 0x80 ? 0 : (lead >> 5) == 0x6 ? 1 : (lead >> 4) == 0xe ? 2 : (lead >> 3) == 0x1e ? 3 : -1;
+    if (continuations < 0 || index + static_cast<size_t>(continuations) > utf8.size()) {
+      output.push_back(static_cast<char16_t>(REPLACEMENT_CHARACTER));
+      continue;
+    }
+    auto codePoint = static_cast<char32_t>(continuations == 0 ? lead : lead & (0x3f >> continuations));
+    auto valid = true;
+    for (auto i = 0; i < continuations; i++) {
+      auto const continuation = static_cast<uint8_t>(utf8[index]);
+      if ((continuation & 0xc0) != 0x80) {
+        valid = false;
+        break;
+      }
+      codePoint = (codePoint << 6) | (continuation & 0x3f);
+      index++;
+    }
+    if (!valid || codePoint > 0x10ffff || (codePoint >= 0xd800 && codePoint <= 0xdfff)) {
+      codePoint = REPLACEMENT_CHARACTER;
+    }
+    if (codePoint >= 0x10000) {
+      output.push_back(static_cast<char16_t>(0xd800 + ((codePoint - 0x10000) >> 10)));
+      output.push_back(static_cast<char16_t>(0xdc00 + ((codePoint - 0x10000) & 0x3ff)));
+    } else {
+      output.push_back(static_cast<char16_t>(codePoint));
+    }
+  }
+  return output;
+}
+
+auto getMutf8Utf16Length(std::string_view const mutf8) -> std::optional<size_t> {
+  auto const bytes = reinterpret_cast<uint8_t const *>(mutf8.data());
+  auto length = size_t{0};
+  for (size_t index = 0; index < mutf8.size();) {
+    auto const asciiEnd = skipAscii(bytes, index, mutf8.size());
+    length += asciiEnd - index;
+    index = asciiEnd;
+    if (index < mutf8.size()) {
+      if (readMutf8Unit(bytes, index, mutf8.size()) < 0) {
+        return std::nullopt;
+      }
+      length++;
+    }
+  }
+  return length;
+}
+
+auto appendUtf8FromMutf8(std::string_view const mutf8, std::string &output) -> void {
+  auto const bytes = reinterpret_cast<uint8_t const *>(mutf8.data());
+  output.reserve(output.size() + mutf8.size());
+  for (size_t index = 0; index < mutf8.size();) {
+    auto const asciiEnd = skipAscii(bytes, index, mutf8.size());
+    output.append(mutf8.data() + index, asciiEnd - index);
+    index = asciiEnd;
+    if (index == mutf8.size()) {
+      break;
+    }
+    auto const unit = readMutf8Unit(bytes, index, mutf8.size());
+    if (isHighSurrogate(unit) && index < mutf8.size()) {
+      auto next = index;
+      if (auto const low = readMutf8Unit(bytes, next, mutf8.size()); isLowSurrogate(low)) {
+        appendCodePoint(static_cast<char32_t>(0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00)), output);
+        index = next;
+        continue;
+      }
+    }
+    appendCodePoint(unit < 0 || isHighSurrogate(unit) || isLowSurrogate(unit) ? REPLACEMENT_CHARACTER : static_cast<char32_t>(unit), output);
+  }
+}
+
+auto mutf8ToUtf8(std::string_view const mutf8) -> std::string {
+  auto output = std::string();
+  appendUtf8FromMutf8(mutf8, output);
+  return output;
+}
+
+auto mutf8ToUtf16(std::string_view const mutf8) -> std::u16string {
+  auto const bytes = reinterpret_cast<uint8_t const *>(mutf8.data());
+  auto output = std::u16string();
+  output.reserve(mutf8.size());
+  for (size_t index = 0; index < mutf8.size();) {
+    auto const asciiEnd = skipAscii(bytes, index, mutf8.size());
+    output.append(mutf8.begin() + static_cast<std::ptrdiff_t>(index), mutf8.begin() + static_cast<std::ptrdiff_t>(asciiEnd));
+    index = asciiEnd;
+    if (index < mutf8.size()) {
+      auto const unit = readMutf8Unit(bytes, index, mutf8.size());
+      output.push_back(static_cast<char16_t>(unit < 0 ? REPLACEMENT_CHARACTER : static_cast<char32_t>(unit)));
+    }
+  }
+  return output;
+}
+
+} // namespace ai::utils::unicode
@@ -0,0 +1,136 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define AI_XML_ESCAPE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AI_XML_ESCAPE_NEON
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define AI_XML_ESCAPE_SIMD128
+#endif
+
+#include "utils/xml_escape.h"
+
+namespace {
+
+inline auto isEscaped(char const c) -> bool { return c == '&' || c == '<' || c == '>' || c == '"'; }
+
+inline auto getEntity(char const c) -> std::string_view {
+  switch (c) {
+  case '&':
+    return "&amp;";
+  case '<':
+    return "&lt;";
+  case '>':
+    return "&gt;";
+  default:
+    return "&quot;";
+  }
+}
+
+//
+// Skips blocks of 16 bytes without characters to replace; returns the
+// offset of the block the scalar loop has to look at.
+//
+#if defined(AI_XML_ESCAPE_SSE2)
+
+auto skipPlain(char const *const text, std::size_t offset, std::size_t const size) -> std::size_t {
+  auto const ampersand = _mm_set1_epi8('&');
+  auto const less = _mm_set1_epi8('<');
+  auto const greater = _mm_set1_epi8('>');
+  auto const quote = _mm_set1_epi8('"');
+  for (; offset + 16 <= size; offset += 16) {
+    auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(text + offset));
+    auto const matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, ampersand), _mm_cmpeq_epi8(block, less)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(block, greater), _mm_cmpeq_epi8(block, quote)));
+    if (auto const mask = _mm_movemask_epi8(matches); mask != 0) {
+      return offset + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+    }
+  }
+  return offset;
+}
+
+#elif defined(AI_XML_ESCAPE_NEON)
+
+auto skipPlain(char const *const text, std::size_t offset, std::size_t const size) -> std::size_t {
+  for (; offset + 16 <= size; offset += 16) {
+    auto const block = vld1q_u8(reinterpret_cast<uint8_t const *>(text + offset));
+    auto const matches = vorrq_u8(vorrq_u8(vceqq_u8(block, vdupq_n_u8('&')), vceqq_u8(block, vdupq_n_u8('<'))),
+                                  vorrq_u8(vceqq_u8(block, vdupq_n_u8('>')), vceqq_u8(block, vdupq_n_u8('"'))));
+    if (vmaxvq_u8(matches) != 0) {
+      break;
+    }
+  }
+  return offset;
+}
+
+#elif defined(AI_XML_ESCAPE_SIMD128)
+
+auto skipPlain(char const *const text, std::size_t offset, std::size_t const size) -> std::size_t {
+  for (; offset + 16 <= size; offset += 16) {
+    auto const block = wasm_v128_load(text + offset);
+    auto const matches = wasm_v128_or(wasm_v128_or(wasm_i8x16_eq(block, wasm_i8x16_splat('&')), wasm_i8x16_eq(block, wasm_i8x16_splat('<'))),
+                                      wasm_v128_or(wasm_i8x16_eq(block, wasm_i8x16_splat('>')), wasm_i8x16_eq(block, wasm_i8x16_splat('"'))));
+    if (auto const mask = wasm_i8x16_bitmask(matches); mask != 0) {
+      return offset + static_cast<std::size_t>(__builtin_ctz(mask));
+    }
+  }
+  return offset;
+}
+
+#else
+
+auto skipPlain(char const *const, std::size_t const offset, std::size_t const) -> std::size_t { return offset; }
+
+#endif
+
+} // namespace
+
+namespace ai::utils::xml {
+
+auto findEscaped(std::string_view const text) -> std::size_t {
+  auto offset = skipPlain(text.data(), 0, text.size());
+  while (offset < text.size() && !isEscaped(text[offset])) {
+    offset++;
+  }
+  return offset;
+}
+
+auto appendEscaped(std::string_view text, std::string &output) -> void {
+  while (!text.empty()) {
+    auto const offset = findEscaped(text);
+    output.append(text.data(), offset);
+    if (offset == text.size()) {
+      break;
+    }
+    output.append(getEntity(text[offset]));
+    text.remove_prefix(offset + 1);
+  }
+}
+
+} // namespace ai::utils::xml
@@ -0,0 +1,66 @@
+#
+# Training workload of profile guided builds: runs the instrumented CLI over
+# the synthetic corpus and the test APKs, in batch mode and one APK at a
+# time, so that the zip, binary xml and resource table parsing the profiles
+# are for is what runs hot.  With PROFDATA, the raw clang profiles are then
+# merged into PROFILE_DIRECTORY/default.profdata; GCC reads its own as they
+# are.
+#
+# cmake -DCLI=<wasm> -DAPK_DIRECTORY=<test apks> -DWORK_DIRECTORY=<dir>
+#       -DPROFILE_DIRECTORY=<dir> [-DPROFDATA=<llvm-profdata>] -P PgoTraining.cmake
+#
+
+#
+# The stored-assets shape writes 3 GiB through code it barely exercises.
+#
+set(TRAINING_SHAPES tiny-entries large-manifest string-pool deep-layout)
+
+set(CORPUS_DIRECTORY ${WORK_DIRECTORY}/corpus)
+
+file(REMOVE_RECURSE ${PROFILE_DIRECTORY} ${WORK_DIRECTORY})
+
+file(MAKE_DIRECTORY ${CORPUS_DIRECTORY})
+
+#
+# A run that fails still leaves its profile, only a less complete one.
+#
+function(run_cli)
+  execute_process(COMMAND ${CLI} ${ARGN} OUTPUT_QUIET RESULT_VARIABLE RESULT)
+  if (NOT RESULT EQUAL 0)
+    message(WARNING "training run failed [${RESULT}]: ${ARGN}")
+  endif ()
+endfunction()
+
+set(SHAPE_ARGUMENTS "")
+foreach (SHAPE ${TRAINING_SHAPES})
+  list(APPEND SHAPE_ARGUMENTS --shape ${SHAPE})
+endforeach ()
+
+run_cli(generate-corpus --out ${CORPUS_DIRECTORY} ${SHAPE_ARGUMENTS})
+
+file(GLOB TEST_APKS ${APK_DIRECTORY}/*.apk)
+
+file(COPY ${TEST_APKS} DESTINATION ${CORPUS_DIRECTORY})
+
+run_cli(--dir ${CORPUS_DIRECTORY} --manifest --properties)
+
+file(GLOB TRAINING_APKS ${CORPUS_DIRECTORY}/*.apk)
+
+foreach (TRAINING_APK ${TRAINING_APKS})
+  get_filename_component(NAME ${TRAINING_APK} NAME_WE)
+  run_cli(--file ${TRAINING_APK} --manifest --properties --files)
+  run_cli(extract --file ${TRAINING_APK} --out ${WORK_DIRECTORY}/extract/${NAME} --decode-xml)
+  run_cli(grep --file ${TRAINING_APK} --pattern android --pattern http:// --ignore-case)
+endforeach ()
+
+if (PROFDATA)
+  file(GLOB RAW_PROFILES ${PROFILE_DIRECTORY}/*.profraw)
+  execute_process(COMMAND ${PROFDATA} merge -output=${PROFILE_DIRECTORY}/default.profdata ${RAW_PROFILES} RESULT_VARIABLE RESULT)
+  if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "merging profiles failed [${RESULT}]")
+  endif ()
+endif ()
+
+list(LENGTH TRAINING_APKS TRAINING_APK_COUNT)
+
+message("trained on ${TRAINING_APK_COUNT} apks, profiles in ${PROFILE_DIRECTORY}")
@@ -0,0 +1,28 @@
+#
+# Reports the size of a Wasm module and its loader, raw and gzipped, and
+# appends them to REPORT_FILE as "time,file,bytes,gzip bytes" lines.
+#
+# cmake -DLOADER_FILE=<x.wasm.js> -DREPORT_FILE=<csv> -P SizeReport.cmake
+#
+
+string(REGEX REPLACE "\\.js$" ".wasm" MODULE_FILE ${LOADER_FILE})
+
+string(TIMESTAMP NOW "%Y-%m-%dT%H:%M:%SZ" UTC)
+
+if (NOT EXISTS ${REPORT_FILE})
+  file(WRITE ${REPORT_FILE} "time,file,bytes,gzip bytes\n")
+endif ()
+
+foreach (REPORTED_FILE ${MODULE_FILE} ${LOADER_FILE})
+
+  file(SIZE ${REPORTED_FILE} BYTES)
+
+  execute_process(COMMAND gzip -9 -c ${REPORTED_FILE} COMMAND wc -c OUTPUT_VARIABLE GZIP_BYTES OUTPUT_STRIP_TRAILING_WHITESPACE)
+
+  get_filename_component(NAME ${REPORTED_FILE} NAME)
+
+  message("${NAME}: ${BYTES} bytes, ${GZIP_BYTES} gzipped")
+
+  file(APPEND ${REPORT_FILE} "${NOW},${NAME},${BYTES},${GZIP_BYTES}\n")
+
+endforeach ()
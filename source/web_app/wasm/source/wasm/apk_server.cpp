@@ -0,0 +1,392 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <poll.h>
+#include <stdexcept>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "apk/apk.h"
+#include "apk_server.h"
+#include "json_lines.h"
+#include "utils/cancellation.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/thread_pool.h"
+
+using namespace ai;
+
+namespace {
+
+static constexpr size_t READ_SIZE = 64 * 1024;
+
+//
+// Longest request line; a connection sending a longer one is closed.
+//
+static constexpr size_t MAX_REQUEST_SIZE = 64 * 1024;
+
+//
+// An APK kept open by the server.  Requests for the same APK run on it at
+// once, sharing what it has read and parsed.
+//
+struct ServedApk {
+
+  ServedApk(std::string const &apkPath, std::string const &cacheDirectory) : apk(apkPath, cacheDirectory) {}
+
+  Apk const apk;
+
+  //
+  // Token of the requests received since the last cancel; a cancel sets it
+  // and puts a new one in its place.
+  //
+  auto takeCancellation() -> utils::CancellationToken {
+    auto const lock = std::lock_guard(cancellationMutex);
+    return cancellation;
+  }
+
+  auto cancel() -> void {
+    auto const lock = std::lock_guard(cancellationMutex);
+    cancellation.cancel();
+    cancellation = utils::CancellationToken::create();
+  }
+
+  std::mutex cancellationMutex;
+
+  utils::CancellationToken cancellation = utils::CancellationToken::create();
+
+  uint64_t lastUse = 0;
+};
+
+//
+// A connection of a client.  The requests read from it are answered a batch
+// at a time on a worker of the shared pool; it is not read while a batch is
+// answered, so a client sending faster than it is answered is held back by
+// its socket rather than queued for.
+//
+struct Connection {
+
+  //
+  // The start of a request not received in full.
+  //
+  std::string pending;
+
+  bool isAnswering = false;
+};
+
+class ApkServer final : public std::enable_shared_from_this<ApkServer> {
+public:
+  explicit ApkServer(cli::ApkServerOptions const &options) : options_(options) {}
+
+  ~ApkServer() {
+    ::close(wakeReader_);
+    ::close(wakeWriter_);
+  }
+
+  ApkServer(ApkServer const &) = delete;
+  auto operator=(ApkServer const &) -> ApkServer & = delete;
+
+  //
+  // Accepts connections on the listener and reads their requests on this
+  // thread until the listener fails.
+  //
+  auto serve(int const listener) -> void {
+    auto wake = std::array<int, 2>();
+    if (::pipe(wake.data()) != 0) {
+      LOGW("unable to create pipe, {}", std::strerror(errno));
+      return;
+    }
+    wakeReader_ = wake[0];
+    wakeWriter_ = wake[1];
+    ::fcntl(wakeReader_, F_SETFL, O_NONBLOCK);
+    ::fcntl(wakeWriter_, F_SETFL, O_NONBLOCK);
+
+    auto connections = std::map<int, Connection>();
+    auto buffer = std::vector<char>(READ_SIZE);
+    auto events = std::vector<pollfd>();
+    while (true) {
+      events.clear();
+      events.push_back({wakeReader_, POLLIN, 0});
+      events.push_back({listener, POLLIN, 0});
+      for (auto const &[connection, state] : connections) {
+        if (!state.isAnswering) {
+          events.push_back({connection, POLLIN, 0});
+        }
+      }
+      if (::poll(events.data(), events.size(), -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        LOGW("unable to poll, {}", std::strerror(errno));
+        break;
+      }
+      if (events[0].revents != 0) {
+        while (::read(wakeReader_, buffer.data(), buffer.size()) > 0) {
+        }
+        for (auto const &[connection, isOpen] : takeAnswered()) {
+          if (isOpen) {
+            connections[connection].isAnswering = false;
+          } else {
+            ::close(connection);
+            connections.erase(connection);
+          }
+        }
+      }
+      if (events[1].revents != 0) {
+        auto const connection = ::accept(listener, nullptr, nullptr);
+        if (connection >= 0) {
+          connections.emplace(connection, Connection());
+        } else if (errno != EINTR && errno != ECONNABORTED) {
+          LOGW("unable to accept, {}", std::strerror(errno));
+          break;
+        }
+      }
+      for (auto event = events.begin() + 2; event != events.end(); ++event) {
+        if (event->revents != 0 && !read(event->fd, connections[event->fd], buffer)) {
+          ::close(event->fd);
+          connections.erase(event->fd);
+        }
+      }
+    }
+
+    //
+    // Connections being answered are closed once answered.
+    //
+    auto const lock = std::lock_guard(answeredMutex_);
+    isStopped_ = true;
+    for (auto const &[connection, state] : connections) {
+      if (!state.isAnswering) {
+        ::close(connection);
+      }
+    }
+  }
+
+private:
+  //
+  // Reads what the client sent on the connection and starts answering the
+  // requests received in full, false if the connection is to be closed.
+  //
+  auto read(int const connection, Connection &state, std::vector<char> &buffer) -> bool {
+    auto const bytesRead = ::read(connection, buffer.data(), buffer.size());
+    if (bytesRead < 0 && errno == EINTR) {
+      return true;
+    }
+    if (bytesRead <= 0) {
+      return false;
+    }
+    state.pending.append(buffer.data(), static_cast<size_t>(bytesRead));
+    auto const requestsEnd = state.pending.rfind('\n');
+    auto requests = requestsEnd == std::string::npos ? std::string() : state.pending.substr(0, requestsEnd + 1);
+    state.pending.erase(0, requests.size());
+    if (state.pending.size() > MAX_REQUEST_SIZE) {
+      auto response = std::string();
+      cli::appendApkJsonLine(response, {}, {}, std::nullopt, "request too long");
+      ::send(connection, response.data(), response.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+      return false;
+    }
+    if (!requests.empty()) {
+      state.isAnswering = true;
+      utils::ThreadPool::shared().submit([server = shared_from_this(), connection, requests = std::move(requests)] {
+        auto responses = std::string();
+        auto lineStart = size_t(0);
+        for (auto lineEnd = requests.find('\n'); lineEnd != std::string::npos; lineEnd = requests.find('\n', lineStart)) {
+          server->respond(std::string_view(requests).substr(lineStart, lineEnd - lineStart), responses);
+          lineStart = lineEnd + 1;
+        }
+        server->answered(connection, send(connection, responses));
+      });
+    }
+    return true;
+  }
+
+  //
+  // Hands the connection back to the serving thread once its requests are
+  // answered.
+  //
+  auto answered(int const connection, bool const isOpen) -> void {
+    auto const lock = std::lock_guard(answeredMutex_);
+    if (isStopped_) {
+      ::close(connection);
+      return;
+    }
+    answered_.emplace_back(connection, isOpen);
+    auto const wake = char(0);
+    [[maybe_unused]] auto const bytesWritten = ::write(wakeWriter_, &wake, 1);
+  }
+
+  auto takeAnswered() -> std::vector<std::pair<int, bool>> {
+    auto const lock = std::lock_guard(answeredMutex_);
+    return std::exchange(answered_, {});
+  }
+
+  auto respond(std::string_view const request, std::string &responses) -> void {
+    auto const separator = request.find(' ');
+    auto const command = request.substr(0, separator);
+    auto const apkPath = separator == std::string_view::npos ? std::string() : std::string(request.substr(separator + 1));
+    LOGD("serve, command [{}] apkPath [{}]", command, apkPath);
+    if (command == "stats") {
+      cli::appendApkJsonLine(responses, apkPath, utils::metrics::snapshot(), std::nullopt, {});
+      return;
+    }
+    if (command == "cancel") {
+      if (auto const servedApk = findApk(apkPath)) {
+        servedApk->cancel();
+      }
+      cli::appendApkJsonLine(responses, apkPath, {}, std::nullopt, {});
+      return;
+    }
+    try {
+      auto const fields = command == "manifest" ? ApkPropertyFields::all()
+                                                : ApkPropertyFields{ApkPropertyField::Package, ApkPropertyField::Version, ApkPropertyField::Debuggable,
+                                                                    ApkPropertyField::Sha256};
+      if (command != "properties" && command != "manifest" && command != "files") {
+        throw std::invalid_argument("unknown command");
+      }
+      if (apkPath.empty()) {
+        throw std::invalid_argument("missing path to apk");
+      }
+      auto const servedApk = getApk(apkPath);
+      auto const cancellation = servedApk->takeCancellation();
+      cancellation.throwIfCancelled();
+      if (command == "files") {
+        cli::appendApkJsonLine(responses, apkPath, {}, servedApk->apk.getFiles(), {});
+      } else {
+        //
+        // Hashing goes on in the background for the next request; only the
+        // wait for it is given up.
+        //
+        auto const onProgress = [&cancellation](uint64_t, uint64_t) { cancellation.throwIfCancelled(); };
+        cli::appendApkJsonLine(responses, apkPath, servedApk->apk.getProperties(fields, onProgress), std::nullopt, {});
+      }
+    } catch (std::exception const &exception) {
+      cli::appendApkJsonLine(responses, apkPath, {}, std::nullopt, exception.what());
+    }
+  }
+
+  //
+  // The open APK at the path, opened on first request.  It is opened outside
+  // the lock so requests for open APKs are not held up by it; if two
+  // requests open it at once, the first one in is kept.
+  //
+  auto getApk(std::string const &apkPath) -> std::shared_ptr<ServedApk> {
+    if (auto const servedApk = findApk(apkPath)) {
+      return servedApk;
+    }
+    auto servedApk = std::make_shared<ServedApk>(apkPath, options_.cacheDirectory);
+    auto const lock = std::lock_guard(mutex_);
+    auto const [served, isOpened] = apks_.emplace(apkPath, std::move(servedApk));
+    served->second->lastUse = ++uses_;
+    if (isOpened && apks_.size() > std::max<size_t>(options_.maxOpenApks, 1)) {
+      auto const leastRecentlyUsed =
+          std::min_element(apks_.begin(), apks_.end(), [](auto const &left, auto const &right) { return left.second->lastUse < right.second->lastUse; });
+      apks_.erase(leastRecentlyUsed);
+    }
+    return served->second;
+  }
+
+  //
+  // The open APK at the path, none if it is not open.
+  //
+  auto findApk(std::string const &apkPath) -> std::shared_ptr<ServedApk> {
+    auto const lock = std::lock_guard(mutex_);
+    auto const served = apks_.find(apkPath);
+    if (served == apks_.end()) {
+      return nullptr;
+    }
+    served->second->lastUse = ++uses_;
+    return served->second;
+  }
+
+  static auto send(int const connection, std::string_view bytes) -> bool {
+    while (!bytes.empty()) {
+      auto const bytesSent = ::send(connection, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+      if (bytesSent < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytesSent <= 0) {
+        return false;
+      }
+      bytes.remove_prefix(static_cast<size_t>(bytesSent));
+    }
+    return true;
+  }
+
+  cli::ApkServerOptions const options_;
+
+  std::mutex mutex_;
+
+  std::map<std::string, std::shared_ptr<ServedApk>> apks_;
+
+  uint64_t uses_ = 0;
+
+  std::mutex answeredMutex_;
+
+  //
+  // Connections answered since the serving thread last woke up, and whether
+  // they are still open.
+  //
+  std::vector<std::pair<int, bool>> answered_;
+
+  bool isStopped_ = false;
+
+  int wakeReader_ = -1;
+
+  int wakeWriter_ = -1;
+};
+
+} // namespace
+
+auto ai::cli::serveApks(ApkServerOptions const &options) -> int {
+  auto address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  if (options.socketPath.empty() || options.socketPath.size() >= sizeof(address.sun_path)) {
+    LOGW("invalid socket path [{}]", options.socketPath);
+    return -5;
+  }
+  std::strncpy(address.sun_path, options.socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+  auto const listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::unlink(options.socketPath.c_str());
+  if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr const *>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0) {
+    LOGW("unable to listen on [{}], {}", options.socketPath, std::strerror(errno));
+    return -5;
+  }
+  LOGD("serving on [{}]", options.socketPath);
+
+  std::make_shared<ApkServer>(options)->serve(listener);
+  ::close(listener);
+  return -5;
+}
@@ -0,0 +1,70 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_WASM_APK_SERVER_H_
+#define ANDROID_INTROSPECTION_WASM_APK_SERVER_H_
+
+#include <cstddef>
+#include <string>
+
+namespace ai::cli {
+
+struct ApkServerOptions {
+
+  std::string socketPath;
+
+  //
+  // Analysis cache kept across restarts, none if empty.
+  //
+  std::string cacheDirectory;
+
+  //
+  // Most APKs kept open with their sessions; the least recently used one is
+  // closed to make room.
+  //
+  size_t maxOpenApks = 64;
+};
+
+//
+// Serves analysis requests on a Unix socket until it fails, keeping APKs
+// open across requests so repeat requests for an APK are answered from its
+// session.  Connections are accepted and read on the calling thread, and the
+// requests read from a connection are answered a batch at a time on a worker
+// of the shared pool, one request per line and one JSON line per response,
+// in order:
+//
+//   properties <path>   package, version, debuggable and sha256
+//   manifest <path>     same as above with the manifest
+//   files <path>        the files of the APK
+//   cancel <path>       fails the requests for the APK received so far on
+//                       any connection with "cancelled"
+//   stats               the metrics of the process
+//
+// A connection sending a request line longer than 64 KiB is answered with
+// an error and closed.  Returns the exit code of the CLI.
+//
+auto serveApks(ApkServerOptions const &options) -> int;
+
+} // namespace ai::cli
+
+#endif /* ANDROID_INTROSPECTION_WASM_APK_SERVER_H_ */
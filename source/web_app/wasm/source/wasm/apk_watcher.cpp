@@ -0,0 +1,315 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <set>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include "apk_watcher.h"
+#include "utils/log.h"
+#include "utils/macros.h"
+
+using namespace ai;
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+//
+// Tells whether a file has to be analyzed again; one replaced by a rename
+// has another inode even when its size and time are the same.
+//
+struct FileStamp {
+
+  uint64_t size = 0;
+
+  int64_t modificationNanoseconds = 0;
+
+  uint64_t inode = 0;
+
+  auto operator==(FileStamp const &) const -> bool = default;
+};
+
+auto getFileStamp(std::string const &path) -> std::optional<FileStamp> {
+  struct stat status = {};
+  if (::stat(path.c_str(), &status) != 0) {
+    return std::nullopt;
+  }
+#ifdef __APPLE__
+  auto const &modificationTime = status.st_mtimespec;
+#else
+  auto const &modificationTime = status.st_mtim;
+#endif
+  return FileStamp{static_cast<uint64_t>(status.st_size), int64_t{modificationTime.tv_sec} * 1'000'000'000 + modificationTime.tv_nsec,
+                   static_cast<uint64_t>(status.st_ino)};
+}
+
+auto isApk(fs::path const &path) -> bool { return path.extension() == ".apk"; }
+
+//
+// An APK that could not be read or is not valid, e.g. one still being
+// copied when it was settled; it is tried again rather than taken as done.
+//
+auto isFailed(ApkBatchResult const &result) -> bool {
+  auto const valid = result.properties.find("valid");
+  return !result.error.empty() || valid == result.properties.end() || valid->second != "true";
+}
+
+//
+// Wakes the watch up as soon as a file is closed after writing or moved into
+// a watched directory.  Without inotify, or for directories it has no more
+// watches for, changes are only seen when the directory is listed again.
+//
+class DirectoryWatcher final {
+public:
+  DirectoryWatcher(std::string const &directory, bool const recursive) {
+#ifdef __linux__
+    recursive_ = recursive;
+    inotify_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_ < 0) {
+      LOGW("watch, polling [{}] without inotify, {}", directory, std::strerror(errno));
+      return;
+    }
+    addWatches(directory);
+#else
+    utils::ignore(directory);
+    utils::ignore(recursive);
+#endif
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(DirectoryWatcher);
+
+  ~DirectoryWatcher() {
+    if (inotify_ >= 0) {
+      ::close(inotify_);
+    }
+  }
+
+  //
+  // Waits up to timeout for a change and returns the *.apk files written
+  // or moved in since the last call, which are complete.
+  //
+  auto wait(std::chrono::milliseconds const timeout) -> std::set<std::string> {
+    auto written = std::set<std::string>();
+#ifdef __linux__
+    if (inotify_ >= 0) {
+      auto descriptor = pollfd{inotify_, POLLIN, 0};
+      if (::poll(&descriptor, 1, static_cast<int>(timeout.count())) > 0) {
+        readEvents(written);
+      }
+      return written;
+    }
+#endif
+    std::this_thread::sleep_for(timeout);
+    return written;
+  }
+
+private:
+#ifdef __linux__
+  static constexpr size_t EVENT_BUFFER_SIZE = 64 * 1024;
+
+  auto addWatches(std::string const &directory) -> void {
+    auto const watch = ::inotify_add_watch(inotify_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+    if (watch < 0) {
+      LOGW("watch, polling [{}], {}", directory, std::strerror(errno));
+      return;
+    }
+    directories_[watch] = directory;
+    if (!recursive_) {
+      return;
+    }
+    auto error = boost::system::error_code();
+    for (auto entry = fs::directory_iterator(directory, error); !error && entry != fs::directory_iterator(); entry.increment(error)) {
+      if (fs::is_directory(entry->status())) {
+        addWatches(entry->path().string());
+      }
+    }
+  }
+
+  auto readEvents(std::set<std::string> &written) -> void {
+    alignas(inotify_event) char buffer[EVENT_BUFFER_SIZE];
+    while (true) {
+      auto const bytesRead = ::read(inotify_, buffer, sizeof(buffer));
+      if (bytesRead < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytesRead <= 0) {
+        return;
+      }
+      for (auto offset = size_t(0); offset < static_cast<size_t>(bytesRead);) {
+        auto const *const event = reinterpret_cast<inotify_event const *>(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+        auto const directory = directories_.find(event->wd);
+        if (directory == directories_.end()) {
+          continue;
+        }
+        if ((event->mask & IN_IGNORED) != 0) {
+          directories_.erase(directory);
+          continue;
+        }
+        if (event->len == 0) {
+          continue;
+        }
+        auto const path = fs::path(directory->second) / event->name;
+        if ((event->mask & IN_ISDIR) != 0) {
+          if (recursive_ && (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+            addWatches(path.string());
+          }
+        } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0 && isApk(path)) {
+          written.insert(path.string());
+        }
+      }
+    }
+  }
+
+  bool recursive_ = false;
+
+  std::map<int, std::string> directories_;
+#endif
+
+  int inotify_ = -1;
+};
+
+} // namespace
+
+auto ai::cli::findApks(std::string const &directory, bool const recursive) -> std::vector<std::string> {
+  auto apkPaths = std::vector<std::string>();
+  auto const addIfApk = [&apkPaths](fs::directory_entry const &entry) {
+    if (fs::is_regular_file(entry.status()) && isApk(entry.path())) {
+      apkPaths.push_back(entry.path().string());
+    }
+  };
+  if (recursive) {
+    for (auto const &entry : fs::recursive_directory_iterator(directory)) {
+      addIfApk(entry);
+    }
+  } else {
+    for (auto const &entry : fs::directory_iterator(directory)) {
+      addIfApk(entry);
+    }
+  }
+  return apkPaths;
+}
+
+auto ai::cli::watchApks(ApkWatchOptions const &options, utils::ThreadPool &threadPool, ApkBatchCallback const &callback) -> int {
+  if (!fs::is_directory(options.directory)) {
+    LOGW("watch, [{}] is not a directory", options.directory);
+    return -2;
+  }
+  auto watcher = DirectoryWatcher(options.directory, options.recursive);
+  auto batchOptions = ApkBatchOptions();
+  batchOptions.fields = options.fields;
+  batchOptions.cacheDirectory = options.cacheDirectory;
+  batchOptions.cancellation = options.cancellation;
+
+  //
+  // Stamps of the APKs as they were analyzed, and of those not analyzed yet
+  // as they were last listed; an APK is analyzed once it is written or its
+  // stamp stayed the same for an interval.  APKs whose analysis failed keep
+  // their stamp apart, and are analyzed again along with the next change.
+  //
+  auto analyzed = std::map<std::string, FileStamp>();
+  auto failed = std::map<std::string, FileStamp>();
+  auto unsettled = std::map<std::string, FileStamp>();
+  auto written = std::set<std::string>();
+  auto first = true;
+  while (!options.cancellation.isCancelled()) {
+    auto listed = std::map<std::string, FileStamp>();
+    try {
+      for (auto const &apkPath : findApks(options.directory, options.recursive)) {
+        if (auto const stamp = getFileStamp(apkPath)) {
+          listed.emplace(apkPath, *stamp);
+        }
+      }
+    } catch (fs::filesystem_error const &error) {
+      //
+      // E.g. a subdirectory removed while listed; the next listing will do.
+      //
+      LOGW("watch, unable to list [{}], {}", options.directory, error.what());
+      written.merge(watcher.wait(std::chrono::milliseconds(options.pollIntervalMilliseconds)));
+      continue;
+    }
+
+    auto apkPaths = std::vector<std::string>();
+    auto nextUnsettled = std::map<std::string, FileStamp>();
+    for (auto const &[apkPath, stamp] : listed) {
+      if (auto const done = analyzed.find(apkPath); done != analyzed.end() && done->second == stamp) {
+        continue;
+      }
+      if (auto const tried = failed.find(apkPath); tried != failed.end() && tried->second == stamp) {
+        continue;
+      }
+      if (auto const seen = unsettled.find(apkPath); first || written.contains(apkPath) || (seen != unsettled.end() && seen->second == stamp)) {
+        apkPaths.push_back(apkPath);
+      } else {
+        nextUnsettled.emplace(apkPath, stamp);
+      }
+    }
+    std::erase_if(analyzed, [&listed](auto const &entry) { return !listed.contains(entry.first); });
+    std::erase_if(failed, [&listed](auto const &entry) { return !listed.contains(entry.first); });
+    if (!apkPaths.empty() || !written.empty()) {
+      for (auto const &[apkPath, stamp] : failed) {
+        if (listed.at(apkPath) == stamp && std::find(apkPaths.begin(), apkPaths.end(), apkPath) == apkPaths.end()) {
+          apkPaths.push_back(apkPath);
+        }
+      }
+    }
+    unsettled = std::move(nextUnsettled);
+    first = false;
+
+    if (!apkPaths.empty()) {
+      LOGD("watch, analyzing [{}] of [{}] apks", apkPaths.size(), listed.size());
+      try {
+        analyzeMany(apkPaths, batchOptions, threadPool, [&analyzed, &failed, &listed, &callback](ApkBatchResult result) {
+          if (isFailed(result)) {
+            analyzed.erase(result.path);
+            failed.insert_or_assign(result.path, listed.at(result.path));
+          } else {
+            failed.erase(result.path);
+            analyzed.insert_or_assign(result.path, listed.at(result.path));
+          }
+          callback(std::move(result));
+        });
+      } catch (utils::CancellationException const &) {
+        break;
+      }
+    }
+    written = watcher.wait(std::chrono::milliseconds(options.pollIntervalMilliseconds));
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef ANDROID_INTROSPECTION_WASM_APK_WATCHER_H_
+#define ANDROID_INTROSPECTION_WASM_APK_WATCHER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "apk/apk.h"
+#include "utils/cancellation.h"
+#include "utils/thread_pool.h"
+
+namespace ai::cli {
+
+struct ApkWatchOptions {
+
+  std::string directory;
+
+  //
+  // Watches the subdirectories of directory too, including those made
+  // while watching.
+  //
+  bool recursive = false;
+
+  ApkPropertyFields fields = ApkPropertyFields::all();
+
+  //
+  // Analysis cache, none if empty.  Shared with a server on the same
+  // directory, so that APKs it has analyzed are answered from the cache.
+  //
+  std::string cacheDirectory;
+
+  //
+  // How often the directory is listed again; without inotify this is the
+  // only way changes are noticed.
+  //
+  uint32_t pollIntervalMilliseconds = 2000;
+
+  //
+  // Stops watching once cancelled, after the APKs being analyzed.
+  //
+  utils::CancellationToken cancellation;
+};
+
+//
+// Every *.apk file in the directory, and in its subdirectories if recursive.
+//
+auto findApks(std::string const &directory, bool recursive) -> std::vector<std::string>;
+
+//
+// Analyzes every APK in the directory, then every APK added to it or
+// changed, as it appears.  An APK is analyzed again only once its size,
+// modification time or inode changes, so an APK still being copied is
+// picked up when it is closed, with inotify, or when it has not changed
+// for one interval, without.  An APK that fails to be analyzed or is not
+// valid is tried again whenever another APK changes.  Results are handed to
+// callback on the calling thread, as analyzeMany() hands them out.
+//
+// Returns the exit code of the CLI: 0 once cancelled, -2 if the directory
+// cannot be listed.
+//
+auto watchApks(ApkWatchOptions const &options, utils::ThreadPool &threadPool, ApkBatchCallback const &callback) -> int;
+
+} // namespace ai::cli
+
+#endif /* ANDROID_INTROSPECTION_WASM_APK_WATCHER_H_ */
@@ -0,0 +1,98 @@
+//
+// Worker of WasmWorkerPool, see worker_pool.js.  Instantiates the module it
+// is sent, compiled once by the page, with a heap of its own, and then runs
+// one job at a time: the apk arrives as a transferred ArrayBuffer and the
+// bytes of extracted files go back the same way.
+//
+let instance = null
+
+//
+// Longest a sliced call runs per resume(); there is no event loop to go
+// back to in between, so this only bounds the time between checks.
+//
+const SLICE_MILLISECONDS = 1000
+
+const instantiate = async (loaderUrl, wasmModule) => {
+  importScripts(loaderUrl)
+  return self.Module({
+    instantiateWasm: (imports, onInstantiated) => {
+      WebAssembly.instantiate(wasmModule, imports).then(instance => onInstantiated(instance, wasmModule))
+      return {}
+    }
+  })
+}
+
+const getErrorMessage = error => {
+  if (error instanceof Error || instance === null) {
+    return String(error && error.message || error)
+  }
+  const [type, message] = instance.getExceptionMessage(error)
+  return message ? `${type}: ${message}` : type
+}
+
+const runSliced = call => {
+  try {
+    let done = false
+    while (!done) {
+      done = call.resume(SLICE_MILLISECONDS)
+    }
+  } finally {
+    call.delete()
+  }
+}
+
+//
+// Runs a job on the apk and returns its result along with the buffers to
+// transfer back.
+//
+const runJob = (apk, job) => {
+  switch (job.type) {
+    case 'properties':
+      return [apk.getProperties(), []]
+    case 'summary':
+      return [apk.getSummary(), []]
+    case 'manifestTree':
+      return [apk.getAndroidManifestTree(), []]
+    case 'extract': {
+      const files = []
+      runSliced(apk.startExtract(job.filter, (path, bytes) => files.push({ path, bytes: bytes.slice() })))
+      return [files, files.map(file => file.bytes.buffer)]
+    }
+    default:
+      throw new Error(`unknown job type ${job.type}`)
+  }
+}
+
+self.onmessage = async ({ data }) => {
+  if (data.type === 'init') {
+    try {
+      instance = await instantiate(data.loaderUrl, data.module)
+      self.postMessage({ type: 'ready' })
+    } catch (error) {
+      self.postMessage({ type: 'failed', message: getErrorMessage(error) })
+    }
+    return
+  }
+  const { id, job } = data
+  let apk = null
+  try {
+    instance.allocateApkBuffer(job.buffer.byteLength).set(new Uint8Array(job.buffer))
+    apk = instance.Apk.openBuffer()
+    const [result, transfer] = runJob(apk, job)
+    self.postMessage({ type: 'result', id, result }, transfer)
+  } catch (error) {
+    //
+    // A trap or an abort, e.g. of a heap that could not grow, leaves the
+    // module unusable: the job fails and the pool drops the worker.
+    //
+    const aborted = error instanceof WebAssembly.RuntimeError
+    if (aborted) {
+      apk = null
+    }
+    self.postMessage({ type: aborted ? 'failed' : 'error', id, message: getErrorMessage(error) })
+  } finally {
+    if (apk !== null) {
+      apk.delete()
+    }
+  }
+}
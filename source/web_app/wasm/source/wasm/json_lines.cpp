@@ -0,0 +1,121 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "json_lines.h"
+#include "utils/json.h"
+
+namespace {
+
+auto appendSizes(std::string &output, uint64_t const compressedSize, uint64_t const uncompressedSize) -> void {
+  output += R"("compressedSize":)";
+  output += std::to_string(compressedSize);
+  output += R"(,"uncompressedSize":)";
+  output += std::to_string(uncompressedSize);
+}
+
+auto appendBuckets(std::string &output, std::string_view const name, std::vector<ai::SizeBucket> const &buckets) -> void {
+  output += ",\"";
+  output += name;
+  output += "\":[";
+  auto separator = "";
+  for (auto const &bucket : buckets) {
+    output += separator;
+    output += R"({"name":)";
+    ai::utils::json::appendString(bucket.name, output);
+    output += ',';
+    appendSizes(output, bucket.compressedSize, bucket.uncompressedSize);
+    output += R"(,"entryCount":)";
+    output += std::to_string(bucket.entryCount);
+    output += '}';
+    separator = ",";
+  }
+  output += ']';
+}
+
+} // namespace
+
+auto ai::cli::appendApkJsonLine(std::string &output, std::string const &apkPath, std::map<std::string, std::string> const &properties,
+                                std::optional<std::vector<std::string>> const &files, std::string const &error) -> void {
+  output += R"({"path":)";
+  utils::json::appendString(apkPath, output);
+  if (!error.empty()) {
+    output += R"(,"error":)";
+    utils::json::appendString(error, output);
+  }
+  output += R"(,"properties":{)";
+  auto separator = "";
+  for (auto const &[key, value] : properties) {
+    if (key != "manifest") {
+      output += separator;
+      utils::json::appendString(key, output);
+      output += ':';
+      utils::json::appendString(value, output);
+      separator = ",";
+    }
+  }
+  output += '}';
+  if (auto const manifest = properties.find("manifest"); manifest != properties.end()) {
+    output += R"(,"manifest":)";
+    utils::json::appendString(manifest->second, output);
+  }
+  if (files) {
+    output += R"(,"files":[)";
+    separator = "";
+    for (auto const &file : *files) {
+      output += separator;
+      utils::json::appendString(file, output);
+      separator = ",";
+    }
+    output += ']';
+  }
+  output += "}\n";
+}
+
+auto ai::cli::appendSizeReportJsonLine(std::string &output, std::string const &apkPath, SizeReport const &report) -> void {
+  output += R"({"path":)";
+  utils::json::appendString(apkPath, output);
+  output += ',';
+  appendSizes(output, report.compressedSize, report.uncompressedSize);
+  output += R"(,"entryCount":)";
+  output += std::to_string(report.entryCount);
+  appendBuckets(output, "directories", report.directories);
+  appendBuckets(output, "types", report.types);
+  appendBuckets(output, "abis", report.abis);
+  appendBuckets(output, "dexFiles", report.dexFiles);
+  output += R"(,"flags":[)";
+  auto separator = "";
+  for (auto const &flag : report.flags) {
+    output += separator;
+    output += R"({"path":)";
+    utils::json::appendString(flag.path, output);
+    output += R"(,"issue":)";
+    utils::json::appendString(getSizeIssueName(flag.issue), output);
+    output += R"(,"type":)";
+    utils::json::appendString(getContentTypeName(flag.type), output);
+    output += ',';
+    appendSizes(output, flag.compressedSize, flag.uncompressedSize);
+    output += '}';
+    separator = ",";
+  }
+  output += "]}\n";
+}
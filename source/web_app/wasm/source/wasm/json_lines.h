@@ -0,0 +1,59 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_WASM_JSON_LINES_H_
+#define ANDROID_INTROSPECTION_WASM_JSON_LINES_H_
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "apk/size_report.h"
+
+namespace ai::cli {
+
+//
+// Appends one line of JSON for an APK: its path, an error if it could not be
+// analyzed, its properties but the manifest, and the manifest and files if
+// there are any, e.g.
+//
+//   {"path":"a.apk","properties":{"packageName":"com.a","valid":"true"},"files":["AndroidManifest.xml"]}
+//
+auto appendApkJsonLine(std::string &output, std::string const &apkPath, std::map<std::string, std::string> const &properties,
+                       std::optional<std::vector<std::string>> const &files, std::string const &error) -> void;
+
+//
+// Appends one line of JSON with the size report of an APK, sizes in bytes,
+// e.g.
+//
+//   {"path":"a.apk","compressedSize":10,"uncompressedSize":20,"entryCount":1,
+//    "directories":[{"name":"/","compressedSize":10,"uncompressedSize":20,"entryCount":1}],
+//    "types":[...],"abis":[...],"dexFiles":[...],
+//    "flags":[{"path":"a.txt","issue":"stored-compressible","type":"text","compressedSize":10,"uncompressedSize":10}]}
+//
+auto appendSizeReportJsonLine(std::string &output, std::string const &apkPath, SizeReport const &report) -> void;
+
+} // namespace ai::cli
+
+#endif /* ANDROID_INTROSPECTION_WASM_JSON_LINES_H_ */
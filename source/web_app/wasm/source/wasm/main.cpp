@@ -24,13 +24,39 @@
 
 #ifdef WASM
 
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
+#ifdef AI_OPFS_CACHE
+#include <emscripten/wasmfs.h>
+#endif
+
 #include "apk/apk.h"
+#include "apk/app_bundle.h"
+#include "apk/directory_tree.h"
+#include "apk/file_listing.h"
+#include "apk/zip_stream_writer.h"
+#include "dex/apk_dex_files.h"
+#include "dex/disassembler.h"
+#include "dex/proguard_mapping.h"
+#include "utils/cancellation.h"
 #include "utils/emscripten_bind_wrapper.h"
 #include "utils/log.h"
+#include "utils/macros.h"
+#include "utils/metrics.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
+#include "sliced_call.h"
 
 using namespace emscripten;
 
@@ -38,32 +64,590 @@ auto initialize() { LOGV("wasm::initialize"); }
 
 auto uninitialize() { LOGV("wasm::uninitialize"); }
 
+//
+// Spans show up in the DevTools performance panel while tracing is on; the
+// recorded ones can also be saved as a Chrome trace.
+//
+auto setTracingEnabled(bool const enabled) { ai::utils::trace::setEnabled(enabled); }
+
+auto exportTrace() { return ai::utils::trace::exportChromeTrace(); }
+
+auto getMetrics() { return ai::utils::metrics::snapshot(); }
+
 namespace apk {
 
-auto isValid(std::string const pathToApk) {
-  LOGV("wasm::apk::isValid pathToApk [{}]", pathToApk);
-  auto const apk = ai::Apk(pathToApk);
-  return apk.isValid();
+//
+// Analysis cache for every APK opened from JS, kept in the Origin Private
+// File System so that reopening an APK in a later visit only reads its
+// central directory and the cached entries, manifest and DEX index.  The
+// OPFS backend of WasmFS proxies to a thread of its own that holds
+// synchronous access handles, so it needs the threaded build and the module
+// running in a worker; elsewhere there is no cache.
+//
+auto getCacheDirectory() -> std::string const & {
+  static auto const cacheDirectory = []() -> std::string {
+#ifdef AI_OPFS_CACHE
+    if (auto const result = wasmfs_create_directory("/opfs", 0777, wasmfs_create_opfs_backend()); result != 0) {
+      LOGW("wasm::apk::getCacheDirectory, no opfs, error [{}]", result);
+      return {};
+    }
+    return "/opfs/analysis-cache";
+#else
+    return {};
+#endif
+  }();
+  return cacheDirectory;
 }
 
-auto getFiles(std::string const pathToApk) {
-  LOGV("wasm::apk::getFiles pathToApk [{}]", pathToApk);
-  auto const apk = ai::Apk(pathToApk);
-  return apk.getFiles();
-}
+auto isCachePersistent() -> bool { return !getCacheDirectory().empty(); }
 
-auto getFileContent(std::string const pathToApk, std::string const pathToFile) {
-  LOGV("wasm::apk::getFileContent pathToApk [{}] pathToFile [{}]", pathToApk, pathToFile);
-  auto const apk = ai::Apk(pathToApk);
-  auto const fileContent = apk.getFileContent(pathToFile);
+//
+// Buffer that JS fills with an APK before Apk.openBuffer() takes it over.
+//
+auto pendingApkBuffer = std::vector<std::byte>();
+
+//
+// Makes room on the Wasm heap for an APK of the size and returns a view of
+// it, which JS fills with the contents of the ArrayBuffer or Blob right away,
+// before anything else can grow the heap.  Nothing goes through MEMFS.
+//
+auto allocateApkBuffer(size_t const size) {
+  LOGV("wasm::apk::allocateApkBuffer size [{}]", size);
+  pendingApkBuffer.assign(size, std::byte{0});
+  return val(typed_memory_view(pendingApkBuffer.size(), reinterpret_cast<uint8_t *>(pendingApkBuffer.data())));
 }
 
-auto getProperties(std::string const pathToApk) {
-  LOGV("wasm::apk::getProperties pathToApk [{}]", pathToApk);
-  auto const apk = ai::Apk(pathToApk);
-  return apk.getProperties();
+//
+// Properties of an APK as one JS object of native types, handed over in a
+// single crossing.  Fields that were not asked for are left empty.
+//
+struct ApkProperties {
+
+  bool valid = false;
+
+  std::string packageName;
+
+  //
+  // 0 when the manifest gives no number, e.g. a resource reference.
+  //
+  uint32_t versionCode = 0;
+
+  std::string versionName;
+
+  bool debuggable = false;
+
+  std::string manifest;
+
+  std::string sha256;
+};
+
+auto toApkProperties(std::map<std::string, std::string> properties) -> ApkProperties {
+  auto const take = [&properties](std::string const &name) {
+    auto const property = properties.find(name);
+    return property != properties.end() ? std::move(property->second) : std::string();
+  };
+  auto apkProperties = ApkProperties();
+  apkProperties.valid = take("valid") == "true";
+  apkProperties.packageName = take("packageName");
+  auto const versionCode = take("versionCode");
+  std::from_chars(versionCode.data(), versionCode.data() + versionCode.size(), apkProperties.versionCode);
+  apkProperties.versionName = take("versionName");
+  apkProperties.debuggable = take("debuggable") == "true";
+  apkProperties.manifest = take("manifest");
+  apkProperties.sha256 = take("sha256");
+  return apkProperties;
 }
 
+using ai::wasm::SlicedCall;
+
+//
+// An APK opened once and queried through its handle until JS deletes it, so
+// its session, with the central directory, manifest and resources, lives for
+// as long as the UI shows the APK.
+//
+class ApkHandle final {
+public:
+  explicit ApkHandle(std::shared_ptr<ai::Apk const> apk) : apk_(std::move(apk)) {}
+
+  DISALLOW_COPY_AND_ASSIGN(ApkHandle);
+
+  static auto open(std::string const pathToApk) -> std::shared_ptr<ApkHandle> {
+    LOGV("wasm::apk::open pathToApk [{}]", pathToApk);
+    return std::make_shared<ApkHandle>(std::make_unique<ai::Apk const>(pathToApk, getCacheDirectory()));
+  }
+
+  //
+  // Opens the APK in the buffer JS filled through allocateApkBuffer().
+  //
+  static auto openBuffer() -> std::shared_ptr<ApkHandle> {
+    LOGV("wasm::apk::openBuffer size [{}]", pendingApkBuffer.size());
+    return std::make_shared<ApkHandle>(std::make_unique<ai::Apk const>(std::exchange(pendingApkBuffer, {}), getCacheDirectory()));
+  }
+
+  //
+  // Opens a File or Blob lazily: entries are read from synchronous slices of
+  // it as they are asked for, so APKs larger than the Wasm heap can be opened
+  // and only the central directory and the entries read are ever resident.
+  // FileReaderSync only exists in workers, so the module has to run in one,
+  // and the Blob and reader belong to this thread, so every call on the APK
+  // reads and runs here rather than on the pool.
+  //
+  static auto openBlob(val const blob) -> std::shared_ptr<ApkHandle> {
+    auto const size = static_cast<uint64_t>(blob["size"].as<double>());
+    LOGV("wasm::apk::openBlob size [{}]", size);
+    auto fetcher = [blob, fileReader = val::global("FileReaderSync").new_()](uint64_t const offset, std::span<std::byte> const buffer) -> size_t {
+      auto const slice = blob.call<val>("slice", static_cast<double>(offset), static_cast<double>(offset + buffer.size()));
+      auto const bytes = val::global("Uint8Array").new_(fileReader.call<val>("readAsArrayBuffer", slice));
+      auto const bytesRead = bytes["length"].as<size_t>();
+      val(typed_memory_view(bytesRead, reinterpret_cast<uint8_t *>(buffer.data()))).call<void>("set", bytes);
+      return bytesRead;
+    };
+    return std::make_shared<ApkHandle>(std::make_unique<ai::Apk const>(size, std::move(fetcher), getCacheDirectory(), ai::ApkFetcherThreads::Opening));
+  }
+
+  //
+  // Bounds what the APK inflates and parses on the Wasm heap, so that going
+  // past it throws an exception JS can read with getExceptionMessage()
+  // rather than aborting the module on a failed allocation.
+  //
+  auto setMemoryBudget(double const bytes) const -> void {
+    LOGV("wasm::apk::setMemoryBudget bytes [{}]", bytes);
+    apk_->setMemoryBudget(static_cast<uint64_t>(bytes));
+  }
+
+  auto isValid() const -> bool {
+    LOGV("wasm::apk::isValid");
+    return apk_->isValid();
+  }
+
+  //
+  // A page of the paths the filter keeps, see FileListing, as a JS object of
+  // the number of matching paths, "names", the paths packed as UTF-8, and
+  // "offsets", where path i spans offsets[i] to offsets[i + 1].  Both are
+  // views of the Wasm heap, valid up to the next call or until the heap
+  // grows.
+  //
+  auto getFilePage(double const offset, size_t const limit, std::string const filter) -> val {
+    LOGV("wasm::apk::getFilePage offset [{}] limit [{}] filter [{}]", offset, limit, filter);
+    if (!fileListing_) {
+      fileListing_.emplace(apk_->getFiles());
+    }
+    auto const filePage = fileListing_->getPage(static_cast<size_t>(std::max(offset, 0.0)), limit, filter);
+    auto page = val::object();
+    page.set("total", static_cast<double>(filePage.total));
+    page.set("names", val(typed_memory_view(filePage.names.size(), reinterpret_cast<uint8_t const *>(filePage.names.data()))));
+    page.set("offsets", val(typed_memory_view(filePage.offsets.size(), filePage.offsets.data())));
+    return page;
+  }
+
+  //
+  // One level of the tree of files, as JS objects of the node id, name and
+  // what is at or below it; the root is node 0.  The tree is built from the
+  // central directory on the first call and kept with the handle.
+  //
+  auto listDirectory(uint32_t const node) const -> val {
+    LOGV("wasm::apk::listDirectory node [{}]", node);
+    auto const &directoryTree = getDirectoryTree();
+    auto const &directoryNode = directoryTree.getNode(node);
+    auto children = val::array();
+    for (auto child = directoryNode.firstChild; child < directoryNode.firstChild + directoryNode.childCount; child++) {
+      auto const &childNode = directoryTree.getNode(child);
+      auto object = val::object();
+      object.set("id", child);
+      object.set("name", std::string(directoryTree.getName(child)));
+      object.set("directory", childNode.isDirectory());
+      object.set("files", static_cast<double>(childNode.fileCount));
+      object.set("compressedSize", static_cast<double>(childNode.compressedSize));
+      object.set("size", static_cast<double>(childNode.uncompressedSize));
+      children.call<void>("push", object);
+    }
+    return children;
+  }
+
+  //
+  // Node of the path, or -1 if there is none.
+  //
+  auto findDirectoryNode(std::string const path) const -> int32_t {
+    LOGV("wasm::apk::findDirectoryNode path [{}]", path);
+    auto const node = getDirectoryTree().find(path);
+    return node ? static_cast<int32_t>(*node) : -1;
+  }
+
+  auto getDirectoryNodePath(uint32_t const node) const -> std::string { return getDirectoryTree().getPath(node); }
+
+  //
+  // The manifest text, handed to onChunk in pieces as it is rendered.
+  //
+  auto getAndroidManifestChunks(val const onChunk) const -> void {
+    LOGV("wasm::apk::getAndroidManifestChunks");
+    apk_->getAndroidManifest([&onChunk](std::string_view const chunk) { onChunk(std::string(chunk)); });
+  }
+
+  //
+  // The manifest as a JSON tree, see ai::XmlTreeVisitor, so that the UI
+  // gets its elements without parsing the text.
+  //
+  auto getAndroidManifestTree() const -> std::string {
+    LOGV("wasm::apk::getAndroidManifestTree");
+    return apk_->getAndroidManifestTree();
+  }
+
+  //
+  // Bytes of the file last asked for.  Stored files are a view of the APK
+  // and compressed ones are inflated once, so JS gets a view of the Wasm
+  // heap and nothing is copied on the way.  The view is only valid up to the
+  // next getFileContent() or releaseFileContent(), or until the heap grows;
+  // JS has to copy what it keeps.
+  //
+  auto getFileContent(std::string const pathToFile) -> val {
+    LOGV("wasm::apk::getFileContent pathToFile [{}]", pathToFile);
+    pinnedFileBytes_.reset();
+    pinnedFileBytes_ = apk_->getFileBytes(pathToFile);
+    auto const bytes = pinnedFileBytes_->bytes();
+    return val(typed_memory_view(bytes.size(), reinterpret_cast<uint8_t const *>(bytes.data())));
+  }
+
+  auto releaseFileContent() -> void {
+    LOGV("wasm::apk::releaseFileContent");
+    pinnedFileBytes_.reset();
+  }
+
+  //
+  // What every file is from its first bytes, by path, e.g. "dex" or
+  // "encrypted"; see ai::ContentType.
+  //
+  auto getContentTypes() const -> std::map<std::string, std::string> {
+    LOGV("wasm::apk::getContentTypes");
+    auto contentTypes = std::map<std::string, std::string>();
+    for (auto &entry : apk_->classifyEntries()) {
+      contentTypes.emplace(std::move(entry.path), ai::getContentTypeName(entry.type));
+    }
+    return contentTypes;
+  }
+
+  //
+  // Occurrences of any of the patterns in every file, as JS objects of the
+  // path, the index of the pattern and the offset; see ai::Apk::grep().
+  //
+  auto grep(std::vector<std::string> const patterns, bool const caseSensitive, size_t const maxMatches) const -> val {
+    LOGV("wasm::apk::grep patterns [{}]", patterns.size());
+    auto options = ai::ApkGrepOptions();
+    options.caseSensitive = caseSensitive;
+    options.maxMatches = maxMatches;
+    options.cancellation = startCancellableCall();
+    auto matches = val::array();
+    for (auto const &match : apk_->grep(patterns, options, ai::utils::ThreadPool::shared())) {
+      auto object = val::object();
+      object.set("path", match.path);
+      object.set("pattern", match.pattern);
+      object.set("offset", static_cast<double>(match.offset));
+      matches.call<void>("push", object);
+    }
+    return matches;
+  }
+
+  //
+  // Smali text of every class of the DEX files, handed to onClass with the
+  // class descriptor one class at a time, in the order of the files.
+  //
+  auto disassemble(val const onClass) const -> void {
+    LOGV("wasm::apk::disassemble");
+    auto const cancellation = startCancellableCall();
+    auto const dexFiles = ai::dex::ApkDexFiles(*apk_);
+    ai::dex::disassemble(
+        dexFiles, ai::utils::ThreadPool::shared(),
+        [&onClass](std::string_view const descriptor, std::string_view const smali) { onClass(std::string(descriptor), std::string(smali)); }, cancellation);
+  }
+
+  //
+  // A zip of the manifest, the decoded resources and the smali of every
+  // class, handed to onData in chunks as the items finish, so the project
+  // never sits whole in the heap or on MEMFS.  Each chunk is a view of the
+  // Wasm heap only valid during the call; JS has to copy it, e.g. into a
+  // Blob part or a stream.
+  //
+  auto exportProject(val const onData) const -> void {
+    LOGV("wasm::apk::exportProject");
+    auto writer = ai::ZipStreamWriter([&onData](std::span<std::byte const> const chunk) {
+      onData(val(typed_memory_view(chunk.size(), reinterpret_cast<uint8_t const *>(chunk.data()))));
+    });
+    auto const cancellation = startCancellableCall();
+    apk_->dump(writer, cancellation);
+    auto const dexFiles = ai::dex::ApkDexFiles(*apk_);
+    ai::dex::disassemble(dexFiles, ai::utils::ThreadPool::shared(), writer, cancellation);
+    writer.finish();
+  }
+
+  //
+  // Makes the grep(), disassemble() or exportProject() running on the
+  // handle throw "cancelled" once its workers let go, e.g. from the callback
+  // of one when the user picked another APK.  Nothing if none is running.
+  //
+  auto cancel() const -> void {
+    LOGV("wasm::apk::cancel");
+    cancellation_.cancel();
+  }
+
+  //
+  // Paths of the APK handed to onPage as JS arrays of up to pageSize paths,
+  // one page per step of the call, so that a worker can post the first page
+  // before the rest are converted.
+  //
+  auto startFilePages(size_t const pageSize, val const onPage) const -> std::shared_ptr<SlicedCall> {
+    LOGV("wasm::apk::startFilePages pageSize [{}]", pageSize);
+    auto files = std::optional<std::vector<std::string>>();
+    auto pageStart = size_t{0};
+    return std::make_shared<SlicedCall>([apk = apk_, step = std::max<size_t>(pageSize, 1), onPage, files, pageStart]() mutable {
+      if (!files) {
+        files = apk->getFiles();
+        return true;
+      }
+      auto page = val::array();
+      auto const pageEnd = std::min(files->size(), pageStart + step);
+      for (; pageStart < pageEnd; pageStart++) {
+        page.call<void>("push", (*files)[pageStart]);
+      }
+      if (page["length"].as<size_t>() > 0) {
+        onPage(page);
+      }
+      return pageStart < files->size();
+    });
+  }
+
+  //
+  // Same as getAndroidManifestChunks(), one chunk per step of the call.  The
+  // manifest is rendered in the first step, a single pass over the document,
+  // and its chunks handed out in the steps after it.
+  //
+  auto startAndroidManifestChunks(val const onChunk) const -> std::shared_ptr<SlicedCall> {
+    LOGV("wasm::apk::startAndroidManifestChunks");
+    auto chunks = std::optional<std::vector<std::string>>();
+    auto next = size_t{0};
+    return std::make_shared<SlicedCall>([apk = apk_, onChunk, chunks, next]() mutable {
+      if (!chunks) {
+        chunks.emplace();
+        apk->getAndroidManifest([&chunks](std::string_view const chunk) { chunks->emplace_back(chunk); });
+        return !chunks->empty();
+      }
+      onChunk(std::move((*chunks)[next++]));
+      return next < chunks->size();
+    });
+  }
+
+  //
+  // Bytes of every file whose path the filter keeps, as for getFilePage(),
+  // handed to onFile with the path one file per step of the call.  The
+  // bytes are a view of the Wasm heap only valid during the call to onFile;
+  // JS has to copy what it keeps.
+  //
+  auto startExtract(std::string const filter, val const onFile) const -> std::shared_ptr<SlicedCall> {
+    LOGV("wasm::apk::startExtract filter [{}]", filter);
+    auto files = std::optional<std::vector<std::string>>();
+    auto next = size_t{0};
+    return std::make_shared<SlicedCall>([apk = apk_, filter, onFile, files, next]() mutable {
+      if (!files) {
+        files = apk->getFiles();
+        std::erase_if(*files, [&filter](std::string const &file) { return !ai::matchesPathFilter(filter, file); });
+        return !files->empty();
+      }
+      auto const &file = (*files)[next++];
+      auto const fileBytes = apk->getFileBytes(file);
+      auto const bytes = fileBytes.bytes();
+      onFile(file, val(typed_memory_view(bytes.size(), reinterpret_cast<uint8_t const *>(bytes.data()))));
+      return next < files->size();
+    });
+  }
+
+  //
+  // Prefetches the files a user is likely to open next into the session,
+  // see Apk::prefetch(), one file per step of the call after the first
+  // predicts them; onFile gets the path of every file that is ready.  Meant
+  // to be resumed while the page is idle.
+  //
+  auto startPrefetch(val const onFile) const -> std::shared_ptr<SlicedCall> {
+    LOGV("wasm::apk::startPrefetch");
+    auto files = std::optional<std::vector<std::string>>();
+    auto next = size_t{0};
+    return std::make_shared<SlicedCall>([apk = apk_, onFile, files, next]() mutable {
+      if (!files) {
+        files = apk->getLikelyNextFiles();
+        return !files->empty();
+      }
+      auto const &file = (*files)[next++];
+      if (apk->prefetch(file)) {
+        onFile(file);
+      }
+      return next < files->size();
+    });
+  }
+
+  //
+  // Loads the ProGuard or R8 mapping.txt at the path in MEMFS, whose names
+  // the calls below show next to the obfuscated ones.
+  //
+  auto loadMapping(std::string const pathToMapping) -> void {
+    LOGV("wasm::apk::loadMapping pathToMapping [{}]", pathToMapping);
+    mapping_ = std::make_shared<ai::dex::ProguardMapping const>(pathToMapping, ai::utils::ThreadPool::shared());
+  }
+
+  //
+  // Original name of a class, e.g. "org.fdroid.fdroid.FDroidApp" for
+  // "a.a", or the name itself without a mapping or when it lacks the class.
+  //
+  auto deobfuscateClassName(std::string const className) const -> std::string {
+    return mapping_ ? std::string(mapping_->deobfuscateClassName(className)) : className;
+  }
+
+  //
+  // Same as disassemble(), one class per step of the call, on the calling
+  // thread rather than the pool.  onClass also gets the original name of
+  // the class from the mapping loaded, if any.
+  //
+  auto startDisassemble(val const onClass) const -> std::shared_ptr<SlicedCall> {
+    LOGV("wasm::apk::startDisassemble");
+    auto dexFiles = std::shared_ptr<ai::dex::ApkDexFiles const>();
+    auto dexFile = size_t{0};
+    auto classDef = uint32_t{0};
+    return std::make_shared<SlicedCall>([apk = apk_, mapping = mapping_, onClass, dexFiles, dexFile, classDef]() mutable {
+      if (!dexFiles) {
+        dexFiles = std::make_shared<ai::dex::ApkDexFiles const>(*apk);
+      } else {
+        auto const &dex = (*dexFiles)[dexFile];
+        auto smali = std::pmr::string();
+        ai::dex::disassembleClass(dex, classDef, smali);
+        auto const descriptor = dex.typeDescriptor(dex.classDefs()[classDef].classIndex);
+        auto const className = ai::dex::getClassName(descriptor);
+        onClass(std::string(descriptor), std::string(smali), mapping ? std::string(mapping->deobfuscateClassName(className)) : className);
+        classDef++;
+      }
+      while (dexFile < dexFiles->size() && classDef == (*dexFiles)[dexFile].classDefs().size()) {
+        dexFile++;
+        classDef = 0;
+      }
+      return dexFile < dexFiles->size();
+    });
+  }
+
+  auto getProperties() const -> ApkProperties {
+    LOGV("wasm::apk::getProperties");
+    return toApkProperties(apk_->getProperties());
+  }
+
+  //
+  // Same as above, calling onProgress with the bytes hashed so far and the
+  // size of the APK while the file is hashed.
+  //
+  auto getPropertiesWithProgress(val const onProgress) const -> ApkProperties {
+    LOGV("wasm::apk::getPropertiesWithProgress");
+    return toApkProperties(apk_->getProperties(ai::ApkPropertyFields::all(), [&onProgress](uint64_t const bytesProcessed, uint64_t const bytesTotal) {
+      onProgress(static_cast<double>(bytesProcessed), static_cast<double>(bytesTotal));
+    }));
+  }
+
+  //
+  // What listings of many APKs show, without hashing or rendering the
+  // manifest.
+  //
+  auto getSummary() const -> ApkProperties {
+    LOGV("wasm::apk::getSummary");
+    return toApkProperties(apk_->getProperties({ai::ApkPropertyField::Package, ai::ApkPropertyField::Version}));
+  }
+
+private:
+  //
+  // Calls get a token of their own, so that cancelling one never cancels
+  // the next.
+  //
+  auto startCancellableCall() const -> ai::utils::CancellationToken {
+    cancellation_ = ai::utils::CancellationToken::create();
+    return cancellation_;
+  }
+
+  auto getDirectoryTree() const -> ai::DirectoryTree const & {
+    if (!directoryTree_) {
+      directoryTree_.emplace(apk_->getEntries());
+    }
+    return *directoryTree_;
+  }
+
+  std::shared_ptr<ai::Apk const> const apk_;
+
+  mutable std::optional<ai::DirectoryTree> directoryTree_;
+
+  mutable ai::utils::CancellationToken cancellation_;
+
+  std::optional<ai::FileListing> fileListing_;
+
+  std::optional<ai::ApkFileBytes> pinnedFileBytes_;
+
+  std::shared_ptr<ai::dex::ProguardMapping const> mapping_;
+};
+
+//
+// An Android App Bundle (.aab) opened once and queried through its handle,
+// with a manifest and resources per module rather than one of each.
+//
+class BundleHandle final {
+public:
+  explicit BundleHandle(std::unique_ptr<ai::AppBundle const> bundle) : bundle_(std::move(bundle)) {}
+
+  DISALLOW_COPY_AND_ASSIGN(BundleHandle);
+
+  static auto open(std::string const pathToBundle) -> std::shared_ptr<BundleHandle> {
+    LOGV("wasm::bundle::open pathToBundle [{}]", pathToBundle);
+    return std::make_shared<BundleHandle>(std::make_unique<ai::AppBundle const>(pathToBundle));
+  }
+
+  //
+  // Opens the bundle in the buffer JS filled through allocateApkBuffer().
+  //
+  static auto openBuffer() -> std::shared_ptr<BundleHandle> {
+    LOGV("wasm::bundle::openBuffer size [{}]", pendingApkBuffer.size());
+    return std::make_shared<BundleHandle>(std::make_unique<ai::AppBundle const>(std::exchange(pendingApkBuffer, {})));
+  }
+
+  static auto isBundlePath(std::string const path) -> bool { return ai::AppBundle::isAppBundlePath(path); }
+
+  auto getModules() const -> std::vector<std::string> {
+    LOGV("wasm::bundle::getModules");
+    return bundle_->getModules();
+  }
+
+  auto getFiles() const -> std::vector<std::string> {
+    LOGV("wasm::bundle::getFiles");
+    return bundle_->getFiles();
+  }
+
+  //
+  // The view is valid until the next call, which replaces the content.
+  //
+  auto getFileContent(std::string const pathToFile) -> val {
+    LOGV("wasm::bundle::getFileContent pathToFile [{}]", pathToFile);
+    fileContent_ = bundle_->getFileContent(pathToFile);
+    return val(typed_memory_view(fileContent_.size(), reinterpret_cast<uint8_t const *>(fileContent_.data())));
+  }
+
+  auto getAndroidManifest(std::string const module) const -> std::string {
+    LOGV("wasm::bundle::getAndroidManifest module [{}]", module);
+    return bundle_->getAndroidManifest(module);
+  }
+
+  auto getResourceValues(std::string const module) const -> std::map<std::string, std::string> {
+    LOGV("wasm::bundle::getResourceValues module [{}]", module);
+    return bundle_->getResourceValues(module);
+  }
+
+  auto getProperties() const -> ApkProperties {
+    LOGV("wasm::bundle::getProperties");
+    return toApkProperties(bundle_->getProperties());
+  }
+
+private:
+  std::unique_ptr<ai::AppBundle const> const bundle_;
+
+  std::vector<std::byte> fileContent_;
+};
+
 } // namespace apk
 
 EMSCRIPTEN_BINDINGS(ApkModule) {
@@ -72,13 +656,72 @@ EMSCRIPTEN_BINDINGS(ApkModule) {
 
   function("uninitialize", &uninitialize);
 
-  function("isValid", &apk::isValid);
+  function("setTracingEnabled", &setTracingEnabled);
 
-  function("getFiles", &apk::getFiles);
+  function("exportTrace", &exportTrace);
 
-  function("getFileContent", &apk::getFileContent);
+  function("getMetrics", &getMetrics);
 
-  function("getProperties", &apk::getProperties);
+  function("allocateApkBuffer", &apk::allocateApkBuffer);
+
+  function("isCachePersistent", &apk::isCachePersistent);
+
+  value_object<apk::ApkProperties>("ApkProperties")
+      .field("valid", &apk::ApkProperties::valid)
+      .field("packageName", &apk::ApkProperties::packageName)
+      .field("versionCode", &apk::ApkProperties::versionCode)
+      .field("versionName", &apk::ApkProperties::versionName)
+      .field("debuggable", &apk::ApkProperties::debuggable)
+      .field("manifest", &apk::ApkProperties::manifest)
+      .field("sha256", &apk::ApkProperties::sha256);
+
+  class_<apk::ApkHandle>("Apk")
+      .smart_ptr<std::shared_ptr<apk::ApkHandle>>("shared_ptr<Apk>")
+      .class_function("open", &apk::ApkHandle::open)
+      .class_function("openBuffer", &apk::ApkHandle::openBuffer)
+      .class_function("openBlob", &apk::ApkHandle::openBlob)
+      .function("setMemoryBudget", &apk::ApkHandle::setMemoryBudget)
+      .function("isValid", &apk::ApkHandle::isValid)
+      .function("getFilePage", &apk::ApkHandle::getFilePage)
+      .function("listDirectory", &apk::ApkHandle::listDirectory)
+      .function("findDirectoryNode", &apk::ApkHandle::findDirectoryNode)
+      .function("getDirectoryNodePath", &apk::ApkHandle::getDirectoryNodePath)
+      .function("getAndroidManifestChunks", &apk::ApkHandle::getAndroidManifestChunks)
+      .function("getAndroidManifestTree", &apk::ApkHandle::getAndroidManifestTree)
+      .function("getFileContent", &apk::ApkHandle::getFileContent)
+      .function("releaseFileContent", &apk::ApkHandle::releaseFileContent)
+      .function("getContentTypes", &apk::ApkHandle::getContentTypes)
+      .function("grep", &apk::ApkHandle::grep)
+      .function("disassemble", &apk::ApkHandle::disassemble)
+      .function("exportProject", &apk::ApkHandle::exportProject)
+      .function("cancel", &apk::ApkHandle::cancel)
+      .function("getProperties", &apk::ApkHandle::getProperties)
+      .function("getPropertiesWithProgress", &apk::ApkHandle::getPropertiesWithProgress)
+      .function("getSummary", &apk::ApkHandle::getSummary)
+      .function("startFilePages", &apk::ApkHandle::startFilePages)
+      .function("startAndroidManifestChunks", &apk::ApkHandle::startAndroidManifestChunks)
+      .function("startExtract", &apk::ApkHandle::startExtract)
+      .function("loadMapping", &apk::ApkHandle::loadMapping)
+      .function("deobfuscateClassName", &apk::ApkHandle::deobfuscateClassName)
+      .function("startDisassemble", &apk::ApkHandle::startDisassemble)
+      .function("startPrefetch", &apk::ApkHandle::startPrefetch);
+
+  class_<apk::BundleHandle>("AppBundle")
+      .smart_ptr<std::shared_ptr<apk::BundleHandle>>("shared_ptr<AppBundle>")
+      .class_function("open", &apk::BundleHandle::open)
+      .class_function("openBuffer", &apk::BundleHandle::openBuffer)
+      .class_function("isBundlePath", &apk::BundleHandle::isBundlePath)
+      .function("getModules", &apk::BundleHandle::getModules)
+      .function("getFiles", &apk::BundleHandle::getFiles)
+      .function("getFileContent", &apk::BundleHandle::getFileContent)
+      .function("getAndroidManifest", &apk::BundleHandle::getAndroidManifest)
+      .function("getResourceValues", &apk::BundleHandle::getResourceValues)
+      .function("getProperties", &apk::BundleHandle::getProperties);
+
+  class_<ai::wasm::SlicedCall>("SlicedCall")
+      .smart_ptr<std::shared_ptr<ai::wasm::SlicedCall>>("shared_ptr<SlicedCall>")
+      .function("resume", &ai::wasm::SlicedCall::resume)
+      .function("isDone", &ai::wasm::SlicedCall::isDone);
 
   register_vector<std::string>("vector<string>");
 
@@ -87,72 +730,559 @@ EMSCRIPTEN_BINDINGS(ApkModule) {
 
 #else
 
+#include <algorithm>
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
+#include <cstdio>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "apk/apk.h"
+#include "apk/apk_corpus.h"
+#include "apk/app_bundle.h"
+#include "apk/size_report.h"
+#include "apk_server.h"
+#include "apk_watcher.h"
+#include "dex/apk_dex_files.h"
+#include "dex/dex_index.h"
+#include "dex/hook_table.h"
+#include "json_lines.h"
+#include "perf_check.h"
+#include "utils/file_output.h"
+#include "utils/format.h"
+#include "utils/log.h"
+#include "utils/macros.h"
+#include "utils/metrics.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
 
 namespace fs = boost::filesystem;
 namespace po = boost::program_options;
 
+namespace {
+
+struct PrintOptions {
+
+  bool manifest = false;
+
+  bool properties = false;
+
+  bool files = false;
+
+  //
+  // One JSON object per APK and line instead of text.
+  //
+  bool jsonLines = false;
+
+  //
+  // Time spent per phase, from the tracing spans, printed to stderr.
+  //
+  bool profile = false;
+};
+
+//
+// Writes JSON Lines to stdout through a large buffer, so that a scan of many
+// APKs makes one write call per few hundred lines rather than a flush per
+// line.
+//
+class JsonLinesWriter final {
+public:
+  JsonLinesWriter() = default;
+
+  DISALLOW_COPY_AND_ASSIGN(JsonLinesWriter);
+
+  ~JsonLinesWriter() { flush(); }
+
+  auto write(std::string const &apkPath, std::map<std::string, std::string> const &properties, std::optional<std::vector<std::string>> const &files,
+             std::string const &error) -> void {
+    TRACE_SPAN("cli::output");
+    ai::cli::appendApkJsonLine(buffer_, apkPath, properties, files, error);
+    if (buffer_.size() >= BUFFER_SIZE) {
+      flush();
+    }
+  }
+
+  auto flush() -> void {
+    std::fwrite(buffer_.data(), 1, buffer_.size(), stdout);
+    std::fflush(stdout);
+    buffer_.clear();
+  }
+
+private:
+  static constexpr size_t BUFFER_SIZE = 1024 * 1024;
+
+  std::string buffer_;
+};
+
+auto getFields(PrintOptions const &printOptions) -> ai::ApkPropertyFields {
+  return printOptions.manifest ? ai::ApkPropertyFields{ai::ApkPropertyField::Package, ai::ApkPropertyField::Version, ai::ApkPropertyField::Debuggable,
+                                                       ai::ApkPropertyField::Manifest, ai::ApkPropertyField::Sha256}
+                               : ai::ApkPropertyFields{ai::ApkPropertyField::Package, ai::ApkPropertyField::Version, ai::ApkPropertyField::Debuggable,
+                                                       ai::ApkPropertyField::Sha256};
+}
+
+auto printFiles(std::vector<std::string> const &files) -> void {
+  TRACE_SPAN("cli::output");
+  std::cout << std::endl << std::endl << "Files: " << std::endl;
+  for (auto const &file : files) {
+    std::cout << "    " << file << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+//
+// Prints an APK, or the base module of an app bundle, which answers the
+// same queries.
+//
+template <typename Document> auto printDocument(std::string const &apkPath, PrintOptions const &printOptions) -> void {
+  auto const apk = Document(apkPath);
+
+  if (printOptions.jsonLines) {
+    auto files = printOptions.files ? std::optional(apk.getFiles()) : std::nullopt;
+    JsonLinesWriter().write(apkPath, apk.getProperties(getFields(printOptions)), files, {});
+    return;
+  }
+
+  if (printOptions.manifest) {
+    auto const manifest = apk.getAndroidManifest();
+    TRACE_SPAN("cli::output");
+    std::cout << std::endl << std::endl << "Manifest: " << std::endl;
+    std::cout << std::endl << manifest << std::endl;
+  }
+
+  if (printOptions.properties) {
+    auto const properties = apk.getProperties();
+    TRACE_SPAN("cli::output");
+    std::cout << std::endl << std::endl << "Properties: " << std::endl;
+    for (auto const &[key, value] : properties) {
+      std::cout << "    " << key << "    " << value << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  if (printOptions.files) {
+    printFiles(apk.getFiles());
+  }
+}
+
+auto printApk(std::string const &apkPath, PrintOptions const &printOptions) -> void {
+  if (ai::AppBundle::isAppBundlePath(apkPath)) {
+    printDocument<ai::AppBundle>(apkPath, printOptions);
+  } else {
+    printDocument<ai::Apk>(apkPath, printOptions);
+  }
+}
+
+auto printSizeBuckets(std::string_view const title, std::vector<ai::SizeBucket> const &buckets) -> void {
+  std::cout << std::endl << title << ": " << std::endl;
+  for (auto const &bucket : buckets) {
+    std::cout << "    " << bucket.name << "    " << bucket.compressedSize << "    " << bucket.uncompressedSize << "    " << bucket.entryCount << std::endl;
+  }
+}
+
+//
+// Where the bytes of the APK go, from its central directory: compressed and
+// uncompressed bytes and entries per bucket, then the entries flagged.
+//
+auto printSizeReport(std::string const &apkPath, bool const jsonLines) -> void {
+  auto const report = ai::buildSizeReport(ai::Apk(apkPath).getEntries());
+  TRACE_SPAN("cli::output");
+  if (jsonLines) {
+    auto line = std::string();
+    ai::cli::appendSizeReportJsonLine(line, apkPath, report);
+    std::fwrite(line.data(), 1, line.size(), stdout);
+    return;
+  }
+  std::cout << "Size: " << report.compressedSize << " compressed, " << report.uncompressedSize << " uncompressed, " << report.entryCount << " entries"
+            << std::endl;
+  printSizeBuckets("Directories", report.directories);
+  printSizeBuckets("Types", report.types);
+  printSizeBuckets("ABIs", report.abis);
+  printSizeBuckets("Dex files", report.dexFiles);
+  std::cout << std::endl << "Flags: " << std::endl;
+  for (auto const &flag : report.flags) {
+    std::cout << "    " << flag.path << "    " << ai::getSizeIssueName(flag.issue) << "    " << flag.compressedSize << "    " << flag.uncompressedSize
+              << std::endl;
+  }
+}
+
+//
+// Resolves the hook specs against the dex files of the APK and writes the
+// table the agent installs them from.
+//
+auto writeHookTable(std::string const &apkPath, std::vector<std::string> const &specs, std::string const &outPath, ai::utils::ThreadPool &threadPool)
+    -> void {
+  auto const apk = ai::Apk(apkPath);
+  auto const dexFiles = ai::dex::ApkDexFiles(apk);
+  auto const index = ai::dex::DexIndex(dexFiles, threadPool);
+  auto const table = ai::dex::HookTable(dexFiles, index, specs);
+  for (auto const &spec : table.unmatchedSpecs()) {
+    std::cerr << "no method matches " << spec << std::endl;
+  }
+  auto const encoded = table.encode();
+  auto writer = ai::utils::FileWriter(outPath, encoded.size());
+  writer.write(encoded);
+  writer.close();
+  std::cout << "Wrote " << table.methodCount() << " methods of " << table.classes().size() << " classes to " << outPath << std::endl;
+}
+
+//
+// Phase a span counts toward in --profile, or nothing for the spans of whole
+// operations, which contain the phases.
+//
+auto getPhase(std::string_view const spanName) -> std::string_view {
+  if (spanName == "ZipArchiver::index") {
+    return "central directory scan";
+  }
+  if (spanName.starts_with("ZipArchiver::")) {
+    return "inflate";
+  }
+  if (spanName.starts_with("BinaryXml::")) {
+    return "binary xml decode";
+  }
+  if (spanName == "StringPool::decodeUtf16") {
+    return "string transcoding";
+  }
+  if (spanName == "Apk::sha256" || spanName == "Apk::hashEntries") {
+    return "hashing";
+  }
+  if (spanName == "cli::output") {
+    return "output";
+  }
+  return {};
+}
+
+//
+// Prints the time spent per phase and per span since the last call, then
+// starts over.  Spans overlap where they nest, and work done on other
+// threads, e.g. hashing, overlaps with the calling thread.
+//
+auto printProfile(std::string const &label) -> void {
+  auto const summaries = ai::utils::trace::summarize();
+  ai::utils::trace::clear();
+  auto phases = std::map<std::string_view, double>();
+  for (auto const &summary : summaries) {
+    if (auto const phase = getPhase(summary.name); !phase.empty()) {
+      phases[phase] += summary.totalMicroseconds;
+    }
+  }
+  std::cerr << std::endl << "Profile: " << label << std::endl;
+  for (auto const &[phase, microseconds] : phases) {
+    std::cerr << ai::utils::format::format("    {:<24}{:>12.3f} ms", phase, microseconds / 1000) << std::endl;
+  }
+  std::cerr << std::endl;
+  for (auto const &summary : summaries) {
+    std::cerr << ai::utils::format::format("    {:<32}{:>10} calls{:>12.3f} ms total{:>12.3f} ms max", summary.name, summary.count,
+                                           summary.totalMicroseconds / 1000, summary.maxMicroseconds / 1000)
+              << std::endl;
+  }
+}
+
+//
+// Prints an APK analyzed with the batch API the way --file prints it.
+//
+auto printBatchResult(ai::ApkBatchResult const &result, PrintOptions const &printOptions) -> void {
+  TRACE_SPAN("cli::output");
+  std::cout << std::endl << "Apk: " << result.path << std::endl;
+  if (!result.error.empty()) {
+    std::cout << "    error    " << result.error << std::endl;
+    return;
+  }
+  if (printOptions.manifest) {
+    std::cout << std::endl << std::endl << "Manifest: " << std::endl;
+    std::cout << std::endl << result.properties.at("manifest") << std::endl;
+  }
+  if (printOptions.properties) {
+    std::cout << std::endl << std::endl << "Properties: " << std::endl;
+    for (auto const &[key, value] : result.properties) {
+      if (key != "manifest") {
+        std::cout << "    " << key << "    " << value << std::endl;
+      }
+    }
+    std::cout << std::endl;
+  }
+  if (printOptions.files) {
+    printFiles(ai::Apk(result.path).getFiles());
+  }
+}
+
+//
+// Analyzes every APK found with the batch API, on jobs threads, and prints
+// each one as soon as it is done, so the output is in completion order.
+//
+auto scanDirectory(fs::path const &directory, bool const recursive, size_t const jobs, PrintOptions const &printOptions) -> int {
+  auto const apkPaths = ai::cli::findApks(directory.string(), recursive);
+  auto options = ai::ApkBatchOptions();
+  options.fields = getFields(printOptions);
+
+  auto failures = size_t(0);
+  auto threadPool = ai::utils::ThreadPool(jobs > 0 ? jobs : ai::utils::ThreadPool::defaultThreadCount());
+  if (printOptions.jsonLines) {
+    auto writer = JsonLinesWriter();
+    ai::analyzeMany(apkPaths, options, threadPool, [&failures, &printOptions, &writer](ai::ApkBatchResult result) {
+      failures += result.error.empty() ? 0 : 1;
+      auto files = printOptions.files && result.error.empty() ? std::optional(ai::Apk(result.path).getFiles()) : std::nullopt;
+      writer.write(result.path, result.properties, files, result.error);
+    });
+    if (printOptions.profile) {
+      printProfile(ai::utils::format::format("{} apks", apkPaths.size()));
+    }
+    return failures == 0 ? 0 : -4;
+  }
+  ai::analyzeMany(apkPaths, options, threadPool, [&failures, &printOptions](ai::ApkBatchResult result) {
+    failures += result.error.empty() ? 0 : 1;
+    printBatchResult(result, printOptions);
+  });
+  std::cout << std::endl << "Scanned " << apkPaths.size() << " apks, " << failures << " failed" << std::endl;
+  if (printOptions.profile) {
+    printProfile(ai::utils::format::format("{} apks", apkPaths.size()));
+  }
+  return failures == 0 ? 0 : -4;
+}
+
+//
+// Prints every APK in the directory, then every APK added or changed, as
+// soon as it is analyzed, until the CLI is stopped.
+//
+auto watchDirectory(ai::cli::ApkWatchOptions &options, size_t const jobs, PrintOptions const &printOptions) -> int {
+  options.fields = getFields(printOptions);
+  auto threadPool = ai::utils::ThreadPool(jobs > 0 ? jobs : ai::utils::ThreadPool::defaultThreadCount());
+  if (printOptions.jsonLines) {
+    auto writer = JsonLinesWriter();
+    return ai::cli::watchApks(options, threadPool, [&printOptions, &writer](ai::ApkBatchResult result) {
+      auto files = printOptions.files && result.error.empty() ? std::optional(ai::Apk(result.path).getFiles()) : std::nullopt;
+      writer.write(result.path, result.properties, files, result.error);
+      writer.flush();
+    });
+  }
+  return ai::cli::watchApks(options, threadPool, [&printOptions](ai::ApkBatchResult result) {
+    printBatchResult(result, printOptions);
+    std::cout << std::flush;
+  });
+}
+
+//
+// Writes an APK of every corpus shape named, or of all of them, to
+// <directory>/<shape>.apk.  Shapes are generated one at a time, each one
+// compressing its entries on jobs threads.
+//
+auto generateCorpus(std::string const &directory, std::vector<std::string> const &shapeNames, size_t const jobs) -> int {
+  auto shapes = ai::getApkCorpusShapes();
+  for (auto const &shapeName : shapeNames) {
+    if (std::none_of(shapes.begin(), shapes.end(), [&shapeName](auto const &shape) { return shape.name == shapeName; })) {
+      std::cerr << "unknown corpus shape " << shapeName << std::endl;
+      return -2;
+    }
+  }
+  fs::create_directories(directory);
+  auto threadPool = ai::utils::ThreadPool(jobs > 0 ? jobs : ai::utils::ThreadPool::defaultThreadCount());
+  for (auto const &shape : shapes) {
+    if (!shapeNames.empty() && std::find(shapeNames.begin(), shapeNames.end(), shape.name) == shapeNames.end()) {
+      continue;
+    }
+    auto const apkPath = (fs::path(directory) / (shape.name + ".apk")).string();
+    ai::generateCorpusApk(apkPath, shape, threadPool);
+    std::cout << "Generated " << apkPath << std::endl;
+  }
+  return 0;
+}
+
+} // namespace
+
 auto main(int argc, char *argv[]) -> int {
 
+  auto const asyncLogging = ai::utils::log::AsyncLogging();
+
+  std::string command_argument;
   std::string file_argument;
-  bool print_manifest;
-  bool print_properties;
-  bool print_files;
+  std::string dir_argument;
+  std::string out_argument;
+  auto extract_options = ai::ApkExtractOptions();
+  std::vector<std::string> pattern_arguments;
+  bool ignore_case;
+  std::vector<std::string> shape_arguments;
+  auto perf_check_options = ai::cli::PerfCheckOptions();
+  std::string format_argument;
+  auto server_options = ai::cli::ApkServerOptions();
+  auto watch_options = ai::cli::ApkWatchOptions();
+  bool recursive;
+  size_t jobs;
+  auto print_options = PrintOptions();
+  bool print_stats;
 
   try {
     po::options_description desc{"Options"};
     desc.add_options()
       ("help,h", "Help screen")
-      ("manifest,pm", po::bool_switch(&print_manifest), "Print manifest in apk")
-      ("properties,pp", po::bool_switch(&print_properties), "Print properties in apk")
-      ("files,pf", po::bool_switch(&print_files), "Print files in apk")
-      ("file,f", po::value<std::string>(&file_argument)->required(), "file path to apk");
+      ("manifest,pm", po::bool_switch(&print_options.manifest), "Print manifest in apk")
+      ("properties,pp", po::bool_switch(&print_options.properties), "Print properties in apk")
+      ("files,pf", po::bool_switch(&print_options.files), "Print files in apk")
+      ("stats,ps", po::bool_switch(&print_stats), "Print I/O and cache counters after the other output")
+      ("profile", po::bool_switch(&print_options.profile), "Print the time spent per phase to stderr, for every apk with --file or for all of them with --dir")
+      ("file,f", po::value<std::string>(&file_argument), "file path to apk, or to app bundle if it ends in .aab")
+      ("dir,d", po::value<std::string>(&dir_argument), "directory of apks to scan, printed as each one finishes")
+      ("watch", po::value<std::string>(&watch_options.directory), "directory of apks to print, then to print apks of as they are added or changed")
+      ("poll-interval", po::value<uint32_t>(&watch_options.pollIntervalMilliseconds)->default_value(2000), "milliseconds between listings of --watch")
+      ("recursive,r", po::bool_switch(&recursive), "Scan the subdirectories of --dir or --watch too")
+      ("jobs,j", po::value<size_t>(&jobs)->default_value(0), "apks analyzed at once with --dir or --watch; 0 for one per core")
+      ("format", po::value<std::string>(&format_argument)->default_value("text"), "text, or jsonl for one JSON object per apk and line")
+      ("serve", po::value<std::string>(&server_options.socketPath), "Unix socket to serve analysis requests on, keeping apks open between them")
+      ("cache-dir", po::value<std::string>(&server_options.cacheDirectory), "analysis cache of --serve or --watch")
+      ("max-open-apks", po::value<size_t>(&server_options.maxOpenApks)->default_value(64), "apks --serve keeps open")
+      ("command", po::value<std::string>(&command_argument), "extract, to write files of --file to --out, grep, to search them, size-report, to sum their sizes, hook-table, to resolve hooks in them, generate-corpus, for scale-test apks, or perf-check")
+      ("include", po::value<std::vector<std::string>>(&extract_options.include)->composing(), "glob of the files to extract or grep, e.g. res/**/*.xml; all if none")
+      ("pattern,e", po::value<std::vector<std::string>>(&pattern_arguments)->composing(), "bytes grep looks for in the files of --file, or hook spec of hook-table, e.g. org.fdroid.fdroid.FDroidApp.onCreate()V")
+      ("ignore-case,i", po::bool_switch(&ignore_case), "Match ASCII letters of --pattern in either case")
+      ("decode-xml", po::bool_switch(&extract_options.decodeXml), "Extract binary xml files as text")
+      ("shape", po::value<std::vector<std::string>>(&shape_arguments)->composing(), "corpus shape to generate, e.g. tiny-entries; all if none")
+      ("out,o", po::value<std::string>(&out_argument), "directory to extract or generate to, or file hook-table writes")
+      ("baseline", po::value<std::string>(&perf_check_options.baselinePath), "benchmark JSON perf-check compares --current with")
+      ("current", po::value<std::string>(&perf_check_options.currentPath), "benchmark JSON of the run perf-check checks, e.g. from apk_bench_json")
+      ("tolerance", po::value<double>(&perf_check_options.tolerancePercent)->default_value(5.0), "slowdown in percent perf-check flags");
+
+    auto positional = po::positional_options_description();
+    positional.add("command", 1);
 
     po::variables_map vm;
-    po::store(parse_command_line(argc, argv, desc), vm);
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
     po::notify(vm);
+    if (command_argument == "generate-corpus") {
+      if (vm.count("out") == 0) {
+        throw po::error("generate-corpus needs --out");
+      }
+    } else if (command_argument == "perf-check") {
+      if (vm.count("baseline") == 0 || vm.count("current") == 0) {
+        throw po::error("perf-check needs --baseline and --current");
+      }
+    } else if (command_argument == "grep") {
+      if (vm.count("file") == 0 || vm.count("pattern") == 0) {
+        throw po::error("grep needs --file and --pattern");
+      }
+    } else if (command_argument == "size-report") {
+      if (vm.count("file") == 0) {
+        throw po::error("size-report needs --file");
+      }
+    } else if (command_argument == "hook-table") {
+      if (vm.count("file") == 0 || vm.count("pattern") == 0 || vm.count("out") == 0) {
+        throw po::error("hook-table needs --file, --pattern and --out");
+      }
+    } else if (!command_argument.empty() && (command_argument != "extract" || vm.count("file") == 0 || vm.count("out") == 0)) {
+      throw po::error("the commands are extract, which needs --file and --out, grep, which needs --file and --pattern, size-report, which needs --file, "
+                      "hook-table, which needs --file, --pattern and --out, generate-corpus, which needs --out, and perf-check");
+    } else if (vm.count("serve") == 0 && vm.count("file") + vm.count("dir") + vm.count("watch") != 1) {
+      throw po::error("exactly one of --file, --dir, --watch and --serve is required");
+    }
+    if (format_argument != "text" && format_argument != "jsonl") {
+      throw po::error("format must be text or jsonl");
+    }
+    print_options.jsonLines = format_argument == "jsonl";
   } catch (const po::error &ex) {
     std::cerr << ex.what() << '\n';
     return -1;
   }
 
-  const fs::path file_path(file_argument);
-  if (!fs::exists(file_path)) {
-    std::cerr << "file path does not exist; please check path" << std::endl;
-    return -2;
-  }
+  ai::utils::trace::setEnabled(print_options.profile);
 
-  if (fs::is_directory(file_path)) {
-    std::cerr << "file path is a directory; please check path" << std::endl;
-    return -3;
+  if (!server_options.socketPath.empty()) {
+    return ai::cli::serveApks(server_options);
   }
 
-  auto const apk = ai::Apk(file_argument);
+  auto result = 0;
+  if (command_argument == "generate-corpus") {
+    result = generateCorpus(out_argument, shape_arguments, jobs);
+  } else if (command_argument == "perf-check") {
+    result = ai::cli::checkPerformance(perf_check_options);
+  } else if (command_argument == "extract") {
+    const fs::path file_path(file_argument);
+    if (!fs::is_regular_file(file_path)) {
+      std::cerr << "file path is not a file; please check path" << std::endl;
+      return -2;
+    }
+    auto threadPool = ai::utils::ThreadPool(jobs > 0 ? jobs : ai::utils::ThreadPool::defaultThreadCount());
+    auto const extracted = ai::Apk(file_argument).extract(out_argument, extract_options, threadPool);
+    std::cout << "Extracted " << extracted << " files to " << out_argument << std::endl;
+    if (print_options.profile) {
+      printProfile(file_argument);
+    }
+  } else if (command_argument == "grep") {
+    if (!fs::is_regular_file(fs::path(file_argument))) {
+      std::cerr << "file path is not a file; please check path" << std::endl;
+      return -2;
+    }
+    auto options = ai::ApkGrepOptions();
+    options.include = extract_options.include;
+    options.caseSensitive = !ignore_case;
+    auto threadPool = ai::utils::ThreadPool(jobs > 0 ? jobs : ai::utils::ThreadPool::defaultThreadCount());
+    for (auto const &match : ai::Apk(file_argument).grep(pattern_arguments, options, threadPool)) {
+      std::cout << match.path << ":" << match.offset << ": " << pattern_arguments[match.pattern] << std::endl;
+    }
+    if (print_options.profile) {
+      printProfile(file_argument);
+    }
+  } else if (command_argument == "size-report") {
+    if (!fs::is_regular_file(fs::path(file_argument))) {
+      std::cerr << "file path is not a file; please check path" << std::endl;
+      return -2;
+    }
+    printSizeReport(file_argument, print_options.jsonLines);
+    if (print_options.profile) {
+      printProfile(file_argument);
+    }
+  } else if (command_argument == "hook-table") {
+    if (!fs::is_regular_file(fs::path(file_argument))) {
+      std::cerr << "file path is not a file; please check path" << std::endl;
+      return -2;
+    }
+    auto threadPool = ai::utils::ThreadPool(jobs > 0 ? jobs : ai::utils::ThreadPool::defaultThreadCount());
+    writeHookTable(file_argument, pattern_arguments, out_argument, threadPool);
+    if (print_options.profile) {
+      printProfile(file_argument);
+    }
+  } else if (!watch_options.directory.empty()) {
+    if (!fs::is_directory(fs::path(watch_options.directory))) {
+      std::cerr << "watch path is not a directory; please check path" << std::endl;
+      return -2;
+    }
+    watch_options.recursive = recursive;
+    watch_options.cacheDirectory = server_options.cacheDirectory;
+    result = watchDirectory(watch_options, jobs, print_options);
+  } else if (!dir_argument.empty()) {
+    const fs::path dir_path(dir_argument);
+    if (!fs::is_directory(dir_path)) {
+      std::cerr << "dir path is not a directory; please check path" << std::endl;
+      return -2;
+    }
+    result = scanDirectory(dir_path, recursive, jobs, print_options);
+  } else {
+    const fs::path file_path(file_argument);
+    if (!fs::exists(file_path)) {
+      std::cerr << "file path does not exist; please check path" << std::endl;
+      return -2;
+    }
 
-  if (print_manifest) {
-    std::cout << std::endl << std::endl << "Manifest: " << std::endl;
-    std::cout << std::endl << apk.getAndroidManifest() << std::endl;
-  }
+    if (fs::is_directory(file_path)) {
+      std::cerr << "file path is a directory; please check path" << std::endl;
+      return -3;
+    }
 
-  if (print_properties) {
-    std::cout << std::endl << std::endl << "Properties: " << std::endl;
-    for (auto const &[key, value] : apk.getProperties()) {
-      std::cout << "    " << key << "    " << value << std::endl;
+    printApk(file_argument, print_options);
+    if (print_options.profile) {
+      printProfile(file_argument);
     }
-    std::cout << std::endl;
   }
 
-  if (print_files) {
-    std::cout << std::endl << std::endl << "Files: " << std::endl;
-    for (auto const file : apk.getFiles()) {
-      std::cout << "    " << file << std::endl;
+  if (print_stats) {
+    std::cout << std::endl << std::endl << "Stats: " << std::endl;
+    for (auto const &[name, value] : ai::utils::metrics::snapshot()) {
+      std::cout << "    " << name << "    " << value << std::endl;
     }
     std::cout << std::endl;
   }
+  return result;
 }
 
 #endif
@@ -0,0 +1,160 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <iostream>
+#include <map>
+#include <string_view>
+
+#include "perf_check.h"
+#include "utils/format.h"
+
+using namespace ai;
+
+namespace pt = boost::property_tree;
+
+namespace {
+
+static constexpr std::string_view REFERENCE_PREFIX = "ApkAnalyzer_";
+
+static constexpr std::string_view REFERENCED_PREFIX = "Apk_";
+
+struct BenchmarkTime {
+
+  double nanoseconds;
+
+  //
+  // Coefficient of variation of the repetitions, in percent; 0 without
+  // repetitions.
+  //
+  double noisePercent = 0;
+};
+
+auto toNanoseconds(double const time, std::string const &unit) -> double {
+  if (unit == "us") {
+    return time * 1e3;
+  }
+  if (unit == "ms") {
+    return time * 1e6;
+  }
+  if (unit == "s") {
+    return time * 1e9;
+  }
+  return time;
+}
+
+//
+// Real time of every benchmark of a Google Benchmark JSON output, by run
+// name: the median of the repetitions when there are any, else the time of
+// the single run.  Runs that failed or were skipped are left out.
+//
+auto readBenchmarks(std::string const &path) -> std::map<std::string, BenchmarkTime> {
+  auto tree = pt::ptree();
+  pt::read_json(path, tree);
+  auto benchmarks = std::map<std::string, BenchmarkTime>();
+  auto medians = std::map<std::string, double>();
+  auto noises = std::map<std::string, double>();
+  for (auto const &[key, benchmark] : tree.get_child("benchmarks")) {
+    if (benchmark.get("error_occurred", false)) {
+      continue;
+    }
+    auto const runName = benchmark.get("run_name", benchmark.get<std::string>("name"));
+    auto const realTime = benchmark.get<double>("real_time");
+    auto const aggregateName = benchmark.get("aggregate_name", std::string());
+    if (benchmark.get("run_type", std::string("iteration")) == "iteration") {
+      benchmarks.try_emplace(runName, BenchmarkTime{toNanoseconds(realTime, benchmark.get("time_unit", std::string("ns")))});
+    } else if (aggregateName == "median") {
+      medians[runName] = toNanoseconds(realTime, benchmark.get("time_unit", std::string("ns")));
+    } else if (aggregateName == "cv") {
+      noises[runName] = realTime * 100;
+    }
+  }
+  for (auto const &[runName, median] : medians) {
+    benchmarks[runName].nanoseconds = median;
+  }
+  for (auto const &[runName, noise] : noises) {
+    if (auto const found = benchmarks.find(runName); found != benchmarks.end()) {
+      found->second.noisePercent = noise;
+    }
+  }
+  return benchmarks;
+}
+
+auto isReference(std::string_view const name) -> bool { return name.starts_with(REFERENCE_PREFIX); }
+
+//
+// Speed of our Apk_* benchmarks relative to the apkanalyzer run that does
+// the same on the same corpus.
+//
+auto printReferences(std::map<std::string, BenchmarkTime> const &benchmarks) -> void {
+  for (auto const &[name, reference] : benchmarks) {
+    if (!isReference(name)) {
+      continue;
+    }
+    auto const referenced = std::string(REFERENCED_PREFIX) + name.substr(REFERENCE_PREFIX.size());
+    if (auto const found = benchmarks.find(referenced); found != benchmarks.end() && found->second.nanoseconds > 0) {
+      std::cout << utils::format::format("{:<48} {:>10.1f}x apkanalyzer", referenced, reference.nanoseconds / found->second.nanoseconds) << std::endl;
+    }
+  }
+}
+
+} // namespace
+
+auto ai::cli::checkPerformance(PerfCheckOptions const &options) -> int {
+  auto baseline = std::map<std::string, BenchmarkTime>();
+  auto current = std::map<std::string, BenchmarkTime>();
+  try {
+    baseline = readBenchmarks(options.baselinePath);
+    current = readBenchmarks(options.currentPath);
+  } catch (pt::ptree_error const &exception) {
+    std::cerr << "unable to read benchmarks; " << exception.what() << std::endl;
+    return -2;
+  }
+
+  auto compared = size_t(0);
+  auto regressions = size_t(0);
+  std::cout << utils::format::format("{:<48} {:>14} {:>14} {:>9}", "benchmark", "baseline ns", "current ns", "change") << std::endl;
+  for (auto const &[name, time] : current) {
+    auto const found = baseline.find(name);
+    if (isReference(name) || found == baseline.end() || found->second.nanoseconds <= 0) {
+      continue;
+    }
+    auto const change = (time.nanoseconds / found->second.nanoseconds - 1) * 100;
+    auto const band = std::max(options.tolerancePercent, 2 * found->second.noisePercent);
+    auto const status = change > band ? " REGRESSED" : change < -band ? " improved" : "";
+    compared++;
+    regressions += change > band ? 1 : 0;
+    std::cout << utils::format::format("{:<48} {:>14.1f} {:>14.1f} {:>+8.1f}%{}", name, found->second.nanoseconds, time.nanoseconds, change, status)
+              << std::endl;
+  }
+  for (auto const &[name, time] : baseline) {
+    if (!isReference(name) && !current.contains(name)) {
+      std::cout << utils::format::format("{:<48} missing from the current run", name) << std::endl;
+    }
+  }
+  printReferences(current);
+  std::cout << std::endl << regressions << " of " << compared << " benchmarks regressed past " << options.tolerancePercent << "%" << std::endl;
+  return regressions == 0 ? 0 : -6;
+}
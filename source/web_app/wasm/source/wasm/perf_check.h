@@ -0,0 +1,63 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_WASM_PERF_CHECK_H_
+#define ANDROID_INTROSPECTION_WASM_PERF_CHECK_H_
+
+#include <string>
+
+namespace ai::cli {
+
+struct PerfCheckOptions {
+
+  //
+  // Google Benchmark JSON outputs, e.g. the checked-in baseline and the
+  // output of the apk_bench_json target.
+  //
+  std::string baselinePath;
+
+  std::string currentPath;
+
+  //
+  // Most a benchmark may slow down, in percent of its baseline time, before
+  // it is flagged.
+  //
+  double tolerancePercent = 5.0;
+};
+
+//
+// Compares every benchmark of the current run with the baseline and prints
+// one line each, with the change in time.  Runs with repetitions are
+// compared by their medians, and the band of a benchmark is widened to
+// twice its coefficient of variation in the baseline when that is larger
+// than the tolerance, so that noisy ones are not flagged.  ApkAnalyzer_*
+// benchmarks time apkanalyzer rather than this code, so they are only
+// reported against the matching Apk_* benchmark.
+//
+// Returns the exit code of the CLI: -6 if any benchmark regressed.
+//
+auto checkPerformance(PerfCheckOptions const &options) -> int;
+
+} // namespace ai::cli
+
+#endif /* ANDROID_INTROSPECTION_WASM_PERF_CHECK_H_ */
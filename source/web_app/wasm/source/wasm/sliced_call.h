@@ -0,0 +1,85 @@
+//
+// MIT License
+//
+// Copyright 2019-2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef ANDROID_INTROSPECTION_WASM_SLICED_CALL_H_
+#define ANDROID_INTROSPECTION_WASM_SLICED_CALL_H_
+
+#include <chrono>
+#include <functional>
+#include <utility>
+
+#include "utils/macros.h"
+
+namespace ai::wasm {
+
+//
+// A long call cut into steps, e.g. a page of paths, a chunk of text, a file
+// or a class, which JS resumes for at most a time budget at a time, going
+// back to its event loop in between.  Without pthreads every call runs on
+// the one thread of the worker, so this keeps it answering other messages
+// and lets small requests through while a large one is under way.  Each
+// call holds what it reads from, so it may outlive the handle it came from.
+//
+class SlicedCall final {
+public:
+  //
+  // Does one step and returns whether there are more.
+  //
+  using Step = std::function<bool()>;
+
+  explicit SlicedCall(Step step) : step_(std::move(step)) {}
+
+  DISALLOW_COPY_AND_ASSIGN(SlicedCall);
+
+  //
+  // Runs steps until the call is done or budgetMs went by, at least one,
+  // and returns whether it is done.  An exception of a step, e.g. of a
+  // memory budget, ends the call and goes to JS.
+  //
+  auto resume(double const budgetMs) -> bool {
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(budgetMs);
+    while (!done_) {
+      try {
+        done_ = !step_();
+      } catch (...) {
+        done_ = true;
+        throw;
+      }
+      if (std::chrono::steady_clock::now() >= deadline) {
+        break;
+      }
+    }
+    return done_;
+  }
+
+  auto isDone() const -> bool { return done_; }
+
+private:
+  Step const step_;
+
+  bool done_ = false;
+};
+
+} // namespace ai::wasm
+
+#endif /* ANDROID_INTROSPECTION_WASM_SLICED_CALL_H_ */
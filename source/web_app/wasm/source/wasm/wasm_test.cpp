@@ -0,0 +1,228 @@
+//
+// MIT License
+//
+// Copyright 2020
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "apk_server.h"
+#include "apk_watcher.h"
+#include "sliced_call.h"
+#include "utils/thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+//
+// Serves on a socket of its own in the background for the rest of the
+// tests; the server only returns when its listener fails.
+//
+auto startServer(char const *name) -> std::string {
+  auto const socketPath = (fs::temp_directory_path() / name).string();
+  auto options = ai::cli::ApkServerOptions();
+  options.socketPath = socketPath;
+  std::thread([options] { ai::cli::serveApks(options); }).detach();
+  return socketPath;
+}
+
+//
+// A connection to the server, failing reads after a second.
+//
+auto connect(std::string const &socketPath) -> int {
+  auto address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  socketPath.copy(address.sun_path, sizeof(address.sun_path) - 1);
+  auto const connection = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  auto const timeout = timeval{.tv_sec = 1, .tv_usec = 0};
+  ::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  for (auto attempt = 0; attempt < 100; ++attempt) {
+    if (::connect(connection, reinterpret_cast<sockaddr const *>(&address), sizeof(address)) == 0) {
+      return connection;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ::close(connection);
+  return -1;
+}
+
+auto sendAll(int const connection, std::string_view bytes) -> void {
+  while (!bytes.empty()) {
+    auto const bytesSent = ::send(connection, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+    if (bytesSent <= 0) {
+      return;
+    }
+    bytes.remove_prefix(static_cast<size_t>(bytesSent));
+  }
+}
+
+//
+// The next line from the server, empty if none came in time or the server
+// closed the connection.
+//
+auto readLine(int const connection) -> std::string {
+  auto line = std::string();
+  auto byte = char();
+  while (::read(connection, &byte, 1) == 1) {
+    if (byte == '\n') {
+      return line;
+    }
+    line += byte;
+  }
+  return {};
+}
+
+} // namespace
+
+TEST(ApkServer, moreIdleConnectionsThanWorkers_NewConnectionIsAnswered) {
+  auto const socketPath = startServer("moreIdleConnectionsThanWorkers.sock");
+  auto idleConnections = std::vector<int>();
+  for (auto index = size_t(0); index <= ai::utils::ThreadPool::shared().threadCount(); ++index) {
+    idleConnections.push_back(connect(socketPath));
+    ASSERT_GE(idleConnections.back(), 0);
+  }
+
+  auto const connection = connect(socketPath);
+  ASSERT_GE(connection, 0);
+  sendAll(connection, "stats\nstats\n");
+  EXPECT_NE(readLine(connection).find(R"("path":"")"), std::string::npos);
+  EXPECT_NE(readLine(connection).find(R"("path":"")"), std::string::npos);
+
+  ::close(connection);
+  for (auto const idleConnection : idleConnections) {
+    ::close(idleConnection);
+  }
+}
+
+TEST(ApkServer, requestForMissingApk_ErrorIsAnsweredAndConnectionStaysOpen) {
+  auto const socketPath = startServer("requestForMissingApk.sock");
+  auto const connection = connect(socketPath);
+  ASSERT_GE(connection, 0);
+
+  sendAll(connection, "properties /missing.apk\n");
+  EXPECT_NE(readLine(connection).find(R"("error":)"), std::string::npos);
+  sendAll(connection, "unknown\n");
+  EXPECT_NE(readLine(connection).find(R"("error":"unknown command")"), std::string::npos);
+
+  ::close(connection);
+}
+
+TEST(ApkServer, requestLongerThanTheLimit_ConnectionIsClosed) {
+  auto const socketPath = startServer("requestLongerThanTheLimit.sock");
+  auto const connection = connect(socketPath);
+  ASSERT_GE(connection, 0);
+
+  sendAll(connection, std::string(256 * 1024, 'a'));
+  EXPECT_NE(readLine(connection).find(R"("error":"request too long")"), std::string::npos);
+  auto byte = char();
+  EXPECT_LE(::read(connection, &byte, 1), 0);
+
+  ::close(connection);
+}
+
+TEST(ApkWatcher, apkThatFailsToBeAnalyzed_IsAnalyzedAgainWithTheNextChange) {
+  auto const directory = fs::temp_directory_path() / "apkThatFailsToBeAnalyzed";
+  fs::remove_all(directory);
+  fs::create_directories(directory);
+  auto const writeFile = [&directory](char const *name) { std::ofstream(directory / name) << "not an apk"; };
+  writeFile("broken.apk");
+
+  auto options = ai::cli::ApkWatchOptions();
+  options.directory = directory.string();
+  options.fields = {ai::ApkPropertyField::Package};
+  options.pollIntervalMilliseconds = 50;
+  options.cancellation = ai::utils::CancellationToken::create();
+  auto const cancellation = options.cancellation;
+  auto timeout = std::thread([&cancellation] {
+    for (auto waited = 0; waited < 1000 && !cancellation.isCancelled(); waited++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    cancellation.cancel();
+  });
+
+  auto brokenResults = 0;
+  auto otherResults = 0;
+  auto threadPool = ai::utils::ThreadPool(2);
+  auto const exitCode = ai::cli::watchApks(options, threadPool, [&](ai::ApkBatchResult const &result) {
+    auto const name = fs::path(result.path).filename();
+    if (name == "broken.apk" && ++brokenResults == 1) {
+      writeFile("other.apk");
+    } else if (name == "other.apk") {
+      otherResults++;
+    }
+    if (brokenResults >= 2 && otherResults >= 1) {
+      cancellation.cancel();
+    }
+  });
+  timeout.join();
+
+  EXPECT_EQ(exitCode, 0);
+  EXPECT_EQ(brokenResults, 2);
+  EXPECT_EQ(otherResults, 1);
+  fs::remove_all(directory);
+}
+
+TEST(SlicedCall, resumeWithoutBudget_RunsOneStepAtATime) {
+  auto steps = 0;
+  auto call = ai::wasm::SlicedCall([&steps] { return ++steps < 3; });
+  EXPECT_FALSE(call.isDone());
+  EXPECT_FALSE(call.resume(0));
+  EXPECT_EQ(steps, 1);
+  EXPECT_FALSE(call.resume(0));
+  EXPECT_EQ(steps, 2);
+  EXPECT_TRUE(call.resume(0));
+  EXPECT_EQ(steps, 3);
+  EXPECT_TRUE(call.isDone());
+  EXPECT_TRUE(call.resume(0));
+  EXPECT_EQ(steps, 3);
+}
+
+TEST(SlicedCall, resumeWithinBudget_RunsStepsUntilDone) {
+  auto steps = 0;
+  auto call = ai::wasm::SlicedCall([&steps] { return ++steps < 100; });
+  EXPECT_TRUE(call.resume(60 * 1000));
+  EXPECT_EQ(steps, 100);
+}
+
+TEST(SlicedCall, stepThatThrows_EndsTheCall) {
+  auto steps = 0;
+  auto call = ai::wasm::SlicedCall([&steps]() -> bool {
+    if (++steps == 2) {
+      throw std::runtime_error("memory budget exceeded");
+    }
+    return true;
+  });
+  EXPECT_FALSE(call.resume(0));
+  EXPECT_THROW(call.resume(60 * 1000), std::runtime_error);
+  EXPECT_TRUE(call.isDone());
+  EXPECT_TRUE(call.resume(60 * 1000));
+  EXPECT_EQ(steps, 2);
+}
@@ -0,0 +1,135 @@
+//
+// Runs batch jobs, e.g. the analysis of many apks, on workers that each
+// have an instance of the module.  Pages that are not cross origin isolated
+// have no SharedArrayBuffer and so no threaded build; separate instances
+// still put every core to work, without sharing memory.
+//
+// Jobs wait in one queue that idle workers take from, so a large apk does
+// not hold up the ones behind it on other workers.  The apk of a job is
+// transferred to its worker, and the caller must not use it afterwards.
+//
+// Job types, see apk_worker.js:
+//
+//   { type: 'properties', buffer }  ApkProperties of the apk
+//   { type: 'summary', buffer }  same, package and version only
+//   { type: 'manifestTree', buffer }  JSON of the manifest tree
+//   { type: 'extract', buffer, filter }  [{ path, bytes }] of the files
+//
+// A worker that fails to instantiate the module, or whose module aborts,
+// is left out, failing the job it was running; the queue goes on on the
+// workers left, and jobs fail once no worker is left.
+//
+
+//
+// Workers started by default.  Each holds a heap with the apk it works on,
+// so more than a few cost memory the cores can't make up for.
+//
+const MAX_DEFAULT_WORKER_COUNT = 4
+
+class WasmWorkerPool {
+  //
+  // workerUrl is apk-worker.js, loaderUrl the .wasm.js loader of a build
+  // without threads, and module that build compiled once by the page; it
+  // is posted to every worker rather than compiled by each.
+  //
+  constructor({ workerUrl, loaderUrl, module, workerCount = WasmWorkerPool.defaultWorkerCount() }) {
+    this.workers = []
+    this.queue = []
+    this.pending = new Map()
+    this.nextId = 0
+    for (let i = 0; i < workerCount; i++) {
+      const worker = { worker: new Worker(workerUrl), ready: false, jobId: null }
+      worker.worker.onmessage = ({ data }) => this.onMessage(worker, data)
+      worker.worker.onerror = event => this.onFailed(worker, event.message)
+      worker.worker.postMessage({ type: 'init', loaderUrl, module })
+      this.workers.push(worker)
+    }
+  }
+
+  static defaultWorkerCount() {
+    return Math.max(1, Math.min(self.navigator.hardwareConcurrency || 1, MAX_DEFAULT_WORKER_COUNT))
+  }
+
+  //
+  // Queues a job and resolves with its result, or rejects with the message
+  // of what the module threw.
+  //
+  run(job) {
+    return new Promise((resolve, reject) => {
+      this.queue.push({ id: this.nextId++, job, resolve, reject })
+      this.dispatch()
+    })
+  }
+
+  //
+  // Rejects the jobs that did not complete and stops the workers.
+  //
+  terminate() {
+    for (const worker of this.workers) {
+      worker.worker.terminate()
+    }
+    this.workers = []
+    this.rejectAll('worker pool terminated')
+  }
+
+  dispatch() {
+    for (const worker of this.workers) {
+      if (this.queue.length === 0) {
+        return
+      }
+      if (worker.ready && worker.jobId === null) {
+        const task = this.queue.shift()
+        worker.jobId = task.id
+        this.pending.set(task.id, task)
+        worker.worker.postMessage({ id: task.id, job: task.job }, [task.job.buffer])
+      }
+    }
+    if (this.workers.length === 0) {
+      this.rejectAll('no worker could instantiate the module')
+    }
+  }
+
+  onMessage(worker, data) {
+    if (data.type === 'ready') {
+      worker.ready = true
+      this.dispatch()
+      return
+    }
+    if (data.type === 'failed') {
+      this.onFailed(worker, data.message)
+      return
+    }
+    const task = this.pending.get(data.id)
+    this.pending.delete(data.id)
+    worker.jobId = null
+    if (data.type === 'result') {
+      task.resolve(data.result)
+    } else {
+      task.reject(new Error(data.message))
+    }
+    this.dispatch()
+  }
+
+  onFailed(worker, message) {
+    worker.worker.terminate()
+    this.workers = this.workers.filter(other => other !== worker)
+    if (worker.jobId !== null) {
+      const task = this.pending.get(worker.jobId)
+      this.pending.delete(worker.jobId)
+      task.reject(new Error(message))
+    }
+    this.dispatch()
+  }
+
+  rejectAll(message) {
+    for (const task of [...this.pending.values(), ...this.queue]) {
+      task.reject(new Error(message))
+    }
+    this.pending.clear()
+    this.queue = []
+  }
+}
+
+if (typeof module === 'object' && module.exports) {
+  module.exports = WasmWorkerPool
+}
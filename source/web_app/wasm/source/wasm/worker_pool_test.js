@@ -0,0 +1,178 @@
+//
+// Tests of WasmWorkerPool with the script of its workers, run by node.  Each
+// worker runs apk_worker.js in a context of its own, with a module whose
+// apks answer by their first byte: 0 with properties, 1 with an exception
+// of C++ and 2 with an abort, after which the module only traps.
+//
+const assert = require('assert')
+const fs = require('fs')
+const path = require('path')
+const vm = require('vm')
+
+const WasmWorkerPool = require('./worker_pool.js')
+
+const WORKER_SCRIPT = fs.readFileSync(path.join(__dirname, 'apk_worker.js'), 'utf8')
+
+const PROPERTIES = 0
+const EXCEPTION = 1
+const ABORT = 2
+
+const createModule = () => {
+  let aborted = false
+  let bytes = null
+  const checkAlive = () => {
+    if (aborted) {
+      throw new WebAssembly.RuntimeError('unreachable')
+    }
+  }
+  return {
+    allocateApkBuffer: size => {
+      checkAlive()
+      bytes = new Uint8Array(size)
+      return bytes
+    },
+    getExceptionMessage: () => ['std::runtime_error', 'invalid apk'],
+    Apk: {
+      openBuffer: () => {
+        checkAlive()
+        return {
+          getProperties: () => {
+            switch (bytes[0]) {
+              case EXCEPTION:
+                throw 1024
+              case ABORT:
+                aborted = true
+                throw new WebAssembly.RuntimeError('Aborted(OOM)')
+              default:
+                return { packageName: `apk${bytes[1]}` }
+            }
+          },
+          delete: checkAlive
+        }
+      }
+    }
+  }
+}
+
+//
+// Worker running apk_worker.js, with messages delivered asynchronously both
+// ways as they are in a browser.  failInit makes instantiation fail.
+//
+class FakeWorker {
+  constructor(failInit) {
+    this.terminated = false
+    this.jobCount = 0
+    //
+    // The module is made in this realm, so its errors have to be
+    // recognized by the classes of this realm.
+    //
+    const context = {
+      Error,
+      WebAssembly,
+      importScripts: () => {
+        context.self.Module = async () => {
+          if (failInit) {
+            throw new Error('no memory for the module')
+          }
+          return createModule()
+        }
+      },
+      self: {
+        postMessage: data => setImmediate(() => this.terminated || this.onmessage({ data }))
+      }
+    }
+    vm.runInNewContext(WORKER_SCRIPT, context)
+    this.context = context
+  }
+
+  postMessage(data) {
+    if (data.job) {
+      this.jobCount++
+    }
+    setImmediate(() => this.terminated || this.context.self.onmessage({ data }))
+  }
+
+  terminate() {
+    this.terminated = true
+  }
+}
+
+const createPool = (workerCount, failedInits = 0) => {
+  const workers = []
+  global.Worker = class {
+    constructor() {
+      const worker = new FakeWorker(workers.length < failedInits)
+      workers.push(worker)
+      return worker
+    }
+  }
+  return [new WasmWorkerPool({ workerUrl: 'apk-worker.js', loaderUrl: 'wasm.wasm.js', module: null, workerCount }), workers]
+}
+
+const apk = (kind, index = 0) => ({ type: 'properties', buffer: new Uint8Array([kind, index]).buffer })
+
+const tests = {
+  async jobsOnSeveralWorkers_AllResolveWithTheirResult() {
+    const [pool, workers] = createPool(2)
+    const results = await Promise.all([0, 1, 2, 3, 4].map(index => pool.run(apk(PROPERTIES, index))))
+    assert.deepStrictEqual(results.map(result => result.packageName), ['apk0', 'apk1', 'apk2', 'apk3', 'apk4'])
+    assert.ok(workers.every(worker => worker.jobCount > 0))
+    pool.terminate()
+  },
+
+  async exceptionOfTheModule_JobFailsAndWorkerStays() {
+    const [pool] = createPool(1)
+    await assert.rejects(pool.run(apk(EXCEPTION)), { message: 'std::runtime_error: invalid apk' })
+    assert.strictEqual(pool.workers.length, 1)
+    assert.strictEqual((await pool.run(apk(PROPERTIES, 7))).packageName, 'apk7')
+    pool.terminate()
+  },
+
+  async moduleThatAborts_JobFailsAndWorkerIsRemoved() {
+    const [pool, workers] = createPool(2)
+    const aborting = pool.run(apk(ABORT))
+    const others = [1, 2, 3].map(index => pool.run(apk(PROPERTIES, index)))
+    await assert.rejects(aborting, { message: 'Aborted(OOM)' })
+    assert.deepStrictEqual((await Promise.all(others)).map(result => result.packageName), ['apk1', 'apk2', 'apk3'])
+    assert.strictEqual(pool.workers.length, 1)
+    const [aborted] = workers.filter(worker => worker.terminated)
+    assert.strictEqual(aborted.jobCount, 1)
+    pool.terminate()
+  },
+
+  async lastWorkerAborts_QueuedJobsFail() {
+    const [pool] = createPool(1)
+    const aborting = pool.run(apk(ABORT))
+    const queued = pool.run(apk(PROPERTIES))
+    await Promise.all([
+      assert.rejects(aborting, { message: 'Aborted(OOM)' }),
+      assert.rejects(queued, { message: 'no worker could instantiate the module' })
+    ])
+    assert.strictEqual(pool.workers.length, 0)
+  },
+
+  async workerThatFailsToInstantiate_IsLeftOut() {
+    const [pool, workers] = createPool(2, 1)
+    const results = await Promise.all([0, 1].map(index => pool.run(apk(PROPERTIES, index))))
+    assert.deepStrictEqual(results.map(result => result.packageName), ['apk0', 'apk1'])
+    assert.strictEqual(workers[0].jobCount, 0)
+    assert.strictEqual(pool.workers.length, 1)
+    pool.terminate()
+  }
+}
+
+const main = async () => {
+  let failures = 0
+  for (const [name, test] of Object.entries(tests)) {
+    try {
+      await test()
+      console.log(`[       OK ] ${name}`)
+    } catch (error) {
+      failures++
+      console.log(`[  FAILED  ] ${name}\n${error.stack}`)
+    }
+  }
+  process.exitCode = failures === 0 ? 0 : 1
+}
+
+main()